@@ -0,0 +1,1198 @@
+#include "hermes2d.h"
+#ifndef WIN32
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+using namespace Hermes;
+using namespace Hermes::Hermes2D;
+using namespace Hermes::Hermes2D::WeakFormsH1;
+using namespace Hermes::Hermes2D::RefinementSelectors;
+
+// Performance benchmarks of Hermes2D, scaled-up versions of the test examples
+// (01-poisson, 02-poisson-newton, 04-complex-adapt / 12-transient-adapt, 10-linear-advection-dg-adapt), with the results
+// in JSON for tracking the performance across releases.
+//
+// Usage: hermes2d-bench [options] [benchmark ...]
+//
+//   --refinements N   Uniform refinements of the unit square mesh (default 6, i.e. 4096 elements).
+//   --p P             Uniform polynomial degree (default 2).
+//   --threads T       Hermes2DApi numThreads (default: the library default).
+//   --adapt-steps S   Adaptivity steps of the 'adapt' benchmark (default 5).
+//   --max-threads M   The largest number of threads of the 'scaling' benchmark (default: omp_get_max_threads()).
+//   --output FILE     The JSON file (default: the standard output, where it may mix with the messages of the library).
+//   --machine TAG     The machine the results belong to (default: the host name).
+//   --baselines DIR   Compare the results with the baseline DIR/TAG.json of the machine (see below).
+//   --tolerance KIND=T  The relative tolerance of the metrics of a kind (time, throughput, memory), default 0.1 each.
+//
+// Benchmarks: startup, poisson, poisson-newton, dg-advection, adapt, kernels, scaling, hash; all of them if none is given.
+//
+// Reported: the number of DOFs, the number of assembled states (elements), the assembly time and the
+// states per second, the solver time, the DOFs per second (of the whole solution), the time of every
+// adaptivity step and the peak memory (of the process so far) after the benchmark.
+//
+// The 'startup' benchmark times the first small problem of the process (a Poisson problem on 16 elements, set up,
+// assembled and solved), which includes the creation of the tables of the library on their first use (the quadratures,
+// the precalculated shape functions or their loading from the file of PrecalcShapeset::save_shared_tables()
+// in precalculatedFormsDirPath), and the same problem again. It measures the cold start only as the first benchmark
+// of the run (as it is when all the benchmarks are run).
+//
+// The 'dg-advection' benchmark assembles the upwind DG forms of WeakFormsDG on an L2Space twice: with the forms
+// evaluated for all the pairs of functions at once (MatrixFormVol::value_all(), MatrixFormDG::value_all()) and,
+// as the reference, per pair (value_all() returning false). The solutions of both have to agree.
+//
+// The 'kernels' benchmark times the evaluations under the assembly in isolation, in nanoseconds per
+// (integration) point on a single triangle and a single (non-parallelogram) quad: Shapeset::get_fn_value()
+// and get_dx_value() of all the shape functions of every shapeset, PrecalcShapeset::precalculate() at every
+// integration order and the lookup of the precalculated tables, the RefMap geometry and the reading
+// of the Quad2D tables.
+//
+// The 'scaling' benchmark sweeps the number of threads (Hermes2DApi numThreads) 1, 2, 4, ..., M in one run
+// and reports the times, the speedups and the parallel efficiencies of DiscreteProblem::assemble(),
+// Adapt::calc_err_est() and Linearizer::process_solution() (the best of SCALING_REPEATS runs each).
+// The threads are pinned by the OpenMP runtime when it starts, i.e. by running the benchmark with
+// e.g. OMP_PROC_BIND=close OMP_PLACES=cores; the settings are copied into the report.
+//
+// The 'hash' benchmark times the node hash tables of Mesh (HashTable) on their own: the creation of the vertex
+// and edge nodes of 3 * 16 * 4^N parent pairs on 16 * 4^N top-level vertices (N = --refinements), the lookups
+// of all of them (HASH_LOOKUP_REPEATS times) and the copy of the tables.
+//
+// Regression gate: a baseline is the report of an earlier run on the same machine, stored as DIR/TAG.json
+// (e.g. by --output DIR/TAG.json). With --baselines, every metric of the baseline present in the current run
+// is compared and a PASS / FAIL line is written to the standard error for it: the times (and ns per point)
+// and the memory may grow and the throughputs (per second, speedups, efficiencies) may drop by the relative
+// tolerance of their kind. The sizes (DOFs, states, settings, threads) have to be the same, otherwise the
+// comparison is meaningless and fails. The exit status is 2 if any metric failed.
+
+const double VOLUME_HEAT_SRC = 10.0;
+
+/// The minimum time (in seconds) a kernel is repeated for.
+const double KERNEL_MIN_TIME = 0.05;
+
+/// The runs of every operation of the scaling benchmark, the best one is reported.
+const int SCALING_REPEATS = 3;
+
+/// The lookups of every node of the hash benchmark.
+const int HASH_LOOKUP_REPEATS = 2;
+
+struct BenchmarkSettings
+{
+  int refinements;
+  int p;
+  int adapt_steps;
+  int max_threads;
+};
+
+/* Nonlinear thermal conductivity lambda(u) = 1 + u^2 of 02-poisson-newton. */
+
+class CustomNonlinearity : public Hermes1DFunction<double>
+{
+public:
+  virtual double value(double u) const { return 1.0 + u * u; }
+  virtual Ord value(Ord u) const { return u * u; }
+  virtual double derivative(double u) const { return 2.0 * u; }
+  virtual Ord derivative(Ord u) const { return u; }
+};
+
+/* Timing helper. */
+
+class Stopwatch : public Hermes::Mixins::TimeMeasurable
+{
+public:
+  void start() { this->tick(HERMES_SKIP); }
+  double stop() { this->tick(); return this->last(); }
+};
+
+static long peak_memory_kb()
+{
+#ifndef WIN32
+  struct rusage usage;
+  if(getrusage(RUSAGE_SELF, &usage) != 0)
+    return -1;
+#ifdef __APPLE__
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+#else
+  return -1;
+#endif
+}
+
+/* The problem: the unit square, 'Bdy' on the whole boundary. */
+
+static void create_mesh(Mesh* mesh, int refinements)
+{
+  double2 verts[4] = { { 0.0, 0.0 }, { 1.0, 0.0 }, { 1.0, 1.0 }, { 0.0, 1.0 } };
+  int4 quads[1] = { { 0, 1, 2, 3 } };
+  std::string quad_markers[1] = { "Domain" };
+  int2 mark[4] = { { 0, 1 }, { 1, 2 }, { 2, 3 }, { 3, 0 } };
+  std::string boundary_markers[4] = { "Bdy", "Bdy", "Bdy", "Bdy" };
+  mesh->create(4, verts, 0, NULL, NULL, 1, quads, quad_markers, 4, mark, boundary_markers);
+  for(int i = 0; i < refinements; i++)
+    mesh->refine_all_elements();
+}
+
+/* A single element, a triangle or a quad that is not a parallelogram (the Jacobian is not constant). */
+
+static void create_element_mesh(Mesh* mesh, bool quad)
+{
+  double2 verts[4] = { { 0.0, 0.0 }, { 1.0, 0.0 }, { 1.2, 1.1 }, { 0.0, 0.9 } };
+  int3 tris[1] = { { 0, 1, 2 } };
+  int4 quads[1] = { { 0, 1, 2, 3 } };
+  std::string markers[1] = { "Domain" };
+  int2 quad_mark[4] = { { 0, 1 }, { 1, 2 }, { 2, 3 }, { 3, 0 } };
+  int2 tri_mark[3] = { { 0, 1 }, { 1, 2 }, { 2, 0 } };
+  std::string boundary_markers[4] = { "Bdy", "Bdy", "Bdy", "Bdy" };
+  if(quad)
+    mesh->create(4, verts, 0, NULL, NULL, 1, quads, markers, 4, quad_mark, boundary_markers);
+  else
+    mesh->create(3, verts, 1, tris, markers, 0, NULL, NULL, 3, tri_mark, boundary_markers);
+}
+
+/* JSON output. */
+
+/// The numeric results of a run, "benchmark.metric" (or "benchmark.metric[i]" of an array) to the value,
+/// the top-level ones without a benchmark.
+typedef std::map<std::string, double> Results;
+
+static std::string result_key(const std::string& benchmark, const std::string& name)
+{
+  return benchmark.empty() ? name : benchmark + "." + name;
+}
+
+static std::string result_key(const std::string& benchmark, const std::string& name, unsigned int index)
+{
+  char suffix[32];
+  sprintf(suffix, "[%u]", index);
+  return result_key(benchmark, name) + suffix;
+}
+
+class JsonReport
+{
+public:
+  JsonReport(FILE* out) : out(out), first_benchmark(true) {}
+
+  void begin(int num_threads, const char* machine)
+  {
+    fprintf(out, "{\n  \"hermes2d_bench_version\": 1,\n  \"machine\": \"%s\",\n  \"threads\": %d,\n  \"benchmarks\": [", machine, num_threads);
+    results["threads"] = num_threads;
+  }
+
+  void begin_benchmark(const char* name, const BenchmarkSettings& settings)
+  {
+    fprintf(out, "%s\n    {\n      \"name\": \"%s\",\n      \"refinements\": %d,\n      \"p\": %d", first_benchmark ? "" : ",", name, settings.refinements, settings.p);
+    first_benchmark = false;
+    benchmark = name;
+    results[result_key(benchmark, "refinements")] = settings.refinements;
+    results[result_key(benchmark, "p")] = settings.p;
+  }
+
+  void value(const char* name, double value)
+  {
+    fprintf(out, ",\n      \"%s\": %.9g", name, value);
+    results[result_key(benchmark, name)] = value;
+  }
+
+  void value(const char* name, long value)
+  {
+    fprintf(out, ",\n      \"%s\": %ld", name, value);
+    results[result_key(benchmark, name)] = value;
+  }
+
+  void value(const char* name, const char* value)
+  {
+    fprintf(out, ",\n      \"%s\": \"%s\"", name, value);
+  }
+
+  void values(const char* name, const std::vector<double>& values)
+  {
+    fprintf(out, ",\n      \"%s\": [", name);
+    for(unsigned int i = 0; i < values.size(); i++)
+    {
+      fprintf(out, "%s%.9g", i == 0 ? "" : ", ", values[i]);
+      results[result_key(benchmark, name, i)] = values[i];
+    }
+    fprintf(out, "]");
+  }
+
+  void end_benchmark()
+  {
+    value("peak_memory_kb", peak_memory_kb());
+    fprintf(out, "\n    }");
+    fflush(out);
+  }
+
+  void end()
+  {
+    fprintf(out, "\n  ]\n}\n");
+    fflush(out);
+  }
+
+  const Results& get_results() const { return results; }
+
+protected:
+  FILE* out;
+  bool first_benchmark;
+  std::string benchmark;
+  Results results;
+};
+
+/* Regression gate. */
+
+/// Reads the numeric results of a report written by JsonReport (one value per line).
+static bool load_results(const char* file_name, Results& results)
+{
+  std::ifstream in(file_name);
+  if(!in.is_open())
+    return false;
+  std::string line, benchmark;
+  while(std::getline(in, line))
+  {
+    size_t key_start = line.find('"');
+    size_t key_end = (key_start == std::string::npos) ? std::string::npos : line.find('"', key_start + 1);
+    if(key_end == std::string::npos || line.compare(key_end + 1, 2, ": ") != 0)
+      continue;
+    std::string key = line.substr(key_start + 1, key_end - key_start - 1);
+    std::string value = line.substr(key_end + 3);
+
+    if(key == "name")
+    {
+      size_t name_end = value.find('"', 1);
+      benchmark = value.substr(1, name_end == std::string::npos ? std::string::npos : name_end - 1);
+    }
+    else if(!value.empty() && value[0] == '[')
+    {
+      const char* pos = value.c_str() + 1;
+      for(unsigned int i = 0; ; i++)
+      {
+        char* end;
+        double number = strtod(pos, &end);
+        if(end == pos)
+          break;
+        results[result_key(benchmark, key, i)] = number;
+        pos = end;
+        while(*pos == ',' || *pos == ' ')
+          pos++;
+      }
+    }
+    else
+    {
+      char* end;
+      double number = strtod(value.c_str(), &end);
+      if(end != value.c_str())
+        results[result_key(benchmark, key)] = number;
+    }
+  }
+  return true;
+}
+
+enum MetricKind
+{
+  METRIC_IGNORED,
+  /// Has to be the same (the size of the problem, the settings).
+  METRIC_EXACT,
+  /// Lower is better, by the tolerance of the kind.
+  METRIC_TIME,
+  METRIC_MEMORY,
+  /// Higher is better.
+  METRIC_THROUGHPUT
+};
+
+static bool ends_with(const std::string& text, const char* suffix)
+{
+  size_t length = strlen(suffix);
+  return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+}
+
+static MetricKind metric_kind(const std::string& key)
+{
+  std::string name = key.substr(key.find('.') == std::string::npos ? 0 : key.find('.') + 1);
+  name = name.substr(0, name.find('['));
+  if(name == "threads" || name == "refinements" || name == "p" || name == "ndofs" || name == "states" || name == "nodes" || name == "reference_ndofs")
+    return METRIC_EXACT;
+  if(ends_with(name, "memory_kb"))
+    return METRIC_MEMORY;
+  if(ends_with(name, "_per_s") || ends_with(name, "_speedups") || ends_with(name, "_efficiencies"))
+    return METRIC_THROUGHPUT;
+  if(ends_with(name, "_time") || ends_with(name, "_times") || name.find("ns_per_point") != std::string::npos)
+    return METRIC_TIME;
+  return METRIC_IGNORED;
+}
+
+/// Writes the PASS / FAIL lines of the metrics, returns the number of the failed ones.
+static int compare_results(const Results& current, const Results& baseline, double tolerances[])
+{
+  int num_compared = 0, num_failed = 0;
+  for(Results::const_iterator it = baseline.begin(); it != baseline.end(); it++)
+  {
+    MetricKind kind = metric_kind(it->first);
+    Results::const_iterator found = current.find(it->first);
+    if(kind == METRIC_IGNORED || found == current.end())
+      continue;
+
+    double value = found->second, base = it->second;
+    bool passed;
+    if(kind == METRIC_EXACT)
+      passed = (value == base);
+    else if(kind == METRIC_THROUGHPUT)
+      passed = value >= base * (1.0 - tolerances[kind]);
+    else
+      passed = value <= base * (1.0 + tolerances[kind]);
+    double change = (base == 0.0) ? 0.0 : 100.0 * (value - base) / base;
+    fprintf(stderr, "%s %s %.6g (baseline %.6g, %+.1f%%)\n", passed ? "PASS" : "FAIL", it->first.c_str(), value, base, change);
+    num_compared++;
+    if(!passed)
+      num_failed++;
+  }
+  fprintf(stderr, "%d metrics compared, %d failed.\n", num_compared, num_failed);
+  return num_failed;
+}
+
+/* Startup: the first problem of the process and the same one again. */
+
+static double solve_small_problem(int p)
+{
+  Stopwatch stopwatch;
+  stopwatch.start();
+  Mesh mesh;
+  create_mesh(&mesh, 2);
+  DefaultEssentialBCConst<double> bc_essential("Bdy", 0.0);
+  EssentialBCs<double> bcs(&bc_essential);
+  H1Space<double> space(&mesh, &bcs, p);
+  Hermes1DFunction<double> lambda(1.0);
+  Hermes2DFunction<double> src(-VOLUME_HEAT_SRC);
+  DefaultWeakFormPoisson<double> wf(HERMES_ANY, &lambda, &src);
+
+  SparseMatrix<double>* matrix = create_matrix<double>();
+  Vector<double>* rhs = create_vector<double>();
+  LinearMatrixSolver<double>* solver = create_linear_solver<double>(matrix, rhs);
+  DiscreteProblem<double> dp(&wf, &space);
+  dp.assemble(matrix, rhs);
+  solver->solve();
+
+  delete solver;
+  delete matrix;
+  delete rhs;
+  return stopwatch.stop();
+}
+
+static void benchmark_startup(const BenchmarkSettings& settings, JsonReport& report)
+{
+  double cold_time = solve_small_problem(settings.p);
+  double warm_time = solve_small_problem(settings.p);
+
+  H1Shapeset shapeset;
+  std::string tables_file_name = PrecalcShapeset::get_shared_tables_file_name(&shapeset, Hermes2DApi.get_text_param_value(Hermes::Hermes2D::precalculatedFormsDirPath).c_str());
+  FILE* tables_file = fopen(tables_file_name.c_str(), "rb");
+  if(tables_file != NULL)
+    fclose(tables_file);
+
+  report.begin_benchmark("startup", settings);
+  report.value("cold_time", cold_time);
+  report.value("warm_time", warm_time);
+  report.value("cold_start_overhead_time", std::max(cold_time - warm_time, 0.0));
+  report.value("precalc_tables_file", tables_file != NULL ? "present" : "none");
+  report.end_benchmark();
+}
+
+/* 01-poisson: one assembling and one solution of a linear system. */
+
+static void benchmark_poisson(const BenchmarkSettings& settings, JsonReport& report)
+{
+  Mesh mesh;
+  create_mesh(&mesh, settings.refinements);
+  DefaultEssentialBCConst<double> bc_essential("Bdy", 0.0);
+  EssentialBCs<double> bcs(&bc_essential);
+  H1Space<double> space(&mesh, &bcs, settings.p);
+  DefaultWeakFormPoisson<double> wf(HERMES_ANY, new Hermes1DFunction<double>(1.0), new Hermes2DFunction<double>(-VOLUME_HEAT_SRC));
+
+  int ndof = space.get_num_dofs();
+  long num_states = mesh.get_num_active_elements();
+
+  Stopwatch stopwatch;
+  SparseMatrix<double>* matrix = create_matrix<double>();
+  Vector<double>* rhs = create_vector<double>();
+  LinearMatrixSolver<double>* solver = create_linear_solver<double>(matrix, rhs);
+
+  DiscreteProblem<double> dp(&wf, &space);
+  stopwatch.start();
+  dp.assemble(matrix, rhs);
+  double assembly_time = stopwatch.stop();
+
+  stopwatch.start();
+  solver->solve();
+  double solver_time = stopwatch.stop();
+
+  delete solver;
+  delete matrix;
+  delete rhs;
+
+  report.begin_benchmark("poisson", settings);
+  report.value("ndofs", (long)ndof);
+  report.value("states", num_states);
+  report.value("assembly_time", assembly_time);
+  report.value("assembly_states_per_s", num_states / std::max(assembly_time, 1e-9));
+  report.value("solver_time", solver_time);
+  report.value("dofs_per_s", ndof / std::max(assembly_time + solver_time, 1e-9));
+  report.end_benchmark();
+}
+
+/* 02-poisson-newton: the Newton's method on a nonlinear problem. */
+
+static void benchmark_poisson_newton(const BenchmarkSettings& settings, JsonReport& report)
+{
+  Mesh mesh;
+  create_mesh(&mesh, settings.refinements);
+  DefaultEssentialBCConst<double> bc_essential("Bdy", 0.0);
+  EssentialBCs<double> bcs(&bc_essential);
+  H1Space<double> space(&mesh, &bcs, settings.p);
+  CustomNonlinearity lambda;
+  Hermes2DFunction<double> src(-VOLUME_HEAT_SRC);
+  DefaultWeakFormPoisson<double> wf(HERMES_ANY, &lambda, &src);
+
+  int ndof = space.get_num_dofs();
+  long num_states = mesh.get_num_active_elements();
+
+  Stopwatch stopwatch;
+  NewtonSolver<double> newton(&wf, &space);
+  newton.set_verbose_output(false);
+  newton.set_newton_tol(1e-8);
+  stopwatch.start();
+  newton.solve();
+  double newton_time = stopwatch.stop();
+
+  report.begin_benchmark("poisson-newton", settings);
+  report.value("ndofs", (long)ndof);
+  report.value("states", num_states);
+  report.value("newton_time", newton_time);
+  report.value("dofs_per_s", ndof / std::max(newton_time, 1e-9));
+  report.end_benchmark();
+}
+
+/* 10-linear-advection-dg-adapt: the upwind DG forms of WeakFormsDG, evaluated at once for all the pairs of functions
+   (value_all()) and per pair. */
+
+class PerPairMatrixFormVolAdvection : public WeakFormsDG::DefaultMatrixFormVolAdvection<double>
+{
+public:
+  PerPairMatrixFormVolAdvection(Hermes2DFunction<double>* velocity_x, Hermes2DFunction<double>* velocity_y)
+    : WeakFormsDG::DefaultMatrixFormVolAdvection<double>(0, 0, velocity_x, velocity_y) {}
+
+  virtual bool value_all(int n, double *wt, Func<double> *u_ext[], int u_count, Func<double> **u, int v_count, Func<double> **v,
+    Geom<double> *e, Func<double> **ext, double **local_matrix) const { return false; }
+
+  virtual MatrixFormVol<double>* clone() const { return new PerPairMatrixFormVolAdvection(*this); }
+};
+
+class PerPairMatrixFormDGUpwind : public WeakFormsDG::DefaultMatrixFormDGUpwind<double>
+{
+public:
+  PerPairMatrixFormDGUpwind(Hermes2DFunction<double>* velocity_x, Hermes2DFunction<double>* velocity_y)
+    : WeakFormsDG::DefaultMatrixFormDGUpwind<double>(0, 0, velocity_x, velocity_y) {}
+
+  virtual bool value_all(int n, double *wt, int u_count, DiscontinuousFunc<double> **u, int v_count, DiscontinuousFunc<double> **v,
+    Geom<double> *e, DiscontinuousFunc<double> **ext, double **local_matrix) const { return false; }
+
+  virtual MatrixFormDG<double>* clone() const { return new PerPairMatrixFormDGUpwind(*this); }
+};
+
+/* The velocity (1, 0.5), the inflow value 1. */
+
+class AdvectionWeakForm : public WeakForm<double>
+{
+public:
+  AdvectionWeakForm(bool per_pair) : WeakForm<double>(1), per_pair(per_pair), velocity_x(1.0), velocity_y(0.5), inflow_values(1.0)
+  {
+    if(per_pair)
+    {
+      add_matrix_form(new PerPairMatrixFormVolAdvection(&velocity_x, &velocity_y));
+      add_matrix_form_DG(new PerPairMatrixFormDGUpwind(&velocity_x, &velocity_y));
+    }
+    else
+    {
+      add_matrix_form(new WeakFormsDG::DefaultMatrixFormVolAdvection<double>(0, 0, &velocity_x, &velocity_y));
+      add_matrix_form_DG(new WeakFormsDG::DefaultMatrixFormDGUpwind<double>(0, 0, &velocity_x, &velocity_y));
+    }
+    add_matrix_form_surf(new WeakFormsDG::DefaultMatrixFormSurfUpwind<double>(0, 0, &velocity_x, &velocity_y));
+    add_vector_form_surf(new WeakFormsDG::DefaultVectorFormSurfUpwind<double>(0, &velocity_x, &velocity_y, &inflow_values));
+  }
+
+  virtual WeakForm<double>* clone() const { return new AdvectionWeakForm(per_pair); }
+
+protected:
+  bool per_pair;
+  Hermes2DFunction<double> velocity_x;
+  Hermes2DFunction<double> velocity_y;
+  Hermes2DFunction<double> inflow_values;
+};
+
+/// Assembles and solves the problem, returns the assembly time.
+static double solve_dg_advection(WeakForm<double>* wf, Space<double>* space, double* sln_vector)
+{
+  SparseMatrix<double>* matrix = create_matrix<double>();
+  Vector<double>* rhs = create_vector<double>();
+  LinearMatrixSolver<double>* solver = create_linear_solver<double>(matrix, rhs);
+
+  Stopwatch stopwatch;
+  DiscreteProblem<double> dp(wf, space);
+  stopwatch.start();
+  dp.assemble(matrix, rhs);
+  double assembly_time = stopwatch.stop();
+
+  solver->solve();
+  memcpy(sln_vector, solver->get_sln_vector(), space->get_num_dofs() * sizeof(double));
+
+  delete solver;
+  delete matrix;
+  delete rhs;
+  return assembly_time;
+}
+
+static void benchmark_dg_advection(const BenchmarkSettings& settings, JsonReport& report)
+{
+  Mesh mesh;
+  create_mesh(&mesh, settings.refinements);
+  L2Space<double> space(&mesh, settings.p);
+  AdvectionWeakForm wf(false);
+  AdvectionWeakForm wf_per_pair(true);
+
+  int ndof = space.get_num_dofs();
+  long num_states = mesh.get_num_active_elements();
+
+  double* sln_vector = new double[ndof];
+  double* sln_vector_per_pair = new double[ndof];
+  double assembly_time = solve_dg_advection(&wf, &space, sln_vector);
+  double per_pair_assembly_time = solve_dg_advection(&wf_per_pair, &space, sln_vector_per_pair);
+
+  // Both evaluations discretize the same problem.
+  double max_value = 0.0, max_difference = 0.0;
+  for(int i = 0; i < ndof; i++)
+  {
+    max_value = std::max(max_value, std::abs(sln_vector[i]));
+    max_difference = std::max(max_difference, std::abs(sln_vector[i] - sln_vector_per_pair[i]));
+  }
+  delete [] sln_vector;
+  delete [] sln_vector_per_pair;
+  if(max_difference > 1e-10 * max_value)
+    throw Hermes::Exceptions::Exception("The batched and the per pair DG forms differ by %g.", max_difference);
+
+  report.begin_benchmark("dg-advection", settings);
+  report.value("ndofs", (long)ndof);
+  report.value("states", num_states);
+  report.value("assembly_time", assembly_time);
+  report.value("assembly_states_per_s", num_states / std::max(assembly_time, 1e-9));
+  report.value("per_pair_assembly_time", per_pair_assembly_time);
+  report.value("per_pair_assembly_states_per_s", num_states / std::max(per_pair_assembly_time, 1e-9));
+  report.end_benchmark();
+}
+
+/* 04-complex-adapt, 12-transient-adapt: hp-adaptivity steps with the reference solution. */
+
+static void benchmark_adapt(const BenchmarkSettings& settings, JsonReport& report)
+{
+  Mesh mesh;
+  create_mesh(&mesh, std::max(settings.refinements - 3, 0));
+  DefaultEssentialBCConst<double> bc_essential("Bdy", 0.0);
+  EssentialBCs<double> bcs(&bc_essential);
+  H1Space<double> space(&mesh, &bcs, settings.p);
+  DefaultWeakFormPoisson<double> wf(HERMES_ANY, new Hermes1DFunction<double>(1.0), new Hermes2DFunction<double>(-VOLUME_HEAT_SRC));
+  H1ProjBasedSelector<double> selector(H2D_HP_ANISO, 1.0, H2DRS_DEFAULT_ORDER);
+
+  Stopwatch stopwatch, step_stopwatch;
+  std::vector<double> step_times, reference_solver_times, reference_ndofs;
+  Solution<double> sln, ref_sln;
+  for(int step = 0; step < settings.adapt_steps; step++)
+  {
+    step_stopwatch.start();
+
+    Mesh::ReferenceMeshCreator ref_mesh_creator(&mesh);
+    Mesh* ref_mesh = ref_mesh_creator.create_ref_mesh();
+    Space<double>::ReferenceSpaceCreator ref_space_creator(&space, ref_mesh);
+    Space<double>* ref_space = ref_space_creator.create_ref_space();
+    reference_ndofs.push_back(ref_space->get_num_dofs());
+
+    stopwatch.start();
+    NewtonSolver<double> newton(&wf, ref_space);
+    newton.set_verbose_output(false);
+    newton.solve();
+    Solution<double>::vector_to_solution(newton.get_sln_vector(), ref_space, &ref_sln);
+    reference_solver_times.push_back(stopwatch.stop());
+
+    OGProjection<double> ogProjection;
+    ogProjection.project_global(&space, &ref_sln, &sln);
+    Adapt<double> adaptivity(&space);
+    adaptivity.set_verbose_output(false);
+    adaptivity.calc_err_est(&sln, &ref_sln);
+    bool done = adaptivity.adapt(&selector, 0.3, 0, -1);
+
+    step_times.push_back(step_stopwatch.stop());
+
+    delete ref_space;
+    delete ref_mesh;
+    if(done)
+      break;
+  }
+
+  report.begin_benchmark("adapt", settings);
+  report.value("ndofs", (long)space.get_num_dofs());
+  report.values("reference_ndofs", reference_ndofs);
+  report.values("reference_solver_times", reference_solver_times);
+  report.values("adapt_step_times", step_times);
+  report.end_benchmark();
+}
+
+/* Kernels: the evaluations under the assembly, in nanoseconds per point. */
+
+static double kernel_sink = 0.0;
+
+class Kernel
+{
+public:
+  virtual ~Kernel() {}
+  /// One run of the kernel, returns the number of the points evaluated.
+  virtual long run() = 0;
+};
+
+static double ns_per_point(Kernel& kernel)
+{
+  Stopwatch stopwatch;
+  long points = 0;
+  double time = 0.0;
+  while(time < KERNEL_MIN_TIME)
+  {
+    stopwatch.start();
+    points += kernel.run();
+    time += stopwatch.stop();
+  }
+  return time * 1e9 / std::max(points, 1L);
+}
+
+/// Shapeset::get_fn_value() or get_dx_value() of all the shape functions (and components) at the points of a rule.
+/// Derived from the shapeset, the values are accessible to the library classes only.
+template<typename ShapesetType>
+class ShapesetKernel : public Kernel, public ShapesetType
+{
+public:
+  ShapesetKernel(ElementMode2D mode, int order, bool dx) : mode(mode), order(order), dx(dx) {}
+
+  virtual long run()
+  {
+    int np = g_quad_2d_std.get_num_points(order, mode);
+    double3* pt = g_quad_2d_std.get_points(order, mode);
+    int max_index = this->get_max_index(mode);
+    int num_components = this->get_num_components();
+    double sum = 0.0;
+    for(int index = 0; index <= max_index; index++)
+      for(int component = 0; component < num_components; component++)
+        for(int i = 0; i < np; i++)
+          sum += dx ? this->get_dx_value(index, pt[i][0], pt[i][1], component, mode) : this->get_fn_value(index, pt[i][0], pt[i][1], component, mode);
+    kernel_sink += sum;
+    return (long)(max_index + 1) * num_components * np;
+  }
+
+protected:
+  ElementMode2D mode;
+  int order;
+  bool dx;
+};
+
+template<typename ShapesetType>
+static void report_shapeset_kernels(JsonReport& report, const char* shapeset_name, const char* mode_name, ElementMode2D mode, int order)
+{
+  char name[128];
+  ShapesetKernel<ShapesetType> fn_kernel(mode, order, false);
+  sprintf(name, "shapeset_%s_fn_ns_per_point_%s", shapeset_name, mode_name);
+  report.value(name, ns_per_point(fn_kernel));
+  ShapesetKernel<ShapesetType> dx_kernel(mode, order, true);
+  sprintf(name, "shapeset_%s_dx_ns_per_point_%s", shapeset_name, mode_name);
+  report.value(name, ns_per_point(dx_kernel));
+}
+
+/// The transformations of PrecalcShapeset are for the library classes only, the ones of Transformable are public.
+static Transformable* transformable(PrecalcShapeset* pss)
+{
+  return pss;
+}
+
+/// PrecalcShapeset::precalculate() of all the shape functions at an order. A new instance on a son of the element
+/// every run, so that neither its cache nor the tables shared by the instances (of the unrefined elements) are used.
+class PrecalcKernel : public Kernel
+{
+public:
+  PrecalcKernel(Shapeset* shapeset, Element* e, int order) : shapeset(shapeset), e(e), order(order) {}
+
+  virtual long run()
+  {
+    PrecalcShapeset pss(shapeset);
+    pss.set_active_element(e);
+    transformable(&pss)->push_transform(0);
+    int max_index = shapeset->get_max_index(e->get_mode());
+    for(int index = 0; index <= max_index; index++)
+    {
+      pss.set_active_shape(index);
+      pss.set_quad_order(order);
+      kernel_sink += pss.get_fn_values()[0];
+    }
+    return (long)(max_index + 1) * g_quad_2d_std.get_num_points(order, e->get_mode());
+  }
+
+protected:
+  Shapeset* shapeset;
+  Element* e;
+  int order;
+};
+
+/// The lookup of the tables precalculated by PrecalcShapeset (the cache hits of the assembly), per point of the tables.
+class PrecalcLookupKernel : public Kernel
+{
+public:
+  PrecalcLookupKernel(Shapeset* shapeset, Element* e, int order) : pss(shapeset), order(order)
+  {
+    pss.set_active_element(e);
+    transformable(&pss)->push_transform(0);
+    max_index = shapeset->get_max_index(e->get_mode());
+    np = g_quad_2d_std.get_num_points(order, e->get_mode());
+  }
+
+  virtual long run()
+  {
+    for(int index = 0; index <= max_index; index++)
+    {
+      pss.set_active_shape(index);
+      pss.set_quad_order(order);
+      kernel_sink += pss.get_fn_values()[0];
+    }
+    return (long)(max_index + 1) * np;
+  }
+
+protected:
+  PrecalcShapeset pss;
+  int order;
+  int max_index;
+  int np;
+};
+
+/// The RefMap geometry (the Jacobian, the inverse reference map, the physical coordinates) at all the orders,
+/// a new instance every run.
+class RefMapKernel : public Kernel
+{
+public:
+  RefMapKernel(Element* e) : e(e) {}
+
+  virtual long run()
+  {
+    RefMap refmap;
+    refmap.set_quad_2d(&g_quad_2d_std);
+    refmap.set_active_element(e);
+    long points = 0;
+    for(int order = 0; order <= g_quad_2d_std.get_max_order(e->get_mode()); order++)
+    {
+      kernel_sink += refmap.get_jacobian(order)[0] + refmap.get_inv_ref_map(order)[0][0][0] + refmap.get_phys_x(order)[0] + refmap.get_phys_y(order)[0];
+      points += g_quad_2d_std.get_num_points(order, e->get_mode());
+    }
+    return points;
+  }
+
+protected:
+  Element* e;
+};
+
+/// Reading the points and the weights of the Quad2D rules of all the orders.
+class QuadKernel : public Kernel
+{
+public:
+  QuadKernel(ElementMode2D mode) : mode(mode) {}
+
+  virtual long run()
+  {
+    long points = 0;
+    double sum = 0.0;
+    for(int order = 0; order <= g_quad_2d_std.get_max_order(mode); order++)
+    {
+      int np = g_quad_2d_std.get_num_points(order, mode);
+      double3* pt = g_quad_2d_std.get_points(order, mode);
+      for(int i = 0; i < np; i++)
+        sum += pt[i][2] * (pt[i][0] + pt[i][1]);
+      points += np;
+    }
+    kernel_sink += sum;
+    return points;
+  }
+
+protected:
+  ElementMode2D mode;
+};
+
+static void benchmark_kernels(const BenchmarkSettings& settings, JsonReport& report)
+{
+  H1ShapesetOrtho h1_ortho;
+  const char* mode_names[2] = { "tri", "quad" };
+
+  Mesh meshes[2];
+  create_element_mesh(&meshes[HERMES_MODE_TRIANGLE], false);
+  create_element_mesh(&meshes[HERMES_MODE_QUAD], true);
+
+  // The rule of the mass matrix of the polynomial degree p.
+  int order = std::min(2 * settings.p, g_max_quad);
+
+  report.begin_benchmark("kernels", settings);
+  char name[128];
+  for(int mode = 0; mode < 2; mode++)
+  {
+    report_shapeset_kernels<H1ShapesetOrtho>(report, "h1_ortho", mode_names[mode], (ElementMode2D)mode, order);
+    report_shapeset_kernels<H1ShapesetJacobi>(report, "h1_jacobi", mode_names[mode], (ElementMode2D)mode, order);
+    report_shapeset_kernels<HcurlShapesetLegendre>(report, "hcurl_legendre", mode_names[mode], (ElementMode2D)mode, order);
+    report_shapeset_kernels<HcurlShapesetGradLeg>(report, "hcurl_gradleg", mode_names[mode], (ElementMode2D)mode, order);
+    report_shapeset_kernels<HdivShapesetLegendre>(report, "hdiv_legendre", mode_names[mode], (ElementMode2D)mode, order);
+    report_shapeset_kernels<L2ShapesetLegendre>(report, "l2_legendre", mode_names[mode], (ElementMode2D)mode, order);
+
+    Element* e = meshes[mode].get_element(0);
+    std::vector<double> precalc_times, lookup_times;
+    for(int precalc_order = 0; precalc_order <= g_quad_2d_std.get_max_order((ElementMode2D)mode); precalc_order++)
+    {
+      PrecalcKernel precalc_kernel(&h1_ortho, e, precalc_order);
+      precalc_times.push_back(ns_per_point(precalc_kernel));
+      PrecalcLookupKernel lookup_kernel(&h1_ortho, e, precalc_order);
+      lookup_times.push_back(ns_per_point(lookup_kernel));
+    }
+    sprintf(name, "precalc_ns_per_point_%s", mode_names[mode]);
+    report.values(name, precalc_times);
+    sprintf(name, "precalc_lookup_ns_per_point_%s", mode_names[mode]);
+    report.values(name, lookup_times);
+
+    RefMapKernel refmap_kernel(e);
+    sprintf(name, "refmap_ns_per_point_%s", mode_names[mode]);
+    report.value(name, ns_per_point(refmap_kernel));
+
+    QuadKernel quad_kernel((ElementMode2D)mode);
+    sprintf(name, "quad_ns_per_point_%s", mode_names[mode]);
+    report.value(name, ns_per_point(quad_kernel));
+  }
+  report.value("sink", kernel_sink);
+  report.end_benchmark();
+}
+
+/* Thread scaling of the assembly, the error estimation and the linearization. */
+
+static void report_scaling(JsonReport& report, const char* operation, const std::vector<double>& threads, const std::vector<double>& times)
+{
+  std::vector<double> speedups, efficiencies;
+  for(unsigned int i = 0; i < times.size(); i++)
+  {
+    speedups.push_back(times[0] / std::max(times[i], 1e-9));
+    efficiencies.push_back(speedups[i] / threads[i]);
+  }
+  char name[128];
+  sprintf(name, "%s_times", operation);
+  report.values(name, times);
+  sprintf(name, "%s_speedups", operation);
+  report.values(name, speedups);
+  sprintf(name, "%s_efficiencies", operation);
+  report.values(name, efficiencies);
+}
+
+static void benchmark_scaling(const BenchmarkSettings& settings, JsonReport& report)
+{
+  Mesh mesh;
+  create_mesh(&mesh, settings.refinements);
+  DefaultEssentialBCConst<double> bc_essential("Bdy", 0.0);
+  EssentialBCs<double> bcs(&bc_essential);
+  H1Space<double> space(&mesh, &bcs, settings.p);
+  DefaultWeakFormPoisson<double> wf(HERMES_ANY, new Hermes1DFunction<double>(1.0), new Hermes2DFunction<double>(-VOLUME_HEAT_SRC));
+
+  // The solutions for the error estimation and the linearization, computed once.
+  Mesh::ReferenceMeshCreator ref_mesh_creator(&mesh);
+  Mesh* ref_mesh = ref_mesh_creator.create_ref_mesh();
+  Space<double>::ReferenceSpaceCreator ref_space_creator(&space, ref_mesh);
+  Space<double>* ref_space = ref_space_creator.create_ref_space();
+  Solution<double> sln, ref_sln;
+  NewtonSolver<double> newton(&wf, ref_space);
+  newton.set_verbose_output(false);
+  newton.solve();
+  Solution<double>::vector_to_solution(newton.get_sln_vector(), ref_space, &ref_sln);
+  OGProjection<double> ogProjection;
+  ogProjection.project_global(&space, &ref_sln, &sln);
+
+  int original_num_threads = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
+  std::vector<double> threads, assembly_times, err_est_times, linearizer_times;
+  for(int num_threads = 1; num_threads < settings.max_threads; num_threads *= 2)
+    threads.push_back(num_threads);
+  threads.push_back(settings.max_threads);
+
+  Stopwatch stopwatch;
+  for(unsigned int i = 0; i < threads.size(); i++)
+  {
+    Hermes2DApi.set_integral_param_value(Hermes::Hermes2D::numThreads, (int)threads[i]);
+    double assembly_time = 0.0, err_est_time = 0.0, linearizer_time = 0.0;
+    for(int repeat = 0; repeat < SCALING_REPEATS; repeat++)
+    {
+      SparseMatrix<double>* matrix = create_matrix<double>();
+      Vector<double>* rhs = create_vector<double>();
+      DiscreteProblem<double> dp(&wf, &space);
+      stopwatch.start();
+      dp.assemble(matrix, rhs);
+      double time = stopwatch.stop();
+      assembly_time = (repeat == 0) ? time : std::min(assembly_time, time);
+      delete matrix;
+      delete rhs;
+
+      Adapt<double> adaptivity(&space);
+      adaptivity.set_verbose_output(false);
+      stopwatch.start();
+      adaptivity.calc_err_est(&sln, &ref_sln);
+      time = stopwatch.stop();
+      err_est_time = (repeat == 0) ? time : std::min(err_est_time, time);
+
+      Views::Linearizer linearizer;
+      stopwatch.start();
+      linearizer.process_solution(&ref_sln);
+      time = stopwatch.stop();
+      linearizer_time = (repeat == 0) ? time : std::min(linearizer_time, time);
+    }
+    assembly_times.push_back(assembly_time);
+    err_est_times.push_back(err_est_time);
+    linearizer_times.push_back(linearizer_time);
+  }
+  Hermes2DApi.set_integral_param_value(Hermes::Hermes2D::numThreads, original_num_threads);
+
+  delete ref_space;
+  delete ref_mesh;
+
+  report.begin_benchmark("scaling", settings);
+  report.value("ndofs", (long)space.get_num_dofs());
+  report.value("states", (long)mesh.get_num_active_elements());
+  report.value("omp_proc_bind", getenv("OMP_PROC_BIND") == NULL ? "" : getenv("OMP_PROC_BIND"));
+  report.value("omp_places", getenv("OMP_PLACES") == NULL ? "" : getenv("OMP_PLACES"));
+  report.values("threads", threads);
+  report_scaling(report, "assembly", threads, assembly_times);
+  report_scaling(report, "err_est", threads, err_est_times);
+  report_scaling(report, "linearizer", threads, linearizer_times);
+  report.end_benchmark();
+}
+
+/* The node hash tables of Mesh: creating, looking up and copying the nodes. */
+
+/// Exposes the node tables of HashTable (the base of Mesh) to the benchmark.
+class BenchmarkHashTable : public HashTable
+{
+public:
+  BenchmarkHashTable() { this->init(); }
+
+  void add_top_level_vertices(int count)
+  {
+    for(int i = 0; i < count; i++)
+    {
+      Node* node = this->nodes.add();
+      node->ref = TOP_LEVEL_REF;
+      node->type = HERMES_TYPE_VERTEX;
+      node->bnd = 0;
+      node->p1 = node->p2 = -1;
+      node->x = (double)i;
+      node->y = 0.0;
+    }
+  }
+
+  using HashTable::get_num_nodes;
+  using HashTable::get_vertex_node;
+  using HashTable::get_edge_node;
+  using HashTable::peek_vertex_node;
+  using HashTable::peek_edge_node;
+  using HashTable::copy;
+};
+
+/// The i-th parent pair of the hash benchmark on count top-level vertices: neighbours and distant vertices, both orders.
+static void hash_parents(int i, int count, int& p1, int& p2)
+{
+  int vertex = i % count;
+  switch(i / count)
+  {
+  case 0: p1 = vertex; p2 = (vertex + 1) % count; break;
+  case 1: p1 = (vertex + count / 2 + 1) % count; p2 = vertex; break;
+  default: p1 = vertex; p2 = (vertex + 7919) % count; break;
+  }
+}
+
+static void benchmark_hash(const BenchmarkSettings& settings, JsonReport& report)
+{
+  int num_top_level_vertices = 16 << (2 * std::min(std::max(settings.refinements, 0), 8));
+  int num_pairs = 3 * num_top_level_vertices;
+
+  Stopwatch stopwatch;
+  BenchmarkHashTable table;
+  table.add_top_level_vertices(num_top_level_vertices);
+
+  int p1, p2;
+  stopwatch.start();
+  for(int i = 0; i < num_pairs; i++)
+  {
+    hash_parents(i, num_top_level_vertices, p1, p2);
+    table.get_vertex_node(p1, p2);
+    table.get_edge_node(p1, p2);
+  }
+  double insert_time = stopwatch.stop();
+
+  long num_found = 0;
+  stopwatch.start();
+  for(int repeat = 0; repeat < HASH_LOOKUP_REPEATS; repeat++)
+    for(int i = 0; i < num_pairs; i++)
+    {
+      hash_parents(i, num_top_level_vertices, p1, p2);
+      if(table.peek_vertex_node(p2, p1) != NULL)
+        num_found++;
+      if(table.peek_edge_node(p1, p2) != NULL)
+        num_found++;
+    }
+  double lookup_time = stopwatch.stop();
+  long num_lookups = 2L * HASH_LOOKUP_REPEATS * num_pairs;
+  if(num_found != num_lookups)
+    throw Hermes::Exceptions::Exception("The hash benchmark found %ld of %ld nodes.", num_found, num_lookups);
+
+  BenchmarkHashTable table_copy;
+  stopwatch.start();
+  table_copy.copy(&table);
+  double copy_time = stopwatch.stop();
+
+  report.begin_benchmark("hash", settings);
+  report.value("nodes", (long)table.get_num_nodes());
+  report.value("insert_time", insert_time);
+  report.value("inserts_per_s", 2 * num_pairs / std::max(insert_time, 1e-9));
+  report.value("lookup_time", lookup_time);
+  report.value("lookups_per_s", num_lookups / std::max(lookup_time, 1e-9));
+  report.value("copy_time", copy_time);
+  report.end_benchmark();
+}
+
+int main(int argc, char* argv[])
+{
+  BenchmarkSettings settings;
+  settings.refinements = 6;
+  settings.p = 2;
+  settings.adapt_steps = 5;
+  settings.max_threads = omp_get_max_threads();
+  const char* output_file_name = NULL;
+  const char* baselines_dir = NULL;
+  std::string machine = "default";
+#ifndef WIN32
+  char host_name[256];
+  if(gethostname(host_name, sizeof(host_name)) == 0)
+  {
+    host_name[sizeof(host_name) - 1] = '\0';
+    machine = host_name;
+  }
+#endif
+  double tolerances[METRIC_THROUGHPUT + 1] = { 0.0, 0.0, 0.1, 0.1, 0.1 };
+  std::vector<std::string> benchmarks;
+
+  for(int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    bool has_value = (i + 1 < argc);
+    if(arg == "--refinements" && has_value)
+      settings.refinements = atoi(argv[++i]);
+    else if(arg == "--p" && has_value)
+      settings.p = atoi(argv[++i]);
+    else if(arg == "--threads" && has_value)
+      Hermes2DApi.set_integral_param_value(Hermes::Hermes2D::numThreads, atoi(argv[++i]));
+    else if(arg == "--adapt-steps" && has_value)
+      settings.adapt_steps = atoi(argv[++i]);
+    else if(arg == "--max-threads" && has_value)
+      settings.max_threads = std::max(atoi(argv[++i]), 1);
+    else if(arg == "--output" && has_value)
+      output_file_name = argv[++i];
+    else if(arg == "--machine" && has_value)
+      machine = argv[++i];
+    else if(arg == "--baselines" && has_value)
+      baselines_dir = argv[++i];
+    else if(arg == "--tolerance" && has_value && strchr(argv[i + 1], '=') != NULL)
+    {
+      std::string tolerance = argv[++i];
+      std::string kind = tolerance.substr(0, tolerance.find('='));
+      double value = atof(tolerance.c_str() + tolerance.find('=') + 1);
+      if(kind == "time")
+        tolerances[METRIC_TIME] = value;
+      else if(kind == "memory")
+        tolerances[METRIC_MEMORY] = value;
+      else if(kind == "throughput")
+        tolerances[METRIC_THROUGHPUT] = value;
+      else
+      {
+        fprintf(stderr, "Unknown kind of the metrics: %s.\n", kind.c_str());
+        return 1;
+      }
+    }
+    else if(arg == "startup" || arg == "poisson" || arg == "poisson-newton" || arg == "dg-advection" || arg == "adapt" || arg == "kernels" || arg == "scaling" || arg == "hash")
+      benchmarks.push_back(arg);
+    else
+    {
+      fprintf(stderr, "Usage: %s [--refinements N] [--p P] [--threads T] [--adapt-steps S] [--max-threads M] [--output FILE] [--machine TAG] [--baselines DIR] [--tolerance KIND=T] [startup] [poisson] [poisson-newton] [dg-advection] [adapt] [kernels] [scaling] [hash]\n", argv[0]);
+      return 1;
+    }
+  }
+  if(benchmarks.empty())
+  {
+    benchmarks.push_back("startup");
+    benchmarks.push_back("poisson");
+    benchmarks.push_back("poisson-newton");
+    benchmarks.push_back("dg-advection");
+    benchmarks.push_back("adapt");
+    benchmarks.push_back("kernels");
+    benchmarks.push_back("scaling");
+    benchmarks.push_back("hash");
+  }
+
+  // Read before the output is opened, it may be the baseline itself.
+  Results baseline;
+  std::string baseline_file_name = baselines_dir == NULL ? "" : std::string(baselines_dir) + "/" + machine + ".json";
+  if(baselines_dir != NULL && !load_results(baseline_file_name.c_str(), baseline))
+  {
+    fprintf(stderr, "Could not read the baseline %s.\n", baseline_file_name.c_str());
+    return 1;
+  }
+
+  FILE* out = stdout;
+  if(output_file_name != NULL && (out = fopen(output_file_name, "w")) == NULL)
+  {
+    fprintf(stderr, "Could not open %s.\n", output_file_name);
+    return 1;
+  }
+
+  JsonReport report(out);
+  report.begin(Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads), machine.c_str());
+  int result = 0;
+  try
+  {
+    for(unsigned int i = 0; i < benchmarks.size(); i++)
+    {
+      if(benchmarks[i] == "startup")
+        benchmark_startup(settings, report);
+      else if(benchmarks[i] == "poisson")
+        benchmark_poisson(settings, report);
+      else if(benchmarks[i] == "poisson-newton")
+        benchmark_poisson_newton(settings, report);
+      else if(benchmarks[i] == "dg-advection")
+        benchmark_dg_advection(settings, report);
+      else if(benchmarks[i] == "adapt")
+        benchmark_adapt(settings, report);
+      else if(benchmarks[i] == "kernels")
+        benchmark_kernels(settings, report);
+      else if(benchmarks[i] == "scaling")
+        benchmark_scaling(settings, report);
+      else
+        benchmark_hash(settings, report);
+    }
+  }
+  catch(std::exception& e)
+  {
+    fprintf(stderr, "%s\n", e.what());
+    result = 1;
+  }
+  report.end();
+
+  if(out != stdout)
+    fclose(out);
+
+  if(result == 0 && baselines_dir != NULL && compare_results(report.get_results(), baseline, tolerances) > 0)
+    result = 2;
+  return result;
+}
@@ -24,6 +24,7 @@
 #include "../integrals/hdiv.h"
 #include "../integrals/l2.h"
 #include "../mesh/element_to_refine.h"
+#include "../mesh/traverse.h"
 #include "../refinement_selectors/selector.h"
 #include "exceptions.h"
 #include "../global.h"
@@ -48,6 +49,61 @@ namespace Hermes
 
     template<typename Scalar> class Global;
 
+    /// The (squared) errors of the active elements of a mesh. \ingroup g_adapt
+    /** The errors are stored densely over the active elements, found through a map from the element ids, so that meshes with
+    *  many inactive elements (the maximum element id much larger than the number of the active ones) do not waste memory.
+    *  The values can be stored in single precision, see Adapt::set_single_precision_errors(). */
+    class HERMES_API ElementErrors
+    {
+    public:
+      ElementErrors();
+      ~ElementErrors();
+
+      /// Allocates zero errors of the active elements of the mesh (and frees the previous ones).
+      void init(const Mesh* mesh, bool single_precision = false);
+      void free();
+
+      /// The errors have been allocated.
+      inline bool is_initialized() const { return index != NULL; }
+
+      /// The element of the id has an error (it was active in init()).
+      inline bool contains(int id) const { return index != NULL && id >= 0 && id < index_size && index[id] >= 0; }
+
+      /// The error of the element of the id, it has to be contained.
+      inline double get(int id) const { return single_precision ? (double)values_float[index[id]] : values[index[id]]; }
+      inline void set(int id, double value)
+      {
+        if(single_precision)
+          values_float[index[id]] = (float)value;
+        else
+          values[index[id]] = value;
+      }
+      inline void add(int id, double value)
+      {
+        if(single_precision)
+          values_float[index[id]] += (float)value;
+        else
+          values[index[id]] += value;
+      }
+
+      /// Exchanges the errors with other ones.
+      void swap(ElementErrors& other);
+
+      /// The memory taken by the errors (in bytes).
+      size_t get_memory_size() const;
+
+    private:
+      ElementErrors(const ElementErrors&);
+      ElementErrors& operator=(const ElementErrors&);
+
+      int* index;           ///< The index of the value of the element of an id, -1 for inactive elements.
+      int index_size;       ///< The number of the ids.
+      int count;            ///< The number of the active elements.
+      bool single_precision;
+      double* values;
+      float* values_float;
+    };
+
     /// Evaluation of an error between a (coarse) solution and a reference solution and adaptivity. \ingroup g_adapt
     /** The class provides basic functionality necessary to adaptively refine elements.
     *  Given a reference solution and a coarse solution, it calculates error estimates
@@ -127,6 +183,9 @@ namespace Hermes
       void set_norm_form(int i, int j, MatrixFormVolError* form);
       void set_norm_form(MatrixFormVolError* form);   ///< i = j = 0
 
+      /// Stores the errors of the elements in single precision (half the memory), from the next calculation of the errors on.
+      void set_single_precision_errors(bool single_precision = true);
+
       /// Type-safe version of calc_err_est() for one solution.
       /// @param[in] solutions_for_adapt - if sln and rsln are the solutions error of which is used in the function adapt().
       double calc_err_est(Solution<Scalar>*sln, Solution<Scalar>*rsln, bool solutions_for_adapt = true,
@@ -175,15 +234,46 @@ namespace Hermes
       bool adapt(RefinementSelectors::Selector<Scalar>* refinement_selector, double thr, int strat = 0,
         int regularize = -1, double to_be_processed = 0.0);
 
+      /// Coarsens the meshes and the orders based on results from calc_err_est(), the counterpart of adapt() for transient problems.
+      /**
+      *  The sons of a refined element are merged back if all of them are active, they are not a part of the initial mesh and the sum
+      *  of their squared errors is below thr times the largest squared error of an element (the threshold of the strategy 1 of adapt()),
+      *  for every component on the mesh. The merged element gets the largest order of the sons. Every element is merged at most once, i.e.
+      *  the meshes are coarsened by one level per call.
+      *  If p_coarsening is set, the order of the active elements not merged whose squared error is below the same threshold is decreased by one.
+      *  The errors are invalid after the coarsening, calc_err_est() has to be called before the next adapt().
+      *  \param[in] thr The threshold relative to the largest squared error of an element.
+      *  \param[in] p_coarsening Decrease also the orders of the elements with a small error.
+      *  \return The number of merged elements and elements with a decreased order. */
+      int coarsen(double thr, bool p_coarsening = true);
+
       /// Returns a squared error of an element.
       /** \param[in] A component index.
       *  \param[in] An element index.
       *  \return Squared error. Meaning of the error depends on parameters of the function calc_errors_internal(). */
       double get_element_error_squared(int component, int id) const;
+
+      /// The phases of the adaptivity timed by the profile (see get_profile()).
+      enum ProfilePhase
+      {
+        /// Calculation of the errors (calc_err_est(), calc_err_exact()).
+        PROFILE_ERROR_EVALUATION,
+        /// Selection of the refinements of the elements (by the selectors, per thread).
+        PROFILE_CANDIDATE_SELECTION,
+        /// Application of the refinements, regularization and the assignment of the DOFs.
+        PROFILE_REFINEMENT,
+        PROFILE_NUM_PHASES
+      };
+
+      /// The per-phase timing (per thread, see Hermes::Mixins::Profile), disabled by default.
+      Hermes::Mixins::Profile* get_profile();
     protected:
 
       Exceptions::Exception* caughtException;
 
+      /// States of the traversal of the coarse and reference meshes, shared by the error calculations on the same meshes.
+      TraverseStateList traverse_states;
+
       /// A reference to an element.
       struct ElementReference {
         int id; ///< An element ID. Invalid if below 0.
@@ -192,7 +282,8 @@ namespace Hermes
       };
 
       /// Returns regular queue of elements
-      /** \return A regular queue. */
+      /** Only the leading part of the queue that adapt() examined is sorted by the error, see fill_regular_queue().
+      *  \return A regular queue. */
       const Hermes::vector<ElementReference>& get_regular_queue() const;
 
       /// Apply a single refinement.
@@ -200,7 +291,11 @@ namespace Hermes
       void apply_refinement(const ElementToRefine& elem_ref);
 
       /// Apply a vector of refinements.
-      /** \param[in] A vector of refinements to apply. */
+      /** The refinements are grouped by the mesh they refine (components sharing a mesh form one group) and the groups
+      *  are applied concurrently, each of them in its original order. The meshes and their node tables are independent,
+      *  the refinements of one mesh are thus applied serially. If only one mesh is refined or some of the refined elements
+      *  are curved (the curvilinear maps of the sons are calculated using shared static data), all refinements are applied serially.
+      *  \param[in] A vector of refinements to apply. */
       virtual void apply_refinements(std::vector<ElementToRefine>& elems_to_refine);
 
       /// Returns a vector of refinements generated during the last execution of the method adapt().
@@ -209,6 +304,7 @@ namespace Hermes
 
       std::queue<ElementReference> priority_queue; ///< A queue of priority elements. Elements in this queue are processed before the elements in the Adapt::regular_queue.
       Hermes::vector<ElementReference> regular_queue; ///< A queue of elements which should be processes. The queue had to be filled by the method fill_regular_queue().
+      int regular_queue_sorted; ///< A number of leading elements of Adapt::regular_queue that are in their final order, -1 if the order given by fill_regular_queue() is kept.
       std::vector<ElementToRefine> last_refinements; ///< A vector of refinements generated during the last finished execution of the method adapt().
 
       /// Fixes refinements of a mesh which is shared among multiple components of a multimesh.
@@ -234,8 +330,11 @@ namespace Hermes
       bool have_coarse_solutions;           ///< True if the coarse solutions were set.
       bool have_reference_solutions;        ///< True if the reference solutions were set.
 
-      double* errors[H2D_MAX_COMPONENTS];   ///< Errors of elements. Meaning of the error depeds on flags used when the
+      Hermes::Mixins::Profile profile;      ///< See get_profile().
+
+      ElementErrors errors[H2D_MAX_COMPONENTS];   ///< Errors of elements. Meaning of the error depeds on flags used when the
       ///< method calc_errors_internal() was calls. Initialized in the method calc_errors_internal().
+      bool single_precision_errors;         ///< See set_single_precision_errors().
       double  errors_squared_sum;           ///< Sum of errors in the array Adapt::errors_squared. Used by a method adapt() in some strategies.
 
       double error_time;                    ///< Time needed to calculate the error.
@@ -286,22 +385,42 @@ namespace Hermes
       virtual double eval_error_norm(MatrixFormVolError* form,
         MeshFunction<Scalar>*rsln1, MeshFunction<Scalar>*rsln2);
 
+      /// Evaluates the squares of the errors (as eval_error()) and of the norms (as eval_error_norm()) of all pairs of components
+      /// on the active element of the current traversal state at once, this is what calc_err_internal() calls.
+      /** The values of the solutions and of the reference solutions, and the geometry, are calculated once per element for all the
+      *  error and norm forms, in the largest integration order of the forms.
+      *  \param[in] slns The (coarse) solutions of the components.
+      *  \param[in] rslns The reference solutions of the components.
+      *  \param[out] errors_out The squared errors, errors_out[i * num + j] for the pair i, j (only the pairs with an error form are set).
+      *  \param[out] norms_out The squared norms, in the same layout. */
+      virtual void eval_errors_and_norms(MeshFunction<Scalar>** slns, MeshFunction<Scalar>** rslns, double* errors_out, double* norms_out);
+
+      /// The integration order of the form on the active element (as used by eval_error() and eval_error_norm()).
+      int calc_error_form_order(MatrixFormVolError* form, MeshFunction<Scalar>* rsln1, MeshFunction<Scalar>* rsln2);
+
       /// Builds an ordered queue of elements that are be examined.
-      /** The method fills Adapt::standard_queue by elements sorted accordin to their error descending.
+      /** The method fills Adapt::regular_queue by all active elements and sets Adapt::regular_queue_sorted to zero,
+      *  the elements are then ordered according to their error descending by sort_regular_queue(), only as far as adapt() examines them.
       *  The method assumes that Adapt::errors_squared contains valid values.
-      *  If a special order of elements is requested, this method has to be overridden.
+      *  If a special order of elements is requested, this method has to be overridden, the order it gives is then kept.
       *  /param[in] meshes An array of pointers to meshes of a (coarse) solution. An index into the array is an index of a component.
       *  /param[in] meshes An array of pointers to meshes of a reference solution. An index into the array is an index of a component. */
       virtual void fill_regular_queue(const Mesh** meshes);
 
+      /// Orders the first count elements of Adapt::regular_queue according to their error descending.
+      /** The elements are selected (std::nth_element) from the not yet sorted rest of the queue and only the selected ones are sorted,
+      *  the cost is thus linear in the number of the active elements instead of the n log n of the full sort.
+      *  Does nothing if Adapt::regular_queue_sorted is -1 or at least count. */
+      void sort_regular_queue(int count);
+
     private:
       /// A functor that compares elements accoring to their error. Used by std::sort().
       class CompareElements
       {
       private:
-        double** errors; ///< A 2D array of squared errors: the first index is an index of component, the second index is an element ID.
+        const ElementErrors* errors; ///< The squared errors of the components.
       public:
-        CompareElements(double** errors); ///< Constructor.
+        CompareElements(const ElementErrors* errors); ///< Constructor.
         /// Compares two elements.
         /** \param[in] e1 A reference to the first element.
         *  \param[in] e1 A reference to the second element.
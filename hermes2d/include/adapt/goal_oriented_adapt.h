@@ -0,0 +1,70 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef GOAL_ORIENTED_ADAPT_H
+#define GOAL_ORIENTED_ADAPT_H
+
+#include "adapt.h"
+#include "../discrete_problem.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    /// \brief Goal-oriented adaptivity, the elements are refined according to their contribution to the error of a quantity of interest.
+    ///
+    /// The quantity of interest is a linear functional J(v) given by the vector forms of a weak formulation. The adjoint (dual) problem
+    /// a(v, z) = J(v) is solved on the reference spaces by solve_adjoint(), with the factorization of the matrix of the primal problem
+    /// (LinearMatrixSolver::solve_transposed()), so that an adaptivity step costs one back-solve more than the energy norm adaptivity.
+    /// The error of the element K is then estimated by the weighted product ||e||_K ||e*||_K of the errors of the primal and the adjoint
+    /// coarse solutions measured as in Adapt (by the error forms), which bounds the contribution of K to |J(u) - J(u_h)|.
+    ///
+    /// Typical usage (per adaptivity step, the primal problem solved on the reference space by linear_solver):<br>
+    /// GoalOrientedAdapt<double>::solve_adjoint(linear_solver.get_linear_matrix_solver(), &goal_wf, ref_space, &adjoint_ref_sln);<br>
+    /// ogProjection.project_global(&space, &adjoint_ref_sln, &adjoint_sln);<br>
+    /// GoalOrientedAdapt<double> adaptivity(&space);<br>
+    /// double goal_err_est = adaptivity.calc_err_est(&sln, &ref_sln, &adjoint_sln, &adjoint_ref_sln);<br>
+    /// adaptivity.adapt(&selector, THRESHOLD, STRATEGY);<br>
+    ///
+    /// The candidates of the refinements are still selected by the projections of the primal reference solution.
+    template<typename Scalar>
+    class HERMES_API GoalOrientedAdapt : public Adapt<Scalar>
+    {
+    public:
+      GoalOrientedAdapt(Hermes::vector<Space<Scalar>*> spaces, Hermes::vector<ProjNormType> proj_norms = Hermes::vector<ProjNormType>());
+      GoalOrientedAdapt(Space<Scalar>* space, ProjNormType proj_norm = HERMES_UNSET_NORM);
+
+      /// Solves the adjoint problem on the reference spaces, the right-hand side is the goal functional assembled from the vector forms of goal_wf.
+      /// @param[in] primal_solver The solver of the primal problem on the reference spaces after its (last) solve, e.g. LinearSolver::get_linear_matrix_solver().
+      /// For nonlinear problems, the factorization of the last Newton iteration is used.
+      /// @param[out] adjoint_rslns The adjoint reference solutions, with zero Dirichlet conditions.
+      static void solve_adjoint(LinearMatrixSolver<Scalar>* primal_solver, const WeakForm<Scalar>* goal_wf,
+        Hermes::vector<const Space<Scalar>*> ref_spaces, Hermes::vector<Solution<Scalar>*> adjoint_rslns);
+      /// One Space version.
+      static void solve_adjoint(LinearMatrixSolver<Scalar>* primal_solver, const WeakForm<Scalar>* goal_wf,
+        const Space<Scalar>* ref_space, Solution<Scalar>* adjoint_rsln);
+
+      /// Calculates the goal-oriented errors of the elements for adapt().
+      /// The coarse adjoint solutions (usually the projections of the adjoint reference solutions onto the spaces) have to be on the meshes
+      /// of the coarse primal solutions.
+      /// \return The estimate sum_K ||e||_K ||e*||_K of the error of the goal functional.
+      double calc_err_est(Hermes::vector<Solution<Scalar>*> slns, Hermes::vector<Solution<Scalar>*> rslns,
+        Hermes::vector<Solution<Scalar>*> adjoint_slns, Hermes::vector<Solution<Scalar>*> adjoint_rslns);
+      /// One Space version.
+      double calc_err_est(Solution<Scalar>* sln, Solution<Scalar>* rsln, Solution<Scalar>* adjoint_sln, Solution<Scalar>* adjoint_rsln);
+    };
+  }
+}
+
+#endif
@@ -0,0 +1,85 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef HIERARCHICAL_ESTIMATOR_H
+#define HIERARCHICAL_ESTIMATOR_H
+
+#include "adapt.h"
+#include "../discrete_problem.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    /// \brief Reference solutions for Adapt calculated by local problems in the hierarchical enrichment of the coarse spaces.
+    ///
+    /// The enriched spaces are the coarse spaces with the polynomial orders increased by order_increase on the same meshes.
+    /// The shapesets are hierarchical, so the coarse solution is a function of the enriched spaces: its coefficients are copied
+    /// to the enriched DOFs with the same shape functions, and only the new DOFs (the higher edge and bubble functions) are calculated.
+    /// The system of the enriched spaces is assembled, but instead of its global solve, the residual of the coarse solution is
+    /// solved on every element for the new DOFs of the element (a dense local problem, the elements in parallel), and the corrections
+    /// of the DOFs shared by several elements (on their edges) are averaged.
+    ///
+    /// The result is a reference solution on the coarse meshes for Adapt::calc_err_est() and the selectors, which accept the reference
+    /// solutions on the coarse elements (the candidates are projections of it, see RefinementSelectors::ProjBasedSelector).
+    ///
+    /// Typical usage (per adaptivity step):<br>
+    /// HierarchicalEstimator<double> estimator(&wf, &space);<br>
+    /// estimator.calculate(linear_solver.get_sln_vector(), &ref_sln);<br>
+    /// Adapt<double> adaptivity(&space);<br>
+    /// adaptivity.calc_err_est(&sln, &ref_sln);<br>
+    /// adaptivity.adapt(&selector, THRESHOLD, STRATEGY);<br>
+    template<typename Scalar>
+    class HERMES_API HierarchicalEstimator : public Hermes::Mixins::Loggable, public Hermes::Mixins::TimeMeasurable
+    {
+    public:
+      /// @param[in] linear The weak formulation is the one of a linear problem (DiscreteProblemLinear: the vector forms are the right-hand side),
+      /// otherwise of a nonlinear one (DiscreteProblem: the Jacobian and the residual).
+      HierarchicalEstimator(const WeakForm<Scalar>* wf, Hermes::vector<Space<Scalar>*> coarse_spaces, bool linear = true, unsigned int order_increase = 1);
+      HierarchicalEstimator(const WeakForm<Scalar>* wf, Space<Scalar>* coarse_space, bool linear = true, unsigned int order_increase = 1);
+      virtual ~HierarchicalEstimator();
+
+      /// Calculates the reference solutions.
+      /// @param[in] coarse_coeff_vec The coefficients of the coarse solution (in the DOFs of the coarse spaces).
+      /// @param[out] ref_slns The reference solutions on the enriched spaces.
+      void calculate(const Scalar* coarse_coeff_vec, Hermes::vector<Solution<Scalar>*> ref_slns);
+      /// One Space version.
+      void calculate(const Scalar* coarse_coeff_vec, Solution<Scalar>* ref_sln);
+
+      /// The enriched spaces of the last calculate(), valid until the next one.
+      Hermes::vector<Space<Scalar>*> get_enriched_spaces() const;
+
+    protected:
+      /// Creates the enriched spaces, deletes the previous ones.
+      void create_enriched_spaces();
+      void free_enriched_spaces();
+
+      /// Copies the coefficients of the coarse functions into the enriched DOFs of the same shape functions.
+      /// @param[out] known The enriched DOFs given by the coarse solution.
+      void prolong(const Scalar* coarse_coeff_vec, Scalar* coeff_vec, bool* known);
+
+      /// Solves the dense system (overwritten) by the Gaussian elimination with partial pivoting.
+      /// \return false if the matrix is singular.
+      static bool solve_dense(Scalar* matrix, Scalar* rhs, int n);
+
+      const WeakForm<Scalar>* wf;
+      Hermes::vector<Space<Scalar>*> coarse_spaces;
+      Hermes::vector<Space<Scalar>*> enriched_spaces;
+      bool linear;
+      unsigned int order_increase;
+    };
+  }
+}
+
+#endif
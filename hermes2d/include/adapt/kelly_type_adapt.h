@@ -127,12 +127,16 @@ namespace Hermes
       ///
       /// Functions used for evaluating the actual error estimator forms for an active element or edge segment.
       ///
+      /// The solutions of all the components are passed in slns (the copies used by the current thread).
       double eval_volumetric_estimator(typename KellyTypeAdapt::ErrorEstimatorForm* err_est_form,
+                                       MeshFunction<Scalar>** slns,
                                        RefMap* rm);
       double eval_boundary_estimator(typename KellyTypeAdapt::ErrorEstimatorForm* err_est_form,
+                                     MeshFunction<Scalar>** slns,
                                      RefMap* rm,
                                      SurfPos* surf_pos);
       double eval_interface_estimator(typename KellyTypeAdapt::ErrorEstimatorForm* err_est_form,
+                                      MeshFunction<Scalar>** slns,
                                       RefMap *rm,
                                       SurfPos* surf_pos,
                                       LightArray<NeighborSearch<Scalar>*>& neighbor_searches,
@@ -39,7 +39,52 @@ namespace Hermes
     {
       numThreads,
 			xmlSchemasDirPath,
-			precalculatedFormsDirPath
+			precalculatedFormsDirPath,
+      assemblingMode,
+      /// Limit (in MB) of the memory held by the assembling cache of one DiscreteProblem, 0 means no limit.
+      /// The least recently used elements are evicted from the cache whenever an assembling ends above the limit.
+      cacheSizeLimit,
+      /// Limit (in MB) of the memory held by the precalculated shape function values of one PrecalcShapeset, 0 means no limit.
+      /// The least recently used tables are evicted whenever a new one is precalculated above the limit.
+      precalcCacheSizeLimit,
+      /// Limit (in MB) of the memory held by the assembling cache during an assembling, 0 means no limit (the default).
+      /// When set, the states are assembled in chunks of H2D_ASSEMBLING_CHUNK_STATES consecutive states (spatially coherent
+      /// for meshes ordered by Mesh::reorder_space_filling_curve()) and the cache is trimmed to the limit after every chunk.
+      /// With an ElementMatrixStore as the matrix, its buffered local matrices are written out after every chunk as well.
+      assemblingMemoryLimit,
+      /// Nonzero: the XML files (meshes, spaces, solutions) are trusted and never validated against their schemas,
+      /// whatever the setting of the loading objects (Mixins::XMLParsing::set_validation()) is. Default 0.
+      xmlTrustedInput,
+      /// Nonzero: the trace events (Hermes::Mixins::Trace) of the assembling (states, cache misses, phases),
+      /// of the adaptivity and of the solvers are recorded. Default 0. The same as Trace::set_enabled().
+      traceEvents,
+      /// A file name (text parameter, empty by default): the recorded trace events are written into it
+      /// in the Chrome trace format when Hermes2DApi is destroyed (at the exit of the program).
+      traceFile,
+      /// Nonzero: the large arrays of the matrices and vectors (Hermes::parallelFirstTouch of HermesCommonApi, set by this one)
+      /// and the thread-private values of the assembling are zeroed by the threads using them, so that on NUMA machines
+      /// they are placed in the memory of the socket of the thread. Default 0.
+      numaFirstTouch,
+      /// Nonzero: the numThreads OpenMP threads are pinned to the processors 0, 1, ... (modulo their number), when this or numThreads
+      /// is set, so that the threads keep the memory they touched first local. Only on Linux, elsewhere the threads are left
+      /// to OMP_PROC_BIND / OMP_PLACES. Default 0.
+      threadPinning
+    };
+
+    /// Possible values of the parameter Hermes2DApiParam::assemblingMode.
+    /// Determine how the threads insert local contributions into the global matrix and vector.
+    enum AssemblingMode
+    {
+      /// The states are distributed among the threads arbitrarily,
+      /// concurrent insertion is left to the matrix / vector implementation.
+      H2D_ASSEMBLING_DEFAULT = 0,
+      /// The states are split into colors such that no two states of one color share a DOF,
+      /// the states of one color are then assembled in parallel without any conflicts in the insertion.
+      H2D_ASSEMBLING_COLORED = 1,
+      /// Every thread assembles into its own copy of the matrix values and of the right-hand side,
+      /// these are summed up in parallel after all states are processed.
+      /// The matrix copies are used for CSC matrices (UMFPACK) only, other matrices are inserted into directly.
+      H2D_ASSEMBLING_THREAD_LOCAL = 2
     };
 
     /// API Class containing settings for the whole Hermes2D.
@@ -75,7 +120,13 @@ namespace Hermes
 
 			void set_integral_param_value(Hermes2DApiParam, int value);
 			void set_text_param_value(Hermes2DApiParam, std::string value);
+
+      /// Initializes Xerces (for the whole process) before the first reading or writing of an XML file.
+      /// Done on demand rather than in the constructor, as the initialization is a noticeable part of the startup
+      /// of the programs that never touch XML. Thread-safe.
+      void initialize_xml();
 		private:
+      bool xml_initialized;
 
 			friend class Mesh;
 			friend class MeshReaderH2DXML;
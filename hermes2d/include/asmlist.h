@@ -43,6 +43,9 @@ namespace Hermes
       int* get_dof();
       unsigned int get_cnt();
       Scalar* get_coef();
+
+      /// True if the list carries the constraint operator (the lists of the elements with hanging nodes, see shape_pos).
+      bool has_constraint_operator() const;
     private:
       /// Copy constructor.
       AsmList(const AsmList<Scalar> & other);
@@ -53,6 +56,23 @@ namespace Hermes
       unsigned int cnt;       ///< the number of items in the arrays idx, dof and coef
       unsigned int cap;       ///< internal
 
+      /// The constraint operator of a list of an element with hanging nodes, set by Space::get_element_assembly_list():
+      /// the entry i is the coefficient coef[i] of the shape function idx[shape_entry[shape_pos[i]]] in the DOF reduced_dof[dof_pos[i]],
+      /// so that the local matrices can be calculated on the num_shapes distinct (unconstrained) shape functions
+      /// and inserted on the num_reduced_dofs distinct DOFs. dof_pos[i] is -1 for the entries with negative DOFs.
+      /// The positions are numbered in the order of the first occurrence. num_shapes is 0 for the other lists.
+      int* shape_pos;
+      int* dof_pos;
+      int* shape_entry; ///< the first entry of every distinct shape function
+      int* reduced_dof;
+      unsigned int num_shapes;
+      unsigned int num_reduced_dofs;
+      unsigned int operator_cap; ///< internal
+
+      /// Internal. Makes room for the constraint operator of size entries.
+      void enlarge_operator(unsigned int size);
+      void free_operator();
+
       /// Adds a record for one basis function (shape functions index, basis functions index, coefficient).
       void add_triplet(int i, int d, Scalar c);
 
@@ -67,6 +87,7 @@ namespace Hermes
       template<typename T> friend class L2Space;
       template<typename T> friend class HcurlSpace;
       template<typename T> friend class HdivSpace;
+      template<typename T> friend class StaticCondensation;
     };
   }
 }
@@ -0,0 +1,64 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef __H2D_BINARY_FILE_H
+#define __H2D_BINARY_FILE_H
+
+#include "global.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    /// \brief Reading and writing of the binary formats of Solution and Space (see Solution::save_binary(), Space::save_binary()).
+    ///
+    /// A binary file is a fixed header starting with an 8-character magic followed by raw arrays ("sections"),
+    /// every section padded to a multiple of 8 bytes so that the doubles of a mapped file are aligned.
+    /// The data is stored in the byte order of the machine that saved the file (see H2D_BINARY_FILE_BYTE_ORDER).
+    /// Reading maps the whole file into memory (mmap where available, otherwise it is read at once).
+    class HERMES_API BinaryFile
+    {
+    public:
+      /// Maps the file for reading.
+      BinaryFile(const char* filename);
+      ~BinaryFile();
+
+      /// Returns the next section of the given size, throws if the file is too short.
+      const char* next_section(size_t size);
+
+      /// True if the file exists and starts with the given magic (8 characters).
+      static bool has_magic(const char* filename, const char* magic);
+
+      /// Writes a section (padded to 8 bytes) to f.
+      static void write(FILE* f, const void* data, size_t size);
+
+      /// Flushes a written (and closed) file to the disk (fsync, _commit with MSVC).
+      static void sync(const char* filename);
+
+    protected:
+      std::string filename;
+      char* data;
+      size_t size;
+      size_t offset;
+      /// The data is mapped (not allocated).
+      bool mapped;
+    };
+
+    /// The byte order stamp of the binary files.
+    static const int H2D_BINARY_FILE_BYTE_ORDER = 0x01020304;
+  }
+}
+
+#endif
@@ -19,6 +19,8 @@
 /*! \file calculation_CalculationContinuity.h
 \brief Calculation CalculationContinuity functionality.
 */
+#ifndef __H2D_CALCULATION_CONTINUITY_H
+#define __H2D_CALCULATION_CONTINUITY_H
 
 #include "config.h"
 #include "compat.h"
@@ -61,6 +63,11 @@ namespace Hermes
 
     /// Class used for resuming an interrupted calculation.
     /// Its purpose is to store everything necessary to resume it from a certain point.
+    ///
+    /// A record is committed by its line in the index file (e.g. "timeAndNumber.h2d"), appended after all the files
+    /// of the record are written, so that an interrupted write leaves the previous record the last one.
+    /// See set_binary() for the incremental binary records, and OutputQueue with ContinuityOutputWriter for adding
+    /// the records in a background thread.
     template<typename Scalar>
     class HERMES_API CalculationContinuity
     {
@@ -141,6 +148,19 @@ namespace Hermes
         unsigned int get_number();
 
       private:
+        /// Reads the manifest of a binary record (see set_binary()), returns false if there is none (an XML record).
+        bool read_manifest();
+
+        /// The name of the file i of a kind: the one listed in the manifest, or the name of the XML record.
+        std::string get_file_name(const std::string& base_name, unsigned int i, const Hermes::vector<std::string>& manifest_files);
+
+        /// The name of the manifest of the binary record.
+        std::string get_manifest_file_name() const;
+
+        /// The manifest: -1 not read yet, 0 none, 1 read (or written).
+        int manifest_state;
+        double manifest_time_step, manifest_time_step_n_minus_one, manifest_error;
+
         /// Storage of filenames of needed mesh files.
         Hermes::vector<std::string> meshFiles;
         /// Storage of filenames of needed space files.
@@ -151,6 +171,8 @@ namespace Hermes
         /// Internals. Used for identifying.
         double time;
         unsigned int number;
+
+        friend class CalculationContinuity;
       };
 
       /// Add a record.
@@ -184,8 +206,38 @@ namespace Hermes
       static void set_solution_file_name(std::string solution_file_nameToSet);
       static void set_time_step_file_name(std::string time_step_file_nameToSet);
       static void set_error_file_name(std::string error_file_nameToSet);
+      static void set_record_file_name(std::string record_file_nameToSet);
+
+      /// Saves the following records in the binary formats (MeshReaderH2DBinary, Space::save_binary(), Solution::save_binary())
+      /// instead of XML, incrementally: a mesh or a space unchanged since the previous record of this instance (the same object
+      /// with the same seq) is not written again, the record refers to the file of the earlier one. The file names, the time steps
+      /// and the error of a record are in its manifest (file record_file_name with the time and the number). The files of
+      /// a record, its manifest and the index file are synced to the disk (fsync) before the record is committed.
+      /// The loading methods of the records recognize both formats.
+      void set_binary(bool binary = true);
 
     private:
+      /// Saves the entities of the record, in the XML or the binary format.
+      void save_record(Record* record, Hermes::vector<Mesh*> meshes, Hermes::vector<Space<Scalar>*> spaces, Hermes::vector<Solution<Scalar>*> slns,
+        double time_step, double time_step_n_minus_one, double error);
+
+      /// Appends the line of the record to the index file (and syncs it in the binary mode).
+      void commit(const char* index_file_name, const std::string& line);
+
+      /// In the binary mode, the mesh or space last written at an index, with its seq numbers and file name.
+      struct SavedFile
+      {
+        const void* object;
+        int seq;
+        unsigned int mesh_seq;
+        std::string file_name;
+      };
+      Hermes::vector<SavedFile> saved_meshes;
+      Hermes::vector<SavedFile> saved_spaces;
+
+      /// See set_binary().
+      bool binary;
+
       /// Names for the file stored.
       static std::string mesh_file_name;
       static std::string space_file_name;
@@ -193,6 +245,7 @@ namespace Hermes
       static std::string time_step_file_name;
       static std::string time_stepNMinusOne_file_name;
       static std::string error_file_name;
+      static std::string record_file_name;
 
       /// For time dependent adaptive problems.
       std::map<std::pair<double, unsigned int>, Record*> records;
@@ -218,4 +271,5 @@ namespace Hermes
       friend class Record;
     };
   }
-}
\ No newline at end of file
+}
+#endif
@@ -32,13 +32,17 @@ namespace Hermes
   namespace Hermes2D
   {
     class PrecalcShapeset;
+    class QuadTensorFactors;
+    class ReferenceIntegralTable;
+    template<typename Scalar> class ElementBatchKernel;
 
     /// @ingroup inner
     /// Multimesh neighbors traversal class.
+    /// The nodes of one tree are stored in one array, the first node being the root (see DiscreteProblem::build_multimesh_tree()).
     class NeighborNode
     {
     private:
-      NeighborNode(NeighborNode* parent, unsigned int transformation);
+      NeighborNode(NeighborNode* parent = NULL, unsigned int transformation = 0);
       ~NeighborNode();
       void set_left_son(NeighborNode* left_son);
       void set_right_son(NeighborNode* right_son);
@@ -89,12 +93,41 @@ namespace Hermes
       /// If the cache should not be used for any reason.
       inline void set_do_not_use_cache() { this->do_not_use_cache = true; }
 
+      /// Assemble only a part of the elements, for running the same problem in several (MPI) processes.
+      /// Every process keeps the whole mesh and the global numbering of the DOFs (Space::assign_dofs()), the mesh of the first space
+      /// is split by Mesh::partition() into num_ranks parts (weighted by the element orders of the spaces on it, Space::get_element_weights()),
+      /// and the process rank assembles only the elements (states of the union traversal) in its part. The contributions of all processes are then summed
+      /// in bulk (one reduction of the values of the matrix and of the right-hand side, SparseMatrix::sum_over_processes(),
+      /// Vector::sum_over_processes()), all processes assembling the same sparse structure.
+      /// @param[in] num_ranks 1 switches the partitioning off (the default).
+      /// @param[in] sum_matrix If false, the matrix is left with the local contributions, e.g. for the non-replicated
+      /// distributed input of MumpsSolver (MumpsSolver::set_distributed_input()), which sums them itself. The right-hand side is always summed.
+      void set_process_partition(int rank, int num_ranks, bool sum_matrix = true);
+
+#ifdef WITH_MPI
+      /// set_process_partition() by the rank and the size of MPI_COMM_WORLD.
+      void set_mpi_partition(bool sum_matrix = true);
+#endif
+
+      /// Computes the local matrices of the volumetric forms described by MatrixFormVol::get_point_coefficients() (mass and diffusion)
+      /// on the elements with a constant reference map by the kernel, in batches of the elements with the same shape functions
+      /// (see ElementBatchKernel). The coefficients are evaluated element by element during the assembling, the local matrices
+      /// of a batch are computed once it has batch_size elements (or at the end of a group of states) and then inserted.
+      /// The forms with constant coefficients stay with the integrals over the reference element.
+      /// @param[in] kernel NULL switches the batches off (the default), the kernel is not deleted by this class.
+      void set_element_batch_kernel(ElementBatchKernel<Scalar>* kernel, int batch_size = 64);
+
       /// Get the weak forms.
       const WeakForm<Scalar>* get_weak_formulation() const;
 
       /// Set the weak forms.
       void set_weak_formulation(const WeakForm<Scalar>* wf);
 
+      /// Replaces the weak forms by ones with the same forms on the same blocks, differing only in their parameters
+      /// (e.g. the instances of ParameterSweep). Unlike set_weak_formulation(), the sparse structure and the scatter maps are kept.
+      /// If the forms are not on the same blocks, this is set_weak_formulation().
+      void replace_weak_formulation(const WeakForm<Scalar>* wf);
+
       /// Get all spaces as a Hermes::vector.
       virtual Hermes::vector<const Space<Scalar>*> get_spaces() const;
 
@@ -138,6 +171,31 @@ namespace Hermes
       void assemble(Vector<Scalar>* rhs = NULL, bool force_diagonal_blocks = false,
         Table* block_weights = NULL);
 
+      /// The phases of the assembling timed by the profile (see get_profile()).
+      enum ProfilePhase
+      {
+        /// Generation (or update) of the traversal states and their grouping.
+        PROFILE_TRAVERSAL,
+        /// Calculation of the cache records (values of the shape functions, geometry) and their lookup,
+        /// including PROFILE_ORDER_CALCULATION.
+        PROFILE_PRECALCULATION,
+        /// Calculation of the integration orders of the forms.
+        PROFILE_ORDER_CALCULATION,
+        /// Evaluation of the forms (including the addition of the vector forms to the right-hand side).
+        PROFILE_FORM_EVALUATION,
+        /// Insertion of the local matrices into the global one.
+        PROFILE_MATRIX_INSERTION,
+        /// The neighbor searches of the DG forms.
+        PROFILE_DG_NEIGHBOR_SEARCH,
+        PROFILE_NUM_PHASES
+      };
+
+      /// The per-phase timing of the assemblings (per thread, see Hermes::Mixins::Profile), disabled by default.
+      Hermes::Mixins::Profile* get_profile();
+
+      /// The approximate bytes held by the assembly cache (also reported to Hermes::MemoryAccounting).
+      size_t get_cache_memory() const;
+
       /// \ingroup Helper methods inside {calc_order_*, assemble_*}
       /// Init geometry, jacobian * weights, return the number of integration points.
       static int init_geometry_points(RefMap* reference_mapping, int order, Geom<double>*& geometry, double*& jacobian_x_weights);
@@ -148,6 +206,12 @@ namespace Hermes
 
       void deinit_assembling(PrecalcShapeset*** pss , PrecalcShapeset*** spss, RefMap*** refmaps, Solution<Scalar>*** u_ext, AsmList<Scalar>*** als, WeakForm<Scalar>** weakforms);
 
+      /// Translates the areas of all the forms of the (per-thread) weakform to the tables of the internal markers
+      /// of the meshes of the spaces, see Form::is_assembled_on(). Called on every assembling, as the meshes can change.
+      void resolve_form_markers(WeakForm<Scalar>* wf);
+      /// One form, i, j are its spaces (i == j for the vector forms).
+      void resolve_form_markers(Form<Scalar>* form, int i, int j, bool surface);
+
       /// The form will be assembled.
       bool form_to_be_assembled(MatrixForm<Scalar>* form, Traverse::State* current_state);
       bool form_to_be_assembled(MatrixFormVol<Scalar>* form, Traverse::State* current_state);
@@ -170,6 +234,66 @@ namespace Hermes
       void create_sparse_structure();
       void create_sparse_structure(SparseMatrix<Scalar>* mat, Vector<Scalar>* rhs = NULL);
 
+      /// Splits the states into groups that are assembled one after another, states within one group in parallel.
+      /// With Hermes2DApiParam::assemblingMode set to H2D_ASSEMBLING_COLORED, no two states in one group share a DOF,
+      /// and the states are reordered so that every group is a contiguous range.
+      /// \return Offsets of the groups in the array states, the last one being num_states.
+      Hermes::vector<int> group_states(Traverse::State** states, int num_states);
+
+      /// The groups of group_states(), calculated again only if the states, the DOFs or the assembling mode changed
+      /// (repeated residual assemblings in the line search of NewtonSolver thus do not color the states every time).
+      /// \param[in] states_changed The states were recalculated (see TraverseStateList::update()).
+      const Hermes::vector<int>& get_state_groups(bool states_changed);
+
+      /// With Hermes2DApiParam::assemblingMode set to H2D_ASSEMBLING_THREAD_LOCAL, allocates the thread-private values,
+      /// with H2D_ASSEMBLING_COLORED, sets colored_mat_values and colored_rhs_values.
+      void init_thread_local_assembling();
+      /// Sums up the thread-private values into current_mat, current_rhs and deallocates them.
+      void finish_thread_local_assembling();
+
+      /// Makes sure there is one assembling arena per thread.
+      void init_assembling_arenas();
+      /// The arena of the calling thread, for temporaries living while one state is assembled.
+      MemoryArena* get_assembling_arena();
+
+      /// Inserts a local matrix into current_mat (or into the thread-private values).
+      /// \param[in] positions Scatter map of the block (see get_scatter_map()), if NULL, the positions are searched for.
+      void add_to_matrix(unsigned int m, unsigned int n, Scalar **mat, int *rows, int *cols, int* positions = NULL);
+
+      /// Marks the states assembled by this process, see set_process_partition().
+      /// \param[in] states_changed The states were recalculated (see TraverseStateList::update()).
+      void init_owned_states(Traverse::State** states, int num_states, bool states_changed);
+      /// The state is assembled by this process in the phase of the assembling (0 all states, 1 the halo ones, 2 the others),
+      /// see init_overlapped_reduction().
+      inline bool is_assembled_state(Traverse::State* state, int phase) const
+      {
+        if(state_parts != NULL && state_parts[state->index] != partition_rank)
+          return false;
+        return phase == 0 || (halo_states[state->index] == (phase == 1));
+      }
+      /// Prepares the reduction of the matrix values overlapped with the assembling: the states of this process touching the DOFs
+      /// shared with the other processes (halo states) are assembled first (phase 1), the values of the matrix entries between
+      /// the shared DOFs, complete by then, are summed by a non-blocking reduction while the other states (phase 2) are assembled,
+      /// then the rest of the values is summed. Only the CSC matrices without the DG forms and the thread-local assembling, with MPI-3.
+      /// \return The two phases are to be used.
+      bool init_overlapped_reduction(Traverse::State** states, int num_states);
+      /// Starts the non-blocking reduction of the values between the shared DOFs, called by one thread after the phase 1.
+      void start_overlapped_reduction();
+      void free_overlapped_reduction();
+      /// Sums current_mat, current_rhs over the processes, see set_process_partition().
+      void sum_process_contributions();
+
+      /// Prepares the storage of scatter maps for this assembling (only for CSC matrices).
+      void init_scatter_maps(int num_states);
+      /// Deletes all the stored scatter maps.
+      void delete_scatter_maps();
+      /// Returns the positions in the matrix values of the (volumetric) block [i, j] on this state, see CSCMatrix::get_positions().
+      /// The map is calculated once and reused in subsequent assemblings as long as the sparse structure does not change.
+      /// \return NULL if scatter maps are not used.
+      int* get_scatter_map(Traverse::State* current_state, int i, int j, AsmList<Scalar>* current_als_i, AsmList<Scalar>* current_als_j);
+      /// Inserts a value into current_rhs (or into the thread-private values).
+      void add_to_rhs(unsigned int idx, Scalar value);
+
       /// Set the special handling of external functions of Runge-Kutta methods, including information how many spaces were there in the original problem.
       inline void set_RK(int original_spaces_count) { this->RungeKutta = true; RK_original_spaces_count = original_spaces_count; }
 
@@ -177,6 +301,18 @@ namespace Hermes
       /// \return if one needs to recalculate, the method calculate_cache_records is called.
       bool state_needs_recalculation(AsmList<Scalar>** current_als, Traverse::State* current_state);
 
+      /// Deletes all cache records of the element element_id in the space space_i.
+      void free_cache_records(unsigned int space_i, int element_id);
+
+      /// Evicts the least recently used elements from the cache until it fits into Hermes2DApiParam::cacheSizeLimit.
+      void trim_cache();
+      /// Evicts the least recently used elements from the cache until it fits into limit (bytes, 0 means no limit).
+      void trim_cache(size_t limit);
+
+      /// Called (by one thread) between the chunks of states assembled with Hermes2DApiParam::assemblingMemoryLimit:
+      /// trims the cache to the limit (bytes) and writes out the buffered local matrices of an ElementMatrixStore.
+      void finish_assembling_chunk(size_t limit);
+
       /// Calculate cache records for this set of parameters.
       void calculate_cache_records(PrecalcShapeset** current_pss, PrecalcShapeset** current_spss, RefMap** current_refmaps, Solution<Scalar>** current_u_ext, AsmList<Scalar>** current_als, 
         Traverse::State* current_state, AsmList<Scalar>** current_alsSurface, WeakForm<Scalar>* current_wf);
@@ -193,18 +329,89 @@ namespace Hermes
 
       /// Matrix volumetric forms - assemble the form.
       virtual void assemble_matrix_form(MatrixForm<Scalar>* form, int order, Func<double>** base_fns, Func<double>** test_fns, Func<Scalar>** ext, Func<Scalar>** u_ext,
-      AsmList<Scalar>* current_als_i, AsmList<Scalar>* current_als_j, Traverse::State* current_state, int n_quadrature_points, Geom<double>* geometry, double* jacobian_x_weights);
+      AsmList<Scalar>* current_als_i, AsmList<Scalar>* current_als_j, Traverse::State* current_state, int n_quadrature_points, Geom<double>* geometry, double* jacobian_x_weights,
+      RefMap* current_refmap);
+
+      class CacheRecordPerSubIdx;
+
+      /// The volumetric values of the u_ext function of the space on the state, calculated from the coefficient vector
+      /// and the cached shape functions of the state (no Solution evaluation).
+      /// \return NULL if the values have to come from the Solution (vector-valued spaces, no cache record, no coefficient vector).
+      Func<Scalar>* init_u_ext_fn(unsigned int space_i, int order, CacheRecordPerSubIdx** cacheRecordPerSubIdx, AsmList<Scalar>** current_als, Traverse::State* current_state);
+
+      /// Vector-valued matrix volumetric forms - assemble all the blocks of the form into one local matrix and insert it at once.
+      void assemble_matrix_form_block(MatrixFormVolBlock<Scalar>* form, CacheRecordPerSubIdx** cacheRecordPerSubIdx, Func<Scalar>** ext, Func<Scalar>** u_ext,
+        AsmList<Scalar>** current_als, Traverse::State* current_state);
+
+      /// The maximum polynomial order of the functions of the space on the element of the state (including the edge orders).
+      int calc_max_element_order(unsigned int space_i, Traverse::State* current_state) const;
+
+      /// Matrix volumetric forms with constant coefficients on elements with a constant reference map - calculate
+      /// the values of the form for all pairs of functions from integrals over the reference element.
+      /// \return false if the form has to be integrated numerically on this state.
+      bool calc_matrix_form_reference_values(MatrixFormVol<Scalar>* form, RefMap* current_refmap, AsmList<Scalar>* current_als_i, AsmList<Scalar>* current_als_j,
+        Traverse::State* current_state, Scalar** form_values);
+
+      /// Matrix volumetric forms described by MatrixFormVol::get_point_coefficients on quads - calculate
+      /// the values of the form for all pairs of functions by sum factorization.
+      /// \return false if the form has to be integrated point by point on this state.
+      bool calc_matrix_form_tensor_values(MatrixFormVol<Scalar>* form, int order, RefMap* current_refmap, AsmList<Scalar>* current_als_i, AsmList<Scalar>* current_als_j,
+        Traverse::State* current_state, int n_quadrature_points, Geom<double>* geometry, double* jacobian_x_weights, Func<Scalar>** u_ext, Func<Scalar>** ext, Scalar** form_values);
+
+      /// Matrix volumetric forms described by MatrixFormVol::get_point_coefficients on elements with a constant reference map - add the element
+      /// to a batch of the element batch kernel, see set_element_batch_kernel().
+      /// \return false if the form has to be integrated otherwise on this state.
+      bool batch_matrix_form(MatrixFormVol<Scalar>* form, int order, RefMap* current_refmap, AsmList<Scalar>* current_als_i, AsmList<Scalar>* current_als_j,
+        Traverse::State* current_state, int n_quadrature_points, Geom<double>* geometry, double* jacobian_x_weights, Func<Scalar>** u_ext, Func<Scalar>** ext);
+      /// The shape table of the element batch kernel for the functions of the assembly list, uploaded the first time it is needed in an assembling.
+      int get_batch_shape_table(Shapeset* shapeset, ElementMode2D mode, int order, AsmList<Scalar>* current_als);
+      /// Computes and inserts the batches of the calling thread.
+      /// @param[in] all Also the incomplete batches, otherwise only the ones with batch_size elements.
+      void flush_element_batches(bool all);
+      /// The values of the form being inserted from a batch by flush_element_batches(), NULL otherwise.
+      Scalar** get_batched_form_values();
+      /// Makes sure there are the batches of every thread, forgets the shape tables.
+      void init_element_batches();
+      void free_element_batches();
+
+      /// Vector volumetric forms described by VectorFormVol::get_point_fluxes on quads - calculate
+      /// the values of the form for all test functions by sum factorization.
+      /// \return false if the form has to be integrated point by point on this state.
+      bool calc_vector_form_tensor_values(VectorFormVol<Scalar>* form, int order, RefMap* current_refmap, AsmList<Scalar>* current_als,
+        Traverse::State* current_state, int n_quadrature_points, Geom<double>* geometry, double* jacobian_x_weights, Func<Scalar>** u_ext, Func<Scalar>** ext, Scalar* form_values);
+
+      /// Makes sure there is one storage of reference integrals per thread.
+      void init_reference_integrals();
+
+      /// Makes sure there is one FormValuesBuffer per thread.
+      void init_form_values_buffers();
+      /// The values of a volumetric matrix form in the buffer of the current thread, m x n, not zeroed.
+      Scalar** get_form_values_buffer(unsigned int m, unsigned int n);
+
+      /// Integration order of the form for the orders of the functions it is integrated with.
+      /// \param[in] key The orders of the shape functions and of the external functions, the order of the reference map and the element mode.
+      /// The orders of the shape and external functions (Func<Hermes::Ord>) are only created if ord() has to be evaluated,
+      /// not for the forms with an order formula (Form::get_order_formula()).
+      int calc_order_form(Form<Scalar>* form, bool matrix_form, int order_u, int order_v, const std::vector<int>& key, RefMap** current_refmaps);
+
+      /// Makes sure there is one (empty) storage of calculated orders of forms per thread.
+      void init_form_orders();
 
       /// Vector volumetric forms - calculate the integration order.
       int calc_order_vector_form(VectorForm<Scalar>* mfv, RefMap** current_refmaps, Solution<Scalar>** current_u_ext, Traverse::State* current_state);
 
       /// Vector volumetric forms - assemble the form.
       void assemble_vector_form(VectorForm<Scalar>* form, int order, Func<double>** test_fns, Func<Scalar>** ext, Func<Scalar>** u_ext, 
-      AsmList<Scalar>* current_als, Traverse::State* current_state, int n_quadrature_points, Geom<double>* geometry, double* jacobian_x_weights);
+      AsmList<Scalar>* current_als, Traverse::State* current_state, int n_quadrature_points, Geom<double>* geometry, double* jacobian_x_weights,
+      RefMap* current_refmap);
 
+      /// \ingroup Helper methods inside {calc_order_*, assemble_*}
+      /// Appends the orders of the external functions (u_ext, then ext) of the form to orders.
+      void get_ext_orders(Form<Scalar> *form, Solution<Scalar>** current_u_ext, Traverse::State* current_state, std::vector<int>& orders);
       /// \ingroup Helper methods inside {calc_order_*, assemble_*}
       /// Calculates orders for external functions.
-      void init_ext_orders(Form<Scalar> *form, Func<Hermes::Ord>** oi, Func<Hermes::Ord>** oext, Solution<Scalar>** current_u_ext, Traverse::State* current_state);
+      /// \param[in] orders The orders from get_ext_orders().
+      void init_ext_orders(Form<Scalar> *form, Func<Hermes::Ord>** oi, Func<Hermes::Ord>** oext, const int* orders);
       /// \ingroup Helper methods inside {calc_order_*, assemble_*}
       /// Cleans up after init_ext_orders.
       void deinit_ext_orders(Form<Scalar> *form, Func<Hermes::Ord>** oi, Func<Hermes::Ord>** oext);
@@ -215,6 +422,12 @@ namespace Hermes
       /// Matrix structure as well as spaces and weak formulation is up-to-date.
       bool is_up_to_date() const;
 
+      /// The stored sparse structure (see sparse_structure_Ap) can be used for current_mat.
+      bool sparse_structure_reusable() const;
+
+      /// Deletes the stored sparse structure.
+      void delete_sparse_structure();
+
       /// Weak formulation.
       const WeakForm<Scalar>* wf;
 
@@ -253,6 +466,19 @@ namespace Hermes
       /// There is a vector form set on DG_INNER_EDGE area or not.
       bool DG_vector_forms_present;
 
+      /// The vector forms are not assembled into current_rhs, it only receives the contributions
+      /// of the matrix forms (the Dirichlet lift of linear problems, see DiscreteProblemLinear::assemble_operator()).
+      bool vector_forms_skipped;
+
+      /// The matrix forms assembled, by Form::is_time_independent() (see DiscreteProblemLinear::assemble()).
+      enum MatrixFormsSelection
+      {
+        MATRIX_FORMS_ALL,
+        MATRIX_FORMS_TIME_INDEPENDENT,
+        MATRIX_FORMS_TIME_DEPENDENT
+      };
+      MatrixFormsSelection matrix_forms_selection;
+
       /// Turn on Runge-Kutta specific handling of external functions.
       bool RungeKutta;
 
@@ -265,6 +491,191 @@ namespace Hermes
       bool current_force_diagonal_blocks;
       Table* current_block_weights;
 
+      /// Matrix into which the sparse structure was last created.
+      const SparseMatrix<Scalar>* sparse_structure_mat;
+
+      /// Stored sparse structure (CSC, ndof + 1 column pointers and the row indices) of CSC matrices.
+      /// It is copied into a new (or freed) matrix as long as the spaces stay the same,
+      /// e.g. in a new NewtonSolver or after set_spaces() at a new time step.
+      int* sparse_structure_Ap;
+      int* sparse_structure_Ai;
+      /// Space seq numbers and the setting of current_force_diagonal_blocks the stored sparse structure corresponds to.
+      int* sparse_structure_sp_seq;
+      bool sparse_structure_force_diagonal_blocks;
+      /// Space versions (Space::get_version()) of the stored sparse structure, so that it is reused for the same DOFs
+      /// also after the seq numbers changed (e.g. by assign_dofs() of an unchanged space, or for a SpaceSnapshot).
+      uint64_t* sparse_structure_versions;
+
+      /// The coefficient vector of the u_ext functions of the current assembling (NULL if none)
+      /// and the offsets of the spaces in it (see Space::get_dof_offset()).
+      Scalar* u_ext_coeff_vec;
+      int* u_ext_dof_offsets;
+
+      /// The elements across the edges of the active elements of a mesh, the couplings of the DG sparse structure.
+      /// The ids of the neighbors of the element with the id i are neighbors[neighbor_start[i]] ... neighbors[neighbor_start[i + 1] - 1]
+      /// (ids, as copies of the mesh share the seq).
+      struct DGFaceTable
+      {
+        DGFaceTable(const Mesh* mesh);
+        ~DGFaceTable();
+        int* neighbor_start;
+        int* neighbors;
+      };
+
+      /// The face table of the mesh, found by NeighborSearch on the first request and kept while the mesh
+      /// (its seq) does not change, so that the sparse structure of new spaces on the same mesh is created without any search.
+      DGFaceTable* get_dg_face_table(const Mesh* mesh);
+
+      /// Releases the face tables of the meshes other than those of the spaces (all of them if all == true).
+      void free_dg_face_tables(bool all);
+
+      /// The kept face tables by the mesh seq.
+      std::map<unsigned int, DGFaceTable*> dg_face_tables;
+
+      /// Scatter map of one block (pair of spaces) on one state.
+      class ScatterMapRecord
+      {
+      public:
+        int element_id_i;
+        int element_id_j;
+        unsigned int cnt_i;
+        unsigned int cnt_j;
+        int* positions;
+      };
+
+      /// Scatter maps, indexed by Traverse::State::index and i * neq + j.
+      ScatterMapRecord*** scatter_maps;
+      int scatter_maps_size;
+      /// Scatter maps are used in the current assembling.
+      bool use_scatter_maps;
+
+      /// Thread-private values of current_mat (indexed by thread, the first thread uses the matrix values directly),
+      /// NULL if not assembling in the mode H2D_ASSEMBLING_THREAD_LOCAL.
+      Scalar** thread_mat_values;
+      /// Thread-private values of current_rhs (indexed by thread),
+      /// NULL if not assembling in the mode H2D_ASSEMBLING_THREAD_LOCAL.
+      Scalar** thread_rhs_values;
+      /// The values of current_mat and current_rhs, added to without any synchronization since no two states
+      /// of one group share a DOF, NULL if the states are not colored (see group_states()).
+      Scalar* colored_mat_values;
+      Scalar* colored_rhs_values;
+
+      /// Per-thread arenas for the temporaries of assembling one state, reset before every state.
+      MemoryArena* assembling_arenas;
+      int assembling_arenas_count;
+
+      /// Integrals of products of two shape functions and of their derivatives over the reference element.
+      /// Taken from the precalculated tables (ReferenceIntegralTable) if there are ones for the shapeset,
+      /// otherwise computed on demand and kept for the whole life of the DiscreteProblem, one instance per thread.
+      class ReferenceIntegrals
+      {
+      public:
+        ReferenceIntegrals();
+        ~ReferenceIntegrals();
+        /// Integrals of u * v, du/dxi * dv/dxi, du/dxi * dv/deta + du/deta * dv/dxi and du/deta * dv/deta,
+        /// u being the shape function index_u of shapeset_u and v the shape function index_v of shapeset_v,
+        /// over the reference domain of the element e.
+        const double* get(Shapeset* shapeset_u, int index_u, Shapeset* shapeset_v, int index_v, Element* e);
+
+        /// Splits all functions of als (from shapeset, on the quad e) into tensor-product factors
+        /// for the quadrature order, see QuadTensorFactors.
+        /// \return NULL if some function is not a product.
+        QuadTensorFactors* split(Shapeset* shapeset, int role, Element* e, int order, AsmList<Scalar>* als, int* x_factors, int* y_factors, double* scales);
+      private:
+        struct Values
+        {
+          double v[4];
+        };
+        std::map<uint64_t, Values> integrals;
+        /// The precalculated tables found so far (NULL if there is none), by 2 * shapeset id + mode,
+        /// and the last one used.
+        std::map<int, const ReferenceIntegralTable*> tables;
+        int last_table_key;
+        const ReferenceIntegralTable* last_table;
+        const ReferenceIntegralTable* get_table(Shapeset* shapeset, ElementMode2D mode);
+        /// Precalculated shapesets, two (for u and v) per shapeset.
+        std::map<int, PrecalcShapeset*> pss;
+        PrecalcShapeset* get_pss(Shapeset* shapeset, int role, Element* e);
+        /// Tensor-product factors per shapeset and quadrature order.
+        std::map<int, QuadTensorFactors*> tensor_factors;
+      };
+      ReferenceIntegrals* reference_integrals;
+      int reference_integrals_count;
+
+      /// Storage of the values of a volumetric matrix form for all pairs of functions (MatrixFormVol::value_all()),
+      /// reused by all the forms and states of one thread, it only grows with the largest element.
+      struct FormValuesBuffer
+      {
+        std::vector<Scalar> values;
+        std::vector<Scalar*> rows;
+      };
+      FormValuesBuffer* form_values_buffers;
+      int form_values_buffers_count;
+
+      /// See set_element_batch_kernel().
+      ElementBatchKernel<Scalar>* element_batch_kernel;
+      int element_batch_size;
+      /// The elements of one form with the same shape tables waiting for the kernel.
+      struct ElementBatch
+      {
+        MatrixFormVol<Scalar>* form;
+        int order;
+        int test_table;
+        int basis_table;
+        int num_points;
+        std::vector<Traverse::State*> states;
+        /// Copies of the assembly lists of the elements.
+        std::vector<AsmList<Scalar>*> als_i;
+        std::vector<AsmList<Scalar>*> als_j;
+        /// See ElementBatchKernel::compute().
+        std::vector<Scalar> weights;
+      };
+      /// The batches of one thread, by the form and the shape tables.
+      struct ElementBatches
+      {
+        std::map<std::pair<MatrixFormVol<Scalar>*, std::pair<int, int> >, ElementBatch*> batches;
+        Scalar** form_values;
+      };
+      ElementBatches* element_batches;
+      int element_batches_count;
+      /// The shape tables uploaded in this assembling, by the shapeset, the mode, the order and the indices of the functions.
+      std::map<std::vector<int>, int> batch_shape_tables;
+
+      /// Integration orders of the forms calculated during the current assembling (per thread), by the form and
+      /// the orders it depends on (see calc_order_form()); elements mostly share a few combinations of them.
+      typedef std::map<std::pair<Form<Scalar>*, std::vector<int> >, int> FormOrders;
+      FormOrders* form_orders;
+      int form_orders_count;
+
+      /// States of the union traversal of the meshes, reused while the meshes do not change.
+      TraverseStateList traverse_states;
+
+      /// See set_process_partition().
+      int partition_rank;
+      int partition_num_ranks;
+      bool partition_sum_matrix;
+      /// The processes assembling the states (indexed by Traverse::State::index), NULL if this one assembles all of them.
+      int* state_parts;
+      /// See init_overlapped_reduction(), the halo states (by Traverse::State::index), NULL if the reduction is not overlapped.
+      bool* halo_states;
+      /// The positions in the matrix values of the entries between the shared DOFs and of the other ones.
+      int* halo_positions;
+      int halo_positions_count;
+      int* interior_positions;
+      int interior_positions_count;
+      /// The values of the halo positions being summed, and the MPI_Request of the reduction.
+      Scalar* halo_buffer;
+      void* halo_request;
+      bool halo_reduction_started;
+      /// The partition changed since the owned states were marked.
+      bool owned_states_invalid;
+
+      /// See get_state_groups().
+      Hermes::vector<int> state_groups;
+      /// The space sequence numbers and the assembling mode the state groups were calculated for.
+      Hermes::vector<int> state_groups_sp_seq;
+      int state_groups_mode;
+
       /// Caching.
       class CacheRecordPerElement
       {
@@ -272,6 +683,8 @@ namespace Hermes
         void clear();
         int* asmlistIdx;
         int asmlistCnt;
+        /// Value of cache_stamp of the last assembling that used this element.
+        unsigned int last_used;
       };
 
       class CacheRecordPerSubIdx
@@ -281,6 +694,8 @@ namespace Hermes
         int nvert;
         int order;
         void clear();
+        /// Approximate number of bytes held by this record.
+        size_t get_memory() const;
         int asmlistCnt;
         Func<double>** fns;
         Func<double>*** fnsSurface;
@@ -299,9 +714,36 @@ namespace Hermes
       bool** cache_element_stored;
       int cache_size;
       bool do_not_use_cache;
-
-      /// Exception caught in a parallel region.
-      Hermes::Exceptions::Exception* caughtException;
+      /// Approximate number of bytes held by all CacheRecordPerSubIdx records.
+      size_t cache_memory;
+      /// Incremented with every assembling, used to find the least recently used elements.
+      unsigned int cache_stamp;
+
+      /// The per-thread clones of wf, kept between the assemblings while wf is not modified (WeakForm::get_modification_count()),
+      /// as cloning all the forms is expensive for the weak forms with many of them.
+      WeakForm<Scalar>** weakform_clones;
+      int weakform_clones_count;
+      const WeakForm<Scalar>* weakform_clones_wf;
+      unsigned int weakform_clones_modification;
+      void free_weakform_clones();
+
+      /// The per-thread precalculated shapesets, reference maps and assembly lists, kept between the assemblings while the number
+      /// of threads and the shapesets of the spaces do not change. The precalculated shapesets thus keep their tables of values
+      /// and the repeated assemblings of small problems do not spend their time creating and filling them again.
+      PrecalcShapeset*** context_pss;
+      PrecalcShapeset*** context_spss;
+      RefMap*** context_refmaps;
+      AsmList<Scalar>*** context_als;
+      int contexts_count;
+      int contexts_neq;
+      /// Creates the thread contexts or checks that the kept ones fit.
+      void init_thread_contexts();
+      void free_thread_contexts();
+
+      /// The first exception caught in the parallel assembling, the other threads skip the remaining states.
+      Hermes::Exceptions::ParallelStatus assembly_status;
+
+      Hermes::Mixins::Profile profile;
     
       
       ///* DG *///
@@ -350,11 +792,42 @@ namespace Hermes
       /// Initialize neighbors.
       bool init_neighbors(LightArray<NeighborSearch<Scalar>*>& neighbor_searches, Traverse::State* current_state, unsigned int min_dg_mesh_seq);
 
+      /// The neighbor searches of one DG edge, see get_neighbor_searches().
+      struct NeighborSearchRecord
+      {
+        LightArray<NeighborSearch<Scalar>*>* neighbor_searches;
+        unsigned int num_neighbors;
+        /// All the DG meshes have the edge as an intra-element edge (see init_neighbors()).
+        bool intra_edge;
+        /// For every segment (neighbor) of the edge: the matrix forms are assembled from the other side of the segment.
+        /// Determined from the elements alone (see get_neighbor_searches()), so that each segment is processed exactly once
+        /// regardless of the order (and the thread) the states are assembled in.
+        bool* processed;
+      };
+
+      /// The neighbor searches of the edge current_state->isurf, initialized by init_neighbors() and updated according
+      /// to the multimesh tree. They are calculated once per edge and kept (for the assembling and for KellyTypeAdapt)
+      /// until the meshes change, see free_neighbor_searches(). Thread-safe, the same edge must not be processed
+      /// by two threads at once.
+      NeighborSearchRecord* get_neighbor_searches(Traverse::State* current_state, unsigned int min_dg_mesh_seq);
+
+      /// Releases the kept neighbor searches.
+      void free_neighbor_searches();
+
+      /// Releases the kept neighbor searches if the meshes of the spaces changed (the assembling
+      /// does so when its traversal states change).
+      void update_neighbor_searches();
+
+      /// The kept neighbor searches by the edge and the elements and sub-element transformations of the spaces in the state.
+      std::map<std::vector<uint64_t>, NeighborSearchRecord*> neighbor_search_records;
+
       /// Initialize the tree for traversing multimesh neighbors.
-      void build_multimesh_tree(NeighborNode* root, LightArray<NeighborSearch<Scalar>*>& neighbor_searches);
+      /// All the nodes are allocated at once, the returned root is the array to be deleted by delete [].
+      NeighborNode* build_multimesh_tree(LightArray<NeighborSearch<Scalar>*>& neighbor_searches);
 
       /// Recursive insertion function into the tree.
-      void insert_into_multimesh_tree(NeighborNode* node, unsigned int* transformations, unsigned int transformation_count);
+      /// \param[in, out] free_nodes The unused nodes of the array of the tree.
+      void insert_into_multimesh_tree(NeighborNode* node, unsigned int* transformations, unsigned int transformation_count, NeighborNode*& free_nodes);
 
       /// Return a global (unified list of central element transformations representing the neighbors on the union mesh.
       Hermes::vector<Hermes::vector<unsigned int>*> get_multimesh_neighbors_transformations(NeighborNode* multimesh_tree);
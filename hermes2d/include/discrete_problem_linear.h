@@ -45,14 +45,67 @@ namespace Hermes
 
       /// Assembling.
       /// Light version, linear problems.
+      /// If some matrix forms are time-independent (Form::set_time_independent()), their contribution (including their Dirichlet lift)
+      /// is assembled once into a kept matrix, and only the other forms are assembled on the following calls, e.g. after set_time().
+      /// The kept matrix is assembled again if the spaces, the weak formulation, force_diagonal_blocks or block_weights change.
       virtual void assemble(SparseMatrix<Scalar>* mat, Vector<Scalar>* rhs = NULL, bool force_diagonal_blocks = false,
         Table* block_weights = NULL);
 
+      /// The kept matrix of the time-independent forms is assembled again on the next assemble()
+      /// (to be called e.g. after their coefficients or scaling factors were changed).
+      void invalidate_time_independent_matrix();
+
+      /// Assembles the matrix alone, for problems whose right-hand side changes while the operator does not.
+      /// The contributions of the matrix forms to the right-hand side (the Dirichlet lift) are kept for assemble_rhs().
+      void assemble_operator(SparseMatrix<Scalar>* mat, bool force_diagonal_blocks = false, Table* block_weights = NULL);
+
+      /// Assembles the right-hand side belonging to the operator of the last assemble_operator():
+      /// only the vector forms are evaluated and the kept Dirichlet lift is added.
+      void assemble_rhs(Vector<Scalar>* rhs);
+
+      /// Assembles several right-hand sides belonging to the operator of the last assemble_operator(), the k-th one with
+      /// the external functions ext_sets[k] of the weak formulation (see WeakForm::set_ext()), which are restored afterwards.
+      /// The traversal states and the cached values of the shape functions are shared by all of them.
+      /// @param[out] rhs_block The right-hand sides one after another (ext_sets.size() * ndof values), as taken by
+      /// LinearMatrixSolver::solve_multiple().
+      void assemble_rhs(Hermes::vector<Hermes::vector<MeshFunction<Scalar>*> > ext_sets, Scalar* rhs_block);
+
     protected:
+      /// The right-hand side contributions of the matrix forms of the last assemble_operator().
+      Scalar* dirichlet_lift;
+      /// Space seq numbers the Dirichlet lift corresponds to.
+      int* dirichlet_lift_sp_seq;
+      /// assemble() adds dirichlet_lift to the right-hand side.
+      bool dirichlet_lift_added;
+
+      /// The assembling of the selected forms (see DiscreteProblem::matrix_forms_selection).
+      void assemble_forms(SparseMatrix<Scalar>* mat, Vector<Scalar>* rhs, bool force_diagonal_blocks, Table* block_weights);
+
+      /// Some matrix form of the weak formulation is time-independent.
+      bool has_time_independent_matrix_forms() const;
+
+      /// The kept matrix corresponds to the spaces, the weak formulation and the parameters of this assembling.
+      bool time_independent_matrix_up_to_date(bool force_diagonal_blocks, Table* block_weights) const;
+
+      /// Assembles the time-independent matrix forms into time_independent_matrix (of the type of mat)
+      /// and their Dirichlet lift into time_independent_lift.
+      /// \return false if no matrix of the type of mat can be created (see create_matrix()).
+      bool assemble_time_independent_matrix(SparseMatrix<Scalar>* mat, bool force_diagonal_blocks, Table* block_weights);
+
+      /// The contribution of the time-independent matrix forms, NULL if not assembled.
+      SparseMatrix<Scalar>* time_independent_matrix;
+      Scalar* time_independent_lift;
+      /// Space seq numbers, the weak formulation and the parameters the kept matrix corresponds to.
+      int* time_independent_sp_seq;
+      const WeakForm<Scalar>* time_independent_wf;
+      bool time_independent_force_diagonal_blocks;
+      Table* time_independent_block_weights;
+
       /// Methods different to those of the parent class.
       /// Matrix forms.
       virtual void assemble_matrix_form(MatrixForm<Scalar>* form, int order, Func<double>** base_fns, Func<double>** test_fns, Func<Scalar>** ext, Func<Scalar>** u_ext,
-      AsmList<Scalar>* current_als_i, AsmList<Scalar>* current_als_j, Traverse::State* current_state, int n_quadrature_points, Geom<double>* geometry, double* jacobian_x_weights);
+      AsmList<Scalar>* current_als_i, AsmList<Scalar>* current_als_j, Traverse::State* current_state, int n_quadrature_points, Geom<double>* geometry, double* jacobian_x_weights,
+      RefMap* current_refmap);
 
       template<typename T> friend class KellyTypeAdapt;
       template<typename T> friend class NewtonSolver;
@@ -0,0 +1,79 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef __H2D_ELEMENT_BATCH_KERNEL_H
+#define __H2D_ELEMENT_BATCH_KERNEL_H
+
+#include "global.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    /// \brief Computes the local matrices of the volumetric mass and diffusion forms for batches of elements, see DiscreteProblem::set_element_batch_kernel().
+    ///
+    /// The elements of one batch have the same shape functions (the same mode and orders) and a constant reference map, so the
+    /// shape functions are evaluated once in the integration points of the reference element (a shape table, uploaded by upload_shape_table()
+    /// once per assembling), and the elements differ only by the weights of the terms in the integration points. The weights contain
+    /// the integration weights, the reference map and the coefficients of the form (MatrixFormVol::get_point_coefficients()):
+    /// local[i][j] = sum_k w_mass(k) v_i u_j + w_xx(k) dv_i/dxi du_j/dxi + w_xy(k) (dv_i/dxi du_j/deta + dv_i/deta du_j/dxi) + w_yy(k) dv_i/deta du_j/deta,
+    /// with u_j the basis and v_i the test functions.
+    /// The computation of a batch is regular dense arithmetic, so that an implementation can do it on an accelerator;
+    /// ElementBatchKernelCPU is the one on the host.
+    template<typename Scalar>
+    class HERMES_API ElementBatchKernel
+    {
+    public:
+      virtual ~ElementBatchKernel() {}
+
+      /// Forgets all the shape tables, called at the beginning of every assembling.
+      virtual void clear_shape_tables() = 0;
+
+      /// Stores a shape table.
+      /// @param[in] values, dx, dy The values and the derivatives (in the reference coordinates) of the functions in the points, [fn * num_points + point].
+      /// \return The identifier of the table in compute().
+      virtual int upload_shape_table(int num_fns, int num_points, const double* values, const double* dx, const double* dy) = 0;
+
+      /// Computes the local matrices of a batch, may be called by several threads at once (also with upload_shape_table()).
+      /// @param[in] weights The weights w_mass, w_xx, w_xy, w_yy of the elements, [(element * 4 + term) * num_points + point].
+      /// @param[out] local_matrices [(element * num_test_fns + i) * num_basis_fns + j].
+      virtual void compute(int test_table, int basis_table, int num_elements, const Scalar* weights, Scalar* local_matrices) = 0;
+    };
+
+    /// \brief ElementBatchKernel on the host.
+    /// The weights of every test function are combined first, so that the innermost loops are dot products over the points.
+    template<typename Scalar>
+    class HERMES_API ElementBatchKernelCPU : public ElementBatchKernel<Scalar>
+    {
+    public:
+      ElementBatchKernelCPU();
+      virtual ~ElementBatchKernelCPU();
+
+      virtual void clear_shape_tables();
+      virtual int upload_shape_table(int num_fns, int num_points, const double* values, const double* dx, const double* dy);
+      virtual void compute(int test_table, int basis_table, int num_elements, const Scalar* weights, Scalar* local_matrices);
+
+    protected:
+      struct ShapeTable
+      {
+        int num_fns;
+        int num_points;
+        /// The values, dx and dy one after another.
+        double* data;
+      };
+      std::vector<ShapeTable*> tables;
+    };
+  }
+}
+#endif
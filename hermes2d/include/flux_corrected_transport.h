@@ -0,0 +1,117 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+/*! \file flux_corrected_transport.h
+\brief Algebraic flux correction (FCT) of linear finite element schemes.
+*/
+#ifndef __H2D_FLUX_CORRECTED_TRANSPORT_H
+#define __H2D_FLUX_CORRECTED_TRANSPORT_H
+
+#include "global.h"
+#ifdef WITH_UMFPACK
+#include "space/space.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    /// @ingroup userSolvingAPI
+    /// \brief Flux-corrected transport on the assembled matrices (Kuzmin's algebraic flux correction).
+    ///
+    /// The scheme acts on the vertex degrees of freedom of the linear elements not adjacent to higher order
+    /// elements or hanging nodes (the FCT dofs). Every pair of FCT dofs i > j coupled by the consistent mass
+    /// matrix is an edge; the edges, the positions of their entries in the CSC structure and the edges
+    /// incident to every dof are found once by init(), so that no matrix entry is searched for afterwards.
+    /// All the matrices passed to the methods have to share the sparse structure of the mass matrix of init()
+    /// (they are assembled on the same space).
+    ///
+    /// The limiter (Zalesak) runs edge by edge and then dof by dof, both in parallel: the sums and bounds of the
+    /// fluxes and the correction factors of a dof are gathered from its own edges, so no synchronization is needed.
+    class HERMES_API FluxCorrectedTransport : public Hermes::Mixins::Loggable
+    {
+    public:
+      /// @param[in] theta The parameter of the time discretization (0 explicit, 0.5 Crank-Nicolson, 1 implicit Euler).
+      FluxCorrectedTransport(double theta = 0.5);
+      virtual ~FluxCorrectedTransport();
+
+      /// Determines the FCT dofs of the space and the edges from the sparse structure of the mass matrix.
+      /// Has to be called again whenever the space changes.
+      void init(const Space<double>* space, CSCMatrix<double>* mass_matrix);
+
+      /// The FCT dofs, NULL before init().
+      bool* get_fct_dofs() const;
+
+      /// Discrete upwinding of the convection matrix K: d_ij = max(-k_ij, -k_ji, 0) for every edge, with zero row sums.
+      /// @return The artificial diffusion D (to be deleted by the caller), K + D has no negative off-diagonal entries on the edges.
+      UMFPackMatrix<double>* artificial_diffusion(CSCMatrix<double>* conv_matrix);
+
+      /// Row-sum lumping of the mass matrix on the edges.
+      /// @return The lumped mass matrix M_L (to be deleted by the caller).
+      UMFPackMatrix<double>* mass_lumping(CSCMatrix<double>* mass_matrix);
+
+      /// Limited antidiffusive fluxes of the theta-scheme
+      /// f_ij = (m_ij / tau + theta d_ij)(u_high_i - u_high_j) - (m_ij / tau - (1 - theta) d_ij)(u_old_i - u_old_j),
+      /// bounded by the local extrema of the low order solution u_L.
+      /// @param[out] flux_correction The sums of the limited fluxes of the dofs, to be added to the right-hand side of the low order scheme.
+      /// @param[in] smooth_dofs If not NULL, the fluxes of the dofs with smooth_dofs[i] == 1 are not limited.
+      void antidiffusive_fluxes(CSCMatrix<double>* mass_matrix, CSCMatrix<double>* lumped_matrix, CSCMatrix<double>* diffusion,
+        double* u_high, double* u_L, double* u_old, double time_step, double* flux_correction, int* smooth_dofs = NULL);
+
+      /// Limited fluxes f_ij = m_ij (u_H_i - u_H_j) correcting the lumped projection u_L towards the consistent one u_H.
+      /// The corrected projection is the solution of M_L u = M_L u_L + flux_correction.
+      /// @param[in] smooth_dofs If not NULL, the fluxes of the dofs with smooth_dofs[i] == 1 are not limited.
+      void projection_fluxes(CSCMatrix<double>* mass_matrix, CSCMatrix<double>* lumped_matrix,
+        double* u_L, double* u_H, double* flux_correction, int* smooth_dofs = NULL);
+
+    protected:
+      void free();
+
+      /// Checks that the matrix has the sparse structure of the mass matrix of init().
+      void check_structure(CSCMatrix<double>* matrix) const;
+
+      /// Limits the (prelimited) edge_fluxes by the bounds of u_L and sums them to the dofs.
+      /// @param[in] bound_scaling The scaling of the bounds m_ii (u_L_j - u_L_i).
+      void limit(CSCMatrix<double>* lumped_matrix, double* u_L, double bound_scaling, double* flux_correction, int* smooth_dofs);
+
+      double theta;
+
+      int ndof;
+      int nnz;
+      bool* fct_dofs;
+
+      /// The edges, the dofs i > j and the positions of the entries (i, j) and (j, i) in the values of the matrices.
+      int num_edges;
+      int* edge_i;
+      int* edge_j;
+      int* edge_pos_ij;
+      int* edge_pos_ji;
+
+      /// The positions of the diagonal entries.
+      int* diagonal_pos;
+
+      /// Edges incident to the dofs, node_edges[node_edge_start[i]] ... node_edges[node_edge_start[i + 1] - 1],
+      /// with node_edge_signs +1 if the dof is the edge_i of the edge, -1 if it is the edge_j.
+      int* node_edge_start;
+      int* node_edges;
+      double* node_edge_signs;
+
+      /// Work arrays of the limiter.
+      double* edge_fluxes;
+      double* R_plus;
+      double* R_minus;
+    };
+  }
+}
+#endif
+#endif
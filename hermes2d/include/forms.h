@@ -86,8 +86,14 @@ namespace Hermes
       /** \param[in] func A function which is added to *this. A number of integratioN points and a number of component has to match. */
       void add(Func<T>* func);
 
+      /// The values are stored in a block shared by several functions (see init_fns()); the owner
+      /// of the block (the first function) has values_pool set and deallocates the whole block.
+      bool in_values_pool;
+      T* values_pool;
+
       friend Func<Hermes::Ord>* init_fn_ord(const int order);
       friend Func<double>* init_fn(PrecalcShapeset *fu, RefMap *rm, const int order);
+      friend Func<double>** init_fns(PrecalcShapeset *fu, RefMap *rm, const int order, unsigned int count, int* idx);
       template<typename Scalar> friend Func<Scalar>* init_fn(MeshFunction<Scalar>*fu, const int order);
       template<typename Scalar> friend Func<Scalar>* init_fn(Solution<Scalar>*fu, const int order);
 
@@ -257,6 +263,10 @@ namespace Hermes
     HERMES_API Func<Hermes::Ord>* init_fn_ord(const int order);
     /// Init the shape function for the evaluation of the volumetric/surface integral (transformation of values).
     HERMES_API Func<double>* init_fn(PrecalcShapeset *fu, RefMap *rm, const int order);
+    /// Init the shape functions idx[0], ..., idx[count - 1] of fu at once. For H1 and L2 spaces, the values of all
+    /// of them are stored in one aligned block (val, dx, dy of each function padded to H2D_SIMD_DOUBLES),
+    /// and the inverse reference mapping is evaluated only once.
+    HERMES_API Func<double>** init_fns(PrecalcShapeset *fu, RefMap *rm, const int order, unsigned int count, int* idx);
     /// Init the mesh-function for the evaluation of the volumetric/surface integral.
     template<typename Scalar>
     HERMES_API Func<Scalar>* init_fn(MeshFunction<Scalar>*fu, const int order);
@@ -71,6 +71,12 @@ namespace Hermes
         return value (x, y);
       };
 
+      /// Function returning the values and derivatives at n points at once, called once per element
+      /// (for all its integration points) when the solution is precalculated.
+      /// The default calls exact_function() for every point, override it to evaluate whole arrays
+      /// (e.g. by loops that vectorize, without a virtual call per point).
+      virtual void exact_values(int n, const double* x, const double* y, Scalar* values, Scalar* dx, Scalar* dy) const;
+
       /// Function returning the integration order that
       /// should be used when integrating the function.
       virtual Hermes::Ord ord(Hermes::Ord x, Hermes::Ord y) const = 0;
@@ -98,6 +104,11 @@ namespace Hermes
         return value (x, y);
       };
 
+      /// Function returning the values and derivatives at n points at once, see ExactSolutionScalar::exact_values().
+      /// The arrays are indexed values[component][point].
+      /// The default calls exact_function() for every point.
+      virtual void exact_values(int n, const double* x, const double* y, Scalar** values, Scalar** dx, Scalar** dy) const;
+
       /// Function returning the integration order that
       /// should be used when integrating the function.
       virtual Hermes::Ord ord(Hermes::Ord x, Hermes::Ord y) const = 0;
@@ -114,6 +125,8 @@ namespace Hermes
 
       virtual void derivatives (double x, double y, Scalar& dx, Scalar& dy) const;
 
+      virtual void exact_values(int n, const double* x, const double* y, Scalar* values, Scalar* dx, Scalar* dy) const;
+
       virtual Ord ord(Ord x, Ord y) const;
       virtual MeshFunction<Scalar>* clone() const;
 
@@ -135,6 +148,8 @@ namespace Hermes
 
       virtual void derivatives (double x, double y, Scalar& dx, Scalar& dy) const;
 
+      virtual void exact_values(int n, const double* x, const double* y, Scalar* values, Scalar* dx, Scalar* dy) const;
+
       virtual Ord ord(Ord x, Ord y) const;
       virtual MeshFunction<Scalar>* clone() const;
 
@@ -153,6 +168,8 @@ namespace Hermes
 
       virtual void derivatives (double x, double y, Scalar2<Scalar>& dx, Scalar2<Scalar>& dy) const;
 
+      virtual void exact_values(int n, const double* x, const double* y, Scalar** values, Scalar** dx, Scalar** dy) const;
+
       virtual Ord ord(Ord x, Ord y) const;
       virtual MeshFunction<Scalar>* clone() const;
 
@@ -174,6 +191,8 @@ namespace Hermes
 
       virtual void derivatives (double x, double y, Scalar2<Scalar>& dx, Scalar2<Scalar>& dy) const;
 
+      virtual void exact_values(int n, const double* x, const double* y, Scalar** values, Scalar** dx, Scalar** dy) const;
+
       virtual Ord ord(Ord x, Ord y) const;
       virtual MeshFunction<Scalar>* clone() const;
 
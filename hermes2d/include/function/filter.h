@@ -61,6 +61,9 @@ namespace Hermes
 
       virtual void pop_transform();
 
+      /// The solutions are transformed along, see push_transform().
+      virtual void set_transform(uint64_t idx);
+
       virtual void init();
 
       int num;
@@ -77,9 +80,9 @@ namespace Hermes
       /// The highest layer (in contrast to the PrecalcShapeset class) is represented
       /// here only by this array.
 #ifdef _MSC_VER // For Visual Studio compiler the latter does not compile.
-      std::map<uint64_t, LightArray<Node*>*> tables[H2D_MAX_QUADRATURES];
+      std::map<uint64_t, NodeTable<Node*>*> tables[H2D_MAX_QUADRATURES];
 #else
-      std::map<uint64_t, LightArray<struct Filter<Scalar>::Node*>*> tables[H2D_MAX_QUADRATURES];
+      std::map<uint64_t, NodeTable<struct Filter<Scalar>::Node*>*> tables[H2D_MAX_QUADRATURES];
 #endif
 
       bool unimesh;
@@ -151,6 +154,9 @@ namespace Hermes
 
       virtual void pop_transform();
 
+      /// The solutions are transformed along, see push_transform().
+      virtual void set_transform(uint64_t idx);
+
       virtual void free();
       MeshFunction<std::complex<double> >* sln_complex;
 
@@ -437,6 +443,137 @@ namespace Hermes
 
       virtual void set_active_element(Element* e);
     };
+
+    /// @ingroup meshFunctions
+    /// A node of a pointwise expression over the inputs of an ExpressionFilter.
+    /// The expression gets the values and the derivatives of all inputs at one point and returns
+    /// its value and derivatives there, so e.g. the magnitude of a sum of two functions is evaluated
+    /// in one pass and needs neither the tables nor the traversal of the intermediate filters.
+    /// Composed expressions own (and delete) their operands.
+    template<typename Scalar>
+    class HERMES_API FilterExpression
+    {
+    public:
+      virtual ~FilterExpression();
+
+      /// @param[in] values, dx, dy values and derivatives of the inputs at the point (indexed by the inputs).
+      virtual void evaluate(const Scalar* values, const Scalar* dx, const Scalar* dy, Scalar& result, Scalar& result_dx, Scalar& result_dy) const = 0;
+
+      /// Deep copy.
+      virtual FilterExpression<Scalar>* clone() const = 0;
+
+      /// The highest index of an input the expression uses (-1 for none).
+      virtual int get_max_input() const = 0;
+    };
+
+    /// @ingroup meshFunctions
+    /// The index-th input of the ExpressionFilter.
+    template<typename Scalar>
+    class HERMES_API ExpressionInput : public FilterExpression<Scalar>
+    {
+    public:
+      ExpressionInput(int index);
+      virtual void evaluate(const Scalar* values, const Scalar* dx, const Scalar* dy, Scalar& result, Scalar& result_dx, Scalar& result_dy) const;
+      virtual FilterExpression<Scalar>* clone() const;
+      virtual int get_max_input() const;
+    protected:
+      int index;
+    };
+
+    /// @ingroup meshFunctions
+    /// A constant.
+    template<typename Scalar>
+    class HERMES_API ExpressionConstant : public FilterExpression<Scalar>
+    {
+    public:
+      ExpressionConstant(Scalar value);
+      virtual void evaluate(const Scalar* values, const Scalar* dx, const Scalar* dy, Scalar& result, Scalar& result_dx, Scalar& result_dy) const;
+      virtual FilterExpression<Scalar>* clone() const;
+      virtual int get_max_input() const;
+    protected:
+      Scalar value;
+    };
+
+    /// @ingroup meshFunctions
+    /// Binary operation on two expressions.
+    template<typename Scalar>
+    class HERMES_API ExpressionBinary : public FilterExpression<Scalar>
+    {
+    public:
+      enum Operation
+      {
+        EXPRESSION_SUM,
+        EXPRESSION_DIFF,
+        EXPRESSION_PRODUCT
+      };
+
+      ExpressionBinary(Operation operation, FilterExpression<Scalar>* left, FilterExpression<Scalar>* right);
+      virtual ~ExpressionBinary();
+      virtual void evaluate(const Scalar* values, const Scalar* dx, const Scalar* dy, Scalar& result, Scalar& result_dx, Scalar& result_dy) const;
+      virtual FilterExpression<Scalar>* clone() const;
+      virtual int get_max_input() const;
+    protected:
+      Operation operation;
+      FilterExpression<Scalar>* left;
+      FilterExpression<Scalar>* right;
+    };
+
+    /// @ingroup meshFunctions
+    /// Square of an expression (as SquareFilter).
+    template<typename Scalar>
+    class HERMES_API ExpressionSquare : public FilterExpression<Scalar>
+    {
+    public:
+      ExpressionSquare(FilterExpression<Scalar>* operand);
+      virtual ~ExpressionSquare();
+      virtual void evaluate(const Scalar* values, const Scalar* dx, const Scalar* dy, Scalar& result, Scalar& result_dx, Scalar& result_dy) const;
+      virtual FilterExpression<Scalar>* clone() const;
+      virtual int get_max_input() const;
+    protected:
+      FilterExpression<Scalar>* operand;
+    };
+
+    /// @ingroup meshFunctions
+    /// Magnitude sqrt(a_1^2 + ... + a_n^2) of the operands (as MagFilter).
+    /// The derivatives are set to zero where the magnitude vanishes.
+    template<typename Scalar>
+    class HERMES_API ExpressionMagnitude : public FilterExpression<Scalar>
+    {
+    public:
+      ExpressionMagnitude(Hermes::vector<FilterExpression<Scalar>*> operands);
+      virtual ~ExpressionMagnitude();
+      virtual void evaluate(const Scalar* values, const Scalar* dx, const Scalar* dy, Scalar& result, Scalar& result_dx, Scalar& result_dy) const;
+      virtual FilterExpression<Scalar>* clone() const;
+      virtual int get_max_input() const;
+    protected:
+      Hermes::vector<FilterExpression<Scalar>*> operands;
+    };
+
+    /// @ingroup meshFunctions
+    /// Filter evaluating a (composed) FilterExpression over its inputs. In contrast to chained
+    /// filters (e.g. MagFilter of a SumFilter), only the inputs are precalculated and the whole
+    /// expression is evaluated in one pass at the quadrature points; the derivatives of the result
+    /// are available (but only computed if they are asked for).
+    /// The inputs have to have the same number of components, the expression is applied per component.
+    /// \brief Single-pass filter defined by an expression.
+    template<typename Scalar>
+    class HERMES_API ExpressionFilter : public Filter<Scalar>
+    {
+    public:
+      /// @param[in] expression the expression, deleted by the filter.
+      ExpressionFilter(const Hermes::vector<MeshFunction<Scalar>*>& solutions, FilterExpression<Scalar>* expression);
+
+      virtual Func<Scalar>* get_pt_value(double x, double y, Element* e = NULL);
+      virtual MeshFunction<Scalar>* clone() const;
+      virtual ~ExpressionFilter();
+
+    protected:
+      FilterExpression<Scalar>* expression;
+
+      void init_components();
+
+      virtual void precalculate(int order, int mask);
+    };
   }
 }
 #endif
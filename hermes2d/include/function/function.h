@@ -69,6 +69,59 @@ namespace Hermes
     const int H2D_FN_COMPONENT_0 = H2D_FN_VAL_0 | H2D_FN_DX_0 | H2D_FN_DY_0 | H2D_FN_DXX_0 | H2D_FN_DYY_0 | H2D_FN_DXY_0;
     const int H2D_FN_COMPONENT_1 = H2D_FN_VAL_1 | H2D_FN_DX_1 | H2D_FN_DY_1 | H2D_FN_DXX_1 | H2D_FN_DYY_1 | H2D_FN_DXY_1;
 
+    /// The integration orders (the indices of the tables of Quad2D, including the edge ones) stored directly in NodeTable.
+    /// All the quadratures of the library have fewer tables (see RefMap::H2D_MAX_TABLES).
+    const unsigned int H2D_NODE_TABLE_DENSE_SIZE = 128;
+
+    /// \brief Nodes of a function (Function::Node*) by the integration order, for one sub-element transformation.
+    /// The orders below H2D_NODE_TABLE_DENSE_SIZE are looked up directly in an array, the others (of user-defined
+    /// quadratures) in a map. The interface is that of LightArray (a node is present if it is not NULL).
+    template<typename TYPE>
+    class NodeTable
+    {
+    public:
+      NodeTable() : size(0)
+      {
+        memset(dense, 0, sizeof(dense));
+      }
+
+      inline void add(TYPE item, unsigned int id)
+      {
+        if(id < H2D_NODE_TABLE_DENSE_SIZE)
+          dense[id] = item;
+        else
+          overflow[id] = item;
+        if(id >= size)
+          size = id + 1;
+      }
+
+      inline unsigned int get_size() const
+      {
+        return size;
+      }
+
+      inline bool present(unsigned int id) const
+      {
+        if(id < H2D_NODE_TABLE_DENSE_SIZE)
+          return dense[id] != NULL;
+        typename std::map<unsigned int, TYPE>::const_iterator it = overflow.find(id);
+        return it != overflow.end() && it->second != NULL;
+      }
+
+      /// After successful check for presence, the value can be retrieved.
+      inline TYPE get(unsigned int id) const
+      {
+        if(id < H2D_NODE_TABLE_DENSE_SIZE)
+          return dense[id];
+        return overflow.find(id)->second;
+      }
+
+    private:
+      TYPE dense[H2D_NODE_TABLE_DENSE_SIZE];
+      std::map<unsigned int, TYPE> overflow;
+      unsigned int size;
+    };
+
     /// @ingroup meshFunctions
     /// \brief Represents an arbitrary function defined on an element.
     ///
@@ -155,13 +208,19 @@ namespace Hermes
       /// \param mask[in] A combination of one or more of the constants H2D_FN_VAL, H2D_FN_DX, H2D_FN_DY,
       ///   H2D_FN_DXX, H2D_FN_DYY, H2D_FN_DXY specifying the values which should be precalculated. The default is
       ///   H2D_FN_VAL | H2D_FN_DX | H2D_FN_DY. You can also use H2D_FN_ALL to precalculate everything.
-      void set_quad_order(unsigned int order, int mask = H2D_FN_DEFAULT);
+      virtual void set_quad_order(unsigned int order, int mask = H2D_FN_DEFAULT);
 
       Scalar* get_values(int a, int b);
 
       /// \brief Returns the polynomial degree of the function being represented by the class.
       int get_fn_order() const;
 
+      /// \brief Returns the bytes of the precalculated tables in use (not counting the pooled ones).
+      size_t get_memory_size() const;
+
+      /// \brief Returns the high-water mark of get_memory_size().
+      size_t get_peak_memory_size() const;
+
     protected:
       /// \brief Selects the quadrature points in which the function will be evaluated.
       /// \details It is possible to switch back and forth between different quadrature
@@ -201,16 +260,16 @@ namespace Hermes
       int num_components; ///< number of vector components
 
       /// Table of Node tables, for each possible transformation there can be a different Node table.
-      std::map<uint64_t, LightArray<Node*>*>* sub_tables;
+      std::map<uint64_t, NodeTable<Node*>*>* sub_tables;
 
       /// Table of nodes.
-      LightArray<Node*>* nodes;
+      NodeTable<Node*>* nodes;
 
       /// Current Node.
       Node* cur_node;
 
       /// Nodes for the overflow sub-element transformation.
-      LightArray<Node*>* overflow_nodes;
+      NodeTable<Node*>* overflow_nodes;
 
       /// With changed sub-element mapping, there comes the need for a change of the current
       /// Node table nodes.
@@ -227,8 +286,25 @@ namespace Hermes
 
       int max_mem;      ///< peak memory usage
 
+      /// The MemoryAccounting category the allocated tables (including the pooled ones) are reported in,
+      /// set by the constructors of the derived classes.
+      int memory_category;
+
       Node* new_node(int mask, int num_points); ///< allocates a new Node structure
 
+      void delete_node(Node* node); ///< releases a Node structure allocated by new_node() (of any function)
+
+      /// Smallest allocation of the nodes and number of size classes (powers of two) of the pooled nodes.
+      static const int H2D_NODE_MIN_SIZE = 256;
+      static const int H2D_NODE_SIZE_CLASSES = 16;
+
+      /// Nodes released by delete_node() to be reused by new_node(), by size classes, linked through values[0][0].
+      /// The nodes are allocated with malloc(), so a node may be released to another function than the one it comes from.
+      Node* free_nodes[H2D_NODE_SIZE_CLASSES];
+
+      /// Releases the memory of the nodes in free_nodes.
+      void free_node_pool();
+
       virtual void  handle_overflow_idx() = 0;
 
       void replace_cur_node(Node* node);
@@ -263,6 +339,7 @@ namespace Hermes
       friend HERMES_API Geom<double>* init_geom_vol(RefMap *rm, const int order);
       friend HERMES_API Geom<double>* init_geom_surf(RefMap *rm, SurfPos* surf_pos, const int order);
       friend HERMES_API Func<double>* init_fn(PrecalcShapeset *fu, RefMap *rm, const int order);
+      friend HERMES_API Func<double>** init_fns(PrecalcShapeset *fu, RefMap *rm, const int order, unsigned int count, int* idx);
       template<typename T> friend HERMES_API Func<T>* init_fn(MeshFunction<T>*fu, const int order);
     };
   }
@@ -109,6 +109,10 @@ namespace Hermes
       /// Internal.
       virtual void pop_transform();
 
+      /// See Transformable::set_transform.
+      /// Internal.
+      virtual void set_transform(uint64_t idx);
+
       /// Set the reference mapping.
       /// Internal.
       void set_refmap(RefMap* refmap_to_set);
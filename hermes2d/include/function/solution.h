@@ -31,6 +31,8 @@ namespace Hermes
     ///
     class Quad2DCheb;
 
+    template<typename Scalar> class CompactSolution;
+
     enum SolutionType {
       HERMES_UNDEF = -1,
       HERMES_SLN = 0,
@@ -99,8 +101,18 @@ namespace Hermes
 
       /// Loads the solution from a file previously created by Solution::save(). This completely
       /// restores the solution in the memory.
+      /// Files created by save_binary() are recognized and loaded by load_binary().
       void load(const char* filename, Space<Scalar>* space);
 
+      /// Saves the solution in the binary format (see BinaryFile): the monomial coefficients and the element
+      /// orders as raw arrays, written directly from the memory. Much smaller and faster than save(), but only
+      /// for the solutions from a coefficient vector, and readable only on machines with the same byte order.
+      virtual void save_binary(const char* filename) const;
+
+      /// Loads the solution from a file created by save_binary(), 'space' has to be the one on the same mesh as
+      /// when saving (e.g. loaded by Space::load()).
+      void load_binary(const char* filename, Space<Scalar>* space);
+
       /// Returns solution value or derivatives at element e, in its reference domain point (xi1, xi2).
       /// 'item' controls the returned value: 0 = value, 1 = dx, 2 = dy, 3 = dxx, 4 = dyy, 5 = dxy.
       /// NOTE: This function should be used for postprocessing only, it is not effective
@@ -127,8 +139,14 @@ namespace Hermes
       /// slow. Prefer Solution::get_ref_value if possible.
       virtual Func<Scalar>* get_pt_value(double x, double y, Element* e = NULL);
 
+      /// Returns solution values and derivatives at n physical domain points, the point i being the entry i
+      /// of the returned Func (with the same items as get_pt_value()). The element of the previous point is
+      /// tried first, the others are found through the point location index of the mesh.
+      /// \param[out] found Optional array of n flags, false for the points outside of the domain (their values are zero).
+      Func<Scalar>* get_pt_values(const double* x, const double* y, int n, bool* found = NULL);
+
       /// Multiplies the function represented by this class by the given coefficient.
-      void multiply(Scalar coef);
+      virtual void multiply(Scalar coef);
 
       /// Returns solution type.
       inline SolutionType get_type() const { return sln_type; };
@@ -171,8 +189,15 @@ namespace Hermes
       /// Internal.
       virtual void set_active_element(Element* e);
 
+      /// A lightweight copy for the evaluation in another thread: the coefficient arrays (monomial coefficients,
+      /// element orders) are shared with this solution, only the evaluation state (the active element, the transformation,
+      /// the tables of the precalculated values) is of the clone. The shared arrays are read-only, they are freed with the
+      /// last of the solutions sharing them, and a solution changing them (e.g. by vector_to_solution()) gets its own ones.
       virtual MeshFunction<Scalar>* clone() const;
 
+      /// True if the coefficient arrays are shared with other solutions, see clone().
+      bool shares_coeffs() const;
+
       static void set_static_verbose_output(bool verbose);
 
       void set_type(SolutionType type) { sln_type = type; };
@@ -212,7 +237,7 @@ namespace Hermes
       /// a table from the lowest layer.
       /// The highest layer (in contrast to the PrecalcShapeset class) is represented
       /// here only by this array.
-      std::map<uint64_t, LightArray<struct Function<Scalar>::Node*>*>* tables[H2D_MAX_QUADRATURES][H2D_SOLUTION_ELEMENT_CACHE_SIZE];
+      std::map<uint64_t, NodeTable<struct Function<Scalar>::Node*>*>* tables[H2D_MAX_QUADRATURES][H2D_SOLUTION_ELEMENT_CACHE_SIZE];
 
       Element* elems[H2D_MAX_QUADRATURES][H2D_SOLUTION_ELEMENT_CACHE_SIZE];
       int cur_elem, oldest[H2D_SOLUTION_ELEMENT_CACHE_SIZE];
@@ -224,6 +249,20 @@ namespace Hermes
       int num_coeffs, num_elems;
       int num_dofs;
 
+      /// The number of the solutions sharing mono_coeffs, elem_coeffs and elem_orders, NULL if they are not shared.
+      mutable int* shared_coeffs_references;
+      /// True for a clone using the arrays of another solution (these are reported to MemoryAccounting by that solution).
+      bool coeffs_borrowed;
+
+      /// Makes this solution use the coefficient arrays of sln, see clone().
+      void share_coeffs(const Solution<Scalar>* sln);
+
+      /// Frees the coefficient arrays, or just stops sharing them if they are used by other solutions.
+      void release_coeffs();
+
+      /// Makes a copy of the shared coefficient arrays before changing them in place.
+      void make_coeffs_unique();
+
       void transform_values(int order, struct Function<Scalar>::Node* node, int newmask, int oldmask, int np);
 
       virtual void precalculate(int order, int mask);
@@ -232,10 +271,37 @@ namespace Hermes
 
       Scalar* dxdy_buffer;
 
-      double** calc_mono_matrix(int o, int*& perm);
+      /// Coefficients of the physical gradient (H1 space, element with a constant reference map) if not NULL.
+      /// The gradient on any sub-element is then evaluated directly, without the transformation by the reference map
+      /// (and its update) in transform_values().
+      Scalar* phys_grad_coeffs[2];
+
+      static double** calc_mono_matrix(int mode, int o, int*& perm);
+
+      /// Monomial coefficients of the given component on the element e.
+      virtual Scalar* get_mono_coeffs(Element* e, int component);
+
+      /// The degree of the monomial expansion of a function from 'space' on the element e.
+      static int calc_mono_order(const Space<Scalar>* space, Element* e);
+
+      /// Expresses the solution on the element e as a linear combination of monomials of the order o
+      /// (see calc_mono_order()), the coefficients of the components are stored in 'mono' one after another.
+      /// The coefficient of the DOF 'dof' is coeff_vec[(dof - space->first_dof) / stride + start_index].
+      /// pss has to be set to the Chebyshev points.
+      void calc_mono_coeffs(const Space<Scalar>* space, PrecalcShapeset* pss, const Scalar* coeff_vec, bool add_dir_lift,
+        int start_index, int stride, Element* e, int o, Scalar* mono);
+
+      /// Monomial coefficients of the order o (of all components one after another) of the shape function 'index'
+      /// on the reference domain of e. Calculated by pss (set to the Chebyshev points) at the first call, thread-safe.
+      static double* get_shape_mono_coeffs(PrecalcShapeset* pss, Element* e, int o, int index);
 
       void init_dxdy_buffer();
 
+      /// Reports the size of the coefficient arrays to MemoryAccounting, after any change of them.
+      void update_memory_accounting();
+      /// The bytes of the coefficient arrays last reported.
+      size_t accounted_memory;
+
       void free_tables();
 
       Element* e_last; ///< last visited element when getting solution values at specific points
@@ -256,6 +322,80 @@ namespace Hermes
       template<typename T> friend class RefinementSelectors::H1ProjBasedSelector;
       template<typename T> friend class RefinementSelectors::L2ProjBasedSelector;
       template<typename T> friend class RefinementSelectors::HcurlProjBasedSelector;
+      template<typename T> friend class CompactSolution;
+      template<typename T> friend class TransferredFunction;
+    };
+
+    /// @ingroup meshFunctions
+    /// \brief Solution keeping just the coefficient vector.
+    ///
+    /// Unlike Solution, which expresses the solution on all elements as monomials in advance, CompactSolution
+    /// stores only the coefficients of the DOFs of the space and calculates the monomial coefficients when an element
+    /// is visited, keeping them for the last H2D_COMPACT_SOLUTION_CACHE_SIZE elements. Its memory is thus roughly
+    /// that of the coefficient vector, e.g. for keeping several previous time levels. The space is referenced, so it
+    /// must be neither changed nor deleted while the solution is used.
+    ///
+    /// CompactSolution can be used wherever a Solution is, e.g. with Solution::vector_to_solution().
+    /// Copying a Solution into it (see copy()) makes an ordinary (non-compact) solution of it.
+    template<typename Scalar>
+    class HERMES_API CompactSolution : public Solution<Scalar>
+    {
+    public:
+      CompactSolution();
+      CompactSolution(const Space<Scalar>* space, const Scalar* coeff_vec, bool add_dir_lift = true, int start_index = 0);
+      virtual ~CompactSolution();
+
+      /// State querying helpers.
+      inline std::string getClassName() const { return "CompactSolution"; }
+
+      /// True if the solution keeps just the coefficient vector (i.e. it was set from a coefficient vector).
+      bool is_compact() const;
+
+      virtual void copy(const Solution<Scalar>* sln);
+
+      virtual MeshFunction<Scalar>* clone() const;
+
+      virtual void multiply(Scalar coef);
+
+      /// Saves the solution expanded to all elements, see expand().
+      virtual void save(const char* filename) const;
+      virtual void save_binary(const char* filename) const;
+
+      /// Sets 'target' to the equivalent ordinary Solution (with the monomial coefficients on all elements).
+      void expand(Solution<Scalar>* target) const;
+
+    protected:
+      virtual void free();
+
+      /// Frees the coefficient vector and the cache.
+      void free_compact();
+
+      /// Sets everything but the coefficient vector (which is allocated).
+      void init_compact(const Space<Scalar>* space, bool add_dir_lift);
+
+      using Solution<Scalar>::set_coeff_vector;
+      virtual void set_coeff_vector(const Space<Scalar>* space, PrecalcShapeset* pss, const Scalar* coeffs, bool add_dir_lift, int start_index);
+
+      virtual Scalar* get_mono_coeffs(Element* e, int component);
+
+      const Space<Scalar>* space;
+      /// Seq of the space when the solution was set.
+      int space_seq;
+
+      /// Coefficients of the DOFs of the space, the DOF 'dof' being at (dof - space->first_dof) / space->stride.
+      Scalar* coeffs;
+      bool add_dir_lift;
+      /// Applied to the monomial coefficients when calculated (see multiply()).
+      Scalar multiplicator;
+
+      PrecalcShapeset* pss;
+
+      /// Number of the monomial coefficients (all components) of one cached element.
+      int slot_size;
+      /// Ids of the elements cached in the slots (of slot_size coefficients in Solution::mono_coeffs), -1 for an empty slot.
+      int cached_elems[H2D_COMPACT_SOLUTION_CACHE_SIZE];
+      /// The slot to be replaced next.
+      int next_slot;
     };
   }
 }
@@ -0,0 +1,104 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef __H2D_SOLUTION_SERIES_H
+#define __H2D_SOLUTION_SERIES_H
+
+#include "solution.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    /// @ingroup meshFunctions
+    /// \brief A time series of the solutions saved on one space (by Solution::save() or Solution::save_binary()),
+    /// for the postprocessing of many time steps.
+    ///
+    /// All the solutions are loaded on the given space, i.e. they all refer to its mesh, nothing is copied per file.
+    /// load() reads a range of the files in parallel (Hermes2DApi numThreads), get() loads a single file on demand.
+    /// At most max_loaded solutions are kept in memory, the least recently used ones are freed when others are loaded,
+    /// so that e.g. the norms of all the time steps can be evaluated in the memory of a few of them.
+    ///
+    /// Typical usage:
+    /// Hermes::Hermes2D::SolutionSeries<double> series(&space, 8);
+    /// for(int i = 0; i < num_steps; i++)
+    ///   series.add(file_names[i], times[i]);
+    /// for(unsigned int i = 0; i < series.size(); i += 8)
+    /// {
+    ///   series.load(i, 8);
+    ///   for(unsigned int j = i; j < std::min(i + 8, series.size()); j++)
+    ///     norms[j] = Hermes::Hermes2D::Global<double>::calc_norm(series.get(j), HERMES_H1_NORM);
+    /// }
+    template<typename Scalar>
+    class HERMES_API SolutionSeries : public Hermes::Mixins::Loggable
+    {
+    public:
+      /// @param[in] space The space of all the files (not deleted by the series), has to stay unchanged while the series is used.
+      /// @param[in] max_loaded The maximum number of the solutions in memory, 0 for no limit.
+      SolutionSeries(Space<Scalar>* space, unsigned int max_loaded = 0);
+      virtual ~SolutionSeries();
+
+      /// Appends a file to the series, nothing is loaded yet.
+      void add(const char* file_name, double time = 0.0);
+
+      /// The number of the files in the series.
+      unsigned int size() const;
+
+      double get_time(unsigned int index) const;
+      const char* get_file_name(unsigned int index) const;
+
+      /// Loads the files [first, first + count) that are not loaded yet, in parallel.
+      /// @param[in] count The number of the files, the ones past the end of the series are ignored; 0 for all till the end.
+      /// The range has to fit into max_loaded.
+      void load(unsigned int first = 0, unsigned int count = 0);
+
+      /// The solution of the file, loaded if it is not in memory.
+      /// The solution is owned by the series, and valid until it is freed to load others (see max_loaded) or by release().
+      Solution<Scalar>* get(unsigned int index);
+
+      /// True if the solution of the file is in memory.
+      bool is_loaded(unsigned int index) const;
+
+      /// Frees the solution of the file (it is loaded again by get() or load()).
+      void release(unsigned int index);
+      /// Frees all the solutions.
+      void release_all();
+
+      /// The number of the solutions in memory.
+      unsigned int get_num_loaded() const;
+
+    protected:
+      struct Entry
+      {
+        std::string file_name;
+        double time;
+        Solution<Scalar>* solution;
+        /// The value of use_counter when the solution was last used.
+        unsigned long last_use;
+      };
+
+      /// Frees the least recently used solutions not in [first, first + count), so that count more fit into max_loaded.
+      void make_room(unsigned int first, unsigned int count, unsigned int num_to_load);
+
+      Space<Scalar>* space;
+      unsigned int max_loaded;
+      std::vector<Entry> entries;
+      unsigned int num_loaded;
+      unsigned long use_counter;
+    };
+  }
+}
+
+#endif
@@ -53,8 +53,10 @@ namespace Hermes
       Element* get_active_element() const;
 
       /// Sets the current transform at once as if it was created by multiple calls to push_transform().
+      /// The composite transformation is taken from the shared table of sub-element transforms
+      /// (see get_composite_transform()), only the top of the matrix stack is filled.
       /// \param idx[in] The number of the sub-element, as returned by get_transform().
-      void set_transform(uint64_t idx);
+      virtual void set_transform(uint64_t idx);
 
       /// \return The current transform index.
       uint64_t get_transform() const;
@@ -85,6 +87,15 @@ namespace Hermes
       /// Empties the stack, loads identity transform.
       void reset_transform();
 
+      /// Sets the transform by calling push_transform() for every level of idx, for the classes
+      /// whose push_transform() does more than transforming this instance (filters).
+      void replay_transform(uint64_t idx);
+
+      /// Calculates the composite transformation of the sub-element idx of an element of the mode.
+      /// The levels are composed by H2D_TRF_CACHE_LEVELS at once from a table shared by all the
+      /// instances, the result being identical to multiplying the matrices level by level.
+      static void get_composite_transform(ElementMode2D mode, uint64_t idx, Trf& trf);
+
       /// \return The jacobian of the current transformation matrix.
       inline double get_transform_jacobian() const { return ctm->m[0] * ctm->m[1]; }
 
@@ -98,6 +109,14 @@ namespace Hermes
       static void pop_transforms(std::set<Transformable *>& transformables);
       static const unsigned int H2D_MAX_TRN_LEVEL = 15;
 
+      /// Number of levels of the transforms in the shared table, which holds all sub_idx < H2D_TRF_CACHE_SIZE.
+      static const unsigned int H2D_TRF_CACHE_LEVELS = 4;
+      static const unsigned int H2D_TRF_CACHE_SIZE = 4681;
+
+      class TrfCache;
+      /// The composite transforms of all the sub-elements up to H2D_TRF_CACHE_LEVELS deep, for both modes.
+      static TrfCache trf_cache;
+
       /// The active element.
       Element* element;
 
@@ -114,6 +133,9 @@ namespace Hermes
       Trf stack[21];
       /// Stack top.
       unsigned int top;
+      /// The stack entries up to this level are up to date, the ones between it and top
+      /// (skipped by set_transform()) are recalculated when they are popped to.
+      unsigned int valid_top;
 
       template<typename T> friend class KellyTypeAdapt;
       template<typename T> friend class Adapt;
@@ -125,6 +147,7 @@ namespace Hermes
       template<typename T> friend class NeighborSearch;
       friend class CurvMap;
       friend class Traverse;
+      friend class TraverseStateList;
       friend class Views::Vectorizer;
     };
   }
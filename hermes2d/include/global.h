@@ -36,6 +36,11 @@
 #define H2D_SOLUTION_ELEMENT_CACHE_SIZE 2 ///< A maximum number of vertices of an element.
 #define H2D_MAX_NODE_ID 10000000
 #define H2D_MAX_SOLUTION_COMPONENTS 2
+#define H2D_COMPACT_SOLUTION_CACHE_SIZE 32 ///< A number of elements with the monomial coefficients kept by a CompactSolution.
+#define H2D_SIMD_DOUBLES 4 ///< A number of doubles in one SIMD register, used to pad and align pooled function values.
+#define H2D_DEFAULT_CACHE_SIZE_LIMIT 1024 ///< A default limit (in MB) of the memory used by the assembling cache of one DiscreteProblem.
+#define H2D_DEFAULT_PRECALC_CACHE_SIZE_LIMIT 256 ///< A default limit (in MB) of the memory used by the precalculated tables of one PrecalcShapeset.
+#define H2D_ASSEMBLING_CHUNK_STATES 512 ///< A number of states assembled between the trimmings of the cache with Hermes2DApiParam::assemblingMemoryLimit.
 
 #define HERMES_ONE NULL
 #define HERMES_DEFAULT_FUNCTION NULL
@@ -129,6 +134,17 @@ namespace Hermes
       static double calc_abs_errors(Hermes::vector<Solution<Scalar>*> slns1, Hermes::vector<Solution<Scalar>*> slns2);
       static double calc_rel_errors(Hermes::vector<Solution<Scalar>*> slns1, Hermes::vector<Solution<Scalar>*> slns2);
 
+      /// Any number of norms and absolute errors at once: results[i] is the norm (norm_types[i], see calc_norm()) of slns1[i]
+      /// if slns2[i] is NULL, of slns1[i] - slns2[i] otherwise. All of them come from one traversal of the union of the meshes,
+      /// in parallel over its states. The contributions of the states are summed in the order of the traversal, so the results
+      /// do not depend on the number of threads. The functions are cloned for the threads, if they cannot be, the evaluation runs
+      /// on a single thread.
+      /// With num_ranks > 1, the call is made by num_ranks (MPI) processes and the process rank evaluates only its part of the mesh
+      /// of slns1[0] (Mesh::partition()), the squares are then summed over the processes (Hermes::Algebra::sum_values_over_processes()),
+      /// so that every process gets the results without holding the values of the functions elsewhere than in its part.
+      static void calc_norms_and_errors(Hermes::vector<MeshFunction<Scalar>*> slns1, Hermes::vector<MeshFunction<Scalar>*> slns2,
+        Hermes::vector<int> norm_types, double* results, int rank = 0, int num_ranks = 1);
+
       static double error_fn_l2(MeshFunction<Scalar>* sln1, MeshFunction<Scalar>* sln2, RefMap* ru, RefMap* rv);
       static double norm_fn_l2(MeshFunction<Scalar>* sln, RefMap* ru);
 
@@ -145,6 +161,13 @@ namespace Hermes
       static double norm_fn_hdiv(MeshFunction<Scalar>* sln, RefMap* ru);
 
       static double get_l2_norm(Vector<Scalar>* vec);
+
+    protected:
+      /// The norm corresponding to the space of the solution.
+      static int get_space_norm_type(Solution<Scalar>* sln);
+
+      /// The contribution of the current state to the square of the norm (sln2 NULL) or of the error.
+      static double calc_state_norm_or_error(int norm_type, MeshFunction<Scalar>* sln1, MeshFunction<Scalar>* sln2);
     };
 
     /// Projection norms.
@@ -163,6 +186,15 @@ namespace Hermes
       HERMES_MODE_TRIANGLE = 0,
       HERMES_MODE_QUAD = 1
     };
+
+    /// Orderings of the DOFs of a Space.
+    /// See Space::set_dof_ordering().
+    enum DofOrderingType
+    {
+      HERMES_DOF_ORDERING_ELEMENTS,     ///< Vertex, edge and bubble functions, each in the order of the elements.
+      HERMES_DOF_ORDERING_RCM,          ///< Reverse Cuthill-McKee, small bandwidth (iterative solvers, SpMV).
+      HERMES_DOF_ORDERING_NESTED_DISSECTION ///< Nested dissection, small fill-in of direct solvers.
+    };
   }
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,119 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef __H2D_HDG_SOLVER_H
+#define __H2D_HDG_SOLVER_H
+
+#include "space/space_trace.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    /// @ingroup userSolvingAPI
+    /// \brief Hybridized DG solver of the advection-diffusion problem -div(epsilon grad u) + b.grad u = f (div b = 0).
+    ///
+    /// The element unknowns u are in an L2Space, the unknowns coupling the elements are the traces lambda on the edges (EdgeTraceSpace).
+    /// On every element K (the hybridized interior penalty method with the upwind advective flux):
+    /// (epsilon grad u, grad v)_K - (u, b.grad v)_K - <epsilon du/dn, v - mu> - <epsilon dv/dn, u - lambda> + <tau (u - lambda), v - mu>
+    /// + <b.n lambda + max(b.n, 0) (u - lambda), v - mu> = (f, v)_K, with <.,.> on the boundary of K and tau = penalty epsilon (p + 1)^2 / h_K.
+    /// The element unknowns couple only to the traces of the own element, so they are eliminated element by element
+    /// (the local Schur complements, in parallel) and only the system of the traces is solved by the linear solver
+    /// (Hermes::HermesCommonApiParam::matrixSolverType), then the element unknowns are recovered (in parallel).
+    /// The boundary edges without an essential condition (EdgeTraceSpace::add_essential_bc()) have the zero diffusive flux.
+    ///
+    /// Typical usage:<br>
+    /// Hermes::Hermes2D::L2Space<double> space(&mesh, 3);<br>
+    /// Hermes::Hermes2D::HDGSolver<double> solver(&space);<br>
+    /// solver.set_diffusivity(1e-2);<br>
+    /// solver.set_advection(1.0, 0.5);<br>
+    /// solver.set_source(&f);<br>
+    /// solver.get_trace_space()->add_essential_bc("Inlet", &g);<br>
+    /// solver.solve();<br>
+    /// Hermes::Hermes2D::Solution<double>::vector_to_solution(solver.get_sln_vector(), &space, &sln);<br>
+    template<typename Scalar>
+    class HERMES_API HDGSolver : public Hermes::Mixins::Loggable, public Hermes::Mixins::TimeMeasurable
+    {
+    public:
+      HDGSolver(const L2Space<Scalar>* space);
+      virtual ~HDGSolver();
+
+      void set_diffusivity(double epsilon);
+      void set_advection(double b_x, double b_y);
+      /// NULL for no source (the default).
+      void set_source(Hermes2DFunction<Scalar>* source);
+      /// The coefficient of the penalty of the jumps between the elements and the traces, the default is 10.
+      void set_penalty(double penalty);
+
+      EdgeTraceSpace<Scalar>* get_trace_space();
+
+      /// Assembles the system of the traces, solves it and recovers the element unknowns.
+      void solve();
+
+      /// The coefficients of the element unknowns (of the L2Space), valid after solve().
+      Scalar* get_sln_vector();
+      /// The coefficients of the traces (of get_trace_space()), valid after solve().
+      Scalar* get_trace_vector();
+
+      /// The trace system of the last solve().
+      SparseMatrix<Scalar>* get_matrix();
+      Vector<Scalar>* get_rhs();
+
+    protected:
+      /// The data of an element kept for the recovery.
+      struct LocalSystem
+      {
+        /// The DOFs of the element unknowns.
+        std::vector<int> dofs;
+        /// The DOFs of the traces of the element (-1 for the essential ones) and their values if essential.
+        std::vector<int> trace_dofs;
+        std::vector<Scalar> trace_values;
+        /// (A_uu)^{-1} A_ul, [u * trace_dofs.size() + l], and (A_uu)^{-1} f_u.
+        double* coupling;
+        Scalar* lift;
+      };
+
+      /// Calculates the local system of the element, eliminates the element unknowns, adds the Schur complement into the trace system.
+      void assemble_element(Element* e, LocalSystem& local, PrecalcShapeset* pss, RefMap* refmap);
+
+      /// Adds the terms of the edge of the element.
+      /// @param[in] first, count The local traces of the edge.
+      void assemble_edge(Element* e, int edge, int order, double tau, int first, int count, AsmList<Scalar>& al,
+        PrecalcShapeset* pss, RefMap* refmap, double** a_uu, double** a_ul, double** a_lu, double** a_ll);
+
+      void free_local_systems();
+
+      const L2Space<Scalar>* space;
+      EdgeTraceSpace<Scalar> trace_space;
+
+      double epsilon;
+      double b_x, b_y;
+      Hermes2DFunction<Scalar>* source;
+      double penalty;
+
+      SparseMatrix<Scalar>* matrix;
+      Vector<Scalar>* rhs;
+      LinearMatrixSolver<Scalar>* matrix_solver;
+
+      /// By the position in the list of the active elements.
+      std::vector<LocalSystem> local_systems;
+
+      Scalar* sln_vector;
+      Scalar* trace_vector;
+
+      Hermes::Exceptions::ParallelStatus assembling_status;
+    };
+  }
+}
+#endif
@@ -23,7 +23,12 @@
 #include "newton_solver.h"
 #include "picard_solver.h"
 #include "linear_solver.h"
+#include "parameter_sweep.h"
+#include "static_condensation.h"
+#include "hdg_solver.h"
 #include "calculation_continuity.h"
+#include "output_queue.h"
+#include "in_situ_output.h"
 
 #include "boundary_conditions/essential_boundary_conditions.h"
 
@@ -31,13 +36,17 @@
 
 #include "api2d.h"
 #include "mixins2d.h"
+#include "binary_file.h"
 
 #include "mesh/mesh.h"
 #include "mesh/mesh_reader.h"
 #include "mesh/mesh_reader_h2d.h"
+#include "mesh/mesh_reader_h2d_binary.h"
+#include "mesh/mesh_refinement_log.h"
 #include "mesh/mesh_reader_h2d_xml.h"
 #include "mesh/mesh_reader_h1d_xml.h"
 #include "mesh/mesh_reader_exodusii.h"
+#include "mesh/mesh_snapshot.h"
 
 #include "quadrature/quad.h"
 #include "quadrature/quad_all.h"
@@ -46,11 +55,16 @@
 #include "space/space_hcurl.h"
 #include "space/space_l2.h"
 #include "space/space_hdiv.h"
+#include "space/space_trace.h"
+#include "space/space_snapshot.h"
+#include "space/dof_ordering.h"
 
 #include "shapeset/shapeset_h1_all.h"
 #include "shapeset/shapeset_hc_all.h"
 #include "shapeset/shapeset_hd_all.h"
 #include "shapeset/shapeset_l2_all.h"
+#include "shapeset/shapeset_tabulated.h"
+#include "shapeset/reference_integral_table.h"
 
 #include "mesh/refmap.h"
 #include "mesh/traverse.h"
@@ -58,6 +72,7 @@
 #include "weakform/weakform.h"
 #include "discrete_problem.h"
 #include "discrete_problem_linear.h"
+#include "element_batch_kernel.h"
 #include "forms.h"
 
 #include "integrals/h1.h"
@@ -67,6 +82,7 @@
 
 #include "function/exact_solution.h"
 #include "function/solution.h"
+#include "function/solution_series.h"
 #include "function/mesh_function.h"
 #include "function/filter.h"
 
@@ -80,6 +96,7 @@
 #include "views/stream_view.h"
 #include "views/vector_base_view.h"
 #include "views/vector_view.h"
+#include "views/image_renderer.h"
 
 #include "mesh/refinement_type.h"
 #include "mesh/element_to_refine.h"
@@ -93,12 +110,17 @@
 
 #include "adapt/adapt.h"
 #include "adapt/kelly_type_adapt.h"
+#include "adapt/goal_oriented_adapt.h"
+#include "adapt/hierarchical_estimator.h"
 #include "neighbor.h"
 #include "projections/localprojection.h"
+#include "projections/mesh_transfer.h"
 #include "projections/ogprojection.h"
 #include "projections/ogprojection_nox.h"
 
 #include "runge_kutta.h"
+#include "parareal.h"
+#include "flux_corrected_transport.h"
 #include "spline.h"
 
 #if defined (AGROS)
@@ -106,9 +128,12 @@
 #else
 #include "weakform_library/weakforms_elasticity.h"
 #include "weakform_library/weakforms_h1.h"
+#include "weakform_library/weakforms_dg.h"
 #include "weakform_library/weakforms_hcurl.h"
 #include "weakform_library/weakforms_maxwell.h"
 #include "weakform_library/weakforms_neutronics.h"
+#include "weakform_library/weakforms_expression.h"
+#include "weakform_library/weakforms_integrand.h"
 #endif
 
 #include "doxygen_first_page.h"
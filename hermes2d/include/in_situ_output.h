@@ -0,0 +1,106 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+/*! \file in_situ_output.h
+\brief In-situ output of the linearized solutions to a consumer in the same process, without files.
+*/
+#ifndef __H2D_IN_SITU_OUTPUT_H
+#define __H2D_IN_SITU_OUTPUT_H
+
+#include "global.h"
+#include "function/solution.h"
+#include "views/linearizer.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    /// @ingroup userSolvingAPI
+    /// \brief A linearized field of an InSituFrame.
+    /// The arrays are the buffers of a Linearizer, not copies, valid only during InSituConsumer::consume().
+    struct InSituField
+    {
+      std::string name;
+      int num_vertices;
+      /// (x, y, value) triplets.
+      const double3* vertices;
+      int num_triangles;
+      const int3* triangles;
+      const int* triangle_markers;
+      int num_edges;
+      const int2* edges;
+      const int* edge_markers;
+      double min_value, max_value;
+    };
+
+    /// @ingroup userSolvingAPI
+    /// \brief The state handed to an InSituConsumer.
+    struct InSituFrame
+    {
+      double time;
+      /// The number of the frame, counted from 0.
+      unsigned int number;
+      Hermes::vector<InSituField> fields;
+    };
+
+    /// @ingroup userSolvingAPI
+    /// \brief An in-situ analysis or visualization (e.g. an adaptor of a visualization library, or a socket streamer).
+    class HERMES_API InSituConsumer
+    {
+    public:
+      virtual ~InSituConsumer() {};
+
+      /// Called with every frame, the data has to be copied if needed after the call.
+      virtual void consume(const InSituFrame* frame) = 0;
+    };
+
+    /// @ingroup userSolvingAPI
+    /// \brief Hands the linearized solutions to an InSituConsumer, when a solver or a time stepping finishes.
+    ///
+    /// Attached to a NewtonSolver, PicardSolver, LinearSolver or RungeKutta by attach_output(), it linearizes either
+    /// the functions given by set_functions() (e.g. the solutions the RungeKutta writes to), or the solutions made from
+    /// the solution vector of the solver on its spaces. The time of the frame is the one of the source
+    /// (the new time level for the RungeKutta). output() makes a frame at any point of the computation, e.g. of an adaptivity loop.
+    class HERMES_API InSituOutput : public Hermes::Mixins::OutputCallback, public Hermes::Mixins::Loggable
+    {
+    public:
+      /// @param[in] consumer Not deleted by this class.
+      InSituOutput(InSituConsumer* consumer, int item = H2D_FN_VAL_0, double eps = Views::HERMES_EPS_NORMAL);
+      virtual ~InSituOutput();
+
+      /// The functions (named as the fields) linearized in every frame; not deleted by this class.
+      void set_functions(Hermes::vector<MeshFunction<double>*> functions, Hermes::vector<std::string> names);
+
+      /// The linearizer of the field i (created by the first frame with it), e.g. for freeze_subdivision() or set_decimation().
+      Views::Linearizer* get_linearizer(unsigned int i);
+
+      /// Makes a frame of the functions given by set_functions().
+      void output(double time = 0.0);
+
+      virtual void on_finish(Hermes::Mixins::OutputAttachable* source);
+
+    protected:
+      void output(Hermes::vector<MeshFunction<double>*> functions, Hermes::vector<std::string> names, double time);
+
+      InSituConsumer* consumer;
+      int item;
+      double eps;
+      Hermes::vector<MeshFunction<double>*> functions;
+      Hermes::vector<std::string> names;
+      Hermes::vector<Views::Linearizer*> linearizers;
+      unsigned int frame_number;
+    };
+  }
+}
+#endif
@@ -54,20 +54,38 @@ namespace Hermes
     template<typename Real, typename Scalar>
     Scalar int_u_v(int n, double *wt, Func<Real> *u, Func<Real> *v)
     {
-      Scalar result = Scalar(0);
-      for (int i = 0; i < n; i++)
-        result += wt[i] * u->val[i] * v->val[i];
-      return result;
+      // Four independent partial sums, so that the loop can be vectorized.
+      Scalar result0 = Scalar(0), result1 = Scalar(0), result2 = Scalar(0), result3 = Scalar(0);
+      int i = 0;
+      for (; i + 3 < n; i += 4)
+      {
+        result0 += wt[i] * u->val[i] * v->val[i];
+        result1 += wt[i + 1] * u->val[i + 1] * v->val[i + 1];
+        result2 += wt[i + 2] * u->val[i + 2] * v->val[i + 2];
+        result3 += wt[i + 3] * u->val[i + 3] * v->val[i + 3];
+      }
+      for (; i < n; i++)
+        result0 += wt[i] * u->val[i] * v->val[i];
+      return (result0 + result1) + (result2 + result3);
     }
 
     // For residual forms.
     template<typename Real, typename Scalar>
     Scalar int_u_ext_v(int n, double *wt, Func<Scalar> *u_ext, Func<Real> *v)
     {
-      Scalar result = Scalar(0);
-      for (int i = 0; i < n; i++)
-        result += wt[i] * u_ext->val[i] * v->val[i];
-      return result;
+      // Four independent partial sums, so that the loop can be vectorized.
+      Scalar result0 = Scalar(0), result1 = Scalar(0), result2 = Scalar(0), result3 = Scalar(0);
+      int i = 0;
+      for (; i + 3 < n; i += 4)
+      {
+        result0 += wt[i] * u_ext->val[i] * v->val[i];
+        result1 += wt[i + 1] * u_ext->val[i + 1] * v->val[i + 1];
+        result2 += wt[i + 2] * u_ext->val[i + 2] * v->val[i + 2];
+        result3 += wt[i + 3] * u_ext->val[i + 3] * v->val[i + 3];
+      }
+      for (; i < n; i++)
+        result0 += wt[i] * u_ext->val[i] * v->val[i];
+      return (result0 + result1) + (result2 + result3);
     }
 
     template<typename Real, typename Scalar>
@@ -120,20 +138,38 @@ namespace Hermes
     template<typename Real, typename Scalar>
     Scalar int_grad_u_grad_v(int n, double *wt, Func<Real> *u, Func<Real> *v)
     {
-      Scalar result = Scalar(0);
-      for (int i = 0; i < n; i++)
-        result += wt[i] * (u->dx[i] * v->dx[i] + u->dy[i] * v->dy[i]);
-      return result;
+      // Four independent partial sums, so that the loop can be vectorized.
+      Scalar result0 = Scalar(0), result1 = Scalar(0), result2 = Scalar(0), result3 = Scalar(0);
+      int i = 0;
+      for (; i + 3 < n; i += 4)
+      {
+        result0 += wt[i] * (u->dx[i] * v->dx[i] + u->dy[i] * v->dy[i]);
+        result1 += wt[i + 1] * (u->dx[i + 1] * v->dx[i + 1] + u->dy[i + 1] * v->dy[i + 1]);
+        result2 += wt[i + 2] * (u->dx[i + 2] * v->dx[i + 2] + u->dy[i + 2] * v->dy[i + 2]);
+        result3 += wt[i + 3] * (u->dx[i + 3] * v->dx[i + 3] + u->dy[i + 3] * v->dy[i + 3]);
+      }
+      for (; i < n; i++)
+        result0 += wt[i] * (u->dx[i] * v->dx[i] + u->dy[i] * v->dy[i]);
+      return (result0 + result1) + (result2 + result3);
     }
 
     // For residual forms.
     template<typename Real, typename Scalar>
     Scalar int_grad_u_ext_grad_v(int n, double *wt, Func<Scalar> *u_ext, Func<Real> *v)
     {
-      Scalar result = Scalar(0);
-      for (int i = 0; i < n; i++)
-        result += wt[i] * (u_ext->dx[i] * v->dx[i] + u_ext->dy[i] * v->dy[i]);
-      return result;
+      // Four independent partial sums, so that the loop can be vectorized.
+      Scalar result0 = Scalar(0), result1 = Scalar(0), result2 = Scalar(0), result3 = Scalar(0);
+      int i = 0;
+      for (; i + 3 < n; i += 4)
+      {
+        result0 += wt[i] * (u_ext->dx[i] * v->dx[i] + u_ext->dy[i] * v->dy[i]);
+        result1 += wt[i + 1] * (u_ext->dx[i + 1] * v->dx[i + 1] + u_ext->dy[i + 1] * v->dy[i + 1]);
+        result2 += wt[i + 2] * (u_ext->dx[i + 2] * v->dx[i + 2] + u_ext->dy[i + 2] * v->dy[i + 2]);
+        result3 += wt[i + 3] * (u_ext->dx[i + 3] * v->dx[i + 3] + u_ext->dy[i + 3] * v->dy[i + 3]);
+      }
+      for (; i < n; i++)
+        result0 += wt[i] * (u_ext->dx[i] * v->dx[i] + u_ext->dy[i] * v->dy[i]);
+      return (result0 + result1) + (result2 + result3);
     }
 
     template<typename Real, typename Scalar>
@@ -17,6 +17,7 @@
 #define __H2D_INTEGRALS_HCURL_H
 
 #include "../quadrature/limit_order.h"
+#include "../forms.h"
 #include "../weakform/weakform.h"
 
 namespace Hermes
@@ -26,10 +27,48 @@ namespace Hermes
     template<typename Real, typename Scalar>
     Scalar int_e_f(int n, double *wt, Func<Real> *u, Func<Real> *v)
     {
-      Scalar result = Scalar(0);
-      for (int i = 0; i < n; i++)
-        result += wt[i] * (u->val0[i] * conj(v->val0[i]) + u->val1[i] * conj(v->val1[i]));
-      return result;
+      // Four independent partial sums, so that the loop can be vectorized.
+      Scalar result0 = Scalar(0), result1 = Scalar(0), result2 = Scalar(0), result3 = Scalar(0);
+      int i = 0;
+      for (; i + 3 < n; i += 4)
+      {
+        result0 += wt[i] * (u->val0[i] * conj(v->val0[i]) + u->val1[i] * conj(v->val1[i]));
+        result1 += wt[i + 1] * (u->val0[i + 1] * conj(v->val0[i + 1]) + u->val1[i + 1] * conj(v->val1[i + 1]));
+        result2 += wt[i + 2] * (u->val0[i + 2] * conj(v->val0[i + 2]) + u->val1[i + 2] * conj(v->val1[i + 2]));
+        result3 += wt[i + 3] * (u->val0[i + 3] * conj(v->val0[i + 3]) + u->val1[i + 3] * conj(v->val1[i + 3]));
+      }
+      for (; i < n; i++)
+        result0 += wt[i] * (u->val0[i] * conj(v->val0[i]) + u->val1[i] * conj(v->val1[i]));
+      return (result0 + result1) + (result2 + result3);
+    }
+
+    /// Batched evaluation of coeff * int_e_f() for all pairs of (real) basis and test functions, see MatrixFormVol::value_all().
+    /// The weighted components of every test function are formed once and dotted with the components of all the basis functions.
+    template<typename Scalar>
+    void int_e_f_all(int n, double *wt, Scalar coeff, int u_count, Func<double> **u, int v_count, Func<double> **v, Scalar **local_matrix)
+    {
+      double* v_wt = new double[2 * n];
+      for (int iv = 0; iv < v_count; iv++)
+      {
+        for (int i = 0; i < n; i++)
+        {
+          v_wt[i] = wt[i] * v[iv]->val0[i];
+          v_wt[n + i] = wt[i] * v[iv]->val1[i];
+        }
+        for (int ju = 0; ju < u_count; ju++)
+        {
+          double* u_val0 = u[ju]->val0;
+          double* u_val1 = u[ju]->val1;
+          double result0 = 0.0, result1 = 0.0;
+          for (int i = 0; i < n; i++)
+          {
+            result0 += u_val0[i] * v_wt[i];
+            result1 += u_val1[i] * v_wt[n + i];
+          }
+          local_matrix[iv][ju] = coeff * (result0 + result1);
+        }
+      }
+      delete [] v_wt;
     }
 
     template<typename Scalar>
@@ -58,6 +97,13 @@ namespace Hermes
         return int_e_f<double, Scalar>(n, wt, u, v);
       }
 
+      virtual bool value_all(int n, double *wt, Func<Scalar> *u_ext[], int u_count, Func<double> **u, int v_count, Func<double> **v,
+        Geom<double> *e, Func<Scalar> **ext, Scalar **local_matrix) const
+      {
+        int_e_f_all<Scalar>(n, wt, Scalar(1.0), u_count, u, v_count, v, local_matrix);
+        return true;
+      }
+
       virtual Hermes::Ord ord(int n, double *wt, Func<Hermes::Ord> *u_ext[], Func<Hermes::Ord> *u, Func<Hermes::Ord> *v,
         Geom<Hermes::Ord> *e, Func<Ord> **ext) const
       {
@@ -73,10 +119,40 @@ namespace Hermes
     template<typename Real, typename Scalar>
     Scalar int_curl_e_curl_f(int n, double *wt, Func<Real> *u, Func<Real> *v)
     {
-      Scalar result = Scalar(0);
-      for (int i = 0; i < n; i++)
-        result += wt[i] * (u->curl[i] * conj(v->curl[i]));
-      return result;
+      // Four independent partial sums, so that the loop can be vectorized.
+      Scalar result0 = Scalar(0), result1 = Scalar(0), result2 = Scalar(0), result3 = Scalar(0);
+      int i = 0;
+      for (; i + 3 < n; i += 4)
+      {
+        result0 += wt[i] * (u->curl[i] * conj(v->curl[i]));
+        result1 += wt[i + 1] * (u->curl[i + 1] * conj(v->curl[i + 1]));
+        result2 += wt[i + 2] * (u->curl[i + 2] * conj(v->curl[i + 2]));
+        result3 += wt[i + 3] * (u->curl[i + 3] * conj(v->curl[i + 3]));
+      }
+      for (; i < n; i++)
+        result0 += wt[i] * (u->curl[i] * conj(v->curl[i]));
+      return (result0 + result1) + (result2 + result3);
+    }
+
+    /// Batched evaluation of coeff * int_curl_e_curl_f() for all pairs of (real) basis and test functions, see int_e_f_all().
+    template<typename Scalar>
+    void int_curl_e_curl_f_all(int n, double *wt, Scalar coeff, int u_count, Func<double> **u, int v_count, Func<double> **v, Scalar **local_matrix)
+    {
+      double* v_wt = new double[n];
+      for (int iv = 0; iv < v_count; iv++)
+      {
+        for (int i = 0; i < n; i++)
+          v_wt[i] = wt[i] * v[iv]->curl[i];
+        for (int ju = 0; ju < u_count; ju++)
+        {
+          double* u_curl = u[ju]->curl;
+          double result = 0.0;
+          for (int i = 0; i < n; i++)
+            result += u_curl[i] * v_wt[i];
+          local_matrix[iv][ju] = coeff * result;
+        }
+      }
+      delete [] v_wt;
     }
 
     template<typename Real, typename Scalar>
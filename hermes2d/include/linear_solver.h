@@ -23,6 +23,7 @@
 #define __HERMES_COMMON_LINEAR_SOLVER_H_
 
 #include "discrete_problem_linear.h"
+#include "static_condensation.h"
 
 namespace Hermes
 {
@@ -100,6 +101,15 @@ namespace Hermes
 
       /// Get the Residual.
       Vector<Scalar>* get_residual();
+
+      /// Get the matrix solver, with the factorization of the last solve() (see GoalOrientedAdapt::solve_adjoint()).
+      LinearMatrixSolver<Scalar>* get_linear_matrix_solver();
+
+      /// Eliminate the bubble DOFs before the linear solver (see StaticCondensation), off by default.
+      /// The Jacobian, the residual and the matrix solver then contain the system of the skeleton DOFs only,
+      /// get_sln_vector() returns the solution of the full system.
+      void set_static_condensation(bool to_set = true);
+      StaticCondensation<Scalar>* get_static_condensation();
     protected:
       DiscreteProblemLinear<Scalar>* dp; ///< FE problem being solved.
 
@@ -114,6 +124,9 @@ namespace Hermes
 
       /// Linear solver.
       LinearMatrixSolver<Scalar>* matrix_solver;
+
+      /// The static condensation, NULL if not used.
+      StaticCondensation<Scalar>* condensation;
       
       /// This instance owns its DP.
       const bool own_dp;
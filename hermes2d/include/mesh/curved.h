@@ -44,9 +44,14 @@ namespace Hermes
       Nurbs()
       {
         ref = 0; twin = false;
+        id = next_id++;
       };
       void unref();
 
+      /// Unique identification of the curve, used by the cache of the CurvMap projections.
+      unsigned int id;
+      static unsigned int next_id;
+
       int degree;  ///< curve degree (2=quadratic, etc.)
       int np;      ///< number of control points
       double3* pt; ///< control points and their weights
@@ -67,7 +72,8 @@ namespace Hermes
     public:
       CurvMap()
       {
-        coeffs = NULL;};
+        coeffs = NULL;
+        coeffs_shared_count = NULL;};
         CurvMap(CurvMap* cm);
         ~CurvMap();
     private:
@@ -96,6 +102,13 @@ namespace Hermes
       int nc; ///< number of coefficients
       double2* coeffs; ///< array of the coefficients
 
+      /// The copies of a CurvMap (e.g. in the copy of a mesh a reference mesh is made of) share the coefficients
+      /// until they are recalculated; the number of the CurvMaps sharing them, NULL if they are not shared.
+      int* coeffs_shared_count;
+
+      /// Releases this CurvMap's reference to the coefficients, frees them if it was the last one.
+      void free_coeffs();
+
       /// this is called for every curvilinear element when it is created
       /// or when it is necessary to re-calculate coefficients for another
       /// order: 'e' is a pointer to the element to which this CurvMap
@@ -149,6 +162,13 @@ namespace Hermes
 
       static void ref_map_projection(Element* e, Nurbs** nurbs, int order, double2* proj, H1ShapesetJacobi* ref_map_shapeset, PrecalcShapeset* ref_map_pss);
 
+      /// Looks up the coefficients of a projection identical to that of the element e (same vertices,
+      /// curves, sub-element transformation and order) in the global cache.
+      /// \return True if found, the coefficients are then copied to this->coeffs.
+      bool get_cached_coeffs(Element* e, Element* base, Nurbs** nurbs);
+      /// Stores this->coeffs in the global cache.
+      void cache_coeffs(Element* e, Element* base, Nurbs** nurbs);
+
       static bool warning_issued;
       template<typename T> friend class Space;
       template<typename T> friend class H1Space;
@@ -163,6 +183,7 @@ namespace Hermes
       friend class Mesh;
       friend class MeshReader;
       friend class MeshReaderH2D;
+      friend class MeshReaderH2DBinary;
       friend class MeshReaderH2DXML;
       friend CurvMap* create_son_curv_map(Element* e, int son);
     };
@@ -0,0 +1,70 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef __H2D_ELEMENT_LOCATOR_H
+#define __H2D_ELEMENT_LOCATOR_H
+
+#include "../global.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    class Element;
+    class Mesh;
+
+    /// @ingroup inner
+    /// \brief Uniform bucket grid over the bounding boxes of the active elements of a mesh.
+    ///
+    /// Used by RefMap::element_on_physical_coordinates() so that only the few elements whose boxes
+    /// contain the point are tested instead of all the active elements. The grid has roughly one cell
+    /// per element. The boxes of curved elements are enlarged to cover the bulging curved edges.
+    /// Obtained through Mesh::get_element_locator(), which rebuilds it when the mesh changes.
+    class HERMES_API ElementLocator
+    {
+    public:
+      ElementLocator(const Mesh* mesh);
+      ~ElementLocator();
+
+      /// True if the mesh has not changed since the grid was built.
+      bool is_up_to_date() const;
+
+      /// Returns the active element containing the point (x, y) among the candidates of its cell, NULL if there is none.
+      /// \param[out] x_reference, y_reference The reference coordinates of the point in the element found.
+      Element* find(double x, double y, double& x_reference, double& y_reference) const;
+
+      /// True if there are curved elements in the mesh (whose boxes may not contain all of the element).
+      bool has_curved_elements() const;
+
+    private:
+      const Mesh* mesh;
+      unsigned seq;
+      int nactive;
+      bool curved;
+
+      double x_min, y_min, x_max, y_max;
+      double cell_size_x, cell_size_y;
+      int nx, ny;
+
+      /// Start of every cell in cell_elements (nx * ny + 1 entries).
+      int* cell_starts;
+      Element** cell_elements;
+
+      static void get_bounding_box(Element* e, double* box);
+      void get_cell(double x, double y, int& i, int& j) const;
+    };
+  }
+}
+#endif
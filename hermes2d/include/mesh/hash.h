@@ -37,6 +37,9 @@ namespace Hermes
     ///
     /// HashTable is a base class for Mesh. It serves as a container for all nodes
     /// of a mesh. Moreover, it has node searching functions based on hash tables.
+    /// The tables use open addressing with linear probing, the parent ids are stored
+    /// in the slots so that a search does not touch the nodes until it succeeds.
+    /// The tables grow when they get 70% full.
     ///
     class HERMES_API HashTable : public Hermes::Mixins::Loggable
     {
@@ -85,6 +88,11 @@ namespace Hermes
       /// Reconstructs the hashtable, after, e.g., the nodes have been loaded from a file.
       void rebuild();
 
+      /// Enlarges the hash tables so that the given numbers of new nodes can be added without growing them.
+      /// The tables also grow automatically when nodes are added, calling this beforehand (e.g. before
+      /// a uniform refinement) only saves the intermediate reallocations.
+      void reserve(int num_new_vertex_nodes, int num_new_edge_nodes);
+
       /// Frees all memory used by the instance.
       void free();
 
@@ -97,22 +105,50 @@ namespace Hermes
       // Internal members
     private:
 
-      Node** v_table; ///< Vertex node hash table
-      Node** e_table; ///< Edge node hash table
+      /// A slot of a hash table, empty if id is negative.
+      struct Slot
+      {
+        int p1, p2;
+        int id;
+      };
+
+      /// A hash table.
+      struct Table
+      {
+        Slot* slots;
+        int mask; ///< The number of slots minus one, the number of slots is a power of two.
+        int count; ///< The number of the occupied slots.
+      };
+
+      Table v_table; ///< Vertex node hash table
+      Table e_table; ///< Edge node hash table
+
+      /// The low bits of the product are mixed with the high ones, as linear probing needs all of them to be spread.
+      inline int hash(int p1, int p2, int mask) const
+      {
+        unsigned int h = 984120265u * (unsigned int)p1 + 125965121u * (unsigned int)p2;
+        h ^= h >> 15;
+        return (int)(h & (unsigned int)mask);
+      }
+
+      void alloc_table(Table& table, int size);
+
+      /// Returns the slot of the node with the parent ids p1 and p2, -1 if there is none.
+      int search(const Table& table, int p1, int p2) const;
 
-      int mask;
+      /// Stores a node in the first free slot, the table has to have one.
+      void insert(Table& table, int p1, int p2, int id);
 
-      inline int hash(int p1, int p2) const { return (984120265*p1 + 125965121*p2) & mask; }
+      /// Reallocates a table to the given size (a power of two) and moves the nodes there.
+      void grow(Table& table, int size);
 
-      /// Searches a list of hash synonyms given the first list item.
-      /// Returns the node matching the parent ids p1 and p2.
-      Node* search_list(Node* node, int p1, int p2) const;
+      /// Removes a node from a table and from the array of nodes.
+      void remove_from_table(Table& table, int id);
 
-      /// Creates a copy of a hash synonym list.
-      void copy_list(Node** ptr, Node* node);
 
       friend struct Node;
       friend class MeshReaderH2D;
+      friend class MeshReaderH2DBinary;
       template<typename Scalar> friend class NeighborSearch;
       template<typename Scalar> friend class Space;
       template<typename Scalar> friend class H1Space;
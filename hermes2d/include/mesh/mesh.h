@@ -33,6 +33,8 @@ namespace Hermes
 
     class Element;
     class HashTable;
+    class ElementLocator;
+    class ActiveElementIterator;
 
     template<typename Scalar> class Space;
     template<typename Scalar> class KellyTypeAdapt;
@@ -65,6 +67,11 @@ namespace Hermes
     ///&nbsp;   <li> HERMES_TYPE_EDGE   -- edge node. Only stores edge marker and two element pointers.
     /// </ol>
     ///
+    /// API change: the member 'next_hash' (the next node in a hash synonym list) has been removed, the node
+    /// hash tables of HashTable are open-addressing tables that do not chain the nodes. Code that set it
+    /// has to drop the assignment, code that followed it has to use HashTable::peek_vertex_node() or
+    /// HashTable::peek_edge_node().
+    ///
     struct HERMES_API Node
     {
       int id;          ///< node id number
@@ -87,7 +94,6 @@ namespace Hermes
       };
 
       int p1, p2; ///< parent id numbers
-      Node* next_hash; ///< next node in hash synonym list
 
       /// Returns true if the (vertex) node is constrained.
       bool is_constrained_vertex() const;
@@ -121,12 +127,24 @@ namespace Hermes
     {
     public:
       Element();
+
+      // The members are ordered by the frequency of their use: the data read by the traversal and the element
+      // loops (ids, flags, node and son pointers) occupy the beginning of the structure, the cached geometric
+      // quantities are kept at its end, so that the loops over large meshes touch as few cache lines as possible.
+
       int id;              ///< element id number
+      int marker;        ///< element marker
+      Node* vn[H2D_MAX_NUMBER_VERTICES];   ///< vertex node pointers
+      union
+      {
+        Node* en[H2D_MAX_NUMBER_EDGES];      ///< edge node pointers
+        Element* sons[H2D_MAX_ELEMENT_SONS]; ///< son elements (up to four)
+      };
+      Element* parent;     ///< pointer to the parent element for the current son
       bool active;   ///< 0 = active, no sons; 1 = inactive (refined), has sons
       bool used;     ///< array item usage flag
-      Element* parent;     ///< pointer to the parent element for the current son
       bool visited;        ///< true if the element has been visited during assembling
-      
+
       /// Calculates the area of the element. For curved elements, this is only
       /// an approximation: the curvature is not accounted for.
       double get_area();
@@ -138,15 +156,6 @@ namespace Hermes
       /// Returns the center of gravity.
       void get_center(double& x, double& y);
 
-      Node* vn[H2D_MAX_NUMBER_VERTICES];   ///< vertex node pointers
-      union
-      {
-        Node* en[H2D_MAX_NUMBER_EDGES];      ///< edge node pointers
-        Element* sons[H2D_MAX_ELEMENT_SONS]; ///< son elements (up to four)
-      };
-
-      int marker;        ///< element marker
-      
       // returns the edge orientation. This works for the unconstrained edges.
       int get_edge_orientation(int ie) const;
       ElementMode2D  get_mode() const;
@@ -160,24 +169,27 @@ namespace Hermes
       bool vsplit() const;
       bool bsplit() const;
 
+    private:
+      unsigned nvert:30; ///< number of vertices (3 or 4)
+
     protected:
       CurvMap* cm; ///< curved mapping, NULL if not curvilinear
+
+      /// Increase in integration order, see RefMap::calc_inv_ref_order()
+      int iro_cache;
+
       /// Serves for saving the once calculated area of this element.
       bool areaCalculated;
-      /// Serves for saving the once calculated area of this element.
-      double area;
-
       bool center_set;
-      double x_center, y_center;
-
       /// Serves for saving the once calculated diameter of this element.
       bool diameterCalculated;
+
+      /// Serves for saving the once calculated area of this element.
+      double area;
+      double x_center, y_center;
       /// Serves for saving the once calculated diameter of this element.
       double diameter;
 
-      /// Increase in integration order, see RefMap::calc_inv_ref_order()
-      int iro_cache;
-
       /// Helper functions to obtain the index of the next or previous vertex/edge
       int next_vert(int i) const;
       int prev_vert(int i) const;
@@ -191,11 +203,10 @@ namespace Hermes
       /// Internal.
       void unref_all_nodes(HashTable* ht);
     private:
-      unsigned nvert:30; ///< number of vertices (3 or 4)
-
       friend class Mesh;
       friend class MeshReader;
       friend class MeshReaderH2D;
+      friend class MeshReaderH2DBinary;
       friend class MeshReaderH1DXML;
       friend class MeshReaderH2DXML;
       friend class PrecalcShapeset;
@@ -294,6 +305,10 @@ namespace Hermes
       /// Returns the current number of active elements in the mesh.
       int get_num_active_elements() const;
 
+      /// Copies the active elements (in the order of their ids) into 'active'. The list is kept by the mesh and
+      /// rebuilt only after the elements changed, so that the iteration (for_all_active_elements) is a dense loop.
+      void get_active_elements(std::vector<Element*>& active) const;
+
       /// Returns the maximum node id number plus one.
       int get_max_element_id() const;
 
@@ -361,6 +376,24 @@ namespace Hermes
       /// refine_all_elements().
       void unrefine_all_elements(bool keep_initial_refinements = true);
 
+      /// Renumbers the base elements and the top-level vertex nodes so that they follow a Hilbert curve
+      /// through the centres of the base elements. Neighbouring elements then get close ids, which improves
+      /// the memory locality of the traversal and the bandwidth of the DOF numbering of Spaces built afterwards.
+      /// Markers, curved edges and the refinement trees (including the initial ones) are preserved,
+      /// unused base element slots are dropped. All element and node ids change, so this should be called
+      /// right after loading, before any Space or Solution is defined on the mesh.
+      void reorder_space_filling_curve();
+
+      /// Splits the active elements (including the refinements) into num_parts connected parts of about equal work,
+      /// e.g. for assembling the parts in different processes (DiscreteProblem::set_process_partition()).
+      /// The elements are ordered along a Hilbert curve through their centres, the curve is cut into pieces of equal
+      /// total weight, and the boundaries of the parts are then smoothed by moving the elements having most of their
+      /// neighbours in another part there, as long as the weights of the parts stay within 5% of the average.
+      /// The parts thus follow the ordering of reorder_space_filling_curve().
+      /// @param[out] parts The part of every active element by its id (get_max_element_id() entries), -1 for the inactive ones.
+      /// @param[in] weights The work of the elements by their id, e.g. by Space::get_element_weights(), NULL for the same work everywhere.
+      void partition(int num_parts, int* parts, const double* weights = NULL) const;
+
       /// For internal use.
       Element* get_element_fast(int id) const;
 
@@ -370,6 +403,16 @@ namespace Hermes
       /// For internal use.
       void set_seq(unsigned seq);
 
+      /// \brief The version of the content of the mesh: a hash of the active elements (ids, markers, vertices with their
+      /// coordinates, boundary markers, curvature). Unlike get_seq(), it is the same for the same content
+      /// (e.g. for a copy, or after a refinement reverted by unrefinements), so that the caches
+      /// (sparsity, state lists, face tables, factorizations) can key on it. Calculated on every call (linear in the elements).
+      uint64_t get_version() const;
+
+      /// Returns the point location index of the active elements, (re)built if the mesh changed.
+      /// See RefMap::element_on_physical_coordinates().
+      ElementLocator* get_element_locator() const;
+
       /// Class for creating reference mesh.
       class HERMES_API ReferenceMeshCreator
       {
@@ -381,18 +424,39 @@ namespace Hermes
         /// horizontally (with respect to the reference domain), 2 means
         /// refine vertically.
         ReferenceMeshCreator(Mesh* coarse_mesh, int refinement = 0);
+        /// The copy does not take over the kept reference mesh.
+        ReferenceMeshCreator(const ReferenceMeshCreator& other);
+        ReferenceMeshCreator& operator=(const ReferenceMeshCreator& other);
+        virtual ~ReferenceMeshCreator();
 
         /// Method that does the creation.
         /// THIS IS THE METHOD TO OVERLOAD FOR CUSTOM CREATING OF A REFERENCE MESH.
+        /// The creator keeps a copy of the last reference mesh created, another call for a coarse mesh
+        /// that has not changed since (e.g. a creator reused over the time steps without adaptivity)
+        /// then only copies it.
         virtual Mesh* create_ref_mesh();
 
+        /// Releases the reference mesh kept by create_ref_mesh(), done also in the destructor.
+        void free_cache();
+
       private:
         /// Storage.
         Mesh* coarse_mesh;
         int refinement;
+
+        /// Copy of the last reference mesh created, NULL if none.
+        Mesh* kept_ref_mesh;
+        /// The coarse mesh and its state kept_ref_mesh was created from.
+        const Mesh* kept_coarse_mesh;
+        unsigned kept_seq;
+        int kept_num_elements, kept_num_active_elements, kept_num_nodes, kept_refinement;
       };
 
     private:
+      /// (Re)builds active_elements if the elements changed since the last build.
+      void update_active_elements() const;
+      bool active_elements_up_to_date() const;
+
       /// For internal use.
       void initial_single_check();
       static void initial_multimesh_check(Hermes::vector<Mesh*> meshes);
@@ -400,6 +464,9 @@ namespace Hermes
       /// For internal use.
       int get_edge_sons(Element* e, int edge, int& son1, int& son2) const;
 
+      /// Creates the mid-edge vertex nodes of the refinement of all the given elements, see refine_all_elements().
+      void create_refinement_vertex_nodes(const std::vector<Element*>& elements_to_refine, int refinement);
+
       /// Refines all quad elements to triangles.
       /// It refines a quadrilateral element into two triangles.
       /// Note: this function creates a base mesh.
@@ -430,11 +497,27 @@ namespace Hermes
       int nactive;
       unsigned seq;
 
+      /// Built on demand by get_element_locator().
+      mutable ElementLocator* element_locator;
+
+      /// Built on demand by update_active_elements(), for the state of the elements given by the rest.
+      mutable std::vector<Element*> active_elements;
+      mutable bool active_elements_valid;
+      /// Incremented on every rebuild of active_elements.
+      mutable unsigned int active_elements_generation;
+      mutable unsigned int active_elements_modification;
+      mutable unsigned active_elements_seq;
+      mutable int active_elements_nactive;
+
       int nbase, ntopvert;
       int ninitial;
 
       void unrefine_element_internal(Element* e);
 
+      /// Repeats the refinements of the element e of this mesh on its counterpart e_reordered in the reordered mesh,
+      /// either only the initial ones, or all the remaining ones. Used by reorder_space_filling_curve().
+      void copy_refinements(Element* e, Mesh* reordered, Element* e_reordered, bool initial);
+
       /// Returns a NURBS curve with reversed control points and inverted knot vector.
       /// Used for curved edges inside a mesh, where two mirror Nurbs have to be created
       /// for the adjacent elements
@@ -455,6 +538,10 @@ namespace Hermes
       {
       public:
         MarkersConversion();
+        /// The copy shares the conversion tables until one of the two inserts a marker.
+        MarkersConversion(const MarkersConversion& other);
+        MarkersConversion& operator=(const MarkersConversion& other);
+        virtual ~MarkersConversion();
 
         /// Info about the maximum marker used so far, used in determining
         /// of the internal marker for a user-supplied std::string identification for
@@ -499,13 +586,29 @@ namespace Hermes
         virtual MarkersConversionType get_type() const = 0;
 
       protected:
-        /// Conversion tables between the std::string markers the user sets and
-        /// the markers used internally as members of Elements, Nodes.
-        std::map<int, std::string> conversion_table;
+        /// The conversion tables are shared by the copies of a mesh (Mesh::copy(), Mesh::copy_base(), the reference meshes)
+        /// and copied on the first insert_marker() into a shared one, so that the meshes of the components of a system
+        /// made from one base mesh do not replicate them.
+        struct ConversionTables
+        {
+          /// Conversion tables between the std::string markers the user sets and
+          /// the markers used internally as members of Elements, Nodes.
+          std::map<int, std::string> conversion_table;
+
+          /// Inverse tables, so that it is possible to search using either
+          /// the internal representation, or the user std::string value.
+          std::map<std::string, int> conversion_table_inverse;
+
+          /// The number of the MarkersConversions sharing the tables.
+          int ref_count;
+        };
+        ConversionTables* tables;
+
+        /// Releases the reference to the tables, deletes them if it was the last one.
+        void release_tables();
 
-        /// Inverse tables, so that it is possible to search using either
-        /// the internal representation, or the user std::string value.
-        std::map<std::string, int> conversion_table_inverse;
+        /// Removes all the markers.
+        void clear();
 
         friend class Space<double>;
         friend class Space<std::complex<double> >;
@@ -545,6 +648,9 @@ namespace Hermes
       BoundaryMarkersConversion boundary_markers_conversion;
 
       friend class MeshReaderH2D;
+      friend class MeshReaderH2DBinary;
+      friend class ActiveElementIterator;
+      friend class MeshRefinementLog;
       friend class MeshReaderH2DXML;
       friend class MeshReaderH1DXML;
       friend class MeshReaderExodusII;
@@ -708,6 +814,42 @@ namespace Hermes
     static Node* get_edge_node();
     static Node* get_vertex_node(Node* v1, Node* v2);
 
+    /// Iteration over the active elements of a mesh, see for_all_active_elements.
+    /// Goes through the list kept by the mesh up to its end at the start of the iteration, so the elements
+    /// may be refined during the iteration, the refined ones are then skipped and their sons not visited.
+    /// Should the list be rebuilt meanwhile (e.g. by a nested iteration after a refinement), the rest
+    /// is visited by the element ids, as for_all_elements does.
+    class HERMES_API ActiveElementIterator
+    {
+    public:
+      ActiveElementIterator(const Mesh* mesh);
+
+      /// The next element still active, false at the end.
+      inline bool next(Element*& e)
+      {
+        if(generation != mesh->active_elements_generation)
+          return next_by_id(e);
+        while(position < end)
+        {
+          e = mesh->active_elements[position++];
+          if(e->used && e->active)
+          {
+            next_id = e->id + 1;
+            return true;
+          }
+        }
+        return false;
+      }
+
+    private:
+      bool next_by_id(Element*& e);
+
+      const Mesh* mesh;
+      unsigned int position, end, generation;
+      /// For next_by_id(): the id following the last element visited and the end of the ids at the start.
+      int next_id, max_id;
+    };
+
     /// Helper macros for easy iteration through all elements, nodes etc. in a Mesh.
     #define for_all_elements(e, mesh) \
             for (int _id = 0, _max = (mesh)->get_max_element_id(); _id < _max; _id++) \
@@ -722,9 +864,7 @@ namespace Hermes
               if(((e) = (mesh)->get_element_fast(_id))->used || !((e) = (mesh)->get_element_fast(_id))->used)
 
     #define for_all_active_elements(e, mesh) \
-            for (int _id = 0, _max = (mesh)->get_max_element_id(); _id < _max; _id++) \
-              if(((e) = (mesh)->get_element_fast(_id))->used) \
-                if((e)->active)
+            for (Hermes::Hermes2D::ActiveElementIterator _active_it(mesh); _active_it.next(e); )
 
     #define for_all_inactive_elements(e, mesh) \
             for (int _id = 0, _max = (mesh)->get_max_element_id(); _id < _max; _id++) \
@@ -38,6 +38,8 @@ namespace Hermes
     ///&nbsp;e.print_msg();
     ///&nbsp;return -1;
     /// }
+    /// The files are read by a single-pass tokenizer, building the mesh directly; the files it does
+    /// not understand (e.g. sections in an unusual order, or list-less layouts) are read by the generic MeshData parser.
     class HERMES_API MeshReaderH2D : public MeshReader
     {
     public:
@@ -48,8 +50,20 @@ namespace Hermes
       virtual bool save(const char *filename, Mesh *mesh);
 
     protected:
+      /// The single-pass reading of the whole file in memory, the sections have to come in the order vertices, elements,
+      /// boundaries and curves, refinements.
+      /// \return false if the file is not understood, the mesh is then to be freed and loaded by the generic parser.
+      bool load_fast(const char *filename, Mesh *mesh);
+
       Nurbs* load_nurbs(Mesh *mesh, MeshData *m, int id, Node** en, int &p1, int &p2);
 
+      /// Creates the curve of the edge p1-p2 from the control points (x, y, weight) and the inner knots, if not circle.
+      /// The third entry of the curve specification is the angle of a circle, the degree of a NURBS.
+      Nurbs* create_nurbs(Mesh *mesh, int id, Node** en, int p1, int p2, bool circle, double third, std::vector<double>& vCP, std::vector<double>& vKnots);
+
+      /// Assigns the curve to the elements sharing the edge node en, deletes it if unused.
+      void assign_nurbs(Mesh *mesh, Node* en, Nurbs* nurbs, int p1);
+
       void save_refinements(Mesh *mesh, FILE* f, Element* e, int id, bool& first);
       void save_nurbs(Mesh *mesh, FILE* f, int p1, int p2, Nurbs* nurbs);
     };
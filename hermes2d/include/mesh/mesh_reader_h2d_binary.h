@@ -0,0 +1,75 @@
+// This file is part of Hermes2D
+//
+// Hermes2D is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D; if not, see <http://www.gnu.prg/licenses/>.
+
+#ifndef _MESH_READER_H2D_BINARY_H_
+#define _MESH_READER_H2D_BINARY_H_
+
+#include "mesh_reader.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    /// Mesh reader from a binary Hermes2D format
+    ///
+    /// @ingroup mesh_readers
+    /// The file holds the same data as the Hermes2D format (vertices, elements, boundary markers,
+    /// curved edges and refinements) as raw arrays of 32-bit integers and doubles preceded by a fixed header,
+    /// so loading only maps the file into memory (mmap where available) and builds the mesh from the arrays,
+    /// without any parsing. The data is stored in the byte order of the machine that saved the file,
+    /// files from a machine of the other byte order are rejected.
+    ///
+    /// Typical usage:
+    /// Hermes::Hermes2D::Mesh mesh;
+    /// Hermes::Hermes2D::MeshReaderH2DBinary mloader;
+    /// mloader.save("domain.mesh.bin", &mesh);
+    /// ...
+    /// mloader.load("domain.mesh.bin", &mesh);
+    class HERMES_API MeshReaderH2DBinary : public MeshReader
+    {
+    public:
+      MeshReaderH2DBinary();
+      virtual ~MeshReaderH2DBinary();
+
+      virtual bool load(const char *filename, Mesh *mesh);
+      virtual bool save(const char *filename, Mesh *mesh);
+
+    protected:
+      /// The fixed-size beginning of the file.
+      struct Header
+      {
+        char magic[8];
+        int version;
+        int byte_order; ///< H2D_BINARY_BYTE_ORDER as written by the saving machine.
+        int n_vertices;
+        int n_elements;
+        int n_boundaries;
+        int n_curves;
+        int n_curve_doubles; ///< The number of doubles of all the curves (angle, control points, knot vector).
+        int n_refinements;
+        int n_element_markers;
+        int n_boundary_markers;
+        int n_marker_chars; ///< The total length of the marker names.
+        int padding;
+      };
+
+      void save_refinements(Mesh *mesh, Element* e, int id, std::vector<int>& refinements);
+
+      /// Builds the mesh from the mapped contents of a file of the given size.
+      void load_data(const char *filename, const char* data, size_t size, Mesh *mesh);
+    };
+  }
+}
+#endif
@@ -67,12 +67,22 @@ namespace Hermes
       /// This method loads multiple meshes according to subdomains described in the meshfile.
       /// \param[in] meshes Meshes to be loaded, the number must correspond to the subdomains described in the file.
       ///&nbsp;         also the order is determined by the order in the file.
+      ///&nbsp;         The subdomains with NULL entries are not built.
       bool load(const char *filename, Hermes::vector<Mesh *> meshes);
 
+      /// This method loads only the requested subdomains described in the meshfile, the others are not built.
+      /// With set_validation(false), the (trusted) file is not validated against the schema either.
+      /// \param[in] meshes Meshes to be loaded, meshes[i] is the subdomain named subdomain_names[i].
+      bool load(const char *filename, Hermes::vector<Mesh *> meshes, Hermes::vector<std::string> subdomain_names);
+
       /// This method saves multiple meshes according to subdomains in the vector meshes.
       bool save(const char *filename, Hermes::vector<Mesh *> meshes);
 
     protected:
+      /// Internal method loading the subdomains, either the ones with non-NULL meshes (subdomain_names == NULL),
+      /// or the named ones.
+      bool load_subdomains(const char *filename, Hermes::vector<Mesh *> meshes, Hermes::vector<std::string>* subdomain_names);
+
       /// Internal method loading contents of parsed_xml_mesh into mesh.
       bool load(std::auto_ptr<XMLMesh::mesh> & parsed_xml_mesh, Mesh *mesh, std::map<unsigned int, unsigned int>& vertex_is);
 
@@ -0,0 +1,96 @@
+// This file is part of Hermes2D
+//
+// Hermes2D is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D; if not, see <http://www.gnu.prg/licenses/>.
+
+#ifndef _MESH_REFINEMENT_LOG_H_
+#define _MESH_REFINEMENT_LOG_H_
+
+#include "mesh.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    /// A compact checkpoint of an adaptively refined mesh.
+    ///
+    /// The mesh is saved once (in the format of MeshReaderH2DBinary), then every adaptivity step appends
+    /// only the refinements and unrefinements done since the previous step, as the pairs (element id, refinement type)
+    /// of the refinements of the mesh files (-1 stands for unrefinement). A restart loads the saved mesh and replays
+    /// the steps, which gives the same elements with the same ids as in the interrupted computation.
+    ///
+    /// Every step is flushed to the file, a step cut off by a crash is dropped by replay().
+    /// Only the refinements done through Mesh::refine_element_id(), Mesh::unrefine_element_id() and the methods
+    /// built on them (including Adapt) are logged; after Mesh::regularize(), or when the mesh is loaded or copied again,
+    /// start() has to be called again. The spaces (the orders) are not a part of the log.
+    ///
+    /// Typical usage:
+    /// Hermes::Hermes2D::MeshRefinementLog log("adapt.log");
+    /// if(restart)
+    ///   step = log.replay(&mesh) + 1;
+    /// else
+    ///   log.start(&mesh);
+    /// for(; !done; step++)
+    /// {
+    ///   ...
+    ///   adaptivity.adapt(...);
+    ///   log.add_step(&mesh, step);
+    /// }
+    class HERMES_API MeshRefinementLog : public Hermes::Mixins::Loggable
+    {
+    public:
+      /// @param[in] file_name The log, the mesh is saved into file_name with the suffix ".base".
+      MeshRefinementLog(const char* file_name);
+      virtual ~MeshRefinementLog();
+
+      /// Saves the mesh as the base of the log and starts an empty log.
+      /// A refined mesh is loaded back from the saved base, so that its element ids are the ones of a restart,
+      /// i.e. start() has to be called before any Space is built on the mesh.
+      void start(Mesh* mesh);
+
+      /// Appends the refinements of the mesh done since start(), replay() or the previous add_step().
+      /// @param[in] step The number of the step (nonnegative), e.g. the adaptivity step.
+      void add_step(Mesh* mesh, int step);
+
+      /// Loads the base into the mesh and replays the logged steps up to last_step.
+      /// The following add_step() calls continue the log, the steps after last_step are removed from it.
+      /// @param[in] last_step The last step to replay, negative for all of them.
+      /// @return The number of the last replayed step, -1 if there was none.
+      int replay(Mesh* mesh, int last_step = -1);
+
+      /// The number of the operations (refinements and unrefinements) written so far.
+      unsigned int get_num_operations() const;
+
+    protected:
+      /// The fixed-size beginning of the log.
+      struct Header
+      {
+        char magic[8];
+        int version;
+        int byte_order;
+      };
+
+      /// Opens the log for the following steps, writes the header and the given records.
+      void rewrite(const int* records, unsigned int num_ints);
+
+      std::string file_name;
+      FILE* file;
+
+      /// The logged mesh and the number of its refinements (Mesh::refinements) already in the log.
+      Mesh* mesh;
+      unsigned int num_logged;
+      unsigned int num_operations;
+    };
+  }
+}
+#endif
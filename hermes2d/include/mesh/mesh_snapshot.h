@@ -0,0 +1,67 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef __H2D_MESH_SNAPSHOT_H
+#define __H2D_MESH_SNAPSHOT_H
+
+#include "mesh.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    /// @ingroup meshes
+    /// \brief An immutable copy of a mesh, identified by the version of its content (Mesh::get_version()).
+    ///
+    /// The caches keyed on the version stay valid for as long as the snapshot lives, whatever happens to the original mesh.
+    /// A snapshot is only read (through the const interface), so it is shared by any number of threads and solvers without copies:
+    /// acquire() of a mesh with the content of a live snapshot returns that snapshot. The snapshots are reference counted,
+    /// every acquire() is paired with a release(), the last release() deletes the snapshot.
+    ///
+    /// Typical usage:<br>
+    /// const Hermes::Hermes2D::MeshSnapshot* snapshot = Hermes::Hermes2D::MeshSnapshot::acquire(&mesh);<br>
+    /// ... (e.g. in other threads) snapshot->get_mesh() ...<br>
+    /// Hermes::Hermes2D::MeshSnapshot::release(snapshot);<br>
+    class HERMES_API MeshSnapshot
+    {
+    public:
+      /// A (new or shared) snapshot of the current content of the mesh, with one reference for the caller. Thread-safe.
+      static const MeshSnapshot* acquire(const Mesh* mesh);
+
+      /// Another reference to the snapshot. Thread-safe.
+      static const MeshSnapshot* acquire(const MeshSnapshot* snapshot);
+
+      /// Releases one reference, the last one deletes the snapshot. Thread-safe.
+      static void release(const MeshSnapshot* snapshot);
+
+      const Mesh* get_mesh() const;
+
+      uint64_t get_version() const;
+
+      /// True if the mesh has the content of the snapshot (calculates its version).
+      bool matches(const Mesh* mesh) const;
+
+    private:
+      MeshSnapshot(const Mesh* mesh, uint64_t version);
+      ~MeshSnapshot();
+
+      Mesh mesh;
+      uint64_t version;
+      /// The references, changed under the lock of the live snapshots.
+      mutable int ref_count;
+    };
+  }
+}
+#endif
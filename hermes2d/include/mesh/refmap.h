@@ -63,6 +63,10 @@ namespace Hermes
       /// Must be called prior to using all other functions in the class.
       virtual void set_active_element(Element* e);
 
+      /// Forgets the active element, so that the next set_active_element() calculates the map again even for an element
+      /// at the same address (of a mesh changed meanwhile), used for the RefMaps kept between the assemblings.
+      void reset_active_element();
+
       /// Returns the triples[x, y, norm] of the tangent to the specified (possibly
       /// curved) edge at the 1D integration points along the edge. The maximum
       /// 1D quadrature rule is used by default, but the user may specify his own
@@ -118,6 +122,15 @@ namespace Hermes
       /// its inverse matrix.
       double2x2* get_const_inv_ref_map();
 
+      /// If the reference map is constant, returns it as the affine map x_phys = m * x_ref + t
+      /// from the reference domain of the current (sub-)element to the physical domain.
+      void get_const_ref_map(double2x2& m, double2& t) const;
+
+      /// Calculates the physical coordinates and the jacobian times the weights of the integration
+      /// points of the order for a block of (untransformed) elements with constant reference maps,
+      /// all of the same mode, into contiguous arrays of num_elements * np values, element after element.
+      static void calc_const_geometry(Element** elements, int num_elements, Quad2D* quad, int order, double* x, double* y, double* jacobian_x_weights);
+
       H1ShapesetJacobi ref_map_shapeset;
       PrecalcShapeset ref_map_pss;
     private:
@@ -136,6 +149,9 @@ namespace Hermes
       /// See Transformable::pop_transform()
       virtual void pop_transform();
 
+      /// See Transformable::set_transform()
+      virtual void set_transform(uint64_t idx);
+
       /// Frees all data associated with the instance.
       void free();
 
@@ -161,6 +177,10 @@ namespace Hermes
 
       double2x2 const_inv_ref_map;
 
+      /// The affine reference map of the element (for constant reference maps).
+      double2x2 const_ref_map;
+      double2 const_ref_map_offset;
+
       static const int H2D_MAX_TABLES = g_max_quad + 1 + 4 * g_max_quad + 4;
 
       /// This structure represents one complete piece of information about the reference mapping
@@ -207,6 +227,9 @@ namespace Hermes
       /// (ie., linear triangles and linear parallelogram quads).
       void calc_const_inv_ref_map();
 
+      /// The affine reference map x_phys = m * x_ref + t of a linear triangle or a parallelogram.
+      static void calc_const_ref_map(Element* e, double2x2& m, double2& t);
+
       void calc_second_ref_map(int order);
 
       static bool is_parallelogram(Element* e);
@@ -255,6 +278,7 @@ namespace Hermes
       friend Geom<double>* init_geom_vol(RefMap *rm, const int order);
       friend Geom<double>* init_geom_surf(RefMap *rm, SurfPos* surf_pos, const int order);
       friend Func<double>* init_fn(PrecalcShapeset *fu, RefMap *rm, const int order);
+      friend Func<double>** init_fns(PrecalcShapeset *fu, RefMap *rm, const int order, unsigned int count, int* idx);
       template<typename T> friend T int_g_h(Function<T>* fg, Function<T>* fh, RefMap* rg, RefMap* rh);
 	};
   }
@@ -99,11 +99,15 @@ namespace Hermes
         Rect* er;
         int num;
         int isurf;
+        /// Index of the state in the array returned by Traverse::get_states().
+        int index;
       friend class Traverse;
       friend class Views::Linearizer;
       friend class Views::Vectorizer;
       template<typename Scalar> friend class DiscreteProblem;
       template<typename Scalar> friend class DiscreteProblemLinear;
+      template<typename Scalar> friend class KellyTypeAdapt;
+      friend class TraverseStateList;
       };
 
       void begin(int n, const Mesh** meshes, Transformable** fn = NULL);
@@ -111,6 +115,14 @@ namespace Hermes
 
       State* get_next_state(int* top_by_ref = NULL, int* id_by_ref = NULL);
       int get_num_states(Hermes::vector<const Mesh*> meshes);
+
+      /// Performs the whole traversal at once and returns independent copies of all the leaf states
+      /// (elements, sub-element transformations and boundary information).
+      /// The states can then be processed in any order (e.g. by several threads) without the need
+      /// to synchronize the calls to get_next_state().
+      /// The caller is responsible for deleting the states and for free()-ing the array itself.
+      /// \param[out] num_states The number of the states returned.
+      State** get_states(const Mesh** meshes, int meshes_count, int& num_states);
       inline Element*  get_base() const { return base; }
 
       void init_transforms(State* s, int i);
@@ -150,9 +162,63 @@ namespace Hermes
       template<typename T> friend class Filter;
       template<typename T> friend class SimpleFilter;
       template<typename T> friend class Global;
+      template<typename T> friend class LocalProjection;
       friend class Views::Orderizer;
       friend class Views::Vectorizer;
       friend class Views::Linearizer;
+      friend class TraverseStateList;
+    };
+
+    /// @ingroup inner
+    /// The states of the union traversal of a set of meshes (see Traverse::get_states()), kept
+    /// until any of the meshes changes. Repeated traversals of the same meshes (assembling in every
+    /// Newton's iteration, error calculation, ...) thus do not have to go through the union mesh
+    /// recursion again. Once updated, the states can be read by any number of threads.
+    ///
+    /// A mesh is considered unchanged if its address, sequence number, number of (active) elements
+    /// and the address of its element storage are the same as at the last update.
+    class HERMES_API TraverseStateList
+    {
+    public:
+      TraverseStateList();
+      ~TraverseStateList();
+
+      /// Make the list correspond to the meshes, the traversal is only performed
+      /// if the meshes are not the ones of the last call or if any of them changed.
+      /// \return true if the states were recalculated.
+      bool update(const Mesh** meshes, int meshes_count);
+
+      /// Release the states.
+      void clear();
+
+      int get_num_states() const;
+
+      /// The states, owned by this instance and valid until the next update() or clear().
+      /// The order of the states may be changed by the caller (Traverse::State::index keeps the traversal order).
+      Traverse::State** get_states() const;
+
+      /// Set the elements and the sub-element transformations of the state to the functions,
+      /// one per mesh (NULL entries are skipped), the same way as the traversal with Transformables does it.
+      static void set_active_state(Traverse::State* state, Transformable** fn);
+
+    private:
+      Traverse::State** states;
+      int num_states;
+
+      struct MeshRecord
+      {
+        const Mesh* mesh;
+        unsigned seq;
+        int num_elements;
+        int num_active_elements;
+        Element* first_element;
+      };
+      Hermes::vector<MeshRecord> mesh_records;
+
+      static MeshRecord get_record(const Mesh* mesh);
+
+      TraverseStateList(const TraverseStateList&);
+      void operator=(const TraverseStateList&);
     };
   }
 }
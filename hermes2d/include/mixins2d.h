@@ -1,6 +1,12 @@
 #ifndef __H2D_MIXINS_H
 #define __H2D_MIXINS_H
 #include "global.h"
+#include <xercesc/util/XercesDefs.hpp>
+
+XERCES_CPP_NAMESPACE_BEGIN
+class DOMDocument;
+XERCES_CPP_NAMESPACE_END
+
 namespace Hermes
 {
   namespace Hermes2D
@@ -61,9 +67,29 @@ namespace Hermes
         XMLParsing();
 
         /// Set to validate / not to validate.
+        /// In the trusted input mode (Hermes2DApiParam::xmlTrustedInput) nothing is validated regardless of this setting.
         void set_validation(bool to_set);
 
       protected:
+        /// The validation is switched on and the input is not trusted.
+        bool validation_on() const;
+
+        /// The validation is switched on (validate) and the input is not trusted.
+        static bool validation_on(bool validate);
+
+        /// A file parsed and validated against the schemas of the directory Hermes2DApiParam::xmlSchemasDirPath.
+        /// The schemas are parsed only once per process, into a grammar pool shared by all the parsers,
+        /// instead of reading the schema referenced by every file anew. The document is released with the instance.
+        class HERMES_API ValidatedDocument
+        {
+        public:
+          ValidatedDocument(const char* filename);
+          ~ValidatedDocument();
+          const XERCES_CPP_NAMESPACE::DOMDocument& get() const;
+        private:
+          XERCES_CPP_NAMESPACE::DOMDocument* document;
+        };
+
         /// Internal.
         bool validate;
       };
@@ -89,8 +115,9 @@ namespace Hermes
         /// Sets varname for the matrix
         /// Default: "A".
         void set_matrix_varname(std::string name);
-        /// Sets varname for the matrix
+        /// Sets the format of the matrix output
         /// Default: "DF_MATLAB_SPARSE - matlab file".
+        /// For large matrices, the binary DF_MATRIX_MARKET_BIN and DF_HDF5 write the arrays in bulk.
         void set_matrix_E_matrix_dump_format(EMatrixDumpFormat format);
         /// Sets number format for the matrix output.
         /// Default: "%lf".
@@ -106,8 +133,9 @@ namespace Hermes
         /// Sets varname for the rhs
         /// Default: "b".
         void set_rhs_varname(std::string name);
-        /// Sets varname for the rhs
+        /// Sets the format of the rhs output
         /// Default: "DF_MATLAB_SPARSE - matlab file".
+        /// For large vectors, the binary DF_MATRIX_MARKET_BIN and DF_HDF5 write the entries in bulk.
         void set_rhs_E_matrix_dump_format(EMatrixDumpFormat format);
         /// Sets number format for the vector output.
         /// Default: "%lf".
@@ -130,6 +130,33 @@ namespace Hermes
       /// numerical integration over the entire domain. Therefore this option is off by default.
       void set_residual_as_function();
 
+      /// Assemble the Jacobian together with the residual, in one pass over the elements, in solve().
+      /// The Jacobian is then assembled also in the last iteration, where it is not needed,
+      /// but every other iteration saves the separate residual assembly.
+      /// Ignored for matrix-free problems and in solve_keep_jacobian().
+      /// Default: false
+      void set_jacobian_with_residual(bool onOff = true);
+
+      /// Keep the factorized Jacobian in solve() while it still gives fast convergence.
+      /// The Jacobian (also the one from the previous call of solve(), e.g. of the last time step) is reused as long as the residual
+      /// norm decreases at least by the factor max_contraction per iteration, otherwise it is assembled and factorized again
+      /// at the current point. A new sparse structure (e.g. after adaptation) also leads to a new Jacobian.
+      /// The residual is then always assembled alone, see set_jacobian_with_residual().
+      /// Ignored for matrix-free problems.
+      /// Default: false
+      /// \param[in] max_contraction Highest ratio of two successive residual norms for which the Jacobian is kept, in (0, 1).
+      void set_jacobian_reuse(bool onOff = true, double max_contraction = 0.5);
+
+      /// Inexact Newton's method: with an iterative linear solver (AztecOO, the built-in Krylov solvers, the matrix-free GMRES),
+      /// the relative tolerance of every linear solve is set from the residual norms by the Eisenstat-Walker formula
+      /// eta_k = gamma (|F_k| / |F_{k-1}|)^alpha, bounded by max_forcing_term, instead of the fixed tolerance of the linear solver.
+      /// The linear systems are thus solved only roughly far from the solution. Ignored for direct solvers.
+      /// Default: false
+      /// \param[in] max_forcing_term The largest (and the first) relative tolerance, in (0, 1).
+      /// \param[in] gamma In (0, 1].
+      /// \param[in] alpha In (1, 2].
+      void set_inexact_newton(bool onOff = true, double max_forcing_term = 0.9, double gamma = 0.9, double alpha = 2.0);
+
       /// Set the residual norm tolerance for ending the Newton's loop.
       /// Default: 1E-8.
       void set_newton_tol(double newton_tol);
@@ -185,6 +212,13 @@ namespace Hermes
       /// Set the weak forms.
       void set_weak_formulation(const WeakForm<Scalar>* wf);
 
+      /// The statistics of the linear solves of the last solve() or solve_keep_jacobian(),
+      /// summed over the Newton iterations (see LinearMatrixSolver::get_statistics()).
+      const LinearMatrixSolverStatistics& get_linear_solver_statistics() const;
+
+      /// The matrix solver, with the factorization of the Jacobian of the last Newton iteration (see GoalOrientedAdapt::solve_adjoint()).
+      LinearMatrixSolver<Scalar>* get_linear_matrix_solver();
+
     protected:
       /// This instance owns its DP.
       const bool own_dp;
@@ -195,6 +229,20 @@ namespace Hermes
       /// Internal setting of default values (see individual set methods).
       void init_attributes();
 
+      /// Replace the assembled Jacobian and its linear solver by the matrix-free Jacobian
+      /// (Hermes::Algebra::MatrixFreeJacobian) solved by GMRES, or back, according to
+      /// DiscreteProblem::is_matrix_free().
+      void init_matrix_free_solver();
+
+      /// Solves the linear system of one iteration, adds its statistics to linear_solver_statistics.
+      bool solve_linear_system();
+
+      /// Sets the tolerance of the iterative linear solver for the iteration it, see set_inexact_newton().
+      void update_forcing_term(int it, double residual_norm, double last_residual_norm);
+
+      /// The Jacobian is matrix-free, the products with it are finite differences of residuals.
+      bool matrix_free;
+
       /// Jacobian.
       SparseMatrix<Scalar>* jacobian;
 
@@ -203,10 +251,28 @@ namespace Hermes
 
       /// Linear solver.
       LinearMatrixSolver<Scalar>* linear_solver;
+      /// See get_linear_solver_statistics().
+      LinearMatrixSolverStatistics linear_solver_statistics;
 
       double newton_tol;
       int newton_max_iter;
       bool residual_as_function;
+      /// See set_jacobian_with_residual().
+      bool jacobian_with_residual;
+
+      /// See set_jacobian_reuse().
+      bool jacobian_reuse;
+      double jacobian_reuse_max_contraction;
+      /// The Jacobian has been assembled (and factorized) and can be reused in solve().
+      bool jacobian_reusable;
+
+      /// See set_inexact_newton().
+      bool inexact_newton;
+      double max_forcing_term;
+      double forcing_gamma;
+      double forcing_alpha;
+      /// The last relative tolerance of the linear solver.
+      double forcing_term;
 
       /// Maximum allowed residual norm. If this number is exceeded, the methods solve() return 'false'.
       /// By default set to 1E6.
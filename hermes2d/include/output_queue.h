@@ -0,0 +1,220 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+/*! \file output_queue.h
+\brief Output of the computed states in a background thread.
+*/
+#ifndef __H2D_OUTPUT_QUEUE_H
+#define __H2D_OUTPUT_QUEUE_H
+
+#include "global.h"
+#include "function/solution.h"
+#include "calculation_continuity.h"
+#include "views/linearizer.h"
+#include "views/image_renderer.h"
+#include <deque>
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    /// @ingroup userSolvingAPI
+    /// \brief A state of the computation as the output sees it.
+    /// The meshes and the spaces are copies owned by the OutputQueue, the solutions are recreated from the coefficient vector.
+    template<typename Scalar>
+    struct OutputSnapshot
+    {
+      double time;
+      unsigned int number;
+      double time_step;
+      Hermes::vector<Mesh*> meshes;
+      Hermes::vector<Space<Scalar>*> spaces;
+      Hermes::vector<Solution<Scalar>*> solutions;
+    };
+
+    /// @ingroup userSolvingAPI
+    /// \brief One kind of the output of an OutputQueue, called in its background thread.
+    template<typename Scalar>
+    class HERMES_API OutputWriter
+    {
+    public:
+      virtual ~OutputWriter() {};
+
+      /// Writes the snapshot, the snapshots come in the order of OutputQueue::push().
+      /// The snapshot and its contents are not to be kept after the call.
+      virtual void write(OutputSnapshot<Scalar>* snapshot) = 0;
+    };
+
+    /// @ingroup userSolvingAPI
+    /// \brief Binary output of the linearized solutions (see Views::LinearizedDataWriter), one time series per solution.
+    class HERMES_API LinearizerOutputWriter : public OutputWriter<double>
+    {
+    public:
+      /// @param[in] file_name The name of the files without the extension, the index of the solution is appended if there are more.
+      LinearizerOutputWriter(const char* file_name, const char* quantity_name, Views::LinearizedDataWriter::Format format = Views::LinearizedDataWriter::VTU_BINARY,
+        bool mode_3D = false, int item = H2D_FN_VAL_0, double eps = Views::HERMES_EPS_NORMAL);
+      virtual ~LinearizerOutputWriter();
+
+      virtual void write(OutputSnapshot<double>* snapshot);
+
+    protected:
+      std::string file_name;
+      std::string quantity_name;
+      Views::LinearizedDataWriter::Format format;
+      bool mode_3D;
+      int item;
+      double eps;
+      Views::Linearizer linearizer;
+      /// The writers of the solutions, created by the first snapshot.
+      Hermes::vector<Views::LinearizedDataWriter*> writers;
+    };
+
+    /// @ingroup userSolvingAPI
+    /// \brief Renders the solutions into PNG images (see Views::ImageRenderer), as file_name_<number>.png,
+    /// or file_name_<number>_<solution>.png if there are more solutions. Needs no display, the frames of a movie.
+    class HERMES_API ImageOutputWriter : public OutputWriter<double>
+    {
+    public:
+      ImageOutputWriter(const char* file_name, int width = H2D_DEFAULT_WIDTH, int height = H2D_DEFAULT_HEIGHT,
+        int item = H2D_FN_VAL_0, double eps = Views::HERMES_EPS_NORMAL);
+
+      virtual void write(OutputSnapshot<double>* snapshot);
+
+      /// For the settings of the images (range, palette, edges), e.g. a fixed range for comparable frames.
+      Views::ImageRenderer* get_renderer();
+
+    protected:
+      std::string file_name;
+      int item;
+      double eps;
+      Views::ImageRenderer renderer;
+    };
+
+    /// @ingroup userSolvingAPI
+    /// \brief Saves the solutions and the spaces in the binary format (Solution::save_binary(), Space::save_binary()),
+    /// as file_name_<number>_<solution>.h2d and file_name_<number>_<solution>_space.h2d.
+    template<typename Scalar>
+    class HERMES_API SolutionOutputWriter : public OutputWriter<Scalar>
+    {
+    public:
+      SolutionOutputWriter(const char* file_name);
+
+      virtual void write(OutputSnapshot<Scalar>* snapshot);
+
+    protected:
+      std::string file_name;
+    };
+
+    /// @ingroup userSolvingAPI
+    /// \brief Adds the snapshots as the records of a CalculationContinuity.
+    template<typename Scalar>
+    class HERMES_API ContinuityOutputWriter : public OutputWriter<Scalar>
+    {
+    public:
+      /// @param[in] continuity Not deleted by this class. The records are identified by the time and the number of the snapshots,
+      /// as required by its identification method.
+      ContinuityOutputWriter(CalculationContinuity<Scalar>* continuity, typename CalculationContinuity<Scalar>::IdentificationMethod identification_method);
+
+      virtual void write(OutputSnapshot<Scalar>* snapshot);
+
+    protected:
+      CalculationContinuity<Scalar>* continuity;
+      typename CalculationContinuity<Scalar>::IdentificationMethod identification_method;
+    };
+
+    /// @ingroup userSolvingAPI
+    /// \brief Hands the computed states over to a background thread that runs the output writers, so that
+    /// the writing of the files does not block the computation.
+    ///
+    /// push() copies the coefficient vector; the spaces (with their meshes) are copied only when they changed since the previous
+    /// push(), the consecutive snapshots of unchanged spaces share the copies. The background thread recreates the solutions
+    /// on the copies and calls the writers. If max_queued snapshots are waiting, push() blocks until one of them is written,
+    /// which caps the memory used by the queue.
+    /// The Dirichlet lift of a shared copy is the one of the push() that made it, time-dependent essential conditions
+    /// need a change of the space (e.g. Space::update_essential_bc_values() followed by a new assignment of the dofs).
+    /// An exception of a writer is rethrown by the next push() or finish().
+    template<typename Scalar>
+    class HERMES_API OutputQueue : public Hermes::Mixins::Loggable
+    {
+    public:
+      OutputQueue(unsigned int max_queued = 2);
+      /// Writes all the queued snapshots.
+      virtual ~OutputQueue();
+
+      /// Adds a writer (not deleted by the queue), has to be called before the first push().
+      void add_writer(OutputWriter<Scalar>* writer);
+
+      /// Queues the state given by the coefficient vector (of all the spaces).
+      void push(double time, unsigned int number, const Scalar* coeff_vec, Hermes::vector<const Space<Scalar>*> spaces, double time_step = 0.0);
+      void push(double time, unsigned int number, const Scalar* coeff_vec, const Space<Scalar>* space, double time_step = 0.0);
+
+      /// Waits until all the queued snapshots are written.
+      void finish();
+
+      /// The number of the snapshots waiting for the output.
+      unsigned int get_num_queued();
+
+    protected:
+      /// A copy of a space shared by the snapshots, deleted by the last one.
+      struct SpaceCopy
+      {
+        const Space<Scalar>* original;
+        int original_seq;
+        unsigned int original_mesh_seq;
+        int num_dofs;
+        Mesh* mesh;
+        Space<Scalar>* space;
+        int ref_count;
+      };
+
+      struct QueuedSnapshot
+      {
+        double time;
+        unsigned int number;
+        double time_step;
+        Scalar* coeff_vec;
+        Hermes::vector<SpaceCopy*> spaces;
+      };
+
+      static void* output_thread_func(void* queue);
+      void output_loop();
+      void write(QueuedSnapshot* snapshot);
+
+      /// Releases the reference, assumes the lock.
+      void release(SpaceCopy* space_copy);
+
+      /// Throws the exception of the writers.
+      void rethrow();
+
+      static Space<Scalar>* copy_space(const Space<Scalar>* space, Mesh* mesh);
+
+      unsigned int max_queued;
+      Hermes::vector<OutputWriter<Scalar>*> writers;
+      std::deque<QueuedSnapshot*> queue;
+      /// The copies of the spaces of the last push().
+      Hermes::vector<SpaceCopy*> last_spaces;
+
+      pthread_t thread;
+      bool thread_running;
+      bool stopping;
+      /// A snapshot is being written.
+      bool busy;
+      pthread_mutex_t mutex;
+      pthread_cond_t cond_queued;
+      pthread_cond_t cond_written;
+      Hermes::Exceptions::Exception* caughtException;
+    };
+  }
+}
+#endif
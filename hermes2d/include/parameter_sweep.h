@@ -0,0 +1,87 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef __H2D_PARAMETER_SWEEP_H
+#define __H2D_PARAMETER_SWEEP_H
+
+#include "discrete_problem_linear.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    /// @ingroup userSolvingAPI
+    /// \brief Solves many instances of a linear problem on the same spaces, differing only in the parameters of the forms (a parameter sweep).
+    ///
+    /// Every instance is given by its weak formulation, all of them with the same forms on the same blocks.
+    /// The instances share one DiscreteProblemLinear (see DiscreteProblem::replace_weak_formulation()), so the traversal states,
+    /// the sparse structure, the scatter maps and the precalculated values of the shape functions are calculated once.
+    /// The instances are processed in rounds of get_num_concurrent() of them: the systems of a round are assembled one after another
+    /// (every assembling using all the threads) and then solved concurrently, one instance per thread. Every slot of a round keeps
+    /// its matrix and its linear solver for the following rounds, so the direct solvers reuse their symbolic factorization
+    /// (the matrices having the same sparse structure) and only the numeric factorization is calculated for every instance.
+    /// The concurrent solves are used with UMFPACK and the built-in Krylov solvers, the other backends solve the instances one after another.
+    ///
+    /// Typical usage:<br>
+    /// ParameterSweep<double> sweep(weakforms, &space);<br>
+    /// sweep.solve();<br>
+    /// for(int i = 0; i < sweep.get_num_instances(); i++)<br>
+    ///&nbsp;Solution<double>::vector_to_solution(sweep.get_sln_vector(i), &space, &slns[i]);<br>
+    template<typename Scalar>
+    class HERMES_API ParameterSweep : public Hermes::Mixins::Loggable, public Hermes::Mixins::TimeMeasurable
+    {
+    public:
+      ParameterSweep(Hermes::vector<const WeakForm<Scalar>*> weakforms, Hermes::vector<const Space<Scalar>*> spaces);
+      ParameterSweep(Hermes::vector<const WeakForm<Scalar>*> weakforms, const Space<Scalar>* space);
+      virtual ~ParameterSweep();
+
+      /// The number of the instances solved at once.
+      /// @param[in] num_concurrent 0 for the number of threads (Hermes2DApiParam::numThreads, the default).
+      void set_num_concurrent(int num_concurrent);
+      int get_num_concurrent() const;
+
+      /// Assembles and solves all the instances.
+      void solve();
+
+      int get_num_instances() const;
+
+      /// The solution vector of the instance, valid after solve().
+      Scalar* get_sln_vector(int instance);
+
+    protected:
+      void init(Hermes::vector<const Space<Scalar>*> spaces);
+
+      /// Makes sure there are count slots.
+      void init_slots(int count);
+      void free_slots();
+
+      Hermes::vector<const WeakForm<Scalar>*> weakforms;
+      DiscreteProblemLinear<Scalar>* dp;
+      int num_concurrent;
+
+      /// The matrices, the right-hand sides and the solvers of the slots of a round.
+      std::vector<SparseMatrix<Scalar>*> matrices;
+      std::vector<Vector<Scalar>*> rhss;
+      std::vector<LinearMatrixSolver<Scalar>*> solvers;
+
+      /// The solution vectors of the instances.
+      std::vector<Scalar*> sln_vectors;
+      int ndof;
+
+      /// The first exception of the concurrent solves.
+      Hermes::Exceptions::ParallelStatus solve_status;
+    };
+  }
+}
+#endif
@@ -0,0 +1,129 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+/*! \file parareal.h
+\brief Parallel-in-time integration (Parareal) over the Runge-Kutta methods.
+*/
+#ifndef __H2D_PARAREAL_H
+#define __H2D_PARAREAL_H
+
+#include "runge_kutta.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    /// @ingroup userSolvingAPI
+    /// Parareal method for time-dependent problems M\dot{Y} = F(t, Y) (the weak formulation as for RungeKutta).
+    ///
+    /// The time interval is split into slices. A cheap coarse propagator G (a few steps of RungeKutta with a coarse
+    /// Butcher's table) predicts the states at the slice boundaries one after another, the expensive fine propagator F
+    /// (many steps with the fine table) is run on all the slices at once, and the states are corrected by
+    /// U_{n+1}^{k+1} = G(U_n^{k+1}) + F(U_n^k) - G(U_n^k)
+    /// until they do not change anymore. After k iterations, the first k slices are exact (the same as with
+    /// the fine propagator only), so at most num_slices iterations are done.
+    ///
+    /// Every thread of the fine propagation has its own copies of the spaces, its own RungeKutta instance (with its
+    /// DiscreteProblems, matrices and solvers) and Solutions, only the meshes and the weak formulation are shared.
+    /// The spaces must not change during solve().
+    template<typename Scalar>
+    class HERMES_API Parareal : public Hermes::Mixins::Loggable, public Hermes::Mixins::TimeMeasurable
+    {
+    public:
+      Parareal(const WeakForm<Scalar>* wf, Hermes::vector<const Space<Scalar>*> spaces, ButcherTable* bt_coarse, ButcherTable* bt_fine);
+      Parareal(const WeakForm<Scalar>* wf, const Space<Scalar>* space, ButcherTable* bt_coarse, ButcherTable* bt_fine);
+      virtual ~Parareal();
+
+      /// Number of time steps of the coarse propagator per slice.
+      /// Default: 1
+      void set_coarse_steps(unsigned int steps);
+      /// Number of time steps of the fine propagator per slice.
+      /// Default: 10
+      void set_fine_steps(unsigned int steps);
+      /// The iterations stop if the largest change of a slice boundary state (in the l2-norm, relative to the norm of the state)
+      /// is below the tolerance.
+      /// Default: 1e-6
+      void set_tolerance(double tolerance);
+      /// Upper bound of the number of Parareal iterations.
+      /// Default: 0 (no bound, the method is exact after num_slices iterations).
+      void set_max_iterations(unsigned int max_iterations);
+      /// Number of threads running the fine propagators (at most one slice per thread at a time).
+      /// Default: the number of threads of Hermes2DApi (numThreads).
+      void set_num_threads(int num_threads);
+
+      /// Settings of the Newton's method of all the Runge-Kutta propagators.
+      void set_newton_tol(double newton_tol);
+      void set_newton_max_iter(int newton_max_iter);
+
+      /// Integrates from t_start to t_end in num_slices time slices.
+      /// \param[in] slns_initial The initial condition (projected on the spaces).
+      /// \param[out] slns_end The solution at t_end.
+      void solve(Hermes::vector<Solution<Scalar>*> slns_initial, Hermes::vector<Solution<Scalar>*> slns_end, double t_start, double t_end, unsigned int num_slices);
+      void solve(Solution<Scalar>* sln_initial, Solution<Scalar>* sln_end, double t_start, double t_end, unsigned int num_slices);
+
+      /// Number of the Parareal iterations of the last solve().
+      unsigned int get_num_iterations() const;
+
+      /// The coefficient vector of the state at the beginning of the slice (slice == num_slices for t_end) after solve().
+      Scalar* get_slice_vector(unsigned int slice);
+
+    protected:
+      /// Time integration of coefficient vectors with one ButcherTable, on its own copies of the spaces.
+      class HERMES_API Propagator
+      {
+      public:
+        Propagator(const WeakForm<Scalar>* wf, Hermes::vector<const Space<Scalar>*> spaces, ButcherTable* bt);
+        ~Propagator();
+
+        /// Integrates the state in from time by num_steps steps of length time_step, the result is stored in out.
+        void propagate(Scalar* in, Scalar* out, double time, double time_step, unsigned int num_steps);
+
+        Hermes::vector<Space<Scalar>*> spaces;
+        Hermes::vector<const Space<Scalar>*> spaces_const;
+        RungeKutta<Scalar>* runge_kutta;
+        Hermes::vector<Solution<Scalar>*> slns_prev;
+        Hermes::vector<Solution<Scalar>*> slns_new;
+      };
+
+      void init(ButcherTable* bt_coarse, ButcherTable* bt_fine);
+
+      /// Fine propagators, one per thread, created in solve().
+      void create_fine_propagators(int count);
+
+      void free_states();
+
+      const WeakForm<Scalar>* wf;
+      Hermes::vector<const Space<Scalar>*> spaces;
+      ButcherTable* bt_fine;
+
+      Propagator* coarse_propagator;
+      Hermes::vector<Propagator*> fine_propagators;
+
+      unsigned int coarse_steps;
+      unsigned int fine_steps;
+      double tolerance;
+      unsigned int max_iterations;
+      int num_threads;
+      double newton_tol;
+      int newton_max_iter;
+
+      /// States at the slice boundaries (num_slices + 1 vectors of length ndof).
+      Scalar** states;
+      unsigned int num_states;
+      int ndof;
+      unsigned int num_iterations;
+    };
+  }
+}
+#endif
@@ -127,7 +127,14 @@ namespace Hermes
     protected:
       void init();
       
-      static void calculate_anderson_coeffs(Scalar** previous_vectors, Scalar* anderson_coeffs, int num_last_vectors_used, int ndof);
+      /// The Anderson coefficients from the products of the last num_last_vectors_used - 1 residuals (see store_anderson_vector()).
+      static void calculate_anderson_coeffs(Scalar* residual_products, int* residual_slots, Scalar* anderson_coeffs, int num_last_vectors_used);
+
+      /// Stores new_vector as the newest one of the ring buffer previous_vectors (in place of the oldest one if full), its
+      /// difference to the previous newest one into previous_residuals and the products of this residual with the kept ones into
+      /// residual_products, all in one parallel pass over the vectors. residual_slots lists the slots of the residuals from the oldest one.
+      static void store_anderson_vector(Scalar* new_vector, Scalar* previous_vectors, Scalar* previous_residuals, Scalar* residual_products,
+        int* residual_slots, int& vec_in_memory, int& newest_vector, int num_last_vectors_used, int ndof);
       
       bool verbose_output_linear_solver;
 
@@ -53,7 +53,33 @@ namespace Hermes
           Hermes::vector<Solution<Scalar>*> source_slns, Hermes::vector<Solution<Scalar>*> target_slns,
           Hermes::vector<ProjNormType> proj_norms = Hermes::vector<ProjNormType>(), bool delete_old_mesh = false);
 
+      /// The L2 projection onto an L2 (DG) space, element by element: the global mass matrix is block diagonal,
+      /// so every element solves with its own mass matrix, which is the same (up to the constant jacobian) for all
+      /// the affine elements of one order and is inverted just once per order. The source function is evaluated
+      /// at all the quadrature points at once (on the finer elements, if its mesh is finer), the elements are
+      /// processed in parallel. The result is the same as with OGProjection in the L2 norm.
+      static void project_local_l2(const Space<Scalar>* space, MeshFunction<Scalar>* meshfn, Scalar* target_vec);
+
+      /// The averaged element-local L2 projections onto a space of scalar functions, e.g. the previous reference solution
+      /// onto the new reference space as the initial guess of the next adaptivity step (NewtonSolver::solve(Scalar*)).
+      /// Every element of the space projects the function onto its own shape functions (the function is evaluated on the finer
+      /// elements, if its mesh is finer, through the union of the meshes, which have to share the base mesh), the elements
+      /// in parallel, and the coefficients of the DOFs shared by several elements are averaged. Where the function belongs
+      /// to the space (the mesh of the space is a refinement of the one of the function and the orders did not decrease),
+      /// it is reproduced exactly, elsewhere the result is a quasi-interpolant. No global system is assembled or solved.
+      /// The DOFs constrained in all their elements (by hanging nodes) get zero.
+      static void project_local_averaged(const Space<Scalar>* space, MeshFunction<Scalar>* meshfn, Scalar* target_vec);
+
+      /// Wrapper that takes multiple Solutions.
+      static void project_local_averaged(Hermes::vector<const Space<Scalar>*> spaces, Hermes::vector<Solution<Scalar>*> slns, Scalar* target_vec);
+
     protected:
+      /// inv = a^{-1}, Gauss-Jordan elimination with partial pivoting (a is overwritten).
+      static void invert_element_matrix(double* a, double* inv, int n);
+
+      /// Orders the states by the element of the first mesh.
+      static bool compare_states_by_first_element(Traverse::State* a, Traverse::State* b);
+
       static int ndof;
     };
   }
@@ -0,0 +1,101 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef __H2D_MESH_TRANSFER_H
+#define __H2D_MESH_TRANSFER_H
+
+#include "ogprojection.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    /// @ingroup meshFunctions
+    /// \brief A Solution defined on one mesh evaluated at the points of another (unrelated) mesh.
+    ///
+    /// The function lives on the target mesh, so that it can be integrated against the spaces on it.
+    /// All the integration points of an element are evaluated at once by Solution::get_pt_values(),
+    /// which finds the elements of the source mesh through its point location index (see ElementLocator),
+    /// trying the element of the previous point first. The points outside of the source domain get zero values.
+    /// The values are always the physical ones, second derivatives are not available.
+    template<typename Scalar>
+    class HERMES_API TransferredFunction : public MeshFunction<Scalar>
+    {
+    public:
+      /// @param[in] mesh The target mesh.
+      /// @param[in] source The transferred solution, not deleted by this class.
+      TransferredFunction(const Mesh* mesh, Solution<Scalar>* source);
+      virtual ~TransferredFunction();
+
+      virtual Func<Scalar>* get_pt_value(double x, double y, Element* e = NULL);
+
+      /// The clone works with a clone of the source.
+      virtual MeshFunction<Scalar>* clone() const;
+
+      inline std::string getClassName() const { return "TransferredFunction"; }
+
+    protected:
+      virtual void set_active_element(Element* e);
+
+      virtual void free();
+
+      virtual void precalculate(int order, int mask);
+
+      Solution<Scalar>* source;
+      /// The source is a clone to be deleted.
+      bool own_source;
+
+      /// The precalculated tables, see Filter::tables.
+#ifdef _MSC_VER // For Visual Studio compiler the latter does not compile.
+      std::map<uint64_t, NodeTable<Node*>*> tables[H2D_MAX_QUADRATURES];
+#else
+      std::map<uint64_t, NodeTable<struct Function<Scalar>::Node*>*> tables[H2D_MAX_QUADRATURES];
+#endif
+    };
+
+    /// @ingroup projections
+    /// \brief Transfers solutions between meshes, e.g. after remeshing or for coupling two physics on different meshes.
+    ///
+    /// When the meshes share the base mesh (they differ by refinements only), the source is projected directly,
+    /// its values being obtained through the union of the meshes (see Traverse). Otherwise the source is evaluated
+    /// at the integration points of the target mesh through TransferredFunction. Either way the result is the
+    /// projection of the source onto the target space in the given norm. The factorized Gram matrices of the target
+    /// spaces are kept (see OGProjection), so keep the instance for repeated transfers onto the same space.
+    template<typename Scalar>
+    class HERMES_API MeshTransfer : public Hermes::Mixins::Loggable
+    {
+    public:
+      MeshTransfer();
+      virtual ~MeshTransfer();
+
+      /// Transfers the source onto the space, the coefficient vector is stored in target_vec.
+      void transfer(const Space<Scalar>* space, Solution<Scalar>* source, Scalar* target_vec, ProjNormType proj_norm = HERMES_UNSET_NORM);
+
+      /// Wrapper that delivers a Solution instead of a coefficient vector.
+      void transfer(const Space<Scalar>* space, Solution<Scalar>* source, Solution<Scalar>* target_sln, ProjNormType proj_norm = HERMES_UNSET_NORM);
+
+      /// Wrapper for multiple sources that delivers the coefficient vector.
+      void transfer(Hermes::vector<const Space<Scalar>*> spaces, Hermes::vector<Solution<Scalar>*> sources,
+        Scalar* target_vec, Hermes::vector<ProjNormType> proj_norms = Hermes::vector<ProjNormType>());
+
+      /// True if the meshes have the same base elements, i.e. if they can be traversed together.
+      static bool share_base_mesh(const Mesh* mesh_a, const Mesh* mesh_b);
+
+    protected:
+      OGProjection<Scalar> ogProjection;
+    };
+  }
+}
+#endif
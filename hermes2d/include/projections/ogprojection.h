@@ -24,17 +24,29 @@ namespace Hermes
 {
   namespace Hermes2D
   {
+    template<typename Scalar> class DiscreteProblemLinear;
+
     /** @defgroup projections Projections
     * \brief Projection classes for various kinds of projecting a MeshFunction onto a Space.
     */
 
     /// @ingroup projections
     /// \brief Class for (global) orthogonal projecting. If the projection is not necessary (if a solution belongs to the space), then its solution vector is used.
+    ///
+    /// The projections in the built-in norms keep the factorized Gram matrix of every space (and norm) they were done on,
+    /// so that projecting further functions onto the same space (e.g. all the previous time levels in time stepping) only
+    /// needs the assembling of the right-hand side and a back-substitution. The matrix is assembled again when the space
+    /// changes (its sequence number). To profit from this, keep the instance for all such projections.
+    /// The L2 projections onto L2 spaces do not use any global matrix, see LocalProjection::project_local_l2().
     template<typename Scalar>
     class HERMES_API OGProjection : public Hermes::Mixins::Loggable
     {
     public:
       OGProjection();
+      virtual ~OGProjection();
+
+      /// Frees the kept Gram matrices.
+      void free_gram_matrices();
 
       /// Main functionality is in the protected method project_internal().
       
@@ -109,6 +121,33 @@ namespace Hermes
       /// PDE, the PDE will just be solved.
       void project_internal(const Space<Scalar>* space, WeakForm<Scalar>* proj_wf, Scalar* target_vec);
 
+      /// The projection in one of the built-in norms, reusing the factorized Gram matrix of the space.
+      void project_internal(const Space<Scalar>* space, MeshFunction<Scalar>* source_meshfn, ProjNormType norm, Scalar* target_vec);
+
+      /// The factorized Gram matrix of a space in a norm, with the projection weak form and the structures
+      /// for assembling the right-hand sides.
+      class GramMatrix
+      {
+      public:
+        GramMatrix(const Space<Scalar>* space, ProjNormType norm);
+        ~GramMatrix();
+
+        const Space<Scalar>* space;
+        int space_seq;
+        int ndof;
+        ProjNormType norm;
+        WeakForm<Scalar>* wf;
+        DiscreteProblemLinear<Scalar>* dp;
+        SparseMatrix<Scalar>* matrix;
+        Vector<Scalar>* rhs;
+        LinearMatrixSolver<Scalar>* solver;
+        /// The matrix is assembled and factorized.
+        bool factorized;
+      };
+
+      /// The Gram matrices of the projections done so far.
+      Hermes::vector<GramMatrix*> gram_matrices;
+
       /// Jacobian matrix (same as stiffness matrix since projections are linear).
       class ProjectionMatrixFormVol : public MatrixFormVol<Scalar>
       {
@@ -32,6 +32,7 @@ namespace Hermes
     static int H2D_GIP1D_W = 1;
 
     const int g_max_quad = 24;
+    /// Tabulated triangle rules, the orders above (up to g_max_quad) are collapsed Gauss rules.
     const int g_max_tri = 20;
 
     /// Quad1D is a base class for all 1D quadrature points.
@@ -62,8 +63,8 @@ namespace Hermes
     class HERMES_API Quad2D
     {
     public:
-      inline int get_num_points(int order, ElementMode2D mode)  const { assert(order < num_tables[mode]); return np[mode][order]; };
-      inline double3* get_points(int order, ElementMode2D mode) const { assert(order < num_tables[mode]); return tables[mode][order]; }
+      inline int get_num_points(int order, ElementMode2D mode)  const { assert(order < num_tables[mode]); if(tables[mode][order] == NULL) make_table(order, mode); return np[mode][order]; };
+      inline double3* get_points(int order, ElementMode2D mode) const { assert(order < num_tables[mode]); if(tables[mode][order] == NULL) make_table(order, mode); return tables[mode][order]; }
       inline int get_edge_points(int edge, int order, ElementMode2D mode) {assert(order < num_tables[mode]);  return  max_order[mode]+1 + (3*(1-mode) + 4*mode)*order + edge;}
 
       inline int get_max_order(ElementMode2D mode) const { return max_order[mode]; }
@@ -73,6 +74,10 @@ namespace Hermes
       inline double2* get_ref_vertex(int n, ElementMode2D mode) { return &ref_vert[mode][n]; }
 
     protected:
+      /// Creates the table (of an order or an edge) on its first use, for the quadratures that do not
+      /// create all of their tables in advance (leaving them NULL). Has to be thread-safe.
+      virtual void make_table(int table, ElementMode2D mode) const {}
+
       double3*** tables;
       int** np;
 
@@ -39,6 +39,11 @@ namespace Hermes
              ~Quad2DStd();
 
              virtual void dummy_fn() {}
+
+    protected:
+             /// The tables except for the tabulated triangle rules are created on the first use,
+             /// so that the programs do not pay for the orders they never integrate with.
+             virtual void make_table(int table, ElementMode2D mode) const;
     };
 
     extern HERMES_API Quad1DStd g_quad_1d_std;
@@ -69,6 +69,7 @@ namespace Hermes
       protected: //options
         bool opt_symmetric_mesh; ///< True if ::H2D_PREFER_SYMMETRIC_MESH is set. True by default.
         bool opt_apply_exp_dof; ///< True if ::H2D_APPLY_CONV_EXP_DOF is set. False by default.
+        double candidate_pruning; ///< See set_candidate_pruning(). Zero by default.
       public:
         /// Enables or disables an option.
         /** If overridden, the implementation has to call a parent implementation.
@@ -76,6 +77,11 @@ namespace Hermes
         *  \param[in] enable True to enable, false to disable. */
         virtual void set_option(const SelOption option, bool enable);
 
+        /// Discards the unlikely anisotropic candidates of a quad before the (projection-based) evaluation, see prune_candidates().
+        /** \param[in] level A number in [0, 1]: 0 (the default) keeps all the candidates, the larger the level, the more anisotropic
+        *  candidates are discarded, trading the optimality of the selection for its speed. */
+        void set_candidate_pruning(double level);
+
         /// A candidate.
         struct Cand {
           double error; ///< An error of this candidate.
@@ -181,6 +187,16 @@ namespace Hermes
         *  \param[in] max_p_quad_order A maximum encoded order of an element of a P-candidate. */
         virtual void create_candidates(Element* e, int quad_order, int max_ha_quad_order, int max_p_quad_order);
 
+        /// Removes the candidates that are unlikely to be selected, called after create_candidates() if set_candidate_pruning() was set.
+        /** The indicator is the directional variation of the reference solution: the differences of its averages over the four quarters
+        *  of the element along the horizontal and the vertical direction (a few integration points per quarter). If the anisotropy
+        *  |Vx - Vy| / (Vx + Vy) of the variations is below the pruning level, all the ANISO-candidates and the P-candidates with
+        *  anisotropic changes of orders are removed, otherwise those refining in the direction of the smaller variation are.
+        *  Triangles are not pruned, the unrefined candidate is always kept.
+        *  \param[in] e An element that is being refined.
+        *  \param[in] rsln A reference solution. */
+        virtual void prune_candidates(Element* e, Solution<Scalar>* rsln);
+
         /// Calculates error, dofs, and score of candidates.
         /** \param[in] e An element that is being refined.
         *  \param[in] rsln A reference solution which is used to calculate the error.
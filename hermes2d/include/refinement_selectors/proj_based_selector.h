@@ -30,6 +30,16 @@ namespace Hermes
       *  The maximum allowed order is ::H2DRS_MAX_ORDER + 1. */
       typedef double CandElemProjError[H2DRS_MAX_ORDER + 2][H2DRS_MAX_ORDER + 2];
 
+      /// LU factorization of a projection matrix of a projection-based selector. \ingroup g_selectors
+      /** The factorizations are kept in a global registry shared by all the selectors of the same class
+      *  and the same shapeset (see ProjBasedSelector::get_factored_projection_matrix()), they are released at exit. */
+      struct FactoredProjMatrix
+      {
+        double** lu; ///< The factors as returned by ludcmp(), allocated through new_matrix().
+        int* indx; ///< The row permutation.
+        int size; ///< The number of shapes.
+      };
+
       /// A general projection-based selector. \ingroup g_selectors
       /** Calculates an error of a candidate as a combination of errors of
       *  elements of a candidate. Each element of a candidate is calculated
@@ -74,6 +84,20 @@ namespace Hermes
         TrfShape* cached_shape_ortho_vals; ///< Precalculated valus of orthogonalized shape functions.
         TrfShape* cached_shape_vals; ///< Precalculate values of shape functions.
 
+        /// A projection matrix cache type.
+        /** Defines a cache of factored projection matrices for all possible permutations of orders. */
+        typedef const FactoredProjMatrix* ProjMatrixCache[H2DRS_MAX_ORDER + 2][H2DRS_MAX_ORDER + 2];
+
+        /// An array of factored projection matrices.
+        /** The first index is the mode (see the enum ElementMode2D). The second and the third index
+        *  is the horizontal and the vertical order respectively.
+        *  The matrices are assembled on the reference domain, so they do not depend on the split of a candidate
+        *  and they are shared by all the clones of a selector (see Adapt::adapt()).
+        *
+        *  The records point to the global registry, see get_factored_projection_matrix().
+        *  If record is NULL, the corresponding matrix has to be looked up. */
+        ProjMatrixCache* proj_matrix_cache;
+
       protected: //evaluated shape basis
         /// A transform shaped function expansions.
         /** The contents of the class can be accessed through an array index operator.
@@ -216,18 +240,6 @@ namespace Hermes
           T value; ///< A value stored in the item.
           int state; ///< A state of the image: ::H2DRS_VALCACHE_INVALID or ::H2DRS_VALCACHE_VALID or any other user-defined value. The first user defined state has to have number ::H2DRS_VALCACHE_USER.
         };
-        /// A projection matrix cache type.
-        /** Defines a cache of projection matrices for all possible permutations of orders. */
-        typedef double** ProjMatrixCache[H2DRS_MAX_ORDER + 2][H2DRS_MAX_ORDER + 2];
-
-        /// An array of projection matrices.
-        /** The first index is the mode (see the enum ElementMode2D). The second and the third index
-        *  is the horizontal and the vertical order respectively.
-        *
-        *  All matrices are square dense matrices and they have to be created through the function new_matrix().
-        *  If record is NULL, the corresponding matrix has to be calculated. */
-        ProjMatrixCache proj_matrix_cache[H2D_NUM_MODES];
-
         /// An array of cached right-hand side values.
         /** The first index is an index of the shape function.
         *
@@ -237,6 +249,11 @@ namespace Hermes
         Hermes::vector< ValueCacheItem<Scalar> > nonortho_rhs_cache;
         Hermes::vector< ValueCacheItem<Scalar> > ortho_rhs_cache;
 
+        /// The right-hand side and the shape indices of the projections in calc_error_cand_element(), sized by the largest number
+        /// of shapes so far and reused by all the elements.
+        Hermes::vector<Scalar> right_side_buffer;
+        Hermes::vector<int> shape_inxs_buffer;
+
         double error_weight_h; ///< A coefficient that multiplies error of H-candidate. The default value is ::H2DRS_DEFAULT_ERR_WEIGHT_H.
         double error_weight_p; ///< A coefficient that multiplies error of P-candidate. The default value is ::H2DRS_DEFAULT_ERR_WEIGHT_P.
         double error_weight_aniso; ///< A coefficient that multiplies error of ANISO-candidate. The default value is ::H2DRS_DEFAULT_ERR_WEIGHT_ANISO.
@@ -333,6 +350,13 @@ namespace Hermes
         *  \return A projection matrix. The matrix has to be allocated trought new_matrix(). The size of the matrix has to be \a num_shapes x \a num_shapes. */
         virtual double** build_projection_matrix(double3* gip_points, int num_gip_points, const int* shape_inx, const int num_shapes, ElementMode2D) = 0;
 
+        /// Returns the LU factorization of the projection matrix of a given set of shapes.
+        /** The factorization is taken from a global registry shared by all the selectors, build_projection_matrix() is called
+        *  only if no selector of the same class with the same shapeset has factored the matrix of these shapes yet.
+        *  The caller has to make sure the method is not called concurrently (critical section proj_matrix_cache).
+        *  \return The factorization, owned by the registry. */
+        const FactoredProjMatrix* get_factored_projection_matrix(double3* gip_points, int num_gip_points, const int* shape_inx, const int num_shapes, ElementMode2D mode);
+
         /// Evaluates a value of the right-hande side in a subdomain.
         /** Override to calculate a value of the right-hand side.
         *  \param[in] sub_elem An element of a reference mesh that corresponds to a subdomain.
@@ -21,19 +21,16 @@
 #include "function/filter.h"
 #include "exceptions.h"
 #include "mixins2d.h"
+#include "projections/ogprojection.h"
 namespace Hermes
 {
   namespace Hermes2D
   {
     // TODO LIST:
     //
-    // (1) With explicit and diagonally implicit methods, the matrix is treated
-    //     in the same way as with fully implicit ones. To make this more
-    //     efficient, with explicit and diagonally implicit methods one should
-    //     first only solve for the upper left block, then eliminate all blocks
-    //     under it, then solve for block at position 22, eliminate all blocks
-    //     under it, etc. Currently this is not done and everything is left to
-    //     the matrix solver.
+    // (1) With explicit and diagonally implicit methods, the stages are solved
+    //     one after another (see set_decoupled_stages()). Fully implicit methods
+    //     still solve the coupled system of all the stages.
     //
     // (2) In example 03-timedep-adapt-space-and-time with implicit Euler
     //     method, Newton's method takes much longer than in 01-timedep-adapt-space-only
@@ -54,9 +51,8 @@ namespace Hermes
     //     now, the sparsity structure is created expensively in each block
     //     again.
     //
-    // (5) If space does not change, the sparsity does not change. Right now
-    //     we discard everything at the end of every time step, we should not
-    //     do it.
+    // (5) Done: if the spaces do not change, the stage spaces, the sparsity and
+    //     the mass matrix are kept from the previous time step.
     //
     // (6) If the problem does not depend explicitly on time, then all the blocks
     //     in the Jacobian matrix of the stationary residual are the same up
@@ -70,8 +66,15 @@ namespace Hermes
     //     (he has them online), and possibly in his book.
     /// @ingroup userSolvingAPI
     /// Runge-Kutta methods implementation for time-dependent problems.
+    /// With an IMEX Butcher's table (ButcherTable::is_imex(), e.g. IMEX_ARS_222), the forms set explicit in time
+    /// (Form::set_explicit_in_time()) are evaluated with the explicit table, the stage Jacobians only contain
+    /// the other forms. The matrix forms of the explicit terms (if any) are not used. Requires the decoupled
+    /// stages (set_decoupled_stages()); with tables that are not IMEX, the explicit-in-time flags are ignored.
+    ///
+    /// A time step calls on_initialization() at its start and on_finish() after the new time level solutions are set
+    /// (see OutputAttachable), e.g. for an in-situ output of them (InSituOutput).
     template<typename Scalar>
-    class HERMES_API RungeKutta : public Hermes::Mixins::Loggable, public Hermes::Mixins::TimeMeasurable, public Hermes::Mixins::IntegrableWithGlobalOrder, public Hermes::Mixins::SettableComputationTime, public Hermes::Hermes2D::Mixins::SettableSpaces<Scalar>, public Hermes::Hermes2D::Mixins::MatrixRhsOutput<Scalar>
+    class HERMES_API RungeKutta : public Hermes::Mixins::Loggable, public Hermes::Mixins::TimeMeasurable, public Hermes::Mixins::IntegrableWithGlobalOrder, public Hermes::Mixins::SettableComputationTime, public Hermes::Hermes2D::Mixins::SettableSpaces<Scalar>, public Hermes::Hermes2D::Mixins::MatrixRhsOutput<Scalar>, public Hermes::Mixins::OutputAttachable
     {
     public:
       /// Constructor.
@@ -90,7 +93,7 @@ namespace Hermes
       void set_block_diagonal_jacobian();
 
       /// Destructor.
-      ~RungeKutta();
+      virtual ~RungeKutta();
 
       // Perform one explicit or implicit time step using the Runge-Kutta method
       // corresponding to a given Butcher's table. If err_vec != NULL then it will be
@@ -111,7 +114,42 @@ namespace Hermes
       void rk_time_step_newton(Hermes::vector<Solution<Scalar>*> slns_time_prev, Hermes::vector<Solution<Scalar>*> slns_time_new);
       void rk_time_step_newton(Solution<Scalar>* sln_time_prev, Solution<Scalar>* sln_time_new);
 
+      /// Built-in step size control using the embedded pair of the Butcher's table, see rk_time_step_adaptive().
+      /// The error estimate e = h \sum_j (b_j - b2_j) K_j is measured in the scaled norm
+      /// sqrt(1/ndof \sum_i (e_i / (tolerance * (1 + |y_i|)))^2) of the coefficient vector y of the new solution.
+      /// @param[in] tolerance - the step is accepted if the scaled error norm is at most 1.
+      /// @param[in] order - the lower order of the embedded pair (e.g. 2 for Implicit_SDIRK_CASH_3_23_embedded).
+      /// @param[in] min_time_step - the step size control fails (ValueException) below this time step.
+      /// @param[in] max_time_step - the time step is never increased above this length.
+      void set_time_step_control(double tolerance, unsigned int order, double min_time_step = 1e-10, double max_time_step = 1e10);
+
+      /// One time step with the step size control of set_time_step_control(), starting with the time step set by set_time_step().
+      /// A step whose error estimate is too large, or in which the Newton's method fails, is repeated with a shorter time step,
+      /// reusing the stage weak formulations, the matrices and the solvers (slns_time_prev therefore must not be among slns_time_new).
+      /// The length of the next step follows from the PI controller of Gustafsson.
+      /// \return The length of the accepted time step. The time is advanced by it and the proposed next time step is set.
+      double rk_time_step_adaptive(Hermes::vector<Solution<Scalar>*> slns_time_prev, Hermes::vector<Solution<Scalar>*> slns_time_new);
+      double rk_time_step_adaptive(Solution<Scalar>* sln_time_prev, Solution<Scalar>* sln_time_new);
+
+      /// With a diagonally implicit (or explicit) Butcher's table, solve the stages one after another, every one as a system
+      /// of size ndof (the Jacobian being M - h a_ii J_F), instead of the coupled system of size num_stages * ndof.
+      /// With set_freeze_jacobian(), the factorization is shared by all the stages with the same diagonal coefficient
+      /// (all the implicit ones for SDIRK tables), the explicit stages solve with the mass matrix factorized once
+      /// per time step. Has to be called before the first time step. Ignored for fully implicit tables and with
+      /// set_block_diagonal_jacobian(). Default: false.
+      void set_decoupled_stages(bool onOff = true);
+
+      /// With decoupled stages, the explicit stages (a_ii = 0, all of them for explicit tables) use a lumped mass matrix:
+      /// the element blocks of L2 (DG) spaces, inverted exactly, and the row sums for the other spaces. Such a stage is
+      /// then just the residual assembly and a multiplication with the inverse, without any linear solve.
+      /// The lumped inverse is computed once for the spaces. Default: false.
+      void set_lumped_mass(bool onOff = true);
+
       void set_freeze_jacobian();
+      /// Assemble the block Jacobian together with the stage residual in one pass over the elements
+      /// (not in the iterations with the frozen Jacobian). The Jacobian is then also assembled in the
+      /// last Newton iteration, where it is not needed. Default: false.
+      void set_jacobian_with_residual(bool onOff = true);
       void set_newton_tol(double newton_tol);
       void set_newton_max_iter(int newton_max_iter);
       void set_newton_damping_coeff(double newton_damping_coeff);
@@ -134,10 +172,20 @@ namespace Hermes
 
       void set_filters_to_reinit(Hermes::vector<Filter<Scalar>*> filters_to_reinit);
 
+      /// The statistics of the linear solves of the last time step (rk_time_step_newton()), summed over the stages,
+      /// the Newton iterations and the solvers (see LinearMatrixSolver::get_statistics()).
+      const LinearMatrixSolverStatistics& get_linear_solver_statistics() const;
+
     protected:
       /// Initialization of DiscreteProblems.
       void init();
 
+      /// Solves a linear system of the time step, adds its statistics to linear_solver_statistics.
+      bool solve_linear_system(LinearMatrixSolver<Scalar>* linear_solver);
+
+      /// See get_linear_solver_statistics().
+      LinearMatrixSolverStatistics linear_solver_statistics;
+
       /// Takes a matrix M of size ndof times ndof, extends it (formally) to
       /// a num_stages*ndof times num_stages*ndof matrix that has M in diagonal blocks and
       /// zero everywhere else, and multiplies the new matrix with the vector stage_coeff_vec
@@ -153,13 +201,56 @@ namespace Hermes
       /// Below, "stage_wf_left" and "stage_wf_right" refer to the left-hand side M\dot{Y}
       /// and right-hand side F(t, Y) of the above equation, respectively.
       void create_stage_wf(unsigned int size, bool block_diagonal_jacobian);
+
+      /// Creates the mass matrix form(s) M in stage_wf_left.
+      void create_stage_wf_left(unsigned int size);
       
       /// Updates the augmented weak formulation.
       void update_stage_wf(Hermes::vector<Solution<Scalar>*> slns_time_prev);
 
+      /// The stages are solved one after another, see set_decoupled_stages().
+      bool use_decoupled_stages();
+
+      /// Creates the weak formulation of one stage of a diagonally implicit method (size ndof times ndof):
+      /// the stationary forms with the external previous time level solutions.
+      void create_single_stage_wf();
+
+      /// Sets the scaling (-h a_ii) and the time of the stage stage_i to the single stage weak formulation.
+      void update_single_stage_wf(Hermes::vector<Solution<Scalar>*> slns_time_prev, unsigned int stage_i);
+
+      /// The stage stage_i needs to be solved for, i.e. it is used by the new time level solution, its error estimate or another stage.
+      /// With explicit_part = true, the same for the explicit stage of an IMEX table.
+      bool is_stage_used(unsigned int stage_i, bool explicit_part);
+
+      /// stage_u_ext = h \sum_{j = 1}^i a_{ij} K_j (+ h \sum_{j = 1}^{i - 1} \hat{a}_{ij} \hat{K}_j for the IMEX tables),
+      /// the filters are reinitialized with it.
+      void prepare_stage_u_ext(unsigned int stage_i, Scalar* stage_u_ext, Hermes::vector<Solution<Scalar>*> slns_time_new);
+
+      /// The Newton's loops of the stages one after another, the stage vectors are stored in K_vector.
+      void solve_decoupled_stages(Hermes::vector<Solution<Scalar>*> slns_time_prev, Hermes::vector<Solution<Scalar>*> slns_time_new);
+
+      /// The new time level solution (u_{n + 1} = u_n + h \sum_{j = 1}^s b_j k_j) from the stage vectors in K_vector,
+      /// the temporal error estimate, and the end of the time step.
+      void finish_time_step(Hermes::vector<Solution<Scalar>*> slns_time_prev, Hermes::vector<Solution<Scalar>*> slns_time_new,
+        Hermes::vector<Solution<Scalar>*> error_fns);
+
+      /// The inverse of the lumped mass matrix, see set_lumped_mass().
+      void create_lumped_mass();
+
+      /// sln = M_L^{-1} rhs.
+      void apply_lumped_mass_inverse(Scalar* rhs, Scalar* sln);
+
+      /// (Re)creates the stage spaces if the spaces changed since the last time step, and sets the times of the stages
+      /// to their essential boundary conditions.
+      void update_stage_spaces();
+
       // Prepare u_ext_vec.
       void prepare_u_ext_vec();
 
+      /// The scaled norm of the temporal error estimate, see set_time_step_control().
+      /// @param[in] coeff_vec - the new time level solution.
+      double calc_time_step_error(Scalar* coeff_vec, int ndof);
+
       /// Matrix for the time derivative part of the equation (left-hand side).
       SparseMatrix<Scalar>* matrix_left;
 
@@ -193,8 +284,41 @@ namespace Hermes
       /// For the matrix M (size ndof times ndof).
       WeakForm<Scalar> stage_wf_left;
       DiscreteProblem<Scalar>* stage_dp_left;
+      /// Sequence numbers of the spaces matrix_left was assembled with.
+      Hermes::vector<int> matrix_left_seqs;
+
+      /// Spaces of the stage solutions K_i (copies of the spaces, num_stages * spaces.size()), kept over the time steps,
+      /// and the sequence numbers of the spaces they were created from.
+      Hermes::vector<Space<Scalar>*> stage_spaces_vector;
+      Hermes::vector<int> stage_spaces_seqs;
+
+      /// The weak formulation of one stage and its discrete problem (decoupled stages).
+      WeakForm<Scalar> stage_wf_single;
+      DiscreteProblem<Scalar>* stage_dp_single;
+
+      /// The forms explicit in time with an IMEX table (vector forms only, the residual is -f_E) and its discrete problem,
+      /// NULL if there is no such form.
+      WeakForm<Scalar> stage_wf_explicit;
+      DiscreteProblem<Scalar>* stage_dp_explicit;
+
+      /// Jacobian, residual and the matrix solver of one stage (decoupled stages).
+      SparseMatrix<Scalar>* stage_matrix;
+      Vector<Scalar>* stage_vector;
+      LinearMatrixSolver<Scalar>* stage_solver;
+
+      /// Solver of the explicit stages ( = with the mass matrix, matrix_left), the right-hand side is stage_vector.
+      LinearMatrixSolver<Scalar>* mass_solver;
+
+      /// See set_lumped_mass(). The dofs of the blocks (starting at mass_block_starts) and the inverted blocks
+      /// (n * n values each, starting at mass_block_value_starts), one after another.
+      bool lumped_mass;
+      Hermes::vector<int> mass_block_starts;
+      Hermes::vector<int> mass_block_dofs;
+      Hermes::vector<Scalar> mass_block_inverses;
+      Hermes::vector<int> mass_block_value_starts;
 
       bool start_from_zero_K_vector;
+      bool decoupled_stages;
       bool block_diagonal_jacobian;
       bool residual_as_vector;
 
@@ -203,10 +327,21 @@ namespace Hermes
 
       bool do_global_projections;
       bool freeze_jacobian;
+      bool jacobian_with_residual;
       double newton_tol;
       int newton_max_iter;
       double newton_damping_coeff;
       double newton_max_allowed_residual_norm;
+
+      /// Step size control (set_time_step_control()).
+      bool time_step_control;
+      double time_step_tol;
+      unsigned int time_step_order;
+      double min_time_step;
+      double max_time_step;
+      /// Error estimate of the last time step, and of the last accepted one (for the PI controller, -1 before the first one).
+      double last_time_step_error;
+      double last_accepted_time_step_error;
       
       Hermes::vector<Solution<Scalar>*> residuals_vector;
 
@@ -214,12 +349,18 @@ namespace Hermes
       /// the 'K_i' vectors in the usual R-K notation.
       Scalar* K_vector;
 
+      /// The explicit stage vectors \hat{K}_i = M^{-1} f_E(t_n + c_i h, u_i) of an IMEX table (num_stages * ndof), NULL otherwise.
+      Scalar* K_explicit_vector;
+
       /// Vector u_ext_vec will represent h \sum_{j = 1}^s a_{ij} K_i.
       Scalar* u_ext_vec;
 
       /// Vector for the left part of the residual.
       Scalar* vector_left;
       
+      /// Projection of the previous time level solutions, keeps the Gram matrices of the spaces over the time steps.
+      OGProjection<Scalar> ogProjection;
+
       ///< The filters to reinitialize in every Newton's loop
       Hermes::vector<Filter<Scalar>*> filters_to_reinit;
     };
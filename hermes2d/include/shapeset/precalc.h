@@ -62,14 +62,115 @@ namespace Hermes
       /// \param index[in] Shape index.
       void set_active_shape(int index);
 
+      /// Activates an integration rule of the specified order, see Function::set_quad_order().
+      /// The tables are looked up in (and precalculated into) the cache of the master instance.
+      virtual void set_quad_order(unsigned int order, int mask = H2D_FN_DEFAULT);
+
+      /// Precalculates the tables of all the shape functions of the shapeset on the reference element (the values and the first
+      /// derivatives in all the tables of g_quad_2d_std) and saves them into dir, precalculatedFormsDirPath if NULL.
+      /// The first precalculation of the shapeset in a process then loads the file instead of evaluating the functions
+      /// (see get_shared_node()), which shortens the startup of the short-running programs.
+      /// Typical usage (once, e.g. in an installation step):
+      /// Hermes::Hermes2D::H1ShapesetJacobi shapeset;
+      /// Hermes::Hermes2D::PrecalcShapeset::save_shared_tables(&shapeset);
+      static void save_shared_tables(Shapeset* shapeset, const char* dir = NULL);
+
+      /// The file name of the tables of the shapeset in dir, see save_shared_tables().
+      static std::string get_shared_tables_file_name(Shapeset* shapeset, const char* dir);
+
     private:
+      /// \brief Bounded cache of the precalculated tables.
+      /// \details Open addressing (linear probing) hash table mapping the shape key (see set_active_shape()),
+      /// the sub-element transformation and the integration order to a Node that holds all the tables
+      /// precalculated so far (the union of the requested masks). The entries are kept in a least recently
+      /// used list, when the memory exceeds Hermes2DApiParam::precalcCacheSizeLimit the least recently used
+      /// ones are freed. The H2D_PRECALC_CACHE_MIN_ENTRIES most recently used entries are never freed,
+      /// so that the tables of all instances sharing one master stay valid while in use.
+      class Cache
+      {
+      public:
+        Cache();
+        ~Cache();
+
+        /// Returns the Node stored for the key and marks it as the most recently used, NULL if there is none.
+        Node* get(unsigned shape_key, uint64_t sub_idx, int order);
+
+        /// Stores the node (frees the one previously stored for the key) and evicts the least recently used ones if above the limit.
+        /// \param[in] shared The node belongs to the shared tables (see get_shared_node()), it is neither freed nor counted.
+        void put(unsigned shape_key, uint64_t sub_idx, int order, Node* node, bool shared = false);
+
+        /// Frees all the nodes.
+        void clear();
+
+        /// Memory in bytes held by the nodes.
+        size_t get_memory() const;
+
+      private:
+        struct Entry
+        {
+          uint64_t sub_idx;
+          unsigned shape_key;
+          int order;
+          Node* node;
+          bool shared;
+          /// Neighbors in the least recently used list (indices to entries), next is also used for the list of free entries.
+          int prev, next;
+        };
+
+        std::vector<Entry> entries;
+        int free_entries;
+
+        /// Indices to entries, H2D_PRECALC_CACHE_EMPTY or H2D_PRECALC_CACHE_DELETED. The size is a power of two.
+        int* slots;
+        unsigned int capacity;
+        unsigned int num_entries;
+        unsigned int num_deleted;
+
+        /// The most and the least recently used entries.
+        int lru_first, lru_last;
+
+        size_t memory;
+
+        static unsigned int hash(unsigned shape_key, uint64_t sub_idx, int order);
+        int find_slot(unsigned shape_key, uint64_t sub_idx, int order) const;
+        void rehash(unsigned int new_capacity);
+        void lru_unlink(int entry);
+        void lru_push_front(int entry);
+        void remove(int slot);
+      };
+
+      Cache cache;
+
+      class SharedTables;
+
+      /// Tables of the reference element (no sub-element transformation) shared by all the instances
+      /// (of all the threads) with the same shapeset, filled lazily and released at exit.
+      static SharedTables shared_tables;
+
+      /// Returns the shared tables of the active shape on the reference element for the order containing
+      /// at least the mask, precalculates them if needed. Thread-safe.
+      Node* get_shared_node(int order, int mask);
+
+      /// Adds the tables of the file of save_shared_tables() in precalculatedFormsDirPath (if there is one) to shared_tables.
+      /// Called once for every shapeset, inside the critical section of shared_tables.
+      static void load_shared_tables(Shapeset* shapeset);
+
+      /// The value, dx and dy of every component of the shape function in the points of the table of g_quad_2d_std,
+      /// in the layout of the data of a Node with the mask H2D_FN_DEFAULT.
+      static void calculate_shared_table(Shapeset* shapeset, int index, int table, ElementMode2D mode, double* values);
+
+      /// Key of the active shape function in the cache.
+      unsigned shape_key;
+
+      /// Tables for an overflowed sub-element transformation (not cached).
+      Node* overflow_node;
+
       virtual void set_quad_2d(Quad2D* quad_2d);
 
       /// \brief Frees all precalculated tables.
       virtual void free();
 
-      /// Virtual function handling overflows. Has to be virtual, because
-      /// the necessary iterators in the templated class do not work with GCC.
+      /// Not used, the overflowed transformations are handled in set_quad_order().
       virtual void handle_overflow_idx();
 
 
@@ -92,17 +193,6 @@ namespace Hermes
 
       Shapeset* shapeset;
 
-      /// Main structure.
-      /// There is a 3-layer structure of the precalculated tables.
-      /// The first (the lowest) one is the layer where mapping of integral orders to
-      /// Function::Node takes place. See function.h for details.
-      /// The second one is the layer with mapping of sub-element transformation to
-      /// a table from the lowest layer.
-      /// The highest and most complicated one maps a key formed by
-      /// quadrature table selector (0-7), mode of the shape function (triangle/quad),
-      /// and shape function index to a table from the middle layer.
-      LightArray<std::map<uint64_t, LightArray<Node*>*>*> tables;
-
       int index;
 
       int max_index[H2D_NUM_MODES];
@@ -125,9 +215,11 @@ namespace Hermes
       template<typename T> friend class Adapt;
       template<typename T> friend class Func;
       template<typename T> friend class Solution;
+      template<typename T> friend class CompactSolution;
       template<typename T> friend class DiscontinuousFunc;
       template<typename T> friend class DiscreteProblem;
       template<typename T> friend class NeighborSearch;
+      template<typename T> friend class LocalProjection;
       friend class CurvMap;
     };
   }
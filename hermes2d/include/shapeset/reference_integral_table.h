@@ -0,0 +1,92 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef __H2D_REFERENCE_INTEGRAL_TABLE_H
+#define __H2D_REFERENCE_INTEGRAL_TABLE_H
+
+#include "shapeset.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    class BinaryFile;
+
+    /// @ingroup meshFunctions
+    /// \brief Precalculated integrals of products of the shape functions of a (scalar) shapeset over the reference element.
+    ///
+    /// For all pairs (u, v) of the shape functions of one shapeset on one element mode, the integrals of
+    /// u * v, du/dxi * dv/dxi, du/dxi * dv/deta + du/deta * dv/dxi and du/deta * dv/deta are stored
+    /// (the values DiscreteProblem uses for the forms with constant coefficients, see MatrixFormVol::get_constant_coefficients()).
+    /// The tables are saved by save() into the directory given by the Hermes2DApi parameter precalculatedFormsDirPath,
+    /// one file per shapeset and mode, and mapped into memory (see BinaryFile) the first time they are needed,
+    /// so that the assembling does not integrate the products of the functions of every new order again.
+    /// Without a file, the integrals are calculated during the assembling as before.
+    ///
+    /// Typical usage (once, e.g. in an installation step):
+    /// Hermes::Hermes2D::H1ShapesetJacobi shapeset;
+    /// Hermes::Hermes2D::ReferenceIntegralTable::save(&shapeset, HERMES_MODE_TRIANGLE);
+    /// Hermes::Hermes2D::ReferenceIntegralTable::save(&shapeset, HERMES_MODE_QUAD);
+    class HERMES_API ReferenceIntegralTable
+    {
+    public:
+      ~ReferenceIntegralTable();
+
+      /// The four integrals of the shape functions index_u, index_v (both nonnegative and at most get_max_index()).
+      inline const double* get(int index_u, int index_v) const { return integrals + 4 * (index_u * (max_index + 1) + index_v); }
+
+      int get_max_index() const;
+
+      /// The table of the shapeset and the mode, loaded from precalculatedFormsDirPath on the first call.
+      /// Thread-safe.
+      /// \return NULL if there is no (valid) file for the shapeset and the mode.
+      static const ReferenceIntegralTable* find(Shapeset* shapeset, ElementMode2D mode);
+
+      /// Calculates the table of the shapeset and the mode and saves it.
+      /// @param[in] dir The directory, precalculatedFormsDirPath if NULL.
+      static void save(Shapeset* shapeset, ElementMode2D mode, const char* dir = NULL);
+
+      /// Integrates the products of the shape functions index_u and index_v (of the same shapeset) exactly.
+      /// \param[out] values The four integrals, see get().
+      static void calculate(Shapeset* shapeset, int index_u, int index_v, ElementMode2D mode, double* values);
+
+      /// The file name of the table of the shapeset and the mode in dir.
+      static std::string get_file_name(Shapeset* shapeset, ElementMode2D mode, const char* dir);
+
+    protected:
+      /// Maps the file, throws if it is not a table of the shapeset and the mode.
+      ReferenceIntegralTable(const char* file_name, Shapeset* shapeset, ElementMode2D mode);
+
+      /// The fixed-size beginning of the files.
+      struct Header
+      {
+        char magic[8];
+        int version;
+        int byte_order;
+        int shapeset_id;
+        int mode;
+        int max_index;
+        int max_order;
+      };
+
+      BinaryFile* file;
+      int max_index;
+      /// (max_index + 1)^2 quadruples, in the mapped file.
+      const double* integrals;
+    };
+  }
+}
+
+#endif
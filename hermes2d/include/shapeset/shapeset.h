@@ -133,6 +133,11 @@ namespace Hermes
       /// domain, component is 0 for Scalar shapesets and 0 or 1 for vector shapesets.
       double get_value(int n, int index, double x, double y, int component, ElementMode2D mode);
 
+      /// Obtains the values of the given shape function in np points at once, see get_value().
+      /// The default implementation calls get_value() for every point.
+      /// \param[out] values Array of np values.
+      virtual void get_values(int n, int index, int np, const double* x, const double* y, int component, ElementMode2D mode, double* values);
+
       double get_fn_value (int index, double x, double y, int component, ElementMode2D mode);
       double get_dx_value (int index, double x, double y, int component, ElementMode2D mode);
       double get_dy_value (int index, double x, double y, int component, ElementMode2D mode);
@@ -208,8 +213,11 @@ namespace Hermes
       template<typename Scalar> friend class RefinementSelectors::H1ProjBasedSelector;
       template<typename Scalar> friend class RefinementSelectors::L2ProjBasedSelector;
       template<typename Scalar> friend class RefinementSelectors::HcurlProjBasedSelector;
+      template<typename Scalar> friend class RefinementSelectors::ProjBasedSelector;
       template<typename Scalar> friend class RefinementSelectors::OptimumSelector;
       friend class PrecalcShapeset;
+      friend class ShapesetTabulated;
+      friend class ReferenceIntegralTable;
       friend void check_leg_tri(Shapeset* shapeset);
       friend void check_gradleg_tri(Shapeset* shapeset);
       template<typename Scalar> friend class Form;
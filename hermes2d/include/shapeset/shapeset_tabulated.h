@@ -0,0 +1,114 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef __H2D_SHAPESET_TABULATED_H
+#define __H2D_SHAPESET_TABULATED_H
+
+#include "shapeset.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    /// @ingroup spaces
+    /// \brief Shapeset evaluating the functions of another shapeset from tables of coefficients.
+    ///
+    /// Every shape function (all components, both modes) is expanded into the tensor products
+    /// of Legendre polynomials P_i(x) P_j(y), i, j <= degree, the coefficients being obtained by
+    /// interpolation in the Gauss points, which is exact for polynomials. The expansion is checked
+    /// against the original function, the functions failing the check (not polynomial of a low
+    /// enough degree) are evaluated by the original code.
+    ///
+    /// The values of all the integration points of a table are evaluated at once (see get_values())
+    /// by the three-term recurrences of the Legendre polynomials and of their derivatives, in
+    /// loops over the points that the compiler can vectorize, instead of calling one generated
+    /// function per shape and point. Single values (get_value()) still come from the original tables.
+    ///
+    /// The coefficients are computed once for each kind of shapeset and shared by all the instances.
+    /// Usage: pass e.g. new ShapesetTabulated(new HcurlShapesetGradLeg()) to the constructor of a space.
+    class HERMES_API ShapesetTabulated : public Shapeset
+    {
+    public:
+      /// \param[in] shapeset The original shapeset, it can be deleted afterwards.
+      ShapesetTabulated(Shapeset* shapeset);
+      ShapesetTabulated(const ShapesetTabulated& other);
+      virtual Shapeset* clone();
+      virtual int get_max_index(ElementMode2D mode);
+      virtual SpaceType get_space_type() const;
+
+    protected:
+      virtual int get_id() const;
+
+      virtual void get_values(int n, int index, int np, const double* x, const double* y, int component, ElementMode2D mode, double* values);
+
+      /// The expansion of one component of one shape function.
+      struct Expansion
+      {
+        /// Maximum degree in each of the variables, -1 if the function is not tabulated.
+        int degree;
+        /// (degree + 1)^2 coefficients, the coefficient of P_i(x) P_j(y) at i * (degree + 1) + j.
+        double* coeffs;
+      };
+
+      class Tables;
+
+      /// The expansions of the shapeset (shared).
+      Tables* tables;
+
+      class Registry;
+
+      /// The expansions of all the shapesets tabulated so far (by shapeset id), released at exit.
+      static Registry registry;
+
+      int id;
+      SpaceType space_type;
+      int max_index[H2D_NUM_MODES];
+
+      /// Returns the (shared) expansions for the shapeset, calculates them the first time.
+      static Tables* get_tables(Shapeset* shapeset, int max_index[H2D_NUM_MODES]);
+
+      /// Calculates the expansion of the component of the shape function.
+      static Expansion calculate_expansion(Shapeset* shapeset, int index, int component, ElementMode2D mode);
+
+      /// Evaluates the expansion (the derivative given by n, see FunctionExpansionIndex) in np points.
+      /// \param[in] legendre_x, legendre_y The Legendre polynomials in the points, see legendre_values().
+      /// \param[in] level_size The distance between the derivatives in legendre_x, legendre_y.
+      static void evaluate(const Expansion& expansion, int n, int np, const double* legendre_x, const double* legendre_y, int level_size, double* values);
+
+      /// Evaluates Legendre polynomials of degree 0..degree in the points and num_levels - 1 of their derivatives.
+      /// \param[out] values num_levels * (degree + 1) * np values, the derivative d of the polynomial
+      /// of degree i at (d * (degree + 1) + i) * np.
+      static void legendre_values(int num_levels, int degree, int np, const double* x, double* values);
+
+    public:
+      /// The Legendre polynomials (and two derivatives) in the last points evaluated by a thread.
+      struct PointsCache
+      {
+        int np;
+        int degree;
+        int capacity;
+        double* points;
+        double* values;
+      };
+
+    protected:
+      /// Returns the Legendre polynomials (see legendre_values()) of the degree in the points, up to date in the cache.
+      static const double* get_legendre_values(PointsCache& cache, int degree, int np, const double* x);
+
+      template<typename Scalar> friend class DiscreteProblem; template<typename Scalar> friend class Solution; friend class CurvMap; friend class RefMap; template<typename Scalar> friend class RefinementSelectors::H1ProjBasedSelector; template<typename Scalar> friend class RefinementSelectors::L2ProjBasedSelector; template<typename Scalar> friend class RefinementSelectors::HcurlProjBasedSelector; template<typename Scalar> friend class RefinementSelectors::OptimumSelector; friend class PrecalcShapeset;
+    };
+  }
+}
+#endif
@@ -0,0 +1,80 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef __H2D_TENSOR_FACTORS_H
+#define __H2D_TENSOR_FACTORS_H
+
+#include "../global.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    class PrecalcShapeset;
+
+    /// @ingroup meshFunctions
+    /// \brief Splits shape functions on quads into products of one-dimensional factors.
+    ///
+    /// The quadrature rules on quads are cartesian products of the 1D rules, the point (i, j)
+    /// of the rule having the index i * np + j. A shape function that is a product
+    /// scale * X(xi) * Y(eta) is then fully described by the values and derivatives of X and Y
+    /// in the np 1D points, which allows the sums over the quadrature points to be done
+    /// one direction at a time (sum factorization).
+    ///
+    /// The splitting is found numerically from the precalculated values, so that no assumptions
+    /// about the shapeset are made. The factors are shared by all shape functions with the same
+    /// factor in one direction. One instance serves one shapeset and one quadrature order.
+    class HERMES_API QuadTensorFactors
+    {
+    public:
+      /// \param[in] order Index of the quadrature on quads (as used in Function::set_quad_order()).
+      QuadTensorFactors(int order);
+      ~QuadTensorFactors();
+
+      /// Number of the 1D points.
+      int get_num_points() const;
+
+      /// Splits the shape function index of pss into scale * X(xi) * Y(eta).
+      /// pss has to have a quad active, without any transformation.
+      /// \return false if the function is not a product.
+      bool get(PrecalcShapeset* pss, int index, int& x_factor, int& y_factor, double& scale);
+
+      /// Number of the distinct factors in the direction 0 (xi) or 1 (eta).
+      int get_num_factors(int direction) const;
+
+      /// Values (or derivatives) of the factor in the 1D points.
+      const double* get_values(int direction, int factor, bool derivative) const;
+
+    private:
+      int order;
+      int np;
+
+      struct Split
+      {
+        bool is_product;
+        int factor[2];
+        double scale;
+      };
+      std::map<int, Split> splits;
+
+      /// Values followed by the derivatives of every factor, 2 * np doubles each.
+      std::vector<double*> factors[2];
+
+      /// Returns the index of the factor with these values and derivatives, adds it if it is not present yet.
+      int find_factor(int direction, const double* values);
+    };
+  }
+}
+#endif
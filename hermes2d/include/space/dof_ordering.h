@@ -0,0 +1,58 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef __H2D_DOF_ORDERING_H
+#define __H2D_DOF_ORDERING_H
+
+#include "../global.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    /// @ingroup spaces
+    /// \brief Orderings of the vertices of a sparse symmetric graph, used by Space::assign_dofs() to renumber the DOFs.
+    ///
+    /// The graph has n vertices, the neighbors of the vertex i are adj[adj_start[i]] ... adj[adj_start[i + 1] - 1].
+    /// The result is the ordering, order[k] is the vertex placed k-th.
+    class HERMES_API DofOrdering
+    {
+    public:
+      /// Reverse Cuthill-McKee ordering, small bandwidth and profile of the matrix.
+      /// Every connected component starts in a pseudo-peripheral vertex.
+      static void reverse_cuthill_mckee(int n, const int* adj_start, const int* adj, int* order);
+
+      /// Nested dissection by level structures: the middle level of the breadth-first search
+      /// from a pseudo-peripheral vertex separates the rest into two parts which are ordered recursively,
+      /// the separator goes last. Reduces the fill-in of direct solvers.
+      static void nested_dissection(int n, const int* adj_start, const int* adj, int* order);
+
+    private:
+      /// Size of the parts that nested_dissection() does not split any further.
+      static const int H2D_DISSECTION_MIN_SIZE = 32;
+
+      /// Breadth-first search from root, restricted to the vertices v with region[v] == region_id.
+      /// The levels of the vertices reached are stored in level (which must be -1 for them before),
+      /// the vertices reached in queue, in the order of the search.
+      /// \return The number of levels.
+      static int level_structure(int root, const int* adj_start, const int* adj, const int* region, int region_id, int* level, int* queue, int& queue_size);
+
+      /// Finds a vertex of approximately maximal eccentricity in the component of root (George and Liu).
+      /// The levels of the returned vertex are left in level, its search in queue.
+      static int pseudo_peripheral_vertex(int root, const int* adj_start, const int* adj, const int* region, int region_id, int* level, int* queue, int& queue_size, int& num_levels);
+    };
+  }
+}
+#endif
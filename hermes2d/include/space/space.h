@@ -128,6 +128,11 @@ namespace Hermes
       /// Returns element polynomial order.
       int get_element_order(int id) const;
 
+      /// The work of assembling the active elements, by their id (get_mesh()->get_max_element_id() entries), for Mesh::partition():
+      /// the square of the number of the shape functions of the element order, i.e. the number of the entries of the local matrix.
+      /// The weights are added to the values in the array, so that the ones of several spaces on the same mesh can be summed up.
+      void get_element_weights(double* weights) const;
+
       /// Sets the same polynomial order for all elements in the mesh. Intended for
       /// the user and thus assign_dofs() is called at the end of this function.
       void set_uniform_order(int order, std::string marker = HERMES_ANY);
@@ -146,6 +151,10 @@ namespace Hermes
       /// Updates element orders when the underlying mesh has been refined.
       void update_element_orders_after_refinement();
 
+      /// Updates element orders when the given elements of the underlying mesh have been refined,
+      /// their active descendants get their orders, the rest of the mesh is not visited.
+      void update_element_orders_after_refinement(const Hermes::vector<int>& refined_ids);
+
       /// Sets the shapeset.
       virtual void set_shapeset(Shapeset* shapeset) = 0;
 
@@ -184,8 +193,16 @@ namespace Hermes
       bool save(const char *filename) const;
 
       /// Loads a space from a file.
+      /// Files created by save_binary() are recognized and loaded by load_binary().
       static Space<Scalar>* load(const char *filename, Mesh* mesh, bool validate, EssentialBCs<Scalar>* essential_bcs = NULL, Shapeset* shapeset = NULL);
 
+      /// Saves this space into a binary file (see BinaryFile), much faster to write and read than the XML of save().
+      /// The file is readable only on machines with the same byte order.
+      bool save_binary(const char *filename) const;
+
+      /// Loads a space from a file created by save_binary().
+      static Space<Scalar>* load_binary(const char *filename, Mesh* mesh, EssentialBCs<Scalar>* essential_bcs = NULL, Shapeset* shapeset = NULL);
+
       /// Obtains an assembly list for the given element.
       virtual void get_element_assembly_list(Element* e, AsmList<Scalar>* al, unsigned int first_dof = 0) const;
 
@@ -240,6 +257,41 @@ namespace Hermes
       /// \brief Assings the degrees of freedom to all Spaces in the Hermes::vector.
       static int assign_dofs(Hermes::vector<Space<Scalar>*> spaces);
 
+      /// \brief Assigns the degrees of freedom of the spaces interleaved, so that the k-th basis functions of all
+      /// the spaces have successive numbers (k * n + i in the coupled system of n spaces, i being the index of the space).
+      /// \details Every space is numbered from zero with the stride n, the offsets i are added when assembling
+      /// (see get_dof_offset()). Together with a BSRMatrix with the block size n, the entries coupling the
+      /// unknowns of one node form one block, e.g. for the displacements of elasticity.
+      /// The spaces need the same number of DOFs, i.e. the same mesh, orders and essential boundary conditions
+      /// for the blocks to match the nodes. The interleaving holds until the next assign_dofs() of a space.
+      /// \return The number of basis functions contained in the spaces.
+      static int assign_dofs_interleaved(Hermes::vector<Space<Scalar>*> spaces);
+
+      /// \brief Returns the offset of the DOFs of the i-th space in the coefficient vector of the spaces:
+      /// the number of DOFs of the preceding spaces, or i if the spaces are interleaved (see assign_dofs_interleaved()).
+      static int get_dof_offset(Hermes::vector<const Space<Scalar>*> spaces, unsigned int i);
+      static int get_dof_offset(Hermes::vector<Space<Scalar>*> spaces, unsigned int i);
+
+      /// \brief Returns the difference between the DOF numbers of successive basis functions (see assign_dofs()).
+      int get_stride() const;
+
+      /// \brief The version of the content of the space: a hash of the version of the mesh (Mesh::get_version()), the type,
+      /// the shapeset, the element orders and the assembly lists (the shape functions and the DOFs, not the Dirichlet values).
+      /// \details The same for the same content, unlike the seq numbers that change with every assign_dofs(), so the caches
+      /// depending only on the DOFs (sparsity, state lists, face tables, factorizations) can key on it, see also SpaceSnapshot.
+      /// Calculated on every call (linear in the elements), the space has to be up to date.
+      uint64_t get_version() const;
+
+      /// \brief Stores the polynomial order of the basis function of every DOF to dof_orders[dof + offset]
+      /// (the highest order of the shape functions the DOF is assembled with, the larger one of the two directions on quads).
+      /// \details With the hierarchic shapesets these are the levels of the p-multigrid preconditioner
+      /// (Hermes::Preconditioners::PMultigridPrecond).
+      void get_dof_orders(int* dof_orders, int offset = 0) const;
+
+      /// \brief Returns the orders of all the DOFs of the coupled system of the spaces (see get_dof_offset()), to be deleted by the caller.
+      static int* get_dof_orders(Hermes::vector<const Space<Scalar>*> spaces);
+      static int* get_dof_orders(Hermes::vector<Space<Scalar>*> spaces);
+
       virtual Scalar* get_bc_projection(SurfPos* surf_pos, int order, EssentialBoundaryCondition<Scalar> *bc) = 0;
 
       static void update_essential_bc_values(Hermes::vector<Space<Scalar>*> spaces, double time);
@@ -264,6 +316,25 @@ namespace Hermes
       /// Returns true if the space is ready for computation, false otherwise.
       bool is_up_to_date() const;
 
+      /// Selects how assign_dofs() numbers the DOFs. The orderings other than HERMES_DOF_ORDERING_ELEMENTS
+      /// renumber the functions of the nodes and the bubbles, computed from the graph of the nodes
+      /// sharing an element, so that the matrices need no reordering in the solver.
+      /// Takes effect at the next assign_dofs(). Default: HERMES_DOF_ORDERING_ELEMENTS.
+      void set_dof_ordering(DofOrderingType dof_ordering);
+      DofOrderingType get_dof_ordering() const;
+
+      /// Returns the map of the DOFs of the last assign_dofs() to the DOFs of the previous one.
+      /// For every DOF (numbered from 0, i.e. without first_dof and stride) the entry is the number the same
+      /// basis function had in the previous assignment, or -1 if the function is new or its support has changed
+      /// (e.g. by a refinement of a neighboring element). NULL if the DOFs were assigned for the first time.
+      const int* get_dof_permutation() const;
+
+      /// Copies the coefficients of the previous DOF assignment to the current numbering (see get_dof_permutation()),
+      /// so that only the coefficients of the changed part of the space need to be projected.
+      /// Both vectors are numbered from 0, the coefficients without a counterpart are set to zero.
+      /// \return The number of the coefficients without a counterpart, -1 if there is no previous assignment.
+      int remap_coefficient_vector(const Scalar* previous_coeff_vec, Scalar* coeff_vec) const;
+
       /// Obtains an edge assembly list (contains shape functions that are nonzero on the specified edge).
       void get_boundary_assembly_list(Element* e, int surf_num, AsmList<Scalar>* al, unsigned int first_dof = 0) const;
 
@@ -345,8 +416,82 @@ namespace Hermes
         bool changed_in_last_adaptation;
       };
 
+      /// The element data table, indexed by the element ids.
+      /// The items are allocated in chunks of fixed size, the table grows by adding chunks, so that the items never move
+      /// (the pointers to them stay valid) and growing does not copy the table.
+      class ElementDataTable
+      {
+      public:
+        ElementDataTable() : chunks(NULL), num_chunks(0), allocated_chunks(0) {};
+        ~ElementDataTable() { free(); };
+
+        /// As with the former plain array, the items can be changed through a const table.
+        inline ElementData& operator[](int id) const { return chunks[id >> chunk_bits][id & chunk_mask]; }
+
+        inline bool is_allocated() const { return num_chunks > 0; }
+
+        /// Grows the table to hold at least size items, the new ones have the order -1.
+        /// \return The number of items the table holds.
+        int grow(int size);
+        void free();
+
+      private:
+        ElementDataTable(const ElementDataTable&);
+        ElementDataTable& operator=(const ElementDataTable&);
+
+        static const int chunk_bits = 10;
+        static const int chunk_size = 1 << chunk_bits;
+        static const int chunk_mask = chunk_size - 1;
+
+        ElementData** chunks;
+        int num_chunks, allocated_chunks;
+      };
+
+      /// Assembly lists of the active elements after the previous DOF assignment, used to build dof_permutation.
+      struct DofSnapshot
+      {
+        int num_elems; ///< Size of the element tables (maximum element id).
+        int ndof;
+        int* elem_start; ///< Start of the entries of every element (num_elems + 1 items), inactive elements have no entries.
+        int* elem_data; ///< Order, number of vertices and the vertex node ids of every element (6 items each).
+        double* elem_coords; ///< Coordinates of the vertices of every element (8 items each).
+        int* shape_inxs; ///< Shape indices of the entries, -1 for the entries of constrained functions.
+        int* dofs; ///< DOFs of the entries, numbered from 0.
+      };
+      DofSnapshot dof_snapshot;
+
+      /// Assembly lists of the elements with hanging nodes, stored after every DOF assignment (and update of the Dirichlet values),
+      /// so that get_element_assembly_list() copies them instead of expanding the constraints of the hanging nodes again.
+      struct ConstrainedAssemblyLists
+      {
+        int num_elems; ///< Size of the element tables (maximum element id).
+        int* start; ///< Start of the entries of every element (num_elems + 1 items), the other elements have no entries.
+        int* idx;
+        int* dof; ///< DOFs of the entries, without first_dof of get_element_assembly_list().
+        Scalar* coef;
+        /// The constraint operator of the entries (AsmList::shape_pos and AsmList::dof_pos), precomputed for the assembling.
+        int* shape_pos;
+        int* dof_pos;
+      };
+      ConstrainedAssemblyLists constrained_als;
+
+      /// Stores the assembly lists of the active elements with hanging nodes, see constrained_als.
+      void update_constrained_assembly_lists();
+      void free_constrained_assembly_lists();
+
+      DofOrderingType dof_ordering;
+
+      /// Renumbers the DOFs assigned by assign_vertex_dofs(), assign_edge_dofs() and assign_bubble_dofs()
+      /// according to dof_ordering. The functions of one node or bubble keep consecutive numbers.
+      void reorder_dofs();
+      int* dof_permutation; ///< See get_dof_permutation().
+
+      /// Builds dof_permutation from dof_snapshot and takes a new snapshot. Called at the end of assign_dofs().
+      void update_dof_permutation();
+      void free_dof_permutation();
+
       NodeData* ndata;    ///< node data table
-      ElementData* edata; ///< element data table
+      ElementDataTable edata; ///< element data table
       int nsize, ndata_allocated; ///< number of items in ndata, allocated space
       int esize;
 
@@ -363,6 +508,9 @@ namespace Hermes
 
       void update_orders_recurrent(Element* e, int order);
 
+      /// Creates a space of the type given by its name in a file ("h1", "hcurl", "hdiv", "l2"), used by load() and load_binary().
+      static Space<Scalar>* init_loaded(const char* space_type, const char *filename, Mesh* mesh, EssentialBCs<Scalar>* essential_bcs, Shapeset* shapeset);
+
       virtual void reset_dof_assignment(); ///< Resets assignment of DOF to an unassigned state.
       virtual void assign_vertex_dofs() = 0;
       virtual void assign_edge_dofs() = 0;
@@ -401,6 +549,7 @@ namespace Hermes
       template<typename T> friend class OGProjectionNOX;
       template<typename T> friend class LocalProjection;
       template<typename T> friend class Solution;
+      template<typename T> friend class CompactSolution;
       template<typename T> friend class RungeKutta;
       template<typename T> friend class ExactSolution;
       template<typename T> friend class NeighborSearch;
@@ -412,7 +561,11 @@ namespace Hermes
       template<typename T> friend class Views::VectorBaseView;
       friend class Adapt<Scalar>;
       friend class DiscreteProblem<Scalar>;
+      template<typename T> friend class DiscreteProblemLinear;
       template<typename T> friend class CalculationContinuity;
+      template<typename T> friend class StaticCondensation;
+      template<typename T> friend class OutputQueue;
+      template<typename T> friend class SpaceSnapshot;
     };
   }
 }
@@ -0,0 +1,70 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef __H2D_SPACE_SNAPSHOT_H
+#define __H2D_SPACE_SNAPSHOT_H
+
+#include "space.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    /// @ingroup spaces
+    /// \brief An immutable copy of a space and of its mesh, identified by the version of its content (Space::get_version()).
+    ///
+    /// The copy has the DOFs of the original space, so the caches keyed on the version (sparsity, state lists, face tables,
+    /// factorizations) built on the snapshot or on the original are interchangeable, and they stay valid for as long as the
+    /// snapshot lives, whatever happens to the original. A snapshot is only read (through the const interface), so it is shared
+    /// by any number of threads and solvers without copies: acquire() of a space with the content of a live snapshot returns
+    /// that snapshot. Reference counted like MeshSnapshot.
+    /// The essential boundary conditions are shared with the original space, not copied.
+    template<typename Scalar>
+    class HERMES_API SpaceSnapshot
+    {
+    public:
+      /// A (new or shared) snapshot of the current content of the space, with one reference for the caller. Thread-safe.
+      static const SpaceSnapshot<Scalar>* acquire(const Space<Scalar>* space);
+
+      /// Another reference to the snapshot. Thread-safe.
+      static const SpaceSnapshot<Scalar>* acquire(const SpaceSnapshot<Scalar>* snapshot);
+
+      /// Releases one reference, the last one deletes the snapshot. Thread-safe.
+      static void release(const SpaceSnapshot<Scalar>* snapshot);
+
+      const Space<Scalar>* get_space() const;
+      const Mesh* get_mesh() const;
+
+      uint64_t get_version() const;
+
+      /// True if the space has the content of the snapshot (calculates its version).
+      bool matches(const Space<Scalar>* space) const;
+
+    private:
+      SpaceSnapshot(const Space<Scalar>* space, uint64_t version);
+      ~SpaceSnapshot();
+
+      Mesh* mesh;
+      Space<Scalar>* space;
+      uint64_t version;
+      /// The references, changed under the lock of the live snapshots.
+      mutable int ref_count;
+
+      /// The live snapshots by their versions.
+      static std::map<uint64_t, SpaceSnapshot<Scalar>*> live_snapshots;
+    };
+  }
+}
+#endif
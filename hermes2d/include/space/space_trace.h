@@ -0,0 +1,92 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef __H2D_SPACE_TRACE_H
+#define __H2D_SPACE_TRACE_H
+
+#include "space_l2.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    /// @ingroup spaces
+    /// \brief The space of the traces on the edges of the mesh of an L2Space, the unknowns of the hybridized DG (see HDGSolver).
+    ///
+    /// The trace on every edge is a polynomial of its own (discontinuous in the vertices), given by its coefficients
+    /// in the Legendre polynomials P_0 ... P_p of the edge parameter (see get_edge_parameter()), with p the highest order
+    /// of the two elements of the edge. The functions live on the edges only, so that unlike the Space classes
+    /// there is no shapeset, the values are calculated by get_legendre_values().
+    /// The traces on the edges with the essential conditions are projected (in L2 on the edge) and have no DOFs.
+    /// The mesh has to be conforming (no hanging nodes).
+    template<typename Scalar>
+    class HERMES_API EdgeTraceSpace : public Hermes::Mixins::Loggable
+    {
+    public:
+      /// @param[in] element_space The space of the element unknowns, the orders of the traces follow its element orders.
+      EdgeTraceSpace(const L2Space<Scalar>* element_space);
+      virtual ~EdgeTraceSpace();
+
+      /// The trace on the edges with the boundary marker is given by the function.
+      void add_essential_bc(std::string marker, Hermes2DFunction<Scalar>* value);
+
+      /// Numbers the DOFs and projects the essential values, to be called after every change of the element space.
+      /// \return The number of DOFs.
+      int assign_dofs();
+
+      int get_num_dofs() const;
+      const L2Space<Scalar>* get_element_space() const;
+
+      /// The order of the trace on the edge (by the id of its node), -1 if it is not an edge of an active element.
+      int get_edge_order(int edge_id) const;
+
+      /// The first of the get_edge_order() + 1 consecutive DOFs of the edge, -1 for the edges with the essential conditions.
+      int get_edge_first_dof(int edge_id) const;
+
+      /// The Legendre coefficients of the trace on an edge with the essential condition, NULL for the other edges.
+      const Scalar* get_essential_values(int edge_id) const;
+
+      /// The parameter in [-1, 1] of the point (x, y) of the edge of the element, going from the vertex with the lower id,
+      /// so that it is the same from both the elements of the edge (the projection to the chord for the curved edges).
+      static double get_edge_parameter(Element* e, int edge, double x, double y);
+
+      /// The Legendre polynomials P_0 ... P_order in t.
+      static void get_legendre_values(int order, double t, double* values);
+
+    protected:
+      void free_essential_values();
+
+      /// The L2 projection of the essential value to the edge of the element.
+      void project_essential_value(Element* e, int edge, Hermes2DFunction<Scalar>* value, int order, Scalar* coeffs) const;
+
+      struct EdgeData
+      {
+        int order;
+        int first_dof;
+        Scalar* essential_values;
+      };
+
+      const L2Space<Scalar>* element_space;
+
+      /// By the id of the edge node.
+      std::vector<EdgeData> edata;
+
+      /// By the internal boundary marker.
+      std::map<int, Hermes2DFunction<Scalar>*> essential_bcs;
+
+      int ndof;
+    };
+  }
+}
+#endif
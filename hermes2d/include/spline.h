@@ -51,6 +51,11 @@ namespace Hermes
       /// One-dimensional function derivative integration order.
       Hermes::Ord derivative(Hermes::Ord x) const {return Hermes::Ord(2);};
 
+      /// Values and derivatives in n points at once, see Hermes1DFunction::value_batch().
+      virtual void value_batch(int n, const double* x, double* result) const;
+      virtual void derivative_batch(int n, const double* x, double* result) const;
+      virtual void value_and_derivative_batch(int n, const double* x, double* values_result, double* derivatives_result) const;
+
       /// Plots the spline in format for Pylab (just pairs
       /// x-coordinate and value per line). The interval of definition
       /// of the spline will be extended by "extension" both to the left
@@ -60,10 +65,20 @@ namespace Hermes
       void plot(const char* filename, double extension, bool plot_derivative = false, int subdiv = 50) const;
 
     protected:
-      /// Uses a bisection method to locale interval where a given point lies.
+      /// Locates the interval where a given point lies, in constant time through interval_lookup
+      /// (by bisection before calculate_coeffs()).
       /// Returns false if point lies outside.
       bool find_interval(double x_in, int& m) const;
 
+      /// The value and the derivative at x_in, extrapolated outside of the interval of definition.
+      void evaluate(double x_in, double& value_out, double& derivative_out) const;
+
+      /// A uniform grid of interval_lookup.size() cells over [point_left, point_right], built by calculate_coeffs():
+      /// interval_lookup[c] is the last interval starting at or before the beginning of the cell c,
+      /// so that find_interval() only steps over the few points inside the cell (none for equidistant points).
+      std::vector<int> interval_lookup;
+      double interval_lookup_inv_step;
+
       /// Extrapolate the value of the spline outside of its interval of definition.
       double extrapolate_value(double point_end, double value_end, double derivative_end, double x_in) const;
       /// Grid points, ordered.
@@ -0,0 +1,120 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef __H2D_STATIC_CONDENSATION_H
+#define __H2D_STATIC_CONDENSATION_H
+
+#include "space/space.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    /// @ingroup userSolvingAPI
+    /// \brief Static condensation of the bubble DOFs (the interior DOFs of the elements, see Space::assign_bubble_dofs()).
+    ///
+    /// The full system is assembled into get_full_matrix() and get_full_rhs(), condense() then eliminates the bubble DOFs
+    /// group by group by the local Schur complements and assembles the system of the remaining (skeleton: vertex and edge) DOFs,
+    /// which is passed to the linear solver. recover() calculates the bubble DOFs from the skeleton solution.
+    /// A group contains the bubble DOFs coupled in the matrix, i.e. the bubbles of one element in all the spaces
+    /// on the same mesh. The groups larger than set_max_group_size() (e.g. the coupled elements of L2 spaces with the DG forms,
+    /// or the bubbles of overlapping elements of different meshes) stay in the skeleton system.
+    /// The local eliminations and the recoveries are done in parallel, one group per thread.
+    ///
+    /// Typical usage (done by LinearSolver::set_static_condensation()):<br>
+    /// dp.assemble(condensation.get_full_matrix(), condensation.get_full_rhs());<br>
+    /// condensation.condense(spaces, matrix, rhs);<br>
+    /// solver->solve();<br>
+    /// Scalar* sln_vector = condensation.recover(solver->get_sln_vector());<br>
+    template<typename Scalar>
+    class HERMES_API StaticCondensation : public Hermes::Mixins::Loggable, public Hermes::Mixins::TimeMeasurable
+    {
+    public:
+      StaticCondensation();
+      virtual ~StaticCondensation();
+
+      /// The full system, to be assembled into.
+      CSRMatrix<Scalar>* get_full_matrix();
+      Vector<Scalar>* get_full_rhs();
+
+      /// Eliminates the bubble DOFs of the assembled full system.
+      /// @param[in] spaces The spaces the full system was assembled on.
+      /// @param[out] skeleton_matrix, skeleton_rhs The system of the skeleton DOFs; the sparse structure of the matrix is created again
+      /// only if the full one changed.
+      void condense(Hermes::vector<const Space<Scalar>*> spaces, SparseMatrix<Scalar>* skeleton_matrix, Vector<Scalar>* skeleton_rhs);
+
+      /// Calculates the bubble DOFs.
+      /// @param[in] skeleton_sln The solution of the skeleton system.
+      /// \return The solution vector of the full system, valid until the next condense() (owned by this instance).
+      Scalar* recover(const Scalar* skeleton_sln);
+
+      int get_num_dofs() const;
+      int get_num_skeleton_dofs() const;
+
+      /// The largest group of the bubble DOFs eliminated, the default is 400.
+      void set_max_group_size(int max_group_size);
+
+    protected:
+      /// The bubble DOFs eliminated together.
+      struct Group
+      {
+        /// The (global) bubble DOFs.
+        std::vector<int> bubbles;
+        /// The skeleton DOFs of the rows coupled to the bubbles.
+        std::vector<int> rows;
+        /// The skeleton DOFs of the columns coupled to the bubbles.
+        std::vector<int> cols;
+        /// (A_bb)^{-1} A_bc, [bubble * cols.size() + col], and (A_bb)^{-1} f_b.
+        Scalar* coupling;
+        Scalar* lift;
+      };
+
+      /// Finds the groups and the skeleton DOFs, creates the sparse structure of the skeleton matrix.
+      void init_structure(Hermes::vector<const Space<Scalar>*> spaces, SparseMatrix<Scalar>* skeleton_matrix);
+
+      /// Eliminates the bubbles of the group, adds the Schur complement into skeleton_matrix.
+      /// @param[out] rhs_update The change of the skeleton right-hand side in the rows of the group.
+      void eliminate(Group& group, SparseMatrix<Scalar>* skeleton_matrix, Scalar* rhs_update);
+
+      void free_groups();
+
+      CSRMatrix<Scalar> full_matrix;
+      KrylovVector<Scalar> full_rhs;
+
+      /// The skeleton index of every DOF, -1 for the eliminated ones.
+      std::vector<int> skeleton_index;
+      /// The group of every DOF, -1 for the skeleton ones.
+      std::vector<int> group_index;
+      std::vector<Group> groups;
+      int ndof;
+      int num_skeleton_dofs;
+      int max_group_size;
+
+      /// The sparse structure of the full matrix, the seq numbers of the spaces and the skeleton matrix the groups were found for.
+      std::vector<int> structure_Ap;
+      std::vector<int> structure_Ai;
+      std::vector<int> structure_seqs;
+      SparseMatrix<Scalar>* structure_skeleton_matrix;
+
+      /// True if the groups have to be found again.
+      bool structure_changed(Hermes::vector<const Space<Scalar>*> spaces, SparseMatrix<Scalar>* skeleton_matrix) const;
+
+      /// The solution of the full system.
+      Scalar* sln_vector;
+
+      Hermes::Exceptions::ParallelStatus elimination_status;
+    };
+  }
+}
+#endif
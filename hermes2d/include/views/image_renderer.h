@@ -0,0 +1,100 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef __H2D_IMAGE_RENDERER_H
+#define __H2D_IMAGE_RENDERER_H
+
+#include "view.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    namespace Views
+    {
+      /// \brief Off-screen rendering of linearized data into RGB images, saved as PNG.
+      ///
+      /// Unlike the views, the renderer needs neither a display nor OpenGL (it is available also with NOGLUT):
+      /// the triangles of a Linearizer, Vectorizer or Orderizer are rasterized on the CPU, the threads filling
+      /// horizontal bands of the image, with the palettes of the views. The image shows the whole domain, with
+      /// the aspect ratio kept, as the views do after reset (the 2D mode, no scale, no labels).
+      /// Meant for the batch output of the frames of a computation, see also ImageOutputWriter.
+      class HERMES_API ImageRenderer : public Hermes::Mixins::Loggable
+      {
+      public:
+        ImageRenderer(int width = H2D_DEFAULT_WIDTH, int height = H2D_DEFAULT_HEIGHT);
+        virtual ~ImageRenderer();
+
+        /// The range of the values mapped to the palette, the values outside have the colors of the limits.
+        void set_min_max_range(double min, double max);
+        /// The range is the one of the rendered data (default).
+        void set_auto_range();
+
+        void set_palette(ViewPaletteType type);
+
+        /// Draw all the edges of the elements (default), otherwise only the boundary.
+        void show_edges(bool show = true);
+        void set_edges_color(float r, float g, float b);
+
+        /// Renders the values of the linearized function.
+        void render(Linearizer* lin);
+        /// Renders the magnitudes of the linearized vector field.
+        void render(Vectorizer* vec);
+        /// Renders the polynomial orders, in the colors of the OrderView.
+        void render(Orderizer* ord);
+        /// Renders a MeshFunction (Solution, Filter), linearized by the internal Linearizer.
+        void render(MeshFunction<double>* sln, int item = H2D_FN_VAL_0, double eps = HERMES_EPS_NORMAL);
+
+        int get_width() const;
+        int get_height() const;
+        /// The RGB pixels of the last rendered image, row by row from the top.
+        const unsigned char* get_pixels() const;
+
+        void save_png(const char* file_name) const;
+        /// Like save_png(), but forms the file name in printf-style using the 'number'
+        /// parameter, e.g., format = "frame%04d.png" and number = 5 gives the file name "frame0005.png".
+        void save_numbered_png(const char* format, int number) const;
+
+      protected:
+        /// Sets the mapping of the domain to the pixels and clears the image.
+        void begin(double min_x, double max_x, double min_y, double max_y);
+
+        /// Fills the triangles, either with the palette colors of the per-vertex parameters t (0..1, interpolated),
+        /// or with the per-triangle colors. The vertex coordinates are in pixels.
+        void fill_triangles(const double2* pixel_verts, const int3* tris, int num_tris, const double* t, const unsigned char* tri_colors);
+
+        /// Draws the edges (all of them, or with a nonzero marker if edge_markers is not NULL).
+        void draw_edges(const double2* pixel_verts, const int2* edges, const int* edge_markers, int num_edges);
+
+        void get_palette_color(double t, unsigned char* color) const;
+
+        int width, height;
+        unsigned char* pixels;
+
+        bool range_auto;
+        double range_min, range_max;
+        ViewPaletteType pal_type;
+        bool b_show_edges;
+        unsigned char edges_color[3];
+
+        /// The mapping of the domain to the pixels.
+        double scale, offset_x, offset_y;
+
+        Linearizer lin;
+      };
+    }
+  }
+}
+#endif
@@ -0,0 +1,111 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef __H2D_LINEARIZED_DATA_WRITER_H
+#define __H2D_LINEARIZED_DATA_WRITER_H
+
+#include "global.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    namespace Views
+    {
+      /// \brief Binary output of linearized data (see Linearizer::write_step(), Vectorizer::write_step(), Orderizer::write_step()).
+      ///
+      /// A step is a triangular mesh (the points and the triangles) with any number of fields in the points and in the triangles.
+      /// All the data of a step is copied into contiguous arrays by begin_step() and the add_*() methods and written at once,
+      /// in one of the formats:
+      /// - VTU_BINARY: the VTK XML unstructured grid with raw appended data (no formatting, no base64),
+      ///   the steps of a time series are the files file_name_<step>.vtu collected by file_name.pvd,
+      /// - XDMF_HDF5: the arrays are the datasets /step_<step>/... of file_name.h5, described by file_name.xmf,
+      ///   all the steps of a time series are in these two files (only with WITH_HDF5).
+      /// The index files (pvd, xmf) are rewritten after every step, so that they are complete while a computation runs.
+      class HERMES_API LinearizedDataWriter : public Hermes::Mixins::Loggable
+      {
+      public:
+        enum Format
+        {
+          VTU_BINARY,
+          XDMF_HDF5
+        };
+
+        /// @param[in] file_name The name of the files without the extension.
+        /// @param[in] time_series The steps are kept (with their times), otherwise every step overwrites the previous one.
+        LinearizedDataWriter(const char* file_name, Format format = VTU_BINARY, bool time_series = false);
+        /// Writes the open step, if any.
+        virtual ~LinearizedDataWriter();
+
+        /// Starts a step, the previous one is written if end_step() has not been called.
+        /// @param[in] x, y, z The coordinates of the points, the i-th point at x[i * point_stride] etc., z may be NULL (zero z).
+        void begin_step(double time, int num_points, const double* x, const double* y, const double* z, int point_stride,
+          int num_triangles, const int3* triangles);
+
+        /// Adds a field in the points of the step.
+        /// @param[in] num_components 1 for a scalar field, 2 or 3 for a vector one (written with 3 components).
+        /// @param[in] components The components, the value of the i-th point at components[c][i * stride].
+        void add_point_field(const char* name, int num_components, const double* const* components, int stride);
+
+        /// Adds an integer field in the triangles of the step (the element markers, the polynomial orders, ...).
+        void add_cell_field(const char* name, const int* values);
+
+        /// Writes the step.
+        void end_step();
+
+        /// The number of the steps written so far.
+        int get_num_steps() const;
+
+      protected:
+        struct DataArray
+        {
+          std::string name;
+          int num_components;
+          bool point_data;
+          /// Exactly one of the arrays is used.
+          double* values;
+          int* int_values;
+        };
+
+        void write_vtu();
+        void write_xdmf();
+        void free_step();
+
+        std::string file_name;
+        Format format;
+        bool time_series;
+
+        /// The open step.
+        bool step_open;
+        double step_time;
+        int num_points;
+        double* points;
+        int num_triangles;
+        int* triangles;
+        std::vector<DataArray> arrays;
+
+        int num_steps;
+        /// The entries of the steps written so far in the index file (pvd DataSets, xmf Grids).
+        std::vector<std::string> index_entries;
+
+#ifdef WITH_HDF5
+        /// The HDF5 file of a time series, kept open.
+        int64_t h5_file;
+#endif
+      };
+    }
+  }
+}
+#endif
@@ -34,12 +34,16 @@ namespace Hermes
       /// solution (e.g., gradients or in Hcurl) by inserting double vertices where necessary.
       /// Linearizer also serves as a container for the resulting linearized mesh.
       ///
+      /// Every thread linearizes a contiguous part of the elements into the buffers of its own (worker) instance,
+      /// the buffers are then merged, the vertices shared by the parts being identified by the same keys as within
+      /// one part (see merge()), and the result is regularized at once.
+      ///
       class HERMES_API Linearizer : public LinearizerBase
       {
       public:
 
         Linearizer(bool auto_max = true);
-        ~Linearizer();
+        virtual ~Linearizer();
 
         /// Main method - processes the solution and stores the data obtained by the process.
         /// \param[in] sln the solution
@@ -52,6 +56,15 @@ namespace Hermes
           bool mode_3D = true, int item = H2D_FN_VAL_0,
           double eps = HERMES_EPS_NORMAL);
 
+        /// Save a MeshFunction (Solution, Filter) in the binary VTU format (file_name.vtu), see LinearizedDataWriter.
+        void save_solution_vtu(MeshFunction<double>* sln, const char* file_name, const char* quantity_name,
+          bool mode_3D = true, int item = H2D_FN_VAL_0, double eps = HERMES_EPS_NORMAL);
+
+        /// Starts a step of the writer with the result of the last process_solution(): the vertices (with the values as z in mode_3D),
+        /// the triangles, the values as the point field quantity_name and the element markers as the cell field "marker".
+        /// Further fields may be added to the step by the writer until its end_step().
+        void write_step(LinearizedDataWriter* writer, const char* quantity_name, bool mode_3D = true, double time = 0.0);
+
         /// Set the displacement, i.e. set two functions that will deform the domain for visualization, in the x-direction, and the y-direction.
         void set_displacement(MeshFunction<double>* xdisp, MeshFunction<double>* ydisp, double dmult = 1.0);
 
@@ -79,10 +92,31 @@ namespace Hermes
         /// Get the 'curvature' epsilon determining the tolerance of catching the shape of curved elements.
         double get_curvature_epsilon();
 
+        /// Keep the subdivision of the elements found by the next call of process_solution().
+        /// The following calls on the same (unchanged) meshes with the same item and eps then only evaluate the function
+        /// (and the displacement) at the kept vertices, the triangles and the edges stay the same.
+        /// Meant for the time-dependent problems, the subdivision is not adapted to the new solutions.
+        void freeze_subdivision(bool freeze = true);
+
+        /// Decimate the linearized mesh of the following calls of process_solution(), for overviews and smaller output files.
+        /// The inner vertices are removed (their edges collapsed into a neighbor) in the order of the error of the linear
+        /// interpolation of the value this introduces, until the number of the triangles is at most max_triangles (if > 0)
+        /// and as long as the estimated error stays within tolerance times the range of the values (if tolerance > 0).
+        /// The vertices on the boundary, on the discontinuities, on the marked edges and between the elements with different
+        /// markers are kept, so are the marked edges; the edges with the marker 0 (the inner edges of the mesh) are dropped.
+        /// With a kept subdivision (freeze_subdivision()), the decimation of the recording call is kept as well,
+        /// the removed vertices then stay in the vertex array, unused.
+        /// \param[in] max_triangles The budget of the triangles, 0 for none.
+        /// \param[in] tolerance The relative tolerance of the value, 0 for none. The default (0, 0) means no decimation.
+        void set_decimation(int max_triangles, double tolerance = 0.0);
+
         /// Free the instance.
         void free();
 
       protected:
+        /// States of the traversal of the meshes of the last processed solution(s).
+        TraverseStateList traverse_states;
+
         /// The 'curvature' epsilon.
         double curvature_epsilon;
 
@@ -100,9 +134,60 @@ namespace Hermes
         /// What kind of information do we want to get out of the solution.
         int item, component, value_type;
 
+        /// The kept subdivision, see freeze_subdivision().
+        bool frozen_subdivision;
+        /// The split codes of the recursion (see process_triangle(), process_quad()) and the vertices returned by get_vertex(),
+        /// in the order of the states, state_split_start[i] and state_vertex_start[i] being the first ones of the state i.
+        int* split_codes;
+        int split_codes_count, split_codes_size;
+        int* vertex_indices;
+        int vertex_indices_count, vertex_indices_size;
+        int* state_split_start;
+        int* state_vertex_start;
+        /// The number of the states, the item and eps of the recorded subdivision, pattern_num_states == -1 if there is none.
+        int pattern_num_states, pattern_item;
+        double pattern_eps;
+        /// The subdivision is being recorded (by this worker), or replayed with the cursors of the threads.
+        bool recording, replaying;
+        int* split_cursor;
+        int* vertex_cursor;
+
+        /// The parameters of the decimation, see set_decimation().
+        int decimation_max_triangles;
+        double decimation_tolerance;
+
+        /// Decimates the regularized triangles (assumes the values range found).
+        void decimate();
+
+        /// The estimated error of collapsing the vertex a into its neighbor b, -1 if that is not possible (a triangle would flip
+        /// or degenerate, or the vertices have more than two common neighbors). It is the error of the value at a plus the largest
+        /// error carried by the vertices of its triangles from the earlier collapses. vertex_tris are the triangles of the vertices.
+        double collapse_error(int a, int b, const std::vector<std::vector<int> >& vertex_tris, const std::vector<double>& carried_error);
+
+        void record_split(int split);
+        void record_vertex(int vertex);
+        void free_subdivision();
+
+        /// Evaluates the functions at the vertices of the kept subdivision, in parallel.
+        /// A vertex shared by elements is written by the threads of all of them, the values agree up to the tolerance of get_vertex()
+        /// as long as the function is continuous where it was at the recording.
+        void replay_subdivision(MeshFunction<double>*** fns, Transformable*** trfs, Traverse::State** states, int num_states);
+
         int add_vertex();
         int get_vertex(int p1, int p2, double x, double y, double value);
 
+        /// (Re)allocates the arrays for the linearization of num_elements elements, with the room for at least
+        /// the given numbers of vertices, triangles and edges, and empties the vertex hash table.
+        void init_arrays(int num_elements, int num_vertices = 0, int num_triangles = 0, int num_edges = 0);
+
+        /// Linearizes the active element of fns[0] (the active state has been set).
+        void process_element(MeshFunction<double>** fns);
+
+        /// Appends the vertices, triangles and edges of a worker.
+        /// A vertex of the worker is looked up by its key, the mesh vertex id for the element vertices,
+        /// the (merged) parent vertices otherwise, so that the vertices on the boundaries of the parts are not duplicated.
+        void merge(Linearizer* worker);
+
         void process_triangle(MeshFunction<double>** fns, int iv0, int iv1, int iv2, int level,
           double* val, double* phx, double* phy, int* indices, bool curved);
 
@@ -23,6 +23,7 @@
 
 #include "global.h"
 #include "../quadrature/quad_all.h"
+#include "linearized_data_writer.h"
 
 namespace Hermes
 {
@@ -99,7 +100,7 @@ namespace Hermes
 
       protected:
         LinearizerBase(bool auto_max = true);
-        ~LinearizerBase();
+        virtual ~LinearizerBase();
 
         void process_edge(int iv1, int iv2, int marker);
 
@@ -129,6 +130,8 @@ namespace Hermes
 
         int peek_vertex(int p1, int p2);
 
+        /// Not synchronized, the threads of the classes processing the elements in parallel have to work on their own instances,
+        /// or to serialize the calls.
         void add_edge(int iv1, int iv2, int marker);
         void add_triangle(int iv0, int iv1, int iv2, int marker);
 
@@ -63,11 +63,34 @@ namespace Hermes
 
         void init_order_palette(double3* vert); ///< Initializes the palette from supplied vertices.
 
+#pragma pack(push)
+#pragma pack(1)
+        struct GLVertex2 ///< OpenGL vertex with the color of the order of its triangle.
+        {
+          float x, y;
+          float color[3];
+          GLVertex2() {};
+          static const size_t H2D_OFFSETOF_COLOR = 2*sizeof(float); ///< Offset of the color
+        };
+#pragma pack(pop)
+
+        bool ord_updated; ///< true, if ord or the palette changed since the buffers were filled
+
+        /// Vertex buffer, the (untransformed) vertices of the triangles, three per triangle (the vertices of the orderizer
+        /// carry the orders of the edges, a triangle has the color of its first vertex), followed by two vertices per edge.
+        unsigned int gl_coord_buffer;
+        int gl_tri_cnt; ///< The number of the triangles in gl_coord_buffer.
+        int gl_edge_cnt; ///< The number of the edges in gl_coord_buffer.
+
+        void init();
+        void prepare_gl_geometry(); ///< Uploads the data of ord to the buffers if it is updated. In a case of a failure, the buffers are 0 and the old OpenGL rendering method is used.
+
         virtual void on_display();
         virtual void on_key_down(unsigned char key, int x, int y);
         virtual void scale_dispatch();
         virtual int measure_scale_labels();
         virtual const char* get_help_text() const;
+        virtual void on_close();
       };
 #else
       class HERMES_API OrderView : public View
@@ -34,6 +34,9 @@ namespace Hermes
         Orderizer();
         ~Orderizer();
 
+        /// Processes the orders of the space.
+        /// The result is kept for the space: a following call with the same (unchanged) space returns at once, and if only
+        /// the orders changed (not the mesh), the orders of the changed elements are rewritten in place.
         template<typename Scalar>
         void process_space(const Space<Scalar>* space);
 
@@ -44,6 +47,10 @@ namespace Hermes
         template<typename Scalar>
         void save_mesh_vtk(const Space<Scalar>* space, const char* file_name);
 
+        /// Starts a step of the writer with the result of the last process_space(): the vertices, the triangles,
+        /// and the polynomial orders and the element markers as the cell fields "order" and "marker".
+        void write_step(LinearizedDataWriter* writer, double time = 0.0);
+
         int get_labels(int*& lvert, char**& ltext, double2*& lbox) const;
 
         void calc_vertices_aabb(double* min_x, double* max_x,
@@ -71,6 +78,21 @@ namespace Hermes
         int add_vertex();
 
         void make_vert(int & index, double x, double y, double val);
+
+        /// The orders of the element (o[0..3] of the edges, o[4], o[5] horizontal and vertical) as they are shown.
+        template<typename Scalar>
+        static void get_element_orders(const Space<Scalar>* space, Element* e, int* o);
+
+        /// The space, mesh and their seq numbers of the result, see process_space().
+        const void* cached_space;
+        int cached_space_seq;
+        const Mesh* cached_mesh;
+        unsigned int cached_mesh_seq;
+        /// The element ids, their orders (6 per element) and first triangles, in the order of the labels.
+        /// The vertices of the element with the label i start at lvert[i].
+        int* elem_ids;
+        int* elem_orders;
+        int* elem_first_triangle;
       };
     }
   }
@@ -130,6 +130,16 @@ namespace Hermes
           GLVertex2(float x, float y, float coord) : x(x), y(y), coord(coord) {};
           static const size_t H2D_OFFSETOF_COORD = 2*sizeof(float); ///< Offset of coordinate
         };
+        struct GLVertex3 ///< OpenGL vertex of the 3D mode. The model transformation is applied by the model/view matrix.
+        {
+          float x, y, z; ///< (x, value, y) of the linearized vertex
+          float nx, ny, nz; ///< the normal in the same order of the components
+          float coord;
+          GLVertex3() {};
+          GLVertex3(float x, float y, float z, float nx, float ny, float nz, float coord) : x(x), y(y), z(z), nx(nx), ny(ny), nz(nz), coord(coord) {};
+          static const size_t H2D_OFFSETOF_NORMAL = 3*sizeof(float); ///< Offset of the normal
+          static const size_t H2D_OFFSETOF_COORD = 6*sizeof(float); ///< Offset of coordinate
+        };
 #pragma pack(pop)
 
         bool lin_updated; ///< true, if lin now contains new values
@@ -141,12 +151,20 @@ namespace Hermes
         int max_gl_tris; ///< A maximum allocated number of triangles
         int gl_tri_cnt; ///< A number of OpenGL triangles
 
+        bool gl_3d_updated; ///< true, if the vertices or the normals changed since the 3D vertex buffer was filled
+        unsigned int gl_3d_vertex_buffer; ///< Vertex buffer of the 3D mode, (x, value, y, normal, t), drawn with the indices of gl_index_buffer.
+        int max_gl_3d_verts; ///< A maximum allocated number of vertices of the 3D vertex buffer
+
         bool show_values; ///< true to show values
 
         void prepare_gl_geometry(); ///< prepares geometry in a form compatible with GL arrays; Data are updated if lin is updated. In a case of a failure (out of memory), gl_verts is NULL and an old OpenGL rendering method has to be used.
         void draw_values_2d(); ///< draws values
         void draw_edges_2d(); ///< draws edges
 
+        void prepare_gl_geometry_3d(); ///< Fills the 3D vertex buffer if the data or the normals changed. In a case of a failure, gl_3d_vertex_buffer is 0 and the 3D mode uses the old OpenGL rendering method.
+        void draw_values_3d(); ///< draws the surface
+        void draw_edges_3d(); ///< draws the edges on the surface
+
         void draw_normals_3d(); ////< Draws normals of the 3d mesh. Used for debugging purposses only.
 
       protected: //edges
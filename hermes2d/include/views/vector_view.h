@@ -64,10 +64,34 @@ namespace Hermes
 
         void plot_arrow(double x, double y, double xval, double yval, double max, double min, double gs);
 
+#pragma pack(push)
+#pragma pack(1)
+        struct GLVertex2 ///< OpenGL vertex. Used to cache vertices prior rendering
+        {
+          float x, y;
+          float mag; ///< the magnitude of the vector, mapped to the palette by the texture matrix
+          GLVertex2() {};
+          GLVertex2(float x, float y, float mag) : x(x), y(y), mag(mag) {};
+          static const size_t H2D_OFFSETOF_MAG = 2*sizeof(float); ///< Offset of the magnitude
+        };
+#pragma pack(pop)
+
+        bool vec_updated; ///< true, if vec contains new data since the buffers were filled
+
+        unsigned int gl_coord_buffer; ///< Vertex buffer, the (untransformed) vertices with the magnitudes.
+        unsigned int gl_index_buffer; ///< Index buffer of the triangles.
+        unsigned int gl_edge_inx_buffer; ///< Index buffer of the edges, the edges with a nonzero marker first.
+        int gl_edge_cnt; ///< The number of the edges in gl_edge_inx_buffer.
+        int gl_marked_edge_cnt; ///< The number of the edges with a nonzero marker.
+
+        void init();
+        void prepare_gl_geometry(); ///< Uploads the linearized data to the buffers if vec is updated. In a case of a failure, the buffers are 0 and the old OpenGL rendering method is used.
+
         virtual void on_display();
         virtual void on_mouse_move(int x, int y);
         virtual void on_key_down(unsigned char key, int x, int y);
         virtual const char* get_help_text() const;
+        virtual void on_close();
       };
 #else
       class HERMES_API VectorView : public View
@@ -29,12 +29,15 @@ namespace Hermes
       /// resulting mesh is not attempted. The class can handle different meshes in
       /// both X and Y components.
       ///
+      /// The elements are processed in parallel as by the Linearizer, every thread into the buffers of its own (worker) instance,
+      /// which are merged afterwards (see merge()).
+      ///
       class HERMES_API Vectorizer : public LinearizerBase
       {
       public:
 
         Vectorizer();
-        ~Vectorizer();
+        virtual ~Vectorizer();
 
         /// Main method - processes the solution and stores the data obtained by the process.
         /// \param[in] xsln the first solution (in the x-direction)
@@ -47,6 +50,10 @@ namespace Hermes
         /// Set the displacement, i.e. set two functions that will deform the domain for visualization, in the x-direction, and the y-direction.
         void set_displacement(MeshFunction<double>* xdisp, MeshFunction<double>* ydisp, double dmult = 1.0);
 
+        /// Starts a step of the writer with the result of the last process_solution(): the vertices, the triangles,
+        /// the vector field quantity_name and the element markers as the cell field "marker" (see Linearizer::write_step()).
+        void write_step(LinearizedDataWriter* writer, const char* quantity_name, double time = 0.0);
+
         /// Get the number of vertices of this instance.
         int get_num_vertices();
 
@@ -74,6 +81,9 @@ namespace Hermes
         void free();
 
       protected:
+        /// States of the traversal of the meshes of the last processed solution(s).
+        TraverseStateList traverse_states;
+
         /// The 'curvature' epsilon.
         double curvature_epsilon;
 
@@ -100,6 +110,16 @@ namespace Hermes
 
         void add_dash(int iv1, int iv2);
 
+        /// (Re)allocates the arrays for the linearization of num_elements elements, with the room for at least
+        /// the given numbers of vertices, triangles and edges, and empties the vertex hash table.
+        void init_arrays(int num_elements, int num_vertices = 0, int num_triangles = 0, int num_edges = 0);
+
+        /// Linearizes the active element of fns[0] (the active state has been set).
+        void process_element(MeshFunction<double>** fns);
+
+        /// Appends the vertices, triangles and edges of a worker, the vertices being looked up by their keys (see Linearizer::merge()).
+        void merge(Vectorizer* worker);
+
         void process_triangle(MeshFunction<double>** fns, int iv0, int iv1, int iv2, int level,
           double* xval, double* yval, double* phx, double* phy, int* indices, bool curved);
 
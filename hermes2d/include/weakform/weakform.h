@@ -48,6 +48,7 @@ namespace Hermes
     template<typename Scalar> class Form;
     template<typename Scalar> class OGProjection;
     template<typename Scalar> class MatrixFormVol;
+    template<typename Scalar> class MatrixFormVolBlock;
     template<typename Scalar> class VectorFormVol;
     template<typename Scalar> class MatrixFormSurf;
     template<typename Scalar> class VectorFormSurf;
@@ -171,6 +172,16 @@ namespace Hermes
       /// Deletes all volumetric and surface forms.
       void delete_all();
 
+      /// Has to be called after a change of the parameters of the forms (or of a derived weak form) that are not
+      /// set through the methods of WeakForm and Form, e.g. a coefficient member of a form.
+      /// DiscreteProblem keeps its per-thread clones of the weak form between the assemblings,
+      /// only the times, the base attributes of the forms (scaling factor, stage time, ...) and the external
+      /// functions are synchronized with the original; this makes it clone the weak form again.
+      void set_modified();
+
+      /// Incremented by every change of the weak form, see set_modified().
+      unsigned int get_modification_count() const;
+
     protected:
       /// External solutions.
       Hermes::vector<MeshFunction<Scalar>*> ext;
@@ -213,10 +224,17 @@ namespace Hermes
 
       bool warned_nonOverride;
 
+      unsigned int modification_count;
+
       // internal.
       virtual void cloneMembers(const WeakForm<Scalar>* otherWf);
 
+      /// Internal, for a clone (cloneMembers()) of otherWf: takes over the times and the base attributes of the forms.
+      void sync_with(const WeakForm<Scalar>* otherWf);
+
     private:
+      /// Clones the external functions of otherWf and its forms (these have to correspond to the forms of this one).
+      void clone_ext(const WeakForm<Scalar>* otherWf);
       void free_ext();
     };
 
@@ -249,6 +267,31 @@ namespace Hermes
       /// scaling factor
       void setScalingFactor(double scalingFactor);
 
+      /// The form is treated explicitly by RungeKutta with an IMEX Butcher's table (see ButcherTable::is_imex()):
+      /// it is evaluated at the already computed stages only and does not enter the Jacobian
+      /// (e.g. a non-stiff reaction term next to a stiff diffusion). Default: false.
+      void set_explicit_in_time(bool onOff = true);
+      bool is_explicit_in_time() const;
+
+      /// The (matrix) form does not depend on the time (e.g. the stiffness or the mass of a transient linear problem):
+      /// DiscreteProblemLinear assembles all such forms once into a kept matrix that is added to the time-dependent part
+      /// assembled at every time step. Default: false.
+      /// The forms must not be changed while the kept matrix is used, see DiscreteProblemLinear::invalidate_time_independent_matrix().
+      void set_time_independent(bool onOff = true);
+      bool is_time_independent() const;
+
+      /// Optional description of the integration order of the form as
+      /// u_coefficient * order(u) + v_coefficient * order(v) + ext_coefficient * (the highest order of u_ext and ext) + increase,
+      /// used instead of evaluating ord() (u_coefficient is not used for vector forms).
+      /// The default implementation returns the formula declared by set_order_formula() or set_constant_order().
+      /// @return false if the order has to be obtained from ord().
+      virtual bool get_order_formula(int& u_coefficient, int& v_coefficient, int& ext_coefficient, int& increase) const;
+
+      /// Declares the integration order of the form, see get_order_formula(); ord() is then not evaluated at all.
+      void set_order_formula(int u_coefficient, int v_coefficient, int ext_coefficient = 0, int increase = 0);
+      /// Declares a fixed integration order of the form (before the adjustment to curved elements).
+      void set_constant_order(int order);
+
     protected:
       /// Set pointer to a WeakForm.
       inline void set_weakform(WeakForm<Scalar>* wf) { this->wf = wf; }
@@ -274,9 +317,30 @@ namespace Hermes
       /// Form will be always multiplied (scaled) with this number.
       double scaling_factor;
 
+      /// See set_explicit_in_time().
+      bool explicit_in_time;
+
+      /// See set_time_independent().
+      bool time_independent;
+
+      /// See set_order_formula().
+      bool order_formula_declared;
+      int order_formula[4];
+
       WeakForm<Scalar>* wf;
       double stage_time;
       void set_uExtOffset(int u_ext_offset);
+
+      /// The areas translated to the internal markers of the meshes, see DiscreteProblem::resolve_form_markers(),
+      /// so that the check of an element or an edge is a lookup instead of comparing the strings.
+      /// resolved_markers[marker] is true if the form is assembled on the internal marker.
+      std::vector<bool> resolved_markers;
+      /// The tables are valid (reset by set_area(), set_areas()).
+      bool markers_resolved;
+      /// One of the areas is HERMES_ANY.
+      bool assembled_everywhere;
+      inline bool is_assembled_on(int marker) const { return assembled_everywhere || (marker >= 0 && marker < (int)resolved_markers.size() && resolved_markers[marker]); }
+
       friend class WeakForm<Scalar>;
       friend class RungeKutta<Scalar>;
       friend class DiscreteProblem<Scalar>;
@@ -324,9 +388,71 @@ namespace Hermes
 
       virtual ~MatrixFormVol();
 
+      /// Optional batched evaluation of the form for all pairs of basis and test functions of the element.
+      /// Fills local_matrix[i][j] with the value of the form for the test function v[i] and the basis function u[j],
+      /// which allows to evaluate coefficients only once per integration point and to run the
+      /// remaining sums as small dense products.
+      /// @return false if the form does not implement it, value() is then called for every pair.
+      virtual bool value_all(int n, double *wt, Func<Scalar> *u_ext[], int u_count, Func<double> **u, int v_count, Func<double> **v,
+        Geom<double> *e, Func<Scalar> **ext, Scalar **local_matrix) const;
+
+      /// Optional description of forms equal to mass_coefficient * (u, v) + diffusion_coefficient * (grad u, grad v)
+      /// with both coefficients constant. Such forms are assembled from integrals over the reference element
+      /// on elements with a constant reference map, without any numerical integration.
+      /// @return false if the form is not of this type.
+      virtual bool get_constant_coefficients(Scalar& mass_coefficient, Scalar& diffusion_coefficient) const;
+
+      /// Optional description of forms equal to sum_k wt[k] * (mass[k] * u v + diffusion[k] * grad u . grad v),
+      /// fills in the coefficients in the n integration points. On quads, such forms are assembled by sum factorization.
+      /// @return false if the form is not of this type.
+      virtual bool get_point_coefficients(int n, Func<Scalar> *u_ext[], Geom<double> *e, Func<Scalar> **ext,
+        Scalar* mass, Scalar* diffusion) const;
+
       virtual MatrixFormVol* clone() const;
     };
 
+    /// \brief Matrix volumetric form of a vector-valued equation - i.e. one form for all the blocks [i + bi, j + bj], bi, bj < block_count,
+    /// of a system such as the Lame equations of elasticity.
+    ///
+    /// The blocks are assembled together into one local matrix of the element (see value_all_blocks()), so the values,
+    /// gradients and coefficients in the integration points are run through once for all the blocks instead of once per block.
+    /// The local matrix is inserted into the global one at once, with the DOFs of all the components, which with the
+    /// DOFs interleaved (Space::assign_dofs_interleaved()) and a BSRMatrix of the block size block_count hits whole blocks.
+    template<typename Scalar>
+    class HERMES_API MatrixFormVolBlock : public MatrixFormVol<Scalar>
+    {
+    public:
+      /// Constructor with the coordinates of the first block.
+      MatrixFormVolBlock(unsigned int i, unsigned int j, unsigned int block_count);
+
+      virtual ~MatrixFormVolBlock();
+
+      unsigned int get_block_count() const;
+
+      /// False for the blocks [i + bi, j + bj] that are identically zero, they are left out of the sparse structure.
+      /// All blocks are present by default.
+      virtual bool has_block(unsigned int bi, unsigned int bj) const;
+
+      /// The value of the block [i + bi, j + bj] of the form for the basis function u of the component j + bj
+      /// and the test function v of the component i + bi.
+      virtual Scalar value_block(unsigned int bi, unsigned int bj, int n, double *wt, Func<Scalar> *u_ext[], Func<double> *u, Func<double> *v,
+        Geom<double> *e, Func<Scalar> **ext) const = 0;
+
+      /// Optional evaluation of all the blocks at once, used if all the components share the integration points.
+      /// Fills local_matrix[r][c], the rows r are the test functions v[0][0..v_counts[0]), v[1][0..v_counts[1]), ...,
+      /// the columns c the basis functions u[0][0..u_counts[0]), u[1][0..u_counts[1]), ...
+      /// @return false if the form does not implement it, value_block() is then called for every pair.
+      virtual bool value_all_blocks(int n, double *wt, Func<Scalar> *u_ext[], const int* u_counts, Func<double> ***u, const int* v_counts, Func<double> ***v,
+        Geom<double> *e, Func<Scalar> **ext, Scalar **local_matrix) const;
+
+      /// The block [i, j], see value_block().
+      virtual Scalar value(int n, double *wt, Func<Scalar> *u_ext[], Func<double> *u, Func<double> *v,
+        Geom<double> *e, Func<Scalar> **ext) const;
+
+    protected:
+      unsigned int block_count;
+    };
+
     /// \brief Abstract, base class for matrix Surface form - i.e. MatrixForm, where the integration is with respect to 1D-Lebesgue measure (element domain-boundary edges).
     template<typename Scalar>
     class HERMES_API MatrixFormSurf : public MatrixForm<Scalar>
@@ -356,6 +482,13 @@ namespace Hermes
       virtual Scalar value(int n, double *wt, DiscontinuousFunc<double> *u, DiscontinuousFunc<double> *v,
         Geom<double> *e, DiscontinuousFunc<Scalar> **ext) const;
 
+      /// Optional batched evaluation of the form for all pairs of basis and test functions on the edge,
+      /// see MatrixFormVol::value_all(). The entries of u and v of the functions not assembled are NULL,
+      /// the corresponding entries of local_matrix are not used.
+      /// @return false if the form does not implement it, value() is then called for every pair.
+      virtual bool value_all(int n, double *wt, int u_count, DiscontinuousFunc<double> **u, int v_count, DiscontinuousFunc<double> **v,
+        Geom<double> *e, DiscontinuousFunc<Scalar> **ext, Scalar **local_matrix) const;
+
       virtual Hermes::Ord ord(int n, double *wt, DiscontinuousFunc<Hermes::Ord> *u, DiscontinuousFunc<Hermes::Ord> *v,
         Geom<Hermes::Ord> *e, DiscontinuousFunc<Ord> **ext) const;
 
@@ -396,6 +529,12 @@ namespace Hermes
 
       virtual ~VectorFormVol();
 
+      /// Optional description of forms equal to sum_k wt[k] * (f_val[k] * v + f_dx[k] * dv/dx + f_dy[k] * dv/dy),
+      /// fills in the fluxes in the n integration points. On quads, such forms are assembled by sum factorization.
+      /// @return false if the form is not of this type.
+      virtual bool get_point_fluxes(int n, Func<Scalar> *u_ext[], Geom<double> *e, Func<Scalar> **ext,
+        Scalar* f_val, Scalar* f_dx, Scalar* f_dy) const;
+
       virtual VectorFormVol* clone() const;
     };
 
@@ -0,0 +1,135 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef __H2D_DG_WEAK_FORMS_H
+#define __H2D_DG_WEAK_FORMS_H
+
+#include "../forms.h"
+#include "../weakform/weakform.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    /// Forms of the upwind discontinuous Galerkin discretization of the linear advection equation a . \nabla u = f
+    /// with the velocity a = (velocity_x(x, y), velocity_y(x, y)). The velocity functions are not deleted by the forms.
+    namespace WeakFormsDG
+    {
+      /* Default volumetric matrix form -\int_{area} u a . \nabla v d\bfx
+      */
+
+      template<typename Scalar>
+      class HERMES_API DefaultMatrixFormVolAdvection : public MatrixFormVol<Scalar>
+      {
+      public:
+        DefaultMatrixFormVolAdvection(int i, int j, Hermes2DFunction<double>* velocity_x, Hermes2DFunction<double>* velocity_y,
+          std::string area = HERMES_ANY);
+
+        virtual Scalar value(int n, double *wt, Func<Scalar> *u_ext[], Func<double> *u, Func<double> *v,
+          Geom<double> *e, Func<Scalar> **ext) const;
+
+        /// The velocity is evaluated once per integration point for all the pairs of functions.
+        virtual bool value_all(int n, double *wt, Func<Scalar> *u_ext[], int u_count, Func<double> **u, int v_count, Func<double> **v,
+          Geom<double> *e, Func<Scalar> **ext, Scalar **local_matrix) const;
+
+        virtual Hermes::Ord ord(int n, double *wt, Func<Hermes::Ord> *u_ext[], Func<Hermes::Ord> *u,
+          Func<Hermes::Ord> *v, Geom<Hermes::Ord> *e, Func<Ord> **ext) const;
+
+        virtual MatrixFormVol<Scalar>* clone() const;
+
+      private:
+        Hermes2DFunction<double>* velocity_x;
+        Hermes2DFunction<double>* velocity_y;
+      };
+
+      /* Default surface matrix form \int_{area} max(a . n, 0) u v dS (the outflow part of the boundary).
+      */
+
+      template<typename Scalar>
+      class HERMES_API DefaultMatrixFormSurfUpwind : public MatrixFormSurf<Scalar>
+      {
+      public:
+        DefaultMatrixFormSurfUpwind(int i, int j, Hermes2DFunction<double>* velocity_x, Hermes2DFunction<double>* velocity_y,
+          std::string area = HERMES_ANY);
+
+        virtual Scalar value(int n, double *wt, Func<Scalar> *u_ext[], Func<double> *u, Func<double> *v,
+          Geom<double> *e, Func<Scalar> **ext) const;
+
+        virtual Hermes::Ord ord(int n, double *wt, Func<Hermes::Ord> *u_ext[], Func<Hermes::Ord> *u,
+          Func<Hermes::Ord> *v, Geom<Hermes::Ord> *e, Func<Ord> **ext) const;
+
+        virtual MatrixFormSurf<Scalar>* clone() const;
+
+      private:
+        Hermes2DFunction<double>* velocity_x;
+        Hermes2DFunction<double>* velocity_y;
+      };
+
+      /* Default surface vector form -\int_{area} min(a . n, 0) g v dS (the inflow part of the boundary
+      with the inflow values g).
+      */
+
+      template<typename Scalar>
+      class HERMES_API DefaultVectorFormSurfUpwind : public VectorFormSurf<Scalar>
+      {
+      public:
+        DefaultVectorFormSurfUpwind(int i, Hermes2DFunction<double>* velocity_x, Hermes2DFunction<double>* velocity_y,
+          Hermes2DFunction<Scalar>* inflow_values, std::string area = HERMES_ANY);
+
+        virtual Scalar value(int n, double *wt, Func<Scalar> *u_ext[], Func<double> *v,
+          Geom<double> *e, Func<Scalar> **ext) const;
+
+        virtual Hermes::Ord ord(int n, double *wt, Func<Hermes::Ord> *u_ext[], Func<Hermes::Ord> *v,
+          Geom<Hermes::Ord> *e, Func<Ord> **ext) const;
+
+        virtual VectorFormSurf<Scalar>* clone() const;
+
+      private:
+        Hermes2DFunction<double>* velocity_x;
+        Hermes2DFunction<double>* velocity_y;
+        Hermes2DFunction<Scalar>* inflow_values;
+      };
+
+      /* Default DG matrix form \int_{inner edges} (a . n) u_upwind [v] dS,
+      u_upwind being the value of u from the side the flow comes from, [v] the jump of v (central - neighbor).
+      */
+
+      template<typename Scalar>
+      class HERMES_API DefaultMatrixFormDGUpwind : public MatrixFormDG<Scalar>
+      {
+      public:
+        DefaultMatrixFormDGUpwind(int i, int j, Hermes2DFunction<double>* velocity_x, Hermes2DFunction<double>* velocity_y);
+
+        virtual Scalar value(int n, double *wt, DiscontinuousFunc<double> *u, DiscontinuousFunc<double> *v,
+          Geom<double> *e, DiscontinuousFunc<Scalar> **ext) const;
+
+        /// The upwind switch is decided once per integration point for all the pairs of functions,
+        /// the sums over the integration points are then free of branches.
+        virtual bool value_all(int n, double *wt, int u_count, DiscontinuousFunc<double> **u, int v_count, DiscontinuousFunc<double> **v,
+          Geom<double> *e, DiscontinuousFunc<Scalar> **ext, Scalar **local_matrix) const;
+
+        virtual Hermes::Ord ord(int n, double *wt, DiscontinuousFunc<Hermes::Ord> *u, DiscontinuousFunc<Hermes::Ord> *v,
+          Geom<Hermes::Ord> *e, DiscontinuousFunc<Ord> **ext) const;
+
+        virtual MatrixFormDG<Scalar>* clone() const;
+
+      private:
+        Hermes2DFunction<double>* velocity_x;
+        Hermes2DFunction<double>* velocity_y;
+      };
+    };
+  }
+}
+#endif
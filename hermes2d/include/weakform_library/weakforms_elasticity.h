@@ -158,6 +158,34 @@ namespace Hermes
       private:
         double lambda, mu;
       };
+
+      /* Vector-valued version -- all four blocks of the Jacobian in one pass over the integration points */
+
+      /// The blocks [i, j], [i, j + 1], [i + 1, j], [i + 1, j + 1] of DefaultJacobianElasticity_0_0, _0_1 and _1_1 (and the transpose of _0_1)
+      /// as one form; the gradients of every pair of functions are integrated once for all the blocks.
+      template<typename Scalar>
+      class HERMES_API DefaultJacobianElasticity : public MatrixFormVolBlock<Scalar>
+      {
+      public:
+        DefaultJacobianElasticity(unsigned int i, unsigned int j, double lambda, double mu);
+        DefaultJacobianElasticity(unsigned int i, unsigned int j, std::string area, double lambda, double mu);
+
+        virtual Scalar value_block(unsigned int bi, unsigned int bj, int n, double *wt, Func<Scalar> *u_ext[], Func<double> *u,
+          Func<double> *v, Geom<double> *e, Func<Scalar> **ext) const;
+
+        virtual bool value_all_blocks(int n, double *wt, Func<Scalar> *u_ext[], const int* u_counts, Func<double> ***u, const int* v_counts, Func<double> ***v,
+          Geom<double> *e, Func<Scalar> **ext, Scalar **local_matrix) const;
+
+        virtual Hermes::Ord ord(int n, double *wt, Func<Hermes::Ord> *u_ext[], Func<Hermes::Ord> *u, Func<Hermes::Ord> *v,
+          Geom<Hermes::Ord> *e, Func<Ord> **ext) const;
+
+        virtual MatrixFormVol<Scalar>* clone() const;
+      private:
+        /// The coefficients of du/dx dv/dx, du/dy dv/dy, du/dy dv/dx and du/dx dv/dy in the block [i + bi, j + bj].
+        void get_block_coefficients(unsigned int bi, unsigned int bj, double* coefficients) const;
+
+        double lambda, mu;
+      };
     };
   }
 }
@@ -0,0 +1,168 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef __H2D_EXPRESSION_WEAK_FORMS_H
+#define __H2D_EXPRESSION_WEAK_FORMS_H
+
+#include "../forms.h"
+#include "../weakform/weakform.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    namespace WeakFormsExpression
+    {
+      /// \brief A form given by an expression string, compiled into the coefficients of the products of the shape functions.
+      ///
+      /// The expression is a polynomial in:
+      /// - u, v: the basis and the test function (u only in matrix forms),
+      /// - x, y: the coordinates,
+      /// - the external functions of the form (by the names given to the constructor, in the order of the Func ext[] of the form),
+      /// - the named parameters (constants given to the constructor),
+      /// combined by +, -, *, / (by constants only), ^ (nonnegative integer powers), the derivatives dx(...), dy(...),
+      /// the gradient grad(...) and the dot product a.b or dot(a, b) of two gradients, e.g. "k*grad(u).grad(v) + c*u*v - dx(u)*v".
+      /// The derivatives of products are expanded by the product rule, second derivatives are not supported.
+      ///
+      /// The expression is expanded once, in the constructor, into the coefficients of the nine products
+      /// (u, du/dx, du/dy) x (v, dv/dx, dv/dy), each of them a sum of monomials in x, y and the external functions.
+      /// The forms are then evaluated as the forms of WeakFormsH1 are: the coefficients are evaluated once per integration point
+      /// for all pairs of functions (MatrixFormVol::value_all()), forms with constant coefficients use the integrals over the reference element
+      /// (MatrixFormVol::get_constant_coefficients()), mass and diffusion forms are assembled by sum factorization on quads
+      /// (MatrixFormVol::get_point_coefficients(), VectorFormVol::get_point_fluxes()), and the integration order follows
+      /// from the degrees of the monomials (Form::get_order_formula()).
+      /// Syntax errors and expressions that are not (bi)linear in the functions throw Hermes::Exceptions::Exception.
+      template<typename Scalar>
+      class HERMES_API CompiledExpression
+      {
+      public:
+        /// @param[in] bilinear The expression is linear in u and in v (a matrix form), otherwise linear in v without u (a vector form).
+        CompiledExpression(std::string expression, bool bilinear, std::map<std::string, Scalar> parameters, Hermes::vector<std::string> ext_names);
+
+        /// The indices of the function values and derivatives in the products.
+        enum FunctionComponent
+        {
+          COMPONENT_VAL = 0,
+          COMPONENT_DX = 1,
+          COMPONENT_DY = 2
+        };
+
+        /// The coefficient of the product of the component a of u (0 in vector forms) and the component b of v is not zero.
+        inline bool has_coefficient(int a, int b) const { return !coefficients[a][b].empty(); }
+
+        /// The coefficient does not depend on the point, its value is then get_constant().
+        bool is_constant(int a, int b) const;
+        Scalar get_constant(int a, int b) const;
+
+        /// The two coefficients are the same sums of monomials.
+        bool coefficients_equal(int a, int b, int c, int d) const;
+
+        /// Evaluates the coefficient in the n integration points.
+        void evaluate(int a, int b, int n, Geom<double> *e, Func<Scalar> **ext, Scalar* result) const;
+
+        /// The order of the term of the coefficient, i.e. of the product with u_a and v_b.
+        Hermes::Ord evaluate_ord(int a, int b, int n, Func<Hermes::Ord> *u, Func<Hermes::Ord> *v, Geom<Hermes::Ord> *e, Func<Hermes::Ord> **ext) const;
+
+        /// The order formula (see Form::get_order_formula()) bounding all the terms.
+        void get_order_formula(int& u_coefficient, int& v_coefficient, int& ext_coefficient, int& increase) const;
+
+        /// The coefficients of the products are symmetric in u and v.
+        bool is_symmetric() const;
+
+        /// A monomial in the coefficient symbols x, y and (value, dx, dy) of every external function.
+        struct Monomial
+        {
+          Scalar coefficient;
+          /// The powers of the coefficient symbols.
+          std::vector<int> powers;
+        };
+
+      protected:
+        std::string expression;
+        bool bilinear;
+        int ext_count;
+        /// coefficients[a][b] is the coefficient of u_a * v_b.
+        std::vector<Monomial> coefficients[3][3];
+      };
+
+      /// \brief Matrix volumetric form given by an expression in u and v, see CompiledExpression.
+      /// The form is symmetric (HERMES_SYM) if i == j and the expression is symmetric in u and v.
+      template<typename Scalar>
+      class HERMES_API ExpressionMatrixFormVol : public MatrixFormVol<Scalar>
+      {
+      public:
+        /// @param[in] ext_names The names of the external functions of the form (Form::set_ext() or the weak formulation's) in the expression.
+        ExpressionMatrixFormVol(int i, int j, std::string expression, std::map<std::string, Scalar> parameters = std::map<std::string, Scalar>(),
+          Hermes::vector<std::string> ext_names = Hermes::vector<std::string>(), std::string area = HERMES_ANY);
+
+        ExpressionMatrixFormVol(int i, int j, std::string expression, std::map<std::string, Scalar> parameters,
+          Hermes::vector<std::string> ext_names, Hermes::vector<std::string> areas);
+
+        virtual Scalar value(int n, double *wt, Func<Scalar> *u_ext[], Func<double> *u, Func<double> *v,
+          Geom<double> *e, Func<Scalar> **ext) const;
+
+        virtual bool value_all(int n, double *wt, Func<Scalar> *u_ext[], int u_count, Func<double> **u, int v_count, Func<double> **v,
+          Geom<double> *e, Func<Scalar> **ext, Scalar **local_matrix) const;
+
+        virtual bool get_constant_coefficients(Scalar& mass_coefficient, Scalar& diffusion_coefficient) const;
+
+        virtual bool get_point_coefficients(int n, Func<Scalar> *u_ext[], Geom<double> *e, Func<Scalar> **ext,
+          Scalar* mass, Scalar* diffusion) const;
+
+        virtual bool get_order_formula(int& u_coefficient, int& v_coefficient, int& ext_coefficient, int& increase) const;
+
+        virtual Hermes::Ord ord(int n, double *wt, Func<Hermes::Ord> *u_ext[], Func<Hermes::Ord> *u,
+          Func<Hermes::Ord> *v, Geom<Hermes::Ord> *e, Func<Ord> **ext) const;
+
+        virtual MatrixFormVol<Scalar>* clone() const;
+
+      private:
+        /// The form is mass_coefficient * u * v + diffusion_coefficient * grad u . grad v.
+        bool is_mass_and_diffusion() const;
+
+        CompiledExpression<Scalar> compiled;
+      };
+
+      /// \brief Vector volumetric form given by an expression in v, see CompiledExpression.
+      template<typename Scalar>
+      class HERMES_API ExpressionVectorFormVol : public VectorFormVol<Scalar>
+      {
+      public:
+        ExpressionVectorFormVol(int i, std::string expression, std::map<std::string, Scalar> parameters = std::map<std::string, Scalar>(),
+          Hermes::vector<std::string> ext_names = Hermes::vector<std::string>(), std::string area = HERMES_ANY);
+
+        ExpressionVectorFormVol(int i, std::string expression, std::map<std::string, Scalar> parameters,
+          Hermes::vector<std::string> ext_names, Hermes::vector<std::string> areas);
+
+        virtual Scalar value(int n, double *wt, Func<Scalar> *u_ext[], Func<double> *v,
+          Geom<double> *e, Func<Scalar> **ext) const;
+
+        virtual bool get_point_fluxes(int n, Func<Scalar> *u_ext[], Geom<double> *e, Func<Scalar> **ext,
+          Scalar* f_val, Scalar* f_dx, Scalar* f_dy) const;
+
+        virtual bool get_order_formula(int& u_coefficient, int& v_coefficient, int& ext_coefficient, int& increase) const;
+
+        virtual Hermes::Ord ord(int n, double *wt, Func<Hermes::Ord> *u_ext[], Func<Hermes::Ord> *v,
+          Geom<Hermes::Ord> *e, Func<Ord> **ext) const;
+
+        virtual VectorFormVol<Scalar>* clone() const;
+
+      private:
+        CompiledExpression<Scalar> compiled;
+      };
+    }
+  }
+}
+#endif
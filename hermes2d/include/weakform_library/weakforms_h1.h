@@ -48,6 +48,16 @@ namespace Hermes
         virtual Scalar value(int n, double *wt, Func<Scalar> *u_ext[], Func<double> *u, Func<double> *v,
           Geom<double> *e, Func<Scalar> **ext) const;
 
+        virtual bool value_all(int n, double *wt, Func<Scalar> *u_ext[], int u_count, Func<double> **u, int v_count, Func<double> **v,
+          Geom<double> *e, Func<Scalar> **ext, Scalar **local_matrix) const;
+
+        virtual bool get_constant_coefficients(Scalar& mass_coefficient, Scalar& diffusion_coefficient) const;
+
+        virtual bool get_point_coefficients(int n, Func<Scalar> *u_ext[], Geom<double> *e, Func<Scalar> **ext,
+          Scalar* mass, Scalar* diffusion) const;
+
+        virtual bool get_order_formula(int& u_coefficient, int& v_coefficient, int& ext_coefficient, int& increase) const;
+
         virtual Hermes::Ord ord(int n, double *wt, Func<Hermes::Ord> *u_ext[], Func<Hermes::Ord> *u,
           Func<Hermes::Ord> *v, Geom<Hermes::Ord> *e, Func<Ord> **ext) const;
 
@@ -80,6 +90,16 @@ namespace Hermes
         virtual Scalar value(int n, double *wt, Func<Scalar> *u_ext[], Func<double> *u,
           Func<double> *v, Geom<double> *e, Func<Scalar> **ext) const;
 
+        virtual bool value_all(int n, double *wt, Func<Scalar> *u_ext[], int u_count, Func<double> **u, int v_count, Func<double> **v,
+          Geom<double> *e, Func<Scalar> **ext, Scalar **local_matrix) const;
+
+        virtual bool get_constant_coefficients(Scalar& mass_coefficient, Scalar& diffusion_coefficient) const;
+
+        virtual bool get_order_formula(int& u_coefficient, int& v_coefficient, int& ext_coefficient, int& increase) const;
+
+        virtual bool get_point_coefficients(int n, Func<Scalar> *u_ext[], Geom<double> *e, Func<Scalar> **ext,
+          Scalar* mass, Scalar* diffusion) const;
+
         virtual Hermes::Ord ord(int n, double *wt, Func<Hermes::Ord> *u_ext[], Func<Hermes::Ord> *u, Func<Hermes::Ord> *v,
           Geom<Hermes::Ord> *e, Func<Ord> **ext) const;
 
@@ -107,6 +127,16 @@ namespace Hermes
         virtual Scalar value(int n, double *wt, Func<Scalar> *u_ext[], Func<double> *u,
           Func<double> *v, Geom<double> *e, Func<Scalar> **ext) const;
 
+        virtual bool value_all(int n, double *wt, Func<Scalar> *u_ext[], int u_count, Func<double> **u, int v_count, Func<double> **v,
+          Geom<double> *e, Func<Scalar> **ext, Scalar **local_matrix) const;
+
+        virtual bool get_constant_coefficients(Scalar& mass_coefficient, Scalar& diffusion_coefficient) const;
+
+        virtual bool get_order_formula(int& u_coefficient, int& v_coefficient, int& ext_coefficient, int& increase) const;
+
+        virtual bool get_point_coefficients(int n, Func<Scalar> *u_ext[], Geom<double> *e, Func<Scalar> **ext,
+          Scalar* mass, Scalar* diffusion) const;
+
         virtual Hermes::Ord ord(int n, double *wt, Func<Hermes::Ord> *u_ext[], Func<Hermes::Ord> *u, Func<Hermes::Ord> *v,
           Geom<Hermes::Ord> *e, Func<Ord> **ext) const;
 
@@ -174,9 +204,14 @@ namespace Hermes
         virtual Scalar value(int n, double *wt, Func<Scalar> *u_ext[], Func<double> *v,
           Geom<double> *e, Func<Scalar> **ext) const;
 
+        virtual bool get_point_fluxes(int n, Func<Scalar> *u_ext[], Geom<double> *e, Func<Scalar> **ext,
+          Scalar* f_val, Scalar* f_dx, Scalar* f_dy) const;
+
         virtual Hermes::Ord ord(int n, double *wt, Func<Hermes::Ord> *u_ext[], Func<Hermes::Ord> *v,
           Geom<Hermes::Ord> *e, Func<Ord> **ext) const;
 
+        virtual bool get_order_formula(int& u_coefficient, int& v_coefficient, int& ext_coefficient, int& increase) const;
+
         virtual VectorFormVol<Scalar>* clone() const;
 
       private:
@@ -204,6 +239,9 @@ namespace Hermes
         virtual Scalar value(int n, double *wt, Func<Scalar> *u_ext[], Func<double> *v,
           Geom<double> *e, Func<Scalar> **ext) const;
 
+        virtual bool get_point_fluxes(int n, Func<Scalar> *u_ext[], Geom<double> *e, Func<Scalar> **ext,
+          Scalar* f_val, Scalar* f_dx, Scalar* f_dy) const;
+
         virtual Hermes::Ord ord(int n, double *wt, Func<Hermes::Ord> *u_ext[], Func<Hermes::Ord> *v,
           Geom<Hermes::Ord> *e, Func<Ord> **ext) const;
 
@@ -237,6 +275,9 @@ namespace Hermes
         virtual Scalar value(int n, double *wt, Func<Scalar> *u_ext[], Func<double> *v,
           Geom<double> *e, Func<Scalar> **ext) const;
 
+        virtual bool get_point_fluxes(int n, Func<Scalar> *u_ext[], Geom<double> *e, Func<Scalar> **ext,
+          Scalar* f_val, Scalar* f_dx, Scalar* f_dy) const;
+
         virtual Hermes::Ord ord(int n, double *wt, Func<Hermes::Ord> *u_ext[], Func<Hermes::Ord> *v,
           Geom<Hermes::Ord> *e, Func<Ord> **ext) const;
 
@@ -305,6 +346,8 @@ namespace Hermes
         virtual Hermes::Ord ord(int n, double *wt, Func<Hermes::Ord> *u_ext[], Func<Hermes::Ord> *u,
           Func<Hermes::Ord> *v, Geom<Hermes::Ord> *e, Func<Ord> **ext) const;
 
+        virtual bool get_order_formula(int& u_coefficient, int& v_coefficient, int& ext_coefficient, int& increase) const;
+
         virtual MatrixFormSurf<Scalar>* clone() const;
 
       private:
@@ -366,6 +409,8 @@ namespace Hermes
         virtual Hermes::Ord ord(int n, double *wt, Func<Hermes::Ord> *u_ext[], Func<Hermes::Ord> *v,
           Geom<Hermes::Ord> *e, Func<Ord> **ext) const;
 
+        virtual bool get_order_formula(int& u_coefficient, int& v_coefficient, int& ext_coefficient, int& increase) const;
+
         virtual VectorFormSurf<Scalar>* clone() const;
 
       private:
@@ -48,6 +48,9 @@ namespace Hermes
         virtual Scalar value(int n, double *wt, Func<Scalar> *u_ext[], Func<double> *u,
           Func<double> *v, Geom<double> *e, Func<Scalar> **ext) const;
 
+        virtual bool value_all(int n, double *wt, Func<Scalar> *u_ext[], int u_count, Func<double> **u, int v_count, Func<double> **v,
+          Geom<double> *e, Func<Scalar> **ext, Scalar **local_matrix) const;
+
         virtual Hermes::Ord ord(int n, double *wt, Func<Hermes::Ord> *u_ext[], Func<Hermes::Ord> *u, Func<Hermes::Ord> *v,
           Geom<Hermes::Ord> *e, Func<Ord> **ext) const;
 
@@ -81,6 +84,9 @@ namespace Hermes
         virtual Scalar value(int n, double *wt, Func<Scalar> *u_ext[], Func<double> *u,
           Func<double> *v, Geom<double> *e, Func<Scalar> **ext) const;
 
+        virtual bool value_all(int n, double *wt, Func<Scalar> *u_ext[], int u_count, Func<double> **u, int v_count, Func<double> **v,
+          Geom<double> *e, Func<Scalar> **ext, Scalar **local_matrix) const;
+
         virtual Hermes::Ord ord(int n, double *wt, Func<Hermes::Ord> *u_ext[], Func<Hermes::Ord> *u, Func<Hermes::Ord> *v,
           Geom<Hermes::Ord> *e, Func<Ord> **ext) const;
 
@@ -0,0 +1,165 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef __H2D_INTEGRAND_WEAK_FORMS_H
+#define __H2D_INTEGRAND_WEAK_FORMS_H
+
+#include "../forms.h"
+#include "../weakform/weakform.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    /// \brief Forms given by one integrand for both the values and the integration orders.
+    ///
+    /// The integrand is a functor with a member template
+    /// template<typename Real, typename Scalar> Scalar operator()(int n, double *wt, Func<Scalar> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, Func<Scalar> **ext) const
+    /// (without u for the vector forms), e.g. returning int_grad_u_grad_v<Real, Scalar>(n, wt, u, v).
+    /// value() instantiates it for <double, Scalar>, ord() for <Hermes::Ord, Hermes::Ord>, with the (inline) arithmetics
+    /// of Hermes::Ord the order is then calculated by the code the compiler generates from the same expression,
+    /// no separate ord() is written. The orders are calculated once per combination of the element orders (see DiscreteProblem::calc_order_form()),
+    /// forms with orders known in advance can still declare them by Form::set_order_formula().
+    /// The integrand is copied into the clones of the form for the threads, so it must not keep any state changed by the evaluation.
+    namespace WeakFormsIntegrand
+    {
+      template<typename Scalar, typename Integrand>
+      class IntegrandMatrixFormVol : public MatrixFormVol<Scalar>
+      {
+      public:
+        IntegrandMatrixFormVol(int i, int j, const Integrand& integrand = Integrand(), std::string area = HERMES_ANY, SymFlag sym = HERMES_NONSYM)
+          : MatrixFormVol<Scalar>(i, j), integrand(integrand)
+        {
+          this->set_area(area);
+          this->setSymFlag(sym);
+        }
+
+        virtual Scalar value(int n, double *wt, Func<Scalar> *u_ext[], Func<double> *u, Func<double> *v,
+          Geom<double> *e, Func<Scalar> **ext) const
+        {
+          return integrand.template operator()<double, Scalar>(n, wt, u_ext, u, v, e, ext);
+        }
+
+        virtual Hermes::Ord ord(int n, double *wt, Func<Hermes::Ord> *u_ext[], Func<Hermes::Ord> *u, Func<Hermes::Ord> *v,
+          Geom<Hermes::Ord> *e, Func<Ord> **ext) const
+        {
+          return integrand.template operator()<Hermes::Ord, Hermes::Ord>(n, wt, u_ext, u, v, e, ext);
+        }
+
+        virtual MatrixFormVol<Scalar>* clone() const
+        {
+          return new IntegrandMatrixFormVol<Scalar, Integrand>(*this);
+        }
+
+      protected:
+        Integrand integrand;
+      };
+
+      template<typename Scalar, typename Integrand>
+      class IntegrandMatrixFormSurf : public MatrixFormSurf<Scalar>
+      {
+      public:
+        IntegrandMatrixFormSurf(int i, int j, const Integrand& integrand = Integrand(), std::string area = HERMES_ANY)
+          : MatrixFormSurf<Scalar>(i, j), integrand(integrand)
+        {
+          this->set_area(area);
+        }
+
+        virtual Scalar value(int n, double *wt, Func<Scalar> *u_ext[], Func<double> *u, Func<double> *v,
+          Geom<double> *e, Func<Scalar> **ext) const
+        {
+          return integrand.template operator()<double, Scalar>(n, wt, u_ext, u, v, e, ext);
+        }
+
+        virtual Hermes::Ord ord(int n, double *wt, Func<Hermes::Ord> *u_ext[], Func<Hermes::Ord> *u, Func<Hermes::Ord> *v,
+          Geom<Hermes::Ord> *e, Func<Ord> **ext) const
+        {
+          return integrand.template operator()<Hermes::Ord, Hermes::Ord>(n, wt, u_ext, u, v, e, ext);
+        }
+
+        virtual MatrixFormSurf<Scalar>* clone() const
+        {
+          return new IntegrandMatrixFormSurf<Scalar, Integrand>(*this);
+        }
+
+      protected:
+        Integrand integrand;
+      };
+
+      template<typename Scalar, typename Integrand>
+      class IntegrandVectorFormVol : public VectorFormVol<Scalar>
+      {
+      public:
+        IntegrandVectorFormVol(int i, const Integrand& integrand = Integrand(), std::string area = HERMES_ANY)
+          : VectorFormVol<Scalar>(i), integrand(integrand)
+        {
+          this->set_area(area);
+        }
+
+        virtual Scalar value(int n, double *wt, Func<Scalar> *u_ext[], Func<double> *v,
+          Geom<double> *e, Func<Scalar> **ext) const
+        {
+          return integrand.template operator()<double, Scalar>(n, wt, u_ext, v, e, ext);
+        }
+
+        virtual Hermes::Ord ord(int n, double *wt, Func<Hermes::Ord> *u_ext[], Func<Hermes::Ord> *v, Geom<Hermes::Ord> *e,
+          Func<Ord> **ext) const
+        {
+          return integrand.template operator()<Hermes::Ord, Hermes::Ord>(n, wt, u_ext, v, e, ext);
+        }
+
+        virtual VectorFormVol<Scalar>* clone() const
+        {
+          return new IntegrandVectorFormVol<Scalar, Integrand>(*this);
+        }
+
+      protected:
+        Integrand integrand;
+      };
+
+      template<typename Scalar, typename Integrand>
+      class IntegrandVectorFormSurf : public VectorFormSurf<Scalar>
+      {
+      public:
+        IntegrandVectorFormSurf(int i, const Integrand& integrand = Integrand(), std::string area = HERMES_ANY)
+          : VectorFormSurf<Scalar>(i), integrand(integrand)
+        {
+          this->set_area(area);
+        }
+
+        virtual Scalar value(int n, double *wt, Func<Scalar> *u_ext[], Func<double> *v,
+          Geom<double> *e, Func<Scalar> **ext) const
+        {
+          return integrand.template operator()<double, Scalar>(n, wt, u_ext, v, e, ext);
+        }
+
+        virtual Hermes::Ord ord(int n, double *wt, Func<Hermes::Ord> *u_ext[], Func<Hermes::Ord> *v, Geom<Hermes::Ord> *e,
+          Func<Ord> **ext) const
+        {
+          return integrand.template operator()<Hermes::Ord, Hermes::Ord>(n, wt, u_ext, v, e, ext);
+        }
+
+        virtual VectorFormSurf<Scalar>* clone() const
+        {
+          return new IntegrandVectorFormSurf<Scalar, Integrand>(*this);
+        }
+
+      protected:
+        Integrand integrand;
+      };
+    }
+  }
+}
+#endif
@@ -915,7 +915,7 @@ namespace Hermes
                   return new OuterIterationForm(*this);
                 }
 
-                void update_keff(double new_keff) { keff = new_keff; }
+                void update_keff(double new_keff) { keff = new_keff; if(this->wf != NULL) this->wf->set_modified(); }
 
               private:
 
@@ -1163,6 +1163,64 @@ namespace Hermes
                 unsigned int g;
               };
             };
+
+            struct HERMES_API Multigroup
+            {
+              /// All the G x G blocks of the Jacobian of the multigroup diffusion equations - DiffusionReaction::Jacobian,
+              /// Scattering::Jacobian and (optionally) FissionYield::Jacobian of all the groups - as one form.
+              /// The coefficients of all the blocks are looked up once per element in a table by the internal element markers,
+              /// made from the material properties in the constructor, and the products of every pair of functions are
+              /// integrated once for all the groups, instead of G^2 forms looking up the materials by name for every pair.
+              template<typename Scalar>
+              class HERMES_API Jacobian : public MatrixFormVolBlock<Scalar>, protected GenericForm
+              {
+              public:
+                /// @param[in] fission Include the fission yield (the fixed source problems), not for the source iteration.
+                Jacobian(const MaterialPropertyMaps& matprop, Mesh *mesh, bool fission, GeomType geom_type = HERMES_PLANAR);
+
+                virtual bool has_block(unsigned int bi, unsigned int bj) const;
+
+                virtual Scalar value_block(unsigned int bi, unsigned int bj, int n, double *wt, Func<Scalar> *u_ext[], Func<double> *u,
+                  Func<double> *v, Geom<double> *e, Func<Scalar> **ext) const;
+
+                virtual bool value_all_blocks(int n, double *wt, Func<Scalar> *u_ext[], const int* u_counts, Func<double> ***u, const int* v_counts, Func<double> ***v,
+                  Geom<double> *e, Func<Scalar> **ext, Scalar **local_matrix) const;
+
+                virtual Hermes::Ord ord(int n, double *wt, Func<Hermes::Ord> *u_ext[], Func<Hermes::Ord> *u,
+                  Func<Hermes::Ord> *v, Geom<Hermes::Ord> *e, Func<Hermes::Ord> **ext) const;
+
+                virtual MatrixFormVol<Scalar>* clone() const;
+
+              private:
+                /// The coefficients on the elements of one material.
+                struct MarkerCoefficients
+                {
+                  bool valid;
+                  /// D of the groups, the coefficients of (grad u, grad v) in the diagonal blocks.
+                  rank1 D;
+                  /// G x G, row-wise: the coefficients of (u, v) in the blocks [gto, gfrom]
+                  /// (removal minus scattering and fission yield).
+                  rank1 reaction;
+                };
+
+                /// Fills the coefficients of the material of the internal element marker.
+                void calculate_coefficients(int marker, MarkerCoefficients& coefficients) const;
+
+                /// The coefficients of the internal element marker, from the table or (for markers not in the table)
+                /// calculated into local_coefficients.
+                const MarkerCoefficients& get_coefficients(int marker, MarkerCoefficients& local_coefficients) const;
+
+                /// Multiplies the weights by the geometry (axisymmetric problems).
+                void weight_geometry(int n, double* wt_geom, Geom<double> *e) const;
+
+                unsigned int G;
+                bool fission;
+                /// Present blocks, G x G row-wise.
+                bool1 blocks_present;
+                /// By the internal element markers of the mesh.
+                std::vector<MarkerCoefficients> marker_coefficients;
+              };
+            };
           }
         }
 
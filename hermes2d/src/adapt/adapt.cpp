@@ -30,14 +30,83 @@ namespace Hermes
 {
   namespace Hermes2D
   {
+    static const char* adapt_profile_phase_names[] =
+    {
+      "error evaluation",
+      "candidate selection",
+      "refinement"
+    };
+
+    ElementErrors::ElementErrors() : index(NULL), index_size(0), count(0), single_precision(false), values(NULL), values_float(NULL)
+    {
+    }
+
+    ElementErrors::~ElementErrors()
+    {
+      free();
+    }
+
+    void ElementErrors::init(const Mesh* mesh, bool single_precision)
+    {
+      free();
+      this->single_precision = single_precision;
+      index_size = mesh->get_max_element_id();
+      index = new int[index_size];
+      for(int i = 0; i < index_size; i++)
+        index[i] = -1;
+      count = 0;
+      Element* e;
+      for_all_active_elements(e, mesh)
+        index[e->id] = count++;
+      if(single_precision)
+      {
+        values_float = new float[count];
+        memset(values_float, 0, count * sizeof(float));
+      }
+      else
+      {
+        values = new double[count];
+        memset(values, 0, count * sizeof(double));
+      }
+    }
+
+    void ElementErrors::free()
+    {
+      delete [] index;
+      delete [] values;
+      delete [] values_float;
+      index = NULL;
+      values = NULL;
+      values_float = NULL;
+      index_size = count = 0;
+    }
+
+    void ElementErrors::swap(ElementErrors& other)
+    {
+      std::swap(index, other.index);
+      std::swap(index_size, other.index_size);
+      std::swap(count, other.count);
+      std::swap(single_precision, other.single_precision);
+      std::swap(values, other.values);
+      std::swap(values_float, other.values_float);
+    }
+
+    size_t ElementErrors::get_memory_size() const
+    {
+      return index_size * sizeof(int) + count * (single_precision ? sizeof(float) : sizeof(double));
+    }
+
     template<typename Scalar>
     Adapt<Scalar>::Adapt(Hermes::vector<Space<Scalar>*> spaces,
       Hermes::vector<ProjNormType> proj_norms) :
-    spaces(spaces),
+    regular_queue_sorted(0),
+      spaces(spaces),
       num_act_elems(-1),
       have_errors(false),
       have_coarse_solutions(false),
-      have_reference_solutions(false)
+      have_reference_solutions(false),
+      profile(PROFILE_NUM_PHASES, adapt_profile_phase_names, "adaptivity"),
+      single_precision_errors(false)
     {
       // sanity check
       if(proj_norms.size() > 0 && spaces.size() != proj_norms.size())
@@ -49,7 +118,6 @@ namespace Hermes
       if((this->num <= 0) || (this->num > H2D_MAX_COMPONENTS)) throw Exceptions::ValueException("components", this->num, 0, H2D_MAX_COMPONENTS);
 
       // reset values
-      memset(errors, 0, sizeof(errors));
       memset(sln, 0, sizeof(sln));
       memset(rsln, 0, sizeof(rsln));
       own_forms = new bool*[H2D_MAX_COMPONENTS];
@@ -92,13 +160,22 @@ namespace Hermes
         }
     }
 
+    template<typename Scalar>
+    Hermes::Mixins::Profile* Adapt<Scalar>::get_profile()
+    {
+      return &this->profile;
+    }
+
     template<typename Scalar>
     Adapt<Scalar>::Adapt(Space<Scalar>* space, ProjNormType proj_norm) :
-    spaces(Hermes::vector<Space<Scalar>*>()),
+    regular_queue_sorted(0),
+      spaces(Hermes::vector<Space<Scalar>*>()),
       num_act_elems(-1),
       have_errors(false),
       have_coarse_solutions(false),
-      have_reference_solutions(false)
+      have_reference_solutions(false),
+      profile(PROFILE_NUM_PHASES, adapt_profile_phase_names, "adaptivity"),
+      single_precision_errors(false)
     {
       if(space == NULL) throw Exceptions::NullException(1);
       spaces.push_back(space);
@@ -106,7 +183,6 @@ namespace Hermes
       this->num = 1;
 
       // reset values
-      memset(errors, 0, sizeof(errors));
       memset(sln, 0, sizeof(sln));
       memset(rsln, 0, sizeof(rsln));
       own_forms = new bool*[H2D_MAX_COMPONENTS];
@@ -139,9 +215,6 @@ namespace Hermes
     template<typename Scalar>
     Adapt<Scalar>::~Adapt()
     {
-      for (int i = 0; i < this->num; i++)
-        delete [] errors[i];
-
       for (int i = 0; i < this->num; i++)
         for (int j = 0; j < this->num; j++)
           if(error_form[i][j] != NULL && own_forms[i][j])
@@ -214,6 +287,41 @@ namespace Hermes
       bool first_regular_element = true; // true if first regular element was not processed yet
       bool error_level_reached = false;
 
+      // Select the elements the strategy is expected to examine, the rest of the queue is ordered only if the loop gets there.
+      if(regular_queue_sorted >= 0 && regular_queue_sorted < (int)regular_queue.size())
+      {
+        int queue_size = (int)regular_queue.size();
+        int initial_count;
+        if(strat == 0)
+          initial_count = std::max(64, queue_size / 32);
+        else
+        {
+          int num_threads_used = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
+          int i;
+          double max_error_squared = 0.0;
+          if(strat != 2)
+          {
+#pragma omp parallel num_threads(num_threads_used) private(i)
+            {
+              double thread_max_error_squared = 0.0;
+#pragma omp for schedule(static)
+              for(i = 0; i < queue_size; i++)
+                thread_max_error_squared = std::max(thread_max_error_squared, errors[regular_queue[i].comp].get(regular_queue[i].id));
+#pragma omp critical (adapt_max_error)
+              max_error_squared = std::max(max_error_squared, thread_max_error_squared);
+            }
+          }
+          double selection_threshold = (strat == 2) ? thr : thr * max_error_squared;
+          int above_threshold = 0;
+#pragma omp parallel for num_threads(num_threads_used) schedule(static) reduction(+:above_threshold)
+          for(i = 0; i < queue_size; i++)
+            if(errors[regular_queue[i].comp].get(regular_queue[i].id) >= selection_threshold)
+              above_threshold++;
+          initial_count = above_threshold + 1;
+        }
+        sort_regular_queue(initial_count);
+      }
+
       for(int inx_regular_element = 0; inx_regular_element < num_act_elems || !priority_queue.empty();)
       {
         int id, comp;
@@ -221,12 +329,14 @@ namespace Hermes
         // Process the queuse(s) to see what elements to really refine.
         if(priority_queue.empty())
         {
+          if(inx_regular_element >= regular_queue_sorted)
+            sort_regular_queue(2 * inx_regular_element + 64);
           id = regular_queue[inx_regular_element].id;
           comp = regular_queue[inx_regular_element].comp;
           inx_regular_element++;
 
           // Get info linked with the element
-          double err_squared = errors[comp][id];
+          double err_squared = errors[comp].get(id);
 
           if(first_regular_element)
           {
@@ -302,6 +412,13 @@ namespace Hermes
             global_refinement_selectors[i][j] = refinement_selectors[j]->clone();
             if(dynamic_cast<RefinementSelectors::ProjBasedSelector<Scalar>*>(global_refinement_selectors[i][j]) != NULL)
             {
+              // The clone shares the caches of the original selector, so the shape values and the projection matrices are calculated only once.
+              RefinementSelectors::ProjBasedSelector<Scalar>* clone = dynamic_cast<RefinementSelectors::ProjBasedSelector<Scalar>*>(global_refinement_selectors[i][j]);
+              delete [] clone->cached_shape_vals_valid;
+              delete [] clone->cached_shape_ortho_vals;
+              delete [] clone->cached_shape_vals;
+              delete [] clone->proj_matrix_cache;
+              clone->proj_matrix_cache = dynamic_cast<RefinementSelectors::ProjBasedSelector<Scalar>*>(refinement_selectors[j])->proj_matrix_cache;
               dynamic_cast<RefinementSelectors::ProjBasedSelector<Scalar>*>(global_refinement_selectors[i][j])->cached_shape_vals_valid = dynamic_cast<RefinementSelectors::ProjBasedSelector<Scalar>*>(refinement_selectors[j])->cached_shape_vals_valid;
               dynamic_cast<RefinementSelectors::ProjBasedSelector<Scalar>*>(global_refinement_selectors[i][j])->cached_shape_ortho_vals = dynamic_cast<RefinementSelectors::ProjBasedSelector<Scalar>*>(refinement_selectors[j])->cached_shape_ortho_vals;
               dynamic_cast<RefinementSelectors::ProjBasedSelector<Scalar>*>(global_refinement_selectors[i][j])->cached_shape_vals = dynamic_cast<RefinementSelectors::ProjBasedSelector<Scalar>*>(refinement_selectors[j])->cached_shape_vals;
@@ -352,7 +469,9 @@ namespace Hermes
             ElementToRefine elem_ref(ids[id_to_refine], components[id_to_refine]);
 
             // rsln[comp] may be unset if refinement_selectors[comp] == HOnlySelector or POnlySelector
+            Hermes::Mixins::Profile::Section selection_section(&this->profile, PROFILE_CANDIDATE_SELECTION);
             bool refined = current_refinement_selectors[components[id_to_refine]]->select_refinement(meshes[components[id_to_refine]]->get_element(ids[id_to_refine]), current_orders[id_to_refine], current_rslns[components[id_to_refine]], elem_ref);
+            selection_section.stop();
             
 #pragma omp critical (number_of_candidates)
 						{
@@ -426,6 +545,7 @@ namespace Hermes
         throw *(this->caughtException);
       
       //apply refinements
+      Hermes::Mixins::Profile::Section refinement_section(&this->profile, PROFILE_REFINEMENT);
       apply_refinements(elem_inx_to_proc);
 
       // in singlemesh case, impose same orders across meshes
@@ -462,6 +582,7 @@ namespace Hermes
       // since space changed, assign dofs:
       for(unsigned int i = 0; i < this->spaces.size(); i++)
         this->spaces[i]->assign_dofs();
+      refinement_section.stop();
 
       for (int i = 0; i < this->num; i++)
       {
@@ -666,10 +787,10 @@ namespace Hermes
         OGProjection<Scalar> ogProjection;
         typename Mesh::ReferenceMeshCreator ref_mesh_creator(this->spaces[i]->get_mesh());
         ref_meshes[i] = ref_mesh_creator.create_ref_mesh();
-        typename Space<Scalar>::ReferenceSpaceCreator ref_space_creator(this->spaces[i], ref_mesh_creator.create_ref_mesh(), 0);
+        typename Space<Scalar>::ReferenceSpaceCreator ref_space_creator(this->spaces[i], ref_meshes[i], 0);
         ref_spaces[i] = ref_space_creator.create_ref_space();
         ref_slns_local.push_back(new Solution<Scalar>);
-        ogProjection.project_global(ref_space_creator.create_ref_space(), rslns[i], ref_slns_local.back());
+        ogProjection.project_global(ref_spaces[i], rslns[i], ref_slns_local.back());
       }
       double result = calc_err_internal(slns, ref_slns_local, component_errors, solutions_for_adapt, error_flags);
       for(unsigned int i = 0; i < num; i++)
@@ -695,6 +816,124 @@ namespace Hermes
       return adapt(refinement_selectors, thr, strat, regularize, to_be_processed);
     }
 
+    template<typename Scalar>
+    int Adapt<Scalar>::coarsen(double thr, bool p_coarsening)
+    {
+      if(!have_errors)
+        throw Exceptions::Exception("element errors have to be calculated first, call Adapt<Scalar>::calc_err_est().");
+
+      double max_error_squared = 0.0;
+      for (int i = 0; i < this->regular_queue.size(); i++)
+        max_error_squared = std::max(max_error_squared, errors[regular_queue[i].comp].get(regular_queue[i].id));
+      double threshold = thr * max_error_squared;
+
+      int coarsened = 0;
+      Element* e;
+      for (int i = 0; i < this->num; i++)
+      {
+        Mesh* mesh = this->spaces[i]->get_mesh();
+
+        // Each mesh is processed with the first component on it, the merge has to suit all of them.
+        bool first_on_mesh = true;
+        for (int j = 0; j < i; j++)
+          if(this->spaces[j]->get_mesh() == mesh)
+            first_on_mesh = false;
+        if(!first_on_mesh)
+          continue;
+        Hermes::vector<int> components;
+        for (int j = i; j < this->num; j++)
+          if(this->spaces[j]->get_mesh() == mesh)
+            components.push_back(j);
+
+        // Find the refined elements with active sons of small errors.
+        Hermes::vector<int> to_merge;
+        for_all_inactive_elements(e, mesh)
+        {
+          bool mergeable = true;
+          for (unsigned int son = 0; son < 4 && mergeable; son++)
+            if(e->sons[son] != NULL && (!e->sons[son]->active || e->sons[son]->id < mesh->ninitial))
+              mergeable = false;
+          for (unsigned int comp_i = 0; comp_i < components.size() && mergeable; comp_i++)
+          {
+            double sons_error_squared = 0.0;
+            for (unsigned int son = 0; son < 4; son++)
+              if(e->sons[son] != NULL)
+                sons_error_squared += errors[components[comp_i]].get(e->sons[son]->id);
+            if(sons_error_squared >= threshold)
+              mergeable = false;
+          }
+          if(mergeable)
+            to_merge.push_back(e->id);
+        }
+
+        // The merged elements get the largest orders of their sons.
+        std::vector<bool> merged(mesh->get_max_element_id(), false);
+        for (unsigned int merge_i = 0; merge_i < to_merge.size(); merge_i++)
+        {
+          e = mesh->get_element_fast(to_merge[merge_i]);
+          merged[e->id] = true;
+          for (unsigned int comp_i = 0; comp_i < components.size(); comp_i++)
+          {
+            Space<Scalar>* space = this->spaces[components[comp_i]];
+            int h_order = 0, v_order = 0;
+            for (unsigned int son = 0; son < 4; son++)
+              if(e->sons[son] != NULL)
+              {
+                int son_order = space->get_element_order(e->sons[son]->id);
+                if(e->sons[son]->is_triangle())
+                {
+                  h_order = std::max(h_order, son_order);
+                  v_order = std::max(v_order, son_order);
+                }
+                else
+                {
+                  h_order = std::max(h_order, H2D_GET_H_ORDER(son_order));
+                  v_order = std::max(v_order, H2D_GET_V_ORDER(son_order));
+                }
+              }
+            space->set_element_order_internal(e->id, e->is_triangle() ? std::max(h_order, v_order) : H2D_MAKE_QUAD_ORDER(h_order, v_order));
+          }
+          mesh->unrefine_element_id(e->id);
+          for (unsigned int comp_i = 0; comp_i < components.size(); comp_i++)
+            this->spaces[components[comp_i]]->edata[e->id].changed_in_last_adaptation = true;
+        }
+        coarsened += to_merge.size();
+
+        if(!p_coarsening)
+          continue;
+
+        // Decrease the orders of the remaining elements with small errors (the merged ones have no errors yet).
+        for (unsigned int comp_i = 0; comp_i < components.size(); comp_i++)
+        {
+          Space<Scalar>* space = this->spaces[components[comp_i]];
+          int min_order = (space->get_type() == HERMES_H1_SPACE) ? 1 : 0;
+          for_all_active_elements(e, mesh)
+          {
+            if(merged[e->id] || errors[components[comp_i]].get(e->id) >= threshold)
+              continue;
+            int order = space->get_element_order(e->id);
+            int new_order;
+            if(e->is_triangle())
+              new_order = std::max(min_order, order - 1);
+            else
+              new_order = H2D_MAKE_QUAD_ORDER(std::max(min_order, H2D_GET_H_ORDER(order) - 1), std::max(min_order, H2D_GET_V_ORDER(order) - 1));
+            if(new_order == order)
+              continue;
+            space->set_element_order_internal(e->id, new_order);
+            space->edata[e->id].changed_in_last_adaptation = true;
+            coarsened++;
+          }
+        }
+      }
+
+      have_errors = false;
+      for (int i = 0; i < this->num; i++)
+        this->spaces[i]->assign_dofs();
+
+      this->info("Adaptivity: coarsened %i elements.", coarsened);
+      return coarsened;
+    }
+
     template<typename Scalar>
     void Adapt<Scalar>::fix_shared_mesh_refinements(Mesh** meshes, std::vector<ElementToRefine>& elems_to_refine,
       int** idx, RefinementSelectors::Selector<Scalar> *** refinement_selectors)
@@ -777,7 +1016,9 @@ namespace Hermes
     {
       if(!have_errors)
         throw Exceptions::Exception("element errors have to be calculated first, call Adapt<Scalar>::calc_err_est().");
-      return errors[component][id];
+      if(!errors[component].contains(id))
+        return 0.0;
+      return errors[component].get(id);
     };
 
     template<typename Scalar>
@@ -819,9 +1060,61 @@ namespace Hermes
     template<typename Scalar>
     void Adapt<Scalar>::apply_refinements(std::vector<ElementToRefine>& elems_to_refine)
     {
-      for (std::vector<ElementToRefine>::const_iterator elem_ref = elems_to_refine.begin();
-        elem_ref != elems_to_refine.end(); elem_ref++)
-        apply_refinement(*elem_ref);
+      // Group the refinements by the refined mesh.
+      Hermes::vector<Mesh*> group_meshes;
+      std::vector<std::vector<int> > groups;
+      bool curved = false;
+      for (int i = 0; i < (int)elems_to_refine.size(); i++)
+      {
+        Mesh* mesh = this->spaces[elems_to_refine[i].comp]->get_mesh();
+        if(mesh->get_element(elems_to_refine[i].id)->is_curved())
+          curved = true;
+        int group = 0;
+        while(group < (int)group_meshes.size() && group_meshes[group] != mesh)
+          group++;
+        if(group == (int)group_meshes.size())
+        {
+          group_meshes.push_back(mesh);
+          groups.push_back(std::vector<int>());
+        }
+        groups[group].push_back(i);
+      }
+
+      int num_threads_used = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
+      if(groups.size() < 2 || curved || num_threads_used < 2)
+      {
+        for (std::vector<ElementToRefine>::const_iterator elem_ref = elems_to_refine.begin();
+          elem_ref != elems_to_refine.end(); elem_ref++)
+          apply_refinement(*elem_ref);
+        return;
+      }
+
+      int group_i;
+      int groups_count = (int)groups.size();
+#pragma omp parallel for num_threads(std::min(num_threads_used, groups_count)) schedule(dynamic, 1) private(group_i)
+      for(group_i = 0; group_i < groups_count; group_i++)
+      {
+        try
+        {
+          for (int i = 0; i < (int)groups[group_i].size(); i++)
+            apply_refinement(elems_to_refine[groups[group_i][i]]);
+        }
+        catch(Hermes::Exceptions::Exception& exception)
+        {
+#pragma omp critical (apply_refinements_exception)
+          if(this->caughtException == NULL)
+            this->caughtException = exception.clone();
+        }
+        catch(std::exception& exception)
+        {
+#pragma omp critical (apply_refinements_exception)
+          if(this->caughtException == NULL)
+            this->caughtException = new Hermes::Exceptions::Exception(exception.what());
+        }
+      }
+
+      if(this->caughtException != NULL)
+        throw *(this->caughtException);
     }
 
     template<typename Scalar>
@@ -900,6 +1193,12 @@ namespace Hermes
       set_norm_form(0, 0, form);
     }
 
+    template<typename Scalar>
+    void Adapt<Scalar>::set_single_precision_errors(bool single_precision)
+    {
+      single_precision_errors = single_precision;
+    }
+
     template<typename Scalar>
     double Adapt<Scalar>::eval_error(typename Adapt<Scalar>::MatrixFormVolError* form,
       MeshFunction<Scalar>*sln1, MeshFunction<Scalar>*sln2, MeshFunction<Scalar>*rsln1,
@@ -1024,10 +1323,113 @@ namespace Hermes
       return std::abs(res);
     }
 
+    template<typename Scalar>
+    int Adapt<Scalar>::calc_error_form_order(typename Adapt<Scalar>::MatrixFormVolError* form, MeshFunction<Scalar>* rsln1, MeshFunction<Scalar>* rsln2)
+    {
+      int inc = (rsln1->get_num_components() == 2) ? 1 : 0;
+      Func<Hermes::Ord>* ou = init_fn_ord(rsln1->get_fn_order() + inc);
+      Func<Hermes::Ord>* ov = init_fn_ord(rsln2->get_fn_order() + inc);
+
+      double fake_wt = 1.0;
+      Geom<Hermes::Ord>* fake_e = init_geom_ord();
+      Hermes::Ord o = form->ord(1, &fake_wt, NULL, ou, ov, fake_e, NULL);
+
+      ou->free_ord(); delete ou;
+      ov->free_ord(); delete ov;
+      delete fake_e;
+
+      return rsln1->get_refmap()->get_inv_ref_order() + o.get_order();
+    }
+
+    template<typename Scalar>
+    void Adapt<Scalar>::eval_errors_and_norms(MeshFunction<Scalar>** slns, MeshFunction<Scalar>** rslns, double* errors_out, double* norms_out)
+    {
+      // One integration order for all the forms.
+      int order = 0;
+      bool exact = false;
+      bool used[H2D_MAX_COMPONENTS];
+      bool row_used[H2D_MAX_COMPONENTS];
+      for (int i = 0; i < num; i++)
+        used[i] = row_used[i] = false;
+      for (int i = 0; i < num; i++)
+      {
+        Solution<Scalar>* rsln_solution = dynamic_cast<Solution<Scalar>*>(rslns[i]);
+        for (int j = 0; j < num; j++)
+        {
+          if(error_form[i][j] == NULL)
+            continue;
+          used[i] = used[j] = row_used[i] = true;
+          if(rsln_solution != NULL && rsln_solution->get_type() == HERMES_EXACT)
+            exact = true;
+          order = std::max(order, calc_error_form_order(error_form[i][j], rslns[i], rslns[j]));
+          order = std::max(order, calc_error_form_order(norm_form[i][j], rslns[i], rslns[j]));
+        }
+      }
+      ElementMode2D mode = slns[0]->get_active_element()->get_mode();
+      if(exact)
+        limit_order_nowarn(order, mode);
+      else
+        limit_order(order, mode);
+
+      Quad2D* quad = slns[0]->get_quad_2d();
+      double3* pt = quad->get_points(order, mode);
+      int np = quad->get_num_points(order, mode);
+
+      // The values of every function and the geometry of every reference map once.
+      Func<Scalar>* err[H2D_MAX_COMPONENTS];
+      Func<Scalar>* v[H2D_MAX_COMPONENTS];
+      Geom<double>* geometry[H2D_MAX_COMPONENTS];
+      double* jwt[H2D_MAX_COMPONENTS];
+      for (int i = 0; i < num; i++)
+      {
+        err[i] = v[i] = NULL;
+        geometry[i] = NULL;
+        jwt[i] = NULL;
+        if(used[i])
+        {
+          v[i] = init_fn(rslns[i], order);
+          err[i] = init_fn(slns[i], order);
+          err[i]->subtract(v[i]);
+        }
+        if(row_used[i])
+        {
+          RefMap* rrv = rslns[i]->get_refmap();
+          geometry[i] = init_geom_vol(rrv, order);
+          double* jac = rrv->get_jacobian(order);
+          jwt[i] = new double[np];
+          for(int k = 0; k < np; k++)
+            jwt[i][k] = pt[k][2] * jac[k];
+        }
+      }
+
+      for (int i = 0; i < num; i++)
+        for (int j = 0; j < num; j++)
+          if(error_form[i][j] != NULL)
+          {
+            errors_out[i * num + j] = std::abs(error_form[i][j]->value(np, jwt[i], NULL, err[i], err[j], geometry[i], NULL));
+            norms_out[i * num + j] = std::abs(norm_form[i][j]->value(np, jwt[i], NULL, v[i], v[j], geometry[i], NULL));
+          }
+
+      for (int i = 0; i < num; i++)
+      {
+        if(used[i])
+        {
+          err[i]->free_fn(); delete err[i];
+          v[i]->free_fn(); delete v[i];
+        }
+        if(row_used[i])
+        {
+          geometry[i]->free(); delete geometry[i];
+          delete [] jwt[i];
+        }
+      }
+    }
+
     template<typename Scalar>
     double Adapt<Scalar>::calc_err_internal(Hermes::vector<Solution<Scalar>*> slns, Hermes::vector<Solution<Scalar>*> rslns,
       Hermes::vector<double>* component_errors, bool solutions_for_adapt, unsigned int error_flags)
     {
+      Hermes::Mixins::Profile::Section error_section(&this->profile, PROFILE_ERROR_EVALUATION);
       int i, j;
       
       bool compatible_meshes = true;
@@ -1086,7 +1488,6 @@ namespace Hermes
       // Prepare multi-mesh traversal and error arrays.
       const Mesh **meshes = new const Mesh *[2 * num];
       Transformable **tr = new Transformable *[2 * num];
-      Traverse trav(true);
       num_act_elems = 0;
       for (i = 0; i < num; i++)
       {
@@ -1097,13 +1498,8 @@ namespace Hermes
 
         num_act_elems += sln[i]->get_mesh()->get_num_active_elements();
 
-        int max = meshes[i]->get_max_element_id();
         if(solutions_for_adapt)
-        {
-          if(errors[i] != NULL) delete [] errors[i];
-          errors[i] = new double[max];
-          memset(errors[i], 0, sizeof(double) * max);
-        }
+          errors[i].init(meshes[i], single_precision_errors);
       }
 
       double total_norm = 0.0;
@@ -1115,9 +1511,112 @@ namespace Hermes
       double total_error = 0.0;
 
       // Calculate error.
-      Traverse::State * ee;
-      trav.begin(2 * num, meshes, tr);
-      while ((ee = trav.get_next_state()) != NULL)
+      traverse_states.update(meshes, 2 * num);
+      int num_states = traverse_states.get_num_states();
+      Traverse::State** states = traverse_states.get_states();
+
+      // Per-thread copies of the solutions, the first thread uses the original ones.
+      int num_threads_used = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
+      MeshFunction<Scalar>*** fns = new MeshFunction<Scalar>**[num_threads_used];
+      Transformable*** trfs = new Transformable**[num_threads_used];
+      fns[0] = new MeshFunction<Scalar>*[2 * num];
+      trfs[0] = tr;
+      for (i = 0; i < num; i++)
+      {
+        fns[0][i] = sln[i];
+        fns[0][i + num] = rsln[i];
+      }
+      int num_threads_cloned = 1;
+      try
+      {
+        for(; num_threads_cloned < num_threads_used; num_threads_cloned++)
+        {
+          fns[num_threads_cloned] = new MeshFunction<Scalar>*[2 * num];
+          memset(fns[num_threads_cloned], 0, 2 * num * sizeof(MeshFunction<Scalar>*));
+          trfs[num_threads_cloned] = new Transformable*[2 * num];
+          for (i = 0; i < 2 * num; i++)
+          {
+            fns[num_threads_cloned][i] = fns[0][i]->clone();
+            fns[num_threads_cloned][i]->set_quad_2d(&g_quad_2d_std);
+            trfs[num_threads_cloned][i] = fns[num_threads_cloned][i];
+          }
+        }
+      }
+      catch(Hermes::Exceptions::Exception& e)
+      {
+        // E.g. exact solutions not overriding clone(), evaluate on a single thread.
+        this->warn("Adapt::calc_err_internal: the solutions could not be cloned (%s), the errors are calculated on a single thread.", e.what());
+        for(int thread_i = 1; thread_i <= num_threads_cloned && thread_i < num_threads_used; thread_i++)
+        {
+          for (i = 0; i < 2 * num; i++)
+            delete fns[thread_i][i];
+          delete [] fns[thread_i];
+          delete [] trfs[thread_i];
+        }
+        num_threads_cloned = 1;
+      }
+      num_threads_used = num_threads_cloned;
+
+      // Contributions of all the states, summed up afterwards in the order of the states
+      // so that the totals do not depend on the number of threads.
+      double* state_errors = new double[std::max(num_states, 1) * num * num];
+      double* state_norms = new double[std::max(num_states, 1) * num * num];
+
+      // Important, sets the current caughtException to NULL.
+      this->caughtException = NULL;
+
+      int state_i;
+#pragma omp parallel shared(states, fns, trfs, state_errors, state_norms) private(state_i, i, j) num_threads(num_threads_used)
+      {
+#pragma omp for schedule(dynamic, CHUNKSIZE)
+        for(state_i = 0; state_i < num_states; state_i++)
+        {
+          if(this->caughtException != NULL)
+            continue;
+          try
+          {
+            MeshFunction<Scalar>** current_fns = fns[omp_get_thread_num()];
+            TraverseStateList::set_active_state(states[state_i], trfs[omp_get_thread_num()]);
+            eval_errors_and_norms(current_fns, current_fns + num, state_errors + state_i * num * num, state_norms + state_i * num * num);
+          }
+          catch(Hermes::Exceptions::Exception& e)
+          {
+#pragma omp critical (caughtException)
+            if(this->caughtException == NULL)
+              this->caughtException = e.clone();
+          }
+          catch(std::exception& e)
+          {
+#pragma omp critical (caughtException)
+            if(this->caughtException == NULL)
+              this->caughtException = new Hermes::Exceptions::Exception(e.what());
+          }
+        }
+      }
+
+      for(int thread_i = 1; thread_i < num_threads_used; thread_i++)
+      {
+        for (i = 0; i < 2 * num; i++)
+          delete fns[thread_i][i];
+        delete [] fns[thread_i];
+        delete [] trfs[thread_i];
+      }
+      delete [] fns[0];
+      delete [] fns;
+      delete [] trfs;
+
+      if(this->caughtException != NULL)
+      {
+        delete [] state_errors;
+        delete [] state_norms;
+        delete [] meshes;
+        delete [] tr;
+        delete [] norms;
+        delete [] errors_components;
+        throw *(this->caughtException);
+      }
+
+      for(state_i = 0; state_i < num_states; state_i++)
       {
         for (i = 0; i < num; i++)
         {
@@ -1125,21 +1624,21 @@ namespace Hermes
           {
             if(error_form[i][j] != NULL)
             {
-              double err, nrm;
-              err = eval_error(error_form[i][j], sln[i], sln[j], rsln[i], rsln[j]);
-              nrm = eval_error_norm(norm_form[i][j], rsln[i], rsln[j]);
+              double err = state_errors[(state_i * num + i) * num + j];
+              double nrm = state_norms[(state_i * num + i) * num + j];
 
               norms[i] += nrm;
               total_norm  += nrm;
               total_error += err;
               errors_components[i] += err;
               if(solutions_for_adapt)
-                this->errors[i][ee->e[i]->id] += err;
+                this->errors[i].add(states[state_i]->e[i]->id, err);
             }
           }
         }
       }
-      trav.finish();
+      delete [] state_errors;
+      delete [] state_norms;
 
       // Store the calculation for each solution component separately.
       if(component_errors != NULL)
@@ -1169,7 +1668,7 @@ namespace Hermes
             Element* e;
             for_all_active_elements(e, meshes[i])
             {
-              errors[i][e->id] /= norms[i];
+              errors[i].set(e->id, errors[i].get(e->id) / norms[i]);
             }
           }
         }
@@ -1186,6 +1685,7 @@ namespace Hermes
       // Prepare an ordered list of elements according to an error.
       if(solutions_for_adapt)
       {
+        regular_queue_sorted = -1;
         fill_regular_queue(meshes);
         have_errors = true;
       }
@@ -1228,14 +1728,14 @@ namespace Hermes
     }
 
     template<typename Scalar>
-    Adapt<Scalar>::CompareElements::CompareElements(double** errors): errors(errors)
+    Adapt<Scalar>::CompareElements::CompareElements(const ElementErrors* errors): errors(errors)
     {
     }
 
     template<typename Scalar>
     bool Adapt<Scalar>::CompareElements::operator()(const ElementReference& e1, const ElementReference& e2) const
     {
-      return errors[e1.comp][e1.id] > errors[e2.comp][e2.id];
+      return errors[e1.comp].get(e1.id) > errors[e2.comp].get(e2.id);
     }
 
     template<typename Scalar>
@@ -1260,8 +1760,26 @@ namespace Hermes
           regular_queue.push_back(ElementReference(e->id, i));
         }
       }
-      //sort
-      std::sort(regular_queue.begin(), regular_queue.end(), CompareElements(errors));
+      // The elements are sorted by sort_regular_queue() as adapt() needs them.
+      regular_queue_sorted = 0;
+    }
+
+    template<typename Scalar>
+    void Adapt<Scalar>::sort_regular_queue(int count)
+    {
+      if(regular_queue_sorted < 0 || count <= regular_queue_sorted)
+        return;
+      if(count > (int)regular_queue.size())
+        count = (int)regular_queue.size();
+      if(count <= regular_queue_sorted)
+        return;
+
+      typename Hermes::vector<ElementReference>::iterator begin = regular_queue.begin() + regular_queue_sorted;
+      typename Hermes::vector<ElementReference>::iterator middle = regular_queue.begin() + count;
+      if(middle != regular_queue.end())
+        std::nth_element(begin, middle, regular_queue.end(), CompareElements(errors));
+      std::sort(begin, middle, CompareElements(errors));
+      regular_queue_sorted = count;
     }
 
     template HERMES_API class Adapt<double>;
@@ -0,0 +1,161 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+#include "goal_oriented_adapt.h"
+#include "api2d.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    template<typename Scalar>
+    GoalOrientedAdapt<Scalar>::GoalOrientedAdapt(Hermes::vector<Space<Scalar>*> spaces, Hermes::vector<ProjNormType> proj_norms) : Adapt<Scalar>(spaces, proj_norms)
+    {
+    }
+
+    template<typename Scalar>
+    GoalOrientedAdapt<Scalar>::GoalOrientedAdapt(Space<Scalar>* space, ProjNormType proj_norm) : Adapt<Scalar>(space, proj_norm)
+    {
+    }
+
+    template<typename Scalar>
+    void GoalOrientedAdapt<Scalar>::solve_adjoint(LinearMatrixSolver<Scalar>* primal_solver, const WeakForm<Scalar>* goal_wf,
+      Hermes::vector<const Space<Scalar>*> ref_spaces, Hermes::vector<Solution<Scalar>*> adjoint_rslns)
+    {
+      if(primal_solver == NULL)
+        throw Exceptions::NullException(1);
+      if(goal_wf == NULL)
+        throw Exceptions::NullException(2);
+      if(adjoint_rslns.size() != ref_spaces.size())
+        throw Exceptions::LengthException(4, adjoint_rslns.size(), ref_spaces.size());
+      int ndof = Space<Scalar>::get_num_dofs(ref_spaces);
+      if(primal_solver->get_matrix_size() != ndof)
+        throw Exceptions::LengthException(1, primal_solver->get_matrix_size(), ndof);
+
+      // The goal functional on the reference spaces.
+      Vector<Scalar>* goal_vector = create_vector<Scalar>();
+      Scalar* adjoint = new Scalar[ndof];
+      bool solved;
+      try
+      {
+        DiscreteProblem<Scalar> dp(goal_wf, ref_spaces);
+        dp.assemble(goal_vector);
+        goal_vector->extract(adjoint);
+        solved = primal_solver->solve_transposed(adjoint, 1);
+      }
+      catch(...)
+      {
+        delete goal_vector;
+        delete [] adjoint;
+        throw;
+      }
+      delete goal_vector;
+      if(!solved)
+      {
+        delete [] adjoint;
+        throw Exceptions::Exception("GoalOrientedAdapt: the adjoint problem could not be solved.");
+      }
+
+      // The adjoint solutions vanish on the Dirichlet boundaries.
+      Hermes::vector<bool> add_dir_lift;
+      for(unsigned int i = 0; i < ref_spaces.size(); i++)
+        add_dir_lift.push_back(false);
+      Solution<Scalar>::vector_to_solutions(adjoint, ref_spaces, adjoint_rslns, add_dir_lift);
+      delete [] adjoint;
+    }
+
+    template<typename Scalar>
+    void GoalOrientedAdapt<Scalar>::solve_adjoint(LinearMatrixSolver<Scalar>* primal_solver, const WeakForm<Scalar>* goal_wf,
+      const Space<Scalar>* ref_space, Solution<Scalar>* adjoint_rsln)
+    {
+      Hermes::vector<const Space<Scalar>*> ref_spaces;
+      ref_spaces.push_back(ref_space);
+      Hermes::vector<Solution<Scalar>*> adjoint_rslns;
+      adjoint_rslns.push_back(adjoint_rsln);
+      solve_adjoint(primal_solver, goal_wf, ref_spaces, adjoint_rslns);
+    }
+
+    template<typename Scalar>
+    double GoalOrientedAdapt<Scalar>::calc_err_est(Hermes::vector<Solution<Scalar>*> slns, Hermes::vector<Solution<Scalar>*> rslns,
+      Hermes::vector<Solution<Scalar>*> adjoint_slns, Hermes::vector<Solution<Scalar>*> adjoint_rslns)
+    {
+      this->tick();
+      if(slns.size() != this->num)
+        throw Exceptions::LengthException(1, slns.size(), this->num);
+      if(rslns.size() != this->num)
+        throw Exceptions::LengthException(2, rslns.size(), this->num);
+      if(adjoint_slns.size() != this->num)
+        throw Exceptions::LengthException(3, adjoint_slns.size(), this->num);
+      if(adjoint_rslns.size() != this->num)
+        throw Exceptions::LengthException(4, adjoint_rslns.size(), this->num);
+      for (int i = 0; i < this->num; i++)
+        if(adjoint_slns[i]->get_mesh()->get_seq() != slns[i]->get_mesh()->get_seq())
+          throw Exceptions::Exception("GoalOrientedAdapt: the coarse adjoint solutions have to be on the meshes of the coarse solutions.");
+
+      // The element errors of the adjoint solutions, kept aside.
+      unsigned int error_flags = HERMES_TOTAL_ERROR_ABS | HERMES_ELEMENT_ERROR_ABS;
+      this->calc_err_internal(adjoint_slns, adjoint_rslns, NULL, true, error_flags);
+      ElementErrors adjoint_errors[H2D_MAX_COMPONENTS];
+      for (int i = 0; i < this->num; i++)
+        adjoint_errors[i].swap(this->errors[i]);
+
+      // The primal ones last, adapt() selects the refinements by the primal solutions.
+      this->calc_err_internal(slns, rslns, NULL, true, error_flags);
+
+      // The products of the squared errors stand for the squares of the goal-oriented errors.
+      const Mesh* meshes[H2D_MAX_COMPONENTS];
+      double goal_error = 0.0;
+      this->errors_squared_sum = 0.0;
+      for (int i = 0; i < this->num; i++)
+      {
+        meshes[i] = slns[i]->get_mesh();
+        Element* e;
+        for_all_active_elements(e, meshes[i])
+        {
+          double error_squared = this->errors[i].get(e->id) * adjoint_errors[i].get(e->id);
+          this->errors[i].set(e->id, error_squared);
+          goal_error += sqrt(error_squared);
+          this->errors_squared_sum += error_squared;
+        }
+      }
+
+      // The queue has been filled with the primal errors.
+      this->regular_queue_sorted = -1;
+      this->fill_regular_queue(meshes);
+
+      this->tick();
+      this->info("Adaptivity: goal-oriented error estimate calculation duration: %f s.", this->last());
+      return goal_error;
+    }
+
+    template<typename Scalar>
+    double GoalOrientedAdapt<Scalar>::calc_err_est(Solution<Scalar>* sln, Solution<Scalar>* rsln, Solution<Scalar>* adjoint_sln, Solution<Scalar>* adjoint_rsln)
+    {
+      if(this->num != 1)
+        throw Exceptions::LengthException(1, 1, this->num);
+      Hermes::vector<Solution<Scalar>*> slns;
+      slns.push_back(sln);
+      Hermes::vector<Solution<Scalar>*> rslns;
+      rslns.push_back(rsln);
+      Hermes::vector<Solution<Scalar>*> adjoint_slns;
+      adjoint_slns.push_back(adjoint_sln);
+      Hermes::vector<Solution<Scalar>*> adjoint_rslns;
+      adjoint_rslns.push_back(adjoint_rsln);
+      return calc_err_est(slns, rslns, adjoint_slns, adjoint_rslns);
+    }
+
+    template HERMES_API class GoalOrientedAdapt<double>;
+    template HERMES_API class GoalOrientedAdapt<std::complex<double> >;
+  }
+}
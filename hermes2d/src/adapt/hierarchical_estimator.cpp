@@ -0,0 +1,297 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+#include "hierarchical_estimator.h"
+#include "discrete_problem_linear.h"
+#include "api2d.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    template<typename Scalar>
+    HierarchicalEstimator<Scalar>::HierarchicalEstimator(const WeakForm<Scalar>* wf, Hermes::vector<Space<Scalar>*> coarse_spaces, bool linear, unsigned int order_increase) :
+      wf(wf), coarse_spaces(coarse_spaces), linear(linear), order_increase(order_increase)
+    {
+      if(wf == NULL)
+        throw Exceptions::NullException(1);
+      if(coarse_spaces.empty())
+        throw Exceptions::NullException(2);
+    }
+
+    template<typename Scalar>
+    HierarchicalEstimator<Scalar>::HierarchicalEstimator(const WeakForm<Scalar>* wf, Space<Scalar>* coarse_space, bool linear, unsigned int order_increase) :
+      wf(wf), linear(linear), order_increase(order_increase)
+    {
+      if(wf == NULL)
+        throw Exceptions::NullException(1);
+      if(coarse_space == NULL)
+        throw Exceptions::NullException(2);
+      coarse_spaces.push_back(coarse_space);
+    }
+
+    template<typename Scalar>
+    HierarchicalEstimator<Scalar>::~HierarchicalEstimator()
+    {
+      free_enriched_spaces();
+    }
+
+    template<typename Scalar>
+    void HierarchicalEstimator<Scalar>::free_enriched_spaces()
+    {
+      for(unsigned int i = 0; i < enriched_spaces.size(); i++)
+        delete enriched_spaces[i];
+      enriched_spaces.clear();
+    }
+
+    template<typename Scalar>
+    void HierarchicalEstimator<Scalar>::create_enriched_spaces()
+    {
+      free_enriched_spaces();
+      for(unsigned int i = 0; i < coarse_spaces.size(); i++)
+      {
+        typename Space<Scalar>::ReferenceSpaceCreator creator(coarse_spaces[i], coarse_spaces[i]->get_mesh(), order_increase);
+        enriched_spaces.push_back(creator.create_ref_space(false));
+      }
+      Space<Scalar>::assign_dofs(enriched_spaces);
+    }
+
+    template<typename Scalar>
+    Hermes::vector<Space<Scalar>*> HierarchicalEstimator<Scalar>::get_enriched_spaces() const
+    {
+      return enriched_spaces;
+    }
+
+    template<typename Scalar>
+    void HierarchicalEstimator<Scalar>::prolong(const Scalar* coarse_coeff_vec, Scalar* coeff_vec, bool* known)
+    {
+      AsmList<Scalar> al_coarse, al_enriched;
+      Element* e;
+      for(unsigned int space_i = 0; space_i < coarse_spaces.size(); space_i++)
+      {
+        for_all_active_elements(e, coarse_spaces[space_i]->get_mesh())
+        {
+          coarse_spaces[space_i]->get_element_assembly_list(e, &al_coarse);
+          enriched_spaces[space_i]->get_element_assembly_list(e, &al_enriched);
+          int* idx_coarse = al_coarse.get_idx();
+          int* idx_enriched = al_enriched.get_idx();
+          for(unsigned int k = 0; k < al_enriched.get_cnt(); k++)
+          {
+            int dof = al_enriched.get_dof()[k];
+            if(dof < 0 || known[dof])
+              continue;
+
+            // Only the shape functions of one basis function each (not expanded constraints of hanging nodes) are matched,
+            // every DOF has such an element.
+            int count_enriched = 0, count_coarse = 0, k_coarse = -1;
+            for(unsigned int l = 0; l < al_enriched.get_cnt(); l++)
+              if(idx_enriched[l] == idx_enriched[k])
+                count_enriched++;
+            for(unsigned int l = 0; l < al_coarse.get_cnt(); l++)
+              if(idx_coarse[l] == idx_enriched[k])
+              {
+                count_coarse++;
+                k_coarse = l;
+              }
+            if(count_enriched != 1 || count_coarse != 1 || al_coarse.get_dof()[k_coarse] < 0)
+              continue;
+
+            coeff_vec[dof] = coarse_coeff_vec[al_coarse.get_dof()[k_coarse]] * al_coarse.get_coef()[k_coarse] / al_enriched.get_coef()[k];
+            known[dof] = true;
+          }
+        }
+      }
+    }
+
+    template<typename Scalar>
+    bool HierarchicalEstimator<Scalar>::solve_dense(Scalar* matrix, Scalar* rhs, int n)
+    {
+      for(int col = 0; col < n; col++)
+      {
+        int pivot = col;
+        for(int row = col + 1; row < n; row++)
+          if(std::abs(matrix[row * n + col]) > std::abs(matrix[pivot * n + col]))
+            pivot = row;
+        if(std::abs(matrix[pivot * n + col]) == 0.0)
+          return false;
+        if(pivot != col)
+        {
+          for(int j = col; j < n; j++)
+            std::swap(matrix[col * n + j], matrix[pivot * n + j]);
+          std::swap(rhs[col], rhs[pivot]);
+        }
+        for(int row = col + 1; row < n; row++)
+        {
+          Scalar factor = matrix[row * n + col] / matrix[col * n + col];
+          if(factor == 0.0)
+            continue;
+          for(int j = col; j < n; j++)
+            matrix[row * n + j] -= factor * matrix[col * n + j];
+          rhs[row] -= factor * rhs[col];
+        }
+      }
+      for(int row = n - 1; row >= 0; row--)
+      {
+        for(int j = row + 1; j < n; j++)
+          rhs[row] -= matrix[row * n + j] * rhs[j];
+        rhs[row] /= matrix[row * n + row];
+      }
+      return true;
+    }
+
+    template<typename Scalar>
+    void HierarchicalEstimator<Scalar>::calculate(const Scalar* coarse_coeff_vec, Hermes::vector<Solution<Scalar>*> ref_slns)
+    {
+      if(coarse_coeff_vec == NULL)
+        throw Exceptions::NullException(1);
+      if(ref_slns.size() != coarse_spaces.size())
+        throw Exceptions::LengthException(2, ref_slns.size(), coarse_spaces.size());
+      this->tick();
+
+      create_enriched_spaces();
+      Hermes::vector<const Space<Scalar>*> spaces;
+      for(unsigned int i = 0; i < enriched_spaces.size(); i++)
+        spaces.push_back(enriched_spaces[i]);
+      int ndof = Space<Scalar>::get_num_dofs(spaces);
+
+      Scalar* coeff_vec = new Scalar[ndof];
+      memset(coeff_vec, 0, ndof * sizeof(Scalar));
+      bool* known = new bool[ndof];
+      memset(known, 0, ndof * sizeof(bool));
+      prolong(coarse_coeff_vec, coeff_vec, known);
+
+      // The system of the enriched spaces and the residual of the coarse solution in it.
+      SparseMatrix<Scalar>* matrix = create_matrix<Scalar>();
+      Vector<Scalar>* vector = create_vector<Scalar>();
+      Scalar* residual = new Scalar[ndof];
+      try
+      {
+        if(linear)
+        {
+          DiscreteProblemLinear<Scalar> dp(wf, spaces);
+          dp.assemble(matrix, vector);
+          vector->extract(residual);
+          Scalar* product = new Scalar[ndof];
+          matrix->multiply_with_vector(coeff_vec, product);
+          for(int i = 0; i < ndof; i++)
+            residual[i] -= product[i];
+          delete [] product;
+        }
+        else
+        {
+          DiscreteProblem<Scalar> dp(wf, spaces);
+          dp.assemble(coeff_vec, matrix, vector);
+          vector->extract(residual);
+          for(int i = 0; i < ndof; i++)
+            residual[i] = -residual[i];
+        }
+      }
+      catch(...)
+      {
+        delete matrix;
+        delete vector;
+        delete [] residual;
+        delete [] coeff_vec;
+        delete [] known;
+        throw;
+      }
+      delete vector;
+
+      // The new DOFs of every element.
+      std::vector<std::vector<int> > patches;
+      int* patch_counts = new int[ndof];
+      memset(patch_counts, 0, ndof * sizeof(int));
+      AsmList<Scalar> al;
+      Element* e;
+      for(unsigned int space_i = 0; space_i < enriched_spaces.size(); space_i++)
+      {
+        for_all_active_elements(e, enriched_spaces[space_i]->get_mesh())
+        {
+          enriched_spaces[space_i]->get_element_assembly_list(e, &al);
+          std::vector<int> patch;
+          for(unsigned int k = 0; k < al.get_cnt(); k++)
+          {
+            int dof = al.get_dof()[k];
+            if(dof >= 0 && !known[dof] && std::find(patch.begin(), patch.end(), dof) == patch.end())
+              patch.push_back(dof);
+          }
+          if(patch.empty())
+            continue;
+          for(unsigned int k = 0; k < patch.size(); k++)
+            patch_counts[patch[k]]++;
+          patches.push_back(patch);
+        }
+      }
+
+      // The local problems, the corrections of the shared DOFs are averaged.
+      Scalar* correction = new Scalar[ndof];
+      memset(correction, 0, ndof * sizeof(Scalar));
+      int num_patches = (int)patches.size();
+      int num_singular = 0;
+      int patch_i;
+      int num_threads_used = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
+#pragma omp parallel for num_threads(num_threads_used) schedule(dynamic, 16) private(patch_i) reduction(+:num_singular)
+      for(patch_i = 0; patch_i < num_patches; patch_i++)
+      {
+        const std::vector<int>& patch = patches[patch_i];
+        int n = (int)patch.size();
+        Scalar* local_matrix = new Scalar[n * n];
+        Scalar* local_rhs = new Scalar[n];
+        for(int i = 0; i < n; i++)
+        {
+          for(int j = 0; j < n; j++)
+            local_matrix[i * n + j] = matrix->get(patch[i], patch[j]);
+          local_rhs[i] = residual[patch[i]];
+        }
+        if(solve_dense(local_matrix, local_rhs, n))
+        {
+#pragma omp critical (hierarchical_estimator_correction)
+          for(int i = 0; i < n; i++)
+            correction[patch[i]] += local_rhs[i] / (double)patch_counts[patch[i]];
+        }
+        else
+          num_singular++;
+        delete [] local_matrix;
+        delete [] local_rhs;
+      }
+      if(num_singular > 0)
+        this->warn("HierarchicalEstimator: %i singular local problems were skipped.", num_singular);
+
+      for(int i = 0; i < ndof; i++)
+        coeff_vec[i] += correction[i];
+      Solution<Scalar>::vector_to_solutions(coeff_vec, spaces, ref_slns);
+
+      delete matrix;
+      delete [] residual;
+      delete [] correction;
+      delete [] patch_counts;
+      delete [] coeff_vec;
+      delete [] known;
+
+      this->tick();
+      this->info("HierarchicalEstimator: %i local problems, %i enriched DOFs, duration: %f s.", num_patches, ndof, this->last());
+    }
+
+    template<typename Scalar>
+    void HierarchicalEstimator<Scalar>::calculate(const Scalar* coarse_coeff_vec, Solution<Scalar>* ref_sln)
+    {
+      Hermes::vector<Solution<Scalar>*> ref_slns;
+      ref_slns.push_back(ref_sln);
+      calculate(coarse_coeff_vec, ref_slns);
+    }
+
+    template HERMES_API class HierarchicalEstimator<double>;
+    template HERMES_API class HierarchicalEstimator<std::complex<double> >;
+  }
+}
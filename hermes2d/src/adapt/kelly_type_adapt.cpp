@@ -13,6 +13,7 @@
 // You should have received a copy of the GNU General Public License
 // along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
 #include "kelly_type_adapt.h"
+#include "api2d.h"
 
 namespace Hermes
 {
@@ -113,6 +114,7 @@ namespace Hermes
                                                      Hermes::vector<double>* component_errors,
                                                      unsigned int error_flags)
     {
+      Hermes::Mixins::Profile::Section error_section(&this->profile, this->PROFILE_ERROR_EVALUATION);
       if(slns.size() != this->num)
         throw Hermes::Exceptions::LengthException(0, slns.size(), this->num);
 
@@ -136,11 +138,7 @@ namespace Hermes
         fns[i] = (this->sln[i]);
 
         this->num_act_elems += meshes[i]->get_num_active_elements();
-        int max = meshes[i]->get_max_element_id();
-
-        if(this->errors[i] != NULL) delete [] this->errors[i];
-        this->errors[i] = new double[max];
-        memset(this->errors[i], 0, sizeof(double) * max);
+        this->errors[i].init(meshes[i], this->single_precision_errors);
       }
 
       double total_norm = 0.0;
@@ -161,263 +159,327 @@ namespace Hermes
       this->errors_squared_sum = 0.0;
       double total_error = 0.0;
 
-      bool bnd[H2D_MAX_NUMBER_EDGES];
-      SurfPos surf_pos[H2D_MAX_NUMBER_EDGES];
-      Traverse::State *ee;
-      Traverse trav(true);
-
-      // Reset the e->visited status of each element of each mesh (most likely it will be set to true from
-      // the latest assembling procedure).
-      if(ignore_visited_segments)
+      // The neighbor searches need the spaces, they are kept only during this calculation.
+      Hermes::vector<const Space<Scalar>*> dp_spaces;
+      for (int i = 0; i < this->num; i++)
+        dp_spaces.push_back(this->spaces[i]);
+      this->dp.set_spaces(dp_spaces);
+
+      // Determine the minimum mesh seq.
+      unsigned int min_dg_mesh_seq = 0;
+      for(unsigned int j = 0; j < this->spaces.size(); j++)
+        if(this->spaces[j]->get_mesh()->get_seq() < min_dg_mesh_seq || j == 0)
+          min_dg_mesh_seq = this->spaces[j]->get_mesh()->get_seq();
+
+      this->traverse_states.update(meshes, this->num);
+      int num_states = this->traverse_states.get_num_states();
+      Traverse::State** states = this->traverse_states.get_states();
+
+      // Per-thread copies of the solutions, the first thread uses the original ones.
+      // The external functions of the estimators are shared, with those the estimators are evaluated on a single thread.
+      int num_threads_used = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
+      for (unsigned int iest = 0; iest < error_estimators_vol.size(); iest++)
+        if(!error_estimators_vol[iest]->ext.empty())
+          num_threads_used = 1;
+      for (unsigned int iest = 0; iest < error_estimators_surf.size(); iest++)
+        if(!error_estimators_surf[iest]->ext.empty())
+          num_threads_used = 1;
+
+      MeshFunction<Scalar>*** slns_threads = new MeshFunction<Scalar>**[num_threads_used];
+      Transformable*** trfs = new Transformable**[num_threads_used];
+      slns_threads[0] = new MeshFunction<Scalar>*[this->num];
+      trfs[0] = fns;
+      for (int i = 0; i < this->num; i++)
+        slns_threads[0][i] = this->sln[i];
+      int num_threads_cloned = 1;
+      try
       {
-        for (int i = 0; i < this->num; i++)
+        for(; num_threads_cloned < num_threads_used; num_threads_cloned++)
         {
-          Element* e;
-          for_all_active_elements(e, meshes[i])
-            e->visited = false;
+          slns_threads[num_threads_cloned] = new MeshFunction<Scalar>*[this->num];
+          memset(slns_threads[num_threads_cloned], 0, this->num * sizeof(MeshFunction<Scalar>*));
+          trfs[num_threads_cloned] = new Transformable*[this->num];
+          for (int i = 0; i < this->num; i++)
+          {
+            slns_threads[num_threads_cloned][i] = this->sln[i]->clone();
+            slns_threads[num_threads_cloned][i]->set_quad_2d(&g_quad_2d_std);
+            trfs[num_threads_cloned][i] = slns_threads[num_threads_cloned][i];
+          }
         }
       }
-
-      // Begin the multimesh traversal.
-      trav.begin(this->num, meshes, fns);
-      while ((ee = trav.get_next_state()) != NULL)
+      catch(Hermes::Exceptions::Exception& e)
       {
-        bnd[0] = ee->bnd[0];
-        bnd[1] = ee->bnd[1];
-        bnd[2] = ee->bnd[2];
-        bnd[3] = ee->bnd[3];
-
-        surf_pos[0].marker = ee->rep->en[0]->marker;
-        surf_pos[1].marker = ee->rep->en[1]->marker;
-        surf_pos[2].marker = ee->rep->en[2]->marker;
-        surf_pos[3].marker = ee->rep->en[3]->marker;
-
-        surf_pos[0].surf_num = 0;
-        surf_pos[1].surf_num = 1;
-        surf_pos[2].surf_num = 2;
-        surf_pos[3].surf_num = 3;
-
-        // Go through all solution components.
-        for (int i = 0; i < this->num; i++)
+        this->warn("KellyTypeAdapt::calc_err_internal: the solutions could not be cloned (%s), the errors are calculated on a single thread.", e.what());
+        for(int thread_i = 1; thread_i <= num_threads_cloned && thread_i < num_threads_used; thread_i++)
         {
-          if(ee->e[i] == NULL)
+          for (int i = 0; i < this->num; i++)
+            delete slns_threads[thread_i][i];
+          delete [] slns_threads[thread_i];
+          delete [] trfs[thread_i];
+        }
+        num_threads_cloned = 1;
+      }
+      num_threads_used = num_threads_cloned;
+
+      // Contributions of all the states, summed up afterwards in the order of the states
+      // so that the totals do not depend on the number of threads.
+      // The interface estimates evaluated once for both sides add to the elements on the other side as well.
+      double* state_errors = new double[std::max(num_states, 1) * this->num];
+      double* state_norms = new double[std::max(num_states, 1) * this->num];
+      std::vector<std::pair<int, double> >* state_neighbor_errors = new std::vector<std::pair<int, double> >[std::max(num_states, 1) * this->num];
+      memset(state_errors, 0, std::max(num_states, 1) * this->num * sizeof(double));
+      memset(state_norms, 0, std::max(num_states, 1) * this->num * sizeof(double));
+
+      // Important, sets the current caughtException to NULL.
+      this->caughtException = NULL;
+
+      int state_i;
+#define CHUNKSIZE 1
+#pragma omp parallel shared(states, slns_threads, trfs, state_errors, state_norms, state_neighbor_errors) private(state_i) num_threads(num_threads_used)
+      {
+#pragma omp for schedule(dynamic, CHUNKSIZE)
+        for(state_i = 0; state_i < num_states; state_i++)
+        {
+          if(this->caughtException != NULL)
             continue;
-
-          // Set maximum integration order for use in integrals, see limit_order()
-          update_limit_table(ee->e[i]->get_mode());
-
-          RefMap *rm = this->sln[i]->get_refmap();
-
-          double err = 0.0;
-
-          // Go through all volumetric error estimators.
-          for (unsigned int iest = 0; iest < error_estimators_vol.size(); iest++)
+          try
           {
-            // Skip current error estimator if it is assigned to a different component or geometric area
-            // different from that of the current active element.
+            MeshFunction<Scalar>** current_slns = slns_threads[omp_get_thread_num()];
+            Transformable** current_fns = trfs[omp_get_thread_num()];
+            Traverse::State* ee = states[state_i];
+            TraverseStateList::set_active_state(ee, current_fns);
 
-            if(error_estimators_vol[iest]->i != i)
-              continue;
+            SurfPos surf_pos[H2D_MAX_NUMBER_EDGES];
+            for (int isurf = 0; isurf < H2D_MAX_NUMBER_EDGES; isurf++)
+            {
+              surf_pos[isurf].marker = ee->rep->en[isurf]->marker;
+              surf_pos[isurf].surf_num = isurf;
+            }
 
-            if(error_estimators_vol[iest]->area != HERMES_ANY)
-              if(!element_markers_conversion.get_internal_marker(error_estimators_vol[iest]->area).valid || element_markers_conversion.get_internal_marker(error_estimators_vol[iest]->area).marker != ee->e[i]->marker)
+            // Go through all solution components.
+            for (int i = 0; i < this->num; i++)
+            {
+              if(ee->e[i] == NULL)
                 continue;
 
-            err += eval_volumetric_estimator(error_estimators_vol[iest], rm);
-          }
+              RefMap *rm = current_slns[i]->get_refmap();
 
-          // Go through all surface error estimators (includes both interface and boundary est's).
-          for (unsigned int iest = 0; iest < error_estimators_surf.size(); iest++)
-          {
-            if(error_estimators_surf[iest]->i != i)
-              continue;
+              double err = 0.0;
 
-            for (int isurf = 0; isurf < ee->e[i]->get_nvert(); isurf++)
-            {
-              if(bnd[isurf])   // Boundary
+              // Go through all volumetric error estimators.
+              for (unsigned int iest = 0; iest < error_estimators_vol.size(); iest++)
               {
-                if(error_estimators_surf[iest]->area != HERMES_ANY)
-                {
-                  if(!boundary_markers_conversion.get_internal_marker(error_estimators_surf[iest]->area).valid)
-                    continue;
-                  int imarker = boundary_markers_conversion.get_internal_marker(error_estimators_surf[iest]->area).marker;
+                // Skip current error estimator if it is assigned to a different component or geometric area
+                // different from that of the current active element.
 
-                  if(imarker == H2D_DG_INNER_EDGE_INT)
-                    continue;
-                  if(imarker != surf_pos[isurf].marker)
+                if(error_estimators_vol[iest]->i != i)
+                  continue;
+
+                if(error_estimators_vol[iest]->area != HERMES_ANY)
+                  if(!element_markers_conversion.get_internal_marker(error_estimators_vol[iest]->area).valid || element_markers_conversion.get_internal_marker(error_estimators_vol[iest]->area).marker != ee->e[i]->marker)
                     continue;
-                }
 
-                err += eval_boundary_estimator(error_estimators_surf[iest], rm, &surf_pos[isurf]);
+                err += eval_volumetric_estimator(error_estimators_vol[iest], current_slns, rm);
               }
-              else              // Interface
+
+              // Go through all surface error estimators (includes both interface and boundary est's).
+              for (unsigned int iest = 0; iest < error_estimators_surf.size(); iest++)
               {
-                if(error_estimators_surf[iest]->area != H2D_DG_INNER_EDGE)
+                if(error_estimators_surf[iest]->i != i)
                   continue;
 
-                // BEGIN COPY FROM DISCRETE_PROBLEM.CPP
-
-                // 5 is for bits per page in the array.
-                LightArray<NeighborSearch<Scalar>*> neighbor_searches(5);
-                unsigned int num_neighbors = 0;
-                NeighborNode* root;
-                int ns_index;
-
-                // Determine the minimum mesh seq in this stage.
-                unsigned int min_dg_mesh_seq = 0;
-                for(unsigned int j = 0; j < this->spaces.size(); j++)
-                  if(this->spaces[j]->get_mesh()->get_seq() < min_dg_mesh_seq || j == 0)
-                    min_dg_mesh_seq = this->spaces[j]->get_mesh()->get_seq();
-
-                ns_index = meshes[i]->get_seq() - min_dg_mesh_seq; // = 0 for single mesh
-
-                // Initialize the NeighborSearches.
-                this->dp.init_neighbors(neighbor_searches, ee, min_dg_mesh_seq);
-
-                // Create a multimesh tree;
-                root = new NeighborNode(NULL, 0);
-                this->dp.build_multimesh_tree(root, neighbor_searches);
-
-                // Update all NeighborSearches according to the multimesh tree.
-                // After this, all NeighborSearches in neighbor_searches should have the same count
-                // of neighbors and proper set of transformations
-                // for the central and the neighbor element(s) alike.
-                // Also check that every NeighborSearch has the same number of neighbor elements.
-                for(unsigned int j = 0; j < neighbor_searches.get_size(); j++)
+                for (int isurf = 0; isurf < ee->e[i]->get_nvert(); isurf++)
                 {
-                  if(neighbor_searches.present(j))
+                  if(ee->bnd[isurf])   // Boundary
                   {
-                    NeighborSearch<Scalar>* ns = neighbor_searches.get(j);
-                    this->dp.update_neighbor_search(ns, root);
-                    if(num_neighbors == 0)
-                      num_neighbors = ns->n_neighbors;
-                    if(ns->n_neighbors != num_neighbors)
-                      throw Hermes::Exceptions::Exception("Num_neighbors of different NeighborSearches not matching in KellyTypeAdapt<Scalar>::calc_err_internal.");
-                  }
-                }
+                    if(error_estimators_surf[iest]->area != HERMES_ANY)
+                    {
+                      if(!boundary_markers_conversion.get_internal_marker(error_estimators_surf[iest]->area).valid)
+                        continue;
+                      int imarker = boundary_markers_conversion.get_internal_marker(error_estimators_surf[iest]->area).marker;
+
+                      if(imarker == H2D_DG_INNER_EDGE_INT)
+                        continue;
+                      if(imarker != surf_pos[isurf].marker)
+                        continue;
+                    }
 
-                // Go through all segments of the currently processed interface (segmentation is caused
-                // by hanging nodes on the other side of the interface).
-                for (unsigned int neighbor = 0; neighbor < num_neighbors; neighbor++)
-                {
-                  if(ignore_visited_segments)
+                    err += eval_boundary_estimator(error_estimators_surf[iest], current_slns, rm, &surf_pos[isurf]);
+                  }
+                  else              // Interface
                   {
-                    bool processed = true;
-                    for(unsigned int j = 0; j < neighbor_searches.get_size(); j++)
-                      if(neighbor_searches.present(j))
-                        if(!neighbor_searches.get(j)->neighbors.at(neighbor)->visited)
-                        {
-                          processed = false;
-                          break;
-                        }
+                    if(error_estimators_surf[iest]->area != H2D_DG_INNER_EDGE)
+                      continue;
 
-                    if(processed) continue;
-                  }
+                    int ns_index = meshes[i]->get_seq() - min_dg_mesh_seq; // = 0 for single mesh
+                    ee->isurf = isurf;
 
-                  // We do not use cache_e and cache_jwt here.
+                    // The NeighborSearches, initialized and updated according to the multimesh tree, kept by the DiscreteProblem
+                    // for the other estimators on this edge. Every state (and so every record) is processed by one thread only.
+                    typename DiscreteProblem<Scalar>::NeighborSearchRecord* neighbor_search_record = this->dp.get_neighbor_searches(ee, min_dg_mesh_seq);
+                    LightArray<NeighborSearch<Scalar>*>& neighbor_searches = *neighbor_search_record->neighbor_searches;
+                    unsigned int num_neighbors = neighbor_search_record->num_neighbors;
 
-                  // Set the active segment in all NeighborSearches
-                  for(unsigned int j = 0; j < neighbor_searches.get_size(); j++)
-                  {
-                    if(neighbor_searches.present(j))
+                    // Go through all segments of the currently processed interface (segmentation is caused
+                    // by hanging nodes on the other side of the interface).
+                    for (unsigned int neighbor = 0; neighbor < num_neighbors; neighbor++)
                     {
-                      neighbor_searches.get(j)->active_segment = neighbor;
-                      neighbor_searches.get(j)->neighb_el = neighbor_searches.get(j)->neighbors[neighbor];
-                      neighbor_searches.get(j)->neighbor_edge = neighbor_searches.get(j)->neighbor_edges[neighbor];
-                    }
-                  }
+                      // The segment is evaluated by the side owning it, see DiscreteProblem::get_neighbor_searches().
+                      if(ignore_visited_segments && neighbor_search_record->processed[neighbor])
+                        continue;
 
-                  // Push all the necessary transformations to all functions of this stage.
-                  // The important thing is that the transformations to the current subelement are already there.
-                  // Also store the current neighbor element and neighbor edge in neighb_el, neighbor_edge.
-                  for(unsigned int fns_i = 0; fns_i < this->num; fns_i++)
-                  {
-                    NeighborSearch<Scalar> *ns = neighbor_searches.get(meshes[fns_i]->get_seq() - min_dg_mesh_seq);
-                    if(ns->central_transformations.present(neighbor))
-                      ns->central_transformations.get(neighbor)->apply_on(fns[fns_i]);
-                  }
+                      // BEGIN COPY FROM DISCRETE_PROBLEM.CPP
 
-                  // END COPY FROM DISCRETE_PROBLEM.CPP
-                  rm->force_transform(this->sln[i]->get_transform(), this->sln[i]->get_ctm());
-
-                  // The estimate is multiplied by 0.5 in order to distribute the error equally onto
-                  // the two neighboring elements.
-                  double central_err = 0.5 * eval_interface_estimator(error_estimators_surf[iest],
-                                                                      rm, &surf_pos[isurf], neighbor_searches,
-                                                                      ns_index);
-                  double neighb_err = central_err;
-
-                  // Scale the error estimate by the scaling function dependent on the element diameter
-                  // (use the central element's diameter).
-                  if(use_aposteriori_interface_scaling && interface_scaling_fns[i])
-                    if(!element_markers_conversion.get_user_marker(ee->e[i]->marker).valid)
-                      throw Hermes::Exceptions::Exception("Marker not valid.");
-                    else
-                      central_err *= interface_scaling_fns[i]->value(ee->e[i]->get_diameter(), element_markers_conversion.get_user_marker(ee->e[i]->marker).marker);
-
-                  // In the case this edge will be ignored when calculating the error for the element on
-                  // the other side, add the now computed error to that element as well.
-                  if(ignore_visited_segments)
-                  {
-                    Element *neighb = neighbor_searches.get(ns_index)->neighb_el;
-
-                    // Scale the error estimate by the scaling function dependent on the element diameter
-                    // (use the diameter of the element on the other side).
-                    if(use_aposteriori_interface_scaling && interface_scaling_fns[i])
-                      if(!element_markers_conversion.get_user_marker(neighb->marker).valid)
-                      throw Hermes::Exceptions::Exception("Marker not valid.");
-                    else
-                      neighb_err *= interface_scaling_fns[i]->value(neighb->get_diameter(), element_markers_conversion.get_user_marker(neighb->marker).marker);
-
-                    errors_components[i] += central_err + neighb_err;
-                    total_error += central_err + neighb_err;
-                    this->errors[i][ee->e[i]->id] += central_err;
-                    this->errors[i][neighb->id] += neighb_err;
+                      // Set the active segment in all NeighborSearches
+                      for(unsigned int j = 0; j < neighbor_searches.get_size(); j++)
+                      {
+                        if(neighbor_searches.present(j))
+                        {
+                          neighbor_searches.get(j)->active_segment = neighbor;
+                          neighbor_searches.get(j)->neighb_el = neighbor_searches.get(j)->neighbors[neighbor];
+                          neighbor_searches.get(j)->neighbor_edge = neighbor_searches.get(j)->neighbor_edges[neighbor];
+                        }
+                      }
+
+                      // Push all the necessary transformations to all functions of this stage.
+                      // The important thing is that the transformations to the current subelement are already there.
+                      // Also store the current neighbor element and neighbor edge in neighb_el, neighbor_edge.
+                      for(unsigned int fns_i = 0; fns_i < this->num; fns_i++)
+                      {
+                        NeighborSearch<Scalar> *ns = neighbor_searches.get(meshes[fns_i]->get_seq() - min_dg_mesh_seq);
+                        if(ns->central_transformations.present(neighbor))
+                          ns->central_transformations.get(neighbor)->apply_on(current_fns[fns_i]);
+                      }
+
+                      // END COPY FROM DISCRETE_PROBLEM.CPP
+                      rm->force_transform(current_slns[i]->get_transform(), current_slns[i]->get_ctm());
+
+                      // The estimate is multiplied by 0.5 in order to distribute the error equally onto
+                      // the two neighboring elements.
+                      double central_err = 0.5 * eval_interface_estimator(error_estimators_surf[iest], current_slns,
+                                                                          rm, &surf_pos[isurf], neighbor_searches,
+                                                                          ns_index);
+                      double neighb_err = central_err;
+
+                      // Scale the error estimate by the scaling function dependent on the element diameter
+                      // (use the central element's diameter).
+                      if(use_aposteriori_interface_scaling && interface_scaling_fns[i])
+                        if(!element_markers_conversion.get_user_marker(ee->e[i]->marker).valid)
+                          throw Hermes::Exceptions::Exception("Marker not valid.");
+                        else
+                          central_err *= interface_scaling_fns[i]->value(ee->e[i]->get_diameter(), element_markers_conversion.get_user_marker(ee->e[i]->marker).marker);
+
+                      // In the case this edge will be ignored when calculating the error for the element on
+                      // the other side, add the now computed error to that element as well.
+                      if(ignore_visited_segments)
+                      {
+                        Element *neighb = neighbor_searches.get(ns_index)->neighb_el;
+
+                        // Scale the error estimate by the scaling function dependent on the element diameter
+                        // (use the diameter of the element on the other side).
+                        if(use_aposteriori_interface_scaling && interface_scaling_fns[i])
+                          if(!element_markers_conversion.get_user_marker(neighb->marker).valid)
+                          throw Hermes::Exceptions::Exception("Marker not valid.");
+                        else
+                          neighb_err *= interface_scaling_fns[i]->value(neighb->get_diameter(), element_markers_conversion.get_user_marker(neighb->marker).marker);
+
+                        state_neighbor_errors[state_i * this->num + i].push_back(std::pair<int, double>(neighb->id, neighb_err));
+                      }
+
+                      err += central_err;
+
+                      // BEGIN COPY FROM DISCRETE_PROBLEM.CPP
+
+                      // Clear the transformations from the RefMaps and all functions.
+                      for(unsigned int fns_i = 0; fns_i < this->num; fns_i++)
+                        current_fns[fns_i]->set_transform(neighbor_searches.get(meshes[fns_i]->get_seq() - min_dg_mesh_seq)->original_central_el_transform);
+
+                      rm->set_transform(neighbor_searches.get(ns_index)->original_central_el_transform);
+
+                      // END COPY FROM DISCRETE_PROBLEM.CPP
+                    }
                   }
-                  else
-                    err += central_err;
-
-                  // BEGIN COPY FROM DISCRETE_PROBLEM.CPP
-
-                  // Clear the transformations from the RefMaps and all functions.
-                  for(unsigned int fns_i = 0; fns_i < this->num; fns_i++)
-                    fns[fns_i]->set_transform(neighbor_searches.get(meshes[fns_i]->get_seq() - min_dg_mesh_seq)->original_central_el_transform);
+                }
+              }
 
-                  rm->set_transform(neighbor_searches.get(ns_index)->original_central_el_transform);
+              if(calc_norm)
+                state_norms[state_i * this->num + i] = eval_solution_norm(this->norm_form[i][i], rm, current_slns[i]);
 
-                  // END COPY FROM DISCRETE_PROBLEM.CPP
-                }
+              state_errors[state_i * this->num + i] = err;
+            }
+          }
+          catch(Hermes::Exceptions::Exception& e)
+          {
+#pragma omp critical (caughtException)
+            if(this->caughtException == NULL)
+              this->caughtException = e.clone();
+          }
+          catch(std::exception& e)
+          {
+#pragma omp critical (caughtException)
+            if(this->caughtException == NULL)
+              this->caughtException = new Hermes::Exceptions::Exception(e.what());
+          }
+        }
+      }
 
-                // BEGIN COPY FROM DISCRETE_PROBLEM.CPP
+      for(int thread_i = 1; thread_i < num_threads_used; thread_i++)
+      {
+        for (int i = 0; i < this->num; i++)
+          delete slns_threads[thread_i][i];
+        delete [] slns_threads[thread_i];
+        delete [] trfs[thread_i];
+      }
+      delete [] slns_threads[0];
+      delete [] slns_threads;
+      delete [] trfs;
 
-                // Delete the multimesh tree;
-                delete root;
+      // The meshes will change with the adaptivity step, the neighbor searches are not kept.
+      this->dp.free_neighbor_searches();
 
-                // Delete the neighbor_searches array.
-                for(unsigned int j = 0; j < neighbor_searches.get_size(); j++)
-                  if(neighbor_searches.present(j))
-                    delete neighbor_searches.get(j);
+      if(this->caughtException != NULL)
+      {
+        delete [] state_errors;
+        delete [] state_norms;
+        delete [] state_neighbor_errors;
+        delete [] meshes;
+        delete [] fns;
+        if(calc_norm)
+          delete [] norms;
+        delete [] errors_components;
+        throw *(this->caughtException);
+      }
 
-                // END COPY FROM DISCRETE_PROBLEM.CPP
-              }
-            }
-          }
+      for(state_i = 0; state_i < num_states; state_i++)
+      {
+        for (int i = 0; i < this->num; i++)
+        {
+          if(states[state_i]->e[i] == NULL)
+            continue;
 
           if(calc_norm)
           {
-            double nrm = eval_solution_norm(this->norm_form[i][i], rm, this->sln[i]);
-            norms[i] += nrm;
-            total_norm += nrm;
+            norms[i] += state_norms[state_i * this->num + i];
+            total_norm += state_norms[state_i * this->num + i];
           }
 
+          double err = state_errors[state_i * this->num + i];
           errors_components[i] += err;
           total_error += err;
-          this->errors[i][ee->e[i]->id] += err;
+          this->errors[i].add(states[state_i]->e[i]->id, err);
 
-          ee->e[i]->visited = true;
+          std::vector<std::pair<int, double> >& neighbor_errors = state_neighbor_errors[state_i * this->num + i];
+          for(unsigned int neighbor_i = 0; neighbor_i < neighbor_errors.size(); neighbor_i++)
+          {
+            errors_components[i] += neighbor_errors[neighbor_i].second;
+            total_error += neighbor_errors[neighbor_i].second;
+            this->errors[i].add(neighbor_errors[neighbor_i].first, neighbor_errors[neighbor_i].second);
+          }
         }
       }
-      trav.finish();
+      delete [] state_errors;
+      delete [] state_norms;
+      delete [] state_neighbor_errors;
 
       // Store the calculation for each solution component separately.
       if(component_errors != NULL)
@@ -447,7 +509,7 @@ namespace Hermes
         {
           Element* e;
           for_all_active_elements(e, meshes[i])
-            this->errors[i][e->id] /= norms[i];
+            this->errors[i].set(e->id, this->errors[i].get(e->id) / norms[i]);
         }
       }
 
@@ -460,9 +522,13 @@ namespace Hermes
         this->errors_squared_sum /= total_norm;
 
       // Prepare an ordered list of elements according to an error.
+      this->regular_queue_sorted = -1;
       this->fill_regular_queue(meshes);
       this->have_errors = true;
 
+      delete [] meshes;
+      delete [] fns;
+
       if(calc_norm)
         delete [] norms;
       delete [] errors_components;
@@ -527,14 +593,15 @@ namespace Hermes
 
     template<typename Scalar>
     double KellyTypeAdapt<Scalar>::eval_volumetric_estimator(typename KellyTypeAdapt<Scalar>::ErrorEstimatorForm* err_est_form,
+                                                             MeshFunction<Scalar>** slns,
                                                              RefMap *rm)
     {
       // Determine the integration order.
-      int inc = (this->sln[err_est_form->i]->get_num_components() == 2) ? 1 : 0;
+      int inc = (slns[err_est_form->i]->get_num_components() == 2) ? 1 : 0;
 
       Func<Hermes::Ord>** oi = new Func<Hermes::Ord>*[this->num];
       for (int i = 0; i < this->num; i++)
-        oi[i] = init_fn_ord(this->sln[i]->get_fn_order() + inc);
+        oi[i] = init_fn_ord(slns[i]->get_fn_order() + inc);
 
       // Polynomial order of additional external functions.
       Func<Hermes::Ord>** fake_ext_fn = new Func<Hermes::Ord>*[err_est_form->ext.size()];
@@ -568,7 +635,7 @@ namespace Hermes
       delete [] fake_ext_fn;
 
       // eval the form
-      Quad2D* quad = this->sln[err_est_form->i]->get_quad_2d();
+      Quad2D* quad = slns[err_est_form->i]->get_quad_2d();
       double3* pt = quad->get_points(order, rm->get_active_element()->get_mode());
       int np = quad->get_num_points(order, rm->get_active_element()->get_mode());
 
@@ -583,7 +650,7 @@ namespace Hermes
       Func<Scalar>** ui = new Func<Scalar>*[this->num];
 
       for (int i = 0; i < this->num; i++)
-        ui[i] = init_fn(this->sln[i], order);
+        ui[i] = init_fn(slns[i], order);
 
       Func<Scalar>** ext_fn = new Func<Scalar>*[err_est_form->ext.size()];
       for (unsigned i = 0; i < err_est_form->ext.size(); i++)
@@ -622,13 +689,14 @@ namespace Hermes
 
     template<typename Scalar>
     double KellyTypeAdapt<Scalar>::eval_boundary_estimator(typename KellyTypeAdapt<Scalar>::ErrorEstimatorForm* err_est_form,
+                                                           MeshFunction<Scalar>** slns,
                                                            RefMap *rm, SurfPos* surf_pos)
     {
       // Determine the integration order.
-      int inc = (this->sln[err_est_form->i]->get_num_components() == 2) ? 1 : 0;
+      int inc = (slns[err_est_form->i]->get_num_components() == 2) ? 1 : 0;
       Func<Hermes::Ord>** oi = new Func<Hermes::Ord>*[this->num];
       for (int i = 0; i < this->num; i++)
-        oi[i] = init_fn_ord(this->sln[i]->get_edge_fn_order(surf_pos->surf_num) + inc);
+        oi[i] = init_fn_ord(slns[i]->get_edge_fn_order(surf_pos->surf_num) + inc);
 
       // Polynomial order of additional external functions.
       Func<Hermes::Ord>** fake_ext_fn = new Func<Hermes::Ord>*[err_est_form->ext.size()];
@@ -659,7 +727,7 @@ namespace Hermes
       delete [] fake_ext_fn;
 
       // Evaluate the form.
-      Quad2D* quad = this->sln[err_est_form->i]->get_quad_2d();
+      Quad2D* quad = slns[err_est_form->i]->get_quad_2d();
       int eo = quad->get_edge_points(surf_pos->surf_num, order, rm->get_active_element()->get_mode());
       double3* pt = quad->get_points(eo, rm->get_active_element()->get_mode());
       int np = quad->get_num_points(eo, rm->get_active_element()->get_mode());
@@ -674,7 +742,7 @@ namespace Hermes
       // Function values
       Func<Scalar>** ui = new Func<Scalar>*[this->num];
       for (int i = 0; i < this->num; i++)
-        ui[i] = init_fn(this->sln[i], eo);
+        ui[i] = init_fn(slns[i], eo);
 
       Func<Scalar>** ext_fn = new Func<Scalar>*[err_est_form->ext.size()];
       for (unsigned i = 0; i < err_est_form->ext.size(); i++)
@@ -714,14 +782,15 @@ namespace Hermes
 
     template<typename Scalar>
     double KellyTypeAdapt<Scalar>::eval_interface_estimator(typename KellyTypeAdapt<Scalar>::ErrorEstimatorForm* err_est_form,
+                                                            MeshFunction<Scalar>** slns,
                                                             RefMap *rm, SurfPos* surf_pos,
                                                             LightArray<NeighborSearch<Scalar>*>& neighbor_searches,
                                                             int neighbor_index)
     {
       NeighborSearch<Scalar>* nbs = neighbor_searches.get(neighbor_index);
-      Hermes::vector<MeshFunction<Scalar>*> slns;
+      Hermes::vector<MeshFunction<Scalar>*> current_slns;
       for (int i = 0; i < this->num; i++)
-        slns.push_back(this->sln[i]);
+        current_slns.push_back(slns[i]);
 
       // Determine integration order.
       Func<Hermes::Ord>** fake_ext_fns = new Func<Hermes::Ord>*[err_est_form->ext.size()];
@@ -758,7 +827,7 @@ namespace Hermes
 
       //delete fake_ext;
 
-      Quad2D* quad = this->sln[err_est_form->i]->get_quad_2d();
+      Quad2D* quad = slns[err_est_form->i]->get_quad_2d();
       int eo = quad->get_edge_points(surf_pos->surf_num, order, rm->get_active_element()->get_mode());
       int np = quad->get_num_points(eo, rm->get_active_element()->get_mode());
       double3* pt = quad->get_points(eo, rm->get_active_element()->get_mode());
@@ -775,14 +844,14 @@ namespace Hermes
         jwt[i] = pt[i][2] * tan[i][2];
 
       // Function values.
-      DiscontinuousFunc<Scalar>** ui = this->dp.init_ext_fns(slns, neighbor_searches, order, 0);
+      DiscontinuousFunc<Scalar>** ui = this->dp.init_ext_fns(current_slns, neighbor_searches, order, 0);
 
       Scalar res = interface_scaling_const *
         err_est_form->value(np, jwt, NULL, ui[err_est_form->i], e, NULL);
 
       if(ui != NULL)
       {
-        for(unsigned int i = 0; i < slns.size(); i++)
+        for(unsigned int i = 0; i < current_slns.size(); i++)
           ui[i]->free_fn();
         delete [] ui;
       }
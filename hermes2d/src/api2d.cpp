@@ -22,7 +22,12 @@
 #include "common.h"
 #include "exceptions.h"
 #include "api2d.h"
+#include "global.h"
 #include <xercesc/util/PlatformUtils.hpp>
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#endif
 
 using namespace xercesc;
 
@@ -37,6 +42,23 @@ namespace Hermes
       this->user_set = false;
     }
 
+    /// Pins the OpenMP threads of a parallel region of num_threads threads, one per processor.
+    static void pin_threads(int num_threads)
+    {
+#ifdef __linux__
+      int num_processors = (int)sysconf(_SC_NPROCESSORS_ONLN);
+      if(num_processors < 1)
+        return;
+#pragma omp parallel num_threads(num_threads)
+      {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(omp_get_thread_num() % num_processors, &cpu_set);
+        sched_setaffinity(0, sizeof(cpu_set), &cpu_set);
+      }
+#endif
+    }
+
     Api2D::Api2D()
     {
       signal(SIGABRT, CallStack::dump);
@@ -45,10 +67,19 @@ namespace Hermes
       signal(SIGSEGV, CallStack::dump);
       signal(SIGTERM, CallStack::dump);
       
-      // Xerces initialization - for better performance.
-      XMLPlatformUtils::Initialize();   
+      // Xerces is initialized by initialize_xml() on the first use.
+      this->xml_initialized = false;
 
       this->integral_parameters.insert(std::pair<Hermes2DApiParam, Parameter<int>*> (Hermes::Hermes2D::numThreads,new Parameter<int>(NUM_THREADS)));
+      this->integral_parameters.insert(std::pair<Hermes2DApiParam, Parameter<int>*> (Hermes::Hermes2D::assemblingMode,new Parameter<int>(H2D_ASSEMBLING_DEFAULT)));
+      this->integral_parameters.insert(std::pair<Hermes2DApiParam, Parameter<int>*> (Hermes::Hermes2D::cacheSizeLimit,new Parameter<int>(H2D_DEFAULT_CACHE_SIZE_LIMIT)));
+      this->integral_parameters.insert(std::pair<Hermes2DApiParam, Parameter<int>*> (Hermes::Hermes2D::precalcCacheSizeLimit,new Parameter<int>(H2D_DEFAULT_PRECALC_CACHE_SIZE_LIMIT)));
+      this->integral_parameters.insert(std::pair<Hermes2DApiParam, Parameter<int>*> (Hermes::Hermes2D::assemblingMemoryLimit,new Parameter<int>(0)));
+      this->integral_parameters.insert(std::pair<Hermes2DApiParam, Parameter<int>*> (Hermes::Hermes2D::xmlTrustedInput,new Parameter<int>(0)));
+      this->integral_parameters.insert(std::pair<Hermes2DApiParam, Parameter<int>*> (Hermes::Hermes2D::traceEvents,new Parameter<int>(0)));
+      this->integral_parameters.insert(std::pair<Hermes2DApiParam, Parameter<int>*> (Hermes::Hermes2D::numaFirstTouch,new Parameter<int>(0)));
+      this->integral_parameters.insert(std::pair<Hermes2DApiParam, Parameter<int>*> (Hermes::Hermes2D::threadPinning,new Parameter<int>(0)));
+      this->text_parameters.insert(std::pair<Hermes2DApiParam, Parameter<std::string>*> (Hermes::Hermes2D::traceFile,new Parameter<std::string>("")));
       this->text_parameters.insert(std::pair<Hermes2DApiParam, Parameter<std::string>*> (Hermes::Hermes2D::xmlSchemasDirPath,new Parameter<std::string>(*(new std::string(H2D_XML_SCHEMAS_DIRECTORY)))));
       std::stringstream ss;
       ss << H2D_PRECALCULATED_FORMS_DIRECTORY;
@@ -59,17 +90,36 @@ namespace Hermes
         ss << '/';
         this->text_parameters.insert(std::pair<Hermes2DApiParam, Parameter<std::string>*> (Hermes::Hermes2D::precalculatedFormsDirPath,new Parameter<std::string>(*(new std::string(ss.str())))));
       }
-
-      XMLPlatformUtils::Terminate();
     }
 
     Api2D::~Api2D()
     {
+      std::string trace_file = this->get_text_param_value(traceFile);
+      if(!trace_file.empty() && Hermes::Mixins::Trace::get_num_events() > 0)
+        Hermes::Mixins::Trace::write_chrome_trace(trace_file.c_str());
+
       for(std::map<Hermes2DApiParam, Parameter<std::string>*>::const_iterator it = this->text_parameters.begin(); it != this->text_parameters.end(); ++it)
         delete it->second;
 
       for(std::map<Hermes2DApiParam, Parameter<int>*>::const_iterator it = this->integral_parameters.begin(); it != this->integral_parameters.end(); ++it)
         delete it->second;
+
+      if(this->xml_initialized)
+        XMLPlatformUtils::Terminate();
+    }
+
+    void Api2D::initialize_xml()
+    {
+      if(this->xml_initialized)
+        return;
+      // Kept for the whole process, the files are then parsed without the initialization of their own (xml_schema::flags::dont_initialize).
+#pragma omp critical (xml_initialization)
+      if(!this->xml_initialized)
+      {
+        XMLPlatformUtils::Initialize();
+#pragma omp flush
+        this->xml_initialized = true;
+      }
     }
 
     int Api2D::get_integral_param_value(Hermes2DApiParam param)
@@ -88,6 +138,14 @@ namespace Hermes
         throw Hermes::Exceptions::Exception("Wrong Hermes::Api parameter name:%i", param);
       this->integral_parameters.find(param)->second->user_set = true;
       this->integral_parameters.find(param)->second->user_val = value;
+
+      // Read in the hot paths, where the parameters are not looked up.
+      if(param == traceEvents)
+        Hermes::Mixins::Trace::set_enabled(value != 0);
+      if(param == numaFirstTouch)
+        HermesCommonApi.set_integral_param_value(Hermes::parallelFirstTouch, value);
+      if((param == threadPinning || param == numThreads) && this->get_integral_param_value(threadPinning) != 0)
+        pin_threads(this->get_integral_param_value(numThreads));
     }
 
     std::string Api2D::get_text_param_value(Hermes2DApiParam param)
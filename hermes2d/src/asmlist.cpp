@@ -32,6 +32,19 @@ namespace Hermes
         dof[i] = other.dof[i];
         idx[i] = other.idx[i];
       }
+
+      this->shape_pos = this->dof_pos = this->shape_entry = this->reduced_dof = NULL;
+      this->operator_cap = 0;
+      this->num_shapes = other.num_shapes;
+      this->num_reduced_dofs = other.num_reduced_dofs;
+      if(this->num_shapes > 0)
+      {
+        enlarge_operator(cnt);
+        memcpy(shape_pos, other.shape_pos, sizeof(int) * cnt);
+        memcpy(dof_pos, other.dof_pos, sizeof(int) * cnt);
+        memcpy(shape_entry, other.shape_entry, sizeof(int) * num_shapes);
+        memcpy(reduced_dof, other.reduced_dof, sizeof(int) * num_reduced_dofs);
+      }
     }
 
     template<typename Scalar>
@@ -42,6 +55,9 @@ namespace Hermes
       idx = (int*) malloc(sizeof(int) * cap);
       dof = (int*) malloc(sizeof(int) * cap);
       coef = (Scalar*) malloc(sizeof(Scalar) * cap);
+
+      shape_pos = dof_pos = shape_entry = reduced_dof = NULL;
+      num_shapes = num_reduced_dofs = operator_cap = 0;
     }
 
     template<typename Scalar>
@@ -50,6 +66,36 @@ namespace Hermes
       free(idx);
       free(dof);
       free(coef);
+      free_operator();
+    }
+
+    template<typename Scalar>
+    void AsmList<Scalar>::free_operator()
+    {
+      free(shape_pos);
+      free(dof_pos);
+      free(shape_entry);
+      free(reduced_dof);
+      shape_pos = dof_pos = shape_entry = reduced_dof = NULL;
+      num_shapes = num_reduced_dofs = operator_cap = 0;
+    }
+
+    template<typename Scalar>
+    void AsmList<Scalar>::enlarge_operator(unsigned int size)
+    {
+      if(size <= operator_cap)
+        return;
+      operator_cap = std::max(size, 2 * operator_cap);
+      shape_pos = (int*) realloc(shape_pos, sizeof(int) * operator_cap);
+      dof_pos = (int*) realloc(dof_pos, sizeof(int) * operator_cap);
+      shape_entry = (int*) realloc(shape_entry, sizeof(int) * operator_cap);
+      reduced_dof = (int*) realloc(reduced_dof, sizeof(int) * operator_cap);
+    }
+
+    template<typename Scalar>
+    bool AsmList<Scalar>::has_constraint_operator() const
+    {
+      return this->num_shapes > 0;
     }
 
     template<typename Scalar>
@@ -81,6 +127,8 @@ namespace Hermes
     {
       if(cnt >= cap)
         enlarge();
+      // A list being filled by other means than the stored constraint operator.
+      num_shapes = 0;
       idx[cnt] = i;
       dof[cnt] = d;
       coef[cnt++] = c;
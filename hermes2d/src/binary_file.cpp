@@ -0,0 +1,132 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <string.h>
+#include "binary_file.h"
+#ifndef _MSC_VER
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    static size_t binary_padded(size_t size)
+    {
+      return (size + 7) & ~((size_t)7);
+    }
+
+    BinaryFile::BinaryFile(const char* filename) : filename(filename), data(NULL), size(0), offset(0), mapped(false)
+    {
+#ifndef _MSC_VER
+      int fd = open(filename, O_RDONLY);
+      if(fd < 0)
+        throw Hermes::Exceptions::Exception("File %s not found.", filename);
+      struct stat file_stat;
+      if(fstat(fd, &file_stat) < 0 || file_stat.st_size == 0)
+      {
+        close(fd);
+        throw Hermes::Exceptions::Exception("File %s: could not read the binary file.", filename);
+      }
+      size = (size_t)file_stat.st_size;
+      void* mapped_data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      close(fd);
+      if(mapped_data == MAP_FAILED)
+        throw Hermes::Exceptions::Exception("File %s: could not map the binary file.", filename);
+      data = (char*)mapped_data;
+      mapped = true;
+#else
+      FILE* f = fopen(filename, "rb");
+      if(f == NULL)
+        throw Hermes::Exceptions::Exception("File %s not found.", filename);
+      fseek(f, 0, SEEK_END);
+      size = (size_t)ftell(f);
+      fseek(f, 0, SEEK_SET);
+      data = new char[size + 1];
+      size_t read = fread(data, 1, size, f);
+      fclose(f);
+      if(read != size)
+      {
+        delete [] data;
+        throw Hermes::Exceptions::Exception("File %s: could not read the binary file.", filename);
+      }
+#endif
+    }
+
+    BinaryFile::~BinaryFile()
+    {
+#ifndef _MSC_VER
+      if(mapped)
+        munmap(data, size);
+#endif
+      if(!mapped)
+        delete [] data;
+    }
+
+    const char* BinaryFile::next_section(size_t section_size)
+    {
+      if(offset + section_size > size)
+        throw Hermes::Exceptions::Exception("File %s: the binary file is truncated.", filename.c_str());
+      const char* section = data + offset;
+      offset += binary_padded(section_size);
+      return section;
+    }
+
+    bool BinaryFile::has_magic(const char* filename, const char* magic)
+    {
+      FILE* f = fopen(filename, "rb");
+      if(f == NULL)
+        return false;
+      char file_magic[8];
+      bool result = fread(file_magic, 1, 8, f) == 8 && !memcmp(file_magic, magic, 8);
+      fclose(f);
+      return result;
+    }
+
+    void BinaryFile::write(FILE* f, const void* data, size_t size)
+    {
+      static const char zeros[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+      if(size > 0 && fwrite(data, 1, size, f) != size)
+        throw Hermes::Exceptions::Exception("Could not write the binary file.");
+      if(binary_padded(size) > size && fwrite(zeros, 1, binary_padded(size) - size, f) != binary_padded(size) - size)
+        throw Hermes::Exceptions::Exception("Could not write the binary file.");
+    }
+
+    void BinaryFile::sync(const char* filename)
+    {
+#ifndef _MSC_VER
+      int fd = open(filename, O_RDONLY);
+      if(fd < 0)
+        throw Hermes::Exceptions::Exception("File %s not found.", filename);
+      int result = fsync(fd);
+      close(fd);
+#else
+      int fd = _open(filename, _O_RDWR);
+      if(fd < 0)
+        throw Hermes::Exceptions::Exception("File %s not found.", filename);
+      int result = _commit(fd);
+      _close(fd);
+#endif
+      if(result != 0)
+        throw Hermes::Exceptions::Exception("File %s could not be synced to the disk.", filename);
+    }
+  }
+}
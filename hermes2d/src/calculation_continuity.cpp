@@ -15,6 +15,8 @@
 
 #include "calculation_continuity.h"
 #include "mesh_reader_h2d_xml.h"
+#include "mesh_reader_h2d_binary.h"
+#include "binary_file.h"
 #include "space_h1.h"
 #include "space_hdiv.h"
 #include "space_hcurl.h"
@@ -100,7 +102,7 @@ namespace Hermes
     }
 
     template<typename Scalar>
-    CalculationContinuity<Scalar>::CalculationContinuity(IdentificationMethod identification_method) : last_record(NULL), record_available(false), identification_method(identification_method), num(0)
+    CalculationContinuity<Scalar>::CalculationContinuity(IdentificationMethod identification_method) : binary(false), last_record(NULL), record_available(false), identification_method(identification_method), num(0)
     {
       double last_time;
       unsigned int last_number;
@@ -166,56 +168,34 @@ namespace Hermes
     template<typename Scalar>
     void CalculationContinuity<Scalar>::add_record(double time, unsigned int number, Mesh* mesh, Space<Scalar>* space, Solution<Scalar>* sln, double time_step, double time_step_n_minus_one, double error)
     {
-      std::ofstream ofile("timeAndNumber.h2d", std::ios_base::app);
-      if(ofile)
-      {
-        ofile << ++this->num << ' ' << time << ' ' << number << std::endl;
-        ofile.close();
-      }
-      else
-        throw IOCalculationContinuityException(CalculationContinuityException::general, IOCalculationContinuityException::output, "timeAndNumber.h2d");
-
-      CalculationContinuity<Scalar>::Record* record = new CalculationContinuity<Scalar>::Record(time, number);
-      record->save_mesh(mesh);
+      Hermes::vector<Mesh*> meshes;
+      meshes.push_back(mesh);
+      Hermes::vector<Space<Scalar>*> spaces;
       if(space != NULL)
-        record->save_space(space);
+        spaces.push_back(space);
+      Hermes::vector<Solution<Scalar>*> slns;
       if(sln != NULL)
-        record->save_solution(sln);
-      if(time_step > 0.0)
-        record->save_time_step_length(time_step);
-      if(time_step_n_minus_one > 0.0)
-        record->save_time_step_length_n_minus_one(time_step_n_minus_one);
-      if(error > 0.0)
-        record->save_error(error);
-
-      this->records.insert(std::pair<std::pair<double, unsigned int>, CalculationContinuity<Scalar>::Record*>(std::pair<double, unsigned int>(time, number), record));
-      this->last_record = record;
+        slns.push_back(sln);
+      this->add_record(time, number, meshes, spaces, slns, time_step, time_step_n_minus_one, error);
     }
 
     template<typename Scalar>
     void CalculationContinuity<Scalar>::add_record(double time, unsigned int number, Hermes::vector<Mesh*> meshes, Hermes::vector<Space<Scalar>*> spaces, Hermes::vector<Solution<Scalar>*> slns, double time_step, double time_step_n_minus_one, double error)
     {
-      std::ofstream ofile("timeAndNumber.h2d", std::ios_base::app);
-      if(ofile)
+      CalculationContinuity<Scalar>::Record* record = new CalculationContinuity<Scalar>::Record(time, number);
+      try
       {
-        ofile << ++this->num << ' ' << time << ' ' << number << std::endl;
-        ofile.close();
+        this->save_record(record, meshes, spaces, slns, time_step, time_step_n_minus_one, error);
+      }
+      catch(Hermes::Exceptions::Exception&)
+      {
+        delete record;
+        throw;
       }
-      else
-        throw IOCalculationContinuityException(CalculationContinuityException::general, IOCalculationContinuityException::output, "timeAndNumber.h2d");
 
-      CalculationContinuity<Scalar>::Record* record = new CalculationContinuity<Scalar>::Record(time, number);
-      record->save_meshes(meshes);
-      if(spaces != Hermes::vector<Space<Scalar>*>())
-        record->save_spaces(spaces);
-      if(slns != Hermes::vector<Solution<Scalar>*>())
-        record->save_solutions(slns);
-      if(time_step > 0.0)
-        record->save_time_step_length(time_step);
-      if(time_step_n_minus_one > 0.0)
-        record->save_time_step_length_n_minus_one(time_step_n_minus_one);
-      if(error > 0.0)
-        record->save_error(error);
+      std::stringstream line;
+      line << ++this->num << ' ' << time << ' ' << number;
+      this->commit("timeAndNumber.h2d", line.str());
 
       this->records.insert(std::pair<std::pair<double, unsigned int>, CalculationContinuity<Scalar>::Record*>(std::pair<double, unsigned int>(time, number), record));
       this->last_record = record;
@@ -224,55 +204,35 @@ namespace Hermes
     template<typename Scalar>
     void CalculationContinuity<Scalar>::add_record(double time, Mesh* mesh, Space<Scalar>* space, Solution<Scalar>* sln, double time_step, double time_step_n_minus_one, double error)
     {
-      std::ofstream ofile("onlyTime.h2d", std::ios_base::app);
-      if(ofile)
-      {
-        ofile << ++this->num << ' ' << time << std::endl;
-        ofile.close();
-      }
-      else
-        throw IOCalculationContinuityException(CalculationContinuityException::general, IOCalculationContinuityException::output, "onlyTime.h2d");
-
-      CalculationContinuity<Scalar>::Record* record = new CalculationContinuity<Scalar>::Record(time);
-      record->save_mesh(mesh);
+      Hermes::vector<Mesh*> meshes;
+      meshes.push_back(mesh);
+      Hermes::vector<Space<Scalar>*> spaces;
       if(space != NULL)
-        record->save_space(space);
+        spaces.push_back(space);
+      Hermes::vector<Solution<Scalar>*> slns;
       if(sln != NULL)
-        record->save_solution(sln);
-      if(time_step > 0.0)
-        record->save_time_step_length(time_step);
-      if(time_step_n_minus_one > 0.0)
-        record->save_time_step_length_n_minus_one(time_step_n_minus_one);
-      if(error > 0.0)
-        record->save_error(error);
-
-      this->time_records.insert(std::pair<double, CalculationContinuity<Scalar>::Record*>(time, record));
-      this->last_record = record;
+        slns.push_back(sln);
+      this->add_record(time, meshes, spaces, slns, time_step, time_step_n_minus_one, error);
     }
 
     template<typename Scalar>
     void CalculationContinuity<Scalar>::add_record(double time, Hermes::vector<Mesh*> meshes, Hermes::vector<Space<Scalar>*> spaces, Hermes::vector<Solution<Scalar>*> slns, double time_step, double time_step_n_minus_one, double error)
     {
-      std::ofstream ofile("onlyTime.h2d", std::ios_base::app);
-      if(ofile)
+      CalculationContinuity<Scalar>::Record* record = new CalculationContinuity<Scalar>::Record(time);
+      try
       {
-        ofile << ++this->num << ' ' << time << std::endl;
-        ofile.close();
+        this->save_record(record, meshes, spaces, slns, time_step, time_step_n_minus_one, error);
       }
-      else
-        throw IOCalculationContinuityException(CalculationContinuityException::general, IOCalculationContinuityException::output, "onlyTime.h2d");
-      CalculationContinuity<Scalar>::Record* record = new CalculationContinuity<Scalar>::Record(time);
-      record->save_meshes(meshes);
-      if(spaces != Hermes::vector<Space<Scalar>*>())
-        record->save_spaces(spaces);
-      if(slns != Hermes::vector<Solution<Scalar>*>())
-        record->save_solutions(slns);
-      if(time_step > 0.0)
-        record->save_time_step_length(time_step);
-      if(time_step_n_minus_one > 0.0)
-        record->save_time_step_length_n_minus_one(time_step_n_minus_one);
-      if(error > 0.0)
-        record->save_error(error);
+      catch(Hermes::Exceptions::Exception&)
+      {
+        delete record;
+        throw;
+      }
+
+      std::stringstream line;
+      line << ++this->num << ' ' << time;
+      this->commit("onlyTime.h2d", line.str());
+
       this->time_records.insert(std::pair<double, CalculationContinuity<Scalar>::Record*>(time, record));
       this->last_record = record;
     }
@@ -280,75 +240,278 @@ namespace Hermes
     template<typename Scalar>
     void CalculationContinuity<Scalar>::add_record(unsigned int number, Mesh* mesh, Space<Scalar>* space, Solution<Scalar>* sln, double time_step, double time_step_n_minus_one, double error)
     {
-      std::ofstream ofile("onlyNumber.h2d", std::ios_base::app);
-      if(ofile)
+      Hermes::vector<Mesh*> meshes;
+      meshes.push_back(mesh);
+      Hermes::vector<Space<Scalar>*> spaces;
+      if(space != NULL)
+        spaces.push_back(space);
+      Hermes::vector<Solution<Scalar>*> slns;
+      if(sln != NULL)
+        slns.push_back(sln);
+      this->add_record(number, meshes, spaces, slns, time_step, time_step_n_minus_one, error);
+    }
+
+    template<typename Scalar>
+    void CalculationContinuity<Scalar>::add_record(unsigned int number, Hermes::vector<Mesh*> meshes, Hermes::vector<Space<Scalar>*> spaces, Hermes::vector<Solution<Scalar>*> slns, double time_step, double time_step_n_minus_one, double error)
+    {
+      CalculationContinuity<Scalar>::Record* record = new CalculationContinuity<Scalar>::Record(number);
+      try
       {
-        ofile << ++this->num << ' ' << number << std::endl;
-        ofile.close();
+        this->save_record(record, meshes, spaces, slns, time_step, time_step_n_minus_one, error);
+      }
+      catch(Hermes::Exceptions::Exception&)
+      {
+        delete record;
+        throw;
       }
-      else
-        throw IOCalculationContinuityException(CalculationContinuityException::general, IOCalculationContinuityException::output, "onlyNumber.h2d");
 
-      CalculationContinuity<Scalar>::Record* record = new CalculationContinuity<Scalar>::Record(number);
-      record->save_mesh(mesh);
-      if(space != NULL)
-        record->save_space(space);
-      if(sln != NULL)
-        record->save_solution(sln);
-      if(time_step > 0.0)
-        record->save_time_step_length(time_step);
-      if(time_step_n_minus_one > 0.0)
-        record->save_time_step_length_n_minus_one(time_step_n_minus_one);
-      if(error > 0.0)
-        record->save_error(error);
+      std::stringstream line;
+      line << ++this->num << ' ' << number;
+      this->commit("onlyNumber.h2d", line.str());
 
       this->numbered_records.insert(std::pair<unsigned int, CalculationContinuity<Scalar>::Record*>(number, record));
       this->last_record = record;
     }
 
     template<typename Scalar>
-    void CalculationContinuity<Scalar>::add_record(unsigned int number, Hermes::vector<Mesh*> meshes, Hermes::vector<Space<Scalar>*> spaces, Hermes::vector<Solution<Scalar>*> slns, double time_step, double time_step_n_minus_one, double error)
+    void CalculationContinuity<Scalar>::set_binary(bool binary)
+    {
+      this->binary = binary;
+    }
+
+    template<typename Scalar>
+    void CalculationContinuity<Scalar>::save_record(Record* record, Hermes::vector<Mesh*> meshes, Hermes::vector<Space<Scalar>*> spaces, Hermes::vector<Solution<Scalar>*> slns,
+      double time_step, double time_step_n_minus_one, double error)
+    {
+      if(!this->binary)
+      {
+        record->save_meshes(meshes);
+        if(spaces != Hermes::vector<Space<Scalar>*>())
+          record->save_spaces(spaces);
+        if(slns != Hermes::vector<Solution<Scalar>*>())
+          record->save_solutions(slns);
+        if(time_step > 0.0)
+          record->save_time_step_length(time_step);
+        if(time_step_n_minus_one > 0.0)
+          record->save_time_step_length_n_minus_one(time_step_n_minus_one);
+        if(error > 0.0)
+          record->save_error(error);
+        return;
+      }
+
+      std::stringstream suffix;
+      suffix << '_' << (std::string)"t = " << record->time << (std::string)"n = " << record->number << (std::string)".bin";
+      // the files written by this record, synced before the commit
+      Hermes::vector<std::string> written_files;
+
+      MeshReaderH2DBinary reader;
+      for(unsigned int i = 0; i < meshes.size(); i++)
+      {
+        if(i < saved_meshes.size() && saved_meshes[i].object == meshes[i] && saved_meshes[i].mesh_seq == meshes[i]->get_seq())
+        {
+          record->meshFiles.push_back(saved_meshes[i].file_name);
+          continue;
+        }
+        std::stringstream filename;
+        filename << CalculationContinuity<Scalar>::mesh_file_name << i << suffix.str();
+        try
+        {
+          reader.save(filename.str().c_str(), meshes[i]);
+        }
+        catch(std::exception& e)
+        {
+          throw IOCalculationContinuityException(CalculationContinuityException::meshes, IOCalculationContinuityException::output, filename.str().c_str(), e.what());
+        }
+        SavedFile saved = { meshes[i], 0, meshes[i]->get_seq(), filename.str() };
+        if(i < saved_meshes.size())
+          saved_meshes[i] = saved;
+        else
+          saved_meshes.push_back(saved);
+        record->meshFiles.push_back(filename.str());
+        written_files.push_back(filename.str());
+      }
+
+      for(unsigned int i = 0; i < spaces.size(); i++)
+      {
+        if(i < saved_spaces.size() && saved_spaces[i].object == spaces[i] && saved_spaces[i].seq == spaces[i]->get_seq()
+          && saved_spaces[i].mesh_seq == spaces[i]->get_mesh()->get_seq())
+        {
+          record->spaceFiles.push_back(saved_spaces[i].file_name);
+          continue;
+        }
+        std::stringstream filename;
+        filename << CalculationContinuity<Scalar>::space_file_name << i << suffix.str();
+        try
+        {
+          spaces[i]->save_binary(filename.str().c_str());
+        }
+        catch(std::exception& e)
+        {
+          throw IOCalculationContinuityException(CalculationContinuityException::spaces, IOCalculationContinuityException::output, filename.str().c_str(), e.what());
+        }
+        SavedFile saved = { spaces[i], spaces[i]->get_seq(), spaces[i]->get_mesh()->get_seq(), filename.str() };
+        if(i < saved_spaces.size())
+          saved_spaces[i] = saved;
+        else
+          saved_spaces.push_back(saved);
+        record->spaceFiles.push_back(filename.str());
+        written_files.push_back(filename.str());
+      }
+
+      for(unsigned int i = 0; i < slns.size(); i++)
+      {
+        std::stringstream filename;
+        filename << CalculationContinuity<Scalar>::solution_file_name << i << suffix.str();
+        try
+        {
+          slns[i]->save_binary(filename.str().c_str());
+        }
+        catch(Hermes::Exceptions::SolutionSaveFailureException& e)
+        {
+          throw IOCalculationContinuityException(CalculationContinuityException::solutions, IOCalculationContinuityException::output, filename.str().c_str(), e.what());
+        }
+        record->solutionFiles.push_back(filename.str());
+        written_files.push_back(filename.str());
+      }
+
+      record->manifest_time_step = time_step;
+      record->manifest_time_step_n_minus_one = time_step_n_minus_one;
+      record->manifest_error = error;
+
+      std::string manifest_file_name = record->get_manifest_file_name();
+      std::ofstream manifest(manifest_file_name.c_str());
+      if(!manifest)
+        throw IOCalculationContinuityException(CalculationContinuityException::general, IOCalculationContinuityException::output, manifest_file_name.c_str());
+      manifest.precision(17);
+      for(unsigned int i = 0; i < record->meshFiles.size(); i++)
+        manifest << "mesh " << record->meshFiles[i] << std::endl;
+      for(unsigned int i = 0; i < record->spaceFiles.size(); i++)
+        manifest << "space " << record->spaceFiles[i] << std::endl;
+      for(unsigned int i = 0; i < record->solutionFiles.size(); i++)
+        manifest << "solution " << record->solutionFiles[i] << std::endl;
+      manifest << "time_step " << time_step << std::endl;
+      manifest << "time_step_n_minus_one " << time_step_n_minus_one << std::endl;
+      manifest << "error " << error << std::endl;
+      manifest.close();
+      if(manifest.fail())
+        throw IOCalculationContinuityException(CalculationContinuityException::general, IOCalculationContinuityException::output, manifest_file_name.c_str());
+      written_files.push_back(manifest_file_name);
+      record->manifest_state = 1;
+
+      // the barrier: the record is complete on the disk before the index refers to it
+      for(unsigned int i = 0; i < written_files.size(); i++)
+      {
+        try
+        {
+          BinaryFile::sync(written_files[i].c_str());
+        }
+        catch(Hermes::Exceptions::Exception& e)
+        {
+          throw IOCalculationContinuityException(CalculationContinuityException::general, IOCalculationContinuityException::output, written_files[i].c_str(), e.what());
+        }
+      }
+    }
+
+    template<typename Scalar>
+    void CalculationContinuity<Scalar>::commit(const char* index_file_name, const std::string& line)
     {
-      std::ofstream ofile("onlyNumber.h2d", std::ios_base::app);
+      std::ofstream ofile(index_file_name, std::ios_base::app);
       if(ofile)
       {
-        ofile << ++this->num << ' ' << number << std::endl;
+        ofile << line << std::endl;
         ofile.close();
       }
-      else
-        throw IOCalculationContinuityException(CalculationContinuityException::general, IOCalculationContinuityException::output, "onlyNumber.h2d");
+      if(!ofile)
+        throw IOCalculationContinuityException(CalculationContinuityException::general, IOCalculationContinuityException::output, index_file_name);
 
-      CalculationContinuity<Scalar>::Record* record = new CalculationContinuity<Scalar>::Record(number);
-      record->save_meshes(meshes);
-      if(spaces != Hermes::vector<Space<Scalar>*>())
-        record->save_spaces(spaces);
-      if(slns != Hermes::vector<Solution<Scalar>*>())
-        record->save_solutions(slns);
-      if(time_step > 0.0)
-        record->save_time_step_length(time_step);
-      if(time_step_n_minus_one > 0.0)
-        record->save_time_step_length_n_minus_one(time_step_n_minus_one);
-      if(error > 0.0)
-        record->save_error(error);
-      this->numbered_records.insert(std::pair<unsigned int, CalculationContinuity<Scalar>::Record*>(number, record));
-      this->last_record = record;
+      if(this->binary)
+      {
+        try
+        {
+          BinaryFile::sync(index_file_name);
+        }
+        catch(Hermes::Exceptions::Exception& e)
+        {
+          throw IOCalculationContinuityException(CalculationContinuityException::general, IOCalculationContinuityException::output, index_file_name, e.what());
+        }
+      }
     }
 
     template<typename Scalar>
-    CalculationContinuity<Scalar>::Record::Record(double time, unsigned int number) : time(time), number(number)
+    CalculationContinuity<Scalar>::Record::Record(double time, unsigned int number) : manifest_state(-1),
+      manifest_time_step(0.0), manifest_time_step_n_minus_one(0.0), manifest_error(0.0), time(time), number(number)
     {
     }
 
     template<typename Scalar>
-    CalculationContinuity<Scalar>::Record::Record(double time) : time(time), number(0)
+    CalculationContinuity<Scalar>::Record::Record(double time) : manifest_state(-1),
+      manifest_time_step(0.0), manifest_time_step_n_minus_one(0.0), manifest_error(0.0), time(time), number(0)
     {
     }
 
     template<typename Scalar>
-    CalculationContinuity<Scalar>::Record::Record(unsigned int number) : time(0.0), number(number)
+    CalculationContinuity<Scalar>::Record::Record(unsigned int number) : manifest_state(-1),
+      manifest_time_step(0.0), manifest_time_step_n_minus_one(0.0), manifest_error(0.0), time(0.0), number(number)
     {
     }
 
+    template<typename Scalar>
+    std::string CalculationContinuity<Scalar>::Record::get_manifest_file_name() const
+    {
+      std::stringstream filename;
+      filename << CalculationContinuity<Scalar>::record_file_name << (std::string)"t = " << this->time << (std::string)"n = " << this->number << (std::string)".h2d";
+      return filename.str();
+    }
+
+    template<typename Scalar>
+    bool CalculationContinuity<Scalar>::Record::read_manifest()
+    {
+      if(this->manifest_state >= 0)
+        return this->manifest_state == 1;
+
+      std::ifstream in(get_manifest_file_name().c_str());
+      if(!in)
+      {
+        this->manifest_state = 0;
+        return false;
+      }
+
+      std::string key;
+      while(in >> key)
+      {
+        if(key == "mesh" || key == "space" || key == "solution")
+        {
+          std::string filename;
+          std::getline(in >> std::ws, filename);
+          (key == "mesh" ? meshFiles : (key == "space" ? spaceFiles : solutionFiles)).push_back(filename);
+        }
+        else if(key == "time_step")
+          in >> this->manifest_time_step;
+        else if(key == "time_step_n_minus_one")
+          in >> this->manifest_time_step_n_minus_one;
+        else if(key == "error")
+          in >> this->manifest_error;
+        else
+          throw IOCalculationContinuityException(CalculationContinuityException::general, IOCalculationContinuityException::input, get_manifest_file_name().c_str(), "unknown entry of the manifest");
+      }
+      this->manifest_state = 1;
+      return true;
+    }
+
+    template<typename Scalar>
+    std::string CalculationContinuity<Scalar>::Record::get_file_name(const std::string& base_name, unsigned int i, const Hermes::vector<std::string>& manifest_files)
+    {
+      if(read_manifest())
+      {
+        if(i >= manifest_files.size())
+          throw IOCalculationContinuityException(CalculationContinuityException::general, IOCalculationContinuityException::input, get_manifest_file_name().c_str(), "the record has fewer entities");
+        return manifest_files[i];
+      }
+      std::stringstream filename;
+      filename << base_name << i << '_' << (std::string)"t = " << this->time << (std::string)"n = " << this->number << (std::string)".h2d";
+      return filename.str();
+    }
+
     template<typename Scalar>
     bool CalculationContinuity<Scalar>::have_record_available()
     {
@@ -525,34 +688,43 @@ namespace Hermes
     void CalculationContinuity<Scalar>::Record::load_meshes(Hermes::vector<Mesh*> meshes)
     {
       MeshReaderH2DXML reader;
+      MeshReaderH2DBinary binary_reader;
       for(unsigned int i = 0; i < meshes.size(); i++)
       {
-        std::stringstream filename;
-        filename << CalculationContinuity<Scalar>::mesh_file_name << i << '_' << (std::string)"t = " << this->time << (std::string)"n = " << this->number << (std::string)".h2d";
+        std::string filename = get_file_name(CalculationContinuity<Scalar>::mesh_file_name, i, meshFiles);
         try
         {
-          reader.load(filename.str().c_str(), meshes[i]);
+          if(read_manifest())
+            binary_reader.load(filename.c_str(), meshes[i]);
+          else
+            reader.load(filename.c_str(), meshes[i]);
         }
         catch(Hermes::Exceptions::MeshLoadFailureException& e)
         {
-          throw IOCalculationContinuityException(CalculationContinuityException::meshes, IOCalculationContinuityException::input, filename.str().c_str(), e.what());
+          throw IOCalculationContinuityException(CalculationContinuityException::meshes, IOCalculationContinuityException::input, filename.c_str(), e.what());
         }
       }
     }
     template<typename Scalar>
     void CalculationContinuity<Scalar>::Record::load_mesh(Mesh* mesh)
     {
-      MeshReaderH2DXML reader;
-      std::stringstream filename;
-      filename << CalculationContinuity<Scalar>::mesh_file_name << 0 << '_' << (std::string)"t = " << this->time << (std::string)"n = " << this->number << (std::string)".h2d";
-
+      std::string filename = get_file_name(CalculationContinuity<Scalar>::mesh_file_name, 0, meshFiles);
       try
       {
-        reader.load(filename.str().c_str(), mesh);
+        if(read_manifest())
+        {
+          MeshReaderH2DBinary reader;
+          reader.load(filename.c_str(), mesh);
+        }
+        else
+        {
+          MeshReaderH2DXML reader;
+          reader.load(filename.c_str(), mesh);
+        }
       }
       catch(Hermes::Exceptions::MeshLoadFailureException& e)
       {
-        throw IOCalculationContinuityException(CalculationContinuityException::meshes, IOCalculationContinuityException::input, filename.str().c_str(), e.what());
+        throw IOCalculationContinuityException(CalculationContinuityException::meshes, IOCalculationContinuityException::input, filename.c_str(), e.what());
       }
     }
 
@@ -567,20 +739,19 @@ namespace Hermes
 
       for(unsigned int i = 0; i < meshes.size(); i++)
       {
-        std::stringstream filename;
-        filename << CalculationContinuity<Scalar>::space_file_name << i << '_' << (std::string)"t = " << this->time << (std::string)"n = " << this->number << (std::string)".h2d";
+        std::string filename = get_file_name(CalculationContinuity<Scalar>::space_file_name, i, spaceFiles);
 
         try
         {
-          spaces.push_back(Space<Scalar>::load(filename.str().c_str(), meshes[i], false, essential_bcs[i], shapesets[i]));
+          spaces.push_back(Space<Scalar>::load(filename.c_str(), meshes[i], false, essential_bcs[i], shapesets[i]));
         }
         catch(Hermes::Exceptions::SpaceLoadFailureException& e)
         {
-          throw IOCalculationContinuityException(CalculationContinuityException::spaces, IOCalculationContinuityException::input, filename.str().c_str(), e.what());
+          throw IOCalculationContinuityException(CalculationContinuityException::spaces, IOCalculationContinuityException::input, filename.c_str(), e.what());
         }
         catch(std::exception& e)
         {
-          throw IOCalculationContinuityException(CalculationContinuityException::spaces, IOCalculationContinuityException::input, filename.str().c_str(), e.what());
+          throw IOCalculationContinuityException(CalculationContinuityException::spaces, IOCalculationContinuityException::input, filename.c_str(), e.what());
         }
       }
 
@@ -598,20 +769,19 @@ namespace Hermes
 
       for(unsigned int i = 0; i < meshes.size(); i++)
       {
-        std::stringstream filename;
-        filename << CalculationContinuity<Scalar>::space_file_name << i << '_' << (std::string)"t = " << this->time << (std::string)"n = " << this->number << (std::string)".h2d";
+        std::string filename = get_file_name(CalculationContinuity<Scalar>::space_file_name, i, spaceFiles);
 
         try
         {
-          spaces.push_back(Space<Scalar>::load(filename.str().c_str(), meshes[i], false, NULL, shapesets[i]));
+          spaces.push_back(Space<Scalar>::load(filename.c_str(), meshes[i], false, NULL, shapesets[i]));
         }
         catch(Hermes::Exceptions::SpaceLoadFailureException& e)
         {
-          throw IOCalculationContinuityException(CalculationContinuityException::spaces, IOCalculationContinuityException::input, filename.str().c_str(), e.what());
+          throw IOCalculationContinuityException(CalculationContinuityException::spaces, IOCalculationContinuityException::input, filename.c_str(), e.what());
         }
         catch(std::exception& e)
         {
-          throw IOCalculationContinuityException(CalculationContinuityException::spaces, IOCalculationContinuityException::input, filename.str().c_str(), e.what());
+          throw IOCalculationContinuityException(CalculationContinuityException::spaces, IOCalculationContinuityException::input, filename.c_str(), e.what());
         }
       }
 
@@ -621,20 +791,19 @@ namespace Hermes
     template<typename Scalar>
     Space<Scalar>* CalculationContinuity<Scalar>::Record::load_space(Mesh* mesh, EssentialBCs<Scalar>* essential_bcs, Shapeset* shapeset)
     {
-      std::stringstream filename;
-      filename << CalculationContinuity<Scalar>::space_file_name << 0 << '_' << (std::string)"t = " << this->time << (std::string)"n = " << this->number << (std::string)".h2d";
+      std::string filename = get_file_name(CalculationContinuity<Scalar>::space_file_name, 0, spaceFiles);
 
       try
       {
-        return Space<Scalar>::load(filename.str().c_str(), mesh, false, essential_bcs, shapeset);
+        return Space<Scalar>::load(filename.c_str(), mesh, false, essential_bcs, shapeset);
       }
       catch(Hermes::Exceptions::SpaceLoadFailureException& e)
       {
-        throw IOCalculationContinuityException(CalculationContinuityException::spaces, IOCalculationContinuityException::input, filename.str().c_str(), e.what());
+        throw IOCalculationContinuityException(CalculationContinuityException::spaces, IOCalculationContinuityException::input, filename.c_str(), e.what());
       }
       catch(std::exception& e)
       {
-        throw IOCalculationContinuityException(CalculationContinuityException::spaces, IOCalculationContinuityException::input, filename.str().c_str(), e.what());
+        throw IOCalculationContinuityException(CalculationContinuityException::spaces, IOCalculationContinuityException::input, filename.c_str(), e.what());
       }
     }
 
@@ -645,46 +814,50 @@ namespace Hermes
         throw Exceptions::LengthException(1, 2, solutions.size(), spaces.size());
       for(unsigned int i = 0; i < solutions.size(); i++)
       {
-        std::stringstream filename;
-        filename << CalculationContinuity<Scalar>::solution_file_name << i << '_' << (std::string)"t = " << this->time << (std::string)"n = " << this->number << (std::string)".h2d";
+        std::string filename = get_file_name(CalculationContinuity<Scalar>::solution_file_name, i, solutionFiles);
         try
         {
-          solutions[i]->load(filename.str().c_str(), spaces[i]);
+          solutions[i]->load(filename.c_str(), spaces[i]);
           solutions[i]->space_type = spaces[i]->get_type();
         }
         catch(Hermes::Exceptions::SolutionLoadFailureException& e)
         {
-          throw IOCalculationContinuityException(CalculationContinuityException::solutions, IOCalculationContinuityException::input, filename.str().c_str(), e.what());
+          throw IOCalculationContinuityException(CalculationContinuityException::solutions, IOCalculationContinuityException::input, filename.c_str(), e.what());
         }
         catch(std::exception& e)
         {
-          throw IOCalculationContinuityException(CalculationContinuityException::solutions, IOCalculationContinuityException::input, filename.str().c_str(), e.what());
+          throw IOCalculationContinuityException(CalculationContinuityException::solutions, IOCalculationContinuityException::input, filename.c_str(), e.what());
         }
       }
     }
     template<typename Scalar>
     void CalculationContinuity<Scalar>::Record::load_solution(Solution<Scalar>* solution, Space<Scalar>* space)
     {
-      std::stringstream filename;
-      filename << CalculationContinuity<Scalar>::solution_file_name << 0 << '_' << (std::string)"t = " << this->time << (std::string)"n = " << this->number << (std::string)".h2d";
+      std::string filename = get_file_name(CalculationContinuity<Scalar>::solution_file_name, 0, solutionFiles);
       try
       {
-        solution->load(filename.str().c_str(), space);
+        solution->load(filename.c_str(), space);
         solution->space_type = space->get_type();
       }
       catch(Hermes::Exceptions::SolutionLoadFailureException& e)
       {
-        throw IOCalculationContinuityException(CalculationContinuityException::solutions, IOCalculationContinuityException::input, filename.str().c_str(), e.what());
+        throw IOCalculationContinuityException(CalculationContinuityException::solutions, IOCalculationContinuityException::input, filename.c_str(), e.what());
       }
       catch(std::exception& e)
       {
-        throw IOCalculationContinuityException(CalculationContinuityException::solutions, IOCalculationContinuityException::input, filename.str().c_str(), e.what());
+        throw IOCalculationContinuityException(CalculationContinuityException::solutions, IOCalculationContinuityException::input, filename.c_str(), e.what());
       }
     }
 
     template<typename Scalar>
     void CalculationContinuity<Scalar>::Record::load_time_step_length(double & time_step_length)
     {
+      if(read_manifest())
+      {
+        time_step_length = this->manifest_time_step;
+        return;
+      }
+
       std::stringstream filename;
       filename << CalculationContinuity<Scalar>::time_step_file_name << '_' << (std::string)"t = " << this->time << (std::string)"n = " << this->number << (std::string)".h2d";
       try
@@ -702,6 +875,12 @@ namespace Hermes
     template<typename Scalar>
     void CalculationContinuity<Scalar>::Record::load_time_step_length_n_minus_one(double & time_step_length)
     {
+      if(read_manifest())
+      {
+        time_step_length = this->manifest_time_step_n_minus_one;
+        return;
+      }
+
       std::stringstream filename;
       filename << CalculationContinuity<Scalar>::time_stepNMinusOne_file_name << '_' << (std::string)"t = " << this->time << (std::string)"n = " << this->number << (std::string)".h2d";
       try
@@ -719,6 +898,12 @@ namespace Hermes
     template<typename Scalar>
     void CalculationContinuity<Scalar>::Record::load_error(double & error)
     {
+      if(read_manifest())
+      {
+        error = this->manifest_error;
+        return;
+      }
+
       std::stringstream filename;
       filename << CalculationContinuity<Scalar>::error_file_name << '_' << (std::string)"t = " << this->time << (std::string)"n = " << this->number << (std::string)".h2d";
       try
@@ -762,6 +947,9 @@ namespace Hermes
     template<typename Scalar>
     std::string CalculationContinuity<Scalar>::error_file_name = "Error_";
 
+    template<typename Scalar>
+    std::string CalculationContinuity<Scalar>::record_file_name = "Record_";
+
     template<typename Scalar>
     void CalculationContinuity<Scalar>::set_mesh_file_name(std::string mesh_file_nameToSet)
     {
@@ -787,6 +975,11 @@ namespace Hermes
     {
       error_file_name = error_file_nameToSet;
     }
+    template<typename Scalar>
+    void CalculationContinuity<Scalar>::set_record_file_name(std::string record_file_nameToSet)
+    {
+      record_file_name = record_file_nameToSet;
+    }
 
     template class HERMES_API CalculationContinuity<double>;
     template class HERMES_API CalculationContinuity<std::complex<double> >;
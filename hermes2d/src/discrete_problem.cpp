@@ -20,6 +20,7 @@
 #include "function/exact_solution.h"
 #include <algorithm>
 #include <map>
+#include <new>
 #include <string>
 #include <utility>
 #include <vector>
@@ -29,10 +30,20 @@
 #include "mesh/traverse.h"
 #include "space/space.h"
 #include "shapeset/precalc.h"
+#include "shapeset/tensor_factors.h"
+#include "shapeset/reference_integral_table.h"
+#include "element_batch_kernel.h"
 #include "mesh/refmap.h"
 #include "function/solution.h"
 #include "neighbor.h"
 #include "api2d.h"
+#ifdef WITH_MPI
+#include <mpi.h>
+#if defined(WITH_UMFPACK) && defined(MPI_VERSION) && MPI_VERSION >= 3
+// The non-blocking collectives (MPI_Iallreduce) are needed.
+#define H2D_OVERLAPPED_REDUCTION
+#endif
+#endif
 
 using namespace Hermes::Algebra::DenseMatrixOperations;
 
@@ -45,24 +56,35 @@ namespace Hermes
     template<typename Scalar>
     double DiscreteProblem<Scalar>::fake_wt = 1.0;
 
+    static const char* discrete_problem_profile_phase_names[] =
+    {
+      "traversal",
+      "precalculation",
+      "order calculation",
+      "form evaluation",
+      "matrix insertion",
+      "DG neighbor search"
+    };
+
+    static int assembly_cache_memory_category = Hermes::MemoryAccounting::add_category("assembly caches");
+
     template<typename Scalar>
-    DiscreteProblem<Scalar>::DiscreteProblem(const WeakForm<Scalar>* wf, Hermes::vector<const Space<Scalar> *> spaces) : Hermes::Solvers::DiscreteProblemInterface<Scalar>(), wf(wf)
+    DiscreteProblem<Scalar>::DiscreteProblem(const WeakForm<Scalar>* wf, Hermes::vector<const Space<Scalar> *> spaces) : Hermes::Solvers::DiscreteProblemInterface<Scalar>(), wf(wf),
+      profile(PROFILE_NUM_PHASES, discrete_problem_profile_phase_names, "assembly")
     {
       if(spaces.empty())
         throw Exceptions::NullException(2);
-      unsigned int first_dof_running = 0;
       for(unsigned int i = 0; i < spaces.size(); i++)
       {
         this->spaces.push_back(spaces.at(i));
-        this->spaces_first_dofs.push_back(first_dof_running);
-        first_dof_running += spaces.at(i)->get_num_dofs();
+        this->spaces_first_dofs.push_back(Space<Scalar>::get_dof_offset(spaces, i));
       }
       init();
     }
 
     template<typename Scalar>
     DiscreteProblem<Scalar>::DiscreteProblem(const WeakForm<Scalar>* wf, const Space<Scalar>* space)
-      : Hermes::Solvers::DiscreteProblemInterface<Scalar>(), wf(wf)
+      : Hermes::Solvers::DiscreteProblemInterface<Scalar>(), wf(wf), profile(PROFILE_NUM_PHASES, discrete_problem_profile_phase_names, "assembly")
     {
       spaces.push_back(space);
       this->spaces_first_dofs.push_back(0);
@@ -71,7 +93,8 @@ namespace Hermes
     }
 
     template<typename Scalar>
-    DiscreteProblem<Scalar>::DiscreteProblem() : Hermes::Solvers::DiscreteProblemInterface<Scalar>(), wf(NULL)
+    DiscreteProblem<Scalar>::DiscreteProblem() : Hermes::Solvers::DiscreteProblemInterface<Scalar>(), wf(NULL),
+      profile(PROFILE_NUM_PHASES, discrete_problem_profile_phase_names, "assembly")
     {
       // Set all attributes for which we don't need to acces wf or spaces.
       // This is important for the destructor to properly detect what needs to be deallocated.
@@ -101,15 +124,70 @@ namespace Hermes
       current_mat = NULL;
       current_rhs = NULL;
       current_block_weights = NULL;
+      thread_mat_values = NULL;
+      thread_rhs_values = NULL;
+      colored_mat_values = NULL;
+      colored_rhs_values = NULL;
+      assembling_arenas = NULL;
+      assembling_arenas_count = 0;
+      reference_integrals = NULL;
+      reference_integrals_count = 0;
+      form_values_buffers = NULL;
+      form_values_buffers_count = 0;
+      element_batch_kernel = NULL;
+      element_batch_size = 64;
+      element_batches = NULL;
+      element_batches_count = 0;
+      form_orders = NULL;
+      form_orders_count = 0;
+      sparse_structure_mat = NULL;
+      sparse_structure_Ap = NULL;
+      sparse_structure_Ai = NULL;
+      sparse_structure_sp_seq = NULL;
+      sparse_structure_versions = NULL;
+      sparse_structure_force_diagonal_blocks = false;
+      u_ext_coeff_vec = NULL;
+      u_ext_dof_offsets = NULL;
+      scatter_maps = NULL;
+      scatter_maps_size = 0;
+      use_scatter_maps = false;
+      partition_rank = 0;
+      partition_num_ranks = 1;
+      partition_sum_matrix = true;
+      state_parts = NULL;
+      owned_states_invalid = true;
+      halo_states = NULL;
+      halo_positions = NULL;
+      halo_positions_count = 0;
+      interior_positions = NULL;
+      interior_positions_count = 0;
+      halo_buffer = NULL;
+      halo_request = NULL;
+      halo_reduction_started = false;
+      state_groups_mode = -1;
+      weakform_clones = NULL;
+      weakform_clones_count = 0;
+      weakform_clones_wf = NULL;
+      weakform_clones_modification = 0;
+      context_pss = NULL;
+      context_spss = NULL;
+      context_refmaps = NULL;
+      context_als = NULL;
+      contexts_count = 0;
+      contexts_neq = 0;
 
 
       cache_element_stored = NULL;
 
       this->do_not_use_cache = false;
+      this->cache_memory = 0;
+      this->cache_stamp = 0;
 
       this->spaces_size = 0;
 
       this->is_linear = false;
+      this->vector_forms_skipped = false;
+      this->matrix_forms_selection = MATRIX_FORMS_ALL;
     }
 
     template<typename Scalar>
@@ -177,10 +255,63 @@ namespace Hermes
       delete tmp;
 
       this->is_linear = false;
+      this->vector_forms_skipped = false;
+      this->matrix_forms_selection = MATRIX_FORMS_ALL;
 
       current_mat = NULL;
       current_rhs = NULL;
       current_block_weights = NULL;
+      thread_mat_values = NULL;
+      thread_rhs_values = NULL;
+      colored_mat_values = NULL;
+      colored_rhs_values = NULL;
+      assembling_arenas = NULL;
+      assembling_arenas_count = 0;
+      reference_integrals = NULL;
+      reference_integrals_count = 0;
+      form_values_buffers = NULL;
+      form_values_buffers_count = 0;
+      element_batch_kernel = NULL;
+      element_batch_size = 64;
+      element_batches = NULL;
+      element_batches_count = 0;
+      form_orders = NULL;
+      form_orders_count = 0;
+      sparse_structure_mat = NULL;
+      sparse_structure_Ap = NULL;
+      sparse_structure_Ai = NULL;
+      sparse_structure_sp_seq = NULL;
+      sparse_structure_versions = NULL;
+      sparse_structure_force_diagonal_blocks = false;
+      u_ext_coeff_vec = NULL;
+      u_ext_dof_offsets = NULL;
+      scatter_maps = NULL;
+      scatter_maps_size = 0;
+      use_scatter_maps = false;
+      partition_rank = 0;
+      partition_num_ranks = 1;
+      partition_sum_matrix = true;
+      state_parts = NULL;
+      owned_states_invalid = true;
+      halo_states = NULL;
+      halo_positions = NULL;
+      halo_positions_count = 0;
+      interior_positions = NULL;
+      interior_positions_count = 0;
+      halo_buffer = NULL;
+      halo_request = NULL;
+      halo_reduction_started = false;
+      state_groups_mode = -1;
+      weakform_clones = NULL;
+      weakform_clones_count = 0;
+      weakform_clones_wf = NULL;
+      weakform_clones_modification = 0;
+      context_pss = NULL;
+      context_spss = NULL;
+      context_refmaps = NULL;
+      context_als = NULL;
+      contexts_count = 0;
+      contexts_neq = 0;
 
       cache_records_sub_idx = new std::map<uint64_t, CacheRecordPerSubIdx*>**[spaces.size()];
       cache_records_element = new CacheRecordPerElement**[spaces.size()];
@@ -204,6 +335,8 @@ namespace Hermes
       cache_element_stored = NULL;
 
       this->do_not_use_cache = false;
+      this->cache_memory = 0;
+      this->cache_stamp = 0;
     }
 
     template<typename Scalar>
@@ -217,6 +350,22 @@ namespace Hermes
       const_cast<WeakForm<Scalar>*>(this->wf)->set_current_time(time);
     }
 
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::free_weakform_clones()
+    {
+      if(weakform_clones == NULL)
+        return;
+      for(int i = 0; i < weakform_clones_count; i++)
+      {
+        weakform_clones[i]->free_ext();
+        delete weakform_clones[i];
+      }
+      delete [] weakform_clones;
+      weakform_clones = NULL;
+      weakform_clones_count = 0;
+      weakform_clones_wf = NULL;
+    }
+
     template<typename Scalar>
     void DiscreteProblem<Scalar>::set_time_step(double time_step)
     {
@@ -232,6 +381,92 @@ namespace Hermes
       if(sp_seq != NULL) delete [] sp_seq;
 
       this->delete_cache();
+      this->delete_sparse_structure();
+      this->free_weakform_clones();
+      this->free_thread_contexts();
+      this->free_neighbor_searches();
+      this->free_dg_face_tables(true);
+
+      delete [] assembling_arenas;
+      delete [] reference_integrals;
+      delete [] form_values_buffers;
+      this->free_element_batches();
+      delete [] form_orders;
+      delete [] state_parts;
+      this->free_overlapped_reduction();
+    }
+
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::init_thread_contexts()
+    {
+      int num_threads = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
+      bool fit = (context_pss != NULL && contexts_count == num_threads && contexts_neq == wf->get_neq());
+      for (int j = 0; fit && j < contexts_neq; j++)
+        if(context_pss[0][j]->get_shapeset() != spaces[j]->shapeset)
+          fit = false;
+      if(fit)
+      {
+        // The elements of the previous assembling may be gone.
+        for(int i = 0; i < contexts_count; i++)
+          for (int j = 0; j < contexts_neq; j++)
+            context_refmaps[i][j]->reset_active_element();
+        return;
+      }
+
+      free_thread_contexts();
+      contexts_count = num_threads;
+      contexts_neq = wf->get_neq();
+      context_pss = new PrecalcShapeset**[num_threads];
+      context_spss = new PrecalcShapeset**[num_threads];
+      context_refmaps = new RefMap**[num_threads];
+      context_als = new AsmList<Scalar>**[num_threads];
+      for(int i = 0; i < num_threads; i++)
+      {
+        context_pss[i] = new PrecalcShapeset*[contexts_neq];
+        context_spss[i] = new PrecalcShapeset*[contexts_neq];
+        context_refmaps[i] = new RefMap*[contexts_neq];
+        context_als[i] = new AsmList<Scalar>*[contexts_neq];
+        for (int j = 0; j < contexts_neq; j++)
+        {
+          context_pss[i][j] = new PrecalcShapeset(spaces[j]->shapeset);
+          context_spss[i][j] = new PrecalcShapeset(context_pss[i][j]);
+          context_refmaps[i][j] = new RefMap();
+          context_refmaps[i][j]->set_quad_2d(&g_quad_2d_std);
+          context_als[i][j] = new AsmList<Scalar>();
+        }
+      }
+    }
+
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::free_thread_contexts()
+    {
+      if(context_pss == NULL)
+        return;
+      for(int i = 0; i < contexts_count; i++)
+      {
+        for (int j = 0; j < contexts_neq; j++)
+        {
+          // The slave precalculated shapesets first.
+          delete context_spss[i][j];
+          delete context_pss[i][j];
+          delete context_refmaps[i][j];
+          delete context_als[i][j];
+        }
+        delete [] context_pss[i];
+        delete [] context_spss[i];
+        delete [] context_refmaps[i];
+        delete [] context_als[i];
+      }
+      delete [] context_pss;
+      delete [] context_spss;
+      delete [] context_refmaps;
+      delete [] context_als;
+      context_pss = NULL;
+      context_spss = NULL;
+      context_refmaps = NULL;
+      context_als = NULL;
+      contexts_count = 0;
+      contexts_neq = 0;
     }
 
     template<typename Scalar>
@@ -260,12 +495,55 @@ namespace Hermes
 
       this->wf = wf;
       this->have_matrix = false;
+      this->delete_sparse_structure();
+      this->free_weakform_clones();
 
       if(!this->wf->mfDG.empty())
         this->DG_matrix_forms_present = true;
 
       if(!this->wf->vfDG.empty())
         this->DG_vector_forms_present = true;
+
+      // The DG forms decide about the coloring.
+      this->state_groups.clear();
+    }
+
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::replace_weak_formulation(const WeakForm<Scalar>* wf)
+    {
+      if(wf == NULL)
+        throw Hermes::Exceptions::NullException(0);
+
+      // The blocks of the sparse structure are given by the matrix forms.
+      bool same_blocks = (this->wf != NULL && wf->get_neq() == this->wf->get_neq()
+        && wf->mfvol.size() == this->wf->mfvol.size() && wf->mfsurf.size() == this->wf->mfsurf.size()
+        && wf->mfDG.size() == this->wf->mfDG.size() && wf->vfDG.size() == this->wf->vfDG.size());
+      for(unsigned int i = 0; same_blocks && i < wf->mfvol.size(); i++)
+        if(wf->mfvol[i]->i != this->wf->mfvol[i]->i || wf->mfvol[i]->j != this->wf->mfvol[i]->j || wf->mfvol[i]->sym != this->wf->mfvol[i]->sym)
+          same_blocks = false;
+      for(unsigned int i = 0; same_blocks && i < wf->mfsurf.size(); i++)
+        if(wf->mfsurf[i]->i != this->wf->mfsurf[i]->i || wf->mfsurf[i]->j != this->wf->mfsurf[i]->j)
+          same_blocks = false;
+      if(!same_blocks)
+      {
+        set_weak_formulation(wf);
+        return;
+      }
+
+      this->wf = wf;
+      this->free_weakform_clones();
+    }
+
+    template<typename Scalar>
+    Hermes::Mixins::Profile* DiscreteProblem<Scalar>::get_profile()
+    {
+      return &this->profile;
+    }
+
+    template<typename Scalar>
+    size_t DiscreteProblem<Scalar>::get_cache_memory() const
+    {
+      return this->cache_memory;
     }
 
     template<typename Scalar>
@@ -291,9 +569,60 @@ namespace Hermes
         }
       }
 
+      // The structure was created in a different matrix.
+      if(current_mat != NULL && current_mat != sparse_structure_mat)
+        up_to_date = false;
+
       return up_to_date;
     }
 
+    template<typename Scalar>
+    bool DiscreteProblem<Scalar>::sparse_structure_reusable() const
+    {
+#ifdef WITH_UMFPACK
+      if(sparse_structure_Ap == NULL || dynamic_cast<CSCMatrix<Scalar>*>(current_mat) == NULL)
+        return false;
+
+      if(sparse_structure_force_diagonal_blocks != current_force_diagonal_blocks)
+        return false;
+
+      bool same_seqs = true;
+      for (unsigned int i = 0; i < wf->get_neq() && same_seqs; i++)
+        if(spaces[i]->get_seq() != sparse_structure_sp_seq[i])
+          same_seqs = false;
+
+      // The seq numbers change also when the DOFs stay the same, the versions are the content.
+      if(!same_seqs)
+      {
+        for (unsigned int i = 0; i < wf->get_neq(); i++)
+          if(spaces[i]->get_version() != sparse_structure_versions[i])
+            return false;
+      }
+
+      return true;
+#else
+      return false;
+#endif
+    }
+
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::delete_sparse_structure()
+    {
+      delete_scatter_maps();
+
+      if(sparse_structure_Ap != NULL)
+      {
+        delete [] sparse_structure_Ap;
+        delete [] sparse_structure_Ai;
+        delete [] sparse_structure_sp_seq;
+        delete [] sparse_structure_versions;
+        sparse_structure_Ap = NULL;
+        sparse_structure_Ai = NULL;
+        sparse_structure_sp_seq = NULL;
+        sparse_structure_versions = NULL;
+      }
+    }
+
     template<typename Scalar>
     void DiscreteProblem<Scalar>::set_fvm()
     {
@@ -306,26 +635,7 @@ namespace Hermes
       for(unsigned int i = 0; i < spaces.size(); i++)
       {
         for(unsigned int j = 0; j < cache_size; j++)
-        {
-          if(this->cache_records_sub_idx[i][j] != NULL)
-          {
-            for(typename std::map<uint64_t, CacheRecordPerSubIdx*>::iterator it = this->cache_records_sub_idx[i][j]->begin(); it != this->cache_records_sub_idx[i][j]->end(); it++)
-            {
-              it->second->clear();
-              delete it->second;
-            }
-
-            this->cache_records_sub_idx[i][j]->clear();
-            delete this->cache_records_sub_idx[i][j];
-            this->cache_records_sub_idx[i][j] = NULL;
-          }
-          if(this->cache_records_element[i][j] != NULL)
-          {
-            this->cache_records_element[i][j]->clear();
-            delete this->cache_records_element[i][j];
-            this->cache_records_element[i][j] = NULL;
-          }
-        }
+          this->free_cache_records(i, j);
         free(cache_records_sub_idx[i]);
         free(cache_records_element[i]);
       }
@@ -346,6 +656,9 @@ namespace Hermes
 
       this->spaces = spacesToSet;
 
+      // The neighbor searches depend on the types of the spaces.
+      this->free_neighbor_searches();
+
       this->ndof = Space<Scalar>::get_num_dofs(spaces);
 
       /// \todo TEMPORARY There is something wrong with caching vector shapesets.
@@ -354,14 +667,11 @@ namespace Hermes
           this->do_not_use_cache = true;
 
       have_matrix = false;
+      this->state_groups.clear();
 
-      unsigned int first_dof_running = 0;
       this->spaces_first_dofs.clear();
       for(unsigned int i = 0; i < spaces.size(); i++)
-      {
-        this->spaces_first_dofs.push_back(first_dof_running);
-        first_dof_running += spaces.at(i)->get_num_dofs();
-      }
+        this->spaces_first_dofs.push_back(Space<Scalar>::get_dof_offset(spaces, i));
 
       if(originalSize == 0)
       {
@@ -426,40 +736,12 @@ namespace Hermes
             {
               if(spaces[i]->get_mesh()->get_element(j) == NULL || !spaces[i]->get_mesh()->get_element(j)->active || spaces[i]->get_element_order(spaces[i]->get_mesh()->get_element(j)->id) < 0)
               {
-                if(this->cache_records_sub_idx[i][j] != NULL)
-                {
-                  for(typename std::map<uint64_t, CacheRecordPerSubIdx*>::iterator it = this->cache_records_sub_idx[i][j]->begin(); it != this->cache_records_sub_idx[i][j]->end(); it++)
-                    it->second->clear();
-
-                  this->cache_records_sub_idx[i][j]->clear();
-                  delete this->cache_records_sub_idx[i][j];
-                  this->cache_records_sub_idx[i][j] = NULL;
-                }
-                if(this->cache_records_element[i][j] != NULL)
-                {
-                  this->cache_records_element[i][j]->clear();
-                  delete this->cache_records_element[i][j];
-                  this->cache_records_element[i][j] = NULL;
-                }
+                this->free_cache_records(i, j);
               }
             }
             else
             {
-              if(this->cache_records_sub_idx[i][j] != NULL)
-              {
-                for(typename std::map<uint64_t, CacheRecordPerSubIdx*>::iterator it = this->cache_records_sub_idx[i][j]->begin(); it != this->cache_records_sub_idx[i][j]->end(); it++)
-                  it->second->clear();
-
-                this->cache_records_sub_idx[i][j]->clear();
-                delete this->cache_records_sub_idx[i][j];
-                this->cache_records_sub_idx[i][j] = NULL;
-              }
-              if(this->cache_records_element[i][j] != NULL)
-              {
-                this->cache_records_element[i][j]->clear();
-                delete this->cache_records_element[i][j];
-                this->cache_records_element[i][j] = NULL;
-              }
+              this->free_cache_records(i, j);
             }
           }
         }
@@ -493,6 +775,56 @@ namespace Hermes
       return 1.0;
     }
 
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::resolve_form_markers(WeakForm<Scalar>* wf)
+    {
+      for(unsigned int i = 0; i < wf->mfvol.size(); i++)
+        resolve_form_markers(wf->mfvol[i], wf->mfvol[i]->i, wf->mfvol[i]->j, false);
+      for(unsigned int i = 0; i < wf->mfsurf.size(); i++)
+        resolve_form_markers(wf->mfsurf[i], wf->mfsurf[i]->i, wf->mfsurf[i]->j, true);
+      for(unsigned int i = 0; i < wf->vfvol.size(); i++)
+        resolve_form_markers(wf->vfvol[i], wf->vfvol[i]->i, wf->vfvol[i]->i, false);
+      for(unsigned int i = 0; i < wf->vfsurf.size(); i++)
+        resolve_form_markers(wf->vfsurf[i], wf->vfsurf[i]->i, wf->vfsurf[i]->i, true);
+    }
+
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::resolve_form_markers(Form<Scalar>* form, int i, int j, bool surface)
+    {
+      form->resolved_markers.clear();
+      form->assembled_everywhere = false;
+      form->markers_resolved = true;
+
+      // The DG forms are not assembled by the surface forms' loop at all.
+      if(surface && form->areas[0] == H2D_DG_INNER_EDGE)
+        return;
+
+      const Mesh* mesh_i = this->spaces[i]->get_mesh();
+      const Mesh* mesh_j = this->spaces[j]->get_mesh();
+      const Mesh::MarkersConversion& conversion_i = surface ? (const Mesh::MarkersConversion&)mesh_i->get_boundary_markers_conversion() : (const Mesh::MarkersConversion&)mesh_i->get_element_markers_conversion();
+      const Mesh::MarkersConversion& conversion_j = surface ? (const Mesh::MarkersConversion&)mesh_j->get_boundary_markers_conversion() : (const Mesh::MarkersConversion&)mesh_j->get_element_markers_conversion();
+      for (unsigned int ss = 0; ss < form->areas.size(); ss++)
+      {
+        if(form->areas[ss] == HERMES_ANY)
+        {
+          form->assembled_everywhere = true;
+          return;
+        }
+        Mesh::MarkersConversion::IntValid marker_i = conversion_i.get_internal_marker(form->areas[ss]);
+        if(!marker_i.valid || marker_i.marker < 0)
+          continue;
+        if(i != j)
+        {
+          Mesh::MarkersConversion::IntValid marker_j = conversion_j.get_internal_marker(form->areas[ss]);
+          if(!marker_j.valid || marker_j.marker != marker_i.marker)
+            continue;
+        }
+        if(marker_i.marker >= (int)form->resolved_markers.size())
+          form->resolved_markers.resize(marker_i.marker + 1, false);
+        form->resolved_markers[marker_i.marker] = true;
+      }
+    }
+
     template<typename Scalar>
     bool DiscreteProblem<Scalar>::form_to_be_assembled(MatrixForm<Scalar>* form, Traverse::State* current_state)
     {
@@ -500,6 +832,18 @@ namespace Hermes
         return false;
       if(fabs(form->scaling_factor) < 1e-12)
         return false;
+      if(matrix_forms_selection != MATRIX_FORMS_ALL && form->time_independent != (matrix_forms_selection == MATRIX_FORMS_TIME_INDEPENDENT))
+        return false;
+
+      // Vector-valued forms need the elements of all their components.
+      MatrixFormVolBlock<Scalar>* block_form = dynamic_cast<MatrixFormVolBlock<Scalar>*>(form);
+      if(block_form != NULL)
+      {
+        for(unsigned int block_i = 1; block_i < block_form->get_block_count(); block_i++)
+          if(current_state->e[form->i + block_i] == NULL || current_state->e[form->j + block_i] == NULL)
+            return false;
+        return true;
+      }
 
       // If a block scaling table is provided, and if the scaling coefficient
       // A_mn for this block is zero, then the form does not need to be assembled.
@@ -515,6 +859,9 @@ namespace Hermes
       if(!form_to_be_assembled((MatrixForm<Scalar>*)form, current_state))
         return false;
 
+      if(form->markers_resolved)
+        return form->is_assembled_on(current_state->rep->marker);
+
       // Assemble this form only if one of its areas is HERMES_ANY
       // of if the element marker coincides with one of the form's areas.
       bool assemble_this_form = false;
@@ -558,6 +905,9 @@ namespace Hermes
       if(!form_to_be_assembled((MatrixForm<Scalar>*)form, current_state))
         return false;
 
+      if(form->markers_resolved)
+        return form->is_assembled_on(current_state->rep->en[current_state->isurf]->marker);
+
       bool assemble_this_form = false;
       for (unsigned int ss = 0; ss < form->areas.size(); ss++)
       {
@@ -605,6 +955,9 @@ namespace Hermes
       if(!form_to_be_assembled((VectorForm<Scalar>*)form, current_state))
         return false;
 
+      if(form->markers_resolved)
+        return form->is_assembled_on(current_state->rep->marker);
+
       // Assemble this form only if one of its areas is HERMES_ANY
       // of if the element marker coincides with one of the form's areas.
       bool assemble_this_form = false;
@@ -645,6 +998,9 @@ namespace Hermes
       if(!form_to_be_assembled((VectorForm<Scalar>*)form, current_state))
         return false;
 
+      if(form->markers_resolved)
+        return form->is_assembled_on(current_state->rep->en[current_state->isurf]->marker);
+
       bool assemble_this_form = false;
       for (unsigned int ss = 0; ss < form->areas.size(); ss++)
       {
@@ -683,6 +1039,35 @@ namespace Hermes
     template<typename Scalar>
     void DiscreteProblem<Scalar>::create_sparse_structure()
     {
+      // Residual only: nothing to do with the matrix and its structure, which must not be deemed up to date
+      // for the spaces of this assembling (the sequence numbers are stored only with the matrix).
+      if(current_mat == NULL)
+      {
+        if(current_rhs != NULL)
+        {
+          if(current_rhs->length() != this->ndof)
+            current_rhs->alloc(this->ndof);
+          else
+            current_rhs->zero();
+        }
+        return;
+      }
+
+      // The local matrices go to the file of the store, there is no sparse structure to build (nor to remember).
+      ElementMatrixStore<Scalar>* store = dynamic_cast<ElementMatrixStore<Scalar>*>(current_mat);
+      if(store != NULL)
+      {
+        store->alloc(this->ndof);
+        if(current_rhs != NULL)
+        {
+          if(current_rhs->length() != this->ndof)
+            current_rhs->alloc(this->ndof);
+          else
+            current_rhs->zero();
+        }
+        return;
+      }
+
       if(is_up_to_date())
       {
         if(current_mat != NULL)
@@ -699,6 +1084,24 @@ namespace Hermes
         return;
       }
 
+      // The spaces did not change since the structure was calculated, only the matrix is a different one.
+      if(current_mat != NULL && sparse_structure_reusable())
+      {
+#ifdef WITH_UMFPACK
+        current_mat->free();
+        static_cast<CSCMatrix<Scalar>*>(current_mat)->create(this->ndof, sparse_structure_Ap[this->ndof], sparse_structure_Ap, sparse_structure_Ai, NULL);
+        have_matrix = true;
+        sparse_structure_mat = current_mat;
+
+        if(current_rhs != NULL)
+          current_rhs->alloc(this->ndof);
+
+        for (unsigned int i = 0; i < wf->get_neq(); i++)
+          sp_seq[i] = spaces[i]->get_seq();
+        return;
+#endif
+      }
+
       // For DG, the sparse structure is different as we have to
       // account for over-edge calculations.
       bool is_DG = false;
@@ -722,6 +1125,7 @@ namespace Hermes
       if(current_mat != NULL)
       {
         // Spaces have changed: create the matrix from scratch.
+        delete_scatter_maps();
         have_matrix = true;
         current_mat->free();
         current_mat->prealloc(this->ndof);
@@ -734,9 +1138,6 @@ namespace Hermes
         for (unsigned int i = 0; i < wf->get_neq(); i++)
           meshes[i] = spaces[i]->get_mesh();
 
-        Traverse trav(true);
-        trav.begin(wf->get_neq(), meshes);
-
         if(is_DG)
         {
           Hermes::vector<Space<Scalar>*> mutable_spaces;
@@ -748,121 +1149,103 @@ namespace Hermes
           Space<Scalar>::assign_dofs(mutable_spaces);
         }
 
-        Traverse::State* current_state;
-        // Loop through all elements.
-        while ((current_state = trav.get_next_state()) != NULL)
+        // The neighbors across the edges, for DG.
+        DGFaceTable** face_tables = NULL;
+        AsmList<Scalar> neighbor_al;
+        if(is_DG)
         {
-          // Obtain assembly lists for the element at all spaces.
-          /// \todo do not get the assembly list again if the element was not changed.
+          free_dg_face_tables(false);
+          face_tables = new DGFaceTable*[wf->get_neq()];
           for (unsigned int i = 0; i < wf->get_neq(); i++)
-            if(current_state->e[i] != NULL)
-              if(is_DG)
-                spaces[i]->get_element_assembly_list(current_state->e[i], &(al[i]));
-              else
-                spaces[i]->get_element_assembly_list(current_state->e[i], &(al[i]), spaces_first_dofs[i]);
-
-          if(is_DG)
-          {
-            // Number of edges ( =  number of vertices).
-            int num_edges = current_state->e[0]->nvert;
+            face_tables[i] = get_dg_face_table(meshes[i]);
+        }
 
-            // Allocation an array of arrays of neighboring elements for every mesh x edge.
-            Element **** neighbor_elems_arrays = new Element ***[wf->get_neq()];
-            for(unsigned int i = 0; i < wf->get_neq(); i++)
-              neighbor_elems_arrays[i] = new Element **[num_edges];
+        // The sparse structure is registered twice: the first pass counts the entries of every column,
+        // the second one stores them in the flat index array allocated in prealloc_indices().
+        int prealloc_passes = current_mat->get_prealloc_passes();
+        if(prealloc_passes > 1)
+          current_mat->prealloc_counting();
+        for(int pass = 0; pass < prealloc_passes; pass++)
+        {
+          Traverse trav(true);
+          trav.begin(wf->get_neq(), meshes);
 
-            // The same, only for number of elements
-            int ** neighbor_elems_counts = new int *[wf->get_neq()];
-            for(unsigned int i = 0; i < wf->get_neq(); i++)
-              neighbor_elems_counts[i] = new int[num_edges];
+          Traverse::State* current_state;
+          // Loop through all elements.
+          while ((current_state = trav.get_next_state()) != NULL)
+          {
+            // Obtain assembly lists for the element at all spaces.
+            /// \todo do not get the assembly list again if the element was not changed.
+            for (unsigned int i = 0; i < wf->get_neq(); i++)
+              if(current_state->e[i] != NULL)
+                if(is_DG)
+                  spaces[i]->get_element_assembly_list(current_state->e[i], &(al[i]));
+                else
+                  spaces[i]->get_element_assembly_list(current_state->e[i], &(al[i]), spaces_first_dofs[i]);
 
-            // Get the neighbors.
-            for(unsigned int el = 0; el < wf->get_neq(); el++)
+            if(is_DG)
             {
-              NeighborSearch<Scalar> ns(current_state->e[el], meshes[el]);
-
-              // Ignoring errors (and doing nothing) in case the edge is a boundary one.
-              ns.set_ignore_errors(true);
-
-              for(int ed = 0; ed < num_edges; ed++)
+              // Pre-add the couplings with the elements across the edges into the stiffness matrix.
+              for (unsigned int m = 0; m < wf->get_neq(); m++)
               {
-                ns.set_active_edge(ed);
-                const Hermes::vector<Element *> *neighbors = ns.get_neighbors();
-
-                neighbor_elems_counts[el][ed] = ns.get_num_neighbors();
-                neighbor_elems_arrays[el][ed] = new Element *[neighbor_elems_counts[el][ed]];
-                for(int neigh = 0; neigh < neighbor_elems_counts[el][ed]; neigh++)
-                  neighbor_elems_arrays[el][ed][neigh] = (*neighbors)[neigh];
+                if(current_state->e[m] == NULL)
+                  continue;
+                AsmList<Scalar>* am = &(al[m]);
+                for(unsigned int el = 0; el < wf->get_neq(); el++)
+                {
+                  if(current_state->e[el] == NULL || !(blocks[m][el] || blocks[el][m]))
+                    continue;
+                  for(int neigh = face_tables[el]->neighbor_start[current_state->e[el]->id]; neigh < face_tables[el]->neighbor_start[current_state->e[el]->id + 1]; neigh++)
+                  {
+                    spaces[el]->get_element_assembly_list(meshes[el]->get_element_fast(face_tables[el]->neighbors[neigh]), &neighbor_al);
+
+                    // pretend assembling of the element stiffness matrix
+                    // register nonzero elements
+                    for (unsigned int i = 0; i < am->cnt; i++)
+                      if(am->dof[i] >= 0)
+                        for (unsigned int j = 0; j < neighbor_al.cnt; j++)
+                          if(neighbor_al.dof[j] >= 0)
+                          {
+                            if(blocks[m][el]) current_mat->pre_add_ij(am->dof[i], neighbor_al.dof[j]);
+                            if(blocks[el][m]) current_mat->pre_add_ij(neighbor_al.dof[j], am->dof[i]);
+                          }
+                  }
+                }
               }
             }
 
-            // Pre-add into the stiffness matrix.
+            // Go through all equation-blocks of the local stiffness matrix.
             for (unsigned int m = 0; m < wf->get_neq(); m++)
-              for(unsigned int el = 0; el < wf->get_neq(); el++)
-                for(int ed = 0; ed < num_edges; ed++)
-                  for(int neigh = 0; neigh < neighbor_elems_counts[el][ed]; neigh++)
-                    if((blocks[m][el] || blocks[el][m]) && current_state->e[m] != NULL)
-                    {
-                      AsmList<Scalar>*am = &(al[m]);
-                      AsmList<Scalar>*an = new AsmList<Scalar>;
-                      spaces[el]->get_element_assembly_list(neighbor_elems_arrays[el][ed][neigh], an);
-
-                      // pretend assembling of the element stiffness matrix
-                      // register nonzero elements
-                      for (unsigned int i = 0; i < am->cnt; i++)
-                        if(am->dof[i] >= 0)
-                          for (unsigned int j = 0; j < an->cnt; j++)
-                            if(an->dof[j] >= 0)
-                            {
-                              if(blocks[m][el]) current_mat->pre_add_ij(am->dof[i], an->dof[j]);
-                              if(blocks[el][m]) current_mat->pre_add_ij(an->dof[j], am->dof[i]);
-                            }
-                            delete an;
-                    }
-
-                    // Deallocation an array of arrays of neighboring elements
-                    // for every mesh x edge.
-                    for(unsigned int el = 0; el < wf->get_neq(); el++)
-                    {
-                      for(int ed = 0; ed < num_edges; ed++)
-                        delete [] neighbor_elems_arrays[el][ed];
-                      delete [] neighbor_elems_arrays[el];
-                    }
-                    delete [] neighbor_elems_arrays;
-
-                    // The same, only for number of elements.
-                    for(unsigned int el = 0; el < wf->get_neq(); el++)
-                      delete [] neighbor_elems_counts[el];
-                    delete [] neighbor_elems_counts;
-          }
-
-          // Go through all equation-blocks of the local stiffness matrix.
-          for (unsigned int m = 0; m < wf->get_neq(); m++)
-          {
-            for (unsigned int n = 0; n < wf->get_neq(); n++)
             {
-              if(blocks[m][n] && current_state->e[m] != NULL && current_state->e[n] != NULL)
+              for (unsigned int n = 0; n < wf->get_neq(); n++)
               {
-                AsmList<Scalar>*am = &(al[m]);
-                AsmList<Scalar>*an = &(al[n]);
-
-                // Pretend assembling of the element stiffness matrix.
-                for (unsigned int i = 0; i < am->cnt; i++)
-                  if(am->dof[i] >= 0)
-                    for (unsigned int j = 0; j < an->cnt; j++)
-                      if(an->dof[j] >= 0)
-                        current_mat->pre_add_ij(am->dof[i], an->dof[j]);
+                if(blocks[m][n] && current_state->e[m] != NULL && current_state->e[n] != NULL)
+                {
+                  AsmList<Scalar>*am = &(al[m]);
+                  AsmList<Scalar>*an = &(al[n]);
+
+                  // Pretend assembling of the element stiffness matrix.
+                  for (unsigned int i = 0; i < am->cnt; i++)
+                    if(am->dof[i] >= 0)
+                      for (unsigned int j = 0; j < an->cnt; j++)
+                        if(an->dof[j] >= 0)
+                          current_mat->pre_add_ij(am->dof[i], an->dof[j]);
+                }
               }
             }
           }
-        }
 
-        trav.finish();
+          trav.finish();
+          if(pass == 0 && prealloc_passes > 1)
+            current_mat->prealloc_indices();
+        }
         delete [] al;
         delete [] meshes;
         delete [] blocks;
+        delete [] face_tables;
 
         current_mat->alloc();
+        sparse_structure_mat = current_mat;
       }
 
       // WARNING: unlike Matrix<Scalar>::alloc(), Vector<Scalar>::alloc(ndof) frees the memory occupied
@@ -873,6 +1256,25 @@ namespace Hermes
       // save space seq numbers and weakform seq number, so we can detect their changes
       for (unsigned int i = 0; i < wf->get_neq(); i++)
         sp_seq[i] = spaces[i]->get_seq();
+
+      // Store the structure for later reuse.
+#ifdef WITH_UMFPACK
+      CSCMatrix<Scalar>* csc_mat = dynamic_cast<CSCMatrix<Scalar>*>(current_mat);
+      if(csc_mat != NULL)
+      {
+        delete_sparse_structure();
+        sparse_structure_Ap = new int[this->ndof + 1];
+        memcpy(sparse_structure_Ap, csc_mat->get_Ap(), (this->ndof + 1) * sizeof(int));
+        sparse_structure_Ai = new int[csc_mat->get_nnz()];
+        memcpy(sparse_structure_Ai, csc_mat->get_Ai(), csc_mat->get_nnz() * sizeof(int));
+        sparse_structure_sp_seq = new int[wf->get_neq()];
+        memcpy(sparse_structure_sp_seq, sp_seq, wf->get_neq() * sizeof(int));
+        sparse_structure_versions = new uint64_t[wf->get_neq()];
+        for (unsigned int i = 0; i < wf->get_neq(); i++)
+          sparse_structure_versions[i] = spaces[i]->get_version();
+        sparse_structure_force_diagonal_blocks = current_force_diagonal_blocks;
+      }
+#endif
     }
 
     template<typename Scalar>
@@ -893,29 +1295,25 @@ namespace Hermes
     template<typename Scalar>
     void DiscreteProblem<Scalar>::init_assembling(Scalar* coeff_vec, PrecalcShapeset*** pss , PrecalcShapeset*** spss, RefMap*** refmaps, Solution<Scalar>*** u_ext, AsmList<Scalar>*** als, WeakForm<Scalar>** weakforms)
     {
+      // The precalculated shapesets, reference maps and assembly lists of the previous assembling if they fit.
+      init_thread_contexts();
       for(unsigned int i = 0; i < Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads); i++)
       {
-        pss[i] = new PrecalcShapeset*[wf->get_neq()];
-        for (unsigned int j = 0; j < wf->get_neq(); j++)
-          pss[i][j] = new PrecalcShapeset(spaces[j]->shapeset);
-      }
-      for(unsigned int i = 0; i < Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads); i++)
-      {
-        spss[i] = new PrecalcShapeset*[wf->get_neq()];
-        for (unsigned int j = 0; j < wf->get_neq(); j++)
-          spss[i][j] = new PrecalcShapeset(pss[i][j]);
+        pss[i] = context_pss[i];
+        spss[i] = context_spss[i];
+        refmaps[i] = context_refmaps[i];
+        als[i] = context_als[i];
       }
-      for(unsigned int i = 0; i < Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads); i++)
+
+      // U_ext functions, the volumetric values are calculated from the coefficients directly (see init_u_ext_fn()),
+      // the Solutions are there for the orders of the forms and for the surface and DG forms.
+      if(!is_linear && coeff_vec != NULL)
       {
-        refmaps[i] = new RefMap*[wf->get_neq()];
-        for (unsigned int j = 0; j < wf->get_neq(); j++)
-        {
-          refmaps[i][j] = new RefMap();
-          refmaps[i][j]->set_quad_2d(&g_quad_2d_std);
-        }
+        u_ext_coeff_vec = coeff_vec;
+        u_ext_dof_offsets = new int[wf->get_neq()];
+        for (int j = 0; j < wf->get_neq(); j++)
+          u_ext_dof_offsets[j] = Space<Scalar>::get_dof_offset(spaces, j);
       }
-
-      // U_ext functions
       if(!is_linear)
         for(unsigned int i = 0; i < Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads); i++)
         {
@@ -924,20 +1322,19 @@ namespace Hermes
             u_ext[i] = new Solution<Scalar>*[wf->get_neq()];
             if(i == 0)
             {
-              int first_dof = 0;
               for (int j = 0; j < wf->get_neq(); j++)
               {
                 u_ext[i][j] = new Solution<Scalar>(spaces[j]->get_mesh());
-                Solution<Scalar>::vector_to_solution(coeff_vec, spaces[j], u_ext[i][j], !RungeKutta, first_dof);
-                first_dof += spaces[j]->get_num_dofs();
+                Solution<Scalar>::vector_to_solution(coeff_vec, spaces[j], u_ext[i][j], !RungeKutta, Space<Scalar>::get_dof_offset(spaces, j));
               }
             }
             else
             {
+              // The threads evaluate the coefficients of the first one, see Solution::clone().
               for (int j = 0; j < wf->get_neq(); j++)
               {
                 u_ext[i][j] = new Solution<Scalar>(spaces[j]->get_mesh());
-                u_ext[i][j]->copy(u_ext[0][j]);
+                u_ext[i][j]->share_coeffs(u_ext[0][j]);
               }
             }
           }
@@ -954,19 +1351,35 @@ namespace Hermes
           }
         }
 
-        // Assembly lists
-        for(unsigned int i = 0; i < Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads); i++)
+        // Weakforms, the clones of the previous assembling are reused while wf is not modified,
+        // only the times, the base attributes of the forms and the external functions are taken over again.
+        int num_threads_used = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
+        if(weakform_clones != NULL && (weakform_clones_wf != this->wf || weakform_clones_modification != this->wf->get_modification_count() || weakform_clones_count != num_threads_used))
+          free_weakform_clones();
+        if(weakform_clones == NULL)
         {
-          als[i] = new AsmList<Scalar>*[wf->get_neq()];
-          for (unsigned int j = 0; j < wf->get_neq(); j++)
-            als[i][j] = new AsmList<Scalar>();
+          weakform_clones = new WeakForm<Scalar>*[num_threads_used];
+          for(int i = 0; i < num_threads_used; i++)
+          {
+            weakform_clones[i] = this->wf->clone();
+            weakform_clones[i]->cloneMembers(this->wf);
+          }
+          weakform_clones_count = num_threads_used;
+          weakform_clones_wf = this->wf;
+          weakform_clones_modification = this->wf->get_modification_count();
         }
-
-        // Weakforms.
-        for(unsigned int i = 0; i < Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads); i++)
+        else
+        {
+          for(int i = 0; i < num_threads_used; i++)
+          {
+            weakform_clones[i]->sync_with(this->wf);
+            weakform_clones[i]->clone_ext(this->wf);
+          }
+        }
+        for(int i = 0; i < num_threads_used; i++)
         {
-          weakforms[i] = this->wf->clone();
-          weakforms[i]->cloneMembers(this->wf);
+          weakforms[i] = weakform_clones[i];
+          resolve_form_markers(weakforms[i]);
         }
 
         assert(cache_element_stored == NULL);
@@ -981,29 +1394,15 @@ namespace Hermes
     template<typename Scalar>
     void DiscreteProblem<Scalar>::deinit_assembling(PrecalcShapeset*** pss , PrecalcShapeset*** spss, RefMap*** refmaps, Solution<Scalar>*** u_ext, AsmList<Scalar>*** als, WeakForm<Scalar>** weakforms)
     {
-      for(unsigned int i = 0; i < Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads); i++)
-      {
-        for (unsigned int j = 0; j < wf->get_neq(); j++)
-          delete pss[i][j];
-        delete [] pss[i];
-      }
+      // The precalculated shapesets, reference maps and assembly lists stay in the thread contexts for the next assembling.
       delete [] pss;
-
-      for(unsigned int i = 0; i < Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads); i++)
-      {
-        for (unsigned int j = 0; j < wf->get_neq(); j++)
-          delete spss[i][j];
-        delete [] spss[i];
-      }
       delete [] spss;
-
-      for(unsigned int i = 0; i < Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads); i++)
-      {
-        for (unsigned int j = 0; j < wf->get_neq(); j++)
-          delete refmaps[i][j];
-        delete [] refmaps[i];
-      }
       delete [] refmaps;
+      delete [] als;
+
+      u_ext_coeff_vec = NULL;
+      delete [] u_ext_dof_offsets;
+      u_ext_dof_offsets = NULL;
 
       if(u_ext != NULL)
       {
@@ -1019,19 +1418,9 @@ namespace Hermes
         delete [] u_ext;
       }
 
+      // The weakforms themselves stay in weakform_clones for the next assembling.
       for(unsigned int i = 0; i < Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads); i++)
-      {
-        for (unsigned int j = 0; j < wf->get_neq(); j++)
-          delete als[i][j];
-        delete [] als[i];
-      }
-      delete [] als;
-
-      for(unsigned int i = 0; i < Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads); i++)
-      {
         weakforms[i]->free_ext();
-        delete weakforms[i];
-      }
       delete [] weakforms;
 
       for(unsigned int i = 0; i < this->spaces_size; i++)
@@ -1041,891 +1430,2576 @@ namespace Hermes
     }
 
     template<typename Scalar>
-    void DiscreteProblem<Scalar>::assemble(Scalar* coeff_vec, SparseMatrix<Scalar>* mat, Vector<Scalar>* rhs, bool force_diagonal_blocks, Table* block_weights)
+    Hermes::vector<int> DiscreteProblem<Scalar>::group_states(Traverse::State** states, int num_states)
     {
-      // Check.
-      this->check();
-      if(this->ndof == 0)
-        throw Exceptions::Exception("Zero DOFs detected in DiscreteProblem::assemble().");
+      Hermes::vector<int> state_groups;
+      state_groups.push_back(0);
 
-      // Important, sets the current caughtException to NULL.
-      this->caughtException = NULL;
+      // Over-edge (DG) forms insert also into the DOFs of the neighbors, those are not captured by the coloring.
+      if(Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::assemblingMode) != H2D_ASSEMBLING_COLORED || DG_matrix_forms_present || DG_vector_forms_present)
+      {
+        state_groups.push_back(num_states);
+        return state_groups;
+      }
 
-      current_mat = mat;
-      current_rhs = rhs;
-      current_force_diagonal_blocks = force_diagonal_blocks;
-      current_block_weights = block_weights;
+      // DOFs of all spaces on all the states.
+      int* state_dofs_offsets = new int[num_states + 1];
+      Hermes::vector<int> state_dofs;
+      AsmList<Scalar> al;
+      state_dofs_offsets[0] = 0;
+      for(int state_i = 0; state_i < num_states; state_i++)
+      {
+        for(unsigned int space_i = 0; space_i < this->spaces_size; space_i++)
+          if(states[state_i]->e[space_i] != NULL)
+          {
+            spaces[space_i]->get_element_assembly_list(states[state_i]->e[space_i], &al, spaces_first_dofs[space_i]);
+            for(unsigned int i = 0; i < al.cnt; i++)
+              if(al.dof[i] >= 0)
+                state_dofs.push_back(al.dof[i]);
+          }
+        state_dofs_offsets[state_i + 1] = state_dofs.size();
+      }
 
-      // Check that the block scaling table have proper dimension.
-      if(block_weights != NULL)
-        if(block_weights->get_size() != wf->get_neq())
-          throw Exceptions::LengthException(6, block_weights->get_size(), wf->get_neq());
-
-      // Creating matrix sparse structure.
-      create_sparse_structure();
-
-      // Initial check of meshes and spaces.
-      for(unsigned int ext_i = 0; ext_i < this->wf->ext.size(); ext_i++)
+      // Greedy coloring: the states are taken in the traversal order, a state joins the current color
+      // if none of its DOFs has already been marked by this color.
+      int* dof_colors = new int[this->ndof];
+      for(int i = 0; i < this->ndof; i++)
+        dof_colors[i] = -1;
+      bool* state_colored = new bool[num_states];
+      memset(state_colored, 0, num_states * sizeof(bool));
+      Traverse::State** colored_states = new Traverse::State*[num_states];
+
+      int colored_count = 0;
+      int first_uncolored = 0;
+      for(int color = 0; colored_count < num_states; color++)
       {
-        if(!this->wf->ext[ext_i]->isOkay())
-          throw Hermes::Exceptions::Exception("Ext function %d is not okay in assemble().", ext_i);
-      }
-
-      // Structures that cloning will be done into.
-      PrecalcShapeset*** pss = new PrecalcShapeset**[Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads)];
-      PrecalcShapeset*** spss = new PrecalcShapeset**[Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads)];
-      RefMap*** refmaps = new RefMap**[Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads)];
-      Solution<Scalar>*** u_ext = new Solution<Scalar>**[Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads)];
-      AsmList<Scalar>*** als = new AsmList<Scalar>**[Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads)];
-      WeakForm<Scalar>** weakforms = new WeakForm<Scalar>*[Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads)];
-
-      // Fill these structures.
-      init_assembling(coeff_vec, pss, spss, refmaps, u_ext, als, weakforms);
-
-      // Vector of meshes.
-      Hermes::vector<const Mesh*> meshes;
-      for(unsigned int space_i = 0; space_i < spaces.size(); space_i++)
-        meshes.push_back(spaces[space_i]->get_mesh());
-      for(unsigned int ext_i = 0; ext_i < this->wf->ext.size(); ext_i++)
-        meshes.push_back(this->wf->ext[ext_i]->get_mesh());
-      for(unsigned int form_i = 0; form_i < this->wf->get_forms().size(); form_i++)
-        for(unsigned int ext_i = 0; ext_i < this->wf->get_forms()[form_i]->ext.size(); ext_i++)
-          if(this->wf->get_forms()[form_i]->ext[ext_i] != NULL)
-            meshes.push_back(this->wf->get_forms()[form_i]->ext[ext_i]->get_mesh());
-      for(unsigned int space_i = 0; space_i < spaces.size(); space_i++)
-        meshes.push_back(spaces[space_i]->get_mesh());
-
-      Traverse trav_master(true);
-      unsigned int num_states = trav_master.get_num_states(meshes);
+        while(state_colored[first_uncolored])
+          first_uncolored++;
 
-      trav_master.begin(meshes.size(), &(meshes.front()));
-
-      Traverse* trav = new Traverse[Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads)];
-      Hermes::vector<Transformable *>* fns = new Hermes::vector<Transformable *>[Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads)];
-      for(unsigned int i = 0; i < Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads); i++)
-      {
-        for (unsigned j = 0; j < spaces.size(); j++)
-          fns[i].push_back(pss[i][j]);
-        for (unsigned j = 0; j < this->wf->ext.size(); j++)
-        {
-          fns[i].push_back(weakforms[i]->ext[j]);
-          weakforms[i]->ext[j]->set_quad_2d(&g_quad_2d_std);
-        }
-        for(unsigned int form_i = 0; form_i < this->wf->get_forms().size(); form_i++)
+        for(int state_i = first_uncolored; state_i < num_states; state_i++)
         {
-          for(unsigned int ext_i = 0; ext_i < this->wf->get_forms()[form_i]->ext.size(); ext_i++)
-            if(this->wf->get_forms()[form_i]->ext[ext_i] != NULL)
+          if(state_colored[state_i])
+            continue;
+
+          bool conflict = false;
+          for(int i = state_dofs_offsets[state_i]; i < state_dofs_offsets[state_i + 1]; i++)
+            if(dof_colors[state_dofs[i]] == color)
             {
-              fns[i].push_back(weakforms[i]->get_forms()[form_i]->ext[ext_i]);
-              weakforms[i]->get_forms()[form_i]->ext[ext_i]->set_quad_2d(&g_quad_2d_std);
+              conflict = true;
+              break;
             }
+          if(conflict)
+            continue;
+
+          for(int i = state_dofs_offsets[state_i]; i < state_dofs_offsets[state_i + 1]; i++)
+            dof_colors[state_dofs[i]] = color;
+          state_colored[state_i] = true;
+          colored_states[colored_count++] = states[state_i];
         }
-        for (unsigned j = 0; j < wf->get_neq(); j++)
-        {
-          fns[i].push_back(u_ext[i][j]);
-          u_ext[i][j]->set_quad_2d(&g_quad_2d_std);
-        }
-        trav[i].begin(meshes.size(), &(meshes.front()), &(fns[i].front()));
-        trav[i].stack = trav_master.stack;
+        state_groups.push_back(colored_count);
       }
 
-      int state_i;
+      memcpy(states, colored_states, num_states * sizeof(Traverse::State*));
 
-      PrecalcShapeset** current_pss;
-      PrecalcShapeset** current_spss;
-      RefMap** current_refmaps;
-      Solution<Scalar>** current_u_ext;
-      AsmList<Scalar>** current_als;
-      WeakForm<Scalar>* current_weakform;
+      delete [] colored_states;
+      delete [] state_colored;
+      delete [] dof_colors;
+      delete [] state_dofs_offsets;
 
-#define CHUNKSIZE 1
-      int num_threads_used = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
-#pragma omp parallel shared(trav_master, mat, rhs ) private(state_i, current_pss, current_spss, current_refmaps, current_u_ext, current_als, current_weakform) num_threads(num_threads_used)
-      {
-#pragma omp for schedule(static, CHUNKSIZE)
-        for(state_i = 0; state_i < num_states; state_i++)
-        {
-          if(this->caughtException != NULL)
-            continue;
-          try
-          {
-            Traverse::State current_state;
-#pragma omp critical (get_next_state)
-            {
-              try
-              {
-                current_state = trav[omp_get_thread_num()].get_next_state(&trav_master.top, &trav_master.id);
-              }
-              catch(Hermes::Exceptions::Exception& e)
-              {
-                if(this->caughtException == NULL)
-                  this->caughtException = e.clone();
-              }
-              catch(std::exception& e)
-              {
-                if(this->caughtException == NULL)
-                  this->caughtException = new Hermes::Exceptions::Exception(e.what());
-              }
-            }
+      return state_groups;
+    }
 
-            current_pss = pss[omp_get_thread_num()];
-            current_spss = spss[omp_get_thread_num()];
-            current_refmaps = refmaps[omp_get_thread_num()];
-            current_u_ext = u_ext[omp_get_thread_num()];
-            current_als = als[omp_get_thread_num()];
-            current_weakform = weakforms[omp_get_thread_num()];
+    template<typename Scalar>
+    const Hermes::vector<int>& DiscreteProblem<Scalar>::get_state_groups(bool states_changed)
+    {
+      int mode = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::assemblingMode);
+      bool up_to_date = !states_changed && !this->state_groups.empty() && this->state_groups_mode == mode && this->state_groups_sp_seq.size() == this->spaces_size;
+      for(unsigned int i = 0; i < this->spaces_size && up_to_date; i++)
+        if(this->state_groups_sp_seq[i] != this->spaces[i]->get_seq())
+          up_to_date = false;
+      if(up_to_date)
+        return this->state_groups;
 
-            // One state is a collection of (virtual) elements sharing
-            // the same physical location on (possibly) different meshes.
-            // This is then the same element of the virtual union mesh.
-            // The proper sub-element mappings to all the functions of
-            // this stage is supplied by the function Traverse::get_next_state()
-            // called in the while loop.
-            assemble_one_state(current_pss, current_spss, current_refmaps, current_u_ext, current_als, &current_state, current_weakform);
+      this->state_groups = group_states(traverse_states.get_states(), traverse_states.get_num_states());
+      this->state_groups_mode = mode;
+      this->state_groups_sp_seq.clear();
+      for(unsigned int i = 0; i < this->spaces_size; i++)
+        this->state_groups_sp_seq.push_back(this->spaces[i]->get_seq());
+      return this->state_groups;
+    }
 
-            if(DG_matrix_forms_present || DG_vector_forms_present)
-              assemble_one_DG_state(current_pss, current_spss, current_refmaps, current_als, &current_state, current_weakform->mfDG, current_weakform->vfDG, trav[omp_get_thread_num()].fn, current_weakform);
-          }
-          catch(Hermes::Exceptions::Exception& e)
-          {
-            if(this->caughtException == NULL)
-              this->caughtException = e.clone();
-          }
-          catch(std::exception& e)
-          {
-            if(this->caughtException == NULL)
-              this->caughtException = new Hermes::Exceptions::Exception(e.what());
-          }
-        }
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::init_thread_local_assembling()
+    {
+      int mode = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::assemblingMode);
+      colored_mat_values = NULL;
+      colored_rhs_values = NULL;
+
+      // The states are not colored with DG forms (see group_states()), the insertion stays synchronized then.
+      if(mode == H2D_ASSEMBLING_COLORED && !DG_matrix_forms_present && !DG_vector_forms_present)
+      {
+#ifdef WITH_UMFPACK
+        CSCMatrix<Scalar>* csc_mat = dynamic_cast<CSCMatrix<Scalar>*>(current_mat);
+        if(csc_mat != NULL)
+          colored_mat_values = csc_mat->get_Ax();
+        UMFPackVector<Scalar>* umfpack_rhs = dynamic_cast<UMFPackVector<Scalar>*>(current_rhs);
+        if(umfpack_rhs != NULL)
+          colored_rhs_values = umfpack_rhs->get_c_array();
+#endif
+        return;
       }
 
-      deinit_assembling(pss, spss, refmaps, u_ext, als, weakforms);
+      if(mode != H2D_ASSEMBLING_THREAD_LOCAL)
+        return;
 
-      trav_master.finish();
-      for(unsigned int i = 0; i < Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads); i++)
-        trav[i].finish();
+      int num_threads = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
 
-      for(unsigned int i = 0; i < Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads); i++)
+#ifdef WITH_UMFPACK
+      CSCMatrix<Scalar>* csc_mat = dynamic_cast<CSCMatrix<Scalar>*>(current_mat);
+      if(csc_mat != NULL)
       {
-        fns[i].clear();
+        thread_mat_values = new Scalar*[num_threads];
+        // The first thread assembles directly into the matrix.
+        thread_mat_values[0] = csc_mat->get_Ax();
+        for(int i = 1; i < num_threads; i++)
+          thread_mat_values[i] = new Scalar[csc_mat->get_nnz()];
       }
-      delete [] fns;
-      delete [] trav;
+#endif
 
-      /// \todo Should this be really here? Or in assemble()?
-      if(current_mat != NULL)
-        current_mat->finish();
       if(current_rhs != NULL)
-        current_rhs->finish();
+      {
+        thread_rhs_values = new Scalar*[num_threads];
+        for(int i = 0; i < num_threads; i++)
+          thread_rhs_values[i] = new Scalar[this->ndof];
+      }
 
-      if(DG_matrix_forms_present || DG_vector_forms_present)
+      // With numaFirstTouch, every thread zeroes its own values, which are then in the memory of its NUMA node.
+      int mat_nnz = (thread_mat_values != NULL) ? current_mat->get_nnz() : 0;
+      int num_zeroing_threads = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numaFirstTouch) ? num_threads : 1;
+#pragma omp parallel for schedule(static, 1) num_threads(num_zeroing_threads)
+      for(int i = 0; i < num_threads; i++)
       {
-        Element* element_to_set_nonvisited;
-        for(unsigned int mesh_i = 0; mesh_i < meshes.size(); mesh_i++)
-          for_all_elements(element_to_set_nonvisited, meshes[mesh_i])
-          element_to_set_nonvisited->visited = false;
+        if(thread_mat_values != NULL && i > 0)
+          memset(thread_mat_values[i], 0, mat_nnz * sizeof(Scalar));
+        if(thread_rhs_values != NULL)
+          memset(thread_rhs_values[i], 0, this->ndof * sizeof(Scalar));
       }
+    }
+
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::init_assembling_arenas()
+    {
+      int num_threads = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
+      if(assembling_arenas_count == num_threads)
+        return;
 
-      if(this->caughtException != NULL)
-        throw *(this->caughtException);
+      delete [] assembling_arenas;
+      assembling_arenas = new MemoryArena[num_threads];
+      assembling_arenas_count = num_threads;
     }
 
     template<typename Scalar>
-    void DiscreteProblem<Scalar>::assemble(Scalar* coeff_vec, Vector<Scalar>* rhs,
-      bool force_diagonal_blocks, Table* block_weights)
+    MemoryArena* DiscreteProblem<Scalar>::get_assembling_arena()
     {
-      assemble(coeff_vec, NULL, rhs, force_diagonal_blocks, block_weights);
+      return &assembling_arenas[omp_get_thread_num()];
     }
 
     template<typename Scalar>
-    DiscreteProblem<Scalar>::CacheRecordPerSubIdx::CacheRecordPerSubIdx() : fnsSurface(NULL)
+    void DiscreteProblem<Scalar>::init_reference_integrals()
     {
+      int num_threads = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
+      if(reference_integrals_count == num_threads)
+        return;
+
+      delete [] reference_integrals;
+      reference_integrals = new ReferenceIntegrals[num_threads];
+      reference_integrals_count = num_threads;
     }
 
     template<typename Scalar>
-    void DiscreteProblem<Scalar>::CacheRecordPerSubIdx::clear()
+    void DiscreteProblem<Scalar>::init_form_values_buffers()
     {
-      for(unsigned int i = 0; i < this->asmlistCnt; i++)
+      int num_threads = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
+      if(form_values_buffers_count == num_threads)
+        return;
+
+      delete [] form_values_buffers;
+      form_values_buffers = new FormValuesBuffer[num_threads];
+      form_values_buffers_count = num_threads;
+    }
+
+    template<typename Scalar>
+    Scalar** DiscreteProblem<Scalar>::get_form_values_buffer(unsigned int m, unsigned int n)
+    {
+      if(m == 0 || n == 0)
+        return NULL;
+
+      // The forms fill all the values (see MatrixFormVol::value_all()), only the rows are set for the block.
+      FormValuesBuffer& buffer = form_values_buffers[omp_get_thread_num()];
+      if(buffer.values.size() < m * n)
+        buffer.values.resize(m * n);
+      if(buffer.rows.size() < m)
+        buffer.rows.resize(m);
+      for(unsigned int i = 0; i < m; i++)
+        buffer.rows[i] = &buffer.values[i * n];
+      return &buffer.rows.front();
+    }
+
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::init_element_batches()
+    {
+      if(element_batch_kernel == NULL)
+        return;
+
+      int num_threads = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
+      if(element_batches_count != num_threads)
       {
-        this->fns[i]->free_fn();
-        delete this->fns[i];
+        free_element_batches();
+        element_batches = new ElementBatches[num_threads];
+        for(int i = 0; i < num_threads; i++)
+          element_batches[i].form_values = NULL;
+        element_batches_count = num_threads;
       }
-      delete [] this->fns;
 
-      delete [] this->jacobian_x_weights;
-      this->geometry->free();
-      delete this->geometry;
+      // The shapesets and the weak formulation may have changed since the last assembling.
+      batch_shape_tables.clear();
+      element_batch_kernel->clear_shape_tables();
+    }
 
-      if(this->fnsSurface != NULL)
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::free_element_batches()
+    {
+      for(int thread_i = 0; thread_i < element_batches_count; thread_i++)
       {
-        for(unsigned int edge_i = 0; edge_i < nvert; edge_i++)
+        typename std::map<std::pair<MatrixFormVol<Scalar>*, std::pair<int, int> >, ElementBatch*>::iterator it;
+        for(it = element_batches[thread_i].batches.begin(); it != element_batches[thread_i].batches.end(); it++)
         {
-          if(this->fnsSurface[edge_i] == NULL)
-            continue;
-          delete [] this->jacobian_x_weightsSurface[edge_i];
-          this->geometrySurface[edge_i]->free();
-          delete this->geometrySurface[edge_i];
-
-          for(unsigned int i = 0; i < this->asmlistSurfaceCnt[edge_i]; i++)
+          for(unsigned int k = 0; k < it->second->states.size(); k++)
           {
-            this->fnsSurface[edge_i][i]->free_fn();
-            delete this->fnsSurface[edge_i][i];
+            delete it->second->als_i[k];
+            delete it->second->als_j[k];
           }
-          delete [] this->fnsSurface[edge_i];
+          delete it->second;
         }
+      }
+      delete [] element_batches;
+      element_batches = NULL;
+      element_batches_count = 0;
+    }
 
-        delete [] this->fnsSurface;
-        delete [] this->geometrySurface;
-        delete [] this->jacobian_x_weightsSurface;
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::init_form_orders()
+    {
+      // The orders of the forms may change between the assemblings (e.g. with the time).
+      int num_threads = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
+      if(form_orders_count != num_threads)
+      {
+        delete [] form_orders;
+        form_orders = new FormOrders[num_threads];
+        form_orders_count = num_threads;
+      }
+      for(int i = 0; i < num_threads; i++)
+        form_orders[i].clear();
+    }
 
-        delete [] this->n_quadrature_pointsSurface;
-        delete [] this->orderSurface;
-        delete [] this->asmlistSurfaceCnt;
+    template<typename Scalar>
+    DiscreteProblem<Scalar>::ReferenceIntegrals::ReferenceIntegrals() : last_table_key(-1), last_table(NULL)
+    {
+    }
 
-        this->fnsSurface = NULL;
-      }
+    template<typename Scalar>
+    DiscreteProblem<Scalar>::ReferenceIntegrals::~ReferenceIntegrals()
+    {
+      for(std::map<int, PrecalcShapeset*>::iterator it = pss.begin(); it != pss.end(); it++)
+        delete it->second;
+      for(std::map<int, QuadTensorFactors*>::iterator it = tensor_factors.begin(); it != tensor_factors.end(); it++)
+        delete it->second;
     }
 
     template<typename Scalar>
-    void DiscreteProblem<Scalar>::CacheRecordPerElement::clear()
+    QuadTensorFactors* DiscreteProblem<Scalar>::ReferenceIntegrals::split(Shapeset* shapeset, int role, Element* e, int order, AsmList<Scalar>* als, int* x_factors, int* y_factors, double* scales)
     {
-      delete [] this->asmlistIdx;
+      QuadTensorFactors*& factors = tensor_factors[shapeset->get_id() * (g_quad_2d_std.get_max_order(HERMES_MODE_QUAD) + 1) + order];
+      if(factors == NULL)
+        factors = new QuadTensorFactors(order);
+
+      PrecalcShapeset* shapeset_pss = get_pss(shapeset, role, e);
+      for(unsigned int i = 0; i < als->cnt; i++)
+        if(als->idx[i] < 0 || !factors->get(shapeset_pss, als->idx[i], x_factors[i], y_factors[i], scales[i]))
+          return NULL;
+      return factors;
     }
 
     template<typename Scalar>
-    bool DiscreteProblem<Scalar>::state_needs_recalculation(AsmList<Scalar>** current_als, Traverse::State* current_state)
+    PrecalcShapeset* DiscreteProblem<Scalar>::ReferenceIntegrals::get_pss(Shapeset* shapeset, int role, Element* e)
     {
-      for(unsigned int i = 0; i < this->spaces_size; i++)
-      {
-        if(current_state->e[i] == NULL)
-          continue;
-        if(this->spaces[i]->edata[current_state->e[i]->id].changed_in_last_adaptation)
-          return true;
+      PrecalcShapeset*& shapeset_pss = pss[2 * shapeset->get_id() + role];
+      if(shapeset_pss == NULL)
+        shapeset_pss = new PrecalcShapeset(shapeset);
+      shapeset_pss->set_active_element(e);
+      return shapeset_pss;
+    }
 
-        // Check of potential new constraints.
-        if(!this->do_not_use_cache)
-        {
-          if(this->cache_records_element[i][current_state->e[i]->id] != NULL)
-          {
-            if(this->cache_records_element[i][current_state->e[i]->id]->asmlistCnt != current_als[i]->cnt)
-              return true;
-            else
-            {
-              for(unsigned int idx_i = 0; idx_i < current_als[i]->cnt; idx_i++)
-                if(current_als[i]->idx[idx_i] != this->cache_records_element[i][current_state->e[i]->id]->asmlistIdx[idx_i])
-                  return true;
-            }
-          }
-          else
-            return true;
-        }
-      }
-      return false;
+    template<typename Scalar>
+    const ReferenceIntegralTable* DiscreteProblem<Scalar>::ReferenceIntegrals::get_table(Shapeset* shapeset, ElementMode2D mode)
+    {
+      int key = 2 * shapeset->get_id() + mode;
+      if(key == last_table_key)
+        return last_table;
+
+      std::map<int, const ReferenceIntegralTable*>::iterator it = tables.find(key);
+      if(it == tables.end())
+        it = tables.insert(std::pair<int, const ReferenceIntegralTable*>(key, ReferenceIntegralTable::find(shapeset, mode))).first;
+      last_table_key = key;
+      last_table = it->second;
+      return last_table;
     }
 
     template<typename Scalar>
-    void DiscreteProblem<Scalar>::calculate_cache_records(PrecalcShapeset** current_pss, PrecalcShapeset** current_spss, RefMap** current_refmaps, Solution<Scalar>** current_u_ext, AsmList<Scalar>** current_als, Traverse::State* current_state,
-      AsmList<Scalar>** current_alsSurface, WeakForm<Scalar>* current_wf)
+    const double* DiscreteProblem<Scalar>::ReferenceIntegrals::get(Shapeset* shapeset_u, int index_u, Shapeset* shapeset_v, int index_v, Element* e)
     {
-      for(unsigned int space_i = 0; space_i < this->spaces_size; space_i++)
+      ElementMode2D mode = e->get_mode();
+      if(shapeset_u->get_id() == shapeset_v->get_id())
       {
-        bool new_cache = false;
-        if(current_state->e[space_i] == NULL)
-          continue;
+        const ReferenceIntegralTable* table = get_table(shapeset_u, mode);
+        if(table != NULL && index_u <= table->get_max_index() && index_v <= table->get_max_index())
+          return table->get(index_u, index_v);
+      }
 
-        // No sub_idx map for this element.
-#pragma omp critical (cache_records_sub_idx_map)
-        {
-          try
-          {
-            if(this->cache_records_sub_idx[space_i][current_state->e[space_i]->id] == NULL)
-            {
-              this->cache_records_sub_idx[space_i][current_state->e[space_i]->id] = new std::map<uint64_t, CacheRecordPerSubIdx*>;
-              new_cache = true;
-            }
-            else
-            {
-              // If the sub_idx map exists AND contains a record for this sub_idx, we need to delete the record.
-              typename std::map<uint64_t, CacheRecordPerSubIdx*>::iterator it = this->cache_records_sub_idx[space_i][current_state->e[space_i]->id]->find(current_state->sub_idx[space_i]);
-              if(it != this->cache_records_sub_idx[space_i][current_state->e[space_i]->id]->end())
-                (*it).second->clear();
-              else new_cache = true;
-            }
+      uint64_t key = ((((uint64_t)shapeset_u->get_id() << 8 | shapeset_v->get_id()) << 1 | mode) << 48) | ((uint64_t)index_u << 24) | (uint64_t)index_v;
+      typename std::map<uint64_t, Values>::iterator it = integrals.find(key);
+      if(it != integrals.end())
+        return it->second.v;
 
-            // Insert the new record.
-            if(new_cache)
-              this->cache_records_sub_idx[space_i][current_state->e[space_i]->id]->insert(std::pair<uint64_t, CacheRecordPerSubIdx*>(current_state->sub_idx[space_i], new CacheRecordPerSubIdx));
-          }
-          catch(Hermes::Exceptions::Exception& e)
-          {
-            if(this->caughtException == NULL)
-              this->caughtException = e.clone();
-          }
-          catch(std::exception& e)
-          {
-            if(this->caughtException == NULL)
-              this->caughtException = new Hermes::Exceptions::Exception(e.what());
-          }
-        }
-        if(this->caughtException != NULL)
-          return;
+      // The products are polynomials, the rule of their degree integrates them exactly.
+      int order_u = shapeset_u->get_order(index_u, mode), order_v = shapeset_v->get_order(index_v, mode);
+      int order;
+      if(mode == HERMES_MODE_TRIANGLE)
+        order = order_u + order_v;
+      else
+        order = std::max(H2D_GET_H_ORDER(order_u) + H2D_GET_H_ORDER(order_v), H2D_GET_V_ORDER(order_u) + H2D_GET_V_ORDER(order_v));
+      limit_order_nowarn(order, mode);
+
+      PrecalcShapeset* pss_u = get_pss(shapeset_u, 0, e);
+      PrecalcShapeset* pss_v = get_pss(shapeset_v, 1, e);
+      pss_u->set_active_shape(index_u);
+      pss_u->set_quad_order(order);
+      pss_v->set_active_shape(index_v);
+      pss_v->set_quad_order(order);
+
+      double *u_val = pss_u->get_fn_values(), *u_dx = pss_u->get_dx_values(), *u_dy = pss_u->get_dy_values();
+      double *v_val = pss_v->get_fn_values(), *v_dx = pss_v->get_dx_values(), *v_dy = pss_v->get_dy_values();
+      double3* pt = g_quad_2d_std.get_points(order, mode);
+      int np = g_quad_2d_std.get_num_points(order, mode);
+
+      Values values;
+      memset(values.v, 0, sizeof(values.v));
+      for(int i = 0; i < np; i++)
+      {
+        values.v[0] += pt[i][2] * u_val[i] * v_val[i];
+        values.v[1] += pt[i][2] * u_dx[i] * v_dx[i];
+        values.v[2] += pt[i][2] * (u_dx[i] * v_dy[i] + u_dy[i] * v_dx[i]);
+        values.v[3] += pt[i][2] * u_dy[i] * v_dy[i];
       }
 
-      // Order calculation.
-      int order = this->wf->global_integration_order_set ? this->wf->global_integration_order : 0;
-      if(order == 0)
-      {
-        Hermes::vector<MatrixFormVol<Scalar>*> current_mfvol = current_wf->mfvol;
-        Hermes::vector<VectorFormVol<Scalar>*> current_vfvol = current_wf->vfvol;
-
-        for(int current_mfvol_i = 0; current_mfvol_i < current_mfvol.size(); current_mfvol_i++)
-        {
-          if(!form_to_be_assembled(current_mfvol[current_mfvol_i], current_state))
-            continue;
-          current_mfvol[current_mfvol_i]->wf = current_wf;
-          int orderTemp = calc_order_matrix_form(current_mfvol[current_mfvol_i], current_refmaps, current_u_ext, current_state);
-          if(order < orderTemp)
-            order = orderTemp;
-        }
-
-        for(int current_vfvol_i = 0; current_vfvol_i < current_vfvol.size(); current_vfvol_i++)
-        {
-          if(!form_to_be_assembled(current_vfvol[current_vfvol_i], current_state))
-            continue;
-          current_vfvol[current_vfvol_i]->wf = current_wf;
-          int orderTemp = calc_order_vector_form(current_vfvol[current_vfvol_i], current_refmaps, current_u_ext, current_state);
-          if(order < orderTemp)
-            order = orderTemp;
-        }
-
-        if(current_state->isBnd)
-        {
-          for(int current_mfvol_i = 0; current_mfvol_i < current_mfvol.size(); current_mfvol_i++)
-          {
-            if(!form_to_be_assembled(current_mfvol[current_mfvol_i], current_state))
-              continue;
-            current_mfvol[current_mfvol_i]->wf = current_wf;
-            int orderTemp = calc_order_matrix_form(current_mfvol[current_mfvol_i], current_refmaps, current_u_ext, current_state);
-            if(order < orderTemp)
-              order = orderTemp;
-          }
-          for(int current_vfvol_i = 0; current_vfvol_i < current_vfvol.size(); current_vfvol_i++)
-          {
-            if(!form_to_be_assembled(current_vfvol[current_vfvol_i], current_state))
-              continue;
-            current_vfvol[current_vfvol_i]->wf = current_wf;
-            int orderTemp = calc_order_vector_form(current_vfvol[current_vfvol_i], current_refmaps, current_u_ext, current_state);
-            if(order < orderTemp)
-              order = orderTemp;
-          }
-        }
+      return integrals.insert(std::pair<uint64_t, Values>(key, values)).first->second.v;
+    }
 
-        // Surface forms.
-        if(current_state->isBnd && (current_wf->mfsurf.size() > 0 || current_wf->vfsurf.size() > 0))
-        {
-          Hermes::vector<MatrixFormSurf<Scalar>*> current_mfsurf = current_wf->mfsurf;
-          Hermes::vector<VectorFormSurf<Scalar>*> current_vfsurf = current_wf->vfsurf;
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::finish_thread_local_assembling()
+    {
+      colored_mat_values = NULL;
+      colored_rhs_values = NULL;
 
-          for (current_state->isurf = 0; current_state->isurf < current_state->rep->nvert; current_state->isurf++)
-          {
-            if(!current_state->bnd[current_state->isurf])
-              continue;
-            for(int current_mfsurf_i = 0; current_mfsurf_i < current_mfsurf.size(); current_mfsurf_i++)
-            {
-              if(!form_to_be_assembled(current_mfsurf[current_mfsurf_i], current_state))
-                continue;
-              current_mfsurf[current_mfsurf_i]->wf = current_wf;
-              int orderTemp = calc_order_matrix_form(current_mfsurf[current_mfsurf_i], current_refmaps, current_u_ext, current_state);
-              if(order < orderTemp)
-                order = orderTemp;
-            }
+      int num_threads = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
+      int i;
 
-            for(int current_vfsurf_i = 0; current_vfsurf_i < current_vfsurf.size(); current_vfsurf_i++)
-            {
-              if(!form_to_be_assembled(current_vfsurf[current_vfsurf_i], current_state))
-                continue;
-              current_vfsurf[current_vfsurf_i]->wf = current_wf;
-              int orderTemp = calc_order_vector_form(current_vfsurf[current_vfsurf_i], current_refmaps, current_u_ext, current_state);
-              if(order < orderTemp)
-                order = orderTemp;
-            }
-          }
-        }
+      // Every thread sums up one contiguous range of the values.
+#ifdef WITH_UMFPACK
+      if(thread_mat_values != NULL)
+      {
+        int nnz = static_cast<CSCMatrix<Scalar>*>(current_mat)->get_nnz();
+        Scalar* Ax = thread_mat_values[0];
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+        for(i = 0; i < nnz; i++)
+          for(int thread_i = 1; thread_i < num_threads; thread_i++)
+            Ax[i] += thread_mat_values[thread_i][i];
+
+        for(int thread_i = 1; thread_i < num_threads; thread_i++)
+          delete [] thread_mat_values[thread_i];
+        delete [] thread_mat_values;
+        thread_mat_values = NULL;
       }
+#endif
 
-      // Order is known, we know how many integration points we need and we can proceed.
-      // cache record sub idx : new precalcshapeset(spaces->shapeset, element, sub_idx, order, asmlist->idx)
-      for(unsigned int i = 0; i < this->spaces_size; i++)
+      if(thread_rhs_values != NULL)
       {
-        if(current_state->e[i] == NULL)
-          continue;
-        // Is this thread supposed to compute the perElement record?
-        bool computingThread = false;
-        if(!this->cache_element_stored[i][current_state->e[i]->id])
-        {
-#pragma omp critical (cache_for_element_preparation)
-          if(!this->cache_element_stored[i][current_state->e[i]->id])
-          {
-            computingThread = true;
-            this->cache_element_stored[i][current_state->e[i]->id] = true;
-          }
-        }
+        Scalar* rhs_values = thread_rhs_values[0];
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+        for(i = 0; i < this->ndof; i++)
+          for(int thread_i = 1; thread_i < num_threads; thread_i++)
+            rhs_values[i] += thread_rhs_values[thread_i][i];
+
+        current_rhs->add_vector(rhs_values);
+
+        for(int thread_i = 0; thread_i < num_threads; thread_i++)
+          delete [] thread_rhs_values[thread_i];
+        delete [] thread_rhs_values;
+        thread_rhs_values = NULL;
+      }
+    }
 
-        if(computingThread)
-        {
-          if(this->cache_records_element[i][current_state->e[i]->id] == NULL)
-            this->cache_records_element[i][current_state->e[i]->id] = new CacheRecordPerElement;
-          else
-            this->cache_records_element[i][current_state->e[i]->id]->clear();
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::set_process_partition(int rank, int num_ranks, bool sum_matrix)
+    {
+      if(num_ranks < 1)
+        throw Exceptions::ValueException("num_ranks", num_ranks, 1);
+      if(rank < 0 || rank >= num_ranks)
+        throw Exceptions::ValueException("rank", rank, 0, num_ranks - 1);
+      this->partition_rank = rank;
+      this->partition_num_ranks = num_ranks;
+      this->partition_sum_matrix = sum_matrix;
+      this->owned_states_invalid = true;
+    }
 
-          this->cache_records_element[i][current_state->e[i]->id]->asmlistCnt = current_als[i]->cnt;
-          this->cache_records_element[i][current_state->e[i]->id]->asmlistIdx = new int[current_als[i]->cnt];
-          for(unsigned int asmlist_i = 0; asmlist_i < current_als[i]->cnt; asmlist_i++)
-            this->cache_records_element[i][current_state->e[i]->id]->asmlistIdx[asmlist_i] = current_als[i]->idx[asmlist_i];
-          this->cache_element_stored[i][current_state->e[i]->id] = true;
-        }
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::set_element_batch_kernel(ElementBatchKernel<Scalar>* kernel, int batch_size)
+    {
+      if(batch_size < 1)
+        throw Exceptions::ValueException("batch_size", batch_size, 1);
+      this->element_batch_kernel = kernel;
+      this->element_batch_size = batch_size;
+    }
 
-        CacheRecordPerSubIdx* newRecord;
+#ifdef WITH_MPI
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::set_mpi_partition(bool sum_matrix)
+    {
+      int mpi_initialized;
+      MPI_Initialized(&mpi_initialized);
+      if(!mpi_initialized)
+        throw Exceptions::Exception("DiscreteProblem::set_mpi_partition(): MPI is not initialized.");
+      int rank, num_ranks;
+      MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+      MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+      set_process_partition(rank, num_ranks, sum_matrix);
+    }
+#endif
 
-#pragma omp critical (cache_records_sub_idx_map)
-        newRecord = (*this->cache_records_sub_idx[i][current_state->e[i]->id]->find(current_state->sub_idx[i])).second;
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::init_owned_states(Traverse::State** states, int num_states, bool states_changed)
+    {
+      if(!states_changed && !this->owned_states_invalid)
+        return;
+      this->owned_states_invalid = false;
+      delete [] this->state_parts;
+      this->state_parts = NULL;
+      if(this->partition_num_ranks == 1)
+        return;
 
-        newRecord->nvert = current_state->rep->nvert;
-        newRecord->order = order;
+      // The elements of the first mesh, on which the states are, weighted by the element orders of all spaces on it.
+      const Mesh* mesh = this->spaces[0]->get_mesh();
+      int max_id = mesh->get_max_element_id();
+      double* weights = new double[max_id];
+      memset(weights, 0, max_id * sizeof(double));
+      for(unsigned int space_i = 0; space_i < this->spaces.size(); space_i++)
+        if(this->spaces[space_i]->get_mesh() == mesh)
+          this->spaces[space_i]->get_element_weights(weights);
+      int* parts = new int[max_id];
+      mesh->partition(this->partition_num_ranks, parts, weights);
+
+      this->state_parts = new int[num_states];
+      for(int state_i = 0; state_i < num_states; state_i++)
+        this->state_parts[states[state_i]->index] = parts[states[state_i]->e[0]->id];
+      delete [] weights;
+      delete [] parts;
+    }
 
-        // Set active element to all test functions.
-        current_spss[i]->set_active_element(current_state->e[i]);
-        current_spss[i]->set_master_transform();
+    template<typename Scalar>
+    bool DiscreteProblem<Scalar>::init_overlapped_reduction(Traverse::State** states, int num_states)
+    {
+      free_overlapped_reduction();
+#ifdef H2D_OVERLAPPED_REDUCTION
+      if(state_parts == NULL || !partition_sum_matrix || current_mat == NULL || DG_matrix_forms_present || DG_vector_forms_present
+        || Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::assemblingMode) == H2D_ASSEMBLING_THREAD_LOCAL)
+        return false;
+      CSCMatrix<Scalar>* csc_mat = dynamic_cast<CSCMatrix<Scalar>*>(current_mat);
+      if(csc_mat == NULL)
+        return false;
 
-        // Set active element to reference mappings.
-        current_refmaps[i]->force_transform(current_pss[i]->get_transform(), current_pss[i]->get_ctm());
-        newRecord->fns = new Func<double>*[current_als[i]->cnt];
-        newRecord->asmlistCnt = current_als[i]->cnt;
-        for (unsigned int j = 0; j < current_als[i]->cnt; j++)
+      // The process of every DOF by the states containing it, -2 for the DOFs shared by several processes.
+      // All processes know all the parts, so they all find the same shared DOFs.
+      int* dof_parts = new int[this->ndof];
+      for(int i = 0; i < this->ndof; i++)
+        dof_parts[i] = -1;
+      AsmList<Scalar> al;
+      for(int phase = 0; phase < 2; phase++)
+      {
+        if(phase == 1)
         {
-          current_spss[i]->set_active_shape(current_als[i]->idx[j]);
-          newRecord->fns[j] = init_fn(current_spss[i], current_refmaps[i], newRecord->order);
+          halo_states = new bool[num_states];
+          memset(halo_states, 0, num_states * sizeof(bool));
         }
-
-        newRecord->n_quadrature_points = init_geometry_points(current_refmaps[i], newRecord->order, newRecord->geometry, newRecord->jacobian_x_weights);
-
-        if(current_state->isBnd && (current_wf->mfsurf.size() > 0 || current_wf->vfsurf.size() > 0))
+        for(int state_i = 0; state_i < num_states; state_i++)
         {
-          newRecord->fnsSurface = new Func<double>**[newRecord->nvert];
-          memset(newRecord->fnsSurface, NULL, sizeof(Func<double>**) * newRecord->nvert);
-
-          newRecord->geometrySurface = new Geom<double>*[newRecord->nvert];
-          newRecord->jacobian_x_weightsSurface = new double*[newRecord->nvert];
-
-          newRecord->n_quadrature_pointsSurface = new int[newRecord->nvert];
-          newRecord->orderSurface = new int[newRecord->nvert];
-          newRecord->asmlistSurfaceCnt = new int[newRecord->nvert];
-
-          int order = newRecord->order;
-          for (current_state->isurf = 0; current_state->isurf < newRecord->nvert; current_state->isurf++)
-          {
-            if(!current_state->bnd[current_state->isurf])
-              continue;
-            newRecord->n_quadrature_pointsSurface[current_state->isurf] = init_surface_geometry_points(current_refmaps[i], order, current_state, newRecord->geometrySurface[current_state->isurf], newRecord->jacobian_x_weightsSurface[current_state->isurf]);
-            newRecord->orderSurface[current_state->isurf] = order;
-            order = newRecord->order;
-          }
-
-          for (current_state->isurf = 0; current_state->isurf < newRecord->nvert; current_state->isurf++)
+          Traverse::State* state = states[state_i];
+          int part = state_parts[state->index];
+          if(phase == 1 && part != partition_rank)
+            continue;
+          for(unsigned int space_i = 0; space_i < this->spaces_size; space_i++)
           {
-            if(!current_state->bnd[current_state->isurf])
+            if(state->e[space_i] == NULL)
               continue;
-            newRecord->asmlistSurfaceCnt[current_state->isurf] = current_alsSurface[i][current_state->isurf].cnt;
-
-            newRecord->fnsSurface[current_state->isurf] = new Func<double>*[current_alsSurface[i][current_state->isurf].cnt];
-            for (unsigned int j = 0; j < current_alsSurface[i][current_state->isurf].cnt; j++)
+            spaces[space_i]->get_element_assembly_list(state->e[space_i], &al, spaces_first_dofs[space_i]);
+            for(unsigned int k = 0; k < al.get_cnt(); k++)
             {
-              current_spss[i]->set_active_shape(current_alsSurface[i][current_state->isurf].idx[j]);
-              newRecord->fnsSurface[current_state->isurf][j] = init_fn(current_spss[i], current_refmaps[i], newRecord->orderSurface[current_state->isurf]);
+              int dof = al.get_dof()[k];
+              if(dof < 0)
+                continue;
+              if(phase == 0)
+              {
+                if(dof_parts[dof] == -1)
+                  dof_parts[dof] = part;
+                else if(dof_parts[dof] != part)
+                  dof_parts[dof] = -2;
+              }
+              else if(dof_parts[dof] == -2)
+                halo_states[state->index] = true;
             }
           }
         }
       }
+
+      // The entries between the shared DOFs are touched only by the halo states.
+      int* Ap = csc_mat->get_Ap();
+      int* Ai = csc_mat->get_Ai();
+      int size = csc_mat->get_size();
+      halo_positions_count = interior_positions_count = 0;
+      for(int col = 0; col < size; col++)
+        for(int k = Ap[col]; k < Ap[col + 1]; k++)
+          if(dof_parts[col] == -2 && dof_parts[Ai[k]] == -2)
+            halo_positions_count++;
+          else
+            interior_positions_count++;
+      halo_positions = new int[halo_positions_count];
+      interior_positions = new int[interior_positions_count];
+      int halo_i = 0, interior_i = 0;
+      for(int col = 0; col < size; col++)
+        for(int k = Ap[col]; k < Ap[col + 1]; k++)
+          if(dof_parts[col] == -2 && dof_parts[Ai[k]] == -2)
+            halo_positions[halo_i++] = k;
+          else
+            interior_positions[interior_i++] = k;
+      delete [] dof_parts;
+
+      halo_buffer = new Scalar[halo_positions_count];
+      halo_request = new MPI_Request;
+      return true;
+#else
+      return false;
+#endif
     }
 
     template<typename Scalar>
-    void DiscreteProblem<Scalar>::assemble_one_state(PrecalcShapeset** current_pss, PrecalcShapeset** current_spss, RefMap** current_refmaps, Solution<Scalar>** current_u_ext, AsmList<Scalar>** current_als, 
-      Traverse::State* current_state, WeakForm<Scalar>* current_wf)
+    void DiscreteProblem<Scalar>::start_overlapped_reduction()
     {
-      // Representing space.
-      int rep_space_i = -1;
+#ifdef H2D_OVERLAPPED_REDUCTION
+      Scalar* Ax = static_cast<CSCMatrix<Scalar>*>(current_mat)->get_Ax();
+      for(int i = 0; i < halo_positions_count; i++)
+        halo_buffer[i] = Ax[halo_positions[i]];
+      MPI_Iallreduce(MPI_IN_PLACE, halo_buffer, halo_positions_count * (sizeof(Scalar) / sizeof(double)), MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD, (MPI_Request*)halo_request);
+      halo_reduction_started = true;
+#endif
+    }
 
-      // Get necessary (volumetric) assembly lists.
-      for(unsigned int space_i = 0; space_i < this->spaces_size; space_i++)
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::free_overlapped_reduction()
+    {
+#ifdef H2D_OVERLAPPED_REDUCTION
+      // A reduction of a failed assembling.
+      if(halo_reduction_started)
+        MPI_Wait((MPI_Request*)halo_request, MPI_STATUS_IGNORE);
+      delete (MPI_Request*)halo_request;
+#endif
+      halo_reduction_started = false;
+      halo_request = NULL;
+      delete [] halo_states;
+      halo_states = NULL;
+      delete [] halo_positions;
+      halo_positions = NULL;
+      delete [] interior_positions;
+      interior_positions = NULL;
+      halo_positions_count = interior_positions_count = 0;
+      delete [] halo_buffer;
+      halo_buffer = NULL;
+    }
+
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::sum_process_contributions()
+    {
+      if(this->partition_num_ranks == 1)
+        return;
+      if(current_mat != NULL && this->partition_sum_matrix)
       {
-        if(current_state->e[space_i] != NULL)
+#ifdef H2D_OVERLAPPED_REDUCTION
+        if(halo_reduction_started)
         {
-          rep_space_i = space_i;
-          current_refmaps[space_i]->set_active_element(current_state->e[space_i]);
-          spaces[space_i]->get_element_assembly_list(current_state->e[space_i], current_als[space_i], spaces_first_dofs[space_i]);
+          Scalar* Ax = static_cast<CSCMatrix<Scalar>*>(current_mat)->get_Ax();
+          MPI_Wait((MPI_Request*)halo_request, MPI_STATUS_IGNORE);
+          halo_reduction_started = false;
+          for(int i = 0; i < halo_positions_count; i++)
+            Ax[halo_positions[i]] = halo_buffer[i];
+
+          Scalar* interior_values = new Scalar[interior_positions_count];
+          for(int i = 0; i < interior_positions_count; i++)
+            interior_values[i] = Ax[interior_positions[i]];
+          Hermes::Algebra::sum_values_over_processes<Scalar>(interior_values, interior_positions_count);
+          for(int i = 0; i < interior_positions_count; i++)
+            Ax[interior_positions[i]] = interior_values[i];
+          delete [] interior_values;
         }
+        else
+#endif
+          current_mat->sum_over_processes();
       }
+      if(current_rhs != NULL)
+        current_rhs->sum_over_processes();
+    }
 
-        if(rep_space_i == -1)
-          return;
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::init_scatter_maps(int num_states)
+    {
+      use_scatter_maps = false;
+#ifdef WITH_UMFPACK
+      if(dynamic_cast<CSCMatrix<Scalar>*>(current_mat) == NULL)
+        return;
 
-        // Element-wise parameters for WeakForm.
-        (const_cast<WeakForm<Scalar>*>(current_wf))->set_active_state(current_state->e);
+      if(scatter_maps_size != num_states)
+      {
+        delete_scatter_maps();
+        scatter_maps = new ScatterMapRecord**[num_states];
+        memset(scatter_maps, 0, num_states * sizeof(ScatterMapRecord**));
+        scatter_maps_size = num_states;
+      }
+      use_scatter_maps = true;
+#endif
+    }
 
-        // Do we have to recalculate the data for this state even if the cache contains the data?
-        bool changedInLastAdaptation = this->do_not_use_cache ? true : this->state_needs_recalculation(current_als, current_state);
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::delete_scatter_maps()
+    {
+      if(scatter_maps == NULL)
+        return;
 
-        // Assembly lists for surface forms.
-        AsmList<Scalar>** current_alsSurface = NULL;
-        if(current_state->isBnd && (current_wf->mfsurf.size() > 0 || current_wf->vfsurf.size() > 0 || current_wf->mfDG.size() > 0 || current_wf->vfDG.size() > 0))
-        {
-          current_alsSurface = new AsmList<Scalar>*[this->spaces_size];
-          for(unsigned int space_i = 0; space_i < this->spaces_size; space_i++)
+      for(int state_i = 0; state_i < scatter_maps_size; state_i++)
+      {
+        if(scatter_maps[state_i] == NULL)
+          continue;
+        for(unsigned int block_i = 0; block_i < wf->get_neq() * wf->get_neq(); block_i++)
+          if(scatter_maps[state_i][block_i] != NULL)
           {
-            if(current_state->e[space_i] == NULL)
-              return;
-            current_alsSurface[space_i] = new AsmList<Scalar>[current_state->rep->nvert];
-            for (current_state->isurf = 0; current_state->isurf < current_state->rep->nvert; current_state->isurf++)
-              if(current_state->bnd[current_state->isurf])
-                spaces[space_i]->get_boundary_assembly_list(current_state->e[space_i], current_state->isurf, &current_alsSurface[space_i][current_state->isurf], spaces_first_dofs[space_i]);
+            delete [] scatter_maps[state_i][block_i]->positions;
+            delete scatter_maps[state_i][block_i];
           }
-        }
+        delete [] scatter_maps[state_i];
+      }
+      delete [] scatter_maps;
+      scatter_maps = NULL;
+      scatter_maps_size = 0;
+    }
 
-        // Calculate the cache entries.
-        CacheRecordPerSubIdx** cacheRecordPerSubIdx = new CacheRecordPerSubIdx*[this->spaces_size];
+    template<typename Scalar>
+    int* DiscreteProblem<Scalar>::get_scatter_map(Traverse::State* current_state, int i, int j, AsmList<Scalar>* current_als_i, AsmList<Scalar>* current_als_j)
+    {
+#ifdef WITH_UMFPACK
+      if(!use_scatter_maps)
+        return NULL;
 
-        if(changedInLastAdaptation)
-          this->calculate_cache_records(current_pss, current_spss, current_refmaps, current_u_ext, current_als, current_state, current_alsSurface, current_wf);
+      // Every state is processed by one thread only, no synchronization is needed.
+      int neq = wf->get_neq();
+      if(scatter_maps[current_state->index] == NULL)
+      {
+        scatter_maps[current_state->index] = new ScatterMapRecord*[neq * neq];
+        memset(scatter_maps[current_state->index], 0, neq * neq * sizeof(ScatterMapRecord*));
+      }
 
-        if(this->caughtException != NULL)
-          return;
+      ScatterMapRecord*& record = scatter_maps[current_state->index][i * neq + j];
+      if(record != NULL)
+      {
+        if(record->element_id_i == current_state->e[i]->id && record->element_id_j == current_state->e[j]->id
+          && record->cnt_i == current_als_i->cnt && record->cnt_j == current_als_j->cnt)
+          return record->positions;
+        delete [] record->positions;
+      }
+      else
+        record = new ScatterMapRecord;
 
-        // Store the cache entries.
-        for(int temp_i = 0; temp_i < this->spaces_size; temp_i++)
-        {
-          if(current_state->e[temp_i] == NULL)
-            continue;
-#pragma omp critical (cache_records_sub_idx_map)
-          {
-            typename std::map<uint64_t, CacheRecordPerSubIdx*>::iterator it = this->cache_records_sub_idx[temp_i][current_state->e[temp_i]->id]->find(current_state->sub_idx[temp_i]);
+      record->element_id_i = current_state->e[i]->id;
+      record->element_id_j = current_state->e[j]->id;
+      record->cnt_i = current_als_i->cnt;
+      record->cnt_j = current_als_j->cnt;
+      record->positions = new int[current_als_i->cnt * current_als_j->cnt];
+      static_cast<CSCMatrix<Scalar>*>(current_mat)->get_positions(current_als_i->cnt, current_als_j->cnt, current_als_i->dof, current_als_j->dof, record->positions);
+
+      return record->positions;
+#else
+      return NULL;
+#endif
+    }
+
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::add_to_matrix(unsigned int m, unsigned int n, Scalar **mat, int *rows, int *cols, int* positions)
+    {
+#ifdef WITH_UMFPACK
+      // Plain (not atomic) additions into the thread-private values, or into the matrix values for colored states.
+      Scalar* values = colored_mat_values;
+      if(thread_mat_values != NULL)
+        values = thread_mat_values[omp_get_thread_num()];
+      if(positions != NULL)
+      {
+        static_cast<CSCMatrix<Scalar>*>(current_mat)->add_by_positions(m, n, mat, positions, values);
+        return;
+      }
+      if(values != NULL)
+      {
+        static_cast<CSCMatrix<Scalar>*>(current_mat)->add_to_values(m, n, mat, rows, cols, values);
+        return;
+      }
+#endif
+      current_mat->add(m, n, mat, rows, cols);
+    }
+
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::add_to_rhs(unsigned int idx, Scalar value)
+    {
+      if(thread_rhs_values != NULL)
+        thread_rhs_values[omp_get_thread_num()][idx] += value;
+      else if(colored_rhs_values != NULL)
+        colored_rhs_values[idx] += value;
+      else
+        current_rhs->add(idx, value);
+    }
+
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::assemble(Scalar* coeff_vec, SparseMatrix<Scalar>* mat, Vector<Scalar>* rhs, bool force_diagonal_blocks, Table* block_weights)
+    {
+      // Check.
+      this->check();
+      if(this->ndof == 0)
+        throw Exceptions::Exception("Zero DOFs detected in DiscreteProblem::assemble().");
+
+      // Forget the exception of a previous (failed) assembling.
+      this->assembly_status.reset();
+
+      this->cache_stamp++;
+
+      current_mat = mat;
+      current_rhs = rhs;
+      current_force_diagonal_blocks = force_diagonal_blocks;
+      current_block_weights = block_weights;
+
+      // Check that the block scaling table have proper dimension.
+      if(block_weights != NULL)
+        if(block_weights->get_size() != wf->get_neq())
+          throw Exceptions::LengthException(6, block_weights->get_size(), wf->get_neq());
+
+      // Creating matrix sparse structure.
+      create_sparse_structure();
+
+      // Initial check of meshes and spaces.
+      for(unsigned int ext_i = 0; ext_i < this->wf->ext.size(); ext_i++)
+      {
+        if(!this->wf->ext[ext_i]->isOkay())
+          throw Hermes::Exceptions::Exception("Ext function %d is not okay in assemble().", ext_i);
+      }
+
+      // Structures that cloning will be done into.
+      PrecalcShapeset*** pss = new PrecalcShapeset**[Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads)];
+      PrecalcShapeset*** spss = new PrecalcShapeset**[Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads)];
+      RefMap*** refmaps = new RefMap**[Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads)];
+      Solution<Scalar>*** u_ext = new Solution<Scalar>**[Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads)];
+      AsmList<Scalar>*** als = new AsmList<Scalar>**[Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads)];
+      WeakForm<Scalar>** weakforms = new WeakForm<Scalar>*[Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads)];
+
+      // Fill these structures.
+      init_assembling(coeff_vec, pss, spss, refmaps, u_ext, als, weakforms);
+
+      // Vector of meshes.
+      Hermes::vector<const Mesh*> meshes;
+      for(unsigned int space_i = 0; space_i < spaces.size(); space_i++)
+        meshes.push_back(spaces[space_i]->get_mesh());
+      for(unsigned int ext_i = 0; ext_i < this->wf->ext.size(); ext_i++)
+        meshes.push_back(this->wf->ext[ext_i]->get_mesh());
+      for(unsigned int form_i = 0; form_i < this->wf->get_forms().size(); form_i++)
+        for(unsigned int ext_i = 0; ext_i < this->wf->get_forms()[form_i]->ext.size(); ext_i++)
+          if(this->wf->get_forms()[form_i]->ext[ext_i] != NULL)
+            meshes.push_back(this->wf->get_forms()[form_i]->ext[ext_i]->get_mesh());
+      for(unsigned int space_i = 0; space_i < spaces.size(); space_i++)
+        meshes.push_back(spaces[space_i]->get_mesh());
+
+      // All the states are generated at once beforehand, so that the threads do not need to
+      // share the traversal stack and synchronize on obtaining the next state.
+      // They are kept for the following assemblings on the same meshes.
+      Hermes::Mixins::Profile::Section traversal_section(&this->profile, PROFILE_TRAVERSAL);
+      bool states_changed = traverse_states.update(&(meshes.front()), meshes.size());
+      if(states_changed)
+        free_neighbor_searches();
+      int num_states = traverse_states.get_num_states();
+      Traverse::State** states = traverse_states.get_states();
+      get_state_groups(states_changed);
+      init_owned_states(states, num_states, states_changed);
+      bool overlapped_reduction = init_overlapped_reduction(states, num_states);
+      int first_phase = overlapped_reduction ? 1 : 0, last_phase = overlapped_reduction ? 2 : 0;
+      traversal_section.stop();
+      init_thread_local_assembling();
+      init_assembling_arenas();
+      init_reference_integrals();
+      init_form_values_buffers();
+      init_element_batches();
+      init_form_orders();
+      init_scatter_maps(num_states);
+
+      Hermes::vector<Transformable *>* fns = new Hermes::vector<Transformable *>[Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads)];
+      for(unsigned int i = 0; i < Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads); i++)
+      {
+        for (unsigned j = 0; j < spaces.size(); j++)
+          fns[i].push_back(pss[i][j]);
+        for (unsigned j = 0; j < this->wf->ext.size(); j++)
+        {
+          fns[i].push_back(weakforms[i]->ext[j]);
+          weakforms[i]->ext[j]->set_quad_2d(&g_quad_2d_std);
+        }
+        for(unsigned int form_i = 0; form_i < this->wf->get_forms().size(); form_i++)
+        {
+          for(unsigned int ext_i = 0; ext_i < this->wf->get_forms()[form_i]->ext.size(); ext_i++)
+            if(this->wf->get_forms()[form_i]->ext[ext_i] != NULL)
+            {
+              fns[i].push_back(weakforms[i]->get_forms()[form_i]->ext[ext_i]);
+              weakforms[i]->get_forms()[form_i]->ext[ext_i]->set_quad_2d(&g_quad_2d_std);
+            }
+        }
+        for (unsigned j = 0; j < wf->get_neq(); j++)
+        {
+          fns[i].push_back(u_ext[i][j]);
+          u_ext[i][j]->set_quad_2d(&g_quad_2d_std);
+        }
+      }
+
+      int state_i;
+
+      PrecalcShapeset** current_pss;
+      PrecalcShapeset** current_spss;
+      RefMap** current_refmaps;
+      Solution<Scalar>** current_u_ext;
+      AsmList<Scalar>** current_als;
+      WeakForm<Scalar>* current_weakform;
+      Transformable** current_fns;
+
+#define CHUNKSIZE 1
+      int num_threads_used = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
+      size_t assembling_memory_limit = (size_t)Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::assemblingMemoryLimit) * 1024 * 1024;
+#pragma omp parallel shared(states, mat, rhs ) private(state_i, current_pss, current_spss, current_refmaps, current_u_ext, current_als, current_weakform, current_fns) num_threads(num_threads_used)
+      {
+        for(int phase = first_phase; phase <= last_phase; phase++)
+        {
+          for(unsigned int group_i = 0; group_i < this->state_groups.size() - 1; group_i++)
+          {
+            // With Hermes2DApiParam::assemblingMemoryLimit the group is assembled in chunks of consecutive states, see finish_assembling_chunk().
+            int chunk_size = assembling_memory_limit > 0 ? H2D_ASSEMBLING_CHUNK_STATES : this->state_groups[group_i + 1] - this->state_groups[group_i];
+            for(int chunk_start = this->state_groups[group_i]; chunk_start < this->state_groups[group_i + 1]; chunk_start += chunk_size)
+            {
+              int chunk_end = std::min(chunk_start + chunk_size, this->state_groups[group_i + 1]);
+#pragma omp for schedule(dynamic, CHUNKSIZE)
+              for(state_i = chunk_start; state_i < chunk_end; state_i++)
+              {
+                if(this->assembly_status.has_failed() || !is_assembled_state(states[state_i], phase))
+                  continue;
+                try
+                {
+                  Traverse::State* current_state = states[state_i];
+
+                  current_pss = pss[omp_get_thread_num()];
+                  current_spss = spss[omp_get_thread_num()];
+                  current_refmaps = refmaps[omp_get_thread_num()];
+                  current_u_ext = u_ext[omp_get_thread_num()];
+                  current_als = als[omp_get_thread_num()];
+                  current_weakform = weakforms[omp_get_thread_num()];
+                  current_fns = &(fns[omp_get_thread_num()].front());
+
+                  // One state is a collection of (virtual) elements sharing
+                  // the same physical location on (possibly) different meshes.
+                  // This is then the same element of the virtual union mesh.
+                  // The proper sub-element mappings to all the functions of
+                  // this stage are set here from the precalculated state.
+                  for(int fns_i = 0; fns_i < current_state->num; fns_i++)
+                    if(current_state->e[fns_i] != NULL)
+                    {
+                      current_fns[fns_i]->set_active_element(current_state->e[fns_i]);
+                      current_fns[fns_i]->set_transform(current_state->sub_idx[fns_i]);
+                    }
+
+                  // Temporaries of the previous state are not needed any more.
+                  get_assembling_arena()->reset();
+
+                  assemble_one_state(current_pss, current_spss, current_refmaps, current_u_ext, current_als, current_state, current_weakform);
+
+                  if(DG_matrix_forms_present || DG_vector_forms_present)
+                    assemble_one_DG_state(current_pss, current_spss, current_refmaps, current_als, current_state, current_weakform->mfDG, current_weakform->vfDG, current_fns, current_weakform);
+
+                  if(element_batch_kernel != NULL)
+                    flush_element_batches(false);
+                }
+                catch(Hermes::Exceptions::Exception& e)
+                {
+                  this->assembly_status.fail(e);
+                }
+                catch(std::exception& e)
+                {
+                  this->assembly_status.fail(e);
+                }
+              }
+
+              if(chunk_end < this->state_groups[group_i + 1])
+              {
+                if(this->element_batch_kernel != NULL)
+                  this->flush_element_batches(true);
+#pragma omp barrier
+#pragma omp single
+                finish_assembling_chunk(assembling_memory_limit);
+              }
+            }
+
+            // The remaining batches are inserted before the next group, whose states may share the DOFs with the ones of this group.
+            if(this->element_batch_kernel != NULL)
+            {
+              this->flush_element_batches(true);
+#pragma omp barrier
+            }
+          }
+
+          // The values between the shared DOFs are complete, they are summed while the other states are assembled.
+          if(phase == 1)
+          {
+#pragma omp single
+            start_overlapped_reduction();
+          }
+        }
+      }
+
+      finish_thread_local_assembling();
+
+      if(!this->assembly_status.has_failed())
+        sum_process_contributions();
+
+      deinit_assembling(pss, spss, refmaps, u_ext, als, weakforms);
+
+      this->trim_cache();
+
+      for(unsigned int i = 0; i < Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads); i++)
+      {
+        fns[i].clear();
+      }
+      delete [] fns;
+
+      /// \todo Should this be really here? Or in assemble()?
+      if(current_mat != NULL)
+        current_mat->finish();
+      if(current_rhs != NULL)
+        current_rhs->finish();
+
+      this->assembly_status.rethrow();
+    }
+
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::assemble(Scalar* coeff_vec, Vector<Scalar>* rhs,
+      bool force_diagonal_blocks, Table* block_weights)
+    {
+      assemble(coeff_vec, NULL, rhs, force_diagonal_blocks, block_weights);
+    }
+
+    template<typename Scalar>
+    DiscreteProblem<Scalar>::CacheRecordPerSubIdx::CacheRecordPerSubIdx() : fnsSurface(NULL)
+    {
+    }
+
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::CacheRecordPerSubIdx::clear()
+    {
+      for(unsigned int i = 0; i < this->asmlistCnt; i++)
+      {
+        this->fns[i]->free_fn();
+        delete this->fns[i];
+      }
+      delete [] this->fns;
+
+      delete [] this->jacobian_x_weights;
+      this->geometry->free();
+      delete this->geometry;
+
+      if(this->fnsSurface != NULL)
+      {
+        for(unsigned int edge_i = 0; edge_i < nvert; edge_i++)
+        {
+          if(this->fnsSurface[edge_i] == NULL)
+            continue;
+          delete [] this->jacobian_x_weightsSurface[edge_i];
+          this->geometrySurface[edge_i]->free();
+          delete this->geometrySurface[edge_i];
+
+          for(unsigned int i = 0; i < this->asmlistSurfaceCnt[edge_i]; i++)
+          {
+            this->fnsSurface[edge_i][i]->free_fn();
+            delete this->fnsSurface[edge_i][i];
+          }
+          delete [] this->fnsSurface[edge_i];
+        }
+
+        delete [] this->fnsSurface;
+        delete [] this->geometrySurface;
+        delete [] this->jacobian_x_weightsSurface;
+
+        delete [] this->n_quadrature_pointsSurface;
+        delete [] this->orderSurface;
+        delete [] this->asmlistSurfaceCnt;
+
+        this->fnsSurface = NULL;
+      }
+    }
+
+    template<typename Scalar>
+    size_t DiscreteProblem<Scalar>::CacheRecordPerSubIdx::get_memory() const
+    {
+      // Values and two derivatives of every function, geometry (coordinates, normals, tangents) and weights in every point.
+      size_t memory = (3 * this->asmlistCnt + 3) * this->n_quadrature_points * sizeof(double);
+      if(this->fnsSurface != NULL)
+        for(unsigned int edge_i = 0; edge_i < nvert; edge_i++)
+          if(this->fnsSurface[edge_i] != NULL)
+            memory += (3 * this->asmlistSurfaceCnt[edge_i] + 7) * this->n_quadrature_pointsSurface[edge_i] * sizeof(double);
+      return memory;
+    }
+
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::CacheRecordPerElement::clear()
+    {
+      delete [] this->asmlistIdx;
+    }
+
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::free_cache_records(unsigned int space_i, int element_id)
+    {
+      if(this->cache_records_sub_idx[space_i][element_id] != NULL)
+      {
+        for(typename std::map<uint64_t, CacheRecordPerSubIdx*>::iterator it = this->cache_records_sub_idx[space_i][element_id]->begin(); it != this->cache_records_sub_idx[space_i][element_id]->end(); it++)
+        {
+          this->cache_memory -= it->second->get_memory();
+          Hermes::MemoryAccounting::released(assembly_cache_memory_category, it->second->get_memory());
+          it->second->clear();
+          delete it->second;
+        }
+
+        delete this->cache_records_sub_idx[space_i][element_id];
+        this->cache_records_sub_idx[space_i][element_id] = NULL;
+      }
+      if(this->cache_records_element[space_i][element_id] != NULL)
+      {
+        this->cache_records_element[space_i][element_id]->clear();
+        delete this->cache_records_element[space_i][element_id];
+        this->cache_records_element[space_i][element_id] = NULL;
+      }
+      // Evicted during an assembling (see finish_assembling_chunk()), the element record is to be calculated again.
+      if(this->cache_element_stored != NULL && element_id < this->spaces[space_i]->get_mesh()->get_max_element_id())
+        this->cache_element_stored[space_i][element_id] = false;
+    }
+
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::trim_cache()
+    {
+      trim_cache((size_t)Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::cacheSizeLimit) * 1024 * 1024);
+    }
+
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::finish_assembling_chunk(size_t limit)
+    {
+      // The elements of this chunk become the most recently used ones, the ones of the previous chunks are evicted first.
+      this->cache_stamp++;
+      this->trim_cache(limit);
+
+      ElementMatrixStore<Scalar>* store = dynamic_cast<ElementMatrixStore<Scalar>*>(current_mat);
+      if(store != NULL)
+        store->finish();
+    }
+
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::trim_cache(size_t limit)
+    {
+      if(limit == 0 || this->cache_memory <= limit)
+        return;
+
+      // Elements ordered by the last assembling that used them, the oldest ones are evicted first.
+      std::vector<std::pair<unsigned int, std::pair<unsigned int, int> > > elements;
+      for(unsigned int i = 0; i < this->spaces_size; i++)
+        for(int j = 0; j < this->cache_size; j++)
+          if(this->cache_records_element[i][j] != NULL)
+            elements.push_back(std::make_pair(this->cache_records_element[i][j]->last_used, std::make_pair(i, j)));
+      std::sort(elements.begin(), elements.end());
+
+      for(unsigned int k = 0; k < elements.size() && this->cache_memory > limit; k++)
+        this->free_cache_records(elements[k].second.first, elements[k].second.second);
+    }
+
+    template<typename Scalar>
+    bool DiscreteProblem<Scalar>::state_needs_recalculation(AsmList<Scalar>** current_als, Traverse::State* current_state)
+    {
+      for(unsigned int i = 0; i < this->spaces_size; i++)
+      {
+        if(current_state->e[i] == NULL)
+          continue;
+        if(this->spaces[i]->edata[current_state->e[i]->id].changed_in_last_adaptation)
+          return true;
+
+        // Check of potential new constraints.
+        if(!this->do_not_use_cache)
+        {
+          if(this->cache_records_element[i][current_state->e[i]->id] != NULL)
+          {
+            if(this->cache_records_element[i][current_state->e[i]->id]->asmlistCnt != current_als[i]->cnt)
+              return true;
+            else
+            {
+              for(unsigned int idx_i = 0; idx_i < current_als[i]->cnt; idx_i++)
+                if(current_als[i]->idx[idx_i] != this->cache_records_element[i][current_state->e[i]->id]->asmlistIdx[idx_i])
+                  return true;
+            }
+          }
+          else
+            return true;
+        }
+      }
+      return false;
+    }
+
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::calculate_cache_records(PrecalcShapeset** current_pss, PrecalcShapeset** current_spss, RefMap** current_refmaps, Solution<Scalar>** current_u_ext, AsmList<Scalar>** current_als, Traverse::State* current_state,
+      AsmList<Scalar>** current_alsSurface, WeakForm<Scalar>* current_wf)
+    {
+      for(unsigned int space_i = 0; space_i < this->spaces_size; space_i++)
+      {
+        bool new_cache = false;
+        if(current_state->e[space_i] == NULL)
+          continue;
+
+        // No sub_idx map for this element.
+#pragma omp critical (cache_records_sub_idx_map)
+        {
+          try
+          {
+            if(this->cache_records_sub_idx[space_i][current_state->e[space_i]->id] == NULL)
+            {
+              this->cache_records_sub_idx[space_i][current_state->e[space_i]->id] = new std::map<uint64_t, CacheRecordPerSubIdx*>;
+              new_cache = true;
+            }
+            else
+            {
+              // If the sub_idx map exists AND contains a record for this sub_idx, we need to delete the record.
+              typename std::map<uint64_t, CacheRecordPerSubIdx*>::iterator it = this->cache_records_sub_idx[space_i][current_state->e[space_i]->id]->find(current_state->sub_idx[space_i]);
+              if(it != this->cache_records_sub_idx[space_i][current_state->e[space_i]->id]->end())
+              {
+#pragma omp atomic
+                this->cache_memory -= (*it).second->get_memory();
+                Hermes::MemoryAccounting::released(assembly_cache_memory_category, (*it).second->get_memory());
+                (*it).second->clear();
+              }
+              else new_cache = true;
+            }
+
+            // Insert the new record.
+            if(new_cache)
+              this->cache_records_sub_idx[space_i][current_state->e[space_i]->id]->insert(std::pair<uint64_t, CacheRecordPerSubIdx*>(current_state->sub_idx[space_i], new CacheRecordPerSubIdx));
+          }
+          catch(Hermes::Exceptions::Exception& e)
+          {
+            this->assembly_status.fail(e);
+          }
+          catch(std::exception& e)
+          {
+            this->assembly_status.fail(e);
+          }
+        }
+        if(this->assembly_status.has_failed())
+          return;
+      }
+
+      // Order calculation.
+      int order = this->wf->global_integration_order_set ? this->wf->global_integration_order : 0;
+      if(order == 0)
+      {
+        Hermes::vector<MatrixFormVol<Scalar>*> current_mfvol = current_wf->mfvol;
+        Hermes::vector<VectorFormVol<Scalar>*> current_vfvol = current_wf->vfvol;
+
+        for(int current_mfvol_i = 0; current_mfvol_i < current_mfvol.size(); current_mfvol_i++)
+        {
+          if(!form_to_be_assembled(current_mfvol[current_mfvol_i], current_state))
+            continue;
+          current_mfvol[current_mfvol_i]->wf = current_wf;
+          int orderTemp = calc_order_matrix_form(current_mfvol[current_mfvol_i], current_refmaps, current_u_ext, current_state);
+          if(order < orderTemp)
+            order = orderTemp;
+        }
+
+        for(int current_vfvol_i = 0; current_vfvol_i < current_vfvol.size(); current_vfvol_i++)
+        {
+          if(!form_to_be_assembled(current_vfvol[current_vfvol_i], current_state))
+            continue;
+          current_vfvol[current_vfvol_i]->wf = current_wf;
+          int orderTemp = calc_order_vector_form(current_vfvol[current_vfvol_i], current_refmaps, current_u_ext, current_state);
+          if(order < orderTemp)
+            order = orderTemp;
+        }
+
+        if(current_state->isBnd)
+        {
+          for(int current_mfvol_i = 0; current_mfvol_i < current_mfvol.size(); current_mfvol_i++)
+          {
+            if(!form_to_be_assembled(current_mfvol[current_mfvol_i], current_state))
+              continue;
+            current_mfvol[current_mfvol_i]->wf = current_wf;
+            int orderTemp = calc_order_matrix_form(current_mfvol[current_mfvol_i], current_refmaps, current_u_ext, current_state);
+            if(order < orderTemp)
+              order = orderTemp;
+          }
+          for(int current_vfvol_i = 0; current_vfvol_i < current_vfvol.size(); current_vfvol_i++)
+          {
+            if(!form_to_be_assembled(current_vfvol[current_vfvol_i], current_state))
+              continue;
+            current_vfvol[current_vfvol_i]->wf = current_wf;
+            int orderTemp = calc_order_vector_form(current_vfvol[current_vfvol_i], current_refmaps, current_u_ext, current_state);
+            if(order < orderTemp)
+              order = orderTemp;
+          }
+        }
+
+        // Surface forms.
+        if(current_state->isBnd && (current_wf->mfsurf.size() > 0 || current_wf->vfsurf.size() > 0))
+        {
+          Hermes::vector<MatrixFormSurf<Scalar>*> current_mfsurf = current_wf->mfsurf;
+          Hermes::vector<VectorFormSurf<Scalar>*> current_vfsurf = current_wf->vfsurf;
+
+          for (current_state->isurf = 0; current_state->isurf < current_state->rep->nvert; current_state->isurf++)
+          {
+            if(!current_state->bnd[current_state->isurf])
+              continue;
+            for(int current_mfsurf_i = 0; current_mfsurf_i < current_mfsurf.size(); current_mfsurf_i++)
+            {
+              if(!form_to_be_assembled(current_mfsurf[current_mfsurf_i], current_state))
+                continue;
+              current_mfsurf[current_mfsurf_i]->wf = current_wf;
+              int orderTemp = calc_order_matrix_form(current_mfsurf[current_mfsurf_i], current_refmaps, current_u_ext, current_state);
+              if(order < orderTemp)
+                order = orderTemp;
+            }
+
+            for(int current_vfsurf_i = 0; current_vfsurf_i < current_vfsurf.size(); current_vfsurf_i++)
+            {
+              if(!form_to_be_assembled(current_vfsurf[current_vfsurf_i], current_state))
+                continue;
+              current_vfsurf[current_vfsurf_i]->wf = current_wf;
+              int orderTemp = calc_order_vector_form(current_vfsurf[current_vfsurf_i], current_refmaps, current_u_ext, current_state);
+              if(order < orderTemp)
+                order = orderTemp;
+            }
+          }
+        }
+      }
+
+      // Order is known, we know how many integration points we need and we can proceed.
+      // cache record sub idx : new precalcshapeset(spaces->shapeset, element, sub_idx, order, asmlist->idx)
+      for(unsigned int i = 0; i < this->spaces_size; i++)
+      {
+        if(current_state->e[i] == NULL)
+          continue;
+        // Is this thread supposed to compute the perElement record?
+        bool computingThread = false;
+        if(!this->cache_element_stored[i][current_state->e[i]->id])
+        {
+#pragma omp critical (cache_for_element_preparation)
+          if(!this->cache_element_stored[i][current_state->e[i]->id])
+          {
+            computingThread = true;
+            this->cache_element_stored[i][current_state->e[i]->id] = true;
+          }
+        }
+
+        if(computingThread)
+        {
+          if(this->cache_records_element[i][current_state->e[i]->id] == NULL)
+            this->cache_records_element[i][current_state->e[i]->id] = new CacheRecordPerElement;
+          else
+            this->cache_records_element[i][current_state->e[i]->id]->clear();
+
+          this->cache_records_element[i][current_state->e[i]->id]->asmlistCnt = current_als[i]->cnt;
+          this->cache_records_element[i][current_state->e[i]->id]->last_used = this->cache_stamp;
+          this->cache_records_element[i][current_state->e[i]->id]->asmlistIdx = new int[current_als[i]->cnt];
+          for(unsigned int asmlist_i = 0; asmlist_i < current_als[i]->cnt; asmlist_i++)
+            this->cache_records_element[i][current_state->e[i]->id]->asmlistIdx[asmlist_i] = current_als[i]->idx[asmlist_i];
+          this->cache_element_stored[i][current_state->e[i]->id] = true;
+        }
+
+        CacheRecordPerSubIdx* newRecord;
+
+#pragma omp critical (cache_records_sub_idx_map)
+        newRecord = (*this->cache_records_sub_idx[i][current_state->e[i]->id]->find(current_state->sub_idx[i])).second;
+
+        newRecord->nvert = current_state->rep->nvert;
+        newRecord->order = order;
+
+        // Set active element to all test functions.
+        current_spss[i]->set_active_element(current_state->e[i]);
+        current_spss[i]->set_master_transform();
+
+        // Set active element to reference mappings.
+        current_refmaps[i]->force_transform(current_pss[i]->get_transform(), current_pss[i]->get_ctm());
+        newRecord->asmlistCnt = current_als[i]->cnt;
+        newRecord->fns = init_fns(current_spss[i], current_refmaps[i], newRecord->order, current_als[i]->cnt, current_als[i]->idx);
+
+        newRecord->n_quadrature_points = init_geometry_points(current_refmaps[i], newRecord->order, newRecord->geometry, newRecord->jacobian_x_weights);
+
+        if(current_state->isBnd && (current_wf->mfsurf.size() > 0 || current_wf->vfsurf.size() > 0))
+        {
+          newRecord->fnsSurface = new Func<double>**[newRecord->nvert];
+          memset(newRecord->fnsSurface, NULL, sizeof(Func<double>**) * newRecord->nvert);
+
+          newRecord->geometrySurface = new Geom<double>*[newRecord->nvert];
+          newRecord->jacobian_x_weightsSurface = new double*[newRecord->nvert];
+
+          newRecord->n_quadrature_pointsSurface = new int[newRecord->nvert];
+          newRecord->orderSurface = new int[newRecord->nvert];
+          newRecord->asmlistSurfaceCnt = new int[newRecord->nvert];
+
+          int order = newRecord->order;
+          for (current_state->isurf = 0; current_state->isurf < newRecord->nvert; current_state->isurf++)
+          {
+            if(!current_state->bnd[current_state->isurf])
+              continue;
+            newRecord->n_quadrature_pointsSurface[current_state->isurf] = init_surface_geometry_points(current_refmaps[i], order, current_state, newRecord->geometrySurface[current_state->isurf], newRecord->jacobian_x_weightsSurface[current_state->isurf]);
+            newRecord->orderSurface[current_state->isurf] = order;
+            order = newRecord->order;
+          }
+
+          for (current_state->isurf = 0; current_state->isurf < newRecord->nvert; current_state->isurf++)
+          {
+            if(!current_state->bnd[current_state->isurf])
+              continue;
+            newRecord->asmlistSurfaceCnt[current_state->isurf] = current_alsSurface[i][current_state->isurf].cnt;
+
+            newRecord->fnsSurface[current_state->isurf] = init_fns(current_spss[i], current_refmaps[i], newRecord->orderSurface[current_state->isurf],
+              current_alsSurface[i][current_state->isurf].cnt, current_alsSurface[i][current_state->isurf].idx);
+          }
+        }
+
+#pragma omp atomic
+        this->cache_memory += newRecord->get_memory();
+        Hermes::MemoryAccounting::allocated(assembly_cache_memory_category, newRecord->get_memory());
+      }
+    }
+
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::assemble_one_state(PrecalcShapeset** current_pss, PrecalcShapeset** current_spss, RefMap** current_refmaps, Solution<Scalar>** current_u_ext, AsmList<Scalar>** current_als, 
+      Traverse::State* current_state, WeakForm<Scalar>* current_wf)
+    {
+      Hermes::Mixins::Trace::Scope state_scope("state", "assembly");
+
+      // Representing space.
+      int rep_space_i = -1;
+
+      // Get necessary (volumetric) assembly lists.
+      for(unsigned int space_i = 0; space_i < this->spaces_size; space_i++)
+      {
+        if(current_state->e[space_i] != NULL)
+        {
+          rep_space_i = space_i;
+          current_refmaps[space_i]->set_active_element(current_state->e[space_i]);
+          spaces[space_i]->get_element_assembly_list(current_state->e[space_i], current_als[space_i], spaces_first_dofs[space_i]);
+        }
+      }
+
+        if(rep_space_i == -1)
+          return;
+
+        // Element-wise parameters for WeakForm.
+        (const_cast<WeakForm<Scalar>*>(current_wf))->set_active_state(current_state->e);
+
+        // Do we have to recalculate the data for this state even if the cache contains the data?
+        bool changedInLastAdaptation = this->do_not_use_cache ? true : this->state_needs_recalculation(current_als, current_state);
+
+        // Assembly lists for surface forms.
+        AsmList<Scalar>** current_alsSurface = NULL;
+        if(current_state->isBnd && (current_wf->mfsurf.size() > 0 || current_wf->vfsurf.size() > 0 || current_wf->mfDG.size() > 0 || current_wf->vfDG.size() > 0))
+        {
+          current_alsSurface = new AsmList<Scalar>*[this->spaces_size];
+          for(unsigned int space_i = 0; space_i < this->spaces_size; space_i++)
+          {
+            if(current_state->e[space_i] == NULL)
+              return;
+            current_alsSurface[space_i] = new AsmList<Scalar>[current_state->rep->nvert];
+            for (current_state->isurf = 0; current_state->isurf < current_state->rep->nvert; current_state->isurf++)
+              if(current_state->bnd[current_state->isurf])
+                spaces[space_i]->get_boundary_assembly_list(current_state->e[space_i], current_state->isurf, &current_alsSurface[space_i][current_state->isurf], spaces_first_dofs[space_i]);
+          }
+        }
+
+        // Calculate the cache entries.
+        Hermes::Mixins::Profile::Section precalculation_section(&this->profile, PROFILE_PRECALCULATION);
+        CacheRecordPerSubIdx** cacheRecordPerSubIdx = get_assembling_arena()->template allocate_array<CacheRecordPerSubIdx*>(this->spaces_size);
+
+        if(changedInLastAdaptation)
+        {
+          if(Hermes::Mixins::Trace::is_enabled())
+            Hermes::Mixins::Trace::add_instant("cache miss", "assembly");
+          this->calculate_cache_records(current_pss, current_spss, current_refmaps, current_u_ext, current_als, current_state, current_alsSurface, current_wf);
+        }
+
+        if(this->assembly_status.has_failed())
+          return;
+
+        // Store the cache entries.
+        for(int temp_i = 0; temp_i < this->spaces_size; temp_i++)
+        {
+          if(current_state->e[temp_i] == NULL)
+            continue;
+#pragma omp critical (cache_records_sub_idx_map)
+          {
+            typename std::map<uint64_t, CacheRecordPerSubIdx*>::iterator it = this->cache_records_sub_idx[temp_i][current_state->e[temp_i]->id]->find(current_state->sub_idx[temp_i]);
             if(it != this->cache_records_sub_idx[temp_i][current_state->e[temp_i]->id]->end())
               cacheRecordPerSubIdx[temp_i] = it->second;
           }
+          if(this->cache_records_element[temp_i][current_state->e[temp_i]->id] != NULL)
+            this->cache_records_element[temp_i][current_state->e[temp_i]->id]->last_used = this->cache_stamp;
+        }
+        precalculation_section.stop();
+
+        // Ext functions.
+        // - order
+        int order = cacheRecordPerSubIdx[rep_space_i]->order;
+
+        // - u_ext
+        Func<Scalar>** u_ext = NULL;
+        int prevNewtonSize = this->wf->get_neq();
+
+        if(!this->is_linear)
+        {
+          u_ext = get_assembling_arena()->template allocate_array<Func<Scalar>*>(prevNewtonSize);
+          if(current_u_ext != NULL)
+            for(int u_ext_i = 0; u_ext_i < prevNewtonSize; u_ext_i++)
+              if(current_u_ext[u_ext_i] != NULL)
+              {
+                u_ext[u_ext_i] = init_u_ext_fn(u_ext_i, order, cacheRecordPerSubIdx, current_als, current_state);
+                if(u_ext[u_ext_i] == NULL)
+                  u_ext[u_ext_i] = init_fn(current_u_ext[u_ext_i], order);
+              }
+              else
+                u_ext[u_ext_i] = NULL;
+          else
+            for(int u_ext_i = 0; u_ext_i < prevNewtonSize; u_ext_i++)
+              u_ext[u_ext_i] = NULL;
+        }
+
+        // - ext
+        int current_extCount = this->wf->ext.size();
+        Func<Scalar>** ext = NULL;
+        if(current_extCount > 0)
+        {
+          ext = get_assembling_arena()->template allocate_array<Func<Scalar>*>(current_extCount);
+          for(int ext_i = 0; ext_i < current_extCount; ext_i++)
+            if(current_wf->ext[ext_i] != NULL)
+              ext[ext_i] = init_fn(current_wf->ext[ext_i], order);
+            else
+              ext[ext_i] = NULL;
+        }
+
+        if(RungeKutta)
+          for(int ext_i = 0; ext_i < this->RK_original_spaces_count; ext_i++)
+            u_ext[ext_i]->add(ext[current_extCount - this->RK_original_spaces_count + ext_i]);
+
+        if(current_mat != NULL)
+        {
+          for(int current_mfvol_i = 0; current_mfvol_i < wf->mfvol.size(); current_mfvol_i++)
+          {
+            MatrixFormVol<Scalar>* mfv = current_wf->mfvol[current_mfvol_i];
+
+            if(!form_to_be_assembled(mfv, current_state))
+              continue;
+
+            MatrixFormVolBlock<Scalar>* block_form = dynamic_cast<MatrixFormVolBlock<Scalar>*>(mfv);
+            if(block_form != NULL)
+            {
+              assemble_matrix_form_block(block_form, cacheRecordPerSubIdx, ext, u_ext, current_als, current_state);
+              continue;
+            }
+
+            int form_i = mfv->i;
+            int form_j = mfv->j;
+            CacheRecordPerSubIdx* CacheRecordPerSubIdxI = cacheRecordPerSubIdx[form_i];
+            CacheRecordPerSubIdx* CacheRecordPerSubIdxJ = cacheRecordPerSubIdx[form_j];
+
+            assemble_matrix_form(mfv, 
+              CacheRecordPerSubIdxI->order, 
+              CacheRecordPerSubIdxJ->fns, 
+              CacheRecordPerSubIdxI->fns, 
+              ext,
+              u_ext,
+              current_als[form_i], 
+              current_als[form_j], 
+              current_state, 
+              CacheRecordPerSubIdxI->n_quadrature_points, 
+              CacheRecordPerSubIdxI->geometry, 
+              CacheRecordPerSubIdxI->jacobian_x_weights,
+              current_refmaps[form_i]);
+          }
+        }
+        if(current_rhs != NULL && !vector_forms_skipped)
+        {
+          for(int current_vfvol_i = 0; current_vfvol_i < wf->vfvol.size(); current_vfvol_i++)
+          {
+            VectorFormVol<Scalar>* vfv = current_wf->vfvol[current_vfvol_i];
+
+            if(!form_to_be_assembled(vfv, current_state))
+              continue;
+
+            int form_i = vfv->i;
+            CacheRecordPerSubIdx* CacheRecordPerSubIdxI = cacheRecordPerSubIdx[form_i];
+
+            assemble_vector_form(vfv, 
+              CacheRecordPerSubIdxI->order, 
+              CacheRecordPerSubIdxI->fns, 
+              ext,
+              u_ext, 
+              current_als[form_i], 
+              current_state, 
+              CacheRecordPerSubIdxI->n_quadrature_points,
+              CacheRecordPerSubIdxI->geometry, 
+              CacheRecordPerSubIdxI->jacobian_x_weights,
+              current_refmaps[form_i]);
+          }
+        }
+
+        // Cleanup - u_ext
+        if(current_u_ext != NULL)
+        {
+          for(int u_ext_i = 0; u_ext_i < prevNewtonSize; u_ext_i++)
+            if(current_u_ext[u_ext_i] != NULL && current_state->e[u_ext_i] != NULL)
+            {
+              u_ext[u_ext_i]->free_fn();
+              delete u_ext[u_ext_i];
+            }
+        }
+
+        // Cleanup - ext
+        for(int ext_i = 0; ext_i < current_extCount; ext_i++)
+        {
+          if(current_wf->ext[ext_i] != NULL)
+          {
+            ext[ext_i]->free_fn();
+            delete ext[ext_i];
+          }
+        }
+
+          // Assemble surface integrals now: loop through surfaces of the element.
+          if(current_state->isBnd && (current_wf->mfsurf.size() > 0 || current_wf->vfsurf.size() > 0))
+          {
+            for (current_state->isurf = 0; current_state->isurf < current_state->rep->nvert; current_state->isurf++)
+            {
+              if(!current_state->bnd[current_state->isurf])
+                continue;
+
+              // Edge-wise parameters for WeakForm.
+              (const_cast<WeakForm<Scalar>*>(current_wf))->set_active_edge_state(current_state->e, current_state->isurf);
+
+              // Ext functions.
+              // - order
+              int orderSurf = cacheRecordPerSubIdx[rep_space_i]->orderSurface[current_state->isurf];
+              // - u_ext
+              int prevNewtonSize = this->wf->get_neq();
+              Func<Scalar>** u_extSurf = NULL;
+              if(!this->is_linear)
+              {
+                u_extSurf = get_assembling_arena()->template allocate_array<Func<Scalar>*>(prevNewtonSize);
+                if(current_u_ext != NULL)
+                  for(int u_ext_surf_i = 0; u_ext_surf_i < prevNewtonSize; u_ext_surf_i++)
+                    if(current_u_ext[u_ext_surf_i] != NULL)
+                      u_extSurf[u_ext_surf_i] = current_state->e[u_ext_surf_i] == NULL ? NULL : init_fn(current_u_ext[u_ext_surf_i], orderSurf);
+                    else
+                      u_extSurf[u_ext_surf_i] = NULL;
+                else
+                  for(int u_ext_surf_i = 0; u_ext_surf_i < prevNewtonSize; u_ext_surf_i++)
+                    u_extSurf[u_ext_surf_i] = NULL;
+              }
+              // - ext
+              int current_extCount = this->wf->ext.size();
+              Func<Scalar>** extSurf = get_assembling_arena()->template allocate_array<Func<Scalar>*>(current_extCount);
+              for(int ext_surf_i = 0; ext_surf_i < current_extCount; ext_surf_i++)
+                if(current_wf->ext[ext_surf_i] != NULL)
+                  extSurf[ext_surf_i] = current_state->e[ext_surf_i] == NULL ? NULL : init_fn(current_wf->ext[ext_surf_i], orderSurf);
+                else
+                  extSurf[ext_surf_i] = NULL;
+
+              if(RungeKutta)
+                for(int ext_surf_i = 0; ext_surf_i < this->RK_original_spaces_count; ext_surf_i++)
+                  u_extSurf[ext_surf_i]->add(extSurf[current_extCount - this->RK_original_spaces_count + ext_surf_i]);
+
+              if(current_mat != NULL)
+              {
+                for(int current_mfsurf_i = 0; current_mfsurf_i < wf->mfsurf.size(); current_mfsurf_i++)
+                {
+                  if(!form_to_be_assembled(current_wf->mfsurf[current_mfsurf_i], current_state))
+                    continue;
+
+                  int form_i = current_wf->mfsurf[current_mfsurf_i]->i;
+                  int form_j = current_wf->mfsurf[current_mfsurf_i]->j;
+                  CacheRecordPerSubIdx* CacheRecordPerSubIdxI = cacheRecordPerSubIdx[form_i];
+                  CacheRecordPerSubIdx* CacheRecordPerSubIdxJ = cacheRecordPerSubIdx[form_j];
+
+                  assemble_matrix_form(current_wf->mfsurf[current_mfsurf_i], 
+                    CacheRecordPerSubIdxI->orderSurface[current_state->isurf], 
+                    CacheRecordPerSubIdxJ->fnsSurface[current_state->isurf], 
+                    CacheRecordPerSubIdxI->fnsSurface[current_state->isurf], 
+                    extSurf, 
+                    u_extSurf,
+                    &current_alsSurface[form_i][current_state->isurf], 
+                    &current_alsSurface[form_j][current_state->isurf], 
+                    current_state, 
+                    CacheRecordPerSubIdxI->n_quadrature_pointsSurface[current_state->isurf], 
+                    CacheRecordPerSubIdxI->geometrySurface[current_state->isurf], 
+                    CacheRecordPerSubIdxI->jacobian_x_weightsSurface[current_state->isurf],
+                    current_refmaps[form_i]);
+                }
+              }
+
+              if(current_rhs != NULL && !vector_forms_skipped)
+              {
+                for(int current_vfsurf_i = 0; current_vfsurf_i < wf->vfsurf.size(); current_vfsurf_i++)
+                {
+                  if(!form_to_be_assembled(current_wf->vfsurf[current_vfsurf_i], current_state))
+                    continue;
+
+                  int form_i = current_wf->vfsurf[current_vfsurf_i]->i;
+                  CacheRecordPerSubIdx* CacheRecordPerSubIdxI = cacheRecordPerSubIdx[form_i];
+
+                  assemble_vector_form(current_wf->vfsurf[current_vfsurf_i], 
+                    CacheRecordPerSubIdxI->orderSurface[current_state->isurf], 
+                    CacheRecordPerSubIdxI->fnsSurface[current_state->isurf], 
+                    extSurf, 
+                    u_extSurf, 
+                    &current_alsSurface[form_i][current_state->isurf], 
+                    current_state, 
+                    CacheRecordPerSubIdxI->n_quadrature_pointsSurface[current_state->isurf], 
+                    CacheRecordPerSubIdxI->geometrySurface[current_state->isurf], 
+                    CacheRecordPerSubIdxI->jacobian_x_weightsSurface[current_state->isurf],
+                    current_refmaps[form_i]);
+                }
+              }
+
+              if(current_u_ext != NULL)
+              {
+                for(int u_ext_surf_i = 0; u_ext_surf_i < prevNewtonSize; u_ext_surf_i++)
+                  if(current_u_ext[u_ext_surf_i] != NULL)
+                  {
+                    u_extSurf[u_ext_surf_i]->free_fn();
+                    delete u_extSurf[u_ext_surf_i];
+                  }
+              }
+
+              for(int ext_surf_i = 0; ext_surf_i < current_extCount; ext_surf_i++)
+                if(current_wf->ext[ext_surf_i] != NULL)
+                {
+                  extSurf[ext_surf_i]->free_fn();
+                  delete extSurf[ext_surf_i];
+                }
+            }
+
+            for(unsigned int i = 0; i < this->spaces_size; i++)
+              if(current_state->e[i] != NULL)
+                delete [] current_alsSurface[i];
+          }
+
+          if(current_alsSurface != NULL)
+            delete [] current_alsSurface;
+    }
+
+    template<typename Scalar>
+    Func<Scalar>* DiscreteProblem<Scalar>::init_u_ext_fn(unsigned int space_i, int order, CacheRecordPerSubIdx** cacheRecordPerSubIdx, AsmList<Scalar>** current_als, Traverse::State* current_state)
+    {
+      if(u_ext_coeff_vec == NULL || current_state->e[space_i] == NULL)
+        return NULL;
+      const Space<Scalar>* space = spaces[space_i];
+      if(space->get_shapeset()->get_num_components() != 1)
+        return NULL;
+      CacheRecordPerSubIdx* record = cacheRecordPerSubIdx[space_i];
+      AsmList<Scalar>* al = current_als[space_i];
+      if(record == NULL || record->order != order || record->asmlistCnt != (int)al->cnt)
+        return NULL;
+
+      int np = record->n_quadrature_points;
+      Func<Scalar>* u = new Func<Scalar>(np, 1);
+      u->val = new Scalar[np];
+      u->dx = new Scalar[np];
+      u->dy = new Scalar[np];
+      memset(u->val, 0, sizeof(Scalar) * np);
+      memset(u->dx, 0, sizeof(Scalar) * np);
+      memset(u->dy, 0, sizeof(Scalar) * np);
+#ifdef H2D_USE_SECOND_DERIVATIVES
+      if(space->get_type() == HERMES_H1_SPACE)
+      {
+        u->laplace = new Scalar[np];
+        memset(u->laplace, 0, sizeof(Scalar) * np);
+      }
+#endif
+
+      // The same coefficients as Solution::calc_mono_coeffs(), al has the DOFs shifted by spaces_first_dofs.
+      Scalar dir_lift_coeff = RungeKutta ? 0.0 : 1.0;
+      for(unsigned int k = 0; k < al->cnt; k++)
+      {
+        int dof = al->dof[k];
+        Scalar coef = al->coef[k] * (dof >= 0 ? u_ext_coeff_vec[((int)(dof - spaces_first_dofs[space_i]) - space->first_dof) / space->stride + u_ext_dof_offsets[space_i]] : dir_lift_coeff);
+        if(coef == 0.0)
+          continue;
+        Func<double>* fn = record->fns[k];
+        for(int i = 0; i < np; i++)
+        {
+          u->val[i] += coef * fn->val[i];
+          u->dx[i] += coef * fn->dx[i];
+          u->dy[i] += coef * fn->dy[i];
+        }
+#ifdef H2D_USE_SECOND_DERIVATIVES
+        if(u->laplace != NULL)
+          for(int i = 0; i < np; i++)
+            u->laplace[i] += coef * fn->laplace[i];
+#endif
+      }
+      return u;
+    }
+
+    template<typename Scalar>
+    int DiscreteProblem<Scalar>::calc_order_matrix_form(MatrixForm<Scalar> *form, RefMap** current_refmaps, Solution<Scalar>** current_u_ext, Traverse::State* current_state)
+    {
+      Hermes::Mixins::Profile::Section order_section(&this->profile, PROFILE_ORDER_CALCULATION);
+
+      // Order of shape functions, the highest of all the blocks of vector-valued forms.
+      int max_order_i = calc_max_element_order(form->i, current_state);
+      int max_order_j = calc_max_element_order(form->j, current_state);
+      MatrixFormVolBlock<Scalar>* block_form = dynamic_cast<MatrixFormVolBlock<Scalar>*>(form);
+      if(block_form != NULL)
+      {
+        for(unsigned int block_i = 1; block_i < block_form->get_block_count(); block_i++)
+        {
+          max_order_i = std::max(max_order_i, calc_max_element_order(form->i + block_i, current_state));
+          max_order_j = std::max(max_order_j, calc_max_element_order(form->j + block_i, current_state));
         }
+      }
 
-        // Ext functions.
-        // - order
-        int order = cacheRecordPerSubIdx[rep_space_i]->order;
+      int order_u = max_order_j + (spaces[form->j]->get_shapeset()->get_num_components() > 1 ? 1 : 0);
+      int order_v = max_order_i + (spaces[form->i]->get_shapeset()->get_num_components() > 1 ? 1 : 0);
 
-        // - u_ext
-        Func<Scalar>** u_ext = NULL;
-        int prevNewtonSize = this->wf->get_neq();
+      std::vector<int> key;
+      key.push_back(order_u);
+      key.push_back(order_v);
+      get_ext_orders(form, current_u_ext, current_state, key);
+      key.push_back(current_refmaps[form->i]->get_inv_ref_order());
+      key.push_back(current_refmaps[form->i]->get_active_element()->get_mode());
 
-        if(!this->is_linear)
+      typename FormOrders::iterator it = form_orders[omp_get_thread_num()].find(std::make_pair((Form<Scalar>*)form, key));
+      if(it != form_orders[omp_get_thread_num()].end())
+        return it->second;
+
+      int order = calc_order_form(form, true, order_u, order_v, key, current_refmaps);
+
+      form_orders[omp_get_thread_num()].insert(std::make_pair(std::make_pair((Form<Scalar>*)form, key), order));
+      return order;
+    }
+
+    template<typename Scalar>
+    int DiscreteProblem<Scalar>::calc_max_element_order(unsigned int space_i, Traverse::State* current_state) const
+    {
+      int max_order = this->spaces[space_i]->get_element_order(current_state->e[space_i]->id);
+      if(H2D_GET_V_ORDER(max_order) > H2D_GET_H_ORDER(max_order))
+        max_order = H2D_GET_V_ORDER(max_order);
+      else
+        max_order = H2D_GET_H_ORDER(max_order);
+
+      for (unsigned int k = 0; k < current_state->rep->nvert; k++)
+      {
+        int eo = this->spaces[space_i]->get_edge_order(current_state->e[space_i], k);
+        if(eo > max_order)
+          max_order = eo;
+      }
+      return max_order;
+    }
+
+    template<typename Scalar>
+    int DiscreteProblem<Scalar>::calc_order_form(Form<Scalar>* form, bool matrix_form, int order_u, int order_v, const std::vector<int>& key, RefMap** current_refmaps)
+    {
+      int order;
+      Hermes::Ord o;
+
+      // The external functions follow the orders of the shape functions in the key.
+      const int* ext_orders = &key[matrix_form ? 2 : 1];
+      int ext_count = (RungeKutta ? RK_original_spaces_count : this->wf->get_neq() - form->u_ext_offset) + (form->ext.size() > 0 ? form->ext.size() : form->wf->ext.size());
+
+      int u_coefficient, v_coefficient, ext_coefficient, increase;
+      if(form->get_order_formula(u_coefficient, v_coefficient, ext_coefficient, increase))
+      {
+        int ext_order = 0;
+        for(int i = 0; i < ext_count; i++)
+          ext_order = std::max(ext_order, ext_orders[i]);
+        o = Hermes::Ord((matrix_form ? u_coefficient * order_u : 0) + v_coefficient * order_v + ext_coefficient * ext_order + increase);
+      }
+      else
+      {
+        Func<Hermes::Ord>* ou = matrix_form ? init_fn_ord(order_u) : NULL;
+        Func<Hermes::Ord>* ov = init_fn_ord(order_v);
+
+        // order of solutions from the previous Newton iteration etc..
+        Func<Hermes::Ord>** u_ext_ord = new Func<Hermes::Ord>*[RungeKutta ? RK_original_spaces_count : this->wf->get_neq() - form->u_ext_offset];
+        Func<Hermes::Ord>** ext_ord = NULL;
+        int ext_size = std::max(form->ext.size(), form->wf->ext.size());
+        if(ext_size > 0)
+          ext_ord = new Func<Hermes::Ord>*[ext_size];
+        init_ext_orders(form, u_ext_ord, ext_ord, ext_orders);
+
+        // Total order of the form.
+        if(ou == NULL)
+          o = static_cast<VectorForm<Scalar>*>(form)->ord(1, &fake_wt, u_ext_ord, ov, &geom_ord, ext_ord);
+        else
+          o = static_cast<MatrixForm<Scalar>*>(form)->ord(1, &fake_wt, u_ext_ord, ou, ov, &geom_ord, ext_ord);
+
+        // Cleanup.
+        deinit_ext_orders(form, u_ext_ord, ext_ord);
+        delete [] u_ext_ord;
+        if(ou != NULL)
         {
-          u_ext = new Func<Scalar>*[prevNewtonSize];
-          if(current_u_ext != NULL)
-            for(int u_ext_i = 0; u_ext_i < prevNewtonSize; u_ext_i++)
-              if(current_u_ext[u_ext_i] != NULL)
-                u_ext[u_ext_i] = init_fn(current_u_ext[u_ext_i], order);
-              else
-                u_ext[u_ext_i] = NULL;
+          ou->free_ord();
+          delete ou;
+        }
+        ov->free_ord();
+        delete ov;
+      }
+
+      adjust_order_to_refmaps(form, order, &o, current_refmaps);
+      return order;
+    }
+
+    template<typename Scalar>
+    bool DiscreteProblem<Scalar>::calc_matrix_form_reference_values(MatrixFormVol<Scalar>* form, RefMap* current_refmap, AsmList<Scalar>* current_als_i, AsmList<Scalar>* current_als_j,
+      Traverse::State* current_state, Scalar** form_values)
+    {
+      Scalar mass_coefficient, diffusion_coefficient;
+      if(!form->get_constant_coefficients(mass_coefficient, diffusion_coefficient))
+        return false;
+
+      // Both functions have to be defined on the same untransformed element with a constant reference map.
+      Element* e = current_state->e[form->i];
+      if(e != current_state->e[form->j] || current_state->sub_idx[form->i] != 0 || current_state->sub_idx[form->j] != 0 || !current_refmap->is_jacobian_const())
+        return false;
+
+      Shapeset* shapeset_i = this->spaces[form->i]->get_shapeset();
+      Shapeset* shapeset_j = this->spaces[form->j]->get_shapeset();
+      if(shapeset_i->get_num_components() > 1 || shapeset_j->get_num_components() > 1)
+        return false;
+
+      // Constrained functions (hanging nodes) are left to the numerical integration.
+      for(unsigned int i = 0; i < current_als_i->cnt; i++)
+        if(current_als_i->idx[i] < 0)
+          return false;
+      for(unsigned int j = 0; j < current_als_j->cnt; j++)
+        if(current_als_j->idx[j] < 0)
+          return false;
+
+      // grad u . grad v = sum_ab G_ab du/dxi_a dv/dxi_b, with G = M^T M for the constant inverse reference map M.
+      double2x2* m = current_refmap->get_const_inv_ref_map();
+      double jacobian = current_refmap->get_const_jacobian();
+      double g_xx = jacobian * ((*m)[0][0] * (*m)[0][0] + (*m)[1][0] * (*m)[1][0]);
+      double g_xy = jacobian * ((*m)[0][0] * (*m)[0][1] + (*m)[1][0] * (*m)[1][1]);
+      double g_yy = jacobian * ((*m)[0][1] * (*m)[0][1] + (*m)[1][1] * (*m)[1][1]);
+
+      ReferenceIntegrals* current_reference_integrals = &this->reference_integrals[omp_get_thread_num()];
+      for(unsigned int i = 0; i < current_als_i->cnt; i++)
+      {
+        for(unsigned int j = 0; j < current_als_j->cnt; j++)
+        {
+          const double* integrals = current_reference_integrals->get(shapeset_j, current_als_j->idx[j], shapeset_i, current_als_i->idx[i], e);
+          form_values[i][j] = mass_coefficient * (jacobian * integrals[0])
+            + diffusion_coefficient * (g_xx * integrals[1] + g_xy * integrals[2] + g_yy * integrals[3]);
+        }
+      }
+
+      return true;
+    }
+
+    template<typename Scalar>
+    bool DiscreteProblem<Scalar>::calc_matrix_form_tensor_values(MatrixFormVol<Scalar>* form, int order, RefMap* current_refmap, AsmList<Scalar>* current_als_i, AsmList<Scalar>* current_als_j,
+      Traverse::State* current_state, int n_quadrature_points, Geom<double>* geometry, double* jacobian_x_weights, Func<Scalar>** u_ext, Func<Scalar>** ext, Scalar** form_values)
+    {
+      // Both functions have to be defined on the same untransformed quad.
+      Element* e = current_state->e[form->i];
+      if(!e->is_quad() || e != current_state->e[form->j] || current_state->sub_idx[form->i] != 0 || current_state->sub_idx[form->j] != 0)
+        return false;
+
+      Shapeset* shapeset_i = this->spaces[form->i]->get_shapeset();
+      Shapeset* shapeset_j = this->spaces[form->j]->get_shapeset();
+      if(shapeset_i->get_num_components() > 1 || shapeset_j->get_num_components() > 1)
+        return false;
+
+      MemoryArena* arena = get_assembling_arena();
+      int n = n_quadrature_points;
+      Scalar* mass = arena->template allocate_array<Scalar>(n);
+      Scalar* diffusion = arena->template allocate_array<Scalar>(n);
+      if(!form->get_point_coefficients(n, u_ext, geometry, ext, mass, diffusion))
+        return false;
+
+      // Split the functions into factors.
+      int cnt_i = current_als_i->cnt, cnt_j = current_als_j->cnt;
+      int* x_i = arena->template allocate_array<int>(cnt_i);
+      int* y_i = arena->template allocate_array<int>(cnt_i);
+      double* s_i = arena->template allocate_array<double>(cnt_i);
+      int* x_j = arena->template allocate_array<int>(cnt_j);
+      int* y_j = arena->template allocate_array<int>(cnt_j);
+      double* s_j = arena->template allocate_array<double>(cnt_j);
+      ReferenceIntegrals* current_reference_integrals = &this->reference_integrals[omp_get_thread_num()];
+      QuadTensorFactors* factors_i = current_reference_integrals->split(shapeset_i, 1, e, order, current_als_i, x_i, y_i, s_i);
+      if(factors_i == NULL)
+        return false;
+      QuadTensorFactors* factors_j = current_reference_integrals->split(shapeset_j, 0, e, order, current_als_j, x_j, y_j, s_j);
+      if(factors_j == NULL)
+        return false;
+      int np = factors_i->get_num_points();
+      if(np * np != n)
+        return false;
+
+      // Weights of the terms in the reference coordinates: u v, du/dxi dv/dxi, du/deta dv/deta and the two mixed ones.
+      double2x2* m = current_refmap->is_jacobian_const() ? NULL : current_refmap->get_inv_ref_map(order);
+      double2x2* const_m = current_refmap->is_jacobian_const() ? current_refmap->get_const_inv_ref_map() : NULL;
+      Scalar* w_mass = arena->template allocate_array<Scalar>(n);
+      Scalar* w_xx = arena->template allocate_array<Scalar>(n);
+      Scalar* w_xy = arena->template allocate_array<Scalar>(n);
+      Scalar* w_yy = arena->template allocate_array<Scalar>(n);
+      bool has_mass = false, has_diffusion = false;
+      for(int k = 0; k < n; k++)
+      {
+        double2x2& mk = (m == NULL) ? *const_m : m[k];
+        w_mass[k] = jacobian_x_weights[k] * mass[k];
+        Scalar d = jacobian_x_weights[k] * diffusion[k];
+        w_xx[k] = d * (mk[0][0] * mk[0][0] + mk[1][0] * mk[1][0]);
+        w_xy[k] = d * (mk[0][0] * mk[0][1] + mk[1][0] * mk[1][1]);
+        w_yy[k] = d * (mk[0][1] * mk[0][1] + mk[1][1] * mk[1][1]);
+        if(mass[k] != Scalar(0.0))
+          has_mass = true;
+        if(diffusion[k] != Scalar(0.0))
+          has_diffusion = true;
+      }
+
+      // Terms: weights, derivative flags of the basis factors (x, y) and of the test factors (x, y).
+      Scalar* term_weights[5] = { w_mass, w_xx, w_yy, w_xy, w_xy };
+      bool term_derivatives[5][4] = { { false, false, false, false }, { true, false, true, false }, { false, true, false, true },
+        { true, false, false, true }, { false, true, true, false } };
+      bool term_present[5] = { has_mass, has_diffusion, has_diffusion, has_diffusion, has_diffusion };
+
+      for(int i = 0; i < cnt_i; i++)
+        for(int j = 0; j < cnt_j; j++)
+          form_values[i][j] = 0.0;
+
+      int ny_j = factors_j->get_num_factors(1), ny_i = factors_i->get_num_factors(1);
+      Scalar* t = arena->template allocate_array<Scalar>(np * ny_j * ny_i);
+      Scalar* wy = arena->template allocate_array<Scalar>(np);
+      for(int term = 0; term < 5; term++)
+      {
+        if(!term_present[term])
+          continue;
+        Scalar* w = term_weights[term];
+        bool* der = term_derivatives[term];
+
+        // t[i1][b][d] = sum_i2 w(i1, i2) Y_b(i2) Y_d(i2), b for the basis and d for the test factors.
+        for(int i1 = 0; i1 < np; i1++)
+        {
+          for(int b = 0; b < ny_j; b++)
+          {
+            const double* y_b = factors_j->get_values(1, b, der[1]);
+            for(int i2 = 0; i2 < np; i2++)
+              wy[i2] = w[i1 * np + i2] * y_b[i2];
+            for(int d = 0; d < ny_i; d++)
+            {
+              const double* y_d = factors_i->get_values(1, d, der[3]);
+              Scalar sum = 0.0;
+              for(int i2 = 0; i2 < np; i2++)
+                sum += wy[i2] * y_d[i2];
+              t[(i1 * ny_j + b) * ny_i + d] = sum;
+            }
+          }
+        }
+
+        // form_values[i][j] += s_i s_j sum_i1 X_a(i1) X_c(i1) t[i1][b][d].
+        for(int i = 0; i < cnt_i; i++)
+        {
+          const double* x_c = factors_i->get_values(0, x_i[i], der[2]);
+          for(int j = 0; j < cnt_j; j++)
+          {
+            const double* x_a = factors_j->get_values(0, x_j[j], der[0]);
+            Scalar sum = 0.0;
+            for(int i1 = 0; i1 < np; i1++)
+              sum += x_a[i1] * x_c[i1] * t[(i1 * ny_j + y_j[j]) * ny_i + y_i[i]];
+            form_values[i][j] += s_i[i] * s_j[j] * sum;
+          }
+        }
+      }
+
+      return true;
+    }
+
+    template<typename Scalar>
+    bool DiscreteProblem<Scalar>::batch_matrix_form(MatrixFormVol<Scalar>* form, int order, RefMap* current_refmap, AsmList<Scalar>* current_als_i, AsmList<Scalar>* current_als_j,
+      Traverse::State* current_state, int n_quadrature_points, Geom<double>* geometry, double* jacobian_x_weights, Func<Scalar>** u_ext, Func<Scalar>** ext)
+    {
+      // The own external functions of the form would have to be evaluated again when the batch is inserted.
+      if(element_batch_kernel == NULL || RungeKutta || form->ext.size() > 0)
+        return false;
+
+      // Both functions have to be defined on the same untransformed element with a constant reference map.
+      Element* e = current_state->e[form->i];
+      if(e != current_state->e[form->j] || current_state->sub_idx[form->i] != 0 || current_state->sub_idx[form->j] != 0 || !current_refmap->is_jacobian_const())
+        return false;
+
+      Shapeset* shapeset_i = this->spaces[form->i]->get_shapeset();
+      Shapeset* shapeset_j = this->spaces[form->j]->get_shapeset();
+      if(shapeset_i->get_num_components() > 1 || shapeset_j->get_num_components() > 1)
+        return false;
+
+      // Constrained functions (hanging nodes) are left to the numerical integration.
+      for(unsigned int i = 0; i < current_als_i->cnt; i++)
+        if(current_als_i->idx[i] < 0)
+          return false;
+      for(unsigned int j = 0; j < current_als_j->cnt; j++)
+        if(current_als_j->idx[j] < 0)
+          return false;
+
+      // The shape tables are evaluated in the standard integration points.
+      ElementMode2D mode = e->get_mode();
+      int n = n_quadrature_points;
+      if(n != g_quad_2d_std.get_num_points(order, mode))
+        return false;
+
+      MemoryArena* arena = get_assembling_arena();
+      Scalar* mass = arena->template allocate_array<Scalar>(n);
+      Scalar* diffusion = arena->template allocate_array<Scalar>(n);
+      if(!form->get_point_coefficients(n, u_ext, geometry, ext, mass, diffusion))
+        return false;
+
+      int test_table = get_batch_shape_table(shapeset_i, mode, order, current_als_i);
+      int basis_table = get_batch_shape_table(shapeset_j, mode, order, current_als_j);
+      ElementBatch*& batch = element_batches[omp_get_thread_num()].batches[std::make_pair(form, std::make_pair(test_table, basis_table))];
+      if(batch == NULL)
+      {
+        batch = new ElementBatch;
+        batch->form = form;
+        batch->order = order;
+        batch->test_table = test_table;
+        batch->basis_table = basis_table;
+        batch->num_points = n;
+      }
+
+      // Weights of the terms in the reference coordinates, as in calc_matrix_form_tensor_values().
+      double2x2* m = current_refmap->get_const_inv_ref_map();
+      double m_xx = (*m)[0][0] * (*m)[0][0] + (*m)[1][0] * (*m)[1][0];
+      double m_xy = (*m)[0][0] * (*m)[0][1] + (*m)[1][0] * (*m)[1][1];
+      double m_yy = (*m)[0][1] * (*m)[0][1] + (*m)[1][1] * (*m)[1][1];
+      size_t offset = batch->weights.size();
+      batch->weights.resize(offset + 4 * n);
+      Scalar* w = &batch->weights[offset];
+      for(int k = 0; k < n; k++)
+      {
+        Scalar d = jacobian_x_weights[k] * diffusion[k];
+        w[k] = jacobian_x_weights[k] * mass[k];
+        w[n + k] = d * m_xx;
+        w[2 * n + k] = d * m_xy;
+        w[3 * n + k] = d * m_yy;
+      }
+
+      batch->states.push_back(current_state);
+      batch->als_i.push_back(new AsmList<Scalar>(*current_als_i));
+      batch->als_j.push_back(new AsmList<Scalar>(*current_als_j));
+      return true;
+    }
+
+    template<typename Scalar>
+    int DiscreteProblem<Scalar>::get_batch_shape_table(Shapeset* shapeset, ElementMode2D mode, int order, AsmList<Scalar>* current_als)
+    {
+      std::vector<int> key;
+      key.push_back(shapeset->get_id());
+      key.push_back(mode);
+      key.push_back(order);
+      for(unsigned int i = 0; i < current_als->cnt; i++)
+        key.push_back(current_als->idx[i]);
+
+      int table;
+#pragma omp critical (element_batch_shape_tables)
+      {
+        std::map<std::vector<int>, int>::iterator it = batch_shape_tables.find(key);
+        if(it != batch_shape_tables.end())
+          table = it->second;
+        else
+        {
+          int np = g_quad_2d_std.get_num_points(order, mode);
+          double3* pt = g_quad_2d_std.get_points(order, mode);
+          double* x = new double[np];
+          double* y = new double[np];
+          for(int k = 0; k < np; k++)
+          {
+            x[k] = pt[k][0];
+            y[k] = pt[k][1];
+          }
+
+          // The values, dx and dy of all the functions one after another.
+          int cnt = current_als->cnt;
+          double* values = new double[3 * cnt * np];
+          for(int value_i = 0; value_i < 3; value_i++)
+            for(int i = 0; i < cnt; i++)
+              shapeset->get_values(value_i, current_als->idx[i], np, x, y, 0, mode, values + (value_i * cnt + i) * np);
+          table = element_batch_kernel->upload_shape_table(cnt, np, values, values + cnt * np, values + 2 * cnt * np);
+          batch_shape_tables.insert(std::make_pair(key, table));
+
+          delete [] x;
+          delete [] y;
+          delete [] values;
+        }
+      }
+      return table;
+    }
+
+    template<typename Scalar>
+    Scalar** DiscreteProblem<Scalar>::get_batched_form_values()
+    {
+      if(element_batch_kernel == NULL || element_batches == NULL)
+        return NULL;
+      return element_batches[omp_get_thread_num()].form_values;
+    }
+
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::flush_element_batches(bool all)
+    {
+      ElementBatches& thread_batches = element_batches[omp_get_thread_num()];
+      typename std::map<std::pair<MatrixFormVol<Scalar>*, std::pair<int, int> >, ElementBatch*>::iterator it;
+      for(it = thread_batches.batches.begin(); it != thread_batches.batches.end(); it++)
+      {
+        ElementBatch* batch = it->second;
+        int num_elements = batch->states.size();
+        if(num_elements == 0 || (!all && num_elements < element_batch_size))
+          continue;
+
+        // After a failure, the batches are only emptied.
+        if(!this->assembly_status.has_failed())
+        {
+          try
+          {
+            int cnt_i = batch->als_i[0]->cnt, cnt_j = batch->als_j[0]->cnt;
+            std::vector<Scalar> local_matrices(num_elements * cnt_i * cnt_j);
+            Hermes::Mixins::Profile::Section evaluation_section(&this->profile, PROFILE_FORM_EVALUATION);
+            element_batch_kernel->compute(batch->test_table, batch->basis_table, num_elements, &batch->weights.front(), &local_matrices.front());
+            evaluation_section.stop();
+
+            // The local matrices are inserted by assemble_matrix_form() as the values of the other forms are,
+            // the functions are not evaluated there.
+            std::vector<Scalar*> form_values(cnt_i);
+            std::vector<Func<double>*> no_fns(std::max(cnt_i, cnt_j), (Func<double>*)NULL);
+            for(int k = 0; k < num_elements; k++)
+            {
+              for(int i = 0; i < cnt_i; i++)
+                form_values[i] = &local_matrices[(k * cnt_i + i) * cnt_j];
+              thread_batches.form_values = &form_values.front();
+              get_assembling_arena()->reset();
+              this->assemble_matrix_form(batch->form, batch->order, &no_fns.front(), &no_fns.front(), NULL, NULL, batch->als_i[k], batch->als_j[k],
+                batch->states[k], 0, NULL, NULL, NULL);
+            }
+          }
+          catch(Hermes::Exceptions::Exception& e)
+          {
+            this->assembly_status.fail(e);
+          }
+          catch(std::exception& e)
+          {
+            this->assembly_status.fail(e);
+          }
+          thread_batches.form_values = NULL;
+        }
+
+        for(int k = 0; k < num_elements; k++)
+        {
+          delete batch->als_i[k];
+          delete batch->als_j[k];
+        }
+        batch->states.clear();
+        batch->als_i.clear();
+        batch->als_j.clear();
+        batch->weights.clear();
+      }
+    }
+
+    template<typename Scalar>
+    bool DiscreteProblem<Scalar>::calc_vector_form_tensor_values(VectorFormVol<Scalar>* form, int order, RefMap* current_refmap, AsmList<Scalar>* current_als,
+      Traverse::State* current_state, int n_quadrature_points, Geom<double>* geometry, double* jacobian_x_weights, Func<Scalar>** u_ext, Func<Scalar>** ext, Scalar* form_values)
+    {
+      Element* e = current_state->e[form->i];
+      if(!e->is_quad() || current_state->sub_idx[form->i] != 0)
+        return false;
+
+      Shapeset* shapeset = this->spaces[form->i]->get_shapeset();
+      if(shapeset->get_num_components() > 1)
+        return false;
+
+      MemoryArena* arena = get_assembling_arena();
+      int n = n_quadrature_points;
+      Scalar* f_val = arena->template allocate_array<Scalar>(n);
+      Scalar* f_dx = arena->template allocate_array<Scalar>(n);
+      Scalar* f_dy = arena->template allocate_array<Scalar>(n);
+      if(!form->get_point_fluxes(n, u_ext, geometry, ext, f_val, f_dx, f_dy))
+        return false;
+
+      int cnt = current_als->cnt;
+      int* x_i = arena->template allocate_array<int>(cnt);
+      int* y_i = arena->template allocate_array<int>(cnt);
+      double* s_i = arena->template allocate_array<double>(cnt);
+      QuadTensorFactors* factors = this->reference_integrals[omp_get_thread_num()].split(shapeset, 1, e, order, current_als, x_i, y_i, s_i);
+      if(factors == NULL)
+        return false;
+      int np = factors->get_num_points();
+      if(np * np != n)
+        return false;
+
+      // Fluxes in the reference coordinates: multiplying v, dv/dxi and dv/deta.
+      double2x2* m = current_refmap->is_jacobian_const() ? NULL : current_refmap->get_inv_ref_map(order);
+      double2x2* const_m = current_refmap->is_jacobian_const() ? current_refmap->get_const_inv_ref_map() : NULL;
+      Scalar* w_val = arena->template allocate_array<Scalar>(n);
+      Scalar* w_x = arena->template allocate_array<Scalar>(n);
+      Scalar* w_y = arena->template allocate_array<Scalar>(n);
+      for(int k = 0; k < n; k++)
+      {
+        double2x2& mk = (m == NULL) ? *const_m : m[k];
+        w_val[k] = jacobian_x_weights[k] * f_val[k];
+        w_x[k] = jacobian_x_weights[k] * (mk[0][0] * f_dx[k] + mk[1][0] * f_dy[k]);
+        w_y[k] = jacobian_x_weights[k] * (mk[0][1] * f_dx[k] + mk[1][1] * f_dy[k]);
+      }
+
+      Scalar* term_weights[3] = { w_val, w_x, w_y };
+      bool term_derivatives[3][2] = { { false, false }, { true, false }, { false, true } };
+
+      for(int i = 0; i < cnt; i++)
+        form_values[i] = 0.0;
+
+      int ny = factors->get_num_factors(1);
+      Scalar* t = arena->template allocate_array<Scalar>(np * ny);
+      for(int term = 0; term < 3; term++)
+      {
+        Scalar* w = term_weights[term];
+        bool* der = term_derivatives[term];
+
+        // t[i1][d] = sum_i2 w(i1, i2) Y_d(i2).
+        for(int i1 = 0; i1 < np; i1++)
+        {
+          for(int d = 0; d < ny; d++)
+          {
+            const double* y_d = factors->get_values(1, d, der[1]);
+            Scalar sum = 0.0;
+            for(int i2 = 0; i2 < np; i2++)
+              sum += w[i1 * np + i2] * y_d[i2];
+            t[i1 * ny + d] = sum;
+          }
+        }
+
+        // form_values[i] += s_i sum_i1 X_c(i1) t[i1][d].
+        for(int i = 0; i < cnt; i++)
+        {
+          const double* x_c = factors->get_values(0, x_i[i], der[0]);
+          Scalar sum = 0.0;
+          for(int i1 = 0; i1 < np; i1++)
+            sum += x_c[i1] * t[i1 * ny + y_i[i]];
+          form_values[i] += s_i[i] * sum;
+        }
+      }
+
+      return true;
+    }
+
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::assemble_matrix_form(MatrixForm<Scalar>* form, int order, Func<double>** base_fns, Func<double>** test_fns, Func<Scalar>** ext, Func<Scalar>** u_ext,
+      AsmList<Scalar>* current_als_i, AsmList<Scalar>* current_als_j, Traverse::State* current_state, int n_quadrature_points, Geom<double>* geometry, double* jacobian_x_weights,
+      RefMap* current_refmap)
+    {
+      Hermes::Mixins::Profile::Section evaluation_section(&this->profile, PROFILE_FORM_EVALUATION);
+      bool surface_form = (dynamic_cast<MatrixFormVol<Scalar>*>(form) == NULL);
+
+      double block_scaling_coefficient = this->block_scaling_coeff(form);
+
+      bool tra = (form->i != form->j) && (form->sym != 0);
+      bool sym = (form->i == form->j) && (form->sym == 1);
+
+      // Assemble the local stiffness matrix for the form form.
+      Scalar **local_stiffness_matrix = get_assembling_arena()->template allocate_matrix<Scalar>(std::max(current_als_i->cnt, current_als_j->cnt));
+
+      Func<Scalar>** local_ext = ext;
+      // If the user supplied custom ext functions for this form.
+      if(form->ext.size() > 0)
+      {
+        int local_ext_count = form->ext.size();
+        local_ext = get_assembling_arena()->template allocate_array<Func<Scalar>*>(local_ext_count);
+        for(int ext_i = 0; ext_i < local_ext_count; ext_i++)
+          if(form->ext[ext_i] != NULL)
+            local_ext[ext_i] = current_state->e[ext_i] == NULL ? NULL : init_fn(form->ext[ext_i], order);
           else
-            for(int u_ext_i = 0; u_ext_i < prevNewtonSize; u_ext_i++)
-              u_ext[u_ext_i] = NULL;
-        }
-
-        // - ext
-        int current_extCount = this->wf->ext.size();
-        Func<Scalar>** ext = NULL;
-        if(current_extCount > 0)
-        {
-          ext = new Func<Scalar>*[current_extCount];
-          for(int ext_i = 0; ext_i < current_extCount; ext_i++)
-            if(current_wf->ext[ext_i] != NULL)
-              ext[ext_i] = init_fn(current_wf->ext[ext_i], order);
-            else
-              ext[ext_i] = NULL;
-        }
+            local_ext[ext_i] = NULL;
+      }
 
-        if(RungeKutta)
-          for(int ext_i = 0; ext_i < this->RK_original_spaces_count; ext_i++)
-            u_ext[ext_i]->add(ext[current_extCount - this->RK_original_spaces_count + ext_i]);
+      // Account for the previous time level solution previously inserted at the back of ext.
+      if(RungeKutta)
+        u_ext += form->u_ext_offset;
 
-        if(current_mat != NULL)
-        {
-          for(int current_mfvol_i = 0; current_mfvol_i < wf->mfvol.size(); current_mfvol_i++)
-          {
-            MatrixFormVol<Scalar>* mfv = current_wf->mfvol[current_mfvol_i];
+      // Values of the form for all pairs of functions at once, if the form provides a batched evaluation.
+      Scalar **form_values = NULL;
+      if(!surface_form)
+      {
+        // The values computed by the element batch kernel are being inserted (flush_element_batches()).
+        form_values = get_batched_form_values();
+      }
+      if(!surface_form && form_values == NULL)
+      {
+        form_values = get_form_values_buffer(current_als_i->cnt, current_als_j->cnt);
+        bool reference_values = calc_matrix_form_reference_values(static_cast<MatrixFormVol<Scalar>*>(form), current_refmap, current_als_i, current_als_j, current_state, form_values);
 
-            if(!form_to_be_assembled(mfv, current_state))
-              continue;
+        // The element waits for the batch to be complete, the form has no own external functions to clean up.
+        if(!reference_values && batch_matrix_form(static_cast<MatrixFormVol<Scalar>*>(form), order, current_refmap, current_als_i, current_als_j, current_state,
+          n_quadrature_points, geometry, jacobian_x_weights, u_ext, local_ext))
+          return;
 
-            int form_i = mfv->i;
-            int form_j = mfv->j;
-            CacheRecordPerSubIdx* CacheRecordPerSubIdxI = cacheRecordPerSubIdx[form_i];
-            CacheRecordPerSubIdx* CacheRecordPerSubIdxJ = cacheRecordPerSubIdx[form_j];
+        if(!reference_values
+          && !calc_matrix_form_tensor_values(static_cast<MatrixFormVol<Scalar>*>(form), order, current_refmap, current_als_i, current_als_j, current_state,
+          n_quadrature_points, geometry, jacobian_x_weights, u_ext, local_ext, form_values)
+          && !static_cast<MatrixFormVol<Scalar>*>(form)->value_all(n_quadrature_points, jacobian_x_weights, u_ext, current_als_j->cnt, base_fns,
+          current_als_i->cnt, test_fns, geometry, local_ext, form_values))
+          form_values = NULL;
+      }
 
-            assemble_matrix_form(mfv, 
-              CacheRecordPerSubIdxI->order, 
-              CacheRecordPerSubIdxJ->fns, 
-              CacheRecordPerSubIdxI->fns, 
-              ext,
-              u_ext,
-              current_als[form_i], 
-              current_als[form_j], 
-              current_state, 
-              CacheRecordPerSubIdxI->n_quadrature_points, 
-              CacheRecordPerSubIdxI->geometry, 
-              CacheRecordPerSubIdxI->jacobian_x_weights);
-          }
-        }
-        if(current_rhs != NULL)
+      // The lists of the elements with hanging nodes contain every constrained shape function once per DOF it contributes to.
+      // With the constraint operator of the lists (see AsmList::shape_pos), the form is evaluated once per pair of the distinct
+      // shape functions and the constraints are applied to these values in one pass, giving the local matrix on the distinct DOFs
+      // that is inserted instead of the (larger) matrix of the entries.
+      bool constrained = current_als_i->has_constraint_operator() && current_als_j->has_constraint_operator();
+      Scalar **reduced_matrix = NULL;
+      if(constrained)
+      {
+        double factor = (surface_form ? 0.5 : 1.0) * block_scaling_coefficient * form->scaling_factor;
+
+        // The distinct shape functions contributing to some DOF.
+        bool* needed_i = get_assembling_arena()->template allocate_array<bool>(current_als_i->num_shapes);
+        bool* needed_j = get_assembling_arena()->template allocate_array<bool>(current_als_j->num_shapes);
+        memset(needed_i, 0, current_als_i->num_shapes * sizeof(bool));
+        memset(needed_j, 0, current_als_j->num_shapes * sizeof(bool));
+        for (unsigned int i = 0; i < current_als_i->cnt; i++)
+          if(current_als_i->dof_pos[i] >= 0 && std::abs(current_als_i->coef[i]) >= 1e-12)
+            needed_i[current_als_i->shape_pos[i]] = true;
+        for (unsigned int j = 0; j < current_als_j->cnt; j++)
+          if(current_als_j->dof_pos[j] >= 0 && std::abs(current_als_j->coef[j]) >= 1e-12)
+            needed_j[current_als_j->shape_pos[j]] = true;
+
+        Scalar **shape_values = get_assembling_arena()->template allocate_matrix<Scalar>(current_als_i->num_shapes, current_als_j->num_shapes);
+        for (unsigned int shape_i = 0; shape_i < current_als_i->num_shapes; shape_i++)
         {
-          for(int current_vfvol_i = 0; current_vfvol_i < wf->vfvol.size(); current_vfvol_i++)
+          if(!needed_i[shape_i])
+            continue;
+          int i = current_als_i->shape_entry[shape_i];
+          for (unsigned int shape_j = sym ? shape_i : 0; shape_j < current_als_j->num_shapes; shape_j++)
           {
-            VectorFormVol<Scalar>* vfv = current_wf->vfvol[current_vfvol_i];
-
-            if(!form_to_be_assembled(vfv, current_state))
+            if(!needed_j[shape_j])
               continue;
-
-            int form_i = vfv->i;
-            CacheRecordPerSubIdx* CacheRecordPerSubIdxI = cacheRecordPerSubIdx[form_i];
-
-            assemble_vector_form(vfv, 
-              CacheRecordPerSubIdxI->order, 
-              CacheRecordPerSubIdxI->fns, 
-              ext,
-              u_ext, 
-              current_als[form_i], 
-              current_state, 
-              CacheRecordPerSubIdxI->n_quadrature_points,
-              CacheRecordPerSubIdxI->geometry, 
-              CacheRecordPerSubIdxI->jacobian_x_weights);
+            int j = current_als_j->shape_entry[shape_j];
+            Scalar val = factor * (form_values != NULL ? form_values[i][j] : form->value(n_quadrature_points, jacobian_x_weights, u_ext, base_fns[j], test_fns[i], geometry, local_ext));
+            shape_values[shape_i][shape_j] = val;
+            if(sym)
+              shape_values[shape_j][shape_i] = val;
           }
         }
 
-        // Cleanup - u_ext
-        if(current_u_ext != NULL)
+        // The constraints: the sum of coef[i] coef[j] values(shape_pos[i], shape_pos[j]) over the entries of every pair of DOFs.
+        reduced_matrix = get_assembling_arena()->template allocate_matrix<Scalar>(std::max(current_als_i->num_reduced_dofs, current_als_j->num_reduced_dofs));
+        for (unsigned int i = 0; i < current_als_i->cnt; i++)
         {
-          for(int u_ext_i = 0; u_ext_i < prevNewtonSize; u_ext_i++)
-            if(current_u_ext[u_ext_i] != NULL && current_state->e[u_ext_i] != NULL)
-            {
-              u_ext[u_ext_i]->free_fn();
-              delete u_ext[u_ext_i];
-            }
-            delete [] u_ext;
+          if(current_als_i->dof_pos[i] < 0 || std::abs(current_als_i->coef[i]) < 1e-12)
+            continue;
+          Scalar* row = reduced_matrix[current_als_i->dof_pos[i]];
+          Scalar* values = shape_values[current_als_i->shape_pos[i]];
+          Scalar coef_i = current_als_i->coef[i];
+          for (unsigned int j = 0; j < current_als_j->cnt; j++)
+            if(current_als_j->dof_pos[j] >= 0)
+              row[current_als_j->dof_pos[j]] += values[current_als_j->shape_pos[j]] * current_als_j->coef[j] * coef_i;
         }
-
-        // Cleanup - ext
-        for(int ext_i = 0; ext_i < current_extCount; ext_i++)
+      }
+      else
+      {
+        // Actual form-specific calculation.
+        for (unsigned int i = 0; i < current_als_i->cnt; i++)
         {
-          if(current_wf->ext[ext_i] != NULL)
-          {
-            ext[ext_i]->free_fn();
-            delete ext[ext_i];
-          }
-        }
-          delete [] ext;
+          if(current_als_i->dof[i] < 0)
+            continue;
 
-          // Assemble surface integrals now: loop through surfaces of the element.
-          if(current_state->isBnd && (current_wf->mfsurf.size() > 0 || current_wf->vfsurf.size() > 0))
+          if((!tra || surface_form) && current_als_i->dof[i] < 0)
+            continue;
+          if(std::abs(current_als_i->coef[i]) < 1e-12)
+            continue;
+          if(!sym)
           {
-            for (current_state->isurf = 0; current_state->isurf < current_state->rep->nvert; current_state->isurf++)
+            for (unsigned int j = 0; j < current_als_j->cnt; j++)
             {
-              if(!current_state->bnd[current_state->isurf])
-                continue;
-
-              // Edge-wise parameters for WeakForm.
-              (const_cast<WeakForm<Scalar>*>(current_wf))->set_active_edge_state(current_state->e, current_state->isurf);
-
-              // Ext functions.
-              // - order
-              int orderSurf = cacheRecordPerSubIdx[rep_space_i]->orderSurface[current_state->isurf];
-              // - u_ext
-              int prevNewtonSize = this->wf->get_neq();
-              Func<Scalar>** u_extSurf = NULL;
-              if(!this->is_linear)
-              {
-                u_extSurf = new Func<Scalar>*[prevNewtonSize];
-                if(current_u_ext != NULL)
-                  for(int u_ext_surf_i = 0; u_ext_surf_i < prevNewtonSize; u_ext_surf_i++)
-                    if(current_u_ext[u_ext_surf_i] != NULL)
-                      u_extSurf[u_ext_surf_i] = current_state->e[u_ext_surf_i] == NULL ? NULL : init_fn(current_u_ext[u_ext_surf_i], orderSurf);
-                    else
-                      u_extSurf[u_ext_surf_i] = NULL;
-                else
-                  for(int u_ext_surf_i = 0; u_ext_surf_i < prevNewtonSize; u_ext_surf_i++)
-                    u_extSurf[u_ext_surf_i] = NULL;
-              }
-              // - ext
-              int current_extCount = this->wf->ext.size();
-              Func<Scalar>** extSurf = new Func<Scalar>*[current_extCount];
-              for(int ext_surf_i = 0; ext_surf_i < current_extCount; ext_surf_i++)
-                if(current_wf->ext[ext_surf_i] != NULL)
-                  extSurf[ext_surf_i] = current_state->e[ext_surf_i] == NULL ? NULL : init_fn(current_wf->ext[ext_surf_i], orderSurf);
-                else
-                  extSurf[ext_surf_i] = NULL;
-
-              if(RungeKutta)
-                for(int ext_surf_i = 0; ext_surf_i < this->RK_original_spaces_count; ext_surf_i++)
-                  u_extSurf[ext_surf_i]->add(extSurf[current_extCount - this->RK_original_spaces_count + ext_surf_i]);
-
-              if(current_mat != NULL)
+              if(current_als_j->dof[j] >= 0)
               {
-                for(int current_mfsurf_i = 0; current_mfsurf_i < wf->mfsurf.size(); current_mfsurf_i++)
-                {
-                  if(!form_to_be_assembled(current_wf->mfsurf[current_mfsurf_i], current_state))
-                    continue;
+                // Is this necessary, i.e. is there a coefficient smaller than 1e-12?
+                if(std::abs(current_als_j->coef[j]) < 1e-12)
+                  continue;
 
-                  int form_i = current_wf->mfsurf[current_mfsurf_i]->i;
-                  int form_j = current_wf->mfsurf[current_mfsurf_i]->j;
-                  CacheRecordPerSubIdx* CacheRecordPerSubIdxI = cacheRecordPerSubIdx[form_i];
-                  CacheRecordPerSubIdx* CacheRecordPerSubIdxJ = cacheRecordPerSubIdx[form_j];
+                Func<double>* u = base_fns[j];
+                Func<double>* v = test_fns[i];
 
-                  assemble_matrix_form(current_wf->mfsurf[current_mfsurf_i], 
-                    CacheRecordPerSubIdxI->orderSurface[current_state->isurf], 
-                    CacheRecordPerSubIdxJ->fnsSurface[current_state->isurf], 
-                    CacheRecordPerSubIdxI->fnsSurface[current_state->isurf], 
-                    extSurf, 
-                    u_extSurf,
-                    &current_alsSurface[form_i][current_state->isurf], 
-                    &current_alsSurface[form_j][current_state->isurf], 
-                    current_state, 
-                    CacheRecordPerSubIdxI->n_quadrature_pointsSurface[current_state->isurf], 
-                    CacheRecordPerSubIdxI->geometrySurface[current_state->isurf], 
-                    CacheRecordPerSubIdxI->jacobian_x_weightsSurface[current_state->isurf]);
-                }
+                if(surface_form)
+                  local_stiffness_matrix[i][j] = 0.5 * block_scaling_coefficient * (form_values != NULL ? form_values[i][j] : form->value(n_quadrature_points, jacobian_x_weights, u_ext, u, v, geometry, local_ext)) * form->scaling_factor * current_als_j->coef[j] * current_als_i->coef[i];
+                else
+                  local_stiffness_matrix[i][j] = block_scaling_coefficient * (form_values != NULL ? form_values[i][j] : form->value(n_quadrature_points, jacobian_x_weights, u_ext, u, v, geometry, local_ext)) * form->scaling_factor * current_als_j->coef[j] * current_als_i->coef[i];
               }
-
-              if(current_rhs != NULL)
+            }
+          }
+          // Symmetric block.
+          else
+          {
+            for (unsigned int j = 0; j < current_als_j->cnt; j++)
+            {
+              if(j < i && current_als_j->dof[j] >= 0)
+                continue;
+              if(current_als_j->dof[j] >= 0)
               {
-                for(int current_vfsurf_i = 0; current_vfsurf_i < wf->vfsurf.size(); current_vfsurf_i++)
-                {
-                  if(!form_to_be_assembled(current_wf->vfsurf[current_vfsurf_i], current_state))
-                    continue;
+                // Is this necessary, i.e. is there a coefficient smaller than 1e-12?
+                if(std::abs(current_als_j->coef[j]) < 1e-12)
+                  continue;
 
-                  int form_i = current_wf->vfsurf[current_vfsurf_i]->i;
-                  CacheRecordPerSubIdx* CacheRecordPerSubIdxI = cacheRecordPerSubIdx[form_i];
+                Func<double>* u = base_fns[j];
+                Func<double>* v = test_fns[i];
 
-                  assemble_vector_form(current_wf->vfsurf[current_vfsurf_i], 
-                    CacheRecordPerSubIdxI->orderSurface[current_state->isurf], 
-                    CacheRecordPerSubIdxI->fnsSurface[current_state->isurf], 
-                    extSurf, 
-                    u_extSurf, 
-                    &current_alsSurface[form_i][current_state->isurf], 
-                    current_state, 
-                    CacheRecordPerSubIdxI->n_quadrature_pointsSurface[current_state->isurf], 
-                    CacheRecordPerSubIdxI->geometrySurface[current_state->isurf], 
-                    CacheRecordPerSubIdxI->jacobian_x_weightsSurface[current_state->isurf]);
-                }
-              }
+                Scalar val = block_scaling_coefficient * (form_values != NULL ? form_values[i][j] : form->value(n_quadrature_points, jacobian_x_weights, u_ext, u, v, geometry, local_ext)) * form->scaling_factor * current_als_j->coef[j] * current_als_i->coef[i];
 
-              if(current_u_ext != NULL)
-              {
-                for(int u_ext_surf_i = 0; u_ext_surf_i < prevNewtonSize; u_ext_surf_i++)
-                  if(current_u_ext[u_ext_surf_i] != NULL)
-                  {
-                    u_extSurf[u_ext_surf_i]->free_fn();
-                    delete u_extSurf[u_ext_surf_i];
-                  }
-                  delete [] u_extSurf;
+                local_stiffness_matrix[i][j] = local_stiffness_matrix[j][i] = val;
               }
-
-              for(int ext_surf_i = 0; ext_surf_i < current_extCount; ext_surf_i++)
-                if(current_wf->ext[ext_surf_i] != NULL)
-                {
-                  extSurf[ext_surf_i]->free_fn();
-                  delete extSurf[ext_surf_i];
-                }
-                delete [] extSurf;
             }
-
-            for(unsigned int i = 0; i < this->spaces_size; i++)
-              if(current_state->e[i] != NULL)
-                delete [] current_alsSurface[i];
           }
+        }
+      }
 
-          if(cacheRecordPerSubIdx != NULL)
-            delete [] cacheRecordPerSubIdx;
-          if(current_alsSurface != NULL)
-            delete [] current_alsSurface;
-    }
-
-    template<typename Scalar>
-    int DiscreteProblem<Scalar>::calc_order_matrix_form(MatrixForm<Scalar> *form, RefMap** current_refmaps, Solution<Scalar>** current_u_ext, Traverse::State* current_state)
-    {
-      int order;
-
-      // order of solutions from the previous Newton iteration etc..
-      Func<Hermes::Ord>** u_ext_ord = new Func<Hermes::Ord>*[RungeKutta ? RK_original_spaces_count : this->wf->get_neq() - form->u_ext_offset];
-      Func<Hermes::Ord>** ext_ord = NULL;
-      int ext_size = std::max(form->ext.size(), form->wf->ext.size());
-      if(ext_size > 0)
-        ext_ord = new Func<Hermes::Ord>*[ext_size];
-      init_ext_orders(form, u_ext_ord, ext_ord, current_u_ext, current_state);
-
-      // Order of shape functions.
-      int max_order_j = this->spaces[form->j]->get_element_order(current_state->e[form->j]->id);
-      int max_order_i = this->spaces[form->i]->get_element_order(current_state->e[form->i]->id);
-      if(H2D_GET_V_ORDER(max_order_i) > H2D_GET_H_ORDER(max_order_i))
-        max_order_i = H2D_GET_V_ORDER(max_order_i);
-      else
-        max_order_i = H2D_GET_H_ORDER(max_order_i);
-      if(H2D_GET_V_ORDER(max_order_j) > H2D_GET_H_ORDER(max_order_j))
-        max_order_j = H2D_GET_V_ORDER(max_order_j);
-      else
-        max_order_j = H2D_GET_H_ORDER(max_order_j);
+      // Insert the local stiffness matrix into the global one.
+      evaluation_section.stop();
+      Hermes::Mixins::Profile::Section insertion_section(&this->profile, PROFILE_MATRIX_INSERTION);
 
-      for (unsigned int k = 0; k < current_state->rep->nvert; k++)
+      if(constrained)
       {
-        int eo = this->spaces[form->i]->get_edge_order(current_state->e[form->i], k);
-        if(eo > max_order_i)
-          max_order_i = eo;
-        eo = this->spaces[form->j]->get_edge_order(current_state->e[form->j], k);
-        if(eo > max_order_j)
-          max_order_j = eo;
+        unsigned int m = current_als_i->num_reduced_dofs, n = current_als_j->num_reduced_dofs;
+        add_to_matrix(m, n, reduced_matrix, current_als_i->reduced_dof, current_als_j->reduced_dof, NULL);
+        if(tra)
+        {
+          if(form->sym < 0)
+            chsgn(reduced_matrix, m, n);
+          transpose(reduced_matrix, m, n);
+          add_to_matrix(n, m, reduced_matrix, current_als_j->reduced_dof, current_als_i->reduced_dof, NULL);
+        }
       }
+      else
+      {
+        add_to_matrix(current_als_i->cnt, current_als_j->cnt, local_stiffness_matrix, current_als_i->dof, current_als_j->dof,
+          surface_form ? NULL : get_scatter_map(current_state, form->i, form->j, current_als_i, current_als_j));
 
-      Func<Hermes::Ord>* ou = init_fn_ord(max_order_j + (spaces[form->j]->get_shapeset()->get_num_components() > 1 ? 1 : 0));
-      Func<Hermes::Ord>* ov = init_fn_ord(max_order_i + (spaces[form->i]->get_shapeset()->get_num_components() > 1 ? 1 : 0));
-
-      // Total order of the vector form.
-      Hermes::Ord o = form->ord(1, &fake_wt, u_ext_ord, ou, ov, &geom_ord, ext_ord);
+        // Insert also the off-diagonal (anti-)symmetric block, if required.
+        if(tra)
+        {
+          if(form->sym < 0)
+            chsgn(local_stiffness_matrix, current_als_i->cnt, current_als_j->cnt);
+          transpose(local_stiffness_matrix, current_als_i->cnt, current_als_j->cnt);
 
-      adjust_order_to_refmaps(form, order, &o, current_refmaps);
+          add_to_matrix(current_als_j->cnt, current_als_i->cnt, local_stiffness_matrix, current_als_j->dof, current_als_i->dof,
+            surface_form ? NULL : get_scatter_map(current_state, form->j, form->i, current_als_j, current_als_i));
+        }
+      }
+      insertion_section.stop();
 
-      // Cleanup.
-      deinit_ext_orders(form, u_ext_ord, ext_ord);
-      delete [] u_ext_ord;
-      ou->free_ord();
-      delete ou;
-      ov->free_ord();
-      delete ov;
+      if(form->ext.size() > 0)
+      {
+        for(int ext_i = 0; ext_i < form->ext.size(); ext_i++)
+          if(form->ext[ext_i] != NULL)
+          {
+            local_ext[ext_i]->free_fn();
+            delete local_ext[ext_i];
+          }
+      }
 
-      return order;
+      if(RungeKutta)
+        u_ext -= form->u_ext_offset;
     }
 
     template<typename Scalar>
-    void DiscreteProblem<Scalar>::assemble_matrix_form(MatrixForm<Scalar>* form, int order, Func<double>** base_fns, Func<double>** test_fns, Func<Scalar>** ext, Func<Scalar>** u_ext,
-      AsmList<Scalar>* current_als_i, AsmList<Scalar>* current_als_j, Traverse::State* current_state, int n_quadrature_points, Geom<double>* geometry, double* jacobian_x_weights)
+    void DiscreteProblem<Scalar>::assemble_matrix_form_block(MatrixFormVolBlock<Scalar>* form, CacheRecordPerSubIdx** cacheRecordPerSubIdx, Func<Scalar>** ext, Func<Scalar>** u_ext,
+      AsmList<Scalar>** current_als, Traverse::State* current_state)
     {
-      bool surface_form = (dynamic_cast<MatrixFormVol<Scalar>*>(form) == NULL);
-
-      double block_scaling_coefficient = this->block_scaling_coeff(form);
-
-      bool tra = (form->i != form->j) && (form->sym != 0);
-      bool sym = (form->i == form->j) && (form->sym == 1);
+      Hermes::Mixins::Profile::Section evaluation_section(&this->profile, PROFILE_FORM_EVALUATION);
+
+      unsigned int block_count = form->get_block_count();
+      CacheRecordPerSubIdx* CacheRecordPerSubIdxI = cacheRecordPerSubIdx[form->i];
+      int order = CacheRecordPerSubIdxI->order;
+
+      // The test functions of the components i, i + 1, ... (rows) and the basis functions of j, j + 1, ... (columns), one after another.
+      int* v_counts = get_assembling_arena()->template allocate_array<int>(block_count);
+      int* u_counts = get_assembling_arena()->template allocate_array<int>(block_count);
+      Func<double>*** test_fns = get_assembling_arena()->template allocate_array<Func<double>**>(block_count);
+      Func<double>*** base_fns = get_assembling_arena()->template allocate_array<Func<double>**>(block_count);
+      int v_total = 0, u_total = 0;
+      // All the blocks can be integrated at once if the components share the element and thus the integration points.
+      bool shared_points = true;
+      for(unsigned int block_i = 0; block_i < block_count; block_i++)
+      {
+        v_counts[block_i] = current_als[form->i + block_i]->cnt;
+        u_counts[block_i] = current_als[form->j + block_i]->cnt;
+        test_fns[block_i] = cacheRecordPerSubIdx[form->i + block_i]->fns;
+        base_fns[block_i] = cacheRecordPerSubIdx[form->j + block_i]->fns;
+        v_total += v_counts[block_i];
+        u_total += u_counts[block_i];
+
+        unsigned int components[2] = { form->i + block_i, form->j + block_i };
+        for(int component_i = 0; component_i < 2; component_i++)
+          if(current_state->e[components[component_i]] != current_state->e[form->i] || current_state->sub_idx[components[component_i]] != current_state->sub_idx[form->i]
+            || cacheRecordPerSubIdx[components[component_i]]->n_quadrature_points != CacheRecordPerSubIdxI->n_quadrature_points)
+            shared_points = false;
+      }
 
-      // Assemble the local stiffness matrix for the form form.
-      Scalar **local_stiffness_matrix = new_matrix<Scalar>(std::max(current_als_i->cnt, current_als_j->cnt));
+      int* rows = get_assembling_arena()->template allocate_array<int>(v_total);
+      int* cols = get_assembling_arena()->template allocate_array<int>(u_total);
+      Scalar* row_coefs = get_assembling_arena()->template allocate_array<Scalar>(v_total);
+      Scalar* col_coefs = get_assembling_arena()->template allocate_array<Scalar>(u_total);
+      for(unsigned int block_i = 0, row = 0, col = 0; block_i < block_count; block_i++)
+      {
+        for(int k = 0; k < v_counts[block_i]; k++, row++)
+        {
+          rows[row] = current_als[form->i + block_i]->dof[k];
+          row_coefs[row] = current_als[form->i + block_i]->coef[k];
+        }
+        for(int k = 0; k < u_counts[block_i]; k++, col++)
+        {
+          cols[col] = current_als[form->j + block_i]->dof[k];
+          col_coefs[col] = current_als[form->j + block_i]->coef[k];
+        }
+      }
 
       Func<Scalar>** local_ext = ext;
       // If the user supplied custom ext functions for this form.
       if(form->ext.size() > 0)
       {
         int local_ext_count = form->ext.size();
-        local_ext = new Func<Scalar>*[local_ext_count];
+        local_ext = get_assembling_arena()->template allocate_array<Func<Scalar>*>(local_ext_count);
         for(int ext_i = 0; ext_i < local_ext_count; ext_i++)
           if(form->ext[ext_i] != NULL)
             local_ext[ext_i] = current_state->e[ext_i] == NULL ? NULL : init_fn(form->ext[ext_i], order);
@@ -1937,73 +4011,70 @@ namespace Hermes
       if(RungeKutta)
         u_ext += form->u_ext_offset;
 
-      // Actual form-specific calculation.
-      for (unsigned int i = 0; i < current_als_i->cnt; i++)
+      Scalar **local_stiffness_matrix = get_assembling_arena()->template allocate_matrix<Scalar>(v_total, u_total);
+      if(!shared_points || !form->value_all_blocks(CacheRecordPerSubIdxI->n_quadrature_points, CacheRecordPerSubIdxI->jacobian_x_weights, u_ext, u_counts, base_fns,
+        v_counts, test_fns, CacheRecordPerSubIdxI->geometry, local_ext, local_stiffness_matrix))
       {
-        if(current_als_i->dof[i] < 0)
-          continue;
+        // Block by block, each one integrated on the points of its test functions, as in assemble_matrix_form().
+        for(unsigned int block_i = 0, row = 0; block_i < block_count; row += v_counts[block_i], block_i++)
+        {
+          CacheRecordPerSubIdx* CacheRecordPerSubIdxBlock = cacheRecordPerSubIdx[form->i + block_i];
+          for(unsigned int block_j = 0, col = 0; block_j < block_count; col += u_counts[block_j], block_j++)
+            for(int i = 0; i < v_counts[block_i]; i++)
+              for(int j = 0; j < u_counts[block_j]; j++)
+              {
+                if(rows[row + i] < 0 || cols[col + j] < 0 || !form->has_block(block_i, block_j))
+                  local_stiffness_matrix[row + i][col + j] = 0.0;
+                else
+                  local_stiffness_matrix[row + i][col + j] = form->value_block(block_i, block_j, CacheRecordPerSubIdxBlock->n_quadrature_points,
+                  CacheRecordPerSubIdxBlock->jacobian_x_weights, u_ext, base_fns[block_j][j], test_fns[block_i][i], CacheRecordPerSubIdxBlock->geometry, local_ext);
+              }
+        }
+      }
 
-        if((!tra || surface_form) && current_als_i->dof[i] < 0)
-          continue;
-        if(std::abs(current_als_i->coef[i]) < 1e-12)
-          continue;
-        if(!sym)
+      // Scaling of the blocks and the coefficients of the assembly lists.
+      for(unsigned int block_i = 0, row = 0; block_i < block_count; row += v_counts[block_i], block_i++)
+        for(unsigned int block_j = 0, col = 0; block_j < block_count; col += u_counts[block_j], block_j++)
         {
-          for (unsigned int j = 0; j < current_als_j->cnt; j++)
-          {
-            if(current_als_j->dof[j] >= 0)
+          bool block_present = form->has_block(block_i, block_j);
+          double block_scaling_coefficient = form->scaling_factor;
+          if(current_block_weights != NULL)
+            block_scaling_coefficient *= current_block_weights->get_A(form->i + block_i, form->j + block_j);
+          for(int i = 0; i < v_counts[block_i]; i++)
+            for(int j = 0; j < u_counts[block_j]; j++)
             {
-              // Is this necessary, i.e. is there a coefficient smaller than 1e-12?
-              if(std::abs(current_als_j->coef[j]) < 1e-12)
-                continue;
-
-              Func<double>* u = base_fns[j];
-              Func<double>* v = test_fns[i];
-
-              if(surface_form)
-                local_stiffness_matrix[i][j] = 0.5 * block_scaling_coefficient * form->value(n_quadrature_points, jacobian_x_weights, u_ext, u, v, geometry, local_ext) * form->scaling_factor * current_als_j->coef[j] * current_als_i->coef[i];
+              if(!block_present || rows[row + i] < 0 || cols[col + j] < 0 || std::abs(row_coefs[row + i]) < 1e-12 || std::abs(col_coefs[col + j]) < 1e-12)
+                local_stiffness_matrix[row + i][col + j] = 0.0;
               else
-                local_stiffness_matrix[i][j] = block_scaling_coefficient * form->value(n_quadrature_points, jacobian_x_weights, u_ext, u, v, geometry, local_ext) * form->scaling_factor * current_als_j->coef[j] * current_als_i->coef[i];
+                local_stiffness_matrix[row + i][col + j] *= block_scaling_coefficient * row_coefs[row + i] * col_coefs[col + j];
             }
-          }
         }
-        // Symmetric block.
-        else
-        {
-          for (unsigned int j = 0; j < current_als_j->cnt; j++)
+
+      // Insert the local stiffness matrix of all the blocks into the global one,
+      // block by block if some of them are out of the sparse structure.
+      evaluation_section.stop();
+      Hermes::Mixins::Profile::Section insertion_section(&this->profile, PROFILE_MATRIX_INSERTION);
+      bool all_blocks_present = true;
+      for(unsigned int block_i = 0; block_i < block_count; block_i++)
+        for(unsigned int block_j = 0; block_j < block_count; block_j++)
+          if(!form->has_block(block_i, block_j))
+            all_blocks_present = false;
+      if(all_blocks_present)
+        add_to_matrix(v_total, u_total, local_stiffness_matrix, rows, cols, NULL);
+      else
+      {
+        Scalar** block_matrix = get_assembling_arena()->template allocate_array<Scalar*>(v_total);
+        for(unsigned int block_i = 0, row = 0; block_i < block_count; row += v_counts[block_i], block_i++)
+          for(unsigned int block_j = 0, col = 0; block_j < block_count; col += u_counts[block_j], block_j++)
           {
-            if(j < i && current_als_j->dof[j] >= 0)
+            if(!form->has_block(block_i, block_j))
               continue;
-            if(current_als_j->dof[j] >= 0)
-            {
-              // Is this necessary, i.e. is there a coefficient smaller than 1e-12?
-              if(std::abs(current_als_j->coef[j]) < 1e-12)
-                continue;
-
-              Func<double>* u = base_fns[j];
-              Func<double>* v = test_fns[i];
-
-              Scalar val = block_scaling_coefficient * form->value(n_quadrature_points, jacobian_x_weights, u_ext, u, v, geometry, local_ext) * form->scaling_factor * current_als_j->coef[j] * current_als_i->coef[i];
-
-              local_stiffness_matrix[i][j] = local_stiffness_matrix[j][i] = val;
-            }
+            for(int i = 0; i < v_counts[block_i]; i++)
+              block_matrix[i] = local_stiffness_matrix[row + i] + col;
+            add_to_matrix(v_counts[block_i], u_counts[block_j], block_matrix, rows + row, cols + col, NULL);
           }
-        }
-      }
-
-      // Insert the local stiffness matrix into the global one.
-
-      current_mat->add(current_als_i->cnt, current_als_j->cnt, local_stiffness_matrix, current_als_i->dof, current_als_j->dof);
-
-      // Insert also the off-diagonal (anti-)symmetric block, if required.
-      if(tra)
-      {
-        if(form->sym < 0)
-          chsgn(local_stiffness_matrix, current_als_i->cnt, current_als_j->cnt);
-        transpose(local_stiffness_matrix, current_als_i->cnt, current_als_j->cnt);
-
-        current_mat->add(current_als_j->cnt, current_als_i->cnt, local_stiffness_matrix, current_als_j->dof, current_als_i->dof);
       }
+      insertion_section.stop();
 
       if(form->ext.size() > 0)
       {
@@ -2013,28 +4084,16 @@ namespace Hermes
             local_ext[ext_i]->free_fn();
             delete local_ext[ext_i];
           }
-          delete [] local_ext;
       }
 
       if(RungeKutta)
         u_ext -= form->u_ext_offset;
-
-      // Cleanup.
-      delete [] local_stiffness_matrix;
     }
 
     template<typename Scalar>
     int DiscreteProblem<Scalar>::calc_order_vector_form(VectorForm<Scalar> *form, RefMap** current_refmaps, Solution<Scalar>** current_u_ext, Traverse::State* current_state)
     {
-      int order;
-
-      // order of solutions from the previous Newton iteration etc..
-      Func<Hermes::Ord>** u_ext_ord = new Func<Hermes::Ord>*[RungeKutta ? RK_original_spaces_count : this->wf->get_neq() - form->u_ext_offset];
-      Func<Hermes::Ord>** ext_ord = NULL;
-      int ext_size = std::max(form->ext.size(), form->wf->ext.size());
-      if(ext_size > 0)
-        ext_ord = new Func<Hermes::Ord>*[ext_size];
-      init_ext_orders(form, u_ext_ord, ext_ord, current_u_ext, current_state);
+      Hermes::Mixins::Profile::Section order_section(&this->profile, PROFILE_ORDER_CALCULATION);
 
       // Order of shape functions.
       int max_order_i = this->spaces[form->i]->get_element_order(current_state->e[form->i]->id);
@@ -2049,26 +4108,30 @@ namespace Hermes
         if(eo > max_order_i)
           max_order_i = eo;
       }
-      Func<Hermes::Ord>* ov = init_fn_ord(max_order_i + (spaces[form->i]->get_shapeset()->get_num_components() > 1 ? 1 : 0));
+      int order_v = max_order_i + (spaces[form->i]->get_shapeset()->get_num_components() > 1 ? 1 : 0);
 
-      // Total order of the vector form.
-      Hermes::Ord o = form->ord(1, &fake_wt, u_ext_ord, ov, &geom_ord, ext_ord);
+      std::vector<int> key;
+      key.push_back(order_v);
+      get_ext_orders(form, current_u_ext, current_state, key);
+      key.push_back(current_refmaps[form->i]->get_inv_ref_order());
+      key.push_back(current_refmaps[form->i]->get_active_element()->get_mode());
 
-      adjust_order_to_refmaps(form, order, &o, current_refmaps);
+      typename FormOrders::iterator it = form_orders[omp_get_thread_num()].find(std::make_pair((Form<Scalar>*)form, key));
+      if(it != form_orders[omp_get_thread_num()].end())
+        return it->second;
 
-      // Cleanup.
-      deinit_ext_orders(form, u_ext_ord, ext_ord);
-      delete [] u_ext_ord;
-      ov->free_ord();
-      delete ov;
+      int order = calc_order_form(form, false, 0, order_v, key, current_refmaps);
 
+      form_orders[omp_get_thread_num()].insert(std::make_pair(std::make_pair((Form<Scalar>*)form, key), order));
       return order;
     }
 
     template<typename Scalar>
     void DiscreteProblem<Scalar>::assemble_vector_form(VectorForm<Scalar>* form, int order, Func<double>** test_fns, Func<Scalar>** ext, Func<Scalar>** u_ext, 
-      AsmList<Scalar>* current_als_i, Traverse::State* current_state, int n_quadrature_points, Geom<double>* geometry, double* jacobian_x_weights)
+      AsmList<Scalar>* current_als_i, Traverse::State* current_state, int n_quadrature_points, Geom<double>* geometry, double* jacobian_x_weights,
+      RefMap* current_refmap)
     {
+      Hermes::Mixins::Profile::Section evaluation_section(&this->profile, PROFILE_FORM_EVALUATION);
       bool surface_form = (dynamic_cast<VectorFormVol<Scalar>*>(form) == NULL);
 
       Func<Scalar>** local_ext = ext;
@@ -2077,7 +4140,7 @@ namespace Hermes
       if(form->ext.size() > 0)
       {
         int local_ext_count = form->ext.size();
-        local_ext = new Func<Scalar>*[local_ext_count];
+        local_ext = get_assembling_arena()->template allocate_array<Func<Scalar>*>(local_ext_count);
         for(int ext_i = 0; ext_i < local_ext_count; ext_i++)
           if(form->ext[ext_i] != NULL)
             local_ext[ext_i] = init_fn(form->ext[ext_i], order);
@@ -2089,6 +4152,16 @@ namespace Hermes
       if(RungeKutta)
         u_ext += form->u_ext_offset;
 
+      // Values of the form for all test functions at once, if the form allows sum factorization.
+      Scalar* form_values = NULL;
+      if(!surface_form)
+      {
+        form_values = get_assembling_arena()->template allocate_array<Scalar>(current_als_i->cnt);
+        if(!calc_vector_form_tensor_values(static_cast<VectorFormVol<Scalar>*>(form), order, current_refmap, current_als_i, current_state,
+          n_quadrature_points, geometry, jacobian_x_weights, u_ext, local_ext, form_values))
+          form_values = NULL;
+      }
+
       // Actual form-specific calculation.
       for (unsigned int i = 0; i < current_als_i->cnt; i++)
       {
@@ -2105,9 +4178,9 @@ namespace Hermes
         if(surface_form)
           val = 0.5 * form->value(n_quadrature_points, jacobian_x_weights, u_ext, v, geometry, local_ext) * form->scaling_factor * current_als_i->coef[i];
         else
-          val = form->value(n_quadrature_points, jacobian_x_weights, u_ext, v, geometry, local_ext) * form->scaling_factor * current_als_i->coef[i];
+          val = (form_values != NULL ? form_values[i] : form->value(n_quadrature_points, jacobian_x_weights, u_ext, v, geometry, local_ext)) * form->scaling_factor * current_als_i->coef[i];
 
-        current_rhs->add(current_als_i->dof[i], val);
+        add_to_rhs(current_als_i->dof[i], val);
       }
 
       if(form->ext.size() > 0)
@@ -2118,7 +4191,6 @@ namespace Hermes
             local_ext[ext_i]->free_fn();
             delete local_ext[ext_i];
           }
-          delete [] local_ext;
       }
 
       if(RungeKutta)
@@ -2165,41 +4237,38 @@ namespace Hermes
     }
 
     template<typename Scalar>
-    void DiscreteProblem<Scalar>::init_ext_orders(Form<Scalar> *form, Func<Hermes::Ord>** oi, Func<Hermes::Ord>** oext, Solution<Scalar>** current_u_ext, Traverse::State* current_state)
+    void DiscreteProblem<Scalar>::get_ext_orders(Form<Scalar> *form, Solution<Scalar>** current_u_ext, Traverse::State* current_state, std::vector<int>& orders)
     {
       unsigned int prev_size = RungeKutta ? RK_original_spaces_count : this->wf->get_neq() - form->u_ext_offset;
       bool surface_form = (current_state->isurf > -1);
 
-      if(current_u_ext != NULL)
-        for(int i = 0; i < prev_size; i++)
-          if(current_u_ext[i + form->u_ext_offset] != NULL)
-            if(surface_form)
-              oi[i] = init_fn_ord(current_u_ext[i + form->u_ext_offset]->get_edge_fn_order(current_state->isurf) + (current_u_ext[i + form->u_ext_offset]->get_num_components() > 1 ? 1 : 0));
-            else
-              oi[i] = init_fn_ord(current_u_ext[i + form->u_ext_offset]->get_fn_order() + (current_u_ext[i + form->u_ext_offset]->get_num_components() > 1 ? 1 : 0));
-          else
-            oi[i] = init_fn_ord(0);
-      else
-        for(int i = 0; i < prev_size; i++)
-          oi[i] = init_fn_ord(0);
-
-      if(form->ext.size() > 0)
-      {
-        for (int i = 0; i < form->ext.size(); i++)
+      for(int i = 0; i < prev_size; i++)
+        if(current_u_ext != NULL && current_u_ext[i + form->u_ext_offset] != NULL)
           if(surface_form)
-            oext[i] = init_fn_ord(form->ext[i]->get_edge_fn_order(current_state->isurf) + (form->ext[i]->get_num_components() > 1 ? 1 : 0));
+            orders.push_back(current_u_ext[i + form->u_ext_offset]->get_edge_fn_order(current_state->isurf) + (current_u_ext[i + form->u_ext_offset]->get_num_components() > 1 ? 1 : 0));
           else
-            oext[i] = init_fn_ord(form->ext[i]->get_fn_order() + (form->ext[i]->get_num_components() > 1 ? 1 : 0));
-      }
+            orders.push_back(current_u_ext[i + form->u_ext_offset]->get_fn_order() + (current_u_ext[i + form->u_ext_offset]->get_num_components() > 1 ? 1 : 0));
+        else
+          orders.push_back(0);
 
-      else
-      {
-        for (int i = 0; i < form->wf->ext.size(); i++)
-          if(surface_form)
-            oext[i] = init_fn_ord(form->wf->ext[i]->get_edge_fn_order(current_state->isurf) + (form->wf->ext[i]->get_num_components() > 1 ? 1 : 0));
-          else
-            oext[i] = init_fn_ord(form->wf->ext[i]->get_fn_order() + (form->wf->ext[i]->get_num_components() > 1 ? 1 : 0));
-      }
+      Hermes::vector<MeshFunction<Scalar>*>& ext = form->ext.size() > 0 ? form->ext : form->wf->ext;
+      for (int i = 0; i < ext.size(); i++)
+        if(surface_form)
+          orders.push_back(ext[i]->get_edge_fn_order(current_state->isurf) + (ext[i]->get_num_components() > 1 ? 1 : 0));
+        else
+          orders.push_back(ext[i]->get_fn_order() + (ext[i]->get_num_components() > 1 ? 1 : 0));
+    }
+
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::init_ext_orders(Form<Scalar> *form, Func<Hermes::Ord>** oi, Func<Hermes::Ord>** oext, const int* orders)
+    {
+      unsigned int prev_size = RungeKutta ? RK_original_spaces_count : this->wf->get_neq() - form->u_ext_offset;
+      for(int i = 0; i < prev_size; i++)
+        oi[i] = init_fn_ord(orders[i]);
+
+      int ext_size = form->ext.size() > 0 ? form->ext.size() : form->wf->ext.size();
+      for (int i = 0; i < ext_size; i++)
+        oext[i] = init_fn_ord(orders[prev_size + i]);
     }
 
     template<typename Scalar>
@@ -2274,130 +4343,31 @@ namespace Hermes
 
       bool** processed = new bool*[current_state->rep->nvert];
       LightArray<NeighborSearch<Scalar>*>** neighbor_searches = new LightArray<NeighborSearch<Scalar>*>*[current_state->rep->nvert];
-      (5);
       unsigned int* num_neighbors = new unsigned int[current_state->rep->nvert];
 
       bool intra_edge_passed_DG[H2D_MAX_NUMBER_VERTICES];
       for(int a = 0; a < H2D_MAX_NUMBER_VERTICES; a++)
         intra_edge_passed_DG[a] = false;
 
-#pragma omp critical (DG)
+      for(current_state->isurf = 0; current_state->isurf < current_state->rep->nvert; current_state->isurf++)
       {
-        for(unsigned int i = 0; i < current_state->num; i++)
-          current_state->e[i]->visited = true;
-
-        for(current_state->isurf = 0; current_state->isurf < current_state->rep->nvert; current_state->isurf++)
+        bool inner_edge_for_dg = false;
+        for(int i = 0; i < this->spaces_size; i++)
+          if(current_state->e[i]->en[current_state->isurf]->marker == 0)
+            inner_edge_for_dg = true;
+        if(inner_edge_for_dg)
         {
-          bool inner_edge_for_dg = false;
-          for(int i = 0; i < this->spaces_size; i++)
-            if(current_state->e[i]->en[current_state->isurf]->marker == 0)
-              inner_edge_for_dg = true;
-          if(inner_edge_for_dg)
+          Hermes::Mixins::Profile::Section neighbor_search_section(&this->profile, PROFILE_DG_NEIGHBOR_SEARCH);
+          NeighborSearchRecord* record = get_neighbor_searches(current_state, min_dg_mesh_seq);
+          neighbor_search_section.stop();
+          if(record->intra_edge)
           {
-            neighbor_searches[current_state->isurf] = new LightArray<NeighborSearch<Scalar>*>(5);
-
-            if(!init_neighbors((*neighbor_searches[current_state->isurf]), current_state, min_dg_mesh_seq))
-            {
-              intra_edge_passed_DG[current_state->isurf] = true;
-              continue;
-            }
-            // Create a multimesh tree;
-            NeighborNode* root = new NeighborNode(NULL, 0);
-            build_multimesh_tree(root, (*neighbor_searches[current_state->isurf]));
-
-#ifdef DEBUG_DG_ASSEMBLING
-#pragma omp critical (debug_DG)
-            {
-              int id = 0;
-              bool pass = true;
-              if(DEBUG_DG_ASSEMBLING_ELEMENT != -1)
-              {
-                for(unsigned int i = 0; i < (*neighbor_searches[current_state->isurf]).get_size(); i++)
-                  if((*neighbor_searches[current_state->isurf]).present(i))
-                    if((*neighbor_searches[current_state->isurf]).get(i)->central_el->id == DEBUG_DG_ASSEMBLING_ELEMENT)
-                      pass = false;
-              }
-              else
-                pass = false;
-
-              if(!pass)
-                if(DEBUG_DG_ASSEMBLING_ISURF != -1)
-                  if(current_state->isurf != DEBUG_DG_ASSEMBLING_ISURF)
-                    pass = true;
-
-              if(!pass)
-              {
-                for(unsigned int i = 0; i < (*neighbor_searches[current_state->isurf]).get_size(); i++)
-                {
-                  if((*neighbor_searches[current_state->isurf]).present(i))
-                  {
-                    NeighborSearch<Scalar>* ns = (*neighbor_searches[current_state->isurf]).get(i);
-                    std::cout << (std::string)"The " << ++id << (std::string)"-th Neighbor search:: " << (std::string)"Central element: " << ns->central_el->id << (std::string)", Isurf: " << current_state->isurf << (std::string)", Original sub_idx: " << ns->original_central_el_transform << std::endl;
-                    for(int j = 0; j < ns->n_neighbors; j++)
-                    {
-                      std::cout << '\t' << (std::string)"The " << j << (std::string)"-th neighbor element: " << ns->neighbors[j]->id << std::endl;
-                      if(ns->central_transformations.present(j))
-                      {
-                        std::cout << '\t' << (std::string)"Central transformations: " << std::endl;
-                        for(int k = 0; k < ns->central_transformations.get(j)->num_levels; k++)
-                          std::cout << '\t' << '\t' << ns->central_transformations.get(j)->transf[k] << std::endl;
-                      }
-                      if(ns->neighbor_transformations.present(j))
-                      {
-                        std::cout << '\t' << (std::string)"Neighbor transformations: " << std::endl;
-                        for(int k = 0; k < ns->neighbor_transformations.get(j)->num_levels; k++)
-                          std::cout << '\t' << '\t' << ns->neighbor_transformations.get(j)->transf[k] << std::endl;
-                      }
-                    }
-                  }
-                }
-              }
-            }
-#endif
-
-            // Update all NeighborSearches according to the multimesh tree.
-            // After this, all NeighborSearches in neighbor_searches should have the same count
-            // of neighbors and proper set of transformations
-            // for the central and the neighbor element(s) alike.
-            // Also check that every NeighborSearch has the same number of neighbor elements.
-            num_neighbors[current_state->isurf] = 0;
-            for(unsigned int i = 0; i < (*neighbor_searches[current_state->isurf]).get_size(); i++)
-            {
-              if((*neighbor_searches[current_state->isurf]).present(i))
-              {
-                NeighborSearch<Scalar>* ns = (*neighbor_searches[current_state->isurf]).get(i);
-                update_neighbor_search(ns, root);
-                if(num_neighbors[current_state->isurf] == 0)
-                  num_neighbors[current_state->isurf] = ns->n_neighbors;
-                if(ns->n_neighbors != num_neighbors[current_state->isurf])
-                  throw Hermes::Exceptions::Exception("Num_neighbors of different NeighborSearches not matching in DiscreteProblem<Scalar>::assemble_surface_integrals().");
-              }
-            }
-
-            // Delete the multimesh tree;
-            delete root;
-
-            processed[current_state->isurf] = new bool[num_neighbors[current_state->isurf]];
-
-            for(unsigned int neighbor_i = 0; neighbor_i < num_neighbors[current_state->isurf]; neighbor_i++)
-            {
-              // If the active segment has already been processed (when the neighbor element was assembled), it is skipped.
-              // We test all neighbor searches, because in the case of intra-element edge, the neighboring (the same as central) element
-              // will be marked as visited, even though the edge was not calculated.
-              processed[current_state->isurf][neighbor_i] = true;
-              for(unsigned int i = 0; i < (*neighbor_searches[current_state->isurf]).get_size(); i++)
-              {
-                if((*neighbor_searches[current_state->isurf]).present(i))
-                {
-                  if(!(*neighbor_searches[current_state->isurf]).get(i)->neighbors.at(neighbor_i)->visited)
-                  {
-                    processed[current_state->isurf][neighbor_i] = false;
-                    break;
-                  }
-                }
-              }
-            }
+            intra_edge_passed_DG[current_state->isurf] = true;
+            continue;
           }
+          neighbor_searches[current_state->isurf] = record->neighbor_searches;
+          num_neighbors[current_state->isurf] = record->num_neighbors;
+          processed[current_state->isurf] = record->processed;
         }
       }
 
@@ -2425,13 +4395,6 @@ namespace Hermes
             current_state, current_mfDG, current_vfDG, fn,
             npss, nspss, nrefmap, (*neighbor_searches[current_state->isurf]), min_dg_mesh_seq, current_wf);
         }
-
-        // Delete the neighbor_searches array.
-        for(unsigned int i = 0; i < (*neighbor_searches[current_state->isurf]).get_size(); i++)
-          if((*neighbor_searches[current_state->isurf]).present(i))
-            delete (*neighbor_searches[current_state->isurf]).get(i);
-        delete neighbor_searches[current_state->isurf];
-        delete [] processed[current_state->isurf];
       }
 
       delete [] processed;
@@ -2457,6 +4420,10 @@ namespace Hermes
       std::map<unsigned int, PrecalcShapeset *> npss, std::map<unsigned int, PrecalcShapeset *> nspss, std::map<unsigned int, RefMap *> nrefmap,
       LightArray<NeighborSearch<Scalar>*>& neighbor_searches, unsigned int min_dg_mesh_seq, WeakForm<Scalar>* current_wf)
     {
+      // The matrix forms of the segment are assembled by the side owning it (see get_neighbor_searches()),
+      // the other side does not need the neighbor functions at all.
+      bool assemble_matrix = current_mat != NULL && DG_matrix_forms_present && !edge_processed;
+
       // Set the active segment in all NeighborSearches
       for(unsigned int i = 0; i < neighbor_searches.get_size(); i++)
       {
@@ -2484,7 +4451,7 @@ namespace Hermes
       }
 
       // For neighbor psss.
-      if(current_mat != NULL && DG_matrix_forms_present && !edge_processed)
+      if(assemble_matrix)
       {
         for(unsigned int idx_i = 0; idx_i < spaces.size(); idx_i++)
         {
@@ -2502,7 +4469,7 @@ namespace Hermes
         current_refmaps[i]->force_transform(current_pss[i]->get_transform(), current_pss[i]->get_ctm());
 
         // Neighbor.
-        if(current_mat != NULL && DG_matrix_forms_present && !edge_processed)
+        if(assemble_matrix)
         {
           nspss[i]->set_active_element(npss[i]->get_active_element());
           nspss[i]->set_master_transform();
@@ -2519,6 +4486,8 @@ namespace Hermes
       Geom<double>** geometry = new Geom<double>*[this->spaces_size];
       double** jacobian_x_weights = new double*[this->spaces_size];
       Geom<double>** e = new Geom<double>*[this->spaces_size];
+      // The geometry is shared with the spaces on the same mesh, this is the index of the space it was calculated for.
+      int* geometry_owner = new int[this->spaces_size];
       DiscontinuousFunc<double>*** testFunctions = new DiscontinuousFunc<double>**[this->spaces_size];
 
       // Create the extended shapeset on the union of the central element and its current neighbor.
@@ -2530,17 +4499,41 @@ namespace Hermes
           continue;
 
         nbs[i] = neighbor_searches.get(spaces[i]->get_mesh()->get_seq() - min_dg_mesh_seq);
-        ext_asmlist[i] = nbs[i]->create_extended_asmlist(spaces[i], current_als[i]);
         nbs[i]->set_quad_order(order);
-        order_base = order;
-        n_quadrature_points = init_surface_geometry_points(current_refmaps[i], order_base, current_state, geometry[i], jacobian_x_weights[i]);
-        e[i] = new InterfaceGeom<double>(geometry[i], nbs[i]->neighb_el->marker, nbs[i]->neighb_el->id, nbs[i]->neighb_el->get_diameter());
 
+        // The surface quadrature points on the edge are the same for all the spaces on one mesh.
+        geometry_owner[i] = i;
+        for (unsigned int j = 0; j < i; j++)
+          if(this->spaces[j]->get_type() == HERMES_L2_SPACE && this->spaces[j]->get_mesh()->get_seq() == this->spaces[i]->get_mesh()->get_seq())
+          {
+            geometry_owner[i] = j;
+            break;
+          }
+        if(geometry_owner[i] == i)
+        {
+          order_base = order;
+          n_quadrature_points = init_surface_geometry_points(current_refmaps[i], order_base, current_state, geometry[i], jacobian_x_weights[i]);
+          e[i] = new InterfaceGeom<double>(geometry[i], nbs[i]->neighb_el->marker, nbs[i]->neighb_el->id, nbs[i]->neighb_el->get_diameter());
+        }
+        else
+        {
+          geometry[i] = geometry[geometry_owner[i]];
+          jacobian_x_weights[i] = jacobian_x_weights[geometry_owner[i]];
+          e[i] = e[geometry_owner[i]];
+        }
+
+        if(!assemble_matrix)
+          continue;
+
+        ext_asmlist[i] = nbs[i]->create_extended_asmlist(spaces[i], current_als[i]);
         testFunctions[i] = new DiscontinuousFunc<double>*[ext_asmlist[i]->cnt];
         for (int func_i = 0; func_i < ext_asmlist[i]->cnt; func_i++)
         {
           if(ext_asmlist[i]->dof[func_i] < 0)
+          {
+            testFunctions[i][func_i] = NULL;
             continue;
+          }
 
           // Choose the correct shapeset for the test function.
           if(!ext_asmlist[i]->has_support_on_neighbor(func_i))
@@ -2562,7 +4555,7 @@ namespace Hermes
 
       DiscontinuousFunc<Scalar>** ext = init_ext_fns(current_wf->ext, neighbor_searches, order, min_dg_mesh_seq);
 
-      if(current_mat != NULL && DG_matrix_forms_present && !edge_processed)
+      if(assemble_matrix)
       {
         for(int current_mfsurf_i = 0; current_mfsurf_i < wf->mfDG.size(); current_mfsurf_i++)
         {
@@ -2582,6 +4575,12 @@ namespace Hermes
           typename NeighborSearch<Scalar>::ExtendedShapeset* ext_asmlist_v = ext_asmlist[m];
 
           Scalar **local_stiffness_matrix = new_matrix<Scalar>(std::max(ext_asmlist_u->cnt, ext_asmlist_v->cnt));
+
+          // The batched evaluation of all the pairs, if the form provides it.
+          Scalar** form_values = get_assembling_arena()->template allocate_matrix<Scalar>(ext_asmlist_v->cnt, ext_asmlist_u->cnt);
+          bool form_values_present = mfs->value_all(n_quadrature_points, jacobian_x_weights[n], ext_asmlist_u->cnt, testFunctions[n],
+            ext_asmlist_v->cnt, testFunctions[m], e[n], ext, form_values);
+
           for (int i = 0; i < ext_asmlist_v->cnt; i++)
           {
             if(ext_asmlist_v->dof[i] < 0)
@@ -2597,7 +4596,7 @@ namespace Hermes
                 DiscontinuousFunc<double>* u = testFunctions[n][j];
                 DiscontinuousFunc<double>* v = testFunctions[m][i];
 
-                Scalar res = mfs->value(n_quadrature_points, jacobian_x_weights[n], u, v, e[n], ext) * mfs->scaling_factor;
+                Scalar res = (form_values_present ? form_values[i][j] : mfs->value(n_quadrature_points, jacobian_x_weights[n], u, v, e[n], ext)) * mfs->scaling_factor;
 
                 support_neigh_u = ext_asmlist_u->has_support_on_neighbor(j);
 
@@ -2609,7 +4608,7 @@ namespace Hermes
             }
           }
 
-          current_mat->add(ext_asmlist_v->cnt, ext_asmlist_u->cnt, local_stiffness_matrix, ext_asmlist_v->dof, ext_asmlist_u->dof);
+          add_to_matrix(ext_asmlist_v->cnt, ext_asmlist_u->cnt, local_stiffness_matrix, ext_asmlist_v->dof, ext_asmlist_u->dof);
 
           delete [] local_stiffness_matrix;
         }
@@ -2617,7 +4616,7 @@ namespace Hermes
 
       for(int i = 0; i < this->spaces_size; i++)
       {
-        if(this->spaces[i]->get_type() != HERMES_L2_SPACE)
+        if(this->spaces[i]->get_type() != HERMES_L2_SPACE || !assemble_matrix)
           continue;
         for (int func_i = 0; func_i < ext_asmlist[i]->cnt; func_i++)
         {
@@ -2633,7 +4632,7 @@ namespace Hermes
       delete [] testFunctions;
       delete [] ext_asmlist;
       
-      if(current_rhs != NULL && DG_vector_forms_present)
+      if(current_rhs != NULL && DG_vector_forms_present && !vector_forms_skipped)
       {
         for (unsigned int ww = 0; ww < wf->vfDG.size(); ww++)
         {
@@ -2656,7 +4655,7 @@ namespace Hermes
 
             Func<double>* v = init_fn(current_spss[n], current_refmaps[n], nbs_v->get_quad_eo());
 
-            current_rhs->add(current_als[n]->dof[dof_i], 0.5 * vfs->value(n_quadrature_points, jacobian_x_weights[n], v, e[n], ext) * vfs->scaling_factor * current_als[n]->coef[dof_i]);
+            add_to_rhs(current_als[n]->dof[dof_i], 0.5 * vfs->value(n_quadrature_points, jacobian_x_weights[n], v, e[n], ext) * vfs->scaling_factor * current_als[n]->coef[dof_i]);
 
             v->free_fn();
             delete v;
@@ -2676,7 +4675,7 @@ namespace Hermes
 
       for(int i = 0; i < this->spaces_size; i++)
       {
-        if(this->spaces[i]->get_type() != HERMES_L2_SPACE)
+        if(this->spaces[i]->get_type() != HERMES_L2_SPACE || geometry_owner[i] != i)
           continue;
         delete [] jacobian_x_weights[i];
         e[i]->free();
@@ -2684,6 +4683,7 @@ namespace Hermes
       }
 
       delete [] nbs;
+      delete [] geometry_owner;
       delete [] geometry;
       delete [] jacobian_x_weights;
       delete [] e;
@@ -2759,9 +4759,262 @@ namespace Hermes
     }
 
     template<typename Scalar>
-    void DiscreteProblem<Scalar>::build_multimesh_tree(NeighborNode* root,
-      LightArray<NeighborSearch<Scalar>*>& neighbor_searches)
+    typename DiscreteProblem<Scalar>::NeighborSearchRecord* DiscreteProblem<Scalar>::get_neighbor_searches(Traverse::State* current_state, unsigned int min_dg_mesh_seq)
+    {
+      std::vector<uint64_t> key;
+      key.push_back(current_state->isurf);
+      for(unsigned int i = 0; i < spaces.size(); i++)
+      {
+        key.push_back(current_state->e[i]->id);
+        key.push_back(current_state->sub_idx[i]);
+      }
+
+      NeighborSearchRecord* record = NULL;
+#pragma omp critical (neighbor_search_records)
+      {
+        typename std::map<std::vector<uint64_t>, NeighborSearchRecord*>::iterator it = neighbor_search_records.find(key);
+        if(it != neighbor_search_records.end())
+          record = it->second;
+      }
+      if(record != NULL)
+        return record;
+
+      record = new NeighborSearchRecord;
+      record->neighbor_searches = new LightArray<NeighborSearch<Scalar>*>(5);
+      record->num_neighbors = 0;
+      record->processed = NULL;
+      record->intra_edge = init_neighbors(*record->neighbor_searches, current_state, min_dg_mesh_seq);
+
+      if(!record->intra_edge)
+      {
+        // Create a multimesh tree;
+        NeighborNode* root = build_multimesh_tree(*record->neighbor_searches);
+
+#ifdef DEBUG_DG_ASSEMBLING
+#pragma omp critical (debug_DG)
+        {
+          int id = 0;
+          bool pass = true;
+          if(DEBUG_DG_ASSEMBLING_ELEMENT != -1)
+          {
+            for(unsigned int i = 0; i < (*record->neighbor_searches).get_size(); i++)
+              if((*record->neighbor_searches).present(i))
+                if((*record->neighbor_searches).get(i)->central_el->id == DEBUG_DG_ASSEMBLING_ELEMENT)
+                  pass = false;
+          }
+          else
+            pass = false;
+
+          if(!pass)
+            if(DEBUG_DG_ASSEMBLING_ISURF != -1)
+              if(current_state->isurf != DEBUG_DG_ASSEMBLING_ISURF)
+                pass = true;
+
+          if(!pass)
+          {
+            for(unsigned int i = 0; i < (*record->neighbor_searches).get_size(); i++)
+            {
+              if((*record->neighbor_searches).present(i))
+              {
+                NeighborSearch<Scalar>* ns = (*record->neighbor_searches).get(i);
+                std::cout << (std::string)"The " << ++id << (std::string)"-th Neighbor search:: " << (std::string)"Central element: " << ns->central_el->id << (std::string)", Isurf: " << current_state->isurf << (std::string)", Original sub_idx: " << ns->original_central_el_transform << std::endl;
+                for(int j = 0; j < ns->n_neighbors; j++)
+                {
+                  std::cout << '\t' << (std::string)"The " << j << (std::string)"-th neighbor element: " << ns->neighbors[j]->id << std::endl;
+                  if(ns->central_transformations.present(j))
+                  {
+                    std::cout << '\t' << (std::string)"Central transformations: " << std::endl;
+                    for(int k = 0; k < ns->central_transformations.get(j)->num_levels; k++)
+                      std::cout << '\t' << '\t' << ns->central_transformations.get(j)->transf[k] << std::endl;
+                  }
+                  if(ns->neighbor_transformations.present(j))
+                  {
+                    std::cout << '\t' << (std::string)"Neighbor transformations: " << std::endl;
+                    for(int k = 0; k < ns->neighbor_transformations.get(j)->num_levels; k++)
+                      std::cout << '\t' << '\t' << ns->neighbor_transformations.get(j)->transf[k] << std::endl;
+                  }
+                }
+              }
+            }
+          }
+        }
+#endif
+
+        // Update all NeighborSearches according to the multimesh tree.
+        // After this, all NeighborSearches in neighbor_searches should have the same count
+        // of neighbors and proper set of transformations
+        // for the central and the neighbor element(s) alike.
+        // Also check that every NeighborSearch has the same number of neighbor elements.
+        for(unsigned int i = 0; i < record->neighbor_searches->get_size(); i++)
+        {
+          if(record->neighbor_searches->present(i))
+          {
+            NeighborSearch<Scalar>* ns = record->neighbor_searches->get(i);
+            update_neighbor_search(ns, root);
+            if(record->num_neighbors == 0)
+              record->num_neighbors = ns->n_neighbors;
+            if(ns->n_neighbors != record->num_neighbors)
+            {
+              delete [] root;
+              for(unsigned int j = 0; j < record->neighbor_searches->get_size(); j++)
+                if(record->neighbor_searches->present(j))
+                  delete record->neighbor_searches->get(j);
+              delete record->neighbor_searches;
+              delete record;
+              throw Hermes::Exceptions::Exception("Num_neighbors of different NeighborSearches not matching in DiscreteProblem<Scalar>::assemble_surface_integrals().");
+            }
+          }
+        }
+
+        // Delete the multimesh tree;
+        delete [] root;
+
+        // The segment belongs to the side with the lower element id on the first of the meshes that has different
+        // elements on the two sides. Both sides see the same pairs of elements, so exactly one of them owns the segment.
+        // If the elements coincide on all the meshes, the segment lies inside them and it is not assembled at all.
+        record->processed = new bool[record->num_neighbors];
+        for(unsigned int neighbor_i = 0; neighbor_i < record->num_neighbors; neighbor_i++)
+        {
+          record->processed[neighbor_i] = true;
+          for(unsigned int i = 0; i < record->neighbor_searches->get_size(); i++)
+          {
+            if(record->neighbor_searches->present(i))
+            {
+              NeighborSearch<Scalar>* ns = record->neighbor_searches->get(i);
+              if(ns->central_el != ns->neighbors.at(neighbor_i))
+              {
+                record->processed[neighbor_i] = ns->central_el->id > ns->neighbors.at(neighbor_i)->id;
+                break;
+              }
+            }
+          }
+        }
+      }
+
+#pragma omp critical (neighbor_search_records)
+      neighbor_search_records.insert(std::pair<std::vector<uint64_t>, NeighborSearchRecord*>(key, record));
+
+      return record;
+    }
+
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::free_neighbor_searches()
+    {
+      for(typename std::map<std::vector<uint64_t>, NeighborSearchRecord*>::iterator it = neighbor_search_records.begin(); it != neighbor_search_records.end(); it++)
+      {
+        for(unsigned int i = 0; i < it->second->neighbor_searches->get_size(); i++)
+          if(it->second->neighbor_searches->present(i))
+            delete it->second->neighbor_searches->get(i);
+        delete it->second->neighbor_searches;
+        delete [] it->second->processed;
+        delete it->second;
+      }
+      neighbor_search_records.clear();
+    }
+
+    template<typename Scalar>
+    DiscreteProblem<Scalar>::DGFaceTable::DGFaceTable(const Mesh* mesh)
+    {
+      int max_element_id = mesh->get_max_element_id();
+      neighbor_start = new int[max_element_id + 1];
+      memset(neighbor_start, 0, (max_element_id + 1) * sizeof(int));
+
+      // The neighbors of every element, without repetition (an element can touch a larger one along more edges).
+      std::vector<int> all_neighbors;
+      Element* e;
+      for_all_active_elements(e, mesh)
+      {
+        int first = all_neighbors.size();
+        NeighborSearch<Scalar> ns(e, mesh);
+        ns.set_ignore_errors(true);
+        for(unsigned int ed = 0; ed < e->get_nvert(); ed++)
+        {
+          ns.set_active_edge(ed);
+          const Hermes::vector<Element*>* edge_neighbors = ns.get_neighbors();
+          for(unsigned int neigh = 0; neigh < edge_neighbors->size(); neigh++)
+            if(std::find(all_neighbors.begin() + first, all_neighbors.end(), (*edge_neighbors)[neigh]->id) == all_neighbors.end())
+              all_neighbors.push_back((*edge_neighbors)[neigh]->id);
+        }
+        neighbor_start[e->id + 1] = all_neighbors.size() - first;
+      }
+
+      // The elements are visited in the order of their ids, so the neighbors are already stored by the ids.
+      for(int id = 0; id < max_element_id; id++)
+        neighbor_start[id + 1] += neighbor_start[id];
+      neighbors = new int[all_neighbors.size() > 0 ? all_neighbors.size() : 1];
+      if(!all_neighbors.empty())
+        memcpy(neighbors, &all_neighbors.front(), all_neighbors.size() * sizeof(int));
+    }
+
+    template<typename Scalar>
+    DiscreteProblem<Scalar>::DGFaceTable::~DGFaceTable()
+    {
+      delete [] neighbor_start;
+      delete [] neighbors;
+    }
+
+    template<typename Scalar>
+    typename DiscreteProblem<Scalar>::DGFaceTable* DiscreteProblem<Scalar>::get_dg_face_table(const Mesh* mesh)
+    {
+      typename std::map<unsigned int, DGFaceTable*>::iterator it = dg_face_tables.find(mesh->get_seq());
+      if(it != dg_face_tables.end())
+        return it->second;
+      DGFaceTable* face_table = new DGFaceTable(mesh);
+      dg_face_tables.insert(std::pair<unsigned int, DGFaceTable*>(mesh->get_seq(), face_table));
+      return face_table;
+    }
+
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::free_dg_face_tables(bool all)
+    {
+      typename std::map<unsigned int, DGFaceTable*>::iterator it = dg_face_tables.begin();
+      while(it != dg_face_tables.end())
+      {
+        bool used = false;
+        for(unsigned int space_i = 0; space_i < spaces.size() && !all && !used; space_i++)
+          if(spaces[space_i]->get_mesh()->get_seq() == it->first)
+            used = true;
+        if(used)
+          it++;
+        else
+        {
+          delete it->second;
+          dg_face_tables.erase(it++);
+        }
+      }
+    }
+
+    template<typename Scalar>
+    void DiscreteProblem<Scalar>::update_neighbor_searches()
     {
+      Hermes::vector<const Mesh*> meshes;
+      for(unsigned int space_i = 0; space_i < spaces.size(); space_i++)
+        meshes.push_back(spaces[space_i]->get_mesh());
+      if(traverse_states.update(&(meshes.front()), meshes.size()))
+        free_neighbor_searches();
+    }
+
+    template<typename Scalar>
+    NeighborNode* DiscreteProblem<Scalar>::build_multimesh_tree(LightArray<NeighborSearch<Scalar>*>& neighbor_searches)
+    {
+      // Every transformation adds at most one node per level, so the total length of the transformations
+      // (plus the root) bounds the size of the tree and all the nodes can be allocated at once.
+      unsigned int node_count = 1;
+      for(unsigned int i = 0; i < neighbor_searches.get_size(); i++)
+        if(neighbor_searches.present(i))
+        {
+          NeighborSearch<Scalar>* ns = neighbor_searches.get(i);
+          if(ns->n_neighbors == 1 &&
+            (ns->central_transformations.get_size() == 0 || ns->central_transformations.get(0)->num_levels == 0))
+            continue;
+          for(unsigned int j = 0; j < ns->n_neighbors; j++)
+            if(ns->central_transformations.present(j))
+              node_count += ns->central_transformations.get(j)->num_levels;
+        }
+
+      NeighborNode* root = new NeighborNode[node_count];
+      NeighborNode* free_nodes = root + 1;
+
       for(unsigned int i = 0; i < neighbor_searches.get_size(); i++)
         if(neighbor_searches.present(i))
         {
@@ -2771,14 +5024,16 @@ namespace Hermes
             continue;
           for(unsigned int j = 0; j < ns->n_neighbors; j++)
             if(ns->central_transformations.present(j))
-              insert_into_multimesh_tree(root, ns->central_transformations.get(j)->transf, ns->central_transformations.get(j)->num_levels);
+              insert_into_multimesh_tree(root, ns->central_transformations.get(j)->transf, ns->central_transformations.get(j)->num_levels, free_nodes);
         }
+
+      return root;
     }
 
     template<typename Scalar>
     void DiscreteProblem<Scalar>::insert_into_multimesh_tree(NeighborNode* node,
       unsigned int* transformations,
-      unsigned int transformation_count)
+      unsigned int transformation_count, NeighborNode*& free_nodes)
     {
       // If we are already in the leaf.
       if(transformation_count == 0)
@@ -2786,8 +5041,8 @@ namespace Hermes
       // Both sons are null. We have to add a new Node. Let us do it for the left sone of node.
       if(node->get_left_son() == NULL && node->get_right_son() == NULL)
       {
-        node->set_left_son(new NeighborNode(node, transformations[0]));
-        insert_into_multimesh_tree(node->get_left_son(), transformations + 1, transformation_count - 1);
+        node->set_left_son(new (free_nodes++) NeighborNode(node, transformations[0]));
+        insert_into_multimesh_tree(node->get_left_son(), transformations + 1, transformation_count - 1, free_nodes);
       }
       // At least the left son is not null (it is impossible only for the right one to be not null, because
       // the left one always gets into the tree first, as seen above).
@@ -2795,20 +5050,20 @@ namespace Hermes
       {
         // The existing left son is the right one to continue through.
         if(node->get_left_son()->get_transformation() == transformations[0])
-          insert_into_multimesh_tree(node->get_left_son(), transformations + 1, transformation_count - 1);
+          insert_into_multimesh_tree(node->get_left_son(), transformations + 1, transformation_count - 1, free_nodes);
         // The right one also exists, check that it is the right one, or return an error.
         else if(node->get_right_son() != NULL)
         {
           if(node->get_right_son()->get_transformation() == transformations[0])
-            insert_into_multimesh_tree(node->get_right_son(), transformations + 1, transformation_count - 1);
+            insert_into_multimesh_tree(node->get_right_son(), transformations + 1, transformation_count - 1, free_nodes);
           else
             throw Hermes::Exceptions::Exception("More than two possible sons in insert_into_multimesh_tree().");
         }
         // If the right one does not exist and the left one was not correct, create a right son and continue this way.
         else
         {
-          node->set_right_son(new NeighborNode(node, transformations[0]));
-          insert_into_multimesh_tree(node->get_right_son(), transformations + 1, transformation_count - 1);
+          node->set_right_son(new (free_nodes++) NeighborNode(node, transformations[0]));
+          insert_into_multimesh_tree(node->get_right_son(), transformations + 1, transformation_count - 1, free_nodes);
         }
       }
     }
@@ -3090,16 +5345,7 @@ namespace Hermes
     }
     NeighborNode::~NeighborNode()
     {
-      if(left_son != NULL)
-      {
-        delete left_son;
-        left_son = NULL;
-      }
-      if(right_son != NULL)
-      {
-        delete right_son;
-        right_son = NULL;
-      }
+      // The sons are in the same array as this node (see DiscreteProblem::build_multimesh_tree()).
     }
     void NeighborNode::set_left_son(NeighborNode* left_son)
     {
@@ -16,6 +16,7 @@
 #include "discrete_problem_linear.h"
 #include <iostream>
 #include <algorithm>
+#include <typeinfo>
 #include "global.h"
 #include "integrals/h1.h"
 #include "quadrature/limit_order.h"
@@ -34,19 +35,28 @@ namespace Hermes
   namespace Hermes2D
   {
     template<typename Scalar>
-    DiscreteProblemLinear<Scalar>::DiscreteProblemLinear(const WeakForm<Scalar>* wf, Hermes::vector<const Space<Scalar> *> spaces) : DiscreteProblem<Scalar>(wf, spaces)
+    DiscreteProblemLinear<Scalar>::DiscreteProblemLinear(const WeakForm<Scalar>* wf, Hermes::vector<const Space<Scalar> *> spaces) : DiscreteProblem<Scalar>(wf, spaces),
+      dirichlet_lift(NULL), dirichlet_lift_sp_seq(NULL), dirichlet_lift_added(false),
+      time_independent_matrix(NULL), time_independent_lift(NULL), time_independent_sp_seq(NULL), time_independent_wf(NULL),
+      time_independent_force_diagonal_blocks(false), time_independent_block_weights(NULL)
     {
       this->is_linear = true;
     }
 
     template<typename Scalar>
-    DiscreteProblemLinear<Scalar>::DiscreteProblemLinear(const WeakForm<Scalar>* wf, const Space<Scalar>* space) : DiscreteProblem<Scalar>(wf, space)
+    DiscreteProblemLinear<Scalar>::DiscreteProblemLinear(const WeakForm<Scalar>* wf, const Space<Scalar>* space) : DiscreteProblem<Scalar>(wf, space),
+      dirichlet_lift(NULL), dirichlet_lift_sp_seq(NULL), dirichlet_lift_added(false),
+      time_independent_matrix(NULL), time_independent_lift(NULL), time_independent_sp_seq(NULL), time_independent_wf(NULL),
+      time_independent_force_diagonal_blocks(false), time_independent_block_weights(NULL)
     {
       this->is_linear = true;
     }
 
     template<typename Scalar>
-    DiscreteProblemLinear<Scalar>::DiscreteProblemLinear() : DiscreteProblem<Scalar>()
+    DiscreteProblemLinear<Scalar>::DiscreteProblemLinear() : DiscreteProblem<Scalar>(),
+      dirichlet_lift(NULL), dirichlet_lift_sp_seq(NULL), dirichlet_lift_added(false),
+      time_independent_matrix(NULL), time_independent_lift(NULL), time_independent_sp_seq(NULL), time_independent_wf(NULL),
+      time_independent_force_diagonal_blocks(false), time_independent_block_weights(NULL)
     {
       this->is_linear = true;
     }
@@ -54,6 +64,175 @@ namespace Hermes
     template<typename Scalar>
     DiscreteProblemLinear<Scalar>::~DiscreteProblemLinear()
     {
+      delete [] dirichlet_lift;
+      delete [] dirichlet_lift_sp_seq;
+      invalidate_time_independent_matrix();
+    }
+
+    template<typename Scalar>
+    void DiscreteProblemLinear<Scalar>::assemble_operator(SparseMatrix<Scalar>* mat, bool force_diagonal_blocks, Table* block_weights)
+    {
+      if(mat == NULL)
+        throw Exceptions::NullException(1);
+
+      // The right-hand side receives the Dirichlet lift only.
+      KrylovVector<Scalar> lift;
+      this->vector_forms_skipped = true;
+      try
+      {
+        this->assemble(mat, &lift, force_diagonal_blocks, block_weights);
+      }
+      catch(Hermes::Exceptions::Exception&)
+      {
+        this->vector_forms_skipped = false;
+        throw;
+      }
+      this->vector_forms_skipped = false;
+
+      delete [] dirichlet_lift;
+      delete [] dirichlet_lift_sp_seq;
+      dirichlet_lift = new Scalar[this->ndof];
+      lift.extract(dirichlet_lift);
+      dirichlet_lift_sp_seq = new int[this->spaces_size];
+      for(unsigned int i = 0; i < this->spaces_size; i++)
+        dirichlet_lift_sp_seq[i] = this->spaces[i]->get_seq();
+    }
+
+    template<typename Scalar>
+    void DiscreteProblemLinear<Scalar>::assemble_rhs(Vector<Scalar>* rhs)
+    {
+      if(rhs == NULL)
+        throw Exceptions::NullException(1);
+      if(dirichlet_lift == NULL)
+        throw Exceptions::Exception("DiscreteProblemLinear::assemble_operator() has to be called before assemble_rhs().");
+      for(unsigned int i = 0; i < this->spaces_size; i++)
+        if(this->spaces[i]->get_seq() != dirichlet_lift_sp_seq[i])
+          throw Exceptions::Exception("The spaces changed since DiscreteProblemLinear::assemble_operator(), the operator has to be assembled again.");
+
+      // Without a matrix, the matrix forms are skipped altogether.
+      dirichlet_lift_added = true;
+      try
+      {
+        this->assemble(NULL, rhs);
+      }
+      catch(Hermes::Exceptions::Exception&)
+      {
+        dirichlet_lift_added = false;
+        throw;
+      }
+      dirichlet_lift_added = false;
+    }
+
+    template<typename Scalar>
+    void DiscreteProblemLinear<Scalar>::assemble_rhs(Hermes::vector<Hermes::vector<MeshFunction<Scalar>*> > ext_sets, Scalar* rhs_block)
+    {
+      if(rhs_block == NULL)
+        throw Exceptions::NullException(2);
+
+      WeakForm<Scalar>* mutable_wf = const_cast<WeakForm<Scalar>*>(this->wf);
+      Hermes::vector<MeshFunction<Scalar>*> original_ext = mutable_wf->get_ext();
+      KrylovVector<Scalar> rhs;
+      try
+      {
+        for(unsigned int rhs_i = 0; rhs_i < ext_sets.size(); rhs_i++)
+        {
+          mutable_wf->set_ext(ext_sets[rhs_i]);
+          assemble_rhs(&rhs);
+          rhs.extract(rhs_block + rhs_i * this->ndof);
+        }
+      }
+      catch(Hermes::Exceptions::Exception&)
+      {
+        mutable_wf->set_ext(original_ext);
+        throw;
+      }
+      mutable_wf->set_ext(original_ext);
+    }
+
+    template<typename Scalar>
+    void DiscreteProblemLinear<Scalar>::invalidate_time_independent_matrix()
+    {
+      delete time_independent_matrix;
+      time_independent_matrix = NULL;
+      delete [] time_independent_lift;
+      time_independent_lift = NULL;
+      delete [] time_independent_sp_seq;
+      time_independent_sp_seq = NULL;
+      time_independent_wf = NULL;
+    }
+
+    template<typename Scalar>
+    bool DiscreteProblemLinear<Scalar>::has_time_independent_matrix_forms() const
+    {
+      for(unsigned int i = 0; i < this->wf->mfvol.size(); i++)
+        if(this->wf->mfvol[i]->is_time_independent())
+          return true;
+      for(unsigned int i = 0; i < this->wf->mfsurf.size(); i++)
+        if(this->wf->mfsurf[i]->is_time_independent())
+          return true;
+      for(unsigned int i = 0; i < this->wf->mfDG.size(); i++)
+        if(this->wf->mfDG[i]->is_time_independent())
+          return true;
+      return false;
+    }
+
+    template<typename Scalar>
+    bool DiscreteProblemLinear<Scalar>::time_independent_matrix_up_to_date(bool force_diagonal_blocks, Table* block_weights) const
+    {
+      if(time_independent_matrix == NULL || time_independent_wf != this->wf)
+        return false;
+      if(time_independent_force_diagonal_blocks != force_diagonal_blocks || time_independent_block_weights != block_weights)
+        return false;
+      for(unsigned int i = 0; i < this->spaces_size; i++)
+        if(this->spaces[i]->get_seq() != time_independent_sp_seq[i])
+          return false;
+      return true;
+    }
+
+    template<typename Scalar>
+    bool DiscreteProblemLinear<Scalar>::assemble_time_independent_matrix(SparseMatrix<Scalar>* mat, bool force_diagonal_blocks, Table* block_weights)
+    {
+      invalidate_time_independent_matrix();
+
+      // The kept matrix is added to mat by SparseMatrix::add_sparse_matrix(), both have to be of the same type.
+      SparseMatrix<Scalar>* matrix = create_matrix<Scalar>();
+      if(typeid(*matrix) != typeid(*mat))
+      {
+        delete matrix;
+        Hermes::Mixins::Loggable::Static::warn("DiscreteProblemLinear: the matrix is not of the type of the matrix solver, the time-independent forms are assembled at every step.");
+        return false;
+      }
+
+      // Only the time-independent matrix forms, the right-hand side receives their Dirichlet lift.
+      // (assemble_operator() skips the vector forms as well, the setting is restored afterwards.)
+      KrylovVector<Scalar> lift;
+      bool vector_forms_skipped = this->vector_forms_skipped;
+      this->vector_forms_skipped = true;
+      this->matrix_forms_selection = DiscreteProblem<Scalar>::MATRIX_FORMS_TIME_INDEPENDENT;
+      try
+      {
+        assemble_forms(matrix, &lift, force_diagonal_blocks, block_weights);
+      }
+      catch(Hermes::Exceptions::Exception&)
+      {
+        this->vector_forms_skipped = vector_forms_skipped;
+        this->matrix_forms_selection = DiscreteProblem<Scalar>::MATRIX_FORMS_ALL;
+        delete matrix;
+        throw;
+      }
+      this->vector_forms_skipped = vector_forms_skipped;
+      this->matrix_forms_selection = DiscreteProblem<Scalar>::MATRIX_FORMS_ALL;
+
+      time_independent_matrix = matrix;
+      time_independent_lift = new Scalar[this->ndof];
+      lift.extract(time_independent_lift);
+      time_independent_sp_seq = new int[this->spaces_size];
+      for(unsigned int i = 0; i < this->spaces_size; i++)
+        time_independent_sp_seq[i] = this->spaces[i]->get_seq();
+      time_independent_wf = this->wf;
+      time_independent_force_diagonal_blocks = force_diagonal_blocks;
+      time_independent_block_weights = block_weights;
+      return true;
     }
 
     template<typename Scalar>
@@ -61,14 +240,56 @@ namespace Hermes
       Vector<Scalar>* rhs,
       bool force_diagonal_blocks,
       Table* block_weights)
+    {
+      if(mat == NULL || this->wf == NULL || !has_time_independent_matrix_forms())
+      {
+        assemble_forms(mat, rhs, force_diagonal_blocks, block_weights);
+        return;
+      }
+
+      if(!time_independent_matrix_up_to_date(force_diagonal_blocks, block_weights))
+      {
+        this->check();
+        if(!assemble_time_independent_matrix(mat, force_diagonal_blocks, block_weights))
+        {
+          assemble_forms(mat, rhs, force_diagonal_blocks, block_weights);
+          return;
+        }
+      }
+
+      // The time-dependent matrix forms and all the vector forms, then the kept contribution.
+      this->matrix_forms_selection = DiscreteProblem<Scalar>::MATRIX_FORMS_TIME_DEPENDENT;
+      try
+      {
+        assemble_forms(mat, rhs, force_diagonal_blocks, block_weights);
+      }
+      catch(Hermes::Exceptions::Exception&)
+      {
+        this->matrix_forms_selection = DiscreteProblem<Scalar>::MATRIX_FORMS_ALL;
+        throw;
+      }
+      this->matrix_forms_selection = DiscreteProblem<Scalar>::MATRIX_FORMS_ALL;
+
+      mat->add_sparse_matrix(time_independent_matrix);
+      if(rhs != NULL)
+        rhs->add_vector(time_independent_lift);
+    }
+
+    template<typename Scalar>
+    void DiscreteProblemLinear<Scalar>::assemble_forms(SparseMatrix<Scalar>* mat,
+      Vector<Scalar>* rhs,
+      bool force_diagonal_blocks,
+      Table* block_weights)
     {
       // Check.
       this->check();
       if(this->ndof == 0)
         throw Exceptions::Exception("Zero DOFs detected in DiscreteProblemLinear::assemble().");
 
-      // Important, sets the current caughtException to NULL.
-      this->caughtException = NULL;
+      // Forget the exception of a previous (failed) assembling.
+      this->assembly_status.reset();
+
+      this->cache_stamp++;
 
       this->current_mat = mat;
       this->current_rhs = rhs;
@@ -111,12 +332,24 @@ namespace Hermes
           if(this->wf->get_forms()[form_i]->ext[ext_i] != NULL)
             meshes.push_back(this->wf->get_forms()[form_i]->ext[ext_i]->get_mesh());
 
-      Traverse trav_master(true);
-      unsigned int num_states = trav_master.get_num_states(meshes);
+      // All the states are generated at once beforehand, so that the threads do not need to
+      // share the traversal stack and synchronize on obtaining the next state.
+      // They are kept for the following assemblings on the same meshes.
+      bool states_changed = this->traverse_states.update(&(meshes.front()), meshes.size());
+      int num_states = this->traverse_states.get_num_states();
+      Traverse::State** states = this->traverse_states.get_states();
+      Hermes::vector<int> state_groups = this->group_states(states, num_states);
+      this->init_owned_states(states, num_states, states_changed);
+      bool overlapped_reduction = this->init_overlapped_reduction(states, num_states);
+      int first_phase = overlapped_reduction ? 1 : 0, last_phase = overlapped_reduction ? 2 : 0;
+      this->init_thread_local_assembling();
+      this->init_assembling_arenas();
+      this->init_reference_integrals();
+      this->init_form_values_buffers();
+      this->init_element_batches();
+      this->init_form_orders();
+      this->init_scatter_maps(num_states);
 
-      trav_master.begin(meshes.size(), &(meshes.front()));
-
-      Traverse* trav = new Traverse[Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads)];
       Hermes::vector<Transformable *>* fns = new Hermes::vector<Transformable *>[Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads)];
       for(unsigned int i = 0; i < Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads); i++)
       {
@@ -136,8 +369,6 @@ namespace Hermes
               weakforms[i]->get_forms()[form_i]->ext[ext_i]->set_quad_2d(&g_quad_2d_std);
             }
         }
-        trav[i].begin(meshes.size(), &(meshes.front()), &(fns[i].front()));
-        trav[i].stack = trav_master.stack;
       }
 
       int state_i;
@@ -147,81 +378,116 @@ namespace Hermes
       RefMap** current_refmaps;
       AsmList<Scalar>** current_als;
       WeakForm<Scalar>* current_weakform;
+      Transformable** current_fns;
 
 #define CHUNKSIZE 1
       int num_threads_used = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
-#pragma omp parallel shared(trav_master, mat, rhs ) private(state_i, current_pss, current_spss, current_refmaps, current_als, current_weakform) num_threads(num_threads_used)
+      size_t assembling_memory_limit = (size_t)Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::assemblingMemoryLimit) * 1024 * 1024;
+#pragma omp parallel shared(states, state_groups, mat, rhs ) private(state_i, current_pss, current_spss, current_refmaps, current_als, current_weakform, current_fns) num_threads(num_threads_used)
       {
-#pragma omp for schedule(static, CHUNKSIZE)
-        for(state_i = 0; state_i < num_states; state_i++)
+        for(int phase = first_phase; phase <= last_phase; phase++)
         {
-          if(this->caughtException != NULL)
-            continue;
-
-          try
+          for(unsigned int group_i = 0; group_i < state_groups.size() - 1; group_i++)
           {
-            Traverse::State current_state;
-
-#pragma omp critical (get_next_state)
+            // With Hermes2DApiParam::assemblingMemoryLimit the group is assembled in chunks of consecutive states, see finish_assembling_chunk().
+            int chunk_size = assembling_memory_limit > 0 ? H2D_ASSEMBLING_CHUNK_STATES : state_groups[group_i + 1] - state_groups[group_i];
+            for(int chunk_start = state_groups[group_i]; chunk_start < state_groups[group_i + 1]; chunk_start += chunk_size)
             {
-              try
+              int chunk_end = std::min(chunk_start + chunk_size, state_groups[group_i + 1]);
+#pragma omp for schedule(dynamic, CHUNKSIZE)
+              for(state_i = chunk_start; state_i < chunk_end; state_i++)
               {
-                current_state = trav[omp_get_thread_num()].get_next_state(&trav_master.top, &trav_master.id);
+                if(this->assembly_status.has_failed() || !this->is_assembled_state(states[state_i], phase))
+                  continue;
+                try
+                {
+                  Traverse::State* current_state = states[state_i];
+
+                  current_pss = pss[omp_get_thread_num()];
+                  current_spss = spss[omp_get_thread_num()];
+                  current_refmaps = refmaps[omp_get_thread_num()];
+                  current_als = als[omp_get_thread_num()];
+                  current_weakform = weakforms[omp_get_thread_num()];
+                  current_fns = &(fns[omp_get_thread_num()].front());
+
+                  // One state is a collection of (virtual) elements sharing
+                  // the same physical location on (possibly) different meshes.
+                  // This is then the same element of the virtual union mesh.
+                  // The proper sub-element mappings to all the functions of
+                  // this stage are set here from the precalculated state.
+                  for(int fns_i = 0; fns_i < current_state->num; fns_i++)
+                    if(current_state->e[fns_i] != NULL)
+                    {
+                      current_fns[fns_i]->set_active_element(current_state->e[fns_i]);
+                      current_fns[fns_i]->set_transform(current_state->sub_idx[fns_i]);
+                    }
+
+                  // Temporaries of the previous state are not needed any more.
+                  this->get_assembling_arena()->reset();
+
+                  this->assemble_one_state(current_pss, current_spss, current_refmaps, NULL, current_als, current_state, current_weakform);
+
+                  if(this->DG_matrix_forms_present || this->DG_vector_forms_present)
+                    this->assemble_one_DG_state(current_pss, current_spss, current_refmaps, current_als, current_state, current_weakform->mfDG, current_weakform->vfDG, current_fns, current_weakform);
+
+                  if(this->element_batch_kernel != NULL)
+                    this->flush_element_batches(false);
+                }
+                catch(Hermes::Exceptions::Exception& e)
+                {
+                  this->assembly_status.fail(e);
+                }
+                catch(std::exception& e)
+                {
+                  this->assembly_status.fail(e);
+                }
               }
-              catch(Hermes::Exceptions::Exception& e)
-              {
-                if(this->caughtException == NULL)
-                  this->caughtException = e.clone();
-              }
-              catch(std::exception& e)
+
+              if(chunk_end < state_groups[group_i + 1])
               {
-                if(this->caughtException == NULL)
-                  this->caughtException = new Hermes::Exceptions::Exception(e.what());
+                if(this->element_batch_kernel != NULL)
+                  this->flush_element_batches(true);
+#pragma omp barrier
+#pragma omp single
+                this->finish_assembling_chunk(assembling_memory_limit);
               }
             }
 
-            current_pss = pss[omp_get_thread_num()];
-            current_spss = spss[omp_get_thread_num()];
-            current_refmaps = refmaps[omp_get_thread_num()];
-            current_als = als[omp_get_thread_num()];
-            current_weakform = weakforms[omp_get_thread_num()];
-
-            // One state is a collection of (virtual) elements sharing
-            // the same physical location on (possibly) different meshes.
-            // This is then the same element of the virtual union mesh.
-            // The proper sub-element mappings to all the functions of
-            // this stage is supplied by the function Traverse::get_next_state()
-            // called in the while loop. 
-            this->assemble_one_state(current_pss, current_spss, current_refmaps, NULL, current_als, &current_state, current_weakform);
-
-            if(this->DG_matrix_forms_present || this->DG_vector_forms_present)
-              this->assemble_one_DG_state(current_pss, current_spss, current_refmaps, current_als, &current_state, current_weakform->mfDG, current_weakform->vfDG, trav[omp_get_thread_num()].fn, current_weakform);
-          }
-          catch(Hermes::Exceptions::Exception& e)
-          {
-            if(this->caughtException == NULL)
-              this->caughtException = e.clone();
+            // The remaining batches are inserted before the next group, whose states may share the DOFs with the ones of this group.
+            if(this->element_batch_kernel != NULL)
+            {
+              this->flush_element_batches(true);
+#pragma omp barrier
+            }
           }
-          catch(std::exception& e)
+
+          // The values between the shared DOFs are complete, they are summed while the other states are assembled.
+          if(phase == 1)
           {
-            if(this->caughtException == NULL)
-              this->caughtException = new Hermes::Exceptions::Exception(e.what());
+#pragma omp single
+            this->start_overlapped_reduction();
           }
         }
       }
 
+      this->finish_thread_local_assembling();
+
+      // The Dirichlet lift is added once, to the sums.
+      if(!this->assembly_status.has_failed())
+        this->sum_process_contributions();
+
+      if(this->current_rhs != NULL && dirichlet_lift_added)
+        this->current_rhs->add_vector(dirichlet_lift);
+
       this->deinit_assembling(pss, spss, refmaps, NULL, als, weakforms);
 
-      trav_master.finish();
-      for(unsigned int i = 0; i < Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads); i++)
-        trav[i].finish();
+      this->trim_cache();
 
       for(unsigned int i = 0; i < Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads); i++)
       {
         fns[i].clear();
       }
       delete [] fns;
-      delete [] trav;
 
       /// \todo Should this be really here? Or in assemble()?
       if(this->current_mat != NULL)
@@ -229,21 +495,13 @@ namespace Hermes
       if(this->current_rhs != NULL)
         this->current_rhs->finish();
 
-      if(this->DG_matrix_forms_present || this->DG_vector_forms_present)
-      {
-        Element* element_to_set_nonvisited;
-        for(unsigned int mesh_i = 0; mesh_i < meshes.size(); mesh_i++)
-          for_all_elements(element_to_set_nonvisited, meshes[mesh_i])
-          element_to_set_nonvisited->visited = false;
-      }
-
-      if(this->caughtException != NULL)
-        throw *(this->caughtException);
+      this->assembly_status.rethrow();
     }
 
     template<typename Scalar>
     void DiscreteProblemLinear<Scalar>::assemble_matrix_form(MatrixForm<Scalar>* form, int order, Func<double>** base_fns, Func<double>** test_fns, Func<Scalar>** ext, Func<Scalar>** u_ext,
-      AsmList<Scalar>* current_als_i, AsmList<Scalar>* current_als_j, Traverse::State* current_state, int n_quadrature_points, Geom<double>* geometry, double* jacobian_x_weights)
+      AsmList<Scalar>* current_als_i, AsmList<Scalar>* current_als_j, Traverse::State* current_state, int n_quadrature_points, Geom<double>* geometry, double* jacobian_x_weights,
+      RefMap* current_refmap)
     {
       bool surface_form = (dynamic_cast<MatrixFormVol<Scalar>*>(form) == NULL);
 
@@ -253,14 +511,14 @@ namespace Hermes
       bool sym = (form->i == form->j) && (form->sym == 1);
 
       // Assemble the local stiffness matrix for the form form.
-      Scalar **local_stiffness_matrix = new_matrix<Scalar>(std::max(current_als_i->cnt, current_als_j->cnt));
+      Scalar **local_stiffness_matrix = this->get_assembling_arena()->template allocate_matrix<Scalar>(std::max(current_als_i->cnt, current_als_j->cnt));
 
       Func<Scalar>** local_ext = ext;
       // If the user supplied custom ext functions for this form.
       if(form->ext.size() > 0)
       {
         int local_ext_count = form->ext.size();
-        local_ext = new Func<Scalar>*[local_ext_count];
+        local_ext = this->get_assembling_arena()->template allocate_array<Func<Scalar>*>(local_ext_count);
         for(int ext_i = 0; ext_i < local_ext_count; ext_i++)
           if(form->ext[ext_i] != NULL)
             local_ext[ext_i] = current_state->e[ext_i] == NULL ? NULL : init_fn(form->ext[ext_i], order);
@@ -268,6 +526,31 @@ namespace Hermes
             local_ext[ext_i] = NULL;
       }
 
+      // Values of the form for all pairs of functions at once, if the form provides a batched evaluation.
+      Scalar **form_values = NULL;
+      if(!surface_form)
+      {
+        // The values computed by the element batch kernel are being inserted (flush_element_batches()).
+        form_values = this->get_batched_form_values();
+      }
+      if(!surface_form && form_values == NULL)
+      {
+        form_values = this->get_form_values_buffer(current_als_i->cnt, current_als_j->cnt);
+        bool reference_values = this->calc_matrix_form_reference_values(static_cast<MatrixFormVol<Scalar>*>(form), current_refmap, current_als_i, current_als_j, current_state, form_values);
+
+        // The element waits for the batch to be complete, the form has no own external functions to clean up.
+        if(!reference_values && this->batch_matrix_form(static_cast<MatrixFormVol<Scalar>*>(form), order, current_refmap, current_als_i, current_als_j, current_state,
+          n_quadrature_points, geometry, jacobian_x_weights, u_ext, local_ext))
+          return;
+
+        if(!reference_values
+          && !this->calc_matrix_form_tensor_values(static_cast<MatrixFormVol<Scalar>*>(form), order, current_refmap, current_als_i, current_als_j, current_state,
+          n_quadrature_points, geometry, jacobian_x_weights, u_ext, local_ext, form_values)
+          && !static_cast<MatrixFormVol<Scalar>*>(form)->value_all(n_quadrature_points, jacobian_x_weights, u_ext, current_als_j->cnt, base_fns,
+          current_als_i->cnt, test_fns, geometry, local_ext, form_values))
+          form_values = NULL;
+      }
+
       // Actual form-specific calculation.
       for (unsigned int i = 0; i < current_als_i->cnt; i++)
       {
@@ -292,17 +575,17 @@ namespace Hermes
             if(current_als_j->dof[j] >= 0)
             {
               if(surface_form)
-                local_stiffness_matrix[i][j] = 0.5 * block_scaling_coefficient * form->value(n_quadrature_points, jacobian_x_weights, u_ext, u, v, geometry, local_ext) * form->scaling_factor * current_als_j->coef[j] * current_als_i->coef[i];
+                local_stiffness_matrix[i][j] = 0.5 * block_scaling_coefficient * (form_values != NULL ? form_values[i][j] : form->value(n_quadrature_points, jacobian_x_weights, u_ext, u, v, geometry, local_ext)) * form->scaling_factor * current_als_j->coef[j] * current_als_i->coef[i];
               else
-                local_stiffness_matrix[i][j] = block_scaling_coefficient * form->value(n_quadrature_points, jacobian_x_weights, u_ext, u, v, geometry, local_ext) * form->scaling_factor * current_als_j->coef[j] * current_als_i->coef[i];
+                local_stiffness_matrix[i][j] = block_scaling_coefficient * (form_values != NULL ? form_values[i][j] : form->value(n_quadrature_points, jacobian_x_weights, u_ext, u, v, geometry, local_ext)) * form->scaling_factor * current_als_j->coef[j] * current_als_i->coef[i];
             }
             else
             {
               {
                 if(surface_form)
-                  this->current_rhs->add(current_als_i->dof[i], -0.5 * block_scaling_coefficient * form->value(n_quadrature_points, jacobian_x_weights, u_ext, u, v, geometry, local_ext) * form->scaling_factor * current_als_j->coef[j] * current_als_i->coef[i]);
+                  this->add_to_rhs(current_als_i->dof[i], -0.5 * block_scaling_coefficient * (form_values != NULL ? form_values[i][j] : form->value(n_quadrature_points, jacobian_x_weights, u_ext, u, v, geometry, local_ext)) * form->scaling_factor * current_als_j->coef[j] * current_als_i->coef[i]);
                 else
-                  this->current_rhs->add(current_als_i->dof[i], -block_scaling_coefficient * form->value(n_quadrature_points, jacobian_x_weights, u_ext, u, v, geometry, local_ext) * form->scaling_factor * current_als_j->coef[j] * current_als_i->coef[i]);
+                  this->add_to_rhs(current_als_i->dof[i], -block_scaling_coefficient * (form_values != NULL ? form_values[i][j] : form->value(n_quadrature_points, jacobian_x_weights, u_ext, u, v, geometry, local_ext)) * form->scaling_factor * current_als_j->coef[j] * current_als_i->coef[i]);
               }
             }
           }
@@ -321,20 +604,21 @@ namespace Hermes
             Func<double>* u = base_fns[j];
             Func<double>* v = test_fns[i];
 
-            Scalar val = block_scaling_coefficient * form->value(n_quadrature_points, jacobian_x_weights, u_ext, u, v, geometry, local_ext) * form->scaling_factor * current_als_j->coef[j] * current_als_i->coef[i];
+            Scalar val = block_scaling_coefficient * (form_values != NULL ? form_values[i][j] : form->value(n_quadrature_points, jacobian_x_weights, u_ext, u, v, geometry, local_ext)) * form->scaling_factor * current_als_j->coef[j] * current_als_i->coef[i];
 
             if(current_als_j->dof[j] >= 0)
               local_stiffness_matrix[i][j] = local_stiffness_matrix[j][i] = val;
             else
             {
-              this->current_rhs->add(current_als_i->dof[i], -val);
+              this->add_to_rhs(current_als_i->dof[i], -val);
             }
           }
         }
       }
 
       // Insert the local stiffness matrix into the global one.
-      this->current_mat->add(current_als_i->cnt, current_als_j->cnt, local_stiffness_matrix, current_als_i->dof, current_als_j->dof);
+      this->add_to_matrix(current_als_i->cnt, current_als_j->cnt, local_stiffness_matrix, current_als_i->dof, current_als_j->dof,
+        surface_form ? NULL : this->get_scatter_map(current_state, form->i, form->j, current_als_i, current_als_j));
 
       // Insert also the off-diagonal (anti-)symmetric block, if required.
       if(tra)
@@ -343,14 +627,15 @@ namespace Hermes
           chsgn(local_stiffness_matrix, current_als_i->cnt, current_als_j->cnt);
         transpose(local_stiffness_matrix, current_als_i->cnt, current_als_j->cnt);
 
-        this->current_mat->add(current_als_j->cnt, current_als_i->cnt, local_stiffness_matrix, current_als_j->dof, current_als_i->dof);
+        this->add_to_matrix(current_als_j->cnt, current_als_i->cnt, local_stiffness_matrix, current_als_j->dof, current_als_i->dof,
+          surface_form ? NULL : this->get_scatter_map(current_state, form->j, form->i, current_als_j, current_als_i));
 
         // Linear problems only: Subtracting Dirichlet lift contribution from the RHS:
         for (unsigned int j = 0; j < current_als_i->cnt; j++)
           if(current_als_i->dof[j] < 0)
             for (unsigned int i = 0; i < current_als_j->cnt; i++)
               if(current_als_j->dof[i] >= 0)
-                this->current_rhs->add(current_als_j->dof[i], -local_stiffness_matrix[i][j]);
+                this->add_to_rhs(current_als_j->dof[i], -local_stiffness_matrix[i][j]);
       }
 
       if(form->ext.size() > 0)
@@ -361,11 +646,7 @@ namespace Hermes
             local_ext[ext_i]->free_fn();
             delete local_ext[ext_i];
           }
-          delete [] local_ext;
       }
-
-      // Cleanup.
-      delete [] local_stiffness_matrix;
     }
 
     template class HERMES_API DiscreteProblemLinear<double>;
@@ -0,0 +1,127 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+#include "element_batch_kernel.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    template<typename Scalar>
+    ElementBatchKernelCPU<Scalar>::ElementBatchKernelCPU()
+    {
+    }
+
+    template<typename Scalar>
+    ElementBatchKernelCPU<Scalar>::~ElementBatchKernelCPU()
+    {
+      clear_shape_tables();
+    }
+
+    template<typename Scalar>
+    void ElementBatchKernelCPU<Scalar>::clear_shape_tables()
+    {
+#pragma omp critical (element_batch_kernel_tables)
+      {
+        for(unsigned int i = 0; i < tables.size(); i++)
+        {
+          delete [] tables[i]->data;
+          delete tables[i];
+        }
+        tables.clear();
+      }
+    }
+
+    template<typename Scalar>
+    int ElementBatchKernelCPU<Scalar>::upload_shape_table(int num_fns, int num_points, const double* values, const double* dx, const double* dy)
+    {
+      ShapeTable* table = new ShapeTable;
+      table->num_fns = num_fns;
+      table->num_points = num_points;
+      int size = num_fns * num_points;
+      table->data = new double[3 * size];
+      memcpy(table->data, values, size * sizeof(double));
+      memcpy(table->data + size, dx, size * sizeof(double));
+      memcpy(table->data + 2 * size, dy, size * sizeof(double));
+
+      int id;
+#pragma omp critical (element_batch_kernel_tables)
+      {
+        id = tables.size();
+        tables.push_back(table);
+      }
+      return id;
+    }
+
+    template<typename Scalar>
+    void ElementBatchKernelCPU<Scalar>::compute(int test_table, int basis_table, int num_elements, const Scalar* weights, Scalar* local_matrices)
+    {
+      ShapeTable* test;
+      ShapeTable* basis;
+#pragma omp critical (element_batch_kernel_tables)
+      {
+        test = tables[test_table];
+        basis = tables[basis_table];
+      }
+
+      int np = test->num_points;
+      if(basis->num_points != np)
+        throw Exceptions::Exception("ElementBatchKernelCPU: the shape tables have different numbers of points.");
+      int num_test = test->num_fns, num_basis = basis->num_fns;
+      const double* v = test->data;
+      const double* v_dx = test->data + num_test * np;
+      const double* v_dy = test->data + 2 * num_test * np;
+      const double* u = basis->data;
+      const double* u_dx = basis->data + num_basis * np;
+      const double* u_dy = basis->data + 2 * num_basis * np;
+
+      Scalar* wv = new Scalar[3 * np];
+      for(int element_i = 0; element_i < num_elements; element_i++)
+      {
+        const Scalar* w_mass = weights + 4 * element_i * np;
+        const Scalar* w_xx = w_mass + np;
+        const Scalar* w_xy = w_mass + 2 * np;
+        const Scalar* w_yy = w_mass + 3 * np;
+        Scalar* local = local_matrices + element_i * num_test * num_basis;
+        for(int i = 0; i < num_test; i++)
+        {
+          // The test function with the weights, multiplying u, du/dxi and du/deta.
+          const double* v_i = v + i * np;
+          const double* v_dx_i = v_dx + i * np;
+          const double* v_dy_i = v_dy + i * np;
+          for(int k = 0; k < np; k++)
+          {
+            wv[k] = w_mass[k] * v_i[k];
+            wv[np + k] = w_xx[k] * v_dx_i[k] + w_xy[k] * v_dy_i[k];
+            wv[2 * np + k] = w_xy[k] * v_dx_i[k] + w_yy[k] * v_dy_i[k];
+          }
+          for(int j = 0; j < num_basis; j++)
+          {
+            const double* u_j = u + j * np;
+            const double* u_dx_j = u_dx + j * np;
+            const double* u_dy_j = u_dy + j * np;
+            Scalar sum = 0.0;
+            for(int k = 0; k < np; k++)
+              sum += wv[k] * u_j[k] + wv[np + k] * u_dx_j[k] + wv[2 * np + k] * u_dy_j[k];
+            local[i * num_basis + j] = sum;
+          }
+        }
+      }
+      delete [] wv;
+    }
+
+    template HERMES_API class ElementBatchKernelCPU<double>;
+    template HERMES_API class ElementBatchKernelCPU<std::complex<double> >;
+  }
+}
@@ -0,0 +1,369 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "flux_corrected_transport.h"
+#ifdef WITH_UMFPACK
+#include "api2d.h"
+#include "neighbor.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    FluxCorrectedTransport::FluxCorrectedTransport(double theta) : theta(theta), ndof(0), nnz(0), fct_dofs(NULL),
+      num_edges(0), edge_i(NULL), edge_j(NULL), edge_pos_ij(NULL), edge_pos_ji(NULL), diagonal_pos(NULL),
+      node_edge_start(NULL), node_edges(NULL), node_edge_signs(NULL), edge_fluxes(NULL), R_plus(NULL), R_minus(NULL)
+    {
+    }
+
+    FluxCorrectedTransport::~FluxCorrectedTransport()
+    {
+      free();
+    }
+
+    void FluxCorrectedTransport::free()
+    {
+      delete [] fct_dofs;
+      delete [] edge_i;
+      delete [] edge_j;
+      delete [] edge_pos_ij;
+      delete [] edge_pos_ji;
+      delete [] diagonal_pos;
+      delete [] node_edge_start;
+      delete [] node_edges;
+      delete [] node_edge_signs;
+      delete [] edge_fluxes;
+      delete [] R_plus;
+      delete [] R_minus;
+      fct_dofs = NULL;
+      edge_i = edge_j = edge_pos_ij = edge_pos_ji = diagonal_pos = node_edge_start = node_edges = NULL;
+      node_edge_signs = edge_fluxes = R_plus = R_minus = NULL;
+      ndof = nnz = num_edges = 0;
+    }
+
+    bool* FluxCorrectedTransport::get_fct_dofs() const
+    {
+      return fct_dofs;
+    }
+
+    void FluxCorrectedTransport::init(const Space<double>* space, CSCMatrix<double>* mass_matrix)
+    {
+      if(space == NULL)
+        throw Exceptions::NullException(1);
+      if(mass_matrix == NULL)
+        throw Exceptions::NullException(2);
+      if(mass_matrix->get_matrix_size() != space->get_num_dofs())
+        throw Exceptions::ValueException("mass_matrix size", mass_matrix->get_matrix_size(), space->get_num_dofs());
+
+      free();
+      ndof = space->get_num_dofs();
+      nnz = mass_matrix->get_nnz();
+
+      // The vertex dofs of the linear elements, whose neighbors are linear (and not hanging) as well.
+      fct_dofs = new bool[ndof];
+      memset(fct_dofs, 0, ndof * sizeof(bool));
+      AsmList<double> al;
+      Element* e;
+      for_all_active_elements(e, space->get_mesh())
+      {
+        int order = space->get_element_order(e->id);
+        if(order != 1 && order != H2D_MAKE_QUAD_ORDER(1, 1))
+          continue;
+
+        bool linear_neighborhood = true;
+        for (unsigned int iv = 0; iv < e->get_nvert() && linear_neighborhood; iv++)
+        {
+          if(e->vn[iv]->is_constrained_vertex())
+          {
+            linear_neighborhood = false;
+            break;
+          }
+          NeighborSearch<double> ns(e, space->get_mesh());
+          ns.set_ignore_errors(true);
+          ns.set_active_edge(iv);
+          for(unsigned int i = 0; i < ns.get_neighbors()->size(); i++)
+          {
+            int neighbor_order = space->get_element_order(ns.get_neighbors()->at(i)->id);
+            if(H2D_GET_H_ORDER(neighbor_order) > 1 || H2D_GET_V_ORDER(neighbor_order) > 1)
+            {
+              linear_neighborhood = false;
+              break;
+            }
+          }
+        }
+        if(!linear_neighborhood)
+          continue;
+
+        space->get_element_assembly_list(e, &al);
+        for (unsigned int iv = 0; iv < e->get_nvert(); iv++)
+        {
+          int index = space->get_shapeset()->get_vertex_index(iv, e->get_mode());
+          for(unsigned int j = 0; j < al.get_cnt(); j++)
+            if(al.get_idx()[j] == index && al.get_dof()[j] >= 0)
+              fct_dofs[al.get_dof()[j]] = true;
+        }
+      }
+
+      // The edges from the lower triangle, the entries (j, i) are searched for in their columns.
+      int* Ap = mass_matrix->get_Ap();
+      int* Ai = mass_matrix->get_Ai();
+      double* Ax = mass_matrix->get_Ax();
+
+      diagonal_pos = new int[ndof];
+      for(int j = 0; j < ndof; j++)
+      {
+        diagonal_pos[j] = -1;
+        for(int pos = Ap[j]; pos < Ap[j + 1]; pos++)
+          if(Ai[pos] == j)
+            diagonal_pos[j] = pos;
+        if(fct_dofs[j] && diagonal_pos[j] == -1)
+          throw Exceptions::Exception("FluxCorrectedTransport: the mass matrix has no diagonal entry in the row %i.", j);
+      }
+
+      for(int j = 0; j < ndof; j++)
+        if(fct_dofs[j])
+          for(int pos = Ap[j]; pos < Ap[j + 1]; pos++)
+            if(Ai[pos] > j && fct_dofs[Ai[pos]] && Ax[pos] != 0.)
+              num_edges++;
+
+      edge_i = new int[num_edges];
+      edge_j = new int[num_edges];
+      edge_pos_ij = new int[num_edges];
+      edge_pos_ji = new int[num_edges];
+      node_edge_start = new int[ndof + 1];
+      memset(node_edge_start, 0, (ndof + 1) * sizeof(int));
+
+      int edge = 0;
+      for(int j = 0; j < ndof; j++)
+      {
+        if(!fct_dofs[j])
+          continue;
+        for(int pos = Ap[j]; pos < Ap[j + 1]; pos++)
+        {
+          int i = Ai[pos];
+          if(i <= j || !fct_dofs[i] || Ax[pos] == 0.)
+            continue;
+          edge_i[edge] = i;
+          edge_j[edge] = j;
+          edge_pos_ij[edge] = pos;
+          edge_pos_ji[edge] = -1;
+          for(int pos_ji = Ap[i]; pos_ji < Ap[i + 1]; pos_ji++)
+            if(Ai[pos_ji] == j)
+            {
+              edge_pos_ji[edge] = pos_ji;
+              break;
+            }
+          if(edge_pos_ji[edge] == -1)
+            throw Exceptions::Exception("FluxCorrectedTransport: the sparse structure of the mass matrix is not symmetric.");
+          node_edge_start[i + 1]++;
+          node_edge_start[j + 1]++;
+          edge++;
+        }
+      }
+
+      // The incidence of the dofs and the edges.
+      for(int i = 0; i < ndof; i++)
+        node_edge_start[i + 1] += node_edge_start[i];
+      node_edges = new int[2 * num_edges];
+      node_edge_signs = new double[2 * num_edges];
+      int* node_edge_count = new int[ndof];
+      memset(node_edge_count, 0, ndof * sizeof(int));
+      for(edge = 0; edge < num_edges; edge++)
+      {
+        int position_i = node_edge_start[edge_i[edge]] + node_edge_count[edge_i[edge]]++;
+        node_edges[position_i] = edge;
+        node_edge_signs[position_i] = 1.;
+        int position_j = node_edge_start[edge_j[edge]] + node_edge_count[edge_j[edge]]++;
+        node_edges[position_j] = edge;
+        node_edge_signs[position_j] = -1.;
+      }
+      delete [] node_edge_count;
+
+      edge_fluxes = new double[num_edges];
+      R_plus = new double[ndof];
+      R_minus = new double[ndof];
+
+      this->info("\tFluxCorrectedTransport: %i edges of the FCT dofs.", num_edges);
+    }
+
+    void FluxCorrectedTransport::check_structure(CSCMatrix<double>* matrix) const
+    {
+      if(fct_dofs == NULL)
+        throw Exceptions::Exception("FluxCorrectedTransport: init() has to be called first.");
+      if(matrix == NULL)
+        throw Exceptions::NullException(1);
+      if(matrix->get_matrix_size() != ndof || matrix->get_nnz() != nnz)
+        throw Exceptions::Exception("FluxCorrectedTransport: the matrix does not have the sparse structure of the mass matrix of init().");
+    }
+
+    UMFPackMatrix<double>* FluxCorrectedTransport::artificial_diffusion(CSCMatrix<double>* conv_matrix)
+    {
+      check_structure(conv_matrix);
+      int num_threads = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
+
+      UMFPackMatrix<double>* diffusion = new UMFPackMatrix<double>;
+      diffusion->create(ndof, nnz, conv_matrix->get_Ap(), conv_matrix->get_Ai(), NULL);
+      double* Ax_conv = conv_matrix->get_Ax();
+      double* Ax = diffusion->get_Ax();
+
+      // The off-diagonal entries are private to the edges, the diagonal ones to the dofs.
+      int edge;
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+      for(edge = 0; edge < num_edges; edge++)
+      {
+        double d = std::max(std::max(-Ax_conv[edge_pos_ij[edge]], -Ax_conv[edge_pos_ji[edge]]), 0.);
+        Ax[edge_pos_ij[edge]] = d;
+        Ax[edge_pos_ji[edge]] = d;
+      }
+
+      int i;
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+      for(i = 0; i < ndof; i++)
+        for(int k = node_edge_start[i]; k < node_edge_start[i + 1]; k++)
+          Ax[diagonal_pos[i]] -= Ax[edge_pos_ij[node_edges[k]]];
+
+      return diffusion;
+    }
+
+    UMFPackMatrix<double>* FluxCorrectedTransport::mass_lumping(CSCMatrix<double>* mass_matrix)
+    {
+      check_structure(mass_matrix);
+      int num_threads = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
+
+      UMFPackMatrix<double>* lumped_matrix = new UMFPackMatrix<double>;
+      lumped_matrix->create(ndof, nnz, mass_matrix->get_Ap(), mass_matrix->get_Ai(), mass_matrix->get_Ax());
+      double* Ax_mass = mass_matrix->get_Ax();
+      double* Ax = lumped_matrix->get_Ax();
+
+      int edge;
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+      for(edge = 0; edge < num_edges; edge++)
+      {
+        Ax[edge_pos_ij[edge]] = 0.;
+        Ax[edge_pos_ji[edge]] = 0.;
+      }
+
+      int i;
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+      for(i = 0; i < ndof; i++)
+        for(int k = node_edge_start[i]; k < node_edge_start[i + 1]; k++)
+          Ax[diagonal_pos[i]] += Ax_mass[edge_pos_ij[node_edges[k]]];
+
+      return lumped_matrix;
+    }
+
+    void FluxCorrectedTransport::antidiffusive_fluxes(CSCMatrix<double>* mass_matrix, CSCMatrix<double>* lumped_matrix, CSCMatrix<double>* diffusion,
+      double* u_high, double* u_L, double* u_old, double time_step, double* flux_correction, int* smooth_dofs)
+    {
+      check_structure(mass_matrix);
+      check_structure(lumped_matrix);
+      check_structure(diffusion);
+      int num_threads = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
+
+      double* Ax_mass = mass_matrix->get_Ax();
+      double* Ax_diffusion = diffusion->get_Ax();
+
+      int edge;
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+      for(edge = 0; edge < num_edges; edge++)
+      {
+        int i = edge_i[edge], j = edge_j[edge];
+        double mass = Ax_mass[edge_pos_ij[edge]] / time_step;
+        double diff = Ax_diffusion[edge_pos_ij[edge]];
+        double f = (mass + diff * theta) * (u_high[i] - u_high[j]) - (mass - diff * (1. - theta)) * (u_old[i] - u_old[j]);
+        // Prelimiting, the fluxes down the gradient of the low order solution are cancelled.
+        edge_fluxes[edge] = (f * (u_L[j] - u_L[i]) > 0.) ? 0. : f;
+      }
+
+      limit(lumped_matrix, u_L, 1. / time_step, flux_correction, smooth_dofs);
+    }
+
+    void FluxCorrectedTransport::projection_fluxes(CSCMatrix<double>* mass_matrix, CSCMatrix<double>* lumped_matrix,
+      double* u_L, double* u_H, double* flux_correction, int* smooth_dofs)
+    {
+      check_structure(mass_matrix);
+      check_structure(lumped_matrix);
+      int num_threads = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
+
+      double* Ax_mass = mass_matrix->get_Ax();
+
+      int edge;
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+      for(edge = 0; edge < num_edges; edge++)
+      {
+        int i = edge_i[edge], j = edge_j[edge];
+        double f = Ax_mass[edge_pos_ij[edge]] * (u_H[i] - u_H[j]);
+        edge_fluxes[edge] = (f * (u_L[j] - u_L[i]) > 0.) ? 0. : f;
+      }
+
+      limit(lumped_matrix, u_L, 1., flux_correction, smooth_dofs);
+    }
+
+    void FluxCorrectedTransport::limit(CSCMatrix<double>* lumped_matrix, double* u_L, double bound_scaling, double* flux_correction, int* smooth_dofs)
+    {
+      int num_threads = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
+      double* Ax_lumped = lumped_matrix->get_Ax();
+
+      // The nodal correction factors from the sums of the incoming fluxes (P) and the admissible bounds (Q).
+      int i;
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+      for(i = 0; i < ndof; i++)
+      {
+        R_plus[i] = R_minus[i] = 1.;
+        if(!fct_dofs[i] || (smooth_dofs != NULL && smooth_dofs[i] == 1))
+          continue;
+
+        double P_plus = 0., P_minus = 0., Q_plus = 0., Q_minus = 0.;
+        double m_ii = Ax_lumped[diagonal_pos[i]] * bound_scaling;
+        for(int k = node_edge_start[i]; k < node_edge_start[i + 1]; k++)
+        {
+          int edge = node_edges[k];
+          double f = node_edge_signs[k] * edge_fluxes[edge];
+          P_plus += std::max(f, 0.);
+          P_minus += std::min(f, 0.);
+
+          double q = m_ii * (u_L[edge_i[edge] + edge_j[edge] - i] - u_L[i]);
+          Q_plus = std::max(Q_plus, q);
+          Q_minus = std::min(Q_minus, q);
+        }
+        if(P_plus != 0.)
+          R_plus[i] = std::min(1., Q_plus / P_plus);
+        if(P_minus != 0.)
+          R_minus[i] = std::min(1., Q_minus / P_minus);
+      }
+
+      // The limited fluxes, every one with the most restrictive factor of its two dofs.
+      int edge;
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+      for(edge = 0; edge < num_edges; edge++)
+      {
+        int i = edge_i[edge], j = edge_j[edge];
+        double f = edge_fluxes[edge];
+        double alpha = (f > 0.) ? std::min(R_plus[i], R_minus[j]) : std::min(R_minus[i], R_plus[j]);
+        edge_fluxes[edge] = alpha * f;
+      }
+
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+      for(i = 0; i < ndof; i++)
+      {
+        double correction = 0.;
+        for(int k = node_edge_start[i]; k < node_edge_start[i + 1]; k++)
+          correction += node_edge_signs[k] * edge_fluxes[node_edges[k]];
+        flux_correction[i] = correction;
+      }
+    }
+  }
+}
+#endif
@@ -24,7 +24,7 @@ namespace Hermes
   namespace Hermes2D
   {
     template<typename T>
-    Func<T>::Func(int num_gip, int num_comps) : num_gip(num_gip), nc(num_comps)
+    Func<T>::Func(int num_gip, int num_comps) : num_gip(num_gip), nc(num_comps), in_values_pool(false), values_pool(NULL)
     {
       val = NULL;
       dx = NULL;
@@ -151,6 +151,14 @@ namespace Hermes
     template<typename T>
     void Func<T>::free_fn()
     {
+      if(in_values_pool)
+      {
+        delete [] values_pool;
+        values_pool = NULL;
+        val = dx = dy = laplace = NULL;
+        return;
+      }
+
       delete [] val; val = NULL;
       delete [] dx; dx = NULL;
       delete [] dy; dy = NULL;
@@ -386,6 +394,29 @@ namespace Hermes
       return e;
     }
 
+    /// Physical coordinates of the integration points, directly from the affine reference map if it is constant
+    /// (not stored in the tables of the reference map).
+    static void init_geom_points(RefMap *rm, const int order, int np, double* x, double* y)
+    {
+      if(rm->is_jacobian_const())
+      {
+        double2x2 m;
+        double2 t;
+        rm->get_const_ref_map(m, t);
+        double3* pt = rm->get_quad_2d()->get_points(order, rm->get_active_element()->get_mode());
+        for (int i = 0; i < np; i++)
+        {
+          x[i] = m[0][0] * pt[i][0] + m[0][1] * pt[i][1] + t[0];
+          y[i] = m[1][0] * pt[i][0] + m[1][1] * pt[i][1] + t[1];
+        }
+      }
+      else
+      {
+        memcpy(x, rm->get_phys_x(order), np * sizeof(double));
+        memcpy(y, rm->get_phys_y(order), np * sizeof(double));
+      }
+    }
+
     Geom<double>* init_geom_vol(RefMap *rm, const int order)
     {
       Geom<double>* e = new Geom<double>;
@@ -397,13 +428,7 @@ namespace Hermes
       int np = quad->get_num_points(order, rm->get_active_element()->get_mode());
       e->x = new double[np];
       e->y = new double[np];
-      double* x = rm->get_phys_x(order);
-      double* y = rm->get_phys_y(order);
-      for (int i = 0; i < np; i++)
-      {
-        e->x[i] = x[i];
-        e->y[i] = y[i];
-      }
+      init_geom_points(rm, order, np, e->x, e->y);
       return e;
     }
 
@@ -418,8 +443,6 @@ namespace Hermes
       e->isurf = isurf;
       
       tan = rm->get_tangent(isurf, order);
-      double* x = rm->get_phys_x(order);
-      double* y = rm->get_phys_y(order);
       
       Quad2D* quad = rm->get_quad_2d();
       int np = quad->get_num_points(order, rm->get_active_element()->get_mode());
@@ -429,10 +452,9 @@ namespace Hermes
       e->ty = new double[np];
       e->nx = new double[np];
       e->ny = new double[np];
+      init_geom_points(rm, order, np, e->x, e->y);
       for (int i = 0; i < np; i++)
       {
-        e->x[i] = x[i];
-        e->y[i] = y[i];
         e->tx[i] = tan[i][0];  e->ty[i] =   tan[i][1];
         e->nx[i] = tan[i][1];  e->ny[i] = - tan[i][0];
       }
@@ -645,6 +667,114 @@ namespace Hermes
       return u;
     }
 
+    Func<double>** init_fns(PrecalcShapeset *fu, RefMap *rm, const int order, unsigned int count, int* idx)
+    {
+      Func<double>** fns = new Func<double>*[count];
+      SpaceType space_type = fu->get_space_type();
+
+      if(count == 0)
+        return fns;
+
+      // Vector-valued spaces: one function after another.
+      if(space_type != HERMES_H1_SPACE && space_type != HERMES_L2_SPACE)
+      {
+        for (unsigned int j = 0; j < count; j++)
+        {
+          fu->set_active_shape(idx[j]);
+          fns[j] = init_fn(fu, rm, order);
+        }
+        return fns;
+      }
+
+      Quad2D* quad = fu->get_quad_2d();
+      int np = quad->get_num_points(order, rm->get_active_element()->get_mode());
+      int np_padded = ((np + H2D_SIMD_DOUBLES - 1) / H2D_SIMD_DOUBLES) * H2D_SIMD_DOUBLES;
+#ifdef H2D_USE_SECOND_DERIVATIVES
+      const int num_arrays = 4;
+#else
+      const int num_arrays = 3;
+#endif
+
+      // One block for all functions, aligned to the SIMD width, the padding is zero.
+      double* pool = new double[count * num_arrays * np_padded + H2D_SIMD_DOUBLES];
+      double* aligned = pool;
+      while(((size_t)aligned) % (H2D_SIMD_DOUBLES * sizeof(double)) != 0 && aligned < pool + H2D_SIMD_DOUBLES)
+        aligned++;
+      memset(aligned, 0, count * num_arrays * np_padded * sizeof(double));
+
+      // The inverse reference mapping is the same for all functions.
+      double2x2 *m;
+      if(rm->is_jacobian_const())
+      {
+        m = new double2x2[np];
+        for(int i = 0; i < np; i++)
+        {
+          m[i][0][0] = rm->get_const_inv_ref_map()[0][0][0];
+          m[i][0][1] = rm->get_const_inv_ref_map()[0][0][1];
+          m[i][1][0] = rm->get_const_inv_ref_map()[0][1][0];
+          m[i][1][1] = rm->get_const_inv_ref_map()[0][1][1];
+        }
+      }
+      else
+        m = rm->get_inv_ref_map(order);
+
+#ifdef H2D_USE_SECOND_DERIVATIVES
+      double3x2 *mm = rm->get_second_ref_map(order);
+#endif
+
+      for (unsigned int j = 0; j < count; j++)
+      {
+        fu->set_active_shape(idx[j]);
+#ifdef H2D_USE_SECOND_DERIVATIVES
+        fu->set_quad_order(order, H2D_FN_ALL);
+#else
+        fu->set_quad_order(order);
+#endif
+
+        Func<double>* u = new Func<double>(np, 1);
+        u->in_values_pool = true;
+        if(j == 0)
+          u->values_pool = pool;
+        u->val = aligned + j * num_arrays * np_padded;
+        u->dx = u->val + np_padded;
+        u->dy = u->dx + np_padded;
+
+        double *fn = fu->get_fn_values();
+        double *dx = fu->get_dx_values();
+        double *dy = fu->get_dy_values();
+
+        for (int i = 0; i < np; i++)
+        {
+          u->val[i] = fn[i];
+          u->dx[i] = (dx[i] * m[i][0][0] + dy[i] * m[i][0][1]);
+          u->dy[i] = (dx[i] * m[i][1][0] + dy[i] * m[i][1][1]);
+        }
+
+#ifdef H2D_USE_SECOND_DERIVATIVES
+        u->laplace = u->dy + np_padded;
+        double *dxx = fu->get_dxx_values();
+        double *dxy = fu->get_dxy_values();
+        double *dyy = fu->get_dyy_values();
+        for (int i = 0; i < np; i++)
+        {
+          double axx = (Hermes::sqr(m[i][0][0]) + Hermes::sqr(m[i][1][0]));
+          double ayy = (Hermes::sqr(m[i][0][1]) + Hermes::sqr(m[i][1][1]));
+          double axy = 2.0 * (m[i][0][0] * m[i][0][1] + m[i][1][0] * m[i][1][1]);
+          double ax = mm[i][0][0] + mm[i][2][0];
+          double ay = mm[i][0][1] + mm[i][2][1];
+          u->laplace[i] = ( dx[i] * ax + dy[i] * ay + dxx[i] * axx + dxy[i] * axy + dyy[i] * ayy );
+        }
+#endif
+
+        fns[j] = u;
+      }
+
+      if(rm->is_jacobian_const())
+        delete [] m;
+
+      return fns;
+    }
+
     template<typename Scalar>
     Func<Scalar>* init_fn(MeshFunction<Scalar>*fu, const int order)
     {
@@ -47,6 +47,16 @@ namespace Hermes
       return 1;
     }
 
+    template<typename Scalar>
+    void ExactSolutionScalar<Scalar>::exact_values(int n, const double* x, const double* y, Scalar* values, Scalar* dx, Scalar* dy) const
+    {
+      for (int i = 0; i < n; i++)
+      {
+        dx[i] = dy[i] = 0.0;
+        values[i] = exact_function(x[i], y[i], dx[i], dy[i]);
+      }
+    }
+
     template<typename Scalar>
     ExactSolutionVector<Scalar>::ExactSolutionVector(const Mesh* mesh) : ExactSolution<Scalar>(mesh)
     {
@@ -59,6 +69,22 @@ namespace Hermes
       return 2;
     }
 
+    template<typename Scalar>
+    void ExactSolutionVector<Scalar>::exact_values(int n, const double* x, const double* y, Scalar** values, Scalar** dx, Scalar** dy) const
+    {
+      for (int i = 0; i < n; i++)
+      {
+        Scalar2<Scalar> point_dx(0.0, 0.0), point_dy(0.0, 0.0);
+        Scalar2<Scalar> point_value = exact_function(x[i], y[i], point_dx, point_dy);
+        for (int j = 0; j < 2; j++)
+        {
+          values[j][i] = point_value[j];
+          dx[j][i] = point_dx[j];
+          dy[j][i] = point_dy[j];
+        }
+      }
+    }
+
     template<>
     void ConstantSolution<double>::save(const char* filename) const
     {
@@ -81,7 +107,8 @@ namespace Hermes
         namespace_info_map.insert(std::pair<std::basic_string<char>, xml_schema::namespace_info>("solution", namespace_info_solution));
 
         std::ofstream out(filename);
-        ::xml_schema::flags parsing_flags = ::xml_schema::flags::dont_pretty_print;
+        Hermes2DApi.initialize_xml();
+        ::xml_schema::flags parsing_flags = ::xml_schema::flags::dont_pretty_print | ::xml_schema::flags::dont_initialize;
         XMLSolution::solution_(out, xmlsolution, namespace_info_map, "UTF-8", parsing_flags);
         
         out.close();
@@ -115,7 +142,8 @@ namespace Hermes
         namespace_info_map.insert(std::pair<std::basic_string<char>, xml_schema::namespace_info>("solution", namespace_info_solution));
 
         std::ofstream out(filename);
-        ::xml_schema::flags parsing_flags = ::xml_schema::flags::dont_pretty_print;
+        Hermes2DApi.initialize_xml();
+        ::xml_schema::flags parsing_flags = ::xml_schema::flags::dont_pretty_print | ::xml_schema::flags::dont_initialize;
         XMLSolution::solution_(out, xmlsolution, namespace_info_map, "UTF-8", parsing_flags);
         out.close();
       }
@@ -148,6 +176,16 @@ namespace Hermes
       dy = 0;
     };
 
+    template<typename Scalar>
+    void ConstantSolution<Scalar>::exact_values(int n, const double* x, const double* y, Scalar* values, Scalar* dx, Scalar* dy) const
+    {
+      for (int i = 0; i < n; i++)
+      {
+        values[i] = constant;
+        dx[i] = dy[i] = Scalar(0.0);
+      }
+    }
+
     template<typename Scalar>
     Ord ConstantSolution<Scalar>::ord(Ord x, Ord y) const {
       return Ord(0);
@@ -175,7 +213,8 @@ namespace Hermes
         namespace_info_map.insert(std::pair<std::basic_string<char>, xml_schema::namespace_info>("solution", namespace_info_solution));
 
         std::ofstream out(filename);
-        ::xml_schema::flags parsing_flags = ::xml_schema::flags::dont_pretty_print;
+        Hermes2DApi.initialize_xml();
+        ::xml_schema::flags parsing_flags = ::xml_schema::flags::dont_pretty_print | ::xml_schema::flags::dont_initialize;
         XMLSolution::solution_(out, xmlsolution, namespace_info_map, "UTF-8", parsing_flags);
         out.close();
       }
@@ -208,7 +247,8 @@ namespace Hermes
         namespace_info_map.insert(std::pair<std::basic_string<char>, xml_schema::namespace_info>("solution", namespace_info_solution));
 
         std::ofstream out(filename);
-        ::xml_schema::flags parsing_flags = ::xml_schema::flags::dont_pretty_print;
+        Hermes2DApi.initialize_xml();
+        ::xml_schema::flags parsing_flags = ::xml_schema::flags::dont_pretty_print | ::xml_schema::flags::dont_initialize;
         XMLSolution::solution_(out, xmlsolution, namespace_info_map, "UTF-8", parsing_flags);
         out.close();
       }
@@ -241,6 +281,16 @@ namespace Hermes
       dy = 0;
     };
 
+    template<typename Scalar>
+    void ZeroSolution<Scalar>::exact_values(int n, const double* x, const double* y, Scalar* values, Scalar* dx, Scalar* dy) const
+    {
+      for (int i = 0; i < n; i++)
+      {
+        values[i] = Scalar(0.0);
+        dx[i] = dy[i] = Scalar(0.0);
+      }
+    }
+
     template<typename Scalar>
     Ord ZeroSolution<Scalar>::ord(Ord x, Ord y) const {
       return Ord(0);
@@ -270,7 +320,8 @@ namespace Hermes
         namespace_info_map.insert(std::pair<std::basic_string<char>, xml_schema::namespace_info>("solution", namespace_info_solution));
 
         std::ofstream out(filename);
-        ::xml_schema::flags parsing_flags = ::xml_schema::flags::dont_pretty_print;
+        Hermes2DApi.initialize_xml();
+        ::xml_schema::flags parsing_flags = ::xml_schema::flags::dont_pretty_print | ::xml_schema::flags::dont_initialize;
         XMLSolution::solution_(out, xmlsolution, namespace_info_map, "UTF-8", parsing_flags);
         out.close();
       }
@@ -306,7 +357,8 @@ namespace Hermes
 
         std::ofstream out(filename);
 
-        ::xml_schema::flags parsing_flags = ::xml_schema::flags::dont_pretty_print;
+        Hermes2DApi.initialize_xml();
+        ::xml_schema::flags parsing_flags = ::xml_schema::flags::dont_pretty_print | ::xml_schema::flags::dont_initialize;
 
         XMLSolution::solution_(out, xmlsolution, namespace_info_map, "UTF-8", parsing_flags);
         
@@ -341,6 +393,17 @@ namespace Hermes
       dy = Scalar2<Scalar>(Scalar(0.0), Scalar(0.0));
     };
 
+    template<typename Scalar>
+    void ConstantSolutionVector<Scalar>::exact_values(int n, const double* x, const double* y, Scalar** values, Scalar** dx, Scalar** dy) const
+    {
+      for (int i = 0; i < n; i++)
+      {
+        values[0][i] = constantX;
+        values[1][i] = constantY;
+        dx[0][i] = dx[1][i] = dy[0][i] = dy[1][i] = Scalar(0.0);
+      }
+    }
+
     template<typename Scalar>
     Ord ConstantSolutionVector<Scalar>::ord(Ord x, Ord y) const {
       return Ord(0);
@@ -370,7 +433,8 @@ namespace Hermes
 
         std::ofstream out(filename);
         
-        ::xml_schema::flags parsing_flags = ::xml_schema::flags::dont_pretty_print;
+        Hermes2DApi.initialize_xml();
+        ::xml_schema::flags parsing_flags = ::xml_schema::flags::dont_pretty_print | ::xml_schema::flags::dont_initialize;
         XMLSolution::solution_(out, xmlsolution, namespace_info_map, "UTF-8", parsing_flags);
         
         out.close();
@@ -406,7 +470,8 @@ namespace Hermes
         namespace_info_map.insert(std::pair<std::basic_string<char>, xml_schema::namespace_info>("solution", namespace_info_solution));
 
         std::ofstream out(filename);
-        ::xml_schema::flags parsing_flags = ::xml_schema::flags::dont_pretty_print;
+        Hermes2DApi.initialize_xml();
+        ::xml_schema::flags parsing_flags = ::xml_schema::flags::dont_pretty_print | ::xml_schema::flags::dont_initialize;
         XMLSolution::solution_(out, xmlsolution, namespace_info_map, "UTF-8", parsing_flags);
         
         out.close();
@@ -431,6 +496,14 @@ namespace Hermes
       dy = Scalar2<Scalar>(0.0, 0.0);
     };
 
+    template<typename Scalar>
+    void ZeroSolutionVector<Scalar>::exact_values(int n, const double* x, const double* y, Scalar** values, Scalar** dx, Scalar** dy) const
+    {
+      for (int j = 0; j < 2; j++)
+        for (int i = 0; i < n; i++)
+          values[j][i] = dx[j][i] = dy[j][i] = Scalar(0.0);
+    }
+
     template<typename Scalar>
     Ord ZeroSolutionVector<Scalar>::ord(Ord x, Ord y) const {
       return Ord(0);
@@ -23,9 +23,12 @@ namespace Hermes
 {
   namespace Hermes2D
   {
+    static int filter_memory_category = Hermes::MemoryAccounting::add_category("filter tables");
+
     template<typename Scalar>
     Filter<Scalar>::Filter()
     {
+      this->memory_category = filter_memory_category;
     }
 
     template<typename Scalar>
@@ -81,6 +84,8 @@ namespace Hermes
     template<typename Scalar>
     void Filter<Scalar>::init()
     {
+      this->memory_category = filter_memory_category;
+
       // construct the union mesh, if necessary
       const Mesh* meshes[H2D_MAX_COMPONENTS];
       for(int i = 0; i < this->num; i++)
@@ -161,11 +166,11 @@ namespace Hermes
         }
       }
 
-      for(typename std::map<uint64_t, LightArray<struct Filter<Scalar>::Node*>*>::iterator it = tables[this->cur_quad].begin(); it != tables[this->cur_quad].end(); it++)
+      for(typename std::map<uint64_t, NodeTable<struct Filter<Scalar>::Node*>*>::iterator it = tables[this->cur_quad].begin(); it != tables[this->cur_quad].end(); it++)
       {
         for(unsigned int l = 0; l < it->second->get_size(); l++)
           if(it->second->present(l))
-            ::free(it->second->get(l));
+            this->delete_node(it->second->get(l));
         delete it->second;
       }
       tables[this->cur_quad].clear();
@@ -181,15 +186,16 @@ namespace Hermes
     {
       for (int i = 0; i < H2D_MAX_QUADRATURES; i++)
       {
-        for(typename std::map<uint64_t, LightArray<struct Filter<Scalar>::Node*>*>::iterator it = tables[i].begin(); it != tables[i].end(); it++)
+        for(typename std::map<uint64_t, NodeTable<struct Filter<Scalar>::Node*>*>::iterator it = tables[i].begin(); it != tables[i].end(); it++)
         {
           for(unsigned int l = 0; l < it->second->get_size(); l++)
             if(it->second->present(l))
-              ::free(it->second->get(l));
+              this->delete_node(it->second->get(l));
           delete it->second;
         }
         tables[i].clear();
       }
+      this->free_node_pool();
 
       if(unimesh)
       {
@@ -240,6 +246,12 @@ namespace Hermes
       }
     }
 
+    template<typename Scalar>
+    void Filter<Scalar>::set_transform(uint64_t idx)
+    {
+      Transformable::replay_transform(idx);
+    }
+
     template<typename Scalar>
     SimpleFilter<Scalar>::SimpleFilter() : Filter<Scalar>()
     {
@@ -348,7 +360,7 @@ namespace Hermes
       if(this->nodes->present(order))
       {
         assert(this->nodes->get(order) == this->cur_node);
-        ::free(this->nodes->get(order));
+        this->delete_node(this->nodes->get(order));
       }
       this->nodes->add(node, order);
       this->cur_node = node;
@@ -438,18 +450,19 @@ namespace Hermes
       for (int i = 0; i < H2D_MAX_QUADRATURES; i++)
       {
 #ifdef _MSC_VER // For Visual Studio compiler the latter does not compile.
-        for(std::map<uint64_t, LightArray<Node*>*>::iterator it = tables[i].begin(); it != tables[i].end(); it++)
+        for(std::map<uint64_t, NodeTable<Node*>*>::iterator it = tables[i].begin(); it != tables[i].end(); it++)
 #else
-        for(std::map<uint64_t, LightArray<struct Function<double>::Node*>*>::iterator it = tables[i].begin(); it != tables[i].end(); it++)
+        for(std::map<uint64_t, NodeTable<struct Function<double>::Node*>*>::iterator it = tables[i].begin(); it != tables[i].end(); it++)
 #endif
         {
           for(unsigned int l = 0; l < it->second->get_size(); l++)
             if(it->second->present(l))
-              ::free(it->second->get(l));
+              this->delete_node(it->second->get(l));
           delete it->second;
         }
         tables[i].clear();
       }
+      this->free_node_pool();
 
       if(this->deleteSolutions)
         delete this->sln_complex;
@@ -469,11 +482,11 @@ namespace Hermes
 
       memset(sln_sub, 0, sizeof(sln_sub));
 
-      for(std::map<uint64_t, LightArray<struct Function<double>::Node*>*>::iterator it = tables[this->cur_quad].begin(); it != tables[this->cur_quad].end(); it++)
+      for(std::map<uint64_t, NodeTable<struct Function<double>::Node*>*>::iterator it = tables[this->cur_quad].begin(); it != tables[this->cur_quad].end(); it++)
       {
         for(unsigned int l = 0; l < it->second->get_size(); l++)
           if(it->second->present(l))
-            ::free(it->second->get(l));
+            this->delete_node(it->second->get(l));
         delete it->second;
       }
       tables[this->cur_quad].clear();
@@ -497,6 +510,11 @@ namespace Hermes
       this->sln_complex->pop_transform();
     }
 
+    void ComplexFilter::set_transform(uint64_t idx)
+    {
+      Transformable::replay_transform(idx);
+    }
+
     void ComplexFilter::precalculate(int order, int mask)
     {
       if(mask & (H2D_FN_DX | H2D_FN_DY | H2D_FN_DXX | H2D_FN_DYY | H2D_FN_DXY))
@@ -516,7 +534,7 @@ namespace Hermes
       if(this->nodes->present(order))
       {
         assert(this->nodes->get(order) == this->cur_node);
-        ::free(this->nodes->get(order));
+        this->delete_node(this->nodes->get(order));
       }
 
       this->cur_node = node;
@@ -624,7 +642,7 @@ namespace Hermes
       if(this->nodes->present(order))
       {
         assert(this->nodes->get(order) == this->cur_node);
-        ::free(this->nodes->get(order));
+        this->delete_node(this->nodes->get(order));
       }
       this->nodes->add(node, order);
       this->cur_node = node;
@@ -1089,7 +1107,7 @@ namespace Hermes
       if(this->nodes->present(order))
       {
         assert(this->nodes->get(order) == cur_node);
-        ::free(this->nodes->get(order));
+        this->delete_node(this->nodes->get(order));
       }
       this->nodes->add(node, order);
       cur_node = node;
@@ -1176,7 +1194,7 @@ namespace Hermes
       if(this->nodes->present(order))
       {
         assert(this->nodes->get(order) == this->cur_node);
-        ::free(this->nodes->get(order));
+        this->delete_node(this->nodes->get(order));
       }
       this->nodes->add(node, order);
       this->cur_node = node;
@@ -1230,6 +1248,334 @@ namespace Hermes
       }
     }
 
+    template<typename Scalar>
+    FilterExpression<Scalar>::~FilterExpression()
+    {
+    }
+
+    template<typename Scalar>
+    ExpressionInput<Scalar>::ExpressionInput(int index) : index(index)
+    {
+      if(index < 0 || index >= H2D_MAX_COMPONENTS)
+        throw Hermes::Exceptions::ValueException("index", index, 0, H2D_MAX_COMPONENTS - 1);
+    }
+
+    template<typename Scalar>
+    void ExpressionInput<Scalar>::evaluate(const Scalar* values, const Scalar* dx, const Scalar* dy, Scalar& result, Scalar& result_dx, Scalar& result_dy) const
+    {
+      result = values[index];
+      result_dx = dx[index];
+      result_dy = dy[index];
+    }
+
+    template<typename Scalar>
+    FilterExpression<Scalar>* ExpressionInput<Scalar>::clone() const
+    {
+      return new ExpressionInput<Scalar>(index);
+    }
+
+    template<typename Scalar>
+    int ExpressionInput<Scalar>::get_max_input() const
+    {
+      return index;
+    }
+
+    template<typename Scalar>
+    ExpressionConstant<Scalar>::ExpressionConstant(Scalar value) : value(value)
+    {
+    }
+
+    template<typename Scalar>
+    void ExpressionConstant<Scalar>::evaluate(const Scalar* values, const Scalar* dx, const Scalar* dy, Scalar& result, Scalar& result_dx, Scalar& result_dy) const
+    {
+      result = value;
+      result_dx = 0.0;
+      result_dy = 0.0;
+    }
+
+    template<typename Scalar>
+    FilterExpression<Scalar>* ExpressionConstant<Scalar>::clone() const
+    {
+      return new ExpressionConstant<Scalar>(value);
+    }
+
+    template<typename Scalar>
+    int ExpressionConstant<Scalar>::get_max_input() const
+    {
+      return -1;
+    }
+
+    template<typename Scalar>
+    ExpressionBinary<Scalar>::ExpressionBinary(Operation operation, FilterExpression<Scalar>* left, FilterExpression<Scalar>* right) : operation(operation), left(left), right(right)
+    {
+      if(left == NULL || right == NULL)
+        throw Hermes::Exceptions::NullException(left == NULL ? 1 : 2);
+    }
+
+    template<typename Scalar>
+    ExpressionBinary<Scalar>::~ExpressionBinary()
+    {
+      delete left;
+      delete right;
+    }
+
+    template<typename Scalar>
+    void ExpressionBinary<Scalar>::evaluate(const Scalar* values, const Scalar* dx, const Scalar* dy, Scalar& result, Scalar& result_dx, Scalar& result_dy) const
+    {
+      Scalar l, l_dx, l_dy, r, r_dx, r_dy;
+      left->evaluate(values, dx, dy, l, l_dx, l_dy);
+      right->evaluate(values, dx, dy, r, r_dx, r_dy);
+      switch(operation)
+      {
+      case EXPRESSION_SUM:
+        result = l + r;
+        result_dx = l_dx + r_dx;
+        result_dy = l_dy + r_dy;
+        break;
+      case EXPRESSION_DIFF:
+        result = l - r;
+        result_dx = l_dx - r_dx;
+        result_dy = l_dy - r_dy;
+        break;
+      case EXPRESSION_PRODUCT:
+        result = l * r;
+        result_dx = l_dx * r + l * r_dx;
+        result_dy = l_dy * r + l * r_dy;
+        break;
+      }
+    }
+
+    template<typename Scalar>
+    FilterExpression<Scalar>* ExpressionBinary<Scalar>::clone() const
+    {
+      return new ExpressionBinary<Scalar>(operation, left->clone(), right->clone());
+    }
+
+    template<typename Scalar>
+    int ExpressionBinary<Scalar>::get_max_input() const
+    {
+      return std::max(left->get_max_input(), right->get_max_input());
+    }
+
+    template<typename Scalar>
+    ExpressionSquare<Scalar>::ExpressionSquare(FilterExpression<Scalar>* operand) : operand(operand)
+    {
+      if(operand == NULL)
+        throw Hermes::Exceptions::NullException(1);
+    }
+
+    template<typename Scalar>
+    ExpressionSquare<Scalar>::~ExpressionSquare()
+    {
+      delete operand;
+    }
+
+    template<typename Scalar>
+    void ExpressionSquare<Scalar>::evaluate(const Scalar* values, const Scalar* dx, const Scalar* dy, Scalar& result, Scalar& result_dx, Scalar& result_dy) const
+    {
+      Scalar a, a_dx, a_dy;
+      operand->evaluate(values, dx, dy, a, a_dx, a_dy);
+      result = a * a;
+      result_dx = 2.0 * a * a_dx;
+      result_dy = 2.0 * a * a_dy;
+    }
+
+    template<typename Scalar>
+    FilterExpression<Scalar>* ExpressionSquare<Scalar>::clone() const
+    {
+      return new ExpressionSquare<Scalar>(operand->clone());
+    }
+
+    template<typename Scalar>
+    int ExpressionSquare<Scalar>::get_max_input() const
+    {
+      return operand->get_max_input();
+    }
+
+    template<typename Scalar>
+    ExpressionMagnitude<Scalar>::ExpressionMagnitude(Hermes::vector<FilterExpression<Scalar>*> operands) : operands(operands)
+    {
+      if(operands.empty())
+        throw Hermes::Exceptions::LengthException(1, 0, 1);
+      for(unsigned int i = 0; i < operands.size(); i++)
+        if(operands[i] == NULL)
+          throw Hermes::Exceptions::NullException(1, i);
+    }
+
+    template<typename Scalar>
+    ExpressionMagnitude<Scalar>::~ExpressionMagnitude()
+    {
+      for(unsigned int i = 0; i < operands.size(); i++)
+        delete operands[i];
+    }
+
+    template<typename Scalar>
+    void ExpressionMagnitude<Scalar>::evaluate(const Scalar* values, const Scalar* dx, const Scalar* dy, Scalar& result, Scalar& result_dx, Scalar& result_dy) const
+    {
+      Scalar sum = 0.0, sum_dx = 0.0, sum_dy = 0.0;
+      for(unsigned int i = 0; i < operands.size(); i++)
+      {
+        Scalar a, a_dx, a_dy;
+        operands[i]->evaluate(values, dx, dy, a, a_dx, a_dy);
+        sum += a * a;
+        sum_dx += a * a_dx;
+        sum_dy += a * a_dy;
+      }
+      result = sqrt(sum);
+      if(result == Scalar(0.0))
+      {
+        result_dx = 0.0;
+        result_dy = 0.0;
+      }
+      else
+      {
+        result_dx = sum_dx / result;
+        result_dy = sum_dy / result;
+      }
+    }
+
+    template<typename Scalar>
+    FilterExpression<Scalar>* ExpressionMagnitude<Scalar>::clone() const
+    {
+      Hermes::vector<FilterExpression<Scalar>*> operands_clone;
+      for(unsigned int i = 0; i < operands.size(); i++)
+        operands_clone.push_back(operands[i]->clone());
+      return new ExpressionMagnitude<Scalar>(operands_clone);
+    }
+
+    template<typename Scalar>
+    int ExpressionMagnitude<Scalar>::get_max_input() const
+    {
+      int max_input = -1;
+      for(unsigned int i = 0; i < operands.size(); i++)
+        max_input = std::max(max_input, operands[i]->get_max_input());
+      return max_input;
+    }
+
+    template<typename Scalar>
+    ExpressionFilter<Scalar>::ExpressionFilter(const Hermes::vector<MeshFunction<Scalar>*>& solutions, FilterExpression<Scalar>* expression) : Filter<Scalar>(solutions), expression(expression)
+    {
+      if(expression == NULL)
+        throw Hermes::Exceptions::NullException(2);
+      if(expression->get_max_input() >= this->num)
+        throw Hermes::Exceptions::Exception("ExpressionFilter: the expression uses the input %d, but only %d MeshFunctions were given.", expression->get_max_input(), this->num);
+      init_components();
+    }
+
+    template<typename Scalar>
+    ExpressionFilter<Scalar>::~ExpressionFilter()
+    {
+      delete expression;
+    }
+
+    template<typename Scalar>
+    void ExpressionFilter<Scalar>::init_components()
+    {
+      this->num_components = this->sln[0]->get_num_components();
+      for (int i = 1; i < this->num; i++)
+        if(this->sln[i]->get_num_components() != this->num_components)
+          throw Hermes::Exceptions::Exception("Filter: Solutions do not have the same number of components!");
+    }
+
+    template<typename Scalar>
+    void ExpressionFilter<Scalar>::precalculate(int order, int mask)
+    {
+      if(mask & (H2D_FN_DXX | H2D_FN_DYY | H2D_FN_DXY))
+        throw Hermes::Exceptions::Exception("ExpressionFilter not defined for second derivatives.");
+
+      // the derivatives of the inputs are only precalculated if the derivatives of the result are needed
+      bool derivatives = (mask & (H2D_FN_DX | H2D_FN_DY)) != 0;
+
+      Quad2D* quad = this->quads[this->cur_quad];
+      int np = quad->get_num_points(order, this->element->get_mode());
+      struct Function<Scalar>::Node* node = this->new_node(derivatives ? H2D_FN_DEFAULT : H2D_FN_VAL, np);
+
+      // precalculate all inputs
+      for (int i = 0; i < this->num; i++)
+        this->sln[i]->set_quad_order(order, derivatives ? H2D_FN_DEFAULT : H2D_FN_VAL);
+
+      Scalar val[H2D_MAX_COMPONENTS], dx[H2D_MAX_COMPONENTS], dy[H2D_MAX_COMPONENTS];
+      memset(dx, 0, sizeof(dx));
+      memset(dy, 0, sizeof(dy));
+
+      for (int j = 0; j < this->num_components; j++)
+      {
+        Scalar *val_tab[H2D_MAX_COMPONENTS], *dx_tab[H2D_MAX_COMPONENTS], *dy_tab[H2D_MAX_COMPONENTS];
+        for (int i = 0; i < this->num; i++)
+        {
+          val_tab[i] = this->sln[i]->get_fn_values(j);
+          if(derivatives)
+          {
+            dx_tab[i] = this->sln[i]->get_dx_values(j);
+            dy_tab[i] = this->sln[i]->get_dy_values(j);
+          }
+        }
+
+        Scalar* result = node->values[j][0];
+        for (int k = 0; k < np; k++)
+        {
+          for (int i = 0; i < this->num; i++)
+          {
+            val[i] = val_tab[i][k];
+            if(derivatives)
+            {
+              dx[i] = dx_tab[i][k];
+              dy[i] = dy_tab[i][k];
+            }
+          }
+
+          Scalar result_dx, result_dy;
+          expression->evaluate(val, dx, dy, result[k], result_dx, result_dy);
+          if(derivatives)
+          {
+            node->values[j][1][k] = result_dx;
+            node->values[j][2][k] = result_dy;
+          }
+        }
+      }
+
+      if(this->nodes->present(order))
+      {
+        assert(this->nodes->get(order) == this->cur_node);
+        this->delete_node(this->nodes->get(order));
+      }
+      this->nodes->add(node, order);
+      this->cur_node = node;
+    }
+
+    template<typename Scalar>
+    Func<Scalar>* ExpressionFilter<Scalar>::get_pt_value(double x, double y, Element* e)
+    {
+      Scalar val[H2D_MAX_COMPONENTS], dx[H2D_MAX_COMPONENTS], dy[H2D_MAX_COMPONENTS];
+      for (int i = 0; i < this->num; i++)
+      {
+        Func<Scalar>* value = this->sln[i]->get_pt_value(x, y, e);
+        val[i] = value->val[0];
+        dx[i] = value->dx != NULL ? value->dx[0] : 0.0;
+        dy[i] = value->dy != NULL ? value->dy[0] : 0.0;
+        value->free_fn();
+        delete value;
+      }
+
+      Func<Scalar>* toReturn = new Func<Scalar>(1, 1);
+      toReturn->val = new Scalar[1];
+      toReturn->dx = new Scalar[1];
+      toReturn->dy = new Scalar[1];
+      expression->evaluate(val, dx, dy, toReturn->val[0], toReturn->dx[0], toReturn->dy[0]);
+      return toReturn;
+    }
+
+    template<typename Scalar>
+    MeshFunction<Scalar>* ExpressionFilter<Scalar>::clone() const
+    {
+      Hermes::vector<MeshFunction<Scalar>*> slns;
+      for(int i = 0; i < this->num; i++)
+        slns.push_back(this->sln[i]->clone());
+      ExpressionFilter<Scalar>* filter = new ExpressionFilter<Scalar>(slns, expression->clone());
+      filter->setDeleteSolutions();
+      return filter;
+    }
+
     template class HERMES_API Filter<double>;
     template class HERMES_API Filter<std::complex<double> >;
     template class HERMES_API SimpleFilter<double>;
@@ -1246,5 +1592,19 @@ namespace Hermes
     template class HERMES_API SumFilter<std::complex<double> >;
     template class HERMES_API SquareFilter<double>;
     template class HERMES_API SquareFilter<std::complex<double> >;
+    template class HERMES_API FilterExpression<double>;
+    template class HERMES_API FilterExpression<std::complex<double> >;
+    template class HERMES_API ExpressionInput<double>;
+    template class HERMES_API ExpressionInput<std::complex<double> >;
+    template class HERMES_API ExpressionConstant<double>;
+    template class HERMES_API ExpressionConstant<std::complex<double> >;
+    template class HERMES_API ExpressionBinary<double>;
+    template class HERMES_API ExpressionBinary<std::complex<double> >;
+    template class HERMES_API ExpressionSquare<double>;
+    template class HERMES_API ExpressionSquare<std::complex<double> >;
+    template class HERMES_API ExpressionMagnitude<double>;
+    template class HERMES_API ExpressionMagnitude<std::complex<double> >;
+    template class HERMES_API ExpressionFilter<double>;
+    template class HERMES_API ExpressionFilter<std::complex<double> >;
   }
 }
@@ -18,6 +18,8 @@ namespace Hermes
 {
   namespace Hermes2D
   {
+    static int function_memory_category = Hermes::MemoryAccounting::add_category("function tables");
+
     // Debug helpers.
     template<typename Scalar>
     void Function<Scalar>::check_params(int component, typename Function<Scalar>::Node* cur_node, int num_components)
@@ -42,16 +44,19 @@ namespace Hermes
     {
       order = 0;
       max_mem = total_mem = 0;
+      memory_category = function_memory_category;
       cur_node = NULL;
       sub_tables = NULL;
       nodes = NULL;
       overflow_nodes = NULL;
       memset(quads, 0, sizeof(quads));
+      memset(free_nodes, 0, sizeof(free_nodes));
     }
 
     template<typename Scalar>
     Function<Scalar>::~Function()
     {
+      free_node_pool();
     }
 
     template<typename Scalar>
@@ -60,6 +65,19 @@ namespace Hermes
       return order;
     }
 
+    template<typename Scalar>
+    size_t Function<Scalar>::get_memory_size() const
+    {
+      // The nodes of other functions released here are subtracted too.
+      return total_mem > 0 ? total_mem : 0;
+    }
+
+    template<typename Scalar>
+    size_t Function<Scalar>::get_peak_memory_size() const
+    {
+      return max_mem;
+    }
+
     template<typename Scalar>
     int Function<Scalar>::get_edge_fn_order(int edge) const
     {
@@ -195,7 +213,25 @@ namespace Hermes
 
       // allocate a node including its data part, init table pointers
       int size = (sizeof(Node) - sizeof(Scalar)) + sizeof(Scalar) * num_points * nt; //Due to impl. reasons, the structure Node has non-zero length of data even though they can be zero.
-      Node* node = (Node*) malloc(size);
+
+      // the pooled nodes have the size of their class
+      Node* node = NULL;
+      int size_class = 0;
+      while (size_class < H2D_NODE_SIZE_CLASSES && (H2D_NODE_MIN_SIZE << size_class) < size)
+        size_class++;
+      if(size_class < H2D_NODE_SIZE_CLASSES)
+      {
+        size = H2D_NODE_MIN_SIZE << size_class;
+        node = free_nodes[size_class];
+        if(node != NULL)
+          free_nodes[size_class] = (Node*) node->values[0][0];
+      }
+      if(node == NULL)
+      {
+        node = (Node*) malloc(size);
+        Hermes::MemoryAccounting::allocated(memory_category, size);
+      }
+
       node->mask = mask;
       node->size = size;
       memset(node->values, 0, sizeof(node->values));
@@ -213,6 +249,40 @@ namespace Hermes
       return node;
     }
 
+    template<typename Scalar>
+    void Function<Scalar>::delete_node(Node* node)
+    {
+      total_mem -= node->size;
+      int size_class = 0;
+      while (size_class < H2D_NODE_SIZE_CLASSES && (H2D_NODE_MIN_SIZE << size_class) < node->size)
+        size_class++;
+      if(size_class < H2D_NODE_SIZE_CLASSES && (H2D_NODE_MIN_SIZE << size_class) == node->size)
+      {
+        node->values[0][0] = (Scalar*) free_nodes[size_class];
+        free_nodes[size_class] = node;
+      }
+      else
+      {
+        Hermes::MemoryAccounting::released(memory_category, node->size);
+        ::free(node);
+      }
+    }
+
+    template<typename Scalar>
+    void Function<Scalar>::free_node_pool()
+    {
+      for (int i = 0; i < H2D_NODE_SIZE_CLASSES; i++)
+      {
+        while (free_nodes[i] != NULL)
+        {
+          Node* next = (Node*) free_nodes[i]->values[0][0];
+          Hermes::MemoryAccounting::released(memory_category, H2D_NODE_MIN_SIZE << i);
+          ::free(free_nodes[i]);
+          free_nodes[i] = next;
+        }
+      }
+    }
+
     template<typename Scalar>
     void Function<Scalar>::update_nodes_ptr()
     {
@@ -220,7 +290,7 @@ namespace Hermes
         handle_overflow_idx();
       else {
         if(sub_tables->find(sub_idx) == sub_tables->end())
-          sub_tables->insert(std::pair<uint64_t, LightArray<Node*>*>(sub_idx, new LightArray<Node*>));
+          sub_tables->insert(std::pair<uint64_t, NodeTable<Node*>*>(sub_idx, new NodeTable<Node*>));
         nodes = sub_tables->find(sub_idx)->second;
       }
     }
@@ -237,10 +307,8 @@ namespace Hermes
     void Function<Scalar>::replace_cur_node(Node* node)
     {
       if(node == NULL) throw Exceptions::NullException(1);
-      if(cur_node != NULL) {
-        total_mem -= cur_node->size;
-        ::free(cur_node);
-      }
+      if(cur_node != NULL)
+        delete_node(cur_node);
       cur_node = node;
     }
 
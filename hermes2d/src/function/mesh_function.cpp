@@ -46,7 +46,7 @@ namespace Hermes
       {
         for(unsigned int i = 0; i < this->overflow_nodes->get_size(); i++)
           if(this->overflow_nodes->present(i))
-            ::free(this->overflow_nodes->get(i));
+            this->delete_node(this->overflow_nodes->get(i));
         delete this->overflow_nodes;
       }
     }
@@ -239,10 +239,10 @@ namespace Hermes
       if(this->overflow_nodes != NULL) {
         for(unsigned int i = 0; i < this->overflow_nodes->get_size(); i++)
           if(this->overflow_nodes->present(i))
-            ::free(this->overflow_nodes->get(i));
+            this->delete_node(this->overflow_nodes->get(i));
         delete this->overflow_nodes;
       }
-      this->nodes = new LightArray<typename Function<Scalar>::Node *>;
+      this->nodes = new NodeTable<typename Function<Scalar>::Node *>;
       this->overflow_nodes = this->nodes;
     }
 
@@ -260,6 +260,13 @@ namespace Hermes
       Function<Scalar>::update_nodes_ptr();
     }
 
+    template<typename Scalar>
+    void MeshFunction<Scalar>::set_transform(uint64_t idx)
+    {
+      Transformable::set_transform(idx);
+      Function<Scalar>::update_nodes_ptr();
+    }
+
     template<typename Scalar>
     void MeshFunction<Scalar>::force_transform(MeshFunction<Scalar>* mf)
     {
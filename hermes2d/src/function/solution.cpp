@@ -19,6 +19,7 @@
 #include "solution_h2d_xml.h"
 #include "ogprojection.h"
 #include "api2d.h"
+#include "binary_file.h"
 
 #include <iostream>
 #include <algorithm>
@@ -27,6 +28,9 @@ namespace Hermes
 {
   namespace Hermes2D
   {
+    static int solution_memory_category = Hermes::MemoryAccounting::add_category("solutions");
+    static int solution_tables_memory_category = Hermes::MemoryAccounting::add_category("solution tables");
+
     static double3* cheb_tab_tri[11];
     static double3* cheb_tab_quad[11];
     static int      cheb_np_tri[11];
@@ -100,14 +104,19 @@ namespace Hermes
 
       for(int i = 0; i < 4; i++)
         for(int j = 0; j < 4; j++)
-          tables[i][j] = new std::map<uint64_t, LightArray<struct Function<double>::Node*>*>;
+          tables[i][j] = new std::map<uint64_t, NodeTable<struct Function<double>::Node*>*>;
 
       mono_coeffs = NULL;
       elem_coeffs[0] = elem_coeffs[1] = NULL;
       elem_orders = NULL;
       dxdy_buffer = NULL;
+      phys_grad_coeffs[0] = phys_grad_coeffs[1] = NULL;
       num_coeffs = num_elems = 0;
       num_dofs = -1;
+      accounted_memory = 0;
+      shared_coeffs_references = NULL;
+      coeffs_borrowed = false;
+      this->memory_category = solution_tables_memory_category;
 
       this->set_quad_2d(&g_quad_2d_std);
     }
@@ -125,14 +134,19 @@ namespace Hermes
 
 			for(int i = 0; i < 4; i++)
 				for(int j = 0; j < 4; j++)
-					tables[i][j] = new std::map<uint64_t, LightArray<struct Function<std::complex<double> >::Node*>*>;
+					tables[i][j] = new std::map<uint64_t, NodeTable<struct Function<std::complex<double> >::Node*>*>;
 
 			mono_coeffs = NULL;
 			elem_coeffs[0] = elem_coeffs[1] = NULL;
 			elem_orders = NULL;
 			dxdy_buffer = NULL;
+			phys_grad_coeffs[0] = phys_grad_coeffs[1] = NULL;
 			num_coeffs = num_elems = 0;
 			num_dofs = -1;
+			accounted_memory = 0;
+			shared_coeffs_references = NULL;
+			coeffs_borrowed = false;
+			this->memory_category = solution_tables_memory_category;
 
 			this->set_quad_2d(&g_quad_2d_std);
 		}
@@ -209,7 +223,7 @@ namespace Hermes
     void Solution<Scalar>::assign(Solution<Scalar>* sln)
     {
       if(sln->sln_type == HERMES_UNDEF) throw Hermes::Exceptions::Exception("Solution being assigned is uninitialized.");
-      if(sln->sln_type != HERMES_SLN) { copy(sln); return; }
+      if(sln->sln_type != HERMES_SLN || dynamic_cast<CompactSolution<Scalar>*>(sln) != NULL) { copy(sln); return; }
 
       free();
 
@@ -222,11 +236,17 @@ namespace Hermes
       elem_coeffs[1] = sln->elem_coeffs[1];  sln->elem_coeffs[1] = NULL;
       elem_orders = sln->elem_orders;      sln->elem_orders = NULL;
       dxdy_buffer = sln->dxdy_buffer;      sln->dxdy_buffer = NULL;
+      phys_grad_coeffs[0] = sln->phys_grad_coeffs[0];  sln->phys_grad_coeffs[0] = NULL;
+      phys_grad_coeffs[1] = sln->phys_grad_coeffs[1];  sln->phys_grad_coeffs[1] = NULL;
       num_coeffs = sln->num_coeffs;          sln->num_coeffs = 0;
       num_elems = sln->num_elems;          sln->num_elems = 0;
+      shared_coeffs_references = sln->shared_coeffs_references;  sln->shared_coeffs_references = NULL;
+      coeffs_borrowed = sln->coeffs_borrowed;  sln->coeffs_borrowed = false;
 
       sln_type = sln->sln_type;
       this->num_components = sln->num_components;
+      sln->update_memory_accounting();
+      update_memory_accounting();
 
       memset(sln->tables, 0, sizeof(sln->tables));
     }
@@ -235,6 +255,15 @@ namespace Hermes
     void Solution<Scalar>::copy(const Solution<Scalar>* sln)
     {
       if(sln->sln_type == HERMES_UNDEF) throw Hermes::Exceptions::Exception("Solution being copied is uninitialized.");
+
+      // A compact solution has not got the monomial coefficients of all elements.
+      const CompactSolution<Scalar>* compact = dynamic_cast<const CompactSolution<Scalar>*>(sln);
+      if(compact != NULL && compact->is_compact())
+      {
+        compact->expand(this);
+        return;
+      }
+
       free();
 
       this->mesh = sln->mesh;
@@ -262,6 +291,7 @@ namespace Hermes
         memcpy(elem_orders, sln->elem_orders, sizeof(int) * num_elems);
 
         init_dxdy_buffer();
+        update_memory_accounting();
       }
       else // Const, exact handled differently.
         throw Hermes::Exceptions::Exception("Undefined or exact solutions cannot be copied into an instance of Solution already coming from computation.");
@@ -273,10 +303,110 @@ namespace Hermes
     MeshFunction<Scalar>* Solution<Scalar>::clone() const
     {
       Solution<Scalar>* sln = new Solution<Scalar>();
-      sln->copy(this);
+      if(sln_type == HERMES_SLN)
+        sln->share_coeffs(this);
+      else
+        sln->copy(this);
       return sln;
     }
 
+    template<typename Scalar>
+    bool Solution<Scalar>::shares_coeffs() const
+    {
+      bool shared;
+#pragma omp critical (solution_shared_coeffs)
+      shared = shared_coeffs_references != NULL && *shared_coeffs_references > 1;
+      return shared;
+    }
+
+    template<typename Scalar>
+    void Solution<Scalar>::share_coeffs(const Solution<Scalar>* sln)
+    {
+      free();
+
+      this->mesh = sln->mesh;
+      sln_type = sln->sln_type;
+      space_type = sln->get_space_type();
+      this->num_components = sln->num_components;
+      num_dofs = sln->num_dofs;
+      num_coeffs = sln->num_coeffs;
+      num_elems = sln->num_elems;
+
+      // Clones may be made and deleted by several threads at once.
+#pragma omp critical (solution_shared_coeffs)
+      {
+        if(sln->shared_coeffs_references == NULL)
+          sln->shared_coeffs_references = new int(1);
+        (*sln->shared_coeffs_references)++;
+        shared_coeffs_references = sln->shared_coeffs_references;
+      }
+      coeffs_borrowed = true;
+
+      mono_coeffs = sln->mono_coeffs;
+      for (int l = 0; l < this->num_components; l++)
+        elem_coeffs[l] = sln->elem_coeffs[l];
+      elem_orders = sln->elem_orders;
+
+      init_dxdy_buffer();
+      update_memory_accounting();
+      this->element = NULL;
+    }
+
+    template<typename Scalar>
+    void Solution<Scalar>::release_coeffs()
+    {
+      bool last = true;
+      if(shared_coeffs_references != NULL)
+      {
+#pragma omp critical (solution_shared_coeffs)
+        last = --(*shared_coeffs_references) == 0;
+        if(last)
+          delete shared_coeffs_references;
+        shared_coeffs_references = NULL;
+      }
+      coeffs_borrowed = false;
+
+      if(last)
+      {
+        if(mono_coeffs != NULL)
+          delete [] mono_coeffs;
+        if(elem_orders != NULL)
+          delete [] elem_orders;
+        for (int i = 0; i < this->num_components; i++)
+          if(elem_coeffs[i] != NULL)
+            delete [] elem_coeffs[i];
+      }
+      mono_coeffs = NULL;
+      elem_orders = NULL;
+      for (int i = 0; i < this->num_components; i++)
+        elem_coeffs[i] = NULL;
+    }
+
+    template<typename Scalar>
+    void Solution<Scalar>::make_coeffs_unique()
+    {
+      if(!shares_coeffs())
+        return;
+
+      Scalar* new_mono_coeffs = new Scalar[num_coeffs];
+      memcpy(new_mono_coeffs, mono_coeffs, sizeof(Scalar) * num_coeffs);
+      int* new_elem_orders = new int[num_elems];
+      memcpy(new_elem_orders, elem_orders, sizeof(int) * num_elems);
+      int* new_elem_coeffs[H2D_MAX_SOLUTION_COMPONENTS];
+      for (int l = 0; l < this->num_components; l++)
+      {
+        new_elem_coeffs[l] = new int[num_elems];
+        memcpy(new_elem_coeffs[l], elem_coeffs[l], sizeof(int) * num_elems);
+      }
+
+      release_coeffs();
+      mono_coeffs = new_mono_coeffs;
+      elem_orders = new_elem_orders;
+      for (int l = 0; l < this->num_components; l++)
+        elem_coeffs[l] = new_elem_coeffs[l];
+      update_memory_accounting();
+    }
+
     template<typename Scalar>
     void Solution<Scalar>::free_tables()
     {
@@ -284,11 +414,11 @@ namespace Hermes
         for (int j = 0; j < 4; j++)
           if(tables[i][j] != NULL)
           {
-            for(typename std::map<uint64_t, LightArray<struct Function<Scalar>::Node*>*>::iterator it = tables[i][j]->begin(); it != tables[i][j]->end(); it++)
+            for(typename std::map<uint64_t, NodeTable<struct Function<Scalar>::Node*>*>::iterator it = tables[i][j]->begin(); it != tables[i][j]->end(); it++)
             {
               for(unsigned int l = 0; l < it->second->get_size(); l++)
                 if(it->second->present(l))
-                  ::free(it->second->get(l));
+                  this->delete_node(it->second->get(l));
               delete it->second;
             }
             tables[i][j]->clear();
@@ -301,33 +431,27 @@ namespace Hermes
     template<>
     void Solution<double>::free()
     {
-      if(mono_coeffs  != NULL) { delete [] mono_coeffs;   mono_coeffs = NULL;  }
-      if(elem_orders != NULL) { delete [] elem_orders;  elem_orders = NULL; }
+      release_coeffs();
       if(dxdy_buffer != NULL) { delete [] dxdy_buffer;  dxdy_buffer = NULL; }
 
-      for (int i = 0; i < this->num_components; i++)
-        if(elem_coeffs[i] != NULL)
-        { delete [] elem_coeffs[i];  elem_coeffs[i] = NULL; }
-
         e_last = NULL;
 
         free_tables();
+        this->free_node_pool();
+        update_memory_accounting();
     }
 
 		template<>
 		void Solution<std::complex<double> >::free()
 		{
-			if(mono_coeffs  != NULL) { delete [] mono_coeffs;   mono_coeffs = NULL;  }
-			if(elem_orders != NULL) { delete [] elem_orders;  elem_orders = NULL; }
+			release_coeffs();
 			if(dxdy_buffer != NULL) { delete [] dxdy_buffer;  dxdy_buffer = NULL; }
 
-			for (int i = 0; i < this->num_components; i++)
-				if(elem_coeffs[i] != NULL)
-				{ delete [] elem_coeffs[i];  elem_coeffs[i] = NULL; }
-
 				e_last = NULL;
 
 				free_tables();
+				this->free_node_pool();
+				update_memory_accounting();
 		}
 
 		template<>
@@ -369,25 +493,58 @@ namespace Hermes
     }
     mono_lu;
 
+    /// Key of the monomial coefficients of one shape function, see shape_mono.
+    struct ShapeMonoKey
+    {
+      int shapeset_id;
+      int mode;
+      int order;
+      int index;
+
+      bool operator<(const ShapeMonoKey& other) const
+      {
+        if(shapeset_id != other.shapeset_id)
+          return shapeset_id < other.shapeset_id;
+        if(mode != other.mode)
+          return mode < other.mode;
+        if(order != other.order)
+          return order < other.order;
+        return index < other.index;
+      }
+    };
+
+    /// Monomial coefficients (of all components one after another) of the shape functions expressed
+    /// in the monomials of the given order, shared by all Solutions.
+    /// The solution on an element is then just their combination with the coefficients of the assembly list.
+    static class ShapeMonoTable : public std::map<ShapeMonoKey, double*>
+    {
+    public:
+      ~ShapeMonoTable()
+      {
+        for(iterator it = begin(); it != end(); it++)
+          delete [] it->second;
+      }
+    } shape_mono;
+
     template<typename Scalar>
-    double** Solution<Scalar>::calc_mono_matrix(int o, int*& perm)
+    double** Solution<Scalar>::calc_mono_matrix(int mode, int o, int*& perm)
     {
       int i, j, k, l, m, row;
       double x, y, xn, yn;
-      int n = this->mode ? sqr(o + 1) : (o + 1)*(o + 2)/2;
+      int n = mode ? sqr(o + 1) : (o + 1)*(o + 2)/2;
 
       // loop through all chebyshev points
       double** mat = new_matrix<double>(n, n);
       for (k = o, row = 0; k >= 0; k--)
       {
         y = o ? cos(k * M_PI / o) : 1.0;
-        for (l = o; l >= (this->mode ? 0 : o-k); l--, row++)
+        for (l = o; l >= (mode ? 0 : o-k); l--, row++)
         {
           x = o ? cos(l * M_PI / o) : 1.0;
 
           // each row of the matrix contains all the monomials x^i*y^j
           for (i = 0, yn = 1.0, m = n-1;  i <= o;  i++, yn *= y)
-            for (j = (this->mode ? 0 : i), xn = 1.0;  j <= o;  j++, xn *= x, m--)
+            for (j = (mode ? 0 : i), xn = 1.0;  j <= o;  j++, xn *= x, m--)
               mat[row][m] = xn * yn;
         }
       }
@@ -398,6 +555,88 @@ namespace Hermes
       return mat;
     }
 
+    template<typename Scalar>
+    int Solution<Scalar>::calc_mono_order(const Space<Scalar>* space, Element* e)
+    {
+      int o = space->get_element_order(e->id);
+      o = std::max(H2D_GET_H_ORDER(o), H2D_GET_V_ORDER(o));
+      for (unsigned int k = 0; k < e->get_nvert(); k++)
+      {
+        int eo = space->get_edge_order(e, k);
+        if(eo > o) o = eo;
+      }
+
+      // Hcurl and Hdiv: actual order of functions is one higher than element order
+      if((space->shapeset)->get_num_components() == 2) o++;
+
+      return o;
+    }
+
+    template<typename Scalar>
+    void Solution<Scalar>::calc_mono_coeffs(const Space<Scalar>* space, PrecalcShapeset* pss, const Scalar* coeff_vec, bool add_dir_lift,
+      int start_index, int stride, Element* e, int o, Scalar* mono)
+    {
+      int n = g_quad_2d_cheb.get_num_points(o, e->get_mode()) * this->num_components;
+
+      AsmList<Scalar> al;
+      space->get_element_assembly_list(e, &al);
+
+      memset(mono, 0, sizeof(Scalar) * n);
+      for (unsigned int k = 0; k < al.cnt; k++)
+      {
+        int dof = al.dof[k];
+        double dir_lift_coeff = add_dir_lift ? 1.0 : 0.0;
+        // By subtracting space->first_dof we make sure that it does not matter where the
+        // enumeration of dofs in the space starts. This ca be either zero or there can be some
+        // offset. By adding start_index we move to the desired section of coeff_vec.
+        Scalar coef = al.coef[k] * (dof >= 0 ? coeff_vec[(dof - space->first_dof) / stride + start_index] : dir_lift_coeff);
+        double* shape = get_shape_mono_coeffs(pss, e, o, al.idx[k]);
+        for (int i = 0; i < n; i++)
+          mono[i] += shape[i] * coef;
+      }
+    }
+
+    template<typename Scalar>
+    double* Solution<Scalar>::get_shape_mono_coeffs(PrecalcShapeset* pss, Element* e, int o, int index)
+    {
+      ShapeMonoKey key;
+      key.shapeset_id = pss->get_shapeset()->get_id();
+      key.mode = e->get_mode();
+      key.order = o;
+      key.index = index;
+
+      double* coeffs = NULL;
+      // The constrained edge combinations of the shapeset and mono_lu are not thread-safe either,
+      // so the (rare) calculation is done inside.
+#pragma omp critical (Solution_shape_mono)
+      {
+        ShapeMonoTable::iterator it = shape_mono.find(key);
+        if(it != shape_mono.end())
+          coeffs = it->second;
+        else
+        {
+          int mode = e->get_mode();
+          int np = g_quad_2d_cheb.get_num_points(o, e->get_mode());
+          int num_components = pss->get_num_components();
+          coeffs = new double[np * num_components];
+
+          pss->set_active_element(e);
+          pss->set_active_shape(index);
+          pss->set_quad_order(o, H2D_FN_VAL);
+          if(mono_lu.mat[mode][o] == NULL)
+            mono_lu.mat[mode][o] = calc_mono_matrix(mode, o, mono_lu.perm[mode][o]);
+          for (int l = 0; l < num_components; l++)
+          {
+            // Values in the Chebyshev points, solved for the monomial coefficients.
+            memcpy(coeffs + l * np, pss->get_fn_values(l), sizeof(double) * np);
+            lubksb(mono_lu.mat[mode][o], np, mono_lu.perm[mode][o], coeffs + l * np);
+          }
+          shape_mono.insert(std::pair<ShapeMonoKey, double*>(key, coeffs));
+        }
+      }
+      return coeffs;
+    }
+
     template<typename Scalar>
     void Solution<Scalar>::set_coeff_vector(const Space<Scalar>* space, const Vector<Scalar>* vec,
         bool add_dir_lift, int start_index)
@@ -407,6 +646,13 @@ namespace Hermes
       if(vec == NULL) throw Exceptions::NullException(2);
 
       space_type = space->get_type();
+      // The values are read in place if the vector stores them contiguously.
+      const Scalar* values = vec->get_values();
+      if(values != NULL)
+      {
+        this->set_coeff_vector(space, values, add_dir_lift, start_index);
+        return;
+      }
       Scalar* coeffs = new Scalar[vec->length()];
       vec->extract(coeffs);
       this->set_coeff_vector(space, coeffs, add_dir_lift, start_index);
@@ -429,6 +675,7 @@ namespace Hermes
       delete pss;
     }
 
+#define CHUNKSIZE 1
     template<typename Scalar>
     void Solution<Scalar>::set_coeff_vector(const Space<Scalar>* space, PrecalcShapeset* pss,
         const Scalar* coeff_vec, bool add_dir_lift, int start_index)
@@ -480,17 +727,7 @@ namespace Hermes
       for_all_active_elements(e, this->mesh)
       {
         this->mode = e->get_mode();
-        o = space->get_element_order(e->id);
-        o = std::max(H2D_GET_H_ORDER(o), H2D_GET_V_ORDER(o));
-        for (unsigned int k = 0; k < e->get_nvert(); k++)
-        {
-          int eo = space->get_edge_order(e, k);
-          if(eo > o) o = eo;
-        }
-
-        // Hcurl and Hdiv: actual order of functions is one higher than element order
-        if((space->shapeset)->get_num_components() == 2) o++;
-
+        o = calc_mono_order(space, e);
         num_coeffs += this->mode ? sqr(o + 1) : (o + 1)*(o + 2)/2;
         elem_orders[e->id] = o;
       }
@@ -502,48 +739,73 @@ namespace Hermes
       // Express the solution on elements as a linear combination of monomials.
       Quad2D* quad = &g_quad_2d_cheb;
       pss->set_quad_2d(quad);
-      Scalar* mono = mono_coeffs;
+      Hermes::vector<Element*> elements;
+      int mono_offset = 0;
       for_all_active_elements(e, this->mesh)
       {
-        this->mode = e->get_mode();
         o = elem_orders[e->id];
         int np = quad->get_num_points(o, e->get_mode());
+        for (int l = 0; l < this->num_components; l++)
+          elem_coeffs[l][e->id] = mono_offset + l * np;
+        mono_offset += np * this->num_components;
+        elements.push_back(e);
+      }
 
-        AsmList<Scalar> al;
-        space->get_element_assembly_list(e, &al);
-        pss->set_active_element(e);
+      // In parallel over the elements, every thread with its own PrecalcShapeset
+      // (the shape functions in the monomials are shared, see get_shape_mono_coeffs()).
+      int num_threads_used = std::max(1, std::min((int)Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads), (int)elements.size()));
+      PrecalcShapeset** pss_threads = new PrecalcShapeset*[num_threads_used];
+      pss_threads[0] = pss;
+      for (int thread_i = 1; thread_i < num_threads_used; thread_i++)
+      {
+        pss_threads[thread_i] = new PrecalcShapeset(pss->get_shapeset());
+        pss_threads[thread_i]->set_quad_2d(quad);
+      }
 
-        for (int l = 0; l < this->num_components; l++)
+      Hermes::Exceptions::Exception* caughtException = NULL;
+      int num_elements = elements.size();
+      int elem_i;
+#pragma omp parallel shared(elements, pss_threads) private(elem_i) num_threads(num_threads_used)
+      {
+#pragma omp for schedule(dynamic, CHUNKSIZE)
+        for (elem_i = 0; elem_i < num_elements; elem_i++)
         {
-          // Obtain solution values for the current element.
-          Scalar* val = mono;
-          elem_coeffs[l][e->id] = (int) (mono - mono_coeffs);
-          memset(val, 0, sizeof(Scalar)*np);
-          for (unsigned int k = 0; k < al.cnt; k++)
+          if(caughtException != NULL)
+            continue;
+          try
           {
-            pss->set_active_shape(al.idx[k]);
-            pss->set_quad_order(o, H2D_FN_VAL);
-            int dof = al.dof[k];
-            double dir_lift_coeff = add_dir_lift ? 1.0 : 0.0;
-            // By subtracting space->first_dof we make sure that it does not matter where the
-            // enumeration of dofs in the space starts. This ca be either zero or there can be some
-            // offset. By adding start_index we move to the desired section of coeff_vec.
-            Scalar coef = al.coef[k] * (dof >= 0 ? coeff_vec[dof  - space->first_dof + start_index] : dir_lift_coeff);
-            double* shape = pss->get_fn_values(l);
-            for (int i = 0; i < np; i++)
-              val[i] += shape[i] * coef;
+            Element* elem = elements[elem_i];
+            calc_mono_coeffs(space, pss_threads[omp_get_thread_num()], coeff_vec, add_dir_lift, start_index, 1, elem, elem_orders[elem->id], mono_coeffs + elem_coeffs[0][elem->id]);
+          }
+          catch(Hermes::Exceptions::Exception& exception)
+          {
+#pragma omp critical (caughtException)
+            if(caughtException == NULL)
+              caughtException = exception.clone();
+          }
+          catch(std::exception& exception)
+          {
+#pragma omp critical (caughtException)
+            if(caughtException == NULL)
+              caughtException = new Hermes::Exceptions::Exception(exception.what());
           }
-          mono += np;
-
-          // solve for the monomial coefficients
-          if(mono_lu.mat[this->mode][o] == NULL)
-            mono_lu.mat[this->mode][o] = calc_mono_matrix(o, mono_lu.perm[this->mode][o]);
-          lubksb(mono_lu.mat[this->mode][o], np, mono_lu.perm[this->mode][o], val);
         }
       }
 
+      for (int thread_i = 1; thread_i < num_threads_used; thread_i++)
+        delete pss_threads[thread_i];
+      delete [] pss_threads;
+
+      if(caughtException != NULL)
+      {
+        Hermes::Exceptions::Exception exception(*caughtException);
+        delete caughtException;
+        throw exception;
+      }
+
       if(this->mesh == NULL) throw Hermes::Exceptions::Exception("mesh == NULL.\n");
       init_dxdy_buffer();
+      update_memory_accounting();
       this->element = NULL;
       if(Solution<Scalar>::static_verbose_output)
         Hermes::Mixins::Loggable::Static::info("Solution: set_coeff_vector - done.");
@@ -557,16 +819,12 @@ namespace Hermes
       if(solution_vector == NULL) throw Exceptions::NullException(1);
       if(spaces.size() != solutions.size()) throw Exceptions::LengthException(2, 3, spaces.size(), solutions.size());
 
-      // If start indices are not given, calculate them using the dimension of each space.
+      // If start indices are not given, calculate them using the dimension of each space (or the interleaving of the DOFs).
       Hermes::vector<int> start_indices_new;
       if(start_indices.empty())
       {
-        int counter = 0;
         for (int i=0; i < spaces.size(); i++)
-        {
-          start_indices_new.push_back(counter);
-          counter += spaces[i]->get_num_dofs();
-        }
+          start_indices_new.push_back(Space<Scalar>::get_dof_offset(spaces, i));
       }
       else
       {
@@ -620,16 +878,12 @@ namespace Hermes
       if(solution_vector == NULL) throw Exceptions::NullException(1);
       if(spaces.size() != solutions.size()) throw Exceptions::LengthException(2, 3, spaces.size(), solutions.size());
 
-      // If start indices are not given, calculate them using the dimension of each space.
+      // If start indices are not given, calculate them using the dimension of each space (or the interleaving of the DOFs).
       Hermes::vector<int> start_indices_new;
       if(start_indices.empty())
       {
-        int counter = 0;
         for (int i=0; i < spaces.size(); i++)
-        {
-          start_indices_new.push_back(counter);
-          counter += spaces[i]->get_num_dofs();
-        }
+          start_indices_new.push_back(Space<Scalar>::get_dof_offset(spaces, i));
       }
       else
       {
@@ -671,14 +925,10 @@ namespace Hermes
       if(solution_vector == NULL) throw Exceptions::NullException(1);
       if(spaces.size() != solutions.size()) throw Exceptions::LengthException(2, 3, spaces.size(), solutions.size());
 
-      // If start indices are not given, calculate them using the dimension of each space.
+      // Calculate the start indices using the dimension of each space (or the interleaving of the DOFs).
       Hermes::vector<int> start_indices_new;
-      int counter = 0;
       for (int i=0; i < spaces.size(); i++)
-      {
-        start_indices_new.push_back(counter);
-        counter += spaces[i]->get_num_dofs();
-      }
+        start_indices_new.push_back(Space<Scalar>::get_dof_offset(spaces, i));
       
       for(unsigned int i = 0; i < solutions.size(); i++)
         Solution<Scalar>::vector_to_solution(solution_vector, spaces[i], solutions[i], add_dir_lift, start_indices_new[i]);
@@ -693,14 +943,10 @@ namespace Hermes
       if(solution_vector == NULL) throw Exceptions::NullException(1);
       if(spaces.size() != solutions.size()) throw Exceptions::LengthException(2, 3, spaces.size(), solutions.size());
 
-      // If start indices are not given, calculate them using the dimension of each space.
+      // Calculate the start indices using the dimension of each space (or the interleaving of the DOFs).
       Hermes::vector<int> start_indices_new;
-      int counter = 0;
       for (int i=0; i < spaces.size(); i++)
-      {
-        start_indices_new.push_back(counter);
-        counter += spaces[i]->get_num_dofs();
-      }
+        start_indices_new.push_back(Space<Scalar>::get_dof_offset(spaces, i));
       
       for(unsigned int i = 0; i < solutions.size(); i++)
         Solution<Scalar>::vector_to_solution(solution_vector, spaces[i], solutions[i], add_dir_lift, start_indices_new[i]);
@@ -728,16 +974,12 @@ namespace Hermes
       if(solution_vector==NULL) throw Exceptions::NullException(1);
       if(spaces.size() != solutions.size()) throw Exceptions::LengthException(2, 3, spaces.size(), solutions.size());
 
-      // If start indices are not given, calculate them using the dimension of each space.
+      // If start indices are not given, calculate them using the dimension of each space (or the interleaving of the DOFs).
       Hermes::vector<int> start_indices_new;
       if(start_indices.empty())
       {
-        int counter = 0;
         for (int i=0; i < spaces.size(); i++)
-        {
-          start_indices_new.push_back(counter);
-          counter += spaces[i]->get_num_dofs();
-        }
+          start_indices_new.push_back(Space<Scalar>::get_dof_offset(spaces, i));
       }
       else
       {
@@ -809,6 +1051,7 @@ namespace Hermes
     {
       if(sln_type == HERMES_SLN)
       {
+        make_coeffs_unique();
         for (int i = 0; i < num_coeffs; i++)
           mono_coeffs[i] *= coef;
       }
@@ -851,6 +1094,32 @@ namespace Hermes
       }
     }
 
+    template<typename Scalar>
+    Scalar* Solution<Scalar>::get_mono_coeffs(Element* e, int component)
+    {
+      return mono_coeffs + elem_coeffs[component][e->id];
+    }
+
+    template<typename Scalar>
+    void Solution<Scalar>::update_memory_accounting()
+    {
+      size_t memory = 0;
+      if(!coeffs_borrowed)
+      {
+        if(mono_coeffs != NULL)
+          memory += num_coeffs * sizeof(Scalar);
+        if(elem_orders != NULL)
+          memory += num_elems * sizeof(int);
+        for(int l = 0; l < H2D_MAX_SOLUTION_COMPONENTS; l++)
+          if(elem_coeffs[l] != NULL)
+            memory += num_elems * sizeof(int);
+      }
+      if(dxdy_buffer != NULL)
+        memory += (this->num_components * 5 + 2) * 121 * sizeof(Scalar);
+      Hermes::MemoryAccounting::changed(solution_memory_category, accounted_memory, memory);
+      accounted_memory = memory;
+    }
+
     template<typename Scalar>
     void Solution<Scalar>::init_dxdy_buffer()
     {
@@ -859,7 +1128,7 @@ namespace Hermes
         delete [] dxdy_buffer;
         dxdy_buffer = NULL;
       }
-      dxdy_buffer = new Scalar[this->num_components * 5 * 121];
+      dxdy_buffer = new Scalar[(this->num_components * 5 + 2) * 121];
     }
 
     template<typename Scalar>
@@ -883,11 +1152,11 @@ namespace Hermes
       {
         if(tables[this->cur_quad][oldest[this->cur_quad]] != NULL)
         {
-          for(typename std::map<uint64_t, LightArray<struct Function<Scalar>::Node*>*>::iterator it = tables[this->cur_quad][oldest[this->cur_quad]]->begin(); it != tables[this->cur_quad][oldest[this->cur_quad]]->end(); it++)
+          for(typename std::map<uint64_t, NodeTable<struct Function<Scalar>::Node*>*>::iterator it = tables[this->cur_quad][oldest[this->cur_quad]]->begin(); it != tables[this->cur_quad][oldest[this->cur_quad]]->end(); it++)
           {
             for(unsigned int l = 0; l < it->second->get_size(); l++)
               if(it->second->present(l))
-                ::free(it->second->get(l));
+                this->delete_node(it->second->get(l));
             delete it->second;
           }
           delete tables[this->cur_quad][oldest[this->cur_quad]];
@@ -895,7 +1164,7 @@ namespace Hermes
           elems[this->cur_quad][oldest[this->cur_quad]] = NULL;
         }
 
-        tables[this->cur_quad][oldest[this->cur_quad]] = new std::map<uint64_t, LightArray<struct Function<Scalar>::Node*>*>;
+        tables[this->cur_quad][oldest[this->cur_quad]] = new std::map<uint64_t, NodeTable<struct Function<Scalar>::Node*>*>;
 
         cur_elem = oldest[this->cur_quad];
         if(++oldest[this->cur_quad] >= 4)
@@ -911,7 +1180,7 @@ namespace Hermes
 
         for (int i = 0, m = 0; i < this->num_components; i++)
         {
-          Scalar* mono = mono_coeffs + elem_coeffs[i][e->id];
+          Scalar* mono = get_mono_coeffs(e, i);
           dxdy_coeffs[i][0] = mono;
 
           make_dx_coeffs(this->mode, o, mono, dxdy_coeffs[i][1] = dxdy_buffer + m);  m += n;
@@ -920,6 +1189,19 @@ namespace Hermes
           make_dy_coeffs(this->mode, o, dxdy_coeffs[i][2], dxdy_coeffs[i][4] = dxdy_buffer + m);  m += n;
           make_dx_coeffs(this->mode, o, dxdy_coeffs[i][2], dxdy_coeffs[i][5] = dxdy_buffer + m);  m += n;
         }
+
+        phys_grad_coeffs[0] = phys_grad_coeffs[1] = NULL;
+        if(space_type == HERMES_H1_SPACE && this->num_components == 1 && this->refmap->is_jacobian_const())
+        {
+          double2x2* inv_ref_map = this->refmap->get_const_inv_ref_map();
+          phys_grad_coeffs[0] = dxdy_buffer + 5 * n;
+          phys_grad_coeffs[1] = dxdy_buffer + 6 * n;
+          for (int i = 0; i < n; i++)
+          {
+            phys_grad_coeffs[0][i] = (*inv_ref_map)[0][0] * dxdy_coeffs[0][1][i] + (*inv_ref_map)[0][1] * dxdy_coeffs[0][2][i];
+            phys_grad_coeffs[1][i] = (*inv_ref_map)[1][0] * dxdy_coeffs[0][1][i] + (*inv_ref_map)[1][1] * dxdy_coeffs[0][2][i];
+          }
+        }
       }
       else if(sln_type == HERMES_EXACT)
       {
@@ -933,26 +1215,94 @@ namespace Hermes
       this->update_nodes_ptr();
     }
 
-    template<typename Scalar>
-    static inline void set_vec_num(int n, Scalar* y, Scalar num)
+    /// Evaluates the monomial expansion of a solution on an element of the order O (see Solution::dxdy_coeffs) in np points by Horner's scheme.
+    /// With the order known at compile time the loops over the monomials unroll, blocks of H2D_MONOMIAL_BLOCK points
+    /// are evaluated at once to have independent chains of multiplications (and vectorize).
+    static const int H2D_MONOMIAL_BLOCK = 4;
+
+    template<typename Scalar, int O, bool quad>
+    static void evaluate_monomials(int np, const Scalar* mono, const double* x, const double* y, Scalar* result)
     {
-      for (int i = 0; i < n; i++)
-        y[i] = num;
+      int p = 0;
+      for (; p + H2D_MONOMIAL_BLOCK <= np; p += H2D_MONOMIAL_BLOCK)
+      {
+        const Scalar* m = mono;
+        Scalar value[H2D_MONOMIAL_BLOCK], row[H2D_MONOMIAL_BLOCK];
+        for (int i = 0; i <= O; i++)
+        {
+          for (int q = 0; q < H2D_MONOMIAL_BLOCK; q++)
+            row[q] = m[0];
+          for (int j = 1; j <= (quad ? O : i); j++)
+            for (int q = 0; q < H2D_MONOMIAL_BLOCK; q++)
+              row[q] = row[q] * x[p + q] + m[j];
+          for (int q = 0; q < H2D_MONOMIAL_BLOCK; q++)
+            value[q] = (i == 0) ? row[q] : value[q] * y[p + q] + row[q];
+          m += (quad ? O : i) + 1;
+        }
+        for (int q = 0; q < H2D_MONOMIAL_BLOCK; q++)
+          result[p + q] = value[q];
+      }
+
+      for (; p < np; p++)
+      {
+        const Scalar* m = mono;
+        Scalar value = 0.0;
+        for (int i = 0; i <= O; i++)
+        {
+          Scalar row = *m++;
+          for (int j = 1; j <= (quad ? O : i); j++)
+            row = row * x[p] + *m++;
+          value = value * y[p] + row;
+        }
+        result[p] = value;
+      }
     }
 
+    /// The same as evaluate_monomials() for the orders above H2D_SOLUTION_SPECIALIZED_ORDER.
     template<typename Scalar>
-    static inline void vec_x_vec_p_num(int n, Scalar* y, Scalar* x, Scalar num)
+    static void evaluate_monomials(int np, const Scalar* mono, const double* x, const double* y, Scalar* result, int o, bool quad)
     {
-      for (int i = 0; i < n; i++)
-        y[i] = y[i]*x[i] + num;
+      for (int p = 0; p < np; p++)
+      {
+        const Scalar* m = mono;
+        Scalar value = 0.0;
+        for (int i = 0; i <= o; i++)
+        {
+          Scalar row = *m++;
+          for (int j = 1; j <= (quad ? o : i); j++)
+            row = row * x[p] + *m++;
+          value = value * y[p] + row;
+        }
+        result[p] = value;
+      }
     }
 
+    /// The highest order with a specialized evaluate_monomials().
+    static const int H2D_SOLUTION_SPECIALIZED_ORDER = 10;
+
     template<typename Scalar>
-    static inline void vec_x_vec_p_vec(int n, Scalar* y, Scalar* x, Scalar* z)
+    struct MonomialEvaluators
     {
-      for (int i = 0; i < n; i++)
-        y[i] = y[i]*x[i] + z[i];
-    }
+      typedef void (*Evaluator)(int np, const Scalar* mono, const double* x, const double* y, Scalar* result);
+      static const Evaluator evaluators[H2D_NUM_MODES][H2D_SOLUTION_SPECIALIZED_ORDER + 1];
+    };
+
+    template<typename Scalar>
+    const typename MonomialEvaluators<Scalar>::Evaluator MonomialEvaluators<Scalar>::evaluators[H2D_NUM_MODES][H2D_SOLUTION_SPECIALIZED_ORDER + 1] =
+    {
+      {
+        evaluate_monomials<Scalar, 0, false>, evaluate_monomials<Scalar, 1, false>, evaluate_monomials<Scalar, 2, false>,
+        evaluate_monomials<Scalar, 3, false>, evaluate_monomials<Scalar, 4, false>, evaluate_monomials<Scalar, 5, false>,
+        evaluate_monomials<Scalar, 6, false>, evaluate_monomials<Scalar, 7, false>, evaluate_monomials<Scalar, 8, false>,
+        evaluate_monomials<Scalar, 9, false>, evaluate_monomials<Scalar, 10, false>
+      },
+      {
+        evaluate_monomials<Scalar, 0, true>, evaluate_monomials<Scalar, 1, true>, evaluate_monomials<Scalar, 2, true>,
+        evaluate_monomials<Scalar, 3, true>, evaluate_monomials<Scalar, 4, true>, evaluate_monomials<Scalar, 5, true>,
+        evaluate_monomials<Scalar, 6, true>, evaluate_monomials<Scalar, 7, true>, evaluate_monomials<Scalar, 8, true>,
+        evaluate_monomials<Scalar, 9, true>, evaluate_monomials<Scalar, 10, true>
+      }
+    };
 
     static const int H2D_GRAD = H2D_FN_DX_0 | H2D_FN_DY_0;
     static const int H2D_SECOND = H2D_FN_DXX_0 | H2D_FN_DXY_0 | H2D_FN_DYY_0;
@@ -1090,9 +1440,8 @@ namespace Hermes
         node = this->new_node(newmask, np);
 
         // transform integration points by the current matrix
-        Scalar* x = new Scalar[np];
-        Scalar* y = new Scalar[np];
-        Scalar* tx = new Scalar[np];
+        double* x = new double[2 * np];
+        double* y = x + np;
         double3* pt = quad->get_points(order, this->element->get_mode());
         for (i = 0; i < np; i++)
         {
@@ -1100,6 +1449,9 @@ namespace Hermes
           y[i] = pt[i][1] * this->ctm->m[1] + this->ctm->t[1];
         }
 
+        // the physical gradient straight from its coefficients, if available
+        bool phys_grad = transform && phys_grad_coeffs[0] != NULL;
+
         // obtain the solution values, this is the core of the whole module
         int o = elem_orders[this->element->id];
         for (l = 0; l < this->num_components; l++)
@@ -1117,30 +1469,22 @@ namespace Hermes
               else
               {
                 // calculate the solution values using Horner's scheme
-                Scalar* mono = dxdy_coeffs[l][k];
-                for (i = 0; i <= o; i++)
-                {
-                  set_vec_num(np, tx, *mono++);
-                  for (j = 1; j <= (this->mode ? o : i); j++)
-                    vec_x_vec_p_num(np, tx, x, *mono++);
-
-                  if(!i)
-                    memcpy(result, tx, sizeof(Scalar)*np);
-                  else
-                    vec_x_vec_p_vec(np, result, y, tx);
-                }
+                Scalar* mono = (phys_grad && (k == 1 || k == 2)) ? phys_grad_coeffs[k - 1] : dxdy_coeffs[l][k];
+                if(o <= H2D_SOLUTION_SPECIALIZED_ORDER)
+                  MonomialEvaluators<Scalar>::evaluators[this->mode][o](np, mono, x, y, result);
+                else
+                  evaluate_monomials<Scalar>(np, mono, x, y, result, o, this->mode == HERMES_MODE_QUAD);
               }
             }
           }
         }
 
         delete [] x;
-        delete [] y;
-        delete [] tx;
 
         // transform gradient or vector solution, if required
-        if(transform)
-          transform_values(order, node, newmask, oldmask, np);
+        // (the second derivatives on elements with a constant reference map do not depend on the gradient)
+        if(transform && (!phys_grad || ((newmask & H2D_SECOND) == H2D_SECOND && (oldmask & H2D_SECOND) != H2D_SECOND)))
+          transform_values(order, node, newmask, phys_grad ? (oldmask | H2D_GRAD) : oldmask, np);
       }
       else if(sln_type == HERMES_EXACT)
       {
@@ -1152,9 +1496,12 @@ namespace Hermes
         double* x = this->refmap->get_phys_x(order);
         double* y = this->refmap->get_phys_y(order);
 
-        // evaluate the exact solution
+        // evaluate the exact solution in all the points at once
+        Scalar exact_multiplicator = (static_cast<ExactSolution<Scalar>*>(this))->exact_multiplicator;
         if(this->num_components == 1)
         {
+          (static_cast<ExactSolutionScalar<Scalar>*>(this))->exact_values(np, x, y, node->values[0][0], node->values[0][1], node->values[0][2]);
+
           // untransform values
           if(!transform)
           {
@@ -1166,39 +1513,25 @@ namespace Hermes
             for (i = 0, m = mat; i < np; i++, m += mstep)
             {
               double jac = (*m)[0][0] *  (*m)[1][1] - (*m)[1][0] *  (*m)[0][1];
-              Scalar val, dx = 0.0, dy = 0.0;
-              val = (static_cast<ExactSolutionScalar<Scalar>*>(this))->exact_function(x[i], y[i], dx, dy);
-              node->values[0][0][i] = val * (static_cast<ExactSolutionVector<Scalar>*>(this))->exact_multiplicator;
-              node->values[0][1][i] = (  (*m)[1][1]*dx - (*m)[0][1]*dy) / jac * (static_cast<ExactSolutionVector<Scalar>*>(this))->exact_multiplicator;
-              node->values[0][2][i] = (- (*m)[1][0]*dx + (*m)[0][0]*dy) / jac * (static_cast<ExactSolutionVector<Scalar>*>(this))->exact_multiplicator;
-            }
-          }
-          else
-          {
-            for (i = 0; i < np; i++)
-            {
-              Scalar val, dx = 0.0, dy = 0.0;
-              val = (static_cast<ExactSolutionScalar<Scalar>*>(this))->exact_function(x[i], y[i], dx, dy);
-              node->values[0][0][i] = val * (static_cast<ExactSolutionVector<Scalar>*>(this))->exact_multiplicator;
-              node->values[0][1][i] = dx * (static_cast<ExactSolutionVector<Scalar>*>(this))->exact_multiplicator;
-              node->values[0][2][i] = dy * (static_cast<ExactSolutionVector<Scalar>*>(this))->exact_multiplicator;
+              Scalar dx = node->values[0][1][i], dy = node->values[0][2][i];
+              node->values[0][1][i] = (  (*m)[1][1]*dx - (*m)[0][1]*dy) / jac;
+              node->values[0][2][i] = (- (*m)[1][0]*dx + (*m)[0][0]*dy) / jac;
             }
           }
         }
         else
         {
-          for (i = 0; i < np; i++)
-          {
-            Scalar2<Scalar> dx (0.0, 0.0 ), dy ( 0.0, 0.0 );
-            Scalar2<Scalar> val = (static_cast<ExactSolutionVector<Scalar>*>(this))->exact_function(x[i], y[i], dx, dy);
-            for (j = 0; j < 2; j++)
-            {
-              node->values[j][0][i] = val[j] * (static_cast<ExactSolutionVector<Scalar>*>(this))->exact_multiplicator;
-              node->values[j][1][i] = dx[j] * (static_cast<ExactSolutionVector<Scalar>*>(this))->exact_multiplicator;
-              node->values[j][2][i] = dy[j] * (static_cast<ExactSolutionVector<Scalar>*>(this))->exact_multiplicator;
-            }
-          }
+          Scalar* values[2] = { node->values[0][0], node->values[1][0] };
+          Scalar* dx[2] = { node->values[0][1], node->values[1][1] };
+          Scalar* dy[2] = { node->values[0][2], node->values[1][2] };
+          (static_cast<ExactSolutionVector<Scalar>*>(this))->exact_values(np, x, y, values, dx, dy);
         }
+
+        if(exact_multiplicator != Scalar(1.0))
+          for (j = 0; j < this->num_components; j++)
+            for (int k = 0; k < 3; k++)
+              for (i = 0; i < np; i++)
+                node->values[j][k][i] *= exact_multiplicator;
       }
       else
       {
@@ -1210,12 +1543,122 @@ namespace Hermes
       if(this->nodes->present(order))
       {
         assert(this->nodes->get(order) == this->cur_node);
-        ::free(this->nodes->get(order));
+        this->delete_node(this->nodes->get(order));
       }
       this->nodes->add(node, order);
       this->cur_node = node;
     }
 
+    static const char H2D_BINARY_SOLUTION_MAGIC[8] = { 'H', '2', 'D', 'B', 'S', 'L', 'N', '\0' };
+    static const int H2D_BINARY_SOLUTION_VERSION = 1;
+
+    /// The fixed-size beginning of a binary solution file, followed by the monomial coefficients,
+    /// the element orders and the offsets of the components (see Solution::elem_coeffs).
+    struct SolutionBinaryHeader
+    {
+      char magic[8];
+      int version;
+      int byte_order; ///< H2D_BINARY_FILE_BYTE_ORDER as written by the saving machine.
+      int scalar_size; ///< sizeof(Scalar), to tell the real and complex solutions apart.
+      int space_type;
+      int num_components;
+      int num_elems;
+      int num_coeffs;
+      int padding;
+    };
+
+    template<typename Scalar>
+    void Solution<Scalar>::save_binary(const char* filename) const
+    {
+      if(sln_type != HERMES_SLN)
+        throw Exceptions::SolutionSaveFailureException("Only a solution from a coefficient vector can be saved in the binary format.");
+
+      FILE* f = fopen(filename, "wb");
+      if(f == NULL)
+        throw Exceptions::SolutionSaveFailureException("Could not open %s for writing.", filename);
+
+      try
+      {
+        SolutionBinaryHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, H2D_BINARY_SOLUTION_MAGIC, sizeof(H2D_BINARY_SOLUTION_MAGIC));
+        header.version = H2D_BINARY_SOLUTION_VERSION;
+        header.byte_order = H2D_BINARY_FILE_BYTE_ORDER;
+        header.scalar_size = sizeof(Scalar);
+        header.space_type = space_type;
+        header.num_components = this->num_components;
+        header.num_elems = num_elems;
+        header.num_coeffs = num_coeffs;
+
+        BinaryFile::write(f, &header, sizeof(header));
+        BinaryFile::write(f, mono_coeffs, sizeof(Scalar) * num_coeffs);
+        BinaryFile::write(f, elem_orders, sizeof(int) * num_elems);
+        for (int l = 0; l < this->num_components; l++)
+          BinaryFile::write(f, elem_coeffs[l], sizeof(int) * num_elems);
+      }
+      catch(Hermes::Exceptions::Exception& e)
+      {
+        fclose(f);
+        throw Exceptions::SolutionSaveFailureException("%s", e.what());
+      }
+      fclose(f);
+    }
+
+    template<typename Scalar>
+    void Solution<Scalar>::load_binary(const char* filename, Space<Scalar>* space)
+    {
+      if(space == NULL)
+        throw Exceptions::NullException(2);
+
+      free();
+      this->mesh = space->get_mesh();
+      this->space_type = space->get_type();
+
+      try
+      {
+        BinaryFile file(filename);
+        const SolutionBinaryHeader* header = (const SolutionBinaryHeader*)file.next_section(sizeof(SolutionBinaryHeader));
+        if(memcmp(header->magic, H2D_BINARY_SOLUTION_MAGIC, sizeof(H2D_BINARY_SOLUTION_MAGIC)))
+          throw Exceptions::Exception("File %s: not a binary Hermes2D solution file.", filename);
+        if(header->byte_order != H2D_BINARY_FILE_BYTE_ORDER)
+          throw Exceptions::Exception("File %s: the binary solution file was saved on a machine with a different byte order.", filename);
+        if(header->version != H2D_BINARY_SOLUTION_VERSION)
+          throw Exceptions::Exception("File %s: unsupported version %d of the binary solution file.", filename, header->version);
+        if(header->scalar_size != sizeof(Scalar))
+          throw Exceptions::Exception("Mismatched real - complex solutions in Solution::load_binary().");
+        if(header->space_type != this->space_type)
+          throw Exceptions::Exception("Space types not compliant in Solution::load_binary().");
+        if(header->num_elems != this->mesh->get_max_element_id())
+          throw Exceptions::Exception("The mesh of the space does not match the saved solution in Solution::load_binary().");
+        if(header->num_components < 1 || header->num_components > H2D_MAX_SOLUTION_COMPONENTS)
+          throw Exceptions::Exception("File %s: invalid number of components.", filename);
+
+        this->num_components = header->num_components;
+        num_elems = header->num_elems;
+        num_coeffs = header->num_coeffs;
+
+        mono_coeffs = new Scalar[num_coeffs];
+        memcpy(mono_coeffs, file.next_section(sizeof(Scalar) * num_coeffs), sizeof(Scalar) * num_coeffs);
+        elem_orders = new int[num_elems];
+        memcpy(elem_orders, file.next_section(sizeof(int) * num_elems), sizeof(int) * num_elems);
+        for (int l = 0; l < this->num_components; l++)
+        {
+          elem_coeffs[l] = new int[num_elems];
+          memcpy(elem_coeffs[l], file.next_section(sizeof(int) * num_elems), sizeof(int) * num_elems);
+        }
+      }
+      catch(Hermes::Exceptions::Exception& e)
+      {
+        free();
+        throw Exceptions::SolutionLoadFailureException("%s", e.what());
+      }
+
+      sln_type = HERMES_SLN;
+      init_dxdy_buffer();
+      update_memory_accounting();
+      this->element = NULL;
+    }
+
     template<>
     void Solution<double>::save(const char* filename) const
     {
@@ -1264,7 +1707,8 @@ namespace Hermes
 
         std::ofstream out(filename);
 
-        ::xml_schema::flags parsing_flags = ::xml_schema::flags::dont_pretty_print;
+        Hermes2DApi.initialize_xml();
+        ::xml_schema::flags parsing_flags = ::xml_schema::flags::dont_pretty_print | ::xml_schema::flags::dont_initialize;
 
         XMLSolution::solution_(out, xmlsolution, namespace_info_map, "UTF-8", parsing_flags);
         out.close();
@@ -1328,7 +1772,8 @@ namespace Hermes
 
         std::ofstream out(filename);
         
-        ::xml_schema::flags parsing_flags = ::xml_schema::flags::dont_pretty_print;
+        Hermes2DApi.initialize_xml();
+        ::xml_schema::flags parsing_flags = ::xml_schema::flags::dont_pretty_print | ::xml_schema::flags::dont_initialize;
 
         XMLSolution::solution_(out, xmlsolution, namespace_info_map, "UTF-8", parsing_flags);
         out.close();
@@ -1343,17 +1788,28 @@ namespace Hermes
     template<>
     void Solution<double>::load(const char* filename, Space<double>* space)
     {
+      if(BinaryFile::has_magic(filename, H2D_BINARY_SOLUTION_MAGIC))
+      {
+        load_binary(filename, space);
+        return;
+      }
+
       free();
       this->mesh = space->get_mesh();
       this->space_type = space->get_type();
 
 			try
       {
-        ::xml_schema::flags parsing_flags = 0;
-        if(!this->validate)
-          parsing_flags = xml_schema::flags::dont_validate;
-
-        std::auto_ptr<XMLSolution::solution> parsed_xml_solution(XMLSolution::solution_(filename, parsing_flags));
+        // Xerces is initialized by Hermes2DApi on the first use, for the whole process.
+        Hermes2DApi.initialize_xml();
+        std::auto_ptr<XMLSolution::solution> parsed_xml_solution;
+        if(this->validation_on())
+        {
+          ValidatedDocument document(filename);
+          parsed_xml_solution = XMLSolution::solution_(document.get(), xml_schema::flags::dont_initialize);
+        }
+        else
+          parsed_xml_solution = XMLSolution::solution_(filename, xml_schema::flags::dont_initialize | xml_schema::flags::dont_validate);
         sln_type = parsed_xml_solution->exact() == 0 ? HERMES_SLN : HERMES_EXACT;
   
         if(sln_type == HERMES_EXACT)
@@ -1430,6 +1886,7 @@ namespace Hermes
         
         }
           init_dxdy_buffer();
+          update_memory_accounting();
       }
       catch (const xml_schema::exception& e)
       {
@@ -1441,6 +1898,12 @@ namespace Hermes
     template<>
     void Solution<std::complex<double> >::load(const char* filename, Space<std::complex<double> >* space)
     {
+      if(BinaryFile::has_magic(filename, H2D_BINARY_SOLUTION_MAGIC))
+      {
+        load_binary(filename, space);
+        return;
+      }
+
       free();
       sln_type = HERMES_SLN;
       this->mesh = space->get_mesh();
@@ -1448,11 +1911,16 @@ namespace Hermes
       
       try
       {
-        ::xml_schema::flags parsing_flags = 0;
-        if(!this->validate)
-          parsing_flags = xml_schema::flags::dont_validate;
-
-        std::auto_ptr<XMLSolution::solution> parsed_xml_solution(XMLSolution::solution_(filename, parsing_flags));
+        // Xerces is initialized by Hermes2DApi on the first use, for the whole process.
+        Hermes2DApi.initialize_xml();
+        std::auto_ptr<XMLSolution::solution> parsed_xml_solution;
+        if(this->validation_on())
+        {
+          ValidatedDocument document(filename);
+          parsed_xml_solution = XMLSolution::solution_(document.get(), xml_schema::flags::dont_initialize);
+        }
+        else
+          parsed_xml_solution = XMLSolution::solution_(filename, xml_schema::flags::dont_initialize | xml_schema::flags::dont_validate);
         sln_type = parsed_xml_solution->exact() == 0 ? HERMES_SLN : HERMES_EXACT;
         
         if(sln_type == HERMES_EXACT)
@@ -1505,11 +1973,16 @@ namespace Hermes
             if(this->space_type != HERMES_HDIV_SPACE)
               throw Exceptions::Exception("Space types not compliant in Solution::load().");
 
-          ::xml_schema::flags parsing_flags = 0;
-          if(!this->validate)
-            parsing_flags = xml_schema::flags::dont_validate;
-
-          std::auto_ptr<XMLSolution::solution> parsed_xml_solution(XMLSolution::solution_(filename, parsing_flags));
+          // Xerces is initialized by Hermes2DApi on the first use, for the whole process.
+          Hermes2DApi.initialize_xml();
+          std::auto_ptr<XMLSolution::solution> parsed_xml_solution;
+          if(this->validation_on())
+          {
+            ValidatedDocument document(filename);
+            parsed_xml_solution = XMLSolution::solution_(document.get(), xml_schema::flags::dont_initialize);
+          }
+          else
+            parsed_xml_solution = XMLSolution::solution_(filename, xml_schema::flags::dont_initialize | xml_schema::flags::dont_validate);
 
           this->num_coeffs = parsed_xml_solution->nc();
           this->num_elems = parsed_xml_solution->nel();
@@ -1535,6 +2008,7 @@ namespace Hermes
         }
 
           init_dxdy_buffer();
+          update_memory_accounting();
       }
       catch (const xml_schema::exception& e)
       {
@@ -1804,7 +2278,336 @@ namespace Hermes
       }
     }
 
+    template<typename Scalar>
+    static Scalar* allocate_pt_values(int n)
+    {
+      Scalar* values = new Scalar[n];
+      memset(values, 0, n * sizeof(Scalar));
+      return values;
+    }
+
+    template<typename Scalar>
+    static void copy_pt_value(Scalar* target, Scalar* source, int i)
+    {
+      if(source != NULL)
+        target[i] = source[0];
+    }
+
+    template<typename Scalar>
+    Func<Scalar>* Solution<Scalar>::get_pt_values(const double* x, const double* y, int n, bool* found)
+    {
+      Func<Scalar>* toReturn = new Func<Scalar>(n, this->num_components);
+      if(this->num_components == 1)
+      {
+        toReturn->val = allocate_pt_values<Scalar>(n);
+        toReturn->dx = allocate_pt_values<Scalar>(n);
+        toReturn->dy = allocate_pt_values<Scalar>(n);
+#ifdef H2D_USE_SECOND_DERIVATIVES
+        toReturn->laplace = allocate_pt_values<Scalar>(n);
+#endif
+      }
+      else
+      {
+        toReturn->val0 = allocate_pt_values<Scalar>(n);
+        toReturn->val1 = allocate_pt_values<Scalar>(n);
+        toReturn->dx0 = allocate_pt_values<Scalar>(n);
+        toReturn->dx1 = allocate_pt_values<Scalar>(n);
+        toReturn->dy0 = allocate_pt_values<Scalar>(n);
+        toReturn->dy1 = allocate_pt_values<Scalar>(n);
+      }
+
+      Element* e = NULL;
+      for(int i = 0; i < n; i++)
+      {
+        if(found != NULL)
+          found[i] = false;
+
+        // Neighboring probes mostly lie in the same element.
+        if(sln_type == HERMES_SLN)
+        {
+          double xi1, xi2;
+          if(e == NULL || !RefMap::is_element_on_physical_coordinates(e, x[i], y[i], &xi1, &xi2))
+            e = RefMap::element_on_physical_coordinates(this->mesh, x[i], y[i]);
+          if(e == NULL)
+            continue;
+        }
+
+        Func<Scalar>* point = get_pt_value(x[i], y[i], e);
+        if(point == NULL)
+          continue;
+
+        if(this->num_components == 1)
+        {
+          copy_pt_value(toReturn->val, point->val, i);
+          copy_pt_value(toReturn->dx, point->dx, i);
+          copy_pt_value(toReturn->dy, point->dy, i);
+#ifdef H2D_USE_SECOND_DERIVATIVES
+          copy_pt_value(toReturn->laplace, point->laplace, i);
+#endif
+        }
+        else
+        {
+          copy_pt_value(toReturn->val0, point->val0, i);
+          copy_pt_value(toReturn->val1, point->val1, i);
+          copy_pt_value(toReturn->dx0, point->dx0, i);
+          copy_pt_value(toReturn->dx1, point->dx1, i);
+          copy_pt_value(toReturn->dy0, point->dy0, i);
+          copy_pt_value(toReturn->dy1, point->dy1, i);
+        }
+        point->free_fn();
+        delete point;
+
+        if(found != NULL)
+          found[i] = true;
+      }
+
+      return toReturn;
+    }
+
+    template<typename Scalar>
+    CompactSolution<Scalar>::CompactSolution() : Solution<Scalar>(), space(NULL), coeffs(NULL), pss(NULL)
+    {
+      free_compact();
+    }
+
+    template<typename Scalar>
+    CompactSolution<Scalar>::CompactSolution(const Space<Scalar>* space, const Scalar* coeff_vec, bool add_dir_lift, int start_index) : Solution<Scalar>(), space(NULL), coeffs(NULL), pss(NULL)
+    {
+      free_compact();
+      this->set_coeff_vector(space, coeff_vec, add_dir_lift, start_index);
+    }
+
+    template<typename Scalar>
+    CompactSolution<Scalar>::~CompactSolution()
+    {
+      free_compact();
+    }
+
+    template<typename Scalar>
+    bool CompactSolution<Scalar>::is_compact() const
+    {
+      return space != NULL;
+    }
+
+    template<typename Scalar>
+    void CompactSolution<Scalar>::free_compact()
+    {
+      if(coeffs != NULL)
+      {
+        delete [] coeffs;
+        coeffs = NULL;
+      }
+      if(pss != NULL)
+      {
+        delete pss;
+        pss = NULL;
+      }
+      space = NULL;
+      space_seq = -1;
+      add_dir_lift = true;
+      multiplicator = 1.0;
+      slot_size = 0;
+      for (int i = 0; i < H2D_COMPACT_SOLUTION_CACHE_SIZE; i++)
+        cached_elems[i] = -1;
+      next_slot = 0;
+    }
+
+    template<typename Scalar>
+    void CompactSolution<Scalar>::free()
+    {
+      free_compact();
+      Solution<Scalar>::free();
+    }
+
+    template<typename Scalar>
+    void CompactSolution<Scalar>::set_coeff_vector(const Space<Scalar>* space, PrecalcShapeset* pss,
+        const Scalar* coeff_vec, bool add_dir_lift, int start_index)
+    {
+      // Sanity checks.
+      if(space == NULL) throw Exceptions::NullException(1);
+      if(space->get_mesh() == NULL) throw Exceptions::Exception("Mesh == NULL in CompactSolution<Scalar>::set_coeff_vector().");
+      if(coeff_vec == NULL) throw Exceptions::NullException(3);
+      if(!space->is_up_to_date())
+        throw Exceptions::Exception("Provided 'space' is not up to date.");
+
+      init_compact(space, add_dir_lift);
+
+      // Copy the coefficients of the DOFs of the space.
+      for (int i = 0; i < space->get_num_dofs(); i++)
+        coeffs[i] = coeff_vec[i * space->stride + start_index];
+    }
+
+    template<typename Scalar>
+    void CompactSolution<Scalar>::init_compact(const Space<Scalar>* space, bool add_dir_lift)
+    {
+      this->free();
+
+      this->space = space;
+      this->space_seq = space->get_seq();
+      this->space_type = space->get_type();
+      this->add_dir_lift = add_dir_lift;
+      this->sln_type = HERMES_SLN;
+      this->mesh = space->get_mesh();
+      // The given pss may be temporary.
+      this->pss = new PrecalcShapeset(space->shapeset);
+      this->pss->set_quad_2d(&g_quad_2d_cheb);
+      this->num_components = this->pss->get_num_components();
+
+      coeffs = new Scalar[space->get_num_dofs()];
+
+      // Element orders, the monomial coefficients are calculated when needed.
+      this->num_elems = this->mesh->get_max_element_id();
+      this->elem_orders = new int[this->num_elems];
+      memset(this->elem_orders, 0, sizeof(int) * this->num_elems);
+      for (int l = 0; l < this->num_components; l++)
+      {
+        this->elem_coeffs[l] = new int[this->num_elems];
+        for (int i = 0; i < this->num_elems; i++)
+          this->elem_coeffs[l][i] = -1;
+      }
+
+      int max_np = 0;
+      Element* e;
+      for_all_active_elements(e, this->mesh)
+      {
+        int o = this->elem_orders[e->id] = Solution<Scalar>::calc_mono_order(space, e);
+        max_np = std::max(max_np, g_quad_2d_cheb.get_num_points(o, e->get_mode()));
+      }
+      slot_size = max_np * this->num_components;
+      this->num_coeffs = slot_size * H2D_COMPACT_SOLUTION_CACHE_SIZE;
+      this->mono_coeffs = new Scalar[this->num_coeffs];
+
+      this->init_dxdy_buffer();
+      this->update_memory_accounting();
+      this->element = NULL;
+    }
+
+    template<typename Scalar>
+    Scalar* CompactSolution<Scalar>::get_mono_coeffs(Element* e, int component)
+    {
+      if(space == NULL)
+        return Solution<Scalar>::get_mono_coeffs(e, component);
+
+      if(this->elem_coeffs[component][e->id] < 0)
+      {
+        if(space->get_seq() != space_seq)
+          throw Exceptions::Exception("The space of a CompactSolution has changed.");
+
+        // Replace the oldest element in the cache.
+        int slot = next_slot;
+        if(++next_slot >= H2D_COMPACT_SOLUTION_CACHE_SIZE)
+          next_slot = 0;
+        if(cached_elems[slot] >= 0)
+          for (int l = 0; l < this->num_components; l++)
+            this->elem_coeffs[l][cached_elems[slot]] = -1;
+        cached_elems[slot] = e->id;
+
+        int o = this->elem_orders[e->id];
+        int np = g_quad_2d_cheb.get_num_points(o, e->get_mode());
+        Scalar* mono = this->mono_coeffs + slot * slot_size;
+        this->calc_mono_coeffs(space, pss, coeffs, add_dir_lift, 0, space->stride, e, o, mono);
+        if(multiplicator != Scalar(1.0))
+          for (int i = 0; i < np * this->num_components; i++)
+            mono[i] *= multiplicator;
+
+        for (int l = 0; l < this->num_components; l++)
+          this->elem_coeffs[l][e->id] = slot * slot_size + l * np;
+      }
+
+      return this->mono_coeffs + this->elem_coeffs[component][e->id];
+    }
+
+    template<typename Scalar>
+    void CompactSolution<Scalar>::copy(const Solution<Scalar>* sln)
+    {
+      const CompactSolution<Scalar>* compact = dynamic_cast<const CompactSolution<Scalar>*>(sln);
+      if(compact == NULL || !compact->is_compact())
+      {
+        this->free();
+        Solution<Scalar>::copy(sln);
+        return;
+      }
+
+      init_compact(compact->space, compact->add_dir_lift);
+      memcpy(coeffs, compact->coeffs, sizeof(Scalar) * space->get_num_dofs());
+      space_seq = compact->space_seq;
+      multiplicator = compact->multiplicator;
+    }
+
+    template<typename Scalar>
+    MeshFunction<Scalar>* CompactSolution<Scalar>::clone() const
+    {
+      CompactSolution<Scalar>* sln = new CompactSolution<Scalar>();
+      sln->copy(this);
+      return sln;
+    }
+
+    template<typename Scalar>
+    void CompactSolution<Scalar>::multiply(Scalar coef)
+    {
+      if(space == NULL)
+      {
+        Solution<Scalar>::multiply(coef);
+        return;
+      }
+
+      multiplicator *= coef;
+      for (int slot = 0; slot < H2D_COMPACT_SOLUTION_CACHE_SIZE; slot++)
+        if(cached_elems[slot] >= 0)
+          for (int i = 0; i < slot_size; i++)
+            this->mono_coeffs[slot * slot_size + i] *= coef;
+    }
+
+    template<typename Scalar>
+    void CompactSolution<Scalar>::expand(Solution<Scalar>* target) const
+    {
+      if(space == NULL)
+      {
+        target->copy(this);
+        return;
+      }
+
+      // The coefficients are stored without the offset and the stride of the DOFs.
+      Scalar* coeff_vec = new Scalar[std::max((space->get_num_dofs() - 1) * space->stride + 1, 1)];
+      for (int i = 0; i < space->get_num_dofs(); i++)
+        coeff_vec[i * space->stride] = coeffs[i];
+      target->set_coeff_vector(space, coeff_vec, add_dir_lift, 0);
+      delete [] coeff_vec;
+      if(multiplicator != Scalar(1.0))
+        target->multiply(multiplicator);
+    }
+
+    template<typename Scalar>
+    void CompactSolution<Scalar>::save(const char* filename) const
+    {
+      if(space == NULL)
+      {
+        Solution<Scalar>::save(filename);
+        return;
+      }
+
+      Solution<Scalar> sln;
+      expand(&sln);
+      sln.save(filename);
+    }
+
+    template<typename Scalar>
+    void CompactSolution<Scalar>::save_binary(const char* filename) const
+    {
+      if(space == NULL)
+      {
+        Solution<Scalar>::save_binary(filename);
+        return;
+      }
+
+      Solution<Scalar> sln;
+      expand(&sln);
+      sln.save_binary(filename);
+    }
+
     template class HERMES_API Solution<double>;
     template class HERMES_API Solution<std::complex<double> >;
+    template class HERMES_API CompactSolution<double>;
+    template class HERMES_API CompactSolution<std::complex<double> >;
   }
 }
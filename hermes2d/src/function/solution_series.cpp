@@ -0,0 +1,228 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D. If not, see <http://www.gnu.org/licenses/>.
+
+#include "solution_series.h"
+#include "api2d.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    template<typename Scalar>
+    SolutionSeries<Scalar>::SolutionSeries(Space<Scalar>* space, unsigned int max_loaded) : space(space), max_loaded(max_loaded), num_loaded(0), use_counter(0)
+    {
+      if(space == NULL)
+        throw Exceptions::NullException(1);
+    }
+
+    template<typename Scalar>
+    SolutionSeries<Scalar>::~SolutionSeries()
+    {
+      release_all();
+    }
+
+    template<typename Scalar>
+    void SolutionSeries<Scalar>::add(const char* file_name, double time)
+    {
+      if(file_name == NULL)
+        throw Exceptions::NullException(1);
+      Entry entry;
+      entry.file_name = file_name;
+      entry.time = time;
+      entry.solution = NULL;
+      entry.last_use = 0;
+      entries.push_back(entry);
+    }
+
+    template<typename Scalar>
+    unsigned int SolutionSeries<Scalar>::size() const
+    {
+      return entries.size();
+    }
+
+    template<typename Scalar>
+    double SolutionSeries<Scalar>::get_time(unsigned int index) const
+    {
+      if(index >= entries.size())
+        throw Exceptions::ValueException("index", index, entries.size());
+      return entries[index].time;
+    }
+
+    template<typename Scalar>
+    const char* SolutionSeries<Scalar>::get_file_name(unsigned int index) const
+    {
+      if(index >= entries.size())
+        throw Exceptions::ValueException("index", index, entries.size());
+      return entries[index].file_name.c_str();
+    }
+
+    template<typename Scalar>
+    void SolutionSeries<Scalar>::load(unsigned int first, unsigned int count)
+    {
+      if(first >= entries.size())
+        return;
+      if(count == 0 || first + count > entries.size())
+        count = entries.size() - first;
+      if(max_loaded > 0 && count > max_loaded)
+        throw Exceptions::ValueException("count", count, max_loaded);
+
+      std::vector<unsigned int> to_load;
+      for(unsigned int i = first; i < first + count; i++)
+      {
+        if(entries[i].solution == NULL)
+          to_load.push_back(i);
+        else
+          entries[i].last_use = ++use_counter;
+      }
+      if(to_load.empty())
+        return;
+      make_room(first, count, to_load.size());
+
+      int num_to_load = to_load.size();
+      std::vector<Solution<Scalar>*> loaded(num_to_load, (Solution<Scalar>*)NULL);
+      Hermes::Exceptions::Exception* caughtException = NULL;
+      int num_threads_used = std::min(Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads), num_to_load);
+
+      // Every file into its own Solution, all of them only read the space and its mesh.
+      int load_i;
+#pragma omp parallel for schedule(dynamic) private(load_i) num_threads(num_threads_used)
+      for(load_i = 0; load_i < num_to_load; load_i++)
+      {
+        if(caughtException != NULL)
+          continue;
+
+        Solution<Scalar>* solution = new Solution<Scalar>();
+        try
+        {
+          solution->load(entries[to_load[load_i]].file_name.c_str(), space);
+          loaded[load_i] = solution;
+        }
+        catch(Hermes::Exceptions::Exception& e)
+        {
+          delete solution;
+#pragma omp critical (caughtException)
+          if(caughtException == NULL)
+            caughtException = e.clone();
+        }
+        catch(std::exception& e)
+        {
+          delete solution;
+#pragma omp critical (caughtException)
+          if(caughtException == NULL)
+            caughtException = new Hermes::Exceptions::Exception(e.what());
+        }
+      }
+
+      // The solutions loaded before an exception are kept.
+      for(int i = 0; i < num_to_load; i++)
+      {
+        if(loaded[i] == NULL)
+          continue;
+        entries[to_load[i]].solution = loaded[i];
+        entries[to_load[i]].last_use = ++use_counter;
+        num_loaded++;
+      }
+
+      if(caughtException != NULL)
+      {
+        Hermes::Exceptions::SolutionLoadFailureException exception("SolutionSeries::load(): %s", caughtException->what());
+        delete caughtException;
+        throw exception;
+      }
+      this->info("SolutionSeries: %d solutions loaded.", num_to_load);
+    }
+
+    template<typename Scalar>
+    Solution<Scalar>* SolutionSeries<Scalar>::get(unsigned int index)
+    {
+      if(index >= entries.size())
+        throw Exceptions::ValueException("index", index, entries.size());
+
+      if(entries[index].solution == NULL)
+      {
+        make_room(index, 1, 1);
+        Solution<Scalar>* solution = new Solution<Scalar>();
+        try
+        {
+          solution->load(entries[index].file_name.c_str(), space);
+        }
+        catch(...)
+        {
+          delete solution;
+          throw;
+        }
+        entries[index].solution = solution;
+        num_loaded++;
+      }
+
+      entries[index].last_use = ++use_counter;
+      return entries[index].solution;
+    }
+
+    template<typename Scalar>
+    bool SolutionSeries<Scalar>::is_loaded(unsigned int index) const
+    {
+      return index < entries.size() && entries[index].solution != NULL;
+    }
+
+    template<typename Scalar>
+    void SolutionSeries<Scalar>::release(unsigned int index)
+    {
+      if(index >= entries.size() || entries[index].solution == NULL)
+        return;
+      delete entries[index].solution;
+      entries[index].solution = NULL;
+      num_loaded--;
+    }
+
+    template<typename Scalar>
+    void SolutionSeries<Scalar>::release_all()
+    {
+      for(unsigned int i = 0; i < entries.size(); i++)
+        release(i);
+    }
+
+    template<typename Scalar>
+    unsigned int SolutionSeries<Scalar>::get_num_loaded() const
+    {
+      return num_loaded;
+    }
+
+    template<typename Scalar>
+    void SolutionSeries<Scalar>::make_room(unsigned int first, unsigned int count, unsigned int num_to_load)
+    {
+      if(max_loaded == 0)
+        return;
+
+      while(num_loaded > 0 && num_loaded + num_to_load > max_loaded)
+      {
+        int oldest = -1;
+        for(unsigned int i = 0; i < entries.size(); i++)
+        {
+          if(entries[i].solution == NULL || (i >= first && i < first + count))
+            continue;
+          if(oldest == -1 || entries[i].last_use < entries[oldest].last_use)
+            oldest = i;
+        }
+        if(oldest == -1)
+          break;
+        release(oldest);
+      }
+    }
+
+    template class HERMES_API SolutionSeries<double>;
+    template class HERMES_API SolutionSeries<std::complex<double> >;
+  }
+}
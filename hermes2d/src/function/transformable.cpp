@@ -47,6 +47,74 @@ namespace Hermes
       { H2D_IDENTIFY_TRF }              // identity
     };
 
+    /// The table of the composite transforms, filled at startup from tri_trf and quad_trf.
+    class Transformable::TrfCache
+    {
+    public:
+      TrfCache()
+      {
+        for(int mode = 0; mode < H2D_NUM_MODES; mode++)
+        {
+          Trf* table = trfs[mode];
+          Trf* base = (mode == HERMES_MODE_TRIANGLE) ? tri_trf : quad_trf;
+          table[0].m[0] = table[0].m[1] = 1.0;
+          table[0].t[0] = table[0].t[1] = 0.0;
+          // The parent of idx is (idx - 1) >> 3, always smaller than idx.
+          for(unsigned int idx = 1; idx < H2D_TRF_CACHE_SIZE; idx++)
+          {
+            Trf* parent = table + ((idx - 1) >> 3);
+            Trf* tr = base + ((idx - 1) & 7);
+            table[idx].m[0] = parent->m[0] * tr->m[0];
+            table[idx].m[1] = parent->m[1] * tr->m[1];
+            table[idx].t[0] = parent->m[0] * tr->t[0] + parent->t[0];
+            table[idx].t[1] = parent->m[1] * tr->t[1] + parent->t[1];
+          }
+        }
+      }
+
+      Trf trfs[H2D_NUM_MODES][H2D_TRF_CACHE_SIZE];
+    };
+
+    Transformable::TrfCache Transformable::trf_cache;
+
+    void Transformable::get_composite_transform(ElementMode2D mode, uint64_t idx, Trf& trf)
+    {
+      const Trf* table = trf_cache.trfs[mode];
+      if(idx < H2D_TRF_CACHE_SIZE)
+      {
+        trf = table[idx];
+        return;
+      }
+
+      int son[25];
+      int i = 0;
+      while (idx > 0)
+      {
+        son[i++] = (idx - 1) & 7;
+        idx = (idx - 1) >> 3;
+      }
+
+      // The topmost i % H2D_TRF_CACHE_LEVELS levels, then the rest by H2D_TRF_CACHE_LEVELS levels.
+      trf.m[0] = trf.m[1] = 1.0;
+      trf.t[0] = trf.t[1] = 0.0;
+      int k = i - 1;
+      int chunk = i % H2D_TRF_CACHE_LEVELS;
+      if(chunk == 0)
+        chunk = H2D_TRF_CACHE_LEVELS;
+      while (k >= 0)
+      {
+        unsigned int chunk_idx = 0;
+        for (int l = 0; l < chunk; l++, k--)
+          chunk_idx = (chunk_idx << 3) + son[k] + 1;
+        const Trf* tr = table + chunk_idx;
+        trf.t[0] += trf.m[0] * tr->t[0];
+        trf.t[1] += trf.m[1] * tr->t[1];
+        trf.m[0] *= tr->m[0];
+        trf.m[1] *= tr->m[1];
+        chunk = H2D_TRF_CACHE_LEVELS;
+      }
+    }
+
     Transformable::Transformable()
     {
       memset(stack, 0, sizeof(stack));
@@ -63,6 +131,10 @@ namespace Hermes
       assert(top > 0);
       ctm = stack + (--top);
       sub_idx = (sub_idx - 1) >> 3;
+      if(top > valid_top)
+        get_composite_transform(element->get_mode(), sub_idx, *ctm);
+      else
+        valid_top = top;
     }
 
     uint64_t Transformable::get_transform() const { return sub_idx; }
@@ -72,7 +144,7 @@ namespace Hermes
       stack[0].m[0] = stack[0].m[1] = 1.0;
       stack[0].t[0] = stack[0].t[1] = 0.0;
       ctm = stack;
-      sub_idx = top = 0;
+      sub_idx = top = valid_top = 0;
     }
 
     void Transformable::set_active_element(Element* e)
@@ -83,6 +155,22 @@ namespace Hermes
     }
 
     void Transformable::set_transform(uint64_t idx)
+    {
+      assert(element != NULL);
+      unsigned int depth = 0;
+      for (uint64_t i = idx; i > 0; i = (i - 1) >> 3)
+        depth++;
+      if(depth > H2D_MAX_TRN_LEVEL)
+        throw Hermes::Exceptions::Exception("Too deep transform.");
+
+      top = depth;
+      valid_top = 0;
+      ctm = stack + top;
+      get_composite_transform(element->get_mode(), idx, *ctm);
+      sub_idx = idx;
+    }
+
+    void Transformable::replay_transform(uint64_t idx)
     {
       int son[25];
       int i = 0;
@@ -102,6 +190,8 @@ namespace Hermes
       if(top >= H2D_MAX_TRN_LEVEL)
         throw Hermes::Exceptions::Exception("Too deep transform.");
 
+      if(valid_top == top)
+        valid_top++;
       Trf* mat = stack + (++top);
       Trf* tr = (element->is_triangle() ? tri_trf + son : quad_trf + son);
 
@@ -23,6 +23,7 @@
 #include "quadrature/limit_order.h"
 #include "integrals/h1.h"
 #include "discrete_problem.h"
+#include "api2d.h"
 
 namespace Hermes
 {
@@ -49,112 +50,89 @@ namespace Hermes
       if(sln1 == NULL) throw Hermes::Exceptions::Exception("sln1 is NULL in calc_abs_error().");
       if(sln2 == NULL) throw Hermes::Exceptions::Exception("sln2 is NULL in calc_abs_error().");
 
-      Quad2D* quad = &g_quad_2d_std;
-      sln1->set_quad_2d(quad);
-      sln2->set_quad_2d(quad);
+      Hermes::vector<MeshFunction<Scalar>*> slns1, slns2;
+      Hermes::vector<int> norm_types;
+      slns1.push_back(sln1);
+      slns2.push_back(sln2);
+      norm_types.push_back(norm_type);
 
-      const Mesh* meshes[2] = { sln1->get_mesh(), sln2->get_mesh() };
-      Transformable* tr[2] = { sln1, sln2 };
-      Traverse trav(true);
-      trav.begin(2, meshes, tr);
-
-      double error = 0.0;
-      Traverse::State* ee;
-      while ((ee = trav.get_next_state()) != NULL)
-      {
-        update_limit_table(ee->e[0]->get_mode());
-
-        RefMap* ru = sln1->get_refmap();
-        RefMap* rv = sln2->get_refmap();
-        switch (norm_type)
-        {
-        case HERMES_L2_NORM:
-          error += error_fn_l2(sln1, sln2, ru, rv);
-          break;
-        case HERMES_H1_NORM:
-          error += error_fn_h1(sln1, sln2, ru, rv);
-          break;
-        case HERMES_HCURL_NORM:
-          error += error_fn_hc(sln1, sln2, ru, rv);
-          break;
-        case HERMES_HDIV_NORM:
-          error += error_fn_hdiv(sln1, sln2, ru, rv);
-          break;
-        default: throw Hermes::Exceptions::Exception("Unknown norm in calc_error().");
-        }
-      }
-      trav.finish();
-      return sqrt(error);
+      double error;
+      calc_norms_and_errors(slns1, slns2, norm_types, &error);
+      return error;
     }
 
     template<typename Scalar>
     double Global<Scalar>::calc_rel_error(MeshFunction<Scalar>* sln, MeshFunction<Scalar>* ref_sln, int norm_type)
     {
-      double error = calc_abs_error(sln, ref_sln, norm_type);
-      double norm = calc_norm(ref_sln, norm_type);
-
-      return error/norm;
+      if(sln == NULL) throw Hermes::Exceptions::Exception("sln1 is NULL in calc_rel_error().");
+      if(ref_sln == NULL) throw Hermes::Exceptions::Exception("sln2 is NULL in calc_rel_error().");
+
+      // The error and the norm in one traversal.
+      Hermes::vector<MeshFunction<Scalar>*> slns1, slns2;
+      Hermes::vector<int> norm_types;
+      slns1.push_back(sln);
+      slns2.push_back(ref_sln);
+      norm_types.push_back(norm_type);
+      slns1.push_back(ref_sln);
+      slns2.push_back(NULL);
+      norm_types.push_back(norm_type);
+
+      double results[2];
+      calc_norms_and_errors(slns1, slns2, norm_types, results);
+
+      return results[0] / results[1];
     }
 
     template<typename Scalar>
     double Global<Scalar>::calc_norm(MeshFunction<Scalar>* sln, int norm_type)
     {
-      Quad2D* quad = &g_quad_2d_std;
-      sln->set_quad_2d(quad);
-
-      double norm = 0.0;
-      Element* e;
-      const Mesh* mesh = sln->get_mesh();
+      Hermes::vector<MeshFunction<Scalar>*> slns1, slns2;
+      Hermes::vector<int> norm_types;
+      slns1.push_back(sln);
+      slns2.push_back(NULL);
+      norm_types.push_back(norm_type);
+
+      double norm;
+      calc_norms_and_errors(slns1, slns2, norm_types, &norm);
+      return norm;
+    }
 
-      for_all_active_elements(e, mesh)
+    template<typename Scalar>
+    int Global<Scalar>::get_space_norm_type(Solution<Scalar>* sln)
+    {
+      switch (sln->get_space_type())
       {
-        // set maximum integration order for use in integrals, see limit_order()
-        update_limit_table(e->get_mode());
-
-        sln->set_active_element(e);
-        RefMap* ru = sln->get_refmap();
-
-        switch (norm_type)
-        {
-        case HERMES_L2_NORM:
-          norm += norm_fn_l2(sln, ru);
-          break;
-        case HERMES_H1_NORM:
-          norm += norm_fn_h1(sln, ru);
-          break;
-        case HERMES_HCURL_NORM:
-          norm += norm_fn_hc(sln, ru);
-          break;
-        case HERMES_HDIV_NORM:
-          norm += norm_fn_hdiv(sln, ru);
-          break;
-        default: throw Hermes::Exceptions::Exception("Unknown norm in calc_norm().");
-        }
+      case HERMES_H1_SPACE: return HERMES_H1_NORM;
+      case HERMES_HCURL_SPACE: return HERMES_HCURL_NORM;
+      case HERMES_HDIV_SPACE: return HERMES_HDIV_NORM;
+      case HERMES_L2_SPACE: return HERMES_L2_NORM;
+      default: throw Hermes::Exceptions::Exception("Internal in calc_norms(): unknown space type.");
       }
-      return sqrt(norm);
+      return HERMES_UNSET_NORM;
     }
 
     template<typename Scalar>
     double Global<Scalar>::calc_norms(Hermes::vector<Solution<Scalar>*> slns)
     {
       // Calculate norms for all solutions.
-      Hermes::vector<double> norms;
       int n = slns.size();
-      for (int i = 0; i<n; i++)
+      Hermes::vector<MeshFunction<Scalar>*> fns;
+      Hermes::vector<MeshFunction<Scalar>*> no_fns;
+      Hermes::vector<int> norm_types;
+      for (int i = 0; i < n; i++)
       {
-        switch (slns[i]->get_space_type())
-        {
-        case HERMES_H1_SPACE: norms.push_back(calc_norm(slns[i], HERMES_H1_NORM)); break;
-        case HERMES_HCURL_SPACE: norms.push_back(calc_norm(slns[i], HERMES_HCURL_NORM)); break;
-        case HERMES_HDIV_SPACE: norms.push_back(calc_norm(slns[i], HERMES_HDIV_NORM)); break;
-        case HERMES_L2_SPACE: norms.push_back(calc_norm(slns[i], HERMES_L2_NORM)); break;
-        default: throw Hermes::Exceptions::Exception("Internal in calc_norms(): unknown space type.");
-        }
+        fns.push_back(slns[i]);
+        no_fns.push_back(NULL);
+        norm_types.push_back(get_space_norm_type(slns[i]));
       }
+      double* norms = new double[n];
+      calc_norms_and_errors(fns, no_fns, norm_types, norms);
+
       // Calculate the resulting norm.
       double result = 0;
       for (int i = 0; i < n; i++)
         result += norms[i] * norms[i];
+      delete [] norms;
       return sqrt(result);
     }
 
@@ -162,30 +140,294 @@ namespace Hermes
     double Global<Scalar>::calc_abs_errors(Hermes::vector<Solution<Scalar>*> slns1, Hermes::vector<Solution<Scalar>*> slns2)
     {
       // Calculate errors for all solutions.
-      Hermes::vector<double> errors;
       int n = slns1.size();
+      if(slns2.size() != n)
+        throw Exceptions::LengthException(2, slns2.size(), n);
+      Hermes::vector<MeshFunction<Scalar>*> fns1;
+      Hermes::vector<MeshFunction<Scalar>*> fns2;
+      Hermes::vector<int> norm_types;
       for (int i = 0; i < n; i++)
       {
-        switch (slns1[i]->get_space_type())
-        {
-        case HERMES_H1_SPACE: errors.push_back(calc_abs_error(slns1[i], slns2[i], HERMES_H1_NORM)); break;
-        case HERMES_HCURL_SPACE: errors.push_back(calc_abs_error(slns1[i], slns2[i], HERMES_HCURL_NORM)); break;
-        case HERMES_HDIV_SPACE: errors.push_back(calc_abs_error(slns1[i], slns2[i], HERMES_HDIV_NORM)); break;
-        case HERMES_L2_SPACE: errors.push_back(calc_abs_error(slns1[i], slns2[i], HERMES_L2_NORM)); break;
-        default: throw Hermes::Exceptions::Exception("Internal in calc_norms(): unknown space type.");
-        }
+        fns1.push_back(slns1[i]);
+        fns2.push_back(slns2[i]);
+        norm_types.push_back(get_space_norm_type(slns1[i]));
       }
+      double* errors = new double[n];
+      calc_norms_and_errors(fns1, fns2, norm_types, errors);
+
       // Calculate the resulting error.
       double result = 0;
       for (int i = 0; i < n; i++)
         result += errors[i] * errors[i];
+      delete [] errors;
       return sqrt(result);
     }
 
     template<typename Scalar>
     double Global<Scalar>::calc_rel_errors(Hermes::vector<Solution<Scalar>*> slns1, Hermes::vector<Solution<Scalar>*> slns2)
     {
-      return calc_abs_errors(slns1, slns2) / calc_norms(slns2);
+      // The errors and the norms of slns2 in one traversal.
+      int n = slns1.size();
+      if(slns2.size() != n)
+        throw Exceptions::LengthException(2, slns2.size(), n);
+      Hermes::vector<MeshFunction<Scalar>*> fns1;
+      Hermes::vector<MeshFunction<Scalar>*> fns2;
+      Hermes::vector<int> norm_types;
+      for (int i = 0; i < n; i++)
+      {
+        fns1.push_back(slns1[i]);
+        fns2.push_back(slns2[i]);
+        norm_types.push_back(get_space_norm_type(slns1[i]));
+      }
+      for (int i = 0; i < n; i++)
+      {
+        fns1.push_back(slns2[i]);
+        fns2.push_back(NULL);
+        norm_types.push_back(get_space_norm_type(slns2[i]));
+      }
+      double* results = new double[2 * n];
+      calc_norms_and_errors(fns1, fns2, norm_types, results);
+
+      double error = 0, norm = 0;
+      for (int i = 0; i < n; i++)
+      {
+        error += results[i] * results[i];
+        norm += results[n + i] * results[n + i];
+      }
+      delete [] results;
+      return sqrt(error) / sqrt(norm);
+    }
+
+    template<typename Scalar>
+    double Global<Scalar>::calc_state_norm_or_error(int norm_type, MeshFunction<Scalar>* sln1, MeshFunction<Scalar>* sln2)
+    {
+      RefMap* ru = sln1->get_refmap();
+      if(sln2 == NULL)
+      {
+        switch (norm_type)
+        {
+        case HERMES_L2_NORM:
+          return norm_fn_l2(sln1, ru);
+        case HERMES_H1_NORM:
+          return norm_fn_h1(sln1, ru);
+        case HERMES_HCURL_NORM:
+          return norm_fn_hc(sln1, ru);
+        case HERMES_HDIV_NORM:
+          return norm_fn_hdiv(sln1, ru);
+        default: throw Hermes::Exceptions::Exception("Unknown norm in calc_norm().");
+        }
+      }
+
+      RefMap* rv = sln2->get_refmap();
+      switch (norm_type)
+      {
+      case HERMES_L2_NORM:
+        return error_fn_l2(sln1, sln2, ru, rv);
+      case HERMES_H1_NORM:
+        return error_fn_h1(sln1, sln2, ru, rv);
+      case HERMES_HCURL_NORM:
+        return error_fn_hc(sln1, sln2, ru, rv);
+      case HERMES_HDIV_NORM:
+        return error_fn_hdiv(sln1, sln2, ru, rv);
+      default: throw Hermes::Exceptions::Exception("Unknown norm in calc_error().");
+      }
+      return 0.0;
+    }
+
+#define CHUNKSIZE 1
+    template<typename Scalar>
+    void Global<Scalar>::calc_norms_and_errors(Hermes::vector<MeshFunction<Scalar>*> slns1, Hermes::vector<MeshFunction<Scalar>*> slns2,
+      Hermes::vector<int> norm_types, double* results, int rank, int num_ranks)
+    {
+      int num_requests = slns1.size();
+
+      // Sanity checks.
+      if(slns2.size() != num_requests)
+        throw Exceptions::LengthException(2, slns2.size(), num_requests);
+      if(norm_types.size() != num_requests)
+        throw Exceptions::LengthException(3, norm_types.size(), num_requests);
+      if(results == NULL)
+        throw Exceptions::NullException(4);
+      if(num_ranks < 1)
+        throw Exceptions::ValueException("num_ranks", num_ranks, 1);
+      if(rank < 0 || rank >= num_ranks)
+        throw Exceptions::ValueException("rank", rank, 0, num_ranks - 1);
+      if(num_requests == 0)
+        return;
+
+      // Every function once, with its own mesh in the traversal.
+      Hermes::vector<MeshFunction<Scalar>*> fns;
+      int* fn_indices = new int[2 * num_requests];
+      for (int i = 0; i < 2 * num_requests; i++)
+      {
+        MeshFunction<Scalar>* fn = (i < num_requests) ? slns1[i] : slns2[i - num_requests];
+        if(fn == NULL)
+        {
+          if(i < num_requests)
+          {
+            delete [] fn_indices;
+            throw Exceptions::NullException(1, i);
+          }
+          fn_indices[i] = -1;
+          continue;
+        }
+        fn_indices[i] = -1;
+        for (unsigned int j = 0; j < fns.size(); j++)
+          if(fns[j] == fn)
+            fn_indices[i] = j;
+        if(fn_indices[i] == -1)
+        {
+          fn_indices[i] = fns.size();
+          fns.push_back(fn);
+        }
+      }
+      int num_fns = fns.size();
+
+      const Mesh** meshes = new const Mesh*[num_fns];
+      for (int i = 0; i < num_fns; i++)
+      {
+        fns[i]->set_quad_2d(&g_quad_2d_std);
+        meshes[i] = fns[i]->get_mesh();
+      }
+
+      TraverseStateList traverse_states;
+      traverse_states.update(meshes, num_fns);
+      int num_states = traverse_states.get_num_states();
+      Traverse::State** states = traverse_states.get_states();
+
+      // The part of the mesh of the first function evaluated by this process.
+      int* parts = NULL;
+      if(num_ranks > 1)
+      {
+        parts = new int[meshes[0]->get_max_element_id()];
+        meshes[0]->partition(num_ranks, parts);
+      }
+
+      // Per-thread copies of the functions, the first thread uses the original ones.
+      int num_threads_used = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
+      MeshFunction<Scalar>*** thread_fns = new MeshFunction<Scalar>**[num_threads_used];
+      Transformable*** trfs = new Transformable**[num_threads_used];
+      thread_fns[0] = new MeshFunction<Scalar>*[num_fns];
+      trfs[0] = new Transformable*[num_fns];
+      for (int i = 0; i < num_fns; i++)
+      {
+        thread_fns[0][i] = fns[i];
+        trfs[0][i] = fns[i];
+      }
+      int num_threads_cloned = 1;
+      try
+      {
+        for(; num_threads_cloned < num_threads_used; num_threads_cloned++)
+        {
+          thread_fns[num_threads_cloned] = new MeshFunction<Scalar>*[num_fns];
+          memset(thread_fns[num_threads_cloned], 0, num_fns * sizeof(MeshFunction<Scalar>*));
+          trfs[num_threads_cloned] = new Transformable*[num_fns];
+          for (int i = 0; i < num_fns; i++)
+          {
+            thread_fns[num_threads_cloned][i] = fns[i]->clone();
+            thread_fns[num_threads_cloned][i]->set_quad_2d(&g_quad_2d_std);
+            trfs[num_threads_cloned][i] = thread_fns[num_threads_cloned][i];
+          }
+        }
+      }
+      catch(Hermes::Exceptions::Exception&)
+      {
+        // E.g. exact solutions not overriding clone(), evaluate on a single thread.
+        for(int thread_i = 1; thread_i <= num_threads_cloned && thread_i < num_threads_used; thread_i++)
+        {
+          for (int i = 0; i < num_fns; i++)
+            delete thread_fns[thread_i][i];
+          delete [] thread_fns[thread_i];
+          delete [] trfs[thread_i];
+        }
+        num_threads_cloned = 1;
+      }
+      num_threads_used = num_threads_cloned;
+
+      // Contributions of all the states, summed up afterwards in the order of the states.
+      double* state_values = new double[std::max(num_states, 1) * num_requests];
+
+      Hermes::Exceptions::Exception* caughtException = NULL;
+
+      int state_i;
+#pragma omp parallel shared(states, thread_fns, trfs, state_values, fn_indices) private(state_i) num_threads(num_threads_used)
+      {
+#pragma omp for schedule(dynamic, CHUNKSIZE)
+        for(state_i = 0; state_i < num_states; state_i++)
+        {
+          if(caughtException != NULL)
+            continue;
+          if(parts != NULL && (states[state_i]->e[0] == NULL || parts[states[state_i]->e[0]->id] != rank))
+          {
+            for (int request_i = 0; request_i < num_requests; request_i++)
+              state_values[state_i * num_requests + request_i] = 0.0;
+            continue;
+          }
+          try
+          {
+            MeshFunction<Scalar>** current_fns = thread_fns[omp_get_thread_num()];
+            TraverseStateList::set_active_state(states[state_i], trfs[omp_get_thread_num()]);
+            for (int request_i = 0; request_i < num_requests; request_i++)
+            {
+              int fn_1 = fn_indices[request_i];
+              int fn_2 = fn_indices[num_requests + request_i];
+              double value = 0.0;
+              if(states[state_i]->e[fn_1] != NULL && (fn_2 == -1 || states[state_i]->e[fn_2] != NULL))
+                value = calc_state_norm_or_error(norm_types[request_i], current_fns[fn_1], fn_2 == -1 ? NULL : current_fns[fn_2]);
+              state_values[state_i * num_requests + request_i] = value;
+            }
+          }
+          catch(Hermes::Exceptions::Exception& e)
+          {
+#pragma omp critical (caughtException)
+            if(caughtException == NULL)
+              caughtException = e.clone();
+          }
+          catch(std::exception& e)
+          {
+#pragma omp critical (caughtException)
+            if(caughtException == NULL)
+              caughtException = new Hermes::Exceptions::Exception(e.what());
+          }
+        }
+      }
+
+      for(int thread_i = 1; thread_i < num_threads_used; thread_i++)
+      {
+        for (int i = 0; i < num_fns; i++)
+          delete thread_fns[thread_i][i];
+        delete [] thread_fns[thread_i];
+        delete [] trfs[thread_i];
+      }
+      delete [] thread_fns[0];
+      delete [] trfs[0];
+      delete [] thread_fns;
+      delete [] trfs;
+      delete [] meshes;
+      delete [] fn_indices;
+      delete [] parts;
+
+      if(caughtException != NULL)
+      {
+        delete [] state_values;
+        Hermes::Exceptions::Exception exception(*caughtException);
+        delete caughtException;
+        throw exception;
+      }
+
+      for (int request_i = 0; request_i < num_requests; request_i++)
+      {
+        double value = 0.0;
+        for(state_i = 0; state_i < num_states; state_i++)
+          value += state_values[state_i * num_requests + request_i];
+        results[request_i] = value;
+      }
+      delete [] state_values;
+
+      if(num_ranks > 1)
+        Hermes::Algebra::sum_values_over_processes<double>(results, num_requests);
+      for (int request_i = 0; request_i < num_requests; request_i++)
+        results[request_i] = sqrt(results[request_i]);
     }
 
     template<typename Scalar>
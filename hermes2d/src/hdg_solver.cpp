@@ -0,0 +1,434 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+#include "hdg_solver.h"
+#include "forms.h"
+#include "api2d.h"
+#include "quadrature/limit_order.h"
+
+using namespace Hermes::Algebra::DenseMatrixOperations;
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    template<typename Scalar>
+    HDGSolver<Scalar>::HDGSolver(const L2Space<Scalar>* space) : space(space), trace_space(space),
+      epsilon(1.0), b_x(0.0), b_y(0.0), source(NULL), penalty(10.0), sln_vector(NULL), trace_vector(NULL)
+    {
+      this->matrix = create_matrix<Scalar>();
+      this->rhs = create_vector<Scalar>();
+      this->matrix_solver = create_linear_solver<Scalar>(this->matrix, this->rhs);
+    }
+
+    template<typename Scalar>
+    HDGSolver<Scalar>::~HDGSolver()
+    {
+      free_local_systems();
+      delete matrix_solver;
+      delete matrix;
+      delete rhs;
+      delete [] sln_vector;
+      delete [] trace_vector;
+    }
+
+    template<typename Scalar>
+    void HDGSolver<Scalar>::free_local_systems()
+    {
+      for(unsigned int i = 0; i < local_systems.size(); i++)
+      {
+        delete [] local_systems[i].coupling;
+        delete [] local_systems[i].lift;
+      }
+      local_systems.clear();
+    }
+
+    template<typename Scalar>
+    void HDGSolver<Scalar>::set_diffusivity(double epsilon)
+    {
+      if(epsilon < 0.0)
+        throw Exceptions::ValueException("epsilon", epsilon, 0.0);
+      this->epsilon = epsilon;
+    }
+
+    template<typename Scalar>
+    void HDGSolver<Scalar>::set_advection(double b_x, double b_y)
+    {
+      this->b_x = b_x;
+      this->b_y = b_y;
+    }
+
+    template<typename Scalar>
+    void HDGSolver<Scalar>::set_source(Hermes2DFunction<Scalar>* source)
+    {
+      this->source = source;
+    }
+
+    template<typename Scalar>
+    void HDGSolver<Scalar>::set_penalty(double penalty)
+    {
+      if(penalty <= 0.0)
+        throw Exceptions::ValueException("penalty", penalty, 0.0);
+      this->penalty = penalty;
+    }
+
+    template<typename Scalar>
+    EdgeTraceSpace<Scalar>* HDGSolver<Scalar>::get_trace_space()
+    {
+      return &trace_space;
+    }
+
+    template<typename Scalar>
+    Scalar* HDGSolver<Scalar>::get_sln_vector()
+    {
+      return sln_vector;
+    }
+
+    template<typename Scalar>
+    Scalar* HDGSolver<Scalar>::get_trace_vector()
+    {
+      return trace_vector;
+    }
+
+    template<typename Scalar>
+    SparseMatrix<Scalar>* HDGSolver<Scalar>::get_matrix()
+    {
+      return matrix;
+    }
+
+    template<typename Scalar>
+    Vector<Scalar>* HDGSolver<Scalar>::get_rhs()
+    {
+      return rhs;
+    }
+
+    template<typename Scalar>
+    void HDGSolver<Scalar>::solve()
+    {
+      this->tick();
+
+      int num_trace_dofs = trace_space.assign_dofs();
+      std::vector<Element*> elements;
+      space->get_mesh()->get_active_elements(elements);
+      int num_elements = elements.size();
+
+      // The traces of the elements.
+      free_local_systems();
+      local_systems.resize(num_elements);
+      for(int i = 0; i < num_elements; i++)
+      {
+        Element* e = elements[i];
+        LocalSystem& local = local_systems[i];
+        local.coupling = NULL;
+        local.lift = NULL;
+        for(unsigned int edge = 0; edge < e->get_nvert(); edge++)
+        {
+          int edge_id = e->en[edge]->id;
+          int first_dof = trace_space.get_edge_first_dof(edge_id);
+          const Scalar* essential_values = trace_space.get_essential_values(edge_id);
+          for(int k = 0; k <= trace_space.get_edge_order(edge_id); k++)
+          {
+            local.trace_dofs.push_back(first_dof >= 0 ? first_dof + k : -1);
+            local.trace_values.push_back(essential_values == NULL ? 0.0 : essential_values[k]);
+          }
+        }
+      }
+
+      // The traces of an element are all coupled.
+      matrix->prealloc(num_trace_dofs);
+      int prealloc_passes = matrix->get_prealloc_passes();
+      if(prealloc_passes > 1)
+        matrix->prealloc_counting();
+      for(int pass = 0; pass < prealloc_passes; pass++)
+      {
+        for(int i = 0; i < num_elements; i++)
+        {
+          std::vector<int>& trace_dofs = local_systems[i].trace_dofs;
+          for(unsigned int k = 0; k < trace_dofs.size(); k++)
+            if(trace_dofs[k] >= 0)
+              for(unsigned int l = 0; l < trace_dofs.size(); l++)
+                if(trace_dofs[l] >= 0)
+                  matrix->pre_add_ij(trace_dofs[k], trace_dofs[l]);
+        }
+        if(pass == 0 && prealloc_passes > 1)
+          matrix->prealloc_indices();
+      }
+      matrix->alloc();
+      matrix->zero();
+      rhs->alloc(num_trace_dofs);
+
+      // The local systems and their Schur complements.
+      int num_threads = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
+      assembling_status.reset();
+#pragma omp parallel num_threads(num_threads)
+      {
+        PrecalcShapeset pss(space->get_shapeset());
+        RefMap refmap;
+#pragma omp for schedule(dynamic, 16)
+        for(int i = 0; i < num_elements; i++)
+        {
+          if(assembling_status.has_failed())
+            continue;
+          try
+          {
+            assemble_element(elements[i], local_systems[i], &pss, &refmap);
+          }
+          catch(Hermes::Exceptions::Exception& e)
+          {
+            assembling_status.fail(e);
+          }
+          catch(std::exception& e)
+          {
+            assembling_status.fail(e);
+          }
+        }
+      }
+      assembling_status.rethrow();
+
+      // The traces.
+      delete [] trace_vector;
+      trace_vector = new Scalar[num_trace_dofs + 1];
+      if(num_trace_dofs > 0)
+      {
+        if(!matrix_solver->solve())
+          throw Exceptions::LinearMatrixSolverException("HDGSolver: the system of the traces could not be solved.");
+        memcpy(trace_vector, matrix_solver->get_sln_vector(), num_trace_dofs * sizeof(Scalar));
+      }
+
+      // u = (A_uu)^{-1} (f_u - A_ul lambda).
+      int ndof = space->get_num_dofs();
+      delete [] sln_vector;
+      sln_vector = new Scalar[ndof];
+      memset(sln_vector, 0, ndof * sizeof(Scalar));
+#pragma omp parallel for num_threads(num_threads) schedule(dynamic, 16)
+      for(int i = 0; i < num_elements; i++)
+      {
+        LocalSystem& local = local_systems[i];
+        int nl = local.trace_dofs.size();
+        Scalar* traces = new Scalar[nl];
+        for(int l = 0; l < nl; l++)
+          traces[l] = local.trace_dofs[l] >= 0 ? trace_vector[local.trace_dofs[l]] : local.trace_values[l];
+        for(unsigned int u = 0; u < local.dofs.size(); u++)
+        {
+          Scalar value = local.lift[u];
+          for(int l = 0; l < nl; l++)
+            value -= local.coupling[u * nl + l] * traces[l];
+          sln_vector[local.dofs[u]] = value;
+        }
+        delete [] traces;
+      }
+
+      this->tick();
+      this->info("HDGSolver: %i element DOFs, %i trace DOFs, duration: %f s.", ndof, num_trace_dofs, this->last());
+    }
+
+    template<typename Scalar>
+    void HDGSolver<Scalar>::assemble_element(Element* e, LocalSystem& local, PrecalcShapeset* pss, RefMap* refmap)
+    {
+      AsmList<Scalar> al;
+      space->get_element_assembly_list(e, &al);
+      int nu = al.get_cnt();
+      int nl = local.trace_dofs.size();
+      local.dofs.assign(al.get_dof(), al.get_dof() + nu);
+
+      int trace_offsets[H2D_MAX_NUMBER_EDGES + 1];
+      trace_offsets[0] = 0;
+      for(unsigned int edge = 0; edge < e->get_nvert(); edge++)
+        trace_offsets[edge + 1] = trace_offsets[edge] + trace_space.get_edge_order(e->en[edge]->id) + 1;
+
+      double** a_uu = new_matrix<double>(nu, nu);
+      double** a_ul = new_matrix<double>(nu, nl);
+      double** a_lu = new_matrix<double>(nl, nu);
+      double** a_ll = new_matrix<double>(nl, nl);
+      local.lift = new Scalar[nu];
+      memset(local.lift, 0, nu * sizeof(Scalar));
+
+      refmap->set_active_element(e);
+      pss->set_active_element(e);
+      int p = space->get_element_order(e->id);
+      p = std::max(H2D_GET_H_ORDER(p), H2D_GET_V_ORDER(p));
+      int order = refmap->get_inv_ref_order() + 2 * p + 2;
+      limit_order(order, e->get_mode());
+
+      // (epsilon grad u, grad v) - (u, b.grad v), (f, v).
+      double3* pt = refmap->get_quad_2d()->get_points(order, e->get_mode());
+      int np = refmap->get_quad_2d()->get_num_points(order, e->get_mode());
+      Geom<double>* geometry = init_geom_vol(refmap, order);
+      double* jac = refmap->is_jacobian_const() ? NULL : refmap->get_jacobian(order);
+      double* weights = new double[np];
+      for(int q = 0; q < np; q++)
+        weights[q] = pt[q][2] * (jac == NULL ? refmap->get_const_jacobian() : jac[q]);
+
+      Func<double>** fns = new Func<double>*[nu];
+      for(int i = 0; i < nu; i++)
+      {
+        pss->set_active_shape(al.get_idx()[i]);
+        fns[i] = init_fn(pss, refmap, order);
+      }
+      for(int i = 0; i < nu; i++)
+        for(int j = 0; j < nu; j++)
+        {
+          double sum = 0.0;
+          for(int q = 0; q < np; q++)
+            sum += weights[q] * (epsilon * (fns[j]->dx[q] * fns[i]->dx[q] + fns[j]->dy[q] * fns[i]->dy[q])
+            - fns[j]->val[q] * (b_x * fns[i]->dx[q] + b_y * fns[i]->dy[q]));
+          a_uu[i][j] = sum;
+        }
+      if(source != NULL)
+        for(int q = 0; q < np; q++)
+        {
+          Scalar f = source->value(Scalar(geometry->x[q]), Scalar(geometry->y[q]));
+          for(int i = 0; i < nu; i++)
+            local.lift[i] += weights[q] * f * fns[i]->val[q];
+        }
+      for(int i = 0; i < nu; i++)
+      {
+        fns[i]->free_fn();
+        delete fns[i];
+      }
+      delete [] fns;
+      delete [] weights;
+      geometry->free();
+      delete geometry;
+
+      double tau = penalty * epsilon * (p + 1) * (p + 1) / e->get_diameter();
+      for(unsigned int edge = 0; edge < e->get_nvert(); edge++)
+        assemble_edge(e, edge, order, tau, trace_offsets[edge], trace_offsets[edge + 1] - trace_offsets[edge], al, pss, refmap, a_uu, a_ul, a_lu, a_ll);
+
+      // X = (A_uu)^{-1} A_ul, y = (A_uu)^{-1} f_u.
+      int* indx = new int[nu];
+      double d;
+      ludcmp(a_uu, nu, indx, &d);
+      local.coupling = new double[nu * nl];
+      double* column = new double[nu];
+      for(int l = 0; l < nl; l++)
+      {
+        for(int i = 0; i < nu; i++)
+          column[i] = a_ul[i][l];
+        lubksb<double>(a_uu, nu, indx, column);
+        for(int i = 0; i < nu; i++)
+          local.coupling[i * nl + l] = column[i];
+      }
+      lubksb<Scalar>(a_uu, nu, indx, local.lift);
+      delete [] column;
+      delete [] indx;
+
+      // A_ll - A_lu X and - A_lu y, the essential traces moved to the right-hand side.
+      Scalar** schur = new_matrix<Scalar>(nl, nl);
+      Scalar* rhs_local = new Scalar[nl];
+      for(int k = 0; k < nl; k++)
+      {
+        rhs_local[k] = 0.0;
+        for(int i = 0; i < nu; i++)
+          rhs_local[k] -= a_lu[k][i] * local.lift[i];
+        for(int l = 0; l < nl; l++)
+        {
+          double value = a_ll[k][l];
+          for(int i = 0; i < nu; i++)
+            value -= a_lu[k][i] * local.coupling[i * nl + l];
+          schur[k][l] = value;
+          if(local.trace_dofs[l] < 0)
+            rhs_local[k] -= value * local.trace_values[l];
+        }
+      }
+      matrix->add(nl, nl, schur, &local.trace_dofs[0], &local.trace_dofs[0]);
+      for(int k = 0; k < nl; k++)
+        if(local.trace_dofs[k] >= 0)
+          rhs->add(local.trace_dofs[k], rhs_local[k]);
+
+      delete [] schur;
+      delete [] rhs_local;
+      delete [] a_uu;
+      delete [] a_ul;
+      delete [] a_lu;
+      delete [] a_ll;
+    }
+
+    template<typename Scalar>
+    void HDGSolver<Scalar>::assemble_edge(Element* e, int edge, int order, double tau, int first, int count, AsmList<Scalar>& al,
+      PrecalcShapeset* pss, RefMap* refmap, double** a_uu, double** a_ul, double** a_lu, double** a_ll)
+    {
+      int nu = al.get_cnt();
+      int eo = refmap->get_quad_2d()->get_edge_points(edge, order, e->get_mode());
+      double3* pt = refmap->get_quad_2d()->get_points(eo, e->get_mode());
+      int np = refmap->get_quad_2d()->get_num_points(eo, e->get_mode());
+      double3* tan;
+      Geom<double>* geometry = init_geom_surf(refmap, edge, e->en[edge]->marker, eo, tan);
+
+      // The element functions, their (scaled) normal derivatives, the traces in the points.
+      Func<double>** fns = new Func<double>*[nu];
+      double* dn = new double[nu * np];
+      for(int i = 0; i < nu; i++)
+      {
+        pss->set_active_shape(al.get_idx()[i]);
+        fns[i] = init_fn(pss, refmap, eo);
+        for(int q = 0; q < np; q++)
+          dn[i * np + q] = epsilon * (fns[i]->dx[q] * geometry->nx[q] + fns[i]->dy[q] * geometry->ny[q]);
+      }
+      double* traces = new double[count * np];
+      for(int q = 0; q < np; q++)
+        EdgeTraceSpace<Scalar>::get_legendre_values(count - 1, EdgeTraceSpace<Scalar>::get_edge_parameter(e, edge, geometry->x[q], geometry->y[q]), traces + q * count);
+
+      // On the boundary edges without the essential condition, the trace equation is the zero diffusive flux,
+      // with the consistent term c (lambda - u) determining the trace in the advective flux.
+      Node* en = e->en[edge];
+      bool natural_boundary = en->bnd && trace_space.get_essential_values(en->id) == NULL;
+
+      for(int q = 0; q < np; q++)
+      {
+        double w = pt[q][2] * tan[q][2];
+        double b_n = b_x * geometry->nx[q] + b_y * geometry->ny[q];
+        double tau_a = std::max(b_n, 0.0);
+        double adv = natural_boundary ? 0.0 : 1.0;
+        double c = 0.0;
+        if(natural_boundary)
+          c = (std::abs(b_n) > 0.0 || epsilon > 0.0) ? std::abs(b_n) : 1.0;
+        double* mu = traces + q * count;
+
+        for(int i = 0; i < nu; i++)
+        {
+          double v = fns[i]->val[q], dn_v = dn[i * np + q];
+          for(int j = 0; j < nu; j++)
+          {
+            double u = fns[j]->val[q], dn_u = dn[j * np + q];
+            a_uu[i][j] += w * (-dn_u * v - dn_v * u + (tau + tau_a) * u * v);
+          }
+          for(int l = 0; l < count; l++)
+            a_ul[i][first + l] += w * (dn_v - tau * v + (b_n - tau_a) * v) * mu[l];
+        }
+        for(int k = 0; k < count; k++)
+        {
+          for(int j = 0; j < nu; j++)
+            a_lu[first + k][j] += w * (dn[j * np + q] - (tau + adv * tau_a + c) * fns[j]->val[q]) * mu[k];
+          for(int l = 0; l < count; l++)
+            a_ll[first + k][first + l] += w * (tau - adv * (b_n - tau_a) + c) * mu[l] * mu[k];
+        }
+      }
+
+      for(int i = 0; i < nu; i++)
+      {
+        fns[i]->free_fn();
+        delete fns[i];
+      }
+      delete [] fns;
+      delete [] dn;
+      delete [] traces;
+      geometry->free();
+      delete geometry;
+    }
+
+    template HERMES_API class HDGSolver<double>;
+    template HERMES_API class HDGSolver<std::complex<double> >;
+  }
+}
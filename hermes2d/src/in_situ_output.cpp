@@ -0,0 +1,163 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "in_situ_output.h"
+#include "newton_solver.h"
+#include "picard_solver.h"
+#include "linear_solver.h"
+#include "runge_kutta.h"
+#include <sstream>
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    InSituOutput::InSituOutput(InSituConsumer* consumer, int item, double eps) : consumer(consumer), item(item), eps(eps), frame_number(0)
+    {
+      if(consumer == NULL)
+        throw Exceptions::NullException(1);
+    }
+
+    InSituOutput::~InSituOutput()
+    {
+      for(unsigned int i = 0; i < linearizers.size(); i++)
+        delete linearizers[i];
+    }
+
+    void InSituOutput::set_functions(Hermes::vector<MeshFunction<double>*> functions, Hermes::vector<std::string> names)
+    {
+      if(functions.size() != names.size())
+        throw Exceptions::LengthException(2, names.size(), functions.size());
+      this->functions = functions;
+      this->names = names;
+    }
+
+    Views::Linearizer* InSituOutput::get_linearizer(unsigned int i)
+    {
+      while(linearizers.size() <= i)
+        linearizers.push_back(new Views::Linearizer());
+      return linearizers[i];
+    }
+
+    void InSituOutput::output(double time)
+    {
+      output(functions, names, time);
+    }
+
+    void InSituOutput::output(Hermes::vector<MeshFunction<double>*> functions, Hermes::vector<std::string> names, double time)
+    {
+      InSituFrame frame;
+      frame.time = time;
+      frame.number = frame_number++;
+
+      for(unsigned int i = 0; i < functions.size(); i++)
+      {
+        Views::Linearizer* linearizer = get_linearizer(i);
+        linearizer->process_solution(functions[i], item, eps);
+      }
+
+      // The buffers stay locked while the consumer reads them.
+      for(unsigned int i = 0; i < functions.size(); i++)
+      {
+        Views::Linearizer* linearizer = linearizers[i];
+        linearizer->lock_data();
+        InSituField field;
+        field.name = names[i];
+        field.num_vertices = linearizer->get_num_vertices();
+        field.vertices = linearizer->get_vertices();
+        field.num_triangles = linearizer->get_num_triangles();
+        field.triangles = linearizer->get_triangles();
+        field.triangle_markers = linearizer->get_triangle_markers();
+        field.num_edges = linearizer->get_num_edges();
+        field.edges = linearizer->get_edges();
+        field.edge_markers = linearizer->get_edge_markers();
+        field.min_value = linearizer->get_min_value();
+        field.max_value = linearizer->get_max_value();
+        frame.fields.push_back(field);
+      }
+
+      try
+      {
+        consumer->consume(&frame);
+      }
+      catch(...)
+      {
+        for(unsigned int i = 0; i < functions.size(); i++)
+          linearizers[i]->unlock_data();
+        throw;
+      }
+      for(unsigned int i = 0; i < functions.size(); i++)
+        linearizers[i]->unlock_data();
+    }
+
+    void InSituOutput::on_finish(Hermes::Mixins::OutputAttachable* source)
+    {
+      double time = 0.0;
+      Hermes::Mixins::SettableComputationTime* timed = dynamic_cast<Hermes::Mixins::SettableComputationTime*>(source);
+      if(timed != NULL)
+        time = timed->time;
+      // the time step ends at the new time level
+      if(dynamic_cast<RungeKutta<double>*>(source) != NULL)
+        time += timed->time_step;
+
+      if(!functions.empty())
+      {
+        output(functions, names, time);
+        return;
+      }
+
+      // the solution of the solver
+      double* sln_vector = NULL;
+      if(dynamic_cast<NewtonSolver<double>*>(source) != NULL)
+        sln_vector = dynamic_cast<NewtonSolver<double>*>(source)->get_sln_vector();
+      else if(dynamic_cast<PicardSolver<double>*>(source) != NULL)
+        sln_vector = dynamic_cast<PicardSolver<double>*>(source)->get_sln_vector();
+      else if(dynamic_cast<LinearSolver<double>*>(source) != NULL)
+        sln_vector = dynamic_cast<LinearSolver<double>*>(source)->get_sln_vector();
+      Hermes::Hermes2D::Mixins::SettableSpaces<double>* with_spaces = dynamic_cast<Hermes::Hermes2D::Mixins::SettableSpaces<double>*>(source);
+
+      // a failed solve, or an unknown source
+      if(sln_vector == NULL || with_spaces == NULL)
+        return;
+
+      Hermes::vector<const Space<double>*> spaces = with_spaces->get_spaces();
+      Hermes::vector<Solution<double>*> solutions;
+      Hermes::vector<MeshFunction<double>*> solution_functions;
+      Hermes::vector<std::string> solution_names;
+      for(unsigned int i = 0; i < spaces.size(); i++)
+      {
+        solutions.push_back(new Solution<double>());
+        solution_functions.push_back(solutions.back());
+        std::stringstream name;
+        name << "solution_" << i;
+        solution_names.push_back(name.str());
+      }
+
+      try
+      {
+        Solution<double>::vector_to_solutions(sln_vector, spaces, solutions);
+        output(solution_functions, solution_names, time);
+      }
+      catch(...)
+      {
+        for(unsigned int i = 0; i < solutions.size(); i++)
+          delete solutions[i];
+        throw;
+      }
+      for(unsigned int i = 0; i < solutions.size(); i++)
+        delete solutions[i];
+    }
+  }
+}
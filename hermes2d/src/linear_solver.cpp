@@ -57,6 +57,7 @@ namespace Hermes
       this->jacobian = create_matrix<Scalar>();
       this->residual = create_vector<Scalar>();
       this->matrix_solver = create_linear_solver<Scalar>(this->jacobian, this->residual);
+      this->condensation = NULL;
       this->set_verbose_output(true);
     }
 
@@ -105,6 +106,33 @@ namespace Hermes
       return this->residual;
     }
 
+    template<typename Scalar>
+    LinearMatrixSolver<Scalar>* LinearSolver<Scalar>::get_linear_matrix_solver()
+    {
+      return this->matrix_solver;
+    }
+
+    template<typename Scalar>
+    void LinearSolver<Scalar>::set_static_condensation(bool to_set)
+    {
+      if(to_set && this->condensation == NULL)
+      {
+        this->condensation = new StaticCondensation<Scalar>();
+        this->condensation->set_verbose_output(this->get_verbose_output());
+      }
+      if(!to_set)
+      {
+        delete this->condensation;
+        this->condensation = NULL;
+      }
+    }
+
+    template<typename Scalar>
+    StaticCondensation<Scalar>* LinearSolver<Scalar>::get_static_condensation()
+    {
+      return this->condensation;
+    }
+
     template<typename Scalar>
     void LinearSolver<Scalar>::set_spaces(Hermes::vector<const Space<Scalar>*> spaces)
     {
@@ -129,6 +157,7 @@ namespace Hermes
       delete jacobian;
       delete residual;
       delete matrix_solver;
+      delete condensation;
       if(own_dp)
         delete this->dp;
       else
@@ -144,7 +173,13 @@ namespace Hermes
 
       this->on_initialization();
 
-      dp->assemble(this->jacobian, this->residual);
+      if(this->condensation != NULL)
+      {
+        dp->assemble(this->condensation->get_full_matrix(), this->condensation->get_full_rhs());
+        this->condensation->condense(dp->get_spaces(), this->jacobian, this->residual);
+      }
+      else
+        dp->assemble(this->jacobian, this->residual);
       if(this->output_rhsOn && (this->output_rhsIterations == -1 || this->output_rhsIterations >= 1))
       {
         char* fileName = new char[this->RhsFilename.length() + 5];
@@ -152,7 +187,7 @@ namespace Hermes
           sprintf(fileName, "%s%i.m", this->RhsFilename.c_str(), 1);
         else
           sprintf(fileName, "%s%i", this->RhsFilename.c_str(), 1);
-        FILE* rhs_file = fopen(fileName, "w+");
+        FILE* rhs_file = fopen(fileName, "wb+");
         residual->dump(rhs_file, this->RhsVarname.c_str(), this->RhsFormat, this->rhs_number_format);
         fclose(rhs_file);
       }
@@ -163,7 +198,7 @@ namespace Hermes
             sprintf(fileName, "%s%i.m", this->matrixFilename.c_str(), 1);
           else
             sprintf(fileName, "%s%i", this->matrixFilename.c_str(), 1);
-          FILE* matrix_file = fopen(fileName, "w+");
+          FILE* matrix_file = fopen(fileName, "wb+");
 
           jacobian->dump(matrix_file, this->matrixVarname.c_str(), this->matrixFormat, this->matrix_number_format);
           fclose(matrix_file);
@@ -171,7 +206,10 @@ namespace Hermes
 
       this->matrix_solver->solve();
 
-      this->sln_vector = matrix_solver->get_sln_vector();
+      if(this->condensation != NULL)
+        this->sln_vector = this->condensation->recover(matrix_solver->get_sln_vector());
+      else
+        this->sln_vector = matrix_solver->get_sln_vector();
 
       this->on_finish();
       
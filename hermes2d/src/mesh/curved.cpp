@@ -15,6 +15,7 @@
 
 #include "curved.h"
 #include <algorithm>
+#include <map>
 #include "global.h"
 #include "shapeset/shapeset_h1_all.h"
 #include "shapeset/shapeset_common.h"
@@ -56,6 +57,114 @@ namespace Hermes
 
     bool CurvMap::warning_issued = false;
 
+    unsigned int Nurbs::next_id = 0;
+
+    /// Identification of a projection of the reference mapping in the global cache: the vertices
+    /// of the element and of its base element, the curves, the transformation of the sub-element and the order.
+    struct CurvMapProjectionKey
+    {
+      double coords[4 * H2D_MAX_NUMBER_VERTICES]; ///< The vertices of the base element, then those of the element.
+      unsigned int nurbs[H2D_MAX_NUMBER_EDGES]; ///< Nurbs::id + 1, zero for straight edges.
+      uint64_t part;
+      int order;
+      int nvert; ///< Number of vertices of the base element.
+      int elem_nvert; ///< Number of vertices of the element.
+
+      bool operator<(const CurvMapProjectionKey& other) const
+      {
+        if(nvert != other.nvert)
+          return nvert < other.nvert;
+        if(elem_nvert != other.elem_nvert)
+          return elem_nvert < other.elem_nvert;
+        if(order != other.order)
+          return order < other.order;
+        if(part != other.part)
+          return part < other.part;
+        for (int i = 0; i < nvert; i++)
+          if(nurbs[i] != other.nurbs[i])
+            return nurbs[i] < other.nurbs[i];
+        for (int i = 0; i < 2 * (nvert + elem_nvert); i++)
+          if(coords[i] != other.coords[i])
+            return coords[i] < other.coords[i];
+        return false;
+      }
+    };
+
+    /// Maximum number of projections in the cache, it is emptied when full.
+    static const unsigned int H2D_CURV_MAP_CACHE_SIZE = 1 << 16;
+
+    /// The global cache of the projections, released at exit.
+    class CurvMapProjectionCache : public std::map<CurvMapProjectionKey, std::pair<int, double2*> >
+    {
+    public:
+      ~CurvMapProjectionCache()
+      {
+        free();
+      }
+
+      void free()
+      {
+        for(iterator it = begin(); it != end(); it++)
+          delete [] it->second.second;
+        clear();
+      }
+    };
+
+    static CurvMapProjectionCache curv_map_projection_cache;
+
+    static CurvMapProjectionKey make_projection_key(Element* e, Element* base, Nurbs** nurbs, uint64_t part, int order)
+    {
+      CurvMapProjectionKey key;
+      memset(&key, 0, sizeof(CurvMapProjectionKey));
+      key.nvert = base->get_nvert();
+      key.elem_nvert = e->get_nvert();
+      key.order = order;
+      key.part = part;
+      for (int i = 0; i < key.nvert; i++)
+      {
+        key.coords[2 * i] = base->vn[i]->x;
+        key.coords[2 * i + 1] = base->vn[i]->y;
+        key.nurbs[i] = (nurbs[i] == NULL) ? 0 : nurbs[i]->id + 1;
+      }
+      for (int i = 0; i < key.elem_nvert; i++)
+      {
+        key.coords[2 * (key.nvert + i)] = e->vn[i]->x;
+        key.coords[2 * (key.nvert + i) + 1] = e->vn[i]->y;
+      }
+      return key;
+    }
+
+    bool CurvMap::get_cached_coeffs(Element* e, Element* base, Nurbs** nurbs)
+    {
+      CurvMapProjectionKey key = make_projection_key(e, base, nurbs, toplevel ? 0 : part, order);
+      bool found = false;
+#pragma omp critical (curv_map_projection_cache)
+      {
+        CurvMapProjectionCache::iterator it = curv_map_projection_cache.find(key);
+        if(it != curv_map_projection_cache.end() && it->second.first == nc)
+        {
+          memcpy(coeffs, it->second.second, nc * sizeof(double2));
+          found = true;
+        }
+      }
+      return found;
+    }
+
+    void CurvMap::cache_coeffs(Element* e, Element* base, Nurbs** nurbs)
+    {
+      CurvMapProjectionKey key = make_projection_key(e, base, nurbs, toplevel ? 0 : part, order);
+      double2* cached = new double2[nc];
+      memcpy(cached, coeffs, nc * sizeof(double2));
+#pragma omp critical (curv_map_projection_cache)
+      {
+        if(curv_map_projection_cache.size() >= H2D_CURV_MAP_CACHE_SIZE)
+          curv_map_projection_cache.free();
+        std::pair<CurvMapProjectionCache::iterator, bool> inserted = curv_map_projection_cache.insert(std::make_pair(key, std::make_pair(nc, cached)));
+        if(!inserted.second)
+          delete [] cached;
+      }
+    }
+
     double CurvMap::nurbs_basis_fn(int i, int k, double t, double* knot)
     {
       if(k == 0)
@@ -834,16 +943,19 @@ namespace Hermes
       int qo = e->is_quad() ? H2D_MAKE_QUAD_ORDER(order, order) : order;
       int nb = ref_map_shapeset.get_num_bubbles(qo, e->get_mode());
       nc = nv + nv*ne + nb;
-      if(coeffs != NULL)
-      {
-        delete [] coeffs;
-        coeffs = NULL;
-      }
+      free_coeffs();
       coeffs = new double2[nc];
 
       // WARNING: do not change the format of the array 'coeffs'. If it changes,
       // RefMap::set_active_element() has to be changed too.
 
+      // The projection depends on the base element and the transformation only,
+      // the sons of every refinement and of every copy of a mesh get the same coefficients.
+      Element* base = toplevel ? e : parent;
+      Nurbs** nurbs_base = toplevel ? e->cm->nurbs : parent->cm->nurbs;
+      if(get_cached_coeffs(e, base, nurbs_base))
+        return;
+
       Nurbs** nurbs;
       if(toplevel == false)
       {
@@ -861,6 +973,8 @@ namespace Hermes
 
       // calculation of new projection coefficients
       ref_map_projection(e, nurbs, order, coeffs, &ref_map_shapeset, &ref_map_pss);
+
+      cache_coeffs(e, base, nurbs_base);
     }
 
     void CurvMap::get_mid_edge_points(Element* e, double2* pt, int n)
@@ -899,8 +1013,18 @@ namespace Hermes
     CurvMap::CurvMap(CurvMap* cm)
     {
       memcpy(this, cm, sizeof(CurvMap));
-      coeffs = new double2[nc];
-      memcpy(coeffs, cm->coeffs, sizeof(double2) * nc);
+
+      // The coefficients are only copied when one of the CurvMaps recalculates them.
+      if(coeffs != NULL)
+      {
+#pragma omp critical (curv_map_coeffs)
+        {
+          if(cm->coeffs_shared_count == NULL)
+            cm->coeffs_shared_count = new int(1);
+          coeffs_shared_count = cm->coeffs_shared_count;
+          (*coeffs_shared_count)++;
+        }
+      }
 
       if(toplevel)
         for (int i = 0; i < 4; i++)
@@ -908,13 +1032,30 @@ namespace Hermes
             nurbs[i]->ref++;
     }
 
-    CurvMap::~CurvMap()
+    void CurvMap::free_coeffs()
     {
-      if(coeffs != NULL)
+      if(coeffs == NULL)
+        return;
+
+      bool last = true;
+      if(coeffs_shared_count != NULL)
       {
-        delete [] coeffs;
-        coeffs = NULL;
+#pragma omp critical (curv_map_coeffs)
+        {
+          last = (--(*coeffs_shared_count) == 0);
+        }
+        if(last)
+          delete coeffs_shared_count;
+        coeffs_shared_count = NULL;
       }
+      if(last)
+        delete [] coeffs;
+      coeffs = NULL;
+    }
+
+    CurvMap::~CurvMap()
+    {
+      free_coeffs();
 
       if(toplevel)
         for (int i = 0; i < 4; i++)
@@ -0,0 +1,156 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "element_locator.h"
+#include "mesh.h"
+#include "refmap.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    /// Relative enlargement of the boxes of all the elements, to be safe with points on the edges.
+    static const double H2D_LOCATOR_BOX_TOLERANCE = 1e-10;
+
+    ElementLocator::ElementLocator(const Mesh* mesh) : mesh(mesh), seq(mesh->get_seq()), nactive(mesh->get_num_active_elements()), curved(false),
+      x_min(0.0), y_min(0.0), x_max(0.0), y_max(0.0), cell_size_x(1.0), cell_size_y(1.0), nx(1), ny(1), cell_starts(NULL), cell_elements(NULL)
+    {
+      Element* e;
+
+      // Boxes of all the active elements and of the whole mesh.
+      double* boxes = new double[4 * std::max(nactive, 1)];
+      int count = 0;
+      for_all_active_elements(e, mesh)
+      {
+        double* box = boxes + 4 * count;
+        get_bounding_box(e, box);
+        if(count == 0)
+        {
+          x_min = box[0]; y_min = box[1];
+          x_max = box[2]; y_max = box[3];
+        }
+        else
+        {
+          x_min = std::min(x_min, box[0]); y_min = std::min(y_min, box[1]);
+          x_max = std::max(x_max, box[2]); y_max = std::max(y_max, box[3]);
+        }
+        if(e->is_curved())
+          curved = true;
+        count++;
+      }
+
+      // Roughly one cell per element, the cells as square as possible.
+      double width = x_max - x_min, height = y_max - y_min;
+      if(count > 0 && width > 0.0 && height > 0.0)
+      {
+        nx = std::max(1, (int)(sqrt(count * width / height) + 0.5));
+        ny = std::max(1, (count + nx - 1) / nx);
+        cell_size_x = width / nx;
+        cell_size_y = height / ny;
+      }
+
+      // Count the elements of every cell, then store them.
+      cell_starts = new int[nx * ny + 1];
+      memset(cell_starts, 0, (nx * ny + 1) * sizeof(int));
+      for(int element_i = 0; element_i < count; element_i++)
+      {
+        int i_lo, j_lo, i_hi, j_hi;
+        get_cell(boxes[4 * element_i], boxes[4 * element_i + 1], i_lo, j_lo);
+        get_cell(boxes[4 * element_i + 2], boxes[4 * element_i + 3], i_hi, j_hi);
+        for(int i = i_lo; i <= i_hi; i++)
+          for(int j = j_lo; j <= j_hi; j++)
+            cell_starts[j * nx + i + 1]++;
+      }
+      for(int cell_i = 0; cell_i < nx * ny; cell_i++)
+        cell_starts[cell_i + 1] += cell_starts[cell_i];
+
+      cell_elements = new Element*[std::max(cell_starts[nx * ny], 1)];
+      int* fill = new int[nx * ny];
+      memcpy(fill, cell_starts, nx * ny * sizeof(int));
+      count = 0;
+      for_all_active_elements(e, mesh)
+      {
+        int i_lo, j_lo, i_hi, j_hi;
+        get_cell(boxes[4 * count], boxes[4 * count + 1], i_lo, j_lo);
+        get_cell(boxes[4 * count + 2], boxes[4 * count + 3], i_hi, j_hi);
+        for(int i = i_lo; i <= i_hi; i++)
+          for(int j = j_lo; j <= j_hi; j++)
+            cell_elements[fill[j * nx + i]++] = e;
+        count++;
+      }
+
+      delete [] fill;
+      delete [] boxes;
+    }
+
+    ElementLocator::~ElementLocator()
+    {
+      delete [] cell_starts;
+      delete [] cell_elements;
+    }
+
+    bool ElementLocator::is_up_to_date() const
+    {
+      return seq == mesh->get_seq() && nactive == mesh->get_num_active_elements();
+    }
+
+    bool ElementLocator::has_curved_elements() const
+    {
+      return curved;
+    }
+
+    void ElementLocator::get_bounding_box(Element* e, double* box)
+    {
+      box[0] = box[2] = e->vn[0]->x;
+      box[1] = box[3] = e->vn[0]->y;
+      for(unsigned int i = 1; i < e->get_nvert(); i++)
+      {
+        box[0] = std::min(box[0], e->vn[i]->x);
+        box[1] = std::min(box[1], e->vn[i]->y);
+        box[2] = std::max(box[2], e->vn[i]->x);
+        box[3] = std::max(box[3], e->vn[i]->y);
+      }
+
+      // A circular arc of at most a half circle does not get further from its chord than half of its length.
+      double margin = H2D_LOCATOR_BOX_TOLERANCE * std::max(box[2] - box[0], box[3] - box[1]);
+      if(e->is_curved())
+        margin += 0.5 * std::max(box[2] - box[0], box[3] - box[1]);
+      box[0] -= margin;
+      box[1] -= margin;
+      box[2] += margin;
+      box[3] += margin;
+    }
+
+    void ElementLocator::get_cell(double x, double y, int& i, int& j) const
+    {
+      i = std::min(nx - 1, std::max(0, (int)floor((x - x_min) / cell_size_x)));
+      j = std::min(ny - 1, std::max(0, (int)floor((y - y_min) / cell_size_y)));
+    }
+
+    Element* ElementLocator::find(double x, double y, double& x_reference, double& y_reference) const
+    {
+      if(x < x_min || x > x_max || y < y_min || y > y_max)
+        return NULL;
+
+      int i, j;
+      get_cell(x, y, i, j);
+      for(int k = cell_starts[j * nx + i]; k < cell_starts[j * nx + i + 1]; k++)
+        if(RefMap::is_element_on_physical_coordinates(cell_elements[k], x, y, &x_reference, &y_reference))
+          return cell_elements[k];
+
+      return NULL;
+    }
+  }
+}
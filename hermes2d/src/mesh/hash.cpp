@@ -23,7 +23,9 @@ namespace Hermes
   {
     HashTable::HashTable()
     {
-      v_table = NULL; e_table = NULL;
+      v_table.slots = e_table.slots = NULL;
+      v_table.mask = e_table.mask = -1;
+      v_table.count = e_table.count = 0;
     }
 
     HashTable::~HashTable()
@@ -33,28 +35,20 @@ namespace Hermes
 
     void HashTable::init(int size)
     {
-      v_table = e_table = NULL;
-
-      mask = size-1;
-      if(size & mask) throw Hermes::Exceptions::Exception("Parameter 'size' must be a power of two.");
+      if(size & (size - 1)) throw Hermes::Exceptions::Exception("Parameter 'size' must be a power of two.");
 
       // allocate and initialize the hash tables
-      v_table = new Node*[size];
-      e_table = new Node*[size];
-
-      memset(v_table, 0, size * sizeof(Node*));
-      memset(e_table, 0, size * sizeof(Node*));
+      alloc_table(v_table, size);
+      alloc_table(e_table, size);
     }
 
-    void HashTable::copy_list(Node** ptr, Node* node)
+    void HashTable::alloc_table(Table& table, int size)
     {
-      while (node != NULL)
-      {
-        *ptr = &nodes[node->id];
-        ptr = &((*ptr)->next_hash);
-        node = node->next_hash;
-      }
-      *ptr = NULL;
+      table.slots = new Slot[size];
+      table.mask = size - 1;
+      table.count = 0;
+      for (int i = 0; i < size; i++)
+        table.slots[i].id = -1;
     }
 
     Node* HashTable::get_node(int id) const
@@ -78,76 +72,113 @@ namespace Hermes
     {
       free();
       nodes.copy(ht->nodes);
-      mask = ht->mask;
 
-      v_table = new Node*[mask + 1];
-      e_table = new Node*[mask + 1];
-      for (int i = 0; i <= mask; i++)
-      {
-        copy_list(v_table + i, ht->v_table[i]);
-        copy_list(e_table + i, ht->e_table[i]);
-      }
+      // the slots refer to the nodes by their ids, they can be copied as they are
+      v_table = ht->v_table;
+      v_table.slots = new Slot[v_table.mask + 1];
+      memcpy(v_table.slots, ht->v_table.slots, (v_table.mask + 1) * sizeof(Slot));
+      e_table = ht->e_table;
+      e_table.slots = new Slot[e_table.mask + 1];
+      memcpy(e_table.slots, ht->e_table.slots, (e_table.mask + 1) * sizeof(Slot));
     }
 
     void HashTable::rebuild()
     {
-      memset(v_table, 0, (mask + 1) * sizeof(Node*));
-      memset(e_table, 0, (mask + 1) * sizeof(Node*));
+      for (int i = 0; i <= v_table.mask; i++)
+        v_table.slots[i].id = -1;
+      for (int i = 0; i <= e_table.mask; i++)
+        e_table.slots[i].id = -1;
+      v_table.count = e_table.count = 0;
 
       Node* node;
       for_all_nodes(node, this)
       {
+        // top-level vertex nodes have no parents and are never searched for
+        if(node->p1 < 0)
+          continue;
+
         int p1 = node->p1, p2 = node->p2;
         if(p1 > p2) std::swap(p1, p2);
-        int idx = hash(p1, p2);
-
-        if(node->type == HERMES_TYPE_VERTEX)
-        {
-          node->next_hash = v_table[idx];
-          v_table[idx] = node;
-        }
-        else
-        {
-          node->next_hash = e_table[idx];
-          e_table[idx] = node;
-        }
+        Table& table = (node->type == HERMES_TYPE_VERTEX) ? v_table : e_table;
+        if(10 * (table.count + 1) > 7 * (table.mask + 1))
+          grow(table, 2 * (table.mask + 1));
+        insert(table, p1, p2, node->id);
       }
     }
 
+    void HashTable::insert(Table& table, int p1, int p2, int id)
+    {
+      int i = hash(p1, p2, table.mask);
+      while (table.slots[i].id >= 0)
+        i = (i + 1) & table.mask;
+      table.slots[i].p1 = p1;
+      table.slots[i].p2 = p2;
+      table.slots[i].id = id;
+      table.count++;
+    }
+
+    void HashTable::grow(Table& table, int size)
+    {
+      Table old_table = table;
+      alloc_table(table, size);
+
+      for (int i = 0; i <= old_table.mask; i++)
+        if(old_table.slots[i].id >= 0)
+          insert(table, old_table.slots[i].p1, old_table.slots[i].p2, old_table.slots[i].id);
+
+      delete [] old_table.slots;
+    }
+
+    void HashTable::reserve(int num_new_vertex_nodes, int num_new_edge_nodes)
+    {
+      int size = v_table.mask + 1;
+      while (7 * size < 10 * (v_table.count + num_new_vertex_nodes))
+        size *= 2;
+      if(size > v_table.mask + 1)
+        grow(v_table, size);
+
+      size = e_table.mask + 1;
+      while (7 * size < 10 * (e_table.count + num_new_edge_nodes))
+        size *= 2;
+      if(size > e_table.mask + 1)
+        grow(e_table, size);
+    }
+
     void HashTable::free()
     {
       nodes.free();
-      if(v_table != NULL)
+      if(v_table.slots != NULL)
       {
-        delete [] v_table;
-        v_table = NULL;
+        delete [] v_table.slots;
+        v_table.slots = NULL;
       }
-      if(e_table != NULL)
+      if(e_table.slots != NULL)
       {
-        delete [] e_table;
-        e_table = NULL;
+        delete [] e_table.slots;
+        e_table.slots = NULL;
       }
+      v_table.count = e_table.count = 0;
     }
 
-    inline Node* HashTable::search_list(Node* node, int p1, int p2) const
+    inline int HashTable::search(const Table& table, int p1, int p2) const
     {
-      while (node != NULL)
+      int i = hash(p1, p2, table.mask);
+      while (table.slots[i].id >= 0)
       {
-        if(node->p1 == p1 && node->p2 == p2)
-          return node;
-        node = node->next_hash;
+        if(table.slots[i].p1 == p1 && table.slots[i].p2 == p2)
+          return i;
+        i = (i + 1) & table.mask;
       }
-      return NULL;
+      return -1;
     }
 
     Node* HashTable::get_vertex_node(int p1, int p2)
     {
       // search for the node in the vertex hashtable
       if(p1 > p2) std::swap(p1, p2);
-      int i = hash(p1, p2);
-      Node* node = search_list(v_table[i], p1, p2);
-      if(node != NULL) 
-        return node;
+      int i = search(v_table, p1, p2);
+      if(i >= 0)
+        return &nodes[v_table.slots[i].id];
 
       // not found - create a new one
       Node* newnode = nodes.add();
@@ -162,9 +193,10 @@ namespace Hermes
       newnode->x = (nodes[p1].x + nodes[p2].x) * 0.5;
       newnode->y = (nodes[p1].y + nodes[p2].y) * 0.5;
 
-      // insert into hashtable
-      newnode->next_hash = v_table[i];
-      v_table[i] = newnode;
+      // insert into hashtable, keep the load below 0.7
+      if(10 * (v_table.count + 1) > 7 * (v_table.mask + 1))
+        grow(v_table, 2 * (v_table.mask + 1));
+      insert(v_table, p1, p2, newnode->id);
 
       return newnode;
     }
@@ -173,9 +205,9 @@ namespace Hermes
     {
       // search for the node in the edge hashtable
       if(p1 > p2) std::swap(p1, p2);
-      int i = hash(p1, p2);
-      Node* node = search_list(e_table[i], p1, p2);
-      if(node != NULL) return node;
+      int i = search(e_table, p1, p2);
+      if(i >= 0)
+        return &nodes[e_table.slots[i].id];
 
       // not found - create a new one
       Node* newnode = nodes.add();
@@ -189,9 +221,10 @@ namespace Hermes
       newnode->marker = 0;
       newnode->elem[0] = newnode->elem[1] = NULL;
 
-      // insert into hashtable
-      newnode->next_hash = e_table[i];
-      e_table[i] = newnode;
+      // insert into hashtable, keep the load below 0.7
+      if(10 * (e_table.count + 1) > 7 * (e_table.mask + 1))
+        grow(e_table, 2 * (e_table.mask + 1));
+      insert(e_table, p1, p2, newnode->id);
 
       return newnode;
     }
@@ -199,55 +232,53 @@ namespace Hermes
     Node* HashTable::peek_vertex_node(int p1, int p2) const
     {
       if(p1 > p2) std::swap(p1, p2);
-      return search_list(v_table[hash(p1, p2)], p1, p2);
+      int i = search(v_table, p1, p2);
+      return (i >= 0) ? &nodes[v_table.slots[i].id] : NULL;
     }
 
     Node* HashTable::peek_edge_node(int p1, int p2) const
     {
       if(p1 > p2) std::swap(p1, p2);
-      return search_list(e_table[hash(p1, p2)], p1, p2);
+      int i = search(e_table, p1, p2);
+      return (i >= 0) ? &nodes[e_table.slots[i].id] : NULL;
     }
 
-    void HashTable::remove_vertex_node(int id)
+    void HashTable::remove_from_table(Table& table, int id)
     {
-      // remove the node from the hash table
-      int i = hash(nodes[id].p1, nodes[id].p2);
-      Node** ptr = v_table + i;
-      Node* node = *ptr;
-      while (node != NULL)
+      int i = search(table, nodes[id].p1, nodes[id].p2);
+      if(i >= 0)
       {
-        if(node->id == id)
+        // backward shift deletion: move up the following items of the cluster
+        // that would not be found any more behind the emptied slot
+        int j = i;
+        while (true)
         {
-          *ptr = node->next_hash;
-          break;
+          j = (j + 1) & table.mask;
+          if(table.slots[j].id < 0)
+            break;
+          int k = hash(table.slots[j].p1, table.slots[j].p2, table.mask);
+          if((j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j)))
+          {
+            table.slots[i] = table.slots[j];
+            i = j;
+          }
         }
-        ptr = &node->next_hash;
-        node = *ptr;
+        table.slots[i].id = -1;
+        table.count--;
       }
 
       // remove node from the array
       nodes.remove(id);
     }
 
-    void HashTable::remove_edge_node(int id)
+    void HashTable::remove_vertex_node(int id)
     {
-      // remove the node from the hash table
-      int i = hash(nodes[id].p1, nodes[id].p2);
-      Node** ptr = e_table + i;
-      Node* node = *ptr;
-      while (node != NULL)
-      {
-        if(node->id == id)
-        {
-          *ptr = node->next_hash;
-          break;
-        }
-        ptr = &node->next_hash;
-        node = *ptr;
-      }
+      remove_from_table(v_table, id);
+    }
 
-      // remove node from the array
-      nodes.remove(id);
+    void HashTable::remove_edge_node(int id)
+    {
+      remove_from_table(e_table, id);
     }
   }
 }
\ No newline at end of file
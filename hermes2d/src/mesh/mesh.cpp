@@ -15,6 +15,7 @@
 
 #include "mesh.h"
 #include "refmap.h"
+#include "element_locator.h"
 #include <algorithm>
 #include "global.h"
 #include "api2d.h"
@@ -28,6 +29,8 @@ namespace Hermes
     static const int H2D_DG_INNER_EDGE_INT = -1234567;
     static const std::string H2D_DG_INNER_EDGE = "-1234567";
 
+    static int mesh_memory_category = Hermes::MemoryAccounting::add_category("meshes");
+
     bool Node::is_constrained_vertex() const
     {
       assert(type == HERMES_TYPE_VERTEX);
@@ -94,7 +97,7 @@ namespace Hermes
       this->diameterCalculated = false;
     }
 
-    Element::Element() : visited(false), area(0.0), diameter(0.0), center_set(false)
+    Element::Element() : visited(false), center_set(false), area(0.0), diameter(0.0)
     {
     };
 
@@ -248,10 +251,12 @@ namespace Hermes
 
     unsigned g_mesh_seq = 0;
 
-    Mesh::Mesh() : HashTable()
+    Mesh::Mesh() : HashTable(), element_locator(NULL), active_elements_valid(false), active_elements_generation(0)
     {
       nbase = nactive = ntopvert = ninitial = 0;
       seq = g_mesh_seq++;
+      this->nodes.set_memory_category(mesh_memory_category);
+      this->elements.set_memory_category(mesh_memory_category);
     }
 
     Mesh::~Mesh() 
@@ -272,18 +277,65 @@ namespace Hermes
       return okay;
     }
 
-    Mesh::ReferenceMeshCreator::ReferenceMeshCreator(Mesh* coarse_mesh, int refinement) : coarse_mesh(coarse_mesh), refinement(refinement)
+    Mesh::ReferenceMeshCreator::ReferenceMeshCreator(Mesh* coarse_mesh, int refinement) : coarse_mesh(coarse_mesh), refinement(refinement), kept_ref_mesh(NULL), kept_coarse_mesh(NULL)
+    {
+    }
+
+    Mesh::ReferenceMeshCreator::ReferenceMeshCreator(const ReferenceMeshCreator& other) : coarse_mesh(other.coarse_mesh), refinement(other.refinement), kept_ref_mesh(NULL), kept_coarse_mesh(NULL)
+    {
+    }
+
+    Mesh::ReferenceMeshCreator& Mesh::ReferenceMeshCreator::operator=(const ReferenceMeshCreator& other)
     {
+      if(this != &other)
+      {
+        free_cache();
+        this->coarse_mesh = other.coarse_mesh;
+        this->refinement = other.refinement;
+      }
+      return *this;
+    }
+
+    Mesh::ReferenceMeshCreator::~ReferenceMeshCreator()
+    {
+      free_cache();
     }
 
     Mesh* Mesh::ReferenceMeshCreator::create_ref_mesh()
     {
       Mesh* ref_mesh = new Mesh;
+
+      // The kept reference mesh is only reused for the very same coarse mesh in the same state.
+      if(kept_ref_mesh != NULL && kept_coarse_mesh == this->coarse_mesh && kept_seq == this->coarse_mesh->seq
+        && kept_num_elements == this->coarse_mesh->elements.get_num_items() && kept_num_active_elements == this->coarse_mesh->nactive
+        && kept_num_nodes == this->coarse_mesh->nodes.get_num_items() && kept_refinement == this->refinement)
+      {
+        ref_mesh->copy(kept_ref_mesh);
+        return ref_mesh;
+      }
+
       ref_mesh->copy(this->coarse_mesh);
       ref_mesh->refine_all_elements(refinement, false);
+
+      free_cache();
+      kept_ref_mesh = new Mesh;
+      kept_ref_mesh->copy(ref_mesh);
+      kept_coarse_mesh = this->coarse_mesh;
+      kept_seq = this->coarse_mesh->seq;
+      kept_num_elements = this->coarse_mesh->elements.get_num_items();
+      kept_num_active_elements = this->coarse_mesh->nactive;
+      kept_num_nodes = this->coarse_mesh->nodes.get_num_items();
+      kept_refinement = this->refinement;
       return ref_mesh;
     }
 
+    void Mesh::ReferenceMeshCreator::free_cache()
+    {
+      delete kept_ref_mesh;
+      kept_ref_mesh = NULL;
+      kept_coarse_mesh = NULL;
+    }
+
     void Mesh::initial_single_check()
     {
       RefMap r;
@@ -340,7 +392,6 @@ namespace Hermes
         node->type = HERMES_TYPE_VERTEX;
         node->bnd = 0;
         node->p1 = node->p2 = -1;
-        node->next_hash = NULL;
         node->x = verts[i][0];
         node->y = verts[i][1];
       }
@@ -493,11 +544,141 @@ namespace Hermes
       return seq;
     }
 
+    /// One step of the hash of Mesh::get_version() and Space::get_version() (FNV-1a over the words, mixed).
+    static inline void version_hash(uint64_t& hash, uint64_t word)
+    {
+      hash = (hash ^ word) * 1099511628211ULL;
+      hash ^= hash >> 29;
+    }
+
+    static inline uint64_t version_word(double value)
+    {
+      uint64_t word;
+      memcpy(&word, &value, sizeof(double));
+      return word;
+    }
+
+    uint64_t Mesh::get_version() const
+    {
+      uint64_t hash = 14695981039346656037ULL;
+      Element* e;
+      for_all_active_elements(e, this)
+      {
+        version_hash(hash, e->id);
+        version_hash(hash, (uint64_t)(int64_t)e->marker);
+        version_hash(hash, e->get_nvert());
+        for(unsigned int i = 0; i < e->get_nvert(); i++)
+        {
+          version_hash(hash, e->vn[i]->id);
+          version_hash(hash, version_word(e->vn[i]->x));
+          version_hash(hash, version_word(e->vn[i]->y));
+          version_hash(hash, (uint64_t)(int64_t)(e->en[i]->bnd ? e->en[i]->marker : -1));
+        }
+        if(e->cm == NULL)
+          version_hash(hash, 0);
+        else if(!e->cm->toplevel)
+        {
+          version_hash(hash, 1);
+          version_hash(hash, e->cm->parent->id);
+          version_hash(hash, e->cm->part);
+        }
+        else
+        {
+          version_hash(hash, 2);
+          for(unsigned int i = 0; i < e->get_nvert(); i++)
+          {
+            Nurbs* nurbs = e->cm->nurbs[i];
+            if(nurbs == NULL)
+            {
+              version_hash(hash, 0);
+              continue;
+            }
+            version_hash(hash, nurbs->degree);
+            version_hash(hash, nurbs->np);
+            for(int j = 0; j < nurbs->np; j++)
+              for(int k = 0; k < 3; k++)
+                version_hash(hash, version_word(nurbs->pt[j][k]));
+          }
+        }
+      }
+      return hash;
+    }
+
     void Mesh::set_seq(unsigned seq)
     {
       this->seq = seq;
     }
 
+    ElementLocator* Mesh::get_element_locator() const
+    {
+      if(element_locator == NULL || !element_locator->is_up_to_date())
+      {
+#pragma omp critical (element_locator)
+        if(element_locator == NULL || !element_locator->is_up_to_date())
+        {
+          delete element_locator;
+          element_locator = new ElementLocator(this);
+        }
+      }
+      return element_locator;
+    }
+
+    bool Mesh::active_elements_up_to_date() const
+    {
+      return active_elements_valid && active_elements_modification == elements.get_modification_count() && active_elements_seq == seq && active_elements_nactive == nactive;
+    }
+
+    void Mesh::update_active_elements() const
+    {
+      if(active_elements_up_to_date())
+        return;
+
+      // Meshes are shared by the threads, the list is only rebuilt after the mesh changed.
+#pragma omp critical (mesh_active_elements)
+      {
+        if(!active_elements_up_to_date())
+        {
+          active_elements.clear();
+          for (int id = 0, max = elements.get_size(); id < max; id++)
+          {
+            Element* e = &(elements[id]);
+            if(e->used && e->active)
+              active_elements.push_back(e);
+          }
+          active_elements_modification = elements.get_modification_count();
+          active_elements_seq = seq;
+          active_elements_nactive = nactive;
+          active_elements_generation++;
+          active_elements_valid = true;
+        }
+      }
+    }
+
+    void Mesh::get_active_elements(std::vector<Element*>& active) const
+    {
+      update_active_elements();
+      active = active_elements;
+    }
+
+    ActiveElementIterator::ActiveElementIterator(const Mesh* mesh) : mesh(mesh), position(0), next_id(0)
+    {
+      mesh->update_active_elements();
+      end = mesh->active_elements.size();
+      generation = mesh->active_elements_generation;
+      max_id = mesh->get_max_element_id();
+    }
+
+    bool ActiveElementIterator::next_by_id(Element*& e)
+    {
+      while(next_id < max_id)
+      {
+        e = mesh->get_element_fast(next_id++);
+        if(e->used && e->active)
+          return true;
+      }
+      return false;
+    }
+
     Element* Mesh::get_element_fast(int id) const
     {
       return &(elements[id]);
@@ -958,6 +1139,8 @@ namespace Hermes
       }
       else refine_quad(e, refinement);
 
+      // Meshes are refined concurrently by Adapt::apply_refinements().
+#pragma omp critical (g_mesh_seq)
       this->seq = g_mesh_seq++;
     }
 
@@ -973,8 +1156,6 @@ namespace Hermes
 
     void Mesh::refine_all_elements(int refinement, bool mark_as_initial)
     {
-      Element* e;
-
       ninitial = this->get_max_element_id();
 
       if(refinement == -1)
@@ -982,8 +1163,17 @@ namespace Hermes
 
       elements.set_append_only(true);
 
-      for_all_active_elements(e, this)
-        refine_element_id(e->id, refinement);
+      // A refined quad brings about three new vertex nodes and eight new edge nodes, allocate the hash tables at once.
+      this->reserve(3 * this->get_num_active_elements(), 8 * this->get_num_active_elements());
+
+      std::vector<Element*> elements_to_refine;
+      this->get_active_elements(elements_to_refine);
+      this->create_refinement_vertex_nodes(elements_to_refine, refinement);
+
+      // The elements are created serially (the element and node arrays, the reference counts of the nodes),
+      // their mid-edge vertex nodes are found in the hash table.
+      for(unsigned int i = 0; i < elements_to_refine.size(); i++)
+        refine_element_id(elements_to_refine[i]->id, refinement);
 
       elements.set_append_only(false);
 
@@ -991,6 +1181,48 @@ namespace Hermes
         ninitial = this->get_max_element_id();
     }
 
+    void Mesh::create_refinement_vertex_nodes(const std::vector<Element*>& elements_to_refine, int refinement)
+    {
+      int count = (int)elements_to_refine.size();
+      int* parents = new int[2 * H2D_MAX_NUMBER_EDGES * count];
+
+      // Phase 1, concurrent: every element lists the parents of the mid-edge vertex nodes its refinement creates
+      // and that do not exist yet. The hash tables are only read.
+      int num_threads_used = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
+#pragma omp parallel for schedule(static) num_threads(num_threads_used)
+      for(int i = 0; i < count; i++)
+      {
+        Element* e = elements_to_refine[i];
+        int* element_parents = parents + 2 * H2D_MAX_NUMBER_EDGES * i;
+        for(int edge = 0; edge < H2D_MAX_NUMBER_EDGES; edge++)
+        {
+          element_parents[2 * edge] = -1;
+          if(edge >= e->get_nvert())
+            continue;
+          // Triangles to quads are refined by refine_triangle_to_quads(), which creates its nodes itself.
+          if(e->is_triangle() && refinement == 3)
+            continue;
+          // Quads refined to two sons split two of the edges only.
+          if(e->is_quad() && ((refinement == 1 && edge % 2 == 0) || (refinement == 2 && edge % 2 == 1)))
+            continue;
+          int p1 = e->vn[edge]->id, p2 = e->vn[e->next_vert(edge)]->id;
+          if(peek_vertex_node(p1, p2) == NULL)
+          {
+            element_parents[2 * edge] = p1;
+            element_parents[2 * edge + 1] = p2;
+          }
+        }
+      }
+
+      // Phase 2, serial: the nodes are created in the order of the elements, so that the node ids do not depend
+      // on the number of threads. A node shared by two elements is found by get_vertex_node() the second time.
+      for(int i = 0; i < 2 * H2D_MAX_NUMBER_EDGES * count; i += 2)
+        if(parents[i] >= 0)
+          get_vertex_node(parents[i], parents[i + 1]);
+
+      delete [] parents;
+    }
+
     static int rtb_marker;
     static bool rtb_aniso;
     static char* rtb_vert;
@@ -1079,6 +1311,7 @@ namespace Hermes
 
         Element* e;
         for_all_active_elements(e, this)
+        {
           for (unsigned int j = 0; j < e->get_nvert(); j++)
           {
             bool marker_matched = false;
@@ -1091,9 +1324,10 @@ namespace Hermes
               refined = true;
             }
           }
+        }
 
-          refine_by_criterion(rtb_criterion, 1);
-          delete [] rtb_vert;
+        refine_by_criterion(rtb_criterion, 1);
+        delete [] rtb_vert;
       }
 
       if(mark_as_initial)
@@ -1105,7 +1339,7 @@ namespace Hermes
     void Mesh::refine_towards_boundary(std::string marker, int depth, bool aniso, bool mark_as_initial)
     {
       if(marker == HERMES_ANY)
-        for(std::map<int, std::string>::iterator it = this->boundary_markers_conversion.conversion_table.begin(); it != this->boundary_markers_conversion.conversion_table.end(); ++it)
+        for(std::map<int, std::string>::iterator it = this->boundary_markers_conversion.tables->conversion_table.begin(); it != this->boundary_markers_conversion.tables->conversion_table.end(); ++it)
           refine_towards_boundary(it->second, depth, aniso, mark_as_initial);
 
       else
@@ -1124,6 +1358,7 @@ namespace Hermes
 
           Element* e;
           for_all_active_elements(e, this)
+          {
             for (unsigned int j = 0; j < e->get_nvert(); j++)
             {
               if(e->en[j]->marker == this->boundary_markers_conversion.get_internal_marker(marker).marker)
@@ -1132,9 +1367,10 @@ namespace Hermes
                 refined = true;
               }
             }
+          }
 
-            refine_by_criterion(rtb_criterion, 1);
-            delete [] rtb_vert;
+          refine_by_criterion(rtb_criterion, 1);
+          delete [] rtb_vert;
         }
 
         if(mark_as_initial)
@@ -1211,11 +1447,305 @@ namespace Hermes
         unrefine_element_id(list[i]);
     }
 
+    /// Index of the point (x, y) of the [0, 2^order) x [0, 2^order) grid along the Hilbert curve.
+    static unsigned int hilbert_index(unsigned int x, unsigned int y, int order)
+    {
+      unsigned int d = 0;
+      for (unsigned int s = 1u << (order - 1); s > 0; s >>= 1)
+      {
+        unsigned int rx = (x & s) > 0;
+        unsigned int ry = (y & s) > 0;
+        d += s * s * ((3 * rx) ^ ry);
+        // rotate the quadrant
+        if(ry == 0)
+        {
+          if(rx == 1)
+          {
+            x = s - 1 - x;
+            y = s - 1 - y;
+          }
+          std::swap(x, y);
+        }
+      }
+      return d;
+    }
+
+    void Mesh::reorder_space_filling_curve()
+    {
+      // Order of the Hilbert curve, the grid has 2^15 x 2^15 cells.
+      const int order = 15;
+
+      Element* e;
+      Hermes::vector<std::pair<unsigned int, int> > curve;
+      double x_min = 0.0, x_max = 0.0, y_min = 0.0, y_max = 0.0;
+      bool first = true;
+      for_all_base_elements(e, this)
+      {
+        for (unsigned int i = 0; i < e->get_nvert(); i++)
+        {
+          if(first || e->vn[i]->x < x_min) x_min = e->vn[i]->x;
+          if(first || e->vn[i]->x > x_max) x_max = e->vn[i]->x;
+          if(first || e->vn[i]->y < y_min) y_min = e->vn[i]->y;
+          if(first || e->vn[i]->y > y_max) y_max = e->vn[i]->y;
+          first = false;
+        }
+      }
+      if(first)
+        return;
+
+      // The same scaling in both directions, so that the curve is not distorted.
+      double size = std::max(x_max - x_min, y_max - y_min);
+      double scale = size > 0.0 ? ((1u << order) - 1) / size : 0.0;
+      for_all_base_elements(e, this)
+      {
+        double x = 0.0, y = 0.0;
+        for (unsigned int i = 0; i < e->get_nvert(); i++)
+        {
+          x += e->vn[i]->x;
+          y += e->vn[i]->y;
+        }
+        x /= e->get_nvert();
+        y /= e->get_nvert();
+        curve.push_back(std::pair<unsigned int, int>(hilbert_index((unsigned int)((x - x_min) * scale), (unsigned int)((y - y_min) * scale), order), e->id));
+      }
+      std::sort(curve.begin(), curve.end());
+
+      // The vertices are numbered in the order in which the reordered elements reach them first,
+      // the vertices of no element come last.
+      int* vertex_map = new int[this->ntopvert];
+      for (int i = 0; i < this->ntopvert; i++)
+        vertex_map[i] = -1;
+      int nv = 0;
+      for (unsigned int i = 0; i < curve.size(); i++)
+      {
+        e = this->get_element_fast(curve[i].second);
+        for (unsigned int j = 0; j < e->get_nvert(); j++)
+          if(vertex_map[e->vn[j]->id] == -1)
+            vertex_map[e->vn[j]->id] = nv++;
+      }
+      for (int i = 0; i < this->ntopvert; i++)
+        if(vertex_map[i] == -1)
+          vertex_map[i] = nv++;
+
+      Mesh* reordered = new Mesh;
+      reordered->free();
+      int hash_size = 16;
+      while (hash_size < 2 * this->ntopvert) hash_size *= 2;
+      reordered->init(hash_size);
+
+      // create vertex nodes
+      int* inverse_vertex_map = new int[this->ntopvert];
+      for (int i = 0; i < this->ntopvert; i++)
+        inverse_vertex_map[vertex_map[i]] = i;
+      for (int i = 0; i < this->ntopvert; i++)
+      {
+        Node* node = reordered->nodes.add();
+        Node* original = &this->nodes[inverse_vertex_map[i]];
+        assert(node->id == i);
+        node->ref = TOP_LEVEL_REF;
+        node->type = HERMES_TYPE_VERTEX;
+        node->bnd = original->bnd;
+        node->p1 = node->p2 = -1;
+        node->x = original->x;
+        node->y = original->y;
+      }
+      reordered->ntopvert = this->ntopvert;
+      delete [] inverse_vertex_map;
+
+      // create the base elements, copy the curved maps and the edge markers
+      for (unsigned int i = 0; i < curve.size(); i++)
+      {
+        e = this->get_element_fast(curve[i].second);
+        Node** vn = e->vn;
+        Element* e_reordered;
+        if(e->is_triangle())
+          e_reordered = reordered->create_triangle(e->marker, &reordered->nodes[vertex_map[vn[0]->id]], &reordered->nodes[vertex_map[vn[1]->id]],
+          &reordered->nodes[vertex_map[vn[2]->id]], NULL);
+        else
+          e_reordered = reordered->create_quad(e->marker, &reordered->nodes[vertex_map[vn[0]->id]], &reordered->nodes[vertex_map[vn[1]->id]],
+          &reordered->nodes[vertex_map[vn[2]->id]], &reordered->nodes[vertex_map[vn[3]->id]], NULL);
+
+        if(e->cm != NULL)
+          e_reordered->cm = new CurvMap(e->cm);
+      }
+      for (unsigned int i = 0; i < curve.size(); i++)
+      {
+        e = this->get_element_fast(curve[i].second);
+        Element* e_reordered = reordered->get_element_fast(i);
+        for (unsigned int j = 0; j < e->get_nvert(); j++)
+        {
+          Node* en = this->get_base_edge_node(e, j);
+          e_reordered->en[j]->marker = en->marker;
+          e_reordered->en[j]->bnd = en->bnd;
+        }
+      }
+      delete [] vertex_map;
+
+      reordered->nbase = reordered->nactive = curve.size();
+
+      // The initial refinements first, so that the initial elements keep the lowest ids.
+      for (unsigned int i = 0; i < curve.size(); i++)
+        this->copy_refinements(this->get_element_fast(curve[i].second), reordered, reordered->get_element_fast(i), true);
+      reordered->ninitial = reordered->get_max_element_id();
+      for (unsigned int i = 0; i < curve.size(); i++)
+        this->copy_refinements(this->get_element_fast(curve[i].second), reordered, reordered->get_element_fast(i), false);
+
+      reordered->boundary_markers_conversion = this->boundary_markers_conversion;
+      reordered->element_markers_conversion = this->element_markers_conversion;
+      reordered->seq = g_mesh_seq++;
+
+      this->copy(reordered);
+      delete reordered;
+    }
+
+    void Mesh::partition(int num_parts, int* parts, const double* weights) const
+    {
+      if(num_parts < 1)
+        throw Exceptions::ValueException("num_parts", num_parts, 1);
+      const int order = 15;
+      int max_id = this->get_max_element_id();
+      for (int i = 0; i < max_id; i++)
+        parts[i] = -1;
+
+      // The Hilbert curve through the centres of the active elements, scaled as in reorder_space_filling_curve().
+      Element* e;
+      double x_min = 0.0, x_max = 0.0, y_min = 0.0, y_max = 0.0;
+      bool first = true;
+      for_all_active_elements(e, this)
+      {
+        for (unsigned int i = 0; i < e->get_nvert(); i++)
+        {
+          if(first || e->vn[i]->x < x_min) x_min = e->vn[i]->x;
+          if(first || e->vn[i]->x > x_max) x_max = e->vn[i]->x;
+          if(first || e->vn[i]->y < y_min) y_min = e->vn[i]->y;
+          if(first || e->vn[i]->y > y_max) y_max = e->vn[i]->y;
+          first = false;
+        }
+      }
+      if(first)
+        return;
+      double size = std::max(x_max - x_min, y_max - y_min);
+      double scale = size > 0.0 ? ((1u << order) - 1) / size : 0.0;
+      Hermes::vector<std::pair<unsigned int, int> > curve;
+      double total_weight = 0.0;
+      for_all_active_elements(e, this)
+      {
+        double x = 0.0, y = 0.0;
+        for (unsigned int i = 0; i < e->get_nvert(); i++)
+        {
+          x += e->vn[i]->x;
+          y += e->vn[i]->y;
+        }
+        x /= e->get_nvert();
+        y /= e->get_nvert();
+        curve.push_back(std::pair<unsigned int, int>(hilbert_index((unsigned int)((x - x_min) * scale), (unsigned int)((y - y_min) * scale), order), e->id));
+        total_weight += (weights == NULL ? 1.0 : weights[e->id]);
+      }
+      std::sort(curve.begin(), curve.end());
+
+      // Pieces of equal weight, an element belongs to the piece of the middle of its weight.
+      double* part_weights = new double[num_parts];
+      memset(part_weights, 0, num_parts * sizeof(double));
+      double cumulated = 0.0;
+      for (unsigned int i = 0; i < curve.size(); i++)
+      {
+        double weight = (weights == NULL ? 1.0 : weights[curve[i].second]);
+        int part = total_weight > 0.0 ? (int)((cumulated + 0.5 * weight) * num_parts / total_weight) : 0;
+        part = std::min(std::max(part, 0), num_parts - 1);
+        parts[curve[i].second] = part;
+        part_weights[part] += weight;
+        cumulated += weight;
+      }
+
+      // Smoothing of the boundaries of the parts.
+      if(num_parts > 1)
+      {
+        double min_weight = 0.95 * total_weight / num_parts, max_weight = 1.05 * total_weight / num_parts;
+        for (int pass = 0; pass < 2; pass++)
+        {
+          for (unsigned int i = 0; i < curve.size(); i++)
+          {
+            e = this->get_element_fast(curve[i].second);
+            int part = parts[e->id];
+            int neighbor_parts[H2D_MAX_NUMBER_EDGES];
+            int neighbor_counts[H2D_MAX_NUMBER_EDGES];
+            int num_neighbor_parts = 0, own_count = 0;
+            for (unsigned int ie = 0; ie < e->get_nvert(); ie++)
+            {
+              Element* neighbor = e->get_neighbor(ie);
+              if(neighbor == NULL || !neighbor->active)
+                continue;
+              int neighbor_part = parts[neighbor->id];
+              if(neighbor_part == part)
+              {
+                own_count++;
+                continue;
+              }
+              int k = 0;
+              while(k < num_neighbor_parts && neighbor_parts[k] != neighbor_part)
+                k++;
+              if(k == num_neighbor_parts)
+              {
+                neighbor_parts[k] = neighbor_part;
+                neighbor_counts[k] = 0;
+                num_neighbor_parts++;
+              }
+              neighbor_counts[k]++;
+            }
+            int best = -1;
+            for (int k = 0; k < num_neighbor_parts; k++)
+              if(neighbor_counts[k] > own_count && (best == -1 || neighbor_counts[k] > neighbor_counts[best]))
+                best = k;
+            if(best == -1)
+              continue;
+            double weight = (weights == NULL ? 1.0 : weights[e->id]);
+            if(part_weights[part] - weight < min_weight || part_weights[neighbor_parts[best]] + weight > max_weight)
+              continue;
+            part_weights[part] -= weight;
+            part_weights[neighbor_parts[best]] += weight;
+            parts[e->id] = neighbor_parts[best];
+          }
+        }
+      }
+      delete [] part_weights;
+    }
+
+    void Mesh::copy_refinements(Element* e, Mesh* reordered, Element* e_reordered, bool initial)
+    {
+      if(e->active)
+        return;
+
+      if(e_reordered->active)
+      {
+        int son = 0;
+        while (e->sons[son] == NULL) son++;
+        // The sons of a non-initial refinement can not be refined initially.
+        if(initial && e->sons[son]->id >= this->ninitial)
+          return;
+
+        int refinement;
+        if(e->is_triangle())
+          refinement = (e->sons[3] != NULL) ? 0 : 3;
+        else if(e->bsplit())
+          refinement = 0;
+        else if(e->hsplit())
+          refinement = 1;
+        else
+          refinement = 2;
+        reordered->refine_element(e_reordered, refinement);
+      }
+
+      for (int i = 0; i < 4; i++)
+        if(e->sons[i] != NULL)
+          copy_refinements(e->sons[i], reordered, e_reordered->sons[i], initial);
+    }
+
     Nurbs* Mesh::reverse_nurbs(Nurbs* nurbs)
     {
       Nurbs* rev = new Nurbs;
       *rev = *nurbs;
       rev->twin = true;
+      rev->id = Nurbs::next_id++;
 
       rev->pt = new double3[nurbs->np];
       for (int i = 0; i < nurbs->np; i++)
@@ -1483,10 +2013,11 @@ namespace Hermes
       }
       elements.free();
       HashTable::free();
-      this->boundary_markers_conversion.conversion_table.clear();
-      this->boundary_markers_conversion.conversion_table_inverse.clear();
-      this->element_markers_conversion.conversion_table.clear();
-      this->element_markers_conversion.conversion_table_inverse.clear();
+
+      delete element_locator;
+      element_locator = NULL;
+      this->boundary_markers_conversion.clear();
+      this->element_markers_conversion.clear();
       this->refinements.clear();
       this->seq = -1;
     }
@@ -2181,6 +2712,51 @@ namespace Hermes
 
     Mesh::MarkersConversion::MarkersConversion() : min_marker_unused(1)
     {
+      tables = new ConversionTables;
+      tables->ref_count = 1;
+    }
+
+    Mesh::MarkersConversion::MarkersConversion(const MarkersConversion& other) : min_marker_unused(other.min_marker_unused), tables(other.tables)
+    {
+#pragma omp critical (markers_conversion_tables)
+      tables->ref_count++;
+    }
+
+    Mesh::MarkersConversion& Mesh::MarkersConversion::operator=(const MarkersConversion& other)
+    {
+      if(tables == other.tables)
+      {
+        min_marker_unused = other.min_marker_unused;
+        return *this;
+      }
+      release_tables();
+      min_marker_unused = other.min_marker_unused;
+      tables = other.tables;
+#pragma omp critical (markers_conversion_tables)
+      tables->ref_count++;
+      return *this;
+    }
+
+    Mesh::MarkersConversion::~MarkersConversion()
+    {
+      release_tables();
+    }
+
+    void Mesh::MarkersConversion::release_tables()
+    {
+      bool last;
+#pragma omp critical (markers_conversion_tables)
+      last = (--tables->ref_count == 0);
+      if(last)
+        delete tables;
+      tables = NULL;
+    }
+
+    void Mesh::MarkersConversion::clear()
+    {
+      release_tables();
+      tables = new ConversionTables;
+      tables->ref_count = 1;
     }
 
     Mesh::MarkersConversion::StringValid::StringValid()
@@ -2241,12 +2817,20 @@ namespace Hermes
     {
       // First a check that the string value is not already present.
       if(user_marker != "")
-        if(conversion_table_inverse.find(user_marker) != conversion_table_inverse.end())
+        if(tables->conversion_table_inverse.find(user_marker) != tables->conversion_table_inverse.end())
           return;
-      if(conversion_table.size() == 0 || conversion_table.find(internal_marker) == conversion_table.end())
+      if(tables->conversion_table.size() == 0 || tables->conversion_table.find(internal_marker) == tables->conversion_table.end())
       {
-        conversion_table.insert(std::pair<int, std::string>(internal_marker, user_marker));
-        conversion_table_inverse.insert(std::pair<std::string, int>(user_marker, internal_marker));
+        // Copy on write of the shared tables.
+        if(tables->ref_count > 1)
+        {
+          ConversionTables* own_tables = new ConversionTables(*tables);
+          own_tables->ref_count = 1;
+          release_tables();
+          tables = own_tables;
+        }
+        tables->conversion_table.insert(std::pair<int, std::string>(internal_marker, user_marker));
+        tables->conversion_table_inverse.insert(std::pair<std::string, int>(user_marker, internal_marker));
         if(user_marker != "")
           this->min_marker_unused++;
       }
@@ -2258,10 +2842,11 @@ namespace Hermes
       if(internal_marker == H2D_DG_INNER_EDGE_INT)
         return StringValid(H2D_DG_INNER_EDGE, true);
 
-      if(conversion_table.find(internal_marker) == conversion_table.end())
+      std::map<int, std::string>::const_iterator it = tables->conversion_table.find(internal_marker);
+      if(it == tables->conversion_table.end())
         return StringValid("-999", false);
 
-      return StringValid(conversion_table.find(internal_marker)->second, true);
+      return StringValid(it->second, true);
     }
 
     Mesh::MarkersConversion::IntValid Mesh::MarkersConversion::get_internal_marker(std::string user_marker) const
@@ -2269,10 +2854,11 @@ namespace Hermes
       if(user_marker == H2D_DG_INNER_EDGE)
         return IntValid(H2D_DG_INNER_EDGE_INT, true);
 
-      if(conversion_table_inverse.find(user_marker) == conversion_table_inverse.end())
+      std::map<std::string, int>::const_iterator it = tables->conversion_table_inverse.find(user_marker);
+      if(it == tables->conversion_table_inverse.end())
         return IntValid(-999, false);
 
-      return IntValid(conversion_table_inverse.find(user_marker)->second, true);
+      return IntValid(it->second, true);
     }
 
     Mesh::CurvedException::CurvedException(int elementId) : elementId(elementId)
@@ -18,7 +18,7 @@
 #include <string.h>
 #include "mesh_reader_exodusii.h"
 #include "mesh.h"
-#include <map>
+#include <algorithm>
 
 #ifdef WITH_EXODUSII
 #include <exodusII.h>
@@ -27,6 +27,8 @@ namespace Hermes
 {
   namespace Hermes2D
   {
+    extern unsigned g_mesh_seq;
+
     MeshReaderExodusII::MeshReaderExodusII()
     {
 #ifdef WITH_EXODUSII
@@ -39,24 +41,21 @@ namespace Hermes
     {
     }
 
-    struct Vertex
-    {
-      double x, y;
-    };
-
-    // needed for comparison of vertices inside std::map
-    struct VCompare
+    /// Orders the indices of the vertices lexicographically by their coordinates, so that duplicate vertices end up next to each other.
+    struct VertexIndexCompare
     {
-      bool operator()(Vertex a, Vertex b) const
+      VertexIndexCompare(const double* x, const double* y) : x(x), y(y) {}
+      bool operator()(int a, int b) const
       {
-        if(a.x < b.x) return true;
-        else if(a.x > b.x) return false;
-        else
-        {
-          if(a.y < b.y) return true;
-          return false;
-        }
+        if(x[a] < x[b]) return true;
+        else if(x[a] > x[b]) return false;
+        else if(y[a] < y[b]) return true;
+        else if(y[a] > y[b]) return false;
+        // Equal vertices are ordered by their indices, so that the first one of a group is the first one in the file.
+        return a < b;
       }
+      const double* x;
+      const double* y;
     };
 
     bool MeshReaderExodusII::load(const char *file_name, Mesh *mesh)
@@ -83,44 +82,62 @@ namespace Hermes
       double *y = new double[n_nodes];
       err = ex_get_coord(exoid, x, y, NULL);
 
-      // remove duplicate vertices and build renumbering map
-      std::map<Vertex, int, VCompare> vtx_list;        // map for eliminating duplicities
-      std::map<int, int> vmap;                // reindexing map
-      Hermes::vector<Vertex> vtx_arr;              // vertex array
-      int vid = 0;
+      // remove duplicate vertices and build renumbering map:
+      // sort the vertex indices by the coordinates, every vertex then refers to the first one of its group
+      // and the remaining vertices are numbered in the order of the file
+      int* sorted = new int[n_nodes];
+      for (int i = 0; i < n_nodes; i++)
+        sorted[i] = i;
+      std::sort(sorted, sorted + n_nodes, VertexIndexCompare(x, y));
+
+      int* vmap = new int[n_nodes];            // reindexing map (0-based Exodus index -> vertex)
       for (int i = 0; i < n_nodes; i++)
       {
-        int k;
-        Vertex v = { x[i], y[i] };
-        if(vtx_list.count(v) == 0)
-        {
-          vtx_arr.push_back(v);
-          k = vid++;
-          vtx_list[v] = k;
-        }
+        if(i > 0 && x[sorted[i]] == x[sorted[i - 1]] && y[sorted[i]] == y[sorted[i - 1]])
+          vmap[sorted[i]] = vmap[sorted[i - 1]];
         else
-          k = vtx_list[v];
-
-        vmap[i + 1] = k;
+          vmap[sorted[i]] = sorted[i];
       }
-      delete [] x;
-      delete [] y;
+      delete [] sorted;
+
+      mesh->free();
+
+      // initialize hash table
+      int size = 16;
+      while (size < 2*n_nodes) size *= 2;
+      mesh->init(size);
+      mesh->reserve(0, 2 * n_elems + n_nodes);
 
-      int n_vtx = vtx_arr.size();
-      double2 *vtx = new double2[n_vtx];
-      for (int i = 0; i < n_vtx; i++)
+      // create vertex nodes
+      int n_vtx = 0;
+      for (int i = 0; i < n_nodes; i++)
       {
-        vtx[i][0] = vtx_arr[i].x;
-        vtx[i][1] = vtx_arr[i].y;
+        if(vmap[i] != i)
+        {
+          vmap[i] = vmap[vmap[i]];
+          continue;
+        }
+        Node* node = mesh->nodes.add();
+        assert(node->id == n_vtx);
+        node->ref = TOP_LEVEL_REF;
+        node->type = HERMES_TYPE_VERTEX;
+        node->bnd = 0;
+        node->p1 = node->p2 = -1;
+        node->x = x[i];
+        node->y = y[i];
+        vmap[i] = n_vtx++;
       }
-
-      int n_tri = 0;    // number of triangles
-      int n_quad = 0;    // number of quads
+      mesh->ntopvert = n_vtx;
+      delete [] x;
+      delete [] y;
 
       // get info about element blocks
       int *eid_blocks = new int[n_eblocks];
       err = ex_get_elem_blk_ids(exoid, eid_blocks);
-      // go over all element blocks
+
+      // go over all element blocks, the elements are created straight from the connectivity of the block,
+      // so that their ids are the Exodus ids (minus one) the side sets refer to
+      int n_els = 0;
       for (int i = 0; i < n_eblocks; i++)
       {
         int id = eid_blocks[i];
@@ -130,33 +147,14 @@ namespace Hermes
         int n_elems_in_blk, n_elem_nodes, n_attrs;
         err = ex_get_elem_block(exoid, id, elem_type, &n_elems_in_blk, &n_elem_nodes, &n_attrs);
 
-        if(n_elem_nodes == 3) n_tri += n_elems_in_blk;
-        else if(n_elem_nodes == 4) n_quad += n_elems_in_blk;
-        else
+        if(n_elem_nodes != 3 && n_elem_nodes != 4)
         {
-          delete [] vtx;
+          delete [] vmap;
+          delete [] eid_blocks;
+          ex_close(exoid);
           throw Hermes::Exceptions::Exception("Unknown type of element");
           return false;
         }
-      }
-      int3 *tri = n_tri > 0 ? new int3[n_tri] : NULL;    // triangles
-      std::string *tri_markers = n_tri > 0 ? new std::string[n_tri] : NULL;
-      int4 *quad = n_quad > 0 ? new int4[n_quad] : NULL;    // quads
-      std::string *quad_markers = n_quad > 0 ? new std::string[n_quad] : NULL;
-
-      int n_els = n_tri + n_quad;                // total number of elements
-      int **els = n_els > 0 ? new int *[n_els] : NULL;    // elements
-      int *el_nv = n_els > 0 ? new int[n_els] : NULL;    // number of vertices for each element
-
-      int it = 0, iq = 0, iel = 0;
-      for (int i = 0; i < n_eblocks; i++)
-      {
-        int id = eid_blocks[i];
-
-        // get block info
-        char elem_type[MAX_STR_LENGTH + 1];
-        int n_elems_in_blk, n_elem_nodes, n_attrs;
-        err = ex_get_elem_block(exoid, id, elem_type, &n_elems_in_blk, &n_elem_nodes, &n_attrs);
 
         // read connectivity array
         int *connect = new int[n_elem_nodes * n_elems_in_blk];
@@ -170,59 +168,30 @@ namespace Hermes
         // This functions check if the user-supplied marker on this element has been
         // already used, and if not, inserts it in the appropriate structure.
         mesh->element_markers_conversion.insert_marker(mesh->element_markers_conversion.min_marker_unused, el_marker);
+        int marker = mesh->element_markers_conversion.get_internal_marker(el_marker).marker;
 
         int ic = 0;
         for (int j = 0; j < n_elems_in_blk; j++)
         {
-          el_nv[iel] = n_elem_nodes;
           if(n_elem_nodes == 3)
-          {
-            tri[it][0] = vmap[connect[ic++]];
-            tri[it][1] = vmap[connect[ic++]];
-            tri[it][2] = vmap[connect[ic++]];
-            tri_markers[it] = el_marker;
-            els[iel] = tri[it];
-            it++;
-          }
-          else if(n_elem_nodes == 4)
-          {
-            quad[iq][0] = vmap[connect[ic++]];
-            quad[iq][1] = vmap[connect[ic++]];
-            quad[iq][2] = vmap[connect[ic++]];
-            quad[iq][3] = vmap[connect[ic++]];
-            quad_markers[iq] = el_marker;
-            els[iel] = quad[iq];
-            iq++;
-          }
+            mesh->create_triangle(marker, &mesh->nodes[vmap[connect[ic] - 1]], &mesh->nodes[vmap[connect[ic + 1] - 1]],
+              &mesh->nodes[vmap[connect[ic + 2] - 1]], NULL);
           else
-          {
-            delete [] vtx;
-            throw Hermes::Exceptions::Exception("Unknown type of element");
-            return false;
-          }
-          iel++;
+            mesh->create_quad(marker, &mesh->nodes[vmap[connect[ic] - 1]], &mesh->nodes[vmap[connect[ic + 1] - 1]],
+              &mesh->nodes[vmap[connect[ic + 2] - 1]], &mesh->nodes[vmap[connect[ic + 3] - 1]], NULL);
+          ic += n_elem_nodes;
+          n_els++;
         }
         delete [] connect;
       }
       delete [] eid_blocks;
+      delete [] vmap;
 
       // query number of side sets
       int *sid_blocks = new int[n_sidesets];
       err = ex_get_side_set_ids(exoid, sid_blocks);
 
       // go over the sidesets
-      int n_mark = 0;    // number of markers
-      for (int i = 0; i < n_sidesets; i++)
-      {
-        int sid = sid_blocks[i];
-        int n_sides_in_set, n_df_in_set;
-        err = ex_get_side_set_param(exoid, sid, &n_sides_in_set, &n_df_in_set);
-        n_mark += n_sides_in_set;
-      }
-      int2 *marks = new int2[n_mark];
-      std::string *bnd_markers = new std::string[n_mark];
-
-      int im = 0;
       for (int i = 0; i < n_sidesets; i++)
       {
         int sid = sid_blocks[i];
@@ -242,15 +211,28 @@ namespace Hermes
         // This functions check if the user-supplied marker on this element has been
         // already used, and if not, inserts it in the appropriate structure.
         mesh->boundary_markers_conversion.insert_marker(mesh->boundary_markers_conversion.min_marker_unused, bnd_marker);
+        int marker = mesh->boundary_markers_conversion.get_internal_marker(bnd_marker).marker;
 
         for (int j = 0; j < num_elem_in_set; j++)
         {
-          int nv = el_nv[side_list[j] - 1];      // # of vertices of the element
+          Element* e = mesh->get_element_fast(elem_list[j] - 1);
           int vt = side_list[j] - 1;
-          marks[im][0] = els[elem_list[j] - 1][vt];
-          marks[im][1] = els[elem_list[j] - 1][(vt + 1) % nv];
-          bnd_markers[im] = bnd_marker;
-          im++;
+          Node* v1 = e->vn[vt];
+          Node* v2 = e->vn[(vt + 1) % e->get_nvert()];
+          Node* en = mesh->peek_edge_node(v1->id, v2->id);
+          if(en == NULL)
+          {
+            delete [] elem_list;
+            delete [] side_list;
+            delete [] sid_blocks;
+            ex_close(exoid);
+            throw Hermes::Exceptions::Exception("Boundary data error (edge does not exist)");
+          }
+
+          en->marker = marker;
+          v1->bnd = 1;
+          v2->bnd = 1;
+          en->bnd = 1;
         }
 
         delete [] elem_list;
@@ -261,18 +243,8 @@ namespace Hermes
       // we are done
       err = ex_close(exoid);
 
-      mesh->create(n_vtx, vtx, n_tri, tri, tri_markers, n_quad, quad, quad_markers, n_mark, marks, bnd_markers);
-
-      // clean-up
-      delete [] marks;
-      delete [] tri;
-      delete [] quad;
-      delete [] tri_markers;
-      delete [] quad_markers;
-      delete [] bnd_markers;
-      delete [] vtx;
-      delete [] el_nv;
-      delete [] els;
+      mesh->nbase = mesh->nactive = mesh->ninitial = n_els;
+      mesh->seq = g_mesh_seq++;
 
       return true;
 #else
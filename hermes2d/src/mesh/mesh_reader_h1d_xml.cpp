@@ -14,6 +14,7 @@
 // along with Hermes2D; if not, see <http://www.gnu.prg/licenses/>.
 
 #include "mesh.h"
+#include "api2d.h"
 #include "mesh_reader_h1d_xml.h"
 #include <iostream>
 #include <limits>
@@ -38,11 +39,16 @@ namespace Hermes
 
       try
       {
-        ::xml_schema::flags parsing_flags = 0;
-        if(!this->validate)
-          parsing_flags = xml_schema::flags::dont_validate;
-
-        std::auto_ptr<XMLMesh1D::mesh> parsed_xml_mesh(XMLMesh1D::mesh_(filename, parsing_flags));
+        // Xerces is initialized by Hermes2DApi on the first use, for the whole process.
+        Hermes2DApi.initialize_xml();
+        std::auto_ptr<XMLMesh1D::mesh> parsed_xml_mesh;
+        if(this->validation_on())
+        {
+          ValidatedDocument document(filename);
+          parsed_xml_mesh = XMLMesh1D::mesh_(document.get(), xml_schema::flags::dont_initialize);
+        }
+        else
+          parsed_xml_mesh = XMLMesh1D::mesh_(filename, xml_schema::flags::dont_initialize | xml_schema::flags::dont_validate);
 
         // Variables //
         unsigned int variables_count = parsed_xml_mesh->variables().present() ? parsed_xml_mesh->variables()->var().size() : 0;
@@ -75,7 +81,6 @@ namespace Hermes
           node->type = HERMES_TYPE_VERTEX;
           node->bnd = 0;
           node->p1 = node->p2 = -1;
-          node->next_hash = NULL;
 
           // variables matching.
           std::string x = parsed_xml_mesh->v().at(vertices_i % vertices_count).x();
@@ -37,44 +37,66 @@ namespace Hermes
     {
       double dummy_dbl;
 
-      Nurbs* nurbs = new Nurbs;
-
       // Decide if curve is a circular arc or a general nurbs curve
       bool circle = (m->curv_nurbs[id] == false);
-      nurbs->arc = circle;
 
       // read the end point indices
       p1 = m->curv_first[id];
       p2 = m->curv_second[id];
 
+      // get the control points
+      std::vector<double> vCP;
+      if(!circle)
+      {
+        for (unsigned int i = 0; i < m->vars_[m->curv_inner_pts[id]].size(); ++i)
+        {
+          std::istringstream istr(m->vars_[m->curv_inner_pts[id]][i]);
+
+          if(!(istr >> dummy_dbl))
+            vCP.push_back(atof(m->vars_[m->vars_[m->curv_inner_pts[id]][i]][0].c_str()));
+          else
+            vCP.push_back(atof(m->vars_[m->curv_inner_pts[id]][i].c_str()));
+        }
+      }
+
+      // get the knot vector points
+      std::vector<double> vKnots;
+      if(!circle)
+      {
+        for (unsigned int i = 0; i < m->vars_[m->curv_knots[id]].size(); ++i)
+        {
+          std::istringstream istr(m->vars_[m->curv_knots[id]][i]);
+
+          if(!(istr >> dummy_dbl))
+            vKnots.push_back(atof(m->vars_[m->vars_[m->curv_knots[id]][i]][0].c_str()));
+          else
+            vKnots.push_back(atof(m->vars_[m->curv_knots[id]][i].c_str()));
+        }
+      }
+
+      return create_nurbs(mesh, id, en, p1, p2, circle, m->curv_third[id], vCP, vKnots);
+    }
+
+    Nurbs* MeshReaderH2D::create_nurbs(Mesh *mesh, int id, Node** en, int p1, int p2, bool circle, double third, std::vector<double>& vCP, std::vector<double>& vKnots)
+    {
       *en = mesh->peek_edge_node(p1, p2);
       if(*en == NULL)
         throw Hermes::Exceptions::MeshLoadFailureException("Curve #%d: edge %d-%d does not exist.", id, p1, p2);
 
+      Nurbs* nurbs = new Nurbs;
+      nurbs->arc = circle;
+
       // degree of curved edge
       nurbs->degree = 2;
       if(!circle)
       {
-        nurbs->degree = m->curv_third[id];
+        nurbs->degree = third;
       }
 
       // get the number of control points
-      std::vector<double> vCP;
-
       int inner = 1, outer;
       if(!circle)
-      {
-        for (unsigned int i = 0; i < m->vars_[m->curv_inner_pts[id]].size(); ++i)
-        {
-          std::istringstream istr(m->vars_[m->curv_inner_pts[id]][i]);
-
-          if(!(istr >> dummy_dbl))
-            vCP.push_back(atof(m->vars_[m->vars_[m->curv_inner_pts[id]][i]][0].c_str()));
-          else
-            vCP.push_back(atof(m->vars_[m->curv_inner_pts[id]][i].c_str()));
-        }
         inner = vCP.size()/3;
-      }
       nurbs->np = inner + 2;
 
       // edge endpoints are also control points, with weight 1.0
@@ -100,7 +122,7 @@ namespace Hermes
       else
       {
         // read the arc angle
-        nurbs->angle = m->curv_third[id];
+        nurbs->angle = third;
         double a = (180.0 - nurbs->angle) / 180.0 * M_PI;
 
         // generate one control point
@@ -111,27 +133,18 @@ namespace Hermes
       }
 
       // get the number of knot vector points
-      std::vector<double> vKnots;
-
       inner = 0;
       if(!circle)
-      {
-        for (unsigned int i = 0; i < m->vars_[m->curv_knots[id]].size(); ++i)
-        {
-          std::istringstream istr(m->vars_[m->curv_knots[id]][i]);
-
-          if(!(istr >> dummy_dbl))
-            vKnots.push_back(atof(m->vars_[m->vars_[m->curv_knots[id]][i]][0].c_str()));
-          else
-            vKnots.push_back(atof(m->vars_[m->curv_knots[id]][i].c_str()));
-        }
         inner = vKnots.size();
-      }
 
       nurbs->nk = nurbs->degree + nurbs->np + 1;
       outer = nurbs->nk - inner;
       if((outer & 1) == 1)
+      {
+        delete [] nurbs->pt;
+        delete nurbs;
         throw Hermes::Exceptions::MeshLoadFailureException("Curve #%d: incorrect number of knot points.", id);
+      }
 
       // knot vector is completed by 0.0 on the left and by 1.0 on the right
       nurbs->kv = new double[nurbs->nk];
@@ -153,6 +166,550 @@ namespace Hermes
       return nurbs;
     }
 
+    void MeshReaderH2D::assign_nurbs(Mesh *mesh, Node* en, Nurbs* nurbs, int p1)
+    {
+      // assign the nurbs to the elements sharing the edge node
+      for (int k = 0; k < 2; k++)
+      {
+        Element* e = en->elem[k];
+        if(e == NULL) continue;
+
+        if(e->cm == NULL)
+        {
+          e->cm = new CurvMap;
+          memset(e->cm, 0, sizeof(CurvMap));
+          e->cm->toplevel = 1;
+          e->cm->order = 4;
+        }
+
+        int idx = -1;
+        for (unsigned j = 0; j < e->get_nvert(); j++)
+          if(e->en[j] == en) { idx = j; break; }
+          assert(idx >= 0);
+
+          if(e->vn[idx]->id == p1)
+          {
+            e->cm->nurbs[idx] = nurbs;
+            nurbs->ref++;
+          }
+          else
+          {
+            Nurbs* nurbs_rev = mesh->reverse_nurbs(nurbs);
+            e->cm->nurbs[idx] = nurbs_rev;
+            nurbs_rev->ref++;
+          }
+      }
+      if(!nurbs->ref) delete nurbs;
+    }
+
+    /// The tokens of the .mesh files, for MeshReaderH2D::load_fast().
+    /// Commas and semicolons are separators, '#' starts a comment till the end of the line, both kinds
+    /// of the brackets open / close a list.
+    class MeshReaderH2DTokenizer
+    {
+    public:
+      enum TokenType
+      {
+        TOKEN_END,
+        TOKEN_NUMBER,
+        TOKEN_NAME,
+        TOKEN_STRING,
+        TOKEN_ASSIGN,
+        TOKEN_OPEN,
+        TOKEN_CLOSE,
+        TOKEN_UNKNOWN
+      };
+
+      /// The buffer has to be terminated by '\0'.
+      MeshReaderH2DTokenizer(const char* buffer) : pos(buffer)
+      {
+        advance();
+      }
+
+      void advance()
+      {
+        while(true)
+        {
+          if(*pos == ' ' || *pos == '\t' || *pos == '\n' || *pos == '\r' || *pos == ',' || *pos == ';')
+            pos++;
+          else if(*pos == '#')
+          {
+            while(*pos != '\0' && *pos != '\n')
+              pos++;
+          }
+          else
+            break;
+        }
+
+        text = pos;
+        length = 1;
+        switch(*pos)
+        {
+        case '\0':
+          type = TOKEN_END;
+          length = 0;
+          return;
+        case '=':
+          type = TOKEN_ASSIGN;
+          pos++;
+          return;
+        case '[':
+        case '{':
+          type = TOKEN_OPEN;
+          pos++;
+          return;
+        case ']':
+        case '}':
+          type = TOKEN_CLOSE;
+          pos++;
+          return;
+        case '"':
+          text = ++pos;
+          while(*pos != '\0' && *pos != '"' && *pos != '\n')
+            pos++;
+          length = pos - text;
+          if(*pos != '"')
+          {
+            type = TOKEN_UNKNOWN;
+            return;
+          }
+          pos++;
+          type = TOKEN_STRING;
+          return;
+        }
+
+        if((*pos >= '0' && *pos <= '9') || *pos == '-' || *pos == '+' || *pos == '.')
+        {
+          char* end;
+          number = strtod(pos, &end);
+          length = end - pos;
+          type = (end != pos && is_delimiter(*end)) ? TOKEN_NUMBER : TOKEN_UNKNOWN;
+          pos = end;
+          return;
+        }
+
+        if(is_name_char(*pos) && !(*pos >= '0' && *pos <= '9'))
+        {
+          while(is_name_char(*pos))
+            pos++;
+          length = pos - text;
+          type = TOKEN_NAME;
+          return;
+        }
+
+        type = TOKEN_UNKNOWN;
+      }
+
+      std::string get_text() const
+      {
+        return std::string(text, length);
+      }
+
+      TokenType type;
+      /// The text of the token, without the quotes of a string.
+      const char* text;
+      size_t length;
+      /// The value of a TOKEN_NUMBER.
+      double number;
+
+    protected:
+      static bool is_name_char(char c)
+      {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+      }
+
+      static bool is_delimiter(char c)
+      {
+        return c == '\0' || c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == ',' || c == ';' || c == '#' || c == '=' || c == ']' || c == '}';
+      }
+
+      const char* pos;
+    };
+
+    /// Reads a number, given directly or by a variable.
+    static bool read_mesh_number(MeshReaderH2DTokenizer& t, std::map<std::string, double>& variables, double& value)
+    {
+      if(t.type == MeshReaderH2DTokenizer::TOKEN_NUMBER)
+        value = t.number;
+      else if(t.type == MeshReaderH2DTokenizer::TOKEN_NAME)
+      {
+        std::map<std::string, double>::iterator it = variables.find(t.get_text());
+        if(it == variables.end())
+          return false;
+        value = it->second;
+      }
+      else
+        return false;
+      t.advance();
+      return true;
+    }
+
+    static bool read_mesh_int(MeshReaderH2DTokenizer& t, std::map<std::string, double>& variables, int& value)
+    {
+      double dbl_value;
+      if(!read_mesh_number(t, variables, dbl_value))
+        return false;
+      value = (int)dbl_value;
+      return value == dbl_value;
+    }
+
+    /// Reads a (nested) list of numbers into a flat one.
+    static bool read_mesh_number_list(MeshReaderH2DTokenizer& t, std::map<std::string, double>& variables, std::vector<double>& values)
+    {
+      if(t.type != MeshReaderH2DTokenizer::TOKEN_OPEN)
+        return false;
+      t.advance();
+      while(t.type != MeshReaderH2DTokenizer::TOKEN_CLOSE)
+      {
+        if(t.type == MeshReaderH2DTokenizer::TOKEN_OPEN)
+        {
+          if(!read_mesh_number_list(t, variables, values))
+            return false;
+        }
+        else
+        {
+          double value;
+          if(!read_mesh_number(t, variables, value))
+            return false;
+          values.push_back(value);
+        }
+      }
+      t.advance();
+      return true;
+    }
+
+    bool MeshReaderH2D::load_fast(const char *filename, Mesh *mesh)
+    {
+      // The whole file in one read.
+      FILE* f = fopen(filename, "rb");
+      if(f == NULL)
+        return false;
+      fseek(f, 0, SEEK_END);
+      long file_size = ftell(f);
+      fseek(f, 0, SEEK_SET);
+      if(file_size <= 0)
+      {
+        fclose(f);
+        return false;
+      }
+      std::vector<char> buffer(file_size + 1);
+      size_t read_size = fread(&buffer[0], 1, file_size, f);
+      fclose(f);
+      buffer[read_size] = '\0';
+
+      MeshReaderH2DTokenizer t(&buffer[0]);
+
+      // Variables, the lists are for the NURBS curves.
+      std::map<std::string, double> variables;
+      std::map<std::string, std::vector<double> > list_variables;
+
+      // The sections done: vertices (1), elements (2), curves (3), refinements (4).
+      int stage = 0;
+      bool boundaries_done = false;
+      int curves_count = 0;
+
+      while(t.type != MeshReaderH2DTokenizer::TOKEN_END)
+      {
+        if(t.type != MeshReaderH2DTokenizer::TOKEN_NAME)
+          return false;
+        std::string name = t.get_text();
+        t.advance();
+        if(t.type != MeshReaderH2DTokenizer::TOKEN_ASSIGN)
+          return false;
+        t.advance();
+
+        if(name == "vertices")
+        {
+          if(stage != 0 || t.type != MeshReaderH2DTokenizer::TOKEN_OPEN)
+            return false;
+          t.advance();
+
+          std::vector<double> coordinates;
+          while(t.type != MeshReaderH2DTokenizer::TOKEN_CLOSE)
+          {
+            double x, y;
+            if(t.type != MeshReaderH2DTokenizer::TOKEN_OPEN)
+              return false;
+            t.advance();
+            if(!read_mesh_number(t, variables, x) || !read_mesh_number(t, variables, y) || t.type != MeshReaderH2DTokenizer::TOKEN_CLOSE)
+              return false;
+            t.advance();
+            coordinates.push_back(x);
+            coordinates.push_back(y);
+          }
+          t.advance();
+
+          int n = coordinates.size() / 2;
+          if(n < 2) throw Hermes::Exceptions::MeshLoadFailureException("File %s: invalid number of vertices.", filename);
+
+          // create a hash table large enough
+          int size = HashTable::H2D_DEFAULT_HASH_SIZE;
+          while (size < 8*n) size *= 2;
+          mesh->init(size);
+
+          // create top-level vertex nodes
+          for (int i = 0; i < n; i++)
+          {
+            Node* node = mesh->nodes.add();
+            assert(node->id == i);
+            node->ref = TOP_LEVEL_REF;
+            node->type = HERMES_TYPE_VERTEX;
+            node->bnd = 0;
+            node->p1 = node->p2 = -1;
+            node->x = coordinates[2*i];
+            node->y = coordinates[2*i + 1];
+          }
+          mesh->ntopvert = n;
+          stage = 1;
+        }
+        else if(name == "elements")
+        {
+          if(stage != 1 || t.type != MeshReaderH2DTokenizer::TOKEN_OPEN)
+            return false;
+          t.advance();
+
+          mesh->nactive = 0;
+          int i = 0;
+          for(; t.type != MeshReaderH2DTokenizer::TOKEN_CLOSE; i++)
+          {
+            if(t.type != MeshReaderH2DTokenizer::TOKEN_OPEN)
+              return false;
+            t.advance();
+
+            // The vertex indices, the last entry is the marker, i.e. an entry is known to be an index
+            // once the next one is read.
+            int idx[4];
+            int nv = 0;
+            bool has_entry = false;
+            MeshReaderH2DTokenizer::TokenType entry_type = MeshReaderH2DTokenizer::TOKEN_UNKNOWN;
+            const char* entry_text = NULL;
+            size_t entry_length = 0;
+            double entry_number = 0.0;
+            while(t.type != MeshReaderH2DTokenizer::TOKEN_CLOSE)
+            {
+              if(has_entry)
+              {
+                if(nv == 4)
+                  return false;
+                if(entry_type == MeshReaderH2DTokenizer::TOKEN_NAME)
+                {
+                  std::map<std::string, double>::iterator it = variables.find(std::string(entry_text, entry_length));
+                  if(it == variables.end())
+                    return false;
+                  entry_number = it->second;
+                }
+                else if(entry_type != MeshReaderH2DTokenizer::TOKEN_NUMBER)
+                  return false;
+                idx[nv] = (int)entry_number;
+                if(idx[nv] != entry_number)
+                  return false;
+                nv++;
+              }
+              if(t.type != MeshReaderH2DTokenizer::TOKEN_NUMBER && t.type != MeshReaderH2DTokenizer::TOKEN_NAME && t.type != MeshReaderH2DTokenizer::TOKEN_STRING)
+                return false;
+              has_entry = true;
+              entry_type = t.type;
+              entry_text = t.text;
+              entry_length = t.length;
+              entry_number = t.number;
+              t.advance();
+            }
+            t.advance();
+
+            if(!has_entry)
+            {
+              mesh->elements.skip_slot();
+              continue;
+            }
+            std::string el_marker(entry_text, entry_length);
+            if(nv < 3)
+              throw Hermes::Exceptions::MeshLoadFailureException("File %s: element #%d: wrong number of vertex indices.", filename, i);
+
+            for (int j = 0; j < nv; j++)
+              if(idx[j] < 0 || idx[j] >= mesh->ntopvert)
+                throw Hermes::Exceptions::MeshLoadFailureException("File %s: error creating element #%d: vertex #%d does not exist.", filename, i, idx[j]);
+
+            Node *v0 = &mesh->nodes[idx[0]], *v1 = &mesh->nodes[idx[1]], *v2 = &mesh->nodes[idx[2]];
+
+            mesh->element_markers_conversion.insert_marker(mesh->element_markers_conversion.min_marker_unused, el_marker);
+            int marker = mesh->element_markers_conversion.get_internal_marker(el_marker).marker;
+
+            if(nv == 3)
+            {
+              Mesh::check_triangle(i, v0, v1, v2);
+              mesh->create_triangle(marker, v0, v1, v2, NULL);
+            }
+            else
+            {
+              Node *v3 = &mesh->nodes[idx[3]];
+              Mesh::check_quad(i, v0, v1, v2, v3);
+              mesh->create_quad(marker, v0, v1, v2, v3, NULL);
+            }
+
+            mesh->nactive++;
+          }
+          t.advance();
+
+          if(i < 1) throw Hermes::Exceptions::MeshLoadFailureException("File %s: no elements defined.", filename);
+          mesh->nbase = i;
+          stage = 2;
+        }
+        else if(name == "boundaries")
+        {
+          if(stage < 2 || stage > 3 || boundaries_done || t.type != MeshReaderH2DTokenizer::TOKEN_OPEN)
+            return false;
+          t.advance();
+
+          for(int i = 0; t.type != MeshReaderH2DTokenizer::TOKEN_CLOSE; i++)
+          {
+            int v1, v2;
+            if(t.type != MeshReaderH2DTokenizer::TOKEN_OPEN)
+              return false;
+            t.advance();
+            if(!read_mesh_int(t, variables, v1) || !read_mesh_int(t, variables, v2))
+              return false;
+            if(t.type != MeshReaderH2DTokenizer::TOKEN_NUMBER && t.type != MeshReaderH2DTokenizer::TOKEN_NAME && t.type != MeshReaderH2DTokenizer::TOKEN_STRING)
+              return false;
+            std::string bnd_marker = t.get_text();
+            t.advance();
+            if(t.type != MeshReaderH2DTokenizer::TOKEN_CLOSE)
+              return false;
+            t.advance();
+
+            Node* en = mesh->peek_edge_node(v1, v2);
+            if(en == NULL)
+              throw Hermes::Exceptions::MeshLoadFailureException("File %s: boundary data #%d: edge %d-%d does not exist", filename, i, v1, v2);
+
+            mesh->boundary_markers_conversion.insert_marker(mesh->boundary_markers_conversion.min_marker_unused, bnd_marker);
+            int marker = mesh->boundary_markers_conversion.get_internal_marker(bnd_marker).marker;
+
+            en->marker = marker;
+
+            // This is extremely important, as in DG, it is assumed that negative boundary markers are reserved
+            // for the inner edges.
+            if(marker > 0)
+            {
+              mesh->nodes[v1].bnd = 1;
+              mesh->nodes[v2].bnd = 1;
+              en->bnd = 1;
+            }
+          }
+          t.advance();
+          boundaries_done = true;
+        }
+        else if(name == "curves")
+        {
+          if(stage != 2 || t.type != MeshReaderH2DTokenizer::TOKEN_OPEN)
+            return false;
+          t.advance();
+
+          while(t.type != MeshReaderH2DTokenizer::TOKEN_CLOSE)
+          {
+            int p1, p2;
+            double third;
+            if(t.type != MeshReaderH2DTokenizer::TOKEN_OPEN)
+              return false;
+            t.advance();
+            if(!read_mesh_int(t, variables, p1) || !read_mesh_int(t, variables, p2) || !read_mesh_number(t, variables, third))
+              return false;
+
+            // The control points and the knots of a NURBS, given by the list variables or directly.
+            bool circle = (t.type == MeshReaderH2DTokenizer::TOKEN_CLOSE);
+            std::vector<double> vCP, vKnots;
+            for(int list_i = 0; !circle && list_i < 2; list_i++)
+            {
+              std::vector<double>& values = (list_i == 0) ? vCP : vKnots;
+              if(t.type == MeshReaderH2DTokenizer::TOKEN_NAME)
+              {
+                std::map<std::string, std::vector<double> >::iterator it = list_variables.find(t.get_text());
+                if(it == list_variables.end())
+                  return false;
+                values = it->second;
+                t.advance();
+              }
+              else if(!read_mesh_number_list(t, variables, values))
+                return false;
+            }
+            if(t.type != MeshReaderH2DTokenizer::TOKEN_CLOSE)
+              return false;
+            t.advance();
+
+            Node* en;
+            Nurbs* nurbs = create_nurbs(mesh, curves_count++, &en, p1, p2, circle, third, vCP, vKnots);
+            assign_nurbs(mesh, en, nurbs, p1);
+          }
+          t.advance();
+          stage = 3;
+        }
+        else if(name == "refinements")
+        {
+          if(stage < 2 || stage > 3 || t.type != MeshReaderH2DTokenizer::TOKEN_OPEN)
+            return false;
+          t.advance();
+
+          // The curves are complete.
+          Element* e;
+          for_all_elements(e, mesh)
+            if(e->cm != NULL)
+              e->cm->update_refmap_coeffs(e);
+          stage = 4;
+
+          while(t.type != MeshReaderH2DTokenizer::TOKEN_CLOSE)
+          {
+            int id, ref;
+            if(t.type != MeshReaderH2DTokenizer::TOKEN_OPEN)
+              return false;
+            t.advance();
+            if(!read_mesh_int(t, variables, id) || !read_mesh_int(t, variables, ref) || t.type != MeshReaderH2DTokenizer::TOKEN_CLOSE)
+              return false;
+            t.advance();
+            mesh->refine_element_id(id, ref);
+          }
+          t.advance();
+        }
+        else
+        {
+          // A variable, a number or a list of numbers.
+          if(stage != 0 && stage != 1 && stage != 2)
+            return false;
+          if(t.type == MeshReaderH2DTokenizer::TOKEN_OPEN)
+          {
+            std::vector<double> values;
+            if(!read_mesh_number_list(t, variables, values))
+              return false;
+            if(!values.empty())
+              variables[name] = values[0];
+            list_variables[name] = values;
+          }
+          else
+          {
+            double value;
+            if(!read_mesh_number(t, variables, value))
+              return false;
+            variables[name] = value;
+          }
+        }
+      }
+
+      if(stage < 2)
+        return false;
+
+      // update refmap coeffs of curvilinear elements
+      if(stage < 4)
+      {
+        Element* e;
+        for_all_elements(e, mesh)
+          if(e->cm != NULL)
+            e->cm->update_refmap_coeffs(e);
+      }
+
+      mesh->ninitial = mesh->elements.get_num_items();
+
+      mesh->seq = g_mesh_seq++;
+      mesh->initial_single_check();
+      return true;
+    }
+
     bool MeshReaderH2D::load(const char *filename, Mesh *mesh)
     {
       // Check if file exists
@@ -161,11 +718,21 @@ namespace Hermes
         throw Hermes::Exceptions::MeshLoadFailureException("Mesh file not found.");
       s.close();
 
-      int i, j, k, n;
-      Node* en;
-      bool debug = false;
+      mesh->free();
+
+      int element_min_marker_unused = mesh->element_markers_conversion.min_marker_unused;
+      int boundary_min_marker_unused = mesh->boundary_markers_conversion.min_marker_unused;
+      if(load_fast(filename, mesh))
+        return true;
 
+      // The generic parser, from scratch.
       mesh->free();
+      mesh->element_markers_conversion.min_marker_unused = element_min_marker_unused;
+      mesh->boundary_markers_conversion.min_marker_unused = boundary_min_marker_unused;
+
+      int i, j, n;
+      Node* en;
+      bool debug = false;
 
       std::string fName(filename);
       MeshData m(fName);
@@ -191,7 +758,6 @@ namespace Hermes
         node->type = HERMES_TYPE_VERTEX;
         node->bnd = 0;
         node->p1 = node->p2 = -1;
-        node->next_hash = NULL;
         node->x = m.x_vertex[i];
         node->y = m.y_vertex[i];
       }
@@ -324,38 +890,7 @@ namespace Hermes
 
           Nurbs* nurbs = load_nurbs(mesh, &m, i, &en, p1, p2);
 
-          // assign the nurbs to the elements sharing the edge node
-          for (k = 0; k < 2; k++)
-          {
-            Element* e = en->elem[k];
-            if(e == NULL) continue;
-
-            if(e->cm == NULL)
-            {
-              e->cm = new CurvMap;
-              memset(e->cm, 0, sizeof(CurvMap));
-              e->cm->toplevel = 1;
-              e->cm->order = 4;
-            }
-
-            int idx = -1;
-            for (unsigned j = 0; j < e->get_nvert(); j++)
-              if(e->en[j] == en) { idx = j; break; }
-              assert(idx >= 0);
-
-              if(e->vn[idx]->id == p1)
-              {
-                e->cm->nurbs[idx] = nurbs;
-                nurbs->ref++;
-              }
-              else
-              {
-                Nurbs* nurbs_rev = mesh->reverse_nurbs(nurbs);
-                e->cm->nurbs[idx] = nurbs_rev;
-                nurbs_rev->ref++;
-              }
-          }
-          if(!nurbs->ref) delete nurbs;
+          assign_nurbs(mesh, en, nurbs, p1);
         }
       }
 
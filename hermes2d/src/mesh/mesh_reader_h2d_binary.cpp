@@ -0,0 +1,509 @@
+// This file is part of Hermes2D
+//
+// Hermes2D is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D; if not, see <http://www.gnu.prg/licenses/>.
+
+#include <string.h>
+#include <map>
+#include "mesh.h"
+#include "mesh_reader_h2d_binary.h"
+#ifndef _MSC_VER
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    extern unsigned g_mesh_seq;
+
+    static const char H2D_BINARY_MAGIC[8] = { 'H', '2', 'D', 'B', 'M', 'S', 'H', '\0' };
+    static const int H2D_BINARY_VERSION = 1;
+    static const int H2D_BINARY_BYTE_ORDER = 0x01020304;
+
+    /// Integers per element: four vertices (the fourth -1 for triangles, the first -1 for unused slots) and the marker index.
+    static const int H2D_BINARY_ELEMENT_SIZE = 5;
+    /// Integers per boundary edge: two vertices and the marker index.
+    static const int H2D_BINARY_BOUNDARY_SIZE = 3;
+    /// Integers per curve: two vertices, degree, number of control points, knot vector length and the arc flag.
+    static const int H2D_BINARY_CURVE_SIZE = 6;
+
+    /// Sections start at multiples of 8 bytes, so that the doubles in a mapped file are aligned.
+    static size_t binary_padded(size_t size)
+    {
+      return (size + 7) & ~((size_t)7);
+    }
+
+    static void binary_write(FILE* f, const void* data, size_t size)
+    {
+      static const char zeros[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+      if(size > 0 && fwrite(data, 1, size, f) != size)
+        throw Hermes::Exceptions::Exception("Could not write the binary mesh file.");
+      if(binary_padded(size) > size && fwrite(zeros, 1, binary_padded(size) - size, f) != binary_padded(size) - size)
+        throw Hermes::Exceptions::Exception("Could not write the binary mesh file.");
+    }
+
+    /// Returns the next section of the mapped file, checks that it fits in.
+    static const char* binary_section(const char* filename, const char* data, size_t file_size, size_t& offset, size_t size)
+    {
+      if(offset + size > file_size)
+        throw Hermes::Exceptions::MeshLoadFailureException("File %s: the binary mesh file is truncated.", filename);
+      const char* section = data + offset;
+      offset += binary_padded(size);
+      return section;
+    }
+
+    MeshReaderH2DBinary::MeshReaderH2DBinary()
+    {
+    }
+
+    MeshReaderH2DBinary::~MeshReaderH2DBinary()
+    {
+    }
+
+    bool MeshReaderH2DBinary::load(const char *filename, Mesh *mesh)
+    {
+#ifndef _MSC_VER
+      int fd = open(filename, O_RDONLY);
+      if(fd < 0)
+        throw Hermes::Exceptions::MeshLoadFailureException("Mesh file not found.");
+      struct stat file_stat;
+      if(fstat(fd, &file_stat) < 0 || file_stat.st_size == 0)
+      {
+        close(fd);
+        throw Hermes::Exceptions::MeshLoadFailureException("File %s: could not read the binary mesh file.", filename);
+      }
+      size_t size = (size_t)file_stat.st_size;
+      void* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      close(fd);
+      if(data == MAP_FAILED)
+        throw Hermes::Exceptions::MeshLoadFailureException("File %s: could not map the binary mesh file.", filename);
+
+      try
+      {
+        load_data(filename, (const char*)data, size, mesh);
+      }
+      catch(...)
+      {
+        munmap(data, size);
+        throw;
+      }
+      munmap(data, size);
+#else
+      FILE* f = fopen(filename, "rb");
+      if(f == NULL)
+        throw Hermes::Exceptions::MeshLoadFailureException("Mesh file not found.");
+      fseek(f, 0, SEEK_END);
+      size_t size = (size_t)ftell(f);
+      fseek(f, 0, SEEK_SET);
+      char* data = new char[size + 1];
+      size_t read = fread(data, 1, size, f);
+      fclose(f);
+      if(read != size)
+      {
+        delete [] data;
+        throw Hermes::Exceptions::MeshLoadFailureException("File %s: could not read the binary mesh file.", filename);
+      }
+
+      try
+      {
+        load_data(filename, data, size, mesh);
+      }
+      catch(...)
+      {
+        delete [] data;
+        throw;
+      }
+      delete [] data;
+#endif
+      return true;
+    }
+
+    void MeshReaderH2DBinary::load_data(const char *filename, const char* data, size_t file_size, Mesh *mesh)
+    {
+      size_t offset = 0;
+      const Header* header = (const Header*)binary_section(filename, data, file_size, offset, sizeof(Header));
+      if(memcmp(header->magic, H2D_BINARY_MAGIC, sizeof(H2D_BINARY_MAGIC)))
+        throw Hermes::Exceptions::MeshLoadFailureException("File %s: not a binary Hermes2D mesh file.", filename);
+      if(header->byte_order != H2D_BINARY_BYTE_ORDER)
+        throw Hermes::Exceptions::MeshLoadFailureException("File %s: the binary mesh file was saved with a different byte order.", filename);
+      if(header->version != H2D_BINARY_VERSION)
+        throw Hermes::Exceptions::MeshLoadFailureException("File %s: unsupported version %d of the binary mesh file.", filename, header->version);
+      if(header->n_vertices < 2)
+        throw Hermes::Exceptions::MeshLoadFailureException("File %s: invalid number of vertices.", filename);
+      if(header->n_elements < 1)
+        throw Hermes::Exceptions::MeshLoadFailureException("File %s: no elements defined.", filename);
+      if(header->n_boundaries < 0 || header->n_curves < 0 || header->n_curve_doubles < 0 || header->n_refinements < 0
+        || header->n_element_markers < 0 || header->n_boundary_markers < 0 || header->n_marker_chars < 0)
+        throw Hermes::Exceptions::MeshLoadFailureException("File %s: corrupted header of the binary mesh file.", filename);
+
+      const double* vertices = (const double*)binary_section(filename, data, file_size, offset, 2 * header->n_vertices * sizeof(double));
+      const double* curve_doubles = (const double*)binary_section(filename, data, file_size, offset, header->n_curve_doubles * sizeof(double));
+      const int* elements = (const int*)binary_section(filename, data, file_size, offset, H2D_BINARY_ELEMENT_SIZE * header->n_elements * sizeof(int));
+      const int* boundaries = (const int*)binary_section(filename, data, file_size, offset, H2D_BINARY_BOUNDARY_SIZE * header->n_boundaries * sizeof(int));
+      const int* curves = (const int*)binary_section(filename, data, file_size, offset, H2D_BINARY_CURVE_SIZE * header->n_curves * sizeof(int));
+      const int* refinements = (const int*)binary_section(filename, data, file_size, offset, 2 * header->n_refinements * sizeof(int));
+      const int* marker_lengths = (const int*)binary_section(filename, data, file_size, offset, (header->n_element_markers + header->n_boundary_markers) * sizeof(int));
+      const char* marker_chars = binary_section(filename, data, file_size, offset, header->n_marker_chars);
+
+      mesh->free();
+
+      //// markers /////////////////////////////////////////////////////////////////
+      // This is done once for every marker name, the elements and the edges refer to the names by their indices.
+      std::vector<int> element_markers(header->n_element_markers), boundary_markers(header->n_boundary_markers);
+      int chars_read = 0;
+      for (int i = 0; i < header->n_element_markers + header->n_boundary_markers; i++)
+      {
+        if(marker_lengths[i] < 0 || chars_read + marker_lengths[i] > header->n_marker_chars)
+          throw Hermes::Exceptions::MeshLoadFailureException("File %s: corrupted marker names in the binary mesh file.", filename);
+        std::string marker(marker_chars + chars_read, marker_lengths[i]);
+        chars_read += marker_lengths[i];
+        if(i < header->n_element_markers)
+        {
+          mesh->element_markers_conversion.insert_marker(mesh->element_markers_conversion.min_marker_unused, marker);
+          element_markers[i] = mesh->element_markers_conversion.get_internal_marker(marker).marker;
+        }
+        else
+        {
+          mesh->boundary_markers_conversion.insert_marker(mesh->boundary_markers_conversion.min_marker_unused, marker);
+          boundary_markers[i - header->n_element_markers] = mesh->boundary_markers_conversion.get_internal_marker(marker).marker;
+        }
+      }
+
+      //// vertices ////////////////////////////////////////////////////////////////
+      int n = header->n_vertices;
+
+      // create a hash table large enough
+      int size = HashTable::H2D_DEFAULT_HASH_SIZE;
+      while (size < 8*n) size *= 2;
+      mesh->init(size);
+
+      // create top-level vertex nodes
+      for (int i = 0; i < n; i++)
+      {
+        Node* node = mesh->nodes.add();
+        assert(node->id == i);
+        node->ref = TOP_LEVEL_REF;
+        node->type = HERMES_TYPE_VERTEX;
+        node->bnd = 0;
+        node->p1 = node->p2 = -1;
+        node->x = vertices[2 * i];
+        node->y = vertices[2 * i + 1];
+      }
+      mesh->ntopvert = n;
+
+      //// elements ////////////////////////////////////////////////////////////////
+      n = header->n_elements;
+      mesh->nactive = 0;
+      for (int i = 0; i < n; i++)
+      {
+        const int* idx = elements + H2D_BINARY_ELEMENT_SIZE * i;
+        if(idx[0] == -1)
+        {
+          mesh->elements.skip_slot();
+          continue;
+        }
+
+        int nv = (idx[3] == -1) ? 3 : 4;
+        for (int j = 0; j < nv; j++)
+          if(idx[j] < 0 || idx[j] >= mesh->ntopvert)
+            throw Hermes::Exceptions::MeshLoadFailureException("File %s: error creating element #%d: vertex #%d does not exist.", filename, i, idx[j]);
+        if(idx[4] < 0 || idx[4] >= header->n_element_markers)
+          throw Hermes::Exceptions::MeshLoadFailureException("File %s: element #%d: wrong marker.", filename, i);
+
+        Node *v0 = &mesh->nodes[idx[0]], *v1 = &mesh->nodes[idx[1]], *v2 = &mesh->nodes[idx[2]];
+        if(nv == 3)
+        {
+          Mesh::check_triangle(i, v0, v1, v2);
+          mesh->create_triangle(element_markers[idx[4]], v0, v1, v2, NULL);
+        }
+        else
+        {
+          Node *v3 = &mesh->nodes[idx[3]];
+          Mesh::check_quad(i, v0, v1, v2, v3);
+          mesh->create_quad(element_markers[idx[4]], v0, v1, v2, v3, NULL);
+        }
+
+        mesh->nactive++;
+      }
+      mesh->nbase = n;
+
+      //// boundaries //////////////////////////////////////////////////////////////
+      for (int i = 0; i < header->n_boundaries; i++)
+      {
+        const int* bdy = boundaries + H2D_BINARY_BOUNDARY_SIZE * i;
+        int v1 = bdy[0], v2 = bdy[1];
+        if(v1 < 0 || v1 >= mesh->ntopvert || v2 < 0 || v2 >= mesh->ntopvert || bdy[2] < 0 || bdy[2] >= header->n_boundary_markers)
+          throw Hermes::Exceptions::MeshLoadFailureException("File %s: boundary data #%d: wrong vertices or marker.", filename, i);
+
+        Node* en = mesh->peek_edge_node(v1, v2);
+        if(en == NULL)
+          throw Hermes::Exceptions::MeshLoadFailureException("File %s: boundary data #%d: edge %d-%d does not exist", filename, i, v1, v2);
+
+        int marker = boundary_markers[bdy[2]];
+        en->marker = marker;
+
+        // This is extremely important, as in DG, it is assumed that negative boundary markers are reserved
+        // for the inner edges.
+        if(marker > 0)
+        {
+          mesh->nodes[v1].bnd = 1;
+          mesh->nodes[v2].bnd = 1;
+          en->bnd = 1;
+        }
+      }
+
+      //// curves //////////////////////////////////////////////////////////////////
+      int curve_doubles_read = 0;
+      for (int i = 0; i < header->n_curves; i++)
+      {
+        const int* curve = curves + H2D_BINARY_CURVE_SIZE * i;
+        int p1 = curve[0], p2 = curve[1];
+        int np = curve[3], nk = curve[4];
+        if(np < 2 || nk < 1 || curve_doubles_read + 1 + 3 * np + nk > header->n_curve_doubles)
+          throw Hermes::Exceptions::MeshLoadFailureException("File %s: curve #%d: corrupted data.", filename, i);
+
+        Node* en = mesh->peek_edge_node(p1, p2);
+        if(en == NULL)
+          throw Hermes::Exceptions::MeshLoadFailureException("Curve #%d: edge %d-%d does not exist.", i, p1, p2);
+
+        Nurbs* nurbs = new Nurbs;
+        nurbs->degree = curve[2];
+        nurbs->np = np;
+        nurbs->nk = nk;
+        nurbs->arc = (curve[5] != 0);
+        const double* values = curve_doubles + curve_doubles_read;
+        nurbs->angle = values[0];
+        nurbs->pt = new double3[np];
+        memcpy(nurbs->pt, values + 1, 3 * np * sizeof(double));
+        nurbs->kv = new double[nk];
+        memcpy(nurbs->kv, values + 1 + 3 * np, nk * sizeof(double));
+        curve_doubles_read += 1 + 3 * np + nk;
+
+        // assign the nurbs to the elements sharing the edge node
+        for (int k = 0; k < 2; k++)
+        {
+          Element* e = en->elem[k];
+          if(e == NULL) continue;
+
+          if(e->cm == NULL)
+          {
+            e->cm = new CurvMap;
+            memset(e->cm, 0, sizeof(CurvMap));
+            e->cm->toplevel = 1;
+            e->cm->order = 4;
+          }
+
+          int idx = -1;
+          for (unsigned j = 0; j < e->get_nvert(); j++)
+            if(e->en[j] == en) { idx = j; break; }
+          assert(idx >= 0);
+
+          if(e->vn[idx]->id == p1)
+          {
+            e->cm->nurbs[idx] = nurbs;
+            nurbs->ref++;
+          }
+          else
+          {
+            Nurbs* nurbs_rev = mesh->reverse_nurbs(nurbs);
+            e->cm->nurbs[idx] = nurbs_rev;
+            nurbs_rev->ref++;
+          }
+        }
+        if(!nurbs->ref) delete nurbs;
+      }
+
+      // update refmap coeffs of curvilinear elements
+      Element* e;
+      for_all_elements(e, mesh)
+        if(e->cm != NULL)
+          e->cm->update_refmap_coeffs(e);
+
+      //// refinements /////////////////////////////////////////////////////////////
+      for (int i = 0; i < header->n_refinements; i++)
+        mesh->refine_element_id(refinements[2 * i], refinements[2 * i + 1]);
+      mesh->ninitial = mesh->elements.get_num_items();
+
+      mesh->seq = g_mesh_seq++;
+      mesh->initial_single_check();
+    }
+
+    void MeshReaderH2DBinary::save_refinements(Mesh *mesh, Element* e, int id, std::vector<int>& refinements)
+    {
+      if(e->active) return;
+      if(e->bsplit())
+      {
+        refinements.push_back(id);
+        refinements.push_back(0);
+        int sid = mesh->seq; mesh->seq += 4;
+        for (int i = 0; i < 4; i++)
+          save_refinements(mesh, e->sons[i], sid+i, refinements);
+      }
+      else if(e->hsplit())
+      {
+        refinements.push_back(id);
+        refinements.push_back(1);
+        int sid = mesh->seq; mesh->seq += 2;
+        save_refinements(mesh, e->sons[0], sid, refinements);
+        save_refinements(mesh, e->sons[1], sid+1, refinements);
+      }
+      else
+      {
+        refinements.push_back(id);
+        refinements.push_back(2);
+        int sid = mesh->seq; mesh->seq += 2;
+        save_refinements(mesh, e->sons[2], sid, refinements);
+        save_refinements(mesh, e->sons[3], sid+1, refinements);
+      }
+    }
+
+    bool MeshReaderH2DBinary::save(const char* filename, Mesh *mesh)
+    {
+      Element* e;
+
+      // marker names, numbered in the order of their first use
+      std::vector<std::string> marker_names;
+      std::map<int, int> element_marker_indices, boundary_marker_indices;
+
+      // elements
+      std::vector<int> elements(H2D_BINARY_ELEMENT_SIZE * mesh->get_num_base_elements(), -1);
+      for (int i = 0; i < mesh->get_num_base_elements(); i++)
+      {
+        e = mesh->get_element_fast(i);
+        if(!e->used)
+          continue;
+        for (unsigned int j = 0; j < e->get_nvert(); j++)
+          elements[H2D_BINARY_ELEMENT_SIZE * i + j] = e->vn[j]->id;
+        if(element_marker_indices.find(e->marker) == element_marker_indices.end())
+        {
+          int index = element_marker_indices.size();
+          element_marker_indices[e->marker] = index;
+          marker_names.push_back(mesh->get_element_markers_conversion().get_user_marker(e->marker).marker);
+        }
+        elements[H2D_BINARY_ELEMENT_SIZE * i + 4] = element_marker_indices[e->marker];
+      }
+      int n_element_markers = marker_names.size();
+
+      // boundary markers
+      std::vector<int> boundaries;
+      for_all_base_elements(e, mesh)
+        for (unsigned i = 0; i < e->get_nvert(); i++)
+        {
+          int mrk = mesh->get_base_edge_node(e, i)->marker;
+          if(mrk)
+          {
+            if(boundary_marker_indices.find(mrk) == boundary_marker_indices.end())
+            {
+              int index = boundary_marker_indices.size();
+              boundary_marker_indices[mrk] = index;
+              marker_names.push_back(mesh->boundary_markers_conversion.get_user_marker(mrk).marker);
+            }
+            boundaries.push_back(e->vn[i]->id);
+            boundaries.push_back(e->vn[e->next_vert(i)]->id);
+            boundaries.push_back(boundary_marker_indices[mrk]);
+          }
+        }
+
+      // curved edges
+      std::vector<int> curves;
+      std::vector<double> curve_doubles;
+      for_all_base_elements(e, mesh)
+        if(e->is_curved())
+          for (unsigned i = 0; i < e->get_nvert(); i++)
+            if(e->cm->nurbs[i] != NULL && !is_twin_nurbs(e, i))
+            {
+              Nurbs* nurbs = e->cm->nurbs[i];
+              curves.push_back(e->vn[i]->id);
+              curves.push_back(e->vn[e->next_vert(i)]->id);
+              curves.push_back(nurbs->degree);
+              curves.push_back(nurbs->np);
+              curves.push_back(nurbs->nk);
+              curves.push_back(nurbs->arc ? 1 : 0);
+              curve_doubles.push_back(nurbs->arc ? nurbs->angle : 0.0);
+              for (int j = 0; j < nurbs->np; j++)
+                for (int k = 0; k < 3; k++)
+                  curve_doubles.push_back(nurbs->pt[j][k]);
+              for (int j = 0; j < nurbs->nk; j++)
+                curve_doubles.push_back(nurbs->kv[j]);
+            }
+
+      // refinements
+      std::vector<int> refinements;
+      unsigned temp = mesh->seq;
+      mesh->seq = mesh->nbase;
+      for_all_base_elements(e, mesh)
+        save_refinements(mesh, e, e->id, refinements);
+      mesh->seq = temp;
+
+      // marker names
+      std::vector<int> marker_lengths;
+      std::string marker_chars;
+      for (unsigned int i = 0; i < marker_names.size(); i++)
+      {
+        marker_lengths.push_back(marker_names[i].length());
+        marker_chars += marker_names[i];
+      }
+
+      Header header;
+      memset(&header, 0, sizeof(Header));
+      memcpy(header.magic, H2D_BINARY_MAGIC, sizeof(H2D_BINARY_MAGIC));
+      header.version = H2D_BINARY_VERSION;
+      header.byte_order = H2D_BINARY_BYTE_ORDER;
+      header.n_vertices = mesh->ntopvert;
+      header.n_elements = mesh->get_num_base_elements();
+      header.n_boundaries = boundaries.size() / H2D_BINARY_BOUNDARY_SIZE;
+      header.n_curves = curves.size() / H2D_BINARY_CURVE_SIZE;
+      header.n_curve_doubles = curve_doubles.size();
+      header.n_refinements = refinements.size() / 2;
+      header.n_element_markers = n_element_markers;
+      header.n_boundary_markers = marker_names.size() - n_element_markers;
+      header.n_marker_chars = marker_chars.length();
+
+      std::vector<double> vertices(2 * mesh->ntopvert);
+      for (int i = 0; i < mesh->ntopvert; i++)
+      {
+        vertices[2 * i] = mesh->nodes[i].x;
+        vertices[2 * i + 1] = mesh->nodes[i].y;
+      }
+
+      // open output file
+      FILE* f = fopen(filename, "wb");
+      if(f == NULL) throw Hermes::Exceptions::MeshLoadFailureException("Could not create mesh file.");
+
+      try
+      {
+        binary_write(f, &header, sizeof(Header));
+        binary_write(f, vertices.empty() ? NULL : &vertices[0], vertices.size() * sizeof(double));
+        binary_write(f, curve_doubles.empty() ? NULL : &curve_doubles[0], curve_doubles.size() * sizeof(double));
+        binary_write(f, elements.empty() ? NULL : &elements[0], elements.size() * sizeof(int));
+        binary_write(f, boundaries.empty() ? NULL : &boundaries[0], boundaries.size() * sizeof(int));
+        binary_write(f, curves.empty() ? NULL : &curves[0], curves.size() * sizeof(int));
+        binary_write(f, refinements.empty() ? NULL : &refinements[0], refinements.size() * sizeof(int));
+        binary_write(f, marker_lengths.empty() ? NULL : &marker_lengths[0], marker_lengths.size() * sizeof(int));
+        binary_write(f, marker_chars.data(), marker_chars.length());
+      }
+      catch(...)
+      {
+        fclose(f);
+        throw;
+      }
+      fclose(f);
+
+      return true;
+    }
+  }
+}
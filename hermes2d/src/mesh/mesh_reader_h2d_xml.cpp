@@ -40,11 +40,16 @@ namespace Hermes
 
       try
       {
-        ::xml_schema::flags parsing_flags = 0;
-        if(!this->validate)
-          parsing_flags = xml_schema::flags::dont_validate;
-
-        std::auto_ptr<XMLMesh::mesh> parsed_xml_mesh(XMLMesh::mesh_(filename, parsing_flags));
+        // Xerces is initialized by Hermes2DApi on the first use, for the whole process.
+        Hermes2DApi.initialize_xml();
+        std::auto_ptr<XMLMesh::mesh> parsed_xml_mesh;
+        if(this->validation_on())
+        {
+          ValidatedDocument document(filename);
+          parsed_xml_mesh = XMLMesh::mesh_(document.get(), xml_schema::flags::dont_initialize);
+        }
+        else
+          parsed_xml_mesh = XMLMesh::mesh_(filename, xml_schema::flags::dont_initialize | xml_schema::flags::dont_validate);
 
         if(!load(parsed_xml_mesh, mesh, vertex_is))
           return false;
@@ -136,7 +141,8 @@ namespace Hermes
       namespace_info_map.insert(std::pair<std::basic_string<char>, xml_schema::namespace_info>("mesh", namespace_info_mesh));
 
       std::ofstream out(filename);
-      ::xml_schema::flags parsing_flags = ::xml_schema::flags::dont_pretty_print;
+      Hermes2DApi.initialize_xml();
+      ::xml_schema::flags parsing_flags = ::xml_schema::flags::dont_pretty_print | ::xml_schema::flags::dont_initialize;
       XMLMesh::mesh_(out, xmlmesh, namespace_info_map, "UTF-8", parsing_flags);
       out.close();
 
@@ -144,21 +150,39 @@ namespace Hermes
     }
 
     bool MeshReaderH2DXML::load(const char *filename, Hermes::vector<Mesh *> meshes)
+    {
+      return load_subdomains(filename, meshes, NULL);
+    }
+
+    bool MeshReaderH2DXML::load(const char *filename, Hermes::vector<Mesh *> meshes, Hermes::vector<std::string> subdomain_names)
+    {
+      if(subdomain_names.size() != meshes.size())
+        throw Hermes::Exceptions::LengthException(2, 3, meshes.size(), subdomain_names.size());
+      return load_subdomains(filename, meshes, &subdomain_names);
+    }
+
+    bool MeshReaderH2DXML::load_subdomains(const char *filename, Hermes::vector<Mesh *> meshes, Hermes::vector<std::string>* subdomain_names)
     {
       for(unsigned int meshes_i = 0; meshes_i < meshes.size(); meshes_i++)
       {
-        meshes.at(meshes_i)->free();
+        if(meshes.at(meshes_i) != NULL)
+          meshes.at(meshes_i)->free();
       }
 
       Mesh global_mesh;
 
       try
       {
-        ::xml_schema::flags parsing_flags = 0;
-        if(!this->validate)
-          parsing_flags = xml_schema::flags::dont_validate;
-
-        std::auto_ptr<XMLSubdomains::domain> parsed_xml_domain (XMLSubdomains::domain_(filename, parsing_flags));
+        // Xerces is initialized by Hermes2DApi on the first use, for the whole process.
+        Hermes2DApi.initialize_xml();
+        std::auto_ptr<XMLSubdomains::domain> parsed_xml_domain;
+        if(this->validation_on())
+        {
+          ValidatedDocument document(filename);
+          parsed_xml_domain = XMLSubdomains::domain_(document.get(), xml_schema::flags::dont_initialize);
+        }
+        else
+          parsed_xml_domain = XMLSubdomains::domain_(filename, xml_schema::flags::dont_initialize | xml_schema::flags::dont_validate);
 
         int* vertex_is = new int[H2D_MAX_NODE_ID];
         for(int i = 0; i < H2D_MAX_NODE_ID; i++)
@@ -190,11 +214,35 @@ namespace Hermes
 
         // Subdomains //
         unsigned int subdomains_count = parsed_xml_domain->subdomains().subdomain().size();
-        if(subdomains_count != meshes.size())
-          throw Hermes::Exceptions::MeshLoadFailureException("Number of subdomains( = %u) does not equal the number of provided meshes in the vector( = %u).", subdomains_count, meshes.size());
+
+        // The meshes of the subdomains, NULL for those not to be built.
+        std::vector<Mesh*> subdomain_meshes(subdomains_count, (Mesh*)NULL);
+        if(subdomain_names == NULL)
+        {
+          if(subdomains_count != meshes.size())
+            throw Hermes::Exceptions::MeshLoadFailureException("Number of subdomains( = %u) does not equal the number of provided meshes in the vector( = %u).", subdomains_count, meshes.size());
+          for(unsigned int subdomains_i = 0; subdomains_i < subdomains_count; subdomains_i++)
+            subdomain_meshes[subdomains_i] = meshes[subdomains_i];
+        }
+        else
+        {
+          for(unsigned int meshes_i = 0; meshes_i < meshes.size(); meshes_i++)
+          {
+            unsigned int subdomains_i = 0;
+            for(; subdomains_i < subdomains_count; subdomains_i++)
+              if(parsed_xml_domain->subdomains().subdomain().at(subdomains_i).name() == subdomain_names->at(meshes_i))
+                break;
+            if(subdomains_i == subdomains_count)
+              throw Hermes::Exceptions::MeshLoadFailureException("Subdomain %s not found in the mesh file.", subdomain_names->at(meshes_i).c_str());
+            subdomain_meshes[subdomains_i] = meshes[meshes_i];
+          }
+        }
 
         for(unsigned int subdomains_i = 0; subdomains_i < subdomains_count; subdomains_i++)
         {
+          if(subdomain_meshes[subdomains_i] == NULL)
+            continue;
+
           for (int element_i = 0; element_i < parsed_xml_domain->elements().el().size(); element_i++)
           {
             XMLSubdomains::domain::elements_type::el_type* element = &parsed_xml_domain->elements().el().at(element_i);
@@ -205,7 +253,7 @@ namespace Hermes
             element->m().erase(end + 1, element->m().length());
             element->m().erase(0, begin);
 
-            meshes[subdomains_i]->element_markers_conversion.insert_marker(meshes[subdomains_i]->element_markers_conversion.min_marker_unused, element->m());
+            subdomain_meshes[subdomains_i]->element_markers_conversion.insert_marker(subdomain_meshes[subdomains_i]->element_markers_conversion.min_marker_unused, element->m());
           }
           for(unsigned int edge_i = 0; edge_i < parsed_xml_domain->edges().ed().size(); edge_i++)
           {
@@ -217,12 +265,20 @@ namespace Hermes
             edge->m().erase(end + 1, edge->m().length());
             edge->m().erase(0, begin);
 
-            meshes[subdomains_i]->boundary_markers_conversion.insert_marker(meshes[subdomains_i]->boundary_markers_conversion.min_marker_unused, edge->m());
+            subdomain_meshes[subdomains_i]->boundary_markers_conversion.insert_marker(subdomain_meshes[subdomains_i]->boundary_markers_conversion.min_marker_unused, edge->m());
           }
         }
 
+        // The positions of the edges in the file by their numbers, instead of searching for each edge of each subdomain.
+        std::map<int, unsigned int> edge_positions;
+        for(unsigned int edge_i = 0; edge_i < parsed_xml_domain->edges().ed().size(); edge_i++)
+          edge_positions.insert(std::pair<int, unsigned int>(parsed_xml_domain->edges().ed().at(edge_i).i(), edge_i));
+
         for(unsigned int subdomains_i = 0; subdomains_i < subdomains_count; subdomains_i++)
         {
+          if(subdomain_meshes[subdomains_i] == NULL)
+            continue;
+
           unsigned int vertex_number_count = parsed_xml_domain->subdomains().subdomain().at(subdomains_i).vertices().present() ? parsed_xml_domain->subdomains().subdomain().at(subdomains_i).vertices()->i().size() : 0;
           unsigned int element_number_count = parsed_xml_domain->subdomains().subdomain().at(subdomains_i).elements().present() ? parsed_xml_domain->subdomains().subdomain().at(subdomains_i).elements()->i().size() : 0;
           unsigned int boundary_edge_number_count = parsed_xml_domain->subdomains().subdomain().at(subdomains_i).boundary_edges().present() ? parsed_xml_domain->subdomains().subdomain().at(subdomains_i).boundary_edges()->i().size() : 0;
@@ -231,7 +287,7 @@ namespace Hermes
           // copy the whole mesh if the subdomain is the whole mesh.
           if(element_number_count == 0 || element_number_count == parsed_xml_domain->elements().el().size())
           {
-            meshes[subdomains_i]->copy(&global_mesh);
+            subdomain_meshes[subdomains_i]->copy(&global_mesh);
             // refinements.
             if(parsed_xml_domain->subdomains().subdomain().at(subdomains_i).refinements().present() && parsed_xml_domain->subdomains().subdomain().at(subdomains_i).refinements()->ref().size() > 0)
             {
@@ -241,9 +297,9 @@ namespace Hermes
                 int element_id = parsed_xml_domain->subdomains().subdomain().at(subdomains_i).refinements()->ref().at(i).element_id();
                 int refinement_type = parsed_xml_domain->subdomains().subdomain().at(subdomains_i).refinements()->ref().at(i).refinement_type();
                 if(refinement_type == -1)
-                  meshes[subdomains_i]->unrefine_element_id(element_id);
+                  subdomain_meshes[subdomains_i]->unrefine_element_id(element_id);
                 else
-                  meshes[subdomains_i]->refine_element_id(element_id, refinement_type);
+                  subdomain_meshes[subdomains_i]->refine_element_id(element_id, refinement_type);
               }
             }
           }
@@ -267,7 +323,7 @@ namespace Hermes
             int size = HashTable::H2D_DEFAULT_HASH_SIZE;
             while (size < 8 * vertex_number_count)
               size *= 2;
-            meshes[subdomains_i]->init(size);
+            subdomain_meshes[subdomains_i]->init(size);
 
             // Create top-level vertex nodes.
             if(vertex_number_count == 0)
@@ -285,13 +341,12 @@ namespace Hermes
               }
 
               vertex_vertex_numbers.insert(std::pair<unsigned int, unsigned int>(vertex_number, vertex_numbers_i));
-              Node* node = meshes[subdomains_i]->nodes.add();
+              Node* node = subdomain_meshes[subdomains_i]->nodes.add();
               assert(node->id == vertex_numbers_i);
               node->ref = TOP_LEVEL_REF;
               node->type = HERMES_TYPE_VERTEX;
               node->bnd = 0;
               node->p1 = node->p2 = -1;
-              node->next_hash = NULL;
 
               // variables matching.
               std::string x = parsed_xml_domain->vertices().v().at(vertex_number).x();
@@ -350,12 +405,12 @@ namespace Hermes
                   node->x = x_value;
                   node->y = y_value;
             }
-            meshes[subdomains_i]->ntopvert = vertex_number_count;
+            subdomain_meshes[subdomains_i]->ntopvert = vertex_number_count;
 
             // Element numbers //
             unsigned int element_count = parsed_xml_domain->elements().el().size();
-            meshes[subdomains_i]->nbase = element_count;
-            meshes[subdomains_i]->nactive = meshes[subdomains_i]->ninitial = element_number_count;
+            subdomain_meshes[subdomains_i]->nbase = element_count;
+            subdomain_meshes[subdomains_i]->nactive = subdomain_meshes[subdomains_i]->ninitial = element_number_count;
 
             Element* e;
             int* elements_existing = new int[element_count];
@@ -379,36 +434,29 @@ namespace Hermes
 
               if(!found)
               {
-                meshes[subdomains_i]->elements.skip_slot();
+                subdomain_meshes[subdomains_i]->elements.skip_slot();
                 continue;
               }
 
-              XMLSubdomains::domain::elements_type::el_type* element = NULL;
-              for(int searched_element_i = 0; searched_element_i < element_count; searched_element_i++)
-              {
-                element = &parsed_xml_domain->elements().el().at(searched_element_i);
-                if(element->i() == elements_existing[element_i])
-                  break;
-                else
-                  element = NULL;
-              }
-              if(element == NULL)
+              // elements_existing is indexed by the positions in the file (element_is).
+              XMLSubdomains::domain::elements_type::el_type* element = &parsed_xml_domain->elements().el().at(element_i);
+              if(element->i() != elements_existing[element_i])
                 throw Exceptions::MeshLoadFailureException("Element number wrong in the mesh file.");
 
               XMLSubdomains::q_t* el_q = dynamic_cast<XMLSubdomains::q_t*>(element);
               XMLSubdomains::t_t* el_t = dynamic_cast<XMLSubdomains::t_t*>(element);
               if(el_q != NULL)
-                e = meshes[subdomains_i]->create_quad(meshes[subdomains_i]->element_markers_conversion.get_internal_marker(element->m()).marker,
-                &meshes[subdomains_i]->nodes[vertex_vertex_numbers.find(el_q->v1())->second],
-                &meshes[subdomains_i]->nodes[vertex_vertex_numbers.find(el_q->v2())->second],
-                &meshes[subdomains_i]->nodes[vertex_vertex_numbers.find(el_q->v3())->second],
-                &meshes[subdomains_i]->nodes[vertex_vertex_numbers.find(el_q->v4())->second],
+                e = subdomain_meshes[subdomains_i]->create_quad(subdomain_meshes[subdomains_i]->element_markers_conversion.get_internal_marker(element->m()).marker,
+                &subdomain_meshes[subdomains_i]->nodes[vertex_vertex_numbers.find(el_q->v1())->second],
+                &subdomain_meshes[subdomains_i]->nodes[vertex_vertex_numbers.find(el_q->v2())->second],
+                &subdomain_meshes[subdomains_i]->nodes[vertex_vertex_numbers.find(el_q->v3())->second],
+                &subdomain_meshes[subdomains_i]->nodes[vertex_vertex_numbers.find(el_q->v4())->second],
                 NULL, element_i);
               if(el_t != NULL)
-                e = meshes[subdomains_i]->create_triangle(meshes[subdomains_i]->element_markers_conversion.get_internal_marker(element->m()).marker,
-                &meshes[subdomains_i]->nodes[vertex_vertex_numbers.find(el_t->v1())->second],
-                &meshes[subdomains_i]->nodes[vertex_vertex_numbers.find(el_t->v2())->second],
-                &meshes[subdomains_i]->nodes[vertex_vertex_numbers.find(el_t->v3())->second],
+                e = subdomain_meshes[subdomains_i]->create_triangle(subdomain_meshes[subdomains_i]->element_markers_conversion.get_internal_marker(element->m()).marker,
+                &subdomain_meshes[subdomains_i]->nodes[vertex_vertex_numbers.find(el_t->v1())->second],
+                &subdomain_meshes[subdomains_i]->nodes[vertex_vertex_numbers.find(el_t->v2())->second],
+                &subdomain_meshes[subdomains_i]->nodes[vertex_vertex_numbers.find(el_t->v3())->second],
                 NULL, element_i);
             }
 
@@ -419,37 +467,26 @@ namespace Hermes
             for (int boundary_edge_number_i = 0; boundary_edge_number_i < boundary_edge_number_count; boundary_edge_number_i++)
             {
               XMLSubdomains::domain::edges_type::ed_type* edge = NULL;
-              for(unsigned int to_find_i = 0; to_find_i < parsed_xml_domain->edges().ed().size(); to_find_i++)
+              if(boundary_edge_number_count != parsed_xml_domain->edges().ed().size())
               {
-                if(boundary_edge_number_count != parsed_xml_domain->edges().ed().size())
-                {
-                  if(parsed_xml_domain->edges().ed().at(to_find_i).i() == parsed_xml_domain->subdomains().subdomain().at(subdomains_i).boundary_edges()->i().at(boundary_edge_number_i))
-                  {
-                    edge = &parsed_xml_domain->edges().ed().at(to_find_i);
-                    break;
-                  }
-                }
-                else
-                {
-                  if(parsed_xml_domain->edges().ed().at(to_find_i).i() == edge_is[boundary_edge_number_i])
-                  {
-                    edge = &parsed_xml_domain->edges().ed().at(to_find_i);
-                    break;
-                  }
-                }
+                std::map<int, unsigned int>::iterator it = edge_positions.find(parsed_xml_domain->subdomains().subdomain().at(subdomains_i).boundary_edges()->i().at(boundary_edge_number_i));
+                if(it != edge_positions.end())
+                  edge = &parsed_xml_domain->edges().ed().at(it->second);
               }
+              else
+                edge = &parsed_xml_domain->edges().ed().at(boundary_edge_number_i);
 
               if(edge == NULL)
                   throw Exceptions::MeshLoadFailureException("Wrong boundary-edge number:%i in subdomain %u.", parsed_xml_domain->subdomains().subdomain().at(subdomains_i).boundary_edges()->i().at(boundary_edge_number_i), subdomains_i);
 
-              Node* en = meshes[subdomains_i]->peek_edge_node(vertex_vertex_numbers.find(edge->v1())->second, vertex_vertex_numbers.find(edge->v2())->second);
+              Node* en = subdomain_meshes[subdomains_i]->peek_edge_node(vertex_vertex_numbers.find(edge->v1())->second, vertex_vertex_numbers.find(edge->v2())->second);
               if(en == NULL)
                 throw Hermes::Exceptions::MeshLoadFailureException("Boundary data error (edge %i does not exist).", boundary_edge_number_i);
 
-              en->marker = meshes[subdomains_i]->boundary_markers_conversion.get_internal_marker(edge->m()).marker;
+              en->marker = subdomain_meshes[subdomains_i]->boundary_markers_conversion.get_internal_marker(edge->m()).marker;
 
-              meshes[subdomains_i]->nodes[vertex_vertex_numbers.find(edge->v1())->second].bnd = 1;
-              meshes[subdomains_i]->nodes[vertex_vertex_numbers.find(edge->v2())->second].bnd = 1;
+              subdomain_meshes[subdomains_i]->nodes[vertex_vertex_numbers.find(edge->v1())->second].bnd = 1;
+              subdomain_meshes[subdomains_i]->nodes[vertex_vertex_numbers.find(edge->v2())->second].bnd = 1;
               en->bnd = 1;
             }
 
@@ -457,24 +494,18 @@ namespace Hermes
             for (int inner_edge_number_i = 0; inner_edge_number_i < inner_edge_number_count; inner_edge_number_i++)
             {
               XMLSubdomains::domain::edges_type::ed_type* edge = NULL;
-
-              for(unsigned int to_find_i = 0; to_find_i < parsed_xml_domain->edges().ed().size(); to_find_i++)
-              {
-                if(parsed_xml_domain->edges().ed().at(to_find_i).i() == parsed_xml_domain->subdomains().subdomain().at(subdomains_i).inner_edges()->i().at(inner_edge_number_i))
-                {
-                  edge = &parsed_xml_domain->edges().ed().at(to_find_i);
-                  break;
-                }
-              }
+              std::map<int, unsigned int>::iterator it = edge_positions.find(parsed_xml_domain->subdomains().subdomain().at(subdomains_i).inner_edges()->i().at(inner_edge_number_i));
+              if(it != edge_positions.end())
+                edge = &parsed_xml_domain->edges().ed().at(it->second);
 
               if(edge == NULL)
                   throw Exceptions::MeshLoadFailureException("Wrong inner-edge number:%i in subdomain %u.", parsed_xml_domain->subdomains().subdomain().at(subdomains_i).boundary_edges()->i().at(inner_edge_number_i), subdomains_i);
 
-              Node* en = meshes[subdomains_i]->peek_edge_node(vertex_vertex_numbers.find(edge->v1())->second, vertex_vertex_numbers.find(edge->v2())->second);
+              Node* en = subdomain_meshes[subdomains_i]->peek_edge_node(vertex_vertex_numbers.find(edge->v1())->second, vertex_vertex_numbers.find(edge->v2())->second);
               if(en == NULL)
                 throw Hermes::Exceptions::MeshLoadFailureException("Inner data error (edge %i does not exist).", inner_edge_number_i);
 
-              en->marker = meshes[subdomains_i]->boundary_markers_conversion.get_internal_marker(edge->m()).marker;
+              en->marker = subdomain_meshes[subdomains_i]->boundary_markers_conversion.get_internal_marker(edge->m()).marker;
               en->bnd = 0;
             }
 
@@ -502,7 +533,7 @@ namespace Hermes
                   p1 = vertex_vertex_numbers.find(parsed_xml_domain->curves()->arc().at(curves_i).v1())->second;
                   p2 = vertex_vertex_numbers.find(parsed_xml_domain->curves()->arc().at(curves_i).v2())->second;
 
-                  nurbs = load_arc(meshes[subdomains_i], parsed_xml_domain, curves_i, &en, p1, p2, true);
+                  nurbs = load_arc(subdomain_meshes[subdomains_i], parsed_xml_domain, curves_i, &en, p1, p2, true);
                   if(nurbs == NULL)
                     continue;
                 }
@@ -518,7 +549,7 @@ namespace Hermes
                   p1 = vertex_vertex_numbers.find(parsed_xml_domain->curves()->NURBS().at(curves_i - arc_count).v1())->second;
                   p2 = vertex_vertex_numbers.find(parsed_xml_domain->curves()->NURBS().at(curves_i - arc_count).v2())->second;
 
-                  nurbs = load_nurbs(meshes[subdomains_i], parsed_xml_domain, curves_i - arc_count, &en, p1, p2, true);
+                  nurbs = load_nurbs(subdomain_meshes[subdomains_i], parsed_xml_domain, curves_i - arc_count, &en, p1, p2, true);
                   if(nurbs == NULL)
                     continue;
                 }
@@ -550,7 +581,7 @@ namespace Hermes
                   }
                   else
                   {
-                    Nurbs* nurbs_rev = meshes[subdomains_i]->reverse_nurbs(nurbs);
+                    Nurbs* nurbs_rev = subdomain_meshes[subdomains_i]->reverse_nurbs(nurbs);
                     e->cm->nurbs[idx] = nurbs_rev;
                     nurbs_rev->ref++;
                   }
@@ -559,7 +590,7 @@ namespace Hermes
             }
 
             // update refmap coeffs of curvilinear elements
-            for_all_elements(e, meshes[subdomains_i])
+            for_all_elements(e, subdomain_meshes[subdomains_i])
               if(e->cm != NULL)
                 e->cm->update_refmap_coeffs(e);
 
@@ -572,16 +603,16 @@ namespace Hermes
                 int element_id = parsed_xml_domain->subdomains().subdomain().at(subdomains_i).refinements()->ref().at(i).element_id();
                 int refinement_type = parsed_xml_domain->subdomains().subdomain().at(subdomains_i).refinements()->ref().at(i).refinement_type();
                 if(refinement_type == -1)
-                  meshes[subdomains_i]->unrefine_element_id(element_id);
+                  subdomain_meshes[subdomains_i]->unrefine_element_id(element_id);
                 else
-                  meshes[subdomains_i]->refine_element_id(element_id, refinement_type);
+                  subdomain_meshes[subdomains_i]->refine_element_id(element_id, refinement_type);
               }
             }
 
             delete [] elements_existing;
           }
-          meshes[subdomains_i]->seq = g_mesh_seq++;
-          meshes[subdomains_i]->initial_single_check();
+          subdomain_meshes[subdomains_i]->seq = g_mesh_seq++;
+          subdomain_meshes[subdomains_i]->initial_single_check();
         }
 
         delete [] vertex_is;
@@ -780,7 +811,8 @@ namespace Hermes
       namespace_info_map.insert(std::pair<std::basic_string<char>, xml_schema::namespace_info>("domain", namespace_info_domain));
 
       std::ofstream out(filename);
-      ::xml_schema::flags parsing_flags = ::xml_schema::flags::base;
+      Hermes2DApi.initialize_xml();
+      ::xml_schema::flags parsing_flags = ::xml_schema::flags::base | ::xml_schema::flags::dont_initialize;
       XMLSubdomains::domain_(out, xmldomain, namespace_info_map, "UTF-8", parsing_flags);
       out.close();
 
@@ -819,7 +851,6 @@ namespace Hermes
           node->type = HERMES_TYPE_VERTEX;
           node->bnd = 0;
           node->p1 = node->p2 = -1;
-          node->next_hash = NULL;
 
           // variables matching.
           std::string x = parsed_xml_mesh->vertices().v().at(vertex_i).x();
@@ -1070,7 +1101,6 @@ namespace Hermes
           node->type = HERMES_TYPE_VERTEX;
           node->bnd = 0;
           node->p1 = node->p2 = -1;
-          node->next_hash = NULL;
 
           // variables matching.
           std::string x = parsed_xml_domain->vertices().v().at(vertex_i).x();
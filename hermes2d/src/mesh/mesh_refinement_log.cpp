@@ -0,0 +1,173 @@
+// This file is part of Hermes2D
+//
+// Hermes2D is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D; if not, see <http://www.gnu.prg/licenses/>.
+
+#include <string.h>
+#include "mesh_refinement_log.h"
+#include "mesh_reader_h2d_binary.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    static const char H2D_REFINEMENT_LOG_MAGIC[8] = { 'H', '2', 'D', 'R', 'L', 'O', 'G', '\0' };
+    static const int H2D_REFINEMENT_LOG_VERSION = 1;
+    static const int H2D_REFINEMENT_LOG_BYTE_ORDER = 0x01020304;
+
+    MeshRefinementLog::MeshRefinementLog(const char* file_name) : file_name(file_name), file(NULL), mesh(NULL), num_logged(0), num_operations(0)
+    {
+    }
+
+    MeshRefinementLog::~MeshRefinementLog()
+    {
+      if(file != NULL)
+        fclose(file);
+    }
+
+    void MeshRefinementLog::start(Mesh* mesh)
+    {
+      if(mesh == NULL)
+        throw Exceptions::NullException(1);
+
+      std::string base_file_name = file_name + ".base";
+      MeshReaderH2DBinary reader;
+      reader.save(base_file_name.c_str(), mesh);
+      // The binary format renumbers the refined elements.
+      if(mesh->get_num_elements() > mesh->get_num_base_elements())
+        reader.load(base_file_name.c_str(), mesh);
+
+      this->mesh = mesh;
+      this->num_logged = mesh->refinements.size();
+      this->num_operations = 0;
+      rewrite(NULL, 0);
+    }
+
+    void MeshRefinementLog::add_step(Mesh* mesh, int step)
+    {
+      if(file == NULL)
+        throw Exceptions::Exception("MeshRefinementLog::add_step(): start() or replay() has to be called first.");
+      if(mesh != this->mesh || mesh->refinements.size() < num_logged)
+        throw Exceptions::Exception("MeshRefinementLog::add_step(): not the mesh of start() or replay(), or the mesh was loaded again.");
+      if(step < 0)
+        throw Exceptions::ValueException("step", step, 0);
+
+      unsigned int count = mesh->refinements.size() - num_logged;
+      std::vector<int> record(2 + 2 * count);
+      record[0] = step;
+      record[1] = count;
+      for(unsigned int i = 0; i < count; i++)
+      {
+        record[2 + 2 * i] = mesh->refinements[num_logged + i].first;
+        record[3 + 2 * i] = mesh->refinements[num_logged + i].second;
+      }
+
+      if(fwrite(&record[0], sizeof(int), record.size(), file) != record.size() || fflush(file) != 0)
+        throw Exceptions::Exception("MeshRefinementLog::add_step(): could not write to %s.", file_name.c_str());
+
+      num_logged = mesh->refinements.size();
+      num_operations += count;
+    }
+
+    int MeshRefinementLog::replay(Mesh* mesh, int last_step)
+    {
+      if(mesh == NULL)
+        throw Exceptions::NullException(1);
+
+      std::string base_file_name = file_name + ".base";
+      MeshReaderH2DBinary reader;
+      reader.load(base_file_name.c_str(), mesh);
+
+      FILE* f = fopen(file_name.c_str(), "rb");
+      if(f == NULL)
+        throw Exceptions::MeshLoadFailureException("MeshRefinementLog::replay(): the log %s not found.", file_name.c_str());
+      Header header;
+      if(fread(&header, sizeof(Header), 1, f) != 1 || memcmp(header.magic, H2D_REFINEMENT_LOG_MAGIC, sizeof(H2D_REFINEMENT_LOG_MAGIC)))
+      {
+        fclose(f);
+        throw Exceptions::MeshLoadFailureException("MeshRefinementLog::replay(): %s is not a refinement log.", file_name.c_str());
+      }
+      if(header.byte_order != H2D_REFINEMENT_LOG_BYTE_ORDER || header.version != H2D_REFINEMENT_LOG_VERSION)
+      {
+        fclose(f);
+        throw Exceptions::MeshLoadFailureException("MeshRefinementLog::replay(): %s was written by another version or on a machine of another byte order.", file_name.c_str());
+      }
+      fseek(f, 0, SEEK_END);
+      long size = ftell(f) - (long)sizeof(Header);
+      fseek(f, sizeof(Header), SEEK_SET);
+      std::vector<int> records(size / sizeof(int));
+      size_t read = records.empty() ? 0 : fread(&records[0], sizeof(int), records.size(), f);
+      fclose(f);
+      if(read != records.size())
+        throw Exceptions::MeshLoadFailureException("MeshRefinementLog::replay(): could not read %s.", file_name.c_str());
+
+      // Whole steps only, a step cut off at the end is dropped.
+      unsigned int pos = 0;
+      int replayed_step = -1;
+      this->num_operations = 0;
+      while(pos + 2 <= records.size())
+      {
+        int step = records[pos];
+        int count = records[pos + 1];
+        if(count < 0 || pos + 2 + 2 * (unsigned int)count > records.size())
+          break;
+        if(last_step >= 0 && step > last_step)
+          break;
+        for(int i = 0; i < count; i++)
+        {
+          int id = records[pos + 2 + 2 * i];
+          int refinement = records[pos + 3 + 2 * i];
+          if(refinement == -1)
+            mesh->unrefine_element_id(id);
+          else
+            mesh->refine_element_id(id, refinement);
+        }
+        replayed_step = step;
+        this->num_operations += count;
+        pos += 2 + 2 * count;
+      }
+      this->info("MeshRefinementLog: %u refinements replayed from %s.", this->num_operations, file_name.c_str());
+
+      this->mesh = mesh;
+      this->num_logged = mesh->refinements.size();
+      rewrite(pos > 0 ? &records[0] : NULL, pos);
+
+      return replayed_step;
+    }
+
+    unsigned int MeshRefinementLog::get_num_operations() const
+    {
+      return num_operations;
+    }
+
+    void MeshRefinementLog::rewrite(const int* records, unsigned int num_ints)
+    {
+      if(file != NULL)
+        fclose(file);
+      file = fopen(file_name.c_str(), "wb");
+      if(file == NULL)
+        throw Exceptions::Exception("MeshRefinementLog: could not open %s for writing.", file_name.c_str());
+
+      Header header;
+      memset(&header, 0, sizeof(Header));
+      memcpy(header.magic, H2D_REFINEMENT_LOG_MAGIC, sizeof(H2D_REFINEMENT_LOG_MAGIC));
+      header.version = H2D_REFINEMENT_LOG_VERSION;
+      header.byte_order = H2D_REFINEMENT_LOG_BYTE_ORDER;
+      bool written = (fwrite(&header, sizeof(Header), 1, file) == 1);
+      if(written && num_ints > 0)
+        written = (fwrite(records, sizeof(int), num_ints, file) == num_ints);
+      if(!written || fflush(file) != 0)
+        throw Exceptions::Exception("MeshRefinementLog: could not write to %s.", file_name.c_str());
+    }
+  }
+}
@@ -0,0 +1,109 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "mesh_snapshot.h"
+#include <map>
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    /// The live snapshots by their versions, under the lock (mesh_snapshots).
+    static std::map<uint64_t, MeshSnapshot*> live_mesh_snapshots;
+
+    MeshSnapshot::MeshSnapshot(const Mesh* mesh, uint64_t version) : version(version), ref_count(1)
+    {
+      this->mesh.copy(mesh);
+    }
+
+    MeshSnapshot::~MeshSnapshot()
+    {
+    }
+
+    const MeshSnapshot* MeshSnapshot::acquire(const Mesh* mesh)
+    {
+      if(mesh == NULL)
+        throw Exceptions::NullException(1);
+      uint64_t version = mesh->get_version();
+
+      MeshSnapshot* snapshot = NULL;
+#pragma omp critical (mesh_snapshots)
+      {
+        std::map<uint64_t, MeshSnapshot*>::iterator it = live_mesh_snapshots.find(version);
+        if(it != live_mesh_snapshots.end())
+        {
+          snapshot = it->second;
+          snapshot->ref_count++;
+        }
+      }
+      if(snapshot != NULL)
+        return snapshot;
+
+      // Copied outside of the lock, another thread may have been faster.
+      MeshSnapshot* created = new MeshSnapshot(mesh, version);
+#pragma omp critical (mesh_snapshots)
+      {
+        std::pair<std::map<uint64_t, MeshSnapshot*>::iterator, bool> inserted = live_mesh_snapshots.insert(std::pair<uint64_t, MeshSnapshot*>(version, created));
+        snapshot = inserted.first->second;
+        if(!inserted.second)
+          snapshot->ref_count++;
+      }
+      if(snapshot != created)
+        delete created;
+      return snapshot;
+    }
+
+    const MeshSnapshot* MeshSnapshot::acquire(const MeshSnapshot* snapshot)
+    {
+      if(snapshot == NULL)
+        throw Exceptions::NullException(1);
+#pragma omp critical (mesh_snapshots)
+      snapshot->ref_count++;
+      return snapshot;
+    }
+
+    void MeshSnapshot::release(const MeshSnapshot* snapshot)
+    {
+      if(snapshot == NULL)
+        return;
+      bool last = false;
+#pragma omp critical (mesh_snapshots)
+      {
+        if(--snapshot->ref_count == 0)
+        {
+          live_mesh_snapshots.erase(snapshot->version);
+          last = true;
+        }
+      }
+      if(last)
+        delete snapshot;
+    }
+
+    const Mesh* MeshSnapshot::get_mesh() const
+    {
+      return &this->mesh;
+    }
+
+    uint64_t MeshSnapshot::get_version() const
+    {
+      return this->version;
+    }
+
+    bool MeshSnapshot::matches(const Mesh* mesh) const
+    {
+      return mesh != NULL && mesh->get_version() == this->version;
+    }
+  }
+}
@@ -16,6 +16,7 @@
 #include "global.h"
 #include "mesh.h"
 #include "refmap.h"
+#include "element_locator.h"
 
 namespace Hermes
 {
@@ -227,6 +228,13 @@ namespace Hermes
       const_jacobian *= 4;
     }
 
+    void RefMap::set_transform(uint64_t idx)
+    {
+      Transformable::set_transform(idx);
+      update_cur_node();
+      if(is_const) calc_const_inv_ref_map(); else const_jacobian = 0.0;
+    }
+
     void RefMap::calc_inv_ref_map(int order)
     {
       assert(quad_2d != NULL);
@@ -345,6 +353,54 @@ namespace Hermes
         fabs(e->vn[2]->y - (e->vn[1]->y + e->vn[3]->y - e->vn[0]->y)) < eps;
     }
 
+    void RefMap::calc_const_ref_map(Element* e, double2x2& m, double2& t)
+    {
+      int k = e->is_triangle() ? 2 : 3;
+      m[0][0] = 0.5 * (e->vn[1]->x - e->vn[0]->x);
+      m[0][1] = 0.5 * (e->vn[k]->x - e->vn[0]->x);
+      m[1][0] = 0.5 * (e->vn[1]->y - e->vn[0]->y);
+      m[1][1] = 0.5 * (e->vn[k]->y - e->vn[0]->y);
+      t[0] = e->vn[0]->x + m[0][0] + m[0][1];
+      t[1] = e->vn[0]->y + m[1][0] + m[1][1];
+    }
+
+    void RefMap::get_const_ref_map(double2x2& m, double2& t) const
+    {
+      // composition with the sub-element transformation
+      m[0][0] = const_ref_map[0][0] * ctm->m[0];
+      m[0][1] = const_ref_map[0][1] * ctm->m[1];
+      m[1][0] = const_ref_map[1][0] * ctm->m[0];
+      m[1][1] = const_ref_map[1][1] * ctm->m[1];
+      t[0] = const_ref_map[0][0] * ctm->t[0] + const_ref_map[0][1] * ctm->t[1] + const_ref_map_offset[0];
+      t[1] = const_ref_map[1][0] * ctm->t[0] + const_ref_map[1][1] * ctm->t[1] + const_ref_map_offset[1];
+    }
+
+    void RefMap::calc_const_geometry(Element** elements, int num_elements, Quad2D* quad, int order, double* x, double* y, double* jacobian_x_weights)
+    {
+      if(num_elements == 0)
+        return;
+      ElementMode2D mode = elements[0]->get_mode();
+      double3* pt = quad->get_points(order, mode);
+      int np = quad->get_num_points(order, mode);
+
+      for (int i = 0; i < num_elements; i++, x += np, y += np, jacobian_x_weights += np)
+      {
+        if(elements[i]->get_mode() != mode || elements[i]->is_curved() || (elements[i]->is_quad() && !is_parallelogram(elements[i])))
+          throw Hermes::Exceptions::Exception("RefMap::calc_const_geometry() needs elements of one mode with constant reference maps.");
+
+        double2x2 m;
+        double2 t;
+        calc_const_ref_map(elements[i], m, t);
+        double jacobian = m[0][0] * m[1][1] - m[0][1] * m[1][0];
+        for (int j = 0; j < np; j++)
+        {
+          x[j] = m[0][0] * pt[j][0] + m[0][1] * pt[j][1] + t[0];
+          y[j] = m[1][0] * pt[j][0] + m[1][1] * pt[j][1] + t[1];
+          jacobian_x_weights[j] = pt[j][2] * jacobian;
+        }
+      }
+    }
+
     void RefMap::calc_const_inv_ref_map()
     {
       if(element == NULL)
@@ -363,6 +419,8 @@ namespace Hermes
       const_inv_ref_map[1][1] =  m[0][0] * ij;
 
       const_jacobian *= get_transform_jacobian();
+
+      calc_const_ref_map(element, const_ref_map, const_ref_map_offset);
     }
 
     void RefMap::calc_phys_x(int order)
@@ -370,6 +428,16 @@ namespace Hermes
       // transform all x coordinates of the integration points
       int i, j, np = quad_2d->get_num_points(order, element->get_mode());
       double* x = cur_node->phys_x[order] = new double[np];
+      if(is_const)
+      {
+        double2x2 m;
+        double2 t;
+        get_const_ref_map(m, t);
+        double3* pt = quad_2d->get_points(order, element->get_mode());
+        for (j = 0; j < np; j++)
+          x[j] = m[0][0] * pt[j][0] + m[0][1] * pt[j][1] + t[0];
+        return;
+      }
       memset(x, 0, np * sizeof(double));
       ref_map_pss.force_transform(sub_idx, ctm);
       for (i = 0; i < nc; i++)
@@ -387,6 +455,16 @@ namespace Hermes
       // transform all y coordinates of the integration points
       int i, j, np = quad_2d->get_num_points(order, element->get_mode());
       double* y = cur_node->phys_y[order] = new double[np];
+      if(is_const)
+      {
+        double2x2 m;
+        double2 t;
+        get_const_ref_map(m, t);
+        double3* pt = quad_2d->get_points(order, element->get_mode());
+        for (j = 0; j < np; j++)
+          y[j] = m[1][0] * pt[j][0] + m[1][1] * pt[j][1] + t[1];
+        return;
+      }
       memset(y, 0, np * sizeof(double));
       ref_map_pss.force_transform(sub_idx, ctm);
       for (i = 0; i < nc; i++)
@@ -784,9 +862,29 @@ namespace Hermes
 
     Element* RefMap::element_on_physical_coordinates(const Mesh* mesh, double x, double y, double* x_reference, double* y_reference)
     {
-      // go through all elements
       double xi1, xi2;
       Element *e;
+
+      // Try the few elements whose boxes contain the point first.
+      ElementLocator* locator = mesh->get_element_locator();
+      e = locator->find(x, y, xi1, xi2);
+      if(e != NULL)
+      {
+        if(x_reference != NULL)
+          (*x_reference) = xi1;
+        if(y_reference != NULL)
+          (*y_reference) = xi2;
+        return e;
+      }
+
+      // Without curved elements the boxes cover the whole domain.
+      if(!locator->has_curved_elements())
+      {
+        Hermes::Mixins::Loggable::Static::warn("Point (%g, %g) does not lie in any element.", x, y);
+        return NULL;
+      }
+
+      // go through all elements
       // vector for curved elements that do not have the point in them when considering straight edges.
       Hermes::vector<Element*> improbable_curved_elements;
       for_all_active_elements(e, mesh)
@@ -961,6 +1059,12 @@ namespace Hermes
       }
     }
 
+    void RefMap::reset_active_element()
+    {
+      free();
+      element = NULL;
+    }
+
     RefMap::Node* RefMap::handle_overflow()
     {
       if(overflow != NULL)
@@ -515,6 +515,33 @@ namespace Hermes
       this->finish();
     }
 
+    Traverse::State** Traverse::get_states(const Mesh** meshes, int meshes_count, int& num_states)
+    {
+      this->begin(meshes_count, meshes);
+
+      int states_allocated = 256;
+      State** states = (State**)malloc(states_allocated * sizeof(State*));
+      num_states = 0;
+
+      State* current_state;
+      while ((current_state = this->get_next_state()) != NULL)
+      {
+        if(num_states == states_allocated)
+        {
+          states_allocated *= 2;
+          states = (State**)realloc(states, states_allocated * sizeof(State*));
+        }
+        states[num_states] = new State;
+        *(states[num_states]) = current_state;
+        states[num_states]->index = num_states;
+        num_states++;
+      }
+
+      this->finish();
+
+      return states;
+    }
+
     Traverse::State* Traverse::get_next_state(int* top_by_ref, int* id_by_ref)
     {
       // Serial / parallel code.
@@ -1090,5 +1117,81 @@ namespace Hermes
 
       return unidata;
     }
+  
+    TraverseStateList::TraverseStateList() : states(NULL), num_states(0)
+    {
+    }
+
+    TraverseStateList::~TraverseStateList()
+    {
+      clear();
+    }
+
+    void TraverseStateList::clear()
+    {
+      if(states != NULL)
+      {
+        for(int i = 0; i < num_states; i++)
+          delete states[i];
+        free(states);
+      }
+      states = NULL;
+      num_states = 0;
+      mesh_records.clear();
+    }
+
+    TraverseStateList::MeshRecord TraverseStateList::get_record(const Mesh* mesh)
+    {
+      MeshRecord record;
+      record.mesh = mesh;
+      record.seq = mesh->get_seq();
+      record.num_elements = mesh->get_max_element_id();
+      record.num_active_elements = mesh->get_num_active_elements();
+      record.first_element = record.num_elements > 0 ? mesh->get_element_fast(0) : NULL;
+      return record;
+    }
+
+    bool TraverseStateList::update(const Mesh** meshes, int meshes_count)
+    {
+      bool changed = (states == NULL || (int)mesh_records.size() != meshes_count);
+      for(int i = 0; i < meshes_count && !changed; i++)
+      {
+        MeshRecord record = get_record(meshes[i]);
+        if(record.mesh != mesh_records[i].mesh || record.seq != mesh_records[i].seq || record.num_elements != mesh_records[i].num_elements
+          || record.num_active_elements != mesh_records[i].num_active_elements || record.first_element != mesh_records[i].first_element)
+          changed = true;
+      }
+
+      if(!changed)
+        return false;
+
+      clear();
+      Traverse trav_master(true);
+      states = trav_master.get_states(meshes, meshes_count, num_states);
+      for(int i = 0; i < meshes_count; i++)
+        mesh_records.push_back(get_record(meshes[i]));
+
+      return true;
+    }
+
+    int TraverseStateList::get_num_states() const
+    {
+      return num_states;
+    }
+
+    Traverse::State** TraverseStateList::get_states() const
+    {
+      return states;
+    }
+
+    void TraverseStateList::set_active_state(Traverse::State* state, Transformable** fn)
+    {
+      for(int i = 0; i < state->num; i++)
+        if(state->e[i] != NULL && fn[i] != NULL)
+        {
+          fn[i]->set_active_element(state->e[i]);
+          fn[i]->set_transform(state->sub_idx[i]);
+        }
+    }
   }
-}
\ No newline at end of file
+}
@@ -13,6 +13,15 @@
 // You should have received a copy of the GNU General Public License
 // along with Hermes; if not, see <http://www.gnu.prg/licenses/>.
 #include "mixins2d.h"
+#include "api2d.h"
+#include <xercesc/dom/DOM.hpp>
+#include <xercesc/framework/XMLGrammarPoolImpl.hpp>
+#include <xercesc/util/PlatformUtils.hpp>
+#include <xercesc/util/XMLUni.hpp>
+#include <xercesc/util/XMLUniDefs.hpp>
+#include <xercesc/validators/common/Grammar.hpp>
+
+using namespace xercesc;
 
 namespace Hermes
 {
@@ -20,6 +29,110 @@ namespace Hermes
   {
     namespace Mixins
     {
+      /// The schemas loaded into the grammar pool, the imported ones first.
+      static const char* xml_schema_files[] = { "mesh_h2d_xml.xsd", "mesh_h1d_xml.xsd", "subdomains_h2d_xml.xsd", "space_h2d_xml.xsd", "solution_h2d_xml.xsd", NULL };
+
+      /// The parsed schemas shared by all the validating parsers, locked (read-only, thus thread-safe) once loaded.
+      static XMLGrammarPool* xml_grammar_pool = NULL;
+
+      /// Collects the first error of the parsing.
+      class ValidationErrorHandler : public DOMErrorHandler
+      {
+      public:
+        ValidationErrorHandler() : failed(false), line(0) {}
+
+        virtual bool handleError(const DOMError& error)
+        {
+          if(error.getSeverity() != DOMError::DOM_SEVERITY_WARNING && !failed)
+          {
+            failed = true;
+            char* text = XMLString::transcode(error.getMessage());
+            message = text;
+            XMLString::release(&text);
+            if(error.getLocation() != NULL)
+              line = (unsigned long)error.getLocation()->getLineNumber();
+          }
+          return true;
+        }
+
+        bool failed;
+        std::string message;
+        unsigned long line;
+      };
+
+      static DOMLSParser* create_validating_parser(XMLGrammarPool* pool, ValidationErrorHandler* handler)
+      {
+        const XMLCh ls_id[] = { chLatin_L, chLatin_S, chNull };
+        DOMImplementation* impl = DOMImplementationRegistry::getDOMImplementation(ls_id);
+        DOMLSParser* parser = impl->createLSParser(DOMImplementationLS::MODE_SYNCHRONOUS, 0, XMLPlatformUtils::fgMemoryManager, pool);
+
+        DOMConfiguration* conf = parser->getDomConfig();
+        conf->setParameter(XMLUni::fgDOMComments, false);
+        conf->setParameter(XMLUni::fgDOMDatatypeNormalization, true);
+        conf->setParameter(XMLUni::fgDOMEntities, false);
+        conf->setParameter(XMLUni::fgDOMNamespaces, true);
+        conf->setParameter(XMLUni::fgDOMElementContentWhitespace, false);
+        conf->setParameter(XMLUni::fgDOMValidate, true);
+        conf->setParameter(XMLUni::fgXercesSchema, true);
+        conf->setParameter(XMLUni::fgXercesSchemaFullChecking, false);
+        conf->setParameter(XMLUni::fgXercesUseCachedGrammarInParse, true);
+        conf->setParameter(XMLUni::fgXercesUserAdoptsDOMDocument, true);
+        conf->setParameter(XMLUni::fgDOMErrorHandler, handler);
+        return parser;
+      }
+
+      XMLParsing::ValidatedDocument::ValidatedDocument(const char* filename) : document(NULL)
+      {
+#pragma omp critical (xml_grammar_pool)
+        if(xml_grammar_pool == NULL)
+        {
+          XMLGrammarPool* pool = new XMLGrammarPoolImpl(XMLPlatformUtils::fgMemoryManager);
+          ValidationErrorHandler handler;
+          DOMLSParser* loader = create_validating_parser(pool, &handler);
+          std::string schemas_dir = Hermes2DApi.get_text_param_value(xmlSchemasDirPath);
+          for(int i = 0; xml_schema_files[i] != NULL; i++)
+            loader->loadGrammar((schemas_dir + "/" + xml_schema_files[i]).c_str(), Grammar::SchemaGrammarType, true);
+          loader->release();
+          pool->lockPool();
+          xml_grammar_pool = pool;
+        }
+
+        ValidationErrorHandler handler;
+        DOMLSParser* parser = create_validating_parser(xml_grammar_pool, &handler);
+        // The grammars of the pool only.
+        parser->getDomConfig()->setParameter(XMLUni::fgXercesLoadSchema, false);
+        document = parser->parseURI(filename);
+        parser->release();
+
+        if(handler.failed || document == NULL)
+        {
+          if(document != NULL)
+            document->release();
+          document = NULL;
+          throw Hermes::Exceptions::Exception("%s:%lu: %s", filename, handler.line, handler.failed ? handler.message.c_str() : "the file could not be parsed.");
+        }
+      }
+
+      XMLParsing::ValidatedDocument::~ValidatedDocument()
+      {
+        if(document != NULL)
+          document->release();
+      }
+
+      const DOMDocument& XMLParsing::ValidatedDocument::get() const
+      {
+        return *document;
+      }
+
+      bool XMLParsing::validation_on(bool validate)
+      {
+        return validate && !Hermes2DApi.get_integral_param_value(xmlTrustedInput);
+      }
+
+      bool XMLParsing::validation_on() const
+      {
+        return validation_on(this->validate);
+      }
       template<typename Scalar>
       const Space<Scalar>* SettableSpaces<Scalar>::get_space(int n) const
       {
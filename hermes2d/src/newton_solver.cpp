@@ -68,6 +68,15 @@ namespace Hermes
       this->newton_tol = 1e-8;
       this->newton_max_iter = 15;
       this->residual_as_function = false;
+      this->jacobian_with_residual = false;
+      this->jacobian_reuse = false;
+      this->jacobian_reuse_max_contraction = 0.5;
+      this->jacobian_reusable = false;
+      this->inexact_newton = false;
+      this->max_forcing_term = 0.9;
+      this->forcing_term = 0.9;
+      this->forcing_gamma = 0.9;
+      this->forcing_alpha = 2.0;
       this->max_allowed_residual_norm = 1E9;
       this->min_allowed_damping_coeff = 1E-4;
       this->currentDampingCofficient = 1.0;
@@ -120,6 +129,66 @@ namespace Hermes
       this->residual_as_function = true;
     }
 
+    template<typename Scalar>
+    void NewtonSolver<Scalar>::set_jacobian_with_residual(bool onOff)
+    {
+      this->jacobian_with_residual = onOff;
+    }
+
+    template<typename Scalar>
+    void NewtonSolver<Scalar>::set_jacobian_reuse(bool onOff, double max_contraction)
+    {
+      if(max_contraction <= 0.0 || max_contraction >= 1.0)
+        throw Exceptions::ValueException("max_contraction", max_contraction, 0.0, 1.0);
+      this->jacobian_reuse = onOff;
+      this->jacobian_reuse_max_contraction = max_contraction;
+    }
+
+    template<typename Scalar>
+    void NewtonSolver<Scalar>::set_inexact_newton(bool onOff, double max_forcing_term, double gamma, double alpha)
+    {
+      if(max_forcing_term <= 0.0 || max_forcing_term >= 1.0)
+        throw Exceptions::ValueException("max_forcing_term", max_forcing_term, 0.0, 1.0);
+      if(gamma <= 0.0 || gamma > 1.0)
+        throw Exceptions::ValueException("gamma", gamma, 0.0, 1.0);
+      if(alpha <= 1.0 || alpha > 2.0)
+        throw Exceptions::ValueException("alpha", alpha, 1.0, 2.0);
+      if(onOff && dynamic_cast<IterSolver<Scalar>*>(linear_solver) == NULL)
+        this->warn("Inexact Newton's method only influences iterative linear solvers.");
+      this->inexact_newton = onOff;
+      this->max_forcing_term = max_forcing_term;
+      this->forcing_gamma = gamma;
+      this->forcing_alpha = alpha;
+    }
+
+    template<typename Scalar>
+    void NewtonSolver<Scalar>::update_forcing_term(int it, double residual_norm, double last_residual_norm)
+    {
+      IterSolver<Scalar>* iter_solver = dynamic_cast<IterSolver<Scalar>*>(linear_solver);
+      if(iter_solver == NULL)
+        return;
+
+      if(it == 1 || last_residual_norm <= 0.0)
+        this->forcing_term = this->max_forcing_term;
+      else
+      {
+        // Choice 2 of Eisenstat, Walker: Choosing the forcing terms in an inexact Newton method (1996),
+        // with the safeguard against a too fast decrease of the forcing terms.
+        double new_forcing_term = this->forcing_gamma * std::pow(residual_norm / last_residual_norm, this->forcing_alpha);
+        double safeguard = this->forcing_gamma * std::pow(this->forcing_term, this->forcing_alpha);
+        if(safeguard > 0.1)
+          new_forcing_term = std::max(new_forcing_term, safeguard);
+        this->forcing_term = std::min(this->max_forcing_term, new_forcing_term);
+      }
+
+      // Do not solve more accurately than the Newton's tolerance needs.
+      if(residual_norm > 0.0)
+        this->forcing_term = std::max(this->forcing_term, std::min(this->max_forcing_term, 0.5 * this->newton_tol / residual_norm));
+
+      iter_solver->set_tolerance(this->forcing_term);
+      this->info("\tNewton: linear solver tolerance: %g", this->forcing_term);
+    }
+
     template<typename Scalar>
     void NewtonSolver<Scalar>::set_time(double time)
     {
@@ -144,6 +213,7 @@ namespace Hermes
       if(kept_jacobian != NULL)
         delete kept_jacobian;
       kept_jacobian = NULL;
+      jacobian_reusable = false;
     }
 
     template<typename Scalar>
@@ -153,6 +223,7 @@ namespace Hermes
       if(kept_jacobian != NULL)
         delete kept_jacobian;
       kept_jacobian = NULL;
+      jacobian_reusable = false;
     }
     
     template<typename Scalar>
@@ -168,6 +239,30 @@ namespace Hermes
       jacobian = create_matrix<Scalar>();
       residual = create_vector<Scalar>();
       linear_solver = create_linear_solver<Scalar>(jacobian, residual);
+      matrix_free = false;
+    }
+
+    template<typename Scalar>
+    void NewtonSolver<Scalar>::init_matrix_free_solver()
+    {
+      if(this->dp->is_matrix_free() == matrix_free)
+        return;
+
+      delete linear_solver;
+      delete jacobian;
+      jacobian_reusable = false;
+
+      matrix_free = this->dp->is_matrix_free();
+      if(matrix_free)
+      {
+        jacobian = new MatrixFreeJacobian<Scalar>(this->dp);
+        linear_solver = new GMRESSolver<Scalar>(jacobian, residual);
+      }
+      else
+      {
+        jacobian = create_matrix<Scalar>();
+        linear_solver = create_linear_solver<Scalar>(jacobian, residual);
+      }
     }
 
     template<typename Scalar>
@@ -257,12 +352,35 @@ namespace Hermes
       this->solve(coeff_vec);
     }
 
+    template<typename Scalar>
+    bool NewtonSolver<Scalar>::solve_linear_system()
+    {
+      LinearMatrixSolverStatistics before = linear_solver->get_statistics();
+      bool solved = linear_solver->solve();
+      this->linear_solver_statistics.add(linear_solver->get_statistics().since(before));
+      return solved;
+    }
+
+    template<typename Scalar>
+    const LinearMatrixSolverStatistics& NewtonSolver<Scalar>::get_linear_solver_statistics() const
+    {
+      return this->linear_solver_statistics;
+    }
+
+    template<typename Scalar>
+    LinearMatrixSolver<Scalar>* NewtonSolver<Scalar>::get_linear_matrix_solver()
+    {
+      return this->linear_solver;
+    }
+
     template<typename Scalar>
     void NewtonSolver<Scalar>::solve(Scalar* coeff_vec)
     {
       this->check();
+      this->init_matrix_free_solver();
 
       this->tick();
+      this->linear_solver_statistics.clear();
 
       // Obtain the number of degrees of freedom.
       int ndof = this->dp->get_num_dofs();
@@ -299,8 +417,12 @@ namespace Hermes
       {
         this->on_step_begin();
 
-        // Assemble just the residual vector.
-        this->dp->assemble(coeff_vec, residual);
+        // Assemble just the residual vector, or the Jacobian with it.
+        bool jacobian_assembled = this->jacobian_with_residual && !this->jacobian_reuse && !matrix_free;
+        if(jacobian_assembled)
+          this->dp->assemble(coeff_vec, jacobian, residual);
+        else
+          this->dp->assemble(coeff_vec, residual);
         if(this->output_rhsOn && (this->output_rhsIterations == -1 || this->output_rhsIterations >= it))
         {
           char* fileName = new char[this->RhsFilename.length() + 5];
@@ -308,7 +430,7 @@ namespace Hermes
             sprintf(fileName, "%s%i.m", this->RhsFilename.c_str(), it);
           else
             sprintf(fileName, "%s%i", this->RhsFilename.c_str(), it);
-          FILE* rhs_file = fopen(fileName, "w+");
+          FILE* rhs_file = fopen(fileName, "wb+");
           residual->dump(rhs_file, this->RhsVarname.c_str(), this->RhsFormat, this->rhs_number_format);
           fclose(rhs_file);
           delete [] fileName;
@@ -320,6 +442,8 @@ namespace Hermes
             static_cast<DiscreteProblem<Scalar>*>(this->dp)->get_spaces()[i]->edata[e->id].changed_in_last_adaptation = false;
 
         // Measure the residual norm.
+        if(it > 1)
+          last_residual_norm = residual_norm;
         if(residual_as_function)
         {
           // Prepare solutions for measuring residual norm.
@@ -343,14 +467,10 @@ namespace Hermes
         else
         {
           // Calculate the l2-norm of residual vector, this is the traditional way.
-          if(it == 1)
-            last_residual_norm = residual_norm = Global<Scalar>::get_l2_norm(residual);
-          else
-          {
-            last_residual_norm = residual_norm;
-            residual_norm = Global<Scalar>::get_l2_norm(residual);
-          }
+          residual_norm = Global<Scalar>::get_l2_norm(residual);
         }
+        if(it == 1)
+          last_residual_norm = residual_norm;
 
         // Info for the user.
         if(it == 1)
@@ -416,15 +536,17 @@ namespace Hermes
         if(residual_norm < newton_tol && it > 1)
         {
           // We want to return the solution in a different structure.
-          this->sln_vector = new Scalar[ndof];
-          for (int i = 0; i < ndof; i++)
-            this->sln_vector[i] = coeff_vec[i];
-
+          // The internal coefficient vector is handed over, the caller's one is copied.
           if(delete_coeff_vec)
           {
-            delete [] coeff_vec;
+            this->sln_vector = coeff_vec;
             coeff_vec = NULL;
           }
+          else
+          {
+            this->sln_vector = new Scalar[ndof];
+            memcpy(this->sln_vector, coeff_vec, ndof * sizeof(Scalar));
+          }
 
           delete [] coeff_vec_back;
 
@@ -436,16 +558,35 @@ namespace Hermes
           return;
         }
 
-        // Assemble just the jacobian.
-        this->dp->assemble(coeff_vec, jacobian);
-        if(this->output_matrixOn && (this->output_matrixIterations == -1 || this->output_matrixIterations >= it))
+        // Keep the factorized Jacobian if the last step with it contracted the residual enough (in the first iteration,
+        // the Jacobian of the previous solve() is tried).
+        bool reuse_jacobian = this->jacobian_reuse && !matrix_free && this->jacobian_reusable && static_cast<DiscreteProblem<Scalar>*>(this->dp)->have_matrix
+          && (it == 1 || residual_norm <= this->jacobian_reuse_max_contraction * last_residual_norm);
+
+        // Assemble just the jacobian (if not assembled with the residual), or only take the current point in the matrix-free case.
+        if(matrix_free)
+          static_cast<MatrixFreeJacobian<Scalar>*>(jacobian)->set_linearization_point(coeff_vec, residual);
+        else if(reuse_jacobian)
+        {
+          this->info("\tNewton: reusing the Jacobian.");
+          linear_solver->set_factorization_scheme(HERMES_REUSE_FACTORIZATION_COMPLETELY);
+        }
+        else
+        {
+          if(!jacobian_assembled)
+            this->dp->assemble(coeff_vec, jacobian);
+          if(this->jacobian_reuse)
+            linear_solver->set_factorization_scheme(HERMES_FACTORIZE_FROM_SCRATCH);
+          this->jacobian_reusable = true;
+        }
+        if(!matrix_free && !reuse_jacobian && this->output_matrixOn && (this->output_matrixIterations == -1 || this->output_matrixIterations >= it))
         {
           char* fileName = new char[this->matrixFilename.length() + 5];
           if(this->matrixFormat == Hermes::Algebra::DF_MATLAB_SPARSE)
             sprintf(fileName, "%s%i.m", this->matrixFilename.c_str(), it);
           else
             sprintf(fileName, "%s%i", this->matrixFilename.c_str(), it);
-          FILE* matrix_file = fopen(fileName, "w+");
+          FILE* matrix_file = fopen(fileName, "wb+");
 
           jacobian->dump(matrix_file, this->matrixVarname.c_str(), this->matrixFormat, this->matrix_number_format);
           fclose(matrix_file);
@@ -458,8 +599,12 @@ namespace Hermes
         // equation reads J(Y^n) \deltaY^{n + 1} = -F(Y^n).
         residual->change_sign();
 
+        // Inexact Newton's method: the tolerance of the iterative solver follows the convergence.
+        if(this->inexact_newton)
+          this->update_forcing_term(it, residual_norm, last_residual_norm);
+
         // Solve the linear system.
-        if(!linear_solver->solve())
+        if(!this->solve_linear_system())
           throw Exceptions::LinearMatrixSolverException();
 
         // Add \deltaY^{n + 1} to Y^n.
@@ -480,15 +625,16 @@ namespace Hermes
         if(it++ >= newton_max_iter)
         {
           // We want to return the solution in a different structure.
-          this->sln_vector = new Scalar[ndof];
-          for (int i = 0; i < ndof; i++)
-            this->sln_vector[i] = coeff_vec[i];
-
           if(delete_coeff_vec)
           {
-            delete [] coeff_vec;
+            this->sln_vector = coeff_vec;
             coeff_vec = NULL;
           }
+          else
+          {
+            this->sln_vector = new Scalar[ndof];
+            memcpy(this->sln_vector, coeff_vec, ndof * sizeof(Scalar));
+          }
 
           delete [] coeff_vec_back;
           coeff_vec_back = NULL;
@@ -525,7 +671,16 @@ namespace Hermes
     {
       this->check();
 
+      // There is no matrix to keep.
+      if(this->dp->is_matrix_free())
+      {
+        this->warn("NewtonSolver::solve_keep_jacobian() called for a matrix-free problem, solve() is used instead.");
+        this->solve(coeff_vec);
+        return;
+      }
+
       this->tick();
+      this->linear_solver_statistics.clear();
 
       // Obtain the number of degrees of freedom.
       int ndof = this->dp->get_num_dofs();
@@ -565,7 +720,7 @@ namespace Hermes
             sprintf(fileName, "%s%i.m", this->RhsFilename.c_str(), it);
           else
             sprintf(fileName, "%s%i", this->RhsFilename.c_str(), it);
-          FILE* rhs_file = fopen(fileName, "w+");
+          FILE* rhs_file = fopen(fileName, "wb+");
           residual->dump(rhs_file, this->RhsVarname.c_str(), this->RhsFormat, this->rhs_number_format);
           fclose(rhs_file);
         }
@@ -576,6 +731,8 @@ namespace Hermes
             static_cast<DiscreteProblem<Scalar>*>(this->dp)->get_spaces()[i]->edata[e->id].changed_in_last_adaptation = false;
 
         // Measure the residual norm.
+        if(it > 1)
+          last_residual_norm = residual_norm;
         if(residual_as_function)
         {
           // Prepare solutions for measuring residual norm.
@@ -598,14 +755,10 @@ namespace Hermes
         else
         {
           // Calculate the l2-norm of residual vector, this is the traditional way.
-          if(it == 1)
-            last_residual_norm = residual_norm = Global<Scalar>::get_l2_norm(residual);
-          else
-          {
-            last_residual_norm = residual_norm;
-            residual_norm = Global<Scalar>::get_l2_norm(residual);
-          }
+          residual_norm = Global<Scalar>::get_l2_norm(residual);
         }
+        if(it == 1)
+          last_residual_norm = residual_norm;
 
         // Info for the user.
         if(it == 1)
@@ -673,15 +826,16 @@ namespace Hermes
         if(residual_norm < newton_tol && it > 1) 
         {
           // We want to return the solution in a different structure.
-          this->sln_vector = new Scalar[ndof];
-          for (int i = 0; i < ndof; i++)
-            this->sln_vector[i] = coeff_vec[i];
-
           if(delete_coeff_vec)
           {
-            delete [] coeff_vec;
+            this->sln_vector = coeff_vec;
             coeff_vec = NULL;
           }
+          else
+          {
+            this->sln_vector = new Scalar[ndof];
+            memcpy(this->sln_vector, coeff_vec, ndof * sizeof(Scalar));
+          }
 
           delete [] coeff_vec_back;
 
@@ -706,6 +860,7 @@ namespace Hermes
           //
           // Delete the matrix solver created in the constructor.
           delete linear_solver;
+          jacobian_reusable = false;
           // Create new matrix solver with correct matrix.
           linear_solver = create_linear_solver<Scalar>(kept_jacobian, residual);
 
@@ -718,7 +873,7 @@ namespace Hermes
               sprintf(fileName, "%s%i.m", this->matrixFilename.c_str(), it);
             else
               sprintf(fileName, "%s%i", this->matrixFilename.c_str(), it);
-            FILE* matrix_file = fopen(fileName, "w+");
+            FILE* matrix_file = fopen(fileName, "wb+");
 
             kept_jacobian->dump(matrix_file, this->matrixVarname.c_str(), this->matrixFormat, this->matrix_number_format);
             fclose(matrix_file);
@@ -733,8 +888,12 @@ namespace Hermes
         // equation reads J(Y^n) \deltaY^{n + 1} = -F(Y^n).
         residual->change_sign();
 
+        // Inexact Newton's method: the tolerance of the iterative solver follows the convergence.
+        if(this->inexact_newton)
+          this->update_forcing_term(it, residual_norm, last_residual_norm);
+
         // Solve the linear system.
-        if(!linear_solver->solve()) 
+        if(!this->solve_linear_system())
         {
           throw Exceptions::LinearMatrixSolverException();
         }
@@ -757,15 +916,16 @@ namespace Hermes
         if(it++ >= newton_max_iter)
         {
           // We want to return the solution in a different structure.
-          this->sln_vector = new Scalar[ndof];
-          for (int i = 0; i < ndof; i++)
-            this->sln_vector[i] = coeff_vec[i];
-
           if(delete_coeff_vec)
           {
-            delete [] coeff_vec;
+            this->sln_vector = coeff_vec;
             coeff_vec = NULL;
           }
+          else
+          {
+            this->sln_vector = new Scalar[ndof];
+            memcpy(this->sln_vector, coeff_vec, ndof * sizeof(Scalar));
+          }
 
           delete [] coeff_vec_back;
 
@@ -782,7 +942,17 @@ namespace Hermes
     void NewtonSolver<Scalar>::set_iterative_method(const char* iterative_method_name)
     {
       NonlinearSolver<Scalar>::set_iterative_method(iterative_method_name);
-      // Set iterative method in case of iterative solver AztecOO.
+      if(matrix_free)
+      {
+        this->warn("Matrix-free Newton's method uses GMRES, the iterative method %s is ignored.", iterative_method_name);
+        return;
+      }
+      // Set iterative method in case of iterative solver AztecOO or the built-in Krylov solvers.
+      if(dynamic_cast<Hermes::Solvers::KrylovSolver<Scalar>*>(linear_solver) != NULL)
+      {
+        dynamic_cast<Hermes::Solvers::KrylovSolver<Scalar>*>(linear_solver)->set_solver(iterative_method_name);
+        return;
+      }
 #ifdef HAVE_AZTECOO
       dynamic_cast<Hermes::Solvers::AztecOOSolver<Scalar>*>(linear_solver)->set_solver(iterative_method_name);
 #else
@@ -794,7 +964,17 @@ namespace Hermes
     void NewtonSolver<Scalar>::set_preconditioner(const char* preconditioner_name)
     {
       NonlinearSolver<Scalar>::set_preconditioner(preconditioner_name);
-      // Set preconditioner in case of iterative solver AztecOO.
+      if(matrix_free)
+      {
+        this->warn("Matrix-free Newton's method uses unpreconditioned GMRES, the preconditioner %s is ignored.", preconditioner_name);
+        return;
+      }
+      // Set preconditioner in case of iterative solver AztecOO or the built-in Krylov solvers.
+      if(dynamic_cast<Hermes::Solvers::KrylovSolver<Scalar>*>(linear_solver) != NULL)
+      {
+        dynamic_cast<Hermes::Solvers::KrylovSolver<Scalar>*>(linear_solver)->set_precond(preconditioner_name);
+        return;
+      }
 #ifdef HAVE_AZTECOO
       dynamic_cast<Hermes::Solvers::AztecOOSolver<Scalar> *>(linear_solver)->set_precond(preconditioner_name);
 #else
@@ -0,0 +1,422 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "output_queue.h"
+#include "space_h1.h"
+#include "space_hcurl.h"
+#include "space_hdiv.h"
+#include "space_l2.h"
+#include <sstream>
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    LinearizerOutputWriter::LinearizerOutputWriter(const char* file_name, const char* quantity_name, Views::LinearizedDataWriter::Format format,
+      bool mode_3D, int item, double eps) : file_name(file_name), quantity_name(quantity_name), format(format), mode_3D(mode_3D), item(item), eps(eps)
+    {
+    }
+
+    LinearizerOutputWriter::~LinearizerOutputWriter()
+    {
+      for(unsigned int i = 0; i < writers.size(); i++)
+        delete writers[i];
+    }
+
+    void LinearizerOutputWriter::write(OutputSnapshot<double>* snapshot)
+    {
+      for(unsigned int i = 0; i < snapshot->solutions.size(); i++)
+      {
+        if(i == writers.size())
+        {
+          std::stringstream solution_file_name;
+          solution_file_name << file_name;
+          if(snapshot->solutions.size() > 1)
+            solution_file_name << "_" << i;
+          writers.push_back(new Views::LinearizedDataWriter(solution_file_name.str().c_str(), format, true));
+        }
+
+        linearizer.process_solution(snapshot->solutions[i], item, eps);
+        linearizer.write_step(writers[i], quantity_name.c_str(), mode_3D, snapshot->time);
+        writers[i]->end_step();
+      }
+    }
+
+    ImageOutputWriter::ImageOutputWriter(const char* file_name, int width, int height, int item, double eps) : file_name(file_name), item(item), eps(eps),
+      renderer(width, height)
+    {
+    }
+
+    void ImageOutputWriter::write(OutputSnapshot<double>* snapshot)
+    {
+      for(unsigned int i = 0; i < snapshot->solutions.size(); i++)
+      {
+        std::stringstream name;
+        name << file_name << "_" << snapshot->number;
+        if(snapshot->solutions.size() > 1)
+          name << "_" << i;
+        name << ".png";
+        renderer.render(snapshot->solutions[i], item, eps);
+        renderer.save_png(name.str().c_str());
+      }
+    }
+
+    Views::ImageRenderer* ImageOutputWriter::get_renderer()
+    {
+      return &renderer;
+    }
+
+    template<typename Scalar>
+    SolutionOutputWriter<Scalar>::SolutionOutputWriter(const char* file_name) : file_name(file_name)
+    {
+    }
+
+    template<typename Scalar>
+    void SolutionOutputWriter<Scalar>::write(OutputSnapshot<Scalar>* snapshot)
+    {
+      for(unsigned int i = 0; i < snapshot->solutions.size(); i++)
+      {
+        std::stringstream name;
+        name << file_name << "_" << snapshot->number << "_" << i;
+        snapshot->solutions[i]->save_binary((name.str() + ".h2d").c_str());
+        snapshot->spaces[i]->save_binary((name.str() + "_space.h2d").c_str());
+      }
+    }
+
+    template<typename Scalar>
+    ContinuityOutputWriter<Scalar>::ContinuityOutputWriter(CalculationContinuity<Scalar>* continuity,
+      typename CalculationContinuity<Scalar>::IdentificationMethod identification_method) : continuity(continuity), identification_method(identification_method)
+    {
+      if(continuity == NULL)
+        throw Exceptions::NullException(1);
+    }
+
+    template<typename Scalar>
+    void ContinuityOutputWriter<Scalar>::write(OutputSnapshot<Scalar>* snapshot)
+    {
+      switch(identification_method)
+      {
+      case CalculationContinuity<Scalar>::timeAndNumber:
+        continuity->add_record(snapshot->time, snapshot->number, snapshot->meshes, snapshot->spaces, snapshot->solutions, snapshot->time_step);
+        break;
+      case CalculationContinuity<Scalar>::onlyTime:
+        continuity->add_record(snapshot->time, snapshot->meshes, snapshot->spaces, snapshot->solutions, snapshot->time_step);
+        break;
+      case CalculationContinuity<Scalar>::onlyNumber:
+        continuity->add_record(snapshot->number, snapshot->meshes, snapshot->spaces, snapshot->solutions, snapshot->time_step);
+        break;
+      }
+    }
+
+    template<typename Scalar>
+    OutputQueue<Scalar>::OutputQueue(unsigned int max_queued) : max_queued(max_queued), thread_running(false), stopping(false), busy(false), caughtException(NULL)
+    {
+      if(max_queued == 0)
+        throw Exceptions::ValueException("max_queued", 0, 1);
+      pthread_mutex_init(&mutex, NULL);
+      pthread_cond_init(&cond_queued, NULL);
+      pthread_cond_init(&cond_written, NULL);
+    }
+
+    template<typename Scalar>
+    OutputQueue<Scalar>::~OutputQueue()
+    {
+      if(thread_running)
+      {
+        pthread_mutex_lock(&mutex);
+        stopping = true;
+        pthread_cond_signal(&cond_queued);
+        pthread_mutex_unlock(&mutex);
+        pthread_join(thread, NULL);
+      }
+
+      if(caughtException != NULL)
+      {
+        this->warn("An output of the OutputQueue failed: %s", caughtException->what());
+        delete caughtException;
+      }
+
+      for(unsigned int i = 0; i < last_spaces.size(); i++)
+        release(last_spaces[i]);
+
+      pthread_cond_destroy(&cond_written);
+      pthread_cond_destroy(&cond_queued);
+      pthread_mutex_destroy(&mutex);
+    }
+
+    template<typename Scalar>
+    void OutputQueue<Scalar>::add_writer(OutputWriter<Scalar>* writer)
+    {
+      if(writer == NULL)
+        throw Exceptions::NullException(1);
+      if(thread_running)
+        throw Exceptions::Exception("The writers of an OutputQueue have to be added before the first push().");
+      writers.push_back(writer);
+    }
+
+    template<typename Scalar>
+    Space<Scalar>* OutputQueue<Scalar>::copy_space(const Space<Scalar>* space, Mesh* mesh)
+    {
+      Space<Scalar>* copy;
+      switch(space->get_type())
+      {
+      case HERMES_H1_SPACE:
+        copy = new H1Space<Scalar>();
+        break;
+      case HERMES_HCURL_SPACE:
+        copy = new HcurlSpace<Scalar>();
+        break;
+      case HERMES_HDIV_SPACE:
+        copy = new HdivSpace<Scalar>();
+        break;
+      case HERMES_L2_SPACE:
+        copy = new L2Space<Scalar>();
+        break;
+      default:
+        throw Exceptions::Exception("Unknown space type in OutputQueue::push().");
+      }
+      // Copies the mesh and assigns the dofs from zero.
+      copy->copy(space, mesh);
+      return copy;
+    }
+
+    template<typename Scalar>
+    void OutputQueue<Scalar>::push(double time, unsigned int number, const Scalar* coeff_vec, const Space<Scalar>* space, double time_step)
+    {
+      Hermes::vector<const Space<Scalar>*> spaces;
+      spaces.push_back(space);
+      push(time, number, coeff_vec, spaces, time_step);
+    }
+
+    template<typename Scalar>
+    void OutputQueue<Scalar>::push(double time, unsigned int number, const Scalar* coeff_vec, Hermes::vector<const Space<Scalar>*> spaces, double time_step)
+    {
+      if(coeff_vec == NULL)
+        throw Exceptions::NullException(3);
+
+      // The spaces are copied here, the caller may change them right after the call.
+      Hermes::vector<SpaceCopy*> space_copies;
+      int ndof = 0;
+      for(unsigned int i = 0; i < spaces.size(); i++)
+      {
+        const Space<Scalar>* space = spaces[i];
+        SpaceCopy* last = (i < last_spaces.size()) ? last_spaces[i] : NULL;
+        if(last != NULL && last->original == space && last->original_seq == space->get_seq()
+          && last->original_mesh_seq == space->get_mesh()->get_seq() && last->num_dofs == space->get_num_dofs())
+          space_copies.push_back(last);
+        else
+        {
+          SpaceCopy* space_copy = new SpaceCopy;
+          space_copy->original = space;
+          space_copy->original_seq = space->get_seq();
+          space_copy->original_mesh_seq = space->get_mesh()->get_seq();
+          space_copy->num_dofs = space->get_num_dofs();
+          space_copy->mesh = new Mesh;
+          space_copy->space = copy_space(space, space_copy->mesh);
+          space_copy->ref_count = 0;
+          space_copies.push_back(space_copy);
+        }
+        ndof += space->get_num_dofs();
+      }
+
+      QueuedSnapshot* snapshot = new QueuedSnapshot;
+      snapshot->time = time;
+      snapshot->number = number;
+      snapshot->time_step = time_step;
+      snapshot->coeff_vec = new Scalar[ndof];
+      memcpy(snapshot->coeff_vec, coeff_vec, ndof * sizeof(Scalar));
+      snapshot->spaces = space_copies;
+
+      pthread_mutex_lock(&mutex);
+      // The references of the snapshot and of last_spaces.
+      for(unsigned int i = 0; i < space_copies.size(); i++)
+        space_copies[i]->ref_count += 2;
+      for(unsigned int i = 0; i < last_spaces.size(); i++)
+        release(last_spaces[i]);
+      last_spaces = space_copies;
+
+      while(queue.size() >= max_queued)
+        pthread_cond_wait(&cond_written, &mutex);
+      queue.push_back(snapshot);
+      pthread_cond_signal(&cond_queued);
+      pthread_mutex_unlock(&mutex);
+
+      if(!thread_running)
+      {
+        if(pthread_create(&thread, NULL, output_thread_func, this) != 0)
+          throw Exceptions::Exception("The output thread of the OutputQueue could not be started.");
+        thread_running = true;
+      }
+
+      rethrow();
+    }
+
+    template<typename Scalar>
+    void OutputQueue<Scalar>::finish()
+    {
+      pthread_mutex_lock(&mutex);
+      while(!queue.empty() || busy)
+        pthread_cond_wait(&cond_written, &mutex);
+      pthread_mutex_unlock(&mutex);
+
+      rethrow();
+    }
+
+    template<typename Scalar>
+    unsigned int OutputQueue<Scalar>::get_num_queued()
+    {
+      pthread_mutex_lock(&mutex);
+      unsigned int num_queued = queue.size();
+      pthread_mutex_unlock(&mutex);
+      return num_queued;
+    }
+
+    template<typename Scalar>
+    void OutputQueue<Scalar>::rethrow()
+    {
+      pthread_mutex_lock(&mutex);
+      Hermes::Exceptions::Exception* e = caughtException;
+      caughtException = NULL;
+      pthread_mutex_unlock(&mutex);
+
+      if(e != NULL)
+      {
+        Hermes::Exceptions::Exception copy(*e);
+        delete e;
+        throw copy;
+      }
+    }
+
+    template<typename Scalar>
+    void OutputQueue<Scalar>::release(SpaceCopy* space_copy)
+    {
+      if(--space_copy->ref_count == 0)
+      {
+        delete space_copy->space;
+        delete space_copy->mesh;
+        delete space_copy;
+      }
+    }
+
+    template<typename Scalar>
+    void* OutputQueue<Scalar>::output_thread_func(void* queue)
+    {
+      ((OutputQueue<Scalar>*)queue)->output_loop();
+      return NULL;
+    }
+
+    template<typename Scalar>
+    void OutputQueue<Scalar>::output_loop()
+    {
+      pthread_mutex_lock(&mutex);
+      while(true)
+      {
+        while(queue.empty() && !stopping)
+          pthread_cond_wait(&cond_queued, &mutex);
+        // The remaining snapshots are written before stopping.
+        if(queue.empty())
+          break;
+
+        QueuedSnapshot* snapshot = queue.front();
+        queue.pop_front();
+        busy = true;
+        pthread_cond_broadcast(&cond_written);
+        pthread_mutex_unlock(&mutex);
+
+        Hermes::Exceptions::Exception* e = NULL;
+        try
+        {
+          write(snapshot);
+        }
+        catch(Hermes::Exceptions::Exception& exception)
+        {
+          e = exception.clone();
+        }
+        catch(std::exception& exception)
+        {
+          e = new Hermes::Exceptions::Exception(exception.what());
+        }
+        delete [] snapshot->coeff_vec;
+
+        pthread_mutex_lock(&mutex);
+        for(unsigned int i = 0; i < snapshot->spaces.size(); i++)
+          release(snapshot->spaces[i]);
+        delete snapshot;
+        if(e != NULL)
+        {
+          if(caughtException == NULL)
+            caughtException = e;
+          else
+            delete e;
+        }
+        busy = false;
+        pthread_cond_broadcast(&cond_written);
+      }
+      pthread_mutex_unlock(&mutex);
+    }
+
+    template<typename Scalar>
+    void OutputQueue<Scalar>::write(QueuedSnapshot* queued)
+    {
+      OutputSnapshot<Scalar> snapshot;
+      snapshot.time = queued->time;
+      snapshot.number = queued->number;
+      snapshot.time_step = queued->time_step;
+
+      int start_index = 0;
+      for(unsigned int i = 0; i < queued->spaces.size(); i++)
+      {
+        snapshot.meshes.push_back(queued->spaces[i]->mesh);
+        snapshot.spaces.push_back(queued->spaces[i]->space);
+        Solution<Scalar>* solution = new Solution<Scalar>();
+        snapshot.solutions.push_back(solution);
+        try
+        {
+          Solution<Scalar>::vector_to_solution(queued->coeff_vec, queued->spaces[i]->space, solution, true, start_index);
+        }
+        catch(Hermes::Exceptions::Exception&)
+        {
+          for(unsigned int j = 0; j < snapshot.solutions.size(); j++)
+            delete snapshot.solutions[j];
+          throw;
+        }
+        start_index += queued->spaces[i]->num_dofs;
+      }
+
+      try
+      {
+        for(unsigned int i = 0; i < writers.size(); i++)
+          writers[i]->write(&snapshot);
+      }
+      catch(Hermes::Exceptions::Exception&)
+      {
+        for(unsigned int i = 0; i < snapshot.solutions.size(); i++)
+          delete snapshot.solutions[i];
+        throw;
+      }
+      for(unsigned int i = 0; i < snapshot.solutions.size(); i++)
+        delete snapshot.solutions[i];
+    }
+
+    template class HERMES_API OutputWriter<double>;
+    template class HERMES_API OutputWriter<std::complex<double> >;
+    template class HERMES_API SolutionOutputWriter<double>;
+    template class HERMES_API SolutionOutputWriter<std::complex<double> >;
+    template class HERMES_API ContinuityOutputWriter<double>;
+    template class HERMES_API ContinuityOutputWriter<std::complex<double> >;
+    template class HERMES_API OutputQueue<double>;
+    template class HERMES_API OutputQueue<std::complex<double> >;
+  }
+}
@@ -0,0 +1,174 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+#include "parameter_sweep.h"
+#include "api2d.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    template<typename Scalar>
+    ParameterSweep<Scalar>::ParameterSweep(Hermes::vector<const WeakForm<Scalar>*> weakforms, Hermes::vector<const Space<Scalar>*> spaces) :
+      weakforms(weakforms), dp(NULL), num_concurrent(0), ndof(0)
+    {
+      init(spaces);
+    }
+
+    template<typename Scalar>
+    ParameterSweep<Scalar>::ParameterSweep(Hermes::vector<const WeakForm<Scalar>*> weakforms, const Space<Scalar>* space) :
+      weakforms(weakforms), dp(NULL), num_concurrent(0), ndof(0)
+    {
+      Hermes::vector<const Space<Scalar>*> spaces;
+      spaces.push_back(space);
+      init(spaces);
+    }
+
+    template<typename Scalar>
+    void ParameterSweep<Scalar>::init(Hermes::vector<const Space<Scalar>*> spaces)
+    {
+      if(weakforms.empty())
+        throw Exceptions::NullException(1);
+      for(unsigned int i = 0; i < weakforms.size(); i++)
+        if(weakforms[i] == NULL)
+          throw Exceptions::NullException(1, i);
+      dp = new DiscreteProblemLinear<Scalar>(weakforms[0], spaces);
+    }
+
+    template<typename Scalar>
+    ParameterSweep<Scalar>::~ParameterSweep()
+    {
+      free_slots();
+      for(unsigned int i = 0; i < sln_vectors.size(); i++)
+        delete [] sln_vectors[i];
+      delete dp;
+    }
+
+    template<typename Scalar>
+    void ParameterSweep<Scalar>::set_num_concurrent(int num_concurrent)
+    {
+      if(num_concurrent < 0)
+        throw Exceptions::ValueException("num_concurrent", num_concurrent, 0);
+      this->num_concurrent = num_concurrent;
+    }
+
+    template<typename Scalar>
+    int ParameterSweep<Scalar>::get_num_concurrent() const
+    {
+      if(num_concurrent > 0)
+        return num_concurrent;
+      return Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
+    }
+
+    template<typename Scalar>
+    int ParameterSweep<Scalar>::get_num_instances() const
+    {
+      return weakforms.size();
+    }
+
+    template<typename Scalar>
+    Scalar* ParameterSweep<Scalar>::get_sln_vector(int instance)
+    {
+      if(instance < 0 || instance >= (int)sln_vectors.size())
+        throw Exceptions::ValueException("instance", instance, 0, (int)sln_vectors.size() - 1);
+      return sln_vectors[instance];
+    }
+
+    template<typename Scalar>
+    void ParameterSweep<Scalar>::init_slots(int count)
+    {
+      while((int)matrices.size() < count)
+      {
+        matrices.push_back(create_matrix<Scalar>());
+        rhss.push_back(create_vector<Scalar>());
+        solvers.push_back(create_linear_solver<Scalar>(matrices.back(), rhss.back()));
+      }
+    }
+
+    template<typename Scalar>
+    void ParameterSweep<Scalar>::free_slots()
+    {
+      for(unsigned int i = 0; i < matrices.size(); i++)
+      {
+        delete solvers[i];
+        delete matrices[i];
+        delete rhss[i];
+      }
+      solvers.clear();
+      matrices.clear();
+      rhss.clear();
+    }
+
+    template<typename Scalar>
+    void ParameterSweep<Scalar>::solve()
+    {
+      this->tick();
+
+      int num_instances = weakforms.size();
+      ndof = Space<Scalar>::get_num_dofs(dp->get_spaces());
+      for(unsigned int i = 0; i < sln_vectors.size(); i++)
+        delete [] sln_vectors[i];
+      sln_vectors.assign(num_instances, (Scalar*)NULL);
+
+      // The other backends are not safe to be called from several threads at once.
+      int solver_type = Hermes::HermesCommonApi.get_integral_param_value(Hermes::matrixSolverType);
+      int slots = (solver_type == SOLVER_UMFPACK || solver_type == SOLVER_KRYLOV) ? get_num_concurrent() : 1;
+      slots = std::min(slots, num_instances);
+      init_slots(slots);
+
+      for(int first = 0; first < num_instances; first += slots)
+      {
+        int count = std::min(slots, num_instances - first);
+
+        // The assemblings use all the threads each.
+        for(int slot = 0; slot < count; slot++)
+        {
+          dp->replace_weak_formulation(weakforms[first + slot]);
+          dp->assemble(matrices[slot], rhss[slot]);
+        }
+
+        solve_status.reset();
+#pragma omp parallel for num_threads(count) schedule(static, 1)
+        for(int slot = 0; slot < count; slot++)
+        {
+          if(solve_status.has_failed())
+            continue;
+          try
+          {
+            if(!solvers[slot]->solve())
+              throw Exceptions::LinearMatrixSolverException("ParameterSweep: the system of an instance could not be solved.");
+            Scalar* sln_vector = new Scalar[ndof];
+            memcpy(sln_vector, solvers[slot]->get_sln_vector(), ndof * sizeof(Scalar));
+            sln_vectors[first + slot] = sln_vector;
+          }
+          catch(Hermes::Exceptions::Exception& e)
+          {
+            solve_status.fail(e);
+          }
+          catch(std::exception& e)
+          {
+            solve_status.fail(e);
+          }
+        }
+        solve_status.rethrow();
+      }
+
+      this->tick();
+      this->info("ParameterSweep: %i instances, %i at once, duration: %f s.", num_instances, slots, this->last());
+    }
+
+    template HERMES_API class ParameterSweep<double>;
+    template HERMES_API class ParameterSweep<std::complex<double> >;
+  }
+}
@@ -0,0 +1,360 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "parareal.h"
+#include "api2d.h"
+#include "projections/ogprojection.h"
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    template<typename Scalar>
+    Parareal<Scalar>::Propagator::Propagator(const WeakForm<Scalar>* wf, Hermes::vector<const Space<Scalar>*> spaces, ButcherTable* bt)
+    {
+      for(unsigned int space_i = 0; space_i < spaces.size(); space_i++)
+      {
+        typename Space<Scalar>::ReferenceSpaceCreator ref_space_creator(spaces[space_i], spaces[space_i]->get_mesh(), 0);
+        Space<Scalar>* space = ref_space_creator.create_ref_space();
+        this->spaces.push_back(space);
+        this->spaces_const.push_back(space);
+        this->slns_prev.push_back(new Solution<Scalar>);
+        this->slns_new.push_back(new Solution<Scalar>);
+      }
+      this->runge_kutta = new RungeKutta<Scalar>(wf, this->spaces_const, bt);
+      this->runge_kutta->set_verbose_output(false);
+    }
+
+    template<typename Scalar>
+    Parareal<Scalar>::Propagator::~Propagator()
+    {
+      delete runge_kutta;
+      for(unsigned int space_i = 0; space_i < spaces.size(); space_i++)
+      {
+        delete slns_prev[space_i];
+        delete slns_new[space_i];
+        delete spaces[space_i];
+      }
+    }
+
+    template<typename Scalar>
+    void Parareal<Scalar>::Propagator::propagate(Scalar* in, Scalar* out, double time, double time_step, unsigned int num_steps)
+    {
+      Space<Scalar>::update_essential_bc_values(spaces, time);
+      Solution<Scalar>::vector_to_solutions(in, spaces_const, slns_prev);
+
+      for(unsigned int step = 0; step < num_steps; step++)
+      {
+        runge_kutta->set_time(time + step * time_step);
+        runge_kutta->set_time_step(time_step);
+        runge_kutta->rk_time_step_newton(slns_prev, slns_new);
+        std::swap(slns_prev, slns_new);
+      }
+
+      OGProjection<Scalar> ogProjection;
+      ogProjection.project_global(spaces_const, slns_prev, out);
+    }
+
+    template<typename Scalar>
+    Parareal<Scalar>::Parareal(const WeakForm<Scalar>* wf, Hermes::vector<const Space<Scalar>*> spaces, ButcherTable* bt_coarse, ButcherTable* bt_fine)
+      : wf(wf), spaces(spaces)
+    {
+      init(bt_coarse, bt_fine);
+    }
+
+    template<typename Scalar>
+    Parareal<Scalar>::Parareal(const WeakForm<Scalar>* wf, const Space<Scalar>* space, ButcherTable* bt_coarse, ButcherTable* bt_fine)
+      : wf(wf)
+    {
+      this->spaces.push_back(space);
+      init(bt_coarse, bt_fine);
+    }
+
+    template<typename Scalar>
+    void Parareal<Scalar>::init(ButcherTable* bt_coarse, ButcherTable* bt_fine)
+    {
+      if(bt_coarse == NULL)
+        throw Exceptions::NullException(3);
+      if(bt_fine == NULL)
+        throw Exceptions::NullException(4);
+
+      this->bt_fine = bt_fine;
+      this->coarse_propagator = new Propagator(wf, spaces, bt_coarse);
+      this->coarse_steps = 1;
+      this->fine_steps = 10;
+      this->tolerance = 1e-6;
+      this->max_iterations = 0;
+      this->num_threads = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
+      this->newton_tol = 1e-6;
+      this->newton_max_iter = 20;
+      this->states = NULL;
+      this->num_states = 0;
+      this->ndof = 0;
+      this->num_iterations = 0;
+    }
+
+    template<typename Scalar>
+    Parareal<Scalar>::~Parareal()
+    {
+      delete coarse_propagator;
+      for(unsigned int i = 0; i < fine_propagators.size(); i++)
+        delete fine_propagators[i];
+      free_states();
+    }
+
+    template<typename Scalar>
+    void Parareal<Scalar>::free_states()
+    {
+      for(unsigned int i = 0; i < num_states; i++)
+        delete [] states[i];
+      delete [] states;
+      states = NULL;
+      num_states = 0;
+    }
+
+    template<typename Scalar>
+    void Parareal<Scalar>::set_coarse_steps(unsigned int steps)
+    {
+      if(steps == 0)
+        throw Exceptions::ValueException("coarse steps", steps, 1);
+      this->coarse_steps = steps;
+    }
+
+    template<typename Scalar>
+    void Parareal<Scalar>::set_fine_steps(unsigned int steps)
+    {
+      if(steps == 0)
+        throw Exceptions::ValueException("fine steps", steps, 1);
+      this->fine_steps = steps;
+    }
+
+    template<typename Scalar>
+    void Parareal<Scalar>::set_tolerance(double tolerance)
+    {
+      this->tolerance = tolerance;
+    }
+
+    template<typename Scalar>
+    void Parareal<Scalar>::set_max_iterations(unsigned int max_iterations)
+    {
+      this->max_iterations = max_iterations;
+    }
+
+    template<typename Scalar>
+    void Parareal<Scalar>::set_num_threads(int num_threads)
+    {
+      if(num_threads < 1)
+        throw Exceptions::ValueException("number of threads", num_threads, 1);
+      this->num_threads = num_threads;
+    }
+
+    template<typename Scalar>
+    void Parareal<Scalar>::set_newton_tol(double newton_tol)
+    {
+      this->newton_tol = newton_tol;
+    }
+
+    template<typename Scalar>
+    void Parareal<Scalar>::set_newton_max_iter(int newton_max_iter)
+    {
+      this->newton_max_iter = newton_max_iter;
+    }
+
+    template<typename Scalar>
+    unsigned int Parareal<Scalar>::get_num_iterations() const
+    {
+      return this->num_iterations;
+    }
+
+    template<typename Scalar>
+    Scalar* Parareal<Scalar>::get_slice_vector(unsigned int slice)
+    {
+      if(slice >= num_states)
+        throw Exceptions::ValueException("slice", slice, num_states);
+      return states[slice];
+    }
+
+    template<typename Scalar>
+    void Parareal<Scalar>::create_fine_propagators(int count)
+    {
+      while(fine_propagators.size() < (unsigned int)count)
+        fine_propagators.push_back(new Propagator(wf, spaces, bt_fine));
+      for(unsigned int i = 0; i < fine_propagators.size(); i++)
+      {
+        fine_propagators[i]->runge_kutta->set_newton_tol(newton_tol);
+        fine_propagators[i]->runge_kutta->set_newton_max_iter(newton_max_iter);
+      }
+    }
+
+    template<typename Scalar>
+    void Parareal<Scalar>::solve(Solution<Scalar>* sln_initial, Solution<Scalar>* sln_end, double t_start, double t_end, unsigned int num_slices)
+    {
+      Hermes::vector<Solution<Scalar>*> slns_initial;
+      slns_initial.push_back(sln_initial);
+      Hermes::vector<Solution<Scalar>*> slns_end;
+      slns_end.push_back(sln_end);
+      this->solve(slns_initial, slns_end, t_start, t_end, num_slices);
+    }
+
+    template<typename Scalar>
+    void Parareal<Scalar>::solve(Hermes::vector<Solution<Scalar>*> slns_initial, Hermes::vector<Solution<Scalar>*> slns_end, double t_start, double t_end, unsigned int num_slices)
+    {
+      if(num_slices == 0)
+        throw Exceptions::ValueException("number of slices", num_slices, 1);
+      if(t_end <= t_start)
+        throw Exceptions::ValueException("t_end", t_end, t_start);
+
+      this->tick();
+
+      ndof = Space<Scalar>::get_num_dofs(spaces);
+      free_states();
+      num_states = num_slices + 1;
+      states = new Scalar*[num_states];
+      for(unsigned int i = 0; i < num_states; i++)
+        states[i] = new Scalar[ndof];
+
+      // G(U_n^k) and F(U_n^k) of the slices.
+      Scalar** coarse_values = new Scalar*[num_slices];
+      Scalar** fine_values = new Scalar*[num_slices];
+      for(unsigned int i = 0; i < num_slices; i++)
+      {
+        coarse_values[i] = new Scalar[ndof];
+        fine_values[i] = new Scalar[ndof];
+      }
+      Scalar* coarse_value = new Scalar[ndof];
+
+      coarse_propagator->runge_kutta->set_newton_tol(newton_tol);
+      coarse_propagator->runge_kutta->set_newton_max_iter(newton_max_iter);
+
+      int num_fine_propagators = std::max(1, std::min(num_threads, (int)num_slices));
+      create_fine_propagators(num_fine_propagators);
+
+      double slice_length = (t_end - t_start) / num_slices;
+      double coarse_time_step = slice_length / coarse_steps;
+      double fine_time_step = slice_length / fine_steps;
+
+      OGProjection<Scalar> ogProjection;
+      ogProjection.project_global(spaces, slns_initial, states[0]);
+
+      // Prediction by the coarse propagator.
+      for(unsigned int n = 0; n < num_slices; n++)
+      {
+        coarse_propagator->propagate(states[n], coarse_values[n], t_start + n * slice_length, coarse_time_step, coarse_steps);
+        memcpy(states[n + 1], coarse_values[n], ndof * sizeof(Scalar));
+      }
+
+      unsigned int k = 0;
+      while(true)
+      {
+        k++;
+
+        // The states up to the slice k - 1 are final, the fine propagation starts from there.
+        int first_slice = k - 1;
+        bool failed = false;
+        std::string failure_message;
+#pragma omp parallel for schedule(dynamic, 1) num_threads(num_fine_propagators)
+        for(int n = first_slice; n < (int)num_slices; n++)
+        {
+          try
+          {
+            fine_propagators[omp_get_thread_num()]->propagate(states[n], fine_values[n], t_start + n * slice_length, fine_time_step, fine_steps);
+          }
+          catch(std::exception& e)
+          {
+#pragma omp critical(Parareal_failure)
+            {
+              failed = true;
+              failure_message = e.what();
+            }
+          }
+        }
+        if(failed)
+        {
+          for(unsigned int i = 0; i < num_slices; i++)
+          {
+            delete [] coarse_values[i];
+            delete [] fine_values[i];
+          }
+          delete [] coarse_values;
+          delete [] fine_values;
+          delete [] coarse_value;
+          throw Exceptions::Exception("Parareal: the fine propagation failed: %s", failure_message.c_str());
+        }
+
+        // Correction U_{n+1}^{k} = G(U_n^{k}) + F(U_n^{k-1}) - G(U_n^{k-1}), sequential.
+        // The state of the first slice did not change, so its new state is just the fine one.
+        double max_change = 0.;
+        for(unsigned int n = first_slice; n < num_slices; n++)
+        {
+          Scalar* new_state = states[n + 1];
+          double change_norm = 0., state_norm = 0.;
+          if(n == (unsigned int)first_slice)
+          {
+            for(int i = 0; i < ndof; i++)
+            {
+              Scalar value = fine_values[n][i];
+              change_norm += std::abs((value - new_state[i]) * (value - new_state[i]));
+              state_norm += std::abs(value * value);
+              new_state[i] = value;
+            }
+          }
+          else
+          {
+            coarse_propagator->propagate(states[n], coarse_value, t_start + n * slice_length, coarse_time_step, coarse_steps);
+            for(int i = 0; i < ndof; i++)
+            {
+              Scalar value = coarse_value[i] + fine_values[n][i] - coarse_values[n][i];
+              change_norm += std::abs((value - new_state[i]) * (value - new_state[i]));
+              state_norm += std::abs(value * value);
+              new_state[i] = value;
+            }
+            std::swap(coarse_values[n], coarse_value);
+          }
+          if(state_norm > 0.)
+            max_change = std::max(max_change, std::sqrt(change_norm / state_norm));
+          else
+            max_change = std::max(max_change, std::sqrt(change_norm));
+        }
+
+        this->info("\tParareal: iteration %d, largest relative change of the slice states: %g.", k, max_change);
+
+        if(max_change < tolerance || k >= num_slices || (max_iterations > 0 && k >= max_iterations))
+          break;
+      }
+      num_iterations = k;
+
+      for(unsigned int i = 0; i < num_slices; i++)
+      {
+        delete [] coarse_values[i];
+        delete [] fine_values[i];
+      }
+      delete [] coarse_values;
+      delete [] fine_values;
+      delete [] coarse_value;
+
+      // The final state with the boundary conditions at t_end.
+      Hermes::vector<Space<Scalar>*> spaces_mutable;
+      for(unsigned int space_i = 0; space_i < spaces.size(); space_i++)
+        spaces_mutable.push_back(const_cast<Space<Scalar>*>(spaces[space_i]));
+      Space<Scalar>::update_essential_bc_values(spaces_mutable, t_end);
+      Solution<Scalar>::vector_to_solutions(states[num_slices], spaces, slns_end);
+
+      this->tick();
+      this->info("\tParareal: %d iterations, duration: %f s.\n", num_iterations, this->last());
+    }
+
+    template class HERMES_API Parareal<double>;
+    template class HERMES_API Parareal<std::complex<double> >;
+  }
+}
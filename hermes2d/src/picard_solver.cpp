@@ -136,7 +136,7 @@ namespace Hermes
     }
 
     template<typename Scalar>
-    void PicardSolver<Scalar>::calculate_anderson_coeffs(Scalar** previous_vectors, Scalar* anderson_coeffs, int num_last_vectors_used, int ndof)
+    void PicardSolver<Scalar>::calculate_anderson_coeffs(Scalar* residual_products, int* residual_slots, Scalar* anderson_coeffs, int num_last_vectors_used)
     {
       if(num_last_vectors_used <= 1) throw Hermes::Exceptions::Exception("Picard: Anderson acceleration makes sense only if at least two last iterations are used.");
 
@@ -150,32 +150,26 @@ namespace Hermes
       // In the following, num_last_vectors_used is at least three.
       // Thematrix problem will have dimension num_last_vectors_used - 2.
       int n = num_last_vectors_used - 2;
+      int num_residuals = num_last_vectors_used - 1;
 
       // Allocate the matrix system for the Anderson coefficients.
       double** mat = new_matrix<double>(n, n);
       Scalar* rhs = new Scalar[n];
 
-      // Set up the matrix and rhs vector.
+      // Set up the matrix and rhs vector from the products of the residuals,
+      // (r_n - r_i) . (r_n - r_j) = r_n . r_n - r_n . r_i - r_n . r_j + r_i . r_j.
+      Scalar product_nn = residual_products[residual_slots[n] * num_residuals + residual_slots[n]];
       for (int i = 0; i < n; i++)
       {
+        Scalar product_ni = residual_products[residual_slots[n] * num_residuals + residual_slots[i]];
+
         // Calculate i-th entry of the rhs vector.
-        rhs[i] = 0;
-        for (int k = 0; k < ndof; k++)
-        {
-          Scalar residual_n_k = previous_vectors[n + 1][k] - previous_vectors[n][k];
-          Scalar residual_i_k = previous_vectors[i + 1][k] - previous_vectors[i][k];
-          rhs[i] += residual_n_k * (residual_n_k - residual_i_k);
-        }
+        rhs[i] = product_nn - product_ni;
         for (int j = 0; j < n; j++)
         {
-          Scalar val = 0;
-          for (int k = 0; k < ndof; k++)
-          {
-            Scalar residual_n_k = previous_vectors[n + 1][k] - previous_vectors[n][k];
-            Scalar residual_i_k = previous_vectors[i + 1][k] - previous_vectors[i][k];
-            Scalar residual_j_k = previous_vectors[j + 1][k] - previous_vectors[j][k];
-            val += (residual_n_k - residual_i_k) * (residual_n_k - residual_j_k);
-          }
+          Scalar product_nj = residual_products[residual_slots[n] * num_residuals + residual_slots[j]];
+          Scalar product_ij = residual_products[residual_slots[i] * num_residuals + residual_slots[j]];
+          Scalar val = product_nn - product_ni - product_nj + product_ij;
 
           // FIXME: This is not a nice way to cast Scalar to double. Not mentioning
           // that this will not work for Scalar = complex.
@@ -203,10 +197,80 @@ namespace Hermes
       // Clean up.
       delete [] mat;
       delete [] rhs;
+      delete [] perm;
 
       return;
     }
 
+    template<typename Scalar>
+    void PicardSolver<Scalar>::store_anderson_vector(Scalar* new_vector, Scalar* previous_vectors, Scalar* previous_residuals, Scalar* residual_products,
+      int* residual_slots, int& vec_in_memory, int& newest_vector, int num_last_vectors_used, int ndof)
+    {
+      int slot = (newest_vector + 1) % num_last_vectors_used;
+      Scalar* last_vector = previous_vectors + newest_vector * ndof;
+      Scalar* stored_vector = previous_vectors + slot * ndof;
+
+      // Only one vector is kept, no residuals.
+      if(num_last_vectors_used == 1)
+      {
+        memcpy(stored_vector, new_vector, ndof * sizeof(Scalar));
+        return;
+      }
+
+      // If memory full, the oldest residual is forgotten together with the oldest vector,
+      // its slot is used for the new one.
+      int num_residuals = vec_in_memory - 1;
+      int max_residuals = num_last_vectors_used - 1;
+      int residual_slot;
+      if(num_residuals == max_residuals)
+      {
+        residual_slot = residual_slots[0];
+        for (int i = 0; i < num_residuals - 1; i++)
+          residual_slots[i] = residual_slots[i + 1];
+        num_residuals--;
+      }
+      else
+      {
+        residual_slot = num_residuals;
+        vec_in_memory++;
+      }
+      residual_slots[num_residuals] = residual_slot;
+      Scalar* new_residual = previous_residuals + residual_slot * ndof;
+
+      // One pass over the vectors: store the new vector and its residual, and multiply
+      // the residual with the kept ones and itself.
+      Scalar* products = new Scalar[num_residuals + 1];
+      memset(products, 0, (num_residuals + 1) * sizeof(Scalar));
+#pragma omp parallel
+      {
+        Scalar* partial = new Scalar[num_residuals + 1];
+        memset(partial, 0, (num_residuals + 1) * sizeof(Scalar));
+#pragma omp for schedule(static) nowait
+        for (int k = 0; k < ndof; k++)
+        {
+          Scalar residual_k = new_vector[k] - last_vector[k];
+          stored_vector[k] = new_vector[k];
+          new_residual[k] = residual_k;
+          for (int l = 0; l < num_residuals; l++)
+            partial[l] += residual_k * previous_residuals[residual_slots[l] * ndof + k];
+          partial[num_residuals] += residual_k * residual_k;
+        }
+#pragma omp critical(PicardSolver_anderson_products)
+        for (int l = 0; l <= num_residuals; l++)
+          products[l] += partial[l];
+        delete [] partial;
+      }
+
+      for (int l = 0; l <= num_residuals; l++)
+      {
+        residual_products[residual_slot * max_residuals + residual_slots[l]] = products[l];
+        residual_products[residual_slots[l] * max_residuals + residual_slot] = products[l];
+      }
+      delete [] products;
+
+      newest_vector = slot;
+    }
+
     template<typename Scalar>
     void PicardSolver<Scalar>::set_picard_tol(double tol)
     {
@@ -299,21 +363,31 @@ namespace Hermes
         last_iter_vector[i] = this->sln_vector[i];
 
       // If Anderson is used, allocate memory for vectors and coefficients.
-      Scalar** previous_vectors = NULL;      // To store num_last_vectors_used last coefficient vectors.
+      // The last vectors and their differences (residuals) are stored as ring buffers, in one block each,
+      // and the products of the residuals are updated with every new vector (see store_anderson_vector()).
+      Scalar* previous_vectors = NULL;       // To store num_last_vectors_used last coefficient vectors.
+      Scalar* previous_residuals = NULL;     // To store num_last_vectors_used - 1 differences of the last coefficient vectors.
+      Scalar* residual_products = NULL;      // Products of the residuals, indexed by their slots in previous_residuals.
+      int* residual_slots = NULL;            // Slots of the residuals, from the oldest one.
       Scalar* anderson_coeffs = NULL;        // To store num_last_vectors_used - 1 Anderson coefficients.
+      Scalar** anderson_vectors = NULL;      // The stored vectors, from the oldest one.
       if (anderson_is_on)
       {
-        previous_vectors = new Scalar*[num_last_vectors_used];
-        for (int i = 0; i < num_last_vectors_used; i++) previous_vectors[i] = new Scalar[ndof];
+        previous_vectors = new Scalar[num_last_vectors_used * ndof];
+        previous_residuals = new Scalar[(num_last_vectors_used - 1) * ndof];
+        residual_products = new Scalar[(num_last_vectors_used - 1) * (num_last_vectors_used - 1)];
+        residual_slots = new int[num_last_vectors_used];
         anderson_coeffs = new Scalar[num_last_vectors_used-1];
+        anderson_vectors = new Scalar*[num_last_vectors_used];
       }
 
       // If Anderson is used, save the initial coefficient vector in the memory.
       if (anderson_is_on)
-        for (int i = 0; i < ndof; i++) previous_vectors[0][i] = this->sln_vector[i];
+        memcpy(previous_vectors, this->sln_vector, ndof * sizeof(Scalar));
 
       int it = 1;
       int vec_in_memory = 1;   // There is already one vector in the memory.
+      int newest_vector = 0;   // Its slot in previous_vectors.
 
       this->on_initialization();
 
@@ -330,7 +404,7 @@ namespace Hermes
             sprintf(fileName, "%s%i.m", this->matrixFilename.c_str(), it);
           else
             sprintf(fileName, "%s%i", this->matrixFilename.c_str(), it);
-          FILE* matrix_file = fopen(fileName, "w+");
+          FILE* matrix_file = fopen(fileName, "wb+");
 
           matrix->dump(matrix_file, this->matrixVarname.c_str(), this->matrixFormat, this->matrix_number_format);
           fclose(matrix_file);
@@ -343,7 +417,7 @@ namespace Hermes
             sprintf(fileName, "%s%i.m", this->RhsFilename.c_str(), it);
           else
             sprintf(fileName, "%s%i", this->RhsFilename.c_str(), it);
-          FILE* rhs_file = fopen(fileName, "w+");
+          FILE* rhs_file = fopen(fileName, "wb+");
           rhs->dump(rhs_file, this->RhsVarname.c_str(), this->RhsFormat, this->rhs_number_format);
           fclose(rhs_file);
           delete [] fileName;
@@ -361,38 +435,27 @@ namespace Hermes
 
         // If Anderson is used, store the new vector in the memory.
         if (anderson_is_on)
-        {
-          // If memory not full, just add the vector.
-          if (vec_in_memory < num_last_vectors_used)
-          {
-            for (int i = 0; i < ndof; i++) previous_vectors[vec_in_memory][i] = this->sln_vector[i];
-            vec_in_memory++;
-          }
-          else
-          {
-            // If memory full, shift all vectors back, forgetting the oldest one.
-            // Save this->sln_vector[] as the newest one.
-            Scalar* oldest_vec = previous_vectors[0];
-            for (int i = 0; i < num_last_vectors_used-1; i++) previous_vectors[i] = previous_vectors[i + 1];
-            previous_vectors[num_last_vectors_used-1] = oldest_vec;
-            for (int j = 0; j < ndof; j++) previous_vectors[num_last_vectors_used-1][j] = this->sln_vector[j];
-          }
-        }
+          store_anderson_vector(this->sln_vector, previous_vectors, previous_residuals, residual_products, residual_slots,
+            vec_in_memory, newest_vector, num_last_vectors_used, ndof);
 
         // If there is enough vectors in the memory, calculate Anderson coeffs.
         if (anderson_is_on && vec_in_memory >= num_last_vectors_used)
         {
           // Calculate Anderson coefficients.
-          calculate_anderson_coeffs(previous_vectors, anderson_coeffs, num_last_vectors_used, ndof);
+          calculate_anderson_coeffs(residual_products, residual_slots, anderson_coeffs, num_last_vectors_used);
 
           // Calculate new vector and store it in this->sln_vector[].
+          for (int j = 0; j < num_last_vectors_used; j++)
+            anderson_vectors[j] = previous_vectors + ((newest_vector + 1 + j) % num_last_vectors_used) * ndof;
+#pragma omp parallel for schedule(static)
           for (int i = 0; i < ndof; i++)
           {
-            this->sln_vector[i] = 0;
+            Scalar value = 0;
             for (int j = 1; j < num_last_vectors_used; j++)
             {
-              this->sln_vector[i] += anderson_coeffs[j-1] * previous_vectors[j][i] - (1.0 - anderson_beta) * anderson_coeffs[j-1] * (previous_vectors[j][i] - previous_vectors[j-1][i]);
+              value += anderson_coeffs[j-1] * anderson_vectors[j][i] - (1.0 - anderson_beta) * anderson_coeffs[j-1] * (anderson_vectors[j][i] - anderson_vectors[j-1][i]);
             }
+            this->sln_vector[i] = value;
           }
         }
 
@@ -400,13 +463,15 @@ namespace Hermes
         // FIXME: this is wrong in the complex case (complex conjugation must be used).
         // FIXME: This will crash if norm of last_iter_vector[] is zero.
         double last_iter_vec_norm = 0;
+        double abs_error = 0;
+#pragma omp parallel for schedule(static) reduction(+:last_iter_vec_norm, abs_error)
         for (int i = 0; i < ndof; i++)
+        {
           last_iter_vec_norm += std::abs(last_iter_vector[i] * last_iter_vector[i]);
+          abs_error += std::abs((this->sln_vector[i] - last_iter_vector[i]) * (this->sln_vector[i] - last_iter_vector[i]));
+        }
 
         last_iter_vec_norm = sqrt(last_iter_vec_norm);
-
-        double abs_error = 0;
-        for (int i = 0; i < ndof; i++) abs_error += std::abs((this->sln_vector[i] - last_iter_vector[i]) * (this->sln_vector[i] - last_iter_vector[i]));
         abs_error = sqrt(abs_error);
 
         double rel_error = abs_error / last_iter_vec_norm;
@@ -424,9 +489,12 @@ namespace Hermes
           // If Anderson acceleration was employed, release memory for the Anderson vectors and coeffs.
           if (anderson_is_on)
           {
-            for (int i = 0; i < num_last_vectors_used; i++) delete [] previous_vectors[i];
             delete [] previous_vectors;
+            delete [] previous_residuals;
+            delete [] residual_products;
+            delete [] residual_slots;
             delete [] anderson_coeffs;
+            delete [] anderson_vectors;
           }
           
           static_cast<DiscreteProblem<Scalar>*>(this->dp)->have_matrix = false;
@@ -444,9 +512,12 @@ namespace Hermes
           // If Anderson acceleration was employed, release memory for the Anderson vectors and coeffs.
           if (anderson_is_on)
           {
-            for (int i = 0; i < num_last_vectors_used; i++) delete [] previous_vectors[i];
             delete [] previous_vectors;
+            delete [] previous_residuals;
+            delete [] residual_products;
+            delete [] residual_slots;
             delete [] anderson_coeffs;
+            delete [] anderson_vectors;
           }
           static_cast<DiscreteProblem<Scalar>*>(this->dp)->have_matrix = false;
 
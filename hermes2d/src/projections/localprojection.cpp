@@ -16,6 +16,11 @@
 #include "projections/localprojection.h"
 #include "space.h"
 #include "discrete_problem.h"
+#include "limit_order.h"
+#include "quad_all.h"
+#include "traverse.h"
+#include "refmap.h"
+#include "api2d.h"
 
 namespace Hermes
 {
@@ -46,6 +51,13 @@ namespace Hermes
         }
       }
 
+      // The mass matrix is block diagonal.
+      if(space->get_type() == HERMES_L2_SPACE && proj_norm == HERMES_L2_NORM)
+      {
+        project_local_l2(space, meshfn, target_vec);
+        return;
+      }
+
       // Get dimension of the space.
       int ndof = space->get_num_dofs();
 
@@ -57,6 +69,9 @@ namespace Hermes
       // Start with active vertex dofs.
       Mesh* mesh = space->get_mesh();
       Element* e;
+      // A vertex is shared by several elements, its DOF is evaluated just once.
+      bool* dof_done = new bool[ndof];
+      memset(dof_done, 0, ndof * sizeof(bool));
       // Go through all active elements in mesh to collect active vertex DOF.
       for_all_active_elements(e, mesh)
       {
@@ -65,22 +80,25 @@ namespace Hermes
         {
           for (unsigned int j = 0; j < e->get_nvert(); j++)
           {
-            // FIXME - the same vertex is visited several times since it
-            // belongs to multiple elements!
             Node* vn = e->vn[j];
             double x = e->vn[j]->x;
             double y = e->vn[j]->y;
             //this->info("Probing vertex %g %g\n", x, y);
             typename Space<Scalar>::NodeData* nd = space->ndata + vn->id;
-            if(!vn->is_constrained_vertex() && nd->dof >= 0)
+            if(!vn->is_constrained_vertex() && nd->dof >= 0 && !dof_done[nd->dof])
             {
               int dof_num = nd->dof;
+              dof_done[dof_num] = true;
               // FIXME: If this is a Solution, the it would be MUCH faster to just
               // retrieve the value from the coefficient vector stored in the Solution.
 
-              // FIXME: Retrieving the value through get_pt_value() is slow and this
-              // should be only done if we are dealing with MeshFunction (not a Solution).
-              Scalar val = meshfn->get_pt_value(x, y)->val[0];
+              // The element is found through the point location index of the mesh of meshfn.
+              Func<Scalar>* pt_value = meshfn->get_pt_value(x, y);
+              if(pt_value == NULL)
+                continue;
+              Scalar val = pt_value->val[0];
+              pt_value->free_fn();
+              delete pt_value;
               //printf("Found active vertex %g %g, val = %g, dof_num = %d\n", x, y, std::abs(val), dof_num);
               target_vec[dof_num] = val;
             }
@@ -91,6 +109,8 @@ namespace Hermes
 
         // TODO: Calculate coefficients of bubble functions and copy into target_vec_space[i] as well.
       }
+
+      delete [] dof_done;
     }
 
     template<typename Scalar>
@@ -170,6 +190,605 @@ namespace Hermes
       }
     }
 
+    template<typename Scalar>
+    bool LocalProjection<Scalar>::compare_states_by_first_element(Traverse::State* a, Traverse::State* b)
+    {
+      return a->e[0]->id < b->e[0]->id;
+    }
+
+    template<typename Scalar>
+    void LocalProjection<Scalar>::invert_element_matrix(double* a, double* inv, int n)
+    {
+      for (int i = 0; i < n; i++)
+        for (int j = 0; j < n; j++)
+          inv[i * n + j] = (i == j) ? 1.0 : 0.0;
+      for (int col = 0; col < n; col++)
+      {
+        int pivot = col;
+        for (int i = col + 1; i < n; i++)
+          if(std::abs(a[i * n + col]) > std::abs(a[pivot * n + col]))
+            pivot = i;
+        if(std::abs(a[pivot * n + col]) < 1e-300)
+          throw Exceptions::Exception("LocalProjection: singular element mass matrix.");
+        if(pivot != col)
+          for (int j = 0; j < n; j++)
+          {
+            std::swap(a[col * n + j], a[pivot * n + j]);
+            std::swap(inv[col * n + j], inv[pivot * n + j]);
+          }
+        double pivot_inverse = 1.0 / a[col * n + col];
+        for (int j = 0; j < n; j++)
+        {
+          a[col * n + j] *= pivot_inverse;
+          inv[col * n + j] *= pivot_inverse;
+        }
+        for (int i = 0; i < n; i++)
+        {
+          if(i == col)
+            continue;
+          double factor = a[i * n + col];
+          if(factor == 0.0)
+            continue;
+          for (int j = 0; j < n; j++)
+          {
+            a[i * n + j] -= factor * a[col * n + j];
+            inv[i * n + j] -= factor * inv[col * n + j];
+          }
+        }
+      }
+    }
+
+#define CHUNKSIZE 1
+    template<typename Scalar>
+    void LocalProjection<Scalar>::project_local_l2(const Space<Scalar>* space, MeshFunction<Scalar>* meshfn, Scalar* target_vec)
+    {
+      if(space->get_type() != HERMES_L2_SPACE)
+        throw Hermes::Exceptions::Exception("LocalProjection::project_local_l2() works with L2 spaces only.");
+      if(target_vec == NULL)
+        throw Exceptions::NullException(3);
+
+      int ndof = space->get_num_dofs();
+      memset(target_vec, 0, ndof * sizeof(Scalar));
+
+      // The states of the union of the mesh of the space and the one of meshfn, grouped by the elements of the space
+      // (if the mesh of meshfn is finer, an element consists of several states).
+      const Mesh* meshes[2] = { space->get_mesh(), meshfn->get_mesh() };
+      TraverseStateList traverse_states;
+      traverse_states.update(meshes, 2);
+      int num_states = traverse_states.get_num_states();
+      Traverse::State** states = traverse_states.get_states();
+      std::sort(states, states + num_states, compare_states_by_first_element);
+
+      Hermes::vector<int> element_starts;
+      for (int state_i = 0; state_i < num_states; state_i++)
+        if(state_i == 0 || states[state_i]->e[0]->id != states[state_i - 1]->e[0]->id)
+          element_starts.push_back(state_i);
+      element_starts.push_back(num_states);
+      int num_elements = element_starts.size() - 1;
+
+      // Per-thread copies of meshfn, the first thread uses the original one.
+      int num_threads_used = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
+      MeshFunction<Scalar>** fns = new MeshFunction<Scalar>*[num_threads_used];
+      fns[0] = meshfn;
+      fns[0]->set_quad_2d(&g_quad_2d_std);
+      int num_threads_cloned = 1;
+      try
+      {
+        for(; num_threads_cloned < num_threads_used; num_threads_cloned++)
+        {
+          fns[num_threads_cloned] = meshfn->clone();
+          fns[num_threads_cloned]->set_quad_2d(&g_quad_2d_std);
+        }
+      }
+      catch(Hermes::Exceptions::Exception&)
+      {
+        // E.g. exact solutions not overriding clone(), project on a single thread.
+        for(int thread_i = 1; thread_i < num_threads_cloned; thread_i++)
+          delete fns[thread_i];
+        num_threads_cloned = 1;
+      }
+      num_threads_used = num_threads_cloned;
+
+      PrecalcShapeset** pss = new PrecalcShapeset*[num_threads_used];
+      RefMap** refmaps = new RefMap*[num_threads_used];
+      for(int thread_i = 0; thread_i < num_threads_used; thread_i++)
+      {
+        pss[thread_i] = new PrecalcShapeset(space->get_shapeset());
+        refmaps[thread_i] = new RefMap();
+        refmaps[thread_i]->set_quad_2d(&g_quad_2d_std);
+      }
+
+      // Inverses of the mass matrices on the reference elements, per mode and order ( = the jacobian of the element times
+      // the mass matrix of an affine element).
+      std::map<int, double*> reference_inverses;
+
+      Hermes::Exceptions::Exception* caughtException = NULL;
+
+      int element_i;
+#pragma omp parallel shared(states, element_starts, fns, pss, refmaps, reference_inverses) private(element_i) num_threads(num_threads_used)
+      {
+#pragma omp for schedule(dynamic, CHUNKSIZE)
+        for(element_i = 0; element_i < num_elements; element_i++)
+        {
+          if(caughtException != NULL)
+            continue;
+          try
+          {
+            MeshFunction<Scalar>* fn = fns[omp_get_thread_num()];
+            PrecalcShapeset* current_pss = pss[omp_get_thread_num()];
+            RefMap* current_refmap = refmaps[omp_get_thread_num()];
+
+            Element* e = states[element_starts[element_i]]->e[0];
+            ElementMode2D mode = e->get_mode();
+            int element_order = space->get_element_order(e->id);
+            int p = (mode == HERMES_MODE_TRIANGLE) ? element_order : std::max(H2D_GET_H_ORDER(element_order), H2D_GET_V_ORDER(element_order));
+
+            AsmList<Scalar> al;
+            space->get_element_assembly_list(e, &al);
+            int n = al.get_cnt();
+            if(n == 0)
+              continue;
+
+            // Right-hand side b_k = \int_e f v_k, summed over the states of the element.
+            Scalar* rhs = new Scalar[n];
+            memset(rhs, 0, n * sizeof(Scalar));
+            for(int state_i = element_starts[element_i]; state_i < element_starts[element_i + 1]; state_i++)
+            {
+              Traverse::State* state = states[state_i];
+              if(state->e[1] == NULL)
+                continue;
+              Transformable* trfs[2] = { current_pss, fn };
+              TraverseStateList::set_active_state(state, trfs);
+
+              RefMap* fn_refmap = fn->get_refmap();
+              int order = p + fn->get_fn_order() + fn_refmap->get_inv_ref_order();
+              limit_order_nowarn(order, mode);
+
+              double3* pt = g_quad_2d_std.get_points(order, mode);
+              int np = g_quad_2d_std.get_num_points(order, mode);
+              double* jwt = new double[np];
+              if(fn_refmap->is_jacobian_const())
+                for(int i = 0; i < np; i++)
+                  jwt[i] = pt[i][2] * fn_refmap->get_const_jacobian();
+              else
+              {
+                double* jac = fn_refmap->get_jacobian(order);
+                for(int i = 0; i < np; i++)
+                  jwt[i] = pt[i][2] * jac[i];
+              }
+
+              fn->set_quad_order(order, H2D_FN_VAL);
+              Scalar* fn_values = fn->get_fn_values();
+              for(int k = 0; k < n; k++)
+              {
+                current_pss->set_active_shape(al.get_idx()[k]);
+                current_pss->set_quad_order(order, H2D_FN_VAL);
+                double* shape_values = current_pss->get_fn_values();
+                Scalar value = Scalar(0);
+                for(int i = 0; i < np; i++)
+                  value += jwt[i] * fn_values[i] * shape_values[i];
+                rhs[k] += al.get_coef()[k] * value;
+              }
+              delete [] jwt;
+            }
+
+            // The mass matrix of the whole element.
+            current_pss->set_active_element(e);
+            current_pss->set_master_transform();
+            current_refmap->set_active_element(e);
+            bool affine = current_refmap->is_jacobian_const();
+
+            int order = 2 * p + (affine ? 0 : current_refmap->get_inv_ref_order());
+            limit_order_nowarn(order, mode);
+            double3* pt = g_quad_2d_std.get_points(order, mode);
+            int np = g_quad_2d_std.get_num_points(order, mode);
+
+            double* inv = NULL;
+            bool own_inv = !affine;
+            if(affine)
+            {
+#pragma omp critical (LocalProjection_reference_inverses)
+              {
+                int key = element_order * 2 + (mode == HERMES_MODE_TRIANGLE ? 0 : 1);
+                std::map<int, double*>::iterator it = reference_inverses.find(key);
+                if(it != reference_inverses.end())
+                  inv = it->second;
+                else
+                {
+                  double* mass = new double[n * n];
+                  double** shape_values = new double*[n];
+                  for(int k = 0; k < n; k++)
+                  {
+                    current_pss->set_active_shape(al.get_idx()[k]);
+                    current_pss->set_quad_order(order, H2D_FN_VAL);
+                    shape_values[k] = new double[np];
+                    memcpy(shape_values[k], current_pss->get_fn_values(), np * sizeof(double));
+                  }
+                  for(int k = 0; k < n; k++)
+                    for(int l = 0; l < n; l++)
+                    {
+                      double value = 0.;
+                      for(int i = 0; i < np; i++)
+                        value += pt[i][2] * shape_values[k][i] * shape_values[l][i];
+                      mass[k * n + l] = value;
+                    }
+                  for(int k = 0; k < n; k++)
+                    delete [] shape_values[k];
+                  delete [] shape_values;
+
+                  inv = new double[n * n];
+                  try
+                  {
+                    invert_element_matrix(mass, inv, n);
+                  }
+                  catch(Hermes::Exceptions::Exception&)
+                  {
+                    delete [] mass;
+                    delete [] inv;
+                    inv = NULL;
+                  }
+                  if(inv != NULL)
+                  {
+                    delete [] mass;
+                    reference_inverses.insert(std::pair<int, double*>(key, inv));
+                  }
+                }
+              }
+              if(inv == NULL)
+                throw Exceptions::Exception("LocalProjection: singular element mass matrix.");
+            }
+            else
+            {
+              double* jac = current_refmap->get_jacobian(order);
+              double* mass = new double[n * n];
+              double** shape_values = new double*[n];
+              for(int k = 0; k < n; k++)
+              {
+                current_pss->set_active_shape(al.get_idx()[k]);
+                current_pss->set_quad_order(order, H2D_FN_VAL);
+                shape_values[k] = new double[np];
+                memcpy(shape_values[k], current_pss->get_fn_values(), np * sizeof(double));
+              }
+              for(int k = 0; k < n; k++)
+                for(int l = 0; l < n; l++)
+                {
+                  double value = 0.;
+                  for(int i = 0; i < np; i++)
+                    value += pt[i][2] * jac[i] * shape_values[k][i] * shape_values[l][i];
+                  mass[k * n + l] = value;
+                }
+              for(int k = 0; k < n; k++)
+                delete [] shape_values[k];
+              delete [] shape_values;
+
+              inv = new double[n * n];
+              try
+              {
+                invert_element_matrix(mass, inv, n);
+              }
+              catch(Hermes::Exceptions::Exception&)
+              {
+                delete [] mass;
+                delete [] inv;
+                throw;
+              }
+              delete [] mass;
+            }
+
+            // M_e = J D M D with D = diag(coef) for the affine elements, M_e = D M D otherwise.
+            double scaling = affine ? 1.0 / current_refmap->get_const_jacobian() : 1.0;
+            for(int k = 0; k < n; k++)
+            {
+              if(al.get_dof()[k] < 0)
+                continue;
+              Scalar value = Scalar(0);
+              for(int l = 0; l < n; l++)
+                value += inv[k * n + l] * rhs[l] / al.get_coef()[l];
+              target_vec[al.get_dof()[k]] = scaling * value / al.get_coef()[k];
+            }
+
+            delete [] rhs;
+            if(own_inv)
+              delete [] inv;
+          }
+          catch(Hermes::Exceptions::Exception& e)
+          {
+#pragma omp critical (caughtException)
+            if(caughtException == NULL)
+              caughtException = e.clone();
+          }
+          catch(std::exception& e)
+          {
+#pragma omp critical (caughtException)
+            if(caughtException == NULL)
+              caughtException = new Hermes::Exceptions::Exception(e.what());
+          }
+        }
+      }
+
+      for(std::map<int, double*>::iterator it = reference_inverses.begin(); it != reference_inverses.end(); it++)
+        delete [] it->second;
+      for(int thread_i = 0; thread_i < num_threads_used; thread_i++)
+      {
+        delete pss[thread_i];
+        delete refmaps[thread_i];
+        if(thread_i > 0)
+          delete fns[thread_i];
+      }
+      delete [] pss;
+      delete [] refmaps;
+      delete [] fns;
+
+      if(caughtException != NULL)
+      {
+        Hermes::Exceptions::Exception exception(*caughtException);
+        delete caughtException;
+        throw exception;
+      }
+    }
+
+    template<typename Scalar>
+    void LocalProjection<Scalar>::project_local_averaged(const Space<Scalar>* space, MeshFunction<Scalar>* meshfn, Scalar* target_vec)
+    {
+      if(space->get_type() != HERMES_H1_SPACE && space->get_type() != HERMES_L2_SPACE)
+        throw Hermes::Exceptions::Exception("LocalProjection::project_local_averaged() works with H1 and L2 spaces only.");
+      if(target_vec == NULL)
+        throw Exceptions::NullException(3);
+
+      int ndof = space->get_num_dofs();
+      memset(target_vec, 0, ndof * sizeof(Scalar));
+      int* dof_counts = new int[ndof];
+      memset(dof_counts, 0, ndof * sizeof(int));
+
+      // The states of the union of the meshes grouped by the elements of the space, as in project_local_l2().
+      const Mesh* meshes[2] = { space->get_mesh(), meshfn->get_mesh() };
+      TraverseStateList traverse_states;
+      traverse_states.update(meshes, 2);
+      int num_states = traverse_states.get_num_states();
+      Traverse::State** states = traverse_states.get_states();
+      std::sort(states, states + num_states, compare_states_by_first_element);
+
+      Hermes::vector<int> element_starts;
+      for (int state_i = 0; state_i < num_states; state_i++)
+        if(state_i == 0 || states[state_i]->e[0]->id != states[state_i - 1]->e[0]->id)
+          element_starts.push_back(state_i);
+      element_starts.push_back(num_states);
+      int num_elements = element_starts.size() - 1;
+
+      // Per-thread copies of meshfn, the first thread uses the original one.
+      int num_threads_used = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
+      MeshFunction<Scalar>** fns = new MeshFunction<Scalar>*[num_threads_used];
+      fns[0] = meshfn;
+      fns[0]->set_quad_2d(&g_quad_2d_std);
+      int num_threads_cloned = 1;
+      try
+      {
+        for(; num_threads_cloned < num_threads_used; num_threads_cloned++)
+        {
+          fns[num_threads_cloned] = meshfn->clone();
+          fns[num_threads_cloned]->set_quad_2d(&g_quad_2d_std);
+        }
+      }
+      catch(Hermes::Exceptions::Exception&)
+      {
+        for(int thread_i = 1; thread_i < num_threads_cloned; thread_i++)
+          delete fns[thread_i];
+        num_threads_cloned = 1;
+      }
+      num_threads_used = num_threads_cloned;
+
+      PrecalcShapeset** pss = new PrecalcShapeset*[num_threads_used];
+      RefMap** refmaps = new RefMap*[num_threads_used];
+      for(int thread_i = 0; thread_i < num_threads_used; thread_i++)
+      {
+        pss[thread_i] = new PrecalcShapeset(space->get_shapeset());
+        refmaps[thread_i] = new RefMap();
+        refmaps[thread_i]->set_quad_2d(&g_quad_2d_std);
+      }
+
+      Hermes::Exceptions::Exception* caughtException = NULL;
+
+      int element_i;
+#pragma omp parallel shared(states, element_starts, fns, pss, refmaps) private(element_i) num_threads(num_threads_used)
+      {
+#pragma omp for schedule(dynamic, CHUNKSIZE)
+        for(element_i = 0; element_i < num_elements; element_i++)
+        {
+          if(caughtException != NULL)
+            continue;
+          try
+          {
+            MeshFunction<Scalar>* fn = fns[omp_get_thread_num()];
+            PrecalcShapeset* current_pss = pss[omp_get_thread_num()];
+            RefMap* current_refmap = refmaps[omp_get_thread_num()];
+
+            Element* e = states[element_starts[element_i]]->e[0];
+            ElementMode2D mode = e->get_mode();
+            int element_order = space->get_element_order(e->id);
+            int p = (mode == HERMES_MODE_TRIANGLE) ? element_order : std::max(H2D_GET_H_ORDER(element_order), H2D_GET_V_ORDER(element_order));
+
+            // The shape functions of the element, each once (the constraints of hanging nodes repeat them).
+            AsmList<Scalar> al;
+            space->get_element_assembly_list(e, &al);
+            std::vector<int> shapes;
+            for(unsigned int k = 0; k < al.get_cnt(); k++)
+              if(std::find(shapes.begin(), shapes.end(), al.get_idx()[k]) == shapes.end())
+                shapes.push_back(al.get_idx()[k]);
+            int n = (int)shapes.size();
+            if(n == 0)
+              continue;
+
+            // Right-hand side b_k = \int_e f v_k, summed over the states of the element.
+            Scalar* rhs = new Scalar[n];
+            memset(rhs, 0, n * sizeof(Scalar));
+            for(int state_i = element_starts[element_i]; state_i < element_starts[element_i + 1]; state_i++)
+            {
+              Traverse::State* state = states[state_i];
+              if(state->e[1] == NULL)
+                continue;
+              Transformable* trfs[2] = { current_pss, fn };
+              TraverseStateList::set_active_state(state, trfs);
+
+              RefMap* fn_refmap = fn->get_refmap();
+              int order = p + fn->get_fn_order() + fn_refmap->get_inv_ref_order();
+              limit_order_nowarn(order, mode);
+
+              double3* pt = g_quad_2d_std.get_points(order, mode);
+              int np = g_quad_2d_std.get_num_points(order, mode);
+              double* jwt = new double[np];
+              if(fn_refmap->is_jacobian_const())
+                for(int i = 0; i < np; i++)
+                  jwt[i] = pt[i][2] * fn_refmap->get_const_jacobian();
+              else
+              {
+                double* jac = fn_refmap->get_jacobian(order);
+                for(int i = 0; i < np; i++)
+                  jwt[i] = pt[i][2] * jac[i];
+              }
+
+              fn->set_quad_order(order, H2D_FN_VAL);
+              Scalar* fn_values = fn->get_fn_values();
+              for(int k = 0; k < n; k++)
+              {
+                current_pss->set_active_shape(shapes[k]);
+                current_pss->set_quad_order(order, H2D_FN_VAL);
+                double* shape_values = current_pss->get_fn_values();
+                Scalar value = Scalar(0);
+                for(int i = 0; i < np; i++)
+                  value += jwt[i] * fn_values[i] * shape_values[i];
+                rhs[k] += value;
+              }
+              delete [] jwt;
+            }
+
+            // The mass matrix of the shape functions on the element.
+            current_pss->set_active_element(e);
+            current_pss->set_master_transform();
+            current_refmap->set_active_element(e);
+            int order = 2 * p + current_refmap->get_inv_ref_order();
+            limit_order_nowarn(order, mode);
+            double3* pt = g_quad_2d_std.get_points(order, mode);
+            int np = g_quad_2d_std.get_num_points(order, mode);
+            double* jac = current_refmap->get_jacobian(order);
+
+            double* mass = new double[n * n];
+            double** shape_values = new double*[n];
+            for(int k = 0; k < n; k++)
+            {
+              current_pss->set_active_shape(shapes[k]);
+              current_pss->set_quad_order(order, H2D_FN_VAL);
+              shape_values[k] = new double[np];
+              memcpy(shape_values[k], current_pss->get_fn_values(), np * sizeof(double));
+            }
+            for(int k = 0; k < n; k++)
+              for(int l = 0; l < n; l++)
+              {
+                double value = 0.;
+                for(int i = 0; i < np; i++)
+                  value += pt[i][2] * jac[i] * shape_values[k][i] * shape_values[l][i];
+                mass[k * n + l] = value;
+              }
+            for(int k = 0; k < n; k++)
+              delete [] shape_values[k];
+            delete [] shape_values;
+
+            double* inv = new double[n * n];
+            try
+            {
+              invert_element_matrix(mass, inv, n);
+            }
+            catch(Hermes::Exceptions::Exception&)
+            {
+              delete [] mass;
+              delete [] inv;
+              delete [] rhs;
+              throw;
+            }
+            delete [] mass;
+
+            // The coefficients of the shape functions, a DOF takes them from the elements where it is not constrained.
+            Scalar* local_coeffs = new Scalar[n];
+            for(int k = 0; k < n; k++)
+            {
+              local_coeffs[k] = Scalar(0);
+              for(int l = 0; l < n; l++)
+                local_coeffs[k] += inv[k * n + l] * rhs[l];
+            }
+#pragma omp critical (LocalProjection_averaged)
+            for(unsigned int k = 0; k < al.get_cnt(); k++)
+            {
+              int dof = al.get_dof()[k];
+              if(dof < 0)
+                continue;
+              int count = 0;
+              for(unsigned int l = 0; l < al.get_cnt(); l++)
+                if(al.get_idx()[l] == al.get_idx()[k])
+                  count++;
+              if(count != 1)
+                continue;
+              int shape_k = std::find(shapes.begin(), shapes.end(), al.get_idx()[k]) - shapes.begin();
+              target_vec[dof] += local_coeffs[shape_k] / al.get_coef()[k];
+              dof_counts[dof]++;
+            }
+
+            delete [] local_coeffs;
+            delete [] inv;
+            delete [] rhs;
+          }
+          catch(Hermes::Exceptions::Exception& e)
+          {
+#pragma omp critical (caughtException)
+            if(caughtException == NULL)
+              caughtException = e.clone();
+          }
+          catch(std::exception& e)
+          {
+#pragma omp critical (caughtException)
+            if(caughtException == NULL)
+              caughtException = new Hermes::Exceptions::Exception(e.what());
+          }
+        }
+      }
+
+      for(int thread_i = 0; thread_i < num_threads_used; thread_i++)
+      {
+        delete pss[thread_i];
+        delete refmaps[thread_i];
+        if(thread_i > 0)
+          delete fns[thread_i];
+      }
+      delete [] pss;
+      delete [] refmaps;
+      delete [] fns;
+
+      for(int dof = 0; dof < ndof; dof++)
+        if(dof_counts[dof] > 1)
+          target_vec[dof] /= (double)dof_counts[dof];
+      delete [] dof_counts;
+
+      if(caughtException != NULL)
+      {
+        Hermes::Exceptions::Exception exception(*caughtException);
+        delete caughtException;
+        throw exception;
+      }
+    }
+
+    template<typename Scalar>
+    void LocalProjection<Scalar>::project_local_averaged(Hermes::vector<const Space<Scalar>*> spaces, Hermes::vector<Solution<Scalar>*> slns, Scalar* target_vec)
+    {
+      int n = spaces.size();
+      if(n != slns.size()) throw Exceptions::LengthException(1, 2, n, slns.size());
+      if(target_vec == NULL) throw Exceptions::NullException(3);
+
+      int start_index = 0;
+      for (int i = 0; i < n; i++)
+      {
+        project_local_averaged(spaces[i], slns[i], target_vec + start_index);
+        start_index += spaces[i]->get_num_dofs();
+      }
+    }
+
     template class HERMES_API LocalProjection<double>;
     template class HERMES_API LocalProjection<std::complex<double> >;
   }
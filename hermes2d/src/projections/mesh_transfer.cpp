@@ -0,0 +1,266 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "projections/mesh_transfer.h"
+#include "element_locator.h"
+#include "refmap.h"
+#include "space.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    template<typename Scalar>
+    TransferredFunction<Scalar>::TransferredFunction(const Mesh* mesh, Solution<Scalar>* source) : MeshFunction<Scalar>(mesh), source(source), own_source(false)
+    {
+      if(source == NULL)
+        throw Exceptions::NullException(2);
+      this->num_components = source->get_num_components();
+      this->order = 0;
+      this->set_quad_2d(&g_quad_2d_std);
+    }
+
+    template<typename Scalar>
+    TransferredFunction<Scalar>::~TransferredFunction()
+    {
+      free();
+      if(own_source)
+        delete source;
+    }
+
+    template<typename Scalar>
+    MeshFunction<Scalar>* TransferredFunction<Scalar>::clone() const
+    {
+      TransferredFunction<Scalar>* transferred = new TransferredFunction<Scalar>(this->mesh, static_cast<Solution<Scalar>*>(source->clone()));
+      transferred->own_source = true;
+      return transferred;
+    }
+
+    template<typename Scalar>
+    Func<Scalar>* TransferredFunction<Scalar>::get_pt_value(double x, double y, Element* e)
+    {
+      // e is an element of the target mesh.
+      return source->get_pt_value(x, y);
+    }
+
+    template<typename Scalar>
+    void TransferredFunction<Scalar>::set_active_element(Element* e)
+    {
+      MeshFunction<Scalar>::set_active_element(e);
+
+      for(typename std::map<uint64_t, NodeTable<struct Function<Scalar>::Node*>*>::iterator it = tables[this->cur_quad].begin(); it != tables[this->cur_quad].end(); it++)
+      {
+        for(unsigned int l = 0; l < it->second->get_size(); l++)
+          if(it->second->present(l))
+            this->delete_node(it->second->get(l));
+        delete it->second;
+      }
+      tables[this->cur_quad].clear();
+
+      this->sub_tables = &tables[this->cur_quad];
+      this->update_nodes_ptr();
+
+      // The highest order of the source elements found at the center of e and near its vertices.
+      if(source->get_type() == HERMES_SLN)
+      {
+        ElementLocator* locator = source->get_mesh()->get_element_locator();
+        double x_center = 0., y_center = 0.;
+        for(unsigned int i = 0; i < e->get_nvert(); i++)
+        {
+          x_center += e->vn[i]->x / e->get_nvert();
+          y_center += e->vn[i]->y / e->get_nvert();
+        }
+
+        this->order = 0;
+        for(unsigned int i = 0; i <= e->get_nvert(); i++)
+        {
+          double x = x_center, y = y_center;
+          if(i < e->get_nvert())
+          {
+            x += 0.9 * (e->vn[i]->x - x_center);
+            y += 0.9 * (e->vn[i]->y - y_center);
+          }
+          double x_reference, y_reference;
+          Element* source_element = locator->find(x, y, x_reference, y_reference);
+          if(source_element != NULL && source->elem_orders[source_element->id] > this->order)
+            this->order = source->elem_orders[source_element->id];
+        }
+      }
+      else
+        this->order = Hermes::Hermes2D::g_max_quad;
+    }
+
+    template<typename Scalar>
+    void TransferredFunction<Scalar>::free()
+    {
+      for (int i = 0; i < H2D_MAX_QUADRATURES; i++)
+      {
+        for(typename std::map<uint64_t, NodeTable<struct Function<Scalar>::Node*>*>::iterator it = tables[i].begin(); it != tables[i].end(); it++)
+        {
+          for(unsigned int l = 0; l < it->second->get_size(); l++)
+            if(it->second->present(l))
+              this->delete_node(it->second->get(l));
+          delete it->second;
+        }
+        tables[i].clear();
+      }
+      this->free_node_pool();
+    }
+
+    template<typename Scalar>
+    void TransferredFunction<Scalar>::precalculate(int order, int mask)
+    {
+      if(mask & ~H2D_FN_DEFAULT)
+        throw Hermes::Exceptions::Exception("Cannot obtain second derivatives of a transferred solution.");
+
+      Quad2D* quad = this->quads[this->cur_quad];
+      int np = quad->get_num_points(order, this->element->get_mode());
+      struct Function<Scalar>::Node* node = this->new_node(H2D_FN_DEFAULT, np);
+
+      this->update_refmap();
+      double* x = this->refmap->get_phys_x(order);
+      double* y = this->refmap->get_phys_y(order);
+
+      // All the points at once.
+      Func<Scalar>* values = source->get_pt_values(x, y, np);
+      if(this->num_components == 1)
+      {
+        memcpy(node->values[0][0], values->val, np * sizeof(Scalar));
+        memcpy(node->values[0][1], values->dx, np * sizeof(Scalar));
+        memcpy(node->values[0][2], values->dy, np * sizeof(Scalar));
+      }
+      else
+      {
+        memcpy(node->values[0][0], values->val0, np * sizeof(Scalar));
+        memcpy(node->values[1][0], values->val1, np * sizeof(Scalar));
+        memcpy(node->values[0][1], values->dx0, np * sizeof(Scalar));
+        memcpy(node->values[1][1], values->dx1, np * sizeof(Scalar));
+        memcpy(node->values[0][2], values->dy0, np * sizeof(Scalar));
+        memcpy(node->values[1][2], values->dy1, np * sizeof(Scalar));
+      }
+      values->free_fn();
+      delete values;
+
+      if(this->nodes->present(order))
+      {
+        assert(this->nodes->get(order) == this->cur_node);
+        this->delete_node(this->nodes->get(order));
+      }
+      this->nodes->add(node, order);
+      this->cur_node = node;
+    }
+
+    template<typename Scalar>
+    MeshTransfer<Scalar>::MeshTransfer()
+    {
+    }
+
+    template<typename Scalar>
+    MeshTransfer<Scalar>::~MeshTransfer()
+    {
+    }
+
+    template<typename Scalar>
+    bool MeshTransfer<Scalar>::share_base_mesh(const Mesh* mesh_a, const Mesh* mesh_b)
+    {
+      if(mesh_a == mesh_b)
+        return true;
+      if(mesh_a->get_num_base_elements() != mesh_b->get_num_base_elements())
+        return false;
+
+      for (int id = 0; id < mesh_a->get_num_base_elements(); id++)
+      {
+        Element* e_a = mesh_a->get_element_fast(id);
+        Element* e_b = mesh_b->get_element_fast(id);
+        if(e_a->used != e_b->used)
+          return false;
+        if(!e_a->used)
+          continue;
+        if(e_a->get_nvert() != e_b->get_nvert())
+          return false;
+
+        // The vertices have to coincide up to a fraction of the element size.
+        double tolerance = 1e-6 * std::sqrt(e_a->get_area());
+        for(unsigned int i = 0; i < e_a->get_nvert(); i++)
+          if(std::abs(e_a->vn[i]->x - e_b->vn[i]->x) > tolerance || std::abs(e_a->vn[i]->y - e_b->vn[i]->y) > tolerance)
+            return false;
+      }
+      return true;
+    }
+
+    template<typename Scalar>
+    void MeshTransfer<Scalar>::transfer(const Space<Scalar>* space, Solution<Scalar>* source, Scalar* target_vec, ProjNormType proj_norm)
+    {
+      if(space == NULL)
+        throw Exceptions::NullException(1);
+      if(source == NULL)
+        throw Exceptions::NullException(2);
+      if(target_vec == NULL)
+        throw Exceptions::NullException(3);
+
+      if(source->get_type() == HERMES_SLN && share_base_mesh(space->get_mesh(), source->get_mesh()))
+        ogProjection.project_global(space, source, target_vec, proj_norm);
+      else
+      {
+        TransferredFunction<Scalar> transferred(space->get_mesh(), source);
+        ogProjection.project_global(space, &transferred, target_vec, proj_norm);
+      }
+    }
+
+    template<typename Scalar>
+    void MeshTransfer<Scalar>::transfer(const Space<Scalar>* space, Solution<Scalar>* source, Solution<Scalar>* target_sln, ProjNormType proj_norm)
+    {
+      int ndof = space->get_num_dofs();
+      Scalar* target_vec = new Scalar[ndof];
+      try
+      {
+        transfer(space, source, target_vec, proj_norm);
+        Solution<Scalar>::vector_to_solution(target_vec, space, target_sln);
+      }
+      catch(Hermes::Exceptions::Exception&)
+      {
+        delete [] target_vec;
+        throw;
+      }
+      delete [] target_vec;
+    }
+
+    template<typename Scalar>
+    void MeshTransfer<Scalar>::transfer(Hermes::vector<const Space<Scalar>*> spaces, Hermes::vector<Solution<Scalar>*> sources,
+      Scalar* target_vec, Hermes::vector<ProjNormType> proj_norms)
+    {
+      int n = spaces.size();
+
+      if(n != sources.size()) throw Exceptions::LengthException(1, 2, n, sources.size());
+      if(target_vec == NULL) throw Exceptions::NullException(3);
+      if(!proj_norms.empty() && n != proj_norms.size()) throw Exceptions::LengthException(1, 4, n, proj_norms.size());
+
+      int start_index = 0;
+      for (int i = 0; i < n; i++)
+      {
+        if(proj_norms.empty())
+          transfer(spaces[i], sources[i], target_vec + start_index);
+        else
+          transfer(spaces[i], sources[i], target_vec + start_index, proj_norms[i]);
+        start_index += spaces[i]->get_num_dofs();
+      }
+    }
+
+    template class HERMES_API TransferredFunction<double>;
+    template class HERMES_API TransferredFunction<std::complex<double> >;
+    template class HERMES_API MeshTransfer<double>;
+    template class HERMES_API MeshTransfer<std::complex<double> >;
+  }
+}
@@ -14,6 +14,7 @@
 // along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "projections/ogprojection.h"
+#include "projections/localprojection.h"
 #include "space.h"
 #include "linear_solver.h"
 
@@ -26,6 +27,47 @@ namespace Hermes
     {
     }
 
+    template<typename Scalar>
+    OGProjection<Scalar>::~OGProjection()
+    {
+      free_gram_matrices();
+    }
+
+    template<typename Scalar>
+    void OGProjection<Scalar>::free_gram_matrices()
+    {
+      for(unsigned int i = 0; i < gram_matrices.size(); i++)
+        delete gram_matrices[i];
+      gram_matrices.clear();
+    }
+
+    template<typename Scalar>
+    OGProjection<Scalar>::GramMatrix::GramMatrix(const Space<Scalar>* space, ProjNormType norm) : space(space), space_seq(space->get_seq()),
+      ndof(space->get_num_dofs()), norm(norm), factorized(false)
+    {
+      wf = new WeakForm<Scalar>(1);
+      wf->warned_nonOverride = true;
+      wf->add_matrix_form(new ProjectionMatrixFormVol(0, 0, norm));
+      wf->add_vector_form(new ProjectionVectorFormVol(0, norm));
+
+      dp = new DiscreteProblemLinear<Scalar>(wf, space);
+      dp->set_do_not_use_cache();
+
+      matrix = create_matrix<Scalar>();
+      rhs = create_vector<Scalar>();
+      solver = create_linear_solver<Scalar>(matrix, rhs);
+    }
+
+    template<typename Scalar>
+    OGProjection<Scalar>::GramMatrix::~GramMatrix()
+    {
+      delete solver;
+      delete matrix;
+      delete rhs;
+      delete dp;
+      delete wf;
+    }
+
     template<typename Scalar>
     void OGProjection<Scalar>::project_internal(const Space<Scalar>* space, WeakForm<Scalar>* wf,
   Scalar* target_vec)
@@ -50,6 +92,65 @@ namespace Hermes
           target_vec[i] = linear_solver.get_sln_vector()[i];
     }
 
+    template<typename Scalar>
+    void OGProjection<Scalar>::project_internal(const Space<Scalar>* space, MeshFunction<Scalar>* source_meshfn, ProjNormType norm,
+      Scalar* target_vec)
+    {
+      // Sanity check.
+      if(space == NULL)
+        throw Hermes::Exceptions::Exception("this->space == NULL in project_internal().");
+
+      // The Gram matrix is block diagonal, the element blocks are solved locally.
+      if(space->get_type() == HERMES_L2_SPACE && norm == HERMES_L2_NORM)
+      {
+        LocalProjection<Scalar>::project_local_l2(space, source_meshfn, target_vec);
+        return;
+      }
+
+      // The Gram matrix of the space, a new one if the space changed.
+      GramMatrix* gram_matrix = NULL;
+      for(unsigned int i = 0; i < gram_matrices.size(); i++)
+      {
+        if(gram_matrices[i]->space != space || gram_matrices[i]->norm != norm)
+          continue;
+        if(gram_matrices[i]->space_seq == space->get_seq() && gram_matrices[i]->ndof == space->get_num_dofs())
+          gram_matrix = gram_matrices[i];
+        else
+        {
+          delete gram_matrices[i];
+          gram_matrices.erase(gram_matrices.begin() + i);
+        }
+        break;
+      }
+      if(gram_matrix == NULL)
+      {
+        gram_matrix = new GramMatrix(space, norm);
+        gram_matrices.push_back(gram_matrix);
+      }
+
+      gram_matrix->wf->set_ext(source_meshfn);
+
+      if(gram_matrix->factorized)
+      {
+        // Only the right-hand side.
+        gram_matrix->dp->assemble(NULL, gram_matrix->rhs);
+        gram_matrix->solver->set_factorization_scheme(HERMES_REUSE_FACTORIZATION_COMPLETELY);
+      }
+      else
+      {
+        gram_matrix->dp->assemble(gram_matrix->matrix, gram_matrix->rhs);
+        gram_matrix->solver->set_factorization_scheme(HERMES_FACTORIZE_FROM_SCRATCH);
+      }
+
+      if(!gram_matrix->solver->solve())
+        throw Exceptions::LinearMatrixSolverException();
+      gram_matrix->factorized = true;
+
+      if(target_vec != NULL)
+        for (int i = 0; i < gram_matrix->ndof; i++)
+          target_vec[i] = gram_matrix->solver->get_sln_vector()[i];
+    }
+
     template<typename Scalar>
     void OGProjection<Scalar>::project_global(const Space<Scalar>* space,
         MatrixFormVol<Scalar>* custom_projection_jacobian,
@@ -155,20 +256,8 @@ namespace Hermes
       }
       else norm = proj_norm;
 
-      // Define temporary projection weak form.
-      WeakForm<Scalar>* proj_wf = new WeakForm<Scalar>(1);
-      proj_wf->warned_nonOverride = true;
-      proj_wf->set_ext(source_meshfn);
-      // Add Jacobian.
-      proj_wf->add_matrix_form(new ProjectionMatrixFormVol(0, 0, norm));
-      // Add Residual.
-      proj_wf->add_vector_form(new ProjectionVectorFormVol(0, norm));
-
       // Call main function.
-      project_internal(space, proj_wf, target_vec);
-
-      // Clean up.
-      delete proj_wf;
+      project_internal(space, source_meshfn, norm, target_vec);
     }
 
     template<typename Scalar>
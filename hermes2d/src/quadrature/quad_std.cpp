@@ -2380,7 +2380,7 @@ namespace Hermes
       { -0.978904561411718,  0.859512343113706,  0.007147818771900 }
     };
 
-    static int std_np_2d_tri[g_max_tri + 1 + 3*g_max_tri + 3] =
+    static int std_np_2d_tri[g_max_quad + 1 + 3*g_max_quad + 3] =
     {
       sizeof(std_pts_0_2d_tri) / sizeof(double3),
       sizeof(std_pts_1_2d_tri) / sizeof(double3),
@@ -2405,7 +2405,7 @@ namespace Hermes
       sizeof(std_pts_20_2d_tri) / sizeof(double3)
     };
 
-    static double3* std_tables_2d_tri[g_max_tri + 1 + 3*g_max_tri + 3]=
+    static double3* std_tables_2d_tri[g_max_quad + 1 + 3*g_max_quad + 3]=
     {
       std_pts_0_2d_tri, std_pts_1_2d_tri,
       std_pts_2_2d_tri, std_pts_3_2d_tri,
@@ -2444,7 +2444,7 @@ namespace Hermes
       return result;
     }
 
-    static double3* make_edge_table(double2& v1, double2& v2, int& np, int order)
+    static double3* make_edge_table(const double2& v1, const double2& v2, int& np, int order)
     {
       np = std_np_1d[order];
       double3* result = new double3[np];
@@ -2462,6 +2462,74 @@ namespace Hermes
       return result;
     }
 
+    /// Evaluates the Jacobi polynomial P_n^(1,0) and its derivative at x (|x| < 1).
+    static void jacobi_1_0(int n, double x, double& p, double& dp)
+    {
+      double p_prev = 1.0;
+      p = n ? 0.5 * (3.0 * x + 1.0) : 1.0;
+      for (int k = 2; k <= n; k++)
+      {
+        double p_next = (((2*k + 1) * (2*k - 1) * x + 1.0) * p - (k - 1) * (2*k + 1) * p_prev) / ((k + 1) * (2*k - 1));
+        p_prev = p;
+        p = p_next;
+      }
+      dp = (n * (1.0 - (2*n + 1) * x) * p + 2.0 * n * (n + 1) * p_prev) / ((2*n + 1) * (1.0 - x * x));
+    }
+
+    /// Gauss-Jacobi points and weights for the weight (1 - x) on (-1, 1), n points (exact up to degree 2n - 1).
+    /// The points are the roots of P_n^(1,0), found by Newton's method with deflation by the roots found before.
+    static void make_gauss_jacobi_table(int n, double2* table)
+    {
+      for (int i = 0; i < n; i++)
+      {
+        double x = -cos(M_PI * (i + 0.75) / (n + 0.75));
+        double p, dp;
+        for (int iteration = 0; iteration < 100; iteration++)
+        {
+          jacobi_1_0(n, x, p, dp);
+          double sum = 0.0;
+          for (int j = 0; j < i; j++)
+            sum += 1.0 / (x - table[j][0]);
+          double dx = p / (dp - sum * p);
+          x -= dx;
+          if(fabs(dx) < 1e-15)
+            break;
+        }
+        jacobi_1_0(n, x, p, dp);
+
+        table[i][0] = x;
+        table[i][1] = 4.0 / ((1.0 - x * x) * dp * dp);
+      }
+    }
+
+    static double3* make_collapsed_tri_table(int order, int& np)
+    {
+      // points on a triangle as a product of 1D points on the square (a, b) collapsed
+      // to the reference triangle by x = (1 + a)(1 - b)/2 - 1, y = b; the jacobian (1 - b)/2
+      // is the weight of the Gauss-Jacobi points in b, Gauss points are used in a.
+      // A polynomial of the degree 'order' is of the degree at most 'order' in both a and b.
+      int np_a = std_np_1d[order];
+      int np_b = order / 2 + 1;
+      double2* table_a = std_tables_1d[order];
+      double2* table_b = new double2[np_b];
+      make_gauss_jacobi_table(np_b, table_b);
+
+      np = np_a * np_b;
+      double3* result = new double3[np];
+      for (int i = 0, n = 0; i < np_b; i++)
+      {
+        for (int j = 0; j < np_a; j++, n++)
+        {
+          result[n][0] = 0.5 * (1.0 + table_a[j][0]) * (1.0 - table_b[i][0]) - 1.0;
+          result[n][1] = table_b[i][0];
+          result[n][2] = 0.5 * table_a[j][1] * table_b[i][1];
+        }
+      }
+
+      delete [] table_b;
+      return result;
+    }
+
     static double3* std_tables_2d_quad[g_max_quad + 1 + 4 * g_max_quad + 4];
     static int std_np_2d_quad[g_max_quad + 1 + 4 * g_max_quad + 4];
 
@@ -2497,47 +2565,56 @@ namespace Hermes
       ref_vert[1][3][0] = -1.0;
       ref_vert[1][3][1] =  1.0;
 
-      max_order[0] = g_max_tri;   safe_max_order[0] = g_max_tri - 1; // 20th rule has points outside.
+      // The tabulated triangle rules go up to g_max_tri, the higher orders are collapsed rules.
+      max_order[0] = g_max_quad;  safe_max_order[0] = g_max_quad;
       max_order[1] = g_max_quad;  safe_max_order[1] = g_max_quad;
 
       num_tables[0] = max_order[0] + 1 + 3 * max_order[0] + 3;
       num_tables[1] = max_order[1] + 1 + 4 * max_order[1] + 4;
 
-      // create quad tables and edge tables
-      int i, j, k, l;
+      // The quad tables, the edge tables and the collapsed triangle rules are created by make_table() on the first use.
       if(!quad_pt_ref++)
       {
-        for (i = 0; i <= max_order[0]; i++)
-        {
-          for (j = 0; j < 3; j++)
-          {
-            k = max_order[0] + 1 + 3*i + j;
-            l = j < 2 ? j + 1 : 0;
-            std_tables_2d_tri[k] = make_edge_table(ref_vert[0][j], ref_vert[0][l], std_np_2d_tri[k], i);
-          }
-        }
-
-        for (i = 0; i <= max_order[1]; i++)
-        {
-          std_tables_2d_quad[i] = make_quad_table(i, std_np_2d_quad[i]);
-          for (j = 0; j < 4; j++)
-          {
-            k = max_order[1] + 1 + 4*i + j;
-            l = j < 3 ? j + 1 : 0;
-            std_tables_2d_quad[k] = make_edge_table(ref_vert[1][j], ref_vert[1][l], std_np_2d_quad[k], i);
-          }
-        }
+        // the tabulated 20th rule has points outside, it is replaced too
+        for (int i = g_max_tri; i <= max_order[0]; i++)
+          std_tables_2d_tri[i] = NULL;
       }
 
       tables = std_tables_2d;
       np = std_np_2d;
     }
 
+    void Quad2DStd::make_table(int table, ElementMode2D mode) const
+    {
+#pragma omp critical (quad_2d_std_tables)
+      if(std_tables_2d[mode][table] == NULL)
+      {
+        int num_vertices = (mode == HERMES_MODE_TRIANGLE) ? 3 : 4;
+        int num_points;
+        double3* result;
+        if(table <= max_order[mode])
+          result = (mode == HERMES_MODE_TRIANGLE) ? make_collapsed_tri_table(table, num_points) : make_quad_table(table, num_points);
+        else
+        {
+          int order = (table - max_order[mode] - 1) / num_vertices, edge = (table - max_order[mode] - 1) % num_vertices;
+          result = make_edge_table(ref_vert[mode][edge], ref_vert[mode][(edge + 1) % num_vertices], num_points, order);
+        }
+
+        // The table is read without the lock (see Quad2D::get_points()), the number of points has to be there first.
+        std_np_2d[mode][table] = num_points;
+#pragma omp flush
+        std_tables_2d[mode][table] = result;
+      }
+    }
+
     Quad2DStd::~Quad2DStd()
     {
       int i;
       if(!--quad_pt_ref)
       {
+        for (i = g_max_tri; i <= max_order[0]; i++)
+          delete [] std_tables_2d_tri[i];
+
         for (i = 0; i <= 3 * max_order[0] + 2; i++)
           delete [] std_tables_2d_tri[max_order[0] + 1 + i];
 
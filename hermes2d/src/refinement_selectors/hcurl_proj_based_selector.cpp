@@ -30,6 +30,7 @@ namespace Hermes
       {
         HcurlProjBasedSelector* newSelector = new HcurlProjBasedSelector(this->cand_list, this->conv_exp, this->max_order);
         newSelector->set_error_weights(this->error_weight_h, this->error_weight_p, this->error_weight_aniso);
+        newSelector->set_candidate_pruning(this->candidate_pruning);
         newSelector->isAClone = true;
         return newSelector;
       }
@@ -71,6 +71,7 @@ namespace Hermes
       Selector<Scalar>(max_order),
         opt_symmetric_mesh(true),
         opt_apply_exp_dof(false),
+        candidate_pruning(0.0),
         cand_list(cand_list),
         conv_exp(conv_exp),
         shapeset(shapeset)
@@ -485,6 +486,84 @@ namespace Hermes
         }
       }
 
+      template<typename Scalar>
+      void OptimumSelector<Scalar>::prune_candidates(Element* e, Solution<Scalar>* rsln)
+      {
+        if(e->is_triangle())
+          return;
+
+        int orig_order_h = H2D_GET_H_ORDER(candidates[0].p[0]), orig_order_v = H2D_GET_V_ORDER(candidates[0].p[0]);
+        bool has_aniso = false;
+        for (unsigned i = 1; i < candidates.size() && !has_aniso; i++)
+        {
+          const Cand& c = candidates[i];
+          if(c.split == H2D_REFINEMENT_ANISO_H || c.split == H2D_REFINEMENT_ANISO_V)
+            has_aniso = true;
+          if(c.split == H2D_REFINEMENT_P && H2D_GET_H_ORDER(c.p[0]) - orig_order_h != H2D_GET_V_ORDER(c.p[0]) - orig_order_v)
+            has_aniso = true;
+        }
+        if(!has_aniso)
+          return;
+
+        // Averages of the reference solution over the quarters (the sons: 0 bottom left, 1 bottom right, 2 top right, 3 top left).
+        const int order = 4;
+        Quad2D* quad = &g_quad_2d_std;
+        rsln->set_quad_2d(quad);
+        double3* pt = quad->get_points(order, HERMES_MODE_QUAD);
+        int np = quad->get_num_points(order, HERMES_MODE_QUAD);
+        Element* base_element = rsln->get_mesh()->get_element(e->id);
+        Scalar averages[H2D_MAX_ELEMENT_SONS];
+        for (int son = 0; son < H2D_MAX_ELEMENT_SONS; son++)
+        {
+          if(base_element->active)
+          {
+            rsln->set_active_element(base_element);
+            rsln->push_transform(son);
+          }
+          else
+            rsln->set_active_element(base_element->sons[son]);
+          rsln->set_quad_order(order, H2D_FN_VAL);
+          Scalar* values = rsln->get_fn_values();
+          Scalar sum = 0.0;
+          double sum_weights = 0.0;
+          for (int i = 0; i < np; i++)
+          {
+            sum += pt[i][2] * values[i];
+            sum_weights += pt[i][2];
+          }
+          averages[son] = sum / sum_weights;
+        }
+        double variation_x = Hermes::sqr(std::abs(averages[0] - averages[1])) + Hermes::sqr(std::abs(averages[3] - averages[2]));
+        double variation_y = Hermes::sqr(std::abs(averages[0] - averages[3])) + Hermes::sqr(std::abs(averages[1] - averages[2]));
+        double anisotropy = (variation_x + variation_y > 0.0) ? std::abs(variation_x - variation_y) / (variation_x + variation_y) : 0.0;
+
+        // The candidates refining in the directions to discard.
+        bool keep_x = anisotropy >= candidate_pruning && variation_x > variation_y;
+        bool keep_y = anisotropy >= candidate_pruning && variation_y > variation_x;
+        unsigned int num_kept = 1;
+        for (unsigned i = 1; i < candidates.size(); i++)
+        {
+          const Cand& c = candidates[i];
+          bool keep = true;
+          // ANISO_H splits by a horizontal line, i.e. resolves the vertical variation.
+          if(c.split == H2D_REFINEMENT_ANISO_H)
+            keep = keep_y;
+          else if(c.split == H2D_REFINEMENT_ANISO_V)
+            keep = keep_x;
+          else if(c.split == H2D_REFINEMENT_P)
+          {
+            int increase_h = H2D_GET_H_ORDER(c.p[0]) - orig_order_h, increase_v = H2D_GET_V_ORDER(c.p[0]) - orig_order_v;
+            if(increase_h > increase_v)
+              keep = keep_x;
+            else if(increase_v > increase_h)
+              keep = keep_y;
+          }
+          if(keep)
+            candidates[num_kept++] = c;
+        }
+        candidates.erase(candidates.begin() + num_kept, candidates.end());
+      }
+
       template<typename Scalar>
       void OptimumSelector<Scalar>::update_cands_info(CandsInfo& info_h, CandsInfo& info_p, CandsInfo& info_aniso) const
       {
@@ -700,7 +779,10 @@ namespace Hermes
         create_candidates(element, quad_order
           , H2D_MAKE_QUAD_ORDER(current_max_order, current_max_order)
           , H2D_MAKE_QUAD_ORDER(current_max_order, current_max_order));
-        
+
+        if(candidate_pruning > 0.0 && candidates.size() > 1)
+          prune_candidates(element, rsln);
+
         if(candidates.size() > 1) { //there are candidates to choose from
           // evaluate candidates (sum partial projection errors, calculate dofs)
           double avg_error, dev_error;
@@ -798,6 +880,14 @@ namespace Hermes
         }
       }
 
+      template<typename Scalar>
+      void OptimumSelector<Scalar>::set_candidate_pruning(double level)
+      {
+        if(level < 0.0 || level > 1.0)
+          throw Exceptions::ValueException("level", level, 0.0, 1.0);
+        candidate_pruning = level;
+      }
+
       template<typename Scalar>
       OptimumSelector<Scalar>::Range::Range() : empty_range(true) {}
 
@@ -1,5 +1,8 @@
 #include "proj_based_selector.h"
 #include <algorithm>
+#include <map>
+#include <string>
+#include <typeinfo>
 #include "global.h"
 #include "solution.h"
 #include "discrete_problem.h"
@@ -13,6 +16,46 @@ namespace Hermes
   {
     namespace RefinementSelectors
     {
+      /// Identification of a projection matrix in the global registry.
+      struct ProjMatrixKey
+      {
+        std::string selector_class;
+        int shapeset_id;
+        int mode;
+        int num_gip_points;
+        std::vector<int> shape_inxs;
+
+        bool operator<(const ProjMatrixKey& other) const
+        {
+          if(selector_class != other.selector_class)
+            return selector_class < other.selector_class;
+          if(shapeset_id != other.shapeset_id)
+            return shapeset_id < other.shapeset_id;
+          if(mode != other.mode)
+            return mode < other.mode;
+          if(num_gip_points != other.num_gip_points)
+            return num_gip_points < other.num_gip_points;
+          return shape_inxs < other.shape_inxs;
+        }
+      };
+
+      /// The global registry of factored projection matrices, released at exit.
+      class ProjMatrixRegistry : public std::map<ProjMatrixKey, FactoredProjMatrix*>
+      {
+      public:
+        ~ProjMatrixRegistry()
+        {
+          for(iterator it = begin(); it != end(); it++)
+          {
+            delete [] it->second->lu;
+            delete [] it->second->indx;
+            delete it->second;
+          }
+        }
+      };
+
+      static ProjMatrixRegistry proj_matrix_registry;
+
       template<typename Scalar>
       ProjBasedSelector<Scalar>::ProjBasedSelector(CandList cand_list, double conv_exp, int
         max_order, Shapeset* shapeset, const typename OptimumSelector<Scalar>::Range& vertex_order, const
@@ -31,6 +74,7 @@ namespace Hermes
         std::fill(cached_shape_vals_valid, cached_shape_vals_valid + H2D_NUM_MODES, false);
 
         //clear matrix cache
+        proj_matrix_cache = new ProjMatrixCache[H2D_NUM_MODES];
         for(int m = 0; m < H2D_NUM_MODES; m++)
           for(int i = 0; i < H2DRS_MAX_ORDER + 2; i++)
             for(int k = 0; k < H2DRS_MAX_ORDER + 2; k++)
@@ -47,19 +91,11 @@ namespace Hermes
       template<typename Scalar>
       ProjBasedSelector<Scalar>::~ProjBasedSelector()
       {
-        //delete matrix cache
-        for(int m = 0; m < H2D_NUM_MODES; m++)
-        {
-          for(int i = 0; i < H2DRS_MAX_ORDER + 2; i++)
-            for(int k = 0; k < H2DRS_MAX_ORDER + 2; k++)
-            {
-              if(proj_matrix_cache[m][i][k] != NULL)
-                delete [] proj_matrix_cache[m][i][k];
-            }
-        }
-
         if(!this->isAClone)
         {
+          //delete matrix cache, the matrices belong to the global registry
+          delete [] proj_matrix_cache;
+
           delete [] cached_shape_vals_valid;
           delete [] cached_shape_ortho_vals;
           delete [] cached_shape_vals;
@@ -433,13 +469,15 @@ namespace Hermes
         , CandElemProjError errors_squared
         )
       {
-        //allocate space
+        //allocate space (the buffers are reused by the following elements)
         int max_num_shapes = this->next_order_shape[mode][this->current_max_order];
-        Scalar* right_side = new Scalar[max_num_shapes];
-        int* shape_inxs = new int[max_num_shapes];
-        int* indx = new int[max_num_shapes]; //solver data
-        double* d = new double[max_num_shapes]; //solver data
-        double** proj_matrix = new_matrix<double>(max_num_shapes, max_num_shapes);
+        if((int)right_side_buffer.size() < max_num_shapes)
+        {
+          right_side_buffer.resize(max_num_shapes);
+          shape_inxs_buffer.resize(max_num_shapes);
+        }
+        Scalar* right_side = &right_side_buffer[0];
+        int* shape_inxs = &shape_inxs_buffer[0];
         ProjMatrixCache& proj_matrices = proj_matrix_cache[mode];
         Hermes::vector<typename OptimumSelector<Scalar>::ShapeInx>& full_shape_indices = this->shape_indices[mode];
 
@@ -489,12 +527,17 @@ namespace Hermes
           Hermes::vector< ValueCacheItem<Scalar> >& rhs_cache = use_ortho ? ortho_rhs_cache : nonortho_rhs_cache;
           Hermes::vector<TrfShapeExp>** sub_svals = use_ortho ? sub_ortho_svals : sub_nonortho_svals;
 
-          //calculate projection matrix iff no ortho is used
+          //obtain factored projection matrix iff no ortho is used
+          const FactoredProjMatrix* proj_matrix = NULL;
           if(!use_ortho)
           {
-            if(proj_matrices[order_h][order_v] == NULL)
-              proj_matrices[order_h][order_v] = build_projection_matrix(gip_points, num_gip_points, shape_inxs, num_shapes, mode);
-            copy_matrix(proj_matrix, proj_matrices[order_h][order_v], num_shapes, num_shapes); //copy projection matrix because original matrix will be modified
+            //the cache is shared by the clones of the selector working in other threads, it is read only in the critical section
+#pragma omp critical (proj_matrix_cache)
+            {
+              if(proj_matrices[order_h][order_v] == NULL)
+                proj_matrices[order_h][order_v] = get_factored_projection_matrix(gip_points, num_gip_points, shape_inxs, num_shapes, mode);
+              proj_matrix = proj_matrices[order_h][order_v];
+            }
           }
 
           //build right side (fill cache values that are missing)
@@ -529,8 +572,7 @@ namespace Hermes
           //solve iff no ortho is used
           if(!use_ortho)
           {
-            ludcmp(proj_matrix, num_shapes, indx, d);
-            lubksb<Scalar>(proj_matrix, num_shapes, indx, right_side);
+            lubksb<Scalar>(proj_matrix->lu, num_shapes, proj_matrix->indx, right_side);
           }
 
           //calculate error
@@ -547,12 +589,31 @@ namespace Hermes
           errors_squared[order_h][order_v] = error_squared * sub_area_corr_coef; //apply area correction coefficient
         }
         while (order_perm.next());
+      }
 
-        delete [] proj_matrix;
-        delete [] right_side;
-        delete [] shape_inxs;
-        delete [] indx;
-        delete [] d;
+      template<typename Scalar>
+      const FactoredProjMatrix* ProjBasedSelector<Scalar>::get_factored_projection_matrix(double3* gip_points, int num_gip_points, const int* shape_inx, const int num_shapes, ElementMode2D mode)
+      {
+        ProjMatrixKey key;
+        key.selector_class = typeid(*this).name();
+        key.shapeset_id = this->shapeset->get_id();
+        key.mode = mode;
+        key.num_gip_points = num_gip_points;
+        key.shape_inxs.assign(shape_inx, shape_inx + num_shapes);
+
+        ProjMatrixRegistry::iterator it = proj_matrix_registry.find(key);
+        if(it != proj_matrix_registry.end())
+          return it->second;
+
+        FactoredProjMatrix* factored = new FactoredProjMatrix;
+        factored->size = num_shapes;
+        factored->lu = build_projection_matrix(gip_points, num_gip_points, shape_inx, num_shapes, mode);
+        factored->indx = new int[num_shapes];
+        double d;
+        ludcmp(factored->lu, num_shapes, factored->indx, &d);
+
+        proj_matrix_registry.insert(std::make_pair(key, factored));
+        return factored;
       }
 
       template class HERMES_API ProjBasedSelector<double>;
@@ -25,8 +25,8 @@ namespace Hermes
     template<typename Scalar>
     RungeKutta<Scalar>::RungeKutta(const WeakForm<Scalar>* wf, Hermes::vector<const Space<Scalar> *> spaces, ButcherTable* bt)
       : wf(wf), bt(bt), num_stages(bt->get_size()), stage_wf_right(bt->get_size() * spaces.size()),
-      stage_wf_left(spaces.size()), start_from_zero_K_vector(false), block_diagonal_jacobian(false), residual_as_vector(true), iteration(0),
-      freeze_jacobian(false), newton_tol(1e-6), newton_max_iter(20), newton_damping_coeff(1.0), newton_max_allowed_residual_norm(1e10)
+      stage_wf_left(spaces.size()), stage_wf_single(spaces.size()), stage_wf_explicit(spaces.size()), start_from_zero_K_vector(false), decoupled_stages(false), block_diagonal_jacobian(false), residual_as_vector(true), iteration(0),
+      freeze_jacobian(false), jacobian_with_residual(false), newton_tol(1e-6), newton_max_iter(20), newton_damping_coeff(1.0), newton_max_allowed_residual_norm(1e10)
     {
       for(unsigned int i = 0; i < spaces.size(); i++)
       {
@@ -59,13 +59,25 @@ namespace Hermes
 
       this->stage_dp_left = NULL;
       this->stage_dp_right = NULL;
+      this->stage_dp_single = NULL;
+      this->stage_dp_explicit = NULL;
+      this->K_explicit_vector = NULL;
+      this->stage_matrix = NULL;
+      this->stage_vector = NULL;
+      this->stage_solver = NULL;
+      this->mass_solver = NULL;
+
+      this->lumped_mass = false;
+      this->time_step_control = false;
+      this->last_time_step_error = 0.;
+      this->last_accepted_time_step_error = -1.;
     }
 
     template<typename Scalar>
     RungeKutta<Scalar>::RungeKutta(const WeakForm<Scalar>* wf, const Space<Scalar>* space, ButcherTable* bt)
       : wf(wf), bt(bt), num_stages(bt->get_size()), stage_wf_right(bt->get_size() * 1),
-      stage_wf_left(1), start_from_zero_K_vector(false), block_diagonal_jacobian(false), residual_as_vector(true), iteration(0),
-      freeze_jacobian(false), newton_tol(1e-6), newton_max_iter(20), newton_damping_coeff(1.0), newton_max_allowed_residual_norm(1e10)
+      stage_wf_left(1), stage_wf_single(1), stage_wf_explicit(1), start_from_zero_K_vector(false), decoupled_stages(false), block_diagonal_jacobian(false), residual_as_vector(true), iteration(0),
+      freeze_jacobian(false), jacobian_with_residual(false), newton_tol(1e-6), newton_max_iter(20), newton_damping_coeff(1.0), newton_max_allowed_residual_norm(1e10)
     {
       this->spaces.push_back(space);
       this->spaces_seqs.push_back(space->get_seq());
@@ -93,6 +105,18 @@ namespace Hermes
 
       this->stage_dp_left = NULL;
       this->stage_dp_right = NULL;
+      this->stage_dp_single = NULL;
+      this->stage_dp_explicit = NULL;
+      this->K_explicit_vector = NULL;
+      this->stage_matrix = NULL;
+      this->stage_vector = NULL;
+      this->stage_solver = NULL;
+      this->mass_solver = NULL;
+
+      this->lumped_mass = false;
+      this->time_step_control = false;
+      this->last_time_step_error = 0.;
+      this->last_accepted_time_step_error = -1.;
     }
 
     template<typename Scalar>
@@ -120,6 +144,12 @@ namespace Hermes
         this->info("\tRunge-Kutta: K vectors are being set to zero, as the spaces changed during computation.");
         memset(K_vector, 0, num_stages * Space<Scalar>::get_num_dofs(this->spaces) * sizeof(Scalar));
       }
+      if(K_explicit_vector != NULL)
+      {
+        delete [] K_explicit_vector;
+        K_explicit_vector = new Scalar[num_stages * Space<Scalar>::get_num_dofs(this->spaces)];
+        memset(K_explicit_vector, 0, num_stages * Space<Scalar>::get_num_dofs(this->spaces) * sizeof(Scalar));
+      }
       delete [] u_ext_vec;
       u_ext_vec = new Scalar[num_stages * Space<Scalar>::get_num_dofs(this->spaces)];
       delete [] vector_left;
@@ -127,6 +157,10 @@ namespace Hermes
 
       if(this->stage_dp_left != NULL)
         static_cast<DiscreteProblem<Scalar>*>(this->stage_dp_left)->set_spaces(this->spaces);
+      if(this->stage_dp_single != NULL)
+        this->stage_dp_single->set_spaces(this->spaces);
+      if(this->stage_dp_explicit != NULL)
+        this->stage_dp_explicit->set_spaces(this->spaces);
     }
 
     template<typename Scalar>
@@ -150,6 +184,12 @@ namespace Hermes
         this->info("\tRunge-Kutta: K vector is being set to zero, as the spaces changed during computation.");
         memset(K_vector, 0, num_stages * Space<Scalar>::get_num_dofs(this->spaces) * sizeof(Scalar));
       }
+      if(K_explicit_vector != NULL)
+      {
+        delete [] K_explicit_vector;
+        K_explicit_vector = new Scalar[num_stages * Space<Scalar>::get_num_dofs(this->spaces)];
+        memset(K_explicit_vector, 0, num_stages * Space<Scalar>::get_num_dofs(this->spaces) * sizeof(Scalar));
+      }
       delete [] u_ext_vec;
       u_ext_vec = new Scalar[num_stages * Space<Scalar>::get_num_dofs(this->spaces)];
       delete [] vector_left;
@@ -157,6 +197,10 @@ namespace Hermes
 
       if(this->stage_dp_left != NULL)
         static_cast<DiscreteProblem<Scalar>*>(this->stage_dp_left)->set_space(space);
+      if(this->stage_dp_single != NULL)
+        this->stage_dp_single->set_space(space);
+      if(this->stage_dp_explicit != NULL)
+        this->stage_dp_explicit->set_space(space);
     }
 
     template<typename Scalar>
@@ -168,18 +212,18 @@ namespace Hermes
     template<typename Scalar>
     void RungeKutta<Scalar>::init()
     {
-      this->create_stage_wf(spaces.size(), block_diagonal_jacobian);
-
-      if(this->get_verbose_output())
-      {
-        this->stage_wf_left.set_verbose_output(true);
-        this->stage_wf_right.set_verbose_output(true);
-      }
+      bool decoupled = this->use_decoupled_stages();
+      if(bt->is_imex() && !decoupled)
+        throw Hermes::Exceptions::Exception("RungeKutta: IMEX Butcher's tables require the decoupled stages, see set_decoupled_stages().");
+      if(decoupled)
+        this->create_single_stage_wf();
       else
-      {
-        this->stage_wf_left.set_verbose_output(false);
-        this->stage_wf_right.set_verbose_output(false);
-      }
+        this->create_stage_wf(spaces.size(), block_diagonal_jacobian);
+
+      this->stage_wf_left.set_verbose_output(this->get_verbose_output());
+      this->stage_wf_right.set_verbose_output(this->get_verbose_output());
+      this->stage_wf_single.set_verbose_output(this->get_verbose_output());
+      this->stage_wf_explicit.set_verbose_output(this->get_verbose_output());
 
       // The tensor discrete problem is created in two parts. First, matrix_left is the Jacobian
       // matrix of the term coming from the left-hand side of the RK formula k_i = f(...). This is
@@ -189,7 +233,35 @@ namespace Hermes
       // in a form suitable for the Newton's method: k_i - f(...) = 0. At the end, matrix_left and vector_left
       // are added to matrix_right and vector_right, respectively.
       this->stage_dp_left = new DiscreteProblem<Scalar>(&stage_wf_left, spaces);
-      
+
+      // One stage at a time: the stationary forms only, of size ndof.
+      if(decoupled)
+      {
+        this->stage_dp_single = new DiscreteProblem<Scalar>(&stage_wf_single, spaces);
+        this->stage_dp_single->set_RK(spaces.size());
+
+        // The explicit part of an IMEX table.
+        if(stage_wf_explicit.vfvol.size() + stage_wf_explicit.vfsurf.size() > 0)
+        {
+          this->stage_dp_explicit = new DiscreteProblem<Scalar>(&stage_wf_explicit, spaces);
+          this->stage_dp_explicit->set_RK(spaces.size());
+
+          int ndof = Space<Scalar>::get_num_dofs(spaces);
+          this->K_explicit_vector = new Scalar[num_stages * ndof];
+          memset(K_explicit_vector, 0, num_stages * ndof * sizeof(Scalar));
+        }
+
+        this->stage_matrix = create_matrix<Scalar>();
+        this->stage_vector = create_vector<Scalar>();
+        this->stage_solver = create_linear_solver(stage_matrix, stage_vector);
+        this->mass_solver = create_linear_solver(matrix_left, stage_vector);
+
+        if(!residual_as_vector)
+          for(unsigned int sln_i = 0; sln_i < spaces.size(); sln_i++)
+            residuals_vector.push_back(new Solution<Scalar>(spaces[sln_i]->get_mesh()));
+        return;
+      }
+
       // All Spaces of the problem.
       Hermes::vector<const Space<Scalar>*> stage_spaces_vector;
 
@@ -228,11 +300,39 @@ namespace Hermes
       this->block_diagonal_jacobian = true;
     }
 
+    template<typename Scalar>
+    void RungeKutta<Scalar>::set_decoupled_stages(bool onOff)
+    {
+      if(this->stage_dp_left != NULL)
+        throw Hermes::Exceptions::Exception("RungeKutta::set_decoupled_stages() has to be called before the first time step.");
+      this->decoupled_stages = onOff;
+    }
+
+    template<typename Scalar>
+    void RungeKutta<Scalar>::set_lumped_mass(bool onOff)
+    {
+      this->lumped_mass = onOff;
+      // The mass matrix (and its lumped inverse) is assembled again in the next time step.
+      this->matrix_left_seqs.clear();
+    }
+
+    template<typename Scalar>
+    bool RungeKutta<Scalar>::use_decoupled_stages()
+    {
+      return this->decoupled_stages && !this->block_diagonal_jacobian && bt->is_diagonally_implicit();
+    }
+
     template<typename Scalar>
     void RungeKutta<Scalar>::set_freeze_jacobian()
     {
       this->freeze_jacobian = true;
     }
+    template<typename Scalar>
+    void RungeKutta<Scalar>::set_jacobian_with_residual(bool onOff)
+    {
+      this->jacobian_with_residual = onOff;
+    }
+
     template<typename Scalar>
     void RungeKutta<Scalar>::set_newton_tol(double newton_tol)
     {
@@ -261,11 +361,25 @@ namespace Hermes
         delete stage_dp_left;
       if(stage_dp_right != NULL)
         delete stage_dp_right;
+      if(stage_dp_single != NULL)
+        delete stage_dp_single;
+      if(stage_dp_explicit != NULL)
+        delete stage_dp_explicit;
+      for (unsigned int i = 0; i < residuals_vector.size(); i++)
+        delete residuals_vector[i];
+      for (unsigned int i = 0; i < stage_spaces_vector.size(); i++)
+        delete stage_spaces_vector[i];
+      delete stage_solver;
+      delete mass_solver;
+      delete stage_matrix;
+      delete stage_vector;
       delete solver;
       delete matrix_right;
       delete matrix_left;
       delete vector_right;
       delete [] K_vector;
+      if(K_explicit_vector != NULL)
+        delete [] K_explicit_vector;
       delete [] u_ext_vec;
       delete [] vector_left;
     }
@@ -301,20 +415,39 @@ namespace Hermes
         error_fns);
     }
 
+    template<typename Scalar>
+    bool RungeKutta<Scalar>::solve_linear_system(LinearMatrixSolver<Scalar>* linear_solver)
+    {
+      LinearMatrixSolverStatistics before = linear_solver->get_statistics();
+      bool solved = linear_solver->solve();
+      this->linear_solver_statistics.add(linear_solver->get_statistics().since(before));
+      return solved;
+    }
+
+    template<typename Scalar>
+    const LinearMatrixSolverStatistics& RungeKutta<Scalar>::get_linear_solver_statistics() const
+    {
+      return this->linear_solver_statistics;
+    }
+
     template<typename Scalar>
     void RungeKutta<Scalar>::rk_time_step_newton(Hermes::vector<Solution<Scalar>*> slns_time_prev,
                                           Hermes::vector<Solution<Scalar>*> slns_time_new,
                                           Hermes::vector<Solution<Scalar>*> error_fns)
     {
       this->tick();
+      this->linear_solver_statistics.clear();
 
       int ndof = Space<Scalar>::get_num_dofs(spaces);
 
       if(this->stage_dp_left == NULL)
         this->init();
 
+      bool decoupled = this->use_decoupled_stages();
+
       // Creates the stage weak formulation.
-      update_stage_wf(slns_time_prev);
+      if(!decoupled)
+        update_stage_wf(slns_time_prev);
 
       // Check whether the user provided a nonzero B2-row if he wants temporal error estimation.
       if(error_fns != Hermes::vector<Solution<Scalar>*>() && bt->is_embedded() == false)
@@ -322,23 +455,15 @@ namespace Hermes
 
       info("\tRunge-Kutta: time step, time: %f, time step: %f", this->time, this->time_step);
 
+      this->on_initialization();
+
       // Set the correct time to the essential boundary conditions.
       for (unsigned int stage_i = 0; stage_i < num_stages; stage_i++)
         Space<Scalar>::update_essential_bc_values(spaces_mutable, this->time + bt->get_C(stage_i)*this->time_step);
 
-      // All Spaces of the problem.
-      Hermes::vector<const Space<Scalar>*> stage_spaces_vector;
-
-      // Create spaces for stage solutions K_i. This is necessary
-      // to define a num_stages x num_stages block weak formulation.
-      for (unsigned int i = 0; i < num_stages; i++)
-        for(unsigned int space_i = 0; space_i < spaces.size(); space_i++)
-        {
-          typename Space<Scalar>::ReferenceSpaceCreator ref_space_creator(spaces[space_i], spaces[space_i]->get_mesh(), 0);
-          stage_spaces_vector.push_back(ref_space_creator.create_ref_space());
-        }
-
-      this->stage_dp_right->set_spaces(stage_spaces_vector);
+      // Spaces for stage solutions K_i, kept over the time steps.
+      if(!decoupled)
+        this->update_stage_spaces();
 
       // Zero utility vectors.
       if(start_from_zero_K_vector || !iteration)
@@ -349,8 +474,28 @@ namespace Hermes
       // Assemble the block-diagonal mass matrix M of size ndof times ndof.
       // The corresponding part of the global residual vector is obtained
       // just by multiplication with the stage vector K.
-      // FIXME: This should not be repeated if spaces have not changed.
-      stage_dp_left->assemble(matrix_left, NULL);
+      // This is only repeated if the spaces have changed.
+      bool mass_matrix_current = (matrix_left_seqs.size() == spaces.size());
+      for (unsigned int space_i = 0; space_i < spaces.size() && mass_matrix_current; space_i++)
+        if(matrix_left_seqs[space_i] != spaces[space_i]->get_seq())
+          mass_matrix_current = false;
+      if(!mass_matrix_current)
+      {
+        stage_dp_left->assemble(matrix_left, NULL);
+        matrix_left_seqs.clear();
+        for (unsigned int space_i = 0; space_i < spaces.size(); space_i++)
+          matrix_left_seqs.push_back(spaces[space_i]->get_seq());
+        if(decoupled && lumped_mass)
+          this->create_lumped_mass();
+      }
+
+      // The stages one after another (see set_decoupled_stages()), or the Newton's loop for all of them at once.
+      if(decoupled)
+      {
+        this->solve_decoupled_stages(slns_time_prev, slns_time_new);
+        this->finish_time_step(slns_time_prev, slns_time_new, error_fns);
+        return;
+      }
 
       // The Newton's loop.
       double residual_norm;
@@ -372,10 +517,12 @@ namespace Hermes
         // Residual corresponding to the stage derivatives k_i in the equation k_i - f(...) = 0.
         multiply_as_diagonal_block_matrix(matrix_left, num_stages, K_vector, vector_left);
 
-        // Assemble the block Jacobian matrix of the stationary residual F.
+        // Assemble the residual of the stationary residual F (and its block Jacobian matrix with it, if set).
         // Diagonal blocks are created even if empty, so that matrix_left can be added later.
         bool force_diagonal_blocks = true;
-        stage_dp_right->assemble(u_ext_vec, NULL, vector_right, force_diagonal_blocks);
+        bool rhs_only = (freeze_jacobian && it > 1);
+        bool jacobian_assembled = jacobian_with_residual && !rhs_only;
+        stage_dp_right->assemble(u_ext_vec, jacobian_assembled ? matrix_right : NULL, vector_right, force_diagonal_blocks);
 
         // Finalizing the residual vector.
         vector_right->add_vector(vector_left);
@@ -390,7 +537,7 @@ namespace Hermes
             sprintf(fileName, "%s%i.m", this->RhsFilename.c_str(), it);
           else
             sprintf(fileName, "%s%i", this->RhsFilename.c_str(), it);
-          FILE* rhs_file = fopen(fileName, "w+");
+          FILE* rhs_file = fopen(fileName, "wb+");
           vector_right->dump(rhs_file, this->RhsVarname.c_str(), this->RhsFormat, this->rhs_number_format);
           fclose(rhs_file);
         }
@@ -427,13 +574,13 @@ namespace Hermes
         if((residual_norm < newton_tol || it > newton_max_iter) && it > 1)
           break;
 
-        bool rhs_only = (freeze_jacobian && it > 1);
         if(!rhs_only)
         {
           // Assemble the block Jacobian matrix of the stationary residual F
           // Diagonal blocks are created even if empty, so that matrix_left
           // can be added later.
-          stage_dp_right->assemble(u_ext_vec, matrix_right, NULL, force_diagonal_blocks);
+          if(!jacobian_assembled)
+            stage_dp_right->assemble(u_ext_vec, matrix_right, NULL, force_diagonal_blocks);
 
           // Adding the block mass matrix M to matrix_right. This completes the
           // resulting tensor Jacobian.
@@ -446,19 +593,20 @@ namespace Hermes
               sprintf(fileName, "%s%i.m", this->matrixFilename.c_str(), it);
             else
               sprintf(fileName, "%s%i", this->matrixFilename.c_str(), it);
-            FILE* matrix_file = fopen(fileName, "w+");
+            FILE* matrix_file = fopen(fileName, "wb+");
 
             matrix_right->dump(matrix_file, this->matrixVarname.c_str(), this->matrixFormat, this->matrix_number_format);
             fclose(matrix_file);
           }
 
           matrix_right->finish();
+          solver->set_factorization_scheme(HERMES_FACTORIZE_FROM_SCRATCH);
         }
         else
           solver->set_factorization_scheme(HERMES_REUSE_FACTORIZATION_COMPLETELY);
 
         // Solve the linear system.
-        if(!solver->solve())
+        if(!this->solve_linear_system(solver))
           throw Exceptions::LinearMatrixSolverException();
 
         // Add \deltaK^{n + 1} to K^n.
@@ -477,6 +625,16 @@ namespace Hermes
         throw Exceptions::ValueException("Newton iterations", it, newton_max_iter);
       }
 
+      this->finish_time_step(slns_time_prev, slns_time_new, error_fns);
+    }
+
+    template<typename Scalar>
+    void RungeKutta<Scalar>::finish_time_step(Hermes::vector<Solution<Scalar>*> slns_time_prev,
+                                          Hermes::vector<Solution<Scalar>*> slns_time_new,
+                                          Hermes::vector<Solution<Scalar>*> error_fns)
+    {
+      int ndof = Space<Scalar>::get_num_dofs(spaces);
+
       // Project previous time level solution on the stage space,
       // to be able to add them together. The result of the projection
       // will be stored in the vector coeff_vec.
@@ -484,21 +642,7 @@ namespace Hermes
       //         spaces are the same (if spatial adaptivity is not used).
       Scalar* coeff_vec = new Scalar[ndof];
       if(do_global_projections)
-      {
-        OGProjection<Scalar> ogProjection;
         ogProjection.project_global(spaces, slns_time_prev, coeff_vec);
-      }
-      else
-      {
-        LocalProjection<Scalar> ogProjection;
-        ogProjection.project_local(spaces, slns_time_prev, coeff_vec);
-      }
-
-      if(do_global_projections)
-      {
-        OGProjection<Scalar> ogProjection;
-        ogProjection.project_global(spaces, slns_time_prev, coeff_vec);
-      }
       else
       {
         LocalProjection<Scalar> ogProjection;
@@ -510,8 +654,17 @@ namespace Hermes
         for (unsigned int j = 0; j < num_stages; j++)
           coeff_vec[i] += this->time_step * bt->get_B(j) * K_vector[j * ndof + i];
 
+      // The explicit part of an IMEX table (+ h \sum_{j = 1}^s \hat{b}_j \hat{k}_j).
+      if(K_explicit_vector != NULL)
+        for (int i = 0; i < ndof; i++)
+          for (unsigned int j = 0; j < num_stages; j++)
+            coeff_vec[i] += this->time_step * bt->get_B_explicit(j) * K_explicit_vector[j * ndof + i];
+
       Solution<Scalar>::vector_to_solutions(coeff_vec, spaces, slns_time_new);
 
+      if(time_step_control)
+        this->last_time_step_error = this->calc_time_step_error(coeff_vec, ndof);
+
       // If error_fn is not NULL, use the B2-row in the Butcher's
       // table to calculate the temporal error estimate.
       if(error_fns != Hermes::vector<Solution<Scalar>*>())
@@ -526,21 +679,14 @@ namespace Hermes
         Solution<Scalar>::vector_to_solutions_common_dir_lift(coeff_vec, spaces, error_fns);
       }
 
-      // Delete stage spaces.
-      for (unsigned int i = 0; i < num_stages * spaces.size(); i++)
-          delete stage_spaces_vector[i];
-
-      // Delete all residuals.
-      if(!residual_as_vector)
-        for (unsigned int i = 0; i < num_stages; i++)
-          delete residuals_vector[i];
-
       // Clean up.
       delete [] coeff_vec;
 
       iteration++;
       this->tick();
       this->info("\tRunge-Kutta: time step duration: %f s.\n", this->last());
+
+      this->on_finish();
     }
 
     template<typename Scalar>
@@ -563,6 +709,112 @@ namespace Hermes
                           error_fns);
     }
 
+    template<typename Scalar>
+    void RungeKutta<Scalar>::set_time_step_control(double tolerance, unsigned int order, double min_time_step, double max_time_step)
+    {
+      if(tolerance <= 0.)
+        throw Exceptions::ValueException("tolerance", tolerance, 0.0);
+      this->time_step_control = true;
+      this->time_step_tol = tolerance;
+      this->time_step_order = order;
+      this->min_time_step = min_time_step;
+      this->max_time_step = max_time_step;
+      this->last_accepted_time_step_error = -1.;
+    }
+
+    template<typename Scalar>
+    double RungeKutta<Scalar>::calc_time_step_error(Scalar* coeff_vec, int ndof)
+    {
+      double sum = 0.;
+      for (int i = 0; i < ndof; i++)
+      {
+        Scalar error = 0.;
+        for (unsigned int j = 0; j < num_stages; j++)
+          error += (bt->get_B(j) - bt->get_B2(j)) * K_vector[j * ndof + i];
+        double scaled_error = std::abs(error) * this->time_step / (time_step_tol * (1. + std::abs(coeff_vec[i])));
+        sum += scaled_error * scaled_error;
+      }
+      return ndof > 0 ? std::sqrt(sum / ndof) : 0.;
+    }
+
+    template<typename Scalar>
+    double RungeKutta<Scalar>::rk_time_step_adaptive(Hermes::vector<Solution<Scalar>*> slns_time_prev,
+      Hermes::vector<Solution<Scalar>*> slns_time_new)
+    {
+      if(!time_step_control)
+        throw Hermes::Exceptions::Exception("rk_time_step_adaptive(): set_time_step_control() has to be called first.");
+      if(!bt->is_embedded())
+        throw Hermes::Exceptions::Exception("rk_time_step_adaptive(): R-K method must be embedded for the step size control.");
+
+      // Parameters of the controller (Hairer, Wanner: Solving ODEs II, IV.8).
+      const double safety = 0.9;
+      const double min_factor = 0.2;
+      const double max_factor = 5.0;
+      const double alpha = 0.7 / (time_step_order + 1);
+      const double beta = 0.4 / (time_step_order + 1);
+
+      double step = std::min(this->time_step, max_time_step);
+      bool rejected = false;
+      while (true)
+      {
+        this->set_time_step(step);
+
+        bool converged = true;
+        try
+        {
+          rk_time_step_newton(slns_time_prev, slns_time_new);
+        }
+        catch(Exceptions::ValueException&)
+        {
+          converged = false;
+        }
+        catch(Exceptions::LinearMatrixSolverException&)
+        {
+          converged = false;
+        }
+
+        double error = this->last_time_step_error;
+        if(converged && error <= 1.)
+        {
+          double factor = max_factor;
+          if(error > 1e-10)
+          {
+            factor = safety * std::pow(error, -alpha);
+            if(last_accepted_time_step_error > 0.)
+              factor *= std::pow(last_accepted_time_step_error, beta);
+          }
+          factor = std::max(min_factor, std::min(rejected ? 1.0 : max_factor, factor));
+
+          last_accepted_time_step_error = std::max(error, 1e-4);
+          this->time += step;
+          this->set_time_step(std::min(max_time_step, factor * step));
+          this->info("\tRunge-Kutta: time step %g accepted, error estimate %g, next time step %g.", step, error, this->time_step);
+          return step;
+        }
+
+        // Rejected: without Newton's convergence just halve the time step.
+        if(converged)
+          step *= std::max(min_factor, safety * std::pow(error, -1. / (time_step_order + 1)));
+        else
+          step *= 0.5;
+        rejected = true;
+        this->info("\tRunge-Kutta: time step rejected (%s), retrying with time step %g.", converged ? "error estimate" : "Newton's method", step);
+
+        if(step < min_time_step)
+          throw Exceptions::ValueException("time step", step, min_time_step);
+      }
+    }
+
+    template<typename Scalar>
+    double RungeKutta<Scalar>::rk_time_step_adaptive(Solution<Scalar>* sln_time_prev, Solution<Scalar>* sln_time_new)
+    {
+      Hermes::vector<Solution<Scalar>*> slns_time_prev;
+      slns_time_prev.push_back(sln_time_prev);
+      Hermes::vector<Solution<Scalar>*> slns_time_new;
+      slns_time_new.push_back(sln_time_new);
+      return rk_time_step_adaptive(slns_time_prev, slns_time_new);
+    }
+
     template<typename Scalar>
     void RungeKutta<Scalar>::set_filters_to_reinit(Hermes::vector<Filter<Scalar>*> filters_to_reinit)
     {
@@ -571,13 +823,10 @@ namespace Hermes
     }
 
     template<typename Scalar>
-    void RungeKutta<Scalar>::create_stage_wf(unsigned int size, bool block_diagonal_jacobian)
+    void RungeKutta<Scalar>::create_stage_wf_left(unsigned int size)
     {
-      // Clear the WeakForms.
       stage_wf_left.delete_all();
-      stage_wf_right.delete_all();
 
-      // First let's do the mass matrix (only one block ndof times ndof).
       for(unsigned int component_i = 0; component_i < size; component_i++)
       {
         if(spaces[component_i]->get_type() == HERMES_H1_SPACE
@@ -599,6 +848,16 @@ namespace Hermes
           stage_wf_left.add_matrix_form(proj_form);
         }
       }
+    }
+
+    template<typename Scalar>
+    void RungeKutta<Scalar>::create_stage_wf(unsigned int size, bool block_diagonal_jacobian)
+    {
+      // Clear the WeakForms.
+      stage_wf_right.delete_all();
+
+      // First let's do the mass matrix (only one block ndof times ndof).
+      this->create_stage_wf_left(size);
 
       // In the rest we will take the stationary jacobian and residual forms
       // (right-hand side) and use them to create a block Jacobian matrix of
@@ -721,6 +980,7 @@ namespace Hermes
       Hermes::vector<VectorFormVol<Scalar> *> vfvol = stage_wf_right.vfvol;
       Hermes::vector<VectorFormSurf<Scalar> *> vfsurf = stage_wf_right.vfsurf;
 
+      stage_wf_right.ext.clear();
       for(unsigned int slns_time_prev_i = 0; slns_time_prev_i < slns_time_prev.size(); slns_time_prev_i++)
           stage_wf_right.ext.push_back(slns_time_prev[slns_time_prev_i]);
 
@@ -766,22 +1026,540 @@ namespace Hermes
     }
 
     template<typename Scalar>
-    void RungeKutta<Scalar>::prepare_u_ext_vec()
+    void RungeKutta<Scalar>::create_single_stage_wf()
     {
-      unsigned int ndof = Space<Scalar>::get_num_dofs(spaces);
+      // The mass matrix is the same as with the coupled stages.
+      this->create_stage_wf_left(spaces.size());
+      stage_wf_single.delete_all();
+      stage_wf_explicit.delete_all();
+
+      // With an IMEX table, the forms explicit in time are left out of the stage Jacobian
+      // and residual, their vector forms go to stage_wf_explicit.
+      bool imex = bt->is_imex();
+
+      // The stationary forms, used for one stage at a time (ndof times ndof).
+      for (unsigned int m = 0; m < wf->mfvol.size(); m++)
+      {
+        if(imex && wf->mfvol[m]->is_explicit_in_time())
+          continue;
+        MatrixFormVol<Scalar>* mfv = wf->mfvol[m]->clone();
+        mfv->u_ext_offset = 0;
+        stage_wf_single.add_matrix_form(mfv);
+      }
+
+      for (unsigned int m = 0; m < wf->mfsurf.size(); m++)
+      {
+        if(imex && wf->mfsurf[m]->is_explicit_in_time())
+          continue;
+        MatrixFormSurf<Scalar>* mfs = wf->mfsurf[m]->clone();
+        mfs->u_ext_offset = 0;
+        stage_wf_single.add_matrix_form_surf(mfs);
+      }
+
+      for (unsigned int m = 0; m < wf->vfvol.size(); m++)
+      {
+        VectorFormVol<Scalar>* vfv = wf->vfvol[m]->clone();
+        vfv->scaling_factor = -1.0;
+        vfv->u_ext_offset = 0;
+        if(imex && wf->vfvol[m]->is_explicit_in_time())
+        {
+          vfv->explicit_in_time = true;
+          stage_wf_explicit.add_vector_form(vfv);
+        }
+        else
+          stage_wf_single.add_vector_form(vfv);
+      }
+
+      for (unsigned int m = 0; m < wf->vfsurf.size(); m++)
+      {
+        VectorFormSurf<Scalar>* vfs = wf->vfsurf[m]->clone();
+        vfs->scaling_factor = -1.0;
+        vfs->u_ext_offset = 0;
+        if(imex && wf->vfsurf[m]->is_explicit_in_time())
+        {
+          vfs->explicit_in_time = true;
+          stage_wf_explicit.add_vector_form_surf(vfs);
+        }
+        else
+          stage_wf_single.add_vector_form_surf(vfs);
+      }
+    }
+
+    template<typename Scalar>
+    void RungeKutta<Scalar>::update_single_stage_wf(Hermes::vector<Solution<Scalar>*> slns_time_prev, unsigned int stage_i)
+    {
+      if(this->wf->global_integration_order_set)
+      {
+        this->stage_wf_left.set_global_integration_order(this->wf->global_integration_order);
+        this->stage_wf_single.set_global_integration_order(this->wf->global_integration_order);
+        this->stage_wf_explicit.set_global_integration_order(this->wf->global_integration_order);
+      }
+
+      stage_wf_single.ext.clear();
+      stage_wf_explicit.ext.clear();
+      for(unsigned int slns_time_prev_i = 0; slns_time_prev_i < slns_time_prev.size(); slns_time_prev_i++)
+      {
+        stage_wf_single.ext.push_back(slns_time_prev[slns_time_prev_i]);
+        stage_wf_explicit.ext.push_back(slns_time_prev[slns_time_prev_i]);
+      }
+
+      // Only the diagonal coefficient enters the Jacobian of the stage,
+      // the other stages are already known.
+      double stage_time = this->time + bt->get_C(stage_i) * this->time_step;
+      double jacobian_scaling = -this->time_step * bt->get_A(stage_i, stage_i);
+
+      for (unsigned int m = 0; m < stage_wf_single.mfvol.size(); m++)
+      {
+        stage_wf_single.mfvol[m]->scaling_factor = jacobian_scaling;
+        stage_wf_single.mfvol[m]->set_current_stage_time(stage_time);
+      }
+      for (unsigned int m = 0; m < stage_wf_single.mfsurf.size(); m++)
+      {
+        stage_wf_single.mfsurf[m]->scaling_factor = jacobian_scaling;
+        stage_wf_single.mfsurf[m]->set_current_stage_time(stage_time);
+      }
+      for (unsigned int m = 0; m < stage_wf_single.vfvol.size(); m++)
+        stage_wf_single.vfvol[m]->set_current_stage_time(stage_time);
+      for (unsigned int m = 0; m < stage_wf_single.vfsurf.size(); m++)
+        stage_wf_single.vfsurf[m]->set_current_stage_time(stage_time);
+      for (unsigned int m = 0; m < stage_wf_explicit.vfvol.size(); m++)
+        stage_wf_explicit.vfvol[m]->set_current_stage_time(stage_time);
+      for (unsigned int m = 0; m < stage_wf_explicit.vfsurf.size(); m++)
+        stage_wf_explicit.vfsurf[m]->set_current_stage_time(stage_time);
+    }
+
+    template<typename Scalar>
+    void RungeKutta<Scalar>::solve_decoupled_stages(Hermes::vector<Solution<Scalar>*> slns_time_prev,
+      Hermes::vector<Solution<Scalar>*> slns_time_new)
+    {
+      int ndof = Space<Scalar>::get_num_dofs(spaces);
+
+      // The first ndof entries of the utility vectors are used for the current stage.
+      Scalar* stage_u_ext = u_ext_vec;
+      Scalar* stage_left = vector_left;
+
+      // The diagonal coefficient the factorization of stage_solver belongs to.
+      bool jacobian_factorized = false;
+      double factorized_a_ii = 0.;
+      // The mass matrix is factorized at most once per time step.
+      bool mass_factorized = false;
+
+      // Running counter for the rhs / matrix output.
+      int output_it = 1;
+
       for (unsigned int stage_i = 0; stage_i < num_stages; stage_i++)
       {
-        unsigned int running_space_ndofs = 0;
-        for(unsigned int space_i = 0; space_i < spaces.size(); space_i++)
+        Scalar* K_i = K_vector + stage_i * ndof;
+        double a_ii = bt->get_A(stage_i, stage_i);
+        bool explicit_stage = std::abs(a_ii) < 1e-12;
+
+        update_single_stage_wf(slns_time_prev, stage_i);
+
+        // E.g. the first stage of the ARS IMEX tables is only the initial value for the explicit part.
+        bool stage_used = this->is_stage_used(stage_i, false);
+
+        double residual_norm;
+        int it = 1;
+        while (stage_used)
+        {
+          this->prepare_stage_u_ext(stage_i, stage_u_ext, slns_time_new);
+
+          // Lumped mass: K_i = M_L^{-1} f(...) from the residual assembly alone
+          // (the vector forms are scaled by -1).
+          if(explicit_stage && lumped_mass)
+          {
+            stage_dp_single->assemble(stage_u_ext, NULL, stage_vector, true);
+            stage_vector->extract(stage_left);
+            this->apply_lumped_mass_inverse(stage_left, K_i);
+            for (int idx = 0; idx < ndof; idx++)
+              K_i[idx] = -K_i[idx];
+            break;
+          }
+
+          // With a frozen Jacobian, the factorization is kept for all stages with the same diagonal coefficient.
+          bool rhs_only = explicit_stage || (freeze_jacobian && jacobian_factorized && factorized_a_ii == a_ii);
+          bool jacobian_assembled = jacobian_with_residual && !rhs_only;
+
+          // Residual M K_i - f(t_n + c_i h, u_n + h \sum_{j = 1}^i a_{ij} K_j).
+          stage_dp_single->assemble(stage_u_ext, jacobian_assembled ? stage_matrix : NULL, stage_vector, true);
+          matrix_left->multiply_with_vector(K_i, stage_left);
+          stage_vector->add_vector(stage_left);
+          stage_vector->change_sign();
+
+          if(this->output_rhsOn && (this->output_rhsIterations == -1 || this->output_rhsIterations >= output_it))
+          {
+            char* fileName = new char[this->RhsFilename.length() + 5];
+            if(this->RhsFormat == Hermes::Algebra::DF_MATLAB_SPARSE)
+              sprintf(fileName, "%s%i.m", this->RhsFilename.c_str(), output_it);
+            else
+              sprintf(fileName, "%s%i", this->RhsFilename.c_str(), output_it);
+            FILE* rhs_file = fopen(fileName, "wb+");
+            stage_vector->dump(rhs_file, this->RhsVarname.c_str(), this->RhsFormat, this->rhs_number_format);
+            fclose(rhs_file);
+          }
+
+          // Measure the residual norm.
+          if(residual_as_vector)
+            residual_norm = Global<Scalar>::get_l2_norm(stage_vector);
+          else
+          {
+            Solution<Scalar>::vector_to_solutions(stage_vector, spaces, residuals_vector, false);
+            residual_norm = Global<Scalar>::calc_norms(residuals_vector);
+          }
+
+          if(it == 1)
+            this->info("\tRunge-Kutta: stage %d, Newton initial residual norm: %g", stage_i + 1, residual_norm);
+          else
+            this->info("\tRunge-Kutta: stage %d, Newton iteration %d, residual norm: %g", stage_i + 1, it - 1, residual_norm);
+
+          if(residual_norm > newton_max_allowed_residual_norm)
+            throw Exceptions::ValueException("residual norm", residual_norm, newton_max_allowed_residual_norm);
+
+          if(residual_norm < newton_tol && it > 1)
+            break;
+
+          if(it > newton_max_iter)
+          {
+            this->tick();
+            this->info("\tRunge-Kutta: time step duration: %f s.\n", this->last());
+            throw Exceptions::ValueException("Newton iterations", it, newton_max_iter);
+          }
+
+          LinearMatrixSolver<Scalar>* current_solver;
+          if(explicit_stage)
+          {
+            // M K_i = f(...) with everything on the right-hand side known.
+            current_solver = mass_solver;
+            current_solver->set_factorization_scheme(mass_factorized ? HERMES_REUSE_FACTORIZATION_COMPLETELY : HERMES_FACTORIZE_FROM_SCRATCH);
+            mass_factorized = true;
+          }
+          else
+          {
+            current_solver = stage_solver;
+            if(!rhs_only)
+            {
+              if(!jacobian_assembled)
+                stage_dp_single->assemble(stage_u_ext, stage_matrix, NULL, true);
+
+              // J = M - h a_ii df/du.
+              stage_matrix->add_sparse_to_diagonal_blocks(1, matrix_left);
+
+              if(this->output_matrixOn && (this->output_matrixIterations == -1 || this->output_matrixIterations >= output_it))
+              {
+                char* fileName = new char[this->matrixFilename.length() + 5];
+                if(this->matrixFormat == Hermes::Algebra::DF_MATLAB_SPARSE)
+                  sprintf(fileName, "%s%i.m", this->matrixFilename.c_str(), output_it);
+                else
+                  sprintf(fileName, "%s%i", this->matrixFilename.c_str(), output_it);
+                FILE* matrix_file = fopen(fileName, "wb+");
+
+                stage_matrix->dump(matrix_file, this->matrixVarname.c_str(), this->matrixFormat, this->matrix_number_format);
+                fclose(matrix_file);
+              }
+
+              stage_matrix->finish();
+              current_solver->set_factorization_scheme(HERMES_FACTORIZE_FROM_SCRATCH);
+              jacobian_factorized = true;
+              factorized_a_ii = a_ii;
+            }
+            else
+              current_solver->set_factorization_scheme(HERMES_REUSE_FACTORIZATION_COMPLETELY);
+          }
+
+          if(!this->solve_linear_system(current_solver))
+            throw Exceptions::LinearMatrixSolverException();
+
+          for (int idx = 0; idx < ndof; idx++)
+            K_i[idx] += newton_damping_coeff * current_solver->get_sln_vector()[idx];
+
+          output_it++;
+          it++;
+
+          // The explicit stage is linear in K_i.
+          if(explicit_stage)
+            break;
+        }
+
+        // IMEX: \hat{K}_i = M^{-1} f_E(t_n + c_i h, u_n + h \sum_{j = 1}^i a_{ij} K_j + h \sum_{j = 1}^{i - 1} \hat{a}_{ij} \hat{K}_j).
+        if(K_explicit_vector != NULL && this->is_stage_used(stage_i, true))
         {
-          for (int idx = 0; idx < spaces[space_i]->get_num_dofs(); idx++)
+          Scalar* K_explicit_i = K_explicit_vector + stage_i * ndof;
+          this->prepare_stage_u_ext(stage_i, stage_u_ext, slns_time_new);
+
+          // The vector forms are scaled by -1.
+          stage_dp_explicit->assemble(stage_u_ext, NULL, stage_vector, true);
+          stage_vector->change_sign();
+
+          if(lumped_mass)
+          {
+            stage_vector->extract(stage_left);
+            this->apply_lumped_mass_inverse(stage_left, K_explicit_i);
+          }
+          else
           {
-            Scalar increment = 0;
-            for (unsigned int stage_j = 0; stage_j < num_stages; stage_j++)
-              increment += bt->get_A(stage_i, stage_j) * K_vector[stage_j * ndof + running_space_ndofs + idx];
-            u_ext_vec[stage_i * ndof + running_space_ndofs + idx] = this->time_step * increment;
+            mass_solver->set_factorization_scheme(mass_factorized ? HERMES_REUSE_FACTORIZATION_COMPLETELY : HERMES_FACTORIZE_FROM_SCRATCH);
+            mass_factorized = true;
+            if(!this->solve_linear_system(mass_solver))
+              throw Exceptions::LinearMatrixSolverException();
+            memcpy(K_explicit_i, mass_solver->get_sln_vector(), ndof * sizeof(Scalar));
           }
-          running_space_ndofs += spaces[space_i]->get_num_dofs();
+        }
+      }
+    }
+
+    template<typename Scalar>
+    bool RungeKutta<Scalar>::is_stage_used(unsigned int stage_i, bool explicit_part)
+    {
+      if(explicit_part)
+      {
+        if(bt->get_B_explicit(stage_i) != 0.)
+          return true;
+        for (unsigned int stage_j = stage_i + 1; stage_j < num_stages; stage_j++)
+          if(bt->get_A_explicit(stage_j, stage_i) != 0.)
+            return true;
+        return false;
+      }
+
+      if(bt->get_B(stage_i) != 0. || bt->get_B2(stage_i) != 0.)
+        return true;
+      for (unsigned int stage_j = stage_i; stage_j < num_stages; stage_j++)
+        if(bt->get_A(stage_j, stage_i) != 0.)
+          return true;
+      return false;
+    }
+
+    template<typename Scalar>
+    void RungeKutta<Scalar>::prepare_stage_u_ext(unsigned int stage_i, Scalar* stage_u_ext, Hermes::vector<Solution<Scalar>*> slns_time_new)
+    {
+      int ndof = Space<Scalar>::get_num_dofs(spaces);
+
+      // Prepare vector h\sum_{j = 1}^i a_{ij} K_j.
+      memset(stage_u_ext, 0, ndof * sizeof(Scalar));
+      for (unsigned int stage_j = 0; stage_j <= stage_i; stage_j++)
+      {
+        double a_ij = bt->get_A(stage_i, stage_j);
+        if(a_ij == 0.)
+          continue;
+        for (int idx = 0; idx < ndof; idx++)
+          stage_u_ext[idx] += this->time_step * a_ij * K_vector[stage_j * ndof + idx];
+      }
+
+      // The explicit part of an IMEX table.
+      if(K_explicit_vector != NULL)
+      {
+        for (unsigned int stage_j = 0; stage_j < stage_i; stage_j++)
+        {
+          double a_ij = bt->get_A_explicit(stage_i, stage_j);
+          if(a_ij == 0.)
+            continue;
+          for (int idx = 0; idx < ndof; idx++)
+            stage_u_ext[idx] += this->time_step * a_ij * K_explicit_vector[stage_j * ndof + idx];
+        }
+      }
+
+      // Reinitialize filters.
+      if(this->filters_to_reinit.size() > 0)
+      {
+        Solution<Scalar>::vector_to_solutions(stage_u_ext, spaces, slns_time_new);
+
+        for(unsigned int filters_i = 0; filters_i < this->filters_to_reinit.size(); filters_i++)
+          filters_to_reinit.at(filters_i)->reinit();
+      }
+    }
+
+    template<typename Scalar>
+    void RungeKutta<Scalar>::create_lumped_mass()
+    {
+      int ndof = Space<Scalar>::get_num_dofs(spaces);
+      mass_block_starts.clear();
+      mass_block_dofs.clear();
+      mass_block_inverses.clear();
+      mass_block_value_starts.clear();
+
+      bool* in_block = new bool[ndof];
+      memset(in_block, 0, ndof * sizeof(bool));
+
+      // L2 spaces: the mass matrix consists of the element blocks, these are inverted exactly.
+      for (unsigned int space_i = 0; space_i < spaces.size(); space_i++)
+      {
+        if(spaces[space_i]->get_type() != HERMES_L2_SPACE)
+          continue;
+        int first_dof = Space<Scalar>::get_dof_offset(spaces, space_i);
+        AsmList<Scalar> al;
+        Element* e;
+        for_all_active_elements(e, spaces[space_i]->get_mesh())
+        {
+          spaces[space_i]->get_element_assembly_list(e, &al, first_dof);
+          Hermes::vector<int> dofs;
+          for (unsigned int i = 0; i < al.get_cnt(); i++)
+            if(al.get_dof()[i] >= 0)
+              dofs.push_back(al.get_dof()[i]);
+          int n = dofs.size();
+          if(n == 0)
+            continue;
+
+          // Gauss-Jordan elimination of [M_e | I].
+          Scalar* a = new Scalar[n * n];
+          Scalar* inv = new Scalar[n * n];
+          for (int i = 0; i < n; i++)
+            for (int j = 0; j < n; j++)
+            {
+              a[i * n + j] = matrix_left->get(dofs[i], dofs[j]);
+              inv[i * n + j] = (i == j) ? 1.0 : 0.0;
+            }
+          for (int col = 0; col < n; col++)
+          {
+            int pivot = col;
+            for (int i = col + 1; i < n; i++)
+              if(std::abs(a[i * n + col]) > std::abs(a[pivot * n + col]))
+                pivot = i;
+            if(std::abs(a[pivot * n + col]) < 1e-300)
+              throw Exceptions::Exception("RungeKutta: singular element block of the mass matrix.");
+            if(pivot != col)
+              for (int j = 0; j < n; j++)
+              {
+                std::swap(a[col * n + j], a[pivot * n + j]);
+                std::swap(inv[col * n + j], inv[pivot * n + j]);
+              }
+            Scalar pivot_inverse = 1.0 / a[col * n + col];
+            for (int j = 0; j < n; j++)
+            {
+              a[col * n + j] *= pivot_inverse;
+              inv[col * n + j] *= pivot_inverse;
+            }
+            for (int i = 0; i < n; i++)
+            {
+              if(i == col)
+                continue;
+              Scalar factor = a[i * n + col];
+              if(factor == 0.0)
+                continue;
+              for (int j = 0; j < n; j++)
+              {
+                a[i * n + j] -= factor * a[col * n + j];
+                inv[i * n + j] -= factor * inv[col * n + j];
+              }
+            }
+          }
+
+          mass_block_starts.push_back(mass_block_dofs.size());
+          mass_block_value_starts.push_back(mass_block_inverses.size());
+          for (int i = 0; i < n; i++)
+          {
+            mass_block_dofs.push_back(dofs[i]);
+            in_block[dofs[i]] = true;
+          }
+          for (int i = 0; i < n * n; i++)
+            mass_block_inverses.push_back(inv[i]);
+          delete [] a;
+          delete [] inv;
+        }
+      }
+
+      // The rest is lumped by the row sums.
+      Scalar* ones = new Scalar[ndof];
+      Scalar* row_sums = new Scalar[ndof];
+      for (int i = 0; i < ndof; i++)
+        ones[i] = 1.0;
+      matrix_left->multiply_with_vector(ones, row_sums);
+      for (int i = 0; i < ndof; i++)
+      {
+        if(in_block[i])
+          continue;
+        if(std::abs(row_sums[i]) < 1e-300)
+          throw Exceptions::Exception("RungeKutta: zero row sum of the lumped mass matrix.");
+        mass_block_starts.push_back(mass_block_dofs.size());
+        mass_block_value_starts.push_back(mass_block_inverses.size());
+        mass_block_dofs.push_back(i);
+        mass_block_inverses.push_back(1.0 / row_sums[i]);
+      }
+      mass_block_starts.push_back(mass_block_dofs.size());
+
+      delete [] ones;
+      delete [] row_sums;
+      delete [] in_block;
+    }
+
+    template<typename Scalar>
+    void RungeKutta<Scalar>::apply_lumped_mass_inverse(Scalar* rhs, Scalar* sln)
+    {
+      int num_blocks = mass_block_starts.size() - 1;
+#pragma omp parallel for schedule(static)
+      for (int block = 0; block < num_blocks; block++)
+      {
+        int start = mass_block_starts[block];
+        int n = mass_block_starts[block + 1] - start;
+        const Scalar* inv = &mass_block_inverses[mass_block_value_starts[block]];
+        for (int i = 0; i < n; i++)
+        {
+          Scalar value = 0.0;
+          for (int j = 0; j < n; j++)
+            value += inv[i * n + j] * rhs[mass_block_dofs[start + j]];
+          sln[mass_block_dofs[start + i]] = value;
+        }
+      }
+    }
+
+    template<typename Scalar>
+    void RungeKutta<Scalar>::update_stage_spaces()
+    {
+      bool spaces_changed = (stage_spaces_seqs.size() != spaces.size());
+      for (unsigned int space_i = 0; space_i < spaces.size() && !spaces_changed; space_i++)
+        if(stage_spaces_seqs[space_i] != spaces[space_i]->get_seq())
+          spaces_changed = true;
+
+      if(spaces_changed)
+      {
+        for (unsigned int i = 0; i < stage_spaces_vector.size(); i++)
+          delete stage_spaces_vector[i];
+        stage_spaces_vector.clear();
+
+        // Create spaces for stage solutions K_i. This is necessary
+        // to define a num_stages x num_stages block weak formulation.
+        Hermes::vector<const Space<Scalar>*> stage_spaces_vector_const;
+        for (unsigned int i = 0; i < num_stages; i++)
+          for(unsigned int space_i = 0; space_i < spaces.size(); space_i++)
+          {
+            typename Space<Scalar>::ReferenceSpaceCreator ref_space_creator(spaces[space_i], spaces[space_i]->get_mesh(), 0);
+            Space<Scalar>* stage_space = ref_space_creator.create_ref_space();
+            stage_spaces_vector.push_back(stage_space);
+            stage_spaces_vector_const.push_back(stage_space);
+          }
+
+        stage_spaces_seqs.clear();
+        for (unsigned int space_i = 0; space_i < spaces.size(); space_i++)
+          stage_spaces_seqs.push_back(spaces[space_i]->get_seq());
+
+        // The sparse structure of stage_dp_right is only recalculated now.
+        this->stage_dp_right->set_spaces(stage_spaces_vector_const);
+      }
+
+      // Only the time of the essential boundary conditions changes.
+      for (unsigned int i = 0; i < num_stages; i++)
+      {
+        Hermes::vector<Space<Scalar>*> stage_i_spaces;
+        for(unsigned int space_i = 0; space_i < spaces.size(); space_i++)
+          stage_i_spaces.push_back(stage_spaces_vector[i * spaces.size() + space_i]);
+        Space<Scalar>::update_essential_bc_values(stage_i_spaces, this->time + bt->get_C(i) * this->time_step);
+      }
+    }
+
+    template<typename Scalar>
+    void RungeKutta<Scalar>::prepare_u_ext_vec()
+    {
+      unsigned int ndof = Space<Scalar>::get_num_dofs(spaces);
+      memset(u_ext_vec, 0, num_stages * ndof * sizeof(Scalar));
+      for (unsigned int stage_i = 0; stage_i < num_stages; stage_i++)
+      {
+        Scalar* u_ext_i = u_ext_vec + stage_i * ndof;
+        for (unsigned int stage_j = 0; stage_j < num_stages; stage_j++)
+        {
+          double a_ij = bt->get_A(stage_i, stage_j);
+          if(a_ij == 0.)
+            continue;
+          Scalar* K_j = K_vector + stage_j * ndof;
+          for (unsigned int idx = 0; idx < ndof; idx++)
+            u_ext_i[idx] += this->time_step * a_ij * K_j[idx];
         }
       }
     }
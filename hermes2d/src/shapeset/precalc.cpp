@@ -17,16 +17,318 @@
 #include "quad_all.h"
 #include "precalc.h"
 #include "mesh.h"
+#include "api2d.h"
+#include "binary_file.h"
+#include <map>
+#include <set>
 namespace Hermes
 {
   namespace Hermes2D
   {
+    /// Slot states of PrecalcShapeset::Cache.
+    static const int H2D_PRECALC_CACHE_EMPTY = -1;
+    static const int H2D_PRECALC_CACHE_DELETED = -2;
+    /// Initial number of slots of PrecalcShapeset::Cache.
+    static const unsigned int H2D_PRECALC_CACHE_INITIAL_CAPACITY = 256;
+    /// Number of the most recently used entries never evicted from PrecalcShapeset::Cache.
+    static const unsigned int H2D_PRECALC_CACHE_MIN_ENTRIES = 64;
+
+    /// The tables of PrecalcShapeset are freed by its caches, not by Function::delete_node().
+    static int precalc_shapeset_memory_category = Hermes::MemoryAccounting::add_category("precalculated shapesets");
+
+    PrecalcShapeset::Cache::Cache() : free_entries(-1), capacity(H2D_PRECALC_CACHE_INITIAL_CAPACITY), num_entries(0), num_deleted(0),
+      lru_first(-1), lru_last(-1), memory(0)
+    {
+      slots = new int[capacity];
+      for(unsigned int i = 0; i < capacity; i++)
+        slots[i] = H2D_PRECALC_CACHE_EMPTY;
+    }
+
+    PrecalcShapeset::Cache::~Cache()
+    {
+      clear();
+      delete [] slots;
+    }
+
+    unsigned int PrecalcShapeset::Cache::hash(unsigned shape_key, uint64_t sub_idx, int order)
+    {
+      uint64_t h = sub_idx * 0x9E3779B97F4A7C15ULL;
+      h ^= ((uint64_t)shape_key << 8) + (uint64_t)order + (h >> 29);
+      h *= 0xBF58476D1CE4E5B9ULL;
+      return (unsigned int)(h ^ (h >> 32));
+    }
+
+    int PrecalcShapeset::Cache::find_slot(unsigned shape_key, uint64_t sub_idx, int order) const
+    {
+      unsigned int mask = capacity - 1;
+      for(unsigned int i = hash(shape_key, sub_idx, order) & mask; slots[i] != H2D_PRECALC_CACHE_EMPTY; i = (i + 1) & mask)
+      {
+        if(slots[i] == H2D_PRECALC_CACHE_DELETED)
+          continue;
+        const Entry& entry = entries[slots[i]];
+        if(entry.sub_idx == sub_idx && entry.shape_key == shape_key && entry.order == order)
+          return i;
+      }
+      return -1;
+    }
+
+    void PrecalcShapeset::Cache::rehash(unsigned int new_capacity)
+    {
+      delete [] slots;
+      capacity = new_capacity;
+      slots = new int[capacity];
+      for(unsigned int i = 0; i < capacity; i++)
+        slots[i] = H2D_PRECALC_CACHE_EMPTY;
+      num_deleted = 0;
+
+      unsigned int mask = capacity - 1;
+      for(int entry = lru_first; entry != -1; entry = entries[entry].next)
+      {
+        unsigned int i = hash(entries[entry].shape_key, entries[entry].sub_idx, entries[entry].order) & mask;
+        while(slots[i] != H2D_PRECALC_CACHE_EMPTY)
+          i = (i + 1) & mask;
+        slots[i] = entry;
+      }
+    }
+
+    void PrecalcShapeset::Cache::lru_unlink(int entry)
+    {
+      Entry& e = entries[entry];
+      if(e.prev != -1)
+        entries[e.prev].next = e.next;
+      else
+        lru_first = e.next;
+      if(e.next != -1)
+        entries[e.next].prev = e.prev;
+      else
+        lru_last = e.prev;
+    }
+
+    void PrecalcShapeset::Cache::lru_push_front(int entry)
+    {
+      entries[entry].prev = -1;
+      entries[entry].next = lru_first;
+      if(lru_first != -1)
+        entries[lru_first].prev = entry;
+      else
+        lru_last = entry;
+      lru_first = entry;
+    }
+
+    PrecalcShapeset::Node* PrecalcShapeset::Cache::get(unsigned shape_key, uint64_t sub_idx, int order)
+    {
+      int slot = find_slot(shape_key, sub_idx, order);
+      if(slot == -1)
+        return NULL;
+      int entry = slots[slot];
+      if(entry != lru_first)
+      {
+        lru_unlink(entry);
+        lru_push_front(entry);
+      }
+      return entries[entry].node;
+    }
+
+    void PrecalcShapeset::Cache::remove(int slot)
+    {
+      int entry = slots[slot];
+      lru_unlink(entry);
+      if(!entries[entry].shared)
+      {
+        memory -= entries[entry].node->size;
+        Hermes::MemoryAccounting::released(precalc_shapeset_memory_category, entries[entry].node->size);
+        ::free(entries[entry].node);
+      }
+      entries[entry].node = NULL;
+      entries[entry].next = free_entries;
+      free_entries = entry;
+      slots[slot] = H2D_PRECALC_CACHE_DELETED;
+      num_entries--;
+      num_deleted++;
+    }
+
+    void PrecalcShapeset::Cache::put(unsigned shape_key, uint64_t sub_idx, int order, Node* node, bool shared)
+    {
+      int slot = find_slot(shape_key, sub_idx, order);
+      if(slot != -1)
+      {
+        // Replace the tables (precalculated again with a larger mask).
+        Entry& entry = entries[slots[slot]];
+        if(entry.node != node)
+        {
+          if(!entry.shared)
+          {
+            memory -= entry.node->size;
+            Hermes::MemoryAccounting::released(precalc_shapeset_memory_category, entry.node->size);
+            ::free(entry.node);
+          }
+          entry.node = node;
+          entry.shared = shared;
+          if(!shared)
+            memory += node->size;
+        }
+        if(slots[slot] != lru_first)
+        {
+          lru_unlink(slots[slot]);
+          lru_push_front(slots[slot]);
+        }
+      }
+      else
+      {
+        if(4 * (num_entries + num_deleted + 1) > 3 * capacity)
+          rehash(2 * num_entries + 2 > capacity ? 2 * capacity : capacity);
+
+        int entry;
+        if(free_entries != -1)
+        {
+          entry = free_entries;
+          free_entries = entries[entry].next;
+        }
+        else
+        {
+          entry = entries.size();
+          entries.push_back(Entry());
+        }
+        entries[entry].shape_key = shape_key;
+        entries[entry].sub_idx = sub_idx;
+        entries[entry].order = order;
+        entries[entry].node = node;
+        entries[entry].shared = shared;
+        lru_push_front(entry);
+
+        unsigned int mask = capacity - 1;
+        unsigned int i = hash(shape_key, sub_idx, order) & mask;
+        while(slots[i] >= 0)
+          i = (i + 1) & mask;
+        if(slots[i] == H2D_PRECALC_CACHE_DELETED)
+          num_deleted--;
+        slots[i] = entry;
+        num_entries++;
+        if(!shared)
+          memory += node->size;
+      }
+
+      // Eviction of the least recently used tables.
+      size_t limit = (size_t)Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::precalcCacheSizeLimit) * 1024 * 1024;
+      if(limit == 0)
+        return;
+      while(memory > limit && num_entries > H2D_PRECALC_CACHE_MIN_ENTRIES)
+        remove(find_slot(entries[lru_last].shape_key, entries[lru_last].sub_idx, entries[lru_last].order));
+    }
+
+    void PrecalcShapeset::Cache::clear()
+    {
+      for(int entry = lru_first; entry != -1; entry = entries[entry].next)
+        if(!entries[entry].shared)
+        {
+          Hermes::MemoryAccounting::released(precalc_shapeset_memory_category, entries[entry].node->size);
+          ::free(entries[entry].node);
+        }
+      entries.clear();
+      free_entries = -1;
+      lru_first = lru_last = -1;
+      for(unsigned int i = 0; i < capacity; i++)
+        slots[i] = H2D_PRECALC_CACHE_EMPTY;
+      num_entries = num_deleted = 0;
+      memory = 0;
+    }
+
+    size_t PrecalcShapeset::Cache::get_memory() const
+    {
+      return memory;
+    }
+
+    /// Identification of the tables in PrecalcShapeset::shared_tables.
+    struct SharedTablesKey
+    {
+      int shapeset_id;
+      Quad2D* quad;
+      int mode;
+      int index;
+      int order;
+
+      bool operator<(const SharedTablesKey& other) const
+      {
+        if(shapeset_id != other.shapeset_id)
+          return shapeset_id < other.shapeset_id;
+        if(quad != other.quad)
+          return quad < other.quad;
+        if(mode != other.mode)
+          return mode < other.mode;
+        if(index != other.index)
+          return index < other.index;
+        return order < other.order;
+      }
+    };
+
+    class PrecalcShapeset::SharedTables : public std::map<SharedTablesKey, PrecalcShapeset::Node*>
+    {
+    public:
+      ~SharedTables()
+      {
+        for(iterator it = begin(); it != end(); it++)
+        {
+          Hermes::MemoryAccounting::released(precalc_shapeset_memory_category, it->second->size);
+          ::free(it->second);
+        }
+        for(unsigned int i = 0; i < replaced.size(); i++)
+        {
+          Hermes::MemoryAccounting::released(precalc_shapeset_memory_category, replaced[i]->size);
+          ::free(replaced[i]);
+        }
+      }
+
+      /// Tables replaced by ones with a larger mask, still referenced from the caches of the instances.
+      std::vector<PrecalcShapeset::Node*> replaced;
+
+      /// The shapesets (ids) whose file of PrecalcShapeset::save_shared_tables() has been looked for.
+      std::set<int> loaded;
+    };
+
+    static const char H2D_SHARED_TABLES_MAGIC[8] = { 'H', '2', 'D', 'P', 'S', 'T', 'B', '\0' };
+    static const int H2D_SHARED_TABLES_VERSION = 1;
+
+    /// The fixed-size beginning of the files of PrecalcShapeset::save_shared_tables(), followed by one section per element mode:
+    /// for every shape function and every table of g_quad_2d_std, the H2D_FN_DEFAULT tables (value, dx, dy of every component).
+    struct SharedTablesHeader
+    {
+      char magic[8];
+      int version;
+      int byte_order;
+      int shapeset_id;
+      int num_components;
+      int max_index[H2D_NUM_MODES];
+      int num_tables[H2D_NUM_MODES];
+    };
+
+    void PrecalcShapeset::calculate_shared_table(Shapeset* shapeset, int index, int table, ElementMode2D mode, double* values)
+    {
+      int np = g_quad_2d_std.get_num_points(table, mode);
+      double3* pt = g_quad_2d_std.get_points(table, mode);
+      double* x = new double[2 * np];
+      double* y = x + np;
+      for (int i = 0; i < np; i++)
+      {
+        x[i] = pt[i][0];
+        y[i] = pt[i][1];
+      }
+      for (int j = 0; j < shapeset->get_num_components(); j++)
+        for (int k = 0; k < 3; k++)
+          shapeset->get_values(k, index, np, x, y, j, mode, values + (3 * j + k) * np);
+      delete [] x;
+    }
+
+    PrecalcShapeset::SharedTables PrecalcShapeset::shared_tables;
+
     PrecalcShapeset::PrecalcShapeset(Shapeset* shapeset) : Function<double>()
     {
       if(shapeset == NULL)
         throw Exceptions::NullException(0);
       this->shapeset = shapeset;
+      this->memory_category = precalc_shapeset_memory_category;
       master_pss = NULL;
+      overflow_node = NULL;
+      shape_key = 0;
       num_components = shapeset->get_num_components();
       assert(num_components == 1 || num_components == 2);
       update_max_index();
@@ -38,6 +340,9 @@ namespace Hermes
       while (pss->is_slave())
         pss = pss->master_pss;
       master_pss = pss;
+      this->memory_category = precalc_shapeset_memory_category;
+      overflow_node = NULL;
+      shape_key = 0;
       shapeset = pss->shapeset;
       num_components = pss->num_components;
       update_max_index();
@@ -57,40 +362,216 @@ namespace Hermes
 
     void PrecalcShapeset::handle_overflow_idx()
     {
-      if(overflow_nodes != NULL)
-      {
-        for(unsigned int i = 0; i < overflow_nodes->get_size(); i++)
-          if(overflow_nodes->present(i))
-            ::free(overflow_nodes->get(i));
-        delete overflow_nodes;
-      }
-      nodes = new LightArray<Node *>;
-      overflow_nodes = nodes;
     }
 
     void PrecalcShapeset::set_active_shape(int index)
     {
       // Key creation.
-      unsigned key = cur_quad | (element->get_mode() << 3) | ((unsigned) (max_index[element->get_mode()] - index) << 4);
+      shape_key = cur_quad | (element->get_mode() << 3) | ((unsigned) (max_index[element->get_mode()] - index) << 4);
+
+      this->index = index;
+      order = std::max(H2D_GET_H_ORDER(shapeset->get_order(index, element->get_mode())), H2D_GET_V_ORDER(shapeset->get_order(index, element->get_mode())));
+    }
 
-      if(master_pss == NULL)
+    void PrecalcShapeset::set_quad_order(unsigned int order, int mask)
+    {
+      // The overflowed transformations are not unique, the tables are always precalculated again.
+      if(sub_idx > H2D_MAX_IDX)
       {
-        if(!tables.present(key))
-          tables.add(new std::map<uint64_t, LightArray<Node*>*>, key);
-        sub_tables = tables.get(key);
+        cur_node = NULL;
+        precalculate(order, mask);
+        if(overflow_node != NULL)
+          delete_node(overflow_node);
+        overflow_node = cur_node;
+        return;
       }
-      else
+
+      Cache& owner_cache = (master_pss == NULL) ? cache : master_pss->cache;
+      cur_node = owner_cache.get(shape_key, sub_idx, order);
+      if(cur_node != NULL && (cur_node->mask & mask) == mask)
+        return;
+
+      // The reference element tables are the same for all the instances.
+      if(sub_idx == 0 && index >= 0 && ctm->m[0] == 1.0 && ctm->m[1] == 1.0 && ctm->t[0] == 0.0 && ctm->t[1] == 0.0)
       {
-        if(!master_pss->tables.present(key))
-          master_pss->tables.add(new std::map<uint64_t, LightArray<Node*>*>, key);
-        sub_tables = master_pss->tables.get(key);
+        cur_node = get_shared_node(order, cur_node == NULL ? mask : (mask | cur_node->mask));
+        owner_cache.put(shape_key, sub_idx, order, cur_node, true);
+        return;
       }
 
-      // Update the Node table.
-      update_nodes_ptr();
+      precalculate(order, mask);
+      owner_cache.put(shape_key, sub_idx, order, cur_node);
+    }
 
-      this->index = index;
-      order = std::max(H2D_GET_H_ORDER(shapeset->get_order(index, element->get_mode())), H2D_GET_V_ORDER(shapeset->get_order(index, element->get_mode())));
+    PrecalcShapeset::Node* PrecalcShapeset::get_shared_node(int order, int mask)
+    {
+      SharedTablesKey key;
+      key.shapeset_id = shapeset->get_id();
+      key.quad = get_quad_2d();
+      key.mode = element->get_mode();
+      key.index = index;
+      key.order = order;
+
+      Node* node = NULL;
+#pragma omp critical (precalc_shared_tables)
+      {
+        if(key.quad == &g_quad_2d_std && shared_tables.loaded.insert(key.shapeset_id).second)
+          load_shared_tables(shapeset);
+        SharedTables::iterator it = shared_tables.find(key);
+        if(it != shared_tables.end())
+          node = it->second;
+      }
+      if(node != NULL && (node->mask & mask) == mask)
+        return node;
+
+      // Precalculated outside of the critical section, starting from the tables present.
+      cur_node = node;
+      precalculate(order, mask);
+      Node* precalculated = cur_node;
+
+#pragma omp critical (precalc_shared_tables)
+      {
+        SharedTables::iterator it = shared_tables.find(key);
+        if(it == shared_tables.end())
+          shared_tables.insert(std::pair<SharedTablesKey, Node*>(key, precalculated));
+        else if((it->second->mask & precalculated->mask) == precalculated->mask)
+        {
+          // Another thread was faster.
+          Hermes::MemoryAccounting::released(precalc_shapeset_memory_category, precalculated->size);
+          ::free(precalculated);
+          precalculated = it->second;
+        }
+        else
+        {
+          shared_tables.replaced.push_back(it->second);
+          it->second = precalculated;
+        }
+      }
+      return precalculated;
+    }
+
+    std::string PrecalcShapeset::get_shared_tables_file_name(Shapeset* shapeset, const char* dir)
+    {
+      std::stringstream ss;
+      ss << dir;
+      if(!ss.str().empty() && ss.str().at(ss.str().length() - 1) != '/' && ss.str().at(ss.str().length() - 1) != '\\')
+        ss << '/';
+      ss << "precalc_tables_" << shapeset->get_id() << ".h2d";
+      return ss.str();
+    }
+
+    void PrecalcShapeset::save_shared_tables(Shapeset* shapeset, const char* dir)
+    {
+      if(shapeset == NULL)
+        throw Exceptions::NullException(1);
+
+      SharedTablesHeader header;
+      memset(&header, 0, sizeof(SharedTablesHeader));
+      memcpy(header.magic, H2D_SHARED_TABLES_MAGIC, sizeof(H2D_SHARED_TABLES_MAGIC));
+      header.version = H2D_SHARED_TABLES_VERSION;
+      header.byte_order = H2D_BINARY_FILE_BYTE_ORDER;
+      header.shapeset_id = shapeset->get_id();
+      header.num_components = shapeset->get_num_components();
+      for (int mode = 0; mode < H2D_NUM_MODES; mode++)
+      {
+        header.max_index[mode] = shapeset->get_max_index((ElementMode2D)mode);
+        header.num_tables[mode] = g_quad_2d_std.get_num_tables((ElementMode2D)mode);
+      }
+
+      std::string file_name = get_shared_tables_file_name(shapeset, dir == NULL ? Hermes2DApi.get_text_param_value(precalculatedFormsDirPath).c_str() : dir);
+      FILE* f = fopen(file_name.c_str(), "wb");
+      if(f == NULL)
+        throw Exceptions::Exception("PrecalcShapeset::save_shared_tables(): could not open %s for writing.", file_name.c_str());
+      std::vector<double> values;
+      try
+      {
+        BinaryFile::write(f, &header, sizeof(SharedTablesHeader));
+        for (int mode = 0; mode < H2D_NUM_MODES; mode++)
+        {
+          size_t size_per_index = 0;
+          for (int table = 0; table < header.num_tables[mode]; table++)
+            size_per_index += 3 * header.num_components * g_quad_2d_std.get_num_points(table, (ElementMode2D)mode);
+          values.resize(size_per_index * (header.max_index[mode] + 1));
+          double* next = &values[0];
+          for (int index = 0; index <= header.max_index[mode]; index++)
+            for (int table = 0; table < header.num_tables[mode]; table++)
+            {
+              calculate_shared_table(shapeset, index, table, (ElementMode2D)mode, next);
+              next += 3 * header.num_components * g_quad_2d_std.get_num_points(table, (ElementMode2D)mode);
+            }
+          BinaryFile::write(f, &values[0], sizeof(double) * values.size());
+        }
+      }
+      catch(...)
+      {
+        fclose(f);
+        throw;
+      }
+      fclose(f);
+    }
+
+    void PrecalcShapeset::load_shared_tables(Shapeset* shapeset)
+    {
+      std::string file_name = get_shared_tables_file_name(shapeset, Hermes2DApi.get_text_param_value(precalculatedFormsDirPath).c_str());
+      if(!BinaryFile::has_magic(file_name.c_str(), H2D_SHARED_TABLES_MAGIC))
+        return;
+
+      BinaryFile* file = NULL;
+      try
+      {
+        file = new BinaryFile(file_name.c_str());
+        const SharedTablesHeader* header = (const SharedTablesHeader*)file->next_section(sizeof(SharedTablesHeader));
+        if(header->byte_order != H2D_BINARY_FILE_BYTE_ORDER || header->version != H2D_SHARED_TABLES_VERSION)
+          throw Exceptions::Exception("File %s was written by another version or on a machine of another byte order.", file_name.c_str());
+        bool valid = (header->shapeset_id == shapeset->get_id() && header->num_components == shapeset->get_num_components());
+        for (int mode = 0; mode < H2D_NUM_MODES; mode++)
+          valid = valid && header->max_index[mode] == shapeset->get_max_index((ElementMode2D)mode)
+            && header->num_tables[mode] == g_quad_2d_std.get_num_tables((ElementMode2D)mode);
+        if(!valid)
+          throw Exceptions::Exception("File %s does not correspond to the shapeset.", file_name.c_str());
+
+        int num_components = header->num_components;
+        for (int mode = 0; mode < H2D_NUM_MODES; mode++)
+        {
+          size_t size_per_index = 0;
+          for (int table = 0; table < header->num_tables[mode]; table++)
+            size_per_index += 3 * num_components * g_quad_2d_std.get_num_points(table, (ElementMode2D)mode);
+          const double* values = (const double*)file->next_section(sizeof(double) * size_per_index * (header->max_index[mode] + 1));
+
+          SharedTablesKey key;
+          key.shapeset_id = header->shapeset_id;
+          key.quad = &g_quad_2d_std;
+          key.mode = mode;
+          for (key.index = 0; key.index <= header->max_index[mode]; key.index++)
+            for (key.order = 0; key.order < header->num_tables[mode]; key.order++)
+            {
+              int np = g_quad_2d_std.get_num_points(key.order, (ElementMode2D)mode);
+              int size = (sizeof(Node) - sizeof(double)) + sizeof(double) * np * 3 * num_components;
+              Node* node = (Node*) malloc(size);
+              Hermes::MemoryAccounting::allocated(precalc_shapeset_memory_category, size);
+              node->mask = H2D_FN_DEFAULT;
+              node->size = size;
+              memset(node->values, 0, sizeof(node->values));
+              for (int j = 0; j < num_components; j++)
+                for (int k = 0; k < 3; k++)
+                  node->values[j][k] = node->data + (3 * j + k) * np;
+              memcpy(node->data, values, sizeof(double) * np * 3 * num_components);
+              values += np * 3 * num_components;
+
+              std::pair<SharedTables::iterator, bool> inserted = shared_tables.insert(std::pair<SharedTablesKey, Node*>(key, node));
+              if(!inserted.second)
+              {
+                Hermes::MemoryAccounting::released(precalc_shapeset_memory_category, size);
+                ::free(node);
+              }
+            }
+        }
+      }
+      catch(Hermes::Exceptions::Exception& e)
+      {
+        Hermes::Mixins::Loggable::Static::warn("%s The tables are precalculated during the assembling.", e.what());
+      }
+      delete file;
     }
 
     void PrecalcShapeset::set_active_element(Element* e)
@@ -111,6 +592,15 @@ namespace Hermes
       int newmask = mask | oldmask;
       Node* node = new_node(newmask, np);
 
+      // the transformed integration points
+      double* x = new double[2 * np];
+      double* y = x + np;
+      for (i = 0; i < np; i++)
+      {
+        x[i] = ctm->m[0] * pt[i][0] + ctm->t[0];
+        y[i] = ctm->m[1] * pt[i][1] + ctm->t[1];
+      }
+
       // precalculate all required tables
       for (j = 0; j < num_components; j++)
       {
@@ -121,45 +611,25 @@ namespace Hermes
             if(oldmask & idx2mask[k][j])
               memcpy(node->values[j][k], cur_node->values[j][k], np * sizeof(double));
             else
-              for (i = 0; i < np; i++)
-                node->values[j][k][i] = shapeset->get_value(k, index, ctm->m[0] * pt[i][0] + ctm->t[0],
-                ctm->m[1] * pt[i][1] + ctm->t[1], j, element->get_mode());
+              shapeset->get_values(k, index, np, x, y, j, element->get_mode(), node->values[j][k]);
           }
         }
       }
-      if(nodes->present(order))
-      {
-        assert(nodes->get(order) == cur_node);
-        ::free(nodes->get(order));
-      }
-      nodes->add(node, order);
+      delete [] x;
       cur_node = node;
     }
 
     void PrecalcShapeset::free()
     {
+      if(overflow_node != NULL)
+      {
+        delete_node(overflow_node);
+        overflow_node = NULL;
+      }
+      free_node_pool();
       if(master_pss != NULL) return;
 
-      for(unsigned int i = 0; i < tables.get_size(); i++)
-        if(tables.present(i))
-        {
-          for(std::map<uint64_t, LightArray<Node*>*>::iterator it = tables.get(i)->begin(); it != tables.get(i)->end(); it++)
-          {
-            for(unsigned int k = 0; k < it->second->get_size(); k++)
-              if(it->second->present(k))
-                ::free(it->second->get(k));
-            delete it->second;
-          }
-          delete tables.get(i);
-        }
-
-        if(overflow_nodes != NULL)
-        {
-          for(unsigned int i = 0; i < overflow_nodes->get_size(); i++)
-            if(overflow_nodes->present(i))
-              ::free(overflow_nodes->get(i));
-          delete overflow_nodes;
-        }
+      cache.clear();
     }
 
     extern PrecalcShapeset ref_map_pss;
@@ -172,15 +642,11 @@ namespace Hermes
     void PrecalcShapeset::push_transform(int son)
     {
       Transformable::push_transform(son);
-      if(sub_tables != NULL)
-        update_nodes_ptr();
     }
 
     void PrecalcShapeset::pop_transform()
     {
       Transformable::pop_transform();
-      if(sub_tables != NULL)
-        update_nodes_ptr();
     }
 
     int PrecalcShapeset::get_active_shape() const
@@ -203,6 +669,7 @@ namespace Hermes
       assert(master_pss != NULL);
       sub_idx = master_pss->sub_idx;
       top = master_pss->top;
+      valid_top = 0;
       stack[top] = *(master_pss->ctm);
       ctm = stack + top;
     }
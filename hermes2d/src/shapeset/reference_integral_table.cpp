@@ -0,0 +1,202 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <string.h>
+#include "reference_integral_table.h"
+#include "binary_file.h"
+#include "api2d.h"
+#include "quad_all.h"
+#include "limit_order.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    static const char H2D_REFERENCE_INTEGRAL_TABLE_MAGIC[8] = { 'H', '2', 'D', 'R', 'I', 'N', 'T', '\0' };
+    static const int H2D_REFERENCE_INTEGRAL_TABLE_VERSION = 1;
+
+    /// The loaded tables (NULL for the ones without a file), by 2 * shapeset id + mode, freed at the exit.
+    class ReferenceIntegralTables
+    {
+    public:
+      ~ReferenceIntegralTables()
+      {
+        for(std::map<int, ReferenceIntegralTable*>::iterator it = tables.begin(); it != tables.end(); it++)
+          delete it->second;
+      }
+      std::map<int, ReferenceIntegralTable*> tables;
+    };
+    static ReferenceIntegralTables reference_integral_tables;
+
+    ReferenceIntegralTable::ReferenceIntegralTable(const char* file_name, Shapeset* shapeset, ElementMode2D mode) : file(NULL), max_index(0), integrals(NULL)
+    {
+      file = new BinaryFile(file_name);
+      try
+      {
+        const Header* header = (const Header*)file->next_section(sizeof(Header));
+        if(memcmp(header->magic, H2D_REFERENCE_INTEGRAL_TABLE_MAGIC, sizeof(H2D_REFERENCE_INTEGRAL_TABLE_MAGIC)))
+          throw Exceptions::Exception("File %s is not a table of reference integrals.", file_name);
+        if(header->byte_order != H2D_BINARY_FILE_BYTE_ORDER || header->version != H2D_REFERENCE_INTEGRAL_TABLE_VERSION)
+          throw Exceptions::Exception("File %s was written by another version or on a machine of another byte order.", file_name);
+        if(header->shapeset_id != shapeset->get_id() || header->mode != mode || header->max_index != shapeset->get_max_index(mode) || header->max_order != shapeset->get_max_order())
+          throw Exceptions::Exception("File %s does not correspond to the shapeset.", file_name);
+        max_index = header->max_index;
+        integrals = (const double*)file->next_section(sizeof(double) * 4 * (max_index + 1) * (max_index + 1));
+      }
+      catch(...)
+      {
+        delete file;
+        throw;
+      }
+    }
+
+    ReferenceIntegralTable::~ReferenceIntegralTable()
+    {
+      delete file;
+    }
+
+    int ReferenceIntegralTable::get_max_index() const
+    {
+      return max_index;
+    }
+
+    std::string ReferenceIntegralTable::get_file_name(Shapeset* shapeset, ElementMode2D mode, const char* dir)
+    {
+      std::stringstream ss;
+      ss << dir;
+      if(!ss.str().empty() && ss.str().at(ss.str().length() - 1) != '/' && ss.str().at(ss.str().length() - 1) != '\\')
+        ss << '/';
+      ss << "reference_integrals_" << shapeset->get_id() << (mode == HERMES_MODE_TRIANGLE ? "_tri" : "_quad") << ".h2d";
+      return ss.str();
+    }
+
+    const ReferenceIntegralTable* ReferenceIntegralTable::find(Shapeset* shapeset, ElementMode2D mode)
+    {
+      ReferenceIntegralTable* table = NULL;
+#pragma omp critical (reference_integral_tables)
+      {
+        int key = 2 * shapeset->get_id() + mode;
+        std::map<int, ReferenceIntegralTable*>::iterator it = reference_integral_tables.tables.find(key);
+        if(it != reference_integral_tables.tables.end())
+          table = it->second;
+        else
+        {
+          std::string file_name = get_file_name(shapeset, mode, Hermes2DApi.get_text_param_value(precalculatedFormsDirPath).c_str());
+          if(BinaryFile::has_magic(file_name.c_str(), H2D_REFERENCE_INTEGRAL_TABLE_MAGIC))
+          {
+            try
+            {
+              table = new ReferenceIntegralTable(file_name.c_str(), shapeset, mode);
+            }
+            catch(Hermes::Exceptions::Exception& e)
+            {
+              Hermes::Mixins::Loggable::Static::warn("%s The reference integrals are calculated during the assembling.", e.what());
+              table = NULL;
+            }
+          }
+          reference_integral_tables.tables[key] = table;
+        }
+      }
+      return table;
+    }
+
+    void ReferenceIntegralTable::calculate(Shapeset* shapeset, int index_u, int index_v, ElementMode2D mode, double* values)
+    {
+      // The products are polynomials, the rule of their degree integrates them exactly.
+      int order_u = shapeset->get_order(index_u, mode), order_v = shapeset->get_order(index_v, mode);
+      int order;
+      if(mode == HERMES_MODE_TRIANGLE)
+        order = order_u + order_v;
+      else
+        order = std::max(H2D_GET_H_ORDER(order_u) + H2D_GET_H_ORDER(order_v), H2D_GET_V_ORDER(order_u) + H2D_GET_V_ORDER(order_v));
+      limit_order_nowarn(order, mode);
+
+      double3* pt = g_quad_2d_std.get_points(order, mode);
+      int np = g_quad_2d_std.get_num_points(order, mode);
+      double* x = new double[np];
+      double* y = new double[np];
+      for(int i = 0; i < np; i++)
+      {
+        x[i] = pt[i][0];
+        y[i] = pt[i][1];
+      }
+      double* u_val = new double[6 * np];
+      double *u_dx = u_val + np, *u_dy = u_val + 2 * np, *v_val = u_val + 3 * np, *v_dx = u_val + 4 * np, *v_dy = u_val + 5 * np;
+      for(int n = 0; n < 3; n++)
+      {
+        shapeset->get_values(n, index_u, np, x, y, 0, mode, u_val + n * np);
+        shapeset->get_values(n, index_v, np, x, y, 0, mode, v_val + n * np);
+      }
+
+      memset(values, 0, 4 * sizeof(double));
+      for(int i = 0; i < np; i++)
+      {
+        values[0] += pt[i][2] * u_val[i] * v_val[i];
+        values[1] += pt[i][2] * u_dx[i] * v_dx[i];
+        values[2] += pt[i][2] * (u_dx[i] * v_dy[i] + u_dy[i] * v_dx[i]);
+        values[3] += pt[i][2] * u_dy[i] * v_dy[i];
+      }
+
+      delete [] u_val;
+      delete [] x;
+      delete [] y;
+    }
+
+    void ReferenceIntegralTable::save(Shapeset* shapeset, ElementMode2D mode, const char* dir)
+    {
+      if(shapeset == NULL)
+        throw Exceptions::NullException(1);
+      if(shapeset->get_num_components() > 1)
+        throw Exceptions::Exception("ReferenceIntegralTable::save(): only scalar shapesets are supported.");
+
+      Header header;
+      memset(&header, 0, sizeof(Header));
+      memcpy(header.magic, H2D_REFERENCE_INTEGRAL_TABLE_MAGIC, sizeof(H2D_REFERENCE_INTEGRAL_TABLE_MAGIC));
+      header.version = H2D_REFERENCE_INTEGRAL_TABLE_VERSION;
+      header.byte_order = H2D_BINARY_FILE_BYTE_ORDER;
+      header.shapeset_id = shapeset->get_id();
+      header.mode = mode;
+      header.max_index = shapeset->get_max_index(mode);
+      header.max_order = shapeset->get_max_order();
+
+      int n = header.max_index + 1;
+      double* integrals = new double[4 * n * n];
+      for(int index_u = 0; index_u < n; index_u++)
+        for(int index_v = 0; index_v < n; index_v++)
+          calculate(shapeset, index_u, index_v, mode, integrals + 4 * (index_u * n + index_v));
+
+      std::string file_name = get_file_name(shapeset, mode, dir == NULL ? Hermes2DApi.get_text_param_value(precalculatedFormsDirPath).c_str() : dir);
+      FILE* f = fopen(file_name.c_str(), "wb");
+      if(f == NULL)
+      {
+        delete [] integrals;
+        throw Exceptions::Exception("ReferenceIntegralTable::save(): could not open %s for writing.", file_name.c_str());
+      }
+      try
+      {
+        BinaryFile::write(f, &header, sizeof(Header));
+        BinaryFile::write(f, integrals, sizeof(double) * 4 * n * n);
+      }
+      catch(...)
+      {
+        fclose(f);
+        delete [] integrals;
+        throw;
+      }
+      fclose(f);
+      delete [] integrals;
+    }
+  }
+}
@@ -165,6 +165,12 @@ namespace Hermes
       return sum;
     }
 
+    void Shapeset::get_values(int n, int index, int np, const double* x, const double* y, int component, ElementMode2D mode, double* values)
+    {
+      for(int i = 0; i < np; i++)
+        values[i] = get_value(n, index, x[i], y[i], component, mode);
+    }
+
     Shapeset::~Shapeset() { free_constrained_edge_combinations(); }
 
     int Shapeset::get_max_order() const { return max_order; }
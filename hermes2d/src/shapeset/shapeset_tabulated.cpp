@@ -0,0 +1,389 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "global.h"
+#include "shapeset_tabulated.h"
+#include <map>
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    /// The highest degree of the expansions.
+    static const int H2D_TABULATED_MAX_DEGREE = 24;
+    /// How many degrees above the order of a shape function are tried.
+    static const int H2D_TABULATED_EXTRA_DEGREES = 3;
+    /// Relative tolerance of the check of an expansion against the original function.
+    static const double H2D_TABULATED_TOLERANCE = 1e-10;
+    /// Coefficients smaller than this times the largest one are set to zero.
+    static const double H2D_TABULATED_ZERO = 1e-13;
+
+    /// Orders of the derivatives by x and y for the values of FunctionExpansionIndex.
+    static const int tabulated_dx_order[6] = { 0, 1, 0, 2, 0, 1 };
+    static const int tabulated_dy_order[6] = { 0, 0, 1, 0, 2, 1 };
+
+    class ShapesetTabulated::Tables
+    {
+    public:
+      Tables(int max_index[H2D_NUM_MODES]) : max_degree(0)
+      {
+        for(int mode = 0; mode < H2D_NUM_MODES; mode++)
+        {
+          num_shapes[mode] = max_index[mode] + 1;
+          for(int component = 0; component < H2D_MAX_SOLUTION_COMPONENTS; component++)
+          {
+            expansions[mode][component] = new Expansion[num_shapes[mode]];
+            for(int i = 0; i < num_shapes[mode]; i++)
+            {
+              expansions[mode][component][i].degree = -1;
+              expansions[mode][component][i].coeffs = NULL;
+            }
+          }
+        }
+      }
+
+      ~Tables()
+      {
+        for(int mode = 0; mode < H2D_NUM_MODES; mode++)
+          for(int component = 0; component < H2D_MAX_SOLUTION_COMPONENTS; component++)
+          {
+            for(int i = 0; i < num_shapes[mode]; i++)
+              delete [] expansions[mode][component][i].coeffs;
+            delete [] expansions[mode][component];
+          }
+      }
+
+      int num_shapes[H2D_NUM_MODES];
+      /// The highest degree of the expansions.
+      int max_degree;
+      Expansion* expansions[H2D_NUM_MODES][H2D_MAX_SOLUTION_COMPONENTS];
+    };
+
+    class ShapesetTabulated::Registry : public std::map<int, ShapesetTabulated::Tables*>
+    {
+    public:
+      ~Registry()
+      {
+        for(iterator it = begin(); it != end(); it++)
+          delete it->second;
+      }
+    };
+
+    ShapesetTabulated::Registry ShapesetTabulated::registry;
+
+    /// Gauss-Legendre points and weights on (-1, 1).
+    static void gauss_legendre(int n, double* points, double* weights)
+    {
+      for(int i = 0; i < n; i++)
+      {
+        double x = cos(M_PI * (i + 0.75) / (n + 0.5));
+        double dp = 1.0;
+        for(int it = 0; it < 100; it++)
+        {
+          double p0 = 1.0, p1 = x;
+          for(int k = 1; k < n; k++)
+          {
+            double p2 = ((2 * k + 1) * x * p1 - k * p0) / (k + 1);
+            p0 = p1;
+            p1 = p2;
+          }
+          // P_n = p1, P_{n-1} = p0.
+          dp = n * (x * p1 - p0) / (x * x - 1.0);
+          double dx = p1 / dp;
+          x -= dx;
+          if(fabs(dx) < 1e-15)
+            break;
+        }
+        points[i] = x;
+        weights[i] = 2.0 / ((1.0 - x * x) * dp * dp);
+      }
+    }
+
+    ShapesetTabulated::ShapesetTabulated(Shapeset* shapeset) : Shapeset(*shapeset)
+    {
+      comb_table = NULL;
+      table_size = 0;
+      id = shapeset->get_id();
+      space_type = shapeset->get_space_type();
+      for(int mode = 0; mode < H2D_NUM_MODES; mode++)
+        max_index[mode] = shapeset->get_max_index((ElementMode2D)mode);
+      tables = get_tables(shapeset, max_index);
+    }
+
+    ShapesetTabulated::ShapesetTabulated(const ShapesetTabulated& other) : Shapeset(other)
+    {
+      comb_table = NULL;
+      table_size = 0;
+      id = other.id;
+      space_type = other.space_type;
+      for(int mode = 0; mode < H2D_NUM_MODES; mode++)
+        max_index[mode] = other.max_index[mode];
+      tables = other.tables;
+    }
+
+    Shapeset* ShapesetTabulated::clone()
+    {
+      return new ShapesetTabulated(*this);
+    }
+
+    int ShapesetTabulated::get_max_index(ElementMode2D mode)
+    {
+      return max_index[mode];
+    }
+
+    SpaceType ShapesetTabulated::get_space_type() const
+    {
+      return space_type;
+    }
+
+    int ShapesetTabulated::get_id() const
+    {
+      return id;
+    }
+
+    ShapesetTabulated::Tables* ShapesetTabulated::get_tables(Shapeset* shapeset, int max_index[H2D_NUM_MODES])
+    {
+      Tables* tables = NULL;
+#pragma omp critical (shapeset_tabulated_registry)
+      {
+        Registry::iterator it = registry.find(shapeset->get_id());
+        if(it != registry.end())
+          tables = it->second;
+        else
+        {
+          tables = new Tables(max_index);
+          for(int mode = 0; mode < H2D_NUM_MODES; mode++)
+            for(int component = 0; component < shapeset->get_num_components(); component++)
+              for(int index = 0; index <= max_index[mode]; index++)
+              {
+                tables->expansions[mode][component][index] = calculate_expansion(shapeset, index, component, (ElementMode2D)mode);
+                tables->max_degree = std::max(tables->max_degree, tables->expansions[mode][component][index].degree);
+              }
+          registry.insert(std::pair<int, Tables*>(shapeset->get_id(), tables));
+        }
+      }
+      return tables;
+    }
+
+    ShapesetTabulated::Expansion ShapesetTabulated::calculate_expansion(Shapeset* shapeset, int index, int component, ElementMode2D mode)
+    {
+      Expansion expansion;
+      expansion.degree = -1;
+      expansion.coeffs = NULL;
+      if(shapeset->shape_table[H2D_FEI_VALUE][mode] == NULL)
+        return expansion;
+
+      // Points of the check, inside of the reference domain.
+      const int num_check = 7;
+      const double check_coords[num_check] = { -1.0, -0.83, -0.41, -0.07, 0.29, 0.64, 1.0 };
+      double check_x[num_check * num_check], check_y[num_check * num_check];
+      int np_check = 0;
+      for(int i = 0; i < num_check; i++)
+        for(int j = 0; j < num_check; j++)
+          if(mode == HERMES_MODE_QUAD || check_coords[i] + check_coords[j] <= 0.0)
+          {
+            check_x[np_check] = check_coords[i];
+            check_y[np_check] = check_coords[j];
+            np_check++;
+          }
+
+      int order = shapeset->get_order(index, mode);
+      if(mode == HERMES_MODE_QUAD)
+        order = std::max(H2D_GET_H_ORDER(order), H2D_GET_V_ORDER(order));
+
+      double points[H2D_TABULATED_MAX_DEGREE + 1], weights[H2D_TABULATED_MAX_DEGREE + 1];
+      double* legendre = new double[(H2D_TABULATED_MAX_DEGREE + 1) * (H2D_TABULATED_MAX_DEGREE + 1)];
+      double* samples = new double[(H2D_TABULATED_MAX_DEGREE + 1) * (H2D_TABULATED_MAX_DEGREE + 1)];
+      double* values = new double[np_check];
+      double* check_legendre_x = new double[6 * (H2D_TABULATED_MAX_DEGREE + 1) * np_check];
+      double* check_legendre_y = check_legendre_x + 3 * (H2D_TABULATED_MAX_DEGREE + 1) * np_check;
+
+      for(int degree = std::max(order, 1); degree <= std::min(order + H2D_TABULATED_EXTRA_DEGREES, H2D_TABULATED_MAX_DEGREE); degree++)
+      {
+        int m = degree + 1;
+        gauss_legendre(m, points, weights);
+        legendre_values(1, degree, m, points, legendre);
+        for(int a = 0; a < m; a++)
+          for(int b = 0; b < m; b++)
+            samples[a * m + b] = weights[a] * weights[b] * shapeset->get_value(H2D_FEI_VALUE, index, points[a], points[b], component, mode);
+
+        double* coeffs = new double[m * m];
+        for(int i = 0; i < m; i++)
+          for(int j = 0; j < m; j++)
+          {
+            double sum = 0.0;
+            for(int a = 0; a < m; a++)
+              for(int b = 0; b < m; b++)
+                sum += samples[a * m + b] * legendre[i * m + a] * legendre[j * m + b];
+            coeffs[i * m + j] = sum * (2 * i + 1) * (2 * j + 1) / 4.0;
+          }
+
+        // Most of the coefficients are zero up to rounding (e.g. the products of two one-dimensional functions on quads).
+        double max_coeff = 0.0;
+        for(int i = 0; i < m * m; i++)
+          max_coeff = std::max(max_coeff, fabs(coeffs[i]));
+        for(int i = 0; i < m * m; i++)
+          if(fabs(coeffs[i]) < H2D_TABULATED_ZERO * max_coeff)
+            coeffs[i] = 0.0;
+
+        // The check of the values and of the first derivatives.
+        Expansion candidate;
+        candidate.degree = degree;
+        candidate.coeffs = coeffs;
+        legendre_values(3, degree, np_check, check_x, check_legendre_x);
+        legendre_values(3, degree, np_check, check_y, check_legendre_y);
+        bool ok = true;
+        for(int n = 0; n < 3 && ok; n++)
+        {
+          if(shapeset->shape_table[n] == NULL || shapeset->shape_table[n][mode] == NULL)
+            continue;
+          evaluate(candidate, n, np_check, check_legendre_x, check_legendre_y, m * np_check, values);
+          for(int p = 0; p < np_check && ok; p++)
+          {
+            double exact = shapeset->get_value(n, index, check_x[p], check_y[p], component, mode);
+            if(fabs(values[p] - exact) > H2D_TABULATED_TOLERANCE * std::max(1.0, fabs(exact)))
+              ok = false;
+          }
+        }
+
+        if(ok)
+        {
+          expansion = candidate;
+          break;
+        }
+        delete [] coeffs;
+      }
+
+      delete [] legendre;
+      delete [] samples;
+      delete [] values;
+      delete [] check_legendre_x;
+      return expansion;
+    }
+
+    void ShapesetTabulated::legendre_values(int num_levels, int degree, int np, const double* x, double* values)
+    {
+      double* p = values;
+      for(int i = 0; i < np; i++)
+        p[i] = 1.0;
+      if(degree > 0)
+        for(int i = 0; i < np; i++)
+          p[np + i] = x[i];
+      for(int k = 1; k < degree; k++)
+      {
+        double a = (2 * k + 1) / (double)(k + 1), b = k / (double)(k + 1);
+        for(int i = 0; i < np; i++)
+          p[(k + 1) * np + i] = a * x[i] * p[k * np + i] - b * p[(k - 1) * np + i];
+      }
+
+      // P'_{k+1} = P'_{k-1} + (2k + 1) P_k, the same for the second derivatives.
+      for(int level = 1; level < num_levels; level++)
+      {
+        double* d = values + level * (degree + 1) * np;
+        double* lower = d - (degree + 1) * np;
+        for(int i = 0; i < np; i++)
+          d[i] = 0.0;
+        if(degree > 0)
+          for(int i = 0; i < np; i++)
+            d[np + i] = (level == 1) ? 1.0 : 0.0;
+        for(int k = 1; k < degree; k++)
+          for(int i = 0; i < np; i++)
+            d[(k + 1) * np + i] = d[(k - 1) * np + i] + (2 * k + 1) * lower[k * np + i];
+      }
+    }
+
+    const double* ShapesetTabulated::get_legendre_values(PointsCache& cache, int degree, int np, const double* x)
+    {
+      bool valid = (cache.np == np && cache.degree == degree);
+      for(int i = 0; i < np && valid; i++)
+        if(cache.points[i] != x[i])
+          valid = false;
+
+      if(!valid)
+      {
+        if(cache.capacity < np)
+        {
+          delete [] cache.points;
+          delete [] cache.values;
+          cache.capacity = np;
+          cache.points = new double[np];
+          cache.values = new double[3 * (H2D_TABULATED_MAX_DEGREE + 1) * np];
+        }
+        memcpy(cache.points, x, np * sizeof(double));
+        cache.np = np;
+        cache.degree = degree;
+        legendre_values(3, degree, np, x, cache.values);
+      }
+      return cache.values;
+    }
+
+    void ShapesetTabulated::evaluate(const Expansion& expansion, int n, int np, const double* legendre_x, const double* legendre_y, int level_size, double* values)
+    {
+      int m = expansion.degree + 1;
+      const double* px = legendre_x + tabulated_dx_order[n] * level_size;
+      const double* py = legendre_y + tabulated_dy_order[n] * level_size;
+      double* sum_y = new double[np];
+
+      for(int p = 0; p < np; p++)
+        values[p] = 0.0;
+      for(int i = 0; i < m; i++)
+      {
+        const double* c = expansion.coeffs + i * m;
+        bool zero_row = true;
+        for(int j = 0; j < m && zero_row; j++)
+          if(c[j] != 0.0)
+            zero_row = false;
+        if(zero_row)
+          continue;
+
+        for(int p = 0; p < np; p++)
+          sum_y[p] = 0.0;
+        for(int j = 0; j < m; j++)
+        {
+          if(c[j] == 0.0)
+            continue;
+          const double cj = c[j];
+          const double* py_j = py + j * np;
+          for(int p = 0; p < np; p++)
+            sum_y[p] += cj * py_j[p];
+        }
+        const double* px_i = px + i * np;
+        for(int p = 0; p < np; p++)
+          values[p] += px_i[p] * sum_y[p];
+      }
+
+      delete [] sum_y;
+    }
+
+    /// The Legendre values of the last points of every thread, in x and in y.
+    static ShapesetTabulated::PointsCache tabulated_points_x = { 0, -1, 0, NULL, NULL };
+    static ShapesetTabulated::PointsCache tabulated_points_y = { 0, -1, 0, NULL, NULL };
+#pragma omp threadprivate(tabulated_points_x, tabulated_points_y)
+
+    void ShapesetTabulated::get_values(int n, int index, int np, const double* x, const double* y, int component, ElementMode2D mode, double* values)
+    {
+      if(index < 0 || index > max_index[mode] || tables->expansions[mode][component][index].degree < 0)
+      {
+        Shapeset::get_values(n, index, np, x, y, component, mode, values);
+        return;
+      }
+
+      // All the shape functions are evaluated in the same points one after another, the polynomials are reused.
+      const double* legendre_x = get_legendre_values(tabulated_points_x, tables->max_degree, np, x);
+      const double* legendre_y = get_legendre_values(tabulated_points_y, tables->max_degree, np, y);
+      evaluate(tables->expansions[mode][component][index], n, np, legendre_x, legendre_y, (tables->max_degree + 1) * np, values);
+    }
+  }
+}
@@ -0,0 +1,155 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "tensor_factors.h"
+#include "quad_all.h"
+#include "precalc.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    /// Relative tolerance of the product test and of the comparison of factors.
+    static const double H2D_TENSOR_FACTORS_TOLERANCE = 1e-9;
+
+    QuadTensorFactors::QuadTensorFactors(int order) : order(order)
+    {
+      np = g_quad_1d_std.get_num_points(order);
+    }
+
+    QuadTensorFactors::~QuadTensorFactors()
+    {
+      for(int direction = 0; direction < 2; direction++)
+        for(unsigned int i = 0; i < factors[direction].size(); i++)
+          delete [] factors[direction][i];
+    }
+
+    int QuadTensorFactors::get_num_points() const
+    {
+      return np;
+    }
+
+    int QuadTensorFactors::get_num_factors(int direction) const
+    {
+      return factors[direction].size();
+    }
+
+    const double* QuadTensorFactors::get_values(int direction, int factor, bool derivative) const
+    {
+      return factors[direction][factor] + (derivative ? np : 0);
+    }
+
+    int QuadTensorFactors::find_factor(int direction, const double* values)
+    {
+      for(unsigned int i = 0; i < factors[direction].size(); i++)
+      {
+        bool same = true;
+        for(int k = 0; k < 2 * np && same; k++)
+          if(std::abs(factors[direction][i][k] - values[k]) > H2D_TENSOR_FACTORS_TOLERANCE * (1.0 + std::abs(values[k])))
+            same = false;
+        if(same)
+          return i;
+      }
+
+      double* factor = new double[2 * np];
+      memcpy(factor, values, 2 * np * sizeof(double));
+      factors[direction].push_back(factor);
+      return factors[direction].size() - 1;
+    }
+
+    bool QuadTensorFactors::get(PrecalcShapeset* pss, int index, int& x_factor, int& y_factor, double& scale)
+    {
+      std::map<int, Split>::iterator it = splits.find(index);
+      if(it == splits.end())
+      {
+        Split split;
+        split.is_product = false;
+
+        pss->set_active_shape(index);
+        pss->set_quad_order(order);
+        double* val = pss->get_fn_values();
+        double* dx = pss->get_dx_values();
+        double* dy = pss->get_dy_values();
+
+        // The (first) point of the largest value, for a product it lies in the maxima of both factors.
+        double max_val = 0.0, max_dx = 0.0, max_dy = 0.0;
+        for(int k = 0; k < np * np; k++)
+        {
+          max_val = std::max(max_val, std::abs(val[k]));
+          max_dx = std::max(max_dx, std::abs(dx[k]));
+          max_dy = std::max(max_dy, std::abs(dy[k]));
+        }
+
+        int k_max = 0;
+        while(std::abs(val[k_max]) < (1.0 - H2D_TENSOR_FACTORS_TOLERANCE) * max_val)
+          k_max++;
+
+        if(max_val > 0.0)
+        {
+          int i_max = k_max / np, j_max = k_max % np;
+          double s = val[k_max];
+
+          // X and its derivative along the line eta = eta_{j_max}, Y along xi = xi_{i_max}, both equal to 1 in the maximum.
+          double* x_values = new double[2 * np];
+          double* y_values = new double[2 * np];
+          for(int i = 0; i < np; i++)
+          {
+            x_values[i] = val[i * np + j_max] / s;
+            x_values[np + i] = dx[i * np + j_max] / s;
+          }
+          for(int j = 0; j < np; j++)
+          {
+            y_values[j] = val[i_max * np + j] / s;
+            y_values[np + j] = dy[i_max * np + j] / s;
+          }
+
+          split.is_product = true;
+          double tolerance_val = H2D_TENSOR_FACTORS_TOLERANCE * max_val;
+          double tolerance_dx = H2D_TENSOR_FACTORS_TOLERANCE * std::max(max_val, max_dx);
+          double tolerance_dy = H2D_TENSOR_FACTORS_TOLERANCE * std::max(max_val, max_dy);
+          for(int i = 0; i < np && split.is_product; i++)
+            for(int j = 0; j < np && split.is_product; j++)
+            {
+              int k = i * np + j;
+              if(std::abs(val[k] - s * x_values[i] * y_values[j]) > tolerance_val
+                || std::abs(dx[k] - s * x_values[np + i] * y_values[j]) > tolerance_dx
+                || std::abs(dy[k] - s * x_values[i] * y_values[np + j]) > tolerance_dy)
+                split.is_product = false;
+            }
+
+          if(split.is_product)
+          {
+            split.factor[0] = find_factor(0, x_values);
+            split.factor[1] = find_factor(1, y_values);
+            split.scale = s;
+          }
+
+          delete [] x_values;
+          delete [] y_values;
+        }
+
+        it = splits.insert(std::pair<int, Split>(index, split)).first;
+      }
+
+      if(!it->second.is_product)
+        return false;
+
+      x_factor = it->second.factor[0];
+      y_factor = it->second.factor[1];
+      scale = it->second.scale;
+      return true;
+    }
+  }
+}
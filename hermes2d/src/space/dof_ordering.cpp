@@ -0,0 +1,255 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "dof_ordering.h"
+#include <algorithm>
+#include <vector>
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    /// Orders the vertices by their degrees, ties by the vertex numbers.
+    struct DegreeCompare
+    {
+      DegreeCompare(const int* adj_start) : adj_start(adj_start) {}
+      bool operator()(int a, int b) const
+      {
+        int degree_a = adj_start[a + 1] - adj_start[a], degree_b = adj_start[b + 1] - adj_start[b];
+        return degree_a < degree_b || (degree_a == degree_b && a < b);
+      }
+      const int* adj_start;
+    };
+
+    /// A part of the graph still to be ordered by nested dissection: its region id and one of its vertices.
+    struct DissectionPart
+    {
+      int region_id;
+      int vertex;
+    };
+
+    int DofOrdering::level_structure(int root, const int* adj_start, const int* adj, const int* region, int region_id, int* level, int* queue, int& queue_size)
+    {
+      queue_size = 0;
+      queue[queue_size++] = root;
+      level[root] = 0;
+      int num_levels = 1;
+      for (int i = 0; i < queue_size; i++)
+      {
+        int v = queue[i];
+        for (int j = adj_start[v]; j < adj_start[v + 1]; j++)
+        {
+          int w = adj[j];
+          if(region[w] == region_id && level[w] == -1)
+          {
+            level[w] = level[v] + 1;
+            num_levels = level[w] + 1;
+            queue[queue_size++] = w;
+          }
+        }
+      }
+      return num_levels;
+    }
+
+    int DofOrdering::pseudo_peripheral_vertex(int root, const int* adj_start, const int* adj, const int* region, int region_id, int* level, int* queue, int& queue_size, int& num_levels)
+    {
+      num_levels = level_structure(root, adj_start, adj, region, region_id, level, queue, queue_size);
+      while (true)
+      {
+        // The vertex of the minimal degree in the last level.
+        int candidate = -1;
+        for (int i = queue_size - 1; i >= 0 && level[queue[i]] == num_levels - 1; i--)
+          if(candidate == -1 || DegreeCompare(adj_start)(queue[i], candidate))
+            candidate = queue[i];
+
+        for (int i = 0; i < queue_size; i++)
+          level[queue[i]] = -1;
+        int candidate_levels = level_structure(candidate, adj_start, adj, region, region_id, level, queue, queue_size);
+        if(candidate_levels <= num_levels)
+        {
+          num_levels = candidate_levels;
+          return candidate;
+        }
+        root = candidate;
+        num_levels = candidate_levels;
+      }
+    }
+
+    void DofOrdering::reverse_cuthill_mckee(int n, const int* adj_start, const int* adj, int* order)
+    {
+      int* level = new int[n];
+      int* queue = new int[n];
+      int* region = new int[n];
+      bool* numbered = new bool[n];
+      for (int i = 0; i < n; i++)
+      {
+        level[i] = -1;
+        region[i] = 0;
+        numbered[i] = false;
+      }
+
+      int count = 0;
+      std::vector<int> neighbors;
+      for (int v = 0; v < n; v++)
+      {
+        if(numbered[v])
+          continue;
+
+        int queue_size, num_levels;
+        int root = pseudo_peripheral_vertex(v, adj_start, adj, region, 0, level, queue, queue_size, num_levels);
+        for (int i = 0; i < queue_size; i++)
+          level[queue[i]] = -1;
+
+        // Cuthill-McKee: breadth-first search, the neighbors of every vertex by increasing degree.
+        int first = count;
+        order[count++] = root;
+        numbered[root] = true;
+        for (int i = first; i < count; i++)
+        {
+          int u = order[i];
+          neighbors.clear();
+          for (int j = adj_start[u]; j < adj_start[u + 1]; j++)
+            if(!numbered[adj[j]])
+            {
+              numbered[adj[j]] = true;
+              neighbors.push_back(adj[j]);
+            }
+          std::sort(neighbors.begin(), neighbors.end(), DegreeCompare(adj_start));
+          for (unsigned int j = 0; j < neighbors.size(); j++)
+            order[count++] = neighbors[j];
+        }
+      }
+
+      std::reverse(order, order + n);
+
+      delete [] level;
+      delete [] queue;
+      delete [] region;
+      delete [] numbered;
+    }
+
+    void DofOrdering::nested_dissection(int n, const int* adj_start, const int* adj, int* order)
+    {
+      int* level = new int[n];
+      // The components of the sides of a separator are searched behind the part itself.
+      int* queue = new int[2 * n];
+      int* region = new int[n];
+      for (int i = 0; i < n; i++)
+      {
+        level[i] = -1;
+        region[i] = 0;
+      }
+
+      // Parts still to be ordered. The order is filled from the end, every separator is numbered
+      // before the parts it separates are split further.
+      std::vector<DissectionPart> parts;
+      int next_region = 1;
+      int count = n;
+
+      // The connected components form the initial parts.
+      for (int v = 0; v < n; v++)
+      {
+        if(region[v] != 0)
+          continue;
+        int queue_size;
+        level_structure(v, adj_start, adj, region, 0, level, queue, queue_size);
+        for (int i = 0; i < queue_size; i++)
+        {
+          level[queue[i]] = -1;
+          region[queue[i]] = next_region;
+        }
+        DissectionPart part = { next_region++, v };
+        parts.push_back(part);
+      }
+
+      while (!parts.empty())
+      {
+        DissectionPart part = parts.back();
+        parts.pop_back();
+
+        // Only the level structure from the peripheral vertex is needed, it is left in level and queue.
+        int queue_size, num_levels;
+        pseudo_peripheral_vertex(part.vertex, adj_start, adj, region, part.region_id, level, queue, queue_size, num_levels);
+
+        if(queue_size <= H2D_DISSECTION_MIN_SIZE || num_levels < 3)
+        {
+          // Small enough, numbered in the reverse order of the level structure from a peripheral vertex.
+          for (int i = 0; i < queue_size; i++)
+          {
+            order[--count] = queue[i];
+            level[queue[i]] = -1;
+            region[queue[i]] = -1;
+          }
+          continue;
+        }
+
+        // The middle level is the separator, the levels before and after it are the two new parts.
+        int separator_level = num_levels / 2;
+        int region_a = next_region++, region_b = next_region++;
+        int vertex_a = -1, vertex_b = -1;
+        for (int i = 0; i < queue_size; i++)
+        {
+          int v = queue[i];
+          if(level[v] < separator_level)
+          {
+            region[v] = region_a;
+            vertex_a = v;
+          }
+          else if(level[v] > separator_level)
+          {
+            region[v] = region_b;
+            vertex_b = v;
+          }
+          else
+          {
+            region[v] = -1;
+            order[--count] = v;
+          }
+        }
+        for (int i = 0; i < queue_size; i++)
+          level[queue[i]] = -1;
+
+        // The vertices of each side need not be connected, every component becomes a part of its own.
+        int sides[2] = { region_a, region_b };
+        int side_vertices[2] = { vertex_a, vertex_b };
+        for (int side = 0; side < 2; side++)
+        {
+          if(side_vertices[side] == -1)
+            continue;
+          for (int i = 0; i < queue_size; i++)
+          {
+            int v = queue[i];
+            if(region[v] != sides[side])
+              continue;
+            int component_size;
+            level_structure(v, adj_start, adj, region, sides[side], level, queue + queue_size, component_size);
+            int component_region = next_region++;
+            for (int j = 0; j < component_size; j++)
+            {
+              level[queue[queue_size + j]] = -1;
+              region[queue[queue_size + j]] = component_region;
+            }
+            DissectionPart new_part = { component_region, v };
+            parts.push_back(new_part);
+          }
+        }
+      }
+
+      delete [] level;
+      delete [] queue;
+      delete [] region;
+    }
+  }
+}
@@ -23,6 +23,8 @@
 #include "space_hdiv.h"
 #include "space_h2d_xml.h"
 #include "api2d.h"
+#include "dof_ordering.h"
+#include "binary_file.h"
 #include <iostream>
 
 namespace Hermes
@@ -37,7 +39,6 @@ namespace Hermes
 			this->default_tri_order = -1;
 			this->default_quad_order = -1;
 			this->ndata = NULL;
-			this->edata = NULL;
 			this->nsize = esize = 0;
 			this->ndata_allocated = 0;
 			this->mesh_seq = -1;
@@ -47,12 +48,21 @@ namespace Hermes
       this->proj_mat = NULL;
       this->chol_p = NULL;
       this->vertex_functions_count = this->edge_functions_count = this->bubble_functions_count = 0;
+      this->dof_permutation = NULL;
+      this->dof_snapshot.elem_start = this->dof_snapshot.elem_data = this->dof_snapshot.shape_inxs = this->dof_snapshot.dofs = NULL;
+      this->dof_snapshot.elem_coords = NULL;
+      this->dof_snapshot.num_elems = this->dof_snapshot.ndof = 0;
+      this->dof_ordering = HERMES_DOF_ORDERING_ELEMENTS;
+      this->constrained_als.num_elems = 0;
+      this->constrained_als.start = this->constrained_als.idx = this->constrained_als.dof = NULL;
+      this->constrained_als.coef = NULL;
+      this->constrained_als.shape_pos = this->constrained_als.dof_pos = NULL;
 
 			if(essential_bcs != NULL)
 				for(Hermes::vector<EssentialBoundaryCondition<double>*>::const_iterator it = essential_bcs->begin(); it != essential_bcs->end(); it++)
 					for(unsigned int i = 0; i < (*it)->markers.size(); i++)
 					{
-						if(mesh->boundary_markers_conversion.conversion_table_inverse.find((*it)->markers.at(i)) == mesh->boundary_markers_conversion.conversion_table_inverse.end() && (*it)->markers.at(i) != HERMES_ANY)
+						if(mesh->boundary_markers_conversion.tables->conversion_table_inverse.find((*it)->markers.at(i)) == mesh->boundary_markers_conversion.tables->conversion_table_inverse.end() && (*it)->markers.at(i) != HERMES_ANY)
 							throw Hermes::Exceptions::Exception("A boundary condition defined on a non-existent marker %s.", (*it)->markers.at(i).c_str());
 					}
 
@@ -65,7 +75,6 @@ namespace Hermes
 			this->default_tri_order = -1;
 			this->default_quad_order = -1;
 			this->ndata = NULL;
-			this->edata = NULL;
 			this->nsize = esize = 0;
 			this->ndata_allocated = 0;
 			this->mesh_seq = -1;
@@ -75,12 +84,21 @@ namespace Hermes
       this->proj_mat = NULL;
       this->chol_p = NULL;
       this->vertex_functions_count = this->edge_functions_count = this->bubble_functions_count = 0;
+      this->dof_permutation = NULL;
+      this->dof_snapshot.elem_start = this->dof_snapshot.elem_data = this->dof_snapshot.shape_inxs = this->dof_snapshot.dofs = NULL;
+      this->dof_snapshot.elem_coords = NULL;
+      this->dof_snapshot.num_elems = this->dof_snapshot.ndof = 0;
+      this->dof_ordering = HERMES_DOF_ORDERING_ELEMENTS;
+      this->constrained_als.num_elems = 0;
+      this->constrained_als.start = this->constrained_als.idx = this->constrained_als.dof = NULL;
+      this->constrained_als.coef = NULL;
+      this->constrained_als.shape_pos = this->constrained_als.dof_pos = NULL;
 
 			if(essential_bcs != NULL)
 				for(Hermes::vector<EssentialBoundaryCondition<std::complex<double> >*>::const_iterator it = essential_bcs->begin(); it != essential_bcs->end(); it++)
 					for(unsigned int i = 0; i < (*it)->markers.size(); i++)
 					{
-						if(mesh->boundary_markers_conversion.conversion_table_inverse.find((*it)->markers.at(i)) == mesh->boundary_markers_conversion.conversion_table_inverse.end() && (*it)->markers.at(i) != HERMES_ANY)
+						if(mesh->boundary_markers_conversion.tables->conversion_table_inverse.find((*it)->markers.at(i)) == mesh->boundary_markers_conversion.tables->conversion_table_inverse.end() && (*it)->markers.at(i) != HERMES_ANY)
 							throw Hermes::Exceptions::Exception("A boundary condition defined on a non-existent marker %s.", (*it)->markers.at(i).c_str());
 					}
 
@@ -91,8 +109,10 @@ namespace Hermes
 		void Space<double>::free()
 		{
 			free_bc_data();
+			free_dof_permutation();
+			free_constrained_assembly_lists();
 			if(nsize) { ::free(ndata); nsize = 0; ndata = NULL; }
-			if(esize) { ::free(edata); edata = 0; edata = NULL; }
+			if(esize) { edata.free(); esize = 0; }
 			this->seq = -1;
 		}
 
@@ -100,8 +120,10 @@ namespace Hermes
 		void Space<std::complex<double> >::free()
 		{
 			free_bc_data();
+			free_dof_permutation();
+			free_constrained_assembly_lists();
 			if(nsize) { ::free(ndata); nsize = 0; ndata = NULL; }
-			if(esize) { ::free(edata); edata = 0; edata = NULL; }
+			if(esize) { edata.free(); esize = 0; }
 			this->seq = -1;
 		}
 
@@ -138,7 +160,7 @@ namespace Hermes
     template<typename Scalar>
     bool Space<Scalar>::isOkay() const
     {
-      if(ndata == NULL || edata == NULL || !nsize || !esize)
+      if(ndata == NULL || !edata.is_allocated() || !nsize || !esize)
         return false;
       if(seq < 0)
         return false;
@@ -147,7 +169,7 @@ namespace Hermes
 
       this->mesh->check();
 
-      if(edata == NULL)
+      if(!edata.is_allocated())
       {
           throw Hermes::Exceptions::Exception("NULL edata detected in Space<Scalar>::get_element_order().");
           return false;
@@ -218,19 +240,40 @@ namespace Hermes
         }
       }
 
-      if((esize < mesh->get_max_element_id()) || (edata == NULL))
+      if((esize < mesh->get_max_element_id()) || !edata.is_allocated())
+        esize = edata.grow(mesh->get_max_element_id());
+    }
+
+    template<typename Scalar>
+    int Space<Scalar>::ElementDataTable::grow(int size)
+    {
+      int needed_chunks = std::max(1, (size + chunk_size - 1) / chunk_size);
+      if(needed_chunks > allocated_chunks)
+      {
+        // Only the table of the chunks is reallocated, geometrically.
+        int new_allocated_chunks = std::max(16, allocated_chunks);
+        while (new_allocated_chunks < needed_chunks)
+          new_allocated_chunks *= 2;
+        chunks = (ElementData**)realloc(chunks, new_allocated_chunks * sizeof(ElementData*));
+        allocated_chunks = new_allocated_chunks;
+      }
+      for (; num_chunks < needed_chunks; num_chunks++)
       {
-        int oldsize = esize;
-        if(!esize)
-          esize = 1024;
-        while (esize < mesh->get_max_element_id())
-          esize = esize * 3 / 2;
-        edata = (ElementData*) realloc(edata, sizeof(ElementData) * esize);
-        for (int i = oldsize; i < esize; i++)
-          edata[i].order = -1;
-        for (int i = oldsize; i < esize; i++)
-          edata[i].changed_in_last_adaptation = true;
+        chunks[num_chunks] = new ElementData[chunk_size];
+        for (int i = 0; i < chunk_size; i++)
+          chunks[num_chunks][i].order = -1;
       }
+      return num_chunks * chunk_size;
+    }
+
+    template<typename Scalar>
+    void Space<Scalar>::ElementDataTable::free()
+    {
+      for (int i = 0; i < num_chunks; i++)
+        delete [] chunks[i];
+      ::free(chunks);
+      chunks = NULL;
+      num_chunks = allocated_chunks = 0;
     }
 
     template<typename Scalar>
@@ -242,6 +285,7 @@ namespace Hermes
 
       this->essential_bcs = space->essential_bcs;
       this->shapeset = space->shapeset->clone();
+      this->dof_ordering = space->dof_ordering;
 
       new_mesh->copy(space->get_mesh());
       this->mesh = new_mesh;
@@ -322,26 +366,36 @@ namespace Hermes
         order = H2D_MAKE_QUAD_ORDER(order, order);
 
       edata[id].order = order;
+      // Spaces are set concurrently by Adapt::apply_refinements().
+#pragma omp critical (g_space_seq)
       seq = g_space_seq++;
     }
 
     template<typename Scalar>
     void Space<Scalar>::update_essential_bc_values(Hermes::vector<Space<Scalar>*> spaces, double time)
     {
+      // The EssentialBCs may be shared by spaces used in different threads (see Parareal),
+      // the time and the values computed with it have to be set together.
       int n = spaces.size();
       for (int i = 0; i < n; i++)
       {
-        if(spaces[i]->get_essential_bcs() != NULL)
-          spaces[i]->get_essential_bcs()->set_current_time(time);
-        spaces[i]->update_essential_bc_values();
+#pragma omp critical(Space_essential_bc_values)
+        {
+          if(spaces[i]->get_essential_bcs() != NULL)
+            spaces[i]->get_essential_bcs()->set_current_time(time);
+          spaces[i]->update_essential_bc_values();
+        }
       }
     }
 
     template<typename Scalar>
     void Space<Scalar>::update_essential_bc_values(Space<Scalar>*s, double time)
     {
-      s->get_essential_bcs()->set_current_time(time);
-      s->update_essential_bc_values();
+#pragma omp critical(Space_essential_bc_values)
+      {
+        s->get_essential_bcs()->set_current_time(time);
+        s->update_essential_bc_values();
+      }
     }
 
     template<typename Scalar>
@@ -387,6 +441,128 @@ namespace Hermes
       return ndof;
     }
 
+    template<typename Scalar>
+    int Space<Scalar>::assign_dofs_interleaved(Hermes::vector<Space<Scalar>*> spaces)
+    {
+      int n = spaces.size();
+
+      int ndof = 0;
+      for (int i = 0; i < n; i++)
+      {
+        int space_ndof = spaces[i]->assign_dofs(0, n);
+        if(i > 0 && space_ndof != ndof / i)
+        {
+          for (int j = 0; j <= i; j++)
+            spaces[j]->assign_dofs();
+          throw Hermes::Exceptions::Exception("The DOFs of spaces with different numbers of DOFs (%d and %d) can not be interleaved.",
+            ndof / i, space_ndof);
+        }
+        ndof += space_ndof;
+      }
+
+      return ndof;
+    }
+
+    template<typename Scalar>
+    int Space<Scalar>::get_dof_offset(Hermes::vector<const Space<Scalar>*> spaces, unsigned int i)
+    {
+      bool interleaved = spaces.size() > 1;
+      for (unsigned int j = 0; j < spaces.size() && interleaved; j++)
+        interleaved = spaces[j]->stride == (int)spaces.size() && spaces[j]->first_dof == 0;
+      if(interleaved)
+        return i;
+
+      int offset = 0;
+      for (unsigned int j = 0; j < i; j++)
+        offset += spaces[j]->get_num_dofs();
+      return offset;
+    }
+
+    template<typename Scalar>
+    int Space<Scalar>::get_dof_offset(Hermes::vector<Space<Scalar>*> spaces, unsigned int i)
+    {
+      Hermes::vector<const Space<Scalar>*> const_spaces;
+      for (unsigned int j = 0; j < spaces.size(); j++)
+        const_spaces.push_back(spaces[j]);
+      return get_dof_offset(const_spaces, i);
+    }
+
+    template<typename Scalar>
+    int Space<Scalar>::get_stride() const
+    {
+      return this->stride;
+    }
+
+    template<typename Scalar>
+    uint64_t Space<Scalar>::get_version() const
+    {
+      this->check();
+      // FNV-1a over the words, mixed, as Mesh::get_version().
+      uint64_t hash = this->mesh->get_version();
+      uint64_t words[4] = { (uint64_t)this->get_type(), (uint64_t)this->shapeset->get_id(), (uint64_t)this->ndof, (uint64_t)this->stride };
+      for(int i = 0; i < 4; i++)
+      {
+        hash = (hash ^ words[i]) * 1099511628211ULL;
+        hash ^= hash >> 29;
+      }
+
+      AsmList<Scalar> al;
+      Element* e;
+      for_all_active_elements(e, this->mesh)
+      {
+        hash = (hash ^ (uint64_t)(int64_t)this->get_element_order(e->id)) * 1099511628211ULL;
+        hash ^= hash >> 29;
+        get_element_assembly_list(e, &al);
+        for(unsigned int i = 0; i < al.cnt; i++)
+        {
+          hash = (hash ^ (((uint64_t)(uint32_t)al.idx[i] << 32) | (uint32_t)al.dof[i])) * 1099511628211ULL;
+          hash ^= hash >> 29;
+        }
+      }
+      return hash;
+    }
+
+    template<typename Scalar>
+    void Space<Scalar>::get_dof_orders(int* dof_orders, int offset) const
+    {
+      for (int i = 0; i < this->get_num_dofs(); i++)
+        dof_orders[first_dof + i * stride + offset] = 0;
+
+      AsmList<Scalar> al;
+      Element* e;
+      for_all_active_elements(e, this->mesh)
+      {
+        get_element_assembly_list(e, &al);
+        for (unsigned int i = 0; i < al.cnt; i++)
+        {
+          if(al.dof[i] < 0)
+            continue;
+          int order = shapeset->get_order(al.idx[i], e->get_mode());
+          order = std::max(H2D_GET_H_ORDER(order), H2D_GET_V_ORDER(order));
+          if(order > dof_orders[al.dof[i] + offset])
+            dof_orders[al.dof[i] + offset] = order;
+        }
+      }
+    }
+
+    template<typename Scalar>
+    int* Space<Scalar>::get_dof_orders(Hermes::vector<const Space<Scalar>*> spaces)
+    {
+      int* dof_orders = new int[get_num_dofs(spaces)];
+      for (unsigned int i = 0; i < spaces.size(); i++)
+        spaces[i]->get_dof_orders(dof_orders, get_dof_offset(spaces, i));
+      return dof_orders;
+    }
+
+    template<typename Scalar>
+    int* Space<Scalar>::get_dof_orders(Hermes::vector<Space<Scalar>*> spaces)
+    {
+      Hermes::vector<const Space<Scalar>*> const_spaces;
+      for (unsigned int j = 0; j < spaces.size(); j++)
+        const_spaces.push_back(spaces[j]);
+      return get_dof_orders(const_spaces);
+    }
+
     template<typename Scalar>
     int Space<Scalar>::get_element_order(int id) const
     {
@@ -399,6 +575,22 @@ namespace Hermes
       return edata[id].order;
     }
 
+    template<typename Scalar>
+    void Space<Scalar>::get_element_weights(double* weights) const
+    {
+      Element* e;
+      for_all_active_elements(e, this->mesh)
+      {
+        int order = edata[e->id].order;
+        double num_functions;
+        if(e->is_triangle())
+          num_functions = (order + 1) * (order + 2) / 2;
+        else
+          num_functions = (H2D_GET_H_ORDER(order) + 1) * (H2D_GET_V_ORDER(order) + 1);
+        weights[e->id] += num_functions * num_functions;
+      }
+    }
+
     template<typename Scalar>
     void Space<Scalar>::set_uniform_order(int order, std::string marker)
     {
@@ -505,6 +697,28 @@ namespace Hermes
       }
     }
 
+    template<typename Scalar>
+    void Space<Scalar>::update_element_orders_after_refinement(const Hermes::vector<int>& refined_ids)
+    {
+      Hermes::vector<Element*> stack;
+      for (unsigned int i = 0; i < refined_ids.size(); i++)
+        stack.push_back(this->mesh->get_element(refined_ids[i]));
+      while (!stack.empty())
+      {
+        Element* e = stack.back();
+        stack.pop_back();
+        if(e->active)
+        {
+          if(this->get_element_order(e->id) < 0)
+            this->set_element_order_internal(e->id, this->get_element_order(e->parent->id));
+          continue;
+        }
+        for (unsigned int son = 0; son < H2D_MAX_ELEMENT_SONS; son++)
+          if(e->sons[son] != NULL)
+            stack.push_back(e->sons[son]);
+      }
+    }
+
     template<typename Scalar>
     void Space<Scalar>::unrefine_all_mesh_elements(bool keep_initial_refinements)
     {
@@ -743,6 +957,7 @@ namespace Hermes
     void Space<Scalar>::ReferenceSpaceCreator::finish_construction(Space<Scalar>* ref_space)
     {
       ref_space->seq = g_space_seq++;
+      ref_space->dof_ordering = this->coarse_space->dof_ordering;
 
       Element *e;
       for_all_active_elements(e, coarse_space->get_mesh())
@@ -856,25 +1071,24 @@ namespace Hermes
     template<typename Scalar>
     void Space<Scalar>::distribute_orders(Mesh* mesh, int* parents)
     {
-      int num = mesh->get_max_element_id();
-      int* orders = new int[num + 1];
+      // Only the elements created by the regularization (with a parent other than themselves) get orders,
+      // the parents are not active any more, so their orders stay as they were.
       Element* e;
       for_all_active_elements(e, mesh)
       {
+        if(parents[e->id] == e->id)
+          continue;
         int p = get_element_order(parents[e->id]);
         if(e->is_triangle() && (H2D_GET_V_ORDER(p) != 0))
           p = std::max(H2D_GET_H_ORDER(p), H2D_GET_V_ORDER(p));
-        orders[e->id] = p;
+        set_element_order_internal(e->id, p);
       }
-      for_all_active_elements(e, mesh)
-        set_element_order_internal(e->id, orders[e->id]);
-      delete [] orders;
     }
 
     template<typename Scalar>
     int Space<Scalar>::assign_dofs(int first_dof, int stride)
     {
-      if(ndata == NULL || edata == NULL || !nsize || !esize)
+      if(ndata == NULL || !edata.is_allocated() || !nsize || !esize)
         return false;
       if(seq < 0)
         return false;
@@ -883,7 +1097,7 @@ namespace Hermes
 
       this->mesh->check();
 
-      if(edata == NULL)
+      if(!edata.is_allocated())
       {
           throw Hermes::Exceptions::Exception("NULL edata detected in Space<Scalar>::get_element_order().");
           return false;
@@ -915,10 +1129,12 @@ namespace Hermes
       this->first_dof = next_dof = first_dof;
       this->stride = stride;
 
+      free_constrained_assembly_lists();
       reset_dof_assignment();
       assign_vertex_dofs();
       assign_edge_dofs();
       assign_bubble_dofs();
+      reorder_dofs();
 
       free_bc_data();
       update_essential_bc_values();
@@ -929,10 +1145,311 @@ namespace Hermes
       was_assigned = this->seq;
       this->ndof = (next_dof - first_dof) / stride;
 
+      update_dof_permutation();
+      update_constrained_assembly_lists();
+
       return this->ndof;
       check();
     }
 
+    template<typename Scalar>
+    void Space<Scalar>::set_dof_ordering(DofOrderingType dof_ordering)
+    {
+      this->dof_ordering = dof_ordering;
+    }
+
+    template<typename Scalar>
+    DofOrderingType Space<Scalar>::get_dof_ordering() const
+    {
+      return this->dof_ordering;
+    }
+
+    template<typename Scalar>
+    void Space<Scalar>::reorder_dofs()
+    {
+      if(this->dof_ordering == HERMES_DOF_ORDERING_ELEMENTS)
+        return;
+
+      // The units of the ordering are the nodes and the bubbles with assigned functions.
+      int max_node_id = this->mesh->get_max_node_id();
+      int max_elem_id = this->mesh->get_max_element_id();
+      int* node_unit = new int[max_node_id];
+      int* elem_unit = new int[max_elem_id];
+      Hermes::vector<int*> unit_dofs;
+      Hermes::vector<int> unit_sizes;
+
+      Node* node;
+      for (int i = 0; i < max_node_id; i++)
+        node_unit[i] = -1;
+      for_all_nodes(node, this->mesh)
+      {
+        NodeData* nd = this->ndata + node->id;
+        if(node->id < this->nsize && nd->dof >= this->first_dof && nd->n > 0
+          && !(node->type == HERMES_TYPE_VERTEX && node->is_constrained_vertex()))
+        {
+          node_unit[node->id] = unit_dofs.size();
+          unit_dofs.push_back(&nd->dof);
+          unit_sizes.push_back(nd->n);
+        }
+      }
+
+      Element* e;
+      for (int i = 0; i < max_elem_id; i++)
+        elem_unit[i] = -1;
+      for_all_active_elements(e, this->mesh)
+      {
+        ElementData* ed = &this->edata[e->id];
+        // H1Space leaves the bubble data of elements of order zero from the previous assignment.
+        if(ed->order == 0 && this->get_type() == HERMES_H1_SPACE)
+          continue;
+        if(ed->n > 0 && ed->bdof >= this->first_dof)
+        {
+          elem_unit[e->id] = unit_dofs.size();
+          unit_dofs.push_back(&ed->bdof);
+          unit_sizes.push_back(ed->n);
+        }
+      }
+
+      int num_units = unit_dofs.size();
+      if(num_units < 2)
+      {
+        delete [] node_unit;
+        delete [] elem_unit;
+        return;
+      }
+
+      // Two units are neighbors if they belong to the same element.
+      Hermes::vector<int> element_units;
+      Hermes::vector<std::pair<int, int> > pairs;
+      for_all_active_elements(e, this->mesh)
+      {
+        element_units.clear();
+        for (unsigned int i = 0; i < e->get_nvert(); i++)
+        {
+          if(node_unit[e->vn[i]->id] >= 0)
+            element_units.push_back(node_unit[e->vn[i]->id]);
+          if(node_unit[e->en[i]->id] >= 0)
+            element_units.push_back(node_unit[e->en[i]->id]);
+        }
+        if(elem_unit[e->id] >= 0)
+          element_units.push_back(elem_unit[e->id]);
+        for (unsigned int i = 0; i < element_units.size(); i++)
+          for (unsigned int j = 0; j < element_units.size(); j++)
+            if(i != j)
+              pairs.push_back(std::pair<int, int>(element_units[i], element_units[j]));
+      }
+      std::sort(pairs.begin(), pairs.end());
+      pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+      int* adj_start = new int[num_units + 1];
+      int* adj = new int[std::max((int)pairs.size(), 1)];
+      memset(adj_start, 0, (num_units + 1) * sizeof(int));
+      for (unsigned int i = 0; i < pairs.size(); i++)
+      {
+        adj_start[pairs[i].first + 1]++;
+        adj[i] = pairs[i].second;
+      }
+      for (int i = 0; i < num_units; i++)
+        adj_start[i + 1] += adj_start[i];
+
+      int* order = new int[num_units];
+      if(this->dof_ordering == HERMES_DOF_ORDERING_RCM)
+        DofOrdering::reverse_cuthill_mckee(num_units, adj_start, adj, order);
+      else
+        DofOrdering::nested_dissection(num_units, adj_start, adj, order);
+
+      int dof = this->first_dof;
+      for (int i = 0; i < num_units; i++)
+      {
+        *unit_dofs[order[i]] = dof;
+        dof += unit_sizes[order[i]] * this->stride;
+      }
+
+      delete [] order;
+      delete [] adj;
+      delete [] adj_start;
+      delete [] node_unit;
+      delete [] elem_unit;
+    }
+
+    template<typename Scalar>
+    const int* Space<Scalar>::get_dof_permutation() const
+    {
+      return this->dof_permutation;
+    }
+
+    template<typename Scalar>
+    int Space<Scalar>::remap_coefficient_vector(const Scalar* previous_coeff_vec, Scalar* coeff_vec) const
+    {
+      if(this->dof_permutation == NULL)
+        return -1;
+
+      int unmapped = 0;
+      for(int i = 0; i < this->ndof; i++)
+      {
+        if(this->dof_permutation[i] >= 0)
+          coeff_vec[i] = previous_coeff_vec[this->dof_permutation[i]];
+        else
+        {
+          coeff_vec[i] = 0.0;
+          unmapped++;
+        }
+      }
+      return unmapped;
+    }
+
+    template<typename Scalar>
+    void Space<Scalar>::free_dof_permutation()
+    {
+      delete [] this->dof_permutation;
+      delete [] this->dof_snapshot.elem_start;
+      delete [] this->dof_snapshot.elem_data;
+      delete [] this->dof_snapshot.elem_coords;
+      delete [] this->dof_snapshot.shape_inxs;
+      delete [] this->dof_snapshot.dofs;
+      this->dof_permutation = NULL;
+      this->dof_snapshot.elem_start = this->dof_snapshot.elem_data = this->dof_snapshot.shape_inxs = this->dof_snapshot.dofs = NULL;
+      this->dof_snapshot.elem_coords = NULL;
+      this->dof_snapshot.num_elems = this->dof_snapshot.ndof = 0;
+    }
+
+    template<typename Scalar>
+    void Space<Scalar>::update_dof_permutation()
+    {
+      delete [] this->dof_permutation;
+      this->dof_permutation = NULL;
+
+      AsmList<Scalar> al;
+      Element* e;
+      DofSnapshot& old = this->dof_snapshot;
+
+      // An element keeps its basis functions if it is active in both assignments with the same order and vertices.
+      // A DOF is mapped if all the elements of its support kept their functions.
+      if(old.elem_start != NULL)
+      {
+        bool* elem_unchanged = new bool[old.num_elems];
+        memset(elem_unchanged, 0, old.num_elems * sizeof(bool));
+        for_all_active_elements(e, this->mesh)
+        {
+          if(e->id >= old.num_elems || old.elem_start[e->id] == old.elem_start[e->id + 1])
+            continue;
+          int* data = old.elem_data + 6 * e->id;
+          double* coords = old.elem_coords + 8 * e->id;
+          bool same = (data[0] == this->edata[e->id].order && data[1] == (int)e->get_nvert());
+          for(unsigned int i = 0; i < e->get_nvert() && same; i++)
+            same = (data[2 + i] == e->vn[i]->id && coords[2 * i] == e->vn[i]->x && coords[2 * i + 1] == e->vn[i]->y);
+          elem_unchanged[e->id] = same;
+        }
+
+        // The previous DOFs of the changed elements and of the constrained functions cannot be mapped.
+        bool* old_dof_invalid = new bool[std::max(old.ndof, 1)];
+        memset(old_dof_invalid, 0, std::max(old.ndof, 1) * sizeof(bool));
+        for(int id = 0; id < old.num_elems; id++)
+          for(int k = old.elem_start[id]; k < old.elem_start[id + 1]; k++)
+            if(!elem_unchanged[id] || old.shape_inxs[k] < 0)
+              old_dof_invalid[old.dofs[k]] = true;
+
+        this->dof_permutation = new int[std::max(this->ndof, 1)];
+        for(int i = 0; i < this->ndof; i++)
+          this->dof_permutation[i] = H2D_UNASSIGNED_DOF;
+
+        for_all_active_elements(e, this->mesh)
+        {
+          this->get_element_assembly_list(e, &al);
+          bool unchanged = e->id < old.num_elems && elem_unchanged[e->id];
+          int old_start = unchanged ? old.elem_start[e->id] : 0;
+          int old_count = unchanged ? old.elem_start[e->id + 1] - old_start : 0;
+          for(unsigned int k = 0; k < al.cnt; k++)
+          {
+            if(al.dof[k] < 0)
+              continue;
+            int dof = (al.dof[k] - this->first_dof) / this->stride;
+
+            // The entries of an unchanged element are usually in the same order as before.
+            int old_dof = -1;
+            if(unchanged && al.coef[k] == (Scalar)1.0)
+            {
+              if((int)k < old_count && old.shape_inxs[old_start + k] == al.idx[k])
+                old_dof = old.dofs[old_start + k];
+              else
+                for(int l = 0; l < old_count; l++)
+                  if(old.shape_inxs[old_start + l] == al.idx[k])
+                    old_dof = old.dofs[old_start + l];
+              if(old_dof >= 0 && old_dof_invalid[old_dof])
+                old_dof = -1;
+            }
+
+            if(old_dof < 0)
+              this->dof_permutation[dof] = -1;
+            else if(this->dof_permutation[dof] == H2D_UNASSIGNED_DOF)
+              this->dof_permutation[dof] = old_dof;
+            else if(this->dof_permutation[dof] != old_dof)
+              this->dof_permutation[dof] = -1;
+          }
+        }
+
+        for(int i = 0; i < this->ndof; i++)
+          if(this->dof_permutation[i] == H2D_UNASSIGNED_DOF)
+            this->dof_permutation[i] = -1;
+
+        delete [] elem_unchanged;
+        delete [] old_dof_invalid;
+      }
+
+      // Snapshot of this assignment for the next one.
+      delete [] old.elem_start;
+      delete [] old.elem_data;
+      delete [] old.elem_coords;
+      delete [] old.shape_inxs;
+      delete [] old.dofs;
+
+      old.num_elems = this->mesh->get_max_element_id();
+      old.ndof = this->ndof;
+      old.elem_start = new int[old.num_elems + 1];
+      old.elem_data = new int[6 * std::max(old.num_elems, 1)];
+      old.elem_coords = new double[8 * std::max(old.num_elems, 1)];
+      memset(old.elem_start, 0, (old.num_elems + 1) * sizeof(int));
+
+      int num_entries = 0;
+      for_all_active_elements(e, this->mesh)
+      {
+        this->get_element_assembly_list(e, &al);
+        for(unsigned int k = 0; k < al.cnt; k++)
+          if(al.dof[k] >= 0)
+            old.elem_start[e->id + 1]++;
+        num_entries += old.elem_start[e->id + 1];
+      }
+      for(int id = 0; id < old.num_elems; id++)
+        old.elem_start[id + 1] += old.elem_start[id];
+
+      old.shape_inxs = new int[std::max(num_entries, 1)];
+      old.dofs = new int[std::max(num_entries, 1)];
+      for_all_active_elements(e, this->mesh)
+      {
+        int* data = old.elem_data + 6 * e->id;
+        double* coords = old.elem_coords + 8 * e->id;
+        data[0] = this->edata[e->id].order;
+        data[1] = e->get_nvert();
+        for(unsigned int i = 0; i < e->get_nvert(); i++)
+        {
+          data[2 + i] = e->vn[i]->id;
+          coords[2 * i] = e->vn[i]->x;
+          coords[2 * i + 1] = e->vn[i]->y;
+        }
+
+        this->get_element_assembly_list(e, &al);
+        int entry = old.elem_start[e->id];
+        for(unsigned int k = 0; k < al.cnt; k++)
+        {
+          if(al.dof[k] < 0)
+            continue;
+          old.shape_inxs[entry] = (al.coef[k] == (Scalar)1.0) ? al.idx[k] : -1;
+          old.dofs[entry] = (al.dof[k] - this->first_dof) / this->stride;
+          entry++;
+        }
+      }
+    }
+
     template<typename Scalar>
     void Space<Scalar>::reset_dof_assignment()
     {
@@ -994,6 +1511,32 @@ namespace Hermes
         throw Hermes::Exceptions::Exception("The space in get_element_assembly_list() is out of date. You need to update it with assign_dofs()"
         " any time the mesh changes.");
 
+      // The constraints of the elements with hanging nodes are already expanded.
+      if(e->id < constrained_als.num_elems && constrained_als.start[e->id] < constrained_als.start[e->id + 1])
+      {
+        al->cnt = 0;
+        for (int i = constrained_als.start[e->id]; i < constrained_als.start[e->id + 1]; i++)
+          al->add_triplet(constrained_als.idx[i], constrained_als.dof[i] >= 0 ? constrained_als.dof[i] + first_dof : constrained_als.dof[i], constrained_als.coef[i]);
+
+        // The constraint operator, the distinct shape functions and DOFs come in the order of their first occurrence.
+        al->enlarge_operator(al->cnt);
+        int* shape_pos = constrained_als.shape_pos + constrained_als.start[e->id];
+        int* dof_pos = constrained_als.dof_pos + constrained_als.start[e->id];
+        unsigned int num_shapes = 0, num_reduced_dofs = 0;
+        for(unsigned int i = 0; i < al->cnt; i++)
+        {
+          al->shape_pos[i] = shape_pos[i];
+          al->dof_pos[i] = dof_pos[i];
+          if(shape_pos[i] == (int)num_shapes)
+            al->shape_entry[num_shapes++] = i;
+          if(dof_pos[i] == (int)num_reduced_dofs)
+            al->reduced_dof[num_reduced_dofs++] = al->dof[i];
+        }
+        al->num_shapes = num_shapes;
+        al->num_reduced_dofs = num_reduced_dofs;
+        return;
+      }
+
       // add vertex, edge and bubble functions to the assembly list
       al->cnt = 0;
       for (unsigned int i = 0; i < e->get_nvert(); i++)
@@ -1126,6 +1669,83 @@ namespace Hermes
           }
         }
       }
+
+      // The stored assembly lists contain the Dirichlet values as well.
+      if(this->constrained_als.start != NULL)
+        update_constrained_assembly_lists();
+    }
+
+    template<typename Scalar>
+    void Space<Scalar>::free_constrained_assembly_lists()
+    {
+      delete [] this->constrained_als.start;
+      delete [] this->constrained_als.idx;
+      delete [] this->constrained_als.dof;
+      delete [] this->constrained_als.coef;
+      delete [] this->constrained_als.shape_pos;
+      delete [] this->constrained_als.dof_pos;
+      this->constrained_als.start = this->constrained_als.idx = this->constrained_als.dof = NULL;
+      this->constrained_als.coef = NULL;
+      this->constrained_als.shape_pos = this->constrained_als.dof_pos = NULL;
+      this->constrained_als.num_elems = 0;
+    }
+
+    template<typename Scalar>
+    void Space<Scalar>::update_constrained_assembly_lists()
+    {
+      free_constrained_assembly_lists();
+
+      // The L2 spaces have no constraints.
+      if(this->get_type() == HERMES_L2_SPACE)
+        return;
+
+      int num_elems = this->mesh->get_max_element_id();
+      int* start = new int[num_elems + 1];
+      memset(start, 0, (num_elems + 1) * sizeof(int));
+      std::vector<int> idx, dof, shape_pos, dof_pos;
+      std::vector<Scalar> coef;
+
+      AsmList<Scalar> al;
+      Element* e;
+      for_all_active_elements(e, this->mesh)
+      {
+        bool hanging = false;
+        for (unsigned int i = 0; i < e->get_nvert() && !hanging; i++)
+          if(e->vn[i]->is_constrained_vertex() || (!e->en[i]->bnd && (e->en[i]->elem[0] == NULL || e->en[i]->elem[1] == NULL)))
+            hanging = true;
+        if(!hanging || e->id >= esize || edata[e->id].order < 0)
+          continue;
+
+        get_element_assembly_list(e, &al);
+        std::map<int, int> shapes, dofs;
+        for(unsigned int i = 0; i < al.cnt; i++)
+        {
+          idx.push_back(al.idx[i]);
+          dof.push_back(al.dof[i]);
+          coef.push_back(al.coef[i]);
+          shape_pos.push_back(shapes.insert(std::pair<int, int>(al.idx[i], (int)shapes.size())).first->second);
+          dof_pos.push_back(al.dof[i] < 0 ? -1 : dofs.insert(std::pair<int, int>(al.dof[i], (int)dofs.size())).first->second);
+        }
+        start[e->id + 1] = al.cnt;
+      }
+      for(int id = 0; id < num_elems; id++)
+        start[id + 1] += start[id];
+
+      this->constrained_als.start = start;
+      this->constrained_als.idx = new int[idx.size() + 1];
+      this->constrained_als.dof = new int[idx.size() + 1];
+      this->constrained_als.coef = new Scalar[idx.size() + 1];
+      this->constrained_als.shape_pos = new int[idx.size() + 1];
+      this->constrained_als.dof_pos = new int[idx.size() + 1];
+      for(unsigned int i = 0; i < idx.size(); i++)
+      {
+        this->constrained_als.idx[i] = idx[i];
+        this->constrained_als.dof[i] = dof[i];
+        this->constrained_als.coef[i] = coef[i];
+        this->constrained_als.shape_pos[i] = shape_pos[i];
+        this->constrained_als.dof_pos[i] = dof_pos[i];
+      }
+      this->constrained_als.num_elems = num_elems;
     }
 
     template<typename Scalar>
@@ -1174,7 +1794,8 @@ namespace Hermes
 
       std::ofstream out(filename);
 
-      ::xml_schema::flags parsing_flags = ::xml_schema::flags::dont_pretty_print;
+      Hermes2DApi.initialize_xml();
+      ::xml_schema::flags parsing_flags = ::xml_schema::flags::dont_pretty_print | ::xml_schema::flags::dont_initialize;
 
       XMLSpace::space_(out, xmlspace, namespace_info_map, "UTF-8", parsing_flags);
       out.close();
@@ -1182,121 +1803,265 @@ namespace Hermes
       return true;
     }
 
+    static const char H2D_BINARY_SPACE_MAGIC[8] = { 'H', '2', 'D', 'B', 'S', 'P', 'C', '\0' };
+    static const int H2D_BINARY_SPACE_VERSION = 1;
+
+    /// Integers per element in a binary space file: id, order, bubble DOF, number of bubble DOFs and the changed flag.
+    static const int H2D_BINARY_SPACE_ELEMENT_SIZE = 5;
+
+    /// The fixed-size beginning of a binary space file, followed by the element data.
+    struct SpaceBinaryHeader
+    {
+      char magic[8];
+      int version;
+      int byte_order; ///< H2D_BINARY_FILE_BYTE_ORDER as written by the saving machine.
+      char space_type[8]; ///< As in the XML format ("h1", "hcurl", "hdiv", "l2").
+      int n_elements;
+      int padding;
+    };
+
     template<typename Scalar>
-    Space<Scalar>* Space<Scalar>::load(const char *filename, Mesh* mesh, bool validate, EssentialBCs<Scalar>* essential_bcs, Shapeset* shapeset)
+    bool Space<Scalar>::save_binary(const char *filename) const
     {
+      this->check();
+      SpaceBinaryHeader header;
+      memset(&header, 0, sizeof(header));
+
+      switch(this->get_type())
+      {
+        case HERMES_H1_SPACE:
+            strcpy(header.space_type, "h1");
+            break;
+        case HERMES_HCURL_SPACE:
+            strcpy(header.space_type, "hcurl");
+            break;
+        case HERMES_HDIV_SPACE:
+            strcpy(header.space_type, "hdiv");
+            break;
+        case HERMES_L2_SPACE:
+            strcpy(header.space_type, "l2");
+            break;
+        default:
+            return false;
+      }
+
+      std::vector<int> element_data;
+      Element *e;
+      for_all_elements(e, this->get_mesh())
+      {
+        element_data.push_back(e->id);
+        element_data.push_back(this->edata[e->id].order);
+        element_data.push_back(this->edata[e->id].bdof);
+        element_data.push_back(this->edata[e->id].n);
+        element_data.push_back(this->edata[e->id].changed_in_last_adaptation ? 1 : 0);
+      }
+
+      memcpy(header.magic, H2D_BINARY_SPACE_MAGIC, sizeof(H2D_BINARY_SPACE_MAGIC));
+      header.version = H2D_BINARY_SPACE_VERSION;
+      header.byte_order = H2D_BINARY_FILE_BYTE_ORDER;
+      header.n_elements = element_data.size() / H2D_BINARY_SPACE_ELEMENT_SIZE;
+
+      FILE* f = fopen(filename, "wb");
+      if(f == NULL)
+        throw Hermes::Exceptions::Exception("Could not open %s for writing.", filename);
       try
       {
-				Space<Scalar>* space;
+        BinaryFile::write(f, &header, sizeof(header));
+        BinaryFile::write(f, element_data.empty() ? NULL : &element_data[0], sizeof(int) * element_data.size());
+      }
+      catch(Hermes::Exceptions::Exception&)
+      {
+        fclose(f);
+        throw;
+      }
+      fclose(f);
 
-        ::xml_schema::flags parsing_flags = 0;
+      return true;
+    }
 
-        if(!validate)
-          parsing_flags = xml_schema::flags::dont_validate;
+    template<typename Scalar>
+    Space<Scalar>* Space<Scalar>::load_binary(const char *filename, Mesh* mesh, EssentialBCs<Scalar>* essential_bcs, Shapeset* shapeset)
+    {
+      try
+      {
+        BinaryFile file(filename);
+        const SpaceBinaryHeader* header = (const SpaceBinaryHeader*)file.next_section(sizeof(SpaceBinaryHeader));
+        if(memcmp(header->magic, H2D_BINARY_SPACE_MAGIC, sizeof(H2D_BINARY_SPACE_MAGIC)))
+          throw Hermes::Exceptions::SpaceLoadFailureException("File %s: not a binary Hermes2D space file.", filename);
+        if(header->byte_order != H2D_BINARY_FILE_BYTE_ORDER)
+          throw Hermes::Exceptions::SpaceLoadFailureException("File %s: the binary space file was saved on a machine with a different byte order.", filename);
+        if(header->version != H2D_BINARY_SPACE_VERSION)
+          throw Hermes::Exceptions::SpaceLoadFailureException("File %s: unsupported version %d of the binary space file.", filename, header->version);
+
+        char space_type[sizeof(header->space_type) + 1];
+        memcpy(space_type, header->space_type, sizeof(header->space_type));
+        space_type[sizeof(header->space_type)] = '\0';
+        int n_elements = header->n_elements;
+        const int* element_data = (const int*)file.next_section(sizeof(int) * H2D_BINARY_SPACE_ELEMENT_SIZE * n_elements);
+
+        Space<Scalar>* space = init_loaded(space_type, filename, mesh, essential_bcs, shapeset);
+
+        for (int elem_data_i = 0; elem_data_i < n_elements; elem_data_i++)
+        {
+          const int* data = element_data + H2D_BINARY_SPACE_ELEMENT_SIZE * elem_data_i;
+          if(data[0] < 0 || data[0] >= space->esize)
+          {
+            delete space;
+            throw Hermes::Exceptions::SpaceLoadFailureException("File %s: the space does not match the mesh.", filename);
+          }
+          space->edata[data[0]].order = data[1];
+          space->edata[data[0]].bdof = data[2];
+          space->edata[data[0]].n = data[3];
+          space->edata[data[0]].changed_in_last_adaptation = data[4] != 0;
+        }
 
-        std::auto_ptr<XMLSpace::space> parsed_xml_space (XMLSpace::space_(filename, parsing_flags));
+        space->seq = g_space_seq++;
 
-				if(!strcmp(parsed_xml_space->spaceType().get().c_str(),"h1"))
-				{
-					space = new H1Space<Scalar>();
-					space->mesh = mesh;
+        space->assign_dofs();
 
-					if(shapeset == NULL)
-					{
-						space->shapeset = new H1Shapeset;
-						space->own_shapeset = true;
-					}
-					else
-					{
-						if(shapeset->get_space_type() != HERMES_H1_SPACE)
-							throw Hermes::Exceptions::SpaceLoadFailureException("Wrong shapeset / Wrong spaceType in the Solution XML file %s in Space::load.", filename);
-						else
-							space->shapeset = shapeset;
-					}
+        return space;
+      }
+      catch(Hermes::Exceptions::SpaceLoadFailureException&)
+      {
+        throw;
+      }
+      catch(Hermes::Exceptions::Exception& e)
+      {
+        throw Hermes::Exceptions::SpaceLoadFailureException("%s", e.what());
+      }
+    }
 
-					space->precalculate_projection_matrix(2, space->proj_mat, space->chol_p);
-				}
-				else if (!strcmp(parsed_xml_space->spaceType().get().c_str(),"hcurl"))
-				{
-					space = new HcurlSpace<Scalar>();
-					space->mesh = mesh;
+    template<typename Scalar>
+    Space<Scalar>* Space<Scalar>::init_loaded(const char* space_type, const char *filename, Mesh* mesh, EssentialBCs<Scalar>* essential_bcs, Shapeset* shapeset)
+    {
+      Space<Scalar>* space;
 
-					if(shapeset == NULL)
-					{
-						space->shapeset = new HcurlShapeset;
-						space->own_shapeset = true;
-					}
-				else
-					{
-						if(shapeset->get_num_components() < 2)
-							throw Hermes::Exceptions::Exception("HcurlSpace requires a vector shapeset in Space::load.");
-						if(shapeset->get_space_type() != HERMES_HCURL_SPACE)
-							throw Hermes::Exceptions::SpaceLoadFailureException("Wrong shapeset / Wrong spaceType in the Solution XML file %s in Space::load.", filename);
-						else
-							space->shapeset = shapeset;
-					}
+      if(!strcmp(space_type, "h1"))
+      {
+        space = new H1Space<Scalar>();
+        space->mesh = mesh;
 
-					space->precalculate_projection_matrix(0, space->proj_mat, space->chol_p);
-				}
-				else if(!!strcmp(parsed_xml_space->spaceType().get().c_str(),"hdiv"))
-				{
-					space = new HdivSpace<Scalar>();
-					space->mesh = mesh;
+        if(shapeset == NULL)
+        {
+          space->shapeset = new H1Shapeset;
+          space->own_shapeset = true;
+        }
+        else
+        {
+          if(shapeset->get_space_type() != HERMES_H1_SPACE)
+            throw Hermes::Exceptions::SpaceLoadFailureException("Wrong shapeset / Wrong spaceType in the Solution XML file %s in Space::load.", filename);
+          else
+            space->shapeset = shapeset;
+        }
 
-					if(shapeset == NULL)
-					{
-						space->shapeset = new HdivShapeset;
-						space->own_shapeset = true;
-					}
-					else
-					{
-						if(shapeset->get_num_components() < 2)
-							throw Hermes::Exceptions::Exception("HdivSpace requires a vector shapeset in Space::load.");
-						if(shapeset->get_space_type() != HERMES_HDIV_SPACE)
-							throw Hermes::Exceptions::SpaceLoadFailureException("Wrong shapeset / Wrong spaceType in the Solution XML file %s in Space::load.", filename);
-						else
-							space->shapeset = shapeset;
-					}
+        space->precalculate_projection_matrix(2, space->proj_mat, space->chol_p);
+      }
+      else if (!strcmp(space_type, "hcurl"))
+      {
+        space = new HcurlSpace<Scalar>();
+        space->mesh = mesh;
 
-					space->precalculate_projection_matrix(0, space->proj_mat, space->chol_p);
-				}
-				else if(strcmp(parsed_xml_space->spaceType().get().c_str(),"l2"))
-				{
-					space = new L2Space<Scalar>();
-					space->mesh = mesh;
+        if(shapeset == NULL)
+        {
+          space->shapeset = new HcurlShapeset;
+          space->own_shapeset = true;
+        }
+        else
+        {
+          if(shapeset->get_num_components() < 2)
+            throw Hermes::Exceptions::Exception("HcurlSpace requires a vector shapeset in Space::load.");
+          if(shapeset->get_space_type() != HERMES_HCURL_SPACE)
+            throw Hermes::Exceptions::SpaceLoadFailureException("Wrong shapeset / Wrong spaceType in the Solution XML file %s in Space::load.", filename);
+          else
+            space->shapeset = shapeset;
+        }
 
-					if(shapeset == NULL)
-					{
-						space->shapeset = new L2Shapeset;
-						space->own_shapeset = true;
-					}
-					{
-						if(shapeset->get_space_type() != HERMES_L2_SPACE)
-							throw Hermes::Exceptions::SpaceLoadFailureException("Wrong shapeset / Wrong spaceType in the Solution XML file %s in Space::load.", filename);
-						else
-							space->shapeset = shapeset;
-					}
+        space->precalculate_projection_matrix(0, space->proj_mat, space->chol_p);
+      }
+      else if(!strcmp(space_type, "hdiv"))
+      {
+        space = new HdivSpace<Scalar>();
+        space->mesh = mesh;
+
+        if(shapeset == NULL)
+        {
+          space->shapeset = new HdivShapeset;
+          space->own_shapeset = true;
+        }
+        else
+        {
+          if(shapeset->get_num_components() < 2)
+            throw Hermes::Exceptions::Exception("HdivSpace requires a vector shapeset in Space::load.");
+          if(shapeset->get_space_type() != HERMES_HDIV_SPACE)
+            throw Hermes::Exceptions::SpaceLoadFailureException("Wrong shapeset / Wrong spaceType in the Solution XML file %s in Space::load.", filename);
+          else
+            space->shapeset = shapeset;
+        }
+
+        space->precalculate_projection_matrix(0, space->proj_mat, space->chol_p);
+      }
+      else if(!strcmp(space_type, "l2"))
+      {
+        space = new L2Space<Scalar>();
+        space->mesh = mesh;
+
+        if(shapeset == NULL)
+        {
+          space->shapeset = new L2Shapeset;
+          space->own_shapeset = true;
+        }
+        else
+        {
+          if(shapeset->get_space_type() != HERMES_L2_SPACE)
+            throw Hermes::Exceptions::SpaceLoadFailureException("Wrong shapeset / Wrong spaceType in the Solution XML file %s in Space::load.", filename);
+          else
+            space->shapeset = shapeset;
+        }
+
+        static_cast<L2Space<Scalar>*>(space)->ldata = NULL;
+        static_cast<L2Space<Scalar>*>(space)->lsize = 0;
+      }
+      else
+      {
+        throw Exceptions::SpaceLoadFailureException("Wrong spaceType in the Solution XML file %s in Space::load.", filename);
+        return NULL;
+      }
+
+      space->essential_bcs = essential_bcs;
+      space->mesh_seq = space->mesh->get_seq();
+
+      // L2 space does not have any (strong) essential BCs.
+      if(essential_bcs != NULL && strcmp(space_type, "l2"))
+        for(typename Hermes::vector<EssentialBoundaryCondition<Scalar>*>::const_iterator it = essential_bcs->begin(); it != essential_bcs->end(); it++)
+          for(unsigned int i = 0; i < (*it)->markers.size(); i++)
+            if(space->get_mesh()->boundary_markers_conversion.tables->conversion_table_inverse.find((*it)->markers.at(i)) == space->get_mesh()->boundary_markers_conversion.tables->conversion_table_inverse.end())
+              throw Hermes::Exceptions::Exception("A boundary condition defined on a non-existent marker.");
+
+      space->resize_tables();
+
+      return space;
+    }
+
+    template<typename Scalar>
+    Space<Scalar>* Space<Scalar>::load(const char *filename, Mesh* mesh, bool validate, EssentialBCs<Scalar>* essential_bcs, Shapeset* shapeset)
+    {
+      if(BinaryFile::has_magic(filename, H2D_BINARY_SPACE_MAGIC))
+        return load_binary(filename, mesh, essential_bcs, shapeset);
+
+      try
+      {
+        // Xerces is initialized by Hermes2DApi on the first use, for the whole process.
+        Hermes2DApi.initialize_xml();
+        std::auto_ptr<XMLSpace::space> parsed_xml_space;
+        if(validation_on(validate))
+        {
+          ValidatedDocument document(filename);
+          parsed_xml_space = XMLSpace::space_(document.get(), xml_schema::flags::dont_initialize);
+        }
+        else
+          parsed_xml_space = XMLSpace::space_(filename, xml_schema::flags::dont_initialize | xml_schema::flags::dont_validate);
 
-					static_cast<L2Space<Scalar>*>(space)->ldata = NULL;
-					static_cast<L2Space<Scalar>*>(space)->lsize = 0;
-				}
-				else
-				{
-					throw Exceptions::SpaceLoadFailureException("Wrong spaceType in the Solution XML file %s in Space::load.", filename);
-					return NULL;
-				}
-
-				space->essential_bcs = essential_bcs;
-				space->mesh_seq = space->mesh->get_seq();
-
-				// L2 space does not have any (strong) essential BCs.
-				if(essential_bcs != NULL && parsed_xml_space->spaceType().get().c_str() != "l2")
-					for(typename Hermes::vector<EssentialBoundaryCondition<Scalar>*>::const_iterator it = essential_bcs->begin(); it != essential_bcs->end(); it++)
-						for(unsigned int i = 0; i < (*it)->markers.size(); i++)
-							if(space->get_mesh()->boundary_markers_conversion.conversion_table_inverse.find((*it)->markers.at(i)) == space->get_mesh()->boundary_markers_conversion.conversion_table_inverse.end())
-								throw Hermes::Exceptions::Exception("A boundary condition defined on a non-existent marker.");
-
-				space->resize_tables();
+        Space<Scalar>* space = init_loaded(parsed_xml_space->spaceType().get().c_str(), filename, mesh, essential_bcs, shapeset);
 
         // Element data //
         unsigned int elem_data_count = parsed_xml_space->element_data().size();
@@ -0,0 +1,151 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "space_snapshot.h"
+#include "space_h1.h"
+#include "space_hcurl.h"
+#include "space_hdiv.h"
+#include "space_l2.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    template<typename Scalar>
+    std::map<uint64_t, SpaceSnapshot<Scalar>*> SpaceSnapshot<Scalar>::live_snapshots;
+
+    template<typename Scalar>
+    SpaceSnapshot<Scalar>::SpaceSnapshot(const Space<Scalar>* space, uint64_t version) : version(version), ref_count(1)
+    {
+      switch(space->get_type())
+      {
+      case HERMES_H1_SPACE:
+        this->space = new H1Space<Scalar>();
+        break;
+      case HERMES_HCURL_SPACE:
+        this->space = new HcurlSpace<Scalar>();
+        break;
+      case HERMES_HDIV_SPACE:
+        this->space = new HdivSpace<Scalar>();
+        break;
+      case HERMES_L2_SPACE:
+        this->space = new L2Space<Scalar>();
+        break;
+      default:
+        throw Exceptions::Exception("Unknown space type in SpaceSnapshot::acquire().");
+      }
+      this->mesh = new Mesh;
+      // Copies the mesh, the DOFs are then numbered as in the original.
+      this->space->copy(space, this->mesh);
+      this->space->assign_dofs(space->first_dof, space->stride);
+    }
+
+    template<typename Scalar>
+    SpaceSnapshot<Scalar>::~SpaceSnapshot()
+    {
+      delete this->space;
+      delete this->mesh;
+    }
+
+    template<typename Scalar>
+    const SpaceSnapshot<Scalar>* SpaceSnapshot<Scalar>::acquire(const Space<Scalar>* space)
+    {
+      if(space == NULL)
+        throw Exceptions::NullException(1);
+      uint64_t version = space->get_version();
+
+      SpaceSnapshot<Scalar>* snapshot = NULL;
+#pragma omp critical (space_snapshots)
+      {
+        typename std::map<uint64_t, SpaceSnapshot<Scalar>*>::iterator it = live_snapshots.find(version);
+        if(it != live_snapshots.end())
+        {
+          snapshot = it->second;
+          snapshot->ref_count++;
+        }
+      }
+      if(snapshot != NULL)
+        return snapshot;
+
+      // Copied outside of the lock, another thread may have been faster.
+      SpaceSnapshot<Scalar>* created = new SpaceSnapshot<Scalar>(space, version);
+#pragma omp critical (space_snapshots)
+      {
+        std::pair<typename std::map<uint64_t, SpaceSnapshot<Scalar>*>::iterator, bool> inserted = live_snapshots.insert(std::pair<uint64_t, SpaceSnapshot<Scalar>*>(version, created));
+        snapshot = inserted.first->second;
+        if(!inserted.second)
+          snapshot->ref_count++;
+      }
+      if(snapshot != created)
+        delete created;
+      return snapshot;
+    }
+
+    template<typename Scalar>
+    const SpaceSnapshot<Scalar>* SpaceSnapshot<Scalar>::acquire(const SpaceSnapshot<Scalar>* snapshot)
+    {
+      if(snapshot == NULL)
+        throw Exceptions::NullException(1);
+#pragma omp critical (space_snapshots)
+      snapshot->ref_count++;
+      return snapshot;
+    }
+
+    template<typename Scalar>
+    void SpaceSnapshot<Scalar>::release(const SpaceSnapshot<Scalar>* snapshot)
+    {
+      if(snapshot == NULL)
+        return;
+      bool last = false;
+#pragma omp critical (space_snapshots)
+      {
+        if(--snapshot->ref_count == 0)
+        {
+          live_snapshots.erase(snapshot->version);
+          last = true;
+        }
+      }
+      if(last)
+        delete snapshot;
+    }
+
+    template<typename Scalar>
+    const Space<Scalar>* SpaceSnapshot<Scalar>::get_space() const
+    {
+      return this->space;
+    }
+
+    template<typename Scalar>
+    const Mesh* SpaceSnapshot<Scalar>::get_mesh() const
+    {
+      return this->mesh;
+    }
+
+    template<typename Scalar>
+    uint64_t SpaceSnapshot<Scalar>::get_version() const
+    {
+      return this->version;
+    }
+
+    template<typename Scalar>
+    bool SpaceSnapshot<Scalar>::matches(const Space<Scalar>* space) const
+    {
+      return space != NULL && space->get_version() == this->version;
+    }
+
+    template HERMES_API class SpaceSnapshot<double>;
+    template HERMES_API class SpaceSnapshot<std::complex<double> >;
+  }
+}
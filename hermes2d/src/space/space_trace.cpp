@@ -0,0 +1,207 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+#include "space_trace.h"
+#include "quadrature/quad_all.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    template<typename Scalar>
+    EdgeTraceSpace<Scalar>::EdgeTraceSpace(const L2Space<Scalar>* element_space) : element_space(element_space), ndof(0)
+    {
+      if(element_space == NULL)
+        throw Exceptions::NullException(1);
+    }
+
+    template<typename Scalar>
+    EdgeTraceSpace<Scalar>::~EdgeTraceSpace()
+    {
+      free_essential_values();
+    }
+
+    template<typename Scalar>
+    void EdgeTraceSpace<Scalar>::free_essential_values()
+    {
+      for(unsigned int i = 0; i < edata.size(); i++)
+      {
+        delete [] edata[i].essential_values;
+        edata[i].essential_values = NULL;
+      }
+    }
+
+    template<typename Scalar>
+    void EdgeTraceSpace<Scalar>::add_essential_bc(std::string marker, Hermes2DFunction<Scalar>* value)
+    {
+      if(value == NULL)
+        throw Exceptions::NullException(2);
+      const Mesh* mesh = element_space->get_mesh();
+      if(!mesh->get_boundary_markers_conversion().get_internal_marker(marker).valid)
+        throw Exceptions::Exception("EdgeTraceSpace: the boundary marker '%s' is not in the mesh.", marker.c_str());
+      essential_bcs[mesh->get_boundary_markers_conversion().get_internal_marker(marker).marker] = value;
+    }
+
+    template<typename Scalar>
+    int EdgeTraceSpace<Scalar>::assign_dofs()
+    {
+      free_essential_values();
+      const Mesh* mesh = element_space->get_mesh();
+      std::vector<Element*> elements;
+      mesh->get_active_elements(elements);
+
+      EdgeData empty;
+      empty.order = -1;
+      empty.first_dof = -1;
+      empty.essential_values = NULL;
+      edata.assign(mesh->get_max_node_id(), empty);
+
+      // The orders, the numbers of the elements of every edge.
+      std::vector<int> counts(mesh->get_max_node_id(), 0);
+      for(unsigned int i = 0; i < elements.size(); i++)
+      {
+        Element* e = elements[i];
+        int order = element_space->get_element_order(e->id);
+        order = std::max(H2D_GET_H_ORDER(order), H2D_GET_V_ORDER(order));
+        for(unsigned int edge = 0; edge < e->get_nvert(); edge++)
+        {
+          EdgeData& ed = edata[e->en[edge]->id];
+          ed.order = std::max(ed.order, order);
+          counts[e->en[edge]->id]++;
+        }
+      }
+
+      // The DOFs in the order of the elements, the essential values.
+      ndof = 0;
+      std::vector<bool> assigned(edata.size(), false);
+      for(unsigned int i = 0; i < elements.size(); i++)
+      {
+        Element* e = elements[i];
+        for(unsigned int edge = 0; edge < e->get_nvert(); edge++)
+        {
+          Node* en = e->en[edge];
+          if(assigned[en->id])
+            continue;
+          assigned[en->id] = true;
+          if(!en->bnd && counts[en->id] != 2)
+            throw Exceptions::Exception("EdgeTraceSpace: the mesh has a hanging node on the edge %d, the traces need a conforming mesh.", en->id);
+
+          EdgeData& ed = edata[en->id];
+          typename std::map<int, Hermes2DFunction<Scalar>*>::iterator bc = essential_bcs.find(en->marker);
+          if(en->bnd && bc != essential_bcs.end())
+          {
+            ed.essential_values = new Scalar[ed.order + 1];
+            project_essential_value(e, edge, bc->second, ed.order, ed.essential_values);
+          }
+          else
+          {
+            ed.first_dof = ndof;
+            ndof += ed.order + 1;
+          }
+        }
+      }
+      return ndof;
+    }
+
+    template<typename Scalar>
+    void EdgeTraceSpace<Scalar>::project_essential_value(Element* e, int edge, Hermes2DFunction<Scalar>* value, int order, Scalar* coeffs) const
+    {
+      Node* v1 = e->vn[edge];
+      Node* v2 = e->vn[(edge + 1) % e->get_nvert()];
+      if(v2->id < v1->id)
+        std::swap(v1, v2);
+
+      int quad_order = std::min(2 * order + 4, g_quad_1d_std.get_max_order());
+      double2* pt = g_quad_1d_std.get_points(quad_order);
+      int np = g_quad_1d_std.get_num_points(quad_order);
+      double* legendre = new double[order + 1];
+      for(int k = 0; k <= order; k++)
+        coeffs[k] = 0.0;
+      for(int i = 0; i < np; i++)
+      {
+        double t = pt[i][0];
+        double x = v1->x + 0.5 * (t + 1.0) * (v2->x - v1->x);
+        double y = v1->y + 0.5 * (t + 1.0) * (v2->y - v1->y);
+        Scalar g = value->value(Scalar(x), Scalar(y));
+        get_legendre_values(order, t, legendre);
+        for(int k = 0; k <= order; k++)
+          coeffs[k] += pt[i][1] * g * legendre[k];
+      }
+      // The norms of the Legendre polynomials are 2 / (2k + 1).
+      for(int k = 0; k <= order; k++)
+        coeffs[k] *= 0.5 * (2 * k + 1);
+      delete [] legendre;
+    }
+
+    template<typename Scalar>
+    int EdgeTraceSpace<Scalar>::get_num_dofs() const
+    {
+      return ndof;
+    }
+
+    template<typename Scalar>
+    const L2Space<Scalar>* EdgeTraceSpace<Scalar>::get_element_space() const
+    {
+      return element_space;
+    }
+
+    template<typename Scalar>
+    int EdgeTraceSpace<Scalar>::get_edge_order(int edge_id) const
+    {
+      if(edge_id < 0 || edge_id >= (int)edata.size())
+        return -1;
+      return edata[edge_id].order;
+    }
+
+    template<typename Scalar>
+    int EdgeTraceSpace<Scalar>::get_edge_first_dof(int edge_id) const
+    {
+      if(edge_id < 0 || edge_id >= (int)edata.size())
+        return -1;
+      return edata[edge_id].first_dof;
+    }
+
+    template<typename Scalar>
+    const Scalar* EdgeTraceSpace<Scalar>::get_essential_values(int edge_id) const
+    {
+      if(edge_id < 0 || edge_id >= (int)edata.size())
+        return NULL;
+      return edata[edge_id].essential_values;
+    }
+
+    template<typename Scalar>
+    double EdgeTraceSpace<Scalar>::get_edge_parameter(Element* e, int edge, double x, double y)
+    {
+      Node* v1 = e->vn[edge];
+      Node* v2 = e->vn[(edge + 1) % e->get_nvert()];
+      if(v2->id < v1->id)
+        std::swap(v1, v2);
+      double dx = v2->x - v1->x, dy = v2->y - v1->y;
+      return 2.0 * ((x - v1->x) * dx + (y - v1->y) * dy) / (dx * dx + dy * dy) - 1.0;
+    }
+
+    template<typename Scalar>
+    void EdgeTraceSpace<Scalar>::get_legendre_values(int order, double t, double* values)
+    {
+      values[0] = 1.0;
+      if(order > 0)
+        values[1] = t;
+      for(int k = 2; k <= order; k++)
+        values[k] = ((2 * k - 1) * t * values[k - 1] - (k - 1) * values[k - 2]) / k;
+    }
+
+    template HERMES_API class EdgeTraceSpace<double>;
+    template HERMES_API class EdgeTraceSpace<std::complex<double> >;
+  }
+}
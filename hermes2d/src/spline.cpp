@@ -23,15 +23,15 @@ namespace Hermes
     CubicSpline::CubicSpline(Hermes::vector<double> points, Hermes::vector<double> values,
       double bc_left, double bc_right,
       bool first_der_left, bool first_der_right,
-      bool extrapolate_der_left, bool extrapolate_der_right) : Hermes::Hermes1DFunction<double>(), points(points), values(values),
-      bc_left(bc_left), bc_right(bc_right), first_der_left(first_der_left),
+      bool extrapolate_der_left, bool extrapolate_der_right) : Hermes::Hermes1DFunction<double>(), interval_lookup_inv_step(0.0),
+      points(points), values(values), bc_left(bc_left), bc_right(bc_right), first_der_left(first_der_left),
       first_der_right(first_der_right), extrapolate_der_left(extrapolate_der_left),
       extrapolate_der_right(extrapolate_der_right)
     {
       this->is_const = false;
     }
 
-    CubicSpline::CubicSpline(double const_value) : Hermes::Hermes1DFunction<double>(const_value)
+    CubicSpline::CubicSpline(double const_value) : Hermes::Hermes1DFunction<double>(const_value), interval_lookup_inv_step(0.0)
     {
     }
 
@@ -113,6 +113,68 @@ namespace Hermes
       return get_derivative_from_interval(x, m);
     };
 
+    void CubicSpline::evaluate(double x_in, double& value_out, double& derivative_out) const
+    {
+      int m = -1;
+      if(this->find_interval(x_in, m))
+      {
+        double x2 = x_in * x_in;
+        value_out = this->coeffs[m].a + this->coeffs[m].b * x_in + this->coeffs[m].c * x2 + this->coeffs[m].d * x2 * x_in;
+        derivative_out = this->coeffs[m].b + 2 * this->coeffs[m].c * x_in + 3 * this->coeffs[m].d * x2;
+      }
+      else if(x_in <= point_left)
+      {
+        value_out = extrapolate_der_left ? extrapolate_value(point_left, value_left, derivative_left, x_in) : value_left;
+        derivative_out = extrapolate_der_left ? derivative_left : 0.0;
+      }
+      else
+      {
+        value_out = extrapolate_der_right ? extrapolate_value(point_right, value_right, derivative_right, x_in) : value_right;
+        derivative_out = extrapolate_der_right ? derivative_right : 0.0;
+      }
+    }
+
+    void CubicSpline::value_batch(int n, const double* x, double* result) const
+    {
+      if(this->is_const)
+      {
+        for(int i = 0; i < n; i++)
+          result[i] = const_value;
+        return;
+      }
+      double derivative_value;
+      for(int i = 0; i < n; i++)
+        evaluate(x[i], result[i], derivative_value);
+    }
+
+    void CubicSpline::derivative_batch(int n, const double* x, double* result) const
+    {
+      if(this->is_const)
+      {
+        for(int i = 0; i < n; i++)
+          result[i] = 0.0;
+        return;
+      }
+      double value;
+      for(int i = 0; i < n; i++)
+        evaluate(x[i], value, result[i]);
+    }
+
+    void CubicSpline::value_and_derivative_batch(int n, const double* x, double* values_result, double* derivatives_result) const
+    {
+      if(this->is_const)
+      {
+        for(int i = 0; i < n; i++)
+        {
+          values_result[i] = const_value;
+          derivatives_result[i] = 0.0;
+        }
+        return;
+      }
+      for(int i = 0; i < n; i++)
+        evaluate(x[i], values_result[i], derivatives_result[i]);
+    }
+
     double CubicSpline::extrapolate_value(double point_end, double value_end,
       double derivative_end, double x_in) const
     {
@@ -144,6 +206,20 @@ namespace Hermes
       if(x_in < points[i_left]) return false;
       if(x_in > points[i_right]) return false;
 
+      if(!interval_lookup.empty())
+      {
+        int cell = (int)((x_in - points[0]) * interval_lookup_inv_step);
+        if(cell >= (int)interval_lookup.size())
+          cell = interval_lookup.size() - 1;
+        m = interval_lookup[cell];
+        // The rounding of the cell index.
+        while(m > 0 && points[m] > x_in)
+          m--;
+        while(m + 1 < i_right && points[m + 1] < x_in)
+          m++;
+        return true;
+      }
+
       while (i_left + 1 < i_right)
       {
         int i_mid = (i_left + i_right) / 2;
@@ -387,6 +463,18 @@ namespace Hermes
       value_right = values[values.size() - 1];
       derivative_right = get_derivative_from_interval(point_right, points.size() - 2);
 
+      // The cells of the interval lookup as long as the intervals for the equidistant points.
+      interval_lookup.resize(nelem);
+      interval_lookup_inv_step = nelem / (point_right - point_left);
+      int m = 0;
+      for (int cell = 0; cell < nelem; cell++)
+      {
+        double cell_start = point_left + cell / interval_lookup_inv_step;
+        while(m + 1 < nelem && points[m + 1] <= cell_start)
+          m++;
+        interval_lookup[cell] = m;
+      }
+
       // Free the matrix and rhs vector.
       delete [] matrix;
       delete [] rhs;
@@ -0,0 +1,452 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+#include "static_condensation.h"
+#include "api2d.h"
+#include <algorithm>
+
+using namespace Hermes::Algebra::DenseMatrixOperations;
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    /// The LU decomposition with the partial pivoting of the dense block of the bubbles, false if it is singular.
+    template<typename Scalar>
+    static bool factorize_block(Scalar** a, int n, int* perm)
+    {
+      for(int k = 0; k < n; k++)
+      {
+        int pivot = k;
+        for(int i = k + 1; i < n; i++)
+          if(std::abs(a[i][k]) > std::abs(a[pivot][k]))
+            pivot = i;
+        if(a[pivot][k] == 0.0)
+          return false;
+        perm[k] = pivot;
+        if(pivot != k)
+          std::swap(a[pivot], a[k]);
+        for(int i = k + 1; i < n; i++)
+        {
+          Scalar factor = a[i][k] / a[k][k];
+          a[i][k] = factor;
+          for(int j = k + 1; j < n; j++)
+            a[i][j] -= factor * a[k][j];
+        }
+      }
+      return true;
+    }
+
+    /// Solves with the decomposition by factorize_block(), b[i * stride] is the right-hand side and the solution.
+    template<typename Scalar>
+    static void solve_block(Scalar** a, int n, int* perm, Scalar* b, int stride)
+    {
+      for(int k = 0; k < n; k++)
+        if(perm[k] != k)
+          std::swap(b[k * stride], b[perm[k] * stride]);
+      for(int i = 1; i < n; i++)
+        for(int j = 0; j < i; j++)
+          b[i * stride] -= a[i][j] * b[j * stride];
+      for(int i = n - 1; i >= 0; i--)
+      {
+        for(int j = i + 1; j < n; j++)
+          b[i * stride] -= a[i][j] * b[j * stride];
+        b[i * stride] /= a[i][i];
+      }
+    }
+
+    static int find_root(std::vector<int>& parent, int dof)
+    {
+      while(parent[dof] != dof)
+      {
+        parent[dof] = parent[parent[dof]];
+        dof = parent[dof];
+      }
+      return dof;
+    }
+
+    static int local_index(const std::vector<int>& dofs, int dof)
+    {
+      return std::lower_bound(dofs.begin(), dofs.end(), dof) - dofs.begin();
+    }
+
+    template<typename Scalar>
+    StaticCondensation<Scalar>::StaticCondensation() : ndof(0), num_skeleton_dofs(0), max_group_size(400), structure_skeleton_matrix(NULL), sln_vector(NULL)
+    {
+    }
+
+    template<typename Scalar>
+    StaticCondensation<Scalar>::~StaticCondensation()
+    {
+      free_groups();
+      delete [] sln_vector;
+    }
+
+    template<typename Scalar>
+    void StaticCondensation<Scalar>::free_groups()
+    {
+      for(unsigned int i = 0; i < groups.size(); i++)
+      {
+        delete [] groups[i].coupling;
+        delete [] groups[i].lift;
+      }
+      groups.clear();
+    }
+
+    template<typename Scalar>
+    CSRMatrix<Scalar>* StaticCondensation<Scalar>::get_full_matrix()
+    {
+      return &full_matrix;
+    }
+
+    template<typename Scalar>
+    Vector<Scalar>* StaticCondensation<Scalar>::get_full_rhs()
+    {
+      return &full_rhs;
+    }
+
+    template<typename Scalar>
+    int StaticCondensation<Scalar>::get_num_dofs() const
+    {
+      return ndof;
+    }
+
+    template<typename Scalar>
+    int StaticCondensation<Scalar>::get_num_skeleton_dofs() const
+    {
+      return num_skeleton_dofs;
+    }
+
+    template<typename Scalar>
+    void StaticCondensation<Scalar>::set_max_group_size(int max_group_size)
+    {
+      if(max_group_size < 1)
+        throw Exceptions::ValueException("max_group_size", max_group_size, 1);
+      this->max_group_size = max_group_size;
+    }
+
+    template<typename Scalar>
+    bool StaticCondensation<Scalar>::structure_changed(Hermes::vector<const Space<Scalar>*> spaces, SparseMatrix<Scalar>* skeleton_matrix) const
+    {
+      if(skeleton_matrix != structure_skeleton_matrix || spaces.size() != structure_seqs.size() || (int)structure_Ap.size() != ndof + 1)
+        return true;
+      for(unsigned int i = 0; i < spaces.size(); i++)
+        if(spaces[i]->get_seq() != structure_seqs[i])
+          return true;
+      int* Ap = const_cast<CSRMatrix<Scalar>&>(full_matrix).get_Ap();
+      int* Ai = const_cast<CSRMatrix<Scalar>&>(full_matrix).get_Ai();
+      if(!std::equal(structure_Ap.begin(), structure_Ap.end(), Ap))
+        return true;
+      return !std::equal(structure_Ai.begin(), structure_Ai.end(), Ai);
+    }
+
+    template<typename Scalar>
+    void StaticCondensation<Scalar>::init_structure(Hermes::vector<const Space<Scalar>*> spaces, SparseMatrix<Scalar>* skeleton_matrix)
+    {
+      free_groups();
+      int* Ap = full_matrix.get_Ap();
+      int* Ai = full_matrix.get_Ai();
+
+      // The bubble DOFs are joined by the entries coupling them (union-find), -1 for the other DOFs.
+      std::vector<int> parent(ndof, -1);
+      AsmList<Scalar> al;
+      for(unsigned int space_i = 0; space_i < spaces.size(); space_i++)
+      {
+        int first_dof = Space<Scalar>::get_dof_offset(spaces, space_i);
+        Element* e;
+        for_all_active_elements(e, spaces[space_i]->get_mesh())
+        {
+          al.cnt = 0;
+          spaces[space_i]->get_bubble_assembly_list(e, &al);
+          for(unsigned int i = 0; i < al.cnt; i++)
+            if(al.dof[i] >= 0)
+              parent[al.dof[i] + first_dof] = al.dof[i] + first_dof;
+        }
+      }
+      for(int row = 0; row < ndof; row++)
+        if(parent[row] != -1)
+          for(int k = Ap[row]; k < Ap[row + 1]; k++)
+            if(parent[Ai[k]] != -1)
+            {
+              int root_row = find_root(parent, row), root_col = find_root(parent, Ai[k]);
+              if(root_row != root_col)
+                parent[std::max(root_row, root_col)] = std::min(root_row, root_col);
+            }
+
+      // The groups, in the order of their first DOFs; the ones too large stay in the skeleton system.
+      std::vector<int> root_group(ndof, -1);
+      for(int dof = 0; dof < ndof; dof++)
+        if(parent[dof] != -1)
+        {
+          int root = find_root(parent, dof);
+          if(root_group[root] == -1)
+          {
+            root_group[root] = groups.size();
+            groups.push_back(Group());
+          }
+          groups[root_group[root]].bubbles.push_back(dof);
+        }
+      unsigned int num_groups = 0;
+      for(unsigned int g = 0; g < groups.size(); g++)
+        if((int)groups[g].bubbles.size() <= max_group_size)
+        {
+          if(g != num_groups)
+            groups[num_groups].bubbles.swap(groups[g].bubbles);
+          num_groups++;
+        }
+      groups.resize(num_groups);
+
+      group_index.assign(ndof, -1);
+      for(unsigned int g = 0; g < groups.size(); g++)
+      {
+        groups[g].coupling = NULL;
+        groups[g].lift = NULL;
+        for(unsigned int i = 0; i < groups[g].bubbles.size(); i++)
+          group_index[groups[g].bubbles[i]] = g;
+      }
+
+      skeleton_index.assign(ndof, -1);
+      num_skeleton_dofs = 0;
+      for(int dof = 0; dof < ndof; dof++)
+        if(group_index[dof] == -1)
+          skeleton_index[dof] = num_skeleton_dofs++;
+
+      // The skeleton DOFs coupled to the groups.
+      for(int row = 0; row < ndof; row++)
+        for(int k = Ap[row]; k < Ap[row + 1]; k++)
+        {
+          if(group_index[row] != -1 && group_index[Ai[k]] == -1)
+            groups[group_index[row]].cols.push_back(Ai[k]);
+          else if(group_index[row] == -1 && group_index[Ai[k]] != -1)
+            groups[group_index[Ai[k]]].rows.push_back(row);
+        }
+      for(unsigned int g = 0; g < groups.size(); g++)
+      {
+        std::vector<int>& rows = groups[g].rows;
+        std::vector<int>& cols = groups[g].cols;
+        std::sort(rows.begin(), rows.end());
+        rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+        std::sort(cols.begin(), cols.end());
+        cols.erase(std::unique(cols.begin(), cols.end()), cols.end());
+      }
+
+      // The skeleton matrix has the entries of the full one and the (dense) Schur complements of the groups.
+      skeleton_matrix->prealloc(num_skeleton_dofs);
+      int prealloc_passes = skeleton_matrix->get_prealloc_passes();
+      if(prealloc_passes > 1)
+        skeleton_matrix->prealloc_counting();
+      for(int pass = 0; pass < prealloc_passes; pass++)
+      {
+        for(int row = 0; row < ndof; row++)
+          if(skeleton_index[row] != -1)
+            for(int k = Ap[row]; k < Ap[row + 1]; k++)
+              if(skeleton_index[Ai[k]] != -1)
+                skeleton_matrix->pre_add_ij(skeleton_index[row], skeleton_index[Ai[k]]);
+        for(unsigned int g = 0; g < groups.size(); g++)
+          for(unsigned int i = 0; i < groups[g].rows.size(); i++)
+            for(unsigned int j = 0; j < groups[g].cols.size(); j++)
+              skeleton_matrix->pre_add_ij(skeleton_index[groups[g].rows[i]], skeleton_index[groups[g].cols[j]]);
+        if(pass == 0 && prealloc_passes > 1)
+          skeleton_matrix->prealloc_indices();
+      }
+      skeleton_matrix->alloc();
+
+      structure_Ap.assign(Ap, Ap + ndof + 1);
+      structure_Ai.assign(Ai, Ai + Ap[ndof]);
+      structure_seqs.clear();
+      for(unsigned int i = 0; i < spaces.size(); i++)
+        structure_seqs.push_back(spaces[i]->get_seq());
+      structure_skeleton_matrix = skeleton_matrix;
+    }
+
+    template<typename Scalar>
+    void StaticCondensation<Scalar>::condense(Hermes::vector<const Space<Scalar>*> spaces, SparseMatrix<Scalar>* skeleton_matrix, Vector<Scalar>* skeleton_rhs)
+    {
+      if(skeleton_matrix == NULL)
+        throw Exceptions::NullException(2);
+      if(skeleton_rhs == NULL)
+        throw Exceptions::NullException(3);
+      this->tick();
+
+      ndof = Space<Scalar>::get_num_dofs(spaces);
+      if((int)full_matrix.get_matrix_size() != ndof || (int)full_rhs.length() != ndof)
+        throw Exceptions::Exception("StaticCondensation: the full system was not assembled on the spaces.");
+
+      if(structure_changed(spaces, skeleton_matrix))
+        init_structure(spaces, skeleton_matrix);
+      skeleton_matrix->zero();
+      skeleton_rhs->alloc(num_skeleton_dofs);
+
+      int* Ap = full_matrix.get_Ap();
+      int* Ai = full_matrix.get_Ai();
+      Scalar* Ax = full_matrix.get_Ax();
+      const Scalar* f = full_rhs.get_values();
+
+      // The couplings of the skeleton DOFs.
+      for(int row = 0; row < ndof; row++)
+        if(skeleton_index[row] != -1)
+        {
+          skeleton_rhs->set(skeleton_index[row], f[row]);
+          for(int k = Ap[row]; k < Ap[row + 1]; k++)
+            if(skeleton_index[Ai[k]] != -1)
+              skeleton_matrix->add(skeleton_index[row], skeleton_index[Ai[k]], Ax[k]);
+        }
+
+      // The Schur complements, added concurrently like the element matrices in DiscreteProblem::assemble().
+      int num_groups = groups.size();
+      std::vector<int> update_starts(num_groups + 1, 0);
+      for(int g = 0; g < num_groups; g++)
+        update_starts[g + 1] = update_starts[g] + groups[g].rows.size();
+      Scalar* rhs_updates = new Scalar[update_starts[num_groups] + 1];
+
+      int num_threads = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
+      elimination_status.reset();
+#pragma omp parallel for num_threads(num_threads) schedule(dynamic, 16)
+      for(int g = 0; g < num_groups; g++)
+      {
+        if(elimination_status.has_failed())
+          continue;
+        try
+        {
+          eliminate(groups[g], skeleton_matrix, rhs_updates + update_starts[g]);
+        }
+        catch(Hermes::Exceptions::Exception& e)
+        {
+          elimination_status.fail(e);
+        }
+        catch(std::exception& e)
+        {
+          elimination_status.fail(e);
+        }
+      }
+      if(elimination_status.has_failed())
+      {
+        delete [] rhs_updates;
+        elimination_status.rethrow();
+      }
+
+      for(int g = 0; g < num_groups; g++)
+        for(unsigned int i = 0; i < groups[g].rows.size(); i++)
+          skeleton_rhs->add(skeleton_index[groups[g].rows[i]], rhs_updates[update_starts[g] + i]);
+      delete [] rhs_updates;
+
+      this->tick();
+      this->info("\tStatic condensation: %i DOFs, %i skeleton DOFs, %i groups, duration: %f s.", ndof, num_skeleton_dofs, num_groups, this->last());
+    }
+
+    template<typename Scalar>
+    void StaticCondensation<Scalar>::eliminate(Group& group, SparseMatrix<Scalar>* skeleton_matrix, Scalar* rhs_update)
+    {
+      int* Ap = full_matrix.get_Ap();
+      int* Ai = full_matrix.get_Ai();
+      Scalar* Ax = full_matrix.get_Ax();
+      const Scalar* f = full_rhs.get_values();
+      int nb = group.bubbles.size(), nr = group.rows.size(), nc = group.cols.size();
+
+      // A_bb, A_bc and f_b, the arrays are kept while the structure does not change.
+      if(group.coupling == NULL)
+      {
+        group.coupling = new Scalar[nb * nc + 1];
+        group.lift = new Scalar[nb];
+      }
+      memset(group.coupling, 0, (nb * nc + 1) * sizeof(Scalar));
+      Scalar** block = new_matrix<Scalar>(nb, nb);
+      for(int i = 0; i < nb; i++)
+      {
+        int row = group.bubbles[i];
+        group.lift[i] = f[row];
+        for(int k = Ap[row]; k < Ap[row + 1]; k++)
+          if(group_index[Ai[k]] != -1)
+            block[i][local_index(group.bubbles, Ai[k])] = Ax[k];
+          else
+            group.coupling[i * nc + local_index(group.cols, Ai[k])] = Ax[k];
+      }
+
+      int* perm = new int[nb];
+      if(!factorize_block(block, nb, perm))
+      {
+        delete [] perm;
+        delete [] block;
+        throw Exceptions::Exception("StaticCondensation: the block of the bubble DOFs %i - %i is singular.", group.bubbles.front(), group.bubbles.back());
+      }
+      solve_block(block, nb, perm, group.lift, 1);
+      for(int j = 0; j < nc; j++)
+        solve_block(block, nb, perm, group.coupling + j, nc);
+      delete [] perm;
+      delete [] block;
+
+      // - A_rb (A_bb)^{-1} A_bc and - A_rb (A_bb)^{-1} f_b.
+      Scalar** schur = new_matrix<Scalar>(nr, nc);
+      int* schur_rows = new int[nr];
+      int* schur_cols = new int[nc];
+      int own_group = group_index[group.bubbles.front()];
+      for(int r = 0; r < nr; r++)
+      {
+        int row = group.rows[r];
+        schur_rows[r] = skeleton_index[row];
+        rhs_update[r] = 0.0;
+        for(int k = Ap[row]; k < Ap[row + 1]; k++)
+          if(group_index[Ai[k]] == own_group)
+          {
+            int i = local_index(group.bubbles, Ai[k]);
+            Scalar a = Ax[k];
+            for(int j = 0; j < nc; j++)
+              schur[r][j] -= a * group.coupling[i * nc + j];
+            rhs_update[r] -= a * group.lift[i];
+          }
+      }
+      for(int j = 0; j < nc; j++)
+        schur_cols[j] = skeleton_index[group.cols[j]];
+      skeleton_matrix->add(nr, nc, schur, schur_rows, schur_cols);
+
+      delete [] schur;
+      delete [] schur_rows;
+      delete [] schur_cols;
+    }
+
+    template<typename Scalar>
+    Scalar* StaticCondensation<Scalar>::recover(const Scalar* skeleton_sln)
+    {
+      if(skeleton_sln == NULL)
+        throw Exceptions::NullException(1);
+
+      delete [] sln_vector;
+      sln_vector = new Scalar[ndof];
+      for(int dof = 0; dof < ndof; dof++)
+        if(skeleton_index[dof] != -1)
+          sln_vector[dof] = skeleton_sln[skeleton_index[dof]];
+
+      // u_b = (A_bb)^{-1} (f_b - A_bc u_c).
+      int num_groups = groups.size();
+      int num_threads = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
+#pragma omp parallel for num_threads(num_threads) schedule(dynamic, 16)
+      for(int g = 0; g < num_groups; g++)
+      {
+        const Group& group = groups[g];
+        int nc = group.cols.size();
+        for(unsigned int i = 0; i < group.bubbles.size(); i++)
+        {
+          Scalar value = group.lift[i];
+          for(int j = 0; j < nc; j++)
+            value -= group.coupling[i * nc + j] * sln_vector[group.cols[j]];
+          sln_vector[group.bubbles[i]] = value;
+        }
+      }
+      return sln_vector;
+    }
+
+    template HERMES_API class StaticCondensation<double>;
+    template HERMES_API class StaticCondensation<std::complex<double> >;
+  }
+}
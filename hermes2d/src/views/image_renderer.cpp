@@ -0,0 +1,643 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "image_renderer.h"
+#include "api2d.h"
+#include <stdint.h>
+
+#include "view_data.cpp"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    namespace Views
+    {
+      /// The colors of the orders, as in the OrderView.
+      static const int image_order_palette[] =
+      {
+        0x7f7f7f,
+        0x7f2aff,
+        0x2a2aff,
+        0x2a7fff,
+        0x00d4aa,
+        0x00aa44,
+        0xabc837,
+        0xffd42a,
+        0xc87137,
+        0xc83737,
+        0xff0000
+      };
+      static const int image_max_order = sizeof(image_order_palette) / sizeof(int) - 1;
+
+      //// PNG output ////////////////////////////////////////////////////////////////////////////////////
+
+      /// The bits of the deflate stream, the least significant first.
+      class DeflateBitWriter
+      {
+      public:
+        DeflateBitWriter(std::vector<unsigned char>& out) : out(out), buffer(0), num_bits(0) {}
+
+        void put(unsigned int bits, int count)
+        {
+          buffer |= (uint32_t)bits << num_bits;
+          num_bits += count;
+          while(num_bits >= 8)
+          {
+            out.push_back((unsigned char)(buffer & 0xff));
+            buffer >>= 8;
+            num_bits -= 8;
+          }
+        }
+
+        /// A Huffman code, written from its most significant bit.
+        void put_code(unsigned int code, int count)
+        {
+          unsigned int reversed = 0;
+          for(int i = 0; i < count; i++)
+            reversed |= ((code >> i) & 1) << (count - 1 - i);
+          put(reversed, count);
+        }
+
+        void flush()
+        {
+          if(num_bits > 0)
+            out.push_back((unsigned char)(buffer & 0xff));
+          buffer = 0;
+          num_bits = 0;
+        }
+
+      protected:
+        std::vector<unsigned char>& out;
+        uint32_t buffer;
+        int num_bits;
+      };
+
+      static const int deflate_length_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+      static const int deflate_length_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+      static const int deflate_dist_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+      static const int deflate_dist_extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+      /// A literal/length symbol in the fixed Huffman code.
+      static void deflate_put_symbol(DeflateBitWriter& writer, int symbol)
+      {
+        if(symbol < 144)
+          writer.put_code(0x30 + symbol, 8);
+        else if(symbol < 256)
+          writer.put_code(0x190 + symbol - 144, 9);
+        else if(symbol < 280)
+          writer.put_code(symbol - 256, 7);
+        else
+          writer.put_code(0xc0 + symbol - 280, 8);
+      }
+
+      static void deflate_put_match(DeflateBitWriter& writer, int length, int distance)
+      {
+        int code = 28;
+        while(deflate_length_base[code] > length)
+          code--;
+        deflate_put_symbol(writer, 257 + code);
+        writer.put(length - deflate_length_base[code], deflate_length_extra[code]);
+
+        code = 29;
+        while(deflate_dist_base[code] > distance)
+          code--;
+        writer.put_code(code, 5);
+        writer.put(distance - deflate_dist_base[code], deflate_dist_extra[code]);
+      }
+
+      /// The zlib stream of the data, one block of the fixed Huffman code with (greedy, hash chain) LZ77 matches.
+      /// Rendered fields are mostly runs of a few colors, which this compresses well at a fraction of the cost of zlib -9.
+      static void zlib_compress(const unsigned char* data, size_t size, std::vector<unsigned char>& out)
+      {
+        const int window = 32768, hash_size = 1 << 15, max_chain = 16, min_match = 3, max_match = 258;
+
+        out.push_back(0x78);
+        out.push_back(0x01);
+
+        DeflateBitWriter writer(out);
+        // BFINAL, BTYPE = fixed Huffman
+        writer.put(1, 1);
+        writer.put(1, 2);
+
+        int* head = new int[hash_size];
+        int* prev = new int[window];
+        for(int i = 0; i < hash_size; i++)
+          head[i] = -1;
+
+        size_t pos = 0;
+        while(pos < size)
+        {
+          int best_length = 0, best_distance = 0;
+          if(pos + min_match <= size)
+          {
+            unsigned int hash = ((data[pos] << 10) ^ (data[pos + 1] << 5) ^ data[pos + 2]) & (hash_size - 1);
+            int candidate = head[hash];
+            int max_length = (int)std::min((size_t)max_match, size - pos);
+            for(int chain = 0; candidate >= 0 && (int)pos - candidate <= window && chain < max_chain; chain++)
+            {
+              int length = 0;
+              while(length < max_length && data[candidate + length] == data[pos + length])
+                length++;
+              if(length > best_length)
+              {
+                best_length = length;
+                best_distance = (int)pos - candidate;
+                if(length == max_length)
+                  break;
+              }
+              candidate = prev[candidate % window];
+            }
+            prev[pos % window] = head[hash];
+            head[hash] = (int)pos;
+          }
+
+          if(best_length >= min_match)
+          {
+            deflate_put_match(writer, best_length, best_distance);
+            // the skipped positions enter the hash chains as well
+            for(size_t i = pos + 1; i < pos + best_length && i + min_match <= size; i++)
+            {
+              unsigned int hash = ((data[i] << 10) ^ (data[i + 1] << 5) ^ data[i + 2]) & (hash_size - 1);
+              prev[i % window] = head[hash];
+              head[hash] = (int)i;
+            }
+            pos += best_length;
+          }
+          else
+            deflate_put_symbol(writer, data[pos++]);
+        }
+        // end of block
+        deflate_put_symbol(writer, 256);
+        writer.flush();
+
+        delete [] head;
+        delete [] prev;
+
+        uint32_t a = 1, b = 0;
+        for(size_t i = 0; i < size; i++)
+        {
+          a = (a + data[i]) % 65521;
+          b = (b + a) % 65521;
+        }
+        uint32_t adler = (b << 16) | a;
+        for(int i = 3; i >= 0; i--)
+          out.push_back((unsigned char)(adler >> (8 * i)));
+      }
+
+      static uint32_t png_crc(const unsigned char* data, size_t size, uint32_t crc = 0xffffffff)
+      {
+        static uint32_t table[256];
+        static bool table_ready = false;
+#pragma omp critical (png_crc_table)
+        if(!table_ready)
+        {
+          for(uint32_t n = 0; n < 256; n++)
+          {
+            uint32_t c = n;
+            for(int k = 0; k < 8; k++)
+              c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+            table[n] = c;
+          }
+          table_ready = true;
+        }
+        for(size_t i = 0; i < size; i++)
+          crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        return crc;
+      }
+
+      static void png_put_uint32(std::vector<unsigned char>& out, uint32_t value)
+      {
+        for(int i = 3; i >= 0; i--)
+          out.push_back((unsigned char)(value >> (8 * i)));
+      }
+
+      static void png_write_chunk(FILE* file, const char* type, const std::vector<unsigned char>& data)
+      {
+        std::vector<unsigned char> chunk;
+        png_put_uint32(chunk, (uint32_t)data.size());
+        chunk.insert(chunk.end(), type, type + 4);
+        chunk.insert(chunk.end(), data.begin(), data.end());
+        uint32_t crc = png_crc(&chunk[4], chunk.size() - 4) ^ 0xffffffff;
+        png_put_uint32(chunk, crc);
+        fwrite(&chunk[0], 1, chunk.size(), file);
+      }
+
+      //// ImageRenderer /////////////////////////////////////////////////////////////////////////////////
+
+      ImageRenderer::ImageRenderer(int width, int height) : width(width), height(height), range_auto(true), range_min(0.0), range_max(1.0),
+        pal_type(H2DV_PT_DEFAULT), b_show_edges(true), scale(1.0), offset_x(0.0), offset_y(0.0)
+      {
+        if(width < 1 || height < 1)
+          throw Exceptions::ValueException("width", width < 1 ? width : height, 1);
+        pixels = new unsigned char[3 * width * height];
+        memset(pixels, 0xff, 3 * width * height);
+        set_edges_color(0.5f, 0.4f, 0.4f);
+      }
+
+      ImageRenderer::~ImageRenderer()
+      {
+        delete [] pixels;
+      }
+
+      void ImageRenderer::set_min_max_range(double min, double max)
+      {
+        if(max < min)
+          std::swap(min, max);
+        range_auto = false;
+        range_min = min;
+        range_max = max;
+      }
+
+      void ImageRenderer::set_auto_range()
+      {
+        range_auto = true;
+      }
+
+      void ImageRenderer::set_palette(ViewPaletteType type)
+      {
+        pal_type = type;
+      }
+
+      void ImageRenderer::show_edges(bool show)
+      {
+        b_show_edges = show;
+      }
+
+      void ImageRenderer::set_edges_color(float r, float g, float b)
+      {
+        edges_color[0] = (unsigned char)(255 * r);
+        edges_color[1] = (unsigned char)(255 * g);
+        edges_color[2] = (unsigned char)(255 * b);
+      }
+
+      int ImageRenderer::get_width() const
+      {
+        return width;
+      }
+
+      int ImageRenderer::get_height() const
+      {
+        return height;
+      }
+
+      const unsigned char* ImageRenderer::get_pixels() const
+      {
+        return pixels;
+      }
+
+      void ImageRenderer::get_palette_color(double t, unsigned char* color) const
+      {
+        if(t < 0.0) t = 0.0;
+        else if(t > 1.0) t = 1.0;
+
+        if(pal_type == H2DV_PT_HUESCALE || pal_type == H2DV_PT_DEFAULT)
+        {
+          int n = (int)(t * num_pal_entries);
+          color[0] = (unsigned char)(255 * palette_data[n][0]);
+          color[1] = (unsigned char)(255 * palette_data[n][1]);
+          color[2] = (unsigned char)(255 * palette_data[n][2]);
+        }
+        else if(pal_type == H2DV_PT_GRAYSCALE)
+          color[0] = color[1] = color[2] = (unsigned char)(255 * t);
+        else if(pal_type == H2DV_PT_INVGRAYSCALE)
+          color[0] = color[1] = color[2] = (unsigned char)(255 * (1.0 - t));
+        else
+          color[0] = color[1] = color[2] = 255;
+      }
+
+      void ImageRenderer::begin(double min_x, double max_x, double min_y, double max_y)
+      {
+        // the domain fills the image up to a margin, with the aspect ratio kept
+        const double margin = 0.05;
+        double size_x = std::max(max_x - min_x, 1e-100), size_y = std::max(max_y - min_y, 1e-100);
+        scale = (1.0 - 2 * margin) * std::min(width / size_x, height / size_y);
+        offset_x = 0.5 * width - scale * 0.5 * (min_x + max_x);
+        offset_y = 0.5 * height + scale * 0.5 * (min_y + max_y);
+
+        memset(pixels, 0xff, 3 * width * height);
+      }
+
+      void ImageRenderer::fill_triangles(const double2* pixel_verts, const int3* tris, int num_tris, const double* t, const unsigned char* tri_colors)
+      {
+        int num_threads_used = std::min(Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads), height);
+        int num_bands = std::max(num_threads_used, 1);
+        int band_i;
+
+        // Every thread fills a horizontal band of the image, i.e. its own pixels.
+#pragma omp parallel for schedule(static) private(band_i) num_threads(num_threads_used)
+        for(band_i = 0; band_i < num_bands; band_i++)
+        {
+          int band_start = (int)(((long long)height * band_i) / num_bands);
+          int band_end = (int)(((long long)height * (band_i + 1)) / num_bands);
+          unsigned char palette_color[3];
+
+          for(int i = 0; i < num_tris; i++)
+          {
+            const double* a = pixel_verts[tris[i][0]];
+            const double* b = pixel_verts[tris[i][1]];
+            const double* c = pixel_verts[tris[i][2]];
+
+            if(t != NULL && !(finite(t[tris[i][0]]) && finite(t[tris[i][1]]) && finite(t[tris[i][2]])))
+              continue;
+
+            // the pixels whose centers are covered
+            int y_min = std::max(band_start, (int)ceil(std::min(a[1], std::min(b[1], c[1])) - 0.5));
+            int y_max = std::min(band_end - 1, (int)floor(std::max(a[1], std::max(b[1], c[1])) - 0.5));
+            if(y_min > y_max)
+              continue;
+            int x_min = std::max(0, (int)ceil(std::min(a[0], std::min(b[0], c[0])) - 0.5));
+            int x_max = std::min(width - 1, (int)floor(std::max(a[0], std::max(b[0], c[0])) - 0.5));
+            if(x_min > x_max)
+              continue;
+
+            double area = (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+            if(area == 0.0 || !finite(area))
+              continue;
+            double inv_area = 1.0 / area;
+
+            for(int y = y_min; y <= y_max; y++)
+            {
+              double py = y + 0.5;
+              unsigned char* row = pixels + 3 * width * y;
+              for(int x = x_min; x <= x_max; x++)
+              {
+                double px = x + 0.5;
+                // the barycentric coordinates
+                double l_a = ((b[0] - px) * (c[1] - py) - (b[1] - py) * (c[0] - px)) * inv_area;
+                double l_b = ((c[0] - px) * (a[1] - py) - (c[1] - py) * (a[0] - px)) * inv_area;
+                double l_c = 1.0 - l_a - l_b;
+                if(l_a < 0.0 || l_b < 0.0 || l_c < 0.0)
+                  continue;
+
+                const unsigned char* color;
+                if(t != NULL)
+                {
+                  get_palette_color(l_a * t[tris[i][0]] + l_b * t[tris[i][1]] + l_c * t[tris[i][2]], palette_color);
+                  color = palette_color;
+                }
+                else
+                  color = tri_colors + 3 * i;
+                memcpy(row + 3 * x, color, 3);
+              }
+            }
+          }
+        }
+      }
+
+      void ImageRenderer::draw_edges(const double2* pixel_verts, const int2* edges, const int* edge_markers, int num_edges)
+      {
+        for(int i = 0; i < num_edges; i++)
+        {
+          if(edge_markers != NULL && edge_markers[i] == 0)
+            continue;
+
+          // Bresenham
+          int x0 = (int)floor(pixel_verts[edges[i][0]][0]), y0 = (int)floor(pixel_verts[edges[i][0]][1]);
+          int x1 = (int)floor(pixel_verts[edges[i][1]][0]), y1 = (int)floor(pixel_verts[edges[i][1]][1]);
+          int dx = abs(x1 - x0), dy = -abs(y1 - y0);
+          int sx = x0 < x1 ? 1 : -1, sy = y0 < y1 ? 1 : -1;
+          int err = dx + dy;
+          while(true)
+          {
+            if(x0 >= 0 && x0 < width && y0 >= 0 && y0 < height)
+              memcpy(pixels + 3 * (width * y0 + x0), edges_color, 3);
+            if(x0 == x1 && y0 == y1)
+              break;
+            int e2 = 2 * err;
+            if(e2 >= dy)
+            {
+              err += dy;
+              x0 += sx;
+            }
+            if(e2 <= dx)
+            {
+              err += dx;
+              y0 += sy;
+            }
+          }
+        }
+      }
+
+      void ImageRenderer::render(Linearizer* lin)
+      {
+        lin->lock_data();
+        double2* pixel_verts = NULL;
+        double* t = NULL;
+        try
+        {
+          double min_x, max_x, min_y, max_y;
+          lin->calc_vertices_aabb(&min_x, &max_x, &min_y, &max_y);
+          begin(min_x, max_x, min_y, max_y);
+
+          // the range of the values, as in the ScalarView
+          double min = range_min, max = range_max;
+          if(range_auto)
+          {
+            min = lin->get_min_value();
+            max = lin->get_max_value();
+            if(max - min < 1e-8)
+              min -= 0.5;
+          }
+          double irange = (fabs(max - min) < 1e-8) ? 1.0 : 1.0 / (max - min);
+
+          int num_verts = lin->get_num_vertices();
+          double3* verts = lin->get_vertices();
+          pixel_verts = new double2[num_verts];
+          t = new double[num_verts];
+          for(int i = 0; i < num_verts; i++)
+          {
+            pixel_verts[i][0] = offset_x + scale * verts[i][0];
+            pixel_verts[i][1] = offset_y - scale * verts[i][1];
+            t[i] = (verts[i][2] - min) * irange;
+          }
+
+          fill_triangles(pixel_verts, lin->get_triangles(), lin->get_num_triangles(), t, NULL);
+          draw_edges(pixel_verts, lin->get_edges(), b_show_edges ? NULL : lin->get_edge_markers(), lin->get_num_edges());
+        }
+        catch(Hermes::Exceptions::Exception&)
+        {
+          delete [] pixel_verts;
+          delete [] t;
+          lin->unlock_data();
+          throw;
+        }
+        delete [] pixel_verts;
+        delete [] t;
+        lin->unlock_data();
+      }
+
+      void ImageRenderer::render(Vectorizer* vec)
+      {
+        vec->lock_data();
+        double2* pixel_verts = NULL;
+        double* t = NULL;
+        try
+        {
+          double min_x, max_x, min_y, max_y;
+          vec->calc_vertices_aabb(&min_x, &max_x, &min_y, &max_y);
+          begin(min_x, max_x, min_y, max_y);
+
+          // the range of the magnitudes, as in the VectorView
+          double min = range_min, max = range_max;
+          if(range_auto)
+          {
+            min = vec->get_min_value();
+            max = vec->get_max_value();
+          }
+          double irange = 1.0 / (max - min);
+          if(fabs(max - min) < 1e-8)
+          {
+            irange = 1.0;
+            min -= 0.5;
+          }
+
+          int num_verts = vec->get_num_vertices();
+          double4* verts = vec->get_vertices();
+          pixel_verts = new double2[num_verts];
+          t = new double[num_verts];
+          for(int i = 0; i < num_verts; i++)
+          {
+            pixel_verts[i][0] = offset_x + scale * verts[i][0];
+            pixel_verts[i][1] = offset_y - scale * verts[i][1];
+            t[i] = (sqrt(sqr(verts[i][2]) + sqr(verts[i][3])) - min) * irange;
+          }
+
+          fill_triangles(pixel_verts, vec->get_triangles(), vec->get_num_triangles(), t, NULL);
+          draw_edges(pixel_verts, vec->get_edges(), b_show_edges ? NULL : vec->get_edge_markers(), vec->get_num_edges());
+        }
+        catch(Hermes::Exceptions::Exception&)
+        {
+          delete [] pixel_verts;
+          delete [] t;
+          vec->unlock_data();
+          throw;
+        }
+        delete [] pixel_verts;
+        delete [] t;
+        vec->unlock_data();
+      }
+
+      void ImageRenderer::render(Orderizer* ord)
+      {
+        ord->lock_data();
+        double2* pixel_verts = NULL;
+        unsigned char* tri_colors = NULL;
+        try
+        {
+          double min_x, max_x, min_y, max_y;
+          ord->calc_vertices_aabb(&min_x, &max_x, &min_y, &max_y);
+          begin(min_x, max_x, min_y, max_y);
+
+          int num_verts = ord->get_num_vertices();
+          double3* verts = ord->get_vertices();
+          pixel_verts = new double2[num_verts];
+          for(int i = 0; i < num_verts; i++)
+          {
+            pixel_verts[i][0] = offset_x + scale * verts[i][0];
+            pixel_verts[i][1] = offset_y - scale * verts[i][1];
+          }
+
+          // a triangle has the color of the order of its first vertex, as in the OrderView
+          int num_tris = ord->get_num_triangles();
+          int3* tris = ord->get_triangles();
+          tri_colors = new unsigned char[3 * num_tris];
+          for(int i = 0; i < num_tris; i++)
+          {
+            int order = std::max(0, std::min(image_max_order, (int)verts[tris[i][0]][2]));
+            if(pal_type == H2DV_PT_DEFAULT)
+            {
+              tri_colors[3 * i] = (unsigned char)(image_order_palette[order] >> 16);
+              tri_colors[3 * i + 1] = (unsigned char)((image_order_palette[order] >> 8) & 0xff);
+              tri_colors[3 * i + 2] = (unsigned char)(image_order_palette[order] & 0xff);
+            }
+            else
+              get_palette_color(order / (double)image_max_order, tri_colors + 3 * i);
+          }
+
+          fill_triangles(pixel_verts, tris, num_tris, NULL, tri_colors);
+          draw_edges(pixel_verts, ord->get_edges(), NULL, ord->get_num_edges());
+        }
+        catch(Hermes::Exceptions::Exception&)
+        {
+          delete [] pixel_verts;
+          delete [] tri_colors;
+          ord->unlock_data();
+          throw;
+        }
+        delete [] pixel_verts;
+        delete [] tri_colors;
+        ord->unlock_data();
+      }
+
+      void ImageRenderer::render(MeshFunction<double>* sln, int item, double eps)
+      {
+        lin.process_solution(sln, item, eps);
+        render(&lin);
+      }
+
+      void ImageRenderer::save_png(const char* file_name) const
+      {
+        FILE* file = fopen(file_name, "wb");
+        if(file == NULL)
+          throw Exceptions::Exception("Could not open %s for writing.", file_name);
+
+        static const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+        fwrite(signature, 1, 8, file);
+
+        std::vector<unsigned char> header;
+        png_put_uint32(header, width);
+        png_put_uint32(header, height);
+        // 8 bits per channel, RGB, deflate, adaptive filtering, no interlace
+        header.push_back(8);
+        header.push_back(2);
+        header.push_back(0);
+        header.push_back(0);
+        header.push_back(0);
+        png_write_chunk(file, "IHDR", header);
+
+        // the rows with the filter type 0 (none)
+        size_t row_size = 3 * width + 1;
+        unsigned char* raw = new unsigned char[row_size * height];
+        for(int y = 0; y < height; y++)
+        {
+          raw[row_size * y] = 0;
+          memcpy(raw + row_size * y + 1, pixels + 3 * width * y, 3 * width);
+        }
+        std::vector<unsigned char> data;
+        zlib_compress(raw, row_size * height, data);
+        delete [] raw;
+        png_write_chunk(file, "IDAT", data);
+
+        png_write_chunk(file, "IEND", std::vector<unsigned char>());
+
+        if(ferror(file))
+        {
+          fclose(file);
+          throw Exceptions::Exception("Writing of %s failed.", file_name);
+        }
+        fclose(file);
+        this->info("Image saved to %s.", file_name);
+      }
+
+      void ImageRenderer::save_numbered_png(const char* format, int number) const
+      {
+        char buffer[1000];
+        sprintf(buffer, format, number);
+        save_png(buffer);
+      }
+    }
+  }
+}
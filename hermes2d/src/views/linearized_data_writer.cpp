@@ -0,0 +1,391 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "linearized_data_writer.h"
+#include <sstream>
+
+#ifdef WITH_HDF5
+#include <hdf5.h>
+#endif
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    namespace Views
+    {
+      LinearizedDataWriter::LinearizedDataWriter(const char* file_name, Format format, bool time_series) : file_name(file_name), format(format),
+        time_series(time_series), step_open(false), num_points(0), points(NULL), num_triangles(0), triangles(NULL), num_steps(0)
+      {
+#ifdef WITH_HDF5
+        h5_file = -1;
+#else
+        if(format == XDMF_HDF5)
+          throw Hermes::Exceptions::Exception("hermes2d was not compiled with HDF5 support");
+#endif
+      }
+
+      LinearizedDataWriter::~LinearizedDataWriter()
+      {
+        if(step_open)
+        {
+          try
+          {
+            end_step();
+          }
+          catch(Hermes::Exceptions::Exception& e)
+          {
+            this->warn("The last step of %s could not be written: %s", file_name.c_str(), e.what());
+            free_step();
+          }
+        }
+#ifdef WITH_HDF5
+        if(h5_file >= 0)
+          H5Fclose((hid_t)h5_file);
+#endif
+      }
+
+      int LinearizedDataWriter::get_num_steps() const
+      {
+        return num_steps;
+      }
+
+      void LinearizedDataWriter::free_step()
+      {
+        delete [] points;
+        points = NULL;
+        delete [] triangles;
+        triangles = NULL;
+        for(unsigned int i = 0; i < arrays.size(); i++)
+        {
+          delete [] arrays[i].values;
+          delete [] arrays[i].int_values;
+        }
+        arrays.clear();
+        step_open = false;
+      }
+
+      void LinearizedDataWriter::begin_step(double time, int num_points, const double* x, const double* y, const double* z, int point_stride,
+        int num_triangles, const int3* triangles)
+      {
+        if(step_open)
+          end_step();
+
+        this->step_time = time;
+        this->num_points = num_points;
+        this->points = new double[3 * num_points];
+        for(int i = 0; i < num_points; i++)
+        {
+          this->points[3 * i] = x[i * point_stride];
+          this->points[3 * i + 1] = y[i * point_stride];
+          this->points[3 * i + 2] = (z == NULL) ? 0.0 : z[i * point_stride];
+        }
+        this->num_triangles = num_triangles;
+        this->triangles = new int[3 * num_triangles];
+        memcpy(this->triangles, triangles, 3 * num_triangles * sizeof(int));
+        step_open = true;
+      }
+
+      void LinearizedDataWriter::add_point_field(const char* name, int num_components, const double* const* components, int stride)
+      {
+        if(!step_open)
+          throw Hermes::Exceptions::Exception("No step has been started in LinearizedDataWriter::add_point_field().");
+        if(num_components < 1 || num_components > 3)
+          throw Hermes::Exceptions::ValueException("num_components", num_components, 1, 3);
+
+        DataArray array;
+        array.name = name;
+        array.num_components = (num_components == 1) ? 1 : 3;
+        array.point_data = true;
+        array.values = new double[array.num_components * num_points];
+        array.int_values = NULL;
+        for(int i = 0; i < num_points; i++)
+          for(int c = 0; c < array.num_components; c++)
+            array.values[array.num_components * i + c] = (c < num_components) ? components[c][i * stride] : 0.0;
+        arrays.push_back(array);
+      }
+
+      void LinearizedDataWriter::add_cell_field(const char* name, const int* values)
+      {
+        if(!step_open)
+          throw Hermes::Exceptions::Exception("No step has been started in LinearizedDataWriter::add_cell_field().");
+
+        DataArray array;
+        array.name = name;
+        array.num_components = 1;
+        array.point_data = false;
+        array.values = NULL;
+        array.int_values = new int[num_triangles];
+        memcpy(array.int_values, values, num_triangles * sizeof(int));
+        arrays.push_back(array);
+      }
+
+      void LinearizedDataWriter::end_step()
+      {
+        if(!step_open)
+          throw Hermes::Exceptions::Exception("No step has been started in LinearizedDataWriter::end_step().");
+
+        try
+        {
+          if(format == VTU_BINARY)
+            write_vtu();
+          else
+            write_xdmf();
+        }
+        catch(Hermes::Exceptions::Exception&)
+        {
+          free_step();
+          throw;
+        }
+        free_step();
+        num_steps++;
+      }
+
+      /// Writes the index file (pvd, xmf) from its entries.
+      static void write_index_file(const std::string& index_file_name, const char* header, const std::vector<std::string>& entries, const char* footer)
+      {
+        FILE* f = fopen(index_file_name.c_str(), "w");
+        if(f == NULL)
+          throw Hermes::Exceptions::Exception("Could not open %s for writing.", index_file_name.c_str());
+        fputs(header, f);
+        for(unsigned int i = 0; i < entries.size(); i++)
+          fputs(entries[i].c_str(), f);
+        fputs(footer, f);
+        fclose(f);
+      }
+
+      /// The file name without the directories, the references among the files are relative.
+      static std::string base_name(const std::string& file_name)
+      {
+        size_t slash = file_name.find_last_of("/\\");
+        return (slash == std::string::npos) ? file_name : file_name.substr(slash + 1);
+      }
+
+      void LinearizedDataWriter::write_vtu()
+      {
+        std::stringstream vtu_name;
+        vtu_name << file_name;
+        if(time_series)
+          vtu_name << "_" << num_steps;
+        vtu_name << ".vtu";
+
+        // The cell offsets and types, the appended data has the fields, the points and the cells, in the order of the header.
+        int* offsets = new int[num_triangles];
+        unsigned char* types = new unsigned char[num_triangles];
+        for(int i = 0; i < num_triangles; i++)
+        {
+          offsets[i] = 3 * (i + 1);
+          types[i] = 5; // VTK_TRIANGLE
+        }
+
+        int one = 1;
+        const char* byte_order = (*(char*)&one == 1) ? "LittleEndian" : "BigEndian";
+
+        std::stringstream header;
+        uint64_t offset = 0;
+        header << "<?xml version=\"1.0\"?>\n";
+        header << "<VTKFile type=\"UnstructuredGrid\" version=\"1.0\" byte_order=\"" << byte_order << "\" header_type=\"UInt64\">\n";
+        header << "  <UnstructuredGrid>\n";
+        header << "    <Piece NumberOfPoints=\"" << num_points << "\" NumberOfCells=\"" << num_triangles << "\">\n";
+
+        header << "      <PointData>\n";
+        for(unsigned int i = 0; i < arrays.size(); i++)
+          if(arrays[i].point_data)
+          {
+            header << "        <DataArray type=\"Float64\" Name=\"" << arrays[i].name << "\" NumberOfComponents=\"" << arrays[i].num_components
+              << "\" format=\"appended\" offset=\"" << offset << "\"/>\n";
+            offset += sizeof(uint64_t) + arrays[i].num_components * num_points * sizeof(double);
+          }
+        header << "      </PointData>\n";
+
+        header << "      <CellData>\n";
+        for(unsigned int i = 0; i < arrays.size(); i++)
+          if(!arrays[i].point_data)
+          {
+            header << "        <DataArray type=\"Int32\" Name=\"" << arrays[i].name << "\" format=\"appended\" offset=\"" << offset << "\"/>\n";
+            offset += sizeof(uint64_t) + num_triangles * sizeof(int);
+          }
+        header << "      </CellData>\n";
+
+        header << "      <Points>\n";
+        header << "        <DataArray type=\"Float64\" NumberOfComponents=\"3\" format=\"appended\" offset=\"" << offset << "\"/>\n";
+        offset += sizeof(uint64_t) + 3 * num_points * sizeof(double);
+        header << "      </Points>\n";
+
+        header << "      <Cells>\n";
+        header << "        <DataArray type=\"Int32\" Name=\"connectivity\" format=\"appended\" offset=\"" << offset << "\"/>\n";
+        offset += sizeof(uint64_t) + 3 * num_triangles * sizeof(int);
+        header << "        <DataArray type=\"Int32\" Name=\"offsets\" format=\"appended\" offset=\"" << offset << "\"/>\n";
+        offset += sizeof(uint64_t) + num_triangles * sizeof(int);
+        header << "        <DataArray type=\"UInt8\" Name=\"types\" format=\"appended\" offset=\"" << offset << "\"/>\n";
+        header << "      </Cells>\n";
+
+        header << "    </Piece>\n";
+        header << "  </UnstructuredGrid>\n";
+        header << "  <AppendedData encoding=\"raw\">\n   _";
+
+        FILE* f = fopen(vtu_name.str().c_str(), "wb");
+        if(f == NULL)
+        {
+          delete [] offsets;
+          delete [] types;
+          throw Hermes::Exceptions::Exception("Could not open %s for writing.", vtu_name.str().c_str());
+        }
+        fputs(header.str().c_str(), f);
+
+        // Every array is preceded by its size in bytes, in the order of the header.
+        uint64_t size;
+        for(unsigned int i = 0; i < arrays.size(); i++)
+          if(arrays[i].point_data)
+          {
+            size = arrays[i].num_components * num_points * sizeof(double);
+            fwrite(&size, sizeof(uint64_t), 1, f);
+            fwrite(arrays[i].values, 1, size, f);
+          }
+        for(unsigned int i = 0; i < arrays.size(); i++)
+          if(!arrays[i].point_data)
+          {
+            size = num_triangles * sizeof(int);
+            fwrite(&size, sizeof(uint64_t), 1, f);
+            fwrite(arrays[i].int_values, 1, size, f);
+          }
+        size = 3 * num_points * sizeof(double);
+        fwrite(&size, sizeof(uint64_t), 1, f);
+        fwrite(points, 1, size, f);
+        size = 3 * num_triangles * sizeof(int);
+        fwrite(&size, sizeof(uint64_t), 1, f);
+        fwrite(triangles, 1, size, f);
+        size = num_triangles * sizeof(int);
+        fwrite(&size, sizeof(uint64_t), 1, f);
+        fwrite(offsets, 1, size, f);
+        size = num_triangles * sizeof(unsigned char);
+        fwrite(&size, sizeof(uint64_t), 1, f);
+        fwrite(types, 1, size, f);
+
+        fputs("\n  </AppendedData>\n</VTKFile>\n", f);
+        bool failed = (ferror(f) != 0);
+        fclose(f);
+        delete [] offsets;
+        delete [] types;
+        if(failed)
+          throw Hermes::Exceptions::Exception("Writing of %s failed.", vtu_name.str().c_str());
+
+        if(time_series)
+        {
+          std::stringstream entry;
+          entry << "    <DataSet timestep=\"" << step_time << "\" part=\"0\" file=\"" << base_name(vtu_name.str()) << "\"/>\n";
+          index_entries.push_back(entry.str());
+          write_index_file(file_name + ".pvd", "<?xml version=\"1.0\"?>\n<VTKFile type=\"Collection\" version=\"0.1\">\n  <Collection>\n",
+            index_entries, "  </Collection>\n</VTKFile>\n");
+        }
+      }
+
+#ifdef WITH_HDF5
+      /// Writes a dataset of count x num_components values.
+      static void write_dataset(hid_t group, const char* name, hid_t type, int count, int num_components, const void* data)
+      {
+        hsize_t dims[2] = { (hsize_t)count, (hsize_t)num_components };
+        hid_t space = H5Screate_simple(num_components == 1 ? 1 : 2, dims, NULL);
+        hid_t set = H5Dcreate2(group, name, type, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        herr_t status = (set < 0) ? -1 : H5Dwrite(set, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, data);
+        if(set >= 0)
+          H5Dclose(set);
+        H5Sclose(space);
+        if(status < 0)
+          throw Hermes::Exceptions::Exception("The HDF5 dataset %s could not be written.", name);
+      }
+#endif
+
+      void LinearizedDataWriter::write_xdmf()
+      {
+#ifdef WITH_HDF5
+        std::string h5_name = file_name + ".h5";
+        // A single step replaces the whole file, a time series grows.
+        if(!time_series || h5_file < 0)
+        {
+          if(h5_file >= 0)
+            H5Fclose((hid_t)h5_file);
+          h5_file = H5Fcreate(h5_name.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+          if(h5_file < 0)
+            throw Hermes::Exceptions::Exception("Could not open %s for writing.", h5_name.c_str());
+        }
+        int step = time_series ? num_steps : 0;
+
+        std::stringstream group_name;
+        group_name << "/step_" << step;
+        hid_t group = H5Gcreate2((hid_t)h5_file, group_name.str().c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        if(group < 0)
+          throw Hermes::Exceptions::Exception("The HDF5 group %s could not be created.", group_name.str().c_str());
+
+        std::string h5_path = base_name(h5_name) + ":" + group_name.str() + "/";
+        std::stringstream entry;
+        entry << "      <Grid Name=\"step_" << step << "\" GridType=\"Uniform\">\n";
+        entry << "        <Time Value=\"" << step_time << "\"/>\n";
+        entry << "        <Topology TopologyType=\"Triangle\" NumberOfElements=\"" << num_triangles << "\">\n";
+        entry << "          <DataItem Dimensions=\"" << num_triangles << " 3\" NumberType=\"Int\" Precision=\"4\" Format=\"HDF\">" << h5_path << "triangles</DataItem>\n";
+        entry << "        </Topology>\n";
+        entry << "        <Geometry GeometryType=\"XYZ\">\n";
+        entry << "          <DataItem Dimensions=\"" << num_points << " 3\" NumberType=\"Float\" Precision=\"8\" Format=\"HDF\">" << h5_path << "points</DataItem>\n";
+        entry << "        </Geometry>\n";
+
+        try
+        {
+          write_dataset(group, "points", H5T_NATIVE_DOUBLE, num_points, 3, points);
+          write_dataset(group, "triangles", H5T_NATIVE_INT, num_triangles, 3, triangles);
+          for(unsigned int i = 0; i < arrays.size(); i++)
+          {
+            int count = arrays[i].point_data ? num_points : num_triangles;
+            entry << "        <Attribute Name=\"" << arrays[i].name << "\" AttributeType=\"" << (arrays[i].num_components == 1 ? "Scalar" : "Vector")
+              << "\" Center=\"" << (arrays[i].point_data ? "Node" : "Cell") << "\">\n";
+            entry << "          <DataItem Dimensions=\"" << count;
+            if(arrays[i].num_components > 1)
+              entry << " " << arrays[i].num_components;
+            if(arrays[i].point_data)
+            {
+              entry << "\" NumberType=\"Float\" Precision=\"8\" Format=\"HDF\">";
+              write_dataset(group, arrays[i].name.c_str(), H5T_NATIVE_DOUBLE, count, arrays[i].num_components, arrays[i].values);
+            }
+            else
+            {
+              entry << "\" NumberType=\"Int\" Precision=\"4\" Format=\"HDF\">";
+              write_dataset(group, arrays[i].name.c_str(), H5T_NATIVE_INT, count, 1, arrays[i].int_values);
+            }
+            entry << h5_path << arrays[i].name << "</DataItem>\n";
+            entry << "        </Attribute>\n";
+          }
+        }
+        catch(Hermes::Exceptions::Exception&)
+        {
+          H5Gclose(group);
+          throw;
+        }
+        entry << "      </Grid>\n";
+        H5Gclose(group);
+        H5Fflush((hid_t)h5_file, H5F_SCOPE_GLOBAL);
+        if(!time_series)
+        {
+          H5Fclose((hid_t)h5_file);
+          h5_file = -1;
+          index_entries.clear();
+        }
+
+        index_entries.push_back(entry.str());
+        write_index_file(file_name + ".xmf", "<?xml version=\"1.0\" ?>\n<Xdmf Version=\"2.0\">\n  <Domain>\n    <Grid Name=\"TimeSeries\" GridType=\"Collection\" CollectionType=\"Temporal\">\n",
+          index_entries, "    </Grid>\n  </Domain>\n</Xdmf>\n");
+#endif
+      }
+    }
+  }
+}
@@ -18,6 +18,8 @@
 #include "traverse.h"
 #include "exact_solution.h"
 #include "api2d.h"
+#include <algorithm>
+#include <queue>
 
 namespace Hermes
 {
@@ -111,6 +113,14 @@ namespace Hermes
         ydisp = NULL;
         user_ydisp = false;
         tris_contours = NULL;
+        frozen_subdivision = recording = replaying = false;
+        split_codes = vertex_indices = NULL;
+        split_codes_count = split_codes_size = vertex_indices_count = vertex_indices_size = 0;
+        pattern_num_states = -1;
+        state_split_start = state_vertex_start = NULL;
+        split_cursor = vertex_cursor = NULL;
+        decimation_max_triangles = 0;
+        decimation_tolerance = 0.0;
       }
 
       void Linearizer::process_triangle(MeshFunction<double>** fns, int iv0, int iv1, int iv2, int level,
@@ -126,11 +136,10 @@ namespace Hermes
             // obtain solution values
             fns[0]->set_quad_order(1, item);
             val = fns[0]->get_values(component, value_type);
-            if(auto_max)
+            if(auto_max && !replaying)
               for (i = 0; i < lin_np_tri[1]; i++)
               {
                 double v = val[i];
-#pragma omp critical(max)
                 if(finite(v) && fabs(v) > max)
                   max = fabs(v);
               }
@@ -175,7 +184,9 @@ namespace Hermes
 
           // determine whether or not to split the element
           bool split;
-          if(eps >= 1.0)
+          if(replaying)
+            split = (split_codes[split_cursor[omp_get_thread_num()]++] != 0);
+          else if(eps >= 1.0)
           {
             // if eps > 1, the user wants a fixed number of refinements (no adaptivity)
             split = ((level + 5) < eps);
@@ -215,6 +226,8 @@ namespace Hermes
                 fabs(val[4] - 0.5*(midval[2][2] + midval[2][0]))) > max*3*eps;
             }
           }
+          if(recording)
+            record_split(split ? 1 : 0);
 
           // split the triangle if the error is too large, otherwise produce a linear triangle
           if(split)
@@ -255,7 +268,8 @@ namespace Hermes
         }
 
         // no splitting: output a linear triangle
-        add_triangle(iv0, iv1, iv2, fns[0]->get_active_element()->marker);
+        if(!replaying)
+          add_triangle(iv0, iv1, iv2, fns[0]->get_active_element()->marker);
       }
 
       void Linearizer::set_curvature_epsilon(double curvature_epsilon)
@@ -323,18 +337,16 @@ namespace Hermes
             // obtain solution values
             fns[0]->set_quad_order(1, item);
             val = fns[0]->get_values(component, value_type);
-            if(auto_max)
+            if(auto_max && !replaying)
               for (i = 0; i < lin_np_quad[1]; i++)
               {
                 double v = val[i];
                 if(finite(v) && fabs(v) > max)
-#pragma omp critical(max)
-                  if(finite(v) && fabs(v) > max)
-                    max = fabs(v);
+                  max = fabs(v);
               }
 
               // This is just to make some sense.
-              if(fabs(max) < 1E-10)
+              if(!replaying && fabs(max) < 1E-10)
                 max = 1E-10;
 
               idx = quad_indices[0];
@@ -381,7 +393,9 @@ namespace Hermes
 
           // determine whether or not to split the element
           int split;
-          if(eps >= 1.0)
+          if(replaying)
+            split = split_codes[split_cursor[omp_get_thread_num()]++];
+          else if(eps >= 1.0)
           {
             // if eps > 1, the user wants a fixed number of refinements (no adaptivity)
             split = (level < eps) ? 3 : 0;
@@ -431,6 +445,8 @@ namespace Hermes
                 fabs(val[9]  - 0.5*(midval[2][3] + midval[2][0]))) > max*4*eps) ? 3 : 0;
             }
           }
+          if(recording)
+            record_split(split);
 
           // split the quad if the error is too large, otherwise produce two linear triangles
           if(split)
@@ -498,6 +514,8 @@ namespace Hermes
         }
 
         // output two linear triangles,
+        if(replaying)
+          return;
         if(!flip)
         {
           add_triangle(iv3, iv0, iv1, fns[0]->get_active_element()->marker);
@@ -519,6 +537,158 @@ namespace Hermes
         this->dmult = dmult;
       }
 
+      void Linearizer::init_arrays(int num_elements, int num_vertices, int num_triangles, int num_edges)
+      {
+        //    sizes.
+        this->vertex_size = std::max(std::max(100 * num_elements, num_vertices), std::max(this->vertex_size, 50000));
+        this->triangle_size = std::max(std::max(150 * num_elements, num_triangles), std::max(this->triangle_size, 75000));
+        this->edges_size = std::max(std::max(100 * num_elements, num_edges), std::max(this->edges_size, 50000));
+        //    counts.
+        this->vertex_count = 0;
+        this->triangle_count = 0;
+        this->edges_count = 0;
+        this->del_slot = -1;
+        //    reuse or allocate vertex, triangle and edge arrays.
+        this->verts = (double3*) realloc(this->verts, sizeof(double3) * this->vertex_size);
+        this->tris = (int3*) realloc(this->tris, sizeof(int3) * this->triangle_size);
+        this->tri_markers = (int*) realloc(this->tri_markers, sizeof(int) * this->triangle_size);
+        this->edges = (int2*) realloc(this->edges, sizeof(int2) * this->edges_size);
+        this->edge_markers = (int*) realloc(this->edge_markers, sizeof(int) * this->edges_size);
+        this->info = (int4*) realloc(this->info, sizeof(int4) * this->vertex_size);
+        this->empty = false;
+        //    initialize the hash table
+        this->hash_table = (int*) realloc(this->hash_table, sizeof(int) * this->vertex_size);
+        memset(this->hash_table, 0xff, sizeof(int) * this->vertex_size);
+      }
+
+      void Linearizer::process_element(MeshFunction<double>** fns)
+      {
+        Element* e = fns[0]->get_active_element();
+
+        fns[0]->set_quad_order(0, this->item);
+        double* val = fns[0]->get_values(component, value_type);
+        if(val == NULL)
+          throw Hermes::Exceptions::Exception("Item not defined in the solution in Linearizer::process_solution.");
+
+        if(xdisp != NULL)
+          fns[1]->set_quad_order(0, H2D_FN_VAL);
+        if(ydisp != NULL)
+          fns[xdisp == NULL ? 1 : 2]->set_quad_order(0, H2D_FN_VAL);
+
+        double *dx = NULL;
+        double *dy = NULL;
+        if(xdisp != NULL)
+          dx = fns[1]->get_fn_values();
+        if(ydisp != NULL)
+          dy = fns[xdisp == NULL ? 1 : 2]->get_fn_values();
+
+        int iv[H2D_MAX_NUMBER_VERTICES];
+        for (unsigned int i = 0; i < e->get_nvert(); i++)
+        {
+          double f = val[i];
+          double x_disp = fns[0]->get_refmap()->get_phys_x(0)[i];
+          double y_disp = fns[0]->get_refmap()->get_phys_y(0)[i];
+          if(this->xdisp != NULL)
+            x_disp += dmult * dx[i];
+          if(this->ydisp != NULL)
+            y_disp += dmult * dy[i];
+
+          iv[i] = this->get_vertex(-e->vn[i]->id, -e->vn[i]->id, x_disp, y_disp, f);
+        }
+        if(this->caughtException != NULL)
+          return;
+
+        // recur to sub-elements
+        if(e->is_triangle())
+          process_triangle(fns, iv[0], iv[1], iv[2], 0, NULL, NULL, NULL, NULL, e->is_curved());
+        else
+          process_quad(fns, iv[0], iv[1], iv[2], iv[3], 0, NULL, NULL, NULL, NULL, e->is_curved());
+
+        if(!replaying)
+          for (unsigned int i = 0; i < e->get_nvert(); i++)
+            process_edge(iv[i], iv[e->next_vert(i)], e->en[i]->marker);
+      }
+
+      void Linearizer::merge(Linearizer* worker)
+      {
+        int* vertex_map = new int[worker->vertex_count];
+        for (int i = 0; i < worker->vertex_count; i++)
+        {
+          // The element vertices have the keys (-id, -id), the parents of a mid-edge vertex precede it.
+          int p1 = worker->info[i][0], p2 = worker->info[i][1];
+          if(p1 != p2)
+          {
+            p1 = vertex_map[p1];
+            p2 = vertex_map[p2];
+          }
+          vertex_map[i] = this->get_vertex(p1, p2, worker->verts[i][0], worker->verts[i][1], worker->verts[i][2]);
+        }
+
+        for (int i = 0; i < worker->triangle_count; i++)
+          this->add_triangle(vertex_map[worker->tris[i][0]], vertex_map[worker->tris[i][1]], vertex_map[worker->tris[i][2]], worker->tri_markers[i]);
+
+        for (int i = 0; i < worker->edges_count; i++)
+          this->add_edge(vertex_map[worker->edges[i][0]], vertex_map[worker->edges[i][1]], worker->edge_markers[i]);
+
+        // the subdivision recorded by the worker (its states follow the ones of the previous workers)
+        if(worker->recording)
+        {
+          for (int i = 0; i < worker->split_codes_count; i++)
+            this->record_split(worker->split_codes[i]);
+          for (int i = 0; i < worker->vertex_indices_count; i++)
+            this->record_vertex(vertex_map[worker->vertex_indices[i]]);
+        }
+
+        delete [] vertex_map;
+      }
+
+      void Linearizer::replay_subdivision(MeshFunction<double>*** fns, Transformable*** trfs, Traverse::State** states, int num_states)
+      {
+        int num_threads_used = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
+        split_cursor = new int[num_threads_used];
+        vertex_cursor = new int[num_threads_used];
+        this->replaying = true;
+
+        int state_i;
+#pragma omp parallel shared(states) private(state_i) num_threads(num_threads_used)
+        {
+#pragma omp for schedule(static)
+          for(state_i = 0; state_i < num_states; state_i++)
+          {
+            if(this->caughtException != NULL)
+              continue;
+
+            try
+            {
+              split_cursor[omp_get_thread_num()] = state_split_start[state_i];
+              vertex_cursor[omp_get_thread_num()] = state_vertex_start[state_i];
+              TraverseStateList::set_active_state(states[state_i], trfs[omp_get_thread_num()]);
+              this->process_element(fns[omp_get_thread_num()]);
+            }
+            catch(Hermes::Exceptions::Exception& e)
+            {
+#pragma omp critical (caughtException)
+              if(this->caughtException == NULL)
+                this->caughtException = e.clone();
+            }
+            catch(std::exception& e)
+            {
+#pragma omp critical (caughtException)
+              if(this->caughtException == NULL)
+                this->caughtException = new Hermes::Exceptions::Exception(e.what());
+            }
+          }
+        }
+
+        this->replaying = false;
+        delete [] split_cursor;
+        split_cursor = NULL;
+        delete [] vertex_cursor;
+        vertex_cursor = NULL;
+        if(this->caughtException != NULL)
+          free_subdivision();
+      }
+
       void Linearizer::process_solution(MeshFunction<double>* sln, int item_, double eps)
       {
         // Important, sets the current caughtException to NULL.
@@ -531,6 +701,8 @@ namespace Hermes
         this->item = item_;
         this->eps = eps;
         //   get the component and desired value from item.
+        component = 0;
+        value_type = 0;
         if(item >= 0x40)
         {
           component = 1;
@@ -544,27 +716,6 @@ namespace Hermes
         //   reset the item to the value before the circus with component, value_type.
         this->item = item_;
 
-        // Initialization of computation stuff.
-        //    sizes.
-        this->vertex_size = std::max(100 * sln->get_mesh()->get_num_elements(), std::max(this->vertex_size, 50000));
-        this->triangle_size = std::max(150 * sln->get_mesh()->get_num_elements(), std::max(this->triangle_size, 75000));
-        this->edges_size = std::max(100 * sln->get_mesh()->get_num_elements(), std::max(this->edges_size, 50000));
-        //    counts.
-        this->vertex_count = 0;
-        this->triangle_count = 0;
-        this->edges_count = 0;
-        //    reuse or allocate vertex, triangle and edge arrays.
-        this->verts = (double3*) realloc(this->verts, sizeof(double3) * this->vertex_size);
-        this->tris = (int3*) realloc(this->tris, sizeof(int3) * this->triangle_size);
-        this->tri_markers = (int*) realloc(this->tri_markers, sizeof(int) * this->triangle_size);
-        this->edges = (int2*) realloc(this->edges, sizeof(int2) * this->edges_size);
-        this->edge_markers = (int*) realloc(this->edge_markers, sizeof(int) * this->edges_size);
-        this->info = (int4*) malloc(sizeof(int4) * this->vertex_size);
-        this->empty = false;
-        //    initialize the hash table
-        this->hash_table = (int*) malloc(sizeof(int) * this->vertex_size);
-        memset(this->hash_table, 0xff, sizeof(int) * this->vertex_size);
-
         // select the linearization quadratures
         Quad2D *old_quad, *old_quad_x = NULL, *old_quad_y = NULL;
         old_quad = sln->get_quad_2d();
@@ -583,8 +734,9 @@ namespace Hermes
           meshes.push_back(ydisp->get_mesh());
 
         // Parallelization
-        MeshFunction<double>*** fns = new MeshFunction<double>**[Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads)];
-        for(unsigned int i = 0; i < Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads); i++)
+        int num_threads_used = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
+        MeshFunction<double>*** fns = new MeshFunction<double>**[num_threads_used];
+        for(unsigned int i = 0; i < num_threads_used; i++)
         {
           fns[i] = new MeshFunction<double>*[3];
           fns[i][0] = sln->clone();
@@ -602,8 +754,8 @@ namespace Hermes
           }
         }
 
-        Transformable*** trfs = new Transformable**[Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads)];
-        for(unsigned int i = 0; i < Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads); i++)
+        Transformable*** trfs = new Transformable**[num_threads_used];
+        for(unsigned int i = 0; i < num_threads_used; i++)
         {
           trfs[i] = new Transformable*[3];
           trfs[i][0] = fns[i][0];
@@ -613,154 +765,166 @@ namespace Hermes
             trfs[i][xdisp == NULL ? 1 : 2] = fns[i][xdisp == NULL ? 1 : 2];
         }
 
-        Traverse trav_masterMax(true);
-        unsigned int num_states = trav_masterMax.get_num_states(meshes);
-
-        trav_masterMax.begin(meshes.size(), &(meshes.front()));
+        // Both passes go through the same states, these are kept for the next call if the meshes do not change.
+        bool states_changed = traverse_states.update(&(meshes.front()), meshes.size());
+        int num_states = traverse_states.get_num_states();
+        Traverse::State** states = traverse_states.get_states();
 
-        Traverse* trav = new Traverse[Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads)];
+        int state_i;
 
-        for(unsigned int i = 0; i < Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads); i++)
+        // The kept subdivision is used if it was recorded on the same states for the same item and eps.
+        if(!frozen_subdivision || states_changed || pattern_num_states != num_states || pattern_item != item_ || pattern_eps != eps)
+          free_subdivision();
+        else
         {
-          trav[i].begin(meshes.size(), &(meshes.front()), trfs[i]);
-          trav[i].stack = trav_masterMax.stack;
+          replay_subdivision(fns, trfs, states, num_states);
+
+          for(unsigned int i = 0; i < num_threads_used; i++)
+          {
+            for(unsigned int j = 0; j < (1 + (xdisp != NULL? 1 : 0) + (ydisp != NULL ? 1 : 0)); j++)
+              delete fns[i][j];
+            delete [] fns[i];
+            delete [] trfs[i];
+          }
+          delete [] fns;
+          delete [] trfs;
+
+          if(this->caughtException == NULL)
+            find_min_max();
+          this->unlock_data();
+
+          sln->set_quad_2d(old_quad);
+          if(user_xdisp)
+            xdisp->set_quad_2d(old_quad_x);
+          else
+            delete xdisp;
+          if(user_ydisp)
+            ydisp->set_quad_2d(old_quad_y);
+          else
+            delete ydisp;
+
+          if(this->caughtException != NULL)
+            throw *(this->caughtException);
+          return;
         }
 
-        int state_i;
+        // The maxima of the vertex values found by the threads.
+        double* thread_max = new double[num_threads_used];
+        for(int i = 0; i < num_threads_used; i++)
+          thread_max[i] = this->max;
 
 #define CHUNKSIZE 1
-        int num_threads_used = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
-#pragma omp parallel shared(trav_masterMax) private(state_i) num_threads(num_threads_used)
+#pragma omp parallel shared(states) private(state_i) num_threads(num_threads_used)
         {
 #pragma omp for schedule(static, CHUNKSIZE)
           for(state_i = 0; state_i < num_states; state_i++)
           {
             try
             {
-              Traverse::State current_state;
-#pragma omp critical(get_next_state)
-              current_state = trav[omp_get_thread_num()].get_next_state(&trav_masterMax.top, &trav_masterMax.id);
+              Traverse::State* current_state = states[state_i];
+              TraverseStateList::set_active_state(current_state, trfs[omp_get_thread_num()]);
 
               fns[omp_get_thread_num()][0]->set_quad_order(0, this->item);
               double* val = fns[omp_get_thread_num()][0]->get_values(component, value_type);
 
-              for (unsigned int i = 0; i < current_state.e[0]->get_nvert(); i++)
+              for (unsigned int i = 0; i < current_state->e[0]->get_nvert(); i++)
               {
                 double f = val[i];
-#pragma omp critical (max)
-                if(this->auto_max && finite(f) && fabs(f) > this->max)
-                  this->max = fabs(f);
+                if(this->auto_max && finite(f) && fabs(f) > thread_max[omp_get_thread_num()])
+                  thread_max[omp_get_thread_num()] = fabs(f);
               }
             }
             catch(Hermes::Exceptions::Exception& e)
             {
+#pragma omp critical (caughtException)
               if(this->caughtException == NULL)
                 this->caughtException = e.clone();
             }
             catch(std::exception& e)
             {
+#pragma omp critical (caughtException)
               if(this->caughtException == NULL)
                 this->caughtException = new Hermes::Exceptions::Exception(e.what());
             }
           }
         }
 
-        trav_masterMax.finish();
-        for(unsigned int i = 0; i < Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads); i++)
-          trav[i].finish();
-        delete [] trav;
-
-        Traverse trav_master(true);
-        num_states = trav_master.get_num_states(meshes);
+        for(int i = 0; i < num_threads_used; i++)
+          this->max = std::max(this->max, thread_max[i]);
+        delete [] thread_max;
 
-        trav_master.begin(meshes.size(), &(meshes.front()));
-
-        trav = new Traverse[Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads)];
-
-        for(unsigned int i = 0; i < Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads); i++)
+        // The workers, with a single thread the elements are linearized directly into this instance.
+        Linearizer** workers = new Linearizer*[num_threads_used];
+        if(num_threads_used == 1)
+        {
+          workers[0] = this;
+          this->init_arrays(sln->get_mesh()->get_num_elements());
+          this->recording = frozen_subdivision;
+        }
+        else
         {
-          trav[i].begin(meshes.size(), &(meshes.front()), trfs[i]);
-          trav[i].stack = trav_master.stack;
+          for(int i = 0; i < num_threads_used; i++)
+          {
+            workers[i] = new Linearizer(this->auto_max);
+            workers[i]->caughtException = this->caughtException;
+            workers[i]->item = this->item;
+            workers[i]->component = this->component;
+            workers[i]->value_type = this->value_type;
+            workers[i]->eps = this->eps;
+            workers[i]->max = this->max;
+            workers[i]->curvature_epsilon = this->curvature_epsilon;
+            workers[i]->xdisp = this->xdisp;
+            workers[i]->ydisp = this->ydisp;
+            workers[i]->user_xdisp = workers[i]->user_ydisp = true;
+            workers[i]->dmult = this->dmult;
+            workers[i]->recording = frozen_subdivision;
+            workers[i]->init_arrays(sln->get_mesh()->get_num_elements() / num_threads_used + 1);
+          }
+        }
+        //    the numbers of the split codes and of the vertices recorded for the states, turned into the starts later.
+        if(frozen_subdivision)
+        {
+          state_split_start = new int[num_states + 1];
+          state_vertex_start = new int[num_states + 1];
+          state_split_start[0] = state_vertex_start[0] = 0;
         }
 
-#pragma omp parallel shared(trav_master) private(state_i) num_threads(num_threads_used)
+        // The static schedule gives the threads contiguous parts of the states, i.e. few vertices on the boundaries of the parts.
+#pragma omp parallel shared(states) private(state_i) num_threads(num_threads_used)
         {
-#pragma omp for schedule(static, CHUNKSIZE)
+#pragma omp for schedule(static)
           for(state_i = 0; state_i < num_states; state_i++)
           {
-            if(this->caughtException != NULL)
+            Linearizer* worker = workers[omp_get_thread_num()];
+            if(worker->caughtException != NULL)
               continue;
 
             try
             {
-              Traverse::State current_state;
-
-#pragma omp critical (get_next_state)
-              current_state = trav[omp_get_thread_num()].get_next_state(&trav_master.top, &trav_master.id);
-
-              fns[omp_get_thread_num()][0]->set_quad_order(0, this->item);
-              double* val = fns[omp_get_thread_num()][0]->get_values(component, value_type);
-              if(val == NULL)
+              TraverseStateList::set_active_state(states[state_i], trfs[omp_get_thread_num()]);
+              int split_codes_start = worker->split_codes_count, vertex_indices_start = worker->vertex_indices_count;
+              worker->process_element(fns[omp_get_thread_num()]);
+              if(worker->recording)
               {
-                delete [] trav;
-                throw Hermes::Exceptions::Exception("Item not defined in the solution in Linearizer::process_solution.");
+                state_split_start[state_i + 1] = worker->split_codes_count - split_codes_start;
+                state_vertex_start[state_i + 1] = worker->vertex_indices_count - vertex_indices_start;
               }
-
-              if(xdisp != NULL)
-                fns[omp_get_thread_num()][1]->set_quad_order(0, H2D_FN_VAL);
-              if(ydisp != NULL)
-                fns[omp_get_thread_num()][xdisp == NULL ? 1 : 2]->set_quad_order(0, H2D_FN_VAL);
-
-              double *dx = NULL;
-              double *dy = NULL;
-              if(xdisp != NULL)
-                dx = fns[omp_get_thread_num()][1]->get_fn_values();
-              if(ydisp != NULL)
-                dy = fns[omp_get_thread_num()][xdisp == NULL ? 1 : 2]->get_fn_values();
-
-              int iv[H2D_MAX_NUMBER_VERTICES];
-              for (unsigned int i = 0; i < current_state.e[0]->get_nvert(); i++)
-              {
-                double f = val[i];
-                double x_disp = fns[omp_get_thread_num()][0]->get_refmap()->get_phys_x(0)[i];
-                double y_disp = fns[omp_get_thread_num()][0]->get_refmap()->get_phys_y(0)[i];
-                if(this->xdisp != NULL)
-                  x_disp += dmult * dx[i];
-                if(this->ydisp != NULL)
-                  y_disp += dmult * dy[i];
-
-                iv[i] = this->get_vertex(-fns[omp_get_thread_num()][0]->get_active_element()->vn[i]->id, -fns[omp_get_thread_num()][0]->get_active_element()->vn[i]->id, x_disp, y_disp, f);
-
-                if(this->caughtException != NULL)
-                  continue;
-              }
-
-              // recur to sub-elements
-              if(current_state.e[0]->is_triangle())
-                process_triangle(fns[omp_get_thread_num()], iv[0], iv[1], iv[2], 0, NULL, NULL, NULL, NULL, current_state.e[0]->is_curved());
-              else
-                process_quad(fns[omp_get_thread_num()], iv[0], iv[1], iv[2], iv[3], 0, NULL, NULL, NULL, NULL, current_state.e[0]->is_curved());
-
-              for (unsigned int i = 0; i < current_state.e[0]->get_nvert(); i++)
-                process_edge(iv[i], iv[current_state.e[0]->next_vert(i)], current_state.e[0]->en[i]->marker);
             }
             catch(Hermes::Exceptions::Exception& e)
             {
-              if(this->caughtException == NULL)
-                this->caughtException = e.clone();
+              if(worker->caughtException == NULL)
+                worker->caughtException = e.clone();
             }
             catch(std::exception& e)
             {
-              if(this->caughtException == NULL)
-                this->caughtException = new Hermes::Exceptions::Exception(e.what());
+              if(worker->caughtException == NULL)
+                worker->caughtException = new Hermes::Exceptions::Exception(e.what());
             }
           }
         }
 
-        trav_master.finish();
-        for(unsigned int i = 0; i < Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads); i++)
+        for(unsigned int i = 0; i < num_threads_used; i++)
         {
-          trav[i].finish();
           for(unsigned int j = 0; j < (1 + (xdisp != NULL? 1 : 0) + (ydisp != NULL ? 1 : 0)); j++)
             delete fns[i][j];
           delete [] fns[i];
@@ -768,21 +932,69 @@ namespace Hermes
         }
         delete [] fns;
         delete [] trfs;
-        delete [] trav;
 
-        // for contours, without regularization.
-        this->tris_contours = (int3*) realloc(this->tris_contours, sizeof(int3) * this->triangle_count);
-        memcpy(this->tris_contours, this->tris, this->triangle_count * sizeof(int3));
-        triangle_contours_count = this->triangle_count;
+        // merge the buffers of the workers
+        if(num_threads_used > 1)
+        {
+          int num_vertices = 0, num_triangles = 0, num_edges = 0;
+          for(int i = 0; i < num_threads_used; i++)
+          {
+            if(this->caughtException == NULL)
+              this->caughtException = workers[i]->caughtException;
+            this->max = std::max(this->max, workers[i]->max);
+            num_vertices += workers[i]->vertex_count;
+            num_triangles += workers[i]->triangle_count;
+            num_edges += workers[i]->edges_count;
+          }
+
+          // The hash table is not enlarged during the merge, see add_vertex().
+          this->init_arrays(sln->get_mesh()->get_num_elements(), num_vertices, num_triangles, num_edges);
+          for(int i = 0; i < num_threads_used; i++)
+          {
+            if(this->caughtException == NULL)
+              this->merge(workers[i]);
+            ::free(workers[i]->hash_table);
+            workers[i]->hash_table = NULL;
+            ::free(workers[i]->info);
+            workers[i]->info = NULL;
+            delete workers[i];
+          }
+        }
+        delete [] workers;
+        this->recording = false;
+
+        if(frozen_subdivision)
+        {
+          if(this->caughtException == NULL)
+          {
+            for(int i = 0; i < num_states; i++)
+            {
+              state_split_start[i + 1] += state_split_start[i];
+              state_vertex_start[i + 1] += state_vertex_start[i];
+            }
+            pattern_num_states = num_states;
+            pattern_item = item_;
+            pattern_eps = eps;
+          }
+          else
+            free_subdivision();
+        }
 
         if(this->caughtException != NULL)
         {
           this->unlock_data();
           ::free(hash_table);
+          hash_table = NULL;
           ::free(info);
+          info = NULL;
           throw *(this->caughtException);
         }
 
+        // for contours, without regularization.
+        this->tris_contours = (int3*) realloc(this->tris_contours, sizeof(int3) * this->triangle_count);
+        memcpy(this->tris_contours, this->tris, this->triangle_count * sizeof(int3));
+        triangle_contours_count = this->triangle_count;
+
         // regularize the linear mesh
         for (int i = 0; i < this->triangle_count; i++)
         {
@@ -800,6 +1012,9 @@ namespace Hermes
 
         find_min_max();
 
+        if(decimation_max_triangles > 0 || decimation_tolerance > 0.0)
+          decimate();
+
         this->unlock_data();
 
         // select old quadratrues
@@ -815,7 +1030,9 @@ namespace Hermes
 
         // clean up
         ::free(hash_table);
+        hash_table = NULL;
         ::free(info);
+        info = NULL;
       }
 
       void Linearizer::find_min_max()
@@ -832,31 +1049,40 @@ namespace Hermes
 
       int Linearizer::get_vertex(int p1, int p2, double x, double y, double value)
       {
+        // the vertex of the kept subdivision, only the coordinates and the value change
+        if(replaying)
+        {
+          int i = vertex_indices[vertex_cursor[omp_get_thread_num()]++];
+          verts[i][0] = x;
+          verts[i][1] = y;
+          verts[i][2] = value;
+          return i;
+        }
+
         // search for an existing vertex
         if(p1 > p2) std::swap(p1, p2);
         int index = this->hash(p1, p2);
-        int i = 0;
-        if(index < this->vertex_count)
+        int i = this->hash_table[index];
+        while (i >= 0)
         {
-          i = this->hash_table[index];
-          while (i >= 0 && i < this->vertex_count)
+          if(
+            this->info[i][0] == p1 && this->info[i][1] == p2 &&
+            (value == verts[i][2] || fabs(value - verts[i][2]) < this->max*1e-8) &&
+            (fabs(x - verts[i][0]) < 1e-8) &&
+            (fabs(y - verts[i][1]) < 1e-8)
+            )
           {
-            if(
-              this->info[i][0] == p1 && this->info[i][1] == p2 &&
-              (value == verts[i][2] || fabs(value - verts[i][2]) < this->max*1e-8) &&
-              (fabs(x - verts[i][0]) < 1e-8) &&
-              (fabs(y - verts[i][1]) < 1e-8)
-              )
-              return i;
-            // note that we won't return a vertex with a different value than the required one;
-            // this takes care for discontinuities in the solution, where more vertices
-            // with different values will be created
-            i = info[i][2];
+            if(recording)
+              record_vertex(i);
+            return i;
           }
+          // note that we won't return a vertex with a different value than the required one;
+          // this takes care for discontinuities in the solution, where more vertices
+          // with different values will be created
+          i = info[i][2];
         }
 
         // if not found, create a new one
-#pragma omp critical(realloc_vertices)
         try
         {
           i = add_vertex();
@@ -877,9 +1103,292 @@ namespace Hermes
         this->info[i][1] = p2;
         this->info[i][2] = hash_table[index];
         this->hash_table[index] = i;
+        if(recording)
+          record_vertex(i);
         return i;
       }
 
+      void Linearizer::record_split(int split)
+      {
+        if(split_codes_count >= split_codes_size)
+          split_codes = (int*) realloc(split_codes, sizeof(int) * (split_codes_size = std::max(2 * split_codes_size, 1024)));
+        split_codes[split_codes_count++] = split;
+      }
+
+      void Linearizer::record_vertex(int vertex)
+      {
+        if(vertex_indices_count >= vertex_indices_size)
+          vertex_indices = (int*) realloc(vertex_indices, sizeof(int) * (vertex_indices_size = std::max(2 * vertex_indices_size, 1024)));
+        vertex_indices[vertex_indices_count++] = vertex;
+      }
+
+      void Linearizer::free_subdivision()
+      {
+        ::free(split_codes);
+        split_codes = NULL;
+        ::free(vertex_indices);
+        vertex_indices = NULL;
+        split_codes_count = split_codes_size = vertex_indices_count = vertex_indices_size = 0;
+        delete [] state_split_start;
+        state_split_start = NULL;
+        delete [] state_vertex_start;
+        state_vertex_start = NULL;
+        pattern_num_states = -1;
+      }
+
+      void Linearizer::freeze_subdivision(bool freeze)
+      {
+        this->frozen_subdivision = freeze;
+        if(!freeze)
+          free_subdivision();
+      }
+
+      void Linearizer::set_decimation(int max_triangles, double tolerance)
+      {
+        if(max_triangles < 0)
+          throw Exceptions::ValueException("max_triangles", max_triangles, 0);
+        if(tolerance < 0.0)
+          throw Exceptions::ValueException("tolerance", tolerance, 0.0);
+        this->decimation_max_triangles = max_triangles;
+        this->decimation_tolerance = tolerance;
+      }
+
+      double Linearizer::collapse_error(int a, int b, const std::vector<std::vector<int> >& vertex_tris, const std::vector<double>& carried_error)
+      {
+        const std::vector<int>& fan = vertex_tris[a];
+
+        // the common neighbors, a closed fan of an inner vertex shares exactly two with any neighbor
+        int common = 0;
+        for(unsigned int i = 0; i < fan.size(); i++)
+          for(int j = 0; j < 3; j++)
+          {
+            int w = tris[fan[i]][j];
+            if(w == a || w == b)
+              continue;
+            bool neighbor_b = false;
+            for(unsigned int k = 0; k < vertex_tris[b].size() && !neighbor_b; k++)
+              neighbor_b = (tris[vertex_tris[b][k]][0] == w || tris[vertex_tris[b][k]][1] == w || tris[vertex_tris[b][k]][2] == w);
+            if(neighbor_b)
+              common++;
+          }
+        // every common neighbor is seen twice in the closed fan
+        if(common != 4)
+          return -1.0;
+
+        double error = -1.0, carried = 0.0;
+        for(unsigned int i = 0; i < fan.size(); i++)
+        {
+          int* t = tris[fan[i]];
+          for(int j = 0; j < 3; j++)
+            carried = std::max(carried, carried_error[t[j]]);
+          if(t[0] == b || t[1] == b || t[2] == b)
+            continue;
+
+          double* p[3];
+          for(int j = 0; j < 3; j++)
+            p[j] = verts[t[j] == a ? b : t[j]];
+          double old_area = (verts[t[1]][0] - verts[t[0]][0]) * (verts[t[2]][1] - verts[t[0]][1]) - (verts[t[1]][1] - verts[t[0]][1]) * (verts[t[2]][0] - verts[t[0]][0]);
+          double area = (p[1][0] - p[0][0]) * (p[2][1] - p[0][1]) - (p[1][1] - p[0][1]) * (p[2][0] - p[0][0]);
+          if(area * old_area <= 0.0 || fabs(area) < 1e-10 * fabs(old_area))
+            return -1.0;
+
+          // the value of the new triangle covering the removed vertex
+          if(error < 0.0)
+          {
+            double x = verts[a][0], y = verts[a][1];
+            double l0 = ((p[1][0] - x) * (p[2][1] - y) - (p[1][1] - y) * (p[2][0] - x)) / area;
+            double l1 = ((p[2][0] - x) * (p[0][1] - y) - (p[2][1] - y) * (p[0][0] - x)) / area;
+            double l2 = 1.0 - l0 - l1;
+            if(l0 >= -1e-10 && l1 >= -1e-10 && l2 >= -1e-10)
+              error = fabs(verts[a][2] - (l0 * p[0][2] + l1 * p[1][2] + l2 * p[2][2]));
+          }
+        }
+        return error < 0.0 ? -1.0 : error + carried;
+      }
+
+      void Linearizer::decimate()
+      {
+        int num_verts = this->vertex_count;
+        std::vector<std::vector<int> > vertex_tris(num_verts);
+        for(int i = 0; i < this->triangle_count; i++)
+          for(int j = 0; j < 3; j++)
+            vertex_tris[tris[i][j]].push_back(i);
+
+        // The inner vertices may be removed: every edge of their fan is shared by two of its triangles, the triangles
+        // have the same marker, and the vertex is not on a marked edge.
+        std::vector<bool> removable(num_verts, false);
+        for(int v = 0; v < num_verts; v++)
+        {
+          const std::vector<int>& fan = vertex_tris[v];
+          if(fan.size() < 3 || !finite(verts[v][2]))
+            continue;
+          bool inner = true;
+          for(unsigned int i = 0; i < fan.size() && inner; i++)
+          {
+            if(tri_markers[fan[i]] != tri_markers[fan[0]])
+              inner = false;
+            for(int j = 0; j < 3 && inner; j++)
+            {
+              int w = tris[fan[i]][j];
+              if(w == v)
+                continue;
+              int count = 0;
+              for(unsigned int k = 0; k < fan.size(); k++)
+                if(tris[fan[k]][0] == w || tris[fan[k]][1] == w || tris[fan[k]][2] == w)
+                  count++;
+              inner = (count == 2) && finite(verts[w][2]);
+            }
+          }
+          removable[v] = inner;
+        }
+        for(int i = 0; i < this->edges_count; i++)
+          if(edge_markers[i] != 0)
+            removable[edges[i][0]] = removable[edges[i][1]] = false;
+
+        // The candidates (error, vertex, neighbor), the best one of every vertex, recomputed when its fan changes.
+        typedef std::pair<double, std::pair<int, int> > Candidate;
+        std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate> > candidates;
+        // An upper estimate of the error of the removed vertices in the triangles of a vertex.
+        std::vector<double> carried_error(num_verts, 0.0);
+
+        for(int v = 0; v < num_verts; v++)
+        {
+          if(!removable[v])
+            continue;
+          for(unsigned int i = 0; i < vertex_tris[v].size(); i++)
+            for(int j = 0; j < 3; j++)
+            {
+              int w = tris[vertex_tris[v][i]][j];
+              if(w == v)
+                continue;
+              double error = collapse_error(v, w, vertex_tris, carried_error);
+              if(error >= 0.0)
+                candidates.push(Candidate(error, std::pair<int, int>(v, w)));
+            }
+        }
+
+        double max_error = decimation_tolerance * (max_val - min_val);
+        int num_triangles = this->triangle_count;
+        std::vector<bool> removed_tris(this->triangle_count, false);
+        std::vector<bool> removed_verts(num_verts, false);
+        while(!candidates.empty())
+        {
+          if(decimation_max_triangles > 0 && num_triangles <= decimation_max_triangles)
+            break;
+          Candidate candidate = candidates.top();
+          candidates.pop();
+          if(decimation_tolerance > 0.0 && candidate.first > max_error)
+            break;
+
+          int a = candidate.second.first, b = candidate.second.second;
+          if(removed_verts[a] || removed_verts[b])
+            continue;
+          // the fans changed since, the candidate is reevaluated
+          double error = collapse_error(a, b, vertex_tris, carried_error);
+          if(error < 0.0)
+            continue;
+          if(error > candidate.first)
+          {
+            candidates.push(Candidate(error, candidate.second));
+            continue;
+          }
+
+          // collapse a into b
+          std::vector<int> fan = vertex_tris[a];
+          std::vector<int> neighbors;
+          for(unsigned int i = 0; i < fan.size(); i++)
+          {
+            int* t = tris[fan[i]];
+            if(t[0] == b || t[1] == b || t[2] == b)
+            {
+              removed_tris[fan[i]] = true;
+              num_triangles--;
+              for(int j = 0; j < 3; j++)
+                if(t[j] != a)
+                {
+                  std::vector<int>& w_tris = vertex_tris[t[j]];
+                  w_tris.erase(std::find(w_tris.begin(), w_tris.end(), fan[i]));
+                }
+            }
+            else
+            {
+              for(int j = 0; j < 3; j++)
+                if(t[j] == a)
+                  t[j] = b;
+              vertex_tris[b].push_back(fan[i]);
+            }
+            for(int j = 0; j < 3; j++)
+              if(t[j] != a && std::find(neighbors.begin(), neighbors.end(), t[j]) == neighbors.end())
+                neighbors.push_back(t[j]);
+          }
+          vertex_tris[a].clear();
+          removed_verts[a] = true;
+
+          // the new candidates of the vertices whose fans changed
+          for(unsigned int i = 0; i < neighbors.size(); i++)
+            carried_error[neighbors[i]] = std::max(carried_error[neighbors[i]], candidate.first);
+          for(unsigned int i = 0; i < neighbors.size(); i++)
+          {
+            int v = neighbors[i];
+            if(!removable[v])
+              continue;
+            for(unsigned int k = 0; k < vertex_tris[v].size(); k++)
+              for(int j = 0; j < 3; j++)
+              {
+                int w = tris[vertex_tris[v][k]][j];
+                if(w == v)
+                  continue;
+                double e = collapse_error(v, w, vertex_tris, carried_error);
+                if(e >= 0.0)
+                  candidates.push(Candidate(e, std::pair<int, int>(v, w)));
+              }
+          }
+        }
+
+        // the remaining triangles, and vertices unless the subdivision is kept (it refers to the vertex indices)
+        int* vertex_map = new int[num_verts];
+        int new_vertex_count = 0;
+        for(int v = 0; v < num_verts; v++)
+        {
+          if(frozen_subdivision)
+            vertex_map[v] = v;
+          else if(!removed_verts[v])
+          {
+            if(new_vertex_count != v)
+              memcpy(verts[new_vertex_count], verts[v], sizeof(double3));
+            vertex_map[v] = new_vertex_count++;
+          }
+        }
+        if(!frozen_subdivision)
+          this->vertex_count = new_vertex_count;
+
+        int new_triangle_count = 0;
+        for(int i = 0; i < this->triangle_count; i++)
+          if(!removed_tris[i])
+          {
+            for(int j = 0; j < 3; j++)
+              tris[new_triangle_count][j] = vertex_map[tris[i][j]];
+            tri_markers[new_triangle_count++] = tri_markers[i];
+          }
+        this->triangle_count = new_triangle_count;
+
+        int new_edges_count = 0;
+        for(int i = 0; i < this->edges_count; i++)
+          if(edge_markers[i] != 0)
+          {
+            edges[new_edges_count][0] = vertex_map[edges[i][0]];
+            edges[new_edges_count][1] = vertex_map[edges[i][1]];
+            edge_markers[new_edges_count++] = edge_markers[i];
+          }
+        this->edges_count = new_edges_count;
+        delete [] vertex_map;
+
+        // the decimated triangulation is conforming, it serves for the contours too
+        this->tris_contours = (int3*) realloc(this->tris_contours, sizeof(int3) * std::max(this->triangle_count, 1));
+        memcpy(this->tris_contours, this->tris, this->triangle_count * sizeof(int3));
+        triangle_contours_count = this->triangle_count;
+      }
+
       int Linearizer::add_vertex()
       {
         if(this->vertex_count >= this->vertex_size)
@@ -895,6 +1404,7 @@ namespace Hermes
 
       void Linearizer::free()
       {
+        free_subdivision();
         if(verts != NULL)
         {
           ::free(verts);
@@ -967,6 +1477,35 @@ namespace Hermes
         fclose(f);
       }
 
+      void Linearizer::save_solution_vtu(MeshFunction<double>* sln, const char* file_name, const char *quantity_name,
+        bool mode_3D, int item, double eps)
+      {
+        process_solution(sln, item, eps);
+
+        LinearizedDataWriter writer(file_name);
+        write_step(&writer, quantity_name, mode_3D);
+        writer.end_step();
+      }
+
+      void Linearizer::write_step(LinearizedDataWriter* writer, const char* quantity_name, bool mode_3D, double time)
+      {
+        lock_data();
+        try
+        {
+          writer->begin_step(time, this->vertex_count, &this->verts[0][0], &this->verts[0][1], mode_3D ? &this->verts[0][2] : NULL, 3,
+            this->triangle_count, this->tris);
+          const double* values = &this->verts[0][2];
+          writer->add_point_field(quantity_name, 1, &values, 3);
+          writer->add_cell_field("marker", this->tri_markers);
+        }
+        catch(Hermes::Exceptions::Exception&)
+        {
+          unlock_data();
+          throw;
+        }
+        unlock_data();
+      }
+
       void Linearizer::calc_vertices_aabb(double* min_x, double* max_x, double* min_y, double* max_y) const
       {
         if(verts == NULL)
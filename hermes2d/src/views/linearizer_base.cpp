@@ -171,17 +171,14 @@ namespace Hermes
 
       void LinearizerBase::add_edge(int iv1, int iv2, int marker)
       {
-#pragma omp critical(realloc_edges)
+        if(edges_count >= edges_size)
         {
-          if(edges_count >= edges_size)
-          {
-						edges = (int2*) realloc(edges, sizeof(int2) * (edges_size * 1.5));
-            edge_markers = (int*) realloc(edge_markers, sizeof(int) * (edges_size = edges_size * 1.5));
-          }
-          edges[edges_count][0] = iv1;
-          edges[edges_count][1] = iv2;
-          edge_markers[edges_count++] = marker;
+          edges = (int2*) realloc(edges, sizeof(int2) * (edges_size * 1.5));
+          edge_markers = (int*) realloc(edge_markers, sizeof(int) * (edges_size = edges_size * 1.5));
         }
+        edges[edges_count][0] = iv1;
+        edges[edges_count][1] = iv2;
+        edge_markers[edges_count++] = marker;
       }
 
       int LinearizerBase::peek_vertex(int p1, int p2)
@@ -201,27 +198,25 @@ namespace Hermes
       void LinearizerBase::add_triangle(int iv0, int iv1, int iv2, int marker)
       {
         int index;
-#pragma omp critical(realloc_triangles)
+        if(this->del_slot >= 0) // reuse a slot after a deleted triangle
         {
-          if(this->del_slot >= 0) // reuse a slot after a deleted triangle
-          {
-            index = this->del_slot;
-            del_slot = -1;
-          }
+          index = this->del_slot;
+          del_slot = -1;
+        }
+        else
+        {
+          if(triangle_count >= triangle_size)
           {
-            if(triangle_count >= triangle_size)
-						{
-							tris = (int3*) realloc(tris, sizeof(int3) * (triangle_size * 2));
-              tri_markers = (int*) realloc(tri_markers, sizeof(int) * (triangle_size = triangle_size * 2));
-						}
-            index = triangle_count++;
-
-            tris[index][0] = iv0;
-            tris[index][1] = iv1;
-            tris[index][2] = iv2;
-						tri_markers[index] = marker;
+            tris = (int3*) realloc(tris, sizeof(int3) * (triangle_size * 2));
+            tri_markers = (int*) realloc(tri_markers, sizeof(int) * (triangle_size = triangle_size * 2));
           }
+          index = triangle_count++;
         }
+
+        tris[index][0] = iv0;
+        tris[index][1] = iv1;
+        tris[index][2] = iv2;
+        tri_markers[index] = marker;
       }
 
       int LinearizerBase::hash(int p1, int p2)
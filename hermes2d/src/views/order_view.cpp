@@ -22,11 +22,14 @@
 
 #ifndef NOGLUT
 
+#include <GL/glew.h>
 #include <GL/freeglut.h>
 #include "global.h"
 #include "order_view.h"
 #include "space.h"
 
+#define GL_BUFFER_OFFSET(i) ((char *)NULL + (i))
+
 namespace Hermes
 {
   namespace Hermes2D
@@ -41,6 +44,7 @@ namespace Hermes
         scale_width = 36;
         scale_box_height = 25;
         scale_box_skip = 9;
+        init();
       }
 
       OrderView::OrderView(char* title, WinGeom* wg)
@@ -51,6 +55,27 @@ namespace Hermes
         scale_width = 36;
         scale_box_height = 25;
         scale_box_skip = 9;
+        init();
+      }
+
+      void OrderView::init()
+      {
+        ord_updated = false;
+        gl_coord_buffer = 0;
+        gl_tri_cnt = gl_edge_cnt = 0;
+      }
+
+      void OrderView::on_close()
+      {
+        //OpenGL clenaup
+        if(gl_coord_buffer != 0)
+        {
+          glDeleteBuffersARB(1, &gl_coord_buffer);
+          gl_coord_buffer = 0;
+        }
+
+        //call of parent implementation
+        View::on_close();
       }
 
       static int order_palette[] =
@@ -118,6 +143,7 @@ namespace Hermes
 
         scale_height = num_boxes * scale_box_height + (num_boxes-1) * scale_box_skip;
         order_min = min;
+        ord_updated = true;
       }
 
       void OrderView::set_b_orders(bool set)
@@ -126,6 +152,68 @@ namespace Hermes
         refresh();
       }
 
+      void OrderView::prepare_gl_geometry()
+      {
+        if(ord_updated)
+        {
+          ord_updated = false;
+
+          try
+          {
+            //get input data
+            double3* verts = ord.get_vertices();
+            int tri_cnt = ord.get_num_triangles();
+            int3* tris = ord.get_triangles();
+            int edge_cnt = ord.get_num_edges();
+            int2* edges = ord.get_edges();
+
+            //check if extension is supported
+            if(!GLEW_ARB_vertex_buffer_object)
+              throw std::runtime_error("ARB_vertex_buffer_object not supported");
+
+            if(gl_coord_buffer == 0)
+              glGenBuffersARB(1, &gl_coord_buffer);
+            glBindBufferARB(GL_ARRAY_BUFFER_ARB, gl_coord_buffer);
+            glBufferDataARB(GL_ARRAY_BUFFER_ARB, sizeof(GLVertex2) * (3 * tri_cnt + 2 * edge_cnt), NULL, GL_STATIC_DRAW_ARB);
+            if(glGetError() != GL_NO_ERROR)
+              throw std::runtime_error("unable to allocate coord buffer");
+            GLVertex2* gl_verts = (GLVertex2*)glMapBufferARB(GL_ARRAY_BUFFER_ARB, GL_WRITE_ONLY_ARB);
+            if(gl_verts == NULL)
+              throw std::runtime_error("unable to map coord buffer");
+
+            //triangles
+            for(int i = 0; i < tri_cnt; i++)
+            {
+              const float* color = order_colors[(int) verts[tris[i][0]][2]];
+              for(int j = 0; j < 3; j++, gl_verts++)
+              {
+                gl_verts->x = (float)verts[tris[i][j]][0];
+                gl_verts->y = (float)verts[tris[i][j]][1];
+                memcpy(gl_verts->color, color, 3 * sizeof(float));
+              }
+            }
+
+            //edges
+            for(int i = 0; i < edge_cnt; i++)
+              for(int j = 0; j < 2; j++, gl_verts++)
+              {
+                gl_verts->x = (float)verts[edges[i][j]][0];
+                gl_verts->y = (float)verts[edges[i][j]][1];
+              }
+
+            glUnmapBufferARB(GL_ARRAY_BUFFER_ARB);
+            glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+            gl_tri_cnt = tri_cnt;
+            gl_edge_cnt = edge_cnt;
+          }
+          catch(std::exception &e)
+          { //out-of-memory or any other failure
+            glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+            if(gl_coord_buffer) { glDeleteBuffersARB(1, &gl_coord_buffer); gl_coord_buffer = 0; }
+          }
+        }
+      }
+
       void OrderView::on_display()
       {
         set_ortho_projection();
@@ -133,46 +221,86 @@ namespace Hermes
         glDisable(GL_LIGHTING);
         glDisable(GL_DEPTH_TEST);
 
-        // transform all vertices
         ord.lock_data();
-        int i, nv = ord.get_num_vertices();
+        int i;
         double3* vert = ord.get_vertices();
-        double2* tvert = new double2[nv];
-        for (i = 0; i < nv; i++)
-        {
-          tvert[i][0] = transform_x(vert[i][0]);
-          tvert[i][1] = transform_y(vert[i][1]);
-        }
 
-        // draw all triangles
-        int3* tris = ord.get_triangles();
-        glBegin(GL_TRIANGLES);
-        for (i = 0; i < ord.get_num_triangles(); i++)
+        // the color of the edges
+        float edges_color[3];
+        if(pal_type == 0)
+          edges_color[0] = edges_color[1] = edges_color[2] = 0.4f;
+        else if(pal_type == 1)
+          edges_color[0] = edges_color[1] = edges_color[2] = 1.0f;
+        else
+          edges_color[0] = edges_color[1] = edges_color[2] = 0.0f;
+
+        prepare_gl_geometry();
+        if(gl_coord_buffer != 0)
         {
-          const float* color = order_colors[(int) vert[tris[i][0]][2]];
-          glColor3f(color[0], color[1], color[2]);
+          // setup transformation (follows View::transform_x and View::transform_y)
+          glMatrixMode(GL_MODELVIEW);
+          glPushMatrix();
+          glLoadIdentity();
+          glTranslated(center_x, center_y, 0.0);
+          glScaled(1.0, -1.0, 1.0);
+          glTranslated(trans_x, trans_y, 0.0);
+          glScaled(scale, scale, 1.0);
 
-          glVertex2d(tvert[tris[i][0]][0], tvert[tris[i][0]][1]);
-          glVertex2d(tvert[tris[i][1]][0], tvert[tris[i][1]][1]);
-          glVertex2d(tvert[tris[i][2]][0], tvert[tris[i][2]][1]);
-        }
-        glEnd();
+          // draw all triangles
+          glBindBufferARB(GL_ARRAY_BUFFER_ARB, gl_coord_buffer);
+          glVertexPointer(2, GL_FLOAT, sizeof(GLVertex2), GL_BUFFER_OFFSET(0));
+          glColorPointer(3, GL_FLOAT, sizeof(GLVertex2), GL_BUFFER_OFFSET(GLVertex2::H2D_OFFSETOF_COLOR));
+          glEnableClientState(GL_VERTEX_ARRAY);
+          glEnableClientState(GL_COLOR_ARRAY);
+          glDrawArrays(GL_TRIANGLES, 0, 3 * gl_tri_cnt);
+          glDisableClientState(GL_COLOR_ARRAY);
 
-        // draw all edges
-        if(pal_type == 0)
-          glColor3f(0.4f, 0.4f, 0.4f);
-        else if(pal_type == 1)
-          glColor3f(1.0f, 1.0f, 1.0f);
+          // draw all edges
+          glColor3fv(edges_color);
+          glDrawArrays(GL_LINES, 3 * gl_tri_cnt, 2 * gl_edge_cnt);
+
+          //GL cleanup
+          glDisableClientState(GL_VERTEX_ARRAY);
+          glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+          glPopMatrix();
+        }
         else
-          glColor3f(0.0f, 0.0f, 0.0f);
-        glBegin(GL_LINES);
-        int2* edges = ord.get_edges();
-        for (i = 0; i < ord.get_num_edges(); i++)
         {
-          glVertex2d(tvert[edges[i][0]][0], tvert[edges[i][0]][1]);
-          glVertex2d(tvert[edges[i][1]][0], tvert[edges[i][1]][1]);
+          // transform all vertices
+          int nv = ord.get_num_vertices();
+          double2* tvert = new double2[nv];
+          for (i = 0; i < nv; i++)
+          {
+            tvert[i][0] = transform_x(vert[i][0]);
+            tvert[i][1] = transform_y(vert[i][1]);
+          }
+
+          // draw all triangles
+          int3* tris = ord.get_triangles();
+          glBegin(GL_TRIANGLES);
+          for (i = 0; i < ord.get_num_triangles(); i++)
+          {
+            const float* color = order_colors[(int) vert[tris[i][0]][2]];
+            glColor3f(color[0], color[1], color[2]);
+
+            glVertex2d(tvert[tris[i][0]][0], tvert[tris[i][0]][1]);
+            glVertex2d(tvert[tris[i][1]][0], tvert[tris[i][1]][1]);
+            glVertex2d(tvert[tris[i][2]][0], tvert[tris[i][2]][1]);
+          }
+          glEnd();
+
+          // draw all edges
+          glColor3fv(edges_color);
+          glBegin(GL_LINES);
+          int2* edges = ord.get_edges();
+          for (i = 0; i < ord.get_num_edges(); i++)
+          {
+            glVertex2d(tvert[edges[i][0]][0], tvert[edges[i][0]][1]);
+            glVertex2d(tvert[edges[i][1]][0], tvert[edges[i][1]][1]);
+          }
+          glEnd();
+          delete [] tvert;
         }
-        glEnd();
 
         // draw labels
         if(b_orders)
@@ -192,11 +320,10 @@ namespace Hermes
               else
                 glColor3f(1, 1, 1);
 
-              draw_text(tvert[lvert[i]][0], tvert[lvert[i]][1], ltext[i], 0);
+              draw_text(transform_x(vert[lvert[i]][0]), transform_y(vert[lvert[i]][1]), ltext[i], 0);
             }
         }
 
-        delete [] tvert;
         ord.unlock_data();
       }
 
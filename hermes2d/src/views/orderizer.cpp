@@ -65,6 +65,9 @@ namespace Hermes
         lvert = NULL;
         lbox = NULL;
         tris_orders = NULL;
+        cached_space = NULL;
+        cached_mesh = NULL;
+        elem_ids = elem_orders = elem_first_triangle = NULL;
 
         label_count = cl1 = cl2 = cl3 = 0;
 
@@ -102,6 +105,20 @@ namespace Hermes
         verts[index][2] = val;
       }
 
+      template<typename Scalar>
+      void Orderizer::get_element_orders(const Space<Scalar>* space, Element* e, int* o)
+      {
+        int oo = o[4] = o[5] = space->get_element_order(e->id);
+        o[3] = 0;
+        for (unsigned int k = 0; k < e->get_nvert(); k++)
+          o[k] = space->get_edge_order(e, k);
+        if(e->is_quad())
+        {
+          o[4] = H2D_GET_H_ORDER(oo);
+          o[5] = H2D_GET_V_ORDER(oo);
+        }
+      }
+
       template<typename Scalar>
       void Orderizer::process_space(const Space<Scalar>* space)
       {
@@ -112,17 +129,50 @@ namespace Hermes
           throw Hermes::Exceptions::Exception("The space is not up to date.");
 
         int type = 1;
-        label_count = 0;
-        vertex_count = 0;
-        triangle_count = 0;
-        edges_count = 0;
 
-        // estimate the required number of vertices and triangles
         Mesh* mesh = space->get_mesh();
         if(mesh == NULL)
         {
           throw Hermes::Exceptions::Exception("Mesh is NULL in Orderizer:process_space().");
         }
+
+        // The same mesh: the vertices, triangles and edges stay, only the orders may change.
+        if(!this->empty && cached_space == space && cached_mesh == mesh && cached_mesh_seq == mesh->get_seq()
+          && label_count == mesh->get_num_active_elements())
+        {
+          if(cached_space_seq == space->get_seq())
+            return;
+
+          int o[6];
+          for (int l = 0; l < label_count; l++)
+          {
+            Element* e = mesh->get_element(elem_ids[l]);
+            get_element_orders(space, e, o);
+            if(memcmp(o, elem_orders + 6 * l, sizeof(o)) == 0)
+              continue;
+            memcpy(elem_orders + 6 * l, o, sizeof(o));
+
+            int mode = e->get_mode();
+            double3* pt = quad_ord.get_points(type, e->get_mode());
+            int np = quad_ord.get_num_points(type, e->get_mode());
+            verts[lvert[l]][2] = o[4];
+            for (int i = 1; i < np; i++)
+              verts[lvert[l] + i][2] = o[(int) pt[i][2]];
+            for (int i = 0; i < num_elem[mode][type]; i++)
+              tris_orders[elem_first_triangle[l] + i] = o[4];
+            ltext[l] = labels[o[4]][o[5]];
+          }
+          cached_space_seq = space->get_seq();
+          return;
+        }
+
+        cached_space = NULL;
+        label_count = 0;
+        vertex_count = 0;
+        triangle_count = 0;
+        edges_count = 0;
+
+        // estimate the required number of vertices and triangles
         int nn = mesh->get_num_active_elements();
         this->vertex_size = std::max(this->vertex_size, 77 * nn);
         this->triangle_size = std::max(this->triangle_size, 64 * nn);
@@ -142,8 +192,11 @@ namespace Hermes
         lvert = (int*) realloc(lvert, sizeof(int) * label_size);
         ltext = (char**) realloc(ltext, sizeof(char*) * label_size);
         lbox = (double2*) realloc(lbox, sizeof(double2) * label_size);
+        elem_ids = (int*) realloc(elem_ids, sizeof(int) * label_size);
+        elem_orders = (int*) realloc(elem_orders, sizeof(int) * 6 * label_size);
+        elem_first_triangle = (int*) realloc(elem_first_triangle, sizeof(int) * label_size);
 
-        int oo, o[6];
+        int o[6];
 
         RefMap refmap;
         refmap.set_quad_2d(&quad_ord);
@@ -152,9 +205,7 @@ namespace Hermes
         Element* e;
         for_all_active_elements(e, mesh)
         {
-          oo = o[4] = o[5] = space->get_element_order(e->id);
-          for (unsigned int k = 0; k < e->get_nvert(); k++)
-            o[k] = space->get_edge_order(e, k);
+          get_element_orders(space, e, o);
 
           refmap.set_active_element(e);
           double* x = refmap.get_phys_x(type);
@@ -166,11 +217,9 @@ namespace Hermes
           assert(np <= 80);
 
           int mode = e->get_mode();
-          if(e->is_quad())
-          {
-            o[4] = H2D_GET_H_ORDER(oo);
-            o[5] = H2D_GET_V_ORDER(oo);
-          }
+          elem_ids[label_count] = e->id;
+          memcpy(elem_orders + 6 * label_count, o, sizeof(o));
+          elem_first_triangle[label_count] = triangle_count;
           make_vert(lvert[label_count], x[0], y[0], o[4]);
 
           for (int i = 1; i < np; i++)
@@ -203,6 +252,11 @@ namespace Hermes
         }
 
         refmap.set_quad_2d(&g_quad_2d_std);
+
+        cached_space = space;
+        cached_space_seq = space->get_seq();
+        cached_mesh = mesh;
+        cached_mesh_seq = mesh->get_seq();
       }
 
       void Orderizer::add_triangle(int iv0, int iv1, int iv2, int order, int marker)
@@ -260,6 +314,12 @@ namespace Hermes
           ::free(tris_orders);
           tris_orders = NULL;
         }
+        ::free(elem_ids);
+        ::free(elem_orders);
+        ::free(elem_first_triangle);
+        elem_ids = elem_orders = elem_first_triangle = NULL;
+        cached_space = NULL;
+        cached_mesh = NULL;
 
         LinearizerBase::free();
       }
@@ -367,6 +427,23 @@ namespace Hermes
         fclose(f);
       }
 
+      void Orderizer::write_step(LinearizedDataWriter* writer, double time)
+      {
+        lock_data();
+        try
+        {
+          writer->begin_step(time, this->vertex_count, &this->verts[0][0], &this->verts[0][1], NULL, 3, this->triangle_count, this->tris);
+          writer->add_cell_field("order", this->tris_orders);
+          writer->add_cell_field("marker", this->tri_markers);
+        }
+        catch(Hermes::Exceptions::Exception&)
+        {
+          unlock_data();
+          throw;
+        }
+        unlock_data();
+      }
+
       int Orderizer::get_labels(int*& lvert, char**& ltext, double2*& lbox) const
       {
         lvert = this->lvert;
@@ -59,6 +59,9 @@ namespace Hermes
         show_values = true;
         lin_updated = false;
         gl_coord_buffer = 0; gl_index_buffer = 0; gl_edge_inx_buffer = 0;
+        gl_3d_updated = false;
+        gl_3d_vertex_buffer = 0;
+        max_gl_3d_verts = 0;
 
         do_zoom_to_fit = true;
         is_constant = false;
@@ -147,6 +150,11 @@ namespace Hermes
           glDeleteBuffersARB(1, &gl_index_buffer);
           gl_index_buffer = 0;
         }
+        if(gl_3d_vertex_buffer != 0)
+        {
+          glDeleteBuffersARB(1, &gl_3d_vertex_buffer);
+          gl_3d_vertex_buffer = 0;
+        }
 
         //call of parent implementation
         View::on_close();
@@ -258,6 +266,7 @@ namespace Hermes
           value_range_avg /= num_verts;
 
           lin_updated = true;
+          gl_3d_updated = true;
       }
 
       bool ScalarView::compare_vertex_nodes_x(const VertexNodeInfo& a, const VertexNodeInfo& b)
@@ -896,6 +905,157 @@ namespace Hermes
         }
       }
 
+      void ScalarView::prepare_gl_geometry_3d()
+      {
+        if(gl_3d_updated && normals != NULL)
+        {
+          gl_3d_updated = false;
+
+          try
+          {
+            //get input data
+            int vert_cnt = lin->get_num_vertices();
+            double3* verts = lin->get_vertices();
+
+            //the triangles are drawn with the indices of the 2D mode
+            if(gl_index_buffer == 0)
+              throw std::runtime_error("no index buffer");
+
+            //reallocate vertices
+            if(gl_3d_vertex_buffer == 0 || vert_cnt > max_gl_3d_verts)
+            {
+              if(gl_3d_vertex_buffer == 0)
+                glGenBuffersARB(1, &gl_3d_vertex_buffer);
+              glBindBufferARB(GL_ARRAY_BUFFER_ARB, gl_3d_vertex_buffer);
+              glBufferDataARB(GL_ARRAY_BUFFER_ARB, sizeof(GLVertex3) * vert_cnt, NULL, GL_DYNAMIC_DRAW_ARB);
+              if(glGetError() != GL_NO_ERROR)
+                throw std::runtime_error("unable to allocate 3D vertex buffer");
+              max_gl_3d_verts = vert_cnt;
+            }
+            else
+            {
+              glBindBufferARB(GL_ARRAY_BUFFER_ARB, gl_3d_vertex_buffer);
+            }
+
+            //fill vertices, (x, value, y) and the normal in the same order, see draw_values_3d()
+            GLVertex3* gl_verts = (GLVertex3*)glMapBufferARB(GL_ARRAY_BUFFER_ARB, GL_WRITE_ONLY_ARB);
+            if(gl_verts == NULL)
+              throw std::runtime_error("unable to map 3D vertex buffer");
+            for(int i = 0; i < vert_cnt; i++)
+              gl_verts[i] = GLVertex3((float)verts[i][0], (float)verts[i][2], (float)verts[i][1],
+              (float)normals[i][0], (float)normals[i][2], (float)normals[i][1], (float)((verts[i][2] - range_min) * value_irange));
+            glUnmapBufferARB(GL_ARRAY_BUFFER_ARB);
+            glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+          }
+          catch(std::exception &e)
+          { //out-of-memory or any other failure
+            glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+            if(gl_3d_vertex_buffer) { glDeleteBuffersARB(1, &gl_3d_vertex_buffer); gl_3d_vertex_buffer = 0; }
+          }
+        }
+      }
+
+      void ScalarView::draw_values_3d()
+      {
+        if(gl_3d_vertex_buffer == 0 || gl_index_buffer == 0)
+        { //render using the safe but slow method
+          const int3* tris = lin->get_triangles();
+          const double3* vert = lin->get_vertices();
+
+          glBegin(GL_TRIANGLES);
+          double normal_xzscale = 1.0 / xzscale, normal_yscale = 1.0 / yscale;
+          for (int i = 0; i < lin->get_num_triangles(); i++)
+          {
+            for (int j = 0; j < 3; j++)
+            {
+              glNormal3d(normals[tris[i][j]][0] * normal_xzscale, normals[tris[i][j]][2] * normal_yscale, -normals[tris[i][j]][1] * normal_xzscale);
+              glTexCoord2d((vert[tris[i][j]][2] - range_min) * value_irange * tex_scale + tex_shift, 0.0);
+              glVertex3d((vert[tris[i][j]][0] - xctr) * xzscale,
+                (vert[tris[i][j]][2] - yctr) * yscale,
+                -(vert[tris[i][j]][1] - zctr) * xzscale);
+            }
+          }
+          glEnd();
+          return;
+        }
+
+        if(gl_tri_cnt == 0)
+          return;
+
+        //set texture transformation matrix
+        glMatrixMode(GL_TEXTURE);
+        glLoadIdentity();
+        glTranslated(tex_shift, 0.0, 0.0);
+        glScaled(tex_scale, 0.0, 0.0);
+
+        //model transformation, the normals are transformed by the inverse transpose (and normalized)
+        glMatrixMode(GL_MODELVIEW);
+        glPushMatrix();
+        glScaled(xzscale, yscale, -xzscale);
+        glTranslated(-xctr, -yctr, -zctr);
+
+        //bind vertices
+        glBindBufferARB(GL_ARRAY_BUFFER_ARB, gl_3d_vertex_buffer);
+        glVertexPointer(3, GL_FLOAT, sizeof(GLVertex3), GL_BUFFER_OFFSET(0));
+        glNormalPointer(GL_FLOAT, sizeof(GLVertex3), GL_BUFFER_OFFSET(GLVertex3::H2D_OFFSETOF_NORMAL));
+        glTexCoordPointer(1, GL_FLOAT, sizeof(GLVertex3), GL_BUFFER_OFFSET(GLVertex3::H2D_OFFSETOF_COORD));
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_NORMAL_ARRAY);
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+
+        //bind indices and render
+        glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, gl_index_buffer);
+        glDrawElements(GL_TRIANGLES, 3*gl_tri_cnt, GL_UNSIGNED_INT, GL_BUFFER_OFFSET(0));
+
+        //GL cleanup
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glDisableClientState(GL_NORMAL_ARRAY);
+        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+        glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
+        glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+        glPopMatrix();
+        glMatrixMode(GL_TEXTURE); //switch-off texture transform
+        glLoadIdentity();
+        glMatrixMode(GL_MODELVIEW);
+      }
+
+      void ScalarView::draw_edges_3d()
+      {
+        const int2* edges = lin->get_edges();
+        glColor3fv(edges_color);
+
+        if(gl_3d_vertex_buffer == 0)
+        { //render using the safe but slow method
+          const double3* vert = lin->get_vertices();
+          glBegin(GL_LINES);
+          for (int i = 0; i < lin->get_num_edges(); i++)
+          {
+            glVertex3d((vert[edges[i][0]][0] - xctr) * xzscale,
+              (vert[edges[i][0]][2] - yctr) * yscale,
+              -(vert[edges[i][0]][1] - zctr) * xzscale);
+            glVertex3d((vert[edges[i][1]][0] - xctr) * xzscale,
+              (vert[edges[i][1]][2] - yctr) * yscale,
+              -(vert[edges[i][1]][1] - zctr) * xzscale);
+          }
+          glEnd();
+          return;
+        }
+
+        glPushMatrix();
+        glScaled(xzscale, yscale, -xzscale);
+        glTranslated(-xctr, -yctr, -zctr);
+
+        //the vertices from the buffer, the index pairs directly from the linearizer
+        glBindBufferARB(GL_ARRAY_BUFFER_ARB, gl_3d_vertex_buffer);
+        glVertexPointer(3, GL_FLOAT, sizeof(GLVertex3), GL_BUFFER_OFFSET(0));
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glDrawElements(GL_LINES, 2 * lin->get_num_edges(), GL_UNSIGNED_INT, edges);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+
+        glPopMatrix();
+      }
+
       void ScalarView::draw_normals_3d()
       {
         double normal_xzscale = 1.0 / xzscale, normal_yscale = 1.0 / yscale;
@@ -994,7 +1154,7 @@ namespace Hermes
 
       void ScalarView::on_display()
       {
-        int i, j;
+        int i;
 
         // lock and get data
         lin->lock_data();
@@ -1063,6 +1223,7 @@ namespace Hermes
         else
         {
           set_3d_projection(fovy, znear, zfar);
+          prepare_gl_geometry_3d();
 
           glClear(GL_DEPTH_BUFFER_BIT);
           glEnable(GL_DEPTH_TEST);
@@ -1095,40 +1256,14 @@ namespace Hermes
           glEnable(GL_NORMALIZE);
           glEnable(GL_POLYGON_OFFSET_FILL);
           glPolygonOffset(1.0, 1.0);
-          glBegin(GL_TRIANGLES);
-          double normal_xzscale = 1.0 / xzscale, normal_yscale = 1.0 / yscale;
-          for (i = 0; i < lin->get_num_triangles(); i++)
-          {
-            for (j = 0; j < 3; j++)
-            {
-              glNormal3d(normals[tris[i][j]][0] * normal_xzscale, normals[tris[i][j]][2] * normal_yscale, -normals[tris[i][j]][1] * normal_xzscale);
-              glTexCoord2d((vert[tris[i][j]][2] - range_min) * value_irange * tex_scale + tex_shift, 0.0);
-              glVertex3d((vert[tris[i][j]][0] - xctr) * xzscale,
-                (vert[tris[i][j]][2] - yctr) * yscale,
-                -(vert[tris[i][j]][1] - zctr) * xzscale);
-            }
-          }
-          glEnd();
+          draw_values_3d();
           glDisable(GL_POLYGON_OFFSET_FILL);
 
           // Draw edges.
           glDisable(GL_LIGHTING);
           glDisable(GL_TEXTURE_1D);
           if(show_edges)
-          {
-            glColor3fv(edges_color);
-            glBegin(GL_LINES);
-            for (i = 0; i < lin->get_num_edges(); i++)
-            {
-              glVertex3d((vert[edges[i][0]][0] - xctr) * xzscale,
-                (vert[edges[i][0]][2] - yctr) * yscale,
-                -(vert[edges[i][0]][1] - zctr) * xzscale);
-              glVertex3d((vert[edges[i][1]][0] - xctr) * xzscale,
-                (vert[edges[i][1]][2] - yctr) * yscale,
-                -(vert[edges[i][1]][1] - zctr) * xzscale);
-            }
-            glEnd();
-          }
+            draw_edges_3d();
 
           // Draw the whole bounding box or only the boundary edges.
           if(show_aabb)
@@ -1196,6 +1331,8 @@ namespace Hermes
 
         for (int i = 0; i < num_verts; i++)
           normalize(normals[i][0], normals[i][1], normals[i][2]);
+
+        gl_3d_updated = true;
       }
 
       void ScalarView::update_layout()
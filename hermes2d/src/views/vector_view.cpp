@@ -15,10 +15,13 @@
 
 #ifndef NOGLUT
 
+#include <GL/glew.h>
 #include <GL/freeglut.h>
 #include "global.h"
 #include "vector_view.h"
 
+#define GL_BUFFER_OFFSET(i) ((char *)NULL + (i))
+
 namespace Hermes
 {
   namespace Hermes2D
@@ -36,6 +39,7 @@ namespace Hermes
         lines = false;
         pmode = false;
         length_coef = 1.0;
+        init();
       }
 
       VectorView::VectorView(char* title, WinGeom* wg)
@@ -49,6 +53,14 @@ namespace Hermes
         lines = false;
         pmode = false;
         length_coef = 1.0;
+        init();
+      }
+
+      void VectorView::init()
+      {
+        vec_updated = false;
+        gl_coord_buffer = gl_index_buffer = gl_edge_inx_buffer = 0;
+        gl_edge_cnt = gl_marked_edge_cnt = 0;
       }
 
       VectorView::~VectorView()
@@ -56,6 +68,29 @@ namespace Hermes
         delete vec;
       }
 
+      void VectorView::on_close()
+      {
+        //OpenGL clenaup
+        if(gl_coord_buffer != 0)
+        {
+          glDeleteBuffersARB(1, &gl_coord_buffer);
+          gl_coord_buffer = 0;
+        }
+        if(gl_index_buffer != 0)
+        {
+          glDeleteBuffersARB(1, &gl_index_buffer);
+          gl_index_buffer = 0;
+        }
+        if(gl_edge_inx_buffer != 0)
+        {
+          glDeleteBuffersARB(1, &gl_edge_inx_buffer);
+          gl_edge_inx_buffer = 0;
+        }
+
+        //call of parent implementation
+        View::on_close();
+      }
+
       void VectorView::show(MeshFunction<double>* vsln, double eps)
       {
         if(vec == NULL)
@@ -84,6 +119,7 @@ namespace Hermes
           range_max = vec->get_max_value(); 
         }
         vec->calc_vertices_aabb(&vertices_min_x, &vertices_max_x, &vertices_min_y, &vertices_max_y);
+        vec_updated = true;
         vec->unlock_data();
 
         create();
@@ -192,6 +228,83 @@ namespace Hermes
         }
       }
 
+      void VectorView::prepare_gl_geometry()
+      {
+        if(vec_updated)
+        {
+          vec_updated = false;
+
+          try
+          {
+            //get input data
+            int vert_cnt = vec->get_num_vertices();
+            double4* verts = vec->get_vertices();
+            int tri_cnt = vec->get_num_triangles();
+            int edge_cnt = vec->get_num_edges();
+            int2* edges = vec->get_edges();
+            int* edge_markers = vec->get_edge_markers();
+
+            //check if extension is supported
+            if(!GLEW_ARB_vertex_buffer_object)
+              throw std::runtime_error("ARB_vertex_buffer_object not supported");
+
+            if(gl_coord_buffer == 0)
+            {
+              glGenBuffersARB(1, &gl_coord_buffer);
+              glGenBuffersARB(1, &gl_index_buffer);
+              glGenBuffersARB(1, &gl_edge_inx_buffer);
+            }
+
+            //vertices
+            glBindBufferARB(GL_ARRAY_BUFFER_ARB, gl_coord_buffer);
+            glBufferDataARB(GL_ARRAY_BUFFER_ARB, sizeof(GLVertex2) * vert_cnt, NULL, GL_STATIC_DRAW_ARB);
+            if(glGetError() != GL_NO_ERROR)
+              throw std::runtime_error("unable to allocate coord buffer");
+            GLVertex2* gl_verts = (GLVertex2*)glMapBufferARB(GL_ARRAY_BUFFER_ARB, GL_WRITE_ONLY_ARB);
+            if(gl_verts == NULL)
+              throw std::runtime_error("unable to map coord buffer");
+            for(int i = 0; i < vert_cnt; i++)
+              gl_verts[i] = GLVertex2((float)verts[i][0], (float)verts[i][1], (float)sqrt(sqr(verts[i][2]) + sqr(verts[i][3])));
+            glUnmapBufferARB(GL_ARRAY_BUFFER_ARB);
+            glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+
+            //triangles, the index triplets of the vectorizer as they are
+            glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, gl_index_buffer);
+            glBufferDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB, sizeof(GLuint) * tri_cnt * 3, vec->get_triangles(), GL_STATIC_DRAW_ARB);
+            if(glGetError() != GL_NO_ERROR)
+              throw std::runtime_error("unable to allocate index buffer");
+
+            //edges, the ones with a nonzero marker first, so that both the selections are contiguous
+            glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, gl_edge_inx_buffer);
+            glBufferDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB, sizeof(GLuint) * edge_cnt * 2, NULL, GL_STATIC_DRAW_ARB);
+            if(glGetError() != GL_NO_ERROR)
+              throw std::runtime_error("unable to allocate edge buffer");
+            GLuint* gl_edges = (GLuint*)glMapBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, GL_WRITE_ONLY_ARB);
+            if(gl_edges == NULL)
+              throw std::runtime_error("unable to map edge buffer");
+            int first = 0, last = edge_cnt - 1;
+            for(int i = 0; i < edge_cnt; i++)
+            {
+              int j = (edge_markers[i] != 0) ? first++ : last--;
+              gl_edges[2 * j] = (GLuint)edges[i][0];
+              gl_edges[2 * j + 1] = (GLuint)edges[i][1];
+            }
+            glUnmapBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB);
+            glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
+            gl_edge_cnt = edge_cnt;
+            gl_marked_edge_cnt = first;
+          }
+          catch(std::exception &e)
+          { //out-of-memory or any other failure
+            glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+            glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
+            if(gl_coord_buffer) { glDeleteBuffersARB(1, &gl_coord_buffer); gl_coord_buffer = 0; }
+            if(gl_index_buffer) { glDeleteBuffersARB(1, &gl_index_buffer); gl_index_buffer = 0; }
+            if(gl_edge_inx_buffer) { glDeleteBuffersARB(1, &gl_edge_inx_buffer); gl_edge_inx_buffer = 0; }
+          }
+        }
+      }
+
       void VectorView::on_display()
       {
         set_ortho_projection();
@@ -236,39 +349,86 @@ namespace Hermes
 
         if(mode != 1) glEnable(GL_TEXTURE_1D);
         glBindTexture(GL_TEXTURE_1D, gl_pallete_tex_id);
-        glBegin(GL_TRIANGLES);
-        glColor3f(0.95f, 0.95f, 0.95f);
-        for (i = 0; i < vec->get_num_triangles(); i++)
+        prepare_gl_geometry();
+        if(gl_coord_buffer != 0)
         {
-          double mag = sqrt(sqr(vert[xtris[i][0]][2]) + sqr(vert[xtris[i][0]][3]));
-          glTexCoord2d((mag -min) * irange * tex_scale + tex_shift, 0.0);
-          glVertex2d(tvert[xtris[i][0]][0], tvert[xtris[i][0]][1]);
+          // the texture coordinate (mag - min) * irange * tex_scale + tex_shift
+          glMatrixMode(GL_TEXTURE);
+          glLoadIdentity();
+          glTranslated(tex_shift - min * irange * tex_scale, 0.0, 0.0);
+          glScaled(irange * tex_scale, 0.0, 0.0);
+
+          // setup transformation (follows View::transform_x and View::transform_y)
+          glMatrixMode(GL_MODELVIEW);
+          glPushMatrix();
+          glLoadIdentity();
+          glTranslated(center_x, center_y, 0.0);
+          glScaled(1.0, -1.0, 1.0);
+          glTranslated(trans_x, trans_y, 0.0);
+          glScaled(scale, scale, 1.0);
+
+          glColor3f(0.95f, 0.95f, 0.95f);
+          glBindBufferARB(GL_ARRAY_BUFFER_ARB, gl_coord_buffer);
+          glVertexPointer(2, GL_FLOAT, sizeof(GLVertex2), GL_BUFFER_OFFSET(0));
+          glTexCoordPointer(1, GL_FLOAT, sizeof(GLVertex2), GL_BUFFER_OFFSET(GLVertex2::H2D_OFFSETOF_MAG));
+          glEnableClientState(GL_VERTEX_ARRAY);
+          glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+          glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, gl_index_buffer);
+          glDrawElements(GL_TRIANGLES, 3 * vec->get_num_triangles(), GL_UNSIGNED_INT, GL_BUFFER_OFFSET(0));
+          glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+          glDisable(GL_TEXTURE_1D);
+
+          // draw all edges, or only the ones with a nonzero marker
+          glColor3f(0.5, 0.5, 0.5);
+          glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, gl_edge_inx_buffer);
+          glDrawElements(GL_LINES, 2 * (lines ? gl_edge_cnt : gl_marked_edge_cnt), GL_UNSIGNED_INT, GL_BUFFER_OFFSET(0));
+
+          //GL cleanup
+          glDisableClientState(GL_VERTEX_ARRAY);
+          glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
+          glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+          glPopMatrix();
+          glMatrixMode(GL_TEXTURE);
+          glLoadIdentity();
+          glMatrixMode(GL_MODELVIEW);
+        }
+        else
+        {
+          glBegin(GL_TRIANGLES);
+          glColor3f(0.95f, 0.95f, 0.95f);
+          for (i = 0; i < vec->get_num_triangles(); i++)
+          {
+            double mag = sqrt(sqr(vert[xtris[i][0]][2]) + sqr(vert[xtris[i][0]][3]));
+            glTexCoord2d((mag -min) * irange * tex_scale + tex_shift, 0.0);
+            glVertex2d(tvert[xtris[i][0]][0], tvert[xtris[i][0]][1]);
 
-          mag = sqrt(sqr(vert[xtris[i][1]][2]) + sqr(vert[xtris[i][1]][3]));
-          glTexCoord2d((mag -min) * irange * tex_scale + tex_shift, 0.0);
-          glVertex2d(tvert[xtris[i][1]][0], tvert[xtris[i][1]][1]);
+            mag = sqrt(sqr(vert[xtris[i][1]][2]) + sqr(vert[xtris[i][1]][3]));
+            glTexCoord2d((mag -min) * irange * tex_scale + tex_shift, 0.0);
+            glVertex2d(tvert[xtris[i][1]][0], tvert[xtris[i][1]][1]);
 
-          mag = sqrt(sqr(vert[xtris[i][2]][2]) + sqr(vert[xtris[i][2]][3]));
-          glTexCoord2d((mag -min) * irange * tex_scale + tex_shift, 0.0);
-          glVertex2d(tvert[xtris[i][2]][0], tvert[xtris[i][2]][1]);
-        }
-        glEnd();
-        glDisable(GL_TEXTURE_1D);
+            mag = sqrt(sqr(vert[xtris[i][2]][2]) + sqr(vert[xtris[i][2]][3]));
+            glTexCoord2d((mag -min) * irange * tex_scale + tex_shift, 0.0);
+            glVertex2d(tvert[xtris[i][2]][0], tvert[xtris[i][2]][1]);
+          }
+          glEnd();
+          glDisable(GL_TEXTURE_1D);
 
-        // draw all edges
-        /*if(mode == 0) glColor3f(0.3, 0.3, 0.3);
-        else*/ glColor3f(0.5, 0.5, 0.5);
-        glBegin(GL_LINES);
-        int2* edges = vec->get_edges();
-        for (i = 0; i < vec->get_num_edges(); i++)
-        {
-          if(lines || edges[i][2] != 0)
+          // draw all edges
+          /*if(mode == 0) glColor3f(0.3, 0.3, 0.3);
+          else*/ glColor3f(0.5, 0.5, 0.5);
+          glBegin(GL_LINES);
+          int2* edges = vec->get_edges();
+          int* edge_markers = vec->get_edge_markers();
+          for (i = 0; i < vec->get_num_edges(); i++)
           {
-            glVertex2d(tvert[edges[i][0]][0], tvert[edges[i][0]][1]);
-            glVertex2d(tvert[edges[i][1]][0], tvert[edges[i][1]][1]);
+            if(lines || edge_markers[i] != 0)
+            {
+              glVertex2d(tvert[edges[i][0]][0], tvert[edges[i][0]][1]);
+              glVertex2d(tvert[edges[i][1]][0], tvert[edges[i][1]][1]);
+            }
           }
+          glEnd();
         }
-        glEnd();
 
         // draw dashed edges
         if(lines)
@@ -46,23 +46,15 @@ namespace Hermes
         // search for an existing vertex
         if(p1 > p2) std::swap(p1, p2);
         int index = this->hash(p1, p2);
-        int i = 0;
-        if(index < this->vertex_count)
+        int i = this->hash_table[index];
+        while (i >= 0)
         {
-          i = this->hash_table[index];
-          while (i >= 0 && i < this->vertex_count)
-          {
-            if(this->info[i][0] == p1 && this->info[i][1] == p2)
-              return i;
-            // note that we won't return a vertex with a different value than the required one;
-            // this takes care for discontinuities in the solution, where more vertices
-            // with different values will be created
-            i = info[i][2];
-          }
+          if(this->info[i][0] == p1 && this->info[i][1] == p2)
+            return i;
+          i = info[i][2];
         }
 
         // if not found, create a new one
-#pragma omp critical(realloc_vertices)
         try
         {
           i = add_vertex();
@@ -153,7 +145,6 @@ namespace Hermes
             for (i = 0; i < lin_np_tri[1]; i++)
             {
               double m = (sqrt(sqr(xval[i]) + sqr(yval[i])));
-#pragma omp critical(max)
               if(finite(m) && fabs(m) > max)
                 max = fabs(m);
             }
@@ -300,9 +291,7 @@ namespace Hermes
             {
               double m = sqrt(sqr(xval[i]) + sqr(yval[i]));
               if(finite(m) && fabs(m) > max)
-#pragma omp critical(max)
-                if(finite(m) && fabs(m) > max)
-                  max = fabs(m);
+                max = fabs(m);
             }
 
             // This is just to make some sense.
@@ -499,35 +488,6 @@ namespace Hermes
         this->yitem = yitem_orig;
         this->eps = eps;
 
-        // estimate the required number of vertices and triangles
-        // (based on the assumption that the linear mesh will be
-        // about four-times finer than the original mesh).
-        int nn = xsln->get_mesh()->get_num_elements() + ysln->get_mesh()->get_num_elements();
-
-        this->vertex_size = std::max(100 * nn, std::max(this->vertex_size, 50000));
-        this->triangle_size = std::max(150 * nn, std::max(this->triangle_size, 75000));
-        this->edges_size = std::max(100 * nn, std::max(this->edges_size, 50000));
-        //dashes_size = edges_size;
-
-        vertex_count = 0;
-        triangle_count = 0;
-        edges_count = 0;
-        dashes_count = 0;
-
-        // reuse or allocate vertex, triangle and edge arrays
-        this->verts = (double4*) realloc(this->verts, sizeof(double4) * vertex_size);
-        this->tris = (int3*) realloc(this->tris, sizeof(int3) * this->triangle_size);
-        this->tri_markers = (int*) realloc(this->tri_markers, sizeof(int) * this->triangle_size);
-        this->edges = (int2*) realloc(this->edges, sizeof(int2) * this->edges_size);
-        this->edge_markers = (int*) realloc(this->edge_markers, sizeof(int) * this->edges_size);
-        this->dashes = (int2*) realloc(this->dashes, sizeof(int2) * dashes_size);
-        info = (int4*) malloc(sizeof(int4) * vertex_size);
-        this->empty = false;
-
-        // initialize the hash table
-        hash_table = (int*) malloc(sizeof(int) * vertex_size);
-        memset(hash_table, 0xff, sizeof(int) * vertex_size);
-
         // select the linearization quadrature
         Quad2D *old_quad_x, *old_quad_y;
         Quad2D *old_quad_x_disp, *old_quad_y_disp;
@@ -547,8 +507,9 @@ namespace Hermes
           meshes.push_back(ydisp->get_mesh());
 
         // Parallelization
-        MeshFunction<double>*** fns = new MeshFunction<double>**[Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads)];
-        for(unsigned int i = 0; i < Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads); i++)
+        int num_threads_used = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
+        MeshFunction<double>*** fns = new MeshFunction<double>**[num_threads_used];
+        for(unsigned int i = 0; i < num_threads_used; i++)
         {
           fns[i] = new MeshFunction<double>*[4];
           fns[i][0] = xsln->clone();
@@ -569,8 +530,8 @@ namespace Hermes
           }
         }
 
-        Transformable*** trfs = new Transformable**[Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads)];
-        for(unsigned int i = 0; i < Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads); i++)
+        Transformable*** trfs = new Transformable**[num_threads_used];
+        for(unsigned int i = 0; i < num_threads_used; i++)
         {
           trfs[i] = new Transformable*[4];
           trfs[i][0] = fns[i][0];
@@ -582,6 +543,7 @@ namespace Hermes
         }
 
         // get the component and desired value from item.
+        component_x = value_type_x = 0;
         if(xitem >= 0x40)
         {
           component_x = 1;
@@ -593,6 +555,7 @@ namespace Hermes
           value_type_x++;
         }
         // get the component and desired value from item.
+        component_y = value_type_y = 0;
         if(yitem >= 0x40)
         {
           component_y = 1;
@@ -606,161 +569,123 @@ namespace Hermes
         xitem = xitem_orig;
         yitem = yitem_orig;
 
-        Traverse trav_masterMax(true);
-        unsigned int num_states = trav_masterMax.get_num_states(meshes);
-
-        trav_masterMax.begin(meshes.size(), &(meshes.front()));
-
-        Traverse* trav = new Traverse[Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads)];
-
-        for(unsigned int i = 0; i < Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads); i++)
-        {
-          trav[i].begin(meshes.size(), &(meshes.front()), trfs[i]);
-          trav[i].stack = trav_masterMax.stack;
-        }
+        // Both passes go through the same states, these are kept for the next call if the meshes do not change.
+        traverse_states.update(&(meshes.front()), meshes.size());
+        int num_states = traverse_states.get_num_states();
+        Traverse::State** states = traverse_states.get_states();
 
         int state_i;
 
+        // The maxima of the vertex values found by the threads.
+        double* thread_max = new double[num_threads_used];
+        for(int i = 0; i < num_threads_used; i++)
+          thread_max[i] = this->max;
+
 #define CHUNKSIZE 1
-        int num_threads_used = Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads);
-#pragma omp parallel shared(trav_masterMax) private(state_i) num_threads(num_threads_used)
+#pragma omp parallel shared(states) private(state_i) num_threads(num_threads_used)
         {
 #pragma omp for schedule(static, CHUNKSIZE)
           for(state_i = 0; state_i < num_states; state_i++)
           {
             try
             {
-              Traverse::State current_state;
-#pragma omp critical(get_next_state)
-              current_state = trav[omp_get_thread_num()].get_next_state(&trav_masterMax.top, &trav_masterMax.id);
+              Traverse::State* current_state = states[state_i];
+              TraverseStateList::set_active_state(current_state, trfs[omp_get_thread_num()]);
 
               fns[omp_get_thread_num()][0]->set_quad_order(0, xitem);
               fns[omp_get_thread_num()][1]->set_quad_order(0, yitem);
               double* xval = fns[omp_get_thread_num()][0]->get_values(component_x, value_type_x);
               double* yval = fns[omp_get_thread_num()][1]->get_values(component_y, value_type_y);
 
-              for (unsigned int i = 0; i < current_state.e[0]->get_nvert(); i++)
+              for (unsigned int i = 0; i < current_state->e[0]->get_nvert(); i++)
               {
                 double fx = xval[i];
                 double fy = yval[i];
-#pragma omp critical(max)
-                if(fabs(sqrt(fx*fx + fy*fy)) > max)
-                  max = fabs(sqrt(fx*fx + fy*fy));
+                if(fabs(sqrt(fx*fx + fy*fy)) > thread_max[omp_get_thread_num()])
+                  thread_max[omp_get_thread_num()] = fabs(sqrt(fx*fx + fy*fy));
               }
             }
             catch(Hermes::Exceptions::Exception& e)
             {
+#pragma omp critical (caughtException)
               if(this->caughtException == NULL)
                 this->caughtException = e.clone();
             }
             catch(std::exception& e)
             {
+#pragma omp critical (caughtException)
               if(this->caughtException == NULL)
                 this->caughtException = new Hermes::Exceptions::Exception(e.what());
             }
           }
         }
 
-        trav_masterMax.finish();
-        for(unsigned int i = 0; i < Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads); i++)
-          trav[i].finish();
-        delete [] trav;
-
-        Traverse trav_master(true);
-        num_states = trav_master.get_num_states(meshes);
-
-        trav_master.begin(meshes.size(), &(meshes.front()));
+        for(int i = 0; i < num_threads_used; i++)
+          this->max = std::max(this->max, thread_max[i]);
+        delete [] thread_max;
 
-        trav = new Traverse[Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads)];
-
-        for(unsigned int i = 0; i < Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads); i++)
+        // The workers, with a single thread the elements are linearized directly into this instance.
+        // (The estimate of the sizes assumes the linear mesh about four-times finer than the original mesh.)
+        int num_elements = xsln->get_mesh()->get_num_elements() + ysln->get_mesh()->get_num_elements();
+        Vectorizer** workers = new Vectorizer*[num_threads_used];
+        if(num_threads_used == 1)
         {
-          trav[i].begin(meshes.size(), &(meshes.front()), trfs[i]);
-          trav[i].stack = trav_master.stack;
+          workers[0] = this;
+          this->init_arrays(num_elements);
+        }
+        else
+        {
+          for(int i = 0; i < num_threads_used; i++)
+          {
+            workers[i] = new Vectorizer();
+            workers[i]->caughtException = this->caughtException;
+            workers[i]->xitem = this->xitem;
+            workers[i]->component_x = this->component_x;
+            workers[i]->value_type_x = this->value_type_x;
+            workers[i]->yitem = this->yitem;
+            workers[i]->component_y = this->component_y;
+            workers[i]->value_type_y = this->value_type_y;
+            workers[i]->eps = this->eps;
+            workers[i]->max = this->max;
+            workers[i]->curvature_epsilon = this->curvature_epsilon;
+            workers[i]->xdisp = this->xdisp;
+            workers[i]->ydisp = this->ydisp;
+            workers[i]->user_xdisp = workers[i]->user_ydisp = true;
+            workers[i]->dmult = this->dmult;
+            workers[i]->init_arrays(num_elements / num_threads_used + 1);
+          }
         }
 
-#pragma omp parallel shared(trav_master) private(state_i) num_threads(num_threads_used)
+        // The static schedule gives the threads contiguous parts of the states, i.e. few vertices on the boundaries of the parts.
+#pragma omp parallel shared(states) private(state_i) num_threads(num_threads_used)
         {
-#pragma omp for schedule(static, CHUNKSIZE)
+#pragma omp for schedule(static)
           for(state_i = 0; state_i < num_states; state_i++)
           {
-            if(this->caughtException != NULL)
+            Vectorizer* worker = workers[omp_get_thread_num()];
+            if(worker->caughtException != NULL)
               continue;
 
             try
             {
-              Traverse::State current_state;
-
-#pragma omp critical (get_next_state)
-              current_state = trav[omp_get_thread_num()].get_next_state(&trav_master.top, &trav_master.id);
-
-              fns[omp_get_thread_num()][0]->set_quad_order(0, xitem);
-              fns[omp_get_thread_num()][1]->set_quad_order(0, yitem);
-              double* xval = fns[omp_get_thread_num()][0]->get_values(component_x, value_type_x);
-              double* yval = fns[omp_get_thread_num()][1]->get_values(component_y, value_type_y);
-              if(xval == NULL || yval == NULL)
-              {
-                delete [] trav;
-                throw Hermes::Exceptions::Exception("Item not defined in the solution in Linearizer::process_solution.");
-              }
-
-              if(xdisp != NULL)
-                fns[omp_get_thread_num()][2]->set_quad_order(0, H2D_FN_VAL);
-              if(ydisp != NULL)
-                fns[omp_get_thread_num()][xdisp == NULL ? 2 : 3]->set_quad_order(0, H2D_FN_VAL);
-
-              double *dx = NULL;
-              double *dy = NULL;
-              if(xdisp != NULL)
-                dx = fns[omp_get_thread_num()][2]->get_fn_values();
-              if(ydisp != NULL)
-                dy = fns[omp_get_thread_num()][xdisp == NULL ? 2 : 3]->get_fn_values();
-
-              int iv[H2D_MAX_NUMBER_VERTICES];
-              for (unsigned int i = 0; i < current_state.e[0]->get_nvert(); i++)
-              {
-                double fx = xval[i];
-                double fy = yval[i];
-
-                double x_disp = fns[omp_get_thread_num()][0]->get_refmap()->get_phys_x(0)[i];
-                double y_disp = fns[omp_get_thread_num()][0]->get_refmap()->get_phys_y(0)[i];
-                if(this->xdisp != NULL)
-                  x_disp += dmult * dx[i];
-                if(this->ydisp != NULL)
-                  y_disp += dmult * dy[i];
-
-                iv[i] = this->get_vertex(-fns[omp_get_thread_num()][0]->get_active_element()->vn[i]->id, -fns[omp_get_thread_num()][0]->get_active_element()->vn[i]->id, x_disp, y_disp, fx, fy);
-
-                if(this->caughtException != NULL)
-                  continue;
-              }
-
-              // recur to sub-elements
-              if(current_state.e[0]->is_triangle())
-                process_triangle(fns[omp_get_thread_num()], iv[0], iv[1], iv[2], 0, NULL, NULL, NULL, NULL, NULL, current_state.e[0]->is_curved());
-              else
-                process_quad(fns[omp_get_thread_num()], iv[0], iv[1], iv[2], iv[3], 0, NULL, NULL, NULL, NULL, NULL, current_state.e[0]->is_curved());
-
-              for (unsigned int i = 0; i < current_state.e[0]->get_nvert(); i++)
-                process_edge(iv[i], iv[current_state.e[0]->next_vert(i)], current_state.e[0]->en[i]->marker);
+              TraverseStateList::set_active_state(states[state_i], trfs[omp_get_thread_num()]);
+              worker->process_element(fns[omp_get_thread_num()]);
             }
             catch(Hermes::Exceptions::Exception& e)
             {
-              if(this->caughtException == NULL)
-                this->caughtException = e.clone();
+              if(worker->caughtException == NULL)
+                worker->caughtException = e.clone();
             }
             catch(std::exception& e)
             {
-              if(this->caughtException == NULL)
-                this->caughtException = new Hermes::Exceptions::Exception(e.what());
+              if(worker->caughtException == NULL)
+                worker->caughtException = new Hermes::Exceptions::Exception(e.what());
             }
           }
         }
 
-        trav_master.finish();
-        for(unsigned int i = 0; i < Hermes2DApi.get_integral_param_value(Hermes::Hermes2D::numThreads); i++)
+        for(unsigned int i = 0; i < num_threads_used; i++)
         {
-          trav[i].finish();
           for(unsigned int j = 0; j < (2 + (xdisp != NULL? 1 : 0) + (ydisp != NULL ? 1 : 0)); j++)
             delete fns[i][j];
           delete [] fns[i];
@@ -768,7 +693,44 @@ namespace Hermes
         }
         delete [] fns;
         delete [] trfs;
-        delete [] trav;
+
+        // merge the buffers of the workers
+        if(num_threads_used > 1)
+        {
+          int num_vertices = 0, num_triangles = 0, num_edges = 0;
+          for(int i = 0; i < num_threads_used; i++)
+          {
+            if(this->caughtException == NULL)
+              this->caughtException = workers[i]->caughtException;
+            this->max = std::max(this->max, workers[i]->max);
+            num_vertices += workers[i]->vertex_count;
+            num_triangles += workers[i]->triangle_count;
+            num_edges += workers[i]->edges_count;
+          }
+
+          this->init_arrays(num_elements, num_vertices, num_triangles, num_edges);
+          for(int i = 0; i < num_threads_used; i++)
+          {
+            if(this->caughtException == NULL)
+              this->merge(workers[i]);
+            ::free(workers[i]->hash_table);
+            workers[i]->hash_table = NULL;
+            ::free(workers[i]->info);
+            workers[i]->info = NULL;
+            delete workers[i];
+          }
+        }
+        delete [] workers;
+
+        if(this->caughtException != NULL)
+        {
+          this->unlock_data();
+          ::free(hash_table);
+          hash_table = NULL;
+          ::free(info);
+          info = NULL;
+          throw *(this->caughtException);
+        }
 
         // regularize the linear mesh
         for (int i = 0; i < this->triangle_count; i++)
@@ -800,7 +762,110 @@ namespace Hermes
 
         // clean up
         ::free(this->hash_table);
+        this->hash_table = NULL;
         ::free(this->info);
+        this->info = NULL;
+      }
+
+      void Vectorizer::init_arrays(int num_elements, int num_vertices, int num_triangles, int num_edges)
+      {
+        //    sizes.
+        this->vertex_size = std::max(std::max(100 * num_elements, num_vertices), std::max(this->vertex_size, 50000));
+        this->triangle_size = std::max(std::max(150 * num_elements, num_triangles), std::max(this->triangle_size, 75000));
+        this->edges_size = std::max(std::max(100 * num_elements, num_edges), std::max(this->edges_size, 50000));
+        //    counts.
+        this->vertex_count = 0;
+        this->triangle_count = 0;
+        this->edges_count = 0;
+        this->dashes_count = 0;
+        this->del_slot = -1;
+        //    reuse or allocate vertex, triangle and edge arrays.
+        this->verts = (double4*) realloc(this->verts, sizeof(double4) * this->vertex_size);
+        this->tris = (int3*) realloc(this->tris, sizeof(int3) * this->triangle_size);
+        this->tri_markers = (int*) realloc(this->tri_markers, sizeof(int) * this->triangle_size);
+        this->edges = (int2*) realloc(this->edges, sizeof(int2) * this->edges_size);
+        this->edge_markers = (int*) realloc(this->edge_markers, sizeof(int) * this->edges_size);
+        this->dashes = (int2*) realloc(this->dashes, sizeof(int2) * this->dashes_size);
+        this->info = (int4*) realloc(this->info, sizeof(int4) * this->vertex_size);
+        this->empty = false;
+        //    initialize the hash table
+        this->hash_table = (int*) realloc(this->hash_table, sizeof(int) * this->vertex_size);
+        memset(this->hash_table, 0xff, sizeof(int) * this->vertex_size);
+      }
+
+      void Vectorizer::process_element(MeshFunction<double>** fns)
+      {
+        Element* e = fns[0]->get_active_element();
+
+        fns[0]->set_quad_order(0, xitem);
+        fns[1]->set_quad_order(0, yitem);
+        double* xval = fns[0]->get_values(component_x, value_type_x);
+        double* yval = fns[1]->get_values(component_y, value_type_y);
+        if(xval == NULL || yval == NULL)
+          throw Hermes::Exceptions::Exception("Item not defined in the solution in Vectorizer::process_solution.");
+
+        if(xdisp != NULL)
+          fns[2]->set_quad_order(0, H2D_FN_VAL);
+        if(ydisp != NULL)
+          fns[xdisp == NULL ? 2 : 3]->set_quad_order(0, H2D_FN_VAL);
+
+        double *dx = NULL;
+        double *dy = NULL;
+        if(xdisp != NULL)
+          dx = fns[2]->get_fn_values();
+        if(ydisp != NULL)
+          dy = fns[xdisp == NULL ? 2 : 3]->get_fn_values();
+
+        int iv[H2D_MAX_NUMBER_VERTICES];
+        for (unsigned int i = 0; i < e->get_nvert(); i++)
+        {
+          double fx = xval[i];
+          double fy = yval[i];
+
+          double x_disp = fns[0]->get_refmap()->get_phys_x(0)[i];
+          double y_disp = fns[0]->get_refmap()->get_phys_y(0)[i];
+          if(this->xdisp != NULL)
+            x_disp += dmult * dx[i];
+          if(this->ydisp != NULL)
+            y_disp += dmult * dy[i];
+
+          iv[i] = this->get_vertex(-e->vn[i]->id, -e->vn[i]->id, x_disp, y_disp, fx, fy);
+        }
+        if(this->caughtException != NULL)
+          return;
+
+        // recur to sub-elements
+        if(e->is_triangle())
+          process_triangle(fns, iv[0], iv[1], iv[2], 0, NULL, NULL, NULL, NULL, NULL, e->is_curved());
+        else
+          process_quad(fns, iv[0], iv[1], iv[2], iv[3], 0, NULL, NULL, NULL, NULL, NULL, e->is_curved());
+
+        for (unsigned int i = 0; i < e->get_nvert(); i++)
+          process_edge(iv[i], iv[e->next_vert(i)], e->en[i]->marker);
+      }
+
+      void Vectorizer::merge(Vectorizer* worker)
+      {
+        int* vertex_map = new int[worker->vertex_count];
+        for (int i = 0; i < worker->vertex_count; i++)
+        {
+          // The element vertices have the keys (-id, -id), the parents of a mid-edge vertex precede it.
+          int p1 = worker->info[i][0], p2 = worker->info[i][1];
+          if(p1 != p2)
+          {
+            p1 = vertex_map[p1];
+            p2 = vertex_map[p2];
+          }
+          vertex_map[i] = this->get_vertex(p1, p2, worker->verts[i][0], worker->verts[i][1], worker->verts[i][2], worker->verts[i][3]);
+        }
+
+        for (int i = 0; i < worker->triangle_count; i++)
+          this->add_triangle(vertex_map[worker->tris[i][0]], vertex_map[worker->tris[i][1]], vertex_map[worker->tris[i][2]], worker->tri_markers[i]);
+
+        for (int i = 0; i < worker->edges_count; i++)
+          this->add_edge(vertex_map[worker->edges[i][0]], vertex_map[worker->edges[i][1]], worker->edge_markers[i]);
+
+        delete [] vertex_map;
       }
 
       void Vectorizer::free()
@@ -824,6 +889,24 @@ namespace Hermes
         free();
       }
 
+      void Vectorizer::write_step(LinearizedDataWriter* writer, const char* quantity_name, double time)
+      {
+        lock_data();
+        try
+        {
+          writer->begin_step(time, this->vertex_count, &this->verts[0][0], &this->verts[0][1], NULL, 4, this->triangle_count, this->tris);
+          const double* values[2] = { &this->verts[0][2], &this->verts[0][3] };
+          writer->add_point_field(quantity_name, 2, values, 4);
+          writer->add_cell_field("marker", this->tri_markers);
+        }
+        catch(Hermes::Exceptions::Exception&)
+        {
+          unlock_data();
+          throw;
+        }
+        unlock_data();
+      }
+
       void Vectorizer::calc_vertices_aabb(double* min_x, double* max_x, double* min_y, double* max_y) const
       {
         if(verts == NULL)
@@ -34,7 +34,7 @@ namespace Hermes
     static const std::string H2D_DG_INNER_EDGE = "-1234567";
 
     template<typename Scalar>
-    WeakForm<Scalar>::WeakForm(unsigned int neq, bool mat_free) : Hermes::Mixins::Loggable(true), warned_nonOverride(false)
+    WeakForm<Scalar>::WeakForm(unsigned int neq, bool mat_free) : Hermes::Mixins::Loggable(true), warned_nonOverride(false), modification_count(0)
     {
       this->neq = neq;
       this->is_matfree = mat_free;
@@ -45,9 +45,13 @@ namespace Hermes
     {
       for(unsigned int i = 0; i < this->ext.size(); i++)
         delete this->ext[i];
+      this->ext.clear();
       for(unsigned int i = 0; i < this->forms.size(); i++)
+      {
         for(unsigned int j = 0; j < get_forms()[i]->ext.size(); j++)
           delete get_forms()[i]->ext[j];
+        get_forms()[i]->ext.clear();
+      }
     }
 
     template<typename Scalar>
@@ -117,10 +121,6 @@ namespace Hermes
         if(dynamic_cast<VectorFormDG<Scalar>*>(otherWf->forms[i]) != NULL)
           this->forms.push_back((dynamic_cast<VectorFormDG<Scalar>*>(otherWf->forms[i]))->clone());
 
-        Hermes::vector<MeshFunction<Scalar>*> newExt;
-        for(unsigned int ext_i = 0; ext_i < otherWf->forms[i]->ext.size(); ext_i++)
-          newExt.push_back(otherWf->forms[i]->ext[ext_i]->clone());
-        this->forms.back()->set_ext(newExt);
         this->forms.back()->wf = this;
 
         if(dynamic_cast<MatrixFormVol<Scalar>*>(otherWf->forms[i]) != NULL)
@@ -137,6 +137,20 @@ namespace Hermes
         if(dynamic_cast<VectorFormDG<Scalar>*>(otherWf->forms[i]) != NULL)
           this->vfDG.push_back(dynamic_cast<VectorFormDG<Scalar>*>(this->forms.back()));
       }
+      clone_ext(otherWf);
+    }
+
+    template<typename Scalar>
+    void WeakForm<Scalar>::clone_ext(const WeakForm<Scalar>* otherWf)
+    {
+      for(unsigned int i = 0; i < otherWf->forms.size(); i++)
+      {
+        this->forms[i]->ext.clear();
+        for(unsigned int ext_i = 0; ext_i < otherWf->forms[i]->ext.size(); ext_i++)
+          this->forms[i]->ext.push_back(otherWf->forms[i]->ext[ext_i]->clone());
+      }
+
+      this->ext.clear();
       for(unsigned int i = 0; i < otherWf->ext.size(); i++)
       {
         this->ext.push_back(otherWf->ext[i]->clone());
@@ -147,6 +161,33 @@ namespace Hermes
       }
     }
 
+    template<typename Scalar>
+    void WeakForm<Scalar>::sync_with(const WeakForm<Scalar>* otherWf)
+    {
+      this->current_time = otherWf->current_time;
+      this->current_time_step = otherWf->current_time_step;
+      for(unsigned int i = 0; i < otherWf->forms.size(); i++)
+      {
+        this->forms[i]->scaling_factor = otherWf->forms[i]->scaling_factor;
+        this->forms[i]->explicit_in_time = otherWf->forms[i]->explicit_in_time;
+        this->forms[i]->time_independent = otherWf->forms[i]->time_independent;
+        this->forms[i]->u_ext_offset = otherWf->forms[i]->u_ext_offset;
+        this->forms[i]->stage_time = otherWf->forms[i]->stage_time;
+      }
+    }
+
+    template<typename Scalar>
+    void WeakForm<Scalar>::set_modified()
+    {
+      this->modification_count++;
+    }
+
+    template<typename Scalar>
+    unsigned int WeakForm<Scalar>::get_modification_count() const
+    {
+      return this->modification_count;
+    }
+
     template<typename Scalar>
     void WeakForm<Scalar>::delete_all()
     {
@@ -157,6 +198,7 @@ namespace Hermes
       vfsurf.clear();
       vfDG.clear();
       forms.clear();
+      modification_count++;
     };
 
     template<typename Scalar>
@@ -164,12 +206,14 @@ namespace Hermes
     {
       this->ext.clear();
       this->ext.push_back(ext);
+      modification_count++;
     }
 
     template<typename Scalar>
     void WeakForm<Scalar>::set_ext(Hermes::vector<MeshFunction<Scalar>*> ext)
     {
       this->ext = ext;
+      modification_count++;
     }
 
     template<typename Scalar>
@@ -179,7 +223,7 @@ namespace Hermes
     }
 
     template<typename Scalar>
-    Form<Scalar>::Form() : scaling_factor(1.0), u_ext_offset(0), wf(NULL)
+    Form<Scalar>::Form() : u_ext_offset(0), scaling_factor(1.0), explicit_in_time(false), time_independent(false), order_formula_declared(false), wf(NULL), markers_resolved(false), assembled_everywhere(false)
     {
       areas.push_back(HERMES_ANY);
       stage_time = 0.0;
@@ -190,6 +234,40 @@ namespace Hermes
     {
     }
 
+    template<typename Scalar>
+    bool Form<Scalar>::get_order_formula(int& u_coefficient, int& v_coefficient, int& ext_coefficient, int& increase) const
+    {
+      if(!order_formula_declared)
+        return false;
+      u_coefficient = order_formula[0];
+      v_coefficient = order_formula[1];
+      ext_coefficient = order_formula[2];
+      increase = order_formula[3];
+      return true;
+    }
+
+    template<typename Scalar>
+    void Form<Scalar>::set_order_formula(int u_coefficient, int v_coefficient, int ext_coefficient, int increase)
+    {
+      if(u_coefficient < 0 || v_coefficient < 0 || ext_coefficient < 0)
+        throw Hermes::Exceptions::Exception("Form::set_order_formula(): the coefficients have to be nonnegative.");
+      order_formula[0] = u_coefficient;
+      order_formula[1] = v_coefficient;
+      order_formula[2] = ext_coefficient;
+      order_formula[3] = increase;
+      order_formula_declared = true;
+      if(this->wf != NULL)
+        this->wf->set_modified();
+    }
+
+    template<typename Scalar>
+    void Form<Scalar>::set_constant_order(int order)
+    {
+      if(order < 0)
+        throw Hermes::Exceptions::ValueException("order", order, 0);
+      set_order_formula(0, 0, 0, order);
+    }
+
     template<typename Scalar>
     void Form<Scalar>::set_current_stage_time(double time)
     {
@@ -207,11 +285,17 @@ namespace Hermes
     {
       areas.clear();
       areas.push_back(area);
+      markers_resolved = false;
+      if(this->wf != NULL)
+        this->wf->set_modified();
     }
     template<typename Scalar>
     void Form<Scalar>::set_areas(Hermes::vector<std::string> areas)
     {
       this->areas = areas;
+      this->markers_resolved = false;
+      if(this->wf != NULL)
+        this->wf->set_modified();
     }
 
     template<typename Scalar>
@@ -226,6 +310,30 @@ namespace Hermes
       this->scaling_factor = scalingFactor;
     }
 
+    template<typename Scalar>
+    void Form<Scalar>::set_explicit_in_time(bool onOff)
+    {
+      this->explicit_in_time = onOff;
+    }
+
+    template<typename Scalar>
+    bool Form<Scalar>::is_explicit_in_time() const
+    {
+      return this->explicit_in_time;
+    }
+
+    template<typename Scalar>
+    void Form<Scalar>::set_time_independent(bool onOff)
+    {
+      this->time_independent = onOff;
+    }
+
+    template<typename Scalar>
+    bool Form<Scalar>::is_time_independent() const
+    {
+      return this->time_independent;
+    }
+
     template<typename Scalar>
     void Form<Scalar>::set_uExtOffset(int u_ext_offset)
     {
@@ -237,12 +345,16 @@ namespace Hermes
     {
       this->ext.clear();
       this->ext.push_back(ext);
+      if(this->wf != NULL)
+        this->wf->set_modified();
     }
 
     template<typename Scalar>
     void Form<Scalar>::set_ext(Hermes::vector<MeshFunction<Scalar>*> ext)
     {
       this->ext = ext;
+      if(this->wf != NULL)
+        this->wf->set_modified();
     }
 
     template<typename Scalar>
@@ -301,6 +413,26 @@ namespace Hermes
       return this->sym;
     }
 
+    template<typename Scalar>
+    bool MatrixFormVol<Scalar>::value_all(int n, double *wt, Func<Scalar> *u_ext[], int u_count, Func<double> **u, int v_count, Func<double> **v,
+      Geom<double> *e, Func<Scalar> **ext, Scalar **local_matrix) const
+    {
+      return false;
+    }
+
+    template<typename Scalar>
+    bool MatrixFormVol<Scalar>::get_constant_coefficients(Scalar& mass_coefficient, Scalar& diffusion_coefficient) const
+    {
+      return false;
+    }
+
+    template<typename Scalar>
+    bool MatrixFormVol<Scalar>::get_point_coefficients(int n, Func<Scalar> *u_ext[], Geom<double> *e, Func<Scalar> **ext,
+      Scalar* mass, Scalar* diffusion) const
+    {
+      return false;
+    }
+
     template<typename Scalar>
     MatrixFormVol<Scalar>* MatrixFormVol<Scalar>::clone() const
     {
@@ -308,6 +440,45 @@ namespace Hermes
       return NULL;
     }
 
+    template<typename Scalar>
+    MatrixFormVolBlock<Scalar>::MatrixFormVolBlock(unsigned int i, unsigned int j, unsigned int block_count) :
+    MatrixFormVol<Scalar>(i, j), block_count(block_count)
+    {
+      if(block_count == 0)
+        throw Hermes::Exceptions::ValueException("block_count", block_count, 1);
+    }
+
+    template<typename Scalar>
+    MatrixFormVolBlock<Scalar>::~MatrixFormVolBlock()
+    {
+    }
+
+    template<typename Scalar>
+    unsigned int MatrixFormVolBlock<Scalar>::get_block_count() const
+    {
+      return this->block_count;
+    }
+
+    template<typename Scalar>
+    bool MatrixFormVolBlock<Scalar>::has_block(unsigned int bi, unsigned int bj) const
+    {
+      return true;
+    }
+
+    template<typename Scalar>
+    bool MatrixFormVolBlock<Scalar>::value_all_blocks(int n, double *wt, Func<Scalar> *u_ext[], const int* u_counts, Func<double> ***u, const int* v_counts, Func<double> ***v,
+      Geom<double> *e, Func<Scalar> **ext, Scalar **local_matrix) const
+    {
+      return false;
+    }
+
+    template<typename Scalar>
+    Scalar MatrixFormVolBlock<Scalar>::value(int n, double *wt, Func<Scalar> *u_ext[], Func<double> *u, Func<double> *v,
+      Geom<double> *e, Func<Scalar> **ext) const
+    {
+      return this->value_block(0, 0, n, wt, u_ext, u, v, e, ext);
+    }
+
     template<typename Scalar>
     MatrixFormSurf<Scalar>::MatrixFormSurf(unsigned int i, unsigned int j) :
     MatrixForm<Scalar>(i, j)
@@ -346,6 +517,13 @@ namespace Hermes
       return 0.0;
     }
 
+    template<typename Scalar>
+    bool MatrixFormDG<Scalar>::value_all(int n, double *wt, int u_count, DiscontinuousFunc<double> **u, int v_count, DiscontinuousFunc<double> **v,
+      Geom<double> *e, DiscontinuousFunc<Scalar> **ext, Scalar **local_matrix) const
+    {
+      return false;
+    }
+
     template<typename Scalar>
     Hermes::Ord MatrixFormDG<Scalar>::ord(int n, double *wt, DiscontinuousFunc<Hermes::Ord> *u, DiscontinuousFunc<Hermes::Ord> *v,
       Geom<Hermes::Ord> *e, DiscontinuousFunc<Ord> **ext) const
@@ -399,6 +577,13 @@ namespace Hermes
       return Hermes::Ord();
     }
 
+    template<typename Scalar>
+    bool VectorFormVol<Scalar>::get_point_fluxes(int n, Func<Scalar> *u_ext[], Geom<double> *e, Func<Scalar> **ext,
+      Scalar* f_val, Scalar* f_dx, Scalar* f_dy) const
+    {
+      return false;
+    }
+
     template<typename Scalar>
     VectorFormVol<Scalar>* VectorFormVol<Scalar>::clone() const
     {
@@ -468,6 +653,14 @@ namespace Hermes
         throw Hermes::Exceptions::Exception("\"sym\" must be -1, 0 or 1.");
       if(form->sym < 0 && form->i == form->j)
         throw Hermes::Exceptions::Exception("Only off-diagonal forms can be antisymmetric.");
+      MatrixFormVolBlock<Scalar>* block_form = dynamic_cast<MatrixFormVolBlock<Scalar>*>(form);
+      if(block_form != NULL)
+      {
+        if(form->i + block_form->get_block_count() > neq || form->j + block_form->get_block_count() > neq)
+          throw Hermes::Exceptions::Exception("Invalid equation number.");
+        if(form->sym != HERMES_NONSYM)
+          throw Hermes::Exceptions::Exception("Vector-valued forms assemble all their blocks, they can not be (anti-)symmetric.");
+      }
       if(mfvol.size() > 100)
       {
         this->warn("Large number of forms (> 100). Is this the intent?");
@@ -476,6 +669,7 @@ namespace Hermes
       form->set_weakform(this);
       mfvol.push_back(form);
       forms.push_back(form);
+      modification_count++;
     }
 
     template<typename Scalar>
@@ -487,6 +681,7 @@ namespace Hermes
       form->set_weakform(this);
       mfsurf.push_back(form);
       forms.push_back(form);
+      modification_count++;
     }
 
     template<typename Scalar>
@@ -498,6 +693,7 @@ namespace Hermes
       form->set_weakform(this);
       mfDG.push_back(form);
       forms.push_back(form);
+      modification_count++;
     }
 
     template<typename Scalar>
@@ -508,6 +704,7 @@ namespace Hermes
       form->set_weakform(this);
       vfvol.push_back(form);
       forms.push_back(form);
+      modification_count++;
     }
 
     template<typename Scalar>
@@ -519,6 +716,7 @@ namespace Hermes
       form->set_weakform(this);
       vfsurf.push_back(form);
       forms.push_back(form);
+      modification_count++;
     }
 
     template<typename Scalar>
@@ -530,6 +728,7 @@ namespace Hermes
       form->set_weakform(this);
       vfDG.push_back(form);
       forms.push_back(form);
+      modification_count++;
     }
 
     template<typename Scalar>
@@ -582,6 +781,17 @@ namespace Hermes
       }
       for (unsigned i = 0; i < mfvol.size(); i++)
       {
+        // A vector-valued form covers several blocks.
+        MatrixFormVolBlock<Scalar>* block_form = dynamic_cast<MatrixFormVolBlock<Scalar>*>(mfvol[i]);
+        if(block_form != NULL)
+        {
+          if(fabs(mfvol[i]->scaling_factor) > 1e-12)
+            for(unsigned int bi = 0; bi < block_form->get_block_count(); bi++)
+              for(unsigned int bj = 0; bj < block_form->get_block_count(); bj++)
+                if(block_form->has_block(bi, bj))
+                  blocks[mfvol[i]->i + bi][mfvol[i]->j + bj] = true;
+          continue;
+        }
         if(fabs(mfvol[i]->scaling_factor) > 1e-12)
           blocks[mfvol[i]->i][mfvol[i]->j] = true;
         if(mfvol[i]->sym)
@@ -629,6 +839,8 @@ namespace Hermes
     template class HERMES_API MatrixForm<std::complex<double> >;
     template class HERMES_API MatrixFormVol<double>;
     template class HERMES_API MatrixFormVol<std::complex<double> >;
+    template class HERMES_API MatrixFormVolBlock<double>;
+    template class HERMES_API MatrixFormVolBlock<std::complex<double> >;
     template class HERMES_API MatrixFormSurf<double>;
     template class HERMES_API MatrixFormSurf<std::complex<double> >;
     template class HERMES_API MatrixFormDG<double>;
@@ -0,0 +1,281 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "weakforms_dg.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    namespace WeakFormsDG
+    {
+      template<typename Scalar>
+      DefaultMatrixFormVolAdvection<Scalar>::DefaultMatrixFormVolAdvection(int i, int j,
+        Hermes2DFunction<double>* velocity_x, Hermes2DFunction<double>* velocity_y, std::string area)
+        : MatrixFormVol<Scalar>(i, j), velocity_x(velocity_x), velocity_y(velocity_y)
+      {
+        this->set_area(area);
+      }
+
+      template<typename Scalar>
+      Scalar DefaultMatrixFormVolAdvection<Scalar>::value(int n, double *wt, Func<Scalar> *u_ext[], Func<double> *u,
+        Func<double> *v, Geom<double> *e, Func<Scalar> **ext) const
+      {
+        Scalar result = 0;
+        for (int i = 0; i < n; i++)
+          result += -wt[i] * u->val[i] * (velocity_x->value(e->x[i], e->y[i]) * v->dx[i] + velocity_y->value(e->x[i], e->y[i]) * v->dy[i]);
+        return result;
+      }
+
+      template<typename Scalar>
+      bool DefaultMatrixFormVolAdvection<Scalar>::value_all(int n, double *wt, Func<Scalar> *u_ext[], int u_count, Func<double> **u, int v_count, Func<double> **v,
+        Geom<double> *e, Func<Scalar> **ext, Scalar **local_matrix) const
+      {
+        // The weighted velocity, evaluated once per integration point.
+        double* a_x = new double[n];
+        double* a_y = new double[n];
+        for (int i = 0; i < n; i++)
+        {
+          a_x[i] = -wt[i] * velocity_x->value(e->x[i], e->y[i]);
+          a_y[i] = -wt[i] * velocity_y->value(e->x[i], e->y[i]);
+        }
+
+        double* a_dot_grad_v = new double[n];
+        for (int iv = 0; iv < v_count; iv++)
+        {
+          double* v_dx = v[iv]->dx;
+          double* v_dy = v[iv]->dy;
+          for (int i = 0; i < n; i++)
+            a_dot_grad_v[i] = a_x[i] * v_dx[i] + a_y[i] * v_dy[i];
+
+          for (int ju = 0; ju < u_count; ju++)
+          {
+            double* u_val = u[ju]->val;
+            double result = 0;
+            for (int i = 0; i < n; i++)
+              result += u_val[i] * a_dot_grad_v[i];
+            local_matrix[iv][ju] = result;
+          }
+        }
+
+        delete [] a_dot_grad_v;
+        delete [] a_x;
+        delete [] a_y;
+        return true;
+      }
+
+      template<typename Scalar>
+      Ord DefaultMatrixFormVolAdvection<Scalar>::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Func<Ord> *v,
+        Geom<Ord> *e, Func<Ord> **ext) const
+      {
+        Ord result = Ord(0);
+        for (int i = 0; i < n; i++)
+          result += -wt[i] * u->val[i] * (velocity_x->value(e->x[i], e->y[i]) * v->dx[i] + velocity_y->value(e->x[i], e->y[i]) * v->dy[i]);
+        return result;
+      }
+
+      template<typename Scalar>
+      MatrixFormVol<Scalar>* DefaultMatrixFormVolAdvection<Scalar>::clone() const
+      {
+        return new DefaultMatrixFormVolAdvection<Scalar>(*this);
+      }
+
+      template<typename Scalar>
+      DefaultMatrixFormSurfUpwind<Scalar>::DefaultMatrixFormSurfUpwind(int i, int j,
+        Hermes2DFunction<double>* velocity_x, Hermes2DFunction<double>* velocity_y, std::string area)
+        : MatrixFormSurf<Scalar>(i, j), velocity_x(velocity_x), velocity_y(velocity_y)
+      {
+        this->set_area(area);
+      }
+
+      template<typename Scalar>
+      Scalar DefaultMatrixFormSurfUpwind<Scalar>::value(int n, double *wt, Func<Scalar> *u_ext[], Func<double> *u,
+        Func<double> *v, Geom<double> *e, Func<Scalar> **ext) const
+      {
+        Scalar result = 0;
+        for (int i = 0; i < n; i++)
+        {
+          double a_dot_n = velocity_x->value(e->x[i], e->y[i]) * e->nx[i] + velocity_y->value(e->x[i], e->y[i]) * e->ny[i];
+          result += wt[i] * std::max(a_dot_n, 0.0) * u->val[i] * v->val[i];
+        }
+        return result;
+      }
+
+      template<typename Scalar>
+      Ord DefaultMatrixFormSurfUpwind<Scalar>::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Func<Ord> *v,
+        Geom<Ord> *e, Func<Ord> **ext) const
+      {
+        Ord result = Ord(0);
+        for (int i = 0; i < n; i++)
+          result += wt[i] * (velocity_x->value(e->x[i], e->y[i]) * e->nx[i] + velocity_y->value(e->x[i], e->y[i]) * e->ny[i]) * u->val[i] * v->val[i];
+        return result;
+      }
+
+      template<typename Scalar>
+      MatrixFormSurf<Scalar>* DefaultMatrixFormSurfUpwind<Scalar>::clone() const
+      {
+        return new DefaultMatrixFormSurfUpwind<Scalar>(*this);
+      }
+
+      template<typename Scalar>
+      DefaultVectorFormSurfUpwind<Scalar>::DefaultVectorFormSurfUpwind(int i,
+        Hermes2DFunction<double>* velocity_x, Hermes2DFunction<double>* velocity_y,
+        Hermes2DFunction<Scalar>* inflow_values, std::string area)
+        : VectorFormSurf<Scalar>(i), velocity_x(velocity_x), velocity_y(velocity_y), inflow_values(inflow_values)
+      {
+        this->set_area(area);
+      }
+
+      template<typename Scalar>
+      Scalar DefaultVectorFormSurfUpwind<Scalar>::value(int n, double *wt, Func<Scalar> *u_ext[], Func<double> *v,
+        Geom<double> *e, Func<Scalar> **ext) const
+      {
+        Scalar result = 0;
+        for (int i = 0; i < n; i++)
+        {
+          double a_dot_n = velocity_x->value(e->x[i], e->y[i]) * e->nx[i] + velocity_y->value(e->x[i], e->y[i]) * e->ny[i];
+          if(a_dot_n < 0)
+            result += -wt[i] * a_dot_n * inflow_values->value(e->x[i], e->y[i]) * v->val[i];
+        }
+        return result;
+      }
+
+      template<typename Scalar>
+      Ord DefaultVectorFormSurfUpwind<Scalar>::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *v,
+        Geom<Ord> *e, Func<Ord> **ext) const
+      {
+        Ord result = Ord(0);
+        for (int i = 0; i < n; i++)
+          result += -wt[i] * (velocity_x->value(e->x[i], e->y[i]) * e->nx[i] + velocity_y->value(e->x[i], e->y[i]) * e->ny[i])
+            * inflow_values->value(e->x[i], e->y[i]) * v->val[i];
+        return result;
+      }
+
+      template<typename Scalar>
+      VectorFormSurf<Scalar>* DefaultVectorFormSurfUpwind<Scalar>::clone() const
+      {
+        return new DefaultVectorFormSurfUpwind<Scalar>(*this);
+      }
+
+      template<typename Scalar>
+      DefaultMatrixFormDGUpwind<Scalar>::DefaultMatrixFormDGUpwind(int i, int j,
+        Hermes2DFunction<double>* velocity_x, Hermes2DFunction<double>* velocity_y)
+        : MatrixFormDG<Scalar>(i, j), velocity_x(velocity_x), velocity_y(velocity_y)
+      {
+      }
+
+      template<typename Scalar>
+      Scalar DefaultMatrixFormDGUpwind<Scalar>::value(int n, double *wt, DiscontinuousFunc<double> *u, DiscontinuousFunc<double> *v,
+        Geom<double> *e, DiscontinuousFunc<Scalar> **ext) const
+      {
+        Scalar result = 0;
+        for (int i = 0; i < n; i++)
+        {
+          double a_dot_n = velocity_x->value(e->x[i], e->y[i]) * e->nx[i] + velocity_y->value(e->x[i], e->y[i]) * e->ny[i];
+          double jump_v = (v->fn_central == NULL ? -v->val_neighbor[i] : v->val[i]);
+          if(u->fn_central == NULL)
+            result += wt[i] * std::min(a_dot_n, 0.0) * u->val_neighbor[i] * jump_v;
+          else
+            result += wt[i] * std::max(a_dot_n, 0.0) * u->val[i] * jump_v;
+        }
+        return result;
+      }
+
+      template<typename Scalar>
+      bool DefaultMatrixFormDGUpwind<Scalar>::value_all(int n, double *wt, int u_count, DiscontinuousFunc<double> **u, int v_count, DiscontinuousFunc<double> **v,
+        Geom<double> *e, DiscontinuousFunc<Scalar> **ext, Scalar **local_matrix) const
+      {
+        // The weighted normal velocity split into the parts the central and the neighbor
+        // element are upwind for, decided once per integration point.
+        double* central_flux_wt = new double[n];
+        double* neighbor_flux_wt = new double[n];
+        for (int i = 0; i < n; i++)
+        {
+          double a_dot_n = velocity_x->value(e->x[i], e->y[i]) * e->nx[i] + velocity_y->value(e->x[i], e->y[i]) * e->ny[i];
+          central_flux_wt[i] = wt[i] * std::max(a_dot_n, 0.0);
+          neighbor_flux_wt[i] = wt[i] * std::min(a_dot_n, 0.0);
+        }
+
+        double* u_flux = new double[n];
+        for (int ju = 0; ju < u_count; ju++)
+        {
+          if(u[ju] == NULL)
+            continue;
+
+          // The upwind flux of the basis function.
+          if(u[ju]->fn_central == NULL)
+          {
+            double* u_val = u[ju]->val_neighbor;
+            for (int i = 0; i < n; i++)
+              u_flux[i] = neighbor_flux_wt[i] * u_val[i];
+          }
+          else
+          {
+            double* u_val = u[ju]->val;
+            for (int i = 0; i < n; i++)
+              u_flux[i] = central_flux_wt[i] * u_val[i];
+          }
+
+          // Its products with the jumps of all the test functions.
+          for (int iv = 0; iv < v_count; iv++)
+          {
+            if(v[iv] == NULL)
+              continue;
+            double* v_val = (v[iv]->fn_central == NULL ? v[iv]->val_neighbor : v[iv]->val);
+            double result = 0;
+            for (int i = 0; i < n; i++)
+              result += u_flux[i] * v_val[i];
+            local_matrix[iv][ju] = (v[iv]->fn_central == NULL ? -result : result);
+          }
+        }
+
+        delete [] u_flux;
+        delete [] central_flux_wt;
+        delete [] neighbor_flux_wt;
+        return true;
+      }
+
+      template<typename Scalar>
+      Ord DefaultMatrixFormDGUpwind<Scalar>::ord(int n, double *wt, DiscontinuousFunc<Ord> *u, DiscontinuousFunc<Ord> *v,
+        Geom<Ord> *e, DiscontinuousFunc<Ord> **ext) const
+      {
+        Ord result = Ord(0);
+        for (int i = 0; i < n; i++)
+        {
+          Ord a_dot_n = velocity_x->value(e->x[i], e->y[i]) * e->nx[i] + velocity_y->value(e->x[i], e->y[i]) * e->ny[i];
+          Ord u_val = (u->val != NULL ? u->val[i] : u->val_neighbor[i]);
+          Ord v_val = (v->val != NULL ? v->val[i] : v->val_neighbor[i]);
+          result += wt[i] * a_dot_n * u_val * v_val;
+        }
+        return result;
+      }
+
+      template<typename Scalar>
+      MatrixFormDG<Scalar>* DefaultMatrixFormDGUpwind<Scalar>::clone() const
+      {
+        return new DefaultMatrixFormDGUpwind<Scalar>(*this);
+      }
+
+      template class HERMES_API DefaultMatrixFormVolAdvection<double>;
+      template class HERMES_API DefaultMatrixFormVolAdvection<std::complex<double> >;
+      template class HERMES_API DefaultMatrixFormSurfUpwind<double>;
+      template class HERMES_API DefaultMatrixFormSurfUpwind<std::complex<double> >;
+      template class HERMES_API DefaultVectorFormSurfUpwind<double>;
+      template class HERMES_API DefaultVectorFormSurfUpwind<std::complex<double> >;
+      template class HERMES_API DefaultMatrixFormDGUpwind<double>;
+      template class HERMES_API DefaultMatrixFormDGUpwind<std::complex<double> >;
+    };
+  }
+}
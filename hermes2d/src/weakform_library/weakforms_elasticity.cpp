@@ -284,6 +284,111 @@ namespace Hermes
         return new DefaultJacobianElasticity_1_1<Scalar>(this->i, this->j, this->areas[0], this->lambda, this->mu);
       }
 
+      template<typename Scalar>
+      DefaultJacobianElasticity<Scalar>::DefaultJacobianElasticity
+        (unsigned int i, unsigned int j, double lambda, double mu)
+        : MatrixFormVolBlock<Scalar>(i, j, 2), lambda(lambda), mu(mu)
+      {
+      }
+
+      template<typename Scalar>
+      DefaultJacobianElasticity<Scalar>::DefaultJacobianElasticity
+        (unsigned int i, unsigned int j, std::string area, double lambda, double mu)
+        : MatrixFormVolBlock<Scalar>(i, j, 2), lambda(lambda), mu(mu)
+      {
+        this->set_area(area);
+      }
+
+      template<typename Scalar>
+      void DefaultJacobianElasticity<Scalar>::get_block_coefficients(unsigned int bi, unsigned int bj, double* coefficients) const
+      {
+        if(bi == bj)
+        {
+          coefficients[0] = (bi == 0) ? lambda + 2*mu : mu;
+          coefficients[1] = (bi == 0) ? mu : lambda + 2*mu;
+          coefficients[2] = coefficients[3] = 0.0;
+        }
+        else
+        {
+          coefficients[0] = coefficients[1] = 0.0;
+          coefficients[2] = (bi == 0) ? lambda : mu;
+          coefficients[3] = (bi == 0) ? mu : lambda;
+        }
+      }
+
+      template<typename Scalar>
+      Scalar DefaultJacobianElasticity<Scalar>::value_block(unsigned int bi, unsigned int bj, int n, double *wt, Func<Scalar> *u_ext[], Func<double> *u,
+        Func<double> *v, Geom<double> *e, Func<Scalar> **ext) const
+      {
+        double coefficients[4];
+        get_block_coefficients(bi, bj, coefficients);
+        if(bi == bj)
+          return coefficients[0] * int_dudx_dvdx<double, Scalar>(n, wt, u, v) +
+            coefficients[1] * int_dudy_dvdy<double, Scalar>(n, wt, u, v);
+        else
+          return coefficients[2] * int_dudy_dvdx<double, Scalar>(n, wt, u, v) +
+            coefficients[3] * int_dudx_dvdy<double, Scalar>(n, wt, u, v);
+      }
+
+      template<typename Scalar>
+      bool DefaultJacobianElasticity<Scalar>::value_all_blocks(int n, double *wt, Func<Scalar> *u_ext[], const int* u_counts, Func<double> ***u, const int* v_counts, Func<double> ***v,
+        Geom<double> *e, Func<Scalar> **ext, Scalar **local_matrix) const
+      {
+        double coefficients[2][2][4];
+        for(unsigned int bi = 0; bi < 2; bi++)
+          for(unsigned int bj = 0; bj < 2; bj++)
+            get_block_coefficients(bi, bj, coefficients[bi][bj]);
+
+        // Weighted gradients of one test function, shared by all the basis functions of both components.
+        double* v_dx_wt = new double[n];
+        double* v_dy_wt = new double[n];
+        for(unsigned int bi = 0, row = 0; bi < 2; bi++)
+        {
+          for(int i = 0; i < v_counts[bi]; i++, row++)
+          {
+            Func<double>* test = v[bi][i];
+            for(int k = 0; k < n; k++)
+            {
+              v_dx_wt[k] = wt[k] * test->dx[k];
+              v_dy_wt[k] = wt[k] * test->dy[k];
+            }
+            for(unsigned int bj = 0, col = 0; bj < 2; bj++)
+            {
+              const double* c = coefficients[bi][bj];
+              for(int j = 0; j < u_counts[bj]; j++, col++)
+              {
+                Func<double>* basis = u[bj][j];
+                double xx = 0.0, yy = 0.0, yx = 0.0, xy = 0.0;
+                for(int k = 0; k < n; k++)
+                {
+                  xx += basis->dx[k] * v_dx_wt[k];
+                  yy += basis->dy[k] * v_dy_wt[k];
+                  yx += basis->dy[k] * v_dx_wt[k];
+                  xy += basis->dx[k] * v_dy_wt[k];
+                }
+                local_matrix[row][col] = c[0] * xx + c[1] * yy + c[2] * yx + c[3] * xy;
+              }
+            }
+          }
+        }
+        delete [] v_dx_wt;
+        delete [] v_dy_wt;
+        return true;
+      }
+
+      template<typename Scalar>
+      Ord DefaultJacobianElasticity<Scalar>::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Func<Ord> *v,
+        Geom<Ord> *e, Func<Ord> **ext) const
+      {
+        return int_grad_u_grad_v<Ord, Ord>(n, wt, u, v);
+      }
+
+      template<typename Scalar>
+      MatrixFormVol<Scalar>* DefaultJacobianElasticity<Scalar>::clone() const
+      {
+        return new DefaultJacobianElasticity<Scalar>(this->i, this->j, this->areas[0], this->lambda, this->mu);
+      }
+
       template class HERMES_API DefaultJacobianElasticity_0_0<double>;
       template class HERMES_API DefaultJacobianElasticity_0_1<double>;
       template class HERMES_API DefaultResidualElasticity_0_0<double>;
@@ -291,6 +396,7 @@ namespace Hermes
       template class HERMES_API DefaultResidualElasticity_1_0<double>;
       template class HERMES_API DefaultResidualElasticity_1_1<double>;
       template class HERMES_API DefaultJacobianElasticity_1_1<double>;
+      template class HERMES_API DefaultJacobianElasticity<double>;
     };
   }
 }
\ No newline at end of file
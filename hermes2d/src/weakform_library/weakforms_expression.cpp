@@ -0,0 +1,781 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "weakforms_expression.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    namespace WeakFormsExpression
+    {
+      // The symbols of the expanded polynomials: the components of u, of v, the coordinates and the components of the external functions.
+      static const int SYMBOL_U = 0;
+      static const int SYMBOL_V = 3;
+      static const int SYMBOL_X = 6;
+      static const int SYMBOL_Y = 7;
+      static const int SYMBOL_EXT = 8;
+
+      /// Recursive descent parser expanding the expression into a polynomial in the symbols.
+      template<typename Scalar>
+      class ExpressionParser
+      {
+      public:
+        /// The powers of all the symbols -> the coefficient.
+        typedef std::map<std::vector<int>, Scalar> Polynomial;
+
+        /// A scalar, or a vector (a gradient) of two components.
+        struct Value
+        {
+          bool is_vector;
+          Polynomial c[2];
+        };
+
+        ExpressionParser(const std::string& expression, bool bilinear, const std::map<std::string, Scalar>& parameters, const Hermes::vector<std::string>& ext_names)
+          : expression(expression), position(0), bilinear(bilinear), parameters(parameters), ext_names(ext_names), symbol_count(SYMBOL_EXT + 3 * ext_names.size())
+        {
+        }
+
+        Polynomial parse()
+        {
+          Value result = parse_sum();
+          skip_spaces();
+          if(position < expression.length())
+            error("unexpected character");
+          if(result.is_vector)
+            error("the form is a vector");
+          return result.c[0];
+        }
+
+        int get_symbol_count() const { return symbol_count; }
+
+      private:
+        void error(const char* what) const
+        {
+          throw Hermes::Exceptions::Exception("Expression form: %s at position %d in \"%s\".", what, (int)position, expression.c_str());
+        }
+
+        void skip_spaces()
+        {
+          while(position < expression.length() && isspace((unsigned char)expression[position]))
+            position++;
+        }
+
+        bool accept(char c)
+        {
+          skip_spaces();
+          if(position < expression.length() && expression[position] == c)
+          {
+            position++;
+            return true;
+          }
+          return false;
+        }
+
+        void expect(char c)
+        {
+          if(!accept(c))
+          {
+            char what[32];
+            sprintf(what, "'%c' expected", c);
+            error(what);
+          }
+        }
+
+        Polynomial constant(Scalar value) const
+        {
+          Polynomial p;
+          if(value != Scalar(0.0))
+            p[std::vector<int>(symbol_count, 0)] = value;
+          return p;
+        }
+
+        Polynomial symbol(int index) const
+        {
+          std::vector<int> powers(symbol_count, 0);
+          powers[index] = 1;
+          Polynomial p;
+          p[powers] = Scalar(1.0);
+          return p;
+        }
+
+        static Value scalar(const Polynomial& p)
+        {
+          Value value;
+          value.is_vector = false;
+          value.c[0] = p;
+          return value;
+        }
+
+        static void add(Polynomial& result, const Polynomial& p, Scalar factor)
+        {
+          for(typename Polynomial::const_iterator it = p.begin(); it != p.end(); it++)
+          {
+            Scalar& coefficient = result[it->first];
+            coefficient += factor * it->second;
+            if(coefficient == Scalar(0.0))
+              result.erase(it->first);
+          }
+        }
+
+        Polynomial multiply(const Polynomial& a, const Polynomial& b) const
+        {
+          Polynomial result;
+          for(typename Polynomial::const_iterator it_a = a.begin(); it_a != a.end(); it_a++)
+            for(typename Polynomial::const_iterator it_b = b.begin(); it_b != b.end(); it_b++)
+            {
+              std::vector<int> powers(it_a->first);
+              for(int i = 0; i < symbol_count; i++)
+                powers[i] += it_b->first[i];
+              Polynomial term;
+              term[powers] = it_a->second * it_b->second;
+              add(result, term, Scalar(1.0));
+            }
+          return result;
+        }
+
+        /// The derivative by x (direction 0) or y (direction 1), by the product rule.
+        Polynomial differentiate(const Polynomial& p, int direction) const
+        {
+          Polynomial result;
+          for(typename Polynomial::const_iterator it = p.begin(); it != p.end(); it++)
+          {
+            for(int s = 0; s < symbol_count; s++)
+            {
+              if(it->first[s] == 0)
+                continue;
+              std::vector<int> powers(it->first);
+              powers[s]--;
+              Scalar coefficient = it->second * Scalar((double)it->first[s]);
+              if(s == SYMBOL_X || s == SYMBOL_Y)
+              {
+                if(s - SYMBOL_X != direction)
+                  continue;
+              }
+              else
+              {
+                int function_component = (s < SYMBOL_X) ? s % 3 : (s - SYMBOL_EXT) % 3;
+                if(function_component != CompiledExpression<Scalar>::COMPONENT_VAL)
+                  error("second derivatives are not supported");
+                powers[s + 1 + direction]++;
+              }
+              Polynomial term;
+              term[powers] = coefficient;
+              add(result, term, Scalar(1.0));
+            }
+          }
+          return result;
+        }
+
+        Value parse_sum()
+        {
+          Value result;
+          bool negative = false;
+          if(accept('-'))
+            negative = true;
+          else
+            accept('+');
+          result = parse_product();
+          if(negative)
+            for(int c = 0; c < 2; c++)
+              result.c[c] = multiply(result.c[c], constant(Scalar(-1.0)));
+
+          while(true)
+          {
+            Scalar sign;
+            if(accept('+'))
+              sign = Scalar(1.0);
+            else if(accept('-'))
+              sign = Scalar(-1.0);
+            else
+              break;
+            Value operand = parse_product();
+            if(operand.is_vector != result.is_vector)
+              error("a scalar and a vector added");
+            for(int c = 0; c < 2; c++)
+              add(result.c[c], operand.c[c], sign);
+          }
+          return result;
+        }
+
+        Value parse_product()
+        {
+          Value result = parse_power();
+          while(true)
+          {
+            skip_spaces();
+            if(position >= expression.length())
+              break;
+            char op = expression[position];
+            if(op != '*' && op != '/' && op != '.')
+              break;
+            position++;
+            Value operand = parse_power();
+            if(op == '*')
+            {
+              if(result.is_vector && operand.is_vector)
+                error("two vectors multiplied, use '.'");
+              Value product;
+              product.is_vector = result.is_vector || operand.is_vector;
+              for(int c = 0; c < (product.is_vector ? 2 : 1); c++)
+                product.c[c] = multiply(result.c[result.is_vector ? c : 0], operand.c[operand.is_vector ? c : 0]);
+              result = product;
+            }
+            else if(op == '/')
+            {
+              if(operand.is_vector)
+                error("division by a vector");
+              // Constants only, so that the result stays a polynomial.
+              if(operand.c[0].size() != 1 || operand.c[0].begin()->first != std::vector<int>(symbol_count, 0))
+                error("division by a nonconstant");
+              Scalar divisor = operand.c[0].begin()->second;
+              for(int c = 0; c < 2; c++)
+                result.c[c] = multiply(result.c[c], constant(Scalar(1.0) / divisor));
+            }
+            else
+            {
+              if(!result.is_vector || !operand.is_vector)
+                error("dot product of scalars");
+              Polynomial dot = multiply(result.c[0], operand.c[0]);
+              add(dot, multiply(result.c[1], operand.c[1]), Scalar(1.0));
+              result = scalar(dot);
+            }
+          }
+          return result;
+        }
+
+        Value parse_power()
+        {
+          Value result;
+          if(accept('-'))
+          {
+            result = parse_power();
+            for(int c = 0; c < 2; c++)
+              result.c[c] = multiply(result.c[c], constant(Scalar(-1.0)));
+            return result;
+          }
+          result = parse_primary();
+          if(accept('^'))
+          {
+            if(result.is_vector)
+              error("power of a vector");
+            skip_spaces();
+            if(position >= expression.length() || !isdigit((unsigned char)expression[position]))
+              error("nonnegative integer exponent expected");
+            int exponent = 0;
+            while(position < expression.length() && isdigit((unsigned char)expression[position]))
+              exponent = 10 * exponent + (expression[position++] - '0');
+            Polynomial power = constant(Scalar(1.0));
+            for(int i = 0; i < exponent; i++)
+              power = multiply(power, result.c[0]);
+            result.c[0] = power;
+          }
+          return result;
+        }
+
+        Value parse_primary()
+        {
+          skip_spaces();
+          if(position >= expression.length())
+            error("unexpected end");
+
+          char c = expression[position];
+          if(isdigit((unsigned char)c) || c == '.')
+          {
+            const char* start = expression.c_str() + position;
+            char* end;
+            double number = strtod(start, &end);
+            if(end == start)
+              error("number expected");
+            position += end - start;
+            return scalar(constant(Scalar(number)));
+          }
+
+          if(accept('('))
+          {
+            Value result = parse_sum();
+            expect(')');
+            return result;
+          }
+
+          if(!isalpha((unsigned char)c) && c != '_')
+            error("unexpected character");
+          std::string name;
+          while(position < expression.length() && (isalnum((unsigned char)expression[position]) || expression[position] == '_'))
+            name += expression[position++];
+
+          if(name == "dx" || name == "dy" || name == "grad")
+          {
+            expect('(');
+            Value operand = parse_sum();
+            expect(')');
+            if(operand.is_vector)
+              error("derivative of a vector");
+            if(name == "grad")
+            {
+              Value result;
+              result.is_vector = true;
+              result.c[0] = differentiate(operand.c[0], 0);
+              result.c[1] = differentiate(operand.c[0], 1);
+              return result;
+            }
+            return scalar(differentiate(operand.c[0], name == "dx" ? 0 : 1));
+          }
+          if(name == "dot")
+          {
+            expect('(');
+            Value a = parse_sum();
+            expect(',');
+            Value b = parse_sum();
+            expect(')');
+            if(!a.is_vector || !b.is_vector)
+              error("dot product of scalars");
+            Polynomial dot = multiply(a.c[0], b.c[0]);
+            add(dot, multiply(a.c[1], b.c[1]), Scalar(1.0));
+            return scalar(dot);
+          }
+
+          if(name == "u")
+          {
+            if(!bilinear)
+              error("u in a vector form");
+            return scalar(symbol(SYMBOL_U));
+          }
+          if(name == "v")
+            return scalar(symbol(SYMBOL_V));
+          if(name == "x")
+            return scalar(symbol(SYMBOL_X));
+          if(name == "y")
+            return scalar(symbol(SYMBOL_Y));
+          for(unsigned int ext_i = 0; ext_i < ext_names.size(); ext_i++)
+            if(name == ext_names[ext_i])
+              return scalar(symbol(SYMBOL_EXT + 3 * ext_i));
+          typename std::map<std::string, Scalar>::const_iterator it = parameters.find(name);
+          if(it != parameters.end())
+            return scalar(constant(it->second));
+
+          position -= name.length();
+          error("unknown name");
+          return Value();
+        }
+
+        const std::string& expression;
+        unsigned int position;
+        bool bilinear;
+        const std::map<std::string, Scalar>& parameters;
+        const Hermes::vector<std::string>& ext_names;
+        int symbol_count;
+      };
+
+      template<typename Scalar>
+      CompiledExpression<Scalar>::CompiledExpression(std::string expression, bool bilinear, std::map<std::string, Scalar> parameters, Hermes::vector<std::string> ext_names)
+        : expression(expression), bilinear(bilinear), ext_count(ext_names.size())
+      {
+        ExpressionParser<Scalar> parser(this->expression, bilinear, parameters, ext_names);
+        typename ExpressionParser<Scalar>::Polynomial polynomial = parser.parse();
+        if(polynomial.empty())
+          throw Hermes::Exceptions::Exception("Expression form: \"%s\" is zero.", expression.c_str());
+
+        // Every monomial is one coefficient term of the product of a component of u and a component of v.
+        for(typename ExpressionParser<Scalar>::Polynomial::const_iterator it = polynomial.begin(); it != polynomial.end(); it++)
+        {
+          int a = -1, b = -1, u_power = 0, v_power = 0;
+          for(int c = 0; c < 3; c++)
+          {
+            u_power += it->first[SYMBOL_U + c];
+            v_power += it->first[SYMBOL_V + c];
+            if(it->first[SYMBOL_U + c] > 0)
+              a = c;
+            if(it->first[SYMBOL_V + c] > 0)
+              b = c;
+          }
+          if(v_power != 1 || u_power != (bilinear ? 1 : 0))
+            throw Hermes::Exceptions::Exception("Expression form: \"%s\" is not linear in %s.", expression.c_str(), bilinear ? "u and in v" : "v");
+
+          Monomial monomial;
+          monomial.coefficient = it->second;
+          monomial.powers.assign(it->first.begin() + SYMBOL_X, it->first.end());
+          coefficients[bilinear ? a : 0][b].push_back(monomial);
+        }
+      }
+
+      template<typename Scalar>
+      bool CompiledExpression<Scalar>::is_constant(int a, int b) const
+      {
+        for(unsigned int m = 0; m < coefficients[a][b].size(); m++)
+          for(unsigned int s = 0; s < coefficients[a][b][m].powers.size(); s++)
+            if(coefficients[a][b][m].powers[s] > 0)
+              return false;
+        return true;
+      }
+
+      template<typename Scalar>
+      Scalar CompiledExpression<Scalar>::get_constant(int a, int b) const
+      {
+        Scalar result = Scalar(0.0);
+        for(unsigned int m = 0; m < coefficients[a][b].size(); m++)
+          result += coefficients[a][b][m].coefficient;
+        return result;
+      }
+
+      template<typename Scalar>
+      bool CompiledExpression<Scalar>::coefficients_equal(int a, int b, int c, int d) const
+      {
+        // The monomials are stored in the order of their powers, equal sums have equal sequences.
+        if(coefficients[a][b].size() != coefficients[c][d].size())
+          return false;
+        for(unsigned int m = 0; m < coefficients[a][b].size(); m++)
+          if(coefficients[a][b][m].coefficient != coefficients[c][d][m].coefficient || coefficients[a][b][m].powers != coefficients[c][d][m].powers)
+            return false;
+        return true;
+      }
+
+      template<typename Scalar>
+      bool CompiledExpression<Scalar>::is_symmetric() const
+      {
+        for(int a = 0; a < 3; a++)
+          for(int b = a + 1; b < 3; b++)
+            if(!coefficients_equal(a, b, b, a))
+              return false;
+        return true;
+      }
+
+      template<typename Scalar>
+      void CompiledExpression<Scalar>::evaluate(int a, int b, int n, Geom<double> *e, Func<Scalar> **ext, Scalar* result) const
+      {
+        for(int i = 0; i < n; i++)
+          result[i] = Scalar(0.0);
+
+        for(unsigned int m = 0; m < coefficients[a][b].size(); m++)
+        {
+          const Monomial& monomial = coefficients[a][b][m];
+          for(int i = 0; i < n; i++)
+          {
+            Scalar term = monomial.coefficient;
+            for(int p = 0; p < monomial.powers[0]; p++)
+              term *= e->x[i];
+            for(int p = 0; p < monomial.powers[1]; p++)
+              term *= e->y[i];
+            for(int ext_i = 0; ext_i < ext_count; ext_i++)
+            {
+              const int* powers = &monomial.powers[SYMBOL_EXT - SYMBOL_X + 3 * ext_i];
+              for(int p = 0; p < powers[COMPONENT_VAL]; p++)
+                term *= ext[ext_i]->val[i];
+              for(int p = 0; p < powers[COMPONENT_DX]; p++)
+                term *= ext[ext_i]->dx[i];
+              for(int p = 0; p < powers[COMPONENT_DY]; p++)
+                term *= ext[ext_i]->dy[i];
+            }
+            result[i] += term;
+          }
+        }
+      }
+
+      template<typename T>
+      static T* function_component(Func<T>* f, int component)
+      {
+        return component == CompiledExpression<double>::COMPONENT_VAL ? f->val : (component == CompiledExpression<double>::COMPONENT_DX ? f->dx : f->dy);
+      }
+
+      template<typename Scalar>
+      Hermes::Ord CompiledExpression<Scalar>::evaluate_ord(int a, int b, int n, Func<Hermes::Ord> *u, Func<Hermes::Ord> *v, Geom<Hermes::Ord> *e, Func<Hermes::Ord> **ext) const
+      {
+        Hermes::Ord result = Hermes::Ord(0);
+        for(unsigned int m = 0; m < coefficients[a][b].size(); m++)
+        {
+          const Monomial& monomial = coefficients[a][b][m];
+          for(int i = 0; i < n; i++)
+          {
+            Hermes::Ord term = function_component(v, b)[i];
+            if(u != NULL)
+              term = term * function_component(u, a)[i];
+            for(int p = 0; p < monomial.powers[0]; p++)
+              term = term * e->x[i];
+            for(int p = 0; p < monomial.powers[1]; p++)
+              term = term * e->y[i];
+            for(int ext_i = 0; ext_i < ext_count; ext_i++)
+              for(int c = 0; c < 3; c++)
+                for(int p = 0; p < monomial.powers[SYMBOL_EXT - SYMBOL_X + 3 * ext_i + c]; p++)
+                  term = term * function_component(ext[ext_i], c)[i];
+            result += term;
+          }
+        }
+        return result;
+      }
+
+      template<typename Scalar>
+      void CompiledExpression<Scalar>::get_order_formula(int& u_coefficient, int& v_coefficient, int& ext_coefficient, int& increase) const
+      {
+        // Every monomial is (at most) of the order u_coefficient * order(u) + v_coefficient * order(v) + ext_coefficient * order(ext) + increase,
+        // the maxima of its parts over all monomials bound all of them.
+        u_coefficient = bilinear ? 1 : 0;
+        v_coefficient = 1;
+        ext_coefficient = increase = 0;
+        for(int a = 0; a < 3; a++)
+          for(int b = 0; b < 3; b++)
+            for(unsigned int m = 0; m < coefficients[a][b].size(); m++)
+            {
+              const std::vector<int>& powers = coefficients[a][b][m].powers;
+              increase = std::max(increase, powers[0] + powers[1]);
+              int ext_power = 0;
+              for(unsigned int s = SYMBOL_EXT - SYMBOL_X; s < powers.size(); s++)
+                ext_power += powers[s];
+              ext_coefficient = std::max(ext_coefficient, ext_power);
+            }
+      }
+
+      template<typename Scalar>
+      ExpressionMatrixFormVol<Scalar>::ExpressionMatrixFormVol(int i, int j, std::string expression, std::map<std::string, Scalar> parameters,
+        Hermes::vector<std::string> ext_names, std::string area)
+        : MatrixFormVol<Scalar>(i, j), compiled(expression, true, parameters, ext_names)
+      {
+        this->set_area(area);
+        if(i == j && compiled.is_symmetric())
+          this->setSymFlag(HERMES_SYM);
+      }
+
+      template<typename Scalar>
+      ExpressionMatrixFormVol<Scalar>::ExpressionMatrixFormVol(int i, int j, std::string expression, std::map<std::string, Scalar> parameters,
+        Hermes::vector<std::string> ext_names, Hermes::vector<std::string> areas)
+        : MatrixFormVol<Scalar>(i, j), compiled(expression, true, parameters, ext_names)
+      {
+        this->set_areas(areas);
+        if(i == j && compiled.is_symmetric())
+          this->setSymFlag(HERMES_SYM);
+      }
+
+      template<typename Scalar>
+      Scalar ExpressionMatrixFormVol<Scalar>::value(int n, double *wt, Func<Scalar> *u_ext[], Func<double> *u, Func<double> *v,
+        Geom<double> *e, Func<Scalar> **ext) const
+      {
+        Scalar result = Scalar(0.0);
+        Scalar* coefficient = new Scalar[n];
+        for(int a = 0; a < 3; a++)
+          for(int b = 0; b < 3; b++)
+          {
+            if(!compiled.has_coefficient(a, b))
+              continue;
+            compiled.evaluate(a, b, n, e, ext, coefficient);
+            double* u_a = function_component(u, a);
+            double* v_b = function_component(v, b);
+            for(int i = 0; i < n; i++)
+              result += wt[i] * coefficient[i] * u_a[i] * v_b[i];
+          }
+        delete [] coefficient;
+        return result;
+      }
+
+      template<typename Scalar>
+      bool ExpressionMatrixFormVol<Scalar>::value_all(int n, double *wt, Func<Scalar> *u_ext[], int u_count, Func<double> **u, int v_count, Func<double> **v,
+        Geom<double> *e, Func<Scalar> **ext, Scalar **local_matrix) const
+      {
+        // The coefficients including the integration weights, evaluated once per integration point.
+        Scalar* coefficients[3][3];
+        bool u_component_used[3] = { false, false, false };
+        for(int a = 0; a < 3; a++)
+          for(int b = 0; b < 3; b++)
+          {
+            coefficients[a][b] = NULL;
+            if(!compiled.has_coefficient(a, b))
+              continue;
+            coefficients[a][b] = new Scalar[n];
+            compiled.evaluate(a, b, n, e, ext, coefficients[a][b]);
+            for(int i = 0; i < n; i++)
+              coefficients[a][b][i] *= wt[i];
+            u_component_used[a] = true;
+          }
+
+        // Per test function, the weighted combination of its components multiplying each component of u.
+        Scalar* v_wt = new Scalar[3 * n];
+        for(int iv = 0; iv < v_count; iv++)
+        {
+          for(int a = 0; a < 3; a++)
+          {
+            if(!u_component_used[a])
+              continue;
+            Scalar* v_wt_a = v_wt + a * n;
+            for(int i = 0; i < n; i++)
+              v_wt_a[i] = Scalar(0.0);
+            for(int b = 0; b < 3; b++)
+            {
+              if(coefficients[a][b] == NULL)
+                continue;
+              double* v_b = function_component(v[iv], b);
+              for(int i = 0; i < n; i++)
+                v_wt_a[i] += coefficients[a][b][i] * v_b[i];
+            }
+          }
+
+          for(int ju = 0; ju < u_count; ju++)
+          {
+            Scalar result = Scalar(0.0);
+            for(int a = 0; a < 3; a++)
+            {
+              if(!u_component_used[a])
+                continue;
+              double* u_a = function_component(u[ju], a);
+              Scalar* v_wt_a = v_wt + a * n;
+              for(int i = 0; i < n; i++)
+                result += u_a[i] * v_wt_a[i];
+            }
+            local_matrix[iv][ju] = result;
+          }
+        }
+
+        delete [] v_wt;
+        for(int a = 0; a < 3; a++)
+          for(int b = 0; b < 3; b++)
+            delete [] coefficients[a][b];
+        return true;
+      }
+
+      template<typename Scalar>
+      bool ExpressionMatrixFormVol<Scalar>::is_mass_and_diffusion() const
+      {
+        for(int a = 0; a < 3; a++)
+          for(int b = 0; b < 3; b++)
+            if(a != b && compiled.has_coefficient(a, b))
+              return false;
+        return compiled.coefficients_equal(CompiledExpression<Scalar>::COMPONENT_DX, CompiledExpression<Scalar>::COMPONENT_DX,
+          CompiledExpression<Scalar>::COMPONENT_DY, CompiledExpression<Scalar>::COMPONENT_DY);
+      }
+
+      template<typename Scalar>
+      bool ExpressionMatrixFormVol<Scalar>::get_constant_coefficients(Scalar& mass_coefficient, Scalar& diffusion_coefficient) const
+      {
+        if(!is_mass_and_diffusion() || !compiled.is_constant(0, 0) || !compiled.is_constant(1, 1))
+          return false;
+        mass_coefficient = compiled.get_constant(0, 0);
+        diffusion_coefficient = compiled.get_constant(1, 1);
+        return true;
+      }
+
+      template<typename Scalar>
+      bool ExpressionMatrixFormVol<Scalar>::get_point_coefficients(int n, Func<Scalar> *u_ext[], Geom<double> *e, Func<Scalar> **ext,
+        Scalar* mass, Scalar* diffusion) const
+      {
+        if(!is_mass_and_diffusion())
+          return false;
+        compiled.evaluate(0, 0, n, e, ext, mass);
+        compiled.evaluate(1, 1, n, e, ext, diffusion);
+        return true;
+      }
+
+      template<typename Scalar>
+      bool ExpressionMatrixFormVol<Scalar>::get_order_formula(int& u_coefficient, int& v_coefficient, int& ext_coefficient, int& increase) const
+      {
+        compiled.get_order_formula(u_coefficient, v_coefficient, ext_coefficient, increase);
+        return true;
+      }
+
+      template<typename Scalar>
+      Ord ExpressionMatrixFormVol<Scalar>::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u,
+        Func<Ord> *v, Geom<Ord> *e, Func<Ord> **ext) const
+      {
+        Ord result = Ord(0);
+        for(int a = 0; a < 3; a++)
+          for(int b = 0; b < 3; b++)
+            if(compiled.has_coefficient(a, b))
+              result += compiled.evaluate_ord(a, b, n, u, v, e, ext);
+        return result;
+      }
+
+      template<typename Scalar>
+      MatrixFormVol<Scalar>* ExpressionMatrixFormVol<Scalar>::clone() const
+      {
+        return new ExpressionMatrixFormVol<Scalar>(*this);
+      }
+
+      template<typename Scalar>
+      ExpressionVectorFormVol<Scalar>::ExpressionVectorFormVol(int i, std::string expression, std::map<std::string, Scalar> parameters,
+        Hermes::vector<std::string> ext_names, std::string area)
+        : VectorFormVol<Scalar>(i), compiled(expression, false, parameters, ext_names)
+      {
+        this->set_area(area);
+      }
+
+      template<typename Scalar>
+      ExpressionVectorFormVol<Scalar>::ExpressionVectorFormVol(int i, std::string expression, std::map<std::string, Scalar> parameters,
+        Hermes::vector<std::string> ext_names, Hermes::vector<std::string> areas)
+        : VectorFormVol<Scalar>(i), compiled(expression, false, parameters, ext_names)
+      {
+        this->set_areas(areas);
+      }
+
+      template<typename Scalar>
+      Scalar ExpressionVectorFormVol<Scalar>::value(int n, double *wt, Func<Scalar> *u_ext[], Func<double> *v,
+        Geom<double> *e, Func<Scalar> **ext) const
+      {
+        Scalar result = Scalar(0.0);
+        Scalar* coefficient = new Scalar[n];
+        for(int b = 0; b < 3; b++)
+        {
+          if(!compiled.has_coefficient(0, b))
+            continue;
+          compiled.evaluate(0, b, n, e, ext, coefficient);
+          double* v_b = function_component(v, b);
+          for(int i = 0; i < n; i++)
+            result += wt[i] * coefficient[i] * v_b[i];
+        }
+        delete [] coefficient;
+        return result;
+      }
+
+      template<typename Scalar>
+      bool ExpressionVectorFormVol<Scalar>::get_point_fluxes(int n, Func<Scalar> *u_ext[], Geom<double> *e, Func<Scalar> **ext,
+        Scalar* f_val, Scalar* f_dx, Scalar* f_dy) const
+      {
+        compiled.evaluate(0, CompiledExpression<Scalar>::COMPONENT_VAL, n, e, ext, f_val);
+        compiled.evaluate(0, CompiledExpression<Scalar>::COMPONENT_DX, n, e, ext, f_dx);
+        compiled.evaluate(0, CompiledExpression<Scalar>::COMPONENT_DY, n, e, ext, f_dy);
+        return true;
+      }
+
+      template<typename Scalar>
+      bool ExpressionVectorFormVol<Scalar>::get_order_formula(int& u_coefficient, int& v_coefficient, int& ext_coefficient, int& increase) const
+      {
+        compiled.get_order_formula(u_coefficient, v_coefficient, ext_coefficient, increase);
+        return true;
+      }
+
+      template<typename Scalar>
+      Ord ExpressionVectorFormVol<Scalar>::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *v,
+        Geom<Ord> *e, Func<Ord> **ext) const
+      {
+        Ord result = Ord(0);
+        for(int b = 0; b < 3; b++)
+          if(compiled.has_coefficient(0, b))
+            result += compiled.evaluate_ord(0, b, n, NULL, v, e, ext);
+        return result;
+      }
+
+      template<typename Scalar>
+      VectorFormVol<Scalar>* ExpressionVectorFormVol<Scalar>::clone() const
+      {
+        return new ExpressionVectorFormVol<Scalar>(*this);
+      }
+
+      template class HERMES_API CompiledExpression<double>;
+      template class HERMES_API CompiledExpression<std::complex<double> >;
+      template class HERMES_API ExpressionMatrixFormVol<double>;
+      template class HERMES_API ExpressionMatrixFormVol<std::complex<double> >;
+      template class HERMES_API ExpressionVectorFormVol<double>;
+      template class HERMES_API ExpressionVectorFormVol<std::complex<double> >;
+    };
+  }
+}
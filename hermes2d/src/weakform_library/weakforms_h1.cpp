@@ -15,6 +15,7 @@
 
 #include "weakforms_h1.h"
 #include "api2d.h"
+#include <typeinfo>
 namespace Hermes
 {
   namespace Hermes2D
@@ -105,6 +106,84 @@ namespace Hermes
         return result;
       }
 
+      template<typename Scalar>
+      bool DefaultMatrixFormVol<Scalar>::value_all(int n, double *wt, Func<Scalar> *u_ext[], int u_count, Func<double> **u, int v_count, Func<double> **v,
+        Geom<double> *e, Func<Scalar> **ext, Scalar **local_matrix) const
+      {
+        // Integration weights including the geometry, evaluated once per integration point.
+        Scalar* coeff_wt = new Scalar[n];
+        coeff->value_batch(n, e->x, e->y, coeff_wt);
+        for (int i = 0; i < n; i++)
+        {
+          double geom_wt = wt[i];
+          if(gt == HERMES_AXISYM_X)
+            geom_wt *= e->y[i];
+          else if(gt == HERMES_AXISYM_Y)
+            geom_wt *= e->x[i];
+          coeff_wt[i] *= geom_wt;
+        }
+
+        Scalar* v_wt = new Scalar[n];
+        for (int iv = 0; iv < v_count; iv++)
+        {
+          for (int i = 0; i < n; i++)
+            v_wt[i] = coeff_wt[i] * v[iv]->val[i];
+
+          for (int ju = 0; ju < u_count; ju++)
+          {
+            double* u_val = u[ju]->val;
+            Scalar result = 0;
+            for (int i = 0; i < n; i++)
+              result += u_val[i] * v_wt[i];
+            local_matrix[iv][ju] = result;
+          }
+        }
+
+        delete [] v_wt;
+        delete [] coeff_wt;
+        return true;
+      }
+
+      template<typename Scalar>
+      bool DefaultMatrixFormVol<Scalar>::get_constant_coefficients(Scalar& mass_coefficient, Scalar& diffusion_coefficient) const
+      {
+        // Descendants of Hermes2DFunction may override value() without resetting the constness flag.
+        if(gt != HERMES_PLANAR || !coeff->is_constant() || typeid(*coeff) != typeid(Hermes2DFunction<Scalar>))
+          return false;
+        mass_coefficient = coeff->value(Scalar(0.0), Scalar(0.0));
+        diffusion_coefficient = 0.0;
+        return true;
+      }
+
+      template<typename Scalar>
+      bool DefaultMatrixFormVol<Scalar>::get_order_formula(int& u_coefficient, int& v_coefficient, int& ext_coefficient, int& increase) const
+      {
+        // coeff * u * v
+        if(gt != HERMES_PLANAR || !coeff->is_constant() || typeid(*coeff) != typeid(Hermes2DFunction<Scalar>))
+          return Form<Scalar>::get_order_formula(u_coefficient, v_coefficient, ext_coefficient, increase);
+        u_coefficient = v_coefficient = 1;
+        ext_coefficient = increase = 0;
+        return true;
+      }
+
+      template<typename Scalar>
+      bool DefaultMatrixFormVol<Scalar>::get_point_coefficients(int n, Func<Scalar> *u_ext[], Geom<double> *e, Func<Scalar> **ext,
+        Scalar* mass, Scalar* diffusion) const
+      {
+        coeff->value_batch(n, e->x, e->y, mass);
+        for (int i = 0; i < n; i++)
+        {
+          double geom = 1.0;
+          if(gt == HERMES_AXISYM_X)
+            geom = e->y[i];
+          else if(gt == HERMES_AXISYM_Y)
+            geom = e->x[i];
+          mass[i] *= geom;
+          diffusion[i] = 0.0;
+        }
+        return true;
+      }
+
       template<typename Scalar>
       Ord DefaultMatrixFormVol<Scalar>::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u,
         Func<Ord> *v, Geom<Ord> *e, Func<Ord> **ext) const
@@ -204,6 +283,101 @@ namespace Hermes
         return result;
       }
 
+      template<typename Scalar>
+      bool DefaultJacobianDiffusion<Scalar>::value_all(int n, double *wt, Func<Scalar> *u_ext[], int u_count, Func<double> **u, int v_count, Func<double> **v,
+        Geom<double> *e, Func<Scalar> **ext, Scalar **local_matrix) const
+      {
+        // The coefficient and its derivative, evaluated once per integration point.
+        Scalar* coeff_wt = new Scalar[n];
+        Scalar* coeff_der_wt = new Scalar[n];
+        coeff->value_and_derivative_batch(n, u_ext[idx_j]->val, coeff_wt, coeff_der_wt);
+        for (int i = 0; i < n; i++)
+        {
+          double geom_wt = wt[i];
+          if(gt == HERMES_AXISYM_X)
+            geom_wt *= e->y[i];
+          else if(gt == HERMES_AXISYM_Y)
+            geom_wt *= e->x[i];
+          coeff_wt[i] *= geom_wt;
+          coeff_der_wt[i] *= geom_wt;
+        }
+
+        // Per test function: the weights multiplying u, du/dx and du/dy.
+        Scalar* v_val_wt = new Scalar[n];
+        Scalar* v_dx_wt = new Scalar[n];
+        Scalar* v_dy_wt = new Scalar[n];
+        for (int iv = 0; iv < v_count; iv++)
+        {
+          for (int i = 0; i < n; i++)
+          {
+            v_val_wt[i] = coeff_der_wt[i] * (u_ext[idx_j]->dx[i] * v[iv]->dx[i] + u_ext[idx_j]->dy[i] * v[iv]->dy[i]);
+            v_dx_wt[i] = coeff_wt[i] * v[iv]->dx[i];
+            v_dy_wt[i] = coeff_wt[i] * v[iv]->dy[i];
+          }
+
+          for (int ju = 0; ju < u_count; ju++)
+          {
+            double* u_val = u[ju]->val;
+            double* u_dx = u[ju]->dx;
+            double* u_dy = u[ju]->dy;
+            Scalar result = 0;
+            for (int i = 0; i < n; i++)
+              result += u_val[i] * v_val_wt[i] + u_dx[i] * v_dx_wt[i] + u_dy[i] * v_dy_wt[i];
+            local_matrix[iv][ju] = result;
+          }
+        }
+
+        delete [] v_val_wt;
+        delete [] v_dx_wt;
+        delete [] v_dy_wt;
+        delete [] coeff_wt;
+        delete [] coeff_der_wt;
+        return true;
+      }
+
+      template<typename Scalar>
+      bool DefaultJacobianDiffusion<Scalar>::get_constant_coefficients(Scalar& mass_coefficient, Scalar& diffusion_coefficient) const
+      {
+        // Descendants of Hermes1DFunction may override value() without resetting the constness flag.
+        if(gt != HERMES_PLANAR || !coeff->is_constant() || typeid(*coeff) != typeid(Hermes1DFunction<Scalar>))
+          return false;
+        mass_coefficient = 0.0;
+        diffusion_coefficient = coeff->value(Scalar(0.0));
+        return true;
+      }
+
+      template<typename Scalar>
+      bool DefaultJacobianDiffusion<Scalar>::get_order_formula(int& u_coefficient, int& v_coefficient, int& ext_coefficient, int& increase) const
+      {
+        // coeff * grad u * grad v, the term with the derivative of coeff vanishes.
+        if(gt != HERMES_PLANAR || !coeff->is_constant() || typeid(*coeff) != typeid(Hermes1DFunction<Scalar>))
+          return Form<Scalar>::get_order_formula(u_coefficient, v_coefficient, ext_coefficient, increase);
+        u_coefficient = v_coefficient = 1;
+        ext_coefficient = increase = 0;
+        return true;
+      }
+
+      template<typename Scalar>
+      bool DefaultJacobianDiffusion<Scalar>::get_point_coefficients(int n, Func<Scalar> *u_ext[], Geom<double> *e, Func<Scalar> **ext,
+        Scalar* mass, Scalar* diffusion) const
+      {
+        // The term with the derivative of the coefficient is not of this type.
+        if(!coeff->is_constant() || typeid(*coeff) != typeid(Hermes1DFunction<Scalar>))
+          return false;
+        coeff->value_batch(n, u_ext[idx_j]->val, diffusion);
+        for (int i = 0; i < n; i++)
+        {
+          double geom = 1.0;
+          if(gt == HERMES_AXISYM_X)
+            geom = e->y[i];
+          else if(gt == HERMES_AXISYM_Y)
+            geom = e->x[i];
+          mass[i] = 0.0;
+          diffusion[i] *= geom;
+        }
+        return true;
+      }
+
       template<typename Scalar>
       Ord DefaultJacobianDiffusion<Scalar>::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Func<Ord> *v,
         Geom<Ord> *e, Func<Ord> **ext) const
@@ -302,6 +476,87 @@ namespace Hermes
         return result;
       }
 
+      template<typename Scalar>
+      bool DefaultMatrixFormDiffusion<Scalar>::value_all(int n, double *wt, Func<Scalar> *u_ext[], int u_count, Func<double> **u, int v_count, Func<double> **v,
+        Geom<double> *e, Func<Scalar> **ext, Scalar **local_matrix) const
+      {
+        // Integration weights including the geometry.
+        double* geom_wt = new double[n];
+        for (int i = 0; i < n; i++)
+        {
+          geom_wt[i] = wt[i];
+          if(gt == HERMES_AXISYM_X)
+            geom_wt[i] *= e->y[i];
+          else if(gt == HERMES_AXISYM_Y)
+            geom_wt[i] *= e->x[i];
+        }
+
+        double* v_dx_wt = new double[n];
+        double* v_dy_wt = new double[n];
+        for (int iv = 0; iv < v_count; iv++)
+        {
+          for (int i = 0; i < n; i++)
+          {
+            v_dx_wt[i] = geom_wt[i] * v[iv]->dx[i];
+            v_dy_wt[i] = geom_wt[i] * v[iv]->dy[i];
+          }
+
+          for (int ju = 0; ju < u_count; ju++)
+          {
+            double* u_dx = u[ju]->dx;
+            double* u_dy = u[ju]->dy;
+            double result = 0;
+            for (int i = 0; i < n; i++)
+              result += u_dx[i] * v_dx_wt[i] + u_dy[i] * v_dy_wt[i];
+            local_matrix[iv][ju] = result;
+          }
+        }
+
+        delete [] v_dx_wt;
+        delete [] v_dy_wt;
+        delete [] geom_wt;
+        return true;
+      }
+
+      template<typename Scalar>
+      bool DefaultMatrixFormDiffusion<Scalar>::get_constant_coefficients(Scalar& mass_coefficient, Scalar& diffusion_coefficient) const
+      {
+        // The coefficient is not used by this form.
+        if(gt != HERMES_PLANAR)
+          return false;
+        mass_coefficient = 0.0;
+        diffusion_coefficient = 1.0;
+        return true;
+      }
+
+      template<typename Scalar>
+      bool DefaultMatrixFormDiffusion<Scalar>::get_order_formula(int& u_coefficient, int& v_coefficient, int& ext_coefficient, int& increase) const
+      {
+        // grad u * grad v
+        if(gt != HERMES_PLANAR)
+          return Form<Scalar>::get_order_formula(u_coefficient, v_coefficient, ext_coefficient, increase);
+        u_coefficient = v_coefficient = 1;
+        ext_coefficient = increase = 0;
+        return true;
+      }
+
+      template<typename Scalar>
+      bool DefaultMatrixFormDiffusion<Scalar>::get_point_coefficients(int n, Func<Scalar> *u_ext[], Geom<double> *e, Func<Scalar> **ext,
+        Scalar* mass, Scalar* diffusion) const
+      {
+        for (int i = 0; i < n; i++)
+        {
+          double geom = 1.0;
+          if(gt == HERMES_AXISYM_X)
+            geom = e->y[i];
+          else if(gt == HERMES_AXISYM_Y)
+            geom = e->x[i];
+          mass[i] = 0.0;
+          diffusion[i] = geom;
+        }
+        return true;
+      }
+
       template<typename Scalar>
       Ord DefaultMatrixFormDiffusion<Scalar>::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Func<Ord> *v,
         Geom<Ord> *e, Func<Ord> **ext) const
@@ -467,6 +722,36 @@ namespace Hermes
         return result;
       }
 
+      template<typename Scalar>
+      bool DefaultVectorFormVol<Scalar>::get_point_fluxes(int n, Func<Scalar> *u_ext[], Geom<double> *e, Func<Scalar> **ext,
+        Scalar* f_val, Scalar* f_dx, Scalar* f_dy) const
+      {
+        coeff->value_batch(n, e->x, e->y, f_val);
+        for (int i = 0; i < n; i++)
+        {
+          double geom = 1.0;
+          if(gt == HERMES_AXISYM_X)
+            geom = e->y[i];
+          else if(gt == HERMES_AXISYM_Y)
+            geom = e->x[i];
+          f_val[i] *= geom;
+          f_dx[i] = f_dy[i] = 0.0;
+        }
+        return true;
+      }
+
+      template<typename Scalar>
+      bool DefaultVectorFormVol<Scalar>::get_order_formula(int& u_coefficient, int& v_coefficient, int& ext_coefficient, int& increase) const
+      {
+        // coeff * v
+        if(gt != HERMES_PLANAR || !coeff->is_constant() || typeid(*coeff) != typeid(Hermes2DFunction<Scalar>))
+          return Form<Scalar>::get_order_formula(u_coefficient, v_coefficient, ext_coefficient, increase);
+        u_coefficient = 0;
+        v_coefficient = 1;
+        ext_coefficient = increase = 0;
+        return true;
+      }
+
       template<typename Scalar>
       Ord DefaultVectorFormVol<Scalar>::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *v,
         Geom<Ord> *e, Func<Ord> **ext) const
@@ -555,6 +840,24 @@ namespace Hermes
         return result;
       }
 
+      template<typename Scalar>
+      bool DefaultResidualVol<Scalar>::get_point_fluxes(int n, Func<Scalar> *u_ext[], Geom<double> *e, Func<Scalar> **ext,
+        Scalar* f_val, Scalar* f_dx, Scalar* f_dy) const
+      {
+        coeff->value_batch(n, e->x, e->y, f_val);
+        for (int i = 0; i < n; i++)
+        {
+          double geom = 1.0;
+          if(gt == HERMES_AXISYM_X)
+            geom = e->y[i];
+          else if(gt == HERMES_AXISYM_Y)
+            geom = e->x[i];
+          f_val[i] *= geom * u_ext[idx_i]->val[i];
+          f_dx[i] = f_dy[i] = 0.0;
+        }
+        return true;
+      }
+
       template<typename Scalar>
       Ord DefaultResidualVol<Scalar>::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *v,
         Geom<Ord> *e, Func<Ord> **ext) const
@@ -645,6 +948,27 @@ namespace Hermes
         return result;
       }
 
+      template<typename Scalar>
+      bool DefaultResidualDiffusion<Scalar>::get_point_fluxes(int n, Func<Scalar> *u_ext[], Geom<double> *e, Func<Scalar> **ext,
+        Scalar* f_val, Scalar* f_dx, Scalar* f_dy) const
+      {
+        // The coefficient values go to f_val first.
+        coeff->value_batch(n, u_ext[idx_i]->val, f_val);
+        for (int i = 0; i < n; i++)
+        {
+          double geom = 1.0;
+          if(gt == HERMES_AXISYM_X)
+            geom = e->y[i];
+          else if(gt == HERMES_AXISYM_Y)
+            geom = e->x[i];
+          Scalar coeff_value = geom * f_val[i];
+          f_val[i] = 0.0;
+          f_dx[i] = coeff_value * u_ext[idx_i]->dx[i];
+          f_dy[i] = coeff_value * u_ext[idx_i]->dy[i];
+        }
+        return true;
+      }
+
       template<typename Scalar>
       Ord DefaultResidualDiffusion<Scalar>::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *v,
         Geom<Ord> *e, Func<Ord> **ext) const
@@ -795,6 +1119,18 @@ namespace Hermes
         return result;
       }
 
+      template<typename Scalar>
+      bool DefaultMatrixFormSurf<Scalar>::get_order_formula(int& u_coefficient, int& v_coefficient, int& ext_coefficient, int& increase) const
+      {
+        // coeff * u * v
+        if(gt != HERMES_PLANAR || !coeff->is_constant() || typeid(*coeff) != typeid(Hermes2DFunction<Scalar>))
+          return Form<Scalar>::get_order_formula(u_coefficient, v_coefficient, ext_coefficient, increase);
+        u_coefficient = 1;
+        v_coefficient = 1;
+        ext_coefficient = increase = 0;
+        return true;
+      }
+
       template<typename Scalar>
       Ord DefaultMatrixFormSurf<Scalar>::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u,
         Func<Ord> *v, Geom<Ord> *e, Func<Ord> **ext) const
@@ -948,6 +1284,18 @@ namespace Hermes
         return result;
       }
 
+      template<typename Scalar>
+      bool DefaultVectorFormSurf<Scalar>::get_order_formula(int& u_coefficient, int& v_coefficient, int& ext_coefficient, int& increase) const
+      {
+        // coeff * v
+        if(gt != HERMES_PLANAR || !coeff->is_constant() || typeid(*coeff) != typeid(Hermes2DFunction<Scalar>))
+          return Form<Scalar>::get_order_formula(u_coefficient, v_coefficient, ext_coefficient, increase);
+        u_coefficient = 0;
+        v_coefficient = 1;
+        ext_coefficient = increase = 0;
+        return true;
+      }
+
       template<typename Scalar>
       Ord DefaultVectorFormSurf<Scalar>::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *v,
         Geom<Ord> *e, Func<Ord> **ext) const
@@ -71,6 +71,17 @@ namespace Hermes
         return result;
       }
 
+      template<typename Scalar>
+      bool DefaultMatrixFormVol<Scalar>::value_all(int n, double *wt, Func<Scalar> *u_ext[], int u_count, Func<double> **u, int v_count, Func<double> **v,
+        Geom<double> *e, Func<Scalar> **ext, Scalar **local_matrix) const
+      {
+        // The axisymmetric case is left to value().
+        if(gt != HERMES_PLANAR)
+          return false;
+        int_e_f_all<Scalar>(n, wt, const_coeff, u_count, u, v_count, v, local_matrix);
+        return true;
+      }
+
       template<typename Scalar>
       Ord DefaultMatrixFormVol<Scalar>::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Func<Ord> *v,
         Geom<Ord> *e, Func<Ord> **ext) const
@@ -143,6 +154,17 @@ namespace Hermes
         return result;
       }
 
+      template<typename Scalar>
+      bool DefaultJacobianCurlCurl<Scalar>::value_all(int n, double *wt, Func<Scalar> *u_ext[], int u_count, Func<double> **u, int v_count, Func<double> **v,
+        Geom<double> *e, Func<Scalar> **ext, Scalar **local_matrix) const
+      {
+        // The axisymmetric case is left to value().
+        if(gt != HERMES_PLANAR)
+          return false;
+        int_curl_e_curl_f_all<Scalar>(n, wt, const_coeff, u_count, u, v_count, v, local_matrix);
+        return true;
+      }
+
       template<typename Scalar>
       Ord DefaultJacobianCurlCurl<Scalar>::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Func<Ord> *v,
         Geom<Ord> *e, Func<Ord> **ext) const
@@ -755,6 +755,199 @@ namespace Hermes
                   return matprop.get_src(mat)[g] * int_x_v<Real>(n, wt, v, e);
               }
             }
+
+            template<typename Scalar>
+            Multigroup::Jacobian<Scalar>::Jacobian(const MaterialPropertyMaps& matprop, Mesh *mesh, bool fission, GeomType geom_type)
+              : MatrixFormVolBlock<Scalar>(0, 0, matprop.get_G()),
+              GenericForm(matprop, mesh, geom_type),
+              G(matprop.get_G()), fission(fission)
+            {
+              if(mesh == NULL)
+                throw Hermes::Exceptions::NullException(2);
+
+              bool2 Ss_nnz = matprop.get_scattering_multigroup_structure();
+              bool1 chi_nnz = matprop.get_fission_multigroup_structure();
+              blocks_present.resize(G * G);
+              for (unsigned int gto = 0; gto < G; gto++)
+                for (unsigned int gfrom = 0; gfrom < G; gfrom++)
+                  blocks_present[gto * G + gfrom] = (gto == gfrom) || Ss_nnz[gto][gfrom] || (fission && chi_nnz[gto]);
+
+              marker_coefficients.resize(std::max(mesh->get_element_markers_conversion().min_marker_unused, 0));
+              for (unsigned int marker = 0; marker < marker_coefficients.size(); marker++)
+                calculate_coefficients(marker, marker_coefficients[marker]);
+            }
+
+            template<typename Scalar>
+            void Multigroup::Jacobian<Scalar>::calculate_coefficients(int marker, MarkerCoefficients& coefficients) const
+            {
+              coefficients.valid = false;
+              if(!this->mesh->get_element_markers_conversion().get_user_marker(marker).valid)
+                return;
+              std::string mat = this->mesh->get_element_markers_conversion().get_user_marker(marker).marker;
+
+              bool2 Ss_nnz = matprop.get_scattering_multigroup_structure();
+              bool1 chi_nnz = matprop.get_fission_multigroup_structure();
+              try
+              {
+                coefficients.D = matprop.get_D(mat);
+                const rank1& Sigma_r_elem = matprop.get_Sigma_r(mat);
+                const rank2& Sigma_s_elem = matprop.get_Sigma_s(mat);
+
+                coefficients.reaction.assign(G * G, 0.0);
+                for (unsigned int gto = 0; gto < G; gto++)
+                {
+                  coefficients.reaction[gto * G + gto] += Sigma_r_elem[gto];
+                  for (unsigned int gfrom = 0; gfrom < G; gfrom++)
+                    if(Ss_nnz[gto][gfrom])
+                      coefficients.reaction[gto * G + gfrom] -= Sigma_s_elem[gto][gfrom];
+                  if(fission && chi_nnz[gto])
+                  {
+                    const rank1& nu_elem = matprop.get_nu(mat);
+                    const rank1& Sigma_f_elem = matprop.get_Sigma_f(mat);
+                    const rank1& chi_elem = matprop.get_chi(mat);
+                    for (unsigned int gfrom = 0; gfrom < G; gfrom++)
+                      coefficients.reaction[gto * G + gfrom] -= chi_elem[gto] * nu_elem[gfrom] * Sigma_f_elem[gfrom];
+                  }
+                }
+              }
+              catch(Hermes::Exceptions::Exception&)
+              {
+                // Markers without a material, an error only if an element with the marker is assembled.
+                return;
+              }
+              coefficients.valid = true;
+            }
+
+            template<typename Scalar>
+            const typename Multigroup::Jacobian<Scalar>::MarkerCoefficients& Multigroup::Jacobian<Scalar>::get_coefficients(int marker, MarkerCoefficients& local_coefficients) const
+            {
+              if(marker >= 0 && marker < (int)marker_coefficients.size())
+              {
+                if(!marker_coefficients[marker].valid)
+                  throw Hermes::Exceptions::Exception(E_INVALID_MARKER);
+                return marker_coefficients[marker];
+              }
+
+              calculate_coefficients(marker, local_coefficients);
+              if(!local_coefficients.valid)
+                throw Hermes::Exceptions::Exception(E_INVALID_MARKER);
+              return local_coefficients;
+            }
+
+            template<typename Scalar>
+            void Multigroup::Jacobian<Scalar>::weight_geometry(int n, double* wt_geom, Geom<double> *e) const
+            {
+              if(geom_type == HERMES_AXISYM_X)
+                for (int i = 0; i < n; i++)
+                  wt_geom[i] *= e->y[i];
+              else if(geom_type == HERMES_AXISYM_Y)
+                for (int i = 0; i < n; i++)
+                  wt_geom[i] *= e->x[i];
+            }
+
+            template<typename Scalar>
+            bool Multigroup::Jacobian<Scalar>::has_block(unsigned int bi, unsigned int bj) const
+            {
+              return blocks_present[bi * G + bj];
+            }
+
+            template<typename Scalar>
+            Scalar Multigroup::Jacobian<Scalar>::value_block(unsigned int bi, unsigned int bj, int n, double *wt, Func<Scalar> *u_ext[], Func<double> *u,
+              Func<double> *v, Geom<double> *e, Func<Scalar> **ext) const
+            {
+              MarkerCoefficients local_coefficients;
+              const MarkerCoefficients& coefficients = get_coefficients(e->elem_marker, local_coefficients);
+
+              double* wt_geom = new double[n];
+              memcpy(wt_geom, wt, n * sizeof(double));
+              weight_geometry(n, wt_geom, e);
+
+              Scalar result = coefficients.reaction[bi * G + bj] * int_u_v<double, Scalar>(n, wt_geom, u, v);
+              if(bi == bj)
+                result += coefficients.D[bi] * int_grad_u_grad_v<double, Scalar>(n, wt_geom, u, v);
+
+              delete [] wt_geom;
+              return result;
+            }
+
+            template<typename Scalar>
+            bool Multigroup::Jacobian<Scalar>::value_all_blocks(int n, double *wt, Func<Scalar> *u_ext[], const int* u_counts, Func<double> ***u, const int* v_counts, Func<double> ***v,
+              Geom<double> *e, Func<Scalar> **ext, Scalar **local_matrix) const
+            {
+              MarkerCoefficients local_coefficients;
+              const MarkerCoefficients& coefficients = get_coefficients(e->elem_marker, local_coefficients);
+
+              // The weights with the geometry and the weighted values of one test function, shared by all the groups.
+              double* wt_geom = new double[4 * n];
+              double* v_val_wt = wt_geom + n;
+              double* v_dx_wt = wt_geom + 2 * n;
+              double* v_dy_wt = wt_geom + 3 * n;
+              memcpy(wt_geom, wt, n * sizeof(double));
+              weight_geometry(n, wt_geom, e);
+
+              for (unsigned int gto = 0, row = 0; gto < G; gto++)
+              {
+                for (int i = 0; i < v_counts[gto]; i++, row++)
+                {
+                  Func<double>* test = v[gto][i];
+                  for (int k = 0; k < n; k++)
+                  {
+                    v_val_wt[k] = wt_geom[k] * test->val[k];
+                    v_dx_wt[k] = wt_geom[k] * test->dx[k];
+                    v_dy_wt[k] = wt_geom[k] * test->dy[k];
+                  }
+
+                  for (unsigned int gfrom = 0, col = 0; gfrom < G; gfrom++)
+                  {
+                    if(!blocks_present[gto * G + gfrom])
+                    {
+                      for (int j = 0; j < u_counts[gfrom]; j++, col++)
+                        local_matrix[row][col] = 0.0;
+                      continue;
+                    }
+
+                    double reaction = coefficients.reaction[gto * G + gfrom];
+                    for (int j = 0; j < u_counts[gfrom]; j++, col++)
+                    {
+                      Func<double>* basis = u[gfrom][j];
+                      double mass = 0.0;
+                      for (int k = 0; k < n; k++)
+                        mass += basis->val[k] * v_val_wt[k];
+                      double result = reaction * mass;
+                      if(gto == gfrom)
+                      {
+                        double stiffness = 0.0;
+                        for (int k = 0; k < n; k++)
+                          stiffness += basis->dx[k] * v_dx_wt[k] + basis->dy[k] * v_dy_wt[k];
+                        result += coefficients.D[gto] * stiffness;
+                      }
+                      local_matrix[row][col] = result;
+                    }
+                  }
+                }
+              }
+
+              delete [] wt_geom;
+              return true;
+            }
+
+            template<typename Scalar>
+            Hermes::Ord Multigroup::Jacobian<Scalar>::ord(int n, double *wt, Func<Hermes::Ord> *u_ext[], Func<Hermes::Ord> *u,
+              Func<Hermes::Ord> *v, Geom<Hermes::Ord> *e, Func<Hermes::Ord> **ext) const
+            {
+              if(geom_type == HERMES_PLANAR)
+                return int_grad_u_grad_v<Hermes::Ord, Hermes::Ord>(n, wt, u, v) + int_u_v<Hermes::Ord, Hermes::Ord>(n, wt, u, v);
+              else if(geom_type == HERMES_AXISYM_X)
+                return int_y_grad_u_grad_v<Hermes::Ord, Hermes::Ord>(n, wt, u, v, e) + int_y_u_v<Hermes::Ord, Hermes::Ord>(n, wt, u, v, e);
+              else
+                return int_x_grad_u_grad_v<Hermes::Ord, Hermes::Ord>(n, wt, u, v, e) + int_x_u_v<Hermes::Ord, Hermes::Ord>(n, wt, u, v, e);
+            }
+
+            template<typename Scalar>
+            MatrixFormVol<Scalar>* Multigroup::Jacobian<Scalar>::clone() const
+            {
+              return new Jacobian(*this);
+            }
           }
         }
 
@@ -769,24 +962,20 @@ namespace Hermes
               bool2 Ss_nnz = matprop.get_scattering_multigroup_structure();
               bool1 chi_nnz = matprop.get_fission_multigroup_structure();
 
+              // The Jacobians of all the groups as one form.
+              this->add_matrix_form(new Multigroup::Jacobian<Scalar>(matprop, mesh, true, geom_type));
+
               for (unsigned int gto = 0; gto < G; gto++)
               {
-                this->add_matrix_form(new DiffusionReaction::Jacobian<Scalar>(gto, matprop, mesh, geom_type));
                 this->add_vector_form(new DiffusionReaction::Residual<Scalar>(gto, matprop, mesh, geom_type));
 
                 for (unsigned int gfrom = 0; gfrom < G; gfrom++)
                 {
                   if(Ss_nnz[gto][gfrom])
-                  {
-                    this->add_matrix_form(new Scattering::Jacobian<Scalar>(gto, gfrom, matprop, mesh, geom_type));
                     this->add_vector_form(new Scattering::Residual<Scalar>(gto, gfrom, matprop, mesh, geom_type));
-                  }
 
                   if(chi_nnz[gto])
-                  {
-                    this->add_matrix_form(new FissionYield::Jacobian<Scalar>(gto, gfrom, matprop, mesh, geom_type));
                     this->add_vector_form(new FissionYield::Residual<Scalar>(gto, gfrom, matprop, mesh, geom_type));
-                  }
                 }
               }
             }
@@ -857,18 +1046,17 @@ namespace Hermes
             {
               bool2 Ss_nnz = matprop.get_scattering_multigroup_structure();
 
+              // The Jacobians of all the groups as one form, the fission source is on the right-hand side.
+              this->add_matrix_form(new Multigroup::Jacobian<Scalar>(matprop, mesh, false, geom_type));
+
               for (unsigned int gto = 0; gto < matprop.get_G(); gto++)
               {
-                this->add_matrix_form(new DiffusionReaction::Jacobian<Scalar>(gto, matprop, mesh, geom_type));
                 this->add_vector_form(new DiffusionReaction::Residual<Scalar>(gto, matprop, mesh, geom_type));
 
                 for (unsigned int gfrom = 0; gfrom < matprop.get_G(); gfrom++)
                 {
                   if(Ss_nnz[gto][gfrom])
-                  {
-                    this->add_matrix_form(new Scattering::Jacobian<Scalar>(gto, gfrom, matprop, mesh, geom_type));
                     this->add_vector_form(new Scattering::Residual<Scalar>(gto, gfrom, matprop, mesh, geom_type));
-                  }
                 }
 
                 FissionYield::OuterIterationForm<Scalar>* keff_iteration_form =
@@ -960,6 +1148,9 @@ namespace Hermes
 
             template double ExternalSources::LinearForm<double>::vector_form<double, double>(int n, double *wt, Func<double> *u_ext[],
               Func<double> *v, Geom<double> *e, Func<double> **ext) const;
+
+            template class HERMES_API Multigroup::Jacobian<double>;
+            template class HERMES_API Multigroup::Jacobian<std::complex<double> >;
           }
         }
 
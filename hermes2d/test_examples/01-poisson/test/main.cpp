@@ -0,0 +1,156 @@
+#define HERMES_REPORT_ALL
+#define HERMES_REPORT_FILE "application.log"
+#include "../definitions.h"
+
+//  This test compares the weak forms given by expression strings (WeakFormsExpression) with the
+//  hand-coded ones. The Poisson problem of the example is solved with CustomWeakFormPoisson of the example
+//  (DefaultMatrixFormDiffusion, DefaultVectorFormVol) and with the same weak formulation written as
+//  "lambda*grad(u).grad(v)" and "f*v". A mass term with a point-dependent coefficient is added to both,
+//  hand-coded and as "(1 + x*y)*u*v". The solutions have to be the same.
+//
+//  The following parameters can be changed:
+
+// Uniform polynomial degree of mesh elements.
+const int P_INIT = 3;
+// Number of initial uniform mesh refinements.
+const int INIT_REF_NUM = 1;
+// Maximum allowed relative difference of the solution coefficients
+// (the integration orders of the two may differ on the curved elements).
+const double TOLERANCE = 1e-6;
+
+// Problem parameters.
+const double LAMBDA_AL = 236.0;
+const double LAMBDA_CU = 386.0;
+const double VOLUME_HEAT_SRC = 5e2;
+const double FIXED_BDY_TEMP = 20.0;
+
+/// The hand-coded mass term (1 + x y) u v.
+class CustomMatrixFormMass : public MatrixFormVol<double>
+{
+public:
+  CustomMatrixFormMass() : MatrixFormVol<double>(0, 0)
+  {
+  }
+
+  template<typename Real, typename Scalar>
+  Scalar matrix_form(int n, double *wt, Func<Scalar> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, Func<Scalar> **ext) const
+  {
+    Scalar result = Scalar(0);
+    for (int i = 0; i < n; i++)
+      result += wt[i] * (1.0 + e->x[i] * e->y[i]) * u->val[i] * v->val[i];
+    return result;
+  }
+
+  virtual double value(int n, double *wt, Func<double> *u_ext[], Func<double> *u, Func<double> *v, Geom<double> *e, Func<double> **ext) const
+  {
+    return matrix_form<double, double>(n, wt, u_ext, u, v, e, ext);
+  }
+
+  virtual Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Func<Ord> *v, Geom<Ord> *e, Func<Ord> **ext) const
+  {
+    return matrix_form<Ord, Ord>(n, wt, u_ext, u, v, e, ext);
+  }
+
+  virtual MatrixFormVol<double>* clone() const
+  {
+    return new CustomMatrixFormMass(*this);
+  }
+};
+
+class ExpressionWeakFormPoisson : public WeakForm<double>
+{
+public:
+  ExpressionWeakFormPoisson(std::string mat_al, double lambda_al, std::string mat_cu, double lambda_cu, double src_term) : WeakForm<double>(1)
+  {
+    std::map<std::string, double> parameters;
+    parameters["lambda_al"] = lambda_al;
+    parameters["lambda_cu"] = lambda_cu;
+    parameters["f"] = src_term;
+    Hermes::vector<std::string> no_ext;
+
+    add_matrix_form(new WeakFormsExpression::ExpressionMatrixFormVol<double>(0, 0, "lambda_al*grad(u).grad(v)", parameters, no_ext, mat_al));
+    add_matrix_form(new WeakFormsExpression::ExpressionMatrixFormVol<double>(0, 0, "lambda_cu*grad(u).grad(v)", parameters, no_ext, mat_cu));
+    add_matrix_form(new WeakFormsExpression::ExpressionMatrixFormVol<double>(0, 0, "(1 + x*y)*u*v", parameters));
+
+    add_vector_form(new WeakFormsExpression::ExpressionVectorFormVol<double>(0, "f*v", parameters));
+  }
+};
+
+int main(int argc, char* argv[])
+{
+  // Load the mesh.
+  Mesh mesh;
+  MeshReaderH2DXML mloader;
+  try
+  {
+    mloader.load("../domain.xml", &mesh);
+  }
+  catch(Exceptions::MeshLoadFailureException& e)
+  {
+    e.print_msg();
+    return -1;
+  }
+
+  // Perform initial mesh refinements.
+  for(unsigned int i = 0; i < INIT_REF_NUM; i++)
+    mesh.refine_all_elements();
+
+  // Initialize essential boundary conditions.
+  DefaultEssentialBCConst<double> bc_essential(Hermes::vector<std::string>("Bottom", "Inner", "Outer", "Left"), FIXED_BDY_TEMP);
+  EssentialBCs<double> bcs(&bc_essential);
+
+  // Initialize space.
+  H1Space<double> space(&mesh, &bcs, P_INIT);
+  int ndof = space.get_num_dofs();
+
+  // The hand-coded weak formulation.
+  CustomWeakFormPoisson wf("Aluminum", new Hermes1DFunction<double>(LAMBDA_AL), "Copper",
+    new Hermes1DFunction<double>(LAMBDA_CU), new Hermes2DFunction<double>(-VOLUME_HEAT_SRC));
+  wf.add_matrix_form(new CustomMatrixFormMass());
+
+  // The same weak formulation given by expressions.
+  ExpressionWeakFormPoisson wf_expression("Aluminum", LAMBDA_AL, "Copper", LAMBDA_CU, -VOLUME_HEAT_SRC);
+
+  // Solve both problems.
+  double* sln_vector = new double[ndof];
+  double* sln_vector_expression = new double[ndof];
+  try
+  {
+    LinearSolver<double> linear_solver(&wf, &space);
+    linear_solver.solve();
+    memcpy(sln_vector, linear_solver.get_sln_vector(), ndof * sizeof(double));
+
+    LinearSolver<double> linear_solver_expression(&wf_expression, &space);
+    linear_solver_expression.solve();
+    memcpy(sln_vector_expression, linear_solver_expression.get_sln_vector(), ndof * sizeof(double));
+  }
+  catch(std::exception& e)
+  {
+    std::cout << e.what();
+    printf("Failure!\n");
+    return -1;
+  }
+
+  // Compare the solutions.
+  double max_value = 0.0, max_difference = 0.0;
+  for (int i = 0; i < ndof; i++)
+  {
+    max_value = std::max(max_value, std::abs(sln_vector[i]));
+    max_difference = std::max(max_difference, std::abs(sln_vector[i] - sln_vector_expression[i]));
+  }
+  delete [] sln_vector;
+  delete [] sln_vector_expression;
+
+  Hermes::Mixins::Loggable::Static::info("ndof: %d, relative difference: %g", ndof, max_difference / max_value);
+
+  if(max_difference <= TOLERANCE * max_value)
+  {
+    printf("Success!\n");
+    return 0;
+  }
+  else
+  {
+    printf("Failure!\n");
+    return -1;
+  }
+}
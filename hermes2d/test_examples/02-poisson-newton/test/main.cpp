@@ -0,0 +1,125 @@
+#define HERMES_REPORT_ALL
+#define HERMES_REPORT_FILE "application.log"
+#include "../definitions.h"
+
+//  This test compares the matrix-free Newton's method (Hermes::Algebra::MatrixFreeJacobian solved by
+//  Hermes::Solvers::GMRESSolver) with the Newton's method using the assembled Jacobian and the built-in GMRES
+//  (Hermes::Solvers::KrylovSolver). The problem of the example is solved by both, the solutions have to
+//  agree up to the tolerances of the linear solvers and the finite difference of the Jacobian-vector products.
+//
+//  The following parameters can be changed:
+
+// Uniform polynomial degree of mesh elements.
+const int P_INIT = 3;
+// Number of initial uniform mesh refinements.
+const int INIT_REF_NUM = 0;
+// Stopping criterion for the Newton's method.
+const double NEWTON_TOL = 1e-4;
+// Maximum allowed relative difference of the solution coefficients.
+const double TOLERANCE = 1e-6;
+
+// Problem parameters.
+const double LAMBDA_AL = 236.0;
+const double LAMBDA_CU = 386.0;
+const double VOLUME_HEAT_SRC = 0.0;
+const double ALPHA = 5.0;
+const double T_EXTERIOR = 50.0;
+const double BDY_A_PARAM = 0.0;
+const double BDY_B_PARAM = 0.0;
+const double BDY_C_PARAM = 20.0;
+
+/// The weak formulation of the example without a Jacobian (WeakForm::is_matrix_free()).
+class MatrixFreeWeakFormPoissonNewton : public CustomWeakFormPoissonNewton
+{
+public:
+  MatrixFreeWeakFormPoissonNewton(std::string mat_al, Hermes::Hermes1DFunction<double>* lambda_al,
+    std::string mat_cu, Hermes::Hermes1DFunction<double>* lambda_cu,
+    Hermes::Hermes2DFunction<double>* vol_src_term, std::string bdy_heat_flux,
+    double alpha, double t_exterior) : CustomWeakFormPoissonNewton(mat_al, lambda_al, mat_cu, lambda_cu, vol_src_term, bdy_heat_flux, alpha, t_exterior)
+  {
+    this->is_matfree = true;
+  }
+};
+
+int main(int argc, char* argv[])
+{
+  // Load the mesh.
+  Hermes::Hermes2D::Mesh mesh;
+  Hermes::Hermes2D::MeshReaderH2D mloader;
+  mloader.load("../domain.mesh", &mesh);
+
+  // Perform initial mesh refinements.
+  for (int i = 0; i < INIT_REF_NUM; i++)
+    mesh.refine_all_elements();
+
+  // Initialize boundary conditions.
+  CustomDirichletCondition bc_essential(Hermes::vector<std::string>("Bottom", "Inner", "Left"),
+    BDY_A_PARAM, BDY_B_PARAM, BDY_C_PARAM);
+  Hermes::Hermes2D::EssentialBCs<double> bcs(&bc_essential);
+
+  // Create an H1 space with default shapeset.
+  Hermes::Hermes2D::H1Space<double> space(&mesh, &bcs, P_INIT);
+  int ndof = space.get_num_dofs();
+
+  // The weak formulations with and without the Jacobian.
+  CustomWeakFormPoissonNewton wf("Aluminum", new Hermes::Hermes1DFunction<double>(LAMBDA_AL),
+    "Copper", new Hermes::Hermes1DFunction<double>(LAMBDA_CU),
+    new Hermes::Hermes2DFunction<double>(-VOLUME_HEAT_SRC),
+    "Outer", ALPHA, T_EXTERIOR);
+  MatrixFreeWeakFormPoissonNewton wf_matrix_free("Aluminum", new Hermes::Hermes1DFunction<double>(LAMBDA_AL),
+    "Copper", new Hermes::Hermes1DFunction<double>(LAMBDA_CU),
+    new Hermes::Hermes2DFunction<double>(-VOLUME_HEAT_SRC),
+    "Outer", ALPHA, T_EXTERIOR);
+
+  // The assembled Jacobian is solved by the built-in GMRES.
+  Hermes::HermesCommonApi.set_integral_param_value(Hermes::matrixSolverType, Hermes::SOLVER_KRYLOV);
+
+  double* sln_vector = new double[ndof];
+  double* sln_vector_matrix_free = new double[ndof];
+  try
+  {
+    Hermes::Hermes2D::NewtonSolver<double> newton;
+    newton.set_weak_formulation(&wf);
+    newton.set_space(&space);
+    newton.set_iterative_method("gmres");
+    newton.set_newton_tol(NEWTON_TOL);
+    newton.solve();
+    memcpy(sln_vector, newton.get_sln_vector(), ndof * sizeof(double));
+
+    Hermes::Hermes2D::NewtonSolver<double> newton_matrix_free;
+    newton_matrix_free.set_weak_formulation(&wf_matrix_free);
+    newton_matrix_free.set_space(&space);
+    newton_matrix_free.set_newton_tol(NEWTON_TOL);
+    newton_matrix_free.solve();
+    memcpy(sln_vector_matrix_free, newton_matrix_free.get_sln_vector(), ndof * sizeof(double));
+  }
+  catch(std::exception& e)
+  {
+    std::cout << e.what();
+    printf("Failure!\n");
+    return -1;
+  }
+
+  // Compare the solutions.
+  double max_value = 0.0, max_difference = 0.0;
+  for (int i = 0; i < ndof; i++)
+  {
+    max_value = std::max(max_value, std::abs(sln_vector[i]));
+    max_difference = std::max(max_difference, std::abs(sln_vector[i] - sln_vector_matrix_free[i]));
+  }
+  delete [] sln_vector;
+  delete [] sln_vector_matrix_free;
+
+  Hermes::Mixins::Loggable::Static::info("ndof: %d, relative difference: %g", ndof, max_difference / max_value);
+
+  if(max_difference <= TOLERANCE * max_value)
+  {
+    printf("Success!\n");
+    return 0;
+  }
+  else
+  {
+    printf("Failure!\n");
+    return -1;
+  }
+}
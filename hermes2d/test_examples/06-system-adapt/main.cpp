@@ -80,6 +80,11 @@ const int NDOF_STOP = 60000;
 // Newton's method.
 double NEWTON_TOL_FINE = 1e-0;
 int NEWTON_MAX_ITER = 10;
+// WARM_START = true  ... the Newton's method on the reference mesh starts from the previous
+//                        reference solution projected locally onto the new reference spaces,
+// WARM_START = false ... it starts from zero in every adaptivity step.
+// Compare the Newton's iterations reported in every step.
+const bool WARM_START = true;
 // Matrix solver: SOLVER_AMESOS, SOLVER_AZTECOO, SOLVER_MUMPS,
 // SOLVER_PETSC, SOLVER_SUPERLU, SOLVER_UMFPACK.
 MatrixSolverType matrix_solver = SOLVER_UMFPACK;
@@ -188,7 +193,16 @@ int main(int argc, char* argv[])
 
       newton.set_newton_tol(1e-1);
 
-      newton.solve();
+      // From the second step on, start from the previous reference solution projected locally onto the new reference spaces.
+      if(WARM_START && as > 1)
+      {
+        double* coeff_vec = new double[ndof_ref];
+        LocalProjection<double>::project_local_averaged(ref_spaces_const, Hermes::vector<Solution<double> *>(&u_ref_sln, &v_ref_sln), coeff_vec);
+        newton.solve(coeff_vec);
+        delete [] coeff_vec;
+      }
+      else
+        newton.solve();
     }
     catch(Hermes::Exceptions::Exception& e)
     {
@@ -198,6 +212,7 @@ int main(int argc, char* argv[])
     {
       std::cout << e.what();
     }
+    Hermes::Mixins::Loggable::Static::info("Newton's iterations: %lu.", newton.get_linear_solver_statistics().num_solves);
 
     // Translate the resulting coefficient vector into the instance of Solution.
     Solution<double>::vector_to_solutions(newton.get_sln_vector(), ref_spaces_const,
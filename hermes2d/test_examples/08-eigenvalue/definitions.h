@@ -1,5 +1,8 @@
 #include "hermes2d.h"
 
+using namespace Hermes;
+using namespace Hermes::Hermes2D;
+
 /* Weak forms */
 
 class WeakFormEigenLeft : public WeakForm<double>
@@ -14,14 +17,16 @@ private:
     MatrixFormPotential(int i, int j) : MatrixFormVol<double>(i, j) {};
 
     template<typename Real, typename Scalar>
-    Scalar matrix_form(int n, double *wt, Func<Scalar> *u_ext[], Func<Real> *u, 
-                       Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext) const;
+    Scalar matrix_form(int n, double *wt, Func<Scalar> *u_ext[], Func<Real> *u,
+                       Func<Real> *v, Geom<Real> *e, Func<Scalar> **ext) const;
+
+    virtual double value(int n, double *wt, Func<double> *u_ext[], Func<double> *u,
+                         Func<double> *v, Geom<double> *e, Func<double> **ext) const;
 
-    virtual double value(int n, double *wt, Func<double> *u_ext[], Func<double> *u, 
-                         Func<double> *v, Geom<double> *e, ExtData<double> *ext) const;
+    virtual Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u,
+                    Func<Ord> *v, Geom<Ord> *e, Func<Ord> **ext) const;
 
-    virtual Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, 
-                    Func<Ord> *v, Geom<Ord> *e, ExtData<Ord> *ext) const;
+    MatrixFormVol<double>* clone() const;
   };
 };
 
@@ -30,4 +35,3 @@ class WeakFormEigenRight : public WeakForm<double>
 public:
   WeakFormEigenRight();
 };
-
@@ -3,12 +3,11 @@
 #include "definitions.h"
 #include <stdio.h>
 
-using namespace RefinementSelectors;
-using Teuchos::RCP;
-using Teuchos::rcp;
+using namespace Hermes::Algebra;
+using namespace Hermes::Solvers;
 
 //  This example solves a simple eigenproblem in a square. 
-//  Python and Pysparse must be installed. 
+//  The shift-invert Lanczos eigensolver of Hermes needs UMFPACK or MUMPS.
 //
 //  PDE: -Laplace u + (x*x + y*y)u = lambda_k u,
 //  where lambda_0, lambda_1, ... are the eigenvalues.
@@ -22,19 +21,27 @@ using Teuchos::rcp;
 const int NUMBER_OF_EIGENVALUES = 50;             // Desired number of eigenvalues.
 const int P_INIT = 4;                             // Uniform polynomial degree of mesh elements.
 const int INIT_REF_NUM = 3;                       // Number of initial mesh refinements.
-const double TARGET_VALUE = 2.0;                  // PySparse parameter: Eigenvalues in the vicinity of 
-                                                  // this number will be computed. 
-const double TOL = 1e-10;                         // Pysparse parameter: Error tolerance.
-const int MAX_ITER = 1000;                        // PySparse parameter: Maximum number of iterations.
+const double TARGET_VALUE = 2.0;                  // Eigenvalues in the vicinity of
+                                                  // this number will be computed.
+const double TOL = 1e-10;                         // Error tolerance.
+const int MAX_ITER = 1000;                        // Maximum number of Lanczos steps.
 
 int main(int argc, char* argv[])
 {
-  info("Desired number of eigenvalues: %d.", NUMBER_OF_EIGENVALUES);
+  Hermes::Mixins::Loggable::Static::info("Desired number of eigenvalues: %d.", NUMBER_OF_EIGENVALUES);
 
   // Load the mesh.
   Mesh mesh;
   MeshReaderH2D mloader;
-  mloader.load("domain.mesh", &mesh);
+  try
+  {
+    mloader.load("domain.mesh", &mesh);
+  }
+  catch(Exceptions::MeshLoadFailureException& e)
+  {
+    e.print_msg();
+    return -1;
+  }
 
   // Perform initial mesh refinements (optional).
   for (int i = 0; i < INIT_REF_NUM; i++) mesh.refine_all_elements();
@@ -46,37 +53,38 @@ int main(int argc, char* argv[])
   // Create an H1 space with default shapeset.
   H1Space<double> space(&mesh, &bcs, P_INIT);
   int ndof = space.get_num_dofs();
-  info("ndof: %d.", ndof);
+  Hermes::Mixins::Loggable::Static::info("ndof: %d.", ndof);
 
   // Initialize the weak formulation.
   WeakFormEigenLeft wf_left;
   WeakFormEigenRight wf_right;
 
   // Initialize matrices.
-  RCP<SparseMatrix<double> > matrix_left = rcp(new CSCMatrix<double>());
-  RCP<SparseMatrix<double> > matrix_right = rcp(new CSCMatrix<double>());
+  CSCMatrix<double> matrix_left;
+  CSCMatrix<double> matrix_right;
 
   // Assemble the matrices.
   DiscreteProblem<double> dp_left(&wf_left, &space);
-  dp_left.assemble(matrix_left.get());
+  dp_left.assemble(&matrix_left);
   DiscreteProblem<double> dp_right(&wf_right, &space);
-  dp_right.assemble(matrix_right.get());
+  dp_right.assemble(&matrix_right);
 
-  EigenSolver<double> es(matrix_left, matrix_right);
-  info("Calling Pysparse...");
+  EigenSolver<double> es(&matrix_left, &matrix_right);
+  Hermes::Mixins::Loggable::Static::info("Calling the eigensolver...");
   es.solve(NUMBER_OF_EIGENVALUES, TARGET_VALUE, TOL, MAX_ITER);
-  info("Pysparse finished.");
+  Hermes::Mixins::Loggable::Static::info("Eigensolver finished.");
   es.print_eigenvalues();
 
   // Initializing solution vector, solution and ScalarView.
   double* coeff_vec;
   Solution<double> sln;
-  Views::ScalarView<double> view("Solution", new Views::WinGeom(0, 0, 440, 350));
+  Views::ScalarView view("Solution", new Views::WinGeom(0, 0, 440, 350));
 
   // Reading solution vectors and visualizing.
   double* eigenval = new double[NUMBER_OF_EIGENVALUES];
   int neig = es.get_n_eigs();
-  if (neig != NUMBER_OF_EIGENVALUES) error("Mismatched number of eigenvectors in the eigensolver output file.");  
+  if (neig != NUMBER_OF_EIGENVALUES)
+    Hermes::Mixins::Loggable::Static::warn("Only %d eigenpairs converged.", neig);
   for (int ieig = 0; ieig < neig; ieig++) {
     eigenval[ieig] = es.get_eigenvalue(ieig);
     int n;
@@ -94,6 +102,7 @@ int main(int argc, char* argv[])
     Views::View::wait(Views::HERMES_WAIT_KEYPRESS);
   }
 
-  return 0; 
-};
+  delete [] eigenval;
+  return 0;
+}
 
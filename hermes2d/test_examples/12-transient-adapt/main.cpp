@@ -43,7 +43,11 @@ const int UNREF_FREQ = 2;
 // 1... mesh reset to basemesh and poly degrees to P_INIT.   
 // 2... one ref. layer shaved off, poly degrees reset to P_INIT.
 // 3... one ref. layer shaved off, poly degrees decreased by one. 
-const int UNREF_METHOD = 3;                       
+// 4... selective coarsening of the elements with small errors (Adapt::coarsen()).
+const int UNREF_METHOD = 4;                       
+// Elements whose sons have the sum of squared errors below COARSEN_THRESHOLD times
+// the largest squared error are merged (UNREF_METHOD == 4).
+const double COARSEN_THRESHOLD = 0.01;
 // This is a quantitative parameter of the adapt(...) function and
 // it has different meanings for various adaptive strategies.
 const double THRESHOLD = 0.3;                     
@@ -164,7 +168,7 @@ int main(int argc, char* argv[])
   do
   {
     // Periodic global derefinement.
-    if (ts > 1 && ts % UNREF_FREQ == 0)
+    if (ts > 1 && ts % UNREF_FREQ == 0 && UNREF_METHOD != 4)
     {
       Hermes::Mixins::Loggable::Static::info("Global mesh derefinement.");
       switch (UNREF_METHOD) {
@@ -225,8 +229,15 @@ int main(int argc, char* argv[])
       Hermes::Mixins::Loggable::Static::info("ndof_coarse: %d, ndof_ref: %d, err_est_rel: %g%%",
         Space<double>::get_num_dofs(&space), Space<double>::get_num_dofs(ref_space), err_est_rel_total);
 
+      // Selective derefinement driven by the errors of the first adaptivity step.
+      if (UNREF_METHOD == 4 && ts > 1 && ts % UNREF_FREQ == 0 && as == 1)
+      {
+        Hermes::Mixins::Loggable::Static::info("Selective mesh derefinement.");
+        adaptivity->coarsen(COARSEN_THRESHOLD);
+        as++;
+      }
       // If err_est too large, adapt the mesh.
-      if (err_est_rel_total < ERR_STOP) done = true;
+      else if (err_est_rel_total < ERR_STOP) done = true;
       else
       {
         Hermes::Mixins::Loggable::Static::info("Adapting the coarse mesh.");
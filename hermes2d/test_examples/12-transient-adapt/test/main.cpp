@@ -0,0 +1,212 @@
+#define HERMES_REPORT_ALL
+#define HERMES_REPORT_FILE "application.log"
+#include "hermes2d.h"
+
+using namespace Hermes;
+using namespace Hermes::Hermes2D;
+using namespace Hermes::Algebra;
+
+//  This test compares the sum-factorized assembly of volumetric forms on quads with the standard
+//  quadrature. The same mass and diffusion forms with point-dependent coefficients are assembled
+//  twice on the square mesh of the example: once describing their pointwise structure
+//  (MatrixFormVol::get_point_coefficients(), VectorFormVol::get_point_fluxes()), which makes
+//  DiscreteProblem sum over the points one direction at a time, and once without it, integrated
+//  point by point. The matrices and the right-hand sides have to be the same.
+//
+//  The following parameters can be changed:
+
+// Number of initial uniform mesh refinements.
+const int INIT_REF_NUM = 2;
+// Initial polynomial degree of mesh elements.
+const int P_INIT = 4;
+// Maximum allowed relative difference of the entries.
+const double TOLERANCE = 1e-10;
+
+template<typename Real>
+Real mass_coefficient(Real x, Real y)
+{
+  return 2.0 + x / 10.0;
+}
+
+template<typename Real>
+Real diffusion_coefficient(Real x, Real y)
+{
+  return 1.0 + x * y / 100.0;
+}
+
+template<typename Real>
+Real source(Real x, Real y)
+{
+  return x * x - y;
+}
+
+class CustomMatrixFormVol : public MatrixFormVol<double>
+{
+public:
+  /// @param[in] sum_factorization Describe the form by get_point_coefficients().
+  CustomMatrixFormVol(bool sum_factorization) : MatrixFormVol<double>(0, 0), sum_factorization(sum_factorization)
+  {
+  }
+
+  template<typename Real, typename Scalar>
+  Scalar matrix_form(int n, double *wt, Func<Scalar> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, Func<Scalar> **ext) const
+  {
+    Scalar result = Scalar(0);
+    for (int i = 0; i < n; i++)
+      result += wt[i] * (mass_coefficient(e->x[i], e->y[i]) * u->val[i] * v->val[i]
+        + diffusion_coefficient(e->x[i], e->y[i]) * (u->dx[i] * v->dx[i] + u->dy[i] * v->dy[i]));
+    return result;
+  }
+
+  virtual double value(int n, double *wt, Func<double> *u_ext[], Func<double> *u, Func<double> *v, Geom<double> *e, Func<double> **ext) const
+  {
+    return matrix_form<double, double>(n, wt, u_ext, u, v, e, ext);
+  }
+
+  virtual Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Func<Ord> *v, Geom<Ord> *e, Func<Ord> **ext) const
+  {
+    return matrix_form<Ord, Ord>(n, wt, u_ext, u, v, e, ext);
+  }
+
+  virtual bool get_point_coefficients(int n, Func<double> *u_ext[], Geom<double> *e, Func<double> **ext, double* mass, double* diffusion) const
+  {
+    if(!sum_factorization)
+      return false;
+    for (int i = 0; i < n; i++)
+    {
+      mass[i] = mass_coefficient(e->x[i], e->y[i]);
+      diffusion[i] = diffusion_coefficient(e->x[i], e->y[i]);
+    }
+    return true;
+  }
+
+  virtual MatrixFormVol<double>* clone() const
+  {
+    return new CustomMatrixFormVol(*this);
+  }
+
+private:
+  bool sum_factorization;
+};
+
+class CustomVectorFormVol : public VectorFormVol<double>
+{
+public:
+  /// @param[in] sum_factorization Describe the form by get_point_fluxes().
+  CustomVectorFormVol(bool sum_factorization) : VectorFormVol<double>(0), sum_factorization(sum_factorization)
+  {
+  }
+
+  template<typename Real, typename Scalar>
+  Scalar vector_form(int n, double *wt, Func<Scalar> *u_ext[], Func<Real> *v, Geom<Real> *e, Func<Scalar> **ext) const
+  {
+    Scalar result = Scalar(0);
+    for (int i = 0; i < n; i++)
+      result += wt[i] * (source(e->x[i], e->y[i]) * v->val[i] + e->y[i] * v->dx[i]);
+    return result;
+  }
+
+  virtual double value(int n, double *wt, Func<double> *u_ext[], Func<double> *v, Geom<double> *e, Func<double> **ext) const
+  {
+    return vector_form<double, double>(n, wt, u_ext, v, e, ext);
+  }
+
+  virtual Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *v, Geom<Ord> *e, Func<Ord> **ext) const
+  {
+    return vector_form<Ord, Ord>(n, wt, u_ext, v, e, ext);
+  }
+
+  virtual bool get_point_fluxes(int n, Func<double> *u_ext[], Geom<double> *e, Func<double> **ext, double* f_val, double* f_dx, double* f_dy) const
+  {
+    if(!sum_factorization)
+      return false;
+    for (int i = 0; i < n; i++)
+    {
+      f_val[i] = source(e->x[i], e->y[i]);
+      f_dx[i] = e->y[i];
+      f_dy[i] = 0.0;
+    }
+    return true;
+  }
+
+  virtual VectorFormVol<double>* clone() const
+  {
+    return new CustomVectorFormVol(*this);
+  }
+
+private:
+  bool sum_factorization;
+};
+
+class CustomWeakForm : public WeakForm<double>
+{
+public:
+  CustomWeakForm(bool sum_factorization) : WeakForm<double>(1)
+  {
+    add_matrix_form(new CustomMatrixFormVol(sum_factorization));
+    add_vector_form(new CustomVectorFormVol(sum_factorization));
+  }
+};
+
+int main(int argc, char* args[])
+{
+  // Load the mesh.
+  Mesh mesh;
+  MeshReaderH2D mloader;
+  mloader.load("../square.mesh", &mesh);
+
+  // Perform initial mesh refinements.
+  for (int i = 0; i < INIT_REF_NUM; i++)
+    mesh.refine_all_elements();
+
+  // Create an H1 space without essential boundary conditions, so that all the functions are assembled.
+  H1Space<double> space(&mesh, P_INIT);
+  int ndof = space.get_num_dofs();
+
+  // Assemble the two variants.
+  CustomWeakForm wf_tensor(true);
+  CustomWeakForm wf_points(false);
+  DiscreteProblem<double> dp_tensor(&wf_tensor, &space);
+  DiscreteProblem<double> dp_points(&wf_points, &space);
+
+  SparseMatrix<double>* matrix_tensor = create_matrix<double>();
+  Vector<double>* rhs_tensor = create_vector<double>();
+  SparseMatrix<double>* matrix_points = create_matrix<double>();
+  Vector<double>* rhs_points = create_vector<double>();
+
+  dp_tensor.assemble(matrix_tensor, rhs_tensor);
+  dp_points.assemble(matrix_points, rhs_points);
+
+  // Compare the entries.
+  double max_matrix_entry = 0.0, max_matrix_difference = 0.0;
+  double max_rhs_entry = 0.0, max_rhs_difference = 0.0;
+  for (int i = 0; i < ndof; i++)
+  {
+    max_rhs_entry = std::max(max_rhs_entry, std::abs(rhs_points->get(i)));
+    max_rhs_difference = std::max(max_rhs_difference, std::abs(rhs_tensor->get(i) - rhs_points->get(i)));
+    for (int j = 0; j < ndof; j++)
+    {
+      max_matrix_entry = std::max(max_matrix_entry, std::abs(matrix_points->get(i, j)));
+      max_matrix_difference = std::max(max_matrix_difference, std::abs(matrix_tensor->get(i, j) - matrix_points->get(i, j)));
+    }
+  }
+
+  delete matrix_tensor;
+  delete rhs_tensor;
+  delete matrix_points;
+  delete rhs_points;
+
+  Hermes::Mixins::Loggable::Static::info("ndof: %d, matrix difference: %g, rhs difference: %g", ndof,
+    max_matrix_difference / max_matrix_entry, max_rhs_difference / max_rhs_entry);
+
+  if(max_matrix_difference <= TOLERANCE * max_matrix_entry && max_rhs_difference <= TOLERANCE * max_rhs_entry)
+  {
+    printf("Success!\n");
+    return 0;
+  }
+  else
+  {
+    printf("Failure!\n");
+    return -1;
+  }
+}
@@ -31,7 +31,14 @@ namespace Hermes
   enum HermesCommonApiParam
   {
     exceptionsPrintCallstack,
-    matrixSolverType
+    matrixSolverType,
+    /// Direct solvers detect an unchanged sparsity pattern and reuse the symbolic factorization
+    /// even if a factorization from scratch was requested (1 = on, default).
+    symbolicFactorizationReuse,
+    /// The large arrays of the matrices and vectors are zeroed in parallel, with the static partition of the threads used by
+    /// the matrix-vector products, so that their pages are first touched, and placed on the NUMA node, by the threads using them
+    /// (1 = on, default 0). See Hermes::Algebra::zero_values().
+    parallelFirstTouch
   };
 
   /// API Class containing settings for the whole HermesCommon.
@@ -20,6 +20,7 @@
 
 #include <vector>
 #include <limits.h>
+#include "memory_accounting.h"
 
 #ifndef INVALID_IDX
 #define INVALID_IDX      INT_MAX
@@ -35,6 +36,9 @@ namespace Hermes
     /// a list of unused items is maintained. Unused items (and their id numbers) are
     /// reused when new items are added to the array. The type 'TYPE' must contain the
     /// members 'id' and 'unused' in order to be usable by this class.
+    /// The pages are never moved (the items keep their addresses), and every change of the items in the array
+    /// is counted (get_modification_count()), so that packed lists of the items can be kept by the users
+    /// (see e.g. Mesh::get_active_elements()).
     /// \todo Is this dimension independent?
     template<class TYPE>
     class Array
@@ -44,6 +48,10 @@ namespace Hermes
       Hermes::vector<int> unused;
       int  size, nitems;
       bool append_only;
+      /// The MemoryAccounting category of the pages, -1 if they are not accounted.
+      int memory_category;
+      /// Incremented whenever items are added or removed.
+      unsigned int modification_count;
 
       static const int HERMES_PAGE_BITS = 10;
       static const int HERMES_PAGE_SIZE = 1 << HERMES_PAGE_BITS;
@@ -55,9 +63,11 @@ namespace Hermes
       {
         size = nitems = 0;
         append_only = false;
+        memory_category = -1;
+        modification_count = 0;
       }
 
-      Array(Array& array) { copy(array); }
+      Array(Array& array) : memory_category(-1), modification_count(0) { copy(array); }
 
       ~Array() { free(); }
 
@@ -71,6 +81,7 @@ namespace Hermes
         size = array.size;
         nitems = array.nitems;
         append_only = array.append_only;
+        modification_count++;
 
         for (unsigned i = 0; i < pages.size(); i++)
         {
@@ -78,15 +89,27 @@ namespace Hermes
           memcpy(new_page, pages[i], sizeof(TYPE) * HERMES_PAGE_SIZE);
           pages[i] = new_page;
         }
+        Hermes::MemoryAccounting::allocated(memory_category, pages.size() * sizeof(TYPE) * HERMES_PAGE_SIZE);
+      }
+
+      /// Reports the pages of the array to MemoryAccounting under the category (-1 for none).
+      /// The category is not copied by copy().
+      void set_memory_category(int category)
+      {
+        Hermes::MemoryAccounting::released(memory_category, pages.size() * sizeof(TYPE) * HERMES_PAGE_SIZE);
+        memory_category = category;
+        Hermes::MemoryAccounting::allocated(memory_category, pages.size() * sizeof(TYPE) * HERMES_PAGE_SIZE);
       }
 
       /// Removes all elements from the array.
       void free()
       {
         for (unsigned i = 0; i < pages.size(); i++) delete [] pages[i];
+        Hermes::MemoryAccounting::released(memory_category, pages.size() * sizeof(TYPE) * HERMES_PAGE_SIZE);
         pages.clear();
         unused.clear();
         size = nitems = 0;
+        modification_count++;
       }
 
       /// Sets or resets the append-only mode. In append-only mode new
@@ -120,6 +143,7 @@ namespace Hermes
           {
             TYPE* new_page = new TYPE[HERMES_PAGE_SIZE];
             pages.push_back(new_page);
+            Hermes::MemoryAccounting::allocated(memory_category, sizeof(TYPE) * HERMES_PAGE_SIZE);
           }
           item = pages[size >> HERMES_PAGE_BITS] + (size & HERMES_PAGE_MASK);
           item->id = size++;
@@ -133,6 +157,7 @@ namespace Hermes
           item->used = 1;
         }
         nitems++;
+        modification_count++;
         return item;
       }
 
@@ -148,6 +173,7 @@ namespace Hermes
         item->used = 0;
         unused.push_back(id);
         nitems--;
+        modification_count++;
       }
 
       // Iterators
@@ -242,7 +268,9 @@ namespace Hermes
           pages.push_back(new_page);
           size -= HERMES_PAGE_SIZE;
         }
+        Hermes::MemoryAccounting::allocated(memory_category, pages.size() * sizeof(TYPE) * HERMES_PAGE_SIZE);
         this->size = pages.size() * HERMES_PAGE_SIZE;
+        modification_count++;
       }
 
       /// Counts the items in the array and registers unused items.
@@ -254,6 +282,7 @@ namespace Hermes
         for (int i = start; i < size; i++)
           if (get(i).used) nitems++;
           else unused.push_back(i);
+        modification_count++;
       }
 
       /// Adds an unused item at the end of the array and skips its ID forever.
@@ -264,15 +293,18 @@ namespace Hermes
         {
           TYPE* new_page = new TYPE[HERMES_PAGE_SIZE];
           pages.push_back(new_page);
+          Hermes::MemoryAccounting::allocated(memory_category, sizeof(TYPE) * HERMES_PAGE_SIZE);
         }
         TYPE* item = pages[size >> HERMES_PAGE_BITS] + (size & HERMES_PAGE_MASK);
         item->id = size++;
         item->used = 0;
         nitems++;
+        modification_count++;
       }
 
       int get_size() const { return size; }
       int get_num_items() const { return nitems; }
+      unsigned int get_modification_count() const { return modification_count; }
 
       TYPE& get(int id) const { return pages[id >> HERMES_PAGE_BITS][id & HERMES_PAGE_MASK]; }
       TYPE& operator[] (int id) const { return get(id); }
@@ -60,6 +60,7 @@
 #else
   inline int omp_get_num_threads( ) { return 1; }
   inline int omp_get_thread_num( ) { return 0; }
+  inline int omp_get_max_threads( ) { return 1; }
 #endif
 
 typedef int int2[2];
@@ -146,6 +147,26 @@ namespace Hermes
   inline double pow(double x, double y) { return std::pow(x, y); }
   inline double log(double x) { return std::log(x); }
 
+  /// Thread-safe x += y.
+  inline void atomic_add(double& x, double y)
+  {
+#pragma omp atomic
+    x += y;
+  }
+
+  /// Thread-safe x += y. The real and imaginary parts are added by two atomic updates, so that the complex
+  /// matrices and vectors are assembled without a critical section.
+  inline void atomic_add(std::complex<double>& x, std::complex<double> y)
+  {
+    // Relies on std::complex<double> being laid out as double[2] (real part first). This is guaranteed
+    // since C++11 ([complex.numbers]/4), for C++98 it is what all the supported compilers do.
+    double* parts = reinterpret_cast<double*>(&x);
+#pragma omp atomic
+    parts[0] += y.real();
+#pragma omp atomic
+    parts[1] += y.imag();
+  }
+
   /* log file */
   #undef HERMES_LOG_FILE
   #ifdef HERMES_REPORT_NO_FILE
@@ -167,6 +188,12 @@ namespace Hermes
   #define HERMES_EC_WARNING 'W' ///< An event code: warnings. \internal
   #define HERMES_EC_INFO 'I' ///< An event code: info about results. \internal
 
+  /// The messages compiled in (see Hermes::Mixins::Loggable::set_log_level()):
+  /// 0 none, 1 errors, 2 and warnings, 3 and info (default). \ingroup g_logging
+  #ifndef HERMES_LOG_LEVEL
+  #  define HERMES_LOG_LEVEL 3
+  #endif
+
   /// A size of a delimiter in a log file. \internal \ingroup g_logging
   #define HERMES_LOG_FILE_DELIM_SIZE 80
   #define BUF_SZ 2048
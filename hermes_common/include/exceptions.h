@@ -220,6 +220,44 @@ namespace Hermes
         SolutionLoadFailureException(const SolutionLoadFailureException & e);
         virtual Exception* clone();
     };
+
+    /// \brief The first exception of the threads of a parallel region.
+    /// The threads skip the rest of their work once has_failed() (a read of a flag, the only cost on the non-failing path),
+    /// the exception of the first failing thread is thrown after the region by rethrow().
+    ///
+    /// Typical usage:
+    /// status.reset();
+    /// #pragma omp parallel for
+    /// for(i = 0; i < n; i++)
+    /// {
+    ///   if(status.has_failed())
+    ///     continue;
+    ///   try { ... }
+    ///   catch(Hermes::Exceptions::Exception& e) { status.fail(e); }
+    ///   catch(std::exception& e) { status.fail(e); }
+    /// }
+    /// status.rethrow();
+    class HERMES_API ParallelStatus
+    {
+      public:
+        ParallelStatus();
+        ~ParallelStatus();
+        /// Forgets the recorded exception, before a parallel region.
+        void reset();
+        /// True if a thread has failed since reset().
+        inline bool has_failed() const { return failed; }
+        /// Records a copy of the exception if it is the first one, callable from any thread.
+        void fail(Exception& e);
+        void fail(std::exception& e);
+        /// Throws the recorded exception (as Hermes::Exceptions::Exception) and forgets it, nothing if there is none.
+        void rethrow();
+      private:
+        ParallelStatus(const ParallelStatus&);
+        ParallelStatus& operator=(const ParallelStatus&);
+        void record(Exception* copy);
+        volatile bool failed;
+        Exception* exception;
+    };
   }
 }
 #endif
\ No newline at end of file
@@ -30,9 +30,15 @@
 #include "solvers/petsc_solver.h"
 #include "solvers/umfpack_solver.h"
 #include "solvers/superlu_solver.h"
+#include "solvers/matrix_free_solver.h"
+#include "solvers/element_matrix_store.h"
+#include "solvers/krylov_solver.h"
 #include "solvers/precond.h"
 #include "solvers/precond_ifpack.h"
 #include "solvers/precond_ml.h"
+#include "solvers/precond_krylov.h"
+#include "solvers/precond_pmultigrid.h"
+#include "solvers/bsr_matrix.h"
 #include "solvers/eigensolver.h"
 #include "hermes_function.h"
 #include "compat.h"
@@ -41,6 +47,8 @@
 #include "tables.h"
 #include "array.h"
 #include "qsort.h"
+#include "memory_accounting.h"
+#include "memory_arena.h"
 #include "ord.h"
 #include "mixins.h"
 #include "api.h"
\ No newline at end of file
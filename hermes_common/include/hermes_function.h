@@ -60,6 +60,15 @@ namespace Hermes
     /// One-dimensional function derivative integration order.
     virtual Hermes::Ord derivative(Hermes::Ord x) const;
 
+    /// Values in n points at once (e.g. all the integration points of an element).
+    /// The default implementations call value() / derivative() for every point, descendants with an expensive
+    /// evaluation (a lookup, a table) should override them.
+    /// \param[out] result Array of n values.
+    virtual void value_batch(int n, const Scalar* x, Scalar* result) const;
+    virtual void derivative_batch(int n, const Scalar* x, Scalar* result) const;
+    /// Both at once, see value_batch().
+    virtual void value_and_derivative_batch(int n, const Scalar* x, Scalar* values_result, Scalar* derivatives_result) const;
+
     /// The function is constant.
     /// Returns the value of is_const.
     bool is_constant() const;
@@ -105,6 +114,9 @@ namespace Hermes
     virtual Hermes::Ord derivative_x(Hermes::Ord x, Hermes::Ord y) const;
     virtual Hermes::Ord derivative_y(Hermes::Ord x, Hermes::Ord y) const;
 
+    /// Values in the n points (x[i], y[i]) at once, see Hermes1DFunction::value_batch().
+    virtual void value_batch(int n, const double* x, const double* y, Scalar* result) const;
+
     /// The function is constant.
     /// Returns the value of is_const.
     bool is_constant() const;
@@ -36,7 +36,8 @@ namespace Hermes
     SOLVER_MUMPS,
     SOLVER_SUPERLU,
     SOLVER_AMESOS,
-    SOLVER_AZTECOO
+    SOLVER_AZTECOO,
+    SOLVER_KRYLOV ///< Built-in Krylov solvers, see Hermes::Solvers::KrylovSolver.
   };
 
   /// \brief Namespace containing classes for vector / matrix operations.
@@ -273,9 +274,46 @@ namespace Hermes
       /// \brief Hermes binary format
       ///
       DF_HERMES_BIN,
-      DF_MATRIX_MARKET ///< Matrix Market which can be read by pysparse library
+      DF_MATRIX_MARKET, ///< Matrix Market which can be read by pysparse library
+      /// \brief Matrix Market header followed by binary arrays
+      /// the banner and the size line of the Matrix Market coordinate format (array format for vectors),
+      /// a comment line describing the layout, then the arrays in the native binary representation
+      /// written in bulk: Ap (size + 1 ints), Ai (nnz ints), Ax (nnz values, complex as pairs of doubles)
+      DF_MATRIX_MARKET_BIN,
+      /// \brief HDF5 file (only with WITH_HDF5)
+      /// datasets var_name/Ap, var_name/Ai, var_name/Ax of a matrix, var_name/v of a vector,
+      /// complex values as n x 2 arrays; the attribute "storage" of the group tells the compressed columns / rows
+      DF_HDF5
     };
 
+    /// \brief Dumps the compressed-column (compressed-row if by_rows) arrays in the binary formats,
+    /// DF_MATRIX_MARKET_BIN and DF_HDF5.
+    /// @return false for the other formats.
+    template<typename Scalar> HERMES_API
+      bool dump_compressed_binary(FILE* file, const char* var_name, EMatrixDumpFormat fmt, unsigned int size, int nnz,
+      const int* Ap, const int* Ai, const Scalar* Ax, bool by_rows = false);
+
+    /// \brief Dumps the vector entries in the binary formats, DF_MATRIX_MARKET_BIN and DF_HDF5.
+    /// @return false for the other formats.
+    template<typename Scalar> HERMES_API
+      bool dump_vector_binary(FILE* file, const char* var_name, EMatrixDumpFormat fmt, unsigned int size, const Scalar* v);
+
+    /// \brief Sums the values over all MPI processes (MPI_COMM_WORLD) in place, every process gets the sums.
+    /// Without MPI (not compiled WITH_MPI, or MPI not initialized) there is a single process and the values are kept.
+    template<typename Scalar> HERMES_API
+      void sum_values_over_processes(Scalar* values, unsigned int count);
+
+    /// \brief Zeroes the array, with HermesCommonApiParam::parallelFirstTouch in parallel, every thread the contiguous range of the entries
+    /// it gets in a static schedule, which then lies in the memory of its NUMA node.
+    template<typename Scalar> HERMES_API
+      void zero_values(Scalar* values, unsigned int count);
+
+    /// \brief zero_values() of a compressed-row array, the rows split among the threads as in the row-wise matrix-vector products
+    /// (a static schedule over the rows).
+    /// @param[in] row_starts Index of the first entry of every row, num_rows + 1 entries.
+    template<typename Scalar> HERMES_API
+      void zero_values_by_rows(Scalar* values, const int* row_starts, unsigned int num_rows);
+
     /// \brief General (abstract) matrix representation in Hermes.
     template<typename Scalar>
     class HERMES_API Matrix : public Hermes::Mixins::Loggable
@@ -355,9 +393,26 @@ namespace Hermes
 
       /// prepare memory
       ///
+      /// By default the indices registered by pre_add_ij() are stored in a single pass
+      /// into pages of every column. Callers able to register exactly the same index pairs
+      /// twice call prealloc_counting() right after prealloc(): the first pass then only
+      /// counts the entries of every column, prealloc_indices() allocates one flat array
+      /// for all of them and the second pass stores the row indices.
       /// @param[in] n - number of unknowns
       virtual void prealloc(unsigned int n);
 
+      /// Switch the preallocation started by prealloc() to the two-pass scheme,
+      /// to be called before the first pre_add_ij().
+      virtual void prealloc_counting();
+
+      /// Finish the counting pass of the two-pass preallocation and allocate
+      /// the flat index array for the storing pass.
+      virtual void prealloc_indices();
+
+      /// Number of passes over the nonzero indices the preallocation can use with
+      /// prealloc_counting() (backends not keeping the indices register them just once).
+      virtual int get_prealloc_passes() const { return 2; }
+
       /// add indices of nonzero matrix element
       ///
       /// @param[in] row  - row index
@@ -435,6 +490,13 @@ namespace Hermes
       /// Get fill-in.
       virtual double get_fill_in() const = 0;
 
+      /// Sums the entries over the MPI processes, which have assembled the same sparse structure, each one
+      /// its part of the contributions (see DiscreteProblem::set_process_partition()). Every process then holds the whole matrix.
+      virtual void sum_over_processes()
+      {
+        throw Hermes::Exceptions::Exception("sum_over_processes() undefined.");
+      };
+
       unsigned row_storage:1; ///< \todo document
       unsigned col_storage:1; ///< \todo document
 
@@ -445,11 +507,14 @@ namespace Hermes
         return 0;
       }
 
+      /// The bytes held by the arrays of the matrix (as reported to MemoryAccounting), 0 if the backend does not report them.
+      size_t get_memory_size() const { return mem_size; }
+
     protected:
       /// Size of page (max number of indices stored in one page).
       static const int PAGE_SIZE = 62;
 
-      /// Structure for storing indices in sparse matrix
+      /// Structure for storing indices in sparse matrix in the single-pass preallocation
       struct Page {
         /// number of indices stored
         int count;
@@ -459,22 +524,48 @@ namespace Hermes
         Page *next;
       };
 
-      /// array of pages with indices array. Each field of arra contains pages for one column
+      /// array of pages with indices array. Each field of arra contains pages for one column,
+      /// NULL in the two-pass preallocation
       Page **pages;
 
-      /// gather all pages in the buffer, delete them, sort buffer and remove duplicities
-      /// @param[in] page first page with indices
-      /// @param[out] buffer buffer to which indices will be copied
-      /// @param[in] max maximum indices to be stored (probably)
-      /// \todo max parameter does nothing (not implemented)
-      /// @return number of indices
-      int sort_and_store_indices(Page *page, int *buffer, int *max);
-      /// get number of indices in all pages
-      /// @return number of indices
-      int get_num_indices();
+      /// Number of columns of the preallocation (the size passed to prealloc()).
+      unsigned int prealloc_size;
+
+      /// Number of (possibly duplicate) row indices registered in every column,
+      /// during the storing pass the fill position within the column.
+      int *prealloc_counts;
+
+      /// Start of every column in prealloc_index_array (size + 1 entries).
+      int *prealloc_col_starts;
+
+      /// Flat array with the row indices of all columns, NULL during the counting pass.
+      int *prealloc_index_array;
+
+      /// Gather the pages of the single-pass preallocation into the flat index array
+      /// of the two-pass one, deleting them along the way.
+      void pages_to_index_array();
+
+      /// Sort the indices of every column, remove duplicities and compact them.
+      /// The preallocation data are released, the returned array (allocated by new [])
+      /// is handed over to the caller.
+      /// @param[out] col_starts start of every column in the returned array (size + 1 entries)
+      /// @return array with the sorted row indices of all columns
+      int* compress_indices(int *col_starts);
+
+      /// The same as compress_indices(), but row-wise, for the backends preallocating by rows.
+      /// @param[out] row_starts start of every row in the returned array (size + 1 entries)
+      /// @return array with the sorted column indices of all rows
+      int* compress_indices_by_rows(int *row_starts);
+
+      /// Release the preallocation data.
+      void free_prealloc();
+
+      /// Set the bytes held by the arrays of the matrix, reported to MemoryAccounting under "sparse matrices".
+      /// To be called by the backends after any (re)allocation, with 0 after freeing.
+      void set_memory_size(size_t bytes);
 
       /// mem stat
-      int mem_size;
+      size_t mem_size;
     };
 
     /// \brief General (abstract) vector representation in Hermes.
@@ -502,6 +593,11 @@ namespace Hermes
       /// @param[out] v - array which will contain extracted values
       virtual void extract(Scalar *v) const = 0;
 
+      /// The values as a contiguous array stored in the vector, to be read without the copy of extract().
+      /// Valid until the vector is changed by alloc() or free().
+      /// @return NULL if the vector does not store its values so (e.g. a distributed one)
+      virtual const Scalar* get_values() const { return NULL; }
+
       /// Zero the vector
       virtual void zero() = 0;
 
@@ -532,6 +628,18 @@ namespace Hermes
       /// @param[in] y   - values
       virtual void add(unsigned int n, unsigned int *idx, Scalar *y) = 0;
 
+      /// Sums the entries over the MPI processes, each one having assembled its part of the contributions,
+      /// see SparseMatrix::sum_over_processes().
+      virtual void sum_over_processes()
+      {
+        Scalar* values = new Scalar[this->size];
+        this->extract(values);
+        Hermes::Algebra::sum_values_over_processes<Scalar>(values, this->size);
+        this->zero();
+        this->add_vector(values);
+        delete [] values;
+      }
+
       /// Get vector length.
       unsigned int length() const {return this->size;}
 
@@ -0,0 +1,81 @@
+// This file is part of HermesCommon
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes2D is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+/*! \file memory_accounting.h
+    \brief Process-wide accounting of the memory of the large data structures.
+*/
+#ifndef __HERMES_COMMON_MEMORY_ACCOUNTING_H
+#define __HERMES_COMMON_MEMORY_ACCOUNTING_H
+
+#include "compat.h"
+#include <string>
+
+namespace Hermes
+{
+  /// \brief Process-wide accounting of the memory of the large data structures.
+  ///
+  /// The owners of the large allocations (precalculated tables, assembly caches, matrices, factorizations,
+  /// meshes, solutions) report the bytes they allocate and release under a category,
+  /// the current and the peak number of bytes of every category and of all of them together can be queried
+  /// at any time, e.g. to size the jobs and the cache limits.
+  /// The numbers are those of the accounted structures only, not of the whole process.
+  ///
+  /// Typical usage:
+  /// static int my_memory_category = Hermes::MemoryAccounting::add_category("my tables");
+  /// ...
+  /// Hermes::MemoryAccounting::allocated(my_memory_category, bytes);
+  /// ...
+  /// printf("%s", Hermes::MemoryAccounting::get_report().c_str());
+  class HERMES_API MemoryAccounting
+  {
+  public:
+    /// Registers a category, or returns the already registered one of the same name.
+    /// May be called during the static initialization.
+    /// \param[in] name A static string, only the pointer is stored.
+    /// \return The category, -1 if there are already max_categories of them (the updates of -1 are ignored).
+    static int add_category(const char* name);
+
+    /// Records an allocation.
+    static void allocated(int category, size_t bytes);
+    /// Records a release.
+    static void released(int category, size_t bytes);
+    /// Records a change of a structure from old_bytes to new_bytes.
+    static void changed(int category, size_t old_bytes, size_t new_bytes);
+
+    static int get_num_categories();
+    static const char* get_category_name(int category);
+
+    /// The bytes of the category allocated now.
+    static size_t get_current(int category);
+    /// The high-water mark of the category since the start or reset_peaks().
+    static size_t get_peak(int category);
+    /// The bytes of all the categories allocated now.
+    static size_t get_total_current();
+    /// The high-water mark of the sum of all the categories.
+    static size_t get_total_peak();
+
+    /// Sets the peaks to the current values.
+    static void reset_peaks();
+
+    /// A table of the current and peak values of all the categories.
+    static std::string get_report();
+
+    static const int max_categories = 32;
+  };
+}
+#endif
@@ -0,0 +1,89 @@
+// This file is part of HermesCommon
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes2D is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+/*! \file memory_arena.h
+    \brief Bump allocator for short-lived temporaries.
+*/
+#ifndef __HERMES_COMMON_MEMORY_ARENA_H
+#define __HERMES_COMMON_MEMORY_ARENA_H
+
+#include "compat.h"
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+namespace Hermes
+{
+  /// \brief Bump allocator for short-lived temporaries.
+  ///
+  /// Memory is handed out from large chunks and is never released one allocation at a time:
+  /// reset() makes all of it available again at once, the chunks are kept for the next use.
+  /// Intended to be owned by one thread (no synchronization), e.g. one per assembling thread,
+  /// reset after every assembled element.
+  class HERMES_API MemoryArena
+  {
+  public:
+    /// Constructor.
+    /// \param[in] chunk_size Size of one chunk in bytes. Larger requests get a chunk of their own.
+    MemoryArena(size_t chunk_size = 1 << 18);
+    ~MemoryArena();
+
+    /// Allocate memory aligned to HERMES_ARENA_ALIGNMENT bytes.
+    void* allocate(size_t size);
+
+    /// Allocate an (uninitialized) array.
+    template<typename T>
+    T* allocate_array(size_t count)
+    {
+      return (T*)allocate(count * sizeof(T));
+    }
+
+    /// Allocate a zeroed m x n matrix with the same layout as new_matrix().
+    template<typename T>
+    T** allocate_matrix(unsigned int m, unsigned int n = 0)
+    {
+      if(!n) n = m;
+      T **vec = (T **) allocate(sizeof(T *) * m + sizeof(T) * m * n);
+      memset(vec, 0, sizeof(T *) * m + sizeof(T) * m * n);
+      T *row = (T *) (vec + m);
+      for (unsigned int i = 0; i < m; i++, row += n) vec[i] = row;
+      return vec;
+    }
+
+    /// Make all the allocated memory available again.
+    void reset();
+
+    /// Total size of the chunks held.
+    size_t get_capacity() const;
+
+  protected:
+    /// Alignment of the returned pointers.
+    static const size_t HERMES_ARENA_ALIGNMENT = 32;
+
+    size_t chunk_size;
+
+    /// Chunks and their sizes.
+    std::vector<char*> chunks;
+    std::vector<size_t> chunk_sizes;
+
+    /// The chunk currently allocated from and the first free byte in it.
+    unsigned int current_chunk;
+    size_t current_offset;
+  };
+}
+#endif
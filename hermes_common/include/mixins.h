@@ -63,6 +63,17 @@ namespace Hermes
       /// Returns the current value of verbose_callback;
       callbackFn get_verbose_callback() const;
 
+      /// Sets the process-wide level of the messages, on top of verbose_output of the instances:
+      /// 0 none, 1 errors, 2 and warnings, 3 and info (the default, the maximum is HERMES_LOG_LEVEL).
+      /// The messages above the level are dropped before they are formatted.
+      static void set_log_level(int level);
+      static int get_log_level();
+
+      /// Writes the messages logged in the parallel regions so far. Called by every message logged
+      /// outside of a parallel region and at the exit, there is no need to call it otherwise except
+      /// to see the messages of a long parallel computation in time.
+      static void flush_buffered_messages();
+
       /// For static logging in user programs.
       class HERMES_API Static
       {
@@ -80,7 +91,11 @@ namespace Hermes
       void warn_if(bool cond, const char* msg, ...) const;
       void error(const char* msg, ...) const;
       void error_if(bool cond, const char* msg, ...) const;
-      
+
+      /// True if the messages of the level (see set_log_level()) are written by this instance,
+      /// for guarding the computation of the arguments of a message.
+      inline bool is_logged(int level) const { return level <= HERMES_LOG_LEVEL && level <= log_level && verbose_output; }
+
       /* file operations */
       void hermes_fwrite(const void* ptr, size_t size, size_t nitems, FILE* stream) const;
       void hermes_fread(void* ptr, size_t size, size_t nitems, FILE* stream) const;
@@ -90,7 +105,7 @@ namespace Hermes
       /** \param[in] code An event code, e.g., ::HERMES_EC_ERROR.
       *  \param[in] text A message. A C-style string.
       *  \return True if the message was written. False if it failed due to some reasone. */
-      bool write_console(const char code, const char* text) const;
+      static bool write_console(const char code, const char* text);
 
       /// Info about a log record. Used for output log function. \internal
       class HERMES_API HermesLogEventInfo
@@ -104,7 +119,7 @@ namespace Hermes
         const int src_line;       ///< A line in the source file at which the event was generated.
       };
 
-      HermesLogEventInfo* hermes_build_log_info(char event) const;
+      static HermesLogEventInfo* hermes_build_log_info(char event);
 
       /// \brief Logging output monitor. \internal \ingroup g_logging
       /** This class protects a logging function __hermes_log_message_if() in multithreded environment. */
@@ -146,8 +161,16 @@ namespace Hermes
       *  code.
       *  \param[in] code Code of the message.
       *  \param[in] msg A message. */
+      /// In a parallel region (of more than one thread) the message is kept in a buffer of the thread, without any locking,
+      /// and written by the next message outside of a parallel region (or flush_buffered_messages()).
       void hermes_log_message(const char code, const char* msg) const;
 
+      /// Writes the message to the console and the log file, under logger_monitor.
+      static void write_message(const char code, const char* msg, callbackFn callback);
+
+      /// The process-wide level, see set_log_level().
+      static int log_level;
+
       /// Verbose output.
       /// Set to 'true' by default.
       bool verbose_output;
@@ -210,6 +233,147 @@ namespace Hermes
       double period_in_seconds(const SysTime& begin, const SysTime& end) const; ///< Calculates distance between times (in platform specific units) and returns it in seconds.
       std::string to_string(const double time) const; ///< Converts time from seconds to human readable form.
     };
+
+    /// \brief Times of the phases of a calculation (e.g. of the assembling), accumulated per thread.
+    /// Disabled by default; a disabled profile costs a branch per timed section, an enabled one a reading of the clock
+    /// at the start and at the end of the section. Every thread accumulates into its own record, so the sections
+    /// in parallel regions do not synchronize, the records are summed by the getters.
+    /// The phases may be nested, the time of a nested phase is then a part of the time of the enclosing one.
+    /// Typical usage:
+    /// dp.get_profile()->set_enabled();
+    /// dp.assemble(matrix, rhs);
+    /// std::cout << dp.get_profile()->to_string();
+    class HERMES_API Profile
+    {
+    public:
+      /// @param[in] phase_names num_phases names of the phases, not copied (i.e. string literals).
+      /// @param[in] trace_category The category of the trace events of the sections (see Trace), not copied.
+      Profile(unsigned int num_phases, const char* const* phase_names, const char* trace_category = "hermes");
+      ~Profile();
+
+      void set_enabled(bool enabled = true);
+      bool is_enabled() const;
+
+      /// Sets all the times and counts to zero.
+      void reset();
+
+      unsigned int get_num_phases() const;
+      const char* get_phase_name(unsigned int phase) const;
+
+      /// The time of the phase (in seconds) summed over the threads.
+      double get_time(unsigned int phase) const;
+      /// The number of the timed sections of the phase, of all the threads.
+      unsigned long get_count(unsigned int phase) const;
+
+      /// The number of the threads with a record (the highest omp_get_thread_num() + 1).
+      int get_num_threads() const;
+      /// The time and the count of one thread.
+      double get_time(unsigned int phase, int thread) const;
+      unsigned long get_count(unsigned int phase, int thread) const;
+
+      /// Adds the times of another profile of the same phases, thread by thread (e.g. of several instances).
+      void add(const Profile& other);
+
+      /// The table of the phases, their times and counts.
+      std::string to_string() const;
+
+      /// Adds a period to the phase in the record of the calling thread.
+      void add_time(unsigned int phase, double seconds, unsigned long count = 1);
+
+      /// The clock of the profiles, in seconds.
+      static double now();
+
+      /// Times its scope (or until stop()) as a section of the phase, if the profile is enabled at the construction.
+      /// If tracing (Trace) is enabled at the construction, the section is also recorded as a trace event.
+      class HERMES_API Section
+      {
+      public:
+        Section(Profile* profile, unsigned int phase);
+        ~Section();
+        /// Ends the section before the end of its scope.
+        void stop();
+      private:
+        Profile* profile;
+        unsigned int phase;
+        double start;
+        bool timed;
+        bool traced;
+      };
+
+    private:
+      Profile(const Profile&);
+      Profile& operator=(const Profile&);
+
+      /// The record of the thread, created on its first use.
+      struct Record
+      {
+        double* times;
+        unsigned long* counts;
+      };
+      Record* get_record(int thread);
+
+      /// Threads with a higher number share the last record (and synchronize on it).
+      static const int max_threads = 64;
+
+      unsigned int num_phases;
+      const char* const* phase_names;
+      const char* trace_category;
+      bool enabled;
+      Record* records[max_threads];
+    };
+
+    /// \brief Process-wide recording of timed events per thread, written in the Chrome trace format
+    /// (chrome://tracing, Perfetto), e.g. to see the load balance of the threads in the assembling.
+    /// The sections of all the profiles (Profile::Section) are recorded, plus the events of Trace::Scope and add_instant().
+    /// Disabled by default, a disabled trace costs a branch per event. Every thread records into its own buffer,
+    /// of at most get_max_events() events, the later ones are dropped.
+    /// The names and the categories are not copied (i.e. string literals).
+    /// Typical usage:
+    /// Hermes::Mixins::Trace::set_enabled();
+    /// newton.solve(coeff_vec);
+    /// Hermes::Mixins::Trace::write_chrome_trace("newton.json");
+    class HERMES_API Trace
+    {
+    public:
+      static void set_enabled(bool enabled = true);
+      static bool is_enabled() { return enabled; }
+
+      /// The maximum number of the events of one thread, 1000000 by default.
+      static void set_max_events(unsigned int max_events);
+      static unsigned int get_max_events();
+
+      /// Records a period (Profile::now() times) of the calling thread.
+      static void add_complete(const char* name, const char* category, double start, double end);
+      /// Records an event without duration (e.g. a cache miss) of the calling thread.
+      static void add_instant(const char* name, const char* category);
+
+      /// The number of the recorded events (of all the threads).
+      static unsigned int get_num_events();
+      /// The number of the events dropped because of the limit.
+      static unsigned int get_num_dropped_events();
+      /// Removes all the recorded events.
+      static void clear();
+
+      /// Writes the recorded events in the Chrome trace JSON format, the event times are in microseconds from the first enabling.
+      /// Not to be called while the events are being recorded by other threads.
+      /// @return false if the file could not be written.
+      static bool write_chrome_trace(const char* file_name);
+
+      /// Records its scope as a period, if tracing is enabled at the construction.
+      class HERMES_API Scope
+      {
+      public:
+        Scope(const char* name, const char* category);
+        ~Scope();
+      private:
+        const char* name;
+        const char* category;
+        double start;
+      };
+
+    private:
+      static bool enabled;
+    };
   
     /// \brief Class that allows overriding integration order in its discrete problems
     /// Internal
@@ -235,7 +399,22 @@ namespace Hermes
       double time_step;
     };
 
+    class OutputAttachable;
+
+    /// \brief A consumer of the events of an OutputAttachable, attached to it (OutputAttachable::attach_output())
+    /// instead of overriding its methods, e.g. an in-situ analysis or visualization.
+    class HERMES_API OutputCallback
+    {
+    public:
+      virtual ~OutputCallback() {};
+      virtual void on_initialization(OutputAttachable* source) {};
+      virtual void on_step_begin(OutputAttachable* source) {};
+      virtual void on_step_end(OutputAttachable* source) {};
+      virtual void on_finish(OutputAttachable* source) {};
+    };
+
     /// \brief Class that allows for attaching any method to particular parts of its functionality.
+    /// The methods call the attached callbacks, an override has to call the method of this class for them to be called.
     /// Internal
     class HERMES_API OutputAttachable
     {
@@ -245,6 +424,13 @@ namespace Hermes
       virtual void on_step_begin();
       virtual void on_step_end();
       virtual void on_finish();
+
+      /// Attaches a callback (not deleted by this class), called by the methods above in the order of attaching.
+      void attach_output(OutputCallback* callback);
+      void detach_output(OutputCallback* callback);
+
+    protected:
+      Hermes::vector<OutputCallback*> output_callbacks;
     };
   }
 }
@@ -16,6 +16,7 @@
 \brief Contains class Ord for calculation of integration order.
 */
 #include <complex>
+#include <algorithm>
 #include "compat.h"
 
 #ifndef __HERMES_COMMON_ORD_H_
@@ -28,49 +29,52 @@ namespace Hermes
   /// We defined a special arithmetics with this type to be able to analyze forms
   /// and determine the necessary integration order.  This works for forms, but it also
   /// works for user-defined functions.
+  ///
+  /// The arithmetics is defined inline, so that the order of a form written once for both the values
+  /// and the orders (see e.g. WeakFormsIntegrand) compiles to a few integer operations without calls and temporaries.
   class HERMES_API Ord
   {
   public:
 
-    Ord();
-    explicit Ord(int o);
-    explicit Ord(double o);
+    inline Ord() : order(0) {}
+    inline explicit Ord(int o) : order(o) {}
+    inline explicit Ord(double o) : order(0) {}
 
-    int get_order() const;
+    inline int get_order() const { return order; }
 
-    static Ord get_max_order();
+    static inline Ord get_max_order() { return Ord(30); }
 
-    Ord operator + (const Ord &o);
-    Ord operator + (double d);
-    Ord operator + (std::complex<double> d);
-    Ord operator-(const Ord &o);
-    Ord operator-(double d);
-    Ord operator-(std::complex<double> d);
-    Ord operator*(const Ord &o);
-    Ord operator*(double d);
-    Ord operator*(std::complex<double> d);
-    Ord operator/(const Ord &o);
-    Ord operator/(double d);
-    Ord operator/(std::complex<double> d);
+    inline Ord operator + (const Ord &o) const { return Ord(std::max(this->order, o.order)); }
+    inline Ord operator + (double d) const { return *this; }
+    inline Ord operator + (std::complex<double> d) const { return *this; }
+    inline Ord operator-(const Ord &o) const { return Ord(std::max(this->order, o.order)); }
+    inline Ord operator-(double d) const { return *this; }
+    inline Ord operator-(std::complex<double> d) const { return *this; }
+    inline Ord operator*(const Ord &o) const { return Ord(this->order + o.order); }
+    inline Ord operator*(double d) const { return *this; }
+    inline Ord operator*(std::complex<double> d) const { return *this; }
+    inline Ord operator/(const Ord &o) const { return Ord::get_max_order(); }
+    inline Ord operator/(double d) const { return *this; }
+    inline Ord operator/(std::complex<double> d) const { return *this; }
 
-    Ord operator+=(const Ord &o);
-    Ord operator-=(const Ord &o);
+    inline Ord operator+=(const Ord &o) { this->order = std::max(this->order, o.order); return *this; }
+    inline Ord operator-=(const Ord &o) { this->order = std::max(this->order, o.order); return *this; }
 
-    Ord operator+=(const double &d);
-    Ord operator+=(const std::complex<double> &d);
-    Ord operator-=(const double &d);
-    Ord operator-=(const std::complex<double> &d);
-    Ord operator*=(const double &d);
-    Ord operator*=(const std::complex<double> &d);
-    Ord operator/=(const double &d);
-    Ord operator/=(const std::complex<double> &d);
+    inline Ord operator+=(const double &d) { return *this; }
+    inline Ord operator+=(const std::complex<double> &d) { return *this; }
+    inline Ord operator-=(const double &d) { return *this; }
+    inline Ord operator-=(const std::complex<double> &d) { return *this; }
+    inline Ord operator*=(const double &d) { return *this; }
+    inline Ord operator*=(const std::complex<double> &d) { return *this; }
+    inline Ord operator/=(const double &d) { return *this; }
+    inline Ord operator/=(const std::complex<double> &d) { return *this; }
 
-    bool operator<(double d);
-    bool operator<(std::complex<double> d);
-    bool operator>(double d);
-    bool operator>(std::complex<double> d);
-    bool operator<(const Ord &o);
-    bool operator>(const Ord &o);
+    inline bool operator<(double d) const { return true; }
+    inline bool operator<(std::complex<double> d) const { return true; }
+    inline bool operator>(double d) const { return false; }
+    inline bool operator>(std::complex<double> d) const { return false; }
+    inline bool operator<(const Ord &o) const { return this->order < o.order; }
+    inline bool operator>(const Ord &o) const { return this->order > o.order; }
     
     friend std::ostream & operator<< (std::ostream& os, const Ord& ord)
     {
@@ -82,22 +86,23 @@ namespace Hermes
     int order;
   };
 
-  HERMES_API Ord operator/(const double &a, const Ord &b);
-  HERMES_API Ord operator*(const double &a, const Ord &b);
-  HERMES_API Ord operator + (const double &a, const Ord &b);
-  HERMES_API Ord operator-(const double &a, const Ord &b);
-  HERMES_API Ord operator/(const std::complex<double> &a, const Ord &b);
-  HERMES_API Ord operator*(const std::complex<double> &a, const Ord &b);
-  HERMES_API Ord operator + (const std::complex<double> &a, const Ord &b);
-  HERMES_API Ord operator-(const std::complex<double> &a, const Ord &b);
-  HERMES_API Ord operator-(const Ord &a);
+  inline Ord operator/(const double &a, const Ord &b) { return Ord::get_max_order(); }
+  inline Ord operator*(const double &a, const Ord &b) { return b; }
+  inline Ord operator + (const double &a, const Ord &b) { return b; }
+  inline Ord operator-(const double &a, const Ord &b) { return b; }
+  inline Ord operator/(const std::complex<double> &a, const Ord &b) { return Ord::get_max_order(); }
+  inline Ord operator*(const std::complex<double> &a, const Ord &b) { return b; }
+  inline Ord operator + (const std::complex<double> &a, const Ord &b) { return b; }
+  inline Ord operator-(const std::complex<double> &a, const Ord &b) { return b; }
+  inline Ord operator-(const Ord &a) { return a; }
+
+  inline Ord sqrt(const Ord &a) { return a; }
+  inline Ord sqr(const Ord &a) { return Ord(2 * a.get_order()); }
+  inline Ord conj(const Ord &a) { return a; }
+  inline Ord abs(const Ord &a) { return a; }
+  inline Ord magn(const Ord &a) { return a; }
 
   HERMES_API Ord pow(const Ord &a, const double &b);
-  HERMES_API Ord sqrt(const Ord &a);
-  HERMES_API Ord sqr(const Ord &a);
-  HERMES_API Ord conj(const Ord &a);
-  HERMES_API Ord abs(const Ord &a);
-  HERMES_API Ord magn(const Ord &a);
 
   HERMES_API Ord atan2(const Ord &a, const Ord &b);
   HERMES_API Ord atan(const Ord &a);
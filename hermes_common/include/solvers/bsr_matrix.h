@@ -0,0 +1,119 @@
+// This file is part of HermesCommon
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+/*! \file bsr_matrix.h
+\brief Block sparse row (BSR) matrix for systems with interleaved unknowns.
+*/
+#ifndef __HERMES_COMMON_BSR_MATRIX_H_
+#define __HERMES_COMMON_BSR_MATRIX_H_
+
+#include "matrix.h"
+#include "krylov_solver.h"
+#include "umfpack_solver.h"
+
+namespace Hermes
+{
+  namespace Algebra
+  {
+    /// \brief Sparse matrix made of dense square blocks (block sparse row format).
+    ///
+    /// Meant for vector-valued problems with the unknowns of every node numbered next to each other
+    /// (e.g. the two displacements of elasticity, see Space::assign_dofs_interleaved() in Hermes2D):
+    /// the entries [m, n] with the same (m / block_size, n / block_size) share one block, so just one
+    /// column index is stored per block and the product with a vector works on whole blocks.
+    /// A block is stored even if only some of its entries are registered by pre_add_ij().
+    ///
+    /// The direct and iterative solvers work with the scalar formats, see to_csr() and to_csc().
+    template <typename Scalar>
+    class HERMES_API BSRMatrix : public SparseMatrix<Scalar>
+    {
+    public:
+      /// @param[in] block_size number of rows (and columns) of every block
+      BSRMatrix(unsigned int block_size = 2);
+      virtual ~BSRMatrix();
+
+      /// @param[in] n number of unknowns, has to be a multiple of the block size
+      virtual void prealloc(unsigned int n);
+      virtual void prealloc_indices();
+      /// The indices are registered per block row.
+      virtual void pre_add_ij(unsigned int row, unsigned int col);
+
+      virtual void alloc();
+      virtual void free();
+      virtual Scalar get(unsigned int m, unsigned int n);
+      virtual void zero();
+      virtual void add(unsigned int m, unsigned int n, Scalar v);
+      virtual void add_to_diagonal(Scalar v);
+      virtual void add(unsigned int m, unsigned int n, Scalar **mat, int *rows, int *cols);
+      virtual bool dump(FILE *file, const char *var_name, EMatrixDumpFormat fmt = DF_MATLAB_SPARSE, char* number_format = "%lf");
+      virtual unsigned int get_matrix_size() const;
+      /// Number of the stored entries (all entries of all blocks).
+      virtual unsigned int get_nnz() const;
+      virtual double get_fill_in() const;
+
+      /// Applies the matrix to vector_in and saves result to vector_out, in parallel over the block rows.
+      virtual void multiply_with_vector(Scalar* vector_in, Scalar* vector_out);
+      /// Multiplies matrix with a Scalar.
+      virtual void multiply_with_Scalar(Scalar value);
+      /// Sums the entries over the MPI processes.
+      virtual void sum_over_processes();
+
+      /// Duplicates a matrix (including allocation).
+      virtual BSRMatrix* duplicate();
+
+      /// Copies the matrix into a CSRMatrix (e.g. for the built-in Krylov solvers).
+      void to_csr(CSRMatrix<Scalar>* target);
+#ifdef WITH_UMFPACK
+      /// Copies the matrix into a CSCMatrix (e.g. an UMFPackMatrix for the direct solver).
+      void to_csc(CSCMatrix<Scalar>* target);
+#endif
+
+      unsigned int get_block_size() const;
+      /// Number of the stored blocks.
+      unsigned int get_num_blocks() const;
+
+      /// @return pointer to #Ap
+      int *get_Ap();
+      /// @return pointer to #Ai
+      int *get_Ai();
+      /// @return pointer to #Ax
+      Scalar *get_Ax();
+
+    protected:
+      /// Position of the block [block_row, block_col] in Ai, -1 if it is not in the sparse structure.
+      int find_block(unsigned int block_row, unsigned int block_col) const;
+
+      /// Adds v to Ax[pos], thread-safe.
+      void add_to_position(unsigned int pos, Scalar v);
+
+      unsigned int block_size;
+      /// Number of block rows ( = size / block_size).
+      unsigned int num_block_rows;
+
+      /// The blocks (block_size x block_size, row-wise), one after another in the order of Ai.
+      Scalar *Ax;
+      /// Block column indices of the blocks.
+      int *Ai;
+      /// Index to Ai, where each block row starts.
+      int *Ap;
+      /// Number of blocks ( = Ap[num_block_rows]).
+      unsigned int num_blocks;
+    };
+  }
+}
+#endif
@@ -17,76 +17,85 @@
 // along with Hermes2D; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 /*! \file eigensolver.h
-    \brief class for solving Eigenproblems. Currently using Python.
+    \brief Shift-invert Lanczos solver of generalized eigenproblems.
 */
 #ifndef __HERMES_EIGENSOLVER_H
 #define __HERMES_EIGENSOLVER_H
 
-#include "config.h"
-#ifdef WITH_PYTHON
-
 #include "matrix.h"
-
-#include "python_API/python_api.h"
-
-// RCP
-#ifndef WITH_TRILINOS
-#include "Teuchos_RCP.hpp"
-#else
-#include "Teuchos_RCP.hpp"
-#endif
+#include "mixins.h"
+#include "linear_matrix_solver.h"
 
 namespace Hermes
 {
-
-using Teuchos::RCP;
-using Teuchos::Ptr;
-using Teuchos::rcp;
-using Teuchos::null;
-
-
-template <typename Scalar>
-class HERMES_API EigenSolver
-{
-public:
-    EigenSolver(const RCP<Algebra::Matrix<Scalar> > &A, const RCP<Algebra::Matrix<Scalar> > &B);
-
-
-    // Solves for 'n_eigs' eigenvectors, around the 'target_value'. Use
-    // 'get_eigenvalue' and 'get_eigenvector' to retrieve the
-    // eigenvalues/eigenvectors:
-    void solve(int n_eigs = 4, double target_value = -1, double tol = 1e-6,
-            int max_iter = 150);
-
-    // Returns the number of calculated eigenvalues
-    int get_n_eigs()
+  namespace Solvers
+  {
+    /// \brief Eigenpairs of A x = lambda B x nearest to a target value, for symmetric A and symmetric positive definite B
+    /// (e.g. the stiffness and the mass matrix).
+    ///
+    /// Shift-invert Lanczos: the Krylov subspace of (A - sigma B)^-1 B is built with full reorthogonalization in the
+    /// B-inner product, its largest eigenvalues theta give lambda = sigma + 1 / theta. The matrix A - sigma B is factorized
+    /// just once by UMFPACK or MUMPS (MUMPS if it is the selected matrix solver or UMFPACK is not available),
+    /// every Lanczos step then costs one solve with the factors and one product with B.
+    /// A and B are CSC (UMFPACK) or CSR (Krylov) matrices.
+    /// The eigenvectors are B-orthonormal coefficient vectors, see Solution::vector_to_solution() in Hermes2D.
+    ///
+    /// @ingroup solvers
+    template <typename Scalar>
+    class HERMES_API EigenSolver : public Hermes::Mixins::Loggable
     {
-        return this->n_eigs;
-    }
-    // Returns the i-th eigenvalue
-    double get_eigenvalue(int i);
-    // Returns the i-th eigenvector. A pointer will be returned into an
-    // internal array, as well as the size of the vector. You don't own the
-    // memory and it will be deallocated once the EigenSolver() class is
-    // deleted. You need to make a copy of it if you want to store it
-    // permanently.
-    void get_eigenvector(int i, double **vec, int *n);
-
-    void print_eigenvalues()
-    {
-        printf("Eigenvalues:\n");
-        for (int i = 0; i < this->get_n_eigs(); i++)
-            printf("%3d: %f\n", i, this->get_eigenvalue(i));
-    }
-
-private:
-    RCP<Algebra::Matrix<Scalar> > A, B;
-    int n_eigs;
-    Python p;
-};
-
+    public:
+      EigenSolver(Algebra::SparseMatrix<Scalar>* A, Algebra::SparseMatrix<Scalar>* B);
+      ~EigenSolver();
+
+      /// Solves for 'n_eigs' eigenvectors, around the 'target_value'. Use
+      /// 'get_eigenvalue' and 'get_eigenvector' to retrieve the
+      /// eigenvalues/eigenvectors (ordered by the eigenvalues).
+      /// @param[in] tol - relative residual of the eigenpairs of the shift-inverted problem
+      /// @param[in] max_iter - maximum number of the Lanczos steps ( = dimension of the Krylov subspace)
+      void solve(int n_eigs = 4, double target_value = -1, double tol = 1e-6, int max_iter = 150);
+
+      /// Returns the number of calculated eigenvalues (less than requested if the Krylov subspace is exhausted or not converged).
+      int get_n_eigs();
+      /// Returns the i-th eigenvalue
+      double get_eigenvalue(int i);
+      /// Returns the i-th eigenvector. A pointer will be returned into an
+      /// internal array, as well as the size of the vector. You don't own the
+      /// memory and it will be deallocated once the EigenSolver() class is
+      /// deleted. You need to make a copy of it if you want to store it
+      /// permanently.
+      void get_eigenvector(int i, Scalar **vec, int *n);
+      /// Number of the Lanczos steps of the last solve().
+      int get_num_iters();
+
+      void print_eigenvalues();
+
+    protected:
+      /// Releases the eigenpairs.
+      void free();
+
+      /// Factorizes C = A - sigma B by the direct solver, the structure is the union of both.
+      void factorize_shifted(double sigma);
+
+      /// Destroys the factorization.
+      void free_shifted();
+
+      /// x = C^-1 b (in place).
+      void solve_shifted(Scalar* x);
+
+      Algebra::SparseMatrix<Scalar>* A;
+      Algebra::SparseMatrix<Scalar>* B;
+
+      /// The shifted matrix and its direct solver.
+      Algebra::SparseMatrix<Scalar>* shifted_matrix;
+      Algebra::Vector<Scalar>* shifted_rhs;
+      LinearMatrixSolver<Scalar>* shifted_solver;
+
+      int n_eigs;
+      int num_iters;
+      double* eigenvalues;
+      Scalar** eigenvectors;
+    };
+  }
 }
-
-#endif
-
 #endif
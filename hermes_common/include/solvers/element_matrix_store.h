@@ -0,0 +1,113 @@
+// This file is part of HermesCommon
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+/*! \file element_matrix_store.h
+\brief Out-of-core storage of the element matrices, used as a matrix of products only.
+*/
+#ifndef __HERMES_COMMON_ELEMENT_MATRIX_STORE_H_
+#define __HERMES_COMMON_ELEMENT_MATRIX_STORE_H_
+
+#include "matrix.h"
+
+namespace Hermes
+{
+  namespace Algebra
+  {
+    /// \brief Matrix kept as the list of the local (element) matrices added to it, in a file.
+    ///
+    /// The local matrices coming from add() are collected in a buffer of a fixed size, which is appended to the file
+    /// whenever it is full, so that assembling into the store needs neither the sparse structure nor the matrix in memory.
+    /// The products (multiply_with_vector()) read the file sequentially, so the store can be used with the solvers needing
+    /// just the products (see Hermes::Solvers::GMRESSolver), or it can be summed into an assembled matrix later (add_to_matrix()).
+    /// The entries can not be read.
+    /// With the assembling split over MPI processes (DiscreteProblem::set_process_partition()) every process keeps its own
+    /// local matrices (in its own file) and the products are summed over the processes.
+    template <typename Scalar>
+    class HERMES_API ElementMatrixStore : public SparseMatrix<Scalar>
+    {
+    public:
+      /// @param[in] file_name The file of the local matrices, truncated by alloc() and zero(), removed by the destructor.
+      /// @param[in] buffer_size The bytes of the local matrices kept in memory before they are written out.
+      ElementMatrixStore(const char* file_name, size_t buffer_size = 16 * 1024 * 1024);
+      virtual ~ElementMatrixStore();
+
+      /// Only the size, there is no sparse structure.
+      virtual void prealloc(unsigned int n);
+      virtual void prealloc_counting();
+      virtual void prealloc_indices();
+      virtual int get_prealloc_passes() const { return 1; }
+      virtual void pre_add_ij(unsigned int row, unsigned int col);
+
+      /// Opens (truncates) the file.
+      virtual void alloc();
+      /// Opens the file for the size n.
+      void alloc(unsigned int n);
+      virtual void free();
+      virtual Scalar get(unsigned int m, unsigned int n);
+      /// Forgets all the local matrices.
+      virtual void zero();
+      /// The shift is added to the products, i.e. the operator becomes A + v I.
+      virtual void add_to_diagonal(Scalar v);
+      virtual void add(unsigned int m, unsigned int n, Scalar v);
+      /// Stores the local matrix, thread-safe. The negative rows and columns are skipped.
+      virtual void add(unsigned int m, unsigned int n, Scalar **mat, int *rows, int *cols);
+      /// Writes out the buffer.
+      virtual void finish();
+      /// The products are summed over the processes.
+      virtual void sum_over_processes();
+
+      virtual void multiply_with_vector(Scalar* vector_in, Scalar* vector_out);
+
+      /// Adds all the local matrices into an allocated matrix (with the sparse structure of the same problem).
+      void add_to_matrix(SparseMatrix<Scalar>* mat);
+
+      virtual bool dump(FILE *file, const char *var_name, EMatrixDumpFormat fmt = DF_MATLAB_SPARSE, char* number_format = "%lf");
+      virtual unsigned int get_matrix_size() const;
+      /// The number of the values of all the local matrices (the same entry may come several times).
+      virtual unsigned int get_nnz() const;
+      virtual double get_fill_in() const;
+
+      /// The number of local matrices stored.
+      unsigned int get_num_local_matrices() const;
+      /// The bytes written to the file.
+      size_t get_file_size() const;
+
+    protected:
+      /// Appends the buffer to the file.
+      void flush_buffer();
+      /// Reads the next local matrix from the file (rewound by the caller).
+      /// \return false at the end of the file.
+      bool read_local_matrix(FILE* file, unsigned int& m, unsigned int& n, std::vector<int>& rows, std::vector<int>& cols, std::vector<Scalar>& values);
+
+      std::string file_name;
+      FILE* file;
+
+      char* buffer;
+      size_t buffer_size;
+      size_t buffer_used;
+
+      unsigned int num_local_matrices;
+      unsigned int num_values;
+      size_t file_size;
+
+      Scalar diagonal_shift;
+      bool sum_products;
+    };
+  }
+}
+#endif
@@ -59,9 +59,9 @@ namespace Hermes
       virtual ~EpetraMatrix();
 
       virtual void prealloc(unsigned int n);
-      virtual void pre_add_ij(unsigned int row, unsigned int col);
       virtual void finish();
 
+      /// Builds the graph with the exact number of entries of every row (static profile) from the registered indices.
       virtual void alloc();
       virtual void free();
       virtual Scalar get(unsigned int m, unsigned int n);
@@ -0,0 +1,241 @@
+// This file is part of HermesCommon
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+/*! \file krylov_solver.h
+\brief CSR matrix and the built-in multithreaded Krylov solvers (CG, BiCGStab, GMRES).
+*/
+#ifndef __HERMES_COMMON_KRYLOV_SOLVER_H_
+#define __HERMES_COMMON_KRYLOV_SOLVER_H_
+
+#include "linear_matrix_solver.h"
+#include "matrix.h"
+
+using namespace Hermes::Algebra;
+
+namespace Hermes
+{
+  namespace Solvers
+  {
+    template <typename Scalar> class HERMES_API KrylovSolver;
+  }
+  namespace Preconditioners
+  {
+    template <typename Scalar> class HERMES_API KrylovPrecond;
+  }
+
+  namespace Algebra
+  {
+    /// \brief General CSR Matrix class.
+    /// Used by the built-in Krylov solvers (Hermes::Solvers::KrylovSolver), the rows can be
+    /// multiplied with a vector in parallel without any synchronization.
+    template <typename Scalar>
+    class HERMES_API CSRMatrix : public SparseMatrix<Scalar>
+    {
+    public:
+      /// Creates matrix in CSR format using size, nnz, and the three arrays.
+      /// @param[in] size size of matrix (num of rows and columns)
+      /// @param[in] nnz number of nonzero values
+      /// @param[in] ap index to ap/ax, where each row starts (size is matrix size + 1)
+      /// @param[in] ai column indices (sorted within every row)
+      /// @param[in] ax values (if NULL, the matrix is created with the sparse structure given by ap, ai and zero values)
+      void create(unsigned int size, unsigned int nnz, int* ap, int* ai, Scalar* ax);
+
+      CSRMatrix();
+      virtual ~CSRMatrix();
+
+      /// The indices are registered row-wise, see SparseMatrix::prealloc().
+      virtual void pre_add_ij(unsigned int row, unsigned int col);
+
+      virtual void alloc();
+      virtual void free();
+      virtual Scalar get(unsigned int m, unsigned int n);
+      virtual void zero();
+      virtual void add(unsigned int m, unsigned int n, Scalar v);
+      virtual void add_to_diagonal(Scalar v);
+      virtual void add(unsigned int m, unsigned int n, Scalar **mat, int *rows, int *cols);
+      virtual bool dump(FILE *file, const char *var_name, EMatrixDumpFormat fmt = DF_MATLAB_SPARSE, char* number_format = "%lf");
+      virtual unsigned int get_matrix_size() const;
+      virtual unsigned int get_nnz() const;
+      virtual double get_fill_in() const;
+
+      /// Applies the matrix to vector_in and saves result to vector_out, in parallel over the rows.
+      virtual void multiply_with_vector(Scalar* vector_in, Scalar* vector_out);
+      /// Multiplies matrix with a Scalar.
+      virtual void multiply_with_Scalar(Scalar value);
+      /// Sums the entries over the MPI processes.
+      virtual void sum_over_processes();
+
+      /// Duplicates a matrix (including allocation).
+      virtual CSRMatrix* duplicate();
+
+      /// @return pointer to #Ap
+      int *get_Ap();
+      /// @return pointer to #Ai
+      int *get_Ai();
+      /// @return pointer to #Ax
+      Scalar *get_Ax();
+
+    protected:
+      /// Position of the entry [m, n] in Ax, -1 if it is not in the sparse structure.
+      int find_position(unsigned int m, unsigned int n) const;
+
+      /// Adds v to Ax[pos], thread-safe.
+      void add_to_position(unsigned int pos, Scalar v);
+
+      /// Matrix entries (row-wise).
+      Scalar *Ax;
+      /// Column indices of values in Ax.
+      int *Ai;
+      /// Index to Ax/Ai, where each row starts.
+      int *Ap;
+      /// Number of non-zero entries ( =  Ap[size]).
+      unsigned int nnz;
+    };
+
+    /// \brief Plain array vector used with CSRMatrix.
+    template <typename Scalar>
+    class HERMES_API KrylovVector : public Vector<Scalar>
+    {
+    public:
+      KrylovVector();
+      /// Constructor of vector with specific size.
+      /// @param[in] size size of vector
+      KrylovVector(unsigned int size);
+      virtual ~KrylovVector();
+      virtual void alloc(unsigned int ndofs);
+      virtual void free();
+      virtual Scalar get(unsigned int idx);
+      virtual void extract(Scalar *v) const;
+      virtual const Scalar* get_values() const;
+      virtual void zero();
+      virtual void change_sign();
+      virtual void set(unsigned int idx, Scalar y);
+      virtual void add(unsigned int idx, Scalar y);
+      virtual void add(unsigned int n, unsigned int *idx, Scalar *y);
+      virtual void add_vector(Vector<Scalar>* vec);
+      virtual void add_vector(Scalar* vec);
+      virtual bool dump(FILE *file, const char *var_name, EMatrixDumpFormat fmt = DF_MATLAB_SPARSE, char* number_format = "%lf");
+
+      /// @return pointer to array with vector data
+      Scalar *get_c_array();
+
+    protected:
+      Scalar *v;
+    };
+  }
+
+  namespace Solvers
+  {
+    /// \brief Built-in Krylov subspace solvers, not needing any external library.
+    ///
+    /// Works directly on CSRMatrix (the matrix created for SOLVER_KRYLOV), on BSRMatrix and on the CSC
+    /// matrices of UMFPACK (CSCMatrix), the last two being copied into CSR when solving. The products with the matrix, the
+    /// vector operations and the preconditioners (see Hermes::Preconditioners::KrylovPrecond)
+    /// are parallelized by OpenMP. The tolerance is relative to the norm of the right-hand side.
+    ///
+    /// @ingroup solvers
+    template <typename Scalar>
+    class HERMES_API KrylovSolver : public IterSolver<Scalar>
+    {
+    public:
+      KrylovSolver(SparseMatrix<Scalar> *m, Vector<Scalar> *rhs);
+      virtual ~KrylovSolver();
+      virtual bool solve();
+      /// The right-hand sides are solved one after another, the preconditioner being computed just once.
+      /// get_num_iters() and get_residual() then refer to the last one.
+      virtual bool solve_multiple(Scalar* rhs_block, int nrhs);
+      virtual int get_matrix_size();
+
+      virtual int get_num_iters();
+      virtual double get_residual();
+
+      /// Set the type of the solver.
+      /// @param[in] solver - name of the solver[ cg | bicgstab | gmres ], default: gmres.
+      /// CG is only meant for symmetric (Hermitian) positive definite matrices and preconditioners.
+      void set_solver(const char *solver);
+
+      /// Set the number of iterations after which the Krylov subspace of GMRES is rebuilt.
+      /// Default: 30.
+      void set_restart(int restart);
+
+      /// Set a built-in preconditioner.
+      /// @param[in] name - name of the preconditioner[ none | jacobi | ilu0 | block-jacobi ]
+      virtual void set_precond(const char *name);
+
+      /// Set a preconditioner, which has to be a KrylovPrecond (it is not deleted by the solver).
+      virtual void set_precond(Precond<Scalar> *pc);
+
+    protected:
+      enum KrylovMethod
+      {
+        KRYLOV_CG,
+        KRYLOV_BICGSTAB,
+        KRYLOV_GMRES
+      };
+
+      /// The matrix the iterations run with, m itself or its CSR copy.
+      /// The copy is kept between the solves, while the sparse structure of m does not change (e.g. in the Newton iterations),
+      /// only the values are copied again.
+      CSRMatrix<Scalar>* get_csr_matrix();
+
+      /// The sparse structure of m is the one csr_copy was created from.
+      bool copy_structure_unchanged(int* ap, int ap_size, int* ai, int ai_size, int block_size) const;
+      /// Remembers the sparse structure csr_copy was created from.
+      void set_copy_structure(int* ap, int ap_size, int* ai, int ai_size, int block_size);
+      void free_copy_structure();
+      /// Copies the values of m into csr_copy by copy_positions.
+      void copy_values(Scalar* ax, int count);
+
+      /// z = M^-1 r, copy if there is no preconditioner.
+      void apply_precond(Scalar* r, Scalar* z);
+
+      /// Runs the selected method for the right-hand side b, the solution is stored in sln.
+      bool solve_rhs(CSRMatrix<Scalar>* a, Scalar* b);
+
+      bool solve_cg(CSRMatrix<Scalar>* a, Scalar* b, double b_norm);
+      bool solve_bicgstab(CSRMatrix<Scalar>* a, Scalar* b, double b_norm);
+      bool solve_gmres(CSRMatrix<Scalar>* a, Scalar* b, double b_norm);
+
+      SparseMatrix<Scalar> *m;
+      Vector<Scalar> *rhs;
+
+      /// CSR copy of a BSR or CSC matrix.
+      CSRMatrix<Scalar>* csr_copy;
+      /// The positions in csr_copy of the values of m (by their index in the values of m).
+      int* copy_positions;
+      /// The sparse structure of m csr_copy was created from.
+      int* copy_ap;
+      int* copy_ai;
+      int copy_ap_size;
+      int copy_ai_size;
+      int copy_block_size;
+
+      Hermes::Preconditioners::KrylovPrecond<Scalar>* pc;
+      /// The preconditioner was created by set_precond(const char*).
+      bool own_pc;
+
+      KrylovMethod method;
+      int restart;
+      int num_iters;
+      double residual;
+
+      template<typename T> friend LinearMatrixSolver<T>* create_linear_solver(Matrix<T>* matrix, Vector<T>* rhs);
+    };
+  }
+}
+#endif
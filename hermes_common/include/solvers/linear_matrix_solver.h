@@ -83,6 +83,57 @@ namespace Hermes
       ///< factorization.
     };
 
+    /// \brief The statistics of a linear solver, common to all the backends (see LinearMatrixSolver::get_statistics()).
+    ///
+    /// The counts and the times are summed over all the solves since the creation of the solver (or reset_statistics()),
+    /// the sizes describe the last factorized matrix. The fields a backend does not know stay zero, e.g. the iterations
+    /// of a direct solver or the factor fill of an iterative one.
+    class HERMES_API LinearMatrixSolverStatistics
+    {
+    public:
+      LinearMatrixSolverStatistics();
+
+      /// Sets all the fields to zero.
+      void clear();
+
+      /// The number of the nonzeros of the factors per a nonzero of the matrix, 0 if unknown.
+      double get_fill_ratio() const;
+      /// The number of the solves that reused an existing numeric factorization.
+      unsigned long get_num_factorization_reuses() const;
+      /// The number of the numeric factorizations that reused an existing symbolic factorization.
+      unsigned long get_num_symbolic_reuses() const;
+
+      /// Adds the counts and the times of another object, takes over its sizes if they are known.
+      void add(const LinearMatrixSolverStatistics& other);
+      /// The counts and the times accumulated since the earlier state of the same solver, with the current sizes.
+      LinearMatrixSolverStatistics since(const LinearMatrixSolverStatistics& earlier) const;
+
+      /// A one-line summary, for the logs.
+      std::string to_string() const;
+
+      /// Numbers of the symbolic and the numeric factorizations (or preconditioner setups) and of the solves.
+      unsigned long num_symbolic_factorizations;
+      unsigned long num_numeric_factorizations;
+      unsigned long num_solves;
+      /// The iterations of the iterative solvers.
+      unsigned long num_iterations;
+
+      /// The times (in seconds) of the phases (see LinearMatrixSolver::ProfilePhase).
+      double symbolic_time;
+      double numeric_time;
+      double solve_time;
+
+      /// The floating point operations of the factorizations, as reported by the backend.
+      double flops;
+
+      /// The matrix and the factors of the last factorization, and the last residual of an iterative solver.
+      unsigned int matrix_size;
+      unsigned long matrix_nnz;
+      unsigned long factor_nnz;
+      size_t factor_memory;
+      double residual;
+    };
+
     /// \brief Abstract class for defining solver interface.
     ///
     ///\todo Adjust interface to support faster update of matrix and rhs
@@ -100,6 +151,21 @@ namespace Hermes
       /// @return true on succes
       virtual bool solve() = 0;
 
+      /// Solve the system with several right-hand sides at once, the direct solvers factorize the matrix
+      /// just once for the whole block (all of them according to the factorization scheme).
+      /// @param[in,out] rhs_block - the right-hand sides (of the matrix size) one after another, replaced by the solutions
+      /// @param[in] nrhs - number of the right-hand sides
+      /// @return true on succes
+      virtual bool solve_multiple(Scalar* rhs_block, int nrhs);
+
+      /// Solve the systems with the transposed (not conjugated) matrix, A^T x = b, e.g. the adjoint problems of goal-oriented
+      /// adaptivity. The direct solvers use the factorization of A of the previous solve() / solve_multiple() if there is one,
+      /// so that the adjoint costs one back-solve.
+      /// @param[in,out] rhs_block - the right-hand sides (of the matrix size) one after another, replaced by the solutions
+      /// @param[in] nrhs - number of the right-hand sides
+      /// @return true on succes
+      virtual bool solve_transposed(Scalar* rhs_block, int nrhs);
+
       /// Get solution vector.
       /// @return solution vector ( #sln )
       Scalar *get_sln_vector();
@@ -119,12 +185,40 @@ namespace Hermes
       /// Set factorization scheme to default.
       virtual void set_factorization_scheme();
 
+      /// The phases of the solution timed by the profile (see get_profile()).
+      enum ProfilePhase
+      {
+        /// Symbolic factorization (ordering, analysis of the pattern).
+        PROFILE_SYMBOLIC,
+        /// Numeric factorization, or the setup (preconditioner) of an iterative solver.
+        PROFILE_NUMERIC,
+        /// Solution with the factors, or the iterations of an iterative solver.
+        PROFILE_SOLVE,
+        PROFILE_NUM_PHASES
+      };
+
+      /// The per-phase timing of this solver (see Hermes::Mixins::Profile).
+      /// Enabled by default, as the statistics (get_statistics()) are based on it; the solver phases are coarse enough
+      /// for the timing not to matter.
+      Hermes::Mixins::Profile* get_profile();
+
+      /// The statistics of all the solves since the creation of the solver or reset_statistics().
+      virtual LinearMatrixSolverStatistics get_statistics();
+      /// Starts the statistics (and the profile) from zero.
+      void reset_statistics();
+
     protected:
       /// Solution vector.
       Scalar *sln;
       /// \todo document (not sure what it do)
       int error;
       double time;  ///< Time spent on solving (in secs).
+
+      Hermes::Mixins::Profile profile;
+
+      /// The fields of the statistics the backend fills in itself (sizes, flops, iterations),
+      /// the counts and the times of the phases are taken from the profile by get_statistics().
+      LinearMatrixSolverStatistics statistics;
     };
 
     /// \brief Base class for defining interface for direct linear solvers.
@@ -134,12 +228,23 @@ namespace Hermes
     {
     public:
       DirectSolver(unsigned int factorization_scheme = HERMES_FACTORIZE_FROM_SCRATCH)
-        : LinearMatrixSolver<Scalar>(), factorization_scheme(factorization_scheme) {};
+        : LinearMatrixSolver<Scalar>(), factorization_scheme(factorization_scheme), pattern_size(0), pattern_nnz(0), pattern_hash(0) {};
 
     protected:
       virtual void set_factorization_scheme(FactorizationScheme reuse_scheme);
 
+      /// Check whether the sparsity pattern of the matrix to be factorized now is the same one as the pattern
+      /// of the matrix factorized last time, and remember the new pattern. The pattern is given by two index arrays
+      /// (e.g. Ap and Ai of a CSC matrix) and compared by a hash of their contents.
+      /// Always false if the automatic reuse is switched off (see Hermes::symbolicFactorizationReuse).
+      bool pattern_unchanged(unsigned int size, unsigned int nnz, const int* p, unsigned int p_len, const int* i, unsigned int i_len);
+
       unsigned int factorization_scheme;
+
+      /// Size, number of nonzeros and hash of the pattern of the matrix factorized last time.
+      unsigned int pattern_size;
+      unsigned int pattern_nnz;
+      uint64_t pattern_hash;
     };
 
     /// \brief  Abstract class for defining interface for iterative solvers.
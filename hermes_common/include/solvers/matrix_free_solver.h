@@ -0,0 +1,124 @@
+// This file is part of HermesCommon
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+/*! \file matrix_free_solver.h
+\brief Matrix-free Jacobian operator and a GMRES solver working with products only.
+*/
+#ifndef __HERMES_COMMON_MATRIX_FREE_SOLVER_H_
+#define __HERMES_COMMON_MATRIX_FREE_SOLVER_H_
+
+#include "linear_matrix_solver.h"
+#include "dp_interface.h"
+#include "matrix.h"
+
+using namespace Hermes::Algebra;
+
+namespace Hermes
+{
+  namespace Algebra
+  {
+    /// \brief Jacobian of a discrete problem that is never assembled.
+    ///
+    /// The product with a vector is approximated by the finite difference of residuals
+    /// J(u) v = (F(u + eps v) - F(u)) / eps, every product thus costs one residual assembly
+    /// and the memory needed is a few vectors of the size of the problem.
+    /// Only multiply_with_vector() and add_to_diagonal() are meaningful, entries can be neither
+    /// read nor added, so the operator can only be used with solvers needing just the products
+    /// (see Hermes::Solvers::GMRESSolver).
+    template <typename Scalar>
+    class HERMES_API MatrixFreeJacobian : public SparseMatrix<Scalar>
+    {
+    public:
+      MatrixFreeJacobian(Hermes::Solvers::DiscreteProblemInterface<Scalar>* dp);
+      virtual ~MatrixFreeJacobian();
+
+      /// Set the point the Jacobian is taken in.
+      /// \param[in] coeff_vec The coefficient vector u.
+      /// \param[in] residual The residual F(u) assembled in coeff_vec (before any change of sign).
+      void set_linearization_point(Scalar* coeff_vec, Vector<Scalar>* residual);
+
+      virtual void multiply_with_vector(Scalar* vector_in, Scalar* vector_out);
+
+      virtual void alloc();
+      virtual void free();
+      virtual Scalar get(unsigned int m, unsigned int n);
+      virtual void zero();
+      /// The shift is added to the products, i.e. the operator becomes J + v I.
+      virtual void add_to_diagonal(Scalar v);
+      virtual void add(unsigned int m, unsigned int n, Scalar v);
+      virtual void add(unsigned int m, unsigned int n, Scalar **mat, int *rows, int *cols);
+      virtual bool dump(FILE *file, const char *var_name, EMatrixDumpFormat fmt = DF_MATLAB_SPARSE, char* number_format = "%lf");
+      virtual unsigned int get_matrix_size() const;
+      virtual unsigned int get_nnz() const;
+      virtual double get_fill_in() const;
+
+    protected:
+      Hermes::Solvers::DiscreteProblemInterface<Scalar>* dp;
+
+      /// The linearization point and the residual in it.
+      Scalar* coeff_vec;
+      Scalar* residual;
+      double coeff_vec_norm;
+
+      /// The perturbed point and the residual in it.
+      Scalar* perturbed_coeff_vec;
+      Vector<Scalar>* perturbed_residual;
+
+      Scalar diagonal_shift;
+    };
+  }
+
+  namespace Solvers
+  {
+    /// \brief Restarted GMRES needing only the products of the matrix with vectors.
+    ///
+    /// Works with any SparseMatrix implementing multiply_with_vector(), in particular
+    /// with Hermes::Algebra::MatrixFreeJacobian. No preconditioning is supported.
+    /// The tolerance is relative to the norm of the right-hand side.
+    ///
+    /// @ingroup solvers
+    template <typename Scalar>
+    class HERMES_API GMRESSolver : public IterSolver<Scalar>
+    {
+    public:
+      GMRESSolver(SparseMatrix<Scalar> *m, Vector<Scalar> *rhs);
+      virtual ~GMRESSolver();
+      virtual bool solve();
+      virtual int get_matrix_size();
+
+      virtual int get_num_iters();
+      virtual double get_residual();
+
+      /// Set the number of iterations after which the Krylov subspace is rebuilt.
+      /// Default: 30.
+      void set_restart(int restart);
+
+      virtual void set_precond(const char *name);
+      virtual void set_precond(Precond<Scalar> *pc);
+
+    protected:
+      SparseMatrix<Scalar> *m;
+      Vector<Scalar> *rhs;
+
+      int restart;
+      int num_iters;
+      double residual;
+    };
+  }
+}
+#endif
@@ -31,6 +31,8 @@ extern "C"
 #include <mumps_c_types.h>
 #include <dmumps_c.h>
 #include <zmumps_c.h>
+#include <smumps_c.h>
+#include <cmumps_c.h>
 }
 
 #ifdef WITH_MPI
@@ -59,6 +61,10 @@ namespace Hermes
       typedef ZMUMPS_STRUC_C mumps_struct;
     /** Type for storing scalar number in Mumps complex structures */
       typedef ZMUMPS_COMPLEX mumps_Scalar;
+    /** Type of the single precision Mumps struct (see MumpsSolver::set_single_precision_factorization()) */
+      typedef CMUMPS_STRUC_C mumps_single_struct;
+    /** Type of the single precision scalar number */
+      typedef CMUMPS_COMPLEX mumps_single_Scalar;
     };
 
     /** Type for storing number in Mumps real structures */
@@ -69,6 +75,10 @@ namespace Hermes
       typedef DMUMPS_STRUC_C mumps_struct;
     /** Type for storing scalar number in Mumps real structures */
       typedef double mumps_Scalar;
+    /** Type of the single precision Mumps struct (see MumpsSolver::set_single_precision_factorization()) */
+      typedef SMUMPS_STRUC_C mumps_single_struct;
+    /** Type of the single precision scalar number */
+      typedef float mumps_single_Scalar;
     };
 
     /** \brief Matrix used with MUMPS solver */
@@ -93,6 +103,7 @@ namespace Hermes
       /// Add matrix.
       /// @param[in] mat matrix to be added
       virtual void add_matrix(MumpsMatrix* mat);
+      virtual void add_sparse_matrix(SparseMatrix<Scalar>* mat);
       /// Add matrix to diagonal.
       /// @param[in] num_stages matrix is added to num_stages positions. num_stages * size(added matrix) = size(target matrix)
       /// @param[in] mat added matrix
@@ -108,6 +119,8 @@ namespace Hermes
       void multiply_with_vector(Scalar* vector_in, Scalar* vector_out);
       /// Multiplies matrix with a Scalar.
       void multiply_with_Scalar(Scalar value);
+      /// Sums the entries over the MPI processes, not needed for the non-replicated distributed input of MumpsSolver.
+      virtual void sum_over_processes();
       /// Creates matrix using size, nnz, and the three arrays.
       void create(unsigned int size, unsigned int nnz, int* ap, int* ai, Scalar* ax);
       /// Duplicates a matrix (including allocation).
@@ -138,6 +151,7 @@ namespace Hermes
       virtual void free();
       virtual Scalar get(unsigned int idx);
       virtual void extract(Scalar *v) const;
+      virtual const Scalar* get_values() const;
       virtual void zero();
       virtual void change_sign();
       virtual void set(unsigned int idx, Scalar y);
@@ -171,6 +185,10 @@ namespace Hermes
       virtual ~MumpsSolver();
 
       virtual bool solve();
+      /// All the right-hand sides are solved by one call of MUMPS (the multiple RHS mode).
+      virtual bool solve_multiple(Scalar* rhs_block, int nrhs);
+      /// The same with ICNTL(9) = 0, the factorization of the last solve is reused.
+      virtual bool solve_transposed(Scalar* rhs_block, int nrhs);
       virtual int get_matrix_size();
 
       /// Matrix to solve.
@@ -180,6 +198,8 @@ namespace Hermes
 
       /// \todo document
       bool setup_factorization();
+      /// solve_multiple() and solve_transposed().
+      bool solve_block(Scalar* rhs_block, int nrhs, bool transposed);
 
       /// MUMPS specific structure with solver parameters.
       typename mumps_type<Scalar>::mumps_struct param;
@@ -193,8 +213,67 @@ namespace Hermes
       bool reinit();
       /// True if solver is inited.
       bool inited;
+
+      /// Factorize in single precision (SMUMPS / CMUMPS) and recover the accuracy of the double precision
+      /// by iterative refinement with the residuals of the double precision matrix.
+      /// The factors take half of the memory and the factorization half of the bandwidth, every refinement
+      /// step costs one solve with the factors and one product with the matrix. Useful for well conditioned
+      /// systems, the refinement converges roughly if the condition number is below 1e7.
+      /// @param[in] to_set - use the single precision factorization
+      /// @param[in] max_refinement_steps - maximum number of the refinement steps after the first solve
+      /// @param[in] tolerance - the refinement stops when the norm of the residual relative to the norm of the right-hand side drops below it
+      void set_single_precision_factorization(bool to_set, int max_refinement_steps = 10, double tolerance = 1e-14);
+      /// Number of the refinement steps of the last solve with the single precision factorization.
+      int get_num_refinement_steps() const;
+      /// Relative residual after the last solve with the single precision factorization.
+      double get_refinement_residual() const;
+
+      /// Give the matrix to MUMPS as the distributed assembled input (ICNTL(18) = 3): every MPI process passes
+      /// only a part of the entries, so that they are not gathered on the host and distributed by MUMPS from there.
+      /// The right-hand side stays centralized, i.e. it has to be complete on the host.
+      /// @param[in] to_set - use the distributed input
+      /// @param[in] replicated - true if every process holds the whole matrix (as assembled by DiscreteProblem), each one
+      /// then passes an equal share of the entries; false if every process holds only the contributions of its own part
+      /// of the elements (in any sparse structure), all of them are then passed and MUMPS sums the entries of all processes.
+      /// The single precision factorization needs the whole matrix on every process.
+      void set_distributed_input(bool to_set, bool replicated = true);
+
+    protected:
+      /// The entries of the matrix (from the first one, in the order of irn, jcn and Ax) this process gives to MUMPS,
+      /// see set_distributed_input().
+      void get_local_entries(unsigned int& first, unsigned int& count) const;
+
+      bool distributed_input;
+      bool replicated_input;
+
+      /// Single precision factorization and iterative refinement, see set_single_precision_factorization().
+      /// @param[in] b - the right-hand side
+      /// @param[in] factorize - (re)factorize the matrix, false to use the factors of the previous call
+      bool solve_single_precision(Scalar* b, bool factorize);
+      /// (Re)factorizes the single precision copy of the matrix according to the factorization scheme.
+      bool setup_single_factorization();
+      /// (Re)initialize the single precision MUMPS instance.
+      bool reinit_single();
+      bool check_single_status();
+
+      bool single_precision;
+      int max_refinement_steps;
+      double refinement_tolerance;
+      int num_refinement_steps;
+      double refinement_residual;
+
+      /// MUMPS structure of the single precision factorization.
+      typename mumps_type<Scalar>::mumps_single_struct single_param;
+      /// Single precision copy of the matrix entries.
+      typename mumps_type<Scalar>::mumps_single_Scalar *single_Ax;
+      /// True if the single precision instance is inited.
+      bool single_inited;
+      /// True if single_param holds the factors of the current matrix.
+      bool single_factorized;
+
     private:
       void mumps_c(typename mumps_type<Scalar>::mumps_struct * param);  //wrapper around dmums_c or zmumps_c
+      void mumps_c(typename mumps_type<Scalar>::mumps_single_struct * param);  //wrapper around smums_c or cmumps_c
     };
   }
 }
@@ -46,12 +46,12 @@ namespace Hermes
 
       Scalar *get_sln_vector();
 
-      /// Set the name of the iterative method employed by AztecOO (ignored
+      /// Set the name of the iterative method employed by AztecOO or KrylovSolver (ignored
       /// by the other solvers).
       /// \param[in] preconditioner_name See the attribute preconditioner.
       void set_iterative_method(const char* iterative_method_name);
 
-      /// Set the name of the preconditioner employed by AztecOO (ignored by
+      /// Set the name of the preconditioner employed by AztecOO or KrylovSolver (ignored by
       /// the other solvers).
       /// \param[in] preconditioner_name See the attribute preconditioner.
       void set_preconditioner(const char* preconditioner_name);
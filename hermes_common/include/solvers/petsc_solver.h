@@ -66,6 +66,10 @@ namespace Hermes
       /// Add matrix.
       /// @param[in] mat matrix to be added
       virtual void add_matrix(PetscMatrix* mat);
+      virtual void add_sparse_matrix(SparseMatrix<Scalar>* mat)
+      {
+        add_matrix(static_cast<PetscMatrix<Scalar>*>(mat));
+      }
       /// Add matrix to diagonal.
       /// @param[in] num_stages matrix is added to num_stages positions. num_stages * size(added matrix) = size(target matrix)
       /// @param[in] mat added matrix
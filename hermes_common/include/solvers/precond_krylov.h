@@ -0,0 +1,144 @@
+// This file is part of HermesCommon
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+/*! \file precond_krylov.h
+\brief Preconditioners of the built-in Krylov solvers (Jacobi, ILU(0), block-Jacobi).
+*/
+#ifndef __HERMES_COMMON_PRECOND_KRYLOV_H_
+#define __HERMES_COMMON_PRECOND_KRYLOV_H_
+
+#include "precond.h"
+#include "krylov_solver.h"
+
+namespace Hermes
+{
+  namespace Preconditioners
+  {
+    /// \brief Preconditioner of Hermes::Solvers::KrylovSolver, working on a CSRMatrix.
+    ///
+    /// create() remembers the matrix, compute() builds the preconditioner from its current
+    /// values, apply() is then called in every iteration.
+    ///
+    /// @ingroup preconds
+    template <typename Scalar>
+    class HERMES_API KrylovPrecond : public Precond<Scalar>
+    {
+    public:
+      KrylovPrecond();
+      virtual ~KrylovPrecond();
+
+      /// @param[in] mat - a CSRMatrix
+      virtual void create(Matrix<Scalar> *mat);
+      virtual void destroy();
+      virtual void compute() = 0;
+
+      /// z = M^-1 r.
+      virtual void apply(Scalar* r, Scalar* z) = 0;
+
+#ifdef HAVE_EPETRA
+      virtual Epetra_Operator *get_obj();
+      virtual const Epetra_Comm &Comm() const;
+      virtual const Epetra_Map &OperatorDomainMap() const;
+      virtual const Epetra_Map &OperatorRangeMap() const;
+#endif
+
+    protected:
+      /// Frees the data of compute().
+      virtual void free() = 0;
+
+      CSRMatrix<Scalar>* mat;
+    };
+
+    /// \brief Diagonal (Jacobi) preconditioner.
+    ///
+    /// @ingroup preconds
+    template <typename Scalar>
+    class HERMES_API JacobiPrecond : public KrylovPrecond<Scalar>
+    {
+    public:
+      JacobiPrecond();
+      virtual ~JacobiPrecond();
+      virtual void compute();
+      virtual void apply(Scalar* r, Scalar* z);
+
+    protected:
+      virtual void free();
+
+      /// Inverse of the diagonal.
+      Scalar* inv_diag;
+    };
+
+    /// \brief Incomplete LU factorization with the sparse structure of the matrix (ILU(0)).
+    ///
+    /// The factors are stored in one array with the structure of the matrix, L having a unit diagonal.
+    /// Both the factorization and the triangular solves are sequential, see BlockJacobiPrecond.
+    ///
+    /// @ingroup preconds
+    template <typename Scalar>
+    class HERMES_API ILU0Precond : public KrylovPrecond<Scalar>
+    {
+    public:
+      ILU0Precond();
+      virtual ~ILU0Precond();
+      virtual void compute();
+      virtual void apply(Scalar* r, Scalar* z);
+
+    protected:
+      virtual void free();
+
+      /// Number of (diagonal) blocks factorized independently, the couplings between them are dropped.
+      int num_blocks;
+
+      /// The first row of each block (num_blocks + 1 entries).
+      int* block_starts;
+
+      /// The values of the factors (Ap, Ai of the matrix).
+      Scalar* lu;
+
+      /// Position of the diagonal of every row in lu.
+      int* diag;
+
+      /// Factorizes the rows [row_begin, row_end), ignoring the columns outside.
+      /// @param[in] iw - work array of the matrix size, filled with -1 (and left so).
+      /// @return the first row with a zero or missing pivot, -1 if there is none.
+      int factorize_block(int row_begin, int row_end, int* iw);
+
+      /// Forward and backward substitution in the block.
+      void solve_block(int row_begin, int row_end, Scalar* r, Scalar* z);
+    };
+
+    /// \brief Block-Jacobi preconditioner with ILU(0) of the diagonal blocks.
+    ///
+    /// The rows are split into contiguous blocks (by default one per thread), each block being
+    /// factorized and solved independently of the others, in parallel.
+    ///
+    /// @ingroup preconds
+    template <typename Scalar>
+    class HERMES_API BlockJacobiPrecond : public ILU0Precond<Scalar>
+    {
+    public:
+      /// @param[in] num_blocks - number of blocks, the number of OpenMP threads if <= 0.
+      BlockJacobiPrecond(int num_blocks = 0);
+      virtual void compute();
+
+    protected:
+      int requested_blocks;
+    };
+  }
+}
+#endif
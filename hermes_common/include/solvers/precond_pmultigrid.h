@@ -0,0 +1,100 @@
+// This file is part of HermesCommon
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+/*! \file precond_pmultigrid.h
+\brief p-multigrid preconditioner for hierarchic bases.
+*/
+#ifndef __HERMES_COMMON_PRECOND_PMULTIGRID_H_
+#define __HERMES_COMMON_PRECOND_PMULTIGRID_H_
+
+#include "precond_krylov.h"
+#include "umfpack_solver.h"
+
+namespace Hermes
+{
+  namespace Preconditioners
+  {
+    /// \brief p-multigrid V-cycle for matrices assembled with a hierarchic basis.
+    ///
+    /// Every DOF is given the polynomial order of its basis function (see Space::get_dof_orders() in Hermes2D).
+    /// With a hierarchic basis the functions up to an order p span the space of order p, so the operator of the
+    /// level p is the submatrix of the rows and columns of these DOFs and the restriction and prolongation
+    /// are just the selection of the DOFs. There is one level for every order present, the finest one being
+    /// the matrix itself. The levels above the coarsest one are smoothed by the block-Jacobi ILU(0)
+    /// (BlockJacobiPrecond), the coarsest one is solved by UMFPACK (with the factorization computed once in
+    /// compute()), or approximately by ILU(0) if Hermes is built without UMFPACK.
+    ///
+    /// @ingroup preconds
+    template <typename Scalar>
+    class HERMES_API PMultigridPrecond : public KrylovPrecond<Scalar>
+    {
+    public:
+      /// @param[in] dof_orders - the polynomial order of every DOF (copied)
+      /// @param[in] ndof - length of dof_orders, has to be the size of the matrix
+      /// @param[in] num_smoothing_steps - number of the pre- and of the post-smoothing steps on every level
+      PMultigridPrecond(const int* dof_orders, int ndof, int num_smoothing_steps = 1);
+      virtual ~PMultigridPrecond();
+      virtual void compute();
+      virtual void apply(Scalar* r, Scalar* z);
+
+      /// Number of the levels (distinct orders) built by compute().
+      int get_num_levels() const;
+
+    protected:
+      virtual void free();
+
+      /// One V-cycle on the level, from the right-hand side b[level] to the correction x[level].
+      void cycle(int level);
+
+      /// Residual r[level] = b[level] - A x[level].
+      void residual(int level);
+
+      /// Runs the smoothing steps, starting from x[level] = 0 if zero_start.
+      void smooth(int level, bool zero_start);
+
+      /// Solves on the coarsest level.
+      void solve_coarse();
+
+      int* dof_orders;
+      int ndof;
+      int num_smoothing_steps;
+
+      int num_levels;
+      /// The operators, from the coarsest level to the finest one ( = mat, not owned).
+      CSRMatrix<Scalar>** level_mats;
+      /// For every level but the coarsest one, the index of each of its DOFs on the next coarser level (-1 if not there).
+      int** coarse_index;
+      /// Smoothers of the levels above the coarsest one.
+      BlockJacobiPrecond<Scalar>** smoothers;
+      /// Work arrays of the levels (correction, right-hand side, residual, smoothing update).
+      Scalar** x;
+      Scalar** b;
+      Scalar** r;
+      Scalar** e;
+
+#ifdef WITH_UMFPACK
+      UMFPackMatrix<Scalar>* coarse_matrix;
+      UMFPackVector<Scalar>* coarse_rhs;
+      Hermes::Solvers::LinearMatrixSolver<Scalar>* coarse_solver;
+#else
+      ILU0Precond<Scalar>* coarse_solver;
+#endif
+    };
+  }
+}
+#endif
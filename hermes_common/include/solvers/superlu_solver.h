@@ -117,6 +117,7 @@ namespace Hermes
       /// Add matrix.
       /// @param[in] mat matrix to be added
       virtual void add_matrix(SuperLUMatrix* mat);
+      virtual void add_sparse_matrix(SparseMatrix<Scalar>* mat);
       /// Add matrix to diagonal.
       /// @param[in] num_stages matrix is added to num_stages positions. num_stages * size(added matrix) = size(target matrix)
       /// @param[in] mat added matrix
@@ -132,6 +133,8 @@ namespace Hermes
       void multiply_with_vector(Scalar* vector_in, Scalar* vector_out);
       // Multiplies matrix with a Scalar.
       void multiply_with_Scalar(Scalar value);
+      /// Sums the entries over the MPI processes.
+      virtual void sum_over_processes();
       /// Creates matrix in SuperLU format using size, nnz, and the three arrays.
       /// @param[in] size size of matrix (num of rows and columns)
       /// @param[in] nnz number of nonzero values
@@ -169,6 +172,7 @@ namespace Hermes
       virtual void free();
       virtual Scalar get(unsigned int idx);
       virtual void extract(Scalar *v) const;
+      virtual const Scalar* get_values() const;
       virtual void zero();
       virtual void change_sign();
       virtual void set(unsigned int idx, Scalar y);
@@ -201,9 +205,16 @@ namespace Hermes
       virtual ~SuperLUSolver();
 
       virtual bool solve();
+      /// All the right-hand sides are passed to one call of the solver driver (nrhs columns of B).
+      virtual bool solve_multiple(Scalar* rhs_block, int nrhs);
       virtual int get_matrix_size();
 
     protected:
+      /// Solves the system with nrhs right-hand sides.
+      /// @param[in] rhs_values - the right-hand sides one after another
+      /// @param[out] solutions - the solutions one after another (may be rhs_values)
+      bool solve_rhs(Scalar* rhs_values, int nrhs, Scalar* solutions);
+
       /// Matrix to solve.
       SuperLUMatrix<Scalar> *m;
       /// Right hand side vector.
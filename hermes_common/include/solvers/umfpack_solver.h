@@ -51,9 +51,14 @@ namespace Hermes
       /// @param[in] nnz number of nonzero values
       /// @param[in] ap index to ap/ax, where each column starts (size is matrix size + 1)
       /// @param[in] ai row indices
-      /// @param[in] ax values
+      /// @param[in] ax values (if NULL, the matrix is created with the sparse structure given by ap, ai and zero values)
       void create(unsigned int size, unsigned int nnz, int* ap, int* ai, Scalar* ax);
 
+      /// Uses the three arrays (see create()) in place, without copying them, e.g. a matrix assembled by the caller.
+      /// The arrays are owned by the caller, they are not deleted by free() and have to outlive the use of the matrix.
+      /// The following alloc() (or create()) makes the matrix own its arrays again.
+      void wrap(unsigned int size, unsigned int nnz, int* ap, int* ai, Scalar* ax);
+
       /// \brief Default constructor.
       CSCMatrix();
       /// \brief Constructor with specific size
@@ -70,6 +75,7 @@ namespace Hermes
       /// Add matrix.
       /// @param[in] mat matrix to be added
       virtual void add_matrix(CSCMatrix<Scalar>* mat);
+      virtual void add_sparse_matrix(SparseMatrix<Scalar>* mat);
       /// Add matrix to diagonal.
       /// @param[in] num_stages matrix is added to num_stages positions. num_stages * size(added matrix) = size(target matrix)
       /// @param[in] mat added matrix
@@ -81,15 +87,31 @@ namespace Hermes
       /// @param[in] mat added matrix
       virtual void add_as_block(unsigned int i, unsigned int j, CSCMatrix<Scalar>* mat);
       virtual void add(unsigned int m, unsigned int n, Scalar **mat, int *rows, int *cols);
+      /// Adds a block of values into a separate array of values having the sparse structure (Ap, Ai) of this matrix.
+      /// No synchronization is done, the array is meant to be private to the calling thread.
+      /// @param[in] values array of the length get_nnz() (may be get_Ax() itself).
+      void add_to_values(unsigned int m, unsigned int n, Scalar **mat, int *rows, int *cols, Scalar* values);
+      /// Calculates the positions in the array of values (Ax) of all entries of a block.
+      /// Such a scatter map can be stored and used repeatedly by add_by_positions() while the sparse structure does not change.
+      /// @param[in] rows array with row indexes (negative indexes are skipped)
+      /// @param[in] cols array with column indexes (negative indexes are skipped)
+      /// @param[out] positions array of the length m * n, positions[i * n + j] is the position of [rows[i], cols[j]], or -1.
+      void get_positions(unsigned int m, unsigned int n, int *rows, int *cols, int* positions);
+      /// Adds a block of values using the positions obtained by get_positions(), without any searching.
+      /// @param[in] values if not NULL, the values are added into this array (see add_to_values()) instead of Ax.
+      void add_by_positions(unsigned int m, unsigned int n, Scalar **mat, int* positions, Scalar* values = NULL);
       virtual bool dump(FILE *file, const char *var_name, EMatrixDumpFormat fmt = DF_MATLAB_SPARSE, char* number_format = "%lf");
       virtual unsigned int get_matrix_size() const;
       virtual unsigned int get_nnz() const;
       virtual double get_fill_in() const;
 
       // Applies the matrix to vector_in and saves result to vector_out.
+      /// The rows of the product are computed in parallel, using the row-wise structure (see build_row_structure()).
       void multiply_with_vector(Scalar* vector_in, Scalar* vector_out);
       // Multiplies matrix with a Scalar.
       void multiply_with_Scalar(Scalar value);
+      /// Sums the entries over the MPI processes.
+      virtual void sum_over_processes();
 
       // Duplicates a matrix (including allocation).
       CSCMatrix* duplicate();
@@ -104,6 +126,16 @@ namespace Hermes
       Scalar *get_Ax();
 
     protected:
+      /// Adds v to Ax[pos], thread-safe.
+      void add_to_position(unsigned int pos, Scalar v);
+
+      /// Builds the row-wise (transposed) view of the sparse structure (#Rp, #Rj, #Rpos).
+      /// Only the structure is stored, the values are always read from Ax, so the view stays valid
+      /// until the structure changes (alloc(), create(), free()).
+      void build_row_structure();
+      /// Frees the row-wise view, it is built again on the next use.
+      void free_row_structure();
+
       // UMFPack specific data structures for storing the system matrix (CSC format).
       /// Matrix entries (column-wise).
       Scalar *Ax;
@@ -113,6 +145,15 @@ namespace Hermes
       int *Ap;
       /// Number of non-zero entries ( =  Ap[size]).
       unsigned int nnz;
+      /// Ap, Ai, Ax are allocated by this matrix (not by wrap()).
+      bool owns_arrays;
+
+      /// Index to Rj/Rpos, where each row starts (NULL if the row-wise view is not built).
+      int *Rp;
+      /// Column indices of the entries of every row (sorted).
+      int *Rj;
+      /// Positions of the entries of every row in Ax.
+      int *Rpos;
       template <typename T> friend class Hermes::Solvers::UMFPackLinearMatrixSolver;
       template <typename T> friend class Hermes::Solvers::UMFPackIterator;
       template<typename T> friend SparseMatrix<T>*  create_matrix();
@@ -137,10 +178,12 @@ namespace Hermes
       /// @param[in] size size of vector
       UMFPackVector(unsigned int size);
       virtual ~UMFPackVector();
+      /// If the vector wraps an array of the length ndofs, the array is kept (and zeroed).
       virtual void alloc(unsigned int ndofs);
       virtual void free();
       virtual Scalar get(unsigned int idx);
       virtual void extract(Scalar *v) const;
+      virtual const Scalar* get_values() const;
       virtual void zero();
       virtual void change_sign();
       virtual void set(unsigned int idx, Scalar y);
@@ -150,6 +193,11 @@ namespace Hermes
       virtual void add_vector(Scalar* vec);
       virtual bool dump(FILE *file, const char *var_name, EMatrixDumpFormat fmt = DF_MATLAB_SPARSE, char* number_format = "%lf");
 
+      /// Uses the array in place as the values of the vector, without copying it (e.g. the caller's right-hand side,
+      /// or the coefficient vector to assemble into). The array is owned by the caller, it is not deleted by free().
+      /// The current values (if any) are freed.
+      void wrap(Scalar* v, unsigned int size);
+
       /// @return pointer to array with vector data
       /// \sa #v
       Scalar *get_c_array();
@@ -157,6 +205,8 @@ namespace Hermes
     protected:
       /// UMFPack specific data structures for storing the rhs.
       Scalar *v;
+      /// v is allocated by this vector (not by wrap()).
+      bool owns_v;
       template <typename T> friend class Hermes::Solvers::UMFPackLinearMatrixSolver;
       template <typename T> friend class Hermes::Solvers::UMFPackIterator;
       template<typename T> friend Vector<T>* Hermes::Algebra::create_vector();
@@ -177,8 +227,20 @@ namespace Hermes
       UMFPackLinearMatrixSolver(UMFPackMatrix<Scalar> *m, UMFPackVector<Scalar> *rhs);
       virtual ~UMFPackLinearMatrixSolver();
       virtual bool solve();
+      /// One numeric factorization, then umfpack_*_solve() for every right-hand side.
+      virtual bool solve_multiple(Scalar* rhs_block, int nrhs);
+      /// umfpack_*_solve() with UMFPACK_Aat, the numeric factorization of the last solve is reused.
+      virtual bool solve_transposed(Scalar* rhs_block, int nrhs);
       virtual int get_matrix_size();
 
+      /// Saves the symbolic and numeric factorizations (umfpack_*_save_symbolic(), umfpack_*_save_numeric())
+      /// into the directory, in files named by a hash of the matrix (the structure and the values), and loads them
+      /// instead of the first factorization of a matrix found there. Meant for the fixed operators of linear problems
+      /// (DiscreteProblemLinear), so that a restarted computation does not factorize the same matrix again.
+      /// Every factorized matrix adds its pair of files, the directory is not cleaned.
+      /// @param[in] directory an existing directory, NULL switches the cache off (default).
+      void set_factorization_cache(const char* directory);
+
       /// Matrix to solve.
       UMFPackMatrix<Scalar> *m;
       /// Right hand side vector.
@@ -188,11 +250,27 @@ namespace Hermes
       /// Reordering of matrix A to reduce fill-in during factorization.
       void *symbolic;
       void *numeric;  ///< LU factorization of matrix A.
+      /// The bytes of the L and U factors of numeric (as reported to MemoryAccounting).
+      size_t factorization_memory;
 
       /// \todo document
       void free_factorization_data();
       /// \todo document
       bool setup_factorization();
+      /// solve_multiple() and solve_transposed(), with the UMFPack system type sys (UMFPACK_A or UMFPACK_Aat).
+      bool solve_block(Scalar* rhs_block, int nrhs, int sys);
+      /// Reports the size of the factors of the current numeric factorization to MemoryAccounting.
+      void update_factorization_memory();
+
+      /// The names of the files of the factorizations of the current matrix in the cache.
+      void get_factorization_cache_files(std::string& symbolic_file, std::string& numeric_file);
+      /// Loads the factorizations of the current matrix from the cache, false if they are not there.
+      bool load_cached_factorization();
+      /// Saves the current factorizations into the cache.
+      void save_cached_factorization();
+
+      /// The directory of the factorization cache, empty if not used.
+      std::string factorization_cache;
       template <typename T> friend class Hermes::Algebra::CSCMatrix;
       template <typename T> friend class Hermes::Algebra::UMFPackMatrix;
       template <typename T> friend class Hermes::Algebra::UMFPackVector;
@@ -76,10 +76,20 @@ namespace Hermes
     ///< with Error Estimates by J.R. Cash
     Implicit_SDIRK_CASH_5_34_embedded,       ///< From the paper Diagonally Implicit Runge-Kutta Formulae
     ///< with Error Estimates by J.R. Cash
-    Implicit_DIRK_ISMAIL_7_45_embedded       ///< Implicit embedded DIRK method pair of orders four in five (from the paper
+    Implicit_DIRK_ISMAIL_7_45_embedded,      ///< Implicit embedded DIRK method pair of orders four in five (from the paper
     ///< Fudziah Ismail et all: Embedded Pair of Diagonally Implicit Runge-Kutta
     ///< Method for Solving Ordinary Differential Equations). The method has
     ///< 7 stages but the first one is explicit.
+
+    /* IMEX METHODS */
+    /* The implicit table is stored in A, B and C, the explicit one (with the same C) */
+    /* in A_explicit and B_explicit, see ButcherTable::is_imex(). */
+
+    IMEX_ARS_111,                ///< Implicit-explicit Euler (ARS(1,1,1), order 1), from the paper
+    ///< Implicit-explicit Runge-Kutta methods for time-dependent partial
+    ///< differential equations by U.M. Ascher, S.J. Ruuth and R.J. Spiteri.
+    IMEX_ARS_222,                ///< Implicit-explicit ARS(2,2,2) method (order 2), implicit part L-stable SDIRK.
+    IMEX_ARS_443                 ///< Implicit-explicit ARS(4,4,3) method (order 3), implicit part L-stable SDIRK.
   };
 
   /// \brief General square table of real numbers.
@@ -119,11 +129,25 @@ namespace Hermes
     void switch_B_rows(); ///< For experimental purposes. Switches the B and B2 rows. B2 row
     ///< must be nonzero, otherwise error is thrown.
 
+    /// The explicit table of an IMEX pair, used for the forms set explicit in time
+    /// (Hermes2D: Form::set_explicit_in_time()). Setting any entry makes the table IMEX.
+    double get_A_explicit(unsigned int i, unsigned int j);
+    double get_B_explicit(unsigned int i);
+    void set_A_explicit(unsigned int i, unsigned int j, double val);
+    void set_B_explicit(unsigned int i, double val);
+    /// The table is an implicit-explicit pair. The implicit part (A) has to be diagonally implicit,
+    /// the explicit one (A_explicit) strictly lower triangular.
+    bool is_imex();
+
   protected:
     double* B;
     double* B2;  ///< This is the second B-row for adaptivity based
     ///< on embedded R-K methods.
     double* C;
+    /// Explicit table of an IMEX pair (the C row is shared with the implicit one).
+    double** A_explicit;
+    double* B_explicit;
+    bool imex;
   };
 }
 #endif
\ No newline at end of file
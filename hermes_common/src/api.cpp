@@ -42,6 +42,8 @@ namespace Hermes
 
     this->parameters.insert(std::pair<HermesCommonApiParam, Parameter*> (Hermes::exceptionsPrintCallstack,new Parameter(0)));
     this->parameters.insert(std::pair<HermesCommonApiParam, Parameter*> (Hermes::matrixSolverType,new Parameter(SOLVER_UMFPACK)));
+    this->parameters.insert(std::pair<HermesCommonApiParam, Parameter*> (Hermes::symbolicFactorizationReuse,new Parameter(1)));
+    this->parameters.insert(std::pair<HermesCommonApiParam, Parameter*> (Hermes::parallelFirstTouch,new Parameter(0)));
   }
 
   Api::~Api()
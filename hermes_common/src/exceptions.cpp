@@ -372,5 +372,57 @@ namespace Hermes
     {
       return new SolutionLoadFailureException(*this);
     }
+
+    ParallelStatus::ParallelStatus() : failed(false), exception(NULL)
+    {
+    }
+
+    ParallelStatus::~ParallelStatus()
+    {
+      delete exception;
+    }
+
+    void ParallelStatus::reset()
+    {
+      delete exception;
+      exception = NULL;
+      failed = false;
+    }
+
+    void ParallelStatus::fail(Exception& e)
+    {
+      record(e.clone());
+    }
+
+    void ParallelStatus::fail(std::exception& e)
+    {
+      record(new Exception(e.what()));
+    }
+
+    void ParallelStatus::record(Exception* copy)
+    {
+      bool first = false;
+#pragma omp critical (parallel_status)
+      if(exception == NULL)
+      {
+        exception = copy;
+        first = true;
+#pragma omp flush
+        failed = true;
+      }
+      if(!first)
+        delete copy;
+    }
+
+    void ParallelStatus::rethrow()
+    {
+      if(exception == NULL)
+        return;
+      Exception to_throw(*exception);
+      delete exception;
+      exception = NULL;
+      failed = false;
+      throw to_throw;
+    }
   }
 }
\ No newline at end of file
@@ -118,6 +118,39 @@ namespace Hermes
     }
   };
 
+  template<typename Scalar>
+  void Hermes1DFunction<Scalar>::value_batch(int n, const Scalar* x, Scalar* result) const
+  {
+    if(this->is_const)
+    {
+      for(int i = 0; i < n; i++)
+        result[i] = const_value;
+      return;
+    }
+    for(int i = 0; i < n; i++)
+      result[i] = this->value(x[i]);
+  }
+
+  template<typename Scalar>
+  void Hermes1DFunction<Scalar>::derivative_batch(int n, const Scalar* x, Scalar* result) const
+  {
+    if(this->is_const)
+    {
+      for(int i = 0; i < n; i++)
+        result[i] = Scalar(0.0);
+      return;
+    }
+    for(int i = 0; i < n; i++)
+      result[i] = this->derivative(x[i]);
+  }
+
+  template<typename Scalar>
+  void Hermes1DFunction<Scalar>::value_and_derivative_batch(int n, const Scalar* x, Scalar* values_result, Scalar* derivatives_result) const
+  {
+    this->value_batch(n, x, values_result);
+    this->derivative_batch(n, x, derivatives_result);
+  }
+
   template<typename Scalar>
   Hermes2DFunction<Scalar>::Hermes2DFunction()
   {
@@ -237,6 +270,19 @@ namespace Hermes
     }
   };
 
+  template<typename Scalar>
+  void Hermes2DFunction<Scalar>::value_batch(int n, const double* x, const double* y, Scalar* result) const
+  {
+    if(this->is_const)
+    {
+      for(int i = 0; i < n; i++)
+        result[i] = const_value;
+      return;
+    }
+    for(int i = 0; i < n; i++)
+      result[i] = this->value(Scalar(x[i]), Scalar(y[i]));
+  }
+
   template<typename Scalar>
   Hermes3DFunction<Scalar>::Hermes3DFunction()
   {
@@ -31,8 +31,20 @@
 #include "solvers/mumps_solver.h"
 #include "solvers/newton_solver_nox.h"
 #include "solvers/aztecoo_solver.h"
+#include "solvers/krylov_solver.h"
 #include "qsort.h"
 #include "api.h"
+#include "memory_accounting.h"
+
+#ifdef WITH_HDF5
+#include <hdf5.h>
+#endif
+
+#ifdef WITH_MPI
+#include <mpi.h>
+#endif
+
+static int sparse_matrix_memory_category = Hermes::MemoryAccounting::add_category("sparse matrices");
 
 void Hermes::Algebra::DenseMatrixOperations::ludcmp(double **a, int n, int *indx, double *d)
 {
@@ -122,6 +134,12 @@ Hermes::Algebra::SparseMatrix<Scalar>::SparseMatrix()
 {
   this->size = 0;
   pages = NULL;
+  prealloc_size = 0;
+  prealloc_counts = NULL;
+  prealloc_col_starts = NULL;
+  prealloc_index_array = NULL;
+
+  mem_size = 0;
 
   row_storage = false;
   col_storage = false;
@@ -132,6 +150,12 @@ Hermes::Algebra::SparseMatrix<Scalar>::SparseMatrix(unsigned int size)
 {
   this->size = size;
   pages = NULL;
+  prealloc_size = 0;
+  prealloc_counts = NULL;
+  prealloc_col_starts = NULL;
+  prealloc_index_array = NULL;
+
+  mem_size = 0;
 
   row_storage = false;
   col_storage = false;
@@ -139,69 +163,201 @@ Hermes::Algebra::SparseMatrix<Scalar>::SparseMatrix(unsigned int size)
 
 template<typename Scalar>
 Hermes::Algebra::SparseMatrix<Scalar>::~SparseMatrix()
+{
+  free_prealloc();
+  set_memory_size(0);
+}
+
+template<typename Scalar>
+void Hermes::Algebra::SparseMatrix<Scalar>::free_prealloc()
 {
   if(pages)
   {
-    for (unsigned int i = 0; i < this->size; i++)
-      if(pages[i])
-        delete pages[i];
+    for (unsigned int i = 0; i < prealloc_size; i++)
+    {
+      while(pages[i] != NULL)
+      {
+        Page *tmp = pages[i];
+        pages[i] = tmp->next;
+        delete tmp;
+      }
+    }
     delete [] pages;
+    pages = NULL;
   }
+  delete [] prealloc_counts;
+  prealloc_counts = NULL;
+  delete [] prealloc_col_starts;
+  prealloc_col_starts = NULL;
+  delete [] prealloc_index_array;
+  prealloc_index_array = NULL;
+}
+
+template<typename Scalar>
+void Hermes::Algebra::SparseMatrix<Scalar>::set_memory_size(size_t bytes)
+{
+  Hermes::MemoryAccounting::changed(sparse_matrix_memory_category, mem_size, bytes);
+  mem_size = bytes;
 }
 
 template<typename Scalar>
 void Hermes::Algebra::SparseMatrix<Scalar>::prealloc(unsigned int n)
 {
+  free_prealloc();
   this->size = n;
+  prealloc_size = n;
 
   pages = new Page *[n];
   memset(pages, 0, n * sizeof(Page *));
 }
 
+template<typename Scalar>
+void Hermes::Algebra::SparseMatrix<Scalar>::prealloc_counting()
+{
+  if(pages == NULL)
+    throw Exceptions::Exception("SparseMatrix::prealloc_counting() called without prealloc().");
+
+  free_prealloc();
+  prealloc_counts = new int[prealloc_size];
+  memset(prealloc_counts, 0, prealloc_size * sizeof(int));
+}
+
+template<typename Scalar>
+void Hermes::Algebra::SparseMatrix<Scalar>::prealloc_indices()
+{
+  if(prealloc_counts == NULL)
+    throw Exceptions::Exception("SparseMatrix::prealloc_indices() called without prealloc_counting().");
+
+  prealloc_col_starts = new int[prealloc_size + 1];
+  prealloc_col_starts[0] = 0;
+  for (unsigned int i = 0; i < prealloc_size; i++)
+  {
+    prealloc_col_starts[i + 1] = prealloc_col_starts[i] + prealloc_counts[i];
+    prealloc_counts[i] = 0;
+  }
+
+  prealloc_index_array = new int[prealloc_col_starts[prealloc_size] > 0 ? prealloc_col_starts[prealloc_size] : 1];
+}
+
 template<typename Scalar>
 void Hermes::Algebra::SparseMatrix<Scalar>::pre_add_ij(unsigned int row, unsigned int col)
 {
-  if(pages[col] == NULL || pages[col]->count >= PAGE_SIZE)
+  if(pages != NULL)
+  {
+    if(pages[col] == NULL || pages[col]->count >= PAGE_SIZE)
+    {
+      Page *new_page = new Page;
+      new_page->count = 0;
+      new_page->next = pages[col];
+      pages[col] = new_page;
+    }
+    pages[col]->idx[pages[col]->count++] = row;
+  }
+  else if(prealloc_index_array == NULL)
+    prealloc_counts[col]++;
+  else
   {
-    Page *new_page = new Page;
-    new_page->count = 0;
-    new_page->next = pages[col];
-    pages[col] = new_page;
+    if(prealloc_counts[col] >= prealloc_col_starts[col + 1] - prealloc_col_starts[col])
+      throw Exceptions::Exception("SparseMatrix::pre_add_ij(): the storing pass registered more indices in the column %d than the counting pass.", col);
+    prealloc_index_array[prealloc_col_starts[col] + prealloc_counts[col]++] = row;
   }
-  pages[col]->idx[pages[col]->count++] = row;
 }
 
 template<typename Scalar>
-int Hermes::Algebra::SparseMatrix<Scalar>::sort_and_store_indices(Page *page, int *buffer, int *max)
+void Hermes::Algebra::SparseMatrix<Scalar>::pages_to_index_array()
 {
-  // gather all pages in the buffer, deleting them along the way
-  int *end = buffer;
-  while (page != NULL)
+  prealloc_counts = new int[prealloc_size];
+  prealloc_col_starts = new int[prealloc_size + 1];
+  prealloc_col_starts[0] = 0;
+  for (unsigned int i = 0; i < prealloc_size; i++)
   {
-    memcpy(end, page->idx, sizeof(int) * page->count);
-    end += page->count;
-    Page *tmp = page;
-    page = page->next;
-    delete tmp;
+    prealloc_counts[i] = 0;
+    for (Page *page = pages[i]; page != NULL; page = page->next)
+      prealloc_counts[i] += page->count;
+    prealloc_col_starts[i + 1] = prealloc_col_starts[i] + prealloc_counts[i];
   }
 
-  // sort the indices and remove duplicities
-  qsort_int(buffer, end - buffer);
-  int *q = buffer;
-  for (int *p = buffer, last = -1; p < end; p++) if(*p != last) *q++= last = *p;
+  prealloc_index_array = new int[prealloc_col_starts[prealloc_size] > 0 ? prealloc_col_starts[prealloc_size] : 1];
+  for (unsigned int i = 0; i < prealloc_size; i++)
+  {
+    int *end = prealloc_index_array + prealloc_col_starts[i];
+    while (pages[i] != NULL)
+    {
+      memcpy(end, pages[i]->idx, sizeof(int) * pages[i]->count);
+      end += pages[i]->count;
+      Page *tmp = pages[i];
+      pages[i] = tmp->next;
+      delete tmp;
+    }
+  }
 
-  return q - buffer;
+  delete [] pages;
+  pages = NULL;
 }
 
 template<typename Scalar>
-int Hermes::Algebra::SparseMatrix<Scalar>::get_num_indices()
+int* Hermes::Algebra::SparseMatrix<Scalar>::compress_indices(int *col_starts)
 {
-  int total = 0;
-  for (unsigned int i = 0; i < this->size; i++)
-    for (Page *page = pages[i]; page != NULL; page = page->next)
-      total += page->count;
+  // The single-pass preallocation gets the layout of the two-pass one.
+  if(pages != NULL)
+    pages_to_index_array();
+
+  if(prealloc_index_array == NULL)
+    throw Exceptions::Exception("SparseMatrix::alloc() called before the indices were stored, see SparseMatrix::prealloc_indices().");
+
+  // Sort the indices of every column and remove duplicities within the column.
+  int size = (int)this->size;
+#pragma omp parallel for schedule(dynamic, 256)
+  for (int i = 0; i < size; i++)
+  {
+    int *begin = prealloc_index_array + prealloc_col_starts[i];
+    int *end = begin + prealloc_counts[i];
+    qsort_int(begin, end - begin);
+    int *q = begin;
+    for (int *p = begin, last = -1; p < end; p++) if(*p != last) *q++= last = *p;
+    prealloc_counts[i] = q - begin;
+  }
+
+  col_starts[0] = 0;
+  for (int i = 0; i < size; i++)
+    col_starts[i + 1] = col_starts[i] + prealloc_counts[i];
+
+  // Compact the columns into an array of the exact size.
+  int *indices = new int[col_starts[size] > 0 ? col_starts[size] : 1];
+  for (int i = 0; i < size; i++)
+    memcpy(indices + col_starts[i], prealloc_index_array + prealloc_col_starts[i], prealloc_counts[i] * sizeof(int));
+
+  free_prealloc();
 
-  return total;
+  return indices;
+}
+
+template<typename Scalar>
+int* Hermes::Algebra::SparseMatrix<Scalar>::compress_indices_by_rows(int *row_starts)
+{
+  int size = (int)this->size;
+  int *col_starts = new int[size + 1];
+  int *row_indices = compress_indices(col_starts);
+  int nnz = col_starts[size];
+
+  // Transpose, the columns are visited in ascending order so the rows come out sorted.
+  memset(row_starts, 0, (size + 1) * sizeof(int));
+  for (int k = 0; k < nnz; k++)
+    row_starts[row_indices[k] + 1]++;
+  for (int i = 0; i < size; i++)
+    row_starts[i + 1] += row_starts[i];
+
+  int *col_indices = new int[nnz > 0 ? nnz : 1];
+  int *next = new int[size > 0 ? size : 1];
+  memcpy(next, row_starts, size * sizeof(int));
+  for (int j = 0; j < size; j++)
+    for (int k = col_starts[j]; k < col_starts[j + 1]; k++)
+      col_indices[next[row_indices[k]]++] = j;
+
+  delete [] next;
+  delete [] row_indices;
+  delete [] col_starts;
+  return col_indices;
 }
 
 template<typename Scalar>
@@ -263,6 +419,11 @@ SparseMatrix<Scalar>* Hermes::Algebra::create_matrix()
 #endif
       break;
     }
+  case Hermes::SOLVER_KRYLOV:
+    {
+      return new CSRMatrix<Scalar>;
+      break;
+    }
   default:
     throw Hermes::Exceptions::Exception("Unknown matrix solver requested in create_matrix().");
   }
@@ -328,15 +489,247 @@ Vector<Scalar>* Hermes::Algebra::create_vector()
 #endif
       break;
     }
+  case Hermes::SOLVER_KRYLOV:
+    {
+      return new KrylovVector<Scalar>;
+      break;
+    }
   default:
     throw Hermes::Exceptions::Exception("Unknown matrix solver requested in create_vector().");
   }
   return NULL;
 }
 
+static void fwrite_dump(const void* ptr, size_t size, size_t nitems, FILE* file)
+{
+  if(nitems > 0 && fwrite(ptr, size, nitems, file) != nitems)
+    throw Hermes::Exceptions::Exception("Error writing the binary dump.");
+}
+
+static bool is_complex_dump(double* dummy) { return false; }
+static bool is_complex_dump(std::complex<double>* dummy) { return true; }
+
+#ifdef WITH_HDF5
+/// An HDF5 file in memory (the core driver without a backing store), copied to the FILE at the end.
+class HDF5MemoryDump
+{
+public:
+  HDF5MemoryDump(const char* var_name)
+  {
+    // The name only identifies the file in memory.
+    char name[64];
+    sprintf(name, "hermes_dump_%p.h5", (void*)this);
+    fapl = H5Pcreate(H5P_FILE_ACCESS);
+    H5Pset_fapl_core(fapl, 1 << 20, 0);
+    h5_file = H5Fcreate(name, H5F_ACC_TRUNC, H5P_DEFAULT, fapl);
+    if(h5_file < 0)
+    {
+      H5Pclose(fapl);
+      throw Hermes::Exceptions::Exception("The in-memory HDF5 file could not be created.");
+    }
+    group = (var_name == NULL || var_name[0] == '\0') ? H5Gopen2(h5_file, "/", H5P_DEFAULT) : H5Gcreate2(h5_file, var_name, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  }
+
+  ~HDF5MemoryDump()
+  {
+    if(group >= 0)
+      H5Gclose(group);
+    H5Fclose(h5_file);
+    H5Pclose(fapl);
+  }
+
+  /// A dataset of count x num_components values.
+  void write(const char* name, hid_t type, unsigned int count, int num_components, const void* data)
+  {
+    hsize_t dims[2] = { (hsize_t)count, (hsize_t)num_components };
+    hid_t space = H5Screate_simple(num_components == 1 ? 1 : 2, dims, NULL);
+    hid_t set = H5Dcreate2(group, name, type, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    herr_t status = (set < 0) ? -1 : H5Dwrite(set, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, data);
+    if(set >= 0)
+      H5Dclose(set);
+    H5Sclose(space);
+    if(status < 0)
+      throw Hermes::Exceptions::Exception("The HDF5 dataset %s could not be written.", name);
+  }
+
+  void write_attribute(const char* name, const char* value)
+  {
+    hid_t type = H5Tcopy(H5T_C_S1);
+    H5Tset_size(type, strlen(value) + 1);
+    hid_t space = H5Screate(H5S_SCALAR);
+    hid_t attribute = H5Acreate2(group, name, type, space, H5P_DEFAULT, H5P_DEFAULT);
+    if(attribute >= 0)
+    {
+      H5Awrite(attribute, type, value);
+      H5Aclose(attribute);
+    }
+    H5Sclose(space);
+    H5Tclose(type);
+  }
+
+  /// Copies the image of the file.
+  void save(FILE* file)
+  {
+    H5Fflush(h5_file, H5F_SCOPE_GLOBAL);
+    ssize_t image_size = H5Fget_file_image(h5_file, NULL, 0);
+    if(image_size <= 0)
+      throw Hermes::Exceptions::Exception("The image of the in-memory HDF5 file could not be obtained.");
+    char* image = new char[image_size];
+    H5Fget_file_image(h5_file, image, image_size);
+    try
+    {
+      fwrite_dump(image, 1, image_size, file);
+    }
+    catch(Hermes::Exceptions::Exception&)
+    {
+      delete [] image;
+      throw;
+    }
+    delete [] image;
+  }
+
+protected:
+  hid_t fapl;
+  hid_t h5_file;
+  hid_t group;
+};
+#endif
+
+template<typename Scalar>
+bool Hermes::Algebra::dump_compressed_binary(FILE* file, const char* var_name, EMatrixDumpFormat fmt, unsigned int size, int nnz,
+  const int* Ap, const int* Ai, const Scalar* Ax, bool by_rows)
+{
+  bool complex = is_complex_dump((Scalar*)NULL);
+  switch (fmt)
+  {
+  case DF_MATRIX_MARKET_BIN:
+    fprintf(file, "%%%%MatrixMarket matrix coordinate %s general\n", complex ? "complex" : "real");
+    fprintf(file, "%% Hermes binary: compressed %s, Ap int%d[%u], Ai int%d[%d], Ax %s%d[%d]\n", by_rows ? "rows" : "columns",
+      (int)(8 * sizeof(int)), size + 1, (int)(8 * sizeof(int)), nnz, complex ? "complex" : "float", (int)(8 * sizeof(Scalar)), nnz);
+    fprintf(file, "%u %u %d\n", size, size, nnz);
+    fwrite_dump(Ap, sizeof(int), size + 1, file);
+    fwrite_dump(Ai, sizeof(int), nnz, file);
+    fwrite_dump(Ax, sizeof(Scalar), nnz, file);
+    return true;
+
+  case DF_HDF5:
+    {
+#ifdef WITH_HDF5
+      HDF5MemoryDump dump(var_name);
+      dump.write_attribute("storage", by_rows ? "compressed rows" : "compressed columns");
+      dump.write("Ap", H5T_NATIVE_INT, size + 1, 1, Ap);
+      dump.write("Ai", H5T_NATIVE_INT, nnz, 1, Ai);
+      dump.write("Ax", H5T_NATIVE_DOUBLE, nnz, complex ? 2 : 1, Ax);
+      dump.save(file);
+      return true;
+#else
+      throw Hermes::Exceptions::Exception("hermes_common was not compiled with HDF5 support.");
+#endif
+    }
+
+  default:
+    return false;
+  }
+}
+
+template<typename Scalar>
+bool Hermes::Algebra::dump_vector_binary(FILE* file, const char* var_name, EMatrixDumpFormat fmt, unsigned int size, const Scalar* v)
+{
+  bool complex = is_complex_dump((Scalar*)NULL);
+  switch (fmt)
+  {
+  case DF_MATRIX_MARKET_BIN:
+    fprintf(file, "%%%%MatrixMarket matrix array %s general\n", complex ? "complex" : "real");
+    fprintf(file, "%% Hermes binary: v %s%d[%u]\n", complex ? "complex" : "float", (int)(8 * sizeof(Scalar)), size);
+    fprintf(file, "%u 1\n", size);
+    fwrite_dump(v, sizeof(Scalar), size, file);
+    return true;
+
+  case DF_HDF5:
+    {
+#ifdef WITH_HDF5
+      HDF5MemoryDump dump(var_name);
+      dump.write("v", H5T_NATIVE_DOUBLE, size, complex ? 2 : 1, v);
+      dump.save(file);
+      return true;
+#else
+      throw Hermes::Exceptions::Exception("hermes_common was not compiled with HDF5 support.");
+#endif
+    }
+
+  default:
+    return false;
+  }
+}
+
+template<typename Scalar>
+void Hermes::Algebra::sum_values_over_processes(Scalar* values, unsigned int count)
+{
+#ifdef WITH_MPI
+  int mpi_initialized;
+  MPI_Initialized(&mpi_initialized);
+  if(!mpi_initialized || count == 0)
+    return;
+  // Complex numbers are summed as pairs of doubles.
+  MPI_Allreduce(MPI_IN_PLACE, values, count * (sizeof(Scalar) / sizeof(double)), MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+#endif
+}
+
+/// Arrays smaller than this are zeroed by the calling thread.
+static const unsigned int first_touch_min_size = 1 << 16;
+
+template<typename Scalar>
+void Hermes::Algebra::zero_values(Scalar* values, unsigned int count)
+{
+  if(count < first_touch_min_size || !HermesCommonApi.get_integral_param_value(parallelFirstTouch))
+  {
+    memset(values, 0, count * sizeof(Scalar));
+    return;
+  }
+  // The chunks of pages every thread touches first, in a static schedule.
+  const int chunk = 4096;
+  int num_chunks = (count + chunk - 1) / chunk;
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < num_chunks; i++)
+  {
+    unsigned int start = i * chunk;
+    memset(values + start, 0, std::min((unsigned int)chunk, count - start) * sizeof(Scalar));
+  }
+}
+
+template<typename Scalar>
+void Hermes::Algebra::zero_values_by_rows(Scalar* values, const int* row_starts, unsigned int num_rows)
+{
+  unsigned int count = row_starts[num_rows];
+  if(count < first_touch_min_size || !HermesCommonApi.get_integral_param_value(parallelFirstTouch))
+  {
+    memset(values, 0, count * sizeof(Scalar));
+    return;
+  }
+  int n = num_rows;
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < n; i++)
+    memset(values + row_starts[i], 0, (row_starts[i + 1] - row_starts[i]) * sizeof(Scalar));
+}
+
 template class Hermes::Algebra::SparseMatrix<double>;
 template class Hermes::Algebra::SparseMatrix<std::complex<double> >;
 
+template HERMES_API bool Hermes::Algebra::dump_compressed_binary(FILE* file, const char* var_name, EMatrixDumpFormat fmt, unsigned int size, int nnz,
+  const int* Ap, const int* Ai, const double* Ax, bool by_rows);
+template HERMES_API bool Hermes::Algebra::dump_compressed_binary(FILE* file, const char* var_name, EMatrixDumpFormat fmt, unsigned int size, int nnz,
+  const int* Ap, const int* Ai, const std::complex<double>* Ax, bool by_rows);
+template HERMES_API bool Hermes::Algebra::dump_vector_binary(FILE* file, const char* var_name, EMatrixDumpFormat fmt, unsigned int size, const double* v);
+template HERMES_API bool Hermes::Algebra::dump_vector_binary(FILE* file, const char* var_name, EMatrixDumpFormat fmt, unsigned int size, const std::complex<double>* v);
+
+template HERMES_API void Hermes::Algebra::sum_values_over_processes(double* values, unsigned int count);
+template HERMES_API void Hermes::Algebra::sum_values_over_processes(std::complex<double>* values, unsigned int count);
+
+template HERMES_API void Hermes::Algebra::zero_values(double* values, unsigned int count);
+template HERMES_API void Hermes::Algebra::zero_values(std::complex<double>* values, unsigned int count);
+template HERMES_API void Hermes::Algebra::zero_values_by_rows(double* values, const int* row_starts, unsigned int num_rows);
+template HERMES_API void Hermes::Algebra::zero_values_by_rows(std::complex<double>* values, const int* row_starts, unsigned int num_rows);
+
 template HERMES_API Vector<double>* Hermes::Algebra::create_vector();
 template HERMES_API SparseMatrix<double>*  Hermes::Algebra::create_matrix();
 
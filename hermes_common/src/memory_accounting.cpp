@@ -0,0 +1,155 @@
+// This file is part of HermesCommon
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes2D is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+/*! \file memory_accounting.cpp
+    \brief Process-wide accounting of the memory of the large data structures.
+*/
+#include "memory_accounting.h"
+#include <cstring>
+#include <cstdio>
+
+namespace Hermes
+{
+  // Plain static data only, so that the categories can be registered from the static constructors of other files.
+  static const char* memory_category_names[MemoryAccounting::max_categories];
+  static size_t memory_current[MemoryAccounting::max_categories];
+  static size_t memory_peak[MemoryAccounting::max_categories];
+  static size_t memory_total_current;
+  static size_t memory_total_peak;
+  static int memory_num_categories;
+
+  int MemoryAccounting::add_category(const char* name)
+  {
+    int category = -1;
+#pragma omp critical (memory_accounting)
+    {
+      for(int i = 0; i < memory_num_categories && category == -1; i++)
+        if(!strcmp(memory_category_names[i], name))
+          category = i;
+      if(category == -1 && memory_num_categories < max_categories)
+      {
+        category = memory_num_categories++;
+        memory_category_names[category] = name;
+      }
+    }
+    return category;
+  }
+
+  void MemoryAccounting::allocated(int category, size_t bytes)
+  {
+    if(category < 0 || bytes == 0)
+      return;
+#pragma omp critical (memory_accounting)
+    {
+      memory_current[category] += bytes;
+      if(memory_current[category] > memory_peak[category])
+        memory_peak[category] = memory_current[category];
+      memory_total_current += bytes;
+      if(memory_total_current > memory_total_peak)
+        memory_total_peak = memory_total_current;
+    }
+  }
+
+  void MemoryAccounting::released(int category, size_t bytes)
+  {
+    if(category < 0 || bytes == 0)
+      return;
+#pragma omp critical (memory_accounting)
+    {
+      // A structure may be released under another category than the one it was allocated in (the pooled tables),
+      // the counters never go below zero.
+      if(bytes > memory_current[category])
+        bytes = memory_current[category];
+      memory_current[category] -= bytes;
+      memory_total_current -= bytes;
+    }
+  }
+
+  void MemoryAccounting::changed(int category, size_t old_bytes, size_t new_bytes)
+  {
+    if(new_bytes > old_bytes)
+      allocated(category, new_bytes - old_bytes);
+    else
+      released(category, old_bytes - new_bytes);
+  }
+
+  int MemoryAccounting::get_num_categories()
+  {
+    return memory_num_categories;
+  }
+
+  const char* MemoryAccounting::get_category_name(int category)
+  {
+    if(category < 0 || category >= memory_num_categories)
+      return NULL;
+    return memory_category_names[category];
+  }
+
+  size_t MemoryAccounting::get_current(int category)
+  {
+    if(category < 0 || category >= memory_num_categories)
+      return 0;
+    return memory_current[category];
+  }
+
+  size_t MemoryAccounting::get_peak(int category)
+  {
+    if(category < 0 || category >= memory_num_categories)
+      return 0;
+    return memory_peak[category];
+  }
+
+  size_t MemoryAccounting::get_total_current()
+  {
+    return memory_total_current;
+  }
+
+  size_t MemoryAccounting::get_total_peak()
+  {
+    return memory_total_peak;
+  }
+
+  void MemoryAccounting::reset_peaks()
+  {
+#pragma omp critical (memory_accounting)
+    {
+      for(int i = 0; i < memory_num_categories; i++)
+        memory_peak[i] = memory_current[i];
+      memory_total_peak = memory_total_current;
+    }
+  }
+
+  std::string MemoryAccounting::get_report()
+  {
+    std::string report;
+    char line[256];
+    sprintf(line, "%-32s %14s %14s\n", "memory [kB]", "current", "peak");
+    report += line;
+#pragma omp critical (memory_accounting)
+    {
+      for(int i = 0; i < memory_num_categories; i++)
+      {
+        sprintf(line, "%-32s %14.1f %14.1f\n", memory_category_names[i], memory_current[i] / 1024.0, memory_peak[i] / 1024.0);
+        report += line;
+      }
+      sprintf(line, "%-32s %14.1f %14.1f\n", "total", memory_total_current / 1024.0, memory_total_peak / 1024.0);
+      report += line;
+    }
+    return report;
+  }
+}
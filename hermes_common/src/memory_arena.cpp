@@ -0,0 +1,85 @@
+// This file is part of HermesCommon
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes2D is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+/*! \file memory_arena.cpp
+    \brief Bump allocator for short-lived temporaries.
+*/
+#include "memory_arena.h"
+#include "memory_accounting.h"
+
+namespace Hermes
+{
+  static int memory_arena_memory_category = MemoryAccounting::add_category("assembly arenas");
+
+  MemoryArena::MemoryArena(size_t chunk_size) : chunk_size(chunk_size), current_chunk(0), current_offset(0)
+  {
+  }
+
+  MemoryArena::~MemoryArena()
+  {
+    for(unsigned int i = 0; i < chunks.size(); i++)
+      delete [] chunks[i];
+    MemoryAccounting::released(memory_arena_memory_category, get_capacity());
+  }
+
+  void* MemoryArena::allocate(size_t size)
+  {
+    // Round up, so that the next allocation stays aligned.
+    size = ((size + HERMES_ARENA_ALIGNMENT - 1) / HERMES_ARENA_ALIGNMENT) * HERMES_ARENA_ALIGNMENT;
+
+    // Find a chunk with enough space, the following chunks are free after reset().
+    while(current_chunk < chunks.size() && current_offset + size > chunk_sizes[current_chunk] - HERMES_ARENA_ALIGNMENT)
+    {
+      current_chunk++;
+      current_offset = 0;
+    }
+
+    if(current_chunk == chunks.size())
+    {
+      size_t new_chunk_size = std::max(chunk_size, size) + HERMES_ARENA_ALIGNMENT;
+      chunks.push_back(new char[new_chunk_size]);
+      chunk_sizes.push_back(new_chunk_size);
+      MemoryAccounting::allocated(memory_arena_memory_category, new_chunk_size);
+      current_offset = 0;
+    }
+
+    // The start of the chunk itself is aligned up.
+    char* base = chunks[current_chunk];
+    size_t misalignment = ((size_t)base) % HERMES_ARENA_ALIGNMENT;
+    if(misalignment != 0)
+      base += HERMES_ARENA_ALIGNMENT - misalignment;
+
+    void* result = base + current_offset;
+    current_offset += size;
+    return result;
+  }
+
+  void MemoryArena::reset()
+  {
+    current_chunk = 0;
+    current_offset = 0;
+  }
+
+  size_t MemoryArena::get_capacity() const
+  {
+    size_t capacity = 0;
+    for(unsigned int i = 0; i < chunk_sizes.size(); i++)
+      capacity += chunk_sizes[i];
+    return capacity;
+  }
+}
@@ -16,6 +16,9 @@
 #include <map>
 #include <string>
 #include "common.h"
+#ifdef __APPLE__
+#include <sys/time.h>
+#endif
 
 namespace Hermes
 {
@@ -25,6 +28,59 @@ namespace Hermes
 
     std::map<std::string, bool> Loggable::logger_written;
 
+    int Loggable::log_level = HERMES_LOG_LEVEL;
+
+    /// The buffers of the messages logged in the parallel regions, one per thread (omp_get_thread_num()).
+    static const int max_log_threads = 64;
+    /// The messages kept per thread, above it they are written right away.
+    static const unsigned int max_buffered_messages = 10000;
+
+    struct BufferedMessage
+    {
+      char code;
+      std::string text;
+      void (*callback)(const char*);
+    };
+
+    static std::vector<BufferedMessage>* buffered_messages[max_log_threads];
+
+    /// Writes the buffered messages at the exit.
+    static class BufferedMessagesFlusher
+    {
+    public:
+      ~BufferedMessagesFlusher()
+      {
+        Loggable::flush_buffered_messages();
+        for(int i = 0; i < max_log_threads; i++)
+          delete buffered_messages[i];
+      }
+    } buffered_messages_flusher;
+
+    void Loggable::set_log_level(int level)
+    {
+      log_level = level;
+    }
+
+    int Loggable::get_log_level()
+    {
+      return log_level;
+    }
+
+    void Loggable::flush_buffered_messages()
+    {
+      logger_monitor.enter();
+      for(int i = 0; i < max_log_threads; i++)
+      {
+        if(buffered_messages[i] == NULL)
+          continue;
+        std::vector<BufferedMessage>& messages = *buffered_messages[i];
+        for(unsigned int j = 0; j < messages.size(); j++)
+          write_message(messages[j].code, messages[j].text.c_str(), messages[j].callback);
+        messages.clear();
+      }
+      logger_monitor.leave();
+    }
+
     Loggable::Loggable(bool verbose_output, callbackFn verbose_callback) : verbose_output(verbose_output), verbose_callback(verbose_callback)
     {
     }
@@ -41,6 +97,9 @@ namespace Hermes
 
     void Loggable::Static::info(const char* msg, ...)
     {
+      if(3 > HERMES_LOG_LEVEL || 3 > log_level)
+        return;
+
       char text[BUF_SZ];
       char* text_contents = text + 1;
 
@@ -95,6 +154,9 @@ namespace Hermes
 
     void Loggable::Static::warn(const char* msg, ...)
     {
+      if(2 > HERMES_LOG_LEVEL || 2 > log_level)
+        return;
+
       char text[BUF_SZ];
       char* text_contents = text + 1;
 
@@ -149,6 +211,9 @@ namespace Hermes
 
     void Loggable::Static::error(const char* msg, ...)
     {
+      if(1 > HERMES_LOG_LEVEL || 1 > log_level)
+        return;
+
       char text[BUF_SZ];
       char* text_contents = text + 1;
 
@@ -203,7 +268,7 @@ namespace Hermes
 
     void Loggable::error(const char* msg, ...) const
     {
-      if(!this->verbose_output)
+      if(!this->is_logged(1))
         return;
 
       char text[BUF_SZ];
@@ -223,7 +288,7 @@ namespace Hermes
 
     void Loggable::error_if(bool cond, const char* msg, ...) const
     {
-      if(!this->verbose_output)
+      if(!cond || !this->is_logged(1))
         return;
 
       if(cond)
@@ -246,7 +311,7 @@ namespace Hermes
 
     void Loggable::warn(const char* msg, ...) const
     {
-      if(!this->verbose_output)
+      if(!this->is_logged(2))
         return;
 
       char text[BUF_SZ];
@@ -266,7 +331,7 @@ namespace Hermes
 
     void Loggable::warn_if(bool cond, const char* msg, ...) const
     {
-      if(!this->verbose_output)
+      if(!cond || !this->is_logged(2))
         return;
 
       if(cond)
@@ -288,7 +353,7 @@ namespace Hermes
     }
     void Loggable::info(const char* msg, ...) const
     {
-      if(!this->verbose_output)
+      if(!this->is_logged(3))
         return;
 
       char text[BUF_SZ];
@@ -307,7 +372,7 @@ namespace Hermes
     }
     void Loggable::info_if(bool cond, const char* msg, ...) const
     {
-      if(!this->verbose_output)
+      if(!cond || !this->is_logged(3))
         return;
 
       if(cond)
@@ -328,7 +393,7 @@ namespace Hermes
       }
     }
 
-    bool Loggable::write_console(const char code, const char* text) const
+    bool Loggable::write_console(const char code, const char* text)
     {
       //Windows platform
     #ifdef WIN32
@@ -377,6 +442,7 @@ namespace Hermes
       bool console_bold = false;
       switch(code)
       {
+      case HERMES_EC_ERROR: console_attrs |= FOREGROUND_RED; break;
       case HERMES_EC_WARNING: console_attrs |= FOREGROUND_RED | FOREGROUND_GREEN; break;
       case HERMES_EC_INFO: console_bold = true; break;
       default: throw Hermes::Exceptions::Exception("Unknown error code: '%c'", code);
@@ -395,7 +461,7 @@ namespace Hermes
     #endif
     }
 
-    Loggable::HermesLogEventInfo* Loggable::hermes_build_log_info(char event) const
+    Loggable::HermesLogEventInfo* Loggable::hermes_build_log_info(char event)
     {
         return new Loggable::HermesLogEventInfo(event, HERMES_LOG_FILE, __CURRENT_FUNCTION, __FILE__, __LINE__);
     }
@@ -421,14 +487,43 @@ namespace Hermes
 
     void Loggable::hermes_log_message(const char code, const char* msg) const
     {
+      int thread = omp_get_thread_num();
+      if(omp_get_num_threads() > 1 && thread < max_log_threads)
+      {
+        // Only this thread uses its buffer in the parallel region.
+        if(buffered_messages[thread] == NULL)
+          buffered_messages[thread] = new std::vector<BufferedMessage>();
+        if(buffered_messages[thread]->size() < max_buffered_messages)
+        {
+          BufferedMessage message;
+          message.code = code;
+          message.text = msg;
+          message.callback = this->verbose_callback;
+          buffered_messages[thread]->push_back(message);
+          return;
+        }
+        logger_monitor.enter();
+        write_message(code, msg, this->verbose_callback);
+        logger_monitor.leave();
+        return;
+      }
+
+      // The messages of the preceding parallel regions first.
+      flush_buffered_messages();
       logger_monitor.enter();
+      write_message(code, msg, this->verbose_callback);
+      logger_monitor.leave();
+    }
+
+    void Loggable::write_message(const char code, const char* msg, callbackFn callback)
+    {
 
       //print the message
       if(!write_console(code, msg))
         printf("%s", msg);  //safe fallback
       printf("\n");  //write a new line
 
-      HermesLogEventInfo* info = this->hermes_build_log_info(code);
+      HermesLogEventInfo* info = hermes_build_log_info(code);
 
       //print to file
       if(info->log_file != NULL)
@@ -470,14 +565,12 @@ namespace Hermes
           fprintf(file, "%s\t%s %s\n", time_buf, msg, location.str().c_str());
           fclose(file);
 
-          if(this->verbose_callback != NULL)
-            this->verbose_callback(msg);
+          if(callback != NULL)
+            callback(msg);
         }
       }
 
       delete info;
-
-      logger_monitor.leave();
     }
 
     void Loggable::set_verbose_output(bool to_set)
@@ -624,6 +717,385 @@ namespace Hermes
       }
     }
 
+    Profile::Profile(unsigned int num_phases, const char* const* phase_names, const char* trace_category) : num_phases(num_phases), phase_names(phase_names), trace_category(trace_category), enabled(false)
+    {
+      for(int i = 0; i < max_threads; i++)
+        records[i] = NULL;
+    }
+
+    Profile::~Profile()
+    {
+      for(int i = 0; i < max_threads; i++)
+      {
+        if(records[i] == NULL)
+          continue;
+        delete [] records[i]->times;
+        delete [] records[i]->counts;
+        delete records[i];
+      }
+    }
+
+    void Profile::set_enabled(bool enabled)
+    {
+      this->enabled = enabled;
+    }
+
+    bool Profile::is_enabled() const
+    {
+      return this->enabled;
+    }
+
+    void Profile::reset()
+    {
+      for(int i = 0; i < max_threads; i++)
+      {
+        if(records[i] == NULL)
+          continue;
+        memset(records[i]->times, 0, num_phases * sizeof(double));
+        memset(records[i]->counts, 0, num_phases * sizeof(unsigned long));
+      }
+    }
+
+    unsigned int Profile::get_num_phases() const
+    {
+      return num_phases;
+    }
+
+    const char* Profile::get_phase_name(unsigned int phase) const
+    {
+      if(phase >= num_phases)
+        throw Exceptions::ValueException("phase", phase, num_phases);
+      return phase_names[phase];
+    }
+
+    double Profile::get_time(unsigned int phase) const
+    {
+      double time = 0.0;
+      for(int i = 0; i < max_threads; i++)
+        time += get_time(phase, i);
+      return time;
+    }
+
+    unsigned long Profile::get_count(unsigned int phase) const
+    {
+      unsigned long count = 0;
+      for(int i = 0; i < max_threads; i++)
+        count += get_count(phase, i);
+      return count;
+    }
+
+    int Profile::get_num_threads() const
+    {
+      for(int i = max_threads; i > 0; i--)
+        if(records[i - 1] != NULL)
+          return i;
+      return 0;
+    }
+
+    double Profile::get_time(unsigned int phase, int thread) const
+    {
+      if(phase >= num_phases)
+        throw Exceptions::ValueException("phase", phase, num_phases);
+      if(thread < 0 || thread >= max_threads || records[thread] == NULL)
+        return 0.0;
+      return records[thread]->times[phase];
+    }
+
+    unsigned long Profile::get_count(unsigned int phase, int thread) const
+    {
+      if(phase >= num_phases)
+        throw Exceptions::ValueException("phase", phase, num_phases);
+      if(thread < 0 || thread >= max_threads || records[thread] == NULL)
+        return 0;
+      return records[thread]->counts[phase];
+    }
+
+    void Profile::add(const Profile& other)
+    {
+      if(other.num_phases != num_phases)
+        throw Exceptions::ValueException("num_phases", other.num_phases, num_phases);
+      for(int i = 0; i < max_threads; i++)
+      {
+        if(other.records[i] == NULL)
+          continue;
+        Record* record = get_record(i);
+        for(unsigned int phase = 0; phase < num_phases; phase++)
+        {
+          record->times[phase] += other.records[i]->times[phase];
+          record->counts[phase] += other.records[i]->counts[phase];
+        }
+      }
+    }
+
+    std::string Profile::to_string() const
+    {
+      std::stringstream str;
+      int num_threads = get_num_threads();
+      for(unsigned int phase = 0; phase < num_phases; phase++)
+      {
+        str << phase_names[phase] << ": " << get_time(phase) << " s, " << get_count(phase) << " sections";
+        if(num_threads > 1)
+        {
+          str << " (threads:";
+          for(int i = 0; i < num_threads; i++)
+            str << " " << get_time(phase, i);
+          str << ")";
+        }
+        str << std::endl;
+      }
+      return str.str();
+    }
+
+    void Profile::add_time(unsigned int phase, double seconds, unsigned long count)
+    {
+      int thread = omp_get_thread_num();
+      if(thread < max_threads - 1)
+      {
+        Record* record = get_record(thread);
+        record->times[phase] += seconds;
+        record->counts[phase] += count;
+      }
+      else
+      {
+#pragma omp critical (profile_shared_record)
+        {
+          Record* record = get_record(max_threads - 1);
+          record->times[phase] += seconds;
+          record->counts[phase] += count;
+        }
+      }
+    }
+
+    Profile::Record* Profile::get_record(int thread)
+    {
+      if(records[thread] == NULL)
+      {
+        Record* record = new Record;
+        record->times = new double[num_phases];
+        record->counts = new unsigned long[num_phases];
+        memset(record->times, 0, num_phases * sizeof(double));
+        memset(record->counts, 0, num_phases * sizeof(unsigned long));
+        records[thread] = record;
+      }
+      return records[thread];
+    }
+
+    double Profile::now()
+    {
+  #ifdef WIN32
+      static LARGE_INTEGER frequency;
+      static bool has_frequency = (QueryPerformanceFrequency(&frequency) != 0);
+      if(has_frequency)
+      {
+        LARGE_INTEGER ticks;
+        QueryPerformanceCounter(&ticks);
+        return ticks.QuadPart / (double)frequency.QuadPart;
+      }
+      return clock() / (double)CLOCKS_PER_SEC;
+  #elif defined(__APPLE__)
+      timeval tv;
+      gettimeofday(&tv, NULL);
+      return tv.tv_sec + tv.tv_usec * 1e-6;
+  #else
+      timespec tm;
+      clock_gettime(CLOCK_MONOTONIC, &tm);
+      return tm.tv_sec + tm.tv_nsec * 1e-9;
+  #endif
+    }
+
+    Profile::Section::Section(Profile* profile, unsigned int phase) : profile(profile), phase(phase), start(0.0), timed(false), traced(false)
+    {
+      if(profile == NULL)
+        return;
+      timed = profile->enabled;
+      traced = Trace::is_enabled();
+      if(timed || traced)
+        start = Profile::now();
+      else
+        this->profile = NULL;
+    }
+
+    Profile::Section::~Section()
+    {
+      stop();
+    }
+
+    void Profile::Section::stop()
+    {
+      if(profile == NULL)
+        return;
+      double end = Profile::now();
+      if(timed)
+        profile->add_time(phase, end - start);
+      if(traced)
+        Trace::add_complete(profile->phase_names[phase], profile->trace_category, start, end);
+      profile = NULL;
+    }
+
+    /// One recorded event, an instant one if duration < 0.
+    struct TraceEvent
+    {
+      const char* name;
+      const char* category;
+      double start;
+      double duration;
+    };
+
+    /// The buffers of the threads, threads with a higher number share the last one (and synchronize on it).
+    static const int trace_max_threads = 64;
+    static std::vector<TraceEvent>* trace_events[trace_max_threads];
+    static unsigned int trace_max_events = 1000000;
+    static unsigned int trace_dropped_events = 0;
+    static double trace_origin = -1.0;
+
+    bool Trace::enabled = false;
+
+    static void trace_add(const char* name, const char* category, double start, double duration)
+    {
+      TraceEvent event;
+      event.name = name;
+      event.category = category;
+      event.start = start;
+      event.duration = duration;
+
+      int thread = omp_get_thread_num();
+      if(thread < trace_max_threads - 1)
+      {
+        if(trace_events[thread] == NULL)
+          trace_events[thread] = new std::vector<TraceEvent>();
+        if(trace_events[thread]->size() < trace_max_events)
+          trace_events[thread]->push_back(event);
+        else
+        {
+#pragma omp atomic
+          trace_dropped_events++;
+        }
+      }
+      else
+      {
+#pragma omp critical (trace_shared_buffer)
+        {
+          if(trace_events[trace_max_threads - 1] == NULL)
+            trace_events[trace_max_threads - 1] = new std::vector<TraceEvent>();
+          if(trace_events[trace_max_threads - 1]->size() < trace_max_events)
+            trace_events[trace_max_threads - 1]->push_back(event);
+          else
+            trace_dropped_events++;
+        }
+      }
+    }
+
+    void Trace::set_enabled(bool enabled)
+    {
+      if(enabled && trace_origin < 0.0)
+        trace_origin = Profile::now();
+      Trace::enabled = enabled;
+    }
+
+    void Trace::set_max_events(unsigned int max_events)
+    {
+      trace_max_events = max_events;
+    }
+
+    unsigned int Trace::get_max_events()
+    {
+      return trace_max_events;
+    }
+
+    void Trace::add_complete(const char* name, const char* category, double start, double end)
+    {
+      if(enabled)
+        trace_add(name, category, start, end - start);
+    }
+
+    void Trace::add_instant(const char* name, const char* category)
+    {
+      if(enabled)
+        trace_add(name, category, Profile::now(), -1.0);
+    }
+
+    unsigned int Trace::get_num_events()
+    {
+      unsigned int num_events = 0;
+      for(int i = 0; i < trace_max_threads; i++)
+        if(trace_events[i] != NULL)
+          num_events += trace_events[i]->size();
+      return num_events;
+    }
+
+    unsigned int Trace::get_num_dropped_events()
+    {
+      return trace_dropped_events;
+    }
+
+    void Trace::clear()
+    {
+      for(int i = 0; i < trace_max_threads; i++)
+      {
+        delete trace_events[i];
+        trace_events[i] = NULL;
+      }
+      trace_dropped_events = 0;
+    }
+
+    /// The names are string literals of the code, only the characters JSON does not allow as they are are replaced.
+    static void trace_write_string(FILE* file, const char* str)
+    {
+      fputc('"', file);
+      for(; *str; str++)
+      {
+        if(*str == '"' || *str == '\\')
+          fputc('\\', file);
+        if((unsigned char)*str >= 0x20)
+          fputc(*str, file);
+      }
+      fputc('"', file);
+    }
+
+    bool Trace::write_chrome_trace(const char* file_name)
+    {
+      FILE* file = fopen(file_name, "w");
+      if(file == NULL)
+        return false;
+
+      double origin = trace_origin < 0.0 ? 0.0 : trace_origin;
+      bool first = true;
+      fprintf(file, "{\"traceEvents\":[\n");
+      for(int thread = 0; thread < trace_max_threads; thread++)
+      {
+        if(trace_events[thread] == NULL)
+          continue;
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}", first ? "" : ",\n", thread, thread);
+        first = false;
+        for(unsigned int i = 0; i < trace_events[thread]->size(); i++)
+        {
+          const TraceEvent& event = (*trace_events[thread])[i];
+          fprintf(file, ",\n{\"name\":");
+          trace_write_string(file, event.name);
+          fprintf(file, ",\"cat\":");
+          trace_write_string(file, event.category);
+          if(event.duration < 0.0)
+            fprintf(file, ",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}", (event.start - origin) * 1e6, thread);
+          else
+            fprintf(file, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}", (event.start - origin) * 1e6, event.duration * 1e6, thread);
+        }
+      }
+      fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+      return fclose(file) == 0;
+    }
+
+    Trace::Scope::Scope(const char* name, const char* category) : name(name), category(category), start(-1.0)
+    {
+      if(Trace::is_enabled())
+        start = Profile::now();
+    }
+
+    Trace::Scope::~Scope()
+    {
+      if(start >= 0.0)
+        Trace::add_complete(name, category, start, Profile::now());
+    }
+
     IntegrableWithGlobalOrder::IntegrableWithGlobalOrder() : global_integration_order_set(false), global_integration_order(0)
     {}
 
@@ -653,22 +1125,43 @@ namespace Hermes
 
     void OutputAttachable::on_initialization()
     {
-
+      for(unsigned int i = 0; i < output_callbacks.size(); i++)
+        output_callbacks[i]->on_initialization(this);
     }
 
     void OutputAttachable::on_step_begin()
     {
-
+      for(unsigned int i = 0; i < output_callbacks.size(); i++)
+        output_callbacks[i]->on_step_begin(this);
     }
 
     void OutputAttachable::on_step_end()
     {
-
+      for(unsigned int i = 0; i < output_callbacks.size(); i++)
+        output_callbacks[i]->on_step_end(this);
     }
 
     void OutputAttachable::on_finish()
     {
+      for(unsigned int i = 0; i < output_callbacks.size(); i++)
+        output_callbacks[i]->on_finish(this);
+    }
+
+    void OutputAttachable::attach_output(OutputCallback* callback)
+    {
+      if(callback == NULL)
+        throw Exceptions::NullException(1);
+      output_callbacks.push_back(callback);
+    }
 
+    void OutputAttachable::detach_output(OutputCallback* callback)
+    {
+      for(unsigned int i = 0; i < output_callbacks.size(); i++)
+        if(output_callbacks[i] == callback)
+        {
+          output_callbacks.erase(output_callbacks.begin() + i);
+          return;
+        }
     }
   }
 }
@@ -149,6 +149,8 @@ namespace Hermes
 
       // solve it
       aztec.Iterate(this->max_iters, this->tolerance);
+      this->statistics.num_iterations += aztec.NumIters();
+      this->statistics.residual = aztec.TrueResidual();
 
       this->tick();
       this->time = this->accumulated();
@@ -184,6 +186,8 @@ namespace Hermes
 
       // solve it
       aztec.Iterate(this->max_iters, this->tolerance);
+      this->statistics.num_iterations += aztec.NumIters();
+      this->statistics.residual = aztec.TrueResidual();
 
       kp.ExtractSolution(xr, xi);
 
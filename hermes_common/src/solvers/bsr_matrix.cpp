@@ -0,0 +1,427 @@
+// This file is part of HermesCommon
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+/*! \file bsr_matrix.cpp
+\brief Block sparse row (BSR) matrix for systems with interleaved unknowns.
+*/
+#include "bsr_matrix.h"
+#include "common.h"
+
+namespace Hermes
+{
+  namespace Algebra
+  {
+    /// Product of the block row [begin, end) with x, the block size being known at compile time.
+    template<typename Scalar, int bs>
+    static inline void multiply_block_row(const Scalar* Ax, const int* Ai, int begin, int end, const Scalar* x, Scalar* y)
+    {
+      Scalar sum[bs];
+      for (int r = 0; r < bs; r++)
+        sum[r] = 0.0;
+      for (int k = begin; k < end; k++)
+      {
+        const Scalar* block = Ax + k * bs * bs;
+        const Scalar* x_block = x + Ai[k] * bs;
+        for (int r = 0; r < bs; r++)
+          for (int c = 0; c < bs; c++)
+            sum[r] += block[r * bs + c] * x_block[c];
+      }
+      for (int r = 0; r < bs; r++)
+        y[r] = sum[r];
+    }
+
+    template<typename Scalar>
+    BSRMatrix<Scalar>::BSRMatrix(unsigned int block_size) : SparseMatrix<Scalar>(), block_size(block_size), num_block_rows(0),
+      Ax(NULL), Ai(NULL), Ap(NULL), num_blocks(0)
+    {
+      if(block_size < 1)
+        throw Hermes::Exceptions::ValueException("block_size", block_size, 1);
+    }
+
+    template<typename Scalar>
+    BSRMatrix<Scalar>::~BSRMatrix()
+    {
+      free();
+    }
+
+    template<typename Scalar>
+    void BSRMatrix<Scalar>::prealloc(unsigned int n)
+    {
+      if(n % block_size)
+        throw Hermes::Exceptions::Exception("The size %d of BSRMatrix is not a multiple of the block size %d.", n, block_size);
+      num_block_rows = n / block_size;
+      SparseMatrix<Scalar>::prealloc(num_block_rows);
+      this->size = n;
+    }
+
+    template<typename Scalar>
+    void BSRMatrix<Scalar>::prealloc_indices()
+    {
+      // The preallocation works with the blocks.
+      this->size = num_block_rows;
+      SparseMatrix<Scalar>::prealloc_indices();
+      this->size = num_block_rows * block_size;
+    }
+
+    template<typename Scalar>
+    void BSRMatrix<Scalar>::pre_add_ij(unsigned int row, unsigned int col)
+    {
+      // The preallocation compresses the indices by their second argument.
+      SparseMatrix<Scalar>::pre_add_ij(col / block_size, row / block_size);
+    }
+
+    template<typename Scalar>
+    void BSRMatrix<Scalar>::alloc()
+    {
+      delete [] Ap;
+      delete [] Ai;
+      delete [] Ax;
+      Ap = new int[num_block_rows + 1];
+      this->size = num_block_rows;
+      Ai = this->compress_indices(Ap);
+      this->size = num_block_rows * block_size;
+
+      num_blocks = Ap[num_block_rows];
+
+      Ax = new Scalar[num_blocks * block_size * block_size];
+      zero();
+    }
+
+    template<typename Scalar>
+    void BSRMatrix<Scalar>::free()
+    {
+      num_blocks = 0;
+      delete [] Ap;
+      Ap = NULL;
+      delete [] Ai;
+      Ai = NULL;
+      delete [] Ax;
+      Ax = NULL;
+    }
+
+    template<typename Scalar>
+    int BSRMatrix<Scalar>::find_block(unsigned int block_row, unsigned int block_col) const
+    {
+      int lo = Ap[block_row], hi = Ap[block_row + 1] - 1;
+      while (lo <= hi)
+      {
+        int mid = (lo + hi) >> 1;
+        if((int)block_col < Ai[mid]) hi = mid - 1;
+        else if((int)block_col > Ai[mid]) lo = mid + 1;
+        else return mid;
+      }
+      return -1;
+    }
+
+    template<typename Scalar>
+    Scalar BSRMatrix<Scalar>::get(unsigned int m, unsigned int n)
+    {
+      int pos = find_block(m / block_size, n / block_size);
+      if(pos < 0)
+        return 0.0;
+      else
+        return Ax[(pos * block_size + m % block_size) * block_size + n % block_size];
+    }
+
+    template<typename Scalar>
+    void BSRMatrix<Scalar>::zero()
+    {
+      zero_values<Scalar>(Ax, num_blocks * block_size * block_size);
+    }
+
+    template<typename Scalar>
+    void BSRMatrix<Scalar>::add_to_position(unsigned int pos, Scalar v)
+    {
+      Hermes::atomic_add(Ax[pos], v);
+    }
+
+    template<typename Scalar>
+    void BSRMatrix<Scalar>::add(unsigned int m, unsigned int n, Scalar v)
+    {
+      if(v != 0.0)   // ignore zero values.
+      {
+        int pos = find_block(m / block_size, n / block_size);
+        // Make sure we are adding to an existing non-zero entry.
+        if(pos < 0)
+          throw Hermes::Exceptions::Exception("Sparse matrix entry not found: [%i, %i]", m, n);
+        add_to_position((pos * block_size + m % block_size) * block_size + n % block_size, v);
+      }
+    }
+
+    template<typename Scalar>
+    void BSRMatrix<Scalar>::add_to_diagonal(Scalar v)
+    {
+      for (unsigned int i = 0; i < this->size; i++)
+        add(i, i, v);
+    }
+
+    template<typename Scalar>
+    void BSRMatrix<Scalar>::add(unsigned int m, unsigned int n, Scalar **mat, int *rows, int *cols)
+    {
+      for (unsigned int i = 0; i < m; i++)       // rows
+        for (unsigned int j = 0; j < n; j++)     // cols
+          if(rows[i] >= 0 && cols[j] >= 0) // not Dir. dofs.
+            add(rows[i], cols[j], mat[i][j]);
+    }
+
+    template<typename Scalar>
+    bool BSRMatrix<Scalar>::dump(FILE *file, const char *var_name, EMatrixDumpFormat fmt, char* number_format)
+    {
+      unsigned int bs = block_size;
+      switch (fmt)
+      {
+      case DF_MATLAB_SPARSE:
+        fprintf(file, "%% Size: %dx%d\n%% Nonzeros: %d\ntemp = zeros(%d, 3);\ntemp =[\n",
+          this->size, this->size, get_nnz(), get_nnz());
+        for (unsigned int block_row = 0; block_row < num_block_rows; block_row++)
+          for (int k = Ap[block_row]; k < Ap[block_row + 1]; k++)
+            for (unsigned int r = 0; r < bs; r++)
+              for (unsigned int c = 0; c < bs; c++)
+              {
+                fprintf(file, "%d %d ", block_row * bs + r + 1, Ai[k] * bs + c + 1);
+                Hermes::Helpers::fprint_num(file, Ax[(k * bs + r) * bs + c], number_format);
+                fprintf(file, "\n");
+              }
+        fprintf(file, "];\n%s = spconvert(temp);\n", var_name);
+        return true;
+
+      case DF_HERMES_BIN:
+        {
+          this->hermes_fwrite("HERMESR\001", 1, 8, file);
+          int ssize = sizeof(Scalar);
+          this->hermes_fwrite(&ssize, sizeof(int), 1, file);
+          this->hermes_fwrite(&this->size, sizeof(int), 1, file);
+          this->hermes_fwrite(&block_size, sizeof(int), 1, file);
+          this->hermes_fwrite(&num_blocks, sizeof(int), 1, file);
+          this->hermes_fwrite(Ap, sizeof(int), num_block_rows + 1, file);
+          this->hermes_fwrite(Ai, sizeof(int), num_blocks, file);
+          this->hermes_fwrite(Ax, sizeof(Scalar), num_blocks * bs * bs, file);
+          return true;
+        }
+
+      default:
+        return false;
+      }
+    }
+
+    template<typename Scalar>
+    unsigned int BSRMatrix<Scalar>::get_matrix_size() const
+    {
+      return this->size;
+    }
+
+    template<typename Scalar>
+    unsigned int BSRMatrix<Scalar>::get_nnz() const
+    {
+      return num_blocks * block_size * block_size;
+    }
+
+    template<typename Scalar>
+    double BSRMatrix<Scalar>::get_fill_in() const
+    {
+      return get_nnz() / (double) (this->size * this->size);
+    }
+
+    template<typename Scalar>
+    void BSRMatrix<Scalar>::multiply_with_vector(Scalar* vector_in, Scalar* vector_out)
+    {
+      int n = num_block_rows;
+      int bs = block_size;
+#pragma omp parallel for schedule(static)
+      for (int block_row = 0; block_row < n; block_row++)
+      {
+        Scalar* out = vector_out + block_row * bs;
+        switch(bs)
+        {
+        case 1:
+          multiply_block_row<Scalar, 1>(Ax, Ai, Ap[block_row], Ap[block_row + 1], vector_in, out);
+          break;
+        case 2:
+          multiply_block_row<Scalar, 2>(Ax, Ai, Ap[block_row], Ap[block_row + 1], vector_in, out);
+          break;
+        case 3:
+          multiply_block_row<Scalar, 3>(Ax, Ai, Ap[block_row], Ap[block_row + 1], vector_in, out);
+          break;
+        default:
+          for (int r = 0; r < bs; r++)
+          {
+            Scalar sum = 0.0;
+            for (int k = Ap[block_row]; k < Ap[block_row + 1]; k++)
+            {
+              Scalar* block_row_values = Ax + (k * bs + r) * bs;
+              Scalar* x_block = vector_in + Ai[k] * bs;
+              for (int c = 0; c < bs; c++)
+                sum += block_row_values[c] * x_block[c];
+            }
+            out[r] = sum;
+          }
+        }
+      }
+    }
+
+    template<typename Scalar>
+    void BSRMatrix<Scalar>::multiply_with_Scalar(Scalar value)
+    {
+      unsigned int n = get_nnz();
+      for (unsigned int i = 0; i < n; i++) Ax[i] *= value;
+    }
+
+    template<typename Scalar>
+    void BSRMatrix<Scalar>::sum_over_processes()
+    {
+      sum_values_over_processes<Scalar>(Ax, get_nnz());
+    }
+
+    template<typename Scalar>
+    BSRMatrix<Scalar>* BSRMatrix<Scalar>::duplicate()
+    {
+      BSRMatrix<Scalar>* new_matrix = new BSRMatrix<Scalar>(block_size);
+      new_matrix->size = this->size;
+      new_matrix->num_block_rows = num_block_rows;
+      new_matrix->num_blocks = num_blocks;
+      new_matrix->Ap = new int[num_block_rows + 1];
+      new_matrix->Ai = new int[num_blocks];
+      new_matrix->Ax = new Scalar[get_nnz()];
+      memcpy(new_matrix->Ap, Ap, (num_block_rows + 1) * sizeof(int));
+      memcpy(new_matrix->Ai, Ai, num_blocks * sizeof(int));
+      memcpy(new_matrix->Ax, Ax, get_nnz() * sizeof(Scalar));
+      return new_matrix;
+    }
+
+    template<typename Scalar>
+    void BSRMatrix<Scalar>::to_csr(CSRMatrix<Scalar>* target)
+    {
+      int bs = block_size;
+      int nnz = get_nnz();
+      int* ap = new int[this->size + 1];
+      int* ai = new int[nnz];
+      Scalar* ax = new Scalar[nnz];
+
+      // Every row of a block row has the entries of all its blocks, the columns stay sorted.
+      int pos = 0;
+      for (unsigned int block_row = 0; block_row < num_block_rows; block_row++)
+        for (int r = 0; r < bs; r++)
+        {
+          ap[block_row * bs + r] = pos;
+          for (int k = Ap[block_row]; k < Ap[block_row + 1]; k++)
+            for (int c = 0; c < bs; c++, pos++)
+            {
+              ai[pos] = Ai[k] * bs + c;
+              ax[pos] = Ax[(k * bs + r) * bs + c];
+            }
+        }
+      ap[this->size] = pos;
+
+      target->create(this->size, nnz, ap, ai, ax);
+
+      delete [] ap;
+      delete [] ai;
+      delete [] ax;
+    }
+
+#ifdef WITH_UMFPACK
+    template<typename Scalar>
+    void BSRMatrix<Scalar>::to_csc(CSCMatrix<Scalar>* target)
+    {
+      int bs = block_size;
+      int n = num_block_rows;
+      int nnz = get_nnz();
+
+      // Order the blocks by block columns, going through the block rows in order keeps them sorted.
+      int* col_starts = new int[n + 1];
+      int* col_blocks = new int[num_blocks];
+      memset(col_starts, 0, (n + 1) * sizeof(int));
+      for (unsigned int k = 0; k < num_blocks; k++)
+        col_starts[Ai[k] + 1]++;
+      for (int i = 0; i < n; i++)
+        col_starts[i + 1] += col_starts[i];
+      int* fill = new int[n];
+      memcpy(fill, col_starts, n * sizeof(int));
+      int* block_rows = new int[num_blocks];
+      for (int block_row = 0; block_row < n; block_row++)
+        for (int k = Ap[block_row]; k < Ap[block_row + 1]; k++)
+        {
+          int col_pos = fill[Ai[k]]++;
+          col_blocks[col_pos] = k;
+          block_rows[col_pos] = block_row;
+        }
+
+      int* ap = new int[this->size + 1];
+      int* ai = new int[nnz];
+      Scalar* ax = new Scalar[nnz];
+      int pos = 0;
+      for (int block_col = 0; block_col < n; block_col++)
+        for (int c = 0; c < bs; c++)
+        {
+          ap[block_col * bs + c] = pos;
+          for (int l = col_starts[block_col]; l < col_starts[block_col + 1]; l++)
+            for (int r = 0; r < bs; r++, pos++)
+            {
+              ai[pos] = block_rows[l] * bs + r;
+              ax[pos] = Ax[(col_blocks[l] * bs + r) * bs + c];
+            }
+        }
+      ap[this->size] = pos;
+
+      target->free();
+      target->create(this->size, nnz, ap, ai, ax);
+
+      delete [] fill;
+      delete [] col_starts;
+      delete [] col_blocks;
+      delete [] block_rows;
+      delete [] ap;
+      delete [] ai;
+      delete [] ax;
+    }
+#endif
+
+    template<typename Scalar>
+    unsigned int BSRMatrix<Scalar>::get_block_size() const
+    {
+      return block_size;
+    }
+
+    template<typename Scalar>
+    unsigned int BSRMatrix<Scalar>::get_num_blocks() const
+    {
+      return num_blocks;
+    }
+
+    template<typename Scalar>
+    int *BSRMatrix<Scalar>::get_Ap()
+    {
+      return this->Ap;
+    }
+
+    template<typename Scalar>
+    int *BSRMatrix<Scalar>::get_Ai()
+    {
+      return this->Ai;
+    }
+
+    template<typename Scalar>
+    Scalar *BSRMatrix<Scalar>::get_Ax()
+    {
+      return this->Ax;
+    }
+
+    template class HERMES_API BSRMatrix<double>;
+    template class HERMES_API BSRMatrix<std::complex<double> >;
+  }
+}
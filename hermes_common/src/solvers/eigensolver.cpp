@@ -0,0 +1,488 @@
+// This file is part of HermesCommon
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes2D is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+/*! \file eigensolver.cpp
+    \brief Shift-invert Lanczos solver of generalized eigenproblems.
+*/
+#include "eigensolver.h"
+#include "krylov_solver.h"
+#include "umfpack_solver.h"
+#include "mumps_solver.h"
+#include "api.h"
+
+namespace Hermes
+{
+  namespace Solvers
+  {
+    /// CSC arrays (copies) of a CSC or CSR matrix.
+    template<typename Scalar>
+    static void get_csc_arrays(SparseMatrix<Scalar>* m, int*& ap, int*& ai, Scalar*& ax)
+    {
+      int n = m->get_size();
+#ifdef WITH_UMFPACK
+      CSCMatrix<Scalar>* csc = dynamic_cast<CSCMatrix<Scalar>*>(m);
+      if(csc != NULL)
+      {
+        int nnz = csc->get_nnz();
+        ap = new int[n + 1];
+        ai = new int[nnz > 0 ? nnz : 1];
+        ax = new Scalar[nnz > 0 ? nnz : 1];
+        memcpy(ap, csc->get_Ap(), (n + 1) * sizeof(int));
+        memcpy(ai, csc->get_Ai(), nnz * sizeof(int));
+        memcpy(ax, csc->get_Ax(), nnz * sizeof(Scalar));
+        return;
+      }
+#endif
+      CSRMatrix<Scalar>* csr = dynamic_cast<CSRMatrix<Scalar>*>(m);
+      if(csr == NULL)
+        throw Hermes::Exceptions::Exception("EigenSolver needs CSC or CSR matrices.");
+
+      // Transpose, the rows are visited in ascending order so the columns come out sorted.
+      int nnz = csr->get_nnz();
+      int* csr_Ap = csr->get_Ap();
+      int* csr_Ai = csr->get_Ai();
+      Scalar* csr_Ax = csr->get_Ax();
+      ap = new int[n + 1];
+      ai = new int[nnz > 0 ? nnz : 1];
+      ax = new Scalar[nnz > 0 ? nnz : 1];
+      memset(ap, 0, (n + 1) * sizeof(int));
+      for (int k = 0; k < nnz; k++)
+        ap[csr_Ai[k] + 1]++;
+      for (int j = 0; j < n; j++)
+        ap[j + 1] += ap[j];
+      int* next = new int[n > 0 ? n : 1];
+      memcpy(next, ap, n * sizeof(int));
+      for (int i = 0; i < n; i++)
+        for (int k = csr_Ap[i]; k < csr_Ap[i + 1]; k++)
+        {
+          int pos = next[csr_Ai[k]]++;
+          ai[pos] = i;
+          ax[pos] = csr_Ax[k];
+        }
+      delete [] next;
+    }
+
+    /// Eigenvalues and eigenvectors of a symmetric tridiagonal matrix by the QL method with implicit shifts.
+    /// @param[in,out] d - the diagonal, replaced by the eigenvalues
+    /// @param[in,out] e - the subdiagonal in e[0 .. m-2], destroyed
+    /// @param[out] z - the eigenvectors (column k for d[k]), m x m row-wise
+    static void tridiagonal_eigen(int m, double* d, double* e, double* z)
+    {
+      for (int i = 0; i < m; i++)
+        for (int j = 0; j < m; j++)
+          z[i * m + j] = (i == j) ? 1.0 : 0.0;
+      if(m > 0)
+        e[m - 1] = 0.0;
+
+      for (int l = 0; l < m; l++)
+      {
+        int iter = 0;
+        int k;
+        do
+        {
+          for (k = l; k < m - 1; k++)
+          {
+            double dd = std::abs(d[k]) + std::abs(d[k + 1]);
+            if(std::abs(e[k]) <= 1e-15 * dd)
+              break;
+          }
+          if(k != l)
+          {
+            if(iter++ == 60)
+              throw Hermes::Exceptions::Exception("EigenSolver: the eigenvalues of the Lanczos matrix did not converge.");
+            double g = (d[l + 1] - d[l]) / (2.0 * e[l]);
+            double r = sqrt(g * g + 1.0);
+            g = d[k] - d[l] + e[l] / (g + (g >= 0.0 ? r : -r));
+            double s = 1.0, c = 1.0, p = 0.0;
+            int i;
+            for (i = k - 1; i >= l; i--)
+            {
+              double f = s * e[i];
+              double b = c * e[i];
+              r = sqrt(f * f + g * g);
+              e[i + 1] = r;
+              if(r == 0.0)
+              {
+                d[i + 1] -= p;
+                e[k] = 0.0;
+                break;
+              }
+              s = f / r;
+              c = g / r;
+              g = d[i + 1] - p;
+              r = (d[i] - g) * s + 2.0 * c * b;
+              p = s * r;
+              d[i + 1] = g + p;
+              g = c * r - b;
+              for (int row = 0; row < m; row++)
+              {
+                f = z[row * m + i + 1];
+                z[row * m + i + 1] = s * z[row * m + i] + c * f;
+                z[row * m + i] = c * z[row * m + i] - s * f;
+              }
+            }
+            if(r == 0.0 && i >= l)
+              continue;
+            d[l] -= p;
+            e[l] = g;
+            e[k] = 0.0;
+          }
+        }
+        while (k != l);
+      }
+    }
+
+    template<typename Scalar>
+    EigenSolver<Scalar>::EigenSolver(SparseMatrix<Scalar>* A, SparseMatrix<Scalar>* B)
+      : A(A), B(B), shifted_matrix(NULL), shifted_rhs(NULL), shifted_solver(NULL), n_eigs(0), num_iters(0), eigenvalues(NULL), eigenvectors(NULL)
+    {
+      if(A->get_size() != B->get_size())
+        throw Hermes::Exceptions::Exception("EigenSolver: the matrices have different sizes.");
+    }
+
+    template<typename Scalar>
+    EigenSolver<Scalar>::~EigenSolver()
+    {
+      free();
+      free_shifted();
+    }
+
+    template<typename Scalar>
+    void EigenSolver<Scalar>::free()
+    {
+      for (int i = 0; i < n_eigs; i++)
+        delete [] eigenvectors[i];
+      delete [] eigenvectors;
+      eigenvectors = NULL;
+      delete [] eigenvalues;
+      eigenvalues = NULL;
+      n_eigs = 0;
+    }
+
+    template<typename Scalar>
+    void EigenSolver<Scalar>::free_shifted()
+    {
+      delete shifted_solver;
+      shifted_solver = NULL;
+      delete shifted_matrix;
+      shifted_matrix = NULL;
+      delete shifted_rhs;
+      shifted_rhs = NULL;
+    }
+
+    template<typename Scalar>
+    void EigenSolver<Scalar>::factorize_shifted(double sigma)
+    {
+      free_shifted();
+      int n = A->get_size();
+      int *a_p, *a_i, *b_p, *b_i;
+      Scalar *a_x, *b_x;
+      get_csc_arrays(A, a_p, a_i, a_x);
+      get_csc_arrays(B, b_p, b_i, b_x);
+
+      // C = A - sigma B, merging the sorted row indices of every column.
+      int* c_p = new int[n + 1];
+      int* c_i = new int[a_p[n] + b_p[n] > 0 ? a_p[n] + b_p[n] : 1];
+      Scalar* c_x = new Scalar[a_p[n] + b_p[n] > 0 ? a_p[n] + b_p[n] : 1];
+      int nnz = 0;
+      c_p[0] = 0;
+      for (int j = 0; j < n; j++)
+      {
+        int ka = a_p[j], kb = b_p[j];
+        while(ka < a_p[j + 1] || kb < b_p[j + 1])
+        {
+          if(kb == b_p[j + 1] || (ka < a_p[j + 1] && a_i[ka] < b_i[kb]))
+          {
+            c_i[nnz] = a_i[ka];
+            c_x[nnz++] = a_x[ka++];
+          }
+          else if(ka == a_p[j + 1] || b_i[kb] < a_i[ka])
+          {
+            c_i[nnz] = b_i[kb];
+            c_x[nnz++] = -sigma * b_x[kb++];
+          }
+          else
+          {
+            c_i[nnz] = a_i[ka];
+            c_x[nnz++] = a_x[ka++] - sigma * b_x[kb++];
+          }
+        }
+        c_p[j + 1] = nnz;
+      }
+      delete [] a_p;
+      delete [] a_i;
+      delete [] a_x;
+      delete [] b_p;
+      delete [] b_i;
+      delete [] b_x;
+
+      bool use_mumps = false;
+#ifdef WITH_MUMPS
+      use_mumps = true;
+#ifdef WITH_UMFPACK
+      use_mumps = Hermes::HermesCommonApi.get_integral_param_value(Hermes::matrixSolverType) == Hermes::SOLVER_MUMPS;
+#endif
+      if(use_mumps)
+      {
+        MumpsMatrix<Scalar>* mumps_matrix = new MumpsMatrix<Scalar>();
+        mumps_matrix->create(n, nnz, c_p, c_i, c_x);
+        MumpsVector<Scalar>* mumps_rhs = new MumpsVector<Scalar>();
+        mumps_rhs->alloc(n);
+        shifted_matrix = mumps_matrix;
+        shifted_rhs = mumps_rhs;
+        shifted_solver = new MumpsSolver<Scalar>(mumps_matrix, mumps_rhs);
+      }
+#endif
+#ifdef WITH_UMFPACK
+      if(!use_mumps)
+      {
+        UMFPackMatrix<Scalar>* umfpack_matrix = new UMFPackMatrix<Scalar>();
+        umfpack_matrix->create(n, nnz, c_p, c_i, c_x);
+        UMFPackVector<Scalar>* umfpack_rhs = new UMFPackVector<Scalar>(n);
+        shifted_matrix = umfpack_matrix;
+        shifted_rhs = umfpack_rhs;
+        shifted_solver = new UMFPackLinearMatrixSolver<Scalar>(umfpack_matrix, umfpack_rhs);
+      }
+#endif
+      delete [] c_p;
+      delete [] c_i;
+      delete [] c_x;
+
+      if(shifted_solver == NULL)
+        throw Hermes::Exceptions::Exception("EigenSolver needs UMFPACK or MUMPS.");
+      // Factorized in the first solve, the factors are kept for all the others.
+      shifted_solver->set_factorization_scheme(HERMES_REUSE_FACTORIZATION_COMPLETELY);
+    }
+
+    template<typename Scalar>
+    void EigenSolver<Scalar>::solve_shifted(Scalar* x)
+    {
+      if(!shifted_solver->solve_multiple(x, 1))
+        throw Hermes::Exceptions::LinearMatrixSolverException("EigenSolver: the shifted system could not be solved.");
+    }
+
+    /// Dot product of two vectors.
+    template<typename Scalar>
+    static Scalar dot(int n, const Scalar* x, const Scalar* y)
+    {
+      Scalar sum = 0.0;
+      for (int i = 0; i < n; i++)
+        sum += x[i] * y[i];
+      return sum;
+    }
+
+    template<typename Scalar>
+    void EigenSolver<Scalar>::solve(int n_eigs, double target_value, double tol, int max_iter)
+    {
+      free();
+      int n = A->get_size();
+      int max_dim = std::min(max_iter, n);
+      if(n_eigs > max_dim)
+        n_eigs = max_dim;
+      if(n_eigs < 1)
+        return;
+
+      factorize_shifted(target_value);
+
+      // The Lanczos vectors, their products with B and the tridiagonal matrix.
+      Scalar** q = new Scalar*[max_dim + 1];
+      Scalar** bq = new Scalar*[max_dim + 1];
+      double* alpha = new double[max_dim];
+      double* beta = new double[max_dim];
+      double* d = new double[max_dim];
+      double* e = new double[max_dim];
+      double* z = NULL;
+      memset(q, 0, (max_dim + 1) * sizeof(Scalar*));
+      memset(bq, 0, (max_dim + 1) * sizeof(Scalar*));
+
+      // Start from a vector with all components present, B-normalized.
+      q[0] = new Scalar[n];
+      bq[0] = new Scalar[n];
+      for (int i = 0; i < n; i++)
+        q[0][i] = 1.0 + 0.5 * sin(1.0 + i);
+      B->multiply_with_vector(q[0], bq[0]);
+      double norm = sqrt(std::abs(dot(n, q[0], bq[0])));
+      for (int i = 0; i < n; i++)
+      {
+        q[0][i] /= norm;
+        bq[0][i] /= norm;
+      }
+
+      Scalar* w = new Scalar[n];
+      int dim = 0;
+      int converged = 0;
+      // After how many steps the convergence is checked.
+      int check_step = std::max(n_eigs, 10);
+      for (int j = 0; j < max_dim; j++)
+      {
+        // w = C^-1 B q_j
+        memcpy(w, bq[j], n * sizeof(Scalar));
+        solve_shifted(w);
+        alpha[j] = (double)dot(n, w, bq[j]);
+
+        // Full reorthogonalization (twice is enough) against all the Lanczos vectors in the B-inner product.
+        for (int pass = 0; pass < 2; pass++)
+          for (int k = 0; k <= j; k++)
+          {
+            Scalar c = dot(n, w, bq[k]);
+            for (int i = 0; i < n; i++)
+              w[i] -= c * q[k][i];
+          }
+
+        q[j + 1] = new Scalar[n];
+        bq[j + 1] = new Scalar[n];
+        B->multiply_with_vector(w, bq[j + 1]);
+        beta[j] = sqrt(std::abs(dot(n, w, bq[j + 1])));
+        dim = j + 1;
+
+        // Invariant subspace.
+        bool exhausted = beta[j] <= 1e-14 * std::abs(alpha[j]) || dim == max_dim;
+        if(!exhausted)
+          for (int i = 0; i < n; i++)
+          {
+            q[j + 1][i] = w[i] / beta[j];
+            bq[j + 1][i] /= beta[j];
+          }
+
+        if(dim < n_eigs || (!exhausted && dim % check_step != 0))
+          continue;
+
+        // Ritz values, converged if the residual |beta_j * s_j| is small relative to theta.
+        memcpy(d, alpha, dim * sizeof(double));
+        memcpy(e, beta, dim * sizeof(double));
+        delete [] z;
+        z = new double[dim * dim];
+        tridiagonal_eigen(dim, d, e, z);
+
+        converged = 0;
+        bool* taken = new bool[dim];
+        memset(taken, 0, dim * sizeof(bool));
+        for (int k = 0; k < n_eigs; k++)
+        {
+          int best = -1;
+          for (int l = 0; l < dim; l++)
+            if(!taken[l] && (best < 0 || std::abs(d[l]) > std::abs(d[best])))
+              best = l;
+          taken[best] = true;
+          if(std::abs(beta[j] * z[(dim - 1) * dim + best]) <= tol * std::abs(d[best]))
+            converged++;
+          else
+            break;
+        }
+        delete [] taken;
+
+        if(converged == n_eigs || exhausted)
+          break;
+      }
+      num_iters = dim;
+
+      if(converged < n_eigs)
+        this->warn("EigenSolver: %d of %d eigenpairs converged in %d Lanczos steps.", converged, n_eigs, dim);
+      else
+        this->info("EigenSolver: %d eigenpairs converged in %d Lanczos steps.", converged, dim);
+
+      // The converged eigenpairs, lambda = sigma + 1 / theta, ordered by lambda.
+      this->n_eigs = converged;
+      eigenvalues = new double[converged];
+      eigenvectors = new Scalar*[converged];
+      int* order = new int[converged];
+      bool* taken = new bool[dim];
+      memset(taken, 0, dim * sizeof(bool));
+      for (int k = 0; k < converged; k++)
+      {
+        int best = -1;
+        for (int l = 0; l < dim; l++)
+          if(!taken[l] && (best < 0 || std::abs(d[l]) > std::abs(d[best])))
+            best = l;
+        taken[best] = true;
+        order[k] = best;
+      }
+      delete [] taken;
+      for (int k = 1; k < converged; k++)
+        for (int l = k; l > 0 && 1.0 / d[order[l]] < 1.0 / d[order[l - 1]]; l--)
+          std::swap(order[l], order[l - 1]);
+
+      for (int k = 0; k < converged; k++)
+      {
+        eigenvalues[k] = target_value + 1.0 / d[order[k]];
+        eigenvectors[k] = new Scalar[n];
+        memset(eigenvectors[k], 0, n * sizeof(Scalar));
+        for (int l = 0; l < dim; l++)
+        {
+          double s = z[l * dim + order[k]];
+          for (int i = 0; i < n; i++)
+            eigenvectors[k][i] += s * q[l][i];
+        }
+      }
+      delete [] order;
+
+      for (int j = 0; j <= max_dim; j++)
+      {
+        delete [] q[j];
+        delete [] bq[j];
+      }
+      delete [] q;
+      delete [] bq;
+      delete [] alpha;
+      delete [] beta;
+      delete [] d;
+      delete [] e;
+      delete [] z;
+      delete [] w;
+    }
+
+    template<typename Scalar>
+    int EigenSolver<Scalar>::get_n_eigs()
+    {
+      return n_eigs;
+    }
+
+    template<typename Scalar>
+    double EigenSolver<Scalar>::get_eigenvalue(int i)
+    {
+      if(i < 0 || i >= n_eigs)
+        throw Hermes::Exceptions::ValueException("i", i, 0, n_eigs - 1);
+      return eigenvalues[i];
+    }
+
+    template<typename Scalar>
+    void EigenSolver<Scalar>::get_eigenvector(int i, Scalar **vec, int *n)
+    {
+      if(i < 0 || i >= n_eigs)
+        throw Hermes::Exceptions::ValueException("i", i, 0, n_eigs - 1);
+      *vec = eigenvectors[i];
+      *n = A->get_size();
+    }
+
+    template<typename Scalar>
+    int EigenSolver<Scalar>::get_num_iters()
+    {
+      return num_iters;
+    }
+
+    template<typename Scalar>
+    void EigenSolver<Scalar>::print_eigenvalues()
+    {
+      printf("Eigenvalues:\n");
+      for (int i = 0; i < this->get_n_eigs(); i++)
+        printf("%3d: %f\n", i, this->get_eigenvalue(i));
+    }
+
+    template class HERMES_API EigenSolver<double>;
+  }
+}
@@ -0,0 +1,329 @@
+// This file is part of HermesCommon
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+/*! \file element_matrix_store.cpp
+\brief Out-of-core storage of the element matrices, used as a matrix of products only.
+*/
+#include "element_matrix_store.h"
+#include "common.h"
+
+namespace Hermes
+{
+  namespace Algebra
+  {
+    template<typename Scalar>
+    ElementMatrixStore<Scalar>::ElementMatrixStore(const char* file_name, size_t buffer_size) : SparseMatrix<Scalar>(), file_name(file_name), file(NULL),
+      buffer(NULL), buffer_size(buffer_size), buffer_used(0), num_local_matrices(0), num_values(0), file_size(0), diagonal_shift(0.0), sum_products(false)
+    {
+      if(file_name == NULL)
+        throw Exceptions::NullException(1);
+    }
+
+    template<typename Scalar>
+    ElementMatrixStore<Scalar>::~ElementMatrixStore()
+    {
+      free();
+    }
+
+    template<typename Scalar>
+    void ElementMatrixStore<Scalar>::prealloc(unsigned int n)
+    {
+      this->size = n;
+    }
+
+    template<typename Scalar>
+    void ElementMatrixStore<Scalar>::prealloc_counting()
+    {
+    }
+
+    template<typename Scalar>
+    void ElementMatrixStore<Scalar>::prealloc_indices()
+    {
+    }
+
+    template<typename Scalar>
+    void ElementMatrixStore<Scalar>::pre_add_ij(unsigned int row, unsigned int col)
+    {
+    }
+
+    template<typename Scalar>
+    void ElementMatrixStore<Scalar>::alloc(unsigned int n)
+    {
+      this->size = n;
+      alloc();
+    }
+
+    template<typename Scalar>
+    void ElementMatrixStore<Scalar>::alloc()
+    {
+      free();
+      file = fopen(file_name.c_str(), "w+b");
+      if(file == NULL)
+        throw Hermes::Exceptions::Exception("ElementMatrixStore: the file %s could not be opened.", file_name.c_str());
+      buffer = new char[buffer_size];
+      buffer_used = 0;
+      num_local_matrices = 0;
+      num_values = 0;
+      file_size = 0;
+      diagonal_shift = 0.0;
+      sum_products = false;
+    }
+
+    template<typename Scalar>
+    void ElementMatrixStore<Scalar>::free()
+    {
+      if(file != NULL)
+      {
+        fclose(file);
+        file = NULL;
+        remove(file_name.c_str());
+      }
+      delete [] buffer;
+      buffer = NULL;
+      buffer_used = 0;
+      num_local_matrices = 0;
+      num_values = 0;
+      file_size = 0;
+    }
+
+    template<typename Scalar>
+    Scalar ElementMatrixStore<Scalar>::get(unsigned int m, unsigned int n)
+    {
+      throw Hermes::Exceptions::Exception("ElementMatrixStore: the entries of an element matrix store are not available.");
+      return 0.0;
+    }
+
+    template<typename Scalar>
+    void ElementMatrixStore<Scalar>::zero()
+    {
+      alloc();
+    }
+
+    template<typename Scalar>
+    void ElementMatrixStore<Scalar>::add_to_diagonal(Scalar v)
+    {
+      diagonal_shift += v;
+    }
+
+    template<typename Scalar>
+    void ElementMatrixStore<Scalar>::add(unsigned int m, unsigned int n, Scalar v)
+    {
+      int row = m, col = n;
+      Scalar* mat = &v;
+      add(1, 1, &mat, &row, &col);
+    }
+
+    template<typename Scalar>
+    void ElementMatrixStore<Scalar>::add(unsigned int m, unsigned int n, Scalar **mat, int *rows, int *cols)
+    {
+      if(file == NULL)
+        throw Hermes::Exceptions::Exception("ElementMatrixStore: alloc() has to be called before adding.");
+
+      // The local matrix without the negative rows and columns: m, n, the rows, the columns, the values by rows.
+      std::vector<int> local_rows, local_cols;
+      for(unsigned int i = 0; i < m; i++)
+        if(rows[i] >= 0)
+          local_rows.push_back(i);
+      for(unsigned int j = 0; j < n; j++)
+        if(cols[j] >= 0)
+          local_cols.push_back(j);
+      unsigned int local_m = local_rows.size(), local_n = local_cols.size();
+      if(local_m == 0 || local_n == 0)
+        return;
+
+      size_t bytes = 2 * sizeof(unsigned int) + (local_m + local_n) * sizeof(int) + local_m * local_n * sizeof(Scalar);
+      char* record = new char[bytes];
+      char* pos = record;
+      memcpy(pos, &local_m, sizeof(unsigned int));
+      pos += sizeof(unsigned int);
+      memcpy(pos, &local_n, sizeof(unsigned int));
+      pos += sizeof(unsigned int);
+      for(unsigned int i = 0; i < local_m; i++, pos += sizeof(int))
+        memcpy(pos, &rows[local_rows[i]], sizeof(int));
+      for(unsigned int j = 0; j < local_n; j++, pos += sizeof(int))
+        memcpy(pos, &cols[local_cols[j]], sizeof(int));
+      for(unsigned int i = 0; i < local_m; i++)
+        for(unsigned int j = 0; j < local_n; j++, pos += sizeof(Scalar))
+          memcpy(pos, &mat[local_rows[i]][local_cols[j]], sizeof(Scalar));
+
+      bool written = true;
+#pragma omp critical (element_matrix_store)
+      {
+        if(buffer_used + bytes > buffer_size)
+          flush_buffer();
+        // The local matrices larger than the buffer go to the file directly.
+        if(bytes > buffer_size)
+        {
+          written = fwrite(record, 1, bytes, file) == bytes;
+          file_size += bytes;
+        }
+        else
+        {
+          memcpy(buffer + buffer_used, record, bytes);
+          buffer_used += bytes;
+        }
+        num_local_matrices++;
+        num_values += local_m * local_n;
+      }
+      delete [] record;
+      if(!written)
+        throw Hermes::Exceptions::Exception("ElementMatrixStore: writing to the file %s failed.", file_name.c_str());
+    }
+
+    template<typename Scalar>
+    void ElementMatrixStore<Scalar>::flush_buffer()
+    {
+      if(buffer_used == 0)
+        return;
+      if(fwrite(buffer, 1, buffer_used, file) != buffer_used)
+        this->warn("ElementMatrixStore: writing to the file %s failed.", file_name.c_str());
+      file_size += buffer_used;
+      buffer_used = 0;
+    }
+
+    template<typename Scalar>
+    void ElementMatrixStore<Scalar>::finish()
+    {
+      if(file == NULL)
+        return;
+      flush_buffer();
+      fflush(file);
+    }
+
+    template<typename Scalar>
+    void ElementMatrixStore<Scalar>::sum_over_processes()
+    {
+      sum_products = true;
+    }
+
+    template<typename Scalar>
+    bool ElementMatrixStore<Scalar>::read_local_matrix(FILE* file, unsigned int& m, unsigned int& n, std::vector<int>& rows, std::vector<int>& cols, std::vector<Scalar>& values)
+    {
+      if(fread(&m, sizeof(unsigned int), 1, file) != 1 || fread(&n, sizeof(unsigned int), 1, file) != 1)
+        return false;
+      rows.resize(m);
+      cols.resize(n);
+      values.resize(m * n);
+      if(fread(&rows[0], sizeof(int), m, file) != m || fread(&cols[0], sizeof(int), n, file) != n || fread(&values[0], sizeof(Scalar), m * n, file) != m * n)
+        throw Hermes::Exceptions::Exception("ElementMatrixStore: the file %s is truncated.", file_name.c_str());
+      return true;
+    }
+
+    template<typename Scalar>
+    void ElementMatrixStore<Scalar>::multiply_with_vector(Scalar* vector_in, Scalar* vector_out)
+    {
+      if(file == NULL)
+        throw Hermes::Exceptions::Exception("ElementMatrixStore: alloc() has to be called before the multiplication.");
+      finish();
+
+      for(unsigned int i = 0; i < this->size; i++)
+        vector_out[i] = 0.0;
+
+      // One pass over the file, the local matrices are appended after it again.
+      fseek(file, 0, SEEK_SET);
+      unsigned int m, n;
+      std::vector<int> rows, cols;
+      std::vector<Scalar> values;
+      while(read_local_matrix(file, m, n, rows, cols, values))
+      {
+        for(unsigned int i = 0; i < m; i++)
+        {
+          Scalar sum = 0.0;
+          for(unsigned int j = 0; j < n; j++)
+            sum += values[i * n + j] * vector_in[cols[j]];
+          vector_out[rows[i]] += sum;
+        }
+      }
+      fseek(file, 0, SEEK_END);
+
+      if(sum_products)
+        sum_values_over_processes<Scalar>(vector_out, this->size);
+
+      if(diagonal_shift != 0.0)
+        for(unsigned int i = 0; i < this->size; i++)
+          vector_out[i] += diagonal_shift * vector_in[i];
+    }
+
+    template<typename Scalar>
+    void ElementMatrixStore<Scalar>::add_to_matrix(SparseMatrix<Scalar>* mat)
+    {
+      if(mat == NULL)
+        throw Exceptions::NullException(1);
+      if(file == NULL)
+        throw Hermes::Exceptions::Exception("ElementMatrixStore: alloc() has to be called before add_to_matrix().");
+      finish();
+
+      fseek(file, 0, SEEK_SET);
+      unsigned int m, n;
+      std::vector<int> rows, cols;
+      std::vector<Scalar> values;
+      std::vector<Scalar*> value_rows;
+      while(read_local_matrix(file, m, n, rows, cols, values))
+      {
+        value_rows.resize(m);
+        for(unsigned int i = 0; i < m; i++)
+          value_rows[i] = &values[i * n];
+        mat->add(m, n, &value_rows[0], &rows[0], &cols[0]);
+      }
+      fseek(file, 0, SEEK_END);
+
+      if(diagonal_shift != 0.0)
+        mat->add_to_diagonal(diagonal_shift);
+    }
+
+    template<typename Scalar>
+    bool ElementMatrixStore<Scalar>::dump(FILE *file, const char *var_name, EMatrixDumpFormat fmt, char* number_format)
+    {
+      this->warn("ElementMatrixStore: an element matrix store can not be dumped, see add_to_matrix().");
+      return false;
+    }
+
+    template<typename Scalar>
+    unsigned int ElementMatrixStore<Scalar>::get_matrix_size() const
+    {
+      return this->size;
+    }
+
+    template<typename Scalar>
+    unsigned int ElementMatrixStore<Scalar>::get_nnz() const
+    {
+      return num_values;
+    }
+
+    template<typename Scalar>
+    double ElementMatrixStore<Scalar>::get_fill_in() const
+    {
+      return this->size == 0 ? 0.0 : num_values / ((double)this->size * this->size);
+    }
+
+    template<typename Scalar>
+    unsigned int ElementMatrixStore<Scalar>::get_num_local_matrices() const
+    {
+      return num_local_matrices;
+    }
+
+    template<typename Scalar>
+    size_t ElementMatrixStore<Scalar>::get_file_size() const
+    {
+      return file_size + buffer_used;
+    }
+
+    template class HERMES_API ElementMatrixStore<double>;
+    template class HERMES_API ElementMatrixStore<std::complex<double> >;
+  }
+}
@@ -67,17 +67,25 @@ namespace Hermes
     template<typename Scalar>
     void EpetraMatrix<Scalar>::prealloc(unsigned int n)
     {
-      this->size = n;
+      // the indices are counted and stored by SparseMatrix, the graph is built in alloc()
+      SparseMatrix<Scalar>::prealloc(n);
       // alloc trilinos structs
       std_map = new Epetra_Map(n, 0, seq_comm);
-      grph = new Epetra_CrsGraph(Copy, *std_map, 0);
     }
 
-    template<typename Scalar>
-    void EpetraMatrix<Scalar>::pre_add_ij(unsigned int row, unsigned int col)
+    static Epetra_CrsGraph* create_graph(const Epetra_BlockMap& map, unsigned int size, int* row_starts, int* col_indices)
     {
-      int col_to_pass = col;
-      grph->InsertGlobalIndices(row, 1, &col_to_pass);
+      int* row_counts = new int[size > 0 ? size : 1];
+      for (unsigned int i = 0; i < size; i++)
+        row_counts[i] = row_starts[i + 1] - row_starts[i];
+      // static profile, every row gets exactly its entries
+      Epetra_CrsGraph* grph = new Epetra_CrsGraph(Copy, map, row_counts, true);
+      for (unsigned int i = 0; i < size; i++)
+        if(row_counts[i] > 0)
+          grph->InsertGlobalIndices(i, row_counts[i], col_indices + row_starts[i]);
+      grph->FillComplete();
+      delete [] row_counts;
+      return grph;
     }
 
     template<>
@@ -96,7 +104,11 @@ namespace Hermes
     template<>
     void EpetraMatrix<double>::alloc()
     {
-      grph->FillComplete();
+      int* row_starts = new int[this->size + 1];
+      int* col_indices = this->compress_indices_by_rows(row_starts);
+      grph = create_graph(*std_map, this->size, row_starts, col_indices);
+      delete [] row_starts;
+      delete [] col_indices;
       // create the matrix
       mat = new Epetra_CrsMatrix(Copy, *grph);
     }
@@ -104,7 +116,11 @@ namespace Hermes
     template<>
     void EpetraMatrix<std::complex<double> >::alloc()
     {
-      grph->FillComplete();
+      int* row_starts = new int[this->size + 1];
+      int* col_indices = this->compress_indices_by_rows(row_starts);
+      grph = create_graph(*std_map, this->size, row_starts, col_indices);
+      delete [] row_starts;
+      delete [] col_indices;
       // create the matrix
       mat = new Epetra_CrsMatrix(Copy, *grph);
       mat_im = new Epetra_CrsMatrix(Copy, *grph);
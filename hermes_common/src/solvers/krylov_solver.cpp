@@ -0,0 +1,1057 @@
+// This file is part of HermesCommon
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+/*! \file krylov_solver.cpp
+\brief CSR matrix and the built-in multithreaded Krylov solvers (CG, BiCGStab, GMRES).
+*/
+#include "krylov_solver.h"
+#include "precond_krylov.h"
+#include "umfpack_solver.h"
+#include "bsr_matrix.h"
+#include "common.h"
+
+namespace Hermes
+{
+  namespace Algebra
+  {
+    template<typename Scalar>
+    CSRMatrix<Scalar>::CSRMatrix() : SparseMatrix<Scalar>(), Ax(NULL), Ai(NULL), Ap(NULL), nnz(0)
+    {
+    }
+
+    template<typename Scalar>
+    CSRMatrix<Scalar>::~CSRMatrix()
+    {
+      free();
+    }
+
+    template<typename Scalar>
+    void CSRMatrix<Scalar>::pre_add_ij(unsigned int row, unsigned int col)
+    {
+      // The preallocation compresses the indices by their second argument.
+      SparseMatrix<Scalar>::pre_add_ij(col, row);
+    }
+
+    template<typename Scalar>
+    void CSRMatrix<Scalar>::alloc()
+    {
+      free();
+      Ap = new int[this->size + 1];
+      Ai = this->compress_indices(Ap);
+
+      nnz = Ap[this->size];
+
+      Ax = new Scalar[nnz];
+      zero_values_by_rows<Scalar>(Ax, Ap, this->size);
+      this->set_memory_size((this->size + 1) * sizeof(int) + nnz * (sizeof(int) + sizeof(Scalar)));
+    }
+
+    template<typename Scalar>
+    void CSRMatrix<Scalar>::free()
+    {
+      nnz = 0;
+      delete [] Ap;
+      Ap = NULL;
+      delete [] Ai;
+      Ai = NULL;
+      delete [] Ax;
+      Ax = NULL;
+      this->set_memory_size(0);
+    }
+
+    template<typename Scalar>
+    void CSRMatrix<Scalar>::create(unsigned int size, unsigned int nnz, int* ap, int* ai, Scalar* ax)
+    {
+      free();
+      this->size = size;
+      this->nnz = nnz;
+      this->Ap = new int[this->size + 1];
+      this->Ai = new int[nnz];
+      this->Ax = new Scalar[nnz];
+
+      memcpy(this->Ap, ap, (this->size + 1) * sizeof(int));
+      memcpy(this->Ai, ai, nnz * sizeof(int));
+      if(ax != NULL)
+        memcpy(this->Ax, ax, nnz * sizeof(Scalar));
+      else
+        memset(this->Ax, 0, nnz * sizeof(Scalar));
+      this->set_memory_size((this->size + 1) * sizeof(int) + nnz * (sizeof(int) + sizeof(Scalar)));
+    }
+
+    template<typename Scalar>
+    int CSRMatrix<Scalar>::find_position(unsigned int m, unsigned int n) const
+    {
+      int lo = Ap[m], hi = Ap[m + 1] - 1;
+      while (lo <= hi)
+      {
+        int mid = (lo + hi) >> 1;
+        if((int)n < Ai[mid]) hi = mid - 1;
+        else if((int)n > Ai[mid]) lo = mid + 1;
+        else return mid;
+      }
+      return -1;
+    }
+
+    template<typename Scalar>
+    Scalar CSRMatrix<Scalar>::get(unsigned int m, unsigned int n)
+    {
+      int pos = find_position(m, n);
+      if(pos < 0)
+        return 0.0;
+      else
+        return Ax[pos];
+    }
+
+    template<typename Scalar>
+    void CSRMatrix<Scalar>::zero()
+    {
+      zero_values_by_rows<Scalar>(Ax, Ap, this->size);
+    }
+
+    template<typename Scalar>
+    void CSRMatrix<Scalar>::add_to_position(unsigned int pos, Scalar v)
+    {
+      Hermes::atomic_add(Ax[pos], v);
+    }
+
+    template<typename Scalar>
+    void CSRMatrix<Scalar>::add(unsigned int m, unsigned int n, Scalar v)
+    {
+      if(v != 0.0)   // ignore zero values.
+      {
+        int pos = find_position(m, n);
+        // Make sure we are adding to an existing non-zero entry.
+        if(pos < 0)
+          throw Hermes::Exceptions::Exception("Sparse matrix entry not found: [%i, %i]", m, n);
+        add_to_position(pos, v);
+      }
+    }
+
+    template<typename Scalar>
+    void CSRMatrix<Scalar>::add_to_diagonal(Scalar v)
+    {
+      for (unsigned int i = 0; i < this->size; i++)
+        add(i, i, v);
+    }
+
+    template<typename Scalar>
+    void CSRMatrix<Scalar>::add(unsigned int m, unsigned int n, Scalar **mat, int *rows, int *cols)
+    {
+      for (unsigned int i = 0; i < m; i++)       // rows
+        for (unsigned int j = 0; j < n; j++)     // cols
+          if(rows[i] >= 0 && cols[j] >= 0) // not Dir. dofs.
+            add(rows[i], cols[j], mat[i][j]);
+    }
+
+    template<typename Scalar>
+    bool CSRMatrix<Scalar>::dump(FILE *file, const char *var_name, EMatrixDumpFormat fmt, char* number_format)
+    {
+      switch (fmt)
+      {
+      case DF_MATLAB_SPARSE:
+        fprintf(file, "%% Size: %dx%d\n%% Nonzeros: %d\ntemp = zeros(%d, 3);\ntemp =[\n",
+          this->size, this->size, nnz, nnz);
+        for (unsigned int i = 0; i < this->size; i++)
+          for (int j = Ap[i]; j < Ap[i + 1]; j++)
+          {
+            fprintf(file, "%d %d ", i + 1, Ai[j] + 1);
+            Hermes::Helpers::fprint_num(file, Ax[j], number_format);
+            fprintf(file, "\n");
+          }
+        fprintf(file, "];\n%s = spconvert(temp);\n", var_name);
+        return true;
+
+      case DF_HERMES_BIN:
+        {
+          this->hermes_fwrite("HERMESR\001", 1, 8, file);
+          int ssize = sizeof(Scalar);
+          this->hermes_fwrite(&ssize, sizeof(int), 1, file);
+          this->hermes_fwrite(&this->size, sizeof(int), 1, file);
+          this->hermes_fwrite(&nnz, sizeof(int), 1, file);
+          this->hermes_fwrite(Ap, sizeof(int), this->size + 1, file);
+          this->hermes_fwrite(Ai, sizeof(int), nnz, file);
+          this->hermes_fwrite(Ax, sizeof(Scalar), nnz, file);
+          return true;
+        }
+
+      case DF_MATRIX_MARKET_BIN:
+      case DF_HDF5:
+        return dump_compressed_binary(file, var_name, fmt, this->size, nnz, Ap, Ai, Ax, true);
+
+      default:
+        return false;
+      }
+    }
+
+    template<typename Scalar>
+    unsigned int CSRMatrix<Scalar>::get_matrix_size() const
+    {
+      return this->size;
+    }
+
+    template<typename Scalar>
+    unsigned int CSRMatrix<Scalar>::get_nnz() const
+    {
+      return nnz;
+    }
+
+    template<typename Scalar>
+    double CSRMatrix<Scalar>::get_fill_in() const
+    {
+      return nnz / (double) (this->size * this->size);
+    }
+
+    template<typename Scalar>
+    void CSRMatrix<Scalar>::multiply_with_vector(Scalar* vector_in, Scalar* vector_out)
+    {
+      int n = this->size;
+#pragma omp parallel for schedule(static)
+      for (int i = 0; i < n; i++)
+      {
+        Scalar sum = 0.0;
+        for (int j = Ap[i]; j < Ap[i + 1]; j++)
+          sum += Ax[j] * vector_in[Ai[j]];
+        vector_out[i] = sum;
+      }
+    }
+
+    template<>
+    void CSRMatrix<std::complex<double> >::multiply_with_vector(std::complex<double>* vector_in, std::complex<double>* vector_out)
+    {
+      // Split real and imaginary parts, see CSCMatrix::multiply_with_vector().
+      const double* a = reinterpret_cast<const double*>(Ax);
+      const double* x = reinterpret_cast<const double*>(vector_in);
+      int n = this->size;
+#pragma omp parallel for schedule(static)
+      for (int i = 0; i < n; i++)
+      {
+        double sum_re = 0.0, sum_im = 0.0;
+        for (int j = Ap[i]; j < Ap[i + 1]; j++)
+        {
+          double a_re = a[2 * j], a_im = a[2 * j + 1];
+          double x_re = x[2 * Ai[j]], x_im = x[2 * Ai[j] + 1];
+          sum_re += a_re * x_re - a_im * x_im;
+          sum_im += a_re * x_im + a_im * x_re;
+        }
+        vector_out[i] = std::complex<double>(sum_re, sum_im);
+      }
+    }
+
+    template<typename Scalar>
+    void CSRMatrix<Scalar>::multiply_with_Scalar(Scalar value)
+    {
+      for (unsigned int i = 0; i < this->nnz; i++) Ax[i] *= value;
+    }
+
+    template<typename Scalar>
+    void CSRMatrix<Scalar>::sum_over_processes()
+    {
+      sum_values_over_processes<Scalar>(Ax, this->nnz);
+    }
+
+    template<typename Scalar>
+    CSRMatrix<Scalar>* CSRMatrix<Scalar>::duplicate()
+    {
+      CSRMatrix<Scalar>* new_matrix = new CSRMatrix<Scalar>();
+      new_matrix->create(this->size, nnz, Ap, Ai, Ax);
+      return new_matrix;
+    }
+
+    template<typename Scalar>
+    int *CSRMatrix<Scalar>::get_Ap()
+    {
+      return this->Ap;
+    }
+
+    template<typename Scalar>
+    int *CSRMatrix<Scalar>::get_Ai()
+    {
+      return this->Ai;
+    }
+
+    template<typename Scalar>
+    Scalar *CSRMatrix<Scalar>::get_Ax()
+    {
+      return this->Ax;
+    }
+
+    template<typename Scalar>
+    KrylovVector<Scalar>::KrylovVector()
+    {
+      v = NULL;
+      this->size = 0;
+    }
+
+    template<typename Scalar>
+    KrylovVector<Scalar>::KrylovVector(unsigned int size)
+    {
+      v = NULL;
+      this->size = size;
+      this->alloc(size);
+    }
+
+    template<typename Scalar>
+    KrylovVector<Scalar>::~KrylovVector()
+    {
+      free();
+    }
+
+    template<typename Scalar>
+    void KrylovVector<Scalar>::alloc(unsigned int n)
+    {
+      free();
+      this->size = n;
+      v = new Scalar[n];
+      this->zero();
+    }
+
+    template<typename Scalar>
+    void KrylovVector<Scalar>::zero()
+    {
+      zero_values<Scalar>(v, this->size);
+    }
+
+    template<typename Scalar>
+    void KrylovVector<Scalar>::change_sign()
+    {
+      for (unsigned int i = 0; i < this->size; i++) v[i] *= -1.;
+    }
+
+    template<typename Scalar>
+    void KrylovVector<Scalar>::free()
+    {
+      delete [] v;
+      v = NULL;
+      this->size = 0;
+    }
+
+    template<typename Scalar>
+    void KrylovVector<Scalar>::set(unsigned int idx, Scalar y)
+    {
+      v[idx] = y;
+    }
+
+    template<typename Scalar>
+    void KrylovVector<Scalar>::add(unsigned int idx, Scalar y)
+    {
+      Hermes::atomic_add(v[idx], y);
+    }
+
+    template<typename Scalar>
+    void KrylovVector<Scalar>::add(unsigned int n, unsigned int *idx, Scalar *y)
+    {
+      for (unsigned int i = 0; i < n; i++)
+        v[idx[i]] += y[i];
+    }
+
+    template<typename Scalar>
+    Scalar KrylovVector<Scalar>::get(unsigned int idx)
+    {
+      return v[idx];
+    }
+
+    template<typename Scalar>
+    void KrylovVector<Scalar>::extract(Scalar *v) const
+    {
+      memcpy(v, this->v, this->size * sizeof(Scalar));
+    }
+
+    template<typename Scalar>
+    const Scalar* KrylovVector<Scalar>::get_values() const
+    {
+      return this->v;
+    }
+
+    template<typename Scalar>
+    void KrylovVector<Scalar>::add_vector(Vector<Scalar>* vec)
+    {
+      assert(this->length() == vec->length());
+      for (unsigned int i = 0; i < this->length(); i++) this->v[i] += vec->get(i);
+    }
+
+    template<typename Scalar>
+    void KrylovVector<Scalar>::add_vector(Scalar* vec)
+    {
+      for (unsigned int i = 0; i < this->length(); i++) this->v[i] += vec[i];
+    }
+
+    template<typename Scalar>
+    Scalar *KrylovVector<Scalar>::get_c_array()
+    {
+      return this->v;
+    }
+
+    template<typename Scalar>
+    bool KrylovVector<Scalar>::dump(FILE *file, const char *var_name, EMatrixDumpFormat fmt, char* number_format)
+    {
+      switch (fmt)
+      {
+      case DF_MATLAB_SPARSE:
+        fprintf(file, "%% Size: %dx1\n%s =[\n", this->size, var_name);
+        for (unsigned int i = 0; i < this->size; i++)
+        {
+          Hermes::Helpers::fprint_num(file, v[i], number_format);
+          fprintf(file, "\n");
+        }
+        fprintf(file, " ];\n");
+        return true;
+
+      case DF_HERMES_BIN:
+        {
+          this->hermes_fwrite("HERMESR\001", 1, 8, file);
+          int ssize = sizeof(Scalar);
+          this->hermes_fwrite(&ssize, sizeof(int), 1, file);
+          this->hermes_fwrite(&this->size, sizeof(int), 1, file);
+          this->hermes_fwrite(v, sizeof(Scalar), this->size, file);
+          return true;
+        }
+
+      case DF_MATRIX_MARKET_BIN:
+      case DF_HDF5:
+        return dump_vector_binary(file, var_name, fmt, this->size, v);
+
+      default:
+        return false;
+      }
+    }
+
+    template class HERMES_API CSRMatrix<double>;
+    template class HERMES_API CSRMatrix<std::complex<double> >;
+    template class HERMES_API KrylovVector<double>;
+    template class HERMES_API KrylovVector<std::complex<double> >;
+  }
+
+  namespace Solvers
+  {
+    /// Sum of conj(x[i]) y[i], in parallel.
+    template<typename Scalar>
+    static Scalar dot(Scalar* x, Scalar* y, int n)
+    {
+      Scalar result = 0.0;
+#pragma omp parallel
+      {
+        Scalar partial = 0.0;
+#pragma omp for schedule(static) nowait
+        for (int i = 0; i < n; i++)
+          partial += conj(x[i]) * y[i];
+#pragma omp critical(KrylovSolver_dot)
+        result += partial;
+      }
+      return result;
+    }
+
+    template<typename Scalar>
+    static double l2_norm(Scalar* x, int n)
+    {
+      return sqrt(std::abs(dot(x, x, n)));
+    }
+
+    /// y += alpha x.
+    template<typename Scalar>
+    static void axpy(Scalar alpha, Scalar* x, Scalar* y, int n)
+    {
+#pragma omp parallel for schedule(static)
+      for (int i = 0; i < n; i++)
+        y[i] += alpha * x[i];
+    }
+
+    template<typename Scalar>
+    KrylovSolver<Scalar>::KrylovSolver(SparseMatrix<Scalar> *m, Vector<Scalar> *rhs) : IterSolver<Scalar>(), m(m), rhs(rhs), csr_copy(NULL),
+      copy_positions(NULL), copy_ap(NULL), copy_ai(NULL), copy_ap_size(0), copy_ai_size(0), copy_block_size(0), pc(NULL), own_pc(false), method(KRYLOV_GMRES), restart(30), num_iters(0), residual(0.0)
+    {
+    }
+
+    template<typename Scalar>
+    KrylovSolver<Scalar>::~KrylovSolver()
+    {
+      if(own_pc)
+        delete pc;
+      delete csr_copy;
+      free_copy_structure();
+    }
+
+    template<typename Scalar>
+    void KrylovSolver<Scalar>::set_solver(const char *name)
+    {
+      if(strcasecmp(name, "cg") == 0) method = KRYLOV_CG;
+      else if(strcasecmp(name, "bicgstab") == 0) method = KRYLOV_BICGSTAB;
+      else if(strcasecmp(name, "gmres") == 0) method = KRYLOV_GMRES;
+      else
+        throw Hermes::Exceptions::Exception("Unknown Krylov method %s, use cg, bicgstab or gmres.", name);
+    }
+
+    template<typename Scalar>
+    void KrylovSolver<Scalar>::set_restart(int restart)
+    {
+      if(restart < 1)
+        throw Exceptions::ValueException("restart", restart, 1.0);
+      this->restart = restart;
+    }
+
+    template<typename Scalar>
+    void KrylovSolver<Scalar>::set_precond(const char *name)
+    {
+      if(own_pc)
+        delete pc;
+      pc = NULL;
+      own_pc = false;
+
+      if(strcasecmp(name, "none") == 0)
+      {
+        this->precond_yes = false;
+        return;
+      }
+      else if(strcasecmp(name, "jacobi") == 0) pc = new Hermes::Preconditioners::JacobiPrecond<Scalar>();
+      else if(strcasecmp(name, "ilu0") == 0) pc = new Hermes::Preconditioners::ILU0Precond<Scalar>();
+      else if(strcasecmp(name, "block-jacobi") == 0) pc = new Hermes::Preconditioners::BlockJacobiPrecond<Scalar>();
+      else
+        throw Hermes::Exceptions::Exception("Unknown preconditioner %s, use none, jacobi, ilu0 or block-jacobi.", name);
+
+      own_pc = true;
+      this->precond_yes = true;
+    }
+
+    template<typename Scalar>
+    void KrylovSolver<Scalar>::set_precond(Precond<Scalar> *pc)
+    {
+      Hermes::Preconditioners::KrylovPrecond<Scalar>* krylov_pc = dynamic_cast<Hermes::Preconditioners::KrylovPrecond<Scalar>*>(pc);
+      if(pc != NULL && krylov_pc == NULL)
+        throw Hermes::Exceptions::Exception("KrylovSolver only works with the preconditioners derived from KrylovPrecond.");
+
+      if(own_pc)
+        delete this->pc;
+      this->pc = krylov_pc;
+      own_pc = false;
+      this->precond_yes = (krylov_pc != NULL);
+    }
+
+    template<typename Scalar>
+    int KrylovSolver<Scalar>::get_matrix_size()
+    {
+      return m->get_size();
+    }
+
+    template<typename Scalar>
+    int KrylovSolver<Scalar>::get_num_iters()
+    {
+      return num_iters;
+    }
+
+    template<typename Scalar>
+    double KrylovSolver<Scalar>::get_residual()
+    {
+      return residual;
+    }
+
+    template<typename Scalar>
+    CSRMatrix<Scalar>* KrylovSolver<Scalar>::get_csr_matrix()
+    {
+      CSRMatrix<Scalar>* csr = dynamic_cast<CSRMatrix<Scalar>*>(m);
+      if(csr != NULL)
+        return csr;
+
+      BSRMatrix<Scalar>* bsr = dynamic_cast<BSRMatrix<Scalar>*>(m);
+      if(bsr != NULL)
+      {
+        int bs = bsr->get_block_size();
+        int num_block_rows = bsr->get_size() / bs;
+        int* Ap = bsr->get_Ap();
+        int* Ai = bsr->get_Ai();
+        int nnz = bsr->get_nnz();
+        if(csr_copy != NULL && copy_structure_unchanged(Ap, num_block_rows + 1, Ai, bsr->get_num_blocks(), bs))
+        {
+          copy_values(bsr->get_Ax(), nnz);
+          return csr_copy;
+        }
+
+        if(csr_copy == NULL)
+          csr_copy = new CSRMatrix<Scalar>();
+        bsr->to_csr(csr_copy);
+
+        // The positions in the order of BSRMatrix::to_csr().
+        set_copy_structure(Ap, num_block_rows + 1, Ai, bsr->get_num_blocks(), bs);
+        copy_positions = new int[nnz];
+        int pos = 0;
+        for (int block_row = 0; block_row < num_block_rows; block_row++)
+          for (int r = 0; r < bs; r++)
+            for (int k = Ap[block_row]; k < Ap[block_row + 1]; k++)
+              for (int c = 0; c < bs; c++, pos++)
+                copy_positions[(k * bs + r) * bs + c] = pos;
+        return csr_copy;
+      }
+
+#ifdef WITH_UMFPACK
+      CSCMatrix<Scalar>* csc = dynamic_cast<CSCMatrix<Scalar>*>(m);
+      if(csc != NULL)
+      {
+        // Transpose the structure by counting the entries of every row.
+        int n = csc->get_size(), nnz = csc->get_nnz();
+        int* Ap = csc->get_Ap();
+        int* Ai = csc->get_Ai();
+        Scalar* Ax = csc->get_Ax();
+        if(csr_copy != NULL && copy_structure_unchanged(Ap, n + 1, Ai, nnz, 1))
+        {
+          copy_values(Ax, nnz);
+          return csr_copy;
+        }
+        set_copy_structure(Ap, n + 1, Ai, nnz, 1);
+        copy_positions = new int[nnz];
+
+        int* rp = new int[n + 1];
+        int* ri = new int[nnz];
+        Scalar* rx = new Scalar[nnz];
+        memset(rp, 0, (n + 1) * sizeof(int));
+        for (int k = 0; k < nnz; k++)
+          rp[Ai[k] + 1]++;
+        for (int i = 0; i < n; i++)
+          rp[i + 1] += rp[i];
+        int* fill = new int[n];
+        memcpy(fill, rp, n * sizeof(int));
+        // Going through the columns in order keeps the column indices of every row sorted.
+        for (int j = 0; j < n; j++)
+          for (int k = Ap[j]; k < Ap[j + 1]; k++)
+          {
+            int pos = fill[Ai[k]]++;
+            ri[pos] = j;
+            rx[pos] = Ax[k];
+            copy_positions[k] = pos;
+          }
+
+        if(csr_copy == NULL)
+          csr_copy = new CSRMatrix<Scalar>();
+        csr_copy->create(n, nnz, rp, ri, rx);
+
+        delete [] fill;
+        delete [] rp;
+        delete [] ri;
+        delete [] rx;
+        return csr_copy;
+      }
+#endif
+
+      throw Hermes::Exceptions::Exception("KrylovSolver needs a CSRMatrix, a BSRMatrix or a CSCMatrix.");
+      return NULL;
+    }
+
+    template<typename Scalar>
+    bool KrylovSolver<Scalar>::copy_structure_unchanged(int* ap, int ap_size, int* ai, int ai_size, int block_size) const
+    {
+      if(copy_positions == NULL || ap_size != copy_ap_size || ai_size != copy_ai_size || block_size != copy_block_size)
+        return false;
+      return memcmp(ap, copy_ap, ap_size * sizeof(int)) == 0 && memcmp(ai, copy_ai, ai_size * sizeof(int)) == 0;
+    }
+
+    template<typename Scalar>
+    void KrylovSolver<Scalar>::set_copy_structure(int* ap, int ap_size, int* ai, int ai_size, int block_size)
+    {
+      free_copy_structure();
+      copy_ap = new int[ap_size];
+      memcpy(copy_ap, ap, ap_size * sizeof(int));
+      copy_ai = new int[ai_size];
+      memcpy(copy_ai, ai, ai_size * sizeof(int));
+      copy_ap_size = ap_size;
+      copy_ai_size = ai_size;
+      copy_block_size = block_size;
+    }
+
+    template<typename Scalar>
+    void KrylovSolver<Scalar>::free_copy_structure()
+    {
+      delete [] copy_positions;
+      delete [] copy_ap;
+      delete [] copy_ai;
+      copy_positions = NULL;
+      copy_ap = NULL;
+      copy_ai = NULL;
+      copy_ap_size = copy_ai_size = copy_block_size = 0;
+    }
+
+    template<typename Scalar>
+    void KrylovSolver<Scalar>::copy_values(Scalar* ax, int count)
+    {
+      Scalar* csr_ax = csr_copy->get_Ax();
+#pragma omp parallel for schedule(static)
+      for (int k = 0; k < count; k++)
+        csr_ax[copy_positions[k]] = ax[k];
+    }
+
+    template<typename Scalar>
+    void KrylovSolver<Scalar>::apply_precond(Scalar* r, Scalar* z)
+    {
+      if(pc != NULL)
+        pc->apply(r, z);
+      else
+        memcpy(z, r, m->get_size() * sizeof(Scalar));
+    }
+
+    template<typename Scalar>
+    bool KrylovSolver<Scalar>::solve()
+    {
+      assert(m != NULL);
+      assert(rhs != NULL);
+
+      this->tick();
+
+      CSRMatrix<Scalar>* a = get_csr_matrix();
+      int n = a->get_size();
+
+      if(pc != NULL)
+      {
+        Hermes::Mixins::Profile::Section profile_section(&this->profile, this->PROFILE_NUMERIC);
+        pc->create(a);
+        pc->compute();
+      }
+
+      Scalar* b = new Scalar[n];
+      rhs->extract(b);
+      bool converged = solve_rhs(a, b);
+      delete [] b;
+
+      this->tick();
+      this->time = this->accumulated();
+
+      return converged;
+    }
+
+    template<typename Scalar>
+    bool KrylovSolver<Scalar>::solve_multiple(Scalar* rhs_block, int nrhs)
+    {
+      assert(m != NULL);
+
+      this->tick();
+
+      CSRMatrix<Scalar>* a = get_csr_matrix();
+      int n = a->get_size();
+
+      if(pc != NULL)
+      {
+        Hermes::Mixins::Profile::Section profile_section(&this->profile, this->PROFILE_NUMERIC);
+        pc->create(a);
+        pc->compute();
+      }
+
+      bool converged = true;
+      for (int rhs_i = 0; rhs_i < nrhs; rhs_i++)
+      {
+        converged = solve_rhs(a, rhs_block + rhs_i * n) && converged;
+        memcpy(rhs_block + rhs_i * n, this->sln, n * sizeof(Scalar));
+      }
+
+      this->tick();
+      this->time = this->accumulated();
+
+      this->error = converged ? 0 : -1;
+      return converged;
+    }
+
+    template<typename Scalar>
+    bool KrylovSolver<Scalar>::solve_rhs(CSRMatrix<Scalar>* a, Scalar* b)
+    {
+      int n = a->get_size();
+
+      delete [] this->sln;
+      this->sln = new Scalar[n];
+      memset(this->sln, 0, n * sizeof(Scalar));
+
+      Hermes::Mixins::Profile::Section profile_section(&this->profile, this->PROFILE_SOLVE);
+      double b_norm = l2_norm(b, n);
+
+      num_iters = 0;
+      residual = 0.0;
+      bool converged = true;
+      if(b_norm > 0.0)
+      {
+        switch (method)
+        {
+        case KRYLOV_CG:
+          converged = solve_cg(a, b, b_norm);
+          break;
+        case KRYLOV_BICGSTAB:
+          converged = solve_bicgstab(a, b, b_norm);
+          break;
+        case KRYLOV_GMRES:
+          converged = solve_gmres(a, b, b_norm);
+          break;
+        }
+      }
+
+      this->statistics.num_iterations += num_iters;
+      this->statistics.residual = residual;
+      if(!converged)
+        this->warn("KrylovSolver: relative residual %g after %d iterations.", residual, num_iters);
+      this->error = converged ? 0 : -1;
+
+      return converged;
+    }
+
+    template<typename Scalar>
+    bool KrylovSolver<Scalar>::solve_cg(CSRMatrix<Scalar>* a, Scalar* b, double b_norm)
+    {
+      int n = a->get_size();
+      Scalar* x = this->sln;
+      Scalar* r = new Scalar[n];
+      Scalar* z = new Scalar[n];
+      Scalar* p = new Scalar[n];
+      Scalar* q = new Scalar[n];
+
+      memcpy(r, b, n * sizeof(Scalar));
+      apply_precond(r, z);
+      memcpy(p, z, n * sizeof(Scalar));
+      Scalar rz = dot(r, z, n);
+
+      bool converged = false;
+      while (true)
+      {
+        residual = l2_norm(r, n) / b_norm;
+        if(residual <= this->tolerance)
+        {
+          converged = true;
+          break;
+        }
+        if(num_iters >= this->max_iters)
+          break;
+
+        a->multiply_with_vector(p, q);
+        num_iters++;
+        Scalar pq = dot(p, q, n);
+        if(pq == 0.0)
+          break;
+        Scalar alpha = rz / pq;
+        axpy(alpha, p, x, n);
+        axpy(-alpha, q, r, n);
+
+        apply_precond(r, z);
+        Scalar rz_new = dot(r, z, n);
+        Scalar beta = rz_new / rz;
+        rz = rz_new;
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < n; i++)
+          p[i] = z[i] + beta * p[i];
+      }
+
+      delete [] r;
+      delete [] z;
+      delete [] p;
+      delete [] q;
+      return converged;
+    }
+
+    template<typename Scalar>
+    bool KrylovSolver<Scalar>::solve_bicgstab(CSRMatrix<Scalar>* a, Scalar* b, double b_norm)
+    {
+      int n = a->get_size();
+      Scalar* x = this->sln;
+      Scalar* r = new Scalar[n];
+      Scalar* r0 = new Scalar[n];
+      Scalar* p = new Scalar[n];
+      Scalar* v = new Scalar[n];
+      Scalar* p_hat = new Scalar[n];
+      Scalar* s_hat = new Scalar[n];
+      Scalar* t = new Scalar[n];
+
+      memcpy(r, b, n * sizeof(Scalar));
+      memcpy(r0, b, n * sizeof(Scalar));
+      memset(p, 0, n * sizeof(Scalar));
+      memset(v, 0, n * sizeof(Scalar));
+      Scalar rho = 1.0, alpha = 1.0, omega = 1.0;
+
+      bool converged = false;
+      while (true)
+      {
+        residual = l2_norm(r, n) / b_norm;
+        if(residual <= this->tolerance)
+        {
+          converged = true;
+          break;
+        }
+        if(num_iters >= this->max_iters)
+          break;
+
+        Scalar rho_new = dot(r0, r, n);
+        if(rho_new == 0.0 || omega == 0.0)
+          break;
+        Scalar beta = (rho_new / rho) * (alpha / omega);
+        rho = rho_new;
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < n; i++)
+          p[i] = r[i] + beta * (p[i] - omega * v[i]);
+
+        apply_precond(p, p_hat);
+        a->multiply_with_vector(p_hat, v);
+        num_iters++;
+        Scalar r0v = dot(r0, v, n);
+        if(r0v == 0.0)
+          break;
+        alpha = rho / r0v;
+
+        // s = r - alpha v is stored in r.
+        axpy(-alpha, v, r, n);
+        axpy(alpha, p_hat, x, n);
+        residual = l2_norm(r, n) / b_norm;
+        if(residual <= this->tolerance)
+        {
+          converged = true;
+          break;
+        }
+
+        apply_precond(r, s_hat);
+        a->multiply_with_vector(s_hat, t);
+        double t_norm = l2_norm(t, n);
+        if(t_norm == 0.0)
+          break;
+        omega = dot(t, r, n) / (t_norm * t_norm);
+        axpy(omega, s_hat, x, n);
+        axpy(-omega, t, r, n);
+      }
+
+      delete [] r;
+      delete [] r0;
+      delete [] p;
+      delete [] v;
+      delete [] p_hat;
+      delete [] s_hat;
+      delete [] t;
+      return converged;
+    }
+
+    template<typename Scalar>
+    bool KrylovSolver<Scalar>::solve_gmres(CSRMatrix<Scalar>* a, Scalar* b, double b_norm)
+    {
+      int n = a->get_size();
+      Scalar* x = this->sln;
+
+      // Krylov basis, the Hessenberg matrix (column-wise), Givens rotations and the reduced right-hand side.
+      // The preconditioner is applied from the right, the residuals are thus the ones of the original system.
+      Scalar* v = new Scalar[(restart + 1) * n];
+      Scalar* h = new Scalar[(restart + 1) * restart];
+      Scalar* cs = new Scalar[restart];
+      Scalar* sn = new Scalar[restart];
+      Scalar* g = new Scalar[restart + 1];
+      Scalar* y = new Scalar[restart];
+      Scalar* z = new Scalar[n];
+
+      bool converged = false;
+      while (true)
+      {
+        // r = b - A x.
+        Scalar* r = v;
+        if(num_iters > 0)
+        {
+          a->multiply_with_vector(x, r);
+#pragma omp parallel for schedule(static)
+          for (int i = 0; i < n; i++)
+            r[i] = b[i] - r[i];
+        }
+        else
+          memcpy(r, b, n * sizeof(Scalar));
+
+        double beta = l2_norm(r, n);
+        residual = beta / b_norm;
+        if(residual <= this->tolerance)
+        {
+          converged = true;
+          break;
+        }
+        if(num_iters >= this->max_iters)
+          break;
+
+        for (int i = 0; i < n; i++)
+          r[i] /= beta;
+        memset(g, 0, (restart + 1) * sizeof(Scalar));
+        g[0] = beta;
+
+        int k = 0;
+        while (k < restart && num_iters < this->max_iters)
+        {
+          Scalar* w = v + (k + 1) * n;
+          Scalar* h_k = h + k * (restart + 1);
+          apply_precond(v + k * n, z);
+          a->multiply_with_vector(z, w);
+          num_iters++;
+
+          // Modified Gram-Schmidt.
+          for (int i = 0; i <= k; i++)
+          {
+            Scalar* v_i = v + i * n;
+            h_k[i] = dot(v_i, w, n);
+            axpy(-h_k[i], v_i, w, n);
+          }
+          double w_norm = l2_norm(w, n);
+          h_k[k + 1] = w_norm;
+          if(w_norm > 0.0)
+            for (int j = 0; j < n; j++)
+              w[j] /= w_norm;
+
+          // Apply the previous rotations to the new column and compute the one eliminating h_k[k + 1].
+          for (int i = 0; i < k; i++)
+          {
+            Scalar temp = conj(cs[i]) * h_k[i] + conj(sn[i]) * h_k[i + 1];
+            h_k[i + 1] = -sn[i] * h_k[i] + cs[i] * h_k[i + 1];
+            h_k[i] = temp;
+          }
+          double denominator = sqrt(std::abs(h_k[k]) * std::abs(h_k[k]) + w_norm * w_norm);
+          cs[k] = h_k[k] / denominator;
+          sn[k] = h_k[k + 1] / denominator;
+          h_k[k] = denominator;
+          h_k[k + 1] = 0.0;
+          g[k + 1] = -sn[k] * g[k];
+          g[k] = conj(cs[k]) * g[k];
+
+          k++;
+
+          residual = std::abs(g[k]) / b_norm;
+          if(residual <= this->tolerance || w_norm == 0.0)
+            break;
+        }
+
+        // x += M^-1 V y, H y = g.
+        for (int i = k - 1; i >= 0; i--)
+        {
+          y[i] = g[i];
+          for (int j = i + 1; j < k; j++)
+            y[i] -= h[j * (restart + 1) + i] * y[j];
+          y[i] /= h[i * (restart + 1) + i];
+        }
+        Scalar* u = v + restart * n;
+        memset(u, 0, n * sizeof(Scalar));
+        for (int i = 0; i < k; i++)
+          axpy(y[i], v + i * n, u, n);
+        apply_precond(u, z);
+        axpy(Scalar(1.0), z, x, n);
+
+        if(residual <= this->tolerance)
+        {
+          converged = true;
+          break;
+        }
+      }
+
+      delete [] v;
+      delete [] h;
+      delete [] cs;
+      delete [] sn;
+      delete [] g;
+      delete [] y;
+      delete [] z;
+      return converged;
+    }
+
+    template class HERMES_API KrylovSolver<double>;
+    template class HERMES_API KrylovSolver<std::complex<double> >;
+  }
+}
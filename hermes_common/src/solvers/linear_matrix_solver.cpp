@@ -27,6 +27,7 @@
 #include "mumps_solver.h"
 #include "newton_solver_nox.h"
 #include "aztecoo_solver.h"
+#include "krylov_solver.h"
 #include "api.h"
 
 using namespace Hermes::Algebra;
@@ -35,11 +36,104 @@ namespace Hermes
 {
   namespace Solvers
   {
+    static const char* linear_matrix_solver_profile_phase_names[] =
+    {
+      "symbolic factorization",
+      "numeric factorization",
+      "solve"
+    };
+
+    LinearMatrixSolverStatistics::LinearMatrixSolverStatistics()
+    {
+      clear();
+    }
+
+    void LinearMatrixSolverStatistics::clear()
+    {
+      num_symbolic_factorizations = 0;
+      num_numeric_factorizations = 0;
+      num_solves = 0;
+      num_iterations = 0;
+      symbolic_time = 0.0;
+      numeric_time = 0.0;
+      solve_time = 0.0;
+      flops = 0.0;
+      matrix_size = 0;
+      matrix_nnz = 0;
+      factor_nnz = 0;
+      factor_memory = 0;
+      residual = 0.0;
+    }
+
+    double LinearMatrixSolverStatistics::get_fill_ratio() const
+    {
+      if(matrix_nnz == 0 || factor_nnz == 0)
+        return 0.0;
+      return factor_nnz / (double)matrix_nnz;
+    }
+
+    unsigned long LinearMatrixSolverStatistics::get_num_factorization_reuses() const
+    {
+      return num_solves > num_numeric_factorizations ? num_solves - num_numeric_factorizations : 0;
+    }
+
+    unsigned long LinearMatrixSolverStatistics::get_num_symbolic_reuses() const
+    {
+      return num_numeric_factorizations > num_symbolic_factorizations ? num_numeric_factorizations - num_symbolic_factorizations : 0;
+    }
+
+    void LinearMatrixSolverStatistics::add(const LinearMatrixSolverStatistics& other)
+    {
+      num_symbolic_factorizations += other.num_symbolic_factorizations;
+      num_numeric_factorizations += other.num_numeric_factorizations;
+      num_solves += other.num_solves;
+      num_iterations += other.num_iterations;
+      symbolic_time += other.symbolic_time;
+      numeric_time += other.numeric_time;
+      solve_time += other.solve_time;
+      flops += other.flops;
+      if(other.matrix_size != 0)
+        matrix_size = other.matrix_size;
+      if(other.matrix_nnz != 0)
+        matrix_nnz = other.matrix_nnz;
+      if(other.factor_nnz != 0)
+        factor_nnz = other.factor_nnz;
+      if(other.factor_memory != 0)
+        factor_memory = other.factor_memory;
+      if(other.residual != 0.0)
+        residual = other.residual;
+    }
+
+    LinearMatrixSolverStatistics LinearMatrixSolverStatistics::since(const LinearMatrixSolverStatistics& earlier) const
+    {
+      LinearMatrixSolverStatistics difference = *this;
+      difference.num_symbolic_factorizations -= earlier.num_symbolic_factorizations;
+      difference.num_numeric_factorizations -= earlier.num_numeric_factorizations;
+      difference.num_solves -= earlier.num_solves;
+      difference.num_iterations -= earlier.num_iterations;
+      difference.symbolic_time -= earlier.symbolic_time;
+      difference.numeric_time -= earlier.numeric_time;
+      difference.solve_time -= earlier.solve_time;
+      difference.flops -= earlier.flops;
+      return difference;
+    }
+
+    std::string LinearMatrixSolverStatistics::to_string() const
+    {
+      char buffer[512];
+      sprintf(buffer, "size %u, nnz %lu, factor nnz %lu (fill %g), factor memory %lu B, %lu symbolic (%g s), %lu numeric (%g s), %lu solves (%g s), %lu factorization reuses, %lu iterations, %g flops",
+        matrix_size, matrix_nnz, factor_nnz, get_fill_ratio(), (unsigned long)factor_memory,
+        num_symbolic_factorizations, symbolic_time, num_numeric_factorizations, numeric_time, num_solves, solve_time,
+        get_num_factorization_reuses(), num_iterations, flops);
+      return std::string(buffer);
+    }
+
     template<typename Scalar>
-    LinearMatrixSolver<Scalar>::LinearMatrixSolver()
+    LinearMatrixSolver<Scalar>::LinearMatrixSolver() : profile(PROFILE_NUM_PHASES, linear_matrix_solver_profile_phase_names, "solver")
     {
       sln = NULL;
       time = -1.0;
+      profile.set_enabled();
     }
 
     template<typename Scalar>
@@ -49,12 +143,53 @@ namespace Hermes
         delete [] sln;
     }
 
+    template<typename Scalar>
+    Hermes::Mixins::Profile* LinearMatrixSolver<Scalar>::get_profile()
+    {
+      return &this->profile;
+    }
+
+    template<typename Scalar>
+    LinearMatrixSolverStatistics LinearMatrixSolver<Scalar>::get_statistics()
+    {
+      LinearMatrixSolverStatistics result = this->statistics;
+      result.num_symbolic_factorizations = profile.get_count(PROFILE_SYMBOLIC);
+      result.num_numeric_factorizations = profile.get_count(PROFILE_NUMERIC);
+      result.num_solves = profile.get_count(PROFILE_SOLVE);
+      result.symbolic_time = profile.get_time(PROFILE_SYMBOLIC);
+      result.numeric_time = profile.get_time(PROFILE_NUMERIC);
+      result.solve_time = profile.get_time(PROFILE_SOLVE);
+      result.matrix_size = get_matrix_size();
+      return result;
+    }
+
+    template<typename Scalar>
+    void LinearMatrixSolver<Scalar>::reset_statistics()
+    {
+      profile.reset();
+      statistics.clear();
+    }
+
     template<typename Scalar>
     Scalar *LinearMatrixSolver<Scalar>::get_sln_vector()
     {
       return sln;
     }
 
+    template<typename Scalar>
+    bool LinearMatrixSolver<Scalar>::solve_multiple(Scalar* rhs_block, int nrhs)
+    {
+      throw Hermes::Exceptions::Exception("solve_multiple() undefined.");
+      return false;
+    }
+
+    template<typename Scalar>
+    bool LinearMatrixSolver<Scalar>::solve_transposed(Scalar* rhs_block, int nrhs)
+    {
+      throw Hermes::Exceptions::Exception("solve_transposed() undefined.");
+      return false;
+    }
+
     template<typename Scalar>
     int LinearMatrixSolver<Scalar>::get_error()
     {
@@ -139,6 +274,12 @@ namespace Hermes
 #endif
           break;
         }
+      case Hermes::SOLVER_KRYLOV:
+        {
+          if(rhs != NULL) return new KrylovSolver<Scalar>(static_cast<SparseMatrix<Scalar>*>(matrix), rhs);
+          else return new KrylovSolver<Scalar>(static_cast<SparseMatrix<Scalar>*>(matrix), rhs_dummy);
+          break;
+        }
       default:
         throw Hermes::Exceptions::Exception("Unknown matrix solver requested in create_linear_solver().");
       }
@@ -151,6 +292,28 @@ namespace Hermes
       factorization_scheme = reuse_scheme;
     }
 
+    template<typename Scalar>
+    bool DirectSolver<Scalar>::pattern_unchanged(unsigned int size, unsigned int nnz, const int* p, unsigned int p_len, const int* i, unsigned int i_len)
+    {
+      if(!Hermes::HermesCommonApi.get_integral_param_value(Hermes::symbolicFactorizationReuse))
+        return false;
+
+      // FNV-1a over both index arrays.
+      uint64_t hash = 14695981039346656037ULL;
+      for (unsigned int k = 0; k < p_len; k++)
+        hash = (hash ^ (uint64_t)(unsigned int)p[k]) * 1099511628211ULL;
+      for (unsigned int k = 0; k < i_len; k++)
+        hash = (hash ^ (uint64_t)(unsigned int)i[k]) * 1099511628211ULL;
+
+      bool unchanged = (size == pattern_size && nnz == pattern_nnz && hash == pattern_hash);
+
+      pattern_size = size;
+      pattern_nnz = nnz;
+      pattern_hash = hash;
+
+      return unchanged;
+    }
+
     template<typename Scalar>
     void IterSolver<Scalar>::set_tolerance(double tol)
     {
@@ -0,0 +1,372 @@
+// This file is part of HermesCommon
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+/*! \file matrix_free_solver.cpp
+\brief Matrix-free Jacobian operator and a GMRES solver working with products only.
+*/
+#include "matrix_free_solver.h"
+#include "common.h"
+#include <float.h>
+
+namespace Hermes
+{
+  namespace Algebra
+  {
+    template<typename Scalar>
+    static double l2_norm(Scalar* v, unsigned int n)
+    {
+      double norm = 0.0;
+      for (unsigned int i = 0; i < n; i++)
+        norm += std::abs(v[i]) * std::abs(v[i]);
+      return sqrt(norm);
+    }
+
+    template<typename Scalar>
+    MatrixFreeJacobian<Scalar>::MatrixFreeJacobian(Hermes::Solvers::DiscreteProblemInterface<Scalar>* dp) : SparseMatrix<Scalar>(), dp(dp),
+      coeff_vec(NULL), residual(NULL), coeff_vec_norm(0.0), perturbed_coeff_vec(NULL), perturbed_residual(NULL), diagonal_shift(0.0)
+    {
+    }
+
+    template<typename Scalar>
+    MatrixFreeJacobian<Scalar>::~MatrixFreeJacobian()
+    {
+      free();
+    }
+
+    template<typename Scalar>
+    void MatrixFreeJacobian<Scalar>::alloc()
+    {
+      free();
+      this->size = dp->get_num_dofs();
+      coeff_vec = new Scalar[this->size];
+      residual = new Scalar[this->size];
+      perturbed_coeff_vec = new Scalar[this->size];
+      perturbed_residual = create_vector<Scalar>();
+    }
+
+    template<typename Scalar>
+    void MatrixFreeJacobian<Scalar>::free()
+    {
+      delete [] coeff_vec;
+      coeff_vec = NULL;
+      delete [] residual;
+      residual = NULL;
+      delete [] perturbed_coeff_vec;
+      perturbed_coeff_vec = NULL;
+      delete perturbed_residual;
+      perturbed_residual = NULL;
+    }
+
+    template<typename Scalar>
+    void MatrixFreeJacobian<Scalar>::set_linearization_point(Scalar* coeff_vec_to_set, Vector<Scalar>* residual_to_set)
+    {
+      if(this->coeff_vec == NULL || this->size != (unsigned int)dp->get_num_dofs())
+        alloc();
+
+      memcpy(this->coeff_vec, coeff_vec_to_set, this->size * sizeof(Scalar));
+      residual_to_set->extract(this->residual);
+      this->coeff_vec_norm = l2_norm(this->coeff_vec, this->size);
+      this->diagonal_shift = 0.0;
+    }
+
+    template<typename Scalar>
+    void MatrixFreeJacobian<Scalar>::multiply_with_vector(Scalar* vector_in, Scalar* vector_out)
+    {
+      if(coeff_vec == NULL)
+        throw Hermes::Exceptions::Exception("MatrixFreeJacobian: set_linearization_point() has to be called before the multiplication.");
+
+      double vector_in_norm = l2_norm(vector_in, this->size);
+      if(vector_in_norm == 0.0)
+      {
+        memset(vector_out, 0, this->size * sizeof(Scalar));
+        return;
+      }
+
+      // The step balancing the truncation and the rounding error of the difference.
+      double eps = sqrt(DBL_EPSILON) * (1.0 + coeff_vec_norm) / vector_in_norm;
+
+      for (unsigned int i = 0; i < this->size; i++)
+        perturbed_coeff_vec[i] = coeff_vec[i] + eps * vector_in[i];
+
+      dp->assemble(perturbed_coeff_vec, perturbed_residual);
+      perturbed_residual->extract(vector_out);
+
+      for (unsigned int i = 0; i < this->size; i++)
+        vector_out[i] = (vector_out[i] - residual[i]) / eps + diagonal_shift * vector_in[i];
+    }
+
+    template<typename Scalar>
+    Scalar MatrixFreeJacobian<Scalar>::get(unsigned int m, unsigned int n)
+    {
+      throw Hermes::Exceptions::Exception("MatrixFreeJacobian: the entries of a matrix-free Jacobian are not available.");
+      return 0.0;
+    }
+
+    template<typename Scalar>
+    void MatrixFreeJacobian<Scalar>::zero()
+    {
+      diagonal_shift = 0.0;
+    }
+
+    template<typename Scalar>
+    void MatrixFreeJacobian<Scalar>::add_to_diagonal(Scalar v)
+    {
+      diagonal_shift += v;
+    }
+
+    template<typename Scalar>
+    void MatrixFreeJacobian<Scalar>::add(unsigned int m, unsigned int n, Scalar v)
+    {
+      throw Hermes::Exceptions::Exception("MatrixFreeJacobian: entries can not be added to a matrix-free Jacobian.");
+    }
+
+    template<typename Scalar>
+    void MatrixFreeJacobian<Scalar>::add(unsigned int m, unsigned int n, Scalar **mat, int *rows, int *cols)
+    {
+      throw Hermes::Exceptions::Exception("MatrixFreeJacobian: entries can not be added to a matrix-free Jacobian.");
+    }
+
+    template<typename Scalar>
+    bool MatrixFreeJacobian<Scalar>::dump(FILE *file, const char *var_name, EMatrixDumpFormat fmt, char* number_format)
+    {
+      this->warn("MatrixFreeJacobian: a matrix-free Jacobian can not be dumped.");
+      return false;
+    }
+
+    template<typename Scalar>
+    unsigned int MatrixFreeJacobian<Scalar>::get_matrix_size() const
+    {
+      return this->size;
+    }
+
+    template<typename Scalar>
+    unsigned int MatrixFreeJacobian<Scalar>::get_nnz() const
+    {
+      return 0;
+    }
+
+    template<typename Scalar>
+    double MatrixFreeJacobian<Scalar>::get_fill_in() const
+    {
+      return 0.0;
+    }
+
+    template class HERMES_API MatrixFreeJacobian<double>;
+    template class HERMES_API MatrixFreeJacobian<std::complex<double> >;
+  }
+
+  namespace Solvers
+  {
+    template<typename Scalar>
+    GMRESSolver<Scalar>::GMRESSolver(SparseMatrix<Scalar> *m, Vector<Scalar> *rhs) : IterSolver<Scalar>(), m(m), rhs(rhs), restart(30), num_iters(0), residual(0.0)
+    {
+    }
+
+    template<typename Scalar>
+    GMRESSolver<Scalar>::~GMRESSolver()
+    {
+    }
+
+    template<typename Scalar>
+    void GMRESSolver<Scalar>::set_restart(int restart)
+    {
+      if(restart < 1)
+        throw Exceptions::ValueException("restart", restart, 1.0);
+      this->restart = restart;
+    }
+
+    template<typename Scalar>
+    void GMRESSolver<Scalar>::set_precond(const char *name)
+    {
+      this->warn("GMRESSolver does not support preconditioning, the preconditioner %s is ignored.", name);
+    }
+
+    template<typename Scalar>
+    void GMRESSolver<Scalar>::set_precond(Precond<Scalar> *pc)
+    {
+      this->warn("GMRESSolver does not support preconditioning, the preconditioner is ignored.");
+    }
+
+    template<typename Scalar>
+    int GMRESSolver<Scalar>::get_matrix_size()
+    {
+      return m->get_size();
+    }
+
+    template<typename Scalar>
+    int GMRESSolver<Scalar>::get_num_iters()
+    {
+      return num_iters;
+    }
+
+    template<typename Scalar>
+    double GMRESSolver<Scalar>::get_residual()
+    {
+      return residual;
+    }
+
+    template<typename Scalar>
+    bool GMRESSolver<Scalar>::solve()
+    {
+      assert(m != NULL);
+      assert(rhs != NULL);
+
+      this->tick();
+
+      unsigned int n = rhs->length();
+
+      delete [] this->sln;
+      this->sln = new Scalar[n];
+      memset(this->sln, 0, n * sizeof(Scalar));
+
+      Scalar* b = new Scalar[n];
+      rhs->extract(b);
+      double b_norm = Hermes::Algebra::l2_norm(b, n);
+
+      num_iters = 0;
+      residual = 0.0;
+      if(b_norm == 0.0)
+      {
+        delete [] b;
+        this->tick();
+        this->time = this->accumulated();
+        return true;
+      }
+
+      // Krylov basis, the Hessenberg matrix (column-wise), Givens rotations and the reduced right-hand side.
+      Scalar* v = new Scalar[(restart + 1) * n];
+      Scalar* h = new Scalar[(restart + 1) * restart];
+      Scalar* cs = new Scalar[restart];
+      Scalar* sn = new Scalar[restart];
+      Scalar* g = new Scalar[restart + 1];
+      Scalar* y = new Scalar[restart];
+
+      bool converged = false;
+      while (true)
+      {
+        // r = b - A x.
+        Scalar* r = v;
+        if(num_iters > 0)
+        {
+          m->multiply_with_vector(this->sln, r);
+          for (unsigned int i = 0; i < n; i++)
+            r[i] = b[i] - r[i];
+        }
+        else
+          memcpy(r, b, n * sizeof(Scalar));
+
+        double beta = Hermes::Algebra::l2_norm(r, n);
+        residual = beta / b_norm;
+        if(residual <= this->tolerance)
+        {
+          converged = true;
+          break;
+        }
+        if(num_iters >= this->max_iters)
+          break;
+
+        for (unsigned int i = 0; i < n; i++)
+          r[i] /= beta;
+        memset(g, 0, (restart + 1) * sizeof(Scalar));
+        g[0] = beta;
+
+        int k = 0;
+        while (k < restart && num_iters < this->max_iters)
+        {
+          Scalar* w = v + (k + 1) * n;
+          Scalar* h_k = h + k * (restart + 1);
+          m->multiply_with_vector(v + k * n, w);
+          num_iters++;
+
+          // Modified Gram-Schmidt.
+          for (int i = 0; i <= k; i++)
+          {
+            Scalar* v_i = v + i * n;
+            Scalar dot = 0.0;
+            for (unsigned int j = 0; j < n; j++)
+              dot += conj(v_i[j]) * w[j];
+            h_k[i] = dot;
+            for (unsigned int j = 0; j < n; j++)
+              w[j] -= dot * v_i[j];
+          }
+          double w_norm = Hermes::Algebra::l2_norm(w, n);
+          h_k[k + 1] = w_norm;
+          if(w_norm > 0.0)
+            for (unsigned int j = 0; j < n; j++)
+              w[j] /= w_norm;
+
+          // Apply the previous rotations to the new column and compute the one eliminating h_k[k + 1].
+          for (int i = 0; i < k; i++)
+          {
+            Scalar temp = conj(cs[i]) * h_k[i] + conj(sn[i]) * h_k[i + 1];
+            h_k[i + 1] = -sn[i] * h_k[i] + cs[i] * h_k[i + 1];
+            h_k[i] = temp;
+          }
+          double denominator = sqrt(std::abs(h_k[k]) * std::abs(h_k[k]) + w_norm * w_norm);
+          cs[k] = h_k[k] / denominator;
+          sn[k] = h_k[k + 1] / denominator;
+          h_k[k] = denominator;
+          h_k[k + 1] = 0.0;
+          g[k + 1] = -sn[k] * g[k];
+          g[k] = conj(cs[k]) * g[k];
+
+          k++;
+
+          residual = std::abs(g[k]) / b_norm;
+          if(residual <= this->tolerance || w_norm == 0.0)
+            break;
+        }
+
+        // x += V y, H y = g.
+        for (int i = k - 1; i >= 0; i--)
+        {
+          y[i] = g[i];
+          for (int j = i + 1; j < k; j++)
+            y[i] -= h[j * (restart + 1) + i] * y[j];
+          y[i] /= h[i * (restart + 1) + i];
+        }
+        for (int i = 0; i < k; i++)
+          for (unsigned int j = 0; j < n; j++)
+            this->sln[j] += y[i] * v[i * n + j];
+      }
+
+      delete [] b;
+      delete [] v;
+      delete [] h;
+      delete [] cs;
+      delete [] sn;
+      delete [] g;
+      delete [] y;
+
+      this->tick();
+      this->time = this->accumulated();
+
+      this->statistics.num_iterations += num_iters;
+      this->statistics.residual = residual;
+
+      // Not reaching the tolerance is not fatal for an inexact Newton's step.
+      if(!converged)
+        this->warn("GMRESSolver: relative residual %g after %d iterations.", residual, num_iters);
+
+      return true;
+    }
+
+    template class HERMES_API GMRESSolver<double>;
+    template class HERMES_API GMRESSolver<std::complex<double> >;
+  }
+}
@@ -32,6 +32,8 @@ namespace Hermes
     {
       extern void dmumps_c(DMUMPS_STRUC_C *mumps_param_ptr);
       extern void zmumps_c(ZMUMPS_STRUC_C *mumps_param_ptr);
+      extern void smumps_c(SMUMPS_STRUC_C *mumps_param_ptr);
+      extern void cmumps_c(CMUMPS_STRUC_C *mumps_param_ptr);
     }
 
 #define USE_COMM_WORLD  -987654
@@ -88,24 +90,14 @@ namespace Hermes
     template<typename Scalar>
     void MumpsMatrix<Scalar>::alloc()
     {
-      assert(this->pages != NULL);
-
       // initialize the arrays Ap and Ai
-      Ap = new unsigned int[this->size + 1];
-      int aisize = this->get_num_indices();
-      Ai = new int[aisize];
-
       // sort the indices and remove duplicities, insert into Ai
-      unsigned int i, pos = 0;
-      for (i = 0; i < this->size; i++)
-      {
-        Ap[i] = pos;
-        pos += sort_and_store_indices(this->pages[i], Ai + pos, Ai + aisize);
-      }
-      Ap[i] = pos;
-
-      delete [] this->pages;
-      this->pages = NULL;
+      int *col_starts = new int[this->size + 1];
+      Ai = this->compress_indices(col_starts);
+      Ap = new unsigned int[this->size + 1];
+      for (unsigned int i = 0; i <= this->size; i++)
+        Ap[i] = col_starts[i];
+      delete [] col_starts;
 
       nnz = Ap[this->size];
 
@@ -119,6 +111,7 @@ namespace Hermes
         irn[i] = 1;
         jcn[i] = 1;
       }
+      this->set_memory_size((this->size + 1) * sizeof(unsigned int) + nnz * (3 * sizeof(int) + sizeof(typename mumps_type<Scalar>::mumps_Scalar)));
     }
 
     template<typename Scalar>
@@ -130,6 +123,7 @@ namespace Hermes
       delete [] Ax; Ax = NULL;
       delete [] irn; irn = NULL;
       delete [] jcn; jcn = NULL;
+      this->set_memory_size(0);
     }
 
     inline double mumps_to_Scalar(double x)
@@ -250,6 +244,10 @@ namespace Hermes
           return true;
         }
 
+      case DF_MATRIX_MARKET_BIN:
+      case DF_HDF5:
+        return dump_compressed_binary(file, var_name, fmt, this->size, nnz, (const int*)Ap, Ai, (const Scalar*)Ax);
+
       default:
         return false;
       }
@@ -279,6 +277,12 @@ namespace Hermes
       add_as_block(0, 0, mat);
     };
 
+    template<typename Scalar>
+    void MumpsMatrix<Scalar>::add_sparse_matrix(SparseMatrix<Scalar>* mat)
+    {
+      add_matrix(static_cast<MumpsMatrix*>(mat));
+    }
+
     template<typename Scalar>
     void MumpsMatrix<Scalar>::add_to_diagonal_blocks(int num_stages, MumpsMatrix<Scalar>* mat)
     {
@@ -348,6 +352,13 @@ namespace Hermes
       }
     }
 
+    template<typename Scalar>
+    void MumpsMatrix<Scalar>::sum_over_processes()
+    {
+      // The complex entries of MUMPS are pairs of doubles as std::complex<double>.
+      sum_values_over_processes<Scalar>((Scalar*)Ax, nnz);
+    }
+
     template<>
     void MumpsMatrix<std::complex<double> >::multiply_with_Scalar(std::complex<double> value)
     {
@@ -388,15 +399,16 @@ namespace Hermes
       for (unsigned int i = 0; i < this->size; i++)
       {
         this->Ap[i] = ap[i];
-        for (int j = ap[i];j<ap[i + 1];j++) jcn[j] = i;
+        for (int j = ap[i];j<ap[i + 1];j++) jcn[j] = i + 1;  // MUMPS is indexing from 1
       }
       this->Ap[this->size] = ap[this->size];
       for (unsigned int i = 0; i < nnz; i++)
       {
         mumps_assign_Scalar(this->Ax[i], ax[i]);
         this->Ai[i] = ai[i];
-        irn[i] = ai[i];
+        irn[i] = ai[i] + 1;
       }
+      this->set_memory_size((this->size + 1) * sizeof(unsigned int) + nnz * (3 * sizeof(int) + sizeof(typename mumps_type<Scalar>::mumps_Scalar)));
     }
     // Duplicates a matrix (including allocation).
     template<typename Scalar>
@@ -422,6 +434,7 @@ namespace Hermes
       {
         nmat->Ap[i] = Ap[i];
       }
+      nmat->set_memory_size((this->size + 1) * sizeof(unsigned int) + nnz * (3 * sizeof(int) + sizeof(typename mumps_type<Scalar>::mumps_Scalar)));
       return nmat;
     }
 
@@ -503,6 +516,12 @@ namespace Hermes
       memcpy(v, this->v, this->size * sizeof(Scalar));
     }
 
+    template<typename Scalar>
+    const Scalar* MumpsVector<Scalar>::get_values() const
+    {
+      return this->v;
+    }
+
     template<typename Scalar>
     void MumpsVector<Scalar>::add_vector(Vector<Scalar>* vec)
     {
@@ -550,6 +569,10 @@ namespace Hermes
           return true;
         }
 
+      case DF_MATRIX_MARKET_BIN:
+      case DF_HDF5:
+        return dump_vector_binary(file, var_name, fmt, this->size, v);
+
       default:
         return false;
       }
@@ -573,17 +596,129 @@ namespace Hermes
 #define JOB_ANALYZE_FACTORIZE_SOLVE  6
 #define JOB_FACTORIZE_SOLVE          5
 #define JOB_SOLVE                    3
+#define JOB_ANALYZE_FACTORIZE        4
+#define JOB_FACTORIZE                2
+#define JOB_ANALYZE                  1
+
+    /// The phase of the profile (see LinearMatrixSolver::ProfilePhase) of a MUMPS job, -1 for the initialization and the end.
+    /// The combined jobs are recorded under their first factorization phase.
+    static int mumps_profile_phase(int job)
+    {
+      switch(job)
+      {
+      case JOB_ANALYZE:
+        return LinearMatrixSolver<double>::PROFILE_SYMBOLIC;
+      case JOB_FACTORIZE:
+      case JOB_ANALYZE_FACTORIZE:
+      case JOB_FACTORIZE_SOLVE:
+      case JOB_ANALYZE_FACTORIZE_SOLVE:
+        return LinearMatrixSolver<double>::PROFILE_NUMERIC;
+      case JOB_SOLVE:
+        return LinearMatrixSolver<double>::PROFILE_SOLVE;
+      default:
+        return -1;
+      }
+    }
+
+    /// Takes the size of the factors and the operations of a job that factorized the matrix into the statistics.
+    template<typename MumpsStruct>
+    static void mumps_update_statistics(LinearMatrixSolverStatistics& statistics, const MumpsStruct* param, int phase)
+    {
+      if(phase != LinearMatrixSolver<double>::PROFILE_NUMERIC || param->INFOG(1) < 0)
+        return;
+      // A negative count is in millions.
+      long factor_entries = param->INFOG(29) < 0 ? -1000000L * param->INFOG(29) : param->INFOG(29);
+      long factor_space = param->INFOG(9) < 0 ? -1000000L * param->INFOG(9) : param->INFOG(9);
+      statistics.factor_nnz = factor_entries;
+      statistics.factor_memory = (size_t)factor_space * sizeof(param->a[0]);
+      statistics.flops += param->rinfog[2];
+    }
 
     template<>
     void MumpsSolver<double>::mumps_c(mumps_type<double>::mumps_struct * param)
     {
+      int phase = mumps_profile_phase(param->job);
+      Hermes::Mixins::Profile::Section profile_section(phase < 0 ? NULL : &this->profile, phase);
       dmumps_c(param);
+      mumps_update_statistics(this->statistics, param, phase);
     }
 
     template<>
     void MumpsSolver<std::complex<double> >::mumps_c(mumps_type<std::complex<double> >::mumps_struct * param)
     {
+      int phase = mumps_profile_phase(param->job);
+      Hermes::Mixins::Profile::Section profile_section(phase < 0 ? NULL : &this->profile, phase);
       zmumps_c(param);
+      mumps_update_statistics(this->statistics, param, phase);
+    }
+
+    template<>
+    void MumpsSolver<double>::mumps_c(mumps_type<double>::mumps_single_struct * param)
+    {
+      int phase = mumps_profile_phase(param->job);
+      Hermes::Mixins::Profile::Section profile_section(phase < 0 ? NULL : &this->profile, phase);
+      smumps_c(param);
+      mumps_update_statistics(this->statistics, param, phase);
+    }
+
+    template<>
+    void MumpsSolver<std::complex<double> >::mumps_c(mumps_type<std::complex<double> >::mumps_single_struct * param)
+    {
+      int phase = mumps_profile_phase(param->job);
+      Hermes::Mixins::Profile::Section profile_section(phase < 0 ? NULL : &this->profile, phase);
+      cmumps_c(param);
+      mumps_update_statistics(this->statistics, param, phase);
+    }
+
+    inline void mumps_assign_single(float & a, double b)
+    {
+      a = (float)b;
+    }
+
+    inline void mumps_assign_single(CMUMPS_COMPLEX & a, ZMUMPS_COMPLEX b)
+    {
+      a.r = (float)b.r;
+      a.i = (float)b.i;
+    }
+
+    inline void mumps_assign_single(CMUMPS_COMPLEX & a, std::complex<double> b)
+    {
+      a.r = (float)b.real();
+      a.i = (float)b.imag();
+    }
+
+    inline double mumps_single_to_Scalar(float x)
+    {
+      return x;
+    }
+
+    inline std::complex<double> mumps_single_to_Scalar(CMUMPS_COMPLEX x)
+    {
+      return std::complex<double>(x.r, x.i);
+    }
+
+    /// Specifies the matrix in the MUMPS structure, centralized or distributed (the entries [first, first + count)).
+    template<typename mumps_struct, typename mumps_Scalar>
+    static void mumps_set_matrix(mumps_struct & param, int n, unsigned int nnz, int* irn, int* jcn, mumps_Scalar* a,
+      bool distributed, unsigned int first, unsigned int count)
+    {
+      param.n = n;
+      if(distributed)
+      {
+        param.ICNTL(18) = 3; // distributed assembled matrix
+        param.nz_loc = count;
+        param.irn_loc = irn + first;
+        param.jcn_loc = jcn + first;
+        param.a_loc = a + first;
+      }
+      else
+      {
+        param.ICNTL(18) = 0; // centralized assembled matrix
+        param.nz = nnz;
+        param.irn = irn;
+        param.jcn = jcn;
+        param.a = a;
+      }
     }
 
     template<typename Scalar>
@@ -630,19 +765,63 @@ namespace Hermes
         param.ICNTL(21) = 0; // centralized dense solution
 
         // Specify the matrix.
-        param.n = m->size;
-        param.nz = m->nnz;
-        param.irn = m->irn;
-        param.jcn = m->jcn;
-        param.a = m->Ax;
+        unsigned int first, count;
+        get_local_entries(first, count);
+        mumps_set_matrix(param, m->size, m->nnz, m->irn, m->jcn, m->Ax, distributed_input, first, count);
       }
 
       return inited;
     }
 
+    template<typename Scalar>
+    bool MumpsSolver<Scalar>::check_single_status()
+    {
+      if(single_param.INFOG(1) == 0)
+        return true;
+      this->warn("Single precision factorization: INFOG(1) = %d", single_param.INFOG(1));
+      return false;
+    }
+
+    template<typename Scalar>
+    bool MumpsSolver<Scalar>::reinit_single()
+    {
+      if(single_inited)
+      {
+        single_param.job = JOB_END;
+        mumps_c(&single_param);
+      }
+
+      single_param.job = JOB_INIT;
+      single_param.par = 1; // host also performs calculations
+      single_param.sym = 0; // 0 = unsymmetric
+      single_param.comm_fortran = USE_COMM_WORLD;
+
+      mumps_c(&single_param);
+      single_inited = check_single_status();
+
+      if(single_inited)
+      {
+        // No printings.
+        single_param.ICNTL(1) = -1;
+        single_param.ICNTL(2) = -1;
+        single_param.ICNTL(3) = -1;
+        single_param.ICNTL(4) = 0;
+
+        single_param.ICNTL(20) = 0; // centralized dense RHS
+        single_param.ICNTL(21) = 0; // centralized dense solution
+
+        // Let MUMPS decide when and how to compute matrix reordering and scaling.
+        single_param.ICNTL(6) = 7;
+        single_param.ICNTL(8) = 77;
+      }
+
+      return single_inited;
+    }
+
     template<typename Scalar>
     MumpsSolver<Scalar>::MumpsSolver(MumpsMatrix<Scalar> *m, MumpsVector<Scalar> *rhs) :
-    DirectSolver<Scalar>(), m(m), rhs(rhs)
+    DirectSolver<Scalar>(), m(m), rhs(rhs), distributed_input(false), replicated_input(true), single_precision(false), max_refinement_steps(10), refinement_tolerance(1e-14),
+      num_refinement_steps(0), refinement_residual(0.0), single_Ax(NULL), single_inited(false), single_factorized(false)
     {
       inited = false;
 
@@ -651,6 +830,7 @@ namespace Hermes
       param.rhs = NULL;
       param.INFOG(33) = -999; // see the case HERMES_REUSE_MATRIX_REORDERING_AND_SCALING
       // in setup_factorization()
+      single_param.rhs = NULL;
     }
 
     template<typename Scalar>
@@ -662,8 +842,171 @@ namespace Hermes
         param.job = JOB_END;
         mumps_c(&param);
       }
+      if(single_inited)
+      {
+        single_param.job = JOB_END;
+        mumps_c(&single_param);
+      }
 
       if(param.rhs != NULL) delete [] param.rhs;
+      delete [] single_Ax;
+    }
+
+    template<typename Scalar>
+    void MumpsSolver<Scalar>::set_single_precision_factorization(bool to_set, int max_refinement_steps, double tolerance)
+    {
+      this->single_precision = to_set;
+      this->max_refinement_steps = max_refinement_steps;
+      this->refinement_tolerance = tolerance;
+    }
+
+    template<typename Scalar>
+    void MumpsSolver<Scalar>::set_distributed_input(bool to_set, bool replicated)
+    {
+      this->distributed_input = to_set;
+      this->replicated_input = replicated;
+    }
+
+    template<typename Scalar>
+    void MumpsSolver<Scalar>::get_local_entries(unsigned int& first, unsigned int& count) const
+    {
+      first = 0;
+      count = m->nnz;
+      if(!distributed_input || !replicated_input)
+        return;
+#ifdef WITH_MPI
+      int mpi_initialized;
+      MPI_Initialized(&mpi_initialized);
+      if(!mpi_initialized)
+        return;
+      int rank, num_procs;
+      MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+      MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+      first = (unsigned int)(((long long)m->nnz * rank) / num_procs);
+      count = (unsigned int)(((long long)m->nnz * (rank + 1)) / num_procs) - first;
+#endif
+    }
+
+    template<typename Scalar>
+    int MumpsSolver<Scalar>::get_num_refinement_steps() const
+    {
+      return num_refinement_steps;
+    }
+
+    template<typename Scalar>
+    double MumpsSolver<Scalar>::get_refinement_residual() const
+    {
+      return refinement_residual;
+    }
+
+    template<typename Scalar>
+    bool MumpsSolver<Scalar>::setup_single_factorization()
+    {
+      bool same_pattern = this->pattern_unchanged(m->size, m->nnz, m->irn, m->nnz, m->jcn, m->nnz);
+      if(this->factorization_scheme == HERMES_REUSE_FACTORIZATION_COMPLETELY && single_factorized && same_pattern)
+        return true;
+
+      // The single precision copy of the values, the arrays of the matrix may have been reallocated.
+      delete [] single_Ax;
+      single_Ax = new typename mumps_type<Scalar>::mumps_single_Scalar[m->nnz];
+      for (unsigned int i = 0; i < m->nnz; i++)
+        mumps_assign_single(single_Ax[i], m->Ax[i]);
+
+      if(!single_inited || !same_pattern || this->factorization_scheme == HERMES_FACTORIZE_FROM_SCRATCH)
+      {
+        if(!reinit_single())
+          return false;
+        single_param.job = JOB_ANALYZE_FACTORIZE;
+      }
+      else
+        single_param.job = JOB_FACTORIZE;
+
+      unsigned int first, count;
+      get_local_entries(first, count);
+      mumps_set_matrix(single_param, m->size, m->nnz, m->irn, m->jcn, single_Ax, distributed_input, first, count);
+
+      mumps_c(&single_param);
+      single_factorized = check_single_status();
+      return single_factorized;
+    }
+
+    template<typename Scalar>
+    bool MumpsSolver<Scalar>::solve_single_precision(Scalar* b, bool factorize)
+    {
+      this->tick();
+
+      if(factorize && !setup_single_factorization())
+        throw Hermes::Exceptions::LinearMatrixSolverException("Single precision LU factorization could not be completed.");
+
+      int n = m->size;
+      Scalar* x = new Scalar[n];
+      Scalar* r = new Scalar[n];
+      memset(x, 0, n * sizeof(Scalar));
+      memcpy(r, b, n * sizeof(Scalar));
+      typename mumps_type<Scalar>::mumps_single_Scalar* correction = new typename mumps_type<Scalar>::mumps_single_Scalar[n];
+
+      double rhs_norm = 0.0;
+      for (int i = 0; i < n; i++)
+        rhs_norm += std::abs(r[i]) * std::abs(r[i]);
+      rhs_norm = sqrt(rhs_norm);
+
+      bool ret = true;
+      num_refinement_steps = -1;
+      refinement_residual = 0.0;
+      double last_residual = 1.0;
+      while(rhs_norm > 0.0 && num_refinement_steps < max_refinement_steps)
+      {
+        // The correction with the single precision factors.
+        for (int i = 0; i < n; i++)
+          mumps_assign_single(correction[i], r[i]);
+        single_param.rhs = correction;
+        single_param.job = JOB_SOLVE;
+        mumps_c(&single_param);
+        single_param.rhs = NULL;
+        if(!(ret = check_single_status()))
+          break;
+        for (int i = 0; i < n; i++)
+          x[i] += mumps_single_to_Scalar(correction[i]);
+        num_refinement_steps++;
+
+        // The residual in double precision (MUMPS indexes from 1).
+        memcpy(r, b, n * sizeof(Scalar));
+        for (unsigned int k = 0; k < m->nnz; k++)
+          r[m->irn[k] - 1] -= mumps_to_Scalar(m->Ax[k]) * x[m->jcn[k] - 1];
+        refinement_residual = 0.0;
+        for (int i = 0; i < n; i++)
+          refinement_residual += std::abs(r[i]) * std::abs(r[i]);
+        refinement_residual = sqrt(refinement_residual) / rhs_norm;
+
+        if(refinement_residual <= refinement_tolerance)
+          break;
+        // No more progress, the accuracy of the single precision factors is exhausted.
+        if(num_refinement_steps > 0 && refinement_residual > 0.5 * last_residual)
+          break;
+        last_residual = refinement_residual;
+      }
+      if(num_refinement_steps < 0)
+        num_refinement_steps = 0;
+
+      if(ret)
+      {
+        if(refinement_residual > refinement_tolerance)
+          this->warn("MumpsSolver: the iterative refinement stopped at the relative residual %g after %d steps.", refinement_residual, num_refinement_steps);
+        else
+          this->info("MumpsSolver: %d refinement steps of the single precision solution, relative residual %g.", num_refinement_steps, refinement_residual);
+        delete [] this->sln;
+        this->sln = x;
+      }
+      else
+        delete [] x;
+
+      delete [] r;
+      delete [] correction;
+
+      this->tick();
+      this->time = this->accumulated();
+
+      return ret;
     }
 
     template<typename Scalar>
@@ -678,6 +1021,14 @@ namespace Hermes
       bool ret = false;
       assert(m != NULL);
       assert(rhs != NULL);
+      this->statistics.matrix_nnz = m->nnz;
+
+      if(single_precision)
+      {
+        if(distributed_input && !replicated_input)
+          throw Hermes::Exceptions::Exception("MumpsSolver: the single precision factorization needs the replicated matrix.");
+        return solve_single_precision(rhs->v, true);
+      }
 
       this->tick();
 
@@ -715,6 +1066,89 @@ namespace Hermes
       return ret;
     }
 
+    template<typename Scalar>
+    bool MumpsSolver<Scalar>::solve_multiple(Scalar* rhs_block, int nrhs)
+    {
+      return solve_block(rhs_block, nrhs, false);
+    }
+
+    template<typename Scalar>
+    bool MumpsSolver<Scalar>::solve_transposed(Scalar* rhs_block, int nrhs)
+    {
+      // The matrix has not changed since the last solve, the factors of A serve A^T as well.
+      unsigned int scheme = this->factorization_scheme;
+      if(inited)
+        this->factorization_scheme = HERMES_REUSE_FACTORIZATION_COMPLETELY;
+      bool ret;
+      try
+      {
+        ret = solve_block(rhs_block, nrhs, true);
+      }
+      catch(...)
+      {
+        this->factorization_scheme = scheme;
+        throw;
+      }
+      this->factorization_scheme = scheme;
+      return ret;
+    }
+
+    template<typename Scalar>
+    bool MumpsSolver<Scalar>::solve_block(Scalar* rhs_block, int nrhs, bool transposed)
+    {
+      assert(m != NULL);
+
+      if(single_precision)
+      {
+        if(transposed)
+          throw Hermes::Exceptions::Exception("MumpsSolver: the transposed solve is not available with the single precision factorization.");
+        if(distributed_input && !replicated_input)
+          throw Hermes::Exceptions::Exception("MumpsSolver: the single precision factorization needs the replicated matrix.");
+        bool ret = true;
+        for (int rhs_i = 0; rhs_i < nrhs && ret; rhs_i++)
+        {
+          ret = solve_single_precision(rhs_block + rhs_i * m->size, rhs_i == 0);
+          if(ret)
+            memcpy(rhs_block + rhs_i * m->size, this->sln, m->size * sizeof(Scalar));
+        }
+        return ret;
+      }
+
+      this->tick();
+
+      if( !setup_factorization() )
+      {
+        throw Hermes::Exceptions::LinearMatrixSolverException("LU factorization could not be completed.");
+      }
+
+      // The right-hand sides one after another (will be replaced by the solutions).
+      param.rhs = new typename mumps_type<Scalar>::mumps_Scalar[m->size * nrhs];
+      memcpy(param.rhs, rhs_block, m->size * nrhs * sizeof(Scalar));
+      param.nrhs = nrhs;
+      param.lrhs = m->size;
+
+      // Do the jobs specified in setup_factorization().
+      if(transposed)
+        param.ICNTL(9) = 0;
+      mumps_c(&param);
+      param.ICNTL(9) = 1;
+      param.nrhs = 1;
+
+      bool ret = check_status();
+
+      if(ret)
+        for (unsigned int i = 0; i < m->size * nrhs; i++)
+          rhs_block[i] = mumps_to_Scalar(param.rhs[i]);
+
+      delete [] param.rhs;
+      param.rhs = NULL;
+
+      this->tick();
+      this->time = this->accumulated();
+
+      return ret;
+    }
+
     template<typename Scalar>
     bool MumpsSolver<Scalar>::setup_factorization()
     {
@@ -726,6 +1160,17 @@ namespace Hermes
           this->factorization_scheme == HERMES_REUSE_FACTORIZATION_COMPLETELY )
           eff_fact_scheme = HERMES_FACTORIZE_FROM_SCRATCH;
 
+      // Only the values changed since the last analysis: redo just the numerical factorization
+      // (the arrays of the matrix may have been reallocated, so they are passed again).
+      bool same_pattern = this->pattern_unchanged(m->size, m->nnz, m->irn, m->nnz, m->jcn, m->nnz);
+      if(eff_fact_scheme == HERMES_FACTORIZE_FROM_SCRATCH && inited && same_pattern)
+      {
+        eff_fact_scheme = HERMES_REUSE_MATRIX_REORDERING;
+        unsigned int first, count;
+        get_local_entries(first, count);
+        mumps_set_matrix(param, m->size, m->nnz, m->irn, m->jcn, m->Ax, distributed_input, first, count);
+      }
+
       switch (eff_fact_scheme)
       {
       case HERMES_FACTORIZE_FROM_SCRATCH:
@@ -56,9 +56,10 @@ namespace Hermes
     template<typename Scalar>
     void NonlinearSolver<Scalar>::set_iterative_method(const char* iterative_method_name)
     {
-      if(Hermes::HermesCommonApi.get_integral_param_value(Hermes::matrixSolverType) != SOLVER_AZTECOO)
+      int solver_type = Hermes::HermesCommonApi.get_integral_param_value(Hermes::matrixSolverType);
+      if(solver_type != SOLVER_AZTECOO && solver_type != SOLVER_KRYLOV)
       {
-        this->warn("Trying to set iterative method for a different solver than AztecOO.");
+        this->warn("Trying to set iterative method for a different solver than AztecOO or the built-in Krylov solvers.");
         return;
       }
       else
@@ -70,9 +71,10 @@ namespace Hermes
     template<typename Scalar>
     void NonlinearSolver<Scalar>::set_preconditioner(const char* preconditioner_name)
     {
-      if(Hermes::HermesCommonApi.get_integral_param_value(Hermes::matrixSolverType) != SOLVER_AZTECOO)
+      int solver_type = Hermes::HermesCommonApi.get_integral_param_value(Hermes::matrixSolverType);
+      if(solver_type != SOLVER_AZTECOO && solver_type != SOLVER_KRYLOV)
       {
-        this->warn("Trying to set iterative method for a different solver than AztecOO.");
+        this->warn("Trying to set iterative method for a different solver than AztecOO or the built-in Krylov solvers.");
         return;
       }
       else
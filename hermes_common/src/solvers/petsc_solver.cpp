@@ -99,33 +99,26 @@ namespace Hermes
     template<typename Scalar>
     void PetscMatrix<Scalar>::alloc()
     {
-      assert(this->pages != NULL);
+      // sort the indices and remove duplicities, PETSc preallocates by rows
+      int *row_starts = new int[this->size + 1];
+      int *aj = this->compress_indices_by_rows(row_starts);
 
-      // calc nnz
+      // the exact number of nonzeros of every row
       int *nnz_array = new int[this->size];
-
-      // fill in nnz_array
-      int aisize = this->get_num_indices();
-      int *ai = new int[aisize];
-
-      // sort the indices and remove duplicities, insert into ai
-      int pos = 0;
       for (unsigned int i = 0; i < this->size; i++)
-      {
-        nnz_array[i] = sort_and_store_indices(this->pages[i], ai + pos, ai + aisize);
-        pos += nnz_array[i];
-      }
+        nnz_array[i] = row_starts[i + 1] - row_starts[i];
       // stote the number of nonzeros
-      nnz = pos;
-      delete [] this->pages; this->pages = NULL;
-      delete [] ai;
+      nnz = row_starts[this->size];
 
-      //
+      // preallocate exactly and set the sparse structure right away, so that no entry is inserted while assembling
       MatCreateSeqAIJ(PETSC_COMM_SELF, this->size, this->size, 0, nnz_array, &matrix);
+      MatSeqAIJSetColumnIndices(matrix, (PetscInt*) aj);
       //  MatSetOption(matrix, MAT_ROW_ORIENTED);
       //  MatSetOption(matrix, MAT_ROWS_SORTED);
 
       delete [] nnz_array;
+      delete [] row_starts;
+      delete [] aj;
 
       inited = true;
     }
@@ -522,6 +515,13 @@ namespace Hermes
       vec_get_value(x, m->size, idx, this->sln);
       delete [] idx;
 
+      PetscInt num_iters;
+      KSPGetIterationNumber(ksp, &num_iters);
+      this->statistics.num_iterations += num_iters;
+      PetscReal residual_norm;
+      KSPGetResidualNorm(ksp, &residual_norm);
+      this->statistics.residual = residual_norm;
+
       KSPDestroy(ksp);
       VecDestroy(x);
 
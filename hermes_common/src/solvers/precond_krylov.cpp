@@ -0,0 +1,291 @@
+// This file is part of HermesCommon
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+/*! \file precond_krylov.cpp
+\brief Preconditioners of the built-in Krylov solvers (Jacobi, ILU(0), block-Jacobi).
+*/
+#include "precond_krylov.h"
+
+namespace Hermes
+{
+  namespace Preconditioners
+  {
+    template<typename Scalar>
+    KrylovPrecond<Scalar>::KrylovPrecond() : mat(NULL)
+    {
+    }
+
+    template<typename Scalar>
+    KrylovPrecond<Scalar>::~KrylovPrecond()
+    {
+    }
+
+    template<typename Scalar>
+    void KrylovPrecond<Scalar>::create(Matrix<Scalar> *m)
+    {
+      CSRMatrix<Scalar>* csr = dynamic_cast<CSRMatrix<Scalar>*>(m);
+      if(csr == NULL)
+        throw Hermes::Exceptions::Exception("The preconditioners of KrylovSolver need a CSRMatrix.");
+      mat = csr;
+    }
+
+    template<typename Scalar>
+    void KrylovPrecond<Scalar>::destroy()
+    {
+      free();
+      mat = NULL;
+    }
+
+#ifdef HAVE_EPETRA
+    template<typename Scalar>
+    Epetra_Operator *KrylovPrecond<Scalar>::get_obj()
+    {
+      return NULL;
+    }
+
+    template<typename Scalar>
+    const Epetra_Comm &KrylovPrecond<Scalar>::Comm() const
+    {
+      throw Hermes::Exceptions::Exception("KrylovPrecond can not be used with Epetra.");
+    }
+
+    template<typename Scalar>
+    const Epetra_Map &KrylovPrecond<Scalar>::OperatorDomainMap() const
+    {
+      throw Hermes::Exceptions::Exception("KrylovPrecond can not be used with Epetra.");
+    }
+
+    template<typename Scalar>
+    const Epetra_Map &KrylovPrecond<Scalar>::OperatorRangeMap() const
+    {
+      throw Hermes::Exceptions::Exception("KrylovPrecond can not be used with Epetra.");
+    }
+#endif
+
+    template<typename Scalar>
+    JacobiPrecond<Scalar>::JacobiPrecond() : KrylovPrecond<Scalar>(), inv_diag(NULL)
+    {
+    }
+
+    template<typename Scalar>
+    JacobiPrecond<Scalar>::~JacobiPrecond()
+    {
+      free();
+    }
+
+    template<typename Scalar>
+    void JacobiPrecond<Scalar>::free()
+    {
+      delete [] inv_diag;
+      inv_diag = NULL;
+    }
+
+    template<typename Scalar>
+    void JacobiPrecond<Scalar>::compute()
+    {
+      assert(this->mat != NULL);
+      free();
+      int n = this->mat->get_size();
+      inv_diag = new Scalar[n];
+      for (int i = 0; i < n; i++)
+      {
+        Scalar d = this->mat->get(i, i);
+        inv_diag[i] = (d == 0.0) ? Scalar(1.0) : Scalar(1.0) / d;
+      }
+    }
+
+    template<typename Scalar>
+    void JacobiPrecond<Scalar>::apply(Scalar* r, Scalar* z)
+    {
+      int n = this->mat->get_size();
+#pragma omp parallel for schedule(static)
+      for (int i = 0; i < n; i++)
+        z[i] = inv_diag[i] * r[i];
+    }
+
+    template<typename Scalar>
+    ILU0Precond<Scalar>::ILU0Precond() : KrylovPrecond<Scalar>(), num_blocks(1), block_starts(NULL), lu(NULL), diag(NULL)
+    {
+    }
+
+    template<typename Scalar>
+    ILU0Precond<Scalar>::~ILU0Precond()
+    {
+      free();
+    }
+
+    template<typename Scalar>
+    void ILU0Precond<Scalar>::free()
+    {
+      delete [] block_starts;
+      block_starts = NULL;
+      delete [] lu;
+      lu = NULL;
+      delete [] diag;
+      diag = NULL;
+    }
+
+    template<typename Scalar>
+    void ILU0Precond<Scalar>::compute()
+    {
+      assert(this->mat != NULL);
+      free();
+      int n = this->mat->get_size();
+      int nnz = this->mat->get_nnz();
+
+      if(num_blocks > n)
+        num_blocks = n > 0 ? n : 1;
+      block_starts = new int[num_blocks + 1];
+      for (int i = 0; i <= num_blocks; i++)
+        block_starts[i] = (int)(((long long)n * i) / num_blocks);
+
+      lu = new Scalar[nnz];
+      memcpy(lu, this->mat->get_Ax(), nnz * sizeof(Scalar));
+      diag = new int[n];
+
+      int* iw = new int[n];
+      for (int i = 0; i < n; i++)
+        iw[i] = -1;
+
+      // The blocks touch disjoint rows of lu and disjoint parts of iw.
+      int failed_row = -1;
+#pragma omp parallel for schedule(static, 1)
+      for (int block_i = 0; block_i < num_blocks; block_i++)
+      {
+        int row = factorize_block(block_starts[block_i], block_starts[block_i + 1], iw);
+        if(row >= 0)
+        {
+#pragma omp critical(ILU0Precond_failed_row)
+          failed_row = row;
+        }
+      }
+
+      delete [] iw;
+
+      if(failed_row >= 0)
+        throw Hermes::Exceptions::Exception("ILU(0) preconditioner: zero or missing pivot in row %d.", failed_row);
+    }
+
+    template<typename Scalar>
+    int ILU0Precond<Scalar>::factorize_block(int row_begin, int row_end, int* iw)
+    {
+      int* Ap = this->mat->get_Ap();
+      int* Ai = this->mat->get_Ai();
+
+      for (int i = row_begin; i < row_end; i++)
+      {
+        diag[i] = -1;
+        for (int k = Ap[i]; k < Ap[i + 1]; k++)
+        {
+          if(Ai[k] == i)
+            diag[i] = k;
+          if(Ai[k] >= row_begin && Ai[k] < row_end)
+            iw[Ai[k]] = k;
+        }
+        if(diag[i] < 0)
+        {
+          for (int k = Ap[i]; k < Ap[i + 1]; k++)
+            if(Ai[k] >= row_begin && Ai[k] < row_end)
+              iw[Ai[k]] = -1;
+          return i;
+        }
+
+        // Eliminate the entries left of the diagonal by the rows above.
+        for (int k = Ap[i]; k < diag[i]; k++)
+        {
+          int row = Ai[k];
+          if(row < row_begin)
+            continue;
+          lu[k] /= lu[diag[row]];
+          for (int l = diag[row] + 1; l < Ap[row + 1]; l++)
+          {
+            int col = Ai[l];
+            if(col < row_end && iw[col] >= 0)
+              lu[iw[col]] -= lu[k] * lu[l];
+          }
+        }
+
+        for (int k = Ap[i]; k < Ap[i + 1]; k++)
+          if(Ai[k] >= row_begin && Ai[k] < row_end)
+            iw[Ai[k]] = -1;
+
+        if(lu[diag[i]] == 0.0)
+          return i;
+      }
+      return -1;
+    }
+
+    template<typename Scalar>
+    void ILU0Precond<Scalar>::solve_block(int row_begin, int row_end, Scalar* r, Scalar* z)
+    {
+      int* Ap = this->mat->get_Ap();
+      int* Ai = this->mat->get_Ai();
+
+      // L y = r, L having a unit diagonal.
+      for (int i = row_begin; i < row_end; i++)
+      {
+        Scalar sum = r[i];
+        for (int k = Ap[i]; k < diag[i]; k++)
+          if(Ai[k] >= row_begin)
+            sum -= lu[k] * z[Ai[k]];
+        z[i] = sum;
+      }
+
+      // U z = y.
+      for (int i = row_end - 1; i >= row_begin; i--)
+      {
+        Scalar sum = z[i];
+        for (int k = diag[i] + 1; k < Ap[i + 1]; k++)
+          if(Ai[k] < row_end)
+            sum -= lu[k] * z[Ai[k]];
+        z[i] = sum / lu[diag[i]];
+      }
+    }
+
+    template<typename Scalar>
+    void ILU0Precond<Scalar>::apply(Scalar* r, Scalar* z)
+    {
+#pragma omp parallel for schedule(static, 1)
+      for (int block_i = 0; block_i < num_blocks; block_i++)
+        solve_block(block_starts[block_i], block_starts[block_i + 1], r, z);
+    }
+
+    template<typename Scalar>
+    BlockJacobiPrecond<Scalar>::BlockJacobiPrecond(int num_blocks) : ILU0Precond<Scalar>(), requested_blocks(num_blocks)
+    {
+    }
+
+    template<typename Scalar>
+    void BlockJacobiPrecond<Scalar>::compute()
+    {
+      this->num_blocks = requested_blocks > 0 ? requested_blocks : omp_get_max_threads();
+      if(this->num_blocks < 1)
+        this->num_blocks = 1;
+      ILU0Precond<Scalar>::compute();
+    }
+
+    template class HERMES_API KrylovPrecond<double>;
+    template class HERMES_API KrylovPrecond<std::complex<double> >;
+    template class HERMES_API JacobiPrecond<double>;
+    template class HERMES_API JacobiPrecond<std::complex<double> >;
+    template class HERMES_API ILU0Precond<double>;
+    template class HERMES_API ILU0Precond<std::complex<double> >;
+    template class HERMES_API BlockJacobiPrecond<double>;
+    template class HERMES_API BlockJacobiPrecond<std::complex<double> >;
+  }
+}
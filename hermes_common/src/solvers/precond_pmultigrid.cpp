@@ -0,0 +1,350 @@
+// This file is part of HermesCommon
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+/*! \file precond_pmultigrid.cpp
+\brief p-multigrid preconditioner for hierarchic bases.
+*/
+#include "precond_pmultigrid.h"
+
+namespace Hermes
+{
+  namespace Preconditioners
+  {
+    template<typename Scalar>
+    PMultigridPrecond<Scalar>::PMultigridPrecond(const int* dof_orders, int ndof, int num_smoothing_steps)
+      : KrylovPrecond<Scalar>(), ndof(ndof), num_smoothing_steps(num_smoothing_steps), num_levels(0),
+      level_mats(NULL), coarse_index(NULL), smoothers(NULL), x(NULL), b(NULL), r(NULL), e(NULL),
+#ifdef WITH_UMFPACK
+      coarse_matrix(NULL), coarse_rhs(NULL),
+#endif
+      coarse_solver(NULL)
+    {
+      if(num_smoothing_steps < 1)
+        throw Hermes::Exceptions::ValueException("num_smoothing_steps", num_smoothing_steps, 1);
+      this->dof_orders = new int[ndof];
+      memcpy(this->dof_orders, dof_orders, ndof * sizeof(int));
+    }
+
+    template<typename Scalar>
+    PMultigridPrecond<Scalar>::~PMultigridPrecond()
+    {
+      free();
+      delete [] dof_orders;
+    }
+
+    template<typename Scalar>
+    void PMultigridPrecond<Scalar>::free()
+    {
+      for (int level = 0; level < num_levels; level++)
+      {
+        // The finest level is the matrix itself.
+        if(level < num_levels - 1)
+          delete level_mats[level];
+        if(level > 0)
+        {
+          delete [] coarse_index[level];
+          delete smoothers[level];
+        }
+        delete [] x[level];
+        delete [] b[level];
+        delete [] r[level];
+        delete [] e[level];
+      }
+      delete [] level_mats;
+      delete [] coarse_index;
+      delete [] smoothers;
+      delete [] x;
+      delete [] b;
+      delete [] r;
+      delete [] e;
+      level_mats = NULL;
+      coarse_index = NULL;
+      smoothers = NULL;
+      x = b = r = e = NULL;
+      num_levels = 0;
+
+      delete coarse_solver;
+      coarse_solver = NULL;
+#ifdef WITH_UMFPACK
+      delete coarse_matrix;
+      coarse_matrix = NULL;
+      delete coarse_rhs;
+      coarse_rhs = NULL;
+#endif
+    }
+
+    template<typename Scalar>
+    int PMultigridPrecond<Scalar>::get_num_levels() const
+    {
+      return num_levels;
+    }
+
+    template<typename Scalar>
+    void PMultigridPrecond<Scalar>::compute()
+    {
+      assert(this->mat != NULL);
+      free();
+      int n = this->mat->get_size();
+      if(n != ndof)
+        throw Hermes::Exceptions::Exception("p-multigrid preconditioner: %d DOF orders given for a matrix of size %d.", ndof, n);
+
+      // The levels are the distinct orders.
+      int max_order = 0;
+      for (int i = 0; i < n; i++)
+      {
+        if(dof_orders[i] < 0)
+          throw Hermes::Exceptions::Exception("p-multigrid preconditioner: negative order of the DOF %d.", i);
+        if(dof_orders[i] > max_order)
+          max_order = dof_orders[i];
+      }
+      bool* present = new bool[max_order + 1];
+      memset(present, 0, (max_order + 1) * sizeof(bool));
+      for (int i = 0; i < n; i++)
+        present[dof_orders[i]] = true;
+      int* level_orders = new int[max_order + 1];
+      for (int order = 0; order <= max_order; order++)
+        if(present[order])
+          level_orders[num_levels++] = order;
+      delete [] present;
+      if(n == 0)
+        num_levels = 0;
+
+      level_mats = new CSRMatrix<Scalar>*[num_levels];
+      coarse_index = new int*[num_levels];
+      smoothers = new BlockJacobiPrecond<Scalar>*[num_levels];
+      x = new Scalar*[num_levels];
+      b = new Scalar*[num_levels];
+      r = new Scalar*[num_levels];
+      e = new Scalar*[num_levels];
+
+      int* Ap = this->mat->get_Ap();
+      int* Ai = this->mat->get_Ai();
+      Scalar* Ax = this->mat->get_Ax();
+
+      // Index of every DOF of the matrix on the current level and on the finer one (-1 if not there).
+      int* local = new int[n];
+      int* finer_local = new int[n];
+      for (int level = num_levels - 1; level >= 0; level--)
+      {
+        int level_size = 0;
+        for (int i = 0; i < n; i++)
+          local[i] = dof_orders[i] <= level_orders[level] ? level_size++ : -1;
+
+        if(level == num_levels - 1)
+          level_mats[level] = this->mat;
+        else
+        {
+          // The submatrix, the columns stay sorted as the numbering keeps the order of the DOFs.
+          int* level_Ap = new int[level_size + 1];
+          int level_nnz = 0;
+          level_Ap[0] = 0;
+          for (int i = 0; i < n; i++)
+          {
+            if(local[i] < 0)
+              continue;
+            for (int k = Ap[i]; k < Ap[i + 1]; k++)
+              if(local[Ai[k]] >= 0)
+                level_nnz++;
+            level_Ap[local[i] + 1] = level_nnz;
+          }
+          int* level_Ai = new int[level_nnz];
+          Scalar* level_Ax = new Scalar[level_nnz];
+          int pos = 0;
+          for (int i = 0; i < n; i++)
+          {
+            if(local[i] < 0)
+              continue;
+            for (int k = Ap[i]; k < Ap[i + 1]; k++)
+              if(local[Ai[k]] >= 0)
+              {
+                level_Ai[pos] = local[Ai[k]];
+                level_Ax[pos++] = Ax[k];
+              }
+          }
+          level_mats[level] = new CSRMatrix<Scalar>();
+          level_mats[level]->create(level_size, level_nnz, level_Ap, level_Ai, level_Ax);
+          delete [] level_Ap;
+          delete [] level_Ai;
+          delete [] level_Ax;
+
+          // The finer level knows where its DOFs are on this one.
+          int finer_size = level_mats[level + 1]->get_size();
+          coarse_index[level + 1] = new int[finer_size];
+          for (int i = 0; i < n; i++)
+            if(finer_local[i] >= 0)
+              coarse_index[level + 1][finer_local[i]] = local[i];
+        }
+
+        if(level > 0)
+        {
+          smoothers[level] = new BlockJacobiPrecond<Scalar>();
+          smoothers[level]->create(level_mats[level]);
+          smoothers[level]->compute();
+        }
+
+        x[level] = new Scalar[level_size];
+        b[level] = new Scalar[level_size];
+        r[level] = new Scalar[level_size];
+        e[level] = new Scalar[level_size];
+
+        int* tmp = finer_local;
+        finer_local = local;
+        local = tmp;
+      }
+      delete [] local;
+      delete [] finer_local;
+      delete [] level_orders;
+
+      if(num_levels == 0)
+        return;
+
+#ifdef WITH_UMFPACK
+      // UMFPACK needs the transpose of the CSR arrays, the factorization is computed in the first solve and then kept.
+      CSRMatrix<Scalar>* coarse = level_mats[0];
+      int coarse_size = coarse->get_size();
+      int coarse_nnz = coarse->get_nnz();
+      int* csc_Ap = new int[coarse_size + 1];
+      int* csc_Ai = new int[coarse_nnz];
+      Scalar* csc_Ax = new Scalar[coarse_nnz];
+      memset(csc_Ap, 0, (coarse_size + 1) * sizeof(int));
+      for (int k = 0; k < coarse_nnz; k++)
+        csc_Ap[coarse->get_Ai()[k] + 1]++;
+      for (int j = 0; j < coarse_size; j++)
+        csc_Ap[j + 1] += csc_Ap[j];
+      int* next = new int[coarse_size];
+      memcpy(next, csc_Ap, coarse_size * sizeof(int));
+      for (int i = 0; i < coarse_size; i++)
+        for (int k = coarse->get_Ap()[i]; k < coarse->get_Ap()[i + 1]; k++)
+        {
+          int pos = next[coarse->get_Ai()[k]]++;
+          csc_Ai[pos] = i;
+          csc_Ax[pos] = coarse->get_Ax()[k];
+        }
+      delete [] next;
+
+      coarse_matrix = new UMFPackMatrix<Scalar>();
+      coarse_matrix->create(coarse_size, coarse_nnz, csc_Ap, csc_Ai, csc_Ax);
+      delete [] csc_Ap;
+      delete [] csc_Ai;
+      delete [] csc_Ax;
+      coarse_rhs = new UMFPackVector<Scalar>(coarse_size);
+      coarse_solver = new Hermes::Solvers::UMFPackLinearMatrixSolver<Scalar>(coarse_matrix, coarse_rhs);
+      coarse_solver->set_factorization_scheme(HERMES_REUSE_FACTORIZATION_COMPLETELY);
+#else
+      coarse_solver = new ILU0Precond<Scalar>();
+      coarse_solver->create(level_mats[0]);
+      coarse_solver->compute();
+#endif
+    }
+
+    template<typename Scalar>
+    void PMultigridPrecond<Scalar>::residual(int level)
+    {
+      int size = level_mats[level]->get_size();
+      Scalar* level_r = r[level];
+      Scalar* level_b = b[level];
+      level_mats[level]->multiply_with_vector(x[level], level_r);
+#pragma omp parallel for schedule(static)
+      for (int i = 0; i < size; i++)
+        level_r[i] = level_b[i] - level_r[i];
+    }
+
+    template<typename Scalar>
+    void PMultigridPrecond<Scalar>::smooth(int level, bool zero_start)
+    {
+      int size = level_mats[level]->get_size();
+      Scalar* level_x = x[level];
+      Scalar* level_e = e[level];
+      for (int step = 0; step < num_smoothing_steps; step++)
+      {
+        if(step == 0 && zero_start)
+        {
+          smoothers[level]->apply(b[level], level_x);
+          continue;
+        }
+        residual(level);
+        smoothers[level]->apply(r[level], level_e);
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < size; i++)
+          level_x[i] += level_e[i];
+      }
+    }
+
+    template<typename Scalar>
+    void PMultigridPrecond<Scalar>::solve_coarse()
+    {
+#ifdef WITH_UMFPACK
+      int size = level_mats[0]->get_size();
+      memcpy(x[0], b[0], size * sizeof(Scalar));
+      if(!coarse_solver->solve_multiple(x[0], 1))
+        throw Hermes::Exceptions::Exception("p-multigrid preconditioner: the coarsest level could not be solved.");
+#else
+      coarse_solver->apply(b[0], x[0]);
+#endif
+    }
+
+    template<typename Scalar>
+    void PMultigridPrecond<Scalar>::cycle(int level)
+    {
+      if(level == 0)
+      {
+        solve_coarse();
+        return;
+      }
+
+      int size = level_mats[level]->get_size();
+      int* index = coarse_index[level];
+      Scalar* level_x = x[level];
+      Scalar* level_r = r[level];
+      Scalar* coarse_x = x[level - 1];
+      Scalar* coarse_b = b[level - 1];
+
+      smooth(level, true);
+
+      // Restriction and prolongation of the correction are the selection of the coarse DOFs.
+      residual(level);
+#pragma omp parallel for schedule(static)
+      for (int i = 0; i < size; i++)
+        if(index[i] >= 0)
+          coarse_b[index[i]] = level_r[i];
+
+      cycle(level - 1);
+
+#pragma omp parallel for schedule(static)
+      for (int i = 0; i < size; i++)
+        if(index[i] >= 0)
+          level_x[i] += coarse_x[index[i]];
+
+      smooth(level, false);
+    }
+
+    template<typename Scalar>
+    void PMultigridPrecond<Scalar>::apply(Scalar* r, Scalar* z)
+    {
+      if(num_levels == 0)
+        return;
+      int n = this->mat->get_size();
+      memcpy(b[num_levels - 1], r, n * sizeof(Scalar));
+      cycle(num_levels - 1);
+      memcpy(z, x[num_levels - 1], n * sizeof(Scalar));
+    }
+
+    template class HERMES_API PMultigridPrecond<double>;
+    template class HERMES_API PMultigridPrecond<std::complex<double> >;
+  }
+}
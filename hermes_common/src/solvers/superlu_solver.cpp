@@ -131,29 +131,20 @@ namespace Hermes
     template<typename Scalar>
     void SuperLUMatrix<Scalar>::alloc()
     {
-      assert(this->pages != NULL);
-
       // Initialize the arrays Ap and Ai.
-      Ap = new unsigned int[this->size + 1];
-      int aisize = this->get_num_indices();
-      Ai = new int[aisize];
-
       // sort the indices and remove duplicities, insert into Ai
-      unsigned int i, pos = 0;
-      for (i = 0; i < this->size; i++)
-      {
-        Ap[i] = pos;
-        pos += sort_and_store_indices(this->pages[i], Ai + pos, Ai + aisize);
-      }
-      Ap[i] = pos;
-
-      delete [] this->pages;
-      this->pages = NULL;
+      int *col_starts = new int[this->size + 1];
+      Ai = this->compress_indices(col_starts);
+      Ap = new unsigned int[this->size + 1];
+      for (unsigned int i = 0; i <= this->size; i++)
+        Ap[i] = col_starts[i];
+      delete [] col_starts;
 
       nnz = Ap[this->size];
 
       Ax = new Scalar[nnz];
       memset(Ax, 0, sizeof(Scalar) * nnz);
+      this->set_memory_size((this->size + 1) * sizeof(unsigned int) + nnz * (sizeof(int) + sizeof(Scalar)));
     }
 
     template<typename Scalar>
@@ -163,6 +154,7 @@ namespace Hermes
       delete [] Ap; Ap = NULL;
       delete [] Ai; Ai = NULL;
       delete [] Ax; Ax = NULL;
+      this->set_memory_size(0);
     }
 
     template<typename Scalar>
@@ -254,6 +246,10 @@ namespace Hermes
           return true;
         }
 
+      case DF_MATRIX_MARKET_BIN:
+      case DF_HDF5:
+        return dump_compressed_binary(file, var_name, fmt, this->size, nnz, (const int*)Ap, Ai, Ax);
+
       default:
         return false;
       }
@@ -283,6 +279,12 @@ namespace Hermes
       add_as_block(0, 0, mat);
     }
 
+    template<typename Scalar>
+    void SuperLUMatrix<Scalar>::add_sparse_matrix(SparseMatrix<Scalar>* mat)
+    {
+      add_matrix(static_cast<SuperLUMatrix*>(mat));
+    }
+
     template<typename Scalar>
     void SuperLUMatrix<Scalar>::add_to_diagonal_blocks(int num_stages, SuperLUMatrix<Scalar>* mat)
     {
@@ -347,6 +349,13 @@ namespace Hermes
         Ax[i] = Ax[i]*value;
       }
     }
+
+    template<typename Scalar>
+    void SuperLUMatrix<Scalar>::sum_over_processes()
+    {
+      sum_values_over_processes<Scalar>(Ax, nnz);
+    }
+
     // Creates matrix using size, nnz, and the three arrays.
 
     template<typename Scalar>
@@ -367,6 +376,7 @@ namespace Hermes
         this->Ax[i] = ax[i];
         this->Ai[i] = ai[i];
       }
+      this->set_memory_size((this->size + 1) * sizeof(unsigned int) + nnz * (sizeof(int) + sizeof(Scalar)));
     }
     // Duplicates a matrix (including allocation).
 
@@ -389,6 +399,7 @@ namespace Hermes
       {
         nmat->Ap[i] = Ap[i];
       }
+      nmat->set_memory_size((this->size + 1) * sizeof(unsigned int) + nnz * (sizeof(int) + sizeof(Scalar)));
       return nmat;
     }
 
@@ -469,6 +480,12 @@ namespace Hermes
       memcpy(v, this->v, this->size * sizeof(Scalar));
     }
 
+    template<typename Scalar>
+    const Scalar* SuperLUVector<Scalar>::get_values() const
+    {
+      return this->v;
+    }
+
     template<typename Scalar>
     void SuperLUVector<Scalar>::add_vector(Vector<Scalar>* vec)
     {
@@ -516,6 +533,10 @@ namespace Hermes
           return true;
         }
 
+      case DF_MATRIX_MARKET_BIN:
+      case DF_HDF5:
+        return dump_vector_binary(file, var_name, fmt, this->size, v);
+
       default:
         return false;
       }
@@ -651,6 +672,28 @@ namespace Hermes
       assert(m != NULL);
       assert(rhs != NULL);
 
+      Scalar* solution = new Scalar[m->size];
+      bool factorized = solve_rhs(rhs->v, 1, solution);
+      if(factorized)
+      {
+        delete [] this->sln;
+        this->sln = solution;
+      }
+      else
+        delete [] solution;
+      return factorized;
+    }
+
+    template<typename Scalar>
+    bool SuperLUSolver<Scalar>::solve_multiple(Scalar* rhs_block, int nrhs)
+    {
+      assert(m != NULL);
+      return solve_rhs(rhs_block, nrhs, rhs_block);
+    }
+
+    template<typename Scalar>
+    bool SuperLUSolver<Scalar>::solve_rhs(Scalar* rhs_values, int nrhs, Scalar* solutions)
+    {
       this->tick();
 
       // Initialize the statistics variable.
@@ -663,9 +706,9 @@ namespace Hermes
       // (unused, see below).
       int lwork = 0;            // Space for the factorization will be allocated
       // internally by system malloc.
-      double ferr = 1.0;        // Estimated relative forward error
+      double* ferr = new double[nrhs];  // Estimated relative forward errors
       // (unused unless iterative refinement is performed).
-      double berr = 1.0;        // Estimated relative backward error
+      double* berr = new double[nrhs];  // Estimated relative backward errors
       // (unused unless iterative refinement is performed).
       slu_memusage_t memusage;  // Record the memory usage statistics.
       double rpivot_growth;     // The reciprocal pivot growth factor.
@@ -678,6 +721,8 @@ namespace Hermes
       if( !setup_factorization() )
       {
         this->warn("LU factorization could not be completed.");
+        delete [] ferr;
+        delete [] berr;
         return false;
       }
 
@@ -718,20 +763,20 @@ namespace Hermes
       free_rhs();
 
       if(local_rhs) delete [] local_rhs;
-      local_rhs = new typename SuperLuType<Scalar>::Scalar[rhs->size];
-      for (unsigned int i = 0;i<rhs->size;i++)
-        to_superlu(local_rhs[i], rhs->v[i]);
+      local_rhs = new typename SuperLuType<Scalar>::Scalar[m->size * nrhs];
+      for (unsigned int i = 0; i < m->size * nrhs; i++)
+        to_superlu(local_rhs[i], rhs_values[i]);
 
-      create_dense_matrix(&B, rhs->size, 1, local_rhs, rhs->size, SLU_DN, SLU_DTYPE, SLU_GE);
+      create_dense_matrix(&B, m->size, nrhs, local_rhs, m->size, SLU_DN, SLU_DTYPE, SLU_GE);
 
       has_B = true;
 
       // Initialize the solution variable.
       SuperMatrix X;
       typename SuperLuType<Scalar>::Scalar *x;
-      if( !(x = new typename SuperLuType<Scalar>::Scalar[m->size]) )
+      if( !(x = new typename SuperLuType<Scalar>::Scalar[m->size * nrhs]) )
         throw Hermes::Exceptions::Exception("Malloc fails for x[].");
-      create_dense_matrix(&X, m->size, 1, x, m->size, SLU_DN, SLU_DTYPE, SLU_GE);
+      create_dense_matrix(&X, m->size, nrhs, x, m->size, SLU_DN, SLU_DTYPE, SLU_GE);
 
       // Solve the system.
       int info;
@@ -744,6 +789,7 @@ namespace Hermes
         //  1: minimum degree ordering on structure of A'*A
         //  2: minimum degree ordering on structure of A' + A
         //  3: approximate minimum degree for unsymmetric matrices
+        Hermes::Mixins::Profile::Section profile_section(&this->profile, this->PROFILE_SYMBOLIC);
         get_perm_c(1, &A, perm_c);
       }
 
@@ -753,7 +799,7 @@ namespace Hermes
       // Memory usage will be acquired at the end. If A is singular, info will be set to A->ncol + 1.
       //
       slu_mt_solver_driver( &options, &A, perm_c, perm_r, &AC, &equed, R, C,
-      &L, &U, &B, &X, &rpivot_growth, &rcond, &ferr, &berr,
+      &L, &U, &B, &X, &rpivot_growth, &rcond, ferr, berr,
       &stat, &memusage, &info );
       */
 
@@ -762,9 +808,13 @@ namespace Hermes
       // Estimate reciprocal condition number of A and solve the system. If A is singular, info
       // will be set to A->ncol + 1.
       //
-      slu_mt_solver_driver( &options, &A, perm_c, perm_r, &AC, &equed, R, C,
-        &L, &U, &B, &X, NULL, &rcond, NULL, NULL,
-        &stat, NULL, &info );
+      {
+        // The driver factorizes and solves at once.
+        Hermes::Mixins::Profile::Section profile_section(&this->profile, this->PROFILE_NUMERIC);
+        slu_mt_solver_driver( &options, &A, perm_c, perm_r, &AC, &equed, R, C,
+          &L, &U, &B, &X, NULL, &rcond, NULL, NULL,
+          &stat, NULL, &info );
+      }
 
       // ... OR ...
 
@@ -776,9 +826,13 @@ namespace Hermes
       &stat, NULL, &info );
       */
 #else
-      solver_driver(&options, &A, perm_c, perm_r, etree, equed, R, C, &L, &U,
-        work, lwork, &B, &X, &rpivot_growth, &rcond, &ferr, &berr,
-        &memusage, &stat, &info);
+      {
+        // The driver factorizes and solves at once.
+        Hermes::Mixins::Profile::Section profile_section(&this->profile, this->PROFILE_NUMERIC);
+        solver_driver(&options, &A, perm_c, perm_r, etree, equed, R, C, &L, &U,
+          work, lwork, &B, &X, &rpivot_growth, &rcond, ferr, berr,
+          &memusage, &stat, &info);
+      }
 #endif
 
       // A and B may have been multiplied by the scaling vectors R and C on the output of the
@@ -795,22 +849,32 @@ namespace Hermes
 
       if(factorized)
       {
-        delete [] this->sln;
-        this->sln = new Scalar[m->size];
-
         Scalar *sol = (Scalar*) ((DNformat*) X.Store)->nzval;
 
-        for (unsigned int i = 0; i < rhs->size; i++)
-          this->sln[i] = sol[i];
+        for (unsigned int i = 0; i < m->size * nrhs; i++)
+          solutions[i] = sol[i];
       }
 
+      this->statistics.matrix_nnz = m->nnz;
+#ifndef SLU_MT
+      // The multithreaded driver is not asked for the memory usage.
+      if(factorized && options.Fact != FACTORED)
+      {
+        this->statistics.factor_nnz = ((SCformat*) L.Store)->nnz + ((NCformat*) U.Store)->nnz;
+        this->statistics.factor_memory = (size_t)memusage.for_lu;
+        this->statistics.flops += stat.ops[FACT];
+      }
+#endif
+
       // If required, print statistics.
       if( options.PrintStat ) SLU_PRINT_STAT(&stat);
 
       // Free temporary local variables.
       StatFree(&stat);
       //SUPERLU_FREE (x);
-      delete x;
+      delete [] x;
+      delete [] ferr;
+      delete [] berr;
       Destroy_SuperMatrix_Store(&X);
 
       this->tick();
@@ -836,6 +900,15 @@ namespace Hermes
       else
         eff_fact_scheme = this->factorization_scheme;
 
+      // Only the values changed since the last factorization: reuse the column permutation and
+      // the elimination tree, the matrix itself has to be recreated with the new values.
+      bool same_pattern = this->pattern_unchanged(m->size, m->nnz, (const int*)m->Ap, m->size + 1, m->Ai, m->nnz);
+      if(eff_fact_scheme == HERMES_FACTORIZE_FROM_SCRATCH && inited && same_pattern)
+      {
+        eff_fact_scheme = HERMES_REUSE_MATRIX_REORDERING;
+        free_matrix();
+      }
+
       // Prepare factorization structures. In case of a particular reuse scheme, comments are given
       // to clarify which arguments will be reused and which will be reset by the dgssvx (zgssvx) routine.
       // It was determined empirically by running the dlinsolx2 example from SuperLU, setting options.Fact
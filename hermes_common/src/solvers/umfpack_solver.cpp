@@ -22,6 +22,7 @@
 #include "config.h"
 #ifdef WITH_UMFPACK
 #include "umfpack_solver.h"
+#include "memory_accounting.h"
 
 extern "C"
 {
@@ -32,6 +33,8 @@ namespace Hermes
 {
   namespace Algebra
   {
+    static int factorization_memory_category = Hermes::MemoryAccounting::add_category("factorizations");
+
     static int find_position(int *Ai, int Alen, int idx)
     {
       assert(Ai != NULL);
@@ -66,12 +69,23 @@ namespace Hermes
       Ap = NULL;
       Ai = NULL;
       Ax = NULL;
+      owns_arrays = true;
+      Rp = NULL;
+      Rj = NULL;
+      Rpos = NULL;
     }
 
     template<typename Scalar>
     CSCMatrix<Scalar>::CSCMatrix(unsigned int size)
     {
       this->size = size;
+      Ap = NULL;
+      Ai = NULL;
+      Ax = NULL;
+      owns_arrays = true;
+      Rp = NULL;
+      Rj = NULL;
+      Rpos = NULL;
       this->alloc();
     }
 
@@ -81,17 +95,95 @@ namespace Hermes
       free();
     }
 
+    template<typename Scalar>
+    void CSCMatrix<Scalar>::build_row_structure()
+    {
+      free_row_structure();
+      int n = this->size;
+      Rp = new int[n + 1];
+      Rj = new int[nnz];
+      Rpos = new int[nnz];
+
+      // Count the entries of every row.
+      memset(Rp, 0, (n + 1) * sizeof(int));
+      for (unsigned int k = 0; k < nnz; k++)
+        Rp[Ai[k] + 1]++;
+      for (int i = 0; i < n; i++)
+        Rp[i + 1] += Rp[i];
+
+      // Going through the columns in order keeps the column indices of every row sorted.
+      int* fill = new int[n];
+      memcpy(fill, Rp, n * sizeof(int));
+      for (int j = 0; j < n; j++)
+      {
+        for (int k = Ap[j]; k < Ap[j + 1]; k++)
+        {
+          int pos = fill[Ai[k]]++;
+          Rj[pos] = j;
+          Rpos[pos] = k;
+        }
+      }
+      delete [] fill;
+    }
+
+    template<typename Scalar>
+    void CSCMatrix<Scalar>::free_row_structure()
+    {
+      delete [] Rp;
+      Rp = NULL;
+      delete [] Rj;
+      Rj = NULL;
+      delete [] Rpos;
+      Rpos = NULL;
+    }
+
     template<typename Scalar>
     void CSCMatrix<Scalar>::multiply_with_vector(Scalar* vector_in, Scalar* vector_out)
     {
+      if(Rp == NULL)
+        build_row_structure();
+
+      // Every row is a gather into its own entry of vector_out, so the rows need no synchronization.
+      int n = this->size;
+#pragma omp parallel for schedule(static) if(n > 1000)
+      for (int i = 0; i < n; i++)
+      {
+        Scalar sum_0 = 0.0, sum_1 = 0.0;
+        int k = Rp[i], row_end = Rp[i + 1];
+        for (; k + 1 < row_end; k += 2)
+        {
+          sum_0 += Ax[Rpos[k]] * vector_in[Rj[k]];
+          sum_1 += Ax[Rpos[k + 1]] * vector_in[Rj[k + 1]];
+        }
+        if(k < row_end)
+          sum_0 += Ax[Rpos[k]] * vector_in[Rj[k]];
+        vector_out[i] = sum_0 + sum_1;
+      }
+    }
+
+    template<>
+    void CSCMatrix<std::complex<double> >::multiply_with_vector(std::complex<double>* vector_in, std::complex<double>* vector_out)
+    {
+      if(Rp == NULL)
+        build_row_structure();
+
+      // The real and imaginary parts are accumulated separately in plain double arithmetic (the complex
+      // operator* checks for infinities and NaNs and does not vectorize).
+      const double* a = reinterpret_cast<const double*>(Ax);
+      const double* x = reinterpret_cast<const double*>(vector_in);
       int n = this->size;
-      for (int j = 0; j<n; j++) vector_out[j] = 0;
-      for (int j = 0; j<n; j++)
+#pragma omp parallel for schedule(static) if(n > 1000)
+      for (int i = 0; i < n; i++)
       {
-        for (int i = Ap[j]; i < Ap[j + 1]; i++)
+        double sum_re = 0.0, sum_im = 0.0;
+        for (int k = Rp[i]; k < Rp[i + 1]; k++)
         {
-          vector_out[Ai[i]] += vector_in[j]*Ax[i];
+          double a_re = a[2 * Rpos[k]], a_im = a[2 * Rpos[k] + 1];
+          double x_re = x[2 * Rj[k]], x_im = x[2 * Rj[k] + 1];
+          sum_re += a_re * x_re - a_im * x_im;
+          sum_im += a_re * x_im + a_im * x_re;
         }
+        vector_out[i] = std::complex<double>(sum_re, sum_im);
       }
     }
 
@@ -102,38 +194,48 @@ namespace Hermes
     }
 
     template<typename Scalar>
-    void CSCMatrix<Scalar>::alloc()
+    void CSCMatrix<Scalar>::sum_over_processes()
     {
-      assert(this->pages != NULL);
-
-      // initialize the arrays Ap and Ai
-      Ap = new int[this->size + 1];
-      int aisize = this->get_num_indices();
-      Ai = new int[aisize];
+      sum_values_over_processes<Scalar>(Ax, this->nnz);
+    }
 
-      // sort the indices and remove duplicities, insert into Ai
-      unsigned int i;
-      int pos = 0;
-      for (i = 0; i < this->size; i++)
+    template<typename Scalar>
+    void CSCMatrix<Scalar>::alloc()
+    {
+      free_row_structure();
+      if(!owns_arrays)
       {
-        Ap[i] = pos;
-        pos += this->sort_and_store_indices(this->pages[i], Ai + pos, Ai + aisize);
+        Ap = NULL;
+        Ai = NULL;
+        Ax = NULL;
+        owns_arrays = true;
       }
-      Ap[i] = pos;
-
-      delete [] this->pages;
-      this->pages = NULL;
+      // initialize the arrays Ap and Ai
+      // sort the indices and remove duplicities, insert into Ai
+      Ap = new int[this->size + 1];
+      Ai = this->compress_indices(Ap);
 
       nnz = Ap[this->size];
 
       Ax = new Scalar[nnz];
-      memset(Ax, 0, sizeof(Scalar) * nnz);
+      zero_values<Scalar>(Ax, nnz);
+      this->set_memory_size((this->size + 1) * sizeof(int) + nnz * (sizeof(int) + sizeof(Scalar)));
     }
 
     template<typename Scalar>
     void CSCMatrix<Scalar>::free()
     {
+      free_row_structure();
       nnz = 0;
+      this->set_memory_size(0);
+      if(!owns_arrays)
+      {
+        Ap = NULL;
+        Ai = NULL;
+        Ax = NULL;
+        owns_arrays = true;
+        return;
+      }
       if(Ap != NULL)
       {
         delete [] Ap;
@@ -166,30 +268,11 @@ namespace Hermes
     template<typename Scalar>
     void CSCMatrix<Scalar>::zero()
     {
-      memset(Ax, 0, sizeof(Scalar) * nnz);
+      zero_values<Scalar>(Ax, nnz);
     }
 
-    template<>
-    void CSCMatrix<double>::add(unsigned int m, unsigned int n, double v)
-    {
-      if(v != 0.0)   // ignore zero values.
-      {
-        // Find m-th row in the n-th column.
-        int pos = find_position(Ai + Ap[n], Ap[n + 1] - Ap[n], m);
-        // Make sure we are adding to an existing non-zero entry.
-        if(pos < 0)
-        {
-          this->info("CSCMatrix<Scalar>::add(): i = %d, j = %d.", m, n);
-          throw Hermes::Exceptions::Exception("Sparse matrix entry not found: [%i, %i]", m, n);
-        }
-
-#pragma omp atomic
-        Ax[Ap[n] + pos] += v;
-      }
-    }
-
-    template<>
-    void CSCMatrix<std::complex<double> >::add(unsigned int m, unsigned int n, std::complex<double> v)
+    template<typename Scalar>
+    void CSCMatrix<Scalar>::add(unsigned int m, unsigned int n, Scalar v)
     {
       if(v != 0.0)   // ignore zero values.
       {
@@ -202,8 +285,7 @@ namespace Hermes
           throw Hermes::Exceptions::Exception("Sparse matrix entry not found: [%i, %i]", m, n);
         }
 
-#pragma omp critical
-        Ax[Ap[n] + pos] += v;
+        Hermes::atomic_add(Ax[Ap[n] + pos], v);
       }
     }
 
@@ -265,6 +347,15 @@ namespace Hermes
     void CSCMatrix<Scalar>::add_matrix(CSCMatrix<Scalar>* mat)
     {
       assert(this->get_size() == mat->get_size());
+      // The same sparse structure (e.g. both created by one DiscreteProblem): the values are added directly.
+      if(this->nnz == mat->nnz && (this->Ap == mat->Ap || !memcmp(this->Ap, mat->Ap, sizeof(int) * (this->size + 1)))
+        && (this->Ai == mat->Ai || !memcmp(this->Ai, mat->Ai, sizeof(int) * this->nnz)))
+      {
+        for(unsigned int i = 0; i < this->nnz; i++)
+          this->Ax[i] += mat->Ax[i];
+        return;
+      }
+
       // Create iterators for both matrices.
       UMFPackIterator<Scalar> mat_it(mat);
       UMFPackIterator<Scalar> this_it(this);
@@ -300,6 +391,12 @@ namespace Hermes
       }
     }
 
+    template<typename Scalar>
+    void CSCMatrix<Scalar>::add_sparse_matrix(SparseMatrix<Scalar>* mat)
+    {
+      add_matrix(static_cast<CSCMatrix<Scalar>*>(mat));
+    }
+
     template<typename Scalar>
     void CSCMatrix<Scalar>::add_to_diagonal(Scalar v)
     {
@@ -318,6 +415,69 @@ namespace Hermes
             add(rows[i], cols[j], mat[i][j]);
     }
 
+    template<typename Scalar>
+    void CSCMatrix<Scalar>::add_to_values(unsigned int m, unsigned int n, Scalar **mat, int *rows, int *cols, Scalar* values)
+    {
+      for (unsigned int j = 0; j < n; j++)     // cols
+      {
+        if(cols[j] < 0)
+          continue;
+        for (unsigned int i = 0; i < m; i++)       // rows
+        {
+          if(rows[i] < 0 || mat[i][j] == 0.0)
+            continue;
+
+          // Find rows[i]-th row in the cols[j]-th column.
+          int pos = find_position(Ai + Ap[cols[j]], Ap[cols[j] + 1] - Ap[cols[j]], rows[i]);
+          if(pos < 0)
+            throw Hermes::Exceptions::Exception("Sparse matrix entry not found: [%i, %i]", rows[i], cols[j]);
+
+          values[Ap[cols[j]] + pos] += mat[i][j];
+        }
+      }
+    }
+
+    template<typename Scalar>
+    void CSCMatrix<Scalar>::get_positions(unsigned int m, unsigned int n, int *rows, int *cols, int* positions)
+    {
+      for (unsigned int i = 0; i < m; i++)       // rows
+        for (unsigned int j = 0; j < n; j++)     // cols
+        {
+          if(rows[i] < 0 || cols[j] < 0)
+          {
+            positions[i * n + j] = -1;
+            continue;
+          }
+
+          int pos = find_position(Ai + Ap[cols[j]], Ap[cols[j] + 1] - Ap[cols[j]], rows[i]);
+          if(pos < 0)
+            throw Hermes::Exceptions::Exception("Sparse matrix entry not found: [%i, %i]", rows[i], cols[j]);
+          positions[i * n + j] = Ap[cols[j]] + pos;
+        }
+    }
+
+    template<typename Scalar>
+    void CSCMatrix<Scalar>::add_by_positions(unsigned int m, unsigned int n, Scalar **mat, int* positions, Scalar* values)
+    {
+      for (unsigned int i = 0; i < m; i++)       // rows
+        for (unsigned int j = 0; j < n; j++)     // cols
+        {
+          int pos = positions[i * n + j];
+          if(pos < 0 || mat[i][j] == 0.0)
+            continue;
+          if(values == NULL)
+            add_to_position(pos, mat[i][j]);
+          else
+            values[pos] += mat[i][j];
+        }
+    }
+
+    template<typename Scalar>
+    void CSCMatrix<Scalar>::add_to_position(unsigned int pos, Scalar v)
+    {
+      Hermes::atomic_add(Ax[pos], v);
+    }
+
     double inline real(double x)
     {
       return x;
@@ -393,6 +553,10 @@ namespace Hermes
           return true;
         }
 
+      case DF_MATRIX_MARKET_BIN:
+      case DF_HDF5:
+        return dump_compressed_binary(file, var_name, fmt, this->size, nnz, Ap, Ai, Ax);
+
       case DF_PLAIN_ASCII:
         exit(1);
         {
@@ -498,6 +662,10 @@ namespace Hermes
           return true;
         }
 
+      case DF_MATRIX_MARKET_BIN:
+      case DF_HDF5:
+        return dump_compressed_binary(file, var_name, fmt, this->size, nnz, Ap, Ai, Ax);
+
       case DF_PLAIN_ASCII:
         exit(1);
         {
@@ -563,17 +731,33 @@ namespace Hermes
     template<typename Scalar>
     void CSCMatrix<Scalar>::create(unsigned int size, unsigned int nnz, int* ap, int* ai, Scalar* ax)
     {
+      free();
       this->nnz = nnz;
       this->size = size;
       this->Ap = new int[this->size + 1]; assert(this->Ap != NULL);
       this->Ai = new int[nnz];    assert(this->Ai != NULL);
       this->Ax = new Scalar[nnz]; assert(this->Ax != NULL);
       for (unsigned int i = 0; i < this->size + 1; i++) this->Ap[i] = ap[i];
-      for (unsigned int i = 0; i < nnz; i++)
-      {
-        this->Ax[i] = ax[i];
-        this->Ai[i] = ai[i];
-      }
+      memcpy(this->Ai, ai, nnz * sizeof(int));
+      if(ax == NULL)
+        memset(this->Ax, 0, nnz * sizeof(Scalar));
+      else
+        memcpy(this->Ax, ax, nnz * sizeof(Scalar));
+      this->set_memory_size((this->size + 1) * sizeof(int) + nnz * (sizeof(int) + sizeof(Scalar)));
+    }
+
+    template<typename Scalar>
+    void CSCMatrix<Scalar>::wrap(unsigned int size, unsigned int nnz, int* ap, int* ai, Scalar* ax)
+    {
+      if(ap == NULL || ai == NULL || ax == NULL)
+        throw Hermes::Exceptions::NullException(ap == NULL ? 3 : (ai == NULL ? 4 : 5));
+      free();
+      this->size = size;
+      this->nnz = nnz;
+      this->Ap = ap;
+      this->Ai = ai;
+      this->Ax = ax;
+      owns_arrays = false;
     }
 
     template<typename Scalar>
@@ -606,6 +790,7 @@ namespace Hermes
     UMFPackVector<Scalar>::UMFPackVector()
     {
       v = NULL;
+      owns_v = true;
       this->size = 0;
     }
 
@@ -613,6 +798,7 @@ namespace Hermes
     UMFPackVector<Scalar>::UMFPackVector(unsigned int size)
     {
       v = NULL;
+      owns_v = true;
       this->size = size;
       this->alloc(size);
     }
@@ -626,6 +812,11 @@ namespace Hermes
     template<typename Scalar>
     void UMFPackVector<Scalar>::alloc(unsigned int n)
     {
+      if(!owns_v && v != NULL && n == this->size)
+      {
+        this->zero();
+        return;
+      }
       free();
       this->size = n;
       v = new Scalar[n];
@@ -635,7 +826,7 @@ namespace Hermes
     template<typename Scalar>
     void UMFPackVector<Scalar>::zero()
     {
-      memset(v, 0, this->size * sizeof(Scalar));
+      zero_values<Scalar>(v, this->size);
     }
 
     template<typename Scalar>
@@ -647,29 +838,34 @@ namespace Hermes
     template<typename Scalar>
     void UMFPackVector<Scalar>::free()
     {
-      delete [] v;
+      if(owns_v)
+        delete [] v;
       v = NULL;
+      owns_v = true;
       this->size = 0;
     }
 
     template<typename Scalar>
-    void UMFPackVector<Scalar>::set(unsigned int idx, Scalar y)
+    void UMFPackVector<Scalar>::wrap(Scalar* v, unsigned int size)
     {
-      v[idx] = y;
+      if(v == NULL)
+        throw Hermes::Exceptions::NullException(1);
+      free();
+      this->v = v;
+      this->size = size;
+      owns_v = false;
     }
 
-    template<>
-    void UMFPackVector<double>::add(unsigned int idx, double y)
+    template<typename Scalar>
+    void UMFPackVector<Scalar>::set(unsigned int idx, Scalar y)
     {
-#pragma omp atomic
-      v[idx] += y;
+      v[idx] = y;
     }
 
-    template<>
-    void UMFPackVector<std::complex<double> >::add(unsigned int idx, std::complex<double> y)
+    template<typename Scalar>
+    void UMFPackVector<Scalar>::add(unsigned int idx, Scalar y)
     {
-#pragma omp critical(UMFPackVector_add)
-      v[idx] += y;
+      Hermes::atomic_add(v[idx], y);
     }
 
     template<typename Scalar>
@@ -691,6 +887,12 @@ namespace Hermes
       memcpy(v, this->v, this->size * sizeof(Scalar));
     }
 
+    template<typename Scalar>
+    const Scalar* UMFPackVector<Scalar>::get_values() const
+    {
+      return this->v;
+    }
+
     template<typename Scalar>
     void UMFPackVector<Scalar>::add_vector(Vector<Scalar>* vec)
     {
@@ -735,6 +937,10 @@ namespace Hermes
           return true;
         }
 
+      case DF_MATRIX_MARKET_BIN:
+      case DF_HDF5:
+        return dump_vector_binary(file, var_name, fmt, this->size, v);
+
       case DF_PLAIN_ASCII:
         {
           fprintf(file, "\n");
@@ -777,6 +983,10 @@ namespace Hermes
           return true;
         }
 
+      case DF_MATRIX_MARKET_BIN:
+      case DF_HDF5:
+        return dump_vector_binary(file, var_name, fmt, this->size, v);
+
       case DF_PLAIN_ASCII:
         {
           fprintf(file, "\n");
@@ -864,6 +1074,121 @@ namespace Hermes
       this->Ax[this->Ai_pos] += val;
     }
 
+    template<>
+    void UMFPackLinearMatrixSolver<double>::update_factorization_memory()
+    {
+      int lnz = 0, unz = 0, n_row, n_col, nz_udiag;
+      if(numeric != NULL)
+        umfpack_di_get_lunz(&lnz, &unz, &n_row, &n_col, &nz_udiag, numeric);
+      size_t memory = (size_t)(lnz + unz) * (sizeof(int) + sizeof(double));
+      Hermes::MemoryAccounting::changed(factorization_memory_category, factorization_memory, memory);
+      factorization_memory = memory;
+      this->statistics.matrix_nnz = m->nnz;
+      this->statistics.factor_nnz = lnz + unz;
+      this->statistics.factor_memory = memory;
+    }
+
+    template<>
+    void UMFPackLinearMatrixSolver<std::complex<double> >::update_factorization_memory()
+    {
+      int lnz = 0, unz = 0, n_row, n_col, nz_udiag;
+      if(numeric != NULL)
+        umfpack_zi_get_lunz(&lnz, &unz, &n_row, &n_col, &nz_udiag, numeric);
+      size_t memory = (size_t)(lnz + unz) * (sizeof(int) + sizeof(std::complex<double>));
+      Hermes::MemoryAccounting::changed(factorization_memory_category, factorization_memory, memory);
+      factorization_memory = memory;
+      this->statistics.matrix_nnz = m->nnz;
+      this->statistics.factor_nnz = lnz + unz;
+      this->statistics.factor_memory = memory;
+    }
+
+    static const char* umfpack_type_prefix(double* dummy) { return "di"; }
+    static const char* umfpack_type_prefix(std::complex<double>* dummy) { return "zi"; }
+
+    template<typename Scalar>
+    void UMFPackLinearMatrixSolver<Scalar>::get_factorization_cache_files(std::string& symbolic_file, std::string& numeric_file)
+    {
+      // FNV-1a over the structure and the values.
+      uint64_t hash = 14695981039346656037ULL;
+      unsigned int size = m->get_size();
+      const unsigned char* bytes[3] = { (const unsigned char*)m->get_Ap(), (const unsigned char*)m->get_Ai(), (const unsigned char*)m->get_Ax() };
+      size_t lengths[3] = { (size + 1) * sizeof(int), m->nnz * sizeof(int), m->nnz * sizeof(Scalar) };
+      for(int array_i = 0; array_i < 3; array_i++)
+        for(size_t k = 0; k < lengths[array_i]; k++)
+          hash = (hash ^ (uint64_t)bytes[array_i][k]) * 1099511628211ULL;
+
+      char name[128];
+      sprintf(name, "/umfpack_%s_%u_%u_%016llx", umfpack_type_prefix((Scalar*)NULL), size, m->nnz, (unsigned long long)hash);
+      symbolic_file = factorization_cache + name + "_symbolic.umf";
+      numeric_file = factorization_cache + name + "_numeric.umf";
+    }
+
+    template<>
+    bool UMFPackLinearMatrixSolver<double>::load_cached_factorization()
+    {
+      std::string symbolic_file, numeric_file;
+      get_factorization_cache_files(symbolic_file, numeric_file);
+      void* cached_symbolic = NULL;
+      void* cached_numeric = NULL;
+      if(umfpack_di_load_symbolic(&cached_symbolic, (char*)symbolic_file.c_str()) != UMFPACK_OK)
+        return false;
+      if(umfpack_di_load_numeric(&cached_numeric, (char*)numeric_file.c_str()) != UMFPACK_OK)
+      {
+        umfpack_di_free_symbolic(&cached_symbolic);
+        return false;
+      }
+      if(symbolic != NULL)
+        umfpack_di_free_symbolic(&symbolic);
+      symbolic = cached_symbolic;
+      numeric = cached_numeric;
+      update_factorization_memory();
+      this->info("\tUMFPack: the factorization loaded from %s.", numeric_file.c_str());
+      return true;
+    }
+
+    template<>
+    bool UMFPackLinearMatrixSolver<std::complex<double> >::load_cached_factorization()
+    {
+      std::string symbolic_file, numeric_file;
+      get_factorization_cache_files(symbolic_file, numeric_file);
+      void* cached_symbolic = NULL;
+      void* cached_numeric = NULL;
+      if(umfpack_zi_load_symbolic(&cached_symbolic, (char*)symbolic_file.c_str()) != UMFPACK_OK)
+        return false;
+      if(umfpack_zi_load_numeric(&cached_numeric, (char*)numeric_file.c_str()) != UMFPACK_OK)
+      {
+        umfpack_zi_free_symbolic(&cached_symbolic);
+        return false;
+      }
+      if(symbolic != NULL)
+        umfpack_zi_free_symbolic(&symbolic);
+      symbolic = cached_symbolic;
+      numeric = cached_numeric;
+      update_factorization_memory();
+      this->info("\tUMFPack: the factorization loaded from %s.", numeric_file.c_str());
+      return true;
+    }
+
+    template<>
+    void UMFPackLinearMatrixSolver<double>::save_cached_factorization()
+    {
+      std::string symbolic_file, numeric_file;
+      get_factorization_cache_files(symbolic_file, numeric_file);
+      if(umfpack_di_save_symbolic(symbolic, (char*)symbolic_file.c_str()) != UMFPACK_OK
+        || umfpack_di_save_numeric(numeric, (char*)numeric_file.c_str()) != UMFPACK_OK)
+        this->warn("UMFPack: the factorization could not be saved to %s.", factorization_cache.c_str());
+    }
+
+    template<>
+    void UMFPackLinearMatrixSolver<std::complex<double> >::save_cached_factorization()
+    {
+      std::string symbolic_file, numeric_file;
+      get_factorization_cache_files(symbolic_file, numeric_file);
+      if(umfpack_zi_save_symbolic(symbolic, (char*)symbolic_file.c_str()) != UMFPACK_OK
+        || umfpack_zi_save_numeric(numeric, (char*)numeric_file.c_str()) != UMFPACK_OK)
+        this->warn("UMFPack: the factorization could not be saved to %s.", factorization_cache.c_str());
+    }
+
     template<>
     bool UMFPackLinearMatrixSolver<double>::setup_factorization()
     {
@@ -874,6 +1199,15 @@ namespace Hermes
       else
         eff_fact_scheme = factorization_scheme;
 
+      // Only the values changed since the last factorization: reuse the symbolic factorization.
+      bool same_pattern = this->pattern_unchanged(m->get_size(), m->nnz, m->get_Ap(), m->get_size() + 1, m->get_Ai(), m->nnz);
+      if(eff_fact_scheme == HERMES_FACTORIZE_FROM_SCRATCH && symbolic != NULL && same_pattern)
+        eff_fact_scheme = HERMES_REUSE_MATRIX_REORDERING;
+
+      // The first factorization may be the one of the same matrix stored by an earlier run.
+      if(!factorization_cache.empty() && numeric == NULL && load_cached_factorization())
+        return true;
+
       int status;
       switch(eff_fact_scheme)
       {
@@ -881,7 +1215,10 @@ namespace Hermes
         if(symbolic != NULL) umfpack_di_free_symbolic(&symbolic);
 
         //debug_log("Factorizing symbolically.");
-        status = umfpack_di_symbolic(m->get_size(), m->get_size(), m->get_Ap(), m->get_Ai(), m->get_Ax(), &symbolic, NULL, NULL);
+        {
+          Hermes::Mixins::Profile::Section profile_section(&this->profile, this->PROFILE_SYMBOLIC);
+          status = umfpack_di_symbolic(m->get_size(), m->get_size(), m->get_Ap(), m->get_Ai(), m->get_Ax(), &symbolic, NULL, NULL);
+        }
         if(status != UMFPACK_OK)
         {
           check_status("umfpack_di_symbolic", status);
@@ -895,7 +1232,13 @@ namespace Hermes
         if(numeric != NULL) umfpack_di_free_numeric(&numeric);
 
         //debug_log("Factorizing numerically.");
-        status = umfpack_di_numeric(m->get_Ap(), m->get_Ai(), m->get_Ax(), symbolic, &numeric, NULL, NULL);
+        {
+          Hermes::Mixins::Profile::Section profile_section(&this->profile, this->PROFILE_NUMERIC);
+          double info[UMFPACK_INFO];
+          status = umfpack_di_numeric(m->get_Ap(), m->get_Ai(), m->get_Ax(), symbolic, &numeric, NULL, info);
+          if(status == UMFPACK_OK)
+            this->statistics.flops += info[UMFPACK_FLOPS];
+        }
         if(status != UMFPACK_OK)
         {
           check_status("umfpack_di_numeric", status);
@@ -903,6 +1246,10 @@ namespace Hermes
         }
         if(numeric == NULL)
           throw Exceptions::Exception("umfpack_di_numeric error: numeric == NULL");
+        update_factorization_memory();
+
+        if(!factorization_cache.empty())
+          save_cached_factorization();
       }
 
       return true;
@@ -910,7 +1257,7 @@ namespace Hermes
 
     template<typename Scalar>
     UMFPackLinearMatrixSolver<Scalar>::UMFPackLinearMatrixSolver(UMFPackMatrix<Scalar> *m, UMFPackVector<Scalar> *rhs)
-      : DirectSolver<Scalar>(HERMES_FACTORIZE_FROM_SCRATCH), m(m), rhs(rhs), symbolic(NULL), numeric(NULL)
+      : DirectSolver<Scalar>(HERMES_FACTORIZE_FROM_SCRATCH), m(m), rhs(rhs), symbolic(NULL), numeric(NULL), factorization_memory(0)
     {
       }
 
@@ -936,6 +1283,15 @@ namespace Hermes
       else
         eff_fact_scheme = factorization_scheme;
 
+      // Only the values changed since the last factorization: reuse the symbolic factorization.
+      bool same_pattern = this->pattern_unchanged(m->get_size(), m->nnz, m->get_Ap(), m->get_size() + 1, m->get_Ai(), m->nnz);
+      if(eff_fact_scheme == HERMES_FACTORIZE_FROM_SCRATCH && symbolic != NULL && same_pattern)
+        eff_fact_scheme = HERMES_REUSE_MATRIX_REORDERING;
+
+      // The first factorization may be the one of the same matrix stored by an earlier run.
+      if(!factorization_cache.empty() && numeric == NULL && load_cached_factorization())
+        return true;
+
       int status;
       switch(eff_fact_scheme)
       {
@@ -943,7 +1299,10 @@ namespace Hermes
           if(symbolic != NULL)
             umfpack_zi_free_symbolic(&symbolic);
 
-          status = umfpack_zi_symbolic(m->get_size(), m->get_size(), m->get_Ap(), m->get_Ai(), (double *)m->get_Ax(), NULL, &symbolic, NULL, NULL);
+          {
+            Hermes::Mixins::Profile::Section profile_section(&this->profile, this->PROFILE_SYMBOLIC);
+            status = umfpack_zi_symbolic(m->get_size(), m->get_size(), m->get_Ap(), m->get_Ai(), (double *)m->get_Ax(), NULL, &symbolic, NULL, NULL);
+          }
           if(status != UMFPACK_OK)
           {
             check_status("umfpack_di_symbolic", status);
@@ -957,7 +1316,13 @@ namespace Hermes
           if(numeric != NULL)
             umfpack_zi_free_numeric(&numeric);
 
-        status = umfpack_zi_numeric(m->get_Ap(), m->get_Ai(), (double *) m->get_Ax(), NULL, symbolic, &numeric, NULL, NULL);
+        {
+          Hermes::Mixins::Profile::Section profile_section(&this->profile, this->PROFILE_NUMERIC);
+          double info[UMFPACK_INFO];
+          status = umfpack_zi_numeric(m->get_Ap(), m->get_Ai(), (double *) m->get_Ax(), NULL, symbolic, &numeric, NULL, info);
+          if(status == UMFPACK_OK)
+            this->statistics.flops += info[UMFPACK_FLOPS];
+        }
         if(status != UMFPACK_OK)
         {
           check_status("umfpack_di_numeric", status);
@@ -965,6 +1330,10 @@ namespace Hermes
         }
         if(numeric == NULL)
           throw Exceptions::Exception("umfpack_di_numeric error: numeric == NULL");
+        update_factorization_memory();
+
+        if(!factorization_cache.empty())
+          save_cached_factorization();
       }
 
       return true;
@@ -977,6 +1346,8 @@ namespace Hermes
       symbolic = NULL;
       if(numeric != NULL) umfpack_di_free_numeric(&numeric);
       numeric = NULL;
+      Hermes::MemoryAccounting::released(factorization_memory_category, factorization_memory);
+      factorization_memory = 0;
     }
 
     template<>
@@ -986,6 +1357,8 @@ namespace Hermes
       symbolic = NULL;
       if(numeric != NULL) umfpack_zi_free_numeric(&numeric);
       numeric = NULL;
+      Hermes::MemoryAccounting::released(factorization_memory_category, factorization_memory);
+      factorization_memory = 0;
     }
 
     template<>
@@ -1004,7 +1377,11 @@ namespace Hermes
         delete [] sln;
       sln = new double[m->get_size()];
       memset(sln, 0, m->get_size() * sizeof(double));
-      int status = umfpack_di_solve(UMFPACK_A, m->get_Ap(), m->get_Ai(), m->get_Ax(), sln, rhs->get_c_array(), numeric, NULL, NULL);
+      int status;
+      {
+        Hermes::Mixins::Profile::Section profile_section(&this->profile, this->PROFILE_SOLVE);
+        status = umfpack_di_solve(UMFPACK_A, m->get_Ap(), m->get_Ai(), m->get_Ax(), sln, rhs->get_c_array(), numeric, NULL, NULL);
+      }
       if(status != UMFPACK_OK)
       {
         check_status("umfpack_di_solve", status);
@@ -1035,7 +1412,11 @@ namespace Hermes
         delete [] sln;
       sln = new std::complex<double>[m->get_size()];
       memset(sln, 0, m->get_size() * sizeof(std::complex<double>));
-      int status = umfpack_zi_solve(UMFPACK_A, m->get_Ap(), m->get_Ai(), (double *)m->get_Ax(), NULL, (double*) sln, NULL, (double *)rhs->get_c_array(), NULL, numeric, NULL, NULL);
+      int status;
+      {
+        Hermes::Mixins::Profile::Section profile_section(&this->profile, this->PROFILE_SOLVE);
+        status = umfpack_zi_solve(UMFPACK_A, m->get_Ap(), m->get_Ai(), (double *)m->get_Ax(), NULL, (double*) sln, NULL, (double *)rhs->get_c_array(), NULL, numeric, NULL, NULL);
+      }
       if(status != UMFPACK_OK)
       {
         check_status("umfpack_di_solve", status);
@@ -1048,6 +1429,119 @@ namespace Hermes
       return true;
     }
 
+    template<>
+    bool UMFPackLinearMatrixSolver<double>::solve_block(double* rhs_block, int nrhs, int sys)
+    {
+      assert(m != NULL);
+
+      this->tick();
+
+      if( !setup_factorization() )
+        throw Exceptions::LinearMatrixSolverException("LU factorization could not be completed.");
+
+      int n = m->get_size();
+      double* x = new double[n];
+      bool ret = true;
+      for (int rhs_i = 0; rhs_i < nrhs && ret; rhs_i++)
+      {
+        double* b = rhs_block + rhs_i * n;
+        int status;
+        {
+          Hermes::Mixins::Profile::Section profile_section(&this->profile, this->PROFILE_SOLVE);
+          status = umfpack_di_solve(sys, m->get_Ap(), m->get_Ai(), m->get_Ax(), x, b, numeric, NULL, NULL);
+        }
+        if(status != UMFPACK_OK)
+        {
+          check_status("umfpack_di_solve", status);
+          ret = false;
+        }
+        else
+          memcpy(b, x, n * sizeof(double));
+      }
+      delete [] x;
+
+      this->tick();
+      time = this->accumulated();
+
+      return ret;
+    }
+
+    template<>
+    bool UMFPackLinearMatrixSolver<std::complex<double> >::solve_block(std::complex<double>* rhs_block, int nrhs, int sys)
+    {
+      assert(m != NULL);
+
+      this->tick();
+
+      if( !setup_factorization() )
+      {
+        this->warn("LU factorization could not be completed.");
+        return false;
+      }
+
+      int n = m->get_size();
+      std::complex<double>* x = new std::complex<double>[n];
+      bool ret = true;
+      for (int rhs_i = 0; rhs_i < nrhs && ret; rhs_i++)
+      {
+        std::complex<double>* b = rhs_block + rhs_i * n;
+        int status;
+        {
+          Hermes::Mixins::Profile::Section profile_section(&this->profile, this->PROFILE_SOLVE);
+          status = umfpack_zi_solve(sys, m->get_Ap(), m->get_Ai(), (double *)m->get_Ax(), NULL, (double*) x, NULL, (double *)b, NULL, numeric, NULL, NULL);
+        }
+        if(status != UMFPACK_OK)
+        {
+          check_status("umfpack_zi_solve", status);
+          ret = false;
+        }
+        else
+          memcpy(b, x, n * sizeof(std::complex<double>));
+      }
+      delete [] x;
+
+      this->tick();
+      time = this->accumulated();
+
+      return ret;
+    }
+
+    template<typename Scalar>
+    bool UMFPackLinearMatrixSolver<Scalar>::solve_multiple(Scalar* rhs_block, int nrhs)
+    {
+      return solve_block(rhs_block, nrhs, UMFPACK_A);
+    }
+
+    template<typename Scalar>
+    bool UMFPackLinearMatrixSolver<Scalar>::solve_transposed(Scalar* rhs_block, int nrhs)
+    {
+      // The matrix has not changed since the last solve, the factors of A serve A^T as well.
+      unsigned int scheme = this->factorization_scheme;
+      if(numeric != NULL)
+        this->factorization_scheme = HERMES_REUSE_FACTORIZATION_COMPLETELY;
+      bool ret;
+      try
+      {
+        ret = solve_block(rhs_block, nrhs, UMFPACK_Aat);
+      }
+      catch(...)
+      {
+        this->factorization_scheme = scheme;
+        throw;
+      }
+      this->factorization_scheme = scheme;
+      return ret;
+    }
+
+    template<typename Scalar>
+    void UMFPackLinearMatrixSolver<Scalar>::set_factorization_cache(const char* directory)
+    {
+      if(directory == NULL)
+        factorization_cache.clear();
+      else
+        factorization_cache = directory;
+    }
+
     template<typename Scalar>
     void UMFPackLinearMatrixSolver<Scalar>::check_status(const char *fn_name, int status)
     {
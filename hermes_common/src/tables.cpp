@@ -74,6 +74,9 @@ namespace Hermes
     this->B = NULL;
     this->B2 = NULL;
     this->C = NULL;
+    this->A_explicit = NULL;
+    this->B_explicit = NULL;
+    this->imex = false;
   }
 
   ButcherTable::ButcherTable(unsigned int size) : Table(size)
@@ -87,6 +90,15 @@ namespace Hermes
     // C array.
     this->C = new double[size];
     for (unsigned int j = 0; j < size; j++) this->C[j] = 0;
+    // Explicit table of IMEX pairs.
+    this->A_explicit = new_matrix<double>(size, size);
+    for (unsigned int i = 0; i < size; i++)
+    {
+      for (unsigned int j = 0; j < size; j++) this->A_explicit[i][j] = 0;
+    }
+    this->B_explicit = new double[size];
+    for (unsigned int j = 0; j < size; j++) this->B_explicit[j] = 0;
+    this->imex = false;
   }
 
   ButcherTable::ButcherTable(ButcherTableType butcher_table)
@@ -677,6 +689,74 @@ namespace Hermes
       this->set_C(6, 1.0);
       break;
 
+      /* IMEX METHODS */
+
+      // Implicit-explicit Euler, the first stage is only the initial value.
+    case IMEX_ARS_111:
+      this->alloc(2);
+      this->set_A(1, 1, 1.);
+      this->set_B(1, 1.);
+      this->set_A_explicit(1, 0, 1.);
+      this->set_B_explicit(0, 1.);
+      this->set_C(1, 1.);
+      break;
+
+    case IMEX_ARS_222:
+      {
+        double gamma = 1. - 1./sqrt(2.);
+        double delta = 1. - 1./(2. * gamma);
+        this->alloc(3);
+        this->set_A(1, 1, gamma);
+        this->set_A(2, 1, 1. - gamma);
+        this->set_A(2, 2, gamma);
+        this->set_B(1, 1. - gamma);
+        this->set_B(2, gamma);
+        this->set_A_explicit(1, 0, gamma);
+        this->set_A_explicit(2, 0, delta);
+        this->set_A_explicit(2, 1, 1. - delta);
+        this->set_B_explicit(0, delta);
+        this->set_B_explicit(1, 1. - delta);
+        this->set_C(1, gamma);
+        this->set_C(2, 1.);
+      }
+      break;
+
+    case IMEX_ARS_443:
+      this->alloc(5);
+      this->set_A(1, 1, 1./2.);
+      this->set_A(2, 1, 1./6.);
+      this->set_A(2, 2, 1./2.);
+      this->set_A(3, 1, -1./2.);
+      this->set_A(3, 2, 1./2.);
+      this->set_A(3, 3, 1./2.);
+      this->set_A(4, 1, 3./2.);
+      this->set_A(4, 2, -3./2.);
+      this->set_A(4, 3, 1./2.);
+      this->set_A(4, 4, 1./2.);
+      this->set_B(1, 3./2.);
+      this->set_B(2, -3./2.);
+      this->set_B(3, 1./2.);
+      this->set_B(4, 1./2.);
+      this->set_A_explicit(1, 0, 1./2.);
+      this->set_A_explicit(2, 0, 11./18.);
+      this->set_A_explicit(2, 1, 1./18.);
+      this->set_A_explicit(3, 0, 5./6.);
+      this->set_A_explicit(3, 1, -5./6.);
+      this->set_A_explicit(3, 2, 1./2.);
+      this->set_A_explicit(4, 0, 1./4.);
+      this->set_A_explicit(4, 1, 7./4.);
+      this->set_A_explicit(4, 2, 3./4.);
+      this->set_A_explicit(4, 3, -7./4.);
+      this->set_B_explicit(0, 1./4.);
+      this->set_B_explicit(1, 7./4.);
+      this->set_B_explicit(2, 3./4.);
+      this->set_B_explicit(3, -7./4.);
+      this->set_C(1, 1./2.);
+      this->set_C(2, 2./3.);
+      this->set_C(3, 1./2.);
+      this->set_C(4, 1.);
+      break;
+
     default: throw Hermes::Exceptions::Exception("Unknown Butcher's table.");
     }
   }
@@ -700,6 +780,15 @@ namespace Hermes
     // C array.
     this->C = new double[size];
     for (unsigned int j = 0; j < size; j++) this->C[j] = 0;
+    // Explicit table of IMEX pairs.
+    this->A_explicit = new_matrix<double>(size, size);
+    for (unsigned int i = 0; i < size; i++)
+    {
+      for (unsigned int j = 0; j < size; j++) this->A_explicit[i][j] = 0;
+    }
+    this->B_explicit = new double[size];
+    for (unsigned int j = 0; j < size; j++) this->B_explicit[j] = 0;
+    this->imex = false;
   }
 
   double ButcherTable::get_B(unsigned int i)
@@ -738,6 +827,38 @@ namespace Hermes
     this->C[i] = val;
   }
 
+  double ButcherTable::get_A_explicit(unsigned int i, unsigned int j)
+  {
+    if(i > size || j > size) throw Hermes::Exceptions::Exception("Invalid access to a Butcher's table.");
+    return this->A_explicit[i][j];
+  }
+
+  double ButcherTable::get_B_explicit(unsigned int i)
+  {
+    if(i > size) throw Hermes::Exceptions::Exception("Invalid access to a Butcher's table.");
+    return this->B_explicit[i];
+  }
+
+  void ButcherTable::set_A_explicit(unsigned int i, unsigned int j, double val)
+  {
+    if(i > size || j > size) throw Hermes::Exceptions::Exception("Invalid access to a Butcher's table.");
+    if(j >= i && fabs(val) > 1e-12) throw Hermes::Exceptions::Exception("The explicit table of an IMEX pair has to be strictly lower triangular.");
+    this->A_explicit[i][j] = val;
+    this->imex = true;
+  }
+
+  void ButcherTable::set_B_explicit(unsigned int i, double val)
+  {
+    if(i > size) throw Hermes::Exceptions::Exception("Invalid access to a Butcher's table.");
+    this->B_explicit[i] = val;
+    this->imex = true;
+  }
+
+  bool ButcherTable::is_imex()
+  {
+    return this->imex;
+  }
+
   bool ButcherTable::is_explicit()
   {
     bool result = true;
@@ -0,0 +1,130 @@
+#include "hermes_common.h"
+
+using namespace Hermes::Algebra;
+using namespace Hermes::Solvers;
+
+//  This test compares the built-in Krylov solvers (KrylovSolver) with UMFPACK. A symmetric positive
+//  definite system (the 5-point Laplace operator) is solved by CG, a nonsymmetric one (the 5-point
+//  convection-diffusion operator) by BiCGStab and GMRES, with the built-in preconditioners. The solutions
+//  have to agree with the direct ones.
+//
+//  The following parameters can be changed:
+
+// Number of grid points in each direction, the systems have GRID_SIZE^2 unknowns.
+const int GRID_SIZE = 20;
+// Convection (relative to the diffusion) of the nonsymmetric system.
+const double CONVECTION = 0.8;
+// Relative tolerance of the Krylov solvers.
+const double KRYLOV_TOL = 1e-12;
+// Maximum allowed relative difference of the solutions.
+const double TOLERANCE = 1e-8;
+
+/// Creates the 5-point operator on the grid, convection in the x direction (0 for the symmetric one).
+static void create_system(double convection, UMFPackMatrix<double>* matrix, UMFPackVector<double>* rhs)
+{
+  int size = GRID_SIZE * GRID_SIZE;
+  matrix->prealloc(size);
+  for (int i = 0; i < size; i++)
+  {
+    int x = i % GRID_SIZE, y = i / GRID_SIZE;
+    matrix->pre_add_ij(i, i);
+    if(x > 0) matrix->pre_add_ij(i, i - 1);
+    if(x < GRID_SIZE - 1) matrix->pre_add_ij(i, i + 1);
+    if(y > 0) matrix->pre_add_ij(i, i - GRID_SIZE);
+    if(y < GRID_SIZE - 1) matrix->pre_add_ij(i, i + GRID_SIZE);
+  }
+  matrix->alloc();
+  rhs->alloc(size);
+
+  for (int i = 0; i < size; i++)
+  {
+    int x = i % GRID_SIZE, y = i / GRID_SIZE;
+    matrix->add(i, i, 4.0);
+    if(x > 0) matrix->add(i, i - 1, -1.0 - 0.5 * convection);
+    if(x < GRID_SIZE - 1) matrix->add(i, i + 1, -1.0 + 0.5 * convection);
+    if(y > 0) matrix->add(i, i - GRID_SIZE, -1.0);
+    if(y < GRID_SIZE - 1) matrix->add(i, i + GRID_SIZE, -1.0);
+    rhs->set(i, 1.0 + 0.1 * (i % 7));
+  }
+}
+
+/// Solves the system by a Krylov method and compares the solution with the direct one.
+static bool check_krylov_solver(UMFPackMatrix<double>* matrix, UMFPackVector<double>* rhs, double* direct_sln,
+  const char* method, const char* precond)
+{
+  int size = matrix->get_size();
+  KrylovSolver<double> solver(matrix, rhs);
+  solver.set_solver(method);
+  solver.set_precond(precond);
+  solver.set_tolerance(KRYLOV_TOL);
+  solver.set_max_iters(10 * size);
+
+  bool converged;
+  try
+  {
+    converged = solver.solve();
+  }
+  catch(std::exception& e)
+  {
+    printf("%s (%s): %s\n", method, precond, e.what());
+    return false;
+  }
+
+  double* sln = solver.get_sln_vector();
+  double max_value = 0.0, max_difference = 0.0;
+  for (int i = 0; i < size; i++)
+  {
+    max_value = std::max(max_value, std::abs(direct_sln[i]));
+    max_difference = std::max(max_difference, std::abs(sln[i] - direct_sln[i]));
+  }
+  printf("%s (%s): %d iterations, relative difference %g\n", method, precond, solver.get_num_iters(), max_difference / max_value);
+
+  return converged && max_difference <= TOLERANCE * max_value;
+}
+
+int main(int argc, char* argv[])
+{
+  bool success = true;
+
+  // The symmetric positive definite system.
+  UMFPackMatrix<double> spd_matrix;
+  UMFPackVector<double> spd_rhs;
+  create_system(0.0, &spd_matrix, &spd_rhs);
+
+  UMFPackLinearMatrixSolver<double> spd_direct(&spd_matrix, &spd_rhs);
+  spd_direct.solve();
+  double* spd_sln = new double[spd_matrix.get_size()];
+  memcpy(spd_sln, spd_direct.get_sln_vector(), spd_matrix.get_size() * sizeof(double));
+
+  success = check_krylov_solver(&spd_matrix, &spd_rhs, spd_sln, "cg", "none") && success;
+  success = check_krylov_solver(&spd_matrix, &spd_rhs, spd_sln, "cg", "jacobi") && success;
+
+  // The nonsymmetric system.
+  UMFPackMatrix<double> matrix;
+  UMFPackVector<double> rhs;
+  create_system(CONVECTION, &matrix, &rhs);
+
+  UMFPackLinearMatrixSolver<double> direct(&matrix, &rhs);
+  direct.solve();
+  double* sln = new double[matrix.get_size()];
+  memcpy(sln, direct.get_sln_vector(), matrix.get_size() * sizeof(double));
+
+  success = check_krylov_solver(&matrix, &rhs, sln, "bicgstab", "jacobi") && success;
+  success = check_krylov_solver(&matrix, &rhs, sln, "bicgstab", "ilu0") && success;
+  success = check_krylov_solver(&matrix, &rhs, sln, "gmres", "ilu0") && success;
+  success = check_krylov_solver(&matrix, &rhs, sln, "gmres", "block-jacobi") && success;
+
+  delete [] spd_sln;
+  delete [] sln;
+
+  if(success)
+  {
+    printf("Success!\n");
+    return 0;
+  }
+  else
+  {
+    printf("Failure!\n");
+    return -1;
+  }
+}